@@ -1107,6 +1107,25 @@ void gic_clear_irq_pending(unsigned int irq)
 	raw_spin_unlock(&irq_controller_lock);
 }
 
+/*
+ * Return the highest priority interrupt pending on this cpu's interface,
+ * without acknowledging it, or -ENOENT if there is none. SGIs are
+ * reported by their hardware number.
+ */
+int gic_get_pending_irq(void)
+{
+	struct gic_chip_data *gic = &gic_data[0];
+	void __iomem *cpu_base = gic_data_cpu_base(gic);
+	u32 irqnr;
+
+	irqnr = readl_relaxed(cpu_base + GIC_CPU_HIGHPRI) & 0x3ff;
+	if (irqnr > 15 && irqnr < 1021)
+		return irq_find_mapping(gic->domain, irqnr);
+	if (irqnr < 16)
+		return irqnr;
+	return -ENOENT;
+}
+
 #ifdef CONFIG_ARCH_MSM8625
  /*
   *  Check for any interrupts which are enabled are pending
@@ -0,0 +1,104 @@
+/*
+ * CRC32/CRC32C folding using NEON
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * ARMv7 has no 64-bit carry-less multiply, so it is built from vmull.p8
+ * the same way the OpenSSL GHASH code does it: eight 8x8 polynomial
+ * products of byte-rotated operands, masked and shifted into place.
+ * With that, the input is folded 64 bytes at a time into four 128-bit
+ * accumulators, which are then folded into one. The caller finishes the
+ * last 16 bytes with the table code.
+ *
+ * Built with -mfpu=neon, so only call this between kernel_neon_begin()
+ * and kernel_neon_end().
+ */
+
+#include <linux/types.h>
+#include <arm_neon.h>
+
+#define PMULL8(a, b)	vreinterpretq_u8_p16(vmull_p8(vreinterpret_p8_u8(a), \
+						      vreinterpret_p8_u8(b)))
+
+static inline uint8x16_t pmull_mask(uint8x16_t x, uint8x8_t m)
+{
+	uint8x8_t l = veor_u8(vget_low_u8(x), vget_high_u8(x));
+	uint8x8_t h = vand_u8(vget_high_u8(x), m);
+
+	return vcombine_u8(veor_u8(l, h), h);
+}
+
+/* 64x64 -> 128 bit carry-less multiply */
+static inline uint8x16_t pmull64(uint8x8_t a, uint8x8_t b)
+{
+	uint8x16_t l, m, n, k;
+
+	l = veorq_u8(PMULL8(vext_u8(a, a, 1), b), PMULL8(a, vext_u8(b, b, 1)));
+	m = veorq_u8(PMULL8(vext_u8(a, a, 2), b), PMULL8(a, vext_u8(b, b, 2)));
+	n = veorq_u8(PMULL8(vext_u8(a, a, 3), b), PMULL8(a, vext_u8(b, b, 3)));
+	k = PMULL8(a, vext_u8(b, b, 4));
+
+	l = pmull_mask(l, vcreate_u8(0x0000ffffffffffffULL));
+	m = pmull_mask(m, vcreate_u8(0x00000000ffffffffULL));
+	n = pmull_mask(n, vcreate_u8(0x000000000000ffffULL));
+	k = vcombine_u8(veor_u8(vget_low_u8(k), vget_high_u8(k)),
+			vdup_n_u8(0));
+
+	l = vextq_u8(l, l, 15);
+	m = vextq_u8(m, m, 14);
+	n = vextq_u8(n, n, 13);
+	k = vextq_u8(k, k, 12);
+
+	return veorq_u8(PMULL8(a, b), veorq_u8(veorq_u8(l, m), veorq_u8(n, k)));
+}
+
+/* fold @x forward over the distance encoded by @khi/@klo and add @next */
+static inline uint8x16_t fold(uint8x16_t x, uint8x8_t khi, uint8x8_t klo,
+			      uint8x16_t next)
+{
+	return veorq_u8(veorq_u8(pmull64(vget_low_u8(x), khi),
+				 pmull64(vget_high_u8(x), klo)), next);
+}
+
+/**
+ * crc32_neon_fold - fold a buffer down to 16 bytes with the same CRC
+ * @out: the 16 byte remainder, to be run through the table code
+ * @crc: initial CRC, as passed to crc32_le()/__crc32c_le()
+ * @p: data
+ * @blocks: number of 64 byte blocks in @p, at least one
+ * @k: fold constants for 512 and 128 bit distances, bit reflected
+ *
+ * crc32_le(0, out, 16) (or the crc32c equivalent) is then the CRC of
+ * @blocks * 64 bytes of @p starting from @crc.
+ */
+void crc32_neon_fold(u8 *out, u32 crc, const u8 *p, unsigned int blocks,
+		     const u64 k[4])
+{
+	const uint8x8_t k575 = vcreate_u8(k[0]), k511 = vcreate_u8(k[1]);
+	const uint8x8_t k191 = vcreate_u8(k[2]), k127 = vcreate_u8(k[3]);
+	uint8x16_t x0, x1, x2, x3;
+
+	x0 = vld1q_u8(p);
+	x1 = vld1q_u8(p + 16);
+	x2 = vld1q_u8(p + 32);
+	x3 = vld1q_u8(p + 48);
+	x0 = veorq_u8(x0, vcombine_u8(vcreate_u8(crc), vdup_n_u8(0)));
+	p += 64;
+
+	while (--blocks) {
+		x0 = fold(x0, k575, k511, vld1q_u8(p));
+		x1 = fold(x1, k575, k511, vld1q_u8(p + 16));
+		x2 = fold(x2, k575, k511, vld1q_u8(p + 32));
+		x3 = fold(x3, k575, k511, vld1q_u8(p + 48));
+		p += 64;
+	}
+
+	x1 = fold(x0, k191, k127, x1);
+	x2 = fold(x1, k191, k127, x2);
+	x3 = fold(x2, k191, k127, x3);
+
+	vst1q_u8(out, x3);
+}
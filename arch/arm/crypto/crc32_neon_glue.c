@@ -0,0 +1,312 @@
+/*
+ * Glue code for CRC32 and CRC32C using NEON folding.
+ *
+ * This file is based on crypto/crc32c.c.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Whether vmull.p8 folding beats the slice-by-8 tables in lib/crc32.c
+ * depends on the core (and on how warm the tables are), so the module
+ * times both on a page at load and registers at a priority above or
+ * below crc32c-generic accordingly. The NEON drivers stay reachable by
+ * driver name either way.
+ */
+
+#include <crypto/internal/hash.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/crc32.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <asm/unaligned.h>
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+#define CHKSUM_BLOCK_SIZE	1
+#define CHKSUM_DIGEST_SIZE	4
+
+/* below this, kernel_neon_begin() costs more than it saves */
+#define CRC32_NEON_MIN		256
+
+#define CRC32_NEON_PRIO		300
+#define CRC32_NEON_PRIO_SLOW	50
+
+void crc32_neon_fold(u8 *out, u32 crc, const u8 *p, unsigned int blocks,
+		     const u64 k[4]);
+
+/* rev64(x^n mod P) for n = 575, 511, 191, 127 */
+static const u64 crc32_k[4] = {
+	0x653d982200000000ULL, 0xcad38e8f00000000ULL,
+	0x65673b4600000000ULL, 0x9ba54c6f00000000ULL,
+};
+
+static const u64 crc32c_k[4] = {
+	0x1c19243b00000000ULL, 0x75bba45b00000000ULL,
+	0x3743f7bd00000000ULL, 0x3171d43000000000ULL,
+};
+
+struct chksum_ctx {
+	u32 key;
+};
+
+struct chksum_desc_ctx {
+	u32 crc;
+};
+
+static u32 crc32_neon(u32 crc, const u8 *p, size_t len, const u64 *k,
+		      u32 (*tab)(u32, unsigned char const *, size_t))
+{
+	u8 rem[16];
+
+	if (len >= CRC32_NEON_MIN && may_use_simd()) {
+		size_t blocks = len / 64;
+
+		kernel_neon_begin();
+		crc32_neon_fold(rem, crc, p, blocks, k);
+		kernel_neon_end();
+
+		crc = tab(0, rem, sizeof(rem));
+		p += blocks * 64;
+		len -= blocks * 64;
+	}
+
+	return tab(crc, p, len);
+}
+
+static u32 crc32_le_neon(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_neon(crc, p, len, crc32_k, crc32_le);
+}
+
+static u32 crc32c_le_neon(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_neon(crc, p, len, crc32c_k, __crc32c_le);
+}
+
+static int chksum_init(struct shash_desc *desc)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(desc->tfm);
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	ctx->crc = mctx->key;
+
+	return 0;
+}
+
+static int chksum_setkey(struct crypto_shash *tfm, const u8 *key,
+			 unsigned int keylen)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(tfm);
+
+	if (keylen != sizeof(mctx->key)) {
+		crypto_shash_set_flags(tfm, CRYPTO_TFM_RES_BAD_KEY_LEN);
+		return -EINVAL;
+	}
+	mctx->key = get_unaligned_le32(key);
+	return 0;
+}
+
+static int crc32_update(struct shash_desc *desc, const u8 *data,
+			unsigned int length)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	ctx->crc = crc32_le_neon(ctx->crc, data, length);
+	return 0;
+}
+
+static int crc32c_update(struct shash_desc *desc, const u8 *data,
+			 unsigned int length)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	ctx->crc = crc32c_le_neon(ctx->crc, data, length);
+	return 0;
+}
+
+/* "crc32" follows crc32_le(): no inversion, seed 0 unless keyed */
+static int crc32_final(struct shash_desc *desc, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	put_unaligned_le32(ctx->crc, out);
+	return 0;
+}
+
+static int crc32_finup(struct shash_desc *desc, const u8 *data,
+		       unsigned int len, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	put_unaligned_le32(crc32_le_neon(ctx->crc, data, len), out);
+	return 0;
+}
+
+static int crc32_digest(struct shash_desc *desc, const u8 *data,
+			unsigned int len, u8 *out)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(desc->tfm);
+
+	put_unaligned_le32(crc32_le_neon(mctx->key, data, len), out);
+	return 0;
+}
+
+/* "crc32c" matches crc32c-generic: seed ~0, inverted on output */
+static int crc32c_final(struct shash_desc *desc, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	put_unaligned_le32(~ctx->crc, out);
+	return 0;
+}
+
+static int crc32c_finup(struct shash_desc *desc, const u8 *data,
+			unsigned int len, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	put_unaligned_le32(~crc32c_le_neon(ctx->crc, data, len), out);
+	return 0;
+}
+
+static int crc32c_digest(struct shash_desc *desc, const u8 *data,
+			 unsigned int len, u8 *out)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(desc->tfm);
+
+	put_unaligned_le32(~crc32c_le_neon(mctx->key, data, len), out);
+	return 0;
+}
+
+static int crc32_cra_init(struct crypto_tfm *tfm)
+{
+	struct chksum_ctx *mctx = crypto_tfm_ctx(tfm);
+
+	mctx->key = 0;
+	return 0;
+}
+
+static int crc32c_cra_init(struct crypto_tfm *tfm)
+{
+	struct chksum_ctx *mctx = crypto_tfm_ctx(tfm);
+
+	mctx->key = ~0;
+	return 0;
+}
+
+static struct shash_alg algs[] = { {
+	.digestsize		=	CHKSUM_DIGEST_SIZE,
+	.setkey			=	chksum_setkey,
+	.init			=	chksum_init,
+	.update			=	crc32_update,
+	.final			=	crc32_final,
+	.finup			=	crc32_finup,
+	.digest			=	crc32_digest,
+	.descsize		=	sizeof(struct chksum_desc_ctx),
+	.base			=	{
+		.cra_name		=	"crc32",
+		.cra_driver_name	=	"crc32-arm-neon",
+		.cra_priority		=	CRC32_NEON_PRIO,
+		.cra_blocksize		=	CHKSUM_BLOCK_SIZE,
+		.cra_ctxsize		=	sizeof(struct chksum_ctx),
+		.cra_module		=	THIS_MODULE,
+		.cra_init		=	crc32_cra_init,
+	}
+}, {
+	.digestsize		=	CHKSUM_DIGEST_SIZE,
+	.setkey			=	chksum_setkey,
+	.init			=	chksum_init,
+	.update			=	crc32c_update,
+	.final			=	crc32c_final,
+	.finup			=	crc32c_finup,
+	.digest			=	crc32c_digest,
+	.descsize		=	sizeof(struct chksum_desc_ctx),
+	.base			=	{
+		.cra_name		=	"crc32c",
+		.cra_driver_name	=	"crc32c-arm-neon",
+		.cra_priority		=	CRC32_NEON_PRIO,
+		.cra_blocksize		=	CHKSUM_BLOCK_SIZE,
+		.cra_ctxsize		=	sizeof(struct chksum_ctx),
+		.cra_module		=	THIS_MODULE,
+		.cra_init		=	crc32c_cra_init,
+	}
+} };
+
+/* best of a few runs, in ns, of 16 passes of @fn over @len bytes */
+static s64 crc32_neon_time(u32 (*fn)(u32, unsigned char const *, size_t),
+			   const u8 *buf, unsigned int len)
+{
+	s64 best = S64_MAX, t;
+	ktime_t start;
+	int i, j;
+
+	for (i = 0; i < 4; i++) {
+		start = ktime_get();
+		for (j = 0; j < 16; j++)
+			fn(~0, buf, len);
+		t = ktime_to_ns(ktime_sub(ktime_get(), start));
+		if (t < best)
+			best = t;
+	}
+	return best;
+}
+
+static void __init crc32_neon_pick(void)
+{
+	s64 neon, tab;
+	u8 *buf;
+	int prio;
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return;
+	memset(buf, 0xa5, PAGE_SIZE);
+
+	/* the first run of each also warms the caches */
+	tab = crc32_neon_time(__crc32c_le, buf, PAGE_SIZE);
+	neon = crc32_neon_time(crc32c_le_neon, buf, PAGE_SIZE);
+
+	prio = neon < tab ? CRC32_NEON_PRIO : CRC32_NEON_PRIO_SLOW;
+	algs[1].base.cra_priority = prio;
+	pr_info("crc32c-arm-neon: %lld ns vs %lld ns table, priority %d\n",
+		neon, tab, prio);
+
+	tab = crc32_neon_time(crc32_le, buf, PAGE_SIZE);
+	neon = crc32_neon_time(crc32_le_neon, buf, PAGE_SIZE);
+
+	prio = neon < tab ? CRC32_NEON_PRIO : CRC32_NEON_PRIO_SLOW;
+	algs[0].base.cra_priority = prio;
+	pr_info("crc32-arm-neon: %lld ns vs %lld ns table, priority %d\n",
+		neon, tab, prio);
+
+	kfree(buf);
+}
+
+static int __init crc32_neon_mod_init(void)
+{
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	crc32_neon_pick();
+
+	return crypto_register_shashes(algs, ARRAY_SIZE(algs));
+}
+
+static void __exit crc32_neon_mod_fini(void)
+{
+	crypto_unregister_shashes(algs, ARRAY_SIZE(algs));
+}
+
+module_init(crc32_neon_mod_init);
+module_exit(crc32_neon_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("CRC32 and CRC32C, NEON accelerated");
+
+MODULE_ALIAS("crc32");
+MODULE_ALIAS("crc32c");
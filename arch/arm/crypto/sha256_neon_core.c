@@ -0,0 +1,200 @@
+/*
+ * SHA-256 block functions using NEON
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * sha256_transform_neon() hashes one message, with the message schedule
+ * computed four words at a time in NEON registers and the rounds in the
+ * integer core. sha256_transform_neon_x4() hashes four independent
+ * messages of the same length, one per 32-bit lane, which is where NEON
+ * really pays off.
+ *
+ * Built with -mfpu=neon, so only call these between kernel_neon_begin()
+ * and kernel_neon_end().
+ */
+
+#include <linux/types.h>
+#include <linux/bitops.h>
+#include <asm/byteorder.h>
+#include <arm_neon.h>
+
+static const u32 sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define Ch(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define Maj(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+#define e0(x)		(ror32(x, 2) ^ ror32(x, 13) ^ ror32(x, 22))
+#define e1(x)		(ror32(x, 6) ^ ror32(x, 11) ^ ror32(x, 25))
+
+/* Rotates and small sigmas on 2 and 4 lanes */
+#define VROR(x, n)	vsriq_n_u32(vshlq_n_u32(x, 32 - (n)), x, n)
+#define VROR2(x, n)	vsri_n_u32(vshl_n_u32(x, 32 - (n)), x, n)
+
+#define vs0(x)		veorq_u32(veorq_u32(VROR(x, 7), VROR(x, 18)), \
+				  vshrq_n_u32(x, 3))
+#define vs1_2(x)	veor_u32(veor_u32(VROR2(x, 17), VROR2(x, 19)), \
+				 vshr_n_u32(x, 10))
+#define vs1(x)		veorq_u32(veorq_u32(VROR(x, 17), VROR(x, 19)), \
+				  vshrq_n_u32(x, 10))
+#define ve0(x)		veorq_u32(veorq_u32(VROR(x, 2), VROR(x, 13)), \
+				  VROR(x, 22))
+#define ve1(x)		veorq_u32(veorq_u32(VROR(x, 6), VROR(x, 11)), \
+				  VROR(x, 25))
+
+static inline uint32x4_t vload_be32(const u8 *p)
+{
+	return vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p)));
+}
+
+void sha256_transform_neon(u32 *state, const u8 *data, unsigned int blocks)
+{
+	u32 W[64];
+	u32 a, b, c, d, e, f, g, h, t1, t2;
+	int i;
+
+	while (blocks--) {
+		for (i = 0; i < 16; i += 4)
+			vst1q_u32(&W[i], vload_be32(data + i * 4));
+
+		/*
+		 * s1() of the upper two words of each group depends on the
+		 * lower two, so that half is finished in a second step.
+		 */
+		for (i = 16; i < 64; i += 4) {
+			uint32x4_t v = vaddq_u32(vaddq_u32(vld1q_u32(&W[i - 16]),
+					vs0(vld1q_u32(&W[i - 15]))),
+					vld1q_u32(&W[i - 7]));
+			uint32x2_t lo = vadd_u32(vget_low_u32(v),
+						 vs1_2(vld1_u32(&W[i - 2])));
+			uint32x2_t hi = vadd_u32(vget_high_u32(v), vs1_2(lo));
+
+			vst1q_u32(&W[i], vcombine_u32(lo, hi));
+		}
+
+		for (i = 0; i < 64; i += 4)
+			vst1q_u32(&W[i], vaddq_u32(vld1q_u32(&W[i]),
+						   vld1q_u32(&sha256_k[i])));
+
+		a = state[0]; b = state[1]; c = state[2]; d = state[3];
+		e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+		for (i = 0; i < 64; i++) {
+			t1 = h + e1(e) + Ch(e, f, g) + W[i];
+			t2 = e0(a) + Maj(a, b, c);
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+
+		data += 64;
+	}
+}
+
+void sha256_transform_neon_x4(u32 *state[4], const u8 *data[4],
+			      unsigned int blocks)
+{
+	uint32x4_t s[8], v[8], W[16];
+	uint32x4_t t1, t2;
+	const u8 *p0 = data[0], *p1 = data[1], *p2 = data[2], *p3 = data[3];
+	u32 lane[4];
+	int i, j;
+
+	/* one lane per message */
+	for (i = 0; i < 8; i++) {
+		lane[0] = state[0][i];
+		lane[1] = state[1][i];
+		lane[2] = state[2][i];
+		lane[3] = state[3][i];
+		s[i] = vld1q_u32(lane);
+	}
+
+	while (blocks--) {
+		/* transpose 4 words of each message into 4 words x 4 lanes */
+		for (i = 0; i < 16; i += 4) {
+			uint32x4x2_t t01 = vtrnq_u32(vload_be32(p0 + i * 4),
+						     vload_be32(p1 + i * 4));
+			uint32x4x2_t t23 = vtrnq_u32(vload_be32(p2 + i * 4),
+						     vload_be32(p3 + i * 4));
+
+			W[i] = vcombine_u32(vget_low_u32(t01.val[0]),
+					    vget_low_u32(t23.val[0]));
+			W[i + 1] = vcombine_u32(vget_low_u32(t01.val[1]),
+						vget_low_u32(t23.val[1]));
+			W[i + 2] = vcombine_u32(vget_high_u32(t01.val[0]),
+						vget_high_u32(t23.val[0]));
+			W[i + 3] = vcombine_u32(vget_high_u32(t01.val[1]),
+						vget_high_u32(t23.val[1]));
+		}
+
+		for (j = 0; j < 8; j++)
+			v[j] = s[j];
+
+		for (i = 0; i < 64; i++) {
+			uint32x4_t w;
+
+			if (i < 16) {
+				w = W[i];
+			} else {
+				w = vaddq_u32(vaddq_u32(W[i & 15],
+						vs0(W[(i - 15) & 15])),
+					vaddq_u32(W[(i - 7) & 15],
+						vs1(W[(i - 2) & 15])));
+				W[i & 15] = w;
+			}
+
+			/* v[0..7] are a..h */
+			t1 = vaddq_u32(vaddq_u32(v[7], ve1(v[4])),
+				       vaddq_u32(vbslq_u32(v[4], v[5], v[6]),
+						 vaddq_u32(w,
+						   vdupq_n_u32(sha256_k[i]))));
+			t2 = vaddq_u32(ve0(v[0]),
+				       vbslq_u32(veorq_u32(v[0], v[1]),
+						 v[2], v[1]));
+			v[7] = v[6];
+			v[6] = v[5];
+			v[5] = v[4];
+			v[4] = vaddq_u32(v[3], t1);
+			v[3] = v[2];
+			v[2] = v[1];
+			v[1] = v[0];
+			v[0] = vaddq_u32(t1, t2);
+		}
+
+		for (j = 0; j < 8; j++)
+			s[j] = vaddq_u32(s[j], v[j]);
+
+		p0 += 64;
+		p1 += 64;
+		p2 += 64;
+		p3 += 64;
+	}
+
+	for (i = 0; i < 8; i++) {
+		vst1q_u32(lane, s[i]);
+		state[0][i] = lane[0];
+		state[1][i] = lane[1];
+		state[2][i] = lane[2];
+		state[3][i] = lane[3];
+	}
+}
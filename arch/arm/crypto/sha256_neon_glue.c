@@ -0,0 +1,365 @@
+/*
+ * Glue code for the SHA256 Secure Hash Algorithm using NEON instructions.
+ *
+ * This file is based on sha256_generic.c and sha1_neon_glue.c.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ */
+
+#include <crypto/internal/hash.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/cryptohash.h>
+#include <linux/types.h>
+#include <linux/string.h>
+#include <crypto/sha.h>
+#include <asm/byteorder.h>
+#include <asm/unaligned.h>
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+
+void sha256_transform_neon(u32 *state, const u8 *data, unsigned int blocks);
+void sha256_transform_neon_x4(u32 *state[4], const u8 *data[4],
+			      unsigned int blocks);
+
+static const u8 sha256_padding[SHA256_BLOCK_SIZE] = { 0x80, };
+
+
+static void sha256_neon_state_init(struct sha256_state *sctx)
+{
+	*sctx = (struct sha256_state){
+		.state = { SHA256_H0, SHA256_H1, SHA256_H2, SHA256_H3,
+			   SHA256_H4, SHA256_H5, SHA256_H6, SHA256_H7 },
+	};
+}
+
+static int sha256_neon_init(struct shash_desc *desc)
+{
+	sha256_neon_state_init(shash_desc_ctx(desc));
+
+	return 0;
+}
+
+static int sha224_neon_init(struct shash_desc *desc)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+
+	*sctx = (struct sha256_state){
+		.state = { SHA224_H0, SHA224_H1, SHA224_H2, SHA224_H3,
+			   SHA224_H4, SHA224_H5, SHA224_H6, SHA224_H7 },
+	};
+
+	return 0;
+}
+
+static void __sha256_neon_update(struct sha256_state *sctx, const u8 *data,
+				 unsigned int len)
+{
+	unsigned int partial = sctx->count % SHA256_BLOCK_SIZE;
+	unsigned int done = 0;
+
+	sctx->count += len;
+
+	if (partial) {
+		done = min(len, SHA256_BLOCK_SIZE - partial);
+		memcpy(sctx->buf + partial, data, done);
+		if (partial + done < SHA256_BLOCK_SIZE)
+			return;
+		sha256_transform_neon(sctx->state, sctx->buf, 1);
+	}
+
+	if (len - done >= SHA256_BLOCK_SIZE) {
+		const unsigned int blocks = (len - done) / SHA256_BLOCK_SIZE;
+
+		sha256_transform_neon(sctx->state, data + done, blocks);
+		done += blocks * SHA256_BLOCK_SIZE;
+	}
+
+	memcpy(sctx->buf, data + done, len - done);
+}
+
+static void __sha256_neon_final(struct sha256_state *sctx, u8 *out)
+{
+	unsigned int i, index, padlen;
+	__be64 bits;
+
+	bits = cpu_to_be64(sctx->count << 3);
+
+	/* Pad out to 56 mod 64 and append length */
+	index = sctx->count % SHA256_BLOCK_SIZE;
+	padlen = (index < 56) ? (56 - index) : ((SHA256_BLOCK_SIZE+56) - index);
+	__sha256_neon_update(sctx, sha256_padding, padlen);
+	__sha256_neon_update(sctx, (const u8 *)&bits, sizeof(bits));
+
+	for (i = 0; i < SHA256_DIGEST_SIZE / 4; i++)
+		put_unaligned_be32(sctx->state[i], out + i * 4);
+
+	memset(sctx, 0, sizeof(*sctx));
+}
+
+static int sha256_neon_update(struct shash_desc *desc, const u8 *data,
+			      unsigned int len)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+	unsigned int partial = sctx->count % SHA256_BLOCK_SIZE;
+
+	/* Handle the fast case right here */
+	if (partial + len < SHA256_BLOCK_SIZE) {
+		sctx->count += len;
+		memcpy(sctx->buf + partial, data, len);
+
+		return 0;
+	}
+
+	if (!may_use_simd())
+		return crypto_sha256_update(desc, data, len);
+
+	kernel_neon_begin();
+	__sha256_neon_update(sctx, data, len);
+	kernel_neon_end();
+
+	return 0;
+}
+
+static int sha256_neon_final(struct shash_desc *desc, u8 *out)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+	unsigned int i, index, padlen;
+	__be64 bits;
+
+	if (may_use_simd()) {
+		kernel_neon_begin();
+		__sha256_neon_final(sctx, out);
+		kernel_neon_end();
+
+		return 0;
+	}
+
+	bits = cpu_to_be64(sctx->count << 3);
+	index = sctx->count % SHA256_BLOCK_SIZE;
+	padlen = (index < 56) ? (56 - index) : ((SHA256_BLOCK_SIZE+56) - index);
+	crypto_sha256_update(desc, sha256_padding, padlen);
+	crypto_sha256_update(desc, (const u8 *)&bits, sizeof(bits));
+
+	for (i = 0; i < SHA256_DIGEST_SIZE / 4; i++)
+		put_unaligned_be32(sctx->state[i], out + i * 4);
+
+	memset(sctx, 0, sizeof(*sctx));
+
+	return 0;
+}
+
+static int sha224_neon_final(struct shash_desc *desc, u8 *hash)
+{
+	u8 D[SHA256_DIGEST_SIZE];
+
+	sha256_neon_final(desc, D);
+
+	memcpy(hash, D, SHA224_DIGEST_SIZE);
+	memset(D, 0, SHA256_DIGEST_SIZE);
+
+	return 0;
+}
+
+static int sha256_neon_export(struct shash_desc *desc, void *out)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+
+	memcpy(out, sctx, sizeof(*sctx));
+
+	return 0;
+}
+
+static int sha256_neon_import(struct shash_desc *desc, const void *in)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+
+	memcpy(sctx, in, sizeof(*sctx));
+
+	return 0;
+}
+
+/*
+ * Finish four messages that share the hashed prefix in @pre, each
+ * followed by @len bytes of its own data, in the four NEON lanes.
+ */
+static void sha256_neon_finup_x4(const struct sha256_state *pre,
+				 const u8 * const data[], unsigned int len,
+				 u8 * const out[])
+{
+	u8 buf[4][2 * SHA256_BLOCK_SIZE];
+	u32 state[4][SHA256_DIGEST_SIZE / 4];
+	u32 *sp[4];
+	const u8 *dp[4];
+	unsigned int partial = pre->count % SHA256_BLOCK_SIZE;
+	unsigned int done = 0, tail, padded, blocks, i, j;
+	u64 bits = (pre->count + len) << 3;
+
+	for (i = 0; i < 4; i++) {
+		memcpy(state[i], pre->state, sizeof(state[i]));
+		sp[i] = state[i];
+	}
+
+	/* complete the block the prefix left open */
+	tail = 0;
+	if (partial) {
+		done = min(len, SHA256_BLOCK_SIZE - partial);
+		for (i = 0; i < 4; i++) {
+			memcpy(buf[i], pre->buf, partial);
+			memcpy(buf[i] + partial, data[i], done);
+			dp[i] = buf[i];
+		}
+		if (partial + done == SHA256_BLOCK_SIZE)
+			sha256_transform_neon_x4(sp, dp, 1);
+		else
+			tail = partial + done;
+	}
+
+	blocks = (len - done) / SHA256_BLOCK_SIZE;
+	if (blocks) {
+		for (i = 0; i < 4; i++)
+			dp[i] = data[i] + done;
+		sha256_transform_neon_x4(sp, dp, blocks);
+		done += blocks * SHA256_BLOCK_SIZE;
+	}
+
+	/* whatever is left, then the padding and the length */
+	if (!tail) {
+		tail = len - done;
+		for (i = 0; i < 4; i++)
+			memcpy(buf[i], data[i] + done, tail);
+	}
+	padded = tail < 56 ? SHA256_BLOCK_SIZE : 2 * SHA256_BLOCK_SIZE;
+	for (i = 0; i < 4; i++) {
+		buf[i][tail] = 0x80;
+		memset(buf[i] + tail + 1, 0, padded - tail - 9);
+		put_unaligned_be64(bits, buf[i] + padded - 8);
+		dp[i] = buf[i];
+	}
+	sha256_transform_neon_x4(sp, dp, padded / SHA256_BLOCK_SIZE);
+
+	for (i = 0; i < 4; i++)
+		for (j = 0; j < SHA256_DIGEST_SIZE / 4; j++)
+			put_unaligned_be32(state[i][j], out[i] + j * 4);
+}
+
+/**
+ * sha256_finup_mb - hash several messages with a common prefix
+ * @prefix: bytes each message starts with, or NULL
+ * @plen: length of @prefix
+ * @data: @n pointers to the rest of each message
+ * @len: length of each of the buffers in @data
+ * @out: @n pointers to SHA256_DIGEST_SIZE bytes for the digests
+ * @n: number of messages
+ *
+ * Computes sha256(prefix || data[i]) for each i, four at a time. Meant
+ * for dm-verity, whose data block hashes are salt || block.
+ */
+int sha256_finup_mb(const u8 *prefix, unsigned int plen,
+		    const u8 * const data[], unsigned int len,
+		    u8 * const out[], unsigned int n)
+{
+	struct sha256_state pre, sctx;
+	unsigned int i = 0;
+
+	if (!may_use_simd()) {
+		struct {
+			struct shash_desc desc;
+			struct sha256_state sctx;
+		} d;
+
+		d.desc.tfm = NULL;
+		d.desc.flags = 0;
+		for (i = 0; i < n; i++) {
+			sha256_neon_state_init(shash_desc_ctx(&d.desc));
+			crypto_sha256_update(&d.desc, prefix, plen);
+			crypto_sha256_update(&d.desc, data[i], len);
+			sha256_neon_final(&d.desc, out[i]);
+		}
+		return 0;
+	}
+
+	kernel_neon_begin();
+
+	sha256_neon_state_init(&pre);
+	__sha256_neon_update(&pre, prefix, plen);
+
+	for (; i + 4 <= n; i += 4)
+		sha256_neon_finup_x4(&pre, data + i, len, out + i);
+
+	for (; i < n; i++) {
+		sctx = pre;
+		__sha256_neon_update(&sctx, data[i], len);
+		__sha256_neon_final(&sctx, out[i]);
+	}
+
+	kernel_neon_end();
+
+	memset(&pre, 0, sizeof(pre));
+	return 0;
+}
+EXPORT_SYMBOL_GPL(sha256_finup_mb);
+
+static struct shash_alg algs[] = { {
+	.digestsize	=	SHA256_DIGEST_SIZE,
+	.init		=	sha256_neon_init,
+	.update		=	sha256_neon_update,
+	.final		=	sha256_neon_final,
+	.export		=	sha256_neon_export,
+	.import		=	sha256_neon_import,
+	.descsize	=	sizeof(struct sha256_state),
+	.statesize	=	sizeof(struct sha256_state),
+	.base		=	{
+		.cra_name	=	"sha256",
+		.cra_driver_name =	"sha256-neon",
+		.cra_priority	=	250,
+		.cra_flags	=	CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize	=	SHA256_BLOCK_SIZE,
+		.cra_module	=	THIS_MODULE,
+	}
+}, {
+	.digestsize	=	SHA224_DIGEST_SIZE,
+	.init		=	sha224_neon_init,
+	.update		=	sha256_neon_update,
+	.final		=	sha224_neon_final,
+	.export		=	sha256_neon_export,
+	.import		=	sha256_neon_import,
+	.descsize	=	sizeof(struct sha256_state),
+	.statesize	=	sizeof(struct sha256_state),
+	.base		=	{
+		.cra_name	=	"sha224",
+		.cra_driver_name =	"sha224-neon",
+		.cra_priority	=	250,
+		.cra_flags	=	CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize	=	SHA224_BLOCK_SIZE,
+		.cra_module	=	THIS_MODULE,
+	}
+} };
+
+static int __init sha256_neon_mod_init(void)
+{
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	return crypto_register_shashes(algs, ARRAY_SIZE(algs));
+}
+
+static void __exit sha256_neon_mod_fini(void)
+{
+	crypto_unregister_shashes(algs, ARRAY_SIZE(algs));
+}
+
+module_init(sha256_neon_mod_init);
+module_exit(sha256_neon_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("SHA256 Secure Hash Algorithm, NEON accelerated");
+
+MODULE_ALIAS("sha256");
+MODULE_ALIAS("sha224");
@@ -10,8 +10,22 @@
 
 #include <asm/hwcap.h>
 
+/*
+ * memcpy(), memset() (and so clear_page()) and copy_page() move blocks of
+ * at least this many bytes with NEON when kernel mode NEON is usable.
+ * Must be a valid ARM immediate.
+ */
+#define NEON_MEMOPS_MIN		1024
+
+#ifndef __ASSEMBLY__
+
+#include <linux/percpu.h>
+
 #define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
 
+/* Set between kernel_neon_begin() and kernel_neon_end() on this cpu */
+DECLARE_PER_CPU(bool, kernel_neon_busy);
+
 #ifdef __ARM_NEON__
 
 /*
@@ -34,3 +48,12 @@
 void kernel_neon_begin(void);
 #endif
 void kernel_neon_end(void);
+
+/* The integer and NEON halves of the string ops, see arch/arm/lib */
+void *__memcpy_arm(void *dest, const void *src, size_t n);
+void *__memset_arm(void *s, int c, size_t n);
+void __memzero_arm(void *s, size_t n);
+void __memcpy_neon(void *dest, const void *src, size_t n);
+void __memset_neon(void *s, int c, size_t n);
+
+#endif /* __ASSEMBLY__ */
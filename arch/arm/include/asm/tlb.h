@@ -29,6 +29,7 @@
 
 #else /* !CONFIG_MMU */
 
+#include <linux/rcupdate.h>
 #include <linux/swap.h>
 #include <asm/pgalloc.h>
 #include <asm/tlbflush.h>
@@ -194,10 +195,24 @@ static inline void tlb_remove_page(struct mmu_gather *tlb, struct page *page)
 		tlb_flush_mmu(tlb);
 }
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+extern void pte_free_rcu(struct rcu_head *head);
+#endif
+
 static inline void __pte_free_tlb(struct mmu_gather *tlb, pgtable_t pte,
 	unsigned long addr)
 {
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	/*
+	 * handle_speculative_fault() walks to and locks the pte page under
+	 * rcu_read_lock() only: keep the page and its ptl around for a
+	 * grace period as well as until the TLB flush drops its reference.
+	 */
+	get_page(pte);
+	call_rcu((struct rcu_head *)&pte->lru, pte_free_rcu);
+#else
 	pgtable_page_dtor(pte);
+#endif
 
 	/*
 	 * With the classic ARM MMU, a pte page has two corresponding pmd
@@ -0,0 +1,70 @@
+#ifndef __ASM_ARM_WORD_AT_A_TIME_H
+#define __ASM_ARM_WORD_AT_A_TIME_H
+
+/*
+ * Little-endian word-at-a-time zero byte handling, as on x86, for the
+ * dcache name hashing in fs/namei.c. has_zero() and REPEAT_BYTE() are
+ * endian neutral and also used by the string functions in arch/arm/lib.
+ */
+
+#include <linux/bitops.h>
+
+#define REPEAT_BYTE(x)	((~0ul / 0xff) * (x))
+
+/* Return the high bit set in the first byte that is a zero */
+static inline unsigned long has_zero(unsigned long a)
+{
+	return ((a - REPEAT_BYTE(0x01)) & ~a) & REPEAT_BYTE(0x80);
+}
+
+#ifndef __ARMEB__
+
+/* (000000 0000ff 00ffff ffffff) -> ( 0 1 2 3 ) */
+static inline long count_masked_bytes(unsigned long mask)
+{
+#if __LINUX_ARM_ARCH__ >= 5
+	return fls(mask) >> 3;
+#else
+	/* Carl Chatfield / Jan Achrenius G+ version for 32-bit */
+	long a = (0x0ff0001 + mask) >> 23;
+	/* Fix the 1 for 00 case */
+	return a & mask;
+#endif
+}
+
+/*
+ * Load an unaligned word from kernel space.
+ *
+ * In the (very unlikely) case of the word being a page-crosser
+ * and the next page not being mapped, take the exception and
+ * return zeroes in the non-existing part.
+ */
+static inline unsigned long load_unaligned_zeropad(const void *addr)
+{
+	unsigned long ret, offset;
+
+	asm(
+	"1:	ldr	%0, [%2]\n"
+	"2:\n"
+	"	.pushsection .fixup,\"ax\"\n"
+	"	.align 2\n"
+	"3:	and	%1, %2, #0x3\n"
+	"	bic	%2, %2, #0x3\n"
+	"	ldr	%0, [%2]\n"
+	"	lsl	%1, %1, #0x3\n"
+	"	lsr	%0, %0, %1\n"
+	"	b	2b\n"
+	"	.popsection\n"
+	"	.pushsection __ex_table,\"a\"\n"
+	"	.align	3\n"
+	"	.long	1b, 3b\n"
+	"	.popsection"
+	: "=&r" (ret), "=&r" (offset)
+	: "r" (addr), "Qo" (*(unsigned long *)addr));
+
+	return ret;
+}
+
+#endif	/* __ARMEB__ */
+
+#endif /* __ASM_ARM_WORD_AT_A_TIME_H */
@@ -0,0 +1,123 @@
+/*
+ *  linux/arch/arm/lib/memops_neon.c
+ *
+ *  Large memcpy(), memset(), __memzero() and copy_page() through NEON
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ *  The assembly entry points branch here for blocks of at least
+ *  NEON_MEMOPS_MIN bytes. The NEON unit is only borrowed from process
+ *  context with interrupts enabled and outside of any other kernel mode
+ *  NEON section; anything else, and any tail shorter than 64 bytes,
+ *  goes to the integer code.
+ */
+#include <linux/export.h>
+#include <linux/hardirq.h>
+#include <linux/irqflags.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <asm/neon.h>
+#include <asm/page.h>
+
+/*
+ * Preemption is off while the NEON unit is held, so work in chunks to
+ * bound the scheduling latency added by a single huge call.
+ */
+#define NEON_MEMOPS_CHUNK	(16 * 1024)
+
+void *memcpy_neon_large(void *dest, const void *src, size_t n);
+void *memset_neon_large(void *s, int c, size_t n);
+void memzero_neon_large(void *s, size_t n);
+void copy_page_neon(void *to, const void *from);
+void __copy_page_arm(void *to, const void *from);
+
+static inline bool neon_memops_usable(void)
+{
+	return cpu_has_neon() && !in_interrupt() && !irqs_disabled() &&
+		!this_cpu_read(kernel_neon_busy);
+}
+
+/* Returns how much was filled, always a multiple of 64 */
+static size_t neon_fill(void *s, int c, size_t n)
+{
+	size_t done = 0;
+	size_t len;
+
+	while (n - done >= 64) {
+		len = min_t(size_t, n - done, NEON_MEMOPS_CHUNK) & ~63;
+		kernel_neon_begin();
+		__memset_neon(s + done, c, len);
+		kernel_neon_end();
+		done += len;
+	}
+	return done;
+}
+
+void *memcpy_neon_large(void *dest, const void *src, size_t n)
+{
+	size_t done = 0;
+	size_t len;
+
+	if (!neon_memops_usable())
+		return __memcpy_arm(dest, src, n);
+
+	while (n - done >= 64) {
+		len = min_t(size_t, n - done, NEON_MEMOPS_CHUNK) & ~63;
+		kernel_neon_begin();
+		__memcpy_neon(dest + done, src + done, len);
+		kernel_neon_end();
+		done += len;
+	}
+	if (n - done)
+		__memcpy_arm(dest + done, src + done, n - done);
+	return dest;
+}
+
+void *memset_neon_large(void *s, int c, size_t n)
+{
+	size_t done;
+
+	if (!neon_memops_usable())
+		return __memset_arm(s, c, n);
+
+	done = neon_fill(s, c, n);
+	if (n - done)
+		__memset_arm(s + done, c, n - done);
+	return s;
+}
+
+void memzero_neon_large(void *s, size_t n)
+{
+	size_t done;
+
+	if (!neon_memops_usable()) {
+		__memzero_arm(s, n);
+		return;
+	}
+
+	done = neon_fill(s, 0, n);
+	if (n - done)
+		__memzero_arm(s + done, n - done);
+}
+
+#ifndef CONFIG_HAS_MACH_MEMUTILS
+/* The mach memutils copy_page() is a memcpy() and gets NEON from there */
+void copy_page_neon(void *to, const void *from)
+{
+	if (!neon_memops_usable()) {
+		__copy_page_arm(to, from);
+		return;
+	}
+
+	kernel_neon_begin();
+	__memcpy_neon(to, from, PAGE_SIZE);
+	kernel_neon_end();
+}
+#endif
+
+/* For the benchmark in test-memops-neon.c */
+EXPORT_SYMBOL_GPL(__memcpy_arm);
+EXPORT_SYMBOL_GPL(__memset_arm);
+EXPORT_SYMBOL_GPL(__memzero_arm);
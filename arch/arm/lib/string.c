@@ -0,0 +1,79 @@
+/*
+ *  linux/arch/arm/lib/string.c
+ *
+ *  Word-at-a-time memchr(), strlen() and strnlen()
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ *  Only aligned words are read, so nothing past the end of the string
+ *  or buffer is touched outside the word that holds its last byte, and
+ *  no load can cross into another page. The word with the hit is then
+ *  scanned bytewise, which keeps this independent of endianness.
+ */
+#include <linux/string.h>
+#include <linux/types.h>
+#include <asm/word-at-a-time.h>
+
+#define WORD_MASK	(sizeof(unsigned long) - 1)
+
+void *memchr(const void *s, int c, size_t n)
+{
+	const unsigned char *p = s;
+	const unsigned long *w;
+	unsigned long pattern;
+
+	c &= 0xff;
+	for (; n && ((unsigned long)p & WORD_MASK); p++, n--)
+		if (*p == c)
+			return (void *)p;
+
+	pattern = REPEAT_BYTE(c);
+	w = (const unsigned long *)p;
+	for (; n >= sizeof(unsigned long); w++, n -= sizeof(unsigned long))
+		if (has_zero(*w ^ pattern))
+			break;
+
+	for (p = (const unsigned char *)w; n; p++, n--)
+		if (*p == c)
+			return (void *)p;
+	return NULL;
+}
+
+size_t strlen(const char *s)
+{
+	const char *p = s;
+	const unsigned long *w;
+
+	for (; (unsigned long)p & WORD_MASK; p++)
+		if (!*p)
+			return p - s;
+
+	for (w = (const unsigned long *)p; !has_zero(*w); w++)
+		;
+
+	for (p = (const char *)w; *p; p++)
+		;
+	return p - s;
+}
+
+size_t strnlen(const char *s, size_t count)
+{
+	const char *p = s;
+	const unsigned long *w;
+
+	for (; count && ((unsigned long)p & WORD_MASK); p++, count--)
+		if (!*p)
+			return p - s;
+
+	w = (const unsigned long *)p;
+	for (; count >= sizeof(unsigned long);
+	     w++, count -= sizeof(unsigned long))
+		if (has_zero(*w))
+			break;
+
+	for (p = (const char *)w; count && *p; p++, count--)
+		;
+	return p - s;
+}
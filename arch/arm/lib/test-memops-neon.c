@@ -0,0 +1,166 @@
+/*
+ *  linux/arch/arm/lib/test-memops-neon.c
+ *
+ *  Time the NEON string op paths against the integer ones
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ *  Load the module to get one line per operation and size with the cpu
+ *  cycles per call of the integer code and of the public entry point
+ *  (which takes the NEON path for large blocks), as well as bytes per
+ *  cycle x100. The module refuses to stay loaded once done.
+ */
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/perf_event.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <asm/neon.h>
+#include <asm/page.h>
+
+#define BENCH_MAX	(64 * 1024)
+#define BENCH_LOOPS	64
+
+enum bench_op {
+	BENCH_MEMCPY,
+	BENCH_MEMSET,
+	BENCH_MEMZERO,
+	BENCH_COPY_PAGE,
+};
+
+static const char * const bench_names[] = {
+	[BENCH_MEMCPY]		= "memcpy",
+	[BENCH_MEMSET]		= "memset",
+	[BENCH_MEMZERO]		= "memzero",
+	[BENCH_COPY_PAGE]	= "copy_page",
+};
+
+static const size_t bench_sizes[] __initconst = {
+	256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536,
+};
+
+static struct perf_event *cycles;
+static void *bench_src, *bench_dst;
+
+static u64 __init bench_now(void)
+{
+	u64 enabled, running;
+
+	if (cycles)
+		return perf_event_read_value(cycles, &enabled, &running);
+	/* No cycle counter: report nanoseconds instead */
+	return ktime_to_ns(ktime_get());
+}
+
+static void __init bench_one(enum bench_op op, bool neon, size_t n)
+{
+	switch (op) {
+	case BENCH_MEMCPY:
+		if (neon)
+			memcpy(bench_dst, bench_src, n);
+		else
+			__memcpy_arm(bench_dst, bench_src, n);
+		break;
+	case BENCH_MEMSET:
+		if (neon)
+			memset(bench_dst, 0x5a, n);
+		else
+			__memset_arm(bench_dst, 0x5a, n);
+		break;
+	case BENCH_MEMZERO:
+		if (neon)
+			__memzero(bench_dst, n);
+		else
+			__memzero_arm(bench_dst, n);
+		break;
+	case BENCH_COPY_PAGE:
+		/* The integer copy_page() isn't exported, compare with memcpy */
+		if (neon)
+			copy_page(bench_dst, bench_src);
+		else
+			__memcpy_arm(bench_dst, bench_src, PAGE_SIZE);
+		break;
+	}
+}
+
+static u64 __init bench_run(enum bench_op op, bool neon, size_t n)
+{
+	u64 start;
+	int i;
+
+	/* Warm the caches and TLB first */
+	bench_one(op, neon, n);
+
+	start = bench_now();
+	for (i = 0; i < BENCH_LOOPS; i++)
+		bench_one(op, neon, n);
+	return div_u64(bench_now() - start, BENCH_LOOPS);
+}
+
+static void __init bench_report(enum bench_op op, size_t n)
+{
+	u64 arm = bench_run(op, false, n);
+	u64 neon = bench_run(op, true, n);
+
+	pr_info("%-9s %6zu: arm %8llu neon %8llu %s, bytes/%s x100 arm %llu neon %llu\n",
+		bench_names[op], n, arm, neon, cycles ? "cycles" : "ns",
+		cycles ? "cycle" : "ns",
+		arm ? div64_u64(n * 100ULL, arm) : 0,
+		neon ? div64_u64(n * 100ULL, neon) : 0);
+}
+
+static int __init test_memops_neon_init(void)
+{
+	struct perf_event_attr attr = {
+		.type		= PERF_TYPE_HARDWARE,
+		.config		= PERF_COUNT_HW_CPU_CYCLES,
+		.size		= sizeof(attr),
+		.exclude_user	= 1,
+	};
+	int ret = -ENOMEM;
+	int i;
+
+	if (!cpu_has_neon()) {
+		pr_info("test_memops_neon: no NEON on this cpu\n");
+		return -ENODEV;
+	}
+
+	bench_src = kmalloc(BENCH_MAX, GFP_KERNEL);
+	bench_dst = kmalloc(BENCH_MAX, GFP_KERNEL);
+	if (!bench_src || !bench_dst)
+		goto out;
+	memset(bench_src, 0xa5, BENCH_MAX);
+
+	cycles = perf_event_create_kernel_counter(&attr, -1, current,
+						  NULL, NULL);
+	if (IS_ERR(cycles)) {
+		pr_info("test_memops_neon: no cycle counter (%ld), timing in ns\n",
+			PTR_ERR(cycles));
+		cycles = NULL;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		bench_report(BENCH_MEMCPY, bench_sizes[i]);
+		bench_report(BENCH_MEMSET, bench_sizes[i]);
+		bench_report(BENCH_MEMZERO, bench_sizes[i]);
+	}
+	bench_report(BENCH_COPY_PAGE, PAGE_SIZE);
+
+	if (cycles)
+		perf_event_release_kernel(cycles);
+	ret = -EAGAIN;
+out:
+	kfree(bench_dst);
+	kfree(bench_src);
+	return ret;
+}
+module_init(test_memops_neon_init);
+
+MODULE_DESCRIPTION("NEON memcpy/memset/copy_page benchmark");
+MODULE_LICENSE("GPL");
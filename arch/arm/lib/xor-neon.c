@@ -0,0 +1,102 @@
+/*
+ *  linux/arch/arm/lib/xor-neon.c
+ *
+ *  xor_blocks() inner loops using NEON
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ *  Built with -mfpu=neon, so these only run through the xor_block_neon
+ *  wrappers in asm/xor.h, which hold the NEON unit around each call.
+ *  Buffers are a multiple of 32 bytes, as for the other templates.
+ */
+#include <linux/module.h>
+#include <linux/raid/xor.h>
+#include <arm_neon.h>
+
+MODULE_LICENSE("GPL");
+
+#define LD(p, i)	vld1q_u32((const uint32_t *)(p) + 4 * (i))
+#define ST(p, i, v)	vst1q_u32((uint32_t *)(p) + 4 * (i), v)
+#define X(a, b)		veorq_u32(a, b)
+
+/* unsigned longs per 64 byte line */
+#define LINE		(64 / sizeof(unsigned long))
+
+static void xor_neon_2(unsigned long bytes, unsigned long *p1,
+		       unsigned long *p2)
+{
+	for (; bytes >= 64; bytes -= 64, p1 += LINE, p2 += LINE) {
+		ST(p1, 0, X(LD(p1, 0), LD(p2, 0)));
+		ST(p1, 1, X(LD(p1, 1), LD(p2, 1)));
+		ST(p1, 2, X(LD(p1, 2), LD(p2, 2)));
+		ST(p1, 3, X(LD(p1, 3), LD(p2, 3)));
+	}
+	if (bytes) {
+		ST(p1, 0, X(LD(p1, 0), LD(p2, 0)));
+		ST(p1, 1, X(LD(p1, 1), LD(p2, 1)));
+	}
+}
+
+static void xor_neon_3(unsigned long bytes, unsigned long *p1,
+		       unsigned long *p2, unsigned long *p3)
+{
+	for (; bytes >= 64; bytes -= 64, p1 += LINE, p2 += LINE, p3 += LINE) {
+		ST(p1, 0, X(X(LD(p1, 0), LD(p2, 0)), LD(p3, 0)));
+		ST(p1, 1, X(X(LD(p1, 1), LD(p2, 1)), LD(p3, 1)));
+		ST(p1, 2, X(X(LD(p1, 2), LD(p2, 2)), LD(p3, 2)));
+		ST(p1, 3, X(X(LD(p1, 3), LD(p2, 3)), LD(p3, 3)));
+	}
+	if (bytes) {
+		ST(p1, 0, X(X(LD(p1, 0), LD(p2, 0)), LD(p3, 0)));
+		ST(p1, 1, X(X(LD(p1, 1), LD(p2, 1)), LD(p3, 1)));
+	}
+}
+
+#define X4(i)	X(X(LD(p1, i), LD(p2, i)), X(LD(p3, i), LD(p4, i)))
+
+static void xor_neon_4(unsigned long bytes, unsigned long *p1,
+		       unsigned long *p2, unsigned long *p3,
+		       unsigned long *p4)
+{
+	for (; bytes >= 64; bytes -= 64,
+	     p1 += LINE, p2 += LINE, p3 += LINE, p4 += LINE) {
+		ST(p1, 0, X4(0));
+		ST(p1, 1, X4(1));
+		ST(p1, 2, X4(2));
+		ST(p1, 3, X4(3));
+	}
+	if (bytes) {
+		ST(p1, 0, X4(0));
+		ST(p1, 1, X4(1));
+	}
+}
+
+#define X5(i)	X(X4(i), LD(p5, i))
+
+static void xor_neon_5(unsigned long bytes, unsigned long *p1,
+		       unsigned long *p2, unsigned long *p3,
+		       unsigned long *p4, unsigned long *p5)
+{
+	for (; bytes >= 64; bytes -= 64,
+	     p1 += LINE, p2 += LINE, p3 += LINE, p4 += LINE, p5 += LINE) {
+		ST(p1, 0, X5(0));
+		ST(p1, 1, X5(1));
+		ST(p1, 2, X5(2));
+		ST(p1, 3, X5(3));
+	}
+	if (bytes) {
+		ST(p1, 0, X5(0));
+		ST(p1, 1, X5(1));
+	}
+}
+
+struct xor_block_template const xor_block_neon_inner = {
+	.name	= "__inner_neon__",
+	.do_2	= xor_neon_2,
+	.do_3	= xor_neon_3,
+	.do_4	= xor_neon_4,
+	.do_5	= xor_neon_5,
+};
+EXPORT_SYMBOL(xor_block_neon_inner);
@@ -25,6 +25,13 @@
 #include <linux/clk.h>
 #include <linux/platform_device.h>
 #include <linux/iopoll.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
 
 #include <mach/board.h>
 #include <mach/msm_iomap.h>
@@ -43,6 +50,12 @@
 static struct acpuclk_drv_data *priv;
 static uint32_t bus_perf_client;
 
+/* Raises vdd on another CPU while this one waits for ACPUPLL to lock */
+static struct workqueue_struct *acpuclk_vdd_wq;
+static struct clkctl_acpu_speed *vdd_up_speed;
+static int vdd_up_rc;
+static DECLARE_COMPLETION(vdd_up_done);
+
 /* Update the bus bandwidth request. */
 static void set_bus_bw(unsigned int bw)
 {
@@ -107,21 +120,28 @@ static void decrease_vdd(unsigned int vdd_cpu, unsigned int vdd_mem)
 		pr_err("vdd_mem decrease failed (%d)\n", ret);
 }
 
-static void select_clk_source_div(struct acpuclk_drv_data *drv_data,
+static u32 clk_source_cfg(struct acpuclk_drv_data *drv_data,
 	struct clkctl_acpu_speed *s)
 {
-	u32 regval, rc, src_div;
-	void __iomem *apcs_rcg_config = drv_data->apcs_rcg_config;
-	void __iomem *apcs_rcg_cmd = drv_data->apcs_rcg_cmd;
 	struct acpuclk_reg_data *r = &drv_data->reg_data;
+	u32 src_div;
 
 	src_div = s->src_div ? ((2 * s->src_div) - 1) : s->src_div;
 
+	return (s->src_sel << r->cfg_src_shift) |
+		(src_div << r->cfg_div_shift);
+}
+
+static void select_clk_source_cfg(struct acpuclk_drv_data *drv_data, u32 cfg)
+{
+	u32 regval, rc;
+	void __iomem *apcs_rcg_config = drv_data->apcs_rcg_config;
+	void __iomem *apcs_rcg_cmd = drv_data->apcs_rcg_cmd;
+	struct acpuclk_reg_data *r = &drv_data->reg_data;
+
 	regval = readl_relaxed(apcs_rcg_config);
-	regval &= ~r->cfg_src_mask;
-	regval |= s->src_sel << r->cfg_src_shift;
-	regval &= ~r->cfg_div_mask;
-	regval |= src_div << r->cfg_div_shift;
+	regval &= ~(r->cfg_src_mask | r->cfg_div_mask);
+	regval |= cfg;
 	writel_relaxed(regval, apcs_rcg_config);
 
 	/* Update the configuration */
@@ -138,6 +158,33 @@ static void select_clk_source_div(struct acpuclk_drv_data *drv_data,
 		pr_warn("acpu rcg didn't update its configuration\n");
 }
 
+static void select_clk_source_div(struct acpuclk_drv_data *drv_data,
+	struct clkctl_acpu_speed *s)
+{
+	select_clk_source_cfg(drv_data, clk_source_cfg(drv_data, s));
+}
+
+static void vdd_up_work_fn(struct work_struct *work)
+{
+	vdd_up_rc = increase_vdd(vdd_up_speed->vdd_cpu, vdd_up_speed->vdd_mem);
+	complete(&vdd_up_done);
+}
+static DECLARE_WORK(vdd_up_work, vdd_up_work_fn);
+
+/*
+ * Wait for a vdd ramp started by acpuclk_cortex_set_rate(), if there is
+ * one. Must be done before the CPU is switched to the target source.
+ */
+static int vdd_up_wait(bool *pending)
+{
+	if (!pending || !*pending)
+		return 0;
+
+	wait_for_completion(&vdd_up_done);
+	*pending = false;
+	return vdd_up_rc;
+}
+
 static int set_speed_atomic(struct clkctl_acpu_speed *tgt_s)
 {
 	struct clkctl_acpu_speed *strt_s = priv->current_speed;
@@ -157,7 +204,8 @@ static int set_speed_atomic(struct clkctl_acpu_speed *tgt_s)
 	return rc;
 }
 
-static int set_speed(struct clkctl_acpu_speed *tgt_s)
+static int set_speed(struct clkctl_acpu_speed *tgt_s, struct acpuclk_plan *p,
+		     bool *vdd_pending)
 {
 	int rc = 0;
 	unsigned int div = tgt_s->src_div ? tgt_s->src_div : 1;
@@ -167,7 +215,7 @@ static int set_speed(struct clkctl_acpu_speed *tgt_s)
 	struct clk *strt = priv->src_clocks[strt_s->src].clk;
 	struct clk *tgt = priv->src_clocks[tgt_s->src].clk;
 
-	if (strt_s->src == ACPUPLL && tgt_s->src == ACPUPLL) {
+	if (p->type == SWITCH_PLL_REPROG) {
 		/* Switch to another always on src */
 		select_clk_source_div(priv, cxo_s);
 
@@ -180,10 +228,21 @@ static int set_speed(struct clkctl_acpu_speed *tgt_s)
 
 		BUG_ON(clk_prepare_enable(tgt));
 
+		rc = vdd_up_wait(vdd_pending);
+		if (rc) {
+			/* Go back to where we were */
+			div = strt_s->src_div ? strt_s->src_div : 1;
+			clk_disable_unprepare(tgt);
+			clk_set_rate(tgt, strt_s->khz * 1000 * div);
+			BUG_ON(clk_prepare_enable(tgt));
+			select_clk_source_div(priv, strt_s);
+			return rc;
+		}
+
 		/* Switch back to acpu pll */
-		select_clk_source_div(priv, tgt_s);
+		select_clk_source_cfg(priv, p->cfg);
 
-	} else if (strt_s->src != ACPUPLL && tgt_s->src == ACPUPLL) {
+	} else if (p->type == SWITCH_TO_PLL) {
 		rc = clk_set_rate(tgt, tgt_freq_hz);
 		if (rc) {
 			pr_err("Failed to set ACPU PLL to %u\n", tgt_freq_hz);
@@ -197,7 +256,13 @@ static int set_speed(struct clkctl_acpu_speed *tgt_s)
 			return rc;
 		}
 
-		select_clk_source_div(priv, tgt_s);
+		rc = vdd_up_wait(vdd_pending);
+		if (rc) {
+			clk_disable_unprepare(tgt);
+			return rc;
+		}
+
+		select_clk_source_cfg(priv, p->cfg);
 
 		clk_disable_unprepare(strt);
 
@@ -210,7 +275,7 @@ static int set_speed(struct clkctl_acpu_speed *tgt_s)
 			return rc;
 		}
 
-		select_clk_source_div(priv, tgt_s);
+		select_clk_source_cfg(priv, p->cfg);
 
 		clk_disable_unprepare(strt);
 
@@ -219,11 +284,37 @@ static int set_speed(struct clkctl_acpu_speed *tgt_s)
 	return rc;
 }
 
+static void build_plan(struct clkctl_acpu_speed *strt_s,
+	struct clkctl_acpu_speed *tgt_s, struct acpuclk_plan *p)
+{
+	if (strt_s->src == ACPUPLL && tgt_s->src == ACPUPLL)
+		p->type = SWITCH_PLL_REPROG;
+	else if (tgt_s->src == ACPUPLL)
+		p->type = SWITCH_TO_PLL;
+	else
+		p->type = SWITCH_SRC;
+
+	/* Rails only move with the frequency, and only if the level differs */
+	p->vdd_up = tgt_s->khz > strt_s->khz &&
+		(tgt_s->vdd_cpu != strt_s->vdd_cpu ||
+		 tgt_s->vdd_mem != strt_s->vdd_mem);
+	p->vdd_down = tgt_s->khz < strt_s->khz &&
+		(tgt_s->vdd_cpu != strt_s->vdd_cpu ||
+		 tgt_s->vdd_mem != strt_s->vdd_mem);
+	p->bw_change = tgt_s->bw_level != strt_s->bw_level;
+	p->cfg = clk_source_cfg(priv, tgt_s);
+}
+
 static int acpuclk_cortex_set_rate(int cpu, unsigned long rate,
 				 enum setrate_reason reason)
 {
 	struct clkctl_acpu_speed *tgt_s, *strt_s;
-	int rc = 0;
+	struct acpuclk_plan *p, boot_plan = { 0 };
+	bool sleepable = reason == SETRATE_CPUFREQ || reason == SETRATE_INIT;
+	bool vdd_pending = false;
+	ktime_t start = ktime_get();
+	unsigned int us;
+	int rc = 0, ret;
 
 	if (reason == SETRATE_CPUFREQ)
 		mutex_lock(&priv->lock);
@@ -243,23 +334,49 @@ static int acpuclk_cortex_set_rate(int cpu, unsigned long rate,
 		goto out;
 	}
 
-	/* Increase VDD levels if needed */
-	if ((reason == SETRATE_CPUFREQ || reason == SETRATE_INIT)
-			&& (tgt_s->khz > strt_s->khz)) {
-		rc = increase_vdd(tgt_s->vdd_cpu, tgt_s->vdd_mem);
-		if (rc)
-			goto out;
+	if (priv->plans && strt_s >= priv->freq_tbl &&
+			strt_s < priv->freq_tbl + priv->nr_speeds) {
+		p = &priv->plans[(strt_s - priv->freq_tbl) * priv->nr_speeds +
+				 (tgt_s - priv->freq_tbl)];
+	} else {
+		/* Still on the placeholder speed set up by the board */
+		p = &boot_plan;
+		build_plan(strt_s, tgt_s, p);
+		p->bw_change = true;
+	}
+
+	/*
+	 * Increase VDD levels if needed. When ACPUPLL has to lock first,
+	 * ramp the rails from the workqueue in the meantime; set_speed()
+	 * waits for them before switching over.
+	 */
+	if (sleepable && p->vdd_up) {
+		if (p->type != SWITCH_SRC && acpuclk_vdd_wq) {
+			vdd_up_speed = tgt_s;
+			INIT_COMPLETION(vdd_up_done);
+			queue_work(acpuclk_vdd_wq, &vdd_up_work);
+			vdd_pending = true;
+		} else {
+			rc = increase_vdd(tgt_s->vdd_cpu, tgt_s->vdd_mem);
+			if (rc)
+				goto out;
+		}
 	}
 
 	pr_debug("Switching from CPU rate %u KHz -> %u KHz\n",
 		strt_s->khz, tgt_s->khz);
 
 	/* Switch CPU speed. Flag indicates atomic context */
-	if (reason == SETRATE_CPUFREQ || reason == SETRATE_INIT)
-		rc = set_speed(tgt_s);
+	if (sleepable)
+		rc = set_speed(tgt_s, p, &vdd_pending);
 	else
 		rc = set_speed_atomic(tgt_s);
 
+	/* set_speed() bailed out before it needed the new voltages */
+	ret = vdd_up_wait(&vdd_pending);
+	if (!rc)
+		rc = ret;
+
 	if (rc)
 		goto out;
 
@@ -268,15 +385,22 @@ static int acpuclk_cortex_set_rate(int cpu, unsigned long rate,
 
 	/* Nothing else to do for SWFI or power-collapse. */
 	if (reason == SETRATE_SWFI || reason == SETRATE_PC)
-		goto out;
+		goto out_stats;
 
 	/* Update bus bandwith request */
-	set_bus_bw(tgt_s->bw_level);
+	if (p->bw_change)
+		set_bus_bw(tgt_s->bw_level);
 
 	/* Drop VDD levels if we can. */
-	if (tgt_s->khz < strt_s->khz)
+	if (p->vdd_down)
 		decrease_vdd(tgt_s->vdd_cpu, tgt_s->vdd_mem);
 
+out_stats:
+	us = ktime_us_delta(ktime_get(), start);
+	p->count++;
+	p->total_us += us;
+	if (us > p->max_us)
+		p->max_us = us;
 out:
 	if (reason == SETRATE_CPUFREQ)
 		mutex_unlock(&priv->lock);
@@ -320,6 +444,74 @@ static void __init cpufreq_table_init(void)
 static void __init cpufreq_table_init(void) {}
 #endif
 
+static void __init plans_init(void)
+{
+	int i, j, n;
+
+	for (n = 0; priv->freq_tbl[n].khz != 0; n++)
+		;
+
+	priv->plans = kcalloc(n * n, sizeof(*priv->plans), GFP_KERNEL);
+	if (!priv->plans) {
+		pr_warn("no memory for transition plans\n");
+		return;
+	}
+	priv->nr_speeds = n;
+
+	for (i = 0; i < n; i++)
+		for (j = 0; j < n; j++)
+			build_plan(&priv->freq_tbl[i], &priv->freq_tbl[j],
+				   &priv->plans[i * n + j]);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int transitions_show(struct seq_file *m, void *unused)
+{
+	struct acpuclk_plan *p;
+	int i, j, n = priv->nr_speeds;
+
+	seq_printf(m, "%10s %10s %8s %8s %8s\n",
+		"from_khz", "to_khz", "count", "avg_us", "max_us");
+
+	mutex_lock(&priv->lock);
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < n; j++) {
+			p = &priv->plans[i * n + j];
+			if (!p->count)
+				continue;
+			seq_printf(m, "%10u %10u %8u %8llu %8u\n",
+				priv->freq_tbl[i].khz, priv->freq_tbl[j].khz,
+				p->count, div_u64(p->total_us, p->count),
+				p->max_us);
+		}
+	}
+	mutex_unlock(&priv->lock);
+
+	return 0;
+}
+
+static int transitions_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, transitions_show, inode->i_private);
+}
+
+static const struct file_operations transitions_fops = {
+	.open		= transitions_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init acpuclk_debugfs_init(void)
+{
+	if (priv->plans)
+		debugfs_create_file("acpuclk_transitions", S_IRUGO, NULL,
+				    NULL, &transitions_fops);
+}
+#else
+static inline void acpuclk_debugfs_init(void) { }
+#endif
+
 static struct acpuclk_data acpuclk_cortex_data = {
 	.set_rate = acpuclk_cortex_set_rate,
 	.get_rate = acpuclk_cortex_get_rate,
@@ -378,6 +570,12 @@ int __init acpuclk_cortex_init(struct platform_device *pdev,
 		BUG();
 	}
 
+	plans_init();
+
+	/* Not fatal: vdd is then raised before the PLL is touched */
+	acpuclk_vdd_wq = alloc_workqueue("acpuclk_vdd",
+					 WQ_UNBOUND | WQ_HIGHPRI, 1);
+
 	bus_perf_client = msm_bus_scale_register_client(priv->bus_scale);
 	if (!bus_perf_client) {
 		pr_err("Unable to register bus client\n");
@@ -418,6 +616,7 @@ int __init acpuclk_cortex_init(struct platform_device *pdev,
 
 	acpuclk_register(&acpuclk_cortex_data);
 	cpufreq_table_init();
+	acpuclk_debugfs_init();
 
 	return 0;
 
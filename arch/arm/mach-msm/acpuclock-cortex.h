@@ -42,6 +42,34 @@ struct clkctl_acpu_speed {
 	unsigned int bw_level;
 };
 
+enum acpuclk_switch {
+	SWITCH_SRC,		/* target source is already running */
+	SWITCH_TO_PLL,		/* lock ACPUPLL at the target rate first */
+	SWITCH_PLL_REPROG,	/* park on CXO while ACPUPLL is relocked */
+};
+
+/**
+ * struct acpuclk_plan - precomputed switch between two freq_tbl entries
+ * @type: how the source is switched, see enum acpuclk_switch
+ * @vdd_up: voltages must go up before running at the target
+ * @vdd_down: voltages can be lowered once at the target
+ * @bw_change: the target uses another bus bandwidth level
+ * @cfg: RCG source/divider bits of the target
+ * @count: number of times this switch was made
+ * @total_us: time spent in all of them
+ * @max_us: slowest one
+ */
+struct acpuclk_plan {
+	u8 type;
+	bool vdd_up;
+	bool vdd_down;
+	bool bw_change;
+	u32 cfg;
+	unsigned count;
+	u64 total_us;
+	unsigned max_us;
+};
+
 struct acpuclk_reg_data {
 	u32 cfg_src_mask;
 	u32 cfg_src_shift;
@@ -69,6 +97,8 @@ struct acpuclk_drv_data {
 	struct acpuclk_reg_data		reg_data;
 	unsigned long                   power_collapse_khz;
 	unsigned long                   wait_for_irq_khz;
+	struct acpuclk_plan		*plans;
+	int				nr_speeds;
 };
 
 struct bin_info {
@@ -27,6 +27,7 @@
 #include <linux/clk.h>
 #include <linux/wakelock.h>
 #include <linux/kfifo.h>
+#include <linux/ktime.h>
 #include <linux/of.h>
 #include <linux/srcu.h>
 #include <mach/msm_ipc_logging.h>
@@ -217,9 +218,31 @@ static void bam_mux_write_done(struct work_struct *work);
 static void handle_bam_mux_cmd(struct work_struct *work);
 static void rx_timer_work_func(struct work_struct *work);
 static void queue_rx_work_func(struct work_struct *work);
+static void rx_skb_refill_work_func(struct work_struct *work);
 
 static DECLARE_WORK(rx_timer_work, rx_timer_work_func);
 static DECLARE_WORK(queue_rx_work, queue_rx_work_func);
+static DECLARE_WORK(rx_skb_refill_work, rx_skb_refill_work_func);
+
+static int rx_skb_pool_target = DEFAULT_NUM_BUFFERS;
+module_param_named(rx_skb_pool, rx_skb_pool_target,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/*
+ * Spare rx skbs, kept ready so that refilling the rx pipe from the hot path
+ * does not have to go to the allocator for every descriptor.
+ */
+static struct sk_buff_head bam_rx_skb_pool;
+static ktime_t rx_skb_refill_requested;
+
+static struct {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t recycled;
+	uint32_t refills;
+	uint32_t refill_last_us;
+	uint32_t refill_max_us;
+} rx_skb_pool_stats;
 
 static struct workqueue_struct *bam_mux_rx_workqueue;
 static struct workqueue_struct *bam_mux_tx_workqueue;
@@ -385,6 +408,74 @@ static inline void verify_tx_queue_is_empty(const char *func)
 	spin_unlock_irqrestore(&bam_tx_pool_spinlock, flags);
 }
 
+static void rx_skb_pool_kick(void)
+{
+	if (skb_queue_len(&bam_rx_skb_pool) >= rx_skb_pool_target / 2)
+		return;
+
+	if (!work_pending(&rx_skb_refill_work)) {
+		rx_skb_refill_requested = ktime_get();
+		schedule_work(&rx_skb_refill_work);
+	}
+}
+
+/**
+ * rx_skb_get() - get an rx skb, from the spare pool if possible
+ * @alloc_flags: flags to allocate with when the pool is empty
+ */
+static struct sk_buff *rx_skb_get(gfp_t alloc_flags)
+{
+	struct sk_buff *skb;
+
+	skb = skb_dequeue(&bam_rx_skb_pool);
+	if (skb) {
+		++rx_skb_pool_stats.hits;
+	} else {
+		++rx_skb_pool_stats.misses;
+		skb = __dev_alloc_skb(BUFFER_SIZE, alloc_flags);
+	}
+	rx_skb_pool_kick();
+
+	return skb;
+}
+
+/**
+ * rx_skb_put() - free an rx skb that was not handed to a client
+ * @skb: unmapped skb
+ *
+ * The skb goes back to the spare pool if it is still usable as an rx
+ * buffer, otherwise it is freed.
+ */
+static void rx_skb_put(struct sk_buff *skb)
+{
+	if (skb_queue_len(&bam_rx_skb_pool) < rx_skb_pool_target &&
+			skb_recycle_check(skb, BUFFER_SIZE)) {
+		skb_queue_tail(&bam_rx_skb_pool, skb);
+		++rx_skb_pool_stats.recycled;
+		return;
+	}
+	dev_kfree_skb_any(skb);
+}
+
+static void rx_skb_refill_work_func(struct work_struct *work)
+{
+	struct sk_buff *skb;
+	uint32_t usecs;
+
+	while (skb_queue_len(&bam_rx_skb_pool) < rx_skb_pool_target) {
+		skb = __dev_alloc_skb(BUFFER_SIZE, GFP_KERNEL);
+		if (!skb)
+			break;
+		skb_queue_tail(&bam_rx_skb_pool, skb);
+	}
+
+	usecs = ktime_to_us(ktime_sub(ktime_get(), rx_skb_refill_requested));
+	++rx_skb_pool_stats.refills;
+	rx_skb_pool_stats.refill_last_us = usecs;
+	if (usecs > rx_skb_pool_stats.refill_max_us)
+		rx_skb_pool_stats.refill_max_us = usecs;
+}
+
 static void __queue_rx(gfp_t alloc_flags)
 {
 	void *ptr;
@@ -411,7 +502,7 @@ static void __queue_rx(gfp_t alloc_flags)
 
 		INIT_WORK(&info->work, handle_bam_mux_cmd);
 
-		info->skb = __dev_alloc_skb(BUFFER_SIZE, alloc_flags);
+		info->skb = rx_skb_get(alloc_flags);
 		if (info->skb == NULL) {
 			DMUX_LOG_KERR(
 				"%s: unable to alloc skb w/ flags %x, will retry later\n",
@@ -452,7 +543,7 @@ static void __queue_rx(gfp_t alloc_flags)
 	return;
 
 fail_skb:
-	dev_kfree_skb_any(info->skb);
+	rx_skb_put(info->skb);
 
 fail_info:
 	kfree(info);
@@ -505,7 +596,7 @@ static void bam_mux_process_data(struct sk_buff *rx_skb)
 			bam_ch[rx_hdr->ch_id].priv, BAM_DMUX_RECEIVE,
 							event_data);
 	else
-		dev_kfree_skb_any(rx_skb);
+		rx_skb_put(rx_skb);
 	spin_unlock_irqrestore(&bam_ch[rx_hdr->ch_id].lock, flags);
 
 	queue_rx();
@@ -561,7 +652,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			" pad %d ch %d len %d\n", __func__,
 			rx_hdr->magic_num, rx_hdr->reserved, rx_hdr->cmd,
 			rx_hdr->pad_len, rx_hdr->ch_id, rx_hdr->pkt_len);
-		dev_kfree_skb_any(rx_skb);
+		rx_skb_put(rx_skb);
 		queue_rx();
 		return;
 	}
@@ -572,7 +663,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			" pad %d ch %d len %d\n", __func__,
 			rx_hdr->ch_id, rx_hdr->reserved, rx_hdr->cmd,
 			rx_hdr->pad_len, rx_hdr->ch_id, rx_hdr->pkt_len);
-		dev_kfree_skb_any(rx_skb);
+		rx_skb_put(rx_skb);
 		queue_rx();
 		return;
 	}
@@ -591,7 +682,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 								__func__);
 			disconnect_ack = 0;
 		}
-		dev_kfree_skb_any(rx_skb);
+		rx_skb_put(rx_skb);
 		break;
 	case BAM_MUX_HDR_CMD_OPEN_NO_A2_PC:
 		BAM_DMUX_LOG("%s: opening cid %d PC disabled\n", __func__,
@@ -603,7 +694,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 		}
 
 		handle_bam_mux_cmd_open(rx_hdr);
-		dev_kfree_skb_any(rx_skb);
+		rx_skb_put(rx_skb);
 		break;
 	case BAM_MUX_HDR_CMD_CLOSE:
 		/* probably should drop pending write */
@@ -625,7 +716,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 		if (!bam_ch[rx_hdr->ch_id].pdev)
 			pr_err("%s: platform_device_alloc failed\n", __func__);
 		mutex_unlock(&bam_pdev_mutexlock);
-		dev_kfree_skb_any(rx_skb);
+		rx_skb_put(rx_skb);
 		queue_rx();
 		break;
 	default:
@@ -634,7 +725,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			__func__, rx_hdr->magic_num, rx_hdr->reserved,
 			rx_hdr->cmd, rx_hdr->pad_len, rx_hdr->ch_id,
 			rx_hdr->pkt_len);
-		dev_kfree_skb_any(rx_skb);
+		rx_skb_put(rx_skb);
 		queue_rx();
 		return;
 	}
@@ -1407,6 +1498,29 @@ static int debug_stats(char *buf, int max)
 	return i;
 }
 
+static int debug_rx_pool(char *buf, int max)
+{
+	uint32_t lookups = rx_skb_pool_stats.hits + rx_skb_pool_stats.misses;
+
+	return scnprintf(buf, max,
+			"spare skbs:      %u/%d\n"
+			"hits:            %u\n"
+			"misses:          %u\n"
+			"hit rate:        %u%%\n"
+			"recycled:        %u\n"
+			"refills:         %u\n"
+			"refill last us:  %u\n"
+			"refill max us:   %u\n",
+			skb_queue_len(&bam_rx_skb_pool), rx_skb_pool_target,
+			rx_skb_pool_stats.hits,
+			rx_skb_pool_stats.misses,
+			lookups ? rx_skb_pool_stats.hits * 100 / lookups : 0,
+			rx_skb_pool_stats.recycled,
+			rx_skb_pool_stats.refills,
+			rx_skb_pool_stats.refill_last_us,
+			rx_skb_pool_stats.refill_max_us);
+}
+
 #define DEBUG_BUFMAX 4096
 static char debug_buffer[DEBUG_BUFMAX];
 
@@ -1877,7 +1991,7 @@ static void disconnect_to_bam(void)
 		info = container_of(node, struct rx_pkt_info, list_node);
 		dma_unmap_single(NULL, info->dma_address, BUFFER_SIZE,
 							bam_ops->dma_from);
-		dev_kfree_skb_any(info->skb);
+		rx_skb_put(info->skb);
 		kfree(info);
 	}
 	bam_rx_pool_len = 0;
@@ -2589,9 +2703,12 @@ static int __init bam_dmux_init(void)
 		debug_create("tbl", 0444, dent, debug_tbl);
 		debug_create("ul_pkt_cnt", 0444, dent, debug_ul_pkt_cnt);
 		debug_create("stats", 0444, dent, debug_stats);
+		debug_create("rx_pool", 0444, dent, debug_rx_pool);
 	}
 #endif
 
+	skb_queue_head_init(&bam_rx_skb_pool);
+
 	bam_ipc_log_txt = ipc_log_context_create(BAM_IPC_LOG_PAGES, "bam_dmux");
 	if (!bam_ipc_log_txt) {
 		pr_err("%s : unable to create IPC Logging Context", __func__);
@@ -337,3 +337,87 @@ int interpolate_pc(struct pc_temp_ocv_lut *pc_temp_ocv,
 							ocv, batt_temp);
 	return 100;
 }
+
+static void fill_ocv_temp_cache(struct pc_temp_ocv_lut *pc_temp_ocv,
+				struct ocv_temp_cache *cache, int batt_temp)
+{
+	int i, row, temp;
+	int rows = pc_temp_ocv->rows;
+	int cols = pc_temp_ocv->cols;
+
+	temp = batt_temp;
+	if (temp < pc_temp_ocv->temp[0] * DEGC_SCALE)
+		temp = pc_temp_ocv->temp[0] * DEGC_SCALE;
+	if (temp > pc_temp_ocv->temp[cols - 1] * DEGC_SCALE)
+		temp = pc_temp_ocv->temp[cols - 1] * DEGC_SCALE;
+
+	for (i = 0; i < cols; i++)
+		if (temp <= pc_temp_ocv->temp[i] * DEGC_SCALE)
+			break;
+
+	for (row = 0; row < rows; row++) {
+		if (temp == pc_temp_ocv->temp[i] * DEGC_SCALE) {
+			cache->ocv[row] = pc_temp_ocv->ocv[row][i];
+			continue;
+		}
+		cache->ocv[row] = linear_interpolate(
+				pc_temp_ocv->ocv[row][i - 1],
+				pc_temp_ocv->temp[i - 1] * DEGC_SCALE,
+				pc_temp_ocv->ocv[row][i],
+				pc_temp_ocv->temp[i] * DEGC_SCALE,
+				temp);
+	}
+	cache->batt_temp = batt_temp;
+	cache->valid = 1;
+}
+
+/*
+ * Same as interpolate_ocv(), but the temperature interpolation of the lut
+ * is done once per temperature and kept in @cache, so that repeated
+ * lookups at the same temperature (the unusable charge search makes a
+ * hundred of them per soc calculation) only interpolate along pc.
+ */
+int interpolate_ocv_cached(struct pc_temp_ocv_lut *pc_temp_ocv,
+				struct ocv_temp_cache *cache,
+				int batt_temp, int pc)
+{
+	int i, rows;
+	int row1 = 0;
+	int row2 = 0;
+
+	if (!cache->valid || cache->batt_temp != batt_temp) {
+		fill_ocv_temp_cache(pc_temp_ocv, cache, batt_temp);
+		cache->misses++;
+	} else {
+		cache->hits++;
+	}
+
+	rows = pc_temp_ocv->rows;
+	if (pc >= pc_temp_ocv->percent[0]) {
+		row1 = 0;
+		row2 = 0;
+	} else if (pc <= pc_temp_ocv->percent[rows - 1]) {
+		row1 = rows - 1;
+		row2 = rows - 1;
+	} else {
+		for (i = 1; i < rows; i++) {
+			if (pc == pc_temp_ocv->percent[i]) {
+				row1 = i;
+				row2 = i;
+				break;
+			}
+			if (pc > pc_temp_ocv->percent[i]) {
+				row1 = i - 1;
+				row2 = i;
+				break;
+			}
+		}
+	}
+
+	return linear_interpolate(
+			cache->ocv[row1],
+			pc_temp_ocv->percent[row1],
+			cache->ocv[row2],
+			pc_temp_ocv->percent[row2],
+			pc);
+}
@@ -23,6 +23,7 @@
 #include <linux/sched.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
+#include <linux/boot_timeline.h>
 #include <mach/msm_iomap.h>
 
 #include "boot_stats.h"
@@ -94,6 +95,8 @@ int boot_stats_init(void)
 		return -ENODEV;
 
 	print_boot_stats();
+	boot_timeline_set_base(div_u64((u64)__raw_readl(mpm_counter_base) *
+				       NSEC_PER_SEC, mpm_counter_freq));
 
 	return 0;
 }
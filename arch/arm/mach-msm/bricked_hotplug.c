@@ -26,6 +26,7 @@
 #ifdef CONFIG_STATE_NOTIFIER
 #include <linux/state_notifier.h>
 #endif
+#include <mach/hotplug_core.h>
 
 #define DEBUG 0
 
@@ -49,8 +50,8 @@ enum {
 };
 
 static struct notifier_block notif;
-static struct delayed_work hotplug_work;
 static struct workqueue_struct *hotplug_wq;
+static struct hotplug_policy bricked_policy;
 
 static struct cpu_hotplug {
 	unsigned int startdelay;
@@ -79,7 +80,6 @@ static struct cpu_hotplug {
 	.idle_freq = MSM_MPDEC_IDLE_FREQ,
 	.max_cpus_online = DEFAULT_MAX_CPUS_ONLINE,
 	.min_cpus_online = DEFAULT_MIN_CPUS_ONLINE,
-	.bricked_enabled = HOTPLUG_ENABLED,
 };
 
 static unsigned int NwNs_Threshold[8] = {12, 0, 20, 7, 25, 10, 0, 18};
@@ -97,7 +97,8 @@ static void apply_down_lock(unsigned int cpu)
 
 	dl->locked = 1;
 	queue_delayed_work_on(0, hotplug_wq, &dl->lock_rem,
-			      msecs_to_jiffies(hotplug.down_lock_dur));
+			      msecs_to_jiffies(hotplug.down_lock_dur +
+					       hotplug_core_cycle_ms(cpu)));
 }
 
 static void remove_down_lock(struct work_struct *work)
@@ -113,8 +114,6 @@ static int check_down_lock(unsigned int cpu)
 	return dl->locked;
 }
 
-extern unsigned int get_rq_info(void);
-
 unsigned int state = MSM_MPDEC_DISABLED;
 
 static int get_slowest_cpu(void) {
@@ -145,7 +144,7 @@ static unsigned int get_slowest_cpu_rate(void) {
 	return slow_rate;
 }
 
-static int mp_decision(void) {
+static int mp_decision(const struct hotplug_sample *s) {
 	static bool first_call = true;
 	int new_state = MSM_MPDEC_IDLE;
 	int nr_cpu_online;
@@ -168,8 +167,8 @@ static int mp_decision(void) {
 	}
 	total_time += this_time;
 
-	rq_depth = get_rq_info();
-	nr_cpu_online = num_online_cpus();
+	rq_depth = s->rq_avg;
+	nr_cpu_online = s->online;
 
 	index = (nr_cpu_online - 1) * 2;
 	if ((nr_cpu_online < DEFAULT_MAX_CPUS_ONLINE) && (rq_depth >= NwNs_Threshold[index])) {
@@ -203,33 +202,31 @@ static int mp_decision(void) {
 	return new_state;
 }
 
-static void __ref bricked_hotplug_work(struct work_struct *work) {
+static void bricked_hotplug_sample(const struct hotplug_sample *s) {
 	unsigned int cpu;
 
 	if (hotplug.suspended && hotplug.max_cpus_online_susp <= 1)
-		goto out;
+		return;
 
 	if (!mutex_trylock(&hotplug.bricked_cpu_mutex))
-		goto out;
+		return;
 
-	state = mp_decision();
+	state = mp_decision(s);
 	switch (state) {
 	case MSM_MPDEC_DISABLED:
 	case MSM_MPDEC_IDLE:
 		break;
 	case MSM_MPDEC_DOWN:
 		cpu = get_slowest_cpu();
-		if (cpu > 0) {
-				cpu_down(cpu);
-		}
+		if (cpu > 0)
+			hotplug_core_request_down(&bricked_policy, cpu);
 		break;
 	case MSM_MPDEC_UP:
 		cpu = cpumask_next_zero(0, cpu_online_mask);
 		if (cpu < DEFAULT_MAX_CPUS_ONLINE) {
-			if (!cpu_online(cpu)) {
-				cpu_up(cpu);
+			if (!cpu_online(cpu) &&
+			    !hotplug_core_request_up(&bricked_policy, cpu))
 				apply_down_lock(cpu);
-			}
 		}
 		break;
 	default:
@@ -237,12 +234,6 @@ static void __ref bricked_hotplug_work(struct work_struct *work) {
 			__func__, state);
 	}
 	mutex_unlock(&hotplug.bricked_cpu_mutex);
-
-out:
-	if (hotplug.bricked_enabled)
-		queue_delayed_work(hotplug_wq, &hotplug_work,
-					msecs_to_jiffies(hotplug.delay));
-	return;
 }
 
 static void bricked_hotplug_suspend(void)
@@ -263,18 +254,18 @@ static void bricked_hotplug_suspend(void)
 	}
 
 	/* main work thread can sleep now */
-	cancel_delayed_work_sync(&hotplug_work);
+	hotplug_core_cancel(&bricked_policy);
 
 	for_each_possible_cpu(cpu) {
 		if ((cpu >= 1) && (cpu_online(cpu)))
-			cpu_down(cpu);
+			hotplug_core_cpu_down(&bricked_policy, cpu);
 	}
 
 	pr_info(MPDEC_TAG": Screen -> off. Deactivated bricked hotplug. | Mask=[%d%d%d%d]\n",
 			cpu_online(0), cpu_online(1), cpu_online(2), cpu_online(3));
 }
 
-static void __ref bricked_hotplug_resume(void)
+static void bricked_hotplug_resume(void)
 {
 	int cpu, required_reschedule = 0, required_wakeup = 0;
 
@@ -286,23 +277,21 @@ static void __ref bricked_hotplug_resume(void)
 		mutex_unlock(&hotplug.bricked_hotplug_mutex);
 		required_wakeup = 1;
 		/* Initiate hotplug work if it was cancelled */
-		if (hotplug.max_cpus_online_susp <= 1) {
+		if (hotplug.max_cpus_online_susp <= 1)
 			required_reschedule = 1;
-			INIT_DELAYED_WORK(&hotplug_work, bricked_hotplug_work);
-		}
 
 		/* Fire up all CPUs */
 		for_each_cpu_not(cpu, cpu_online_mask) {
 			if (cpu == 0)
 				continue;
-			cpu_up(cpu);
-			apply_down_lock(cpu);
+			if (!hotplug_core_cpu_up(&bricked_policy, cpu))
+				apply_down_lock(cpu);
 		}
 	}
 
-	/* Resume hotplug workqueue if required */
+	/* Resume hotplug sampling if required */
 	if (required_reschedule) {
-		queue_delayed_work(hotplug_wq, &hotplug_work, 0);
+		hotplug_core_schedule(&bricked_policy, 0);
 		pr_info(MPDEC_TAG": Screen -> on. Activated bricked hotplug. | Mask=[%d%d%d%d]\n",
 				cpu_online(0), cpu_online(1), cpu_online(2), cpu_online(3));
 	}
@@ -346,6 +335,7 @@ static int bricked_hotplug_start(void)
 	if (state_register_client(&notif)) {
 		pr_err("%s: Failed to register State notifier callback\n",
 			MPDEC_TAG);
+		ret = -EINVAL;
 		goto err_dev;
 	}
 #endif
@@ -353,16 +343,14 @@ static int bricked_hotplug_start(void)
 	mutex_init(&hotplug.bricked_cpu_mutex);
 	mutex_init(&hotplug.bricked_hotplug_mutex);
 
-	INIT_DELAYED_WORK(&hotplug_work, bricked_hotplug_work);
-
 	for_each_possible_cpu(cpu) {
 		dl = &per_cpu(lock_info, cpu);
 		INIT_DELAYED_WORK(&dl->lock_rem, remove_down_lock);
 	}
 
-	if (hotplug.bricked_enabled)
-		queue_delayed_work(hotplug_wq, &hotplug_work,
-					msecs_to_jiffies(hotplug.startdelay));
+	hotplug.bricked_enabled = 1;
+	state = MSM_MPDEC_IDLE;
+	hotplug_core_schedule(&bricked_policy, hotplug.startdelay);
 
 	return ret;
 err_dev:
@@ -382,7 +370,6 @@ static void bricked_hotplug_stop(void)
 		cancel_delayed_work_sync(&dl->lock_rem);
 	}
 
-	cancel_delayed_work_sync(&hotplug_work);
 	mutex_destroy(&hotplug.bricked_hotplug_mutex);
 	mutex_destroy(&hotplug.bricked_cpu_mutex);
 #ifdef CONFIG_STATE_NOTIFIER
@@ -395,10 +382,21 @@ static void bricked_hotplug_stop(void)
 	for_each_online_cpu(cpu) {
 		if (cpu == 0)
 			continue;
-		cpu_down(cpu);
+		hotplug_core_cpu_down(&bricked_policy, cpu);
 	}
+
+	state = MSM_MPDEC_DISABLED;
+	hotplug.bricked_enabled = 0;
 }
 
+static struct hotplug_policy bricked_policy = {
+	.name = MPDEC_TAG,
+	.start = bricked_hotplug_start,
+	.stop = bricked_hotplug_stop,
+	.sample = bricked_hotplug_sample,
+	.sample_ms = &hotplug.delay,
+};
+
 /**************************** SYSFS START ****************************/
 
 #define show_one(file_name, object)					\
@@ -544,7 +542,7 @@ static ssize_t store_idle_freq(struct device *dev,
 	return count;
 }
 
-static ssize_t __ref store_min_cpus_online(struct device *dev,
+static ssize_t store_min_cpus_online(struct device *dev,
 				struct device_attribute *bricked_hotplug_attrs,
 				const char *buf, size_t count)
 {
@@ -568,7 +566,7 @@ static ssize_t __ref store_min_cpus_online(struct device *dev,
 				break;
 			if (cpu_online(cpu))
 				continue;
-			cpu_up(cpu);
+			hotplug_core_cpu_up(&bricked_policy, cpu);
 		}
 		pr_info(MPDEC_TAG": min_cpus_online set to %u. Affected CPUs were hotplugged!\n", input);
 	}
@@ -600,7 +598,7 @@ static ssize_t store_max_cpus_online(struct device *dev,
 				break;
 			if (!cpu_online(cpu))
 				continue;
-			cpu_down(cpu);
+			hotplug_core_cpu_down(&bricked_policy, cpu);
 		}
 		pr_info(MPDEC_TAG": max_cpus set to %u. Affected CPUs were unplugged!\n", input);
 	}
@@ -655,17 +653,11 @@ static ssize_t store_bricked_enabled(struct device *dev,
 	if (input == hotplug.bricked_enabled)
 		return count;
 
-	hotplug.bricked_enabled = input;
+	ret = hotplug_core_enable(&bricked_policy, input);
+	if (ret)
+		return ret;
 
-	if (!hotplug.bricked_enabled) {
-		state = MSM_MPDEC_DISABLED;
-		bricked_hotplug_stop();
-		pr_info(MPDEC_TAG": Disabled\n");
-	} else {
-		state = MSM_MPDEC_IDLE;
-		bricked_hotplug_start();
-		pr_info(MPDEC_TAG": Enabled\n");
-	}
+	pr_info(MPDEC_TAG": %s\n", input ? "Enabled" : "Disabled");
 
 	return count;
 }
@@ -738,11 +730,9 @@ static int bricked_hotplug_probe(struct platform_device *pdev)
 		goto err_dev;
 	}
 
-	if (hotplug.bricked_enabled) {
-		ret = bricked_hotplug_start();
-		if (ret != 0)
-			goto err_dev;
-	}
+	ret = hotplug_core_register(&bricked_policy, HOTPLUG_ENABLED);
+	if (ret != 0)
+		goto err_dev;
 
 	return ret;
 err_dev:
@@ -758,8 +748,7 @@ static struct platform_device bricked_hotplug_device = {
 
 static int bricked_hotplug_remove(struct platform_device *pdev)
 {
-	if (hotplug.bricked_enabled)
-		bricked_hotplug_stop();
+	hotplug_core_unregister(&bricked_policy);
 
 	return 0;
 }
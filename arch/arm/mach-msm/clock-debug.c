@@ -24,6 +24,7 @@
 #include <linux/uaccess.h>
 #include <linux/mutex.h>
 #include <linux/io.h>
+#include <linux/math64.h>
 
 #include <mach/clk-provider.h>
 
@@ -462,6 +463,34 @@ static const struct file_operations clock_print_hw_fops = {
 	.release	= seq_release,
 };
 
+static int rate_stats_show(struct seq_file *m, void *unused)
+{
+	struct clk *c = m->private;
+	struct clk_rate_stats st;
+
+	mutex_lock(&c->prepare_lock);
+	st = c->rate_stats;
+	mutex_unlock(&c->prepare_lock);
+
+	seq_printf(m, "count: %u\n", st.count);
+	seq_printf(m, "avg_us: %llu\n",
+		st.count ? div_u64(st.total_us, st.count) : 0);
+	seq_printf(m, "max_us: %u\n", st.max_us);
+
+	return 0;
+}
+
+static int rate_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rate_stats_show, inode->i_private);
+}
+
+static const struct file_operations rate_stats_fops = {
+	.open		= rate_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
 
 static int clock_debug_add(struct clk *clock)
 {
@@ -518,6 +547,10 @@ static int clock_debug_add(struct clk *clock)
 				&clock_print_hw_fops))
 			goto error;
 
+	if (clock->ops->set_rate && !debugfs_create_file("rate_stats",
+				S_IRUGO, clk_dir, clock, &rate_stats_fops))
+			goto error;
+
 	return 0;
 error:
 	debugfs_remove_recursive(clk_dir);
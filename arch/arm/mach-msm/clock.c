@@ -24,6 +24,7 @@
 #include <linux/list.h>
 #include <linux/regulator/consumer.h>
 #include <linux/mutex.h>
+#include <linux/ktime.h>
 #include <trace/events/power.h>
 #include <mach/clk-provider.h>
 #include "clock.h"
@@ -479,9 +480,22 @@ unsigned long clk_get_rate(struct clk *clk)
 }
 EXPORT_SYMBOL(clk_get_rate);
 
+/* Called with clk->prepare_lock held */
+static void clk_account_rate_change(struct clk *clk, ktime_t start)
+{
+	struct clk_rate_stats *st = &clk->rate_stats;
+	unsigned us = ktime_us_delta(ktime_get(), start);
+
+	st->count++;
+	st->total_us += us;
+	if (us > st->max_us)
+		st->max_us = us;
+}
+
 int clk_set_rate(struct clk *clk, unsigned long rate)
 {
 	unsigned long start_rate;
+	ktime_t start;
 	int rc = 0;
 	const char *name = clk ? clk->dbg_name : NULL;
 
@@ -502,6 +516,7 @@ int clk_set_rate(struct clk *clk, unsigned long rate)
 
 	trace_clock_set_rate(name, rate, raw_smp_processor_id());
 
+	start = ktime_get();
 	start_rate = clk->rate;
 
 	if (clk->ops->pre_set_rate)
@@ -528,6 +543,7 @@ int clk_set_rate(struct clk *clk, unsigned long rate)
 	if (clk->ops->post_set_rate)
 		clk->ops->post_set_rate(clk, start_rate);
 
+	clk_account_rate_change(clk, start);
 out:
 	mutex_unlock(&clk->prepare_lock);
 	return rc;
@@ -543,6 +559,119 @@ err_vote_vdd:
 }
 EXPORT_SYMBOL(clk_set_rate);
 
+static DEFINE_MUTEX(clk_set_rates_lock);
+
+/*
+ * Add (@dir = 1) or drop (@dir = -1) the transaction's hold on each
+ * request's voltage level, then re-aggregate each vdd class once.
+ */
+static int clk_set_rates_hold_vdd(struct clk_rate_req *reqs, int *levels,
+				  int n, int dir)
+{
+	struct clk_vdd_class *vdd;
+	int i, j, ret, rc = 0;
+
+	for (i = 0; i < n; i++) {
+		if (levels[i] < 0)
+			continue;
+		vdd = reqs[i].clk->vdd_class;
+		mutex_lock(&vdd->lock);
+		vdd->level_votes[levels[i]] += dir;
+		mutex_unlock(&vdd->lock);
+	}
+
+	for (i = 0; i < n; i++) {
+		if (levels[i] < 0)
+			continue;
+		vdd = reqs[i].clk->vdd_class;
+		for (j = 0; j < i; j++)
+			if (levels[j] >= 0 && reqs[j].clk->vdd_class == vdd)
+				break;
+		if (j < i)
+			continue;
+
+		mutex_lock(&vdd->lock);
+		ret = update_vdd(vdd);
+		mutex_unlock(&vdd->lock);
+		if (ret && !rc)
+			rc = ret;
+	}
+
+	return rc;
+}
+
+/**
+ * clk_set_rates() - change the rates of several clocks as one transaction
+ * @reqs: clocks and their new rates, applied in array order
+ * @n: number of entries in @reqs, at most CLK_SET_RATES_MAX
+ *
+ * Each vdd class is first raised to cover both the old and the new rate of
+ * every prepared clock in @reqs. The individual rate changes then find the
+ * voltage already in place, and the class is lowered to its final level
+ * once they are all done, instead of stepping up and down per clock.
+ *
+ * If a rate change fails, the clocks already changed are put back to their
+ * old rates in reverse order and the error is returned.
+ */
+int clk_set_rates(struct clk_rate_req *reqs, int n)
+{
+	unsigned long old_rate[CLK_SET_RATES_MAX];
+	int levels[CLK_SET_RATES_MAX];
+	struct clk *clk;
+	int i, level, rc;
+
+	if (n <= 0 || n > CLK_SET_RATES_MAX)
+		return -EINVAL;
+
+	for (i = 0; i < n; i++) {
+		clk = reqs[i].clk;
+		if (IS_ERR_OR_NULL(clk))
+			return -EINVAL;
+		if (!clk->ops->set_rate)
+			return -ENOSYS;
+		if (!is_rate_valid(clk, reqs[i].rate))
+			return -EINVAL;
+	}
+
+	mutex_lock(&clk_set_rates_lock);
+
+	for (i = 0; i < n; i++) {
+		clk = reqs[i].clk;
+		old_rate[i] = clk->rate;
+		levels[i] = -1;
+		/* A hold for an unprepared clock only costs some voltage */
+		if (!clk->vdd_class || !clk->prepare_count)
+			continue;
+		levels[i] = find_vdd_level(clk, reqs[i].rate);
+		level = find_vdd_level(clk, old_rate[i]);
+		if (level > levels[i])
+			levels[i] = level;
+	}
+
+	rc = clk_set_rates_hold_vdd(reqs, levels, n, 1);
+	if (rc)
+		goto out;
+
+	for (i = 0; i < n; i++) {
+		rc = clk_set_rate(reqs[i].clk, reqs[i].rate);
+		if (rc) {
+			pr_err("clk_set_rates: %s to %lu failed (%d)\n",
+				reqs[i].clk->dbg_name, reqs[i].rate, rc);
+			break;
+		}
+	}
+
+	if (rc)
+		while (i--)
+			clk_set_rate(reqs[i].clk, old_rate[i]);
+
+out:
+	clk_set_rates_hold_vdd(reqs, levels, n, -1);
+	mutex_unlock(&clk_set_rates_lock);
+	return rc;
+}
+EXPORT_SYMBOL(clk_set_rates);
+
 long clk_round_rate(struct clk *clk, unsigned long rate)
 {
 	long rrate;
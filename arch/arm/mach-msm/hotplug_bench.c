@@ -0,0 +1,788 @@
+/*
+ *  arch/arm/mach-msm/hotplug_bench.c
+ *
+ *  Runs synthetic loads against the active hotplug_core policy and
+ *  scores how much energy it spent and how long the load waited.
+ *
+ *  Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Select a load in debugfs hotplug_bench/workload, write "start" to
+ * hotplug_bench/control and read hotplug_bench/results once control
+ * reads "idle" again. The loads are:
+ *
+ *	touch	 two threads rendering 60 fps frames for 300 ms of
+ *		 every second, as while flinging a list
+ *	periodic one thread doing 2 ms of work every 50 ms, as a music
+ *		 player or a sync adapter
+ *	gaming	 one thread per possible cpu rendering 60 fps frames
+ *		 without a break
+ *	idle	 one thread doing 1 ms of work every 5 s, standing in for
+ *		 wakealarms on an otherwise idle device
+ *
+ * The load threads are not bound, so they wait in the run queues of
+ * whichever cpus the policy keeps online. Work is specified at fmax and
+ * takes proportionally longer at lower frequencies. Each thread records
+ * how late it woke up for its release time and whether the work was
+ * done before the next release.
+ *
+ * Every sample_ms a sampler accumulates the time spent with each number
+ * of cpus online, the frequency residency of the online cpus, the run
+ * queue depth and an energy estimate: core_mw for every online cpu, plus
+ * idle_mw while idle or a cubic frequency model reaching max_mw at fmax
+ * while busy. Offline cpus are assumed to draw nothing. The score is the
+ * average power plus lat_weight mW per millisecond of 95th percentile
+ * wakeup latency; lower is better.
+ */
+
+#define pr_fmt(fmt) "hotplug_bench: " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/hrtimer.h>
+#include <linux/kernel_stat.h>
+#include <linux/kthread.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/tick.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+#include <mach/hotplug_core.h>
+
+/* Busy loop granularity; preemption is off for one chunk at a time */
+#define BENCH_CHUNK_US		50
+#define BENCH_MAX_THREADS	16
+#define BENCH_MAX_FREQS		32
+/* Wakeup latency histogram, the last bucket takes everything above */
+#define BENCH_HIST_US		100
+#define BENCH_HIST		512
+
+struct bench_load {
+	const char *name;
+	unsigned int threads;	/* 0 for one per possible cpu */
+	unsigned int work_us;	/* per release, at fmax */
+	unsigned int period_us;
+	unsigned int burst_ms;	/* releases only in the first burst_ms */
+	unsigned int cycle_ms;	/* of every cycle_ms, 0 for always */
+};
+
+static const struct bench_load bench_loads[] = {
+	{ "touch",	2,  4000,   16666, 300, 1000 },
+	{ "periodic",	1,  2000,   50000,   0,    0 },
+	{ "gaming",	0, 10000,   16666,   0,    0 },
+	{ "idle",	1,  1000, 5000000,   0,    0 },
+};
+
+struct bench_cpu {
+	unsigned int freq;
+	unsigned int fmax;
+	bool online;
+	u64 idle_us;
+	u64 wall_us;
+	unsigned int up_count;
+	unsigned int down_count;
+	u64 up_us;
+	u64 down_us;
+};
+
+struct bench_freq {
+	unsigned int freq;
+	u64 us;
+};
+
+/* Results of the last run, protected by bench_lock */
+static struct bench_result {
+	u64 sampled_us;
+	u64 online_us[CONFIG_NR_CPUS + 1];
+	u64 online_sum;
+	struct bench_freq freqs[BENCH_MAX_FREQS];
+	unsigned int nr_freqs;
+	u64 rq_sum;
+	unsigned int rq_max;
+	u64 energy_nj;
+
+	unsigned int wakeups;
+	u64 lat_total_us;
+	unsigned int lat_max_us;
+	unsigned int hist[BENCH_HIST];
+	unsigned int done;
+	unsigned int missed;
+	unsigned int dropped;
+
+	unsigned int up_count;
+	unsigned int down_count;
+	u64 up_us;
+	u64 down_us;
+} bench;
+
+static DEFINE_SPINLOCK(bench_lock);
+static DEFINE_PER_CPU(struct bench_cpu, bench_cpu);
+static DEFINE_MUTEX(bench_mutex);
+static struct dentry *bench_dir;
+
+static const struct bench_load *bench_load = &bench_loads[0];
+static struct task_struct *bench_tasks[BENCH_MAX_THREADS];
+static unsigned int bench_nr_tasks;
+static char bench_policy[32];
+
+static atomic_t bench_running = ATOMIC_INIT(0);
+/* set from start until the sampler has taken its last sample */
+static bool bench_active;
+static ktime_t bench_start;
+static u64 bench_duration_us;
+
+static void bench_sample_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(bench_sample_work, bench_sample_fn);
+
+static unsigned int duration_ms = 10000;
+module_param(duration_ms, uint, 0644);
+
+static unsigned int sample_ms = 20;
+module_param(sample_ms, uint, 0644);
+
+/* Power model, per cpu */
+static unsigned int core_mw = 40;
+module_param(core_mw, uint, 0644);
+
+static unsigned int idle_mw = 10;
+module_param(idle_mw, uint, 0644);
+
+static unsigned int max_mw = 600;
+module_param(max_mw, uint, 0644);
+
+/* mW of average power one ms of p95 wakeup latency is worth */
+static unsigned int lat_weight = 100;
+module_param(lat_weight, uint, 0644);
+
+static u64 bench_elapsed_us(void)
+{
+	return ktime_us_delta(ktime_get(), bench_start);
+}
+
+/* Dynamic power while busy, growing with the cube of the frequency */
+static unsigned int bench_mw(unsigned int freq, unsigned int fmax)
+{
+	u64 mw = max_mw;
+
+	if (!fmax || freq >= fmax)
+		return max_mw;
+
+	mw *= freq;
+	do_div(mw, fmax);
+	mw *= freq;
+	do_div(mw, fmax);
+	mw *= freq;
+	do_div(mw, fmax);
+
+	return mw;
+}
+
+static u64 bench_idle_us(unsigned int cpu, u64 *wall)
+{
+	u64 idle = get_cpu_idle_time_us(cpu, wall);
+	u64 busy, now;
+
+	if (idle != -1ULL)
+		return idle + get_cpu_iowait_time_us(cpu, NULL);
+
+	/* no NO_HZ idle accounting, fall back to the tick based one */
+	now = get_jiffies_64();
+	busy  = kcpustat_cpu(cpu).cpustat[CPUTIME_USER];
+	busy += kcpustat_cpu(cpu).cpustat[CPUTIME_NICE];
+	busy += kcpustat_cpu(cpu).cpustat[CPUTIME_SYSTEM];
+	busy += kcpustat_cpu(cpu).cpustat[CPUTIME_IRQ];
+	busy += kcpustat_cpu(cpu).cpustat[CPUTIME_SOFTIRQ];
+	busy += kcpustat_cpu(cpu).cpustat[CPUTIME_STEAL];
+	*wall = jiffies_to_usecs(now);
+
+	return jiffies_to_usecs(now - cputime64_to_jiffies64(busy));
+}
+
+/* Called with bench_lock held */
+static void bench_add_freq(unsigned int freq, u64 us)
+{
+	unsigned int i;
+
+	for (i = 0; i < bench.nr_freqs; i++) {
+		if (bench.freqs[i].freq == freq) {
+			bench.freqs[i].us += us;
+			return;
+		}
+		if (bench.freqs[i].freq > freq)
+			break;
+	}
+
+	if (bench.nr_freqs == BENCH_MAX_FREQS)
+		return;
+
+	memmove(&bench.freqs[i + 1], &bench.freqs[i],
+		(bench.nr_freqs - i) * sizeof(bench.freqs[0]));
+	bench.freqs[i].freq = freq;
+	bench.freqs[i].us = us;
+	bench.nr_freqs++;
+}
+
+static void bench_cpu_online(struct bench_cpu *bc, unsigned int cpu)
+{
+	bc->freq = cpufreq_quick_get(cpu);
+	bc->fmax = cpufreq_quick_get_max(cpu);
+	bc->idle_us = bench_idle_us(cpu, &bc->wall_us);
+	bc->online = true;
+}
+
+static void bench_account(void)
+{
+	unsigned int cpu, online = 0, rq = hotplug_core_rq_depth();
+	struct bench_cpu *bc;
+	u64 now, dt, idle, wall, busy, energy;
+
+	now = bench_elapsed_us();
+	dt = now - bench.sampled_us;
+
+	get_online_cpus();
+	for_each_possible_cpu(cpu) {
+		bc = &per_cpu(bench_cpu, cpu);
+		if (!cpu_online(cpu)) {
+			bc->online = false;
+			continue;
+		}
+		online++;
+
+		if (!bc->online) {
+			/* came up since the last sample, call it idle so far */
+			bench_cpu_online(bc, cpu);
+			busy = 0;
+		} else {
+			idle = bench_idle_us(cpu, &wall);
+			busy = wall - bc->wall_us;
+			idle -= bc->idle_us;
+			busy = busy > idle ? min(busy - idle, dt) : 0;
+			bc->idle_us += idle;
+			bc->wall_us = wall;
+		}
+
+		energy = dt * core_mw + busy * bench_mw(bc->freq, bc->fmax) +
+			 (dt - busy) * idle_mw;
+
+		spin_lock(&bench_lock);
+		bench.energy_nj += energy;
+		if (bc->freq)
+			bench_add_freq(bc->freq, dt);
+		spin_unlock(&bench_lock);
+	}
+	put_online_cpus();
+
+	spin_lock(&bench_lock);
+	bench.online_us[online] += dt;
+	bench.online_sum += dt * online;
+	bench.rq_sum += dt * rq;
+	bench.rq_max = max(bench.rq_max, rq);
+	bench.sampled_us = now;
+	spin_unlock(&bench_lock);
+}
+
+static void bench_finish(void)
+{
+	unsigned int cpu, up_count, down_count;
+	struct bench_cpu *bc;
+	u64 up_us, down_us;
+
+	for_each_possible_cpu(cpu) {
+		bc = &per_cpu(bench_cpu, cpu);
+		hotplug_core_latency_stats(cpu, true, &up_count, &up_us);
+		hotplug_core_latency_stats(cpu, false, &down_count, &down_us);
+
+		spin_lock(&bench_lock);
+		bench.up_count += up_count - bc->up_count;
+		bench.up_us += up_us - bc->up_us;
+		bench.down_count += down_count - bc->down_count;
+		bench.down_us += down_us - bc->down_us;
+		spin_unlock(&bench_lock);
+	}
+
+	ACCESS_ONCE(bench_active) = false;
+}
+
+static void bench_sample_fn(struct work_struct *work)
+{
+	bool running = atomic_read(&bench_running);
+
+	bench_account();
+	if (running)
+		schedule_delayed_work(&bench_sample_work,
+				      msecs_to_jiffies(sample_ms));
+	else
+		bench_finish();
+}
+
+static void bench_account_wakeup(unsigned int lat_us)
+{
+	spin_lock(&bench_lock);
+	bench.wakeups++;
+	bench.lat_total_us += lat_us;
+	bench.lat_max_us = max(bench.lat_max_us, lat_us);
+	bench.hist[min(lat_us / BENCH_HIST_US, BENCH_HIST - 1U)]++;
+	spin_unlock(&bench_lock);
+}
+
+static void bench_run_work(unsigned int work_us, u64 deadline_us)
+{
+	s64 left_ns = (s64)work_us * NSEC_PER_USEC;
+	struct bench_cpu *bc;
+	unsigned int freq, fmax;
+
+	while (left_ns > 0 && !kthread_should_stop()) {
+		preempt_disable();
+		bc = &__get_cpu_var(bench_cpu);
+		freq = bc->freq;
+		fmax = bc->fmax;
+		udelay(BENCH_CHUNK_US);
+		preempt_enable();
+
+		if (freq && fmax && freq < fmax)
+			left_ns -= div_u64((u64)BENCH_CHUNK_US * NSEC_PER_USEC *
+					   freq, fmax);
+		else
+			left_ns -= BENCH_CHUNK_US * NSEC_PER_USEC;
+
+		cond_resched();
+	}
+
+	if (left_ns > 0)
+		return;
+
+	spin_lock(&bench_lock);
+	bench.done++;
+	if (bench_elapsed_us() > deadline_us)
+		bench.missed++;
+	spin_unlock(&bench_lock);
+}
+
+/* Push @release out of the quiet part of a burst cycle */
+static u64 bench_next_release(const struct bench_load *load, u64 release)
+{
+	u32 cycle_us = load->cycle_ms * USEC_PER_MSEC;
+	u32 pos;
+
+	if (!cycle_us)
+		return release;
+
+	pos = do_div(release, cycle_us);
+	if (pos >= load->burst_ms * USEC_PER_MSEC)
+		return (release + 1) * cycle_us;
+
+	return release * cycle_us + pos;
+}
+
+static int bench_thread(void *data)
+{
+	const struct bench_load *load = bench_load;
+	unsigned int index = (unsigned long)data;
+	u64 release, now;
+	ktime_t expires;
+
+	/* spread the threads over the period */
+	release = div_u64((u64)load->period_us * index, bench_nr_tasks);
+
+	while (!kthread_should_stop()) {
+		release = bench_next_release(load, release);
+		if (release >= bench_duration_us)
+			break;
+
+		expires = ktime_add_us(bench_start, release);
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule_hrtimeout_range(&expires, 0, HRTIMER_MODE_ABS);
+		__set_current_state(TASK_RUNNING);
+		if (kthread_should_stop())
+			break;
+
+		now = bench_elapsed_us();
+		if (now < release)
+			continue;
+		bench_account_wakeup(min_t(u64, now - release, UINT_MAX));
+		bench_run_work(load->work_us, release + load->period_us);
+
+		/* releases that passed while the work ran are dropped */
+		release += load->period_us;
+		now = bench_elapsed_us();
+		while (release < now) {
+			release += load->period_us;
+			spin_lock(&bench_lock);
+			bench.dropped++;
+			spin_unlock(&bench_lock);
+		}
+	}
+
+	atomic_dec(&bench_running);
+
+	return 0;
+}
+
+static void bench_stop(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < bench_nr_tasks; i++) {
+		kthread_stop(bench_tasks[i]);
+		put_task_struct(bench_tasks[i]);
+		bench_tasks[i] = NULL;
+	}
+	bench_nr_tasks = 0;
+
+	cancel_delayed_work_sync(&bench_sample_work);
+	if (ACCESS_ONCE(bench_active)) {
+		bench_account();
+		bench_finish();
+	}
+}
+
+static int bench_start_all(void)
+{
+	unsigned int cpu, i, nr;
+	struct bench_cpu *bc;
+	struct task_struct *task;
+
+	if (ACCESS_ONCE(bench_active))
+		return -EBUSY;
+	if (!duration_ms || !sample_ms)
+		return -EINVAL;
+
+	bench_stop();
+
+	nr = bench_load->threads ? : num_possible_cpus();
+	nr = min_t(unsigned int, nr, BENCH_MAX_THREADS);
+
+	spin_lock(&bench_lock);
+	memset(&bench, 0, sizeof(bench));
+	spin_unlock(&bench_lock);
+	hotplug_core_policy_name(bench_policy, sizeof(bench_policy));
+
+	for (i = 0; i < nr; i++) {
+		task = kthread_create(bench_thread, (void *)(unsigned long)i,
+				      "hotplug_bench/%u", i);
+		if (IS_ERR(task)) {
+			bench_stop();
+			return PTR_ERR(task);
+		}
+		get_task_struct(task);
+		bench_tasks[bench_nr_tasks++] = task;
+	}
+
+	for_each_possible_cpu(cpu) {
+		bc = &per_cpu(bench_cpu, cpu);
+		hotplug_core_latency_stats(cpu, true, &bc->up_count,
+					   &bc->up_us);
+		hotplug_core_latency_stats(cpu, false, &bc->down_count,
+					   &bc->down_us);
+	}
+
+	get_online_cpus();
+	for_each_possible_cpu(cpu) {
+		bc = &per_cpu(bench_cpu, cpu);
+		if (cpu_online(cpu))
+			bench_cpu_online(bc, cpu);
+		else
+			bc->online = false;
+	}
+	put_online_cpus();
+
+	bench_duration_us = (u64)duration_ms * USEC_PER_MSEC;
+	bench_start = ktime_get();
+	ACCESS_ONCE(bench_active) = true;
+	atomic_set(&bench_running, bench_nr_tasks);
+	for (i = 0; i < bench_nr_tasks; i++)
+		wake_up_process(bench_tasks[i]);
+	schedule_delayed_work(&bench_sample_work, msecs_to_jiffies(sample_ms));
+
+	return 0;
+}
+
+static int bench_transition(struct notifier_block *nb, unsigned long val,
+			    void *data)
+{
+	struct cpufreq_freqs *freq = data;
+
+	if (val == CPUFREQ_POSTCHANGE)
+		per_cpu(bench_cpu, freq->cpu).freq = freq->new;
+
+	return 0;
+}
+
+static struct notifier_block bench_transition_nb = {
+	.notifier_call = bench_transition,
+};
+
+static char *bench_copy_buf(const char __user *ubuf, size_t count)
+{
+	char *buf;
+
+	if (count >= PAGE_SIZE)
+		return ERR_PTR(-E2BIG);
+
+	buf = kmalloc(count + 1, GFP_KERNEL);
+	if (!buf)
+		return ERR_PTR(-ENOMEM);
+
+	if (copy_from_user(buf, ubuf, count)) {
+		kfree(buf);
+		return ERR_PTR(-EFAULT);
+	}
+	buf[count] = '\0';
+
+	return buf;
+}
+
+static ssize_t bench_workload_write(struct file *file,
+				    const char __user *ubuf, size_t count,
+				    loff_t *ppos)
+{
+	unsigned int i;
+	char *buf;
+	int ret = -EINVAL;
+
+	buf = bench_copy_buf(ubuf, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	mutex_lock(&bench_mutex);
+	for (i = 0; i < ARRAY_SIZE(bench_loads); i++) {
+		if (!sysfs_streq(buf, bench_loads[i].name))
+			continue;
+		if (ACCESS_ONCE(bench_active)) {
+			ret = -EBUSY;
+		} else {
+			bench_load = &bench_loads[i];
+			ret = 0;
+		}
+		break;
+	}
+	mutex_unlock(&bench_mutex);
+	kfree(buf);
+
+	return ret ? ret : count;
+}
+
+static int bench_workload_show(struct seq_file *m, void *unused)
+{
+	unsigned int i;
+
+	mutex_lock(&bench_mutex);
+	for (i = 0; i < ARRAY_SIZE(bench_loads); i++)
+		seq_printf(m, &bench_loads[i] == bench_load ? "[%s] " : "%s ",
+			   bench_loads[i].name);
+	seq_putc(m, '\n');
+	mutex_unlock(&bench_mutex);
+
+	return 0;
+}
+
+static int bench_workload_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_workload_show, inode->i_private);
+}
+
+static const struct file_operations bench_workload_fops = {
+	.open		= bench_workload_open,
+	.read		= seq_read,
+	.write		= bench_workload_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* "start" or "stop" */
+static ssize_t bench_control_write(struct file *file,
+				   const char __user *ubuf, size_t count,
+				   loff_t *ppos)
+{
+	char *buf;
+	int ret;
+
+	buf = bench_copy_buf(ubuf, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	mutex_lock(&bench_mutex);
+	if (sysfs_streq(buf, "start")) {
+		ret = bench_start_all();
+	} else if (sysfs_streq(buf, "stop")) {
+		bench_stop();
+		ret = 0;
+	} else {
+		ret = -EINVAL;
+	}
+	mutex_unlock(&bench_mutex);
+	kfree(buf);
+
+	return ret ? ret : count;
+}
+
+static int bench_control_show(struct seq_file *m, void *unused)
+{
+	seq_printf(m, "%s\n", ACCESS_ONCE(bench_active) ? "running" : "idle");
+
+	return 0;
+}
+
+static int bench_control_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_control_show, inode->i_private);
+}
+
+static const struct file_operations bench_control_fops = {
+	.open		= bench_control_open,
+	.read		= seq_read,
+	.write		= bench_control_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* Called with bench_lock held */
+static unsigned int bench_percentile(unsigned int pct)
+{
+	unsigned int i, seen = 0, want;
+
+	if (!bench.wakeups)
+		return 0;
+
+	want = DIV_ROUND_UP(bench.wakeups * pct, 100);
+	for (i = 0; i < BENCH_HIST - 1; i++) {
+		seen += bench.hist[i];
+		if (seen >= want)
+			return min(bench.lat_max_us, (i + 1) * BENCH_HIST_US);
+	}
+
+	return bench.lat_max_us;
+}
+
+static int bench_results_show(struct seq_file *m, void *unused)
+{
+	unsigned int i, p95, p99, avg_mw, avg_us, online, rq_avg, score;
+	u64 total;
+
+	mutex_lock(&bench_mutex);
+	spin_lock(&bench_lock);
+	total = bench.sampled_us;
+
+	seq_printf(m, "policy: %s\n", bench_policy[0] ? bench_policy : "none");
+	seq_printf(m, "workload: %s\n", bench_load->name);
+	seq_printf(m, "state: %s\n", ACCESS_ONCE(bench_active) ?
+		   "running" : "idle");
+	seq_printf(m, "duration_ms: %llu\n", div_u64(total, USEC_PER_MSEC));
+
+	seq_puts(m, "online_ms:");
+	for (i = 1; i <= num_possible_cpus(); i++)
+		seq_printf(m, " %u:%llu", i,
+			   div_u64(bench.online_us[i], USEC_PER_MSEC));
+	online = total ? div64_u64(bench.online_sum * 100, total) : 0;
+	seq_printf(m, "\nonline_avg: %u.%02u\n", online / 100, online % 100);
+
+	seq_printf(m, "hotplug: up=%u down=%u up_avg_us=%llu down_avg_us=%llu\n",
+		   bench.up_count, bench.down_count,
+		   bench.up_count ? div_u64(bench.up_us, bench.up_count) : 0,
+		   bench.down_count ?
+		   div_u64(bench.down_us, bench.down_count) : 0);
+
+	/* rq depth is in tenths */
+	rq_avg = total ? div64_u64(bench.rq_sum, total) : 0;
+	seq_printf(m, "rq_depth: avg=%u.%u max=%u.%u\n", rq_avg / 10,
+		   rq_avg % 10, bench.rq_max / 10, bench.rq_max % 10);
+
+	seq_puts(m, "freq_ms:");
+	for (i = 0; i < bench.nr_freqs; i++)
+		seq_printf(m, " %u:%llu", bench.freqs[i].freq,
+			   div_u64(bench.freqs[i].us, USEC_PER_MSEC));
+	seq_putc(m, '\n');
+
+	p95 = bench_percentile(95);
+	p99 = bench_percentile(99);
+	avg_us = bench.wakeups ?
+		div_u64(bench.lat_total_us, bench.wakeups) : 0;
+	seq_printf(m, "wakeups: count=%u avg_us=%u p95_us=%u p99_us=%u max_us=%u\n",
+		   bench.wakeups, avg_us, p95, p99, bench.lat_max_us);
+	seq_printf(m, "work: done=%u missed=%u dropped=%u\n",
+		   bench.done, bench.missed, bench.dropped);
+
+	/* mW * us = nJ */
+	avg_mw = total ? div64_u64(bench.energy_nj, total) : 0;
+	seq_printf(m, "energy: uj=%llu avg_mw=%u\n",
+		   div_u64(bench.energy_nj, 1000), avg_mw);
+	score = avg_mw + lat_weight * p95 / 1000;
+	seq_printf(m, "score: %u\n", score);
+	spin_unlock(&bench_lock);
+	mutex_unlock(&bench_mutex);
+
+	return 0;
+}
+
+static int bench_results_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_results_show, inode->i_private);
+}
+
+static const struct file_operations bench_results_fops = {
+	.open		= bench_results_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init hotplug_bench_init(void)
+{
+	int ret;
+
+	bench_dir = debugfs_create_dir("hotplug_bench", NULL);
+	if (IS_ERR_OR_NULL(bench_dir))
+		return -ENODEV;
+
+	if (!debugfs_create_file("workload", S_IRUGO | S_IWUSR, bench_dir,
+				 NULL, &bench_workload_fops) ||
+	    !debugfs_create_file("control", S_IRUGO | S_IWUSR, bench_dir,
+				 NULL, &bench_control_fops) ||
+	    !debugfs_create_file("results", S_IRUGO, bench_dir,
+				 NULL, &bench_results_fops)) {
+		debugfs_remove_recursive(bench_dir);
+		return -ENOMEM;
+	}
+
+	ret = cpufreq_register_notifier(&bench_transition_nb,
+					CPUFREQ_TRANSITION_NOTIFIER);
+	if (ret)
+		debugfs_remove_recursive(bench_dir);
+
+	return ret;
+}
+
+static void __exit hotplug_bench_exit(void)
+{
+	debugfs_remove_recursive(bench_dir);
+	cpufreq_unregister_notifier(&bench_transition_nb,
+				    CPUFREQ_TRANSITION_NOTIFIER);
+	mutex_lock(&bench_mutex);
+	bench_stop();
+	mutex_unlock(&bench_mutex);
+}
+
+MODULE_DESCRIPTION("hotplug policy benchmark");
+MODULE_LICENSE("GPL v2");
+
+module_init(hotplug_bench_init);
+module_exit(hotplug_bench_exit);
@@ -0,0 +1,635 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * Common CPU hotplug core for the mach-msm hotplug drivers.
+ *
+ * The individual drivers register as policies.  The core keeps exactly
+ * one of them active, takes the load sample once per period on a
+ * deferrable work for policies that want it, and funnels every
+ * cpu_up/cpu_down through a single mutex.
+ *
+ * Policies can also post asynchronous requests.  Pending requests are
+ * kept as two cpumasks; a request for the opposite transition of a cpu
+ * cancels the pending one, and all pending requests are carried out in
+ * one pass of the request work, onlining before offlining.
+ */
+
+#define pr_fmt(fmt) "hotplug_core: " fmt
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/kobject.h>
+#include <linux/seq_file.h>
+#include <linux/sysfs.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+#ifdef CONFIG_MSM_RUN_QUEUE_STATS
+#include <linux/rq_stats.h>
+#endif
+#include <mach/hotplug_core.h>
+
+static struct hotplug_core {
+	struct hotplug_policy *active;
+	bool sampling;
+	struct list_head policies;
+	/* serializes policy switches and the policy list */
+	struct mutex policy_mutex;
+	/* serializes cpu_up/cpu_down; protects active and sampling */
+	struct mutex cpu_mutex;
+	struct delayed_work sample_work;
+	/* protects req_owner, req_up and req_down */
+	spinlock_t req_lock;
+	struct hotplug_policy *req_owner;
+	struct cpumask req_up;
+	struct cpumask req_down;
+	struct work_struct req_work;
+	struct workqueue_struct *wq;
+	struct kobject *kobj;
+	struct dentry *debugfs;
+} core = {
+	.policies = LIST_HEAD_INIT(core.policies),
+	.policy_mutex = __MUTEX_INITIALIZER(core.policy_mutex),
+	.cpu_mutex = __MUTEX_INITIALIZER(core.cpu_mutex),
+	.req_lock = __SPIN_LOCK_UNLOCKED(core.req_lock),
+};
+
+struct hotplug_latency {
+	unsigned int last_us;
+	unsigned int max_us;
+	unsigned int count;
+	u64 total_us;
+};
+
+/* Online and offline latencies, updated with cpu_mutex held. */
+static DEFINE_PER_CPU(struct hotplug_latency, up_latency);
+static DEFINE_PER_CPU(struct hotplug_latency, down_latency);
+
+static DEFINE_SPINLOCK(nr_avg_lock);
+
+void hotplug_core_nr_running_avg(int *avg, int *iowait_avg)
+{
+	unsigned long flags;
+
+	/* sched_get_nr_running_avg() must not race with itself */
+	spin_lock_irqsave(&nr_avg_lock, flags);
+	sched_get_nr_running_avg(avg, iowait_avg);
+	spin_unlock_irqrestore(&nr_avg_lock, flags);
+}
+EXPORT_SYMBOL(hotplug_core_nr_running_avg);
+
+static bool hotplug_core_rq_peek(unsigned int *val)
+{
+#ifdef CONFIG_MSM_RUN_QUEUE_STATS
+	unsigned long flags;
+
+	if (rq_info.init == 1) {
+		/* peek only, userspace resets it when it reads run_queue_avg */
+		spin_lock_irqsave(&rq_lock, flags);
+		*val = rq_info.rq_avg;
+		spin_unlock_irqrestore(&rq_lock, flags);
+		return true;
+	}
+#endif
+	return false;
+}
+
+static unsigned int hotplug_core_rq_avg(int nr_run_avg)
+{
+	unsigned int val;
+
+	if (hotplug_core_rq_peek(&val))
+		return val;
+	return nr_run_avg / 10;
+}
+
+unsigned int hotplug_core_rq_depth(void)
+{
+	unsigned int val;
+
+	if (hotplug_core_rq_peek(&val))
+		return val;
+	return nr_running() * 10;
+}
+EXPORT_SYMBOL(hotplug_core_rq_depth);
+
+static void hotplug_core_sample(struct work_struct *work)
+{
+	struct hotplug_policy *policy;
+	struct hotplug_sample s;
+
+	mutex_lock(&core.cpu_mutex);
+	policy = core.sampling ? core.active : NULL;
+	mutex_unlock(&core.cpu_mutex);
+
+	if (!policy || !policy->sample)
+		return;
+
+	hotplug_core_nr_running_avg(&s.nr_run_avg, &s.iowait_avg);
+	s.rq_avg = hotplug_core_rq_avg(s.nr_run_avg);
+	s.online = num_online_cpus();
+
+	policy->sample(&s);
+
+	mutex_lock(&core.cpu_mutex);
+	if (core.active == policy && core.sampling)
+		queue_delayed_work(core.wq, &core.sample_work,
+				   msecs_to_jiffies(*policy->sample_ms));
+	mutex_unlock(&core.cpu_mutex);
+}
+
+void hotplug_core_schedule(struct hotplug_policy *policy,
+			   unsigned int delay_ms)
+{
+	mutex_lock(&core.cpu_mutex);
+	if (core.active == policy && policy->sample) {
+		core.sampling = true;
+		cancel_delayed_work(&core.sample_work);
+		queue_delayed_work(core.wq, &core.sample_work,
+				   msecs_to_jiffies(delay_ms));
+	}
+	mutex_unlock(&core.cpu_mutex);
+}
+EXPORT_SYMBOL(hotplug_core_schedule);
+
+void hotplug_core_cancel(struct hotplug_policy *policy)
+{
+	bool cancel = false;
+
+	mutex_lock(&core.cpu_mutex);
+	if (core.active == policy) {
+		core.sampling = false;
+		cancel = true;
+	}
+	mutex_unlock(&core.cpu_mutex);
+
+	if (cancel)
+		cancel_delayed_work_sync(&core.sample_work);
+}
+EXPORT_SYMBOL(hotplug_core_cancel);
+
+static void hotplug_core_account(struct hotplug_latency *lat, ktime_t start)
+{
+	unsigned int us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+	lat->last_us = us;
+	lat->max_us = max(lat->max_us, us);
+	lat->total_us += us;
+	lat->count++;
+}
+
+/* Called with cpu_mutex held. */
+static int __ref hotplug_core_do_up(unsigned int cpu)
+{
+	ktime_t start;
+	int ret;
+
+	if (cpu_online(cpu))
+		return 0;
+
+	start = ktime_get();
+	ret = cpu_up(cpu);
+	if (!ret)
+		hotplug_core_account(&per_cpu(up_latency, cpu), start);
+
+	return ret;
+}
+
+/* Called with cpu_mutex held. */
+static int hotplug_core_do_down(unsigned int cpu)
+{
+	ktime_t start;
+	int ret;
+
+	if (!cpu_online(cpu))
+		return 0;
+
+	start = ktime_get();
+	ret = cpu_down(cpu);
+	if (!ret)
+		hotplug_core_account(&per_cpu(down_latency, cpu), start);
+
+	return ret;
+}
+
+unsigned int hotplug_core_latency_us(unsigned int cpu, bool up)
+{
+	struct hotplug_latency *lat;
+
+	lat = up ? &per_cpu(up_latency, cpu) : &per_cpu(down_latency, cpu);
+	if (!lat->count)
+		return 0;
+
+	return div_u64(lat->total_us, lat->count);
+}
+EXPORT_SYMBOL(hotplug_core_latency_us);
+
+void hotplug_core_latency_stats(unsigned int cpu, bool up,
+				unsigned int *count, u64 *total_us)
+{
+	struct hotplug_latency *lat;
+
+	/*
+	 * Unlocked like hotplug_core_latency_us(): cpu_mutex is held across
+	 * cpu_down(), which can wait for the work of a caller that samples.
+	 */
+	lat = up ? &per_cpu(up_latency, cpu) : &per_cpu(down_latency, cpu);
+	*count = lat->count;
+	*total_us = lat->total_us;
+}
+EXPORT_SYMBOL(hotplug_core_latency_stats);
+
+int hotplug_core_cpu_up(struct hotplug_policy *policy, unsigned int cpu)
+{
+	int ret;
+
+	mutex_lock(&core.cpu_mutex);
+	if (core.active != policy)
+		ret = -EBUSY;
+	else
+		ret = hotplug_core_do_up(cpu);
+	mutex_unlock(&core.cpu_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL(hotplug_core_cpu_up);
+
+int hotplug_core_cpu_down(struct hotplug_policy *policy, unsigned int cpu)
+{
+	int ret = 0;
+
+	if (cpu == 0)
+		return -EINVAL;
+
+	mutex_lock(&core.cpu_mutex);
+	if (core.active != policy)
+		ret = -EBUSY;
+	else
+		ret = hotplug_core_do_down(cpu);
+	mutex_unlock(&core.cpu_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL(hotplug_core_cpu_down);
+
+static void hotplug_core_request_fn(struct work_struct *work)
+{
+	struct hotplug_policy *owner;
+	struct cpumask up, down;
+	unsigned int cpu;
+
+	spin_lock_irq(&core.req_lock);
+	owner = core.req_owner;
+	cpumask_copy(&up, &core.req_up);
+	cpumask_copy(&down, &core.req_down);
+	cpumask_clear(&core.req_up);
+	cpumask_clear(&core.req_down);
+	spin_unlock_irq(&core.req_lock);
+
+	mutex_lock(&core.cpu_mutex);
+	if (owner && core.active == owner) {
+		for_each_cpu(cpu, &up)
+			hotplug_core_do_up(cpu);
+		for_each_cpu(cpu, &down)
+			hotplug_core_do_down(cpu);
+	}
+	mutex_unlock(&core.cpu_mutex);
+}
+
+static int hotplug_core_request(struct hotplug_policy *policy,
+				unsigned int cpu, bool up)
+{
+	unsigned long flags;
+	int ret = 0;
+
+	if (cpu >= nr_cpu_ids || (!up && cpu == 0))
+		return -EINVAL;
+
+	spin_lock_irqsave(&core.req_lock, flags);
+	if (core.req_owner != policy) {
+		ret = -EBUSY;
+	} else if (up) {
+		cpumask_clear_cpu(cpu, &core.req_down);
+		cpumask_set_cpu(cpu, &core.req_up);
+	} else {
+		cpumask_clear_cpu(cpu, &core.req_up);
+		cpumask_set_cpu(cpu, &core.req_down);
+	}
+	spin_unlock_irqrestore(&core.req_lock, flags);
+
+	if (!ret)
+		queue_work(core.wq, &core.req_work);
+
+	return ret;
+}
+
+int hotplug_core_request_up(struct hotplug_policy *policy, unsigned int cpu)
+{
+	return hotplug_core_request(policy, cpu, true);
+}
+EXPORT_SYMBOL(hotplug_core_request_up);
+
+int hotplug_core_request_down(struct hotplug_policy *policy, unsigned int cpu)
+{
+	return hotplug_core_request(policy, cpu, false);
+}
+EXPORT_SYMBOL(hotplug_core_request_down);
+
+/* Drop pending requests and hand the queue to @owner. */
+static void hotplug_core_reset_requests(struct hotplug_policy *owner)
+{
+	spin_lock_irq(&core.req_lock);
+	core.req_owner = NULL;
+	cpumask_clear(&core.req_up);
+	cpumask_clear(&core.req_down);
+	spin_unlock_irq(&core.req_lock);
+
+	cancel_work_sync(&core.req_work);
+
+	spin_lock_irq(&core.req_lock);
+	core.req_owner = owner;
+	spin_unlock_irq(&core.req_lock);
+}
+
+/* Called with policy_mutex held. */
+static int hotplug_core_switch(struct hotplug_policy *policy)
+{
+	struct hotplug_policy *old = core.active;
+	int ret = 0;
+
+	if (old == policy)
+		return 0;
+
+	if (old) {
+		/*
+		 * The old policy may still hotplug synchronously while it
+		 * winds down, but nothing it queued may run after that.
+		 */
+		hotplug_core_cancel(old);
+		hotplug_core_reset_requests(NULL);
+		old->stop();
+		pr_info("%s stopped\n", old->name);
+	}
+
+	mutex_lock(&core.cpu_mutex);
+	core.active = policy;
+	core.sampling = false;
+	mutex_unlock(&core.cpu_mutex);
+
+	if (!policy)
+		return 0;
+
+	hotplug_core_reset_requests(policy);
+
+	ret = policy->start();
+	if (ret) {
+		pr_err("%s failed to start: %d\n", policy->name, ret);
+		hotplug_core_cancel(policy);
+		hotplug_core_reset_requests(NULL);
+		mutex_lock(&core.cpu_mutex);
+		core.active = NULL;
+		mutex_unlock(&core.cpu_mutex);
+		return ret;
+	}
+	pr_info("%s started\n", policy->name);
+
+	return 0;
+}
+
+int hotplug_core_enable(struct hotplug_policy *policy, bool enable)
+{
+	int ret = 0;
+
+	mutex_lock(&core.policy_mutex);
+	if (enable)
+		ret = hotplug_core_switch(policy);
+	else if (core.active == policy)
+		ret = hotplug_core_switch(NULL);
+	mutex_unlock(&core.policy_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL(hotplug_core_enable);
+
+int hotplug_core_register(struct hotplug_policy *policy, bool enable)
+{
+	int ret = 0;
+
+	if (!core.wq)
+		return -ENODEV;
+
+	if (!policy->start || !policy->stop ||
+	    (policy->sample && !policy->sample_ms))
+		return -EINVAL;
+
+	mutex_lock(&core.policy_mutex);
+	list_add_tail(&policy->list, &core.policies);
+	if (enable) {
+		/* a boot-time default never preempts a running policy */
+		if (core.active)
+			pr_info("%s not started, %s is active\n",
+				policy->name, core.active->name);
+		else
+			ret = hotplug_core_switch(policy);
+	}
+	mutex_unlock(&core.policy_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL(hotplug_core_register);
+
+void hotplug_core_unregister(struct hotplug_policy *policy)
+{
+	mutex_lock(&core.policy_mutex);
+	if (core.active == policy)
+		hotplug_core_switch(NULL);
+	list_del(&policy->list);
+	mutex_unlock(&core.policy_mutex);
+}
+EXPORT_SYMBOL(hotplug_core_unregister);
+
+void hotplug_core_policy_name(char *buf, size_t len)
+{
+	mutex_lock(&core.policy_mutex);
+	strlcpy(buf, core.active ? core.active->name : "none", len);
+	mutex_unlock(&core.policy_mutex);
+}
+EXPORT_SYMBOL(hotplug_core_policy_name);
+
+static ssize_t show_policy(struct kobject *kobj,
+			   struct kobj_attribute *attr, char *buf)
+{
+	ssize_t ret;
+
+	mutex_lock(&core.policy_mutex);
+	ret = snprintf(buf, PAGE_SIZE, "%s\n",
+		       core.active ? core.active->name : "none");
+	mutex_unlock(&core.policy_mutex);
+
+	return ret;
+}
+
+static ssize_t store_policy(struct kobject *kobj,
+			    struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct hotplug_policy *policy, *found = NULL;
+	char name[32];
+	int ret;
+
+	if (sscanf(buf, "%31s", name) != 1)
+		return -EINVAL;
+
+	mutex_lock(&core.policy_mutex);
+	if (strcmp(name, "none")) {
+		list_for_each_entry(policy, &core.policies, list) {
+			if (!strcmp(policy->name, name)) {
+				found = policy;
+				break;
+			}
+		}
+		if (!found) {
+			mutex_unlock(&core.policy_mutex);
+			return -EINVAL;
+		}
+	}
+	ret = hotplug_core_switch(found);
+	mutex_unlock(&core.policy_mutex);
+
+	return ret ? ret : count;
+}
+
+static ssize_t show_available_policies(struct kobject *kobj,
+				       struct kobj_attribute *attr, char *buf)
+{
+	struct hotplug_policy *policy;
+	ssize_t len = 0;
+
+	mutex_lock(&core.policy_mutex);
+	list_for_each_entry(policy, &core.policies, list)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%s ",
+				 policy->name);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "none\n");
+	mutex_unlock(&core.policy_mutex);
+
+	return len;
+}
+
+static struct kobj_attribute policy_attr =
+	__ATTR(policy, 0644, show_policy, store_policy);
+static struct kobj_attribute available_policies_attr =
+	__ATTR(available_policies, 0444, show_available_policies, NULL);
+
+static struct attribute *hotplug_core_attrs[] = {
+	&policy_attr.attr,
+	&available_policies_attr.attr,
+	NULL,
+};
+
+static struct attribute_group hotplug_core_attr_group = {
+	.attrs = hotplug_core_attrs,
+};
+
+#ifdef CONFIG_DEBUG_FS
+static void hotplug_core_show_latency(struct seq_file *m,
+				      struct hotplug_latency *lat)
+{
+	seq_printf(m, "%10u%10u%10llu%10u",
+		   lat->last_us, lat->max_us,
+		   lat->count ? div_u64(lat->total_us, lat->count) : 0,
+		   lat->count);
+}
+
+static int hotplug_core_latency_show(struct seq_file *m, void *unused)
+{
+	unsigned int cpu;
+
+	seq_printf(m, "%4s%40s%40s\n", "", "online (us)", "offline (us)");
+	seq_printf(m, "%4s%10s%10s%10s%10s%10s%10s%10s%10s\n", "cpu",
+		   "last", "max", "avg", "count",
+		   "last", "max", "avg", "count");
+
+	mutex_lock(&core.cpu_mutex);
+	for_each_possible_cpu(cpu) {
+		seq_printf(m, "%4u", cpu);
+		hotplug_core_show_latency(m, &per_cpu(up_latency, cpu));
+		hotplug_core_show_latency(m, &per_cpu(down_latency, cpu));
+		seq_printf(m, "\n");
+	}
+	mutex_unlock(&core.cpu_mutex);
+
+	return 0;
+}
+
+static int hotplug_core_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hotplug_core_latency_show, inode->i_private);
+}
+
+static const struct file_operations hotplug_core_latency_fops = {
+	.open		= hotplug_core_latency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init hotplug_core_debugfs_init(void)
+{
+	core.debugfs = debugfs_create_dir("hotplug_core", NULL);
+	if (IS_ERR_OR_NULL(core.debugfs))
+		return;
+
+	debugfs_create_file("latency", S_IRUGO, core.debugfs, NULL,
+			    &hotplug_core_latency_fops);
+}
+#else
+static inline void hotplug_core_debugfs_init(void) {}
+#endif
+
+static int __init hotplug_core_init(void)
+{
+	int ret;
+
+	core.wq = alloc_workqueue("hotplug_core",
+			WQ_HIGHPRI | WQ_FREEZABLE | WQ_POWER_EFFICIENT, 0);
+	if (!core.wq)
+		return -ENOMEM;
+
+	INIT_DELAYED_WORK_DEFERRABLE(&core.sample_work, hotplug_core_sample);
+	INIT_WORK(&core.req_work, hotplug_core_request_fn);
+
+	hotplug_core_debugfs_init();
+
+	core.kobj = kobject_create_and_add("hotplug_core", kernel_kobj);
+	if (!core.kobj) {
+		pr_err("kobject create failed\n");
+		return -ENOMEM;
+	}
+
+	ret = sysfs_create_group(core.kobj, &hotplug_core_attr_group);
+	if (ret) {
+		pr_err("sysfs create failed: %d\n", ret);
+		kobject_put(core.kobj);
+		core.kobj = NULL;
+	}
+
+	return ret;
+}
+subsys_initcall(hotplug_core_init);
@@ -149,6 +149,18 @@ struct clk_ops {
 				struct clk_register_data **regs, u32 *size);
 };
 
+/**
+ * struct clk_rate_stats - rate change latency, updated under prepare_lock
+ * @count: number of rate changes
+ * @total_us: time spent in all of them
+ * @max_us: longest single rate change
+ */
+struct clk_rate_stats {
+	unsigned count;
+	u64 total_us;
+	unsigned max_us;
+};
+
 /**
  * struct clk
  * @prepare_count: prepare refcount
@@ -159,6 +171,7 @@ struct clk_ops {
  * @vdd_class: voltage scaling requirement class
  * @fmax: maximum frequency in Hz supported at each voltage level
  * @parent: the current source of this clock
+ * @rate_stats: how long clk_set_rate() has taken on this clock
  */
 struct clk {
 	uint32_t flags;
@@ -178,6 +191,8 @@ struct clk {
 	spinlock_t lock;
 	unsigned prepare_count;
 	struct mutex prepare_lock;
+
+	struct clk_rate_stats rate_stats;
 };
 
 #define CLK_INIT(name) \
@@ -44,4 +44,19 @@ int clk_reset(struct clk *clk, enum clk_reset_action action);
 /* Set clock-specific configuration parameters */
 int clk_set_flags(struct clk *clk, unsigned long flags);
 
+/**
+ * struct clk_rate_req - one rate change in a clk_set_rates() transaction
+ * @clk: clock to change
+ * @rate: new rate in Hz
+ */
+struct clk_rate_req {
+	struct clk *clk;
+	unsigned long rate;
+};
+
+#define CLK_SET_RATES_MAX		8
+
+/* Change several clock rates with one voltage change each way */
+int clk_set_rates(struct clk_rate_req *reqs, int n);
+
 #endif
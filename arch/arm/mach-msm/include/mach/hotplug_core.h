@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __ARCH_ARM_MACH_MSM_HOTPLUG_CORE_H
+#define __ARCH_ARM_MACH_MSM_HOTPLUG_CORE_H
+
+#include <linux/cpu.h>
+#include <linux/list.h>
+#include <linux/time.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/types.h>
+
+/**
+ * struct hotplug_sample - load snapshot handed to the active policy
+ * @nr_run_avg:	average nr_running since the last sample, times 100
+ * @iowait_avg:	average nr_iowait since the last sample, times 100
+ * @rq_avg:	run queue depth from msm_rq_stats, times 10
+ * @online:	number of online cpus when the sample was taken
+ */
+struct hotplug_sample {
+	int nr_run_avg;
+	int iowait_avg;
+	unsigned int rq_avg;
+	unsigned int online;
+};
+
+/**
+ * struct hotplug_policy - a hotplug algorithm driven by the core
+ * @name:	name shown in /sys/kernel/hotplug_core/available_policies
+ * @start:	called when the policy becomes active; may hotplug cpus
+ * @stop:	called before another policy takes over; may hotplug cpus
+ * @sample:	optional; called from the core sampler with a fresh
+ *		hotplug_sample every *@sample_ms milliseconds
+ * @sample_ms:	sampling period, read each time the sampler is requeued
+ *
+ * Only one policy is active at a time.  cpu_up/cpu_down requests from
+ * a policy that is not active are refused, so an algorithm that is
+ * being switched out cannot undo what its replacement decided.
+ */
+struct hotplug_policy {
+	const char *name;
+	struct list_head list;
+	int (*start)(void);
+	void (*stop)(void);
+	void (*sample)(const struct hotplug_sample *s);
+	unsigned int *sample_ms;
+};
+
+#ifdef CONFIG_MSM_HOTPLUG_CORE
+/**
+ * hotplug_core_register() : Make a policy selectable.
+ * @policy : The policy.
+ * @enable : Start the policy now, unless another one is already active.
+ */
+int hotplug_core_register(struct hotplug_policy *policy, bool enable);
+void hotplug_core_unregister(struct hotplug_policy *policy);
+
+/**
+ * hotplug_core_enable() : Switch to or away from a policy. Enabling a
+ *                         policy stops whichever one was active before.
+ */
+int hotplug_core_enable(struct hotplug_policy *policy, bool enable);
+
+/**
+ * hotplug_core_schedule() : (Re)arm the sampler of the active policy to
+ *                           fire after @delay_ms.
+ * hotplug_core_cancel() : Stop sampling until the next schedule call.
+ *                         Must not be called from the sample callback.
+ */
+void hotplug_core_schedule(struct hotplug_policy *policy,
+			   unsigned int delay_ms);
+void hotplug_core_cancel(struct hotplug_policy *policy);
+
+int hotplug_core_cpu_up(struct hotplug_policy *policy, unsigned int cpu);
+int hotplug_core_cpu_down(struct hotplug_policy *policy, unsigned int cpu);
+
+/**
+ * hotplug_core_request_up() : Queue an asynchronous online request.
+ * hotplug_core_request_down() : Queue an asynchronous offline request.
+ *
+ * A request cancels a still pending request for the opposite transition
+ * of the same cpu. Requests queued before the request work runs are
+ * carried out together.
+ */
+int hotplug_core_request_up(struct hotplug_policy *policy, unsigned int cpu);
+int hotplug_core_request_down(struct hotplug_policy *policy, unsigned int cpu);
+
+/**
+ * hotplug_core_latency_us() : Average measured online (@up) or offline
+ *                             latency of @cpu, 0 if never measured.
+ */
+unsigned int hotplug_core_latency_us(unsigned int cpu, bool up);
+
+/**
+ * hotplug_core_latency_stats() : Number of onlines (@up) or offlines of
+ *                                @cpu done through the core and the time
+ *                                they took in total.
+ */
+void hotplug_core_latency_stats(unsigned int cpu, bool up,
+				unsigned int *count, u64 *total_us);
+
+/**
+ * hotplug_core_policy_name() : Copy the name of the active policy, or
+ *                              "none", to @buf.
+ */
+void hotplug_core_policy_name(char *buf, size_t len);
+
+/**
+ * hotplug_core_rq_depth() : Run queue depth times 10 as in struct
+ *                           hotplug_sample, read without disturbing the
+ *                           averages the policies sample.
+ */
+unsigned int hotplug_core_rq_depth(void);
+
+/**
+ * hotplug_core_nr_running_avg() : Serialized sched_get_nr_running_avg()
+ *                                 for policies that sample on their own.
+ */
+void hotplug_core_nr_running_avg(int *avg, int *iowait_avg);
+#else
+static inline int hotplug_core_register(struct hotplug_policy *policy,
+					bool enable)
+{
+	return enable ? policy->start() : 0;
+}
+static inline void hotplug_core_unregister(struct hotplug_policy *policy) {}
+static inline int hotplug_core_enable(struct hotplug_policy *policy,
+				      bool enable)
+{
+	if (!enable) {
+		policy->stop();
+		return 0;
+	}
+	return policy->start();
+}
+static inline void hotplug_core_schedule(struct hotplug_policy *policy,
+					 unsigned int delay_ms) {}
+static inline void hotplug_core_cancel(struct hotplug_policy *policy) {}
+static inline int hotplug_core_cpu_up(struct hotplug_policy *policy,
+				      unsigned int cpu)
+{
+	return cpu_up(cpu);
+}
+static inline int hotplug_core_cpu_down(struct hotplug_policy *policy,
+					unsigned int cpu)
+{
+	return cpu_down(cpu);
+}
+static inline int hotplug_core_request_up(struct hotplug_policy *policy,
+					  unsigned int cpu)
+{
+	return cpu_online(cpu) ? 0 : cpu_up(cpu);
+}
+static inline int hotplug_core_request_down(struct hotplug_policy *policy,
+					    unsigned int cpu)
+{
+	return cpu_online(cpu) ? cpu_down(cpu) : 0;
+}
+static inline unsigned int hotplug_core_latency_us(unsigned int cpu, bool up)
+{
+	return 0;
+}
+static inline void hotplug_core_nr_running_avg(int *avg, int *iowait_avg)
+{
+	sched_get_nr_running_avg(avg, iowait_avg);
+}
+static inline void hotplug_core_latency_stats(unsigned int cpu, bool up,
+					      unsigned int *count,
+					      u64 *total_us)
+{
+	*count = 0;
+	*total_us = 0;
+}
+static inline void hotplug_core_policy_name(char *buf, size_t len)
+{
+	strlcpy(buf, "none", len);
+}
+#endif
+
+/*
+ * hotplug_core_cycle_ms() : Measured cost of one offline/online round trip
+ *                           of @cpu. Policies add it to their hysteresis so
+ *                           that a cpu is not dropped sooner than bringing
+ *                           it back would pay off.
+ */
+static inline unsigned int hotplug_core_cycle_ms(unsigned int cpu)
+{
+	return (hotplug_core_latency_us(cpu, true) +
+		hotplug_core_latency_us(cpu, false)) / USEC_PER_MSEC;
+}
+
+#endif /* __ARCH_ARM_MACH_MSM_HOTPLUG_CORE_H */
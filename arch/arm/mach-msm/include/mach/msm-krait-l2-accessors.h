@@ -67,7 +67,15 @@
 extern void set_l2_indirect_reg(u32 reg_addr, u32 val);
 extern u32 get_l2_indirect_reg(u32 reg_addr);
 extern u32 set_get_l2_indirect_reg(u32 reg_addr, u32 val);
+extern int krait_l2_pmu_reserve(u32 counters, u8 reg, u8 groups, u8 code);
+extern void krait_l2_pmu_release(u32 counters, u8 reg, u8 groups);
 #else
+static inline int krait_l2_pmu_reserve(u32 counters, u8 reg, u8 groups,
+				       u8 code)
+{
+	return 0;
+}
+static inline void krait_l2_pmu_release(u32 counters, u8 reg, u8 groups) {}
 static inline void set_l2_indirect_reg(u32 reg_addr, u32 val) {}
 static inline u32 get_l2_indirect_reg(u32 reg_addr)
 {
@@ -234,6 +234,24 @@ extern int msm_dcvs_scm_event(uint32_t core_id,
 		uint32_t param0, uint32_t param1,
 		uint32_t *ret0, uint32_t *ret1);
 
+/*
+ * In-kernel counterparts of the calls above, used by msm_dcvs_scm.c when
+ * its native parameter is set. They return -ENOSYS for cores and events
+ * that only TrustZone handles.
+ */
+extern int msm_dcvs_native_register_core(uint32_t core_id,
+		struct msm_dcvs_core_param *param);
+extern int msm_dcvs_native_set_algo_params(uint32_t core_id,
+		struct msm_dcvs_algo_param *param);
+extern int msm_dcvs_native_set_power_params(uint32_t core_id,
+		struct msm_dcvs_power_params *pwr_param,
+		struct msm_dcvs_freq_entry *freq_entry);
+extern int msm_dcvs_native_event(uint32_t core_id,
+		enum msm_dcvs_scm_event event_id,
+		uint32_t param0, uint32_t param1,
+		uint32_t *ret0, uint32_t *ret1);
+extern void msm_dcvs_native_reset(void);
+
 #else
 static inline int msm_dcvs_scm_init(uint32_t phy, size_t bytes)
 { return -ENOSYS; }
@@ -30,6 +30,50 @@ enum qmi_event_type {
 	QMI_SERVER_EXIT,
 };
 
+struct qmi_handle;
+
+/**
+ * struct qmi_txn_stats - Request statistics of a QMI handle
+ * @num_reqs: Requests sent or queued for sending.
+ * @num_resps: Responses received and decoded.
+ * @num_errs: Requests that failed to send or whose response did not decode.
+ * @min_us: Shortest request to response round trip.
+ * @max_us: Longest request to response round trip.
+ * @total_us: Sum of all round trips, for the average.
+ */
+struct qmi_txn_stats {
+	uint32_t num_reqs;
+	uint32_t num_resps;
+	uint32_t num_errs;
+	uint32_t min_us;
+	uint32_t max_us;
+	uint64_t total_us;
+};
+
+/**
+ * struct qmi_batch_req - One request of a qmi_send_req_batch() call
+ * @req_desc: Structure describing the request data structure.
+ * @req: Buffer containing the request data structure.
+ * @req_len: Length of the request data structure.
+ * @resp_desc: Structure describing the response data structure.
+ * @resp: Buffer to hold the response data structure.
+ * @resp_len: Length of the response data structure.
+ * @resp_cb: Callback function to be invoked when the response arrives.
+ * @resp_cb_data: Private information to be passed along with the callback.
+ */
+struct qmi_batch_req {
+	struct msg_desc *req_desc;
+	void *req;
+	unsigned int req_len;
+	struct msg_desc *resp_desc;
+	void *resp;
+	unsigned int resp_len;
+	void (*resp_cb)(struct qmi_handle *handle,
+			unsigned int msg_id, void *msg,
+			void *resp_cb_data, int stat);
+	void *resp_cb_data;
+};
+
 struct qmi_handle {
 	void *src_port;
 	void *dest_info;
@@ -48,6 +92,10 @@ struct qmi_handle {
 	wait_queue_head_t reset_waitq;
 	struct list_head pending_txn_list;
 	struct delayed_work resume_tx_work;
+	struct list_head handle_list;
+	uint32_t service_id;
+	uint32_t service_ins;
+	struct qmi_txn_stats stats;
 };
 
 enum qmi_result_type_v01 {
@@ -160,6 +208,23 @@ int qmi_send_req_nowait(struct qmi_handle *handle,
 					int stat),
 			void *resp_cb_data);
 
+/**
+ * qmi_send_req_batch() - Send several asynchronous QMI requests at once
+ * @handle: QMI handle through which the QMI requests are sent.
+ * @reqs: Array of requests, sent in array order.
+ * @num_reqs: Number of entries in @reqs.
+ *
+ * The requests are encoded and handed to the IPC Router back to back under a
+ * single acquisition of the handle lock, so no other request on the handle
+ * can be interleaved with them.  Each response is reported through the
+ * callback of its own entry, as with qmi_send_req_nowait().
+ *
+ * @return: Number of requests sent (which may be less than @num_reqs if
+ *          one failed), < 0 on error if none was sent.
+ */
+int qmi_send_req_batch(struct qmi_handle *handle,
+		       struct qmi_batch_req *reqs, int num_reqs);
+
 /**
  * qmi_recv_msg() - Receive the QMI message
  * @handle: Handle for which the QMI message has to be received.
@@ -260,6 +325,12 @@ static inline int qmi_send_req_nowait(struct qmi_handle *handle,
 	return -ENODEV;
 }
 
+static inline int qmi_send_req_batch(struct qmi_handle *handle,
+				     struct qmi_batch_req *reqs, int num_reqs)
+{
+	return -ENODEV;
+}
+
 static inline int qmi_recv_msg(struct qmi_handle *handle)
 {
 	return -ENODEV;
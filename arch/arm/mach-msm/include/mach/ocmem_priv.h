@@ -18,6 +18,7 @@
  **/
 #include <linux/platform_device.h>
 #include <linux/clk.h>
+#include <linux/ktime.h>
 #include <asm/io.h>
 #include <mach/msm_iomap.h>
 #include "ocmem.h"
@@ -91,6 +92,13 @@ struct ocmem_zone {
 	unsigned int max_free_time;
 	unsigned int min_free_time;
 	u64 total_free_time;
+	/* Time spent queued before being served, and waiting on evictions */
+	unsigned int max_wait_time;
+	u64 total_wait_time;
+	unsigned long nr_waits;
+	unsigned int max_evict_time;
+	u64 total_evict_time;
+	unsigned long nr_evict_waits;
 };
 
 enum op_code {
@@ -176,6 +184,8 @@ struct ocmem_req {
 	struct ocmem_eviction_data *edata;
 	/* Eviction data of the request being evicted */
 	struct ocmem_eviction_data *eviction_info;
+	/* When the request was first queued */
+	ktime_t wait_start;
 };
 
 struct ocmem_handle {
@@ -185,6 +185,25 @@ int msm_rpm_send_message(enum msm_rpm_set set, uint32_t rsc_type,
 int msm_rpm_send_message_noirq(enum msm_rpm_set set, uint32_t rsc_type,
 		uint32_t rsc_id, struct msm_rpm_kvp *kvp, int nelems);
 
+/**
+ * msm_rpm_send_message_nowait() -Wrapper function for clients that do not
+ * need to know when the RPM has applied a vote. Active set votes are held
+ * for a short window and merged with later votes for the same resource
+ * into a single message; the ACK is consumed by the driver. Can be called
+ * from atomic context.
+ *
+ * @set: if the device is setting the active/sleep set parameter
+ * for the resource
+ * @rsc_type: unsigned 32 bit integer that identifies the type of the resource
+ * @rsc_id: unsigned 32 bit that uniquely identifies a resource within a type
+ * @kvp: array of KVP data.
+ * @nelem: number of KVPs pairs associated with the message.
+ *
+ * returns  0 on success and errno on failure.
+ */
+int msm_rpm_send_message_nowait(enum msm_rpm_set set, uint32_t rsc_type,
+		uint32_t rsc_id, struct msm_rpm_kvp *kvp, int nelems);
+
 /**
  * msm_rpm_driver_init() - Initialization function that registers for a
  * rpm platform driver.
@@ -250,6 +269,13 @@ static inline int msm_rpm_send_message_noirq(enum msm_rpm_set set,
 	return 0;
 }
 
+static inline int msm_rpm_send_message_nowait(enum msm_rpm_set set,
+		uint32_t rsc_type, uint32_t rsc_id, struct msm_rpm_kvp *kvp,
+		int nelems)
+{
+	return 0;
+}
+
 static inline int msm_rpm_wait_for_ack(uint32_t msg_id)
 {
 	return 0;
@@ -0,0 +1,90 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM msm_bus
+
+#if !defined(_TRACE_MSM_BUS_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MSM_BUS_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(bus_update_request,
+
+	TP_PROTO(const char *name, unsigned int index, bool deferred),
+
+	TP_ARGS(name, index, deferred),
+
+	TP_STRUCT__entry(
+		__string(name, name)
+		__field(u32, index)
+		__field(bool, deferred)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->index = index;
+		__entry->deferred = deferred;
+	),
+
+	TP_printk("client:%s index:%u commit:%s",
+		__get_str(name), __entry->index,
+		__entry->deferred ? "deferred" : "now")
+);
+
+TRACE_EVENT(bus_commit,
+
+	TP_PROTO(unsigned int updates),
+
+	TP_ARGS(updates),
+
+	TP_STRUCT__entry(
+		__field(u32, updates)
+	),
+
+	TP_fast_assign(
+		__entry->updates = updates;
+	),
+
+	TP_printk("client updates:%u", __entry->updates)
+);
+
+TRACE_EVENT(bus_vote_saved,
+
+	TP_PROTO(int ctx, unsigned int rsc_type, unsigned int hw_id,
+		unsigned long long bw),
+
+	TP_ARGS(ctx, rsc_type, hw_id, bw),
+
+	TP_STRUCT__entry(
+		__field(int, ctx)
+		__field(u32, rsc_type)
+		__field(u32, hw_id)
+		__field(u64, bw)
+	),
+
+	TP_fast_assign(
+		__entry->ctx = ctx;
+		__entry->rsc_type = rsc_type;
+		__entry->hw_id = hw_id;
+		__entry->bw = bw;
+	),
+
+	TP_printk("ctx:%d rsc_type:0x%08x hw_id:%u bw:%llu",
+		__entry->ctx, __entry->rsc_type, __entry->hw_id,
+		__entry->bw)
+);
+#endif
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH mach
+#define TRACE_INCLUDE_FILE trace_msm_bus
+#include <trace/define_trace.h>
@@ -22,6 +22,7 @@
 #include <linux/state_notifier.h>
 #endif
 #include <linux/cpufreq.h>
+#include <mach/hotplug_core.h>
 
 #define INTELLI_PLUG			"intelli_plug"
 #define INTELLI_PLUG_MAJOR_VERSION	5
@@ -57,11 +58,11 @@ defined (CONFIG_ARCH_MSM8610) || defined (CONFIG_ARCH_MSM8228)
 
 static u64 last_boost_time, last_input;
 
-static struct delayed_work intelli_plug_work;
 static struct work_struct up_down_work;
 static struct workqueue_struct *intelliplug_wq;
 static struct mutex intelli_plug_mutex;
 static struct notifier_block notif;
+static struct hotplug_policy intelli_policy;
 
 struct ip_cpu_info {
 	unsigned long cpu_nr_running;
@@ -160,7 +161,8 @@ static void apply_down_lock(unsigned int cpu)
 
 	dl->locked = 1;
 	queue_delayed_work_on(0, intelliplug_wq, &dl->lock_rem,
-			      msecs_to_jiffies(down_lock_dur));
+			      msecs_to_jiffies(down_lock_dur +
+					       hotplug_core_cycle_ms(cpu)));
 }
 
 static void remove_down_lock(struct work_struct *work)
@@ -176,9 +178,10 @@ static int check_down_lock(unsigned int cpu)
 	return dl->locked;
 }
 
-static unsigned int calculate_thread_stats(void)
+static unsigned int calculate_thread_stats(const struct hotplug_sample *s)
 {
-	unsigned int avg_nr_run = avg_nr_running();
+	/* the thresholds below are in FSHIFT fixed point */
+	unsigned int avg_nr_run = (s->nr_run_avg << FSHIFT) / 100;
 	unsigned int nr_run;
 	unsigned int threshold_size;
 	unsigned int *current_profile;
@@ -220,7 +223,7 @@ static void update_per_cpu_stat(void)
 	}
 }
 
-static void __ref cpu_up_down_work(struct work_struct *work)
+static void cpu_up_down_work(struct work_struct *work)
 {
 	int online_cpus, cpu, l_nr_threshold;
 	int target = target_cpus;
@@ -247,35 +250,32 @@ static void __ref cpu_up_down_work(struct work_struct *work)
 				cpu_nr_run_threshold << 1 / (num_online_cpus());
 			l_ip_info = &per_cpu(ip_info, cpu);
 			if (l_ip_info->cpu_nr_running < l_nr_threshold)
-				cpu_down(cpu);
+				hotplug_core_cpu_down(&intelli_policy, cpu);
 			if (target >= num_online_cpus())
 				break;
 		}
 	} else if (target > online_cpus) {
+		/* queue all of them, the core brings them up in one go */
 		for_each_cpu_not(cpu, cpu_online_mask) {
 			if (cpu == 0)
 				continue;
-			cpu_up(cpu);
-			apply_down_lock(cpu);
-			if (target <= num_online_cpus())
+			if (!hotplug_core_request_up(&intelli_policy, cpu))
+				apply_down_lock(cpu);
+			if (target <= ++online_cpus)
 				break;
 		}
 	}
 }
 
-static void intelli_plug_work_fn(struct work_struct *work)
+static void intelli_plug_sample(const struct hotplug_sample *s)
 {
 	if (hotplug_suspended && max_cpus_online_susp <= 1) {
 		dprintk("intelli_plug is suspended!\n");
 		return;
 	}
 
-	target_cpus = calculate_thread_stats();
+	target_cpus = calculate_thread_stats(s);
 	queue_work_on(0, intelliplug_wq, &up_down_work);
-
-	if (atomic_read(&intelli_plug_active) == 1)
-		queue_delayed_work_on(0, intelliplug_wq, &intelli_plug_work,
-					msecs_to_jiffies(def_sampling_ms));
 }
 
 static void intelli_plug_suspend(void)
@@ -296,18 +296,18 @@ static void intelli_plug_suspend(void)
 		return;
 
 	/* Flush hotplug workqueue */
+	hotplug_core_cancel(&intelli_policy);
 	flush_workqueue(intelliplug_wq);
-	cancel_delayed_work_sync(&intelli_plug_work);
 
 	/* Put all sibling cores to sleep */
 	for_each_online_cpu(cpu) {
 		if (cpu == 0)
 			continue;
-		cpu_down(cpu);
+		hotplug_core_cpu_down(&intelli_policy, cpu);
 	}
 }
 
-static void __ref intelli_plug_resume(void)
+static void intelli_plug_resume(void)
 {
 	int cpu, required_reschedule = 0, required_wakeup = 0;
 
@@ -320,24 +320,21 @@ static void __ref intelli_plug_resume(void)
 		required_wakeup = 1;
 		/* Initiate hotplug work if it was cancelled */
 		if (max_cpus_online_susp <= 1 ||
-			full_mode_profile == 3) {
+			full_mode_profile == 3)
 			required_reschedule = 1;
-			INIT_DELAYED_WORK(&intelli_plug_work, intelli_plug_work_fn);
-		}
 
 		/* Fire up all CPUs */
 		for_each_cpu_not(cpu, cpu_online_mask) {
 			if (cpu == 0)
 				continue;
-			cpu_up(cpu);
-			apply_down_lock(cpu);
+			if (!hotplug_core_cpu_up(&intelli_policy, cpu))
+				apply_down_lock(cpu);
 		}
 	}
 
-	/* Resume hotplug workqueue if required */
+	/* Resume hotplug sampling if required */
 	if (required_reschedule)
-		queue_delayed_work_on(0, intelliplug_wq, &intelli_plug_work,
-				      msecs_to_jiffies(RESUME_SAMPLING_MS));
+		hotplug_core_schedule(&intelli_policy, RESUME_SAMPLING_MS);
 }
 
 #ifdef CONFIG_STATE_NOTIFIER
@@ -452,7 +449,7 @@ static struct input_handler intelli_plug_input_handler = {
 	.id_table       = intelli_plug_ids,
 };
 
-static int __ref intelli_plug_start(void)
+static int intelli_plug_start(void)
 {
 	int cpu, ret = 0;
 	struct down_lock *dl;
@@ -470,6 +467,7 @@ static int __ref intelli_plug_start(void)
 	if (state_register_client(&notif)) {
 		pr_err("%s: Failed to register State notifier callback\n",
 			INTELLI_PLUG);
+		ret = -EINVAL;
 		goto err_dev;
 	}
 #endif
@@ -484,7 +482,6 @@ static int __ref intelli_plug_start(void)
 	mutex_init(&intelli_plug_mutex);
 
 	INIT_WORK(&up_down_work, cpu_up_down_work);
-	INIT_DELAYED_WORK(&intelli_plug_work, intelli_plug_work_fn);
 	for_each_possible_cpu(cpu) {
 		dl = &per_cpu(lock_info, cpu);
 		INIT_DELAYED_WORK(&dl->lock_rem, remove_down_lock);
@@ -494,12 +491,12 @@ static int __ref intelli_plug_start(void)
 	for_each_cpu_not(cpu, cpu_online_mask) {
 		if (cpu == 0)
 			continue;
-		cpu_up(cpu);
-		apply_down_lock(cpu);
+		if (!hotplug_core_cpu_up(&intelli_policy, cpu))
+			apply_down_lock(cpu);
 	}
 
-	queue_delayed_work_on(0, intelliplug_wq, &intelli_plug_work,
-			      START_DELAY_MS);
+	atomic_set(&intelli_plug_active, 1);
+	hotplug_core_schedule(&intelli_policy, jiffies_to_msecs(START_DELAY_MS));
 
 	return ret;
 err_dev:
@@ -520,7 +517,6 @@ static void intelli_plug_stop(void)
 	}
 	flush_workqueue(intelliplug_wq);
 	cancel_work_sync(&up_down_work);
-	cancel_delayed_work_sync(&intelli_plug_work);
 	mutex_destroy(&intelli_plug_mutex);
 #ifdef CONFIG_STATE_NOTIFIER
 	state_unregister_client(&notif);
@@ -529,21 +525,16 @@ static void intelli_plug_stop(void)
 
 	input_unregister_handler(&intelli_plug_input_handler);
 	destroy_workqueue(intelliplug_wq);
+	atomic_set(&intelli_plug_active, 0);
 }
 
-static void intelli_plug_active_eval_fn(unsigned int status)
-{
-	int ret = 0;
-
-	if (status == 1) {
-		ret = intelli_plug_start();
-		if (ret)
-			status = 0;
-	} else
-		intelli_plug_stop();
-
-	atomic_set(&intelli_plug_active, status);
-}
+static struct hotplug_policy intelli_policy = {
+	.name = INTELLI_PLUG,
+	.start = intelli_plug_start,
+	.stop = intelli_plug_stop,
+	.sample = intelli_plug_sample,
+	.sample_ms = &def_sampling_ms,
+};
 
 #define show_one(file_name, object)				\
 static ssize_t show_##file_name					\
@@ -618,7 +609,9 @@ static ssize_t store_intelli_plug_active(struct kobject *kobj,
 	if (input == atomic_read(&intelli_plug_active))
 		return count;
 
-	intelli_plug_active_eval_fn(input);
+	ret = hotplug_core_enable(&intelli_policy, input);
+	if (ret)
+		return ret;
 
 	return count;
 }
@@ -750,8 +743,8 @@ static int __init intelli_plug_init(void)
 		 INTELLI_PLUG_MAJOR_VERSION,
 		 INTELLI_PLUG_MINOR_VERSION);
 
-	if (atomic_read(&intelli_plug_active) == 1)
-		intelli_plug_start();
+	hotplug_core_register(&intelli_policy,
+			      atomic_read(&intelli_plug_active) == 1);
 
 	return 0;
 }
@@ -759,8 +752,7 @@ static int __init intelli_plug_init(void)
 static void __exit intelli_plug_exit(void)
 {
 
-	if (atomic_read(&intelli_plug_active) == 1)
-		intelli_plug_stop();
+	hotplug_core_unregister(&intelli_policy);
 	sysfs_remove_group(kernel_kobj, &intelli_plug_attr_group);
 }
 
@@ -26,6 +26,7 @@
 #include <linux/wait.h>
 #include <linux/delay.h>
 #include <linux/completion.h>
+#include <linux/percpu.h>
 
 #include <mach/msm_ipc_logging.h>
 
@@ -50,17 +51,17 @@ static struct ipc_log_page *get_first_page(struct ipc_log_context *ilctxt)
 	return pg;
 }
 
-static struct ipc_log_page *get_next_page(struct ipc_log_context *ilctxt,
+static struct ipc_log_page *get_next_page(struct ipc_log_cpu_buf *buf,
 					  struct ipc_log_page *cur_pg)
 {
 	struct ipc_log_page_header *p_pghdr;
 	struct ipc_log_page *pg = NULL;
 
-	if (!ilctxt || !cur_pg)
+	if (!buf || !cur_pg)
 		return NULL;
 
-	if (ilctxt->last_page == cur_pg)
-		return ilctxt->first_page;
+	if (buf->last_page == cur_pg)
+		return buf->first_page;
 
 	p_pghdr = list_first_entry(&cur_pg->hdr.list,
 			struct ipc_log_page_header, list);
@@ -70,30 +71,65 @@ static struct ipc_log_page *get_next_page(struct ipc_log_context *ilctxt,
 }
 
 /* If data == NULL, drop the log of size data_size*/
-static void ipc_log_read(struct ipc_log_context *ilctxt,
+static void ipc_log_read(struct ipc_log_cpu_buf *buf,
 			 void *data, int data_size)
 {
 	int bytes_to_read;
 
-	bytes_to_read = MIN(((PAGE_SIZE - sizeof(struct ipc_log_page_header))
-				- ilctxt->read_page->hdr.read_offset),
+	bytes_to_read = MIN((LOG_PAGE_DATA_SIZE -
+				buf->read_page->hdr.read_offset),
 			      data_size);
 	if (data)
-		memcpy(data, (ilctxt->read_page->data +
-			ilctxt->read_page->hdr.read_offset), bytes_to_read);
+		memcpy(data, (buf->read_page->data +
+			buf->read_page->hdr.read_offset), bytes_to_read);
 	if (bytes_to_read != data_size) {
-		ilctxt->read_page->hdr.read_offset = 0xFFFF;
-		ilctxt->read_page = get_next_page(ilctxt, ilctxt->read_page);
-		ilctxt->read_page->hdr.read_offset = 0;
+		buf->read_page->hdr.read_offset = 0xFFFF;
+		buf->read_page = get_next_page(buf, buf->read_page);
+		buf->read_page->hdr.read_offset = 0;
 		if (data)
 			memcpy((data + bytes_to_read),
-			       (ilctxt->read_page->data +
-				ilctxt->read_page->hdr.read_offset),
+			       (buf->read_page->data +
+				buf->read_page->hdr.read_offset),
 			       (data_size - bytes_to_read));
 		bytes_to_read = (data_size - bytes_to_read);
 	}
-	ilctxt->read_page->hdr.read_offset += bytes_to_read;
-	ilctxt->write_avail += data_size;
+	buf->read_page->hdr.read_offset += bytes_to_read;
+	buf->write_avail += data_size;
+}
+
+/* Copy out the start of the oldest message without consuming it */
+static void ipc_log_peek(struct ipc_log_cpu_buf *buf,
+			 void *data, int data_size)
+{
+	struct ipc_log_page *pg = buf->read_page;
+	int bytes_to_read;
+
+	bytes_to_read = MIN((LOG_PAGE_DATA_SIZE - pg->hdr.read_offset),
+			    data_size);
+	memcpy(data, pg->data + pg->hdr.read_offset, bytes_to_read);
+	if (bytes_to_read != data_size) {
+		pg = get_next_page(buf, pg);
+		memcpy(data + bytes_to_read, pg->data,
+		       data_size - bytes_to_read);
+	}
+}
+
+/*
+ * Every message starts with a timestamp (see ipc_log_string()); it is
+ * what the per-CPU buffers are merged on when read.
+ */
+static unsigned long long msg_peek_timestamp(struct ipc_log_cpu_buf *buf)
+{
+	struct {
+		struct tsv_header msg;
+		struct tsv_header ts;
+		unsigned long long t;
+	} __packed head;
+
+	ipc_log_peek(buf, &head, sizeof(head));
+	if (head.ts.type != TSV_TYPE_TIMESTAMP)
+		return 0;
+	return head.t;
 }
 
 /*
@@ -109,20 +145,20 @@ static void ipc_log_read(struct ipc_log_context *ilctxt,
  * @returns 0  - no message available
  *          1  - message read
  */
-int msg_read(struct ipc_log_context *ilctxt,
+int msg_read(struct ipc_log_cpu_buf *buf,
 	     struct encode_context *ectxt)
 {
 	struct tsv_header hdr;
 
-	ipc_log_read(ilctxt, &hdr, sizeof(hdr));
+	ipc_log_read(buf, &hdr, sizeof(hdr));
 	if (ectxt) {
 		ectxt->hdr.type = hdr.type;
 		ectxt->hdr.size = hdr.size;
 		ectxt->offset = sizeof(hdr);
-		ipc_log_read(ilctxt, (ectxt->buff + ectxt->offset),
+		ipc_log_read(buf, (ectxt->buff + ectxt->offset),
 			     (int)hdr.size);
 	} else {
-		ipc_log_read(ilctxt, NULL, (int)hdr.size);
+		ipc_log_read(buf, NULL, (int)hdr.size);
 	}
 	return sizeof(hdr) + (int)hdr.size;
 }
@@ -134,6 +170,7 @@ int msg_read(struct ipc_log_context *ilctxt,
 void ipc_log_write(void *ctxt, struct encode_context *ectxt)
 {
 	struct ipc_log_context *ilctxt = (struct ipc_log_context *)ctxt;
+	struct ipc_log_cpu_buf *buf;
 	int bytes_to_write;
 	unsigned long flags;
 
@@ -142,32 +179,39 @@ void ipc_log_write(void *ctxt, struct encode_context *ectxt)
 		return;
 	}
 
-	read_lock_irqsave(&ipc_log_context_list_lock, flags);
-	spin_lock(&ilctxt->ipc_log_context_lock);
-	while (ilctxt->write_avail < ectxt->offset)
-		msg_read(ilctxt, NULL);
+	local_irq_save(flags);
+	buf = this_cpu_ptr(ilctxt->cpu_buf);
+	spin_lock(&buf->lock);
+	while (buf->write_avail < ectxt->offset)
+		msg_read(buf, NULL);
 
-	bytes_to_write = MIN(((PAGE_SIZE - sizeof(struct ipc_log_page_header))
-				- ilctxt->write_page->hdr.write_offset),
+	bytes_to_write = MIN((LOG_PAGE_DATA_SIZE -
+				buf->write_page->hdr.write_offset),
 				ectxt->offset);
-	memcpy((ilctxt->write_page->data +
-		ilctxt->write_page->hdr.write_offset),
+	memcpy((buf->write_page->data +
+		buf->write_page->hdr.write_offset),
 		ectxt->buff, bytes_to_write);
 	if (bytes_to_write != ectxt->offset) {
-		ilctxt->write_page->hdr.write_offset = 0xFFFF;
-		ilctxt->write_page = get_next_page(ilctxt, ilctxt->write_page);
-		ilctxt->write_page->hdr.write_offset = 0;
-		memcpy((ilctxt->write_page->data +
-			ilctxt->write_page->hdr.write_offset),
+		buf->write_page->hdr.write_offset = 0xFFFF;
+		buf->write_page = get_next_page(buf, buf->write_page);
+		buf->write_page->hdr.write_offset = 0;
+		memcpy((buf->write_page->data +
+			buf->write_page->hdr.write_offset),
 		       (ectxt->buff + bytes_to_write),
 		       (ectxt->offset - bytes_to_write));
 		bytes_to_write = (ectxt->offset - bytes_to_write);
 	}
-	ilctxt->write_page->hdr.write_offset += bytes_to_write;
-	ilctxt->write_avail -= ectxt->offset;
-	complete(&ilctxt->read_avail);
-	spin_unlock(&ilctxt->ipc_log_context_lock);
-	read_unlock_irqrestore(&ipc_log_context_list_lock, flags);
+	buf->write_page->hdr.write_offset += bytes_to_write;
+	buf->write_avail -= ectxt->offset;
+	spin_unlock(&buf->lock);
+	local_irq_restore(flags);
+
+	/*
+	 * Only the first message after the reader ran dry needs to wake it;
+	 * ipc_log_extract() clears .done before it looks at the buffers.
+	 */
+	if (!ACCESS_ONCE(ilctxt->read_avail.done))
+		complete(&ilctxt->read_avail);
 }
 EXPORT_SYMBOL(ipc_log_write);
 
@@ -362,7 +406,10 @@ int ipc_log_extract(void *ctxt, char *buff, int size)
 	void (*deserialize_func)(struct encode_context *ectxt,
 				 struct decode_context *dctxt);
 	struct ipc_log_context *ilctxt = (struct ipc_log_context *)ctxt;
+	struct ipc_log_cpu_buf *buf, *oldest;
+	unsigned long long t, t_oldest;
 	unsigned long flags;
+	int cpu;
 
 	if (size < MAX_MSG_DECODED_SIZE)
 		return -EINVAL;
@@ -370,27 +417,41 @@ int ipc_log_extract(void *ctxt, char *buff, int size)
 	dctxt.output_format = OUTPUT_DEBUGFS;
 	dctxt.buff = buff;
 	dctxt.size = size;
-	read_lock_irqsave(&ipc_log_context_list_lock, flags);
-	spin_lock(&ilctxt->ipc_log_context_lock);
-	while (dctxt.size >= MAX_MSG_DECODED_SIZE &&
-	       !is_ilctxt_empty(ilctxt)) {
-		msg_read(ilctxt, &ectxt);
+	INIT_COMPLETION(ilctxt->read_avail);
+	while (dctxt.size >= MAX_MSG_DECODED_SIZE) {
+		/* Merge the per-CPU buffers in timestamp order */
+		oldest = NULL;
+		t_oldest = 0;
+		for_each_possible_cpu(cpu) {
+			buf = per_cpu_ptr(ilctxt->cpu_buf, cpu);
+			spin_lock_irqsave(&buf->lock, flags);
+			if (!is_ilctxt_empty(buf)) {
+				t = msg_peek_timestamp(buf);
+				if (!oldest || t < t_oldest) {
+					oldest = buf;
+					t_oldest = t;
+				}
+			}
+			spin_unlock_irqrestore(&buf->lock, flags);
+		}
+		if (!oldest)
+			break;
+
+		/* A writer may only have dropped it for a newer message */
+		spin_lock_irqsave(&oldest->lock, flags);
+		msg_read(oldest, &ectxt);
+		spin_unlock_irqrestore(&oldest->lock, flags);
+
+		spin_lock_irqsave(&ilctxt->ipc_log_context_lock, flags);
 		deserialize_func = get_deserialization_func(ilctxt,
 							ectxt.hdr.type);
-		spin_unlock(&ilctxt->ipc_log_context_lock);
-		read_unlock_irqrestore(&ipc_log_context_list_lock, flags);
+		spin_unlock_irqrestore(&ilctxt->ipc_log_context_lock, flags);
 		if (deserialize_func)
 			deserialize_func(&ectxt, &dctxt);
 		else
 			pr_err("%s: unknown message 0x%x\n",
 				__func__, ectxt.hdr.type);
-		read_lock_irqsave(&ipc_log_context_list_lock, flags);
-		spin_lock(&ilctxt->ipc_log_context_lock);
 	}
-	if ((size - dctxt.size) == 0)
-		init_completion(&ilctxt->read_avail);
-	spin_unlock(&ilctxt->ipc_log_context_lock);
-	read_unlock_irqrestore(&ipc_log_context_list_lock, flags);
 	return size - dctxt.size;
 }
 EXPORT_SYMBOL(ipc_log_extract);
@@ -526,13 +587,11 @@ int add_deserialization_func(void *ctxt, int type,
 	if (!df_info)
 		return -ENOSPC;
 
-	read_lock_irqsave(&ipc_log_context_list_lock, flags);
-	spin_lock(&ilctxt->ipc_log_context_lock);
+	spin_lock_irqsave(&ilctxt->ipc_log_context_lock, flags);
 	df_info->type = type;
 	df_info->dfunc = dfunc;
 	list_add_tail(&df_info->list, &ilctxt->dfunc_info_list);
-	spin_unlock(&ilctxt->ipc_log_context_lock);
-	read_unlock_irqrestore(&ipc_log_context_list_lock, flags);
+	spin_unlock_irqrestore(&ilctxt->ipc_log_context_lock, flags);
 	return 0;
 }
 EXPORT_SYMBOL(add_deserialization_func);
@@ -556,8 +615,9 @@ void *ipc_log_context_create(int max_num_pages,
 			     const char *mod_name)
 {
 	struct ipc_log_context *ctxt;
+	struct ipc_log_cpu_buf *buf;
 	struct ipc_log_page *pg = NULL;
-	int page_cnt, local_log_id;
+	int page_cnt = 0, local_log_id, cpu, i, cpu_pages;
 	unsigned long flags;
 
 	ctxt = kzalloc(sizeof(struct ipc_log_context), GFP_KERNEL);
@@ -566,35 +626,48 @@ void *ipc_log_context_create(int max_num_pages,
 		return 0;
 	}
 
+	ctxt->cpu_buf = alloc_percpu(struct ipc_log_cpu_buf);
+	if (!ctxt->cpu_buf) {
+		pr_err("%s: cannot create per-cpu buffers\n", __func__);
+		kfree(ctxt);
+		return 0;
+	}
+
 	local_log_id = atomic_add_return(1, &next_log_id);
 	init_completion(&ctxt->read_avail);
 	INIT_LIST_HEAD(&ctxt->page_list);
 	INIT_LIST_HEAD(&ctxt->dfunc_info_list);
 	spin_lock_init(&ctxt->ipc_log_context_lock);
-	for (page_cnt = 0; page_cnt < max_num_pages; page_cnt++) {
-		pg = kzalloc(sizeof(struct ipc_log_page), GFP_KERNEL);
-		if (!pg) {
-			pr_err("%s: cannot create ipc_log_page\n", __func__);
-			goto release_ipc_log_context;
+
+	/* The pages asked for are shared out between the CPUs */
+	cpu_pages = DIV_ROUND_UP(max_num_pages, num_possible_cpus());
+	for_each_possible_cpu(cpu) {
+		buf = per_cpu_ptr(ctxt->cpu_buf, cpu);
+		spin_lock_init(&buf->lock);
+		for (i = 0; i < cpu_pages; i++) {
+			pg = kzalloc(sizeof(struct ipc_log_page), GFP_KERNEL);
+			if (!pg) {
+				pr_err("%s: cannot create ipc_log_page\n",
+					__func__);
+				goto release_ipc_log_context;
+			}
+			pg->hdr.magic = IPC_LOGGING_MAGIC_NUM;
+			pg->hdr.nmagic = ~(IPC_LOGGING_MAGIC_NUM);
+			pg->hdr.log_id = (uint32_t)local_log_id;
+			pg->hdr.page_num = page_cnt++;
+			pg->hdr.read_offset = 0xFFFF;
+			pg->hdr.write_offset = 0xFFFF;
+			list_add_tail(&pg->hdr.list, &ctxt->page_list);
+			if (!i)
+				buf->first_page = pg;
 		}
-		pg->hdr.magic = IPC_LOGGING_MAGIC_NUM;
-		pg->hdr.nmagic = ~(IPC_LOGGING_MAGIC_NUM);
-		pg->hdr.log_id = (uint32_t)local_log_id;
-		pg->hdr.page_num = page_cnt;
-		pg->hdr.read_offset = 0xFFFF;
-		pg->hdr.write_offset = 0xFFFF;
-		spin_lock_irqsave(&ctxt->ipc_log_context_lock, flags);
-		list_add_tail(&pg->hdr.list, &ctxt->page_list);
-		spin_unlock_irqrestore(&ctxt->ipc_log_context_lock, flags);
+		buf->last_page = pg;
+		buf->write_page = buf->first_page;
+		buf->read_page = buf->first_page;
+		buf->write_page->hdr.write_offset = 0;
+		buf->read_page->hdr.read_offset = 0;
+		buf->write_avail = cpu_pages * LOG_PAGE_DATA_SIZE;
 	}
-	ctxt->first_page = get_first_page(ctxt);
-	ctxt->last_page = pg;
-	ctxt->write_page = ctxt->first_page;
-	ctxt->read_page = ctxt->first_page;
-	ctxt->write_page->hdr.write_offset = 0;
-	ctxt->read_page->hdr.read_offset = 0;
-	ctxt->write_avail = max_num_pages * (PAGE_SIZE -
-					sizeof(struct ipc_log_page_header));
 
 	create_ctx_debugfs(ctxt, mod_name);
 
@@ -604,11 +677,12 @@ void *ipc_log_context_create(int max_num_pages,
 	return (void *)ctxt;
 
 release_ipc_log_context:
-	while (page_cnt-- > 0) {
+	while (!list_empty(&ctxt->page_list)) {
 		pg = get_first_page(ctxt);
 		list_del(&pg->hdr.list);
 		kfree(pg);
 	}
+	free_percpu(ctxt->cpu_buf);
 	kfree(ctxt);
 	return 0;
 }
@@ -638,6 +712,7 @@ int ipc_log_context_destroy(void *ctxt)
 	list_del(&ilctxt->list);
 	write_unlock_irqrestore(&ipc_log_context_list_lock, flags);
 
+	free_percpu(ilctxt->cpu_buf);
 	kfree(ilctxt);
 	return 0;
 }
@@ -30,14 +30,24 @@ struct ipc_log_page {
 	char data[PAGE_SIZE - sizeof(struct ipc_log_page_header)];
 };
 
-struct ipc_log_context {
-	struct list_head list;
-	struct list_head page_list;
+/*
+ * Each CPU writes into its own run of pages, so loggers on different CPUs
+ * never share a lock or a cache line. @lock only serializes the writer
+ * with readers draining the buffer from another CPU.
+ */
+struct ipc_log_cpu_buf {
+	spinlock_t lock;
 	struct ipc_log_page *first_page;
 	struct ipc_log_page *last_page;
 	struct ipc_log_page *write_page;
 	struct ipc_log_page *read_page;
 	uint32_t write_avail;
+};
+
+struct ipc_log_context {
+	struct list_head list;
+	struct list_head page_list;
+	struct ipc_log_cpu_buf __percpu *cpu_buf;
 	struct dentry *dent;
 	struct list_head dfunc_info_list;
 	spinlock_t ipc_log_context_lock;
@@ -63,6 +73,7 @@ enum {
 };
 
 #define IPC_LOGGING_MAGIC_NUM 0x52784425
+#define LOG_PAGE_DATA_SIZE (PAGE_SIZE - sizeof(struct ipc_log_page_header))
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 #define IS_MSG_TYPE(x) (((x) > TSV_TYPE_MSG_START) && \
 			((x) < TSV_TYPE_MSG_END))
@@ -70,17 +81,17 @@ enum {
 
 extern rwlock_t ipc_log_context_list_lock;
 
-extern int msg_read(struct ipc_log_context *ilctxt,
+extern int msg_read(struct ipc_log_cpu_buf *buf,
 		    struct encode_context *ectxt);
 
-static inline int is_ilctxt_empty(struct ipc_log_context *ilctxt)
+static inline int is_ilctxt_empty(struct ipc_log_cpu_buf *buf)
 {
-	if (!ilctxt)
+	if (!buf)
 		return -EINVAL;
 
-	return ((ilctxt->read_page == ilctxt->write_page) &&
-		(ilctxt->read_page->hdr.read_offset ==
-		 ilctxt->write_page->hdr.write_offset));
+	return ((buf->read_page == buf->write_page) &&
+		(buf->read_page->hdr.read_offset ==
+		 buf->write_page->hdr.write_offset));
 }
 
 #if (defined(CONFIG_DEBUG_FS))
@@ -28,6 +28,8 @@
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
 #include <linux/rwsem.h>
+#include <linux/rculist.h>
+#include <linux/srcu.h>
 
 #include <asm/uaccess.h>
 #include <asm/byteorder.h>
@@ -103,9 +105,17 @@ if (msm_ipc_router_debug_mask & R2R_RAW_HDR) \
 static LIST_HEAD(control_ports);
 static DECLARE_RWSEM(control_ports_lock_lha5);
 
+/*
+ * Additions and removals of local ports are serialized by
+ * local_ports_lock_lha2.  The per-packet lookups on the receive and loopback
+ * paths only need a stable view of the hash chain, so they walk it inside a
+ * local_ports_srcu read section instead of taking the rwsem.  A port is not
+ * freed or moved to another list before a grace period has elapsed.
+ */
 #define LP_HASH_SIZE 32
 static struct list_head local_ports[LP_HASH_SIZE];
 static DECLARE_RWSEM(local_ports_lock_lha2);
+static struct srcu_struct local_ports_srcu;
 
 /*
  * Server info is organized as a hash table. The server's service ID is
@@ -330,6 +340,32 @@ fail_clone:
 	return NULL;
 }
 
+/**
+ * take_pkt() - Take over the fragments of a packet
+ * @pkt: Packet owned by the caller.
+ *
+ * @return: New packet that owns the fragment queue of @pkt, NULL on error.
+ *
+ * Unlike clone_pkt() no fragment is cloned; @pkt is left without a fragment
+ * queue and can still be released by its owner.
+ */
+static struct rr_packet *take_pkt(struct rr_packet *pkt)
+{
+	struct rr_packet *new_pkt;
+
+	new_pkt = kzalloc(sizeof(struct rr_packet), GFP_KERNEL);
+	if (!new_pkt) {
+		pr_err("%s: failure\n", __func__);
+		return NULL;
+	}
+	memcpy(&(new_pkt->hdr), &(pkt->hdr), sizeof(struct rr_header_v1));
+	new_pkt->pkt_fragment_q = pkt->pkt_fragment_q;
+	new_pkt->length = pkt->length;
+	pkt->pkt_fragment_q = NULL;
+	pkt->length = 0;
+	return new_pkt;
+}
+
 struct rr_packet *create_pkt(struct sk_buff_head *data)
 {
 	struct rr_packet *pkt;
@@ -883,7 +919,7 @@ void msm_ipc_router_add_local_port(struct msm_ipc_port *port_ptr)
 
 	key = (port_ptr->this_port.port_id & (LP_HASH_SIZE - 1));
 	down_write(&local_ports_lock_lha2);
-	list_add_tail(&port_ptr->list, &local_ports[key]);
+	list_add_tail_rcu(&port_ptr->list, &local_ports[key]);
 	up_write(&local_ports_lock_lha2);
 }
 
@@ -924,13 +960,16 @@ struct msm_ipc_port *msm_ipc_router_create_raw_port(void *endpoint,
 	return port_ptr;
 }
 
-/* Must be called with local_ports_lock_lha2 locked. */
+/*
+ * Must be called with local_ports_lock_lha2 locked or inside a
+ * local_ports_srcu read section.
+ */
 static struct msm_ipc_port *msm_ipc_router_lookup_local_port(uint32_t port_id)
 {
 	int key = (port_id & (LP_HASH_SIZE - 1));
 	struct msm_ipc_port *port_ptr;
 
-	list_for_each_entry(port_ptr, &local_ports[key], list) {
+	list_for_each_entry_rcu(port_ptr, &local_ports[key], list) {
 		if (port_ptr->this_port.port_id == port_id) {
 			return port_ptr;
 		}
@@ -2073,6 +2112,7 @@ static void do_read_data(struct work_struct *work)
 	struct msm_ipc_port *port_ptr;
 	struct msm_ipc_router_remote_port *rport_ptr;
 	int ret;
+	int srcu_idx;
 
 	struct msm_ipc_router_xprt_info *xprt_info =
 		container_of(work,
@@ -2125,12 +2165,12 @@ static void do_read_data(struct work_struct *work)
 #endif
 #endif
 
-		down_read(&local_ports_lock_lha2);
+		srcu_idx = srcu_read_lock(&local_ports_srcu);
 		port_ptr = msm_ipc_router_lookup_local_port(hdr->dst_port_id);
 		if (!port_ptr) {
 			pr_err("%s: No local port id %08x\n", __func__,
 				hdr->dst_port_id);
-			up_read(&local_ports_lock_lha2);
+			srcu_read_unlock(&local_ports_srcu, srcu_idx);
 			release_pkt(pkt);
 			return;
 		}
@@ -2147,14 +2187,14 @@ static void do_read_data(struct work_struct *work)
 					__func__, hdr->src_node_id,
 					hdr->src_port_id);
 				up_read(&routing_table_lock_lha3);
-				up_read(&local_ports_lock_lha2);
+				srcu_read_unlock(&local_ports_srcu, srcu_idx);
 				release_pkt(pkt);
 				return;
 			}
 		}
 		up_read(&routing_table_lock_lha3);
 		post_pkt_to_port(port_ptr, pkt, 0);
-		up_read(&local_ports_lock_lha2);
+		srcu_read_unlock(&local_ports_srcu, srcu_idx);
 	}
 	return;
 
@@ -2273,6 +2313,7 @@ static int loopback_data(struct msm_ipc_port *src,
 	struct msm_ipc_port *port_ptr;
 	struct rr_packet *pkt;
 	int ret_len;
+	int srcu_idx;
 
 	if (!data) {
 		pr_err("%s: Invalid pkt pointer\n", __func__);
@@ -2294,11 +2335,11 @@ static int loopback_data(struct msm_ipc_port *src,
 	hdr->dst_node_id = IPC_ROUTER_NID_LOCAL;
 	hdr->dst_port_id = port_id;
 
-	down_read(&local_ports_lock_lha2);
+	srcu_idx = srcu_read_lock(&local_ports_srcu);
 	port_ptr = msm_ipc_router_lookup_local_port(port_id);
 	if (!port_ptr) {
 		pr_err("%s: Local port %d not present\n", __func__, port_id);
-		up_read(&local_ports_lock_lha2);
+		srcu_read_unlock(&local_ports_srcu, srcu_idx);
 		pkt->pkt_fragment_q = NULL;
 		release_pkt(pkt);
 		return -ENODEV;
@@ -2307,7 +2348,7 @@ static int loopback_data(struct msm_ipc_port *src,
 	ret_len = pkt->length;
 	post_pkt_to_port(port_ptr, pkt, 0);
 	update_comm_mode_info(&src->mode_info, NULL);
-	up_read(&local_ports_lock_lha2);
+	srcu_read_unlock(&local_ports_srcu, srcu_idx);
 
 	return ret_len;
 }
@@ -2769,8 +2810,9 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 
 	if (port_ptr->type == SERVER_PORT || port_ptr->type == CLIENT_PORT) {
 		down_write(&local_ports_lock_lha2);
-		list_del(&port_ptr->list);
+		list_del_rcu(&port_ptr->list);
 		up_write(&local_ports_lock_lha2);
+		synchronize_srcu(&local_ports_srcu);
 
 		if (port_ptr->type == SERVER_PORT) {
 			memset(&msg, 0, sizeof(msg));
@@ -2801,8 +2843,9 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 		up_write(&control_ports_lock_lha5);
 	} else if (port_ptr->type == IRSC_PORT) {
 		down_write(&local_ports_lock_lha2);
-		list_del(&port_ptr->list);
+		list_del_rcu(&port_ptr->list);
 		up_write(&local_ports_lock_lha2);
+		synchronize_srcu(&local_ports_srcu);
 		signal_irsc_completion();
 	}
 
@@ -2857,8 +2900,9 @@ int msm_ipc_router_bind_control_port(struct msm_ipc_port *port_ptr)
 		return -EINVAL;
 
 	down_write(&local_ports_lock_lha2);
-	list_del(&port_ptr->list);
+	list_del_rcu(&port_ptr->list);
 	up_write(&local_ports_lock_lha2);
+	synchronize_srcu(&local_ports_srcu);
 	port_ptr->type = CONTROL_PORT;
 	down_write(&control_ports_lock_lha5);
 	list_add_tail(&port_ptr->list, &control_ports);
@@ -3312,7 +3356,11 @@ void msm_ipc_router_xprt_notify(struct msm_ipc_router_xprt *xprt,
 		xprt_info = xprt->priv;
 	}
 
-	pkt = clone_pkt((struct rr_packet *)data);
+	/*
+	 * The transport releases its packet once this returns, so take over
+	 * its fragments rather than cloning them.
+	 */
+	pkt = take_pkt((struct rr_packet *)data);
 	if (!pkt)
 		return;
 
@@ -3335,6 +3383,13 @@ static int __init msm_ipc_router_init(void)
 		pr_err("%s: Unable to create IPC logging for IPC RTR",
 			__func__);
 
+	ret = init_srcu_struct(&local_ports_srcu);
+	if (ret) {
+		pr_err("%s: Unable to init local ports srcu %d\n",
+			__func__, ret);
+		return ret;
+	}
+
 	msm_ipc_router_workqueue =
 		create_singlethread_workqueue("msm_ipc_router");
 	if (!msm_ipc_router_workqueue)
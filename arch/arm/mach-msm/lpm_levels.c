@@ -26,6 +26,9 @@
 #include <linux/pm_qos.h>
 #include <linux/quickwakeup.h>
 #include <linux/of_platform.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <asm/hardware/gic.h>
 #include <mach/mpm.h>
 #include <mach/cpuidle.h>
 #include <mach/event_timer.h>
@@ -33,6 +36,7 @@
 #include "rpm-notifier.h"
 #include "spm.h"
 #include "idle.h"
+#include "msm_watchdog.h"
 
 #define SCLK_HZ (32768)
 
@@ -128,6 +132,53 @@ module_param_named(sleep_time_override,
 static int num_powered_cores;
 static struct hrtimer lpm_hrtimer;
 
+/*
+ * Idle length prediction. Besides the next timer and event_timer
+ * deadlines, each cpu keeps the durations of its recent idle periods and,
+ * for the few interrupts that woke it most recently, their average
+ * interval. The shortest plausible wakeup of those is used to pick the cpu
+ * level, so that a cpu woken every few ms by touch, SMD or WLAN does not
+ * keep entering a power collapse that never pays for itself.
+ */
+#define LPM_HIST_SIZE		8
+#define LPM_IRQ_HIST_SIZE	8
+#define LPM_IRQ_MIN_SAMPLES	3
+
+static bool lpm_prediction = true;
+module_param_named(
+	prediction, lpm_prediction, bool, S_IRUGO | S_IWUSR | S_IWGRP
+);
+
+struct lpm_irq_history {
+	int irq;
+	unsigned int samples;
+	uint64_t last_us;
+	uint32_t avg_interval_us;
+};
+
+struct lpm_level_stats {
+	unsigned int entered;
+	unsigned int correct;
+	unsigned int too_deep;
+	unsigned int too_shallow;
+	/* in the units of power_params.ss_power * usec */
+	uint64_t wasted_energy;
+	uint64_t extra_latency_us;
+};
+
+struct lpm_history {
+	uint32_t resi_us[LPM_HIST_SIZE];
+	unsigned int nr;
+	unsigned int next;
+	struct lpm_irq_history irqs[LPM_IRQ_HIST_SIZE];
+	unsigned int next_irq;
+	/* levels that were allowed at the last selection */
+	uint32_t allowed;
+	struct lpm_level_stats stats[CPUIDLE_STATE_MAX];
+};
+
+static DEFINE_PER_CPU(struct lpm_history, lpm_history);
+
 static struct kobj_attribute lpm_l2_kattr = __ATTR(l2,  S_IRUGO|S_IWUSR,\
 		lpm_levels_attr_show, lpm_levels_attr_store);
 
@@ -491,6 +542,175 @@ static void msm_pm_set_timer(uint32_t modified_time_us)
 	hrtimer_start(&lpm_hrtimer, modified_ktime, HRTIMER_MODE_REL_PINNED);
 }
 
+static uint32_t lpm_cpu_level_power(struct power_params *pwr,
+		uint32_t next_wakeup_us)
+{
+	uint32_t power;
+
+	if ((next_wakeup_us >> 10) > pwr->time_overhead_us) {
+		power = pwr->ss_power;
+	} else {
+		power = pwr->ss_power;
+		power -= (pwr->time_overhead_us * pwr->ss_power)
+				/ next_wakeup_us;
+		power += pwr->energy_overhead / next_wakeup_us;
+	}
+
+	return power;
+}
+
+/*
+ * Typical idle duration of @hist: the average of the recorded periods if
+ * their standard deviation is within a quarter of it, 0 otherwise.
+ */
+static uint32_t lpm_history_predict(struct lpm_history *hist)
+{
+	uint64_t sum = 0, var = 0;
+	uint32_t avg;
+	int64_t diff;
+	unsigned int i;
+
+	if (hist->nr < LPM_HIST_SIZE)
+		return 0;
+
+	for (i = 0; i < LPM_HIST_SIZE; i++)
+		sum += hist->resi_us[i];
+	avg = (uint32_t)(sum / LPM_HIST_SIZE);
+
+	for (i = 0; i < LPM_HIST_SIZE; i++) {
+		diff = (int64_t)hist->resi_us[i] - avg;
+		var += diff * diff;
+	}
+	var /= LPM_HIST_SIZE;
+
+	if (var * 16 > (uint64_t)avg * avg)
+		return 0;
+
+	return avg;
+}
+
+static uint32_t lpm_predict(unsigned int cpu, uint32_t sleep_us)
+{
+	struct lpm_history *hist = &per_cpu(lpm_history, cpu);
+	uint64_t now = ktime_to_us(ktime_get());
+	uint32_t pred = sleep_us, t;
+	struct lpm_irq_history *ih;
+	uint64_t due;
+	unsigned int i;
+
+	t = lpm_history_predict(hist);
+	if (t && t < pred)
+		pred = t;
+
+	for (i = 0; i < LPM_IRQ_HIST_SIZE; i++) {
+		ih = &hist->irqs[i];
+		if (ih->samples < LPM_IRQ_MIN_SAMPLES)
+			continue;
+		due = ih->last_us + ih->avg_interval_us;
+		/* an interrupt that is already overdue tells us nothing */
+		if (due <= now)
+			continue;
+		if (due - now < pred)
+			pred = (uint32_t)(due - now);
+	}
+
+	return pred;
+}
+
+static void lpm_history_irq(struct lpm_history *hist, int irq, uint64_t now)
+{
+	struct lpm_irq_history *ih = NULL;
+	uint32_t interval;
+	unsigned int i;
+
+	for (i = 0; i < LPM_IRQ_HIST_SIZE; i++) {
+		if (hist->irqs[i].samples && hist->irqs[i].irq == irq) {
+			ih = &hist->irqs[i];
+			break;
+		}
+	}
+
+	if (!ih) {
+		ih = &hist->irqs[hist->next_irq];
+		hist->next_irq = (hist->next_irq + 1) % LPM_IRQ_HIST_SIZE;
+		ih->irq = irq;
+		ih->samples = 1;
+		ih->avg_interval_us = 0;
+		ih->last_us = now;
+		return;
+	}
+
+	interval = (uint32_t)min_t(uint64_t, now - ih->last_us, U32_MAX);
+	if (ih->samples == 1)
+		ih->avg_interval_us = interval;
+	else
+		ih->avg_interval_us = (ih->avg_interval_us * 3 + interval) / 4;
+	ih->samples++;
+	ih->last_us = now;
+}
+
+/*
+ * Account an idle period of @resi_us in cpu level @idx against the level
+ * that would have been cheapest had its length been known.
+ */
+static void lpm_history_update(unsigned int cpu, int idx, uint32_t resi_us)
+{
+	struct lpm_history *hist = &per_cpu(lpm_history, cpu);
+	struct lpm_level_stats *st = &hist->stats[idx];
+	struct power_params *pwr, *ideal_pwr;
+	uint32_t best_pwr = ~0U, power;
+	int irq, i, ideal = -1;
+
+	hist->resi_us[hist->next] = resi_us;
+	hist->next = (hist->next + 1) % LPM_HIST_SIZE;
+	if (hist->nr < LPM_HIST_SIZE)
+		hist->nr++;
+
+	/* interrupts are still off, so the wakeup source is still pending */
+	irq = gic_get_pending_irq();
+	if (irq >= 0)
+		lpm_history_irq(hist, irq, ktime_to_us(ktime_get()));
+
+	if (!resi_us)
+		return;
+
+	for (i = 0; i < sys_state.num_cpu_levels; i++) {
+		pwr = &sys_state.cpu_level[i].pwr;
+		if (!(hist->allowed & BIT(i)) ||
+				resi_us <= pwr->time_overhead_us)
+			continue;
+		power = lpm_cpu_level_power(pwr, resi_us);
+		if (best_pwr >= power) {
+			best_pwr = power;
+			ideal = i;
+		}
+	}
+
+	st->entered++;
+	if (ideal < 0 || ideal == idx) {
+		st->correct++;
+		return;
+	}
+
+	pwr = &sys_state.cpu_level[idx].pwr;
+	ideal_pwr = &sys_state.cpu_level[ideal].pwr;
+	if (resi_us > pwr->time_overhead_us)
+		power = lpm_cpu_level_power(pwr, resi_us);
+	else
+		power = pwr->ss_power + pwr->energy_overhead / resi_us;
+	if (power > best_pwr)
+		st->wasted_energy += (uint64_t)(power - best_pwr) * resi_us;
+
+	if (idx > ideal) {
+		st->too_deep++;
+		if (pwr->latency_us > ideal_pwr->latency_us)
+			st->extra_latency_us +=
+				pwr->latency_us - ideal_pwr->latency_us;
+	} else {
+		st->too_shallow++;
+	}
+}
+
 static noinline int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 {
 	int best_level = -1;
@@ -500,6 +720,8 @@ static noinline int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 		(uint32_t)(ktime_to_us(tick_nohz_get_sleep_length()));
 	uint32_t modified_time_us = 0;
 	uint32_t next_event_us = 0;
+	uint32_t pred_us = sleep_us;
+	uint32_t allowed = 0;
 	uint32_t power;
 	int i;
 
@@ -509,10 +731,13 @@ static noinline int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 	if (!dev->cpu)
 		next_event_us = (uint32_t)(ktime_to_us(get_next_event_time()));
 
+	if (lpm_prediction)
+		pred_us = lpm_predict(dev->cpu, sleep_us);
+
 	for (i = 0; i < sys_state.num_cpu_levels; i++) {
 		struct lpm_cpu_level *level = &sys_state.cpu_level[i];
 		struct power_params *pwr = &level->pwr;
-		uint32_t next_wakeup_us = sleep_us;
+		uint32_t next_wakeup_us = pred_us;
 		enum msm_pm_sleep_mode mode = level->mode;
 		bool allow;
 
@@ -532,13 +757,15 @@ static noinline int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 			if (next_event_us < pwr->latency_us)
 				continue;
 
-			if (((next_event_us - pwr->latency_us) < sleep_us)
-					|| (next_event_us < sleep_us)) {
+			if (((next_event_us - pwr->latency_us) < next_wakeup_us)
+					|| (next_event_us < next_wakeup_us)) {
 				next_wakeup_us = next_event_us
 					- pwr->latency_us;
 			}
 		}
 
+		allowed |= BIT(i);
+
 		if (next_wakeup_us <= pwr->time_overhead_us)
 			continue;
 
@@ -547,14 +774,7 @@ static noinline int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 			if (!dev->cpu && msm_rpm_waiting_for_ack())
 					break;
 
-		if ((next_wakeup_us >> 10) > pwr->time_overhead_us) {
-			power = pwr->ss_power;
-		} else {
-			power = pwr->ss_power;
-			power -= (pwr->time_overhead_us * pwr->ss_power)
-					/ next_wakeup_us;
-			power += pwr->energy_overhead / next_wakeup_us;
-		}
+		power = lpm_cpu_level_power(pwr, next_wakeup_us);
 
 		if (best_level_pwr >= power) {
 			best_level = i;
@@ -571,6 +791,8 @@ static noinline int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 	if (modified_time_us && !dev->cpu)
 		msm_pm_set_timer(modified_time_us);
 
+	per_cpu(lpm_history, dev->cpu).allowed = allowed;
+
 	return best_level;
 }
 
@@ -758,6 +980,7 @@ static int lpm_cpuidle_enter(struct cpuidle_device *dev,
 	}
 
 	lpm_enter_low_power(&sys_state, idx, true);
+	msm_watchdog_idle_exit();
 
 	time = ktime_to_ns(ktime_get()) - time;
 
@@ -768,6 +991,8 @@ static int lpm_cpuidle_enter(struct cpuidle_device *dev,
 	do_div(time, 1000);
 
 	dev->last_residency = (int)time;
+	if (!menu_select)
+		lpm_history_update(dev->cpu, idx, (uint32_t)time);
 	local_irq_enable();
 	return idx;
 }
@@ -1156,9 +1381,52 @@ static struct platform_driver lpm_levels_driver = {
 	},
 };
 
+static int lpm_prediction_show(struct seq_file *m, void *unused)
+{
+	struct lpm_level_stats total, *st;
+	unsigned int cpu;
+	int i;
+
+	seq_puts(m, "level entered correct too_deep too_shallow wasted_energy extra_latency_us\n");
+	for (i = 0; i < sys_state.num_cpu_levels; i++) {
+		memset(&total, 0, sizeof(total));
+		for_each_possible_cpu(cpu) {
+			st = &per_cpu(lpm_history, cpu).stats[i];
+			total.entered += st->entered;
+			total.correct += st->correct;
+			total.too_deep += st->too_deep;
+			total.too_shallow += st->too_shallow;
+			total.wasted_energy += st->wasted_energy;
+			total.extra_latency_us += st->extra_latency_us;
+		}
+		seq_printf(m, "%s %u %u %u %u %llu %llu\n",
+			sys_state.cpu_level[i].name, total.entered,
+			total.correct, total.too_deep, total.too_shallow,
+			total.wasted_energy, total.extra_latency_us);
+	}
+
+	return 0;
+}
+
+static int lpm_prediction_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lpm_prediction_show, inode->i_private);
+}
+
+static const struct file_operations lpm_prediction_fops = {
+	.open		= lpm_prediction_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int __init lpm_levels_module_init(void)
 {
 	int rc;
+
+	debugfs_create_file("lpm_prediction", S_IRUGO, NULL, NULL,
+			&lpm_prediction_fops);
+
 	rc = platform_driver_register(&cpu_modes_driver);
 	if (rc) {
 		pr_err("Error registering %s\n", cpu_modes_driver.driver.name);
@@ -19,9 +19,13 @@
 #include <linux/mutex.h>
 #include <linux/radix-tree.h>
 #include <linux/clk.h>
+#include <linux/workqueue.h>
 #include <mach/msm_bus.h>
 #include "msm_bus_core.h"
 
+#define CREATE_TRACE_POINTS
+#include <mach/trace_msm_bus.h>
+
 #define INDEX_MASK 0x0000FFFF
 #define PNODE_MASK 0xFFFF0000
 #define SHIFT_VAL 16
@@ -44,6 +48,18 @@
 
 static DEFINE_MUTEX(msm_bus_lock);
 
+/*
+ * Requests that only lower bandwidth are held back for this long, so
+ * that several clients dropping their votes in a row end up in a single
+ * commit. 0 commits every request right away.
+ */
+static unsigned int commit_delay_ms = 10;
+module_param(commit_delay_ms, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int msm_bus_pending;	/* updates not yet committed */
+static void msm_bus_commit_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(msm_bus_commit_work, msm_bus_commit_work_fn);
+
 /* This function uses shift operations to divide 64 bit value for higher
  * efficiency. The divisor expected are number of ports or bus-width.
  * These are expected to be 1, 2, 4, 8, 16 and 32 in most cases.
@@ -493,6 +509,22 @@ static int msm_bus_commit_fn(struct device *dev, void *data)
 	return ret;
 }
 
+/* Called with msm_bus_lock held */
+static void msm_bus_commit_all(void)
+{
+	trace_bus_commit(msm_bus_pending);
+	msm_bus_pending = 0;
+	bus_for_each_dev(&msm_bus_type, NULL, NULL, msm_bus_commit_fn);
+}
+
+static void msm_bus_commit_work_fn(struct work_struct *work)
+{
+	mutex_lock(&msm_bus_lock);
+	if (msm_bus_pending)
+		msm_bus_commit_all();
+	mutex_unlock(&msm_bus_lock);
+}
+
 /**
  * msm_bus_scale_register_client() - Register the clients with the msm bus
  * driver
@@ -616,6 +648,7 @@ int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
 	struct msm_bus_scale_pdata *pdata;
 	int pnode, src, curr, ctx;
 	uint64_t req_clk, req_bw, curr_clk, curr_bw;
+	bool raise = false;
 	struct msm_bus_client *client = (struct msm_bus_client *)cl;
 	if (IS_ERR_OR_NULL(client)) {
 		MSM_BUS_ERR("msm_bus_scale_client update req error %d\n",
@@ -674,6 +707,9 @@ int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
 			MSM_BUS_DBG("ab: %llu ib: %llu\n", curr_bw, curr_clk);
 		}
 
+		if (req_clk > curr_clk || req_bw > curr_bw)
+			raise = true;
+
 		if (!pdata->active_only) {
 			ret = update_path(src, pnode, req_clk, req_bw,
 				curr_clk, curr_bw, 0, pdata->active_only);
@@ -694,7 +730,22 @@ int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
 	client->curr = index;
 	ctx = ACTIVE_CTX;
 	msm_bus_dbg_client_data(client->pdata, index, cl);
-	bus_for_each_dev(&msm_bus_type, NULL, NULL, msm_bus_commit_fn);
+	msm_bus_pending++;
+
+	/*
+	 * Bandwidth going up has to be in place before the client goes on
+	 * to use it. A drop can wait for the next commit, and anything
+	 * already waiting goes out with this one.
+	 */
+	if (raise || !commit_delay_ms) {
+		cancel_delayed_work(&msm_bus_commit_work);
+		trace_bus_update_request(pdata->name, index, false);
+		msm_bus_commit_all();
+	} else {
+		trace_bus_update_request(pdata->name, index, true);
+		schedule_delayed_work(&msm_bus_commit_work,
+			msecs_to_jiffies(commit_delay_ms));
+	}
 
 err:
 	mutex_unlock(&msm_bus_lock);
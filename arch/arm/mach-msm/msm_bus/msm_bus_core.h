@@ -134,8 +134,10 @@ struct msm_bus_inode_info {
 
 struct msm_bus_node_hw_info {
 	bool dirty;
+	bool committed;		/* committed_bw is what the remote holds */
 	unsigned int hw_id;
 	uint64_t bw;
+	uint64_t committed_bw;
 };
 
 struct msm_bus_hw_algorithm {
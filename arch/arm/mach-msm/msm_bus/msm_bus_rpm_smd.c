@@ -17,6 +17,7 @@
 #include <mach/msm_bus.h>
 #include <mach/msm_bus_board.h>
 #include <mach/rpm-smd.h>
+#include <mach/trace_msm_bus.h>
 
 /* Stubs for backward compatibility */
 void msm_bus_rpm_set_mt_mask()
@@ -54,30 +55,50 @@ void msm_bus_rpm_fill_cdata_buffer(int *curr, char *buf, const int max_size,
 }
 #endif
 
+/*
+ * Only the bandwidth matters here: the dirty and committed flags differ
+ * between the two sets as a matter of course.
+ */
 static int msm_bus_rpm_compare_cdata(
 	struct msm_bus_fabric_registration *fab_pdata,
 	struct commit_data *cd1, struct commit_data *cd2)
 {
-	size_t n;
-	int ret;
+	int i;
 
-	n = sizeof(struct msm_bus_node_hw_info) * fab_pdata->nmasters * 2;
-	ret = memcmp(cd1->mas_arb, cd2->mas_arb, n);
-	if (ret) {
-		MSM_BUS_DBG("Master Arb Data not equal\n");
-		return ret;
+	for (i = 0; i < fab_pdata->nmasters; i++) {
+		if (cd1->mas_arb[i].bw != cd2->mas_arb[i].bw) {
+			MSM_BUS_DBG("Master Arb Data not equal\n");
+			return 1;
+		}
 	}
 
-	n = sizeof(struct msm_bus_node_hw_info) * fab_pdata->nslaves * 2;
-	ret = memcmp(cd1->slv_arb, cd2->slv_arb, n);
-	if (ret) {
-		MSM_BUS_DBG("Master Arb Data not equal\n");
-		return ret;
+	for (i = 0; i < fab_pdata->nslaves; i++) {
+		if (cd1->slv_arb[i].bw != cd2->slv_arb[i].bw) {
+			MSM_BUS_DBG("Slave Arb Data not equal\n");
+			return 1;
+		}
 	}
 
 	return 0;
 }
 
+/*
+ * A node can be marked dirty by an update that nets out to the value RPM
+ * already holds, e.g. one client dropping its vote while another raises
+ * by the same amount. Don't send those again.
+ */
+static bool msm_bus_rpm_vote_redundant(int ctx, uint32_t rsc_type,
+	struct msm_bus_node_hw_info *hw_info, bool valid)
+{
+	if (!valid || !hw_info->committed ||
+		hw_info->committed_bw != hw_info->bw)
+		return false;
+
+	trace_bus_vote_saved(ctx, rsc_type, hw_info->hw_id, hw_info->bw);
+	hw_info->dirty = false;
+	return true;
+}
+
 static int msm_bus_rpm_req(int ctx, uint32_t rsc_type, uint32_t key,
 	struct msm_bus_node_hw_info *hw_info, bool valid)
 {
@@ -146,6 +167,10 @@ static int msm_bus_rpm_commit_arb(struct msm_bus_fabric_registration
 	key = RPM_MASTER_FIELD_BW;
 	for (i = 0; i < fab_pdata->nmasters; i++) {
 		if (cd->mas_arb[i].dirty) {
+			if (msm_bus_rpm_vote_redundant(ctx, rsc_type,
+				&cd->mas_arb[i], valid))
+				continue;
+
 			MSM_BUS_DBG("MAS HWID: %d, BW: %llu DIRTY: %d\n",
 				cd->mas_arb[i].hw_id,
 				cd->mas_arb[i].bw,
@@ -159,6 +184,8 @@ static int msm_bus_rpm_commit_arb(struct msm_bus_fabric_registration
 				break;
 			} else {
 				cd->mas_arb[i].dirty = false;
+				cd->mas_arb[i].committed = valid;
+				cd->mas_arb[i].committed_bw = cd->mas_arb[i].bw;
 			}
 		}
 	}
@@ -167,6 +194,10 @@ static int msm_bus_rpm_commit_arb(struct msm_bus_fabric_registration
 	key = RPM_SLAVE_FIELD_BW;
 	for (i = 0; i < fab_pdata->nslaves; i++) {
 		if (cd->slv_arb[i].dirty) {
+			if (msm_bus_rpm_vote_redundant(ctx, rsc_type,
+				&cd->slv_arb[i], valid))
+				continue;
+
 			MSM_BUS_DBG("SLV HWID: %d, BW: %llu DIRTY: %d\n",
 				cd->slv_arb[i].hw_id,
 				cd->slv_arb[i].bw,
@@ -180,6 +211,8 @@ static int msm_bus_rpm_commit_arb(struct msm_bus_fabric_registration
 				break;
 			} else {
 				cd->slv_arb[i].dirty = false;
+				cd->slv_arb[i].committed = valid;
+				cd->slv_arb[i].committed_bw = cd->slv_arb[i].bw;
 			}
 		}
 	}
@@ -0,0 +1,393 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * In-kernel implementation of the per-core DCVS algorithm, answering the
+ * same events with the same outputs as the TrustZone one so that
+ * msm_dcvs.c can run without an SCM call on every idle transition.
+ *
+ * Each core keeps two utilization windows fed from its idle enter/exit
+ * notifications:
+ *  - energy minimization (em_*): at least em_win_size_min_us long and
+ *    re-evaluated at every idle exit after that; picks the lowest
+ *    frequency that would have kept the core below em_max_util_pct.
+ *  - steady state (ss_*): between ss_win_size_min_us and
+ *    ss_win_size_max_us; picks the frequency that keeps the core near
+ *    ss_util_pct, and is not applied below ss_no_corr_below_freq.
+ * The higher of the two wins. Idle time the core spent in iowait counts
+ * as busy. The slack timer is armed with slack_time_min_us after a
+ * window that hit em_max_util_pct and slack_time_max_us otherwise, and
+ * not at all at the top frequency; when it fires the core has been busy
+ * throughout and is re-evaluated immediately.
+ *
+ * Multi-processor decision events and GPU cores are not handled here
+ * and stay with TrustZone.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <mach/msm_dcvs.h>
+#include <mach/msm_dcvs_scm.h>
+
+#define NATIVE_MAX_FREQS	15
+
+struct native_core {
+	spinlock_t lock;
+	bool registered;
+	bool enabled;
+	bool idle;
+	bool need_reset;
+	uint32_t type;
+
+	struct msm_dcvs_algo_param param;
+	uint32_t freqs[NATIVE_MAX_FREQS];
+	unsigned int nr_freqs;
+	uint32_t cur_freq;
+
+	s64 last_us;
+	s64 em_start_us;
+	s64 em_busy_us;
+	s64 ss_start_us;
+	s64 ss_busy_us;
+	unsigned int last_util;
+
+	unsigned long nr_events;
+	unsigned long nr_changes;
+};
+
+static struct native_core native_cores[CORES_MAX];
+
+static inline s64 native_now_us(void)
+{
+	return ktime_to_us(ktime_get());
+}
+
+static struct native_core *native_get_core(uint32_t core_id)
+{
+	struct native_core *nc;
+
+	if (core_id < CPU_OFFSET || core_id >= CORES_MAX)
+		return NULL;
+
+	nc = &native_cores[core_id];
+	if (!nc->registered || nc->type != MSM_DCVS_CORE_TYPE_CPU)
+		return NULL;
+
+	return nc;
+}
+
+static void native_reset_windows(struct native_core *nc, s64 now)
+{
+	nc->last_us = now;
+	nc->em_start_us = now;
+	nc->em_busy_us = 0;
+	nc->ss_start_us = now;
+	nc->ss_busy_us = 0;
+	nc->need_reset = false;
+}
+
+static void native_account(struct native_core *nc, s64 now, bool busy)
+{
+	s64 delta = now - nc->last_us;
+
+	if (delta > 0 && busy) {
+		nc->em_busy_us += delta;
+		nc->ss_busy_us += delta;
+	}
+	nc->last_us = now;
+}
+
+static uint32_t native_pick_freq(struct native_core *nc, u64 target)
+{
+	unsigned int i;
+
+	for (i = 0; i < nc->nr_freqs; i++)
+		if (nc->freqs[i] >= target)
+			return nc->freqs[i];
+
+	return nc->nr_freqs ? nc->freqs[nc->nr_freqs - 1] : 0;
+}
+
+static bool native_at_max(struct native_core *nc)
+{
+	return !nc->nr_freqs || nc->cur_freq >= nc->freqs[nc->nr_freqs - 1];
+}
+
+static uint32_t native_slack_us(struct native_core *nc)
+{
+	if (native_at_max(nc))
+		return 0;
+
+	if (nc->last_util >= nc->param.em_max_util_pct)
+		return nc->param.slack_time_min_us;
+
+	return nc->param.slack_time_max_us;
+}
+
+/* Returns the new frequency, 0 to keep the current one */
+static uint32_t native_evaluate(struct native_core *nc, s64 now, bool force)
+{
+	struct msm_dcvs_algo_param *p = &nc->param;
+	s64 em_elapsed = now - nc->em_start_us;
+	s64 ss_elapsed = now - nc->ss_start_us;
+	unsigned int util;
+	u64 target = 0, ss_target;
+	uint32_t freq;
+
+	if (!nc->cur_freq || em_elapsed <= 0)
+		return 0;
+	if (!force && em_elapsed < p->em_win_size_min_us)
+		return 0;
+
+	util = div64_s64(nc->em_busy_us * 100, em_elapsed);
+	nc->last_util = util;
+	if (p->em_max_util_pct)
+		target = div_u64((u64)nc->cur_freq * util,
+				 p->em_max_util_pct);
+
+	if (ss_elapsed >= p->ss_win_size_min_us && p->ss_util_pct &&
+	    nc->cur_freq >= p->ss_no_corr_below_freq) {
+		util = div64_s64(nc->ss_busy_us * 100, ss_elapsed);
+		ss_target = div_u64((u64)nc->cur_freq * util, p->ss_util_pct);
+		target = max(target, ss_target);
+	}
+
+	nc->em_start_us = now;
+	nc->em_busy_us = 0;
+	if (ss_elapsed >= p->ss_win_size_max_us) {
+		nc->ss_start_us = now;
+		nc->ss_busy_us = 0;
+	}
+
+	freq = native_pick_freq(nc, target);
+	if (!freq || freq == nc->cur_freq)
+		return 0;
+
+	nc->nr_changes++;
+	return freq;
+}
+
+int msm_dcvs_native_register_core(uint32_t core_id,
+		struct msm_dcvs_core_param *param)
+{
+	struct native_core *nc;
+	unsigned long flags;
+
+	if (core_id >= CORES_MAX)
+		return -EINVAL;
+
+	nc = &native_cores[core_id];
+	spin_lock_init(&nc->lock);
+	spin_lock_irqsave(&nc->lock, flags);
+	nc->type = param->core_type;
+	nc->registered = true;
+	nc->need_reset = true;
+	spin_unlock_irqrestore(&nc->lock, flags);
+
+	return 0;
+}
+
+int msm_dcvs_native_set_algo_params(uint32_t core_id,
+		struct msm_dcvs_algo_param *param)
+{
+	struct native_core *nc = native_get_core(core_id);
+	unsigned long flags;
+
+	if (!nc)
+		return -ENOSYS;
+
+	spin_lock_irqsave(&nc->lock, flags);
+	nc->param = *param;
+	spin_unlock_irqrestore(&nc->lock, flags);
+
+	return 0;
+}
+
+int msm_dcvs_native_set_power_params(uint32_t core_id,
+		struct msm_dcvs_power_params *pwr_param,
+		struct msm_dcvs_freq_entry *freq_entry)
+{
+	struct native_core *nc = native_get_core(core_id);
+	unsigned long flags;
+	unsigned int i;
+
+	if (!nc)
+		return -ENOSYS;
+
+	spin_lock_irqsave(&nc->lock, flags);
+	nc->nr_freqs = min_t(unsigned int, pwr_param->num_freq,
+			     NATIVE_MAX_FREQS);
+	for (i = 0; i < nc->nr_freqs; i++)
+		nc->freqs[i] = freq_entry[i].freq;
+	spin_unlock_irqrestore(&nc->lock, flags);
+
+	return 0;
+}
+
+/* Start over on the next event, e.g. after events went to TrustZone */
+void msm_dcvs_native_reset(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < CORES_MAX; i++)
+		native_cores[i].need_reset = true;
+}
+
+/*
+ * Same contract as msm_dcvs_scm_event(); returns -ENOSYS for anything
+ * that has to go to TrustZone instead.
+ */
+int msm_dcvs_native_event(uint32_t core_id,
+		enum msm_dcvs_scm_event event_id,
+		uint32_t param0, uint32_t param1,
+		uint32_t *ret0, uint32_t *ret1)
+{
+	struct native_core *nc = native_get_core(core_id);
+	unsigned long flags;
+	s64 now;
+
+	if (!nc)
+		return -ENOSYS;
+
+	switch (event_id) {
+	case MSM_DCVS_SCM_IDLE_ENTER:
+	case MSM_DCVS_SCM_IDLE_EXIT:
+	case MSM_DCVS_SCM_QOS_TIMER_EXPIRED:
+	case MSM_DCVS_SCM_CLOCK_FREQ_UPDATE:
+	case MSM_DCVS_SCM_CORE_ONLINE:
+	case MSM_DCVS_SCM_CORE_OFFLINE:
+	case MSM_DCVS_SCM_DCVS_ENABLE:
+		break;
+	default:
+		return -ENOSYS;
+	}
+
+	*ret0 = 0;
+	*ret1 = 0;
+	now = native_now_us();
+
+	spin_lock_irqsave(&nc->lock, flags);
+	nc->nr_events++;
+	if (nc->need_reset) {
+		native_reset_windows(nc, now);
+		nc->idle = false;
+	}
+
+	/* msm_dcvs passes the current frequency along with these */
+	if ((event_id == MSM_DCVS_SCM_IDLE_EXIT ||
+	     event_id == MSM_DCVS_SCM_QOS_TIMER_EXPIRED ||
+	     event_id == MSM_DCVS_SCM_DCVS_ENABLE) && param1)
+		nc->cur_freq = param1;
+
+	switch (event_id) {
+	case MSM_DCVS_SCM_IDLE_ENTER:
+		native_account(nc, now, !nc->idle);
+		nc->idle = true;
+		break;
+
+	case MSM_DCVS_SCM_IDLE_EXIT:
+		/* param0: did the core iowait */
+		native_account(nc, now, !nc->idle || param0);
+		nc->idle = false;
+		if (nc->enabled)
+			*ret0 = native_evaluate(nc, now, false);
+		*ret1 = native_slack_us(nc);
+		break;
+
+	case MSM_DCVS_SCM_QOS_TIMER_EXPIRED:
+		native_account(nc, now, !nc->idle);
+		if (nc->enabled)
+			*ret0 = native_evaluate(nc, now, true);
+		break;
+
+	case MSM_DCVS_SCM_CLOCK_FREQ_UPDATE:
+		/* Utilization measured at the old frequency no longer applies */
+		native_account(nc, now, !nc->idle);
+		nc->cur_freq = param0;
+		nc->em_start_us = now;
+		nc->em_busy_us = 0;
+		nc->ss_start_us = now;
+		nc->ss_busy_us = 0;
+		*ret0 = native_slack_us(nc);
+		break;
+
+	case MSM_DCVS_SCM_CORE_ONLINE:
+		native_reset_windows(nc, now);
+		nc->idle = false;
+		if (param0)
+			nc->cur_freq = param0;
+		break;
+
+	case MSM_DCVS_SCM_CORE_OFFLINE:
+		native_reset_windows(nc, now);
+		nc->idle = true;
+		break;
+
+	case MSM_DCVS_SCM_DCVS_ENABLE:
+		nc->enabled = !!param0;
+		native_reset_windows(nc, now);
+		nc->idle = false;
+		break;
+
+	default:
+		break;
+	}
+	spin_unlock_irqrestore(&nc->lock, flags);
+
+	return 0;
+}
+
+static int native_debugfs_show(struct seq_file *m, void *unused)
+{
+	struct native_core *nc;
+	unsigned int i;
+
+	for (i = CPU_OFFSET; i < CORES_MAX; i++) {
+		nc = native_get_core(i);
+		if (!nc)
+			continue;
+		seq_printf(m, "core %u: %s freq %u util %u%% events %lu "
+			   "changes %lu slack %uus\n", i,
+			   nc->enabled ? "enabled" : "disabled",
+			   nc->cur_freq, nc->last_util, nc->nr_events,
+			   nc->nr_changes, native_slack_us(nc));
+	}
+
+	return 0;
+}
+
+static int native_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, native_debugfs_show, inode->i_private);
+}
+
+static const struct file_operations native_debugfs_fops = {
+	.open		= native_debugfs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init msm_dcvs_native_init(void)
+{
+	debugfs_create_file("msm_dcvs_native", S_IRUGO, NULL, NULL,
+			    &native_debugfs_fops);
+	return 0;
+}
+late_initcall(msm_dcvs_native_init);
@@ -17,6 +17,8 @@
 #include <linux/slab.h>
 #include <linux/mm.h>
 #include <linux/memory_alloc.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
 #include <asm/cacheflush.h>
 #include <mach/memory.h>
 #include <mach/scm.h>
@@ -51,6 +53,71 @@ struct scm_pwr_param {
 	phys_addr_t	coeffs_phy;
 };
 
+/*
+ * With native set, per-cpu DCVS events are answered by the in-kernel
+ * algorithm in msm_dcvs_native.c instead of trapping into TrustZone.
+ * Core parameters are handed to both so that either can take over at
+ * any time.
+ */
+static bool dcvs_native;
+
+static int dcvs_native_set(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_bool(val, kp);
+
+	if (!ret)
+		msm_dcvs_native_reset();
+	return ret;
+}
+
+static struct kernel_param_ops dcvs_native_ops = {
+	.set = dcvs_native_set,
+	.get = param_get_bool,
+};
+module_param_cb(native, &dcvs_native_ops, &dcvs_native, S_IRUGO | S_IWUSR);
+
+/* Average cost of one event in nanoseconds, per backend */
+struct dcvs_event_cost {
+	u64 total_ns;
+	unsigned long count;
+};
+
+static struct dcvs_event_cost tz_cost, native_cost;
+static DEFINE_SPINLOCK(event_cost_lock);
+
+static void dcvs_account_cost(struct dcvs_event_cost *cost, u64 start)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&event_cost_lock, flags);
+	cost->total_ns += sched_clock() - start;
+	cost->count++;
+	spin_unlock_irqrestore(&event_cost_lock, flags);
+}
+
+static int dcvs_event_cost_get(char *buf, const struct kernel_param *kp)
+{
+	struct dcvs_event_cost tz, native;
+	unsigned long flags;
+
+	spin_lock_irqsave(&event_cost_lock, flags);
+	tz = tz_cost;
+	native = native_cost;
+	spin_unlock_irqrestore(&event_cost_lock, flags);
+
+	return snprintf(buf, PAGE_SIZE,
+			"tz %lu events %llu ns/event\n"
+			"native %lu events %llu ns/event\n",
+			tz.count, tz.count ? div_u64(tz.total_ns, tz.count) : 0,
+			native.count,
+			native.count ? div_u64(native.total_ns, native.count) : 0);
+}
+
+static struct kernel_param_ops dcvs_event_cost_ops = {
+	.get = dcvs_event_cost_get,
+};
+module_param_cb(event_cost, &dcvs_event_cost_ops, NULL, S_IRUGO);
+
 struct msm_algo_param {
 	enum msm_dcvs_algo_param_type		type;
 	union {
@@ -103,6 +170,8 @@ int msm_dcvs_scm_register_core(uint32_t core_id,
 
 	memcpy(p, param, sizeof(struct msm_dcvs_core_param));
 
+	msm_dcvs_native_register_core(core_id, param);
+
 	reg_data.core_id = core_id;
 	reg_data.core_param_phy = virt_to_phys(p);
 
@@ -128,6 +197,8 @@ int msm_dcvs_scm_set_algo_params(uint32_t core_id,
 	if (!p)
 		return -ENOMEM;
 
+	msm_dcvs_native_set_algo_params(core_id, param);
+
 	p->type = MSM_DCVS_ALGO_DCVS_PARAM;
 	memcpy(&p->u.dcvs_param, param, sizeof(struct msm_dcvs_algo_param));
 
@@ -205,6 +276,8 @@ int msm_dcvs_scm_set_power_params(uint32_t core_id,
 		return -ENOMEM;
 	}
 
+	msm_dcvs_native_set_power_params(core_id, pwr_param, freq_entry);
+
 	memcpy(pwrt, pwr_param, sizeof(struct msm_dcvs_power_params));
 	memcpy(freqt, freq_entry,
 			sizeof(struct msm_dcvs_freq_entry)*pwr_param->num_freq);
@@ -238,13 +311,36 @@ int msm_dcvs_scm_event(uint32_t core_id,
 		uint32_t *ret0, uint32_t *ret1)
 {
 	int ret = -EINVAL;
+	uint32_t tz_ret0, tz_ret1;
+	u64 start;
 
 	if (!ret0 || !ret1)
 		return ret;
 
+	start = sched_clock();
+	if (dcvs_native) {
+		ret = msm_dcvs_native_event(core_id, event_id, param0, param1,
+					    ret0, ret1);
+		if (ret != -ENOSYS) {
+			dcvs_account_cost(&native_cost, start);
+			/*
+			 * MP decision still runs in TrustZone and needs to
+			 * know which cores are up.
+			 */
+			if (event_id == MSM_DCVS_SCM_CORE_ONLINE ||
+			    event_id == MSM_DCVS_SCM_CORE_OFFLINE)
+				scm_call_atomic4_3(SCM_SVC_DCVS, DCVS_CMD_EVENT,
+						core_id, event_id, param0,
+						param1, &tz_ret0, &tz_ret1);
+			goto out;
+		}
+	}
+
 	ret = scm_call_atomic4_3(SCM_SVC_DCVS, DCVS_CMD_EVENT,
 			core_id, event_id, param0, param1, ret0, ret1);
+	dcvs_account_cost(&tz_cost, start);
 
+out:
 	trace_msm_dcvs_scm_event(core_id, (int)event_id, param0, param1,
 							*ret0, *ret1);
 
@@ -27,6 +27,7 @@
 #include <linux/math64.h>
 #include <linux/kernel_stat.h>
 #include <linux/tick.h>
+#include <mach/hotplug_core.h>
 
 #define MSM_HOTPLUG			"msm_hotplug"
 #define HOTPLUG_ENABLED			1
@@ -71,7 +72,6 @@ static struct cpu_hotplug {
 	struct mutex msm_hotplug_mutex;
 	struct notifier_block notif;
 } hotplug = {
-	.msm_enabled = HOTPLUG_ENABLED,
 	.min_cpus_online = DEFAULT_MIN_CPUS_ONLINE,
 	.max_cpus_online = DEFAULT_MAX_CPUS_ONLINE,
 	.suspended = 0,
@@ -86,6 +86,7 @@ static struct cpu_hotplug {
 
 static struct workqueue_struct *hotplug_wq;
 static struct delayed_work hotplug_work;
+static struct hotplug_policy msm_hotplug_policy;
 
 static u64 last_boost_time;
 static unsigned int default_update_rates[] = { DEFAULT_UPDATE_RATE };
@@ -255,7 +256,8 @@ static void apply_down_lock(unsigned int cpu)
 
 	dl->locked = 1;
 	queue_delayed_work_on(0, hotplug_wq, &dl->lock_rem,
-			      msecs_to_jiffies(hotplug.down_lock_dur));
+			      msecs_to_jiffies(hotplug.down_lock_dur +
+					       hotplug_core_cycle_ms(cpu)));
 }
 
 static void remove_down_lock(struct work_struct *work)
@@ -301,20 +303,24 @@ static int get_lowest_load_cpu(void)
 	return lowest_cpu;
 }
 
-static void __ref cpu_up_work(struct work_struct *work)
+static void cpu_up_work(struct work_struct *work)
 {
 	int cpu;
-	unsigned int target;
+	unsigned int target, online;
 
 	target = hotplug.target_cpus;
+	online = num_online_cpus();
 
+	/* queue all of them, the core brings them up in one go */
 	for_each_cpu_not(cpu, cpu_online_mask) {
-		if (target <= num_online_cpus())
+		if (target <= online)
 			break;
 		if (cpu == 0)
 			continue;
-		cpu_up(cpu);
-		apply_down_lock(cpu);
+		if (!hotplug_core_request_up(&msm_hotplug_policy, cpu)) {
+			apply_down_lock(cpu);
+			online++;
+		}
 	}
 }
 
@@ -483,11 +489,11 @@ static void msm_hotplug_suspend(void)
 	for_each_online_cpu(cpu) {
 		if (cpu == 0)
 			continue;
-		cpu_down(cpu);
+		hotplug_core_cpu_down(&msm_hotplug_policy, cpu);
 	}
 }
 
-static void __ref msm_hotplug_resume(void)
+static void msm_hotplug_resume(void)
 {
 	int cpu, required_reschedule = 0, required_wakeup = 0;
 
@@ -508,8 +514,8 @@ static void __ref msm_hotplug_resume(void)
 		for_each_cpu_not(cpu, cpu_online_mask) {
 			if (cpu == 0)
 				continue;
-			cpu_up(cpu);
-			apply_down_lock(cpu);
+			if (!hotplug_core_cpu_up(&msm_hotplug_policy, cpu))
+				apply_down_lock(cpu);
 		}
 	}
 
@@ -631,7 +637,7 @@ static struct input_handler hotplug_input_handler = {
 	.id_table	= hotplug_ids,
 };
 
-static int __ref msm_hotplug_start(void)
+static int msm_hotplug_start(void)
 {
 	int cpu, ret = 0;
 	struct down_lock *dl;
@@ -650,6 +656,7 @@ static int __ref msm_hotplug_start(void)
 	if (state_register_client(&hotplug.notif)) {
 		pr_err("%s: Failed to register State notifier callback\n",
 			MSM_HOTPLUG);
+		ret = -EINVAL;
 		goto err_dev;
 	}
 #endif
@@ -679,12 +686,14 @@ static int __ref msm_hotplug_start(void)
 		INIT_DELAYED_WORK(&dl->lock_rem, remove_down_lock);
 	}
 
+	hotplug.msm_enabled = 1;
+
 	/* Fire up all CPUs */
 	for_each_cpu_not(cpu, cpu_online_mask) {
 		if (cpu == 0)
 			continue;
-		cpu_up(cpu);
-		apply_down_lock(cpu);
+		if (!hotplug_core_cpu_up(&msm_hotplug_policy, cpu))
+			apply_down_lock(cpu);
 	}
 
 	queue_delayed_work_on(0, hotplug_wq, &hotplug_work,
@@ -728,10 +737,23 @@ static void msm_hotplug_stop(void)
 	for_each_online_cpu(cpu) {
 		if (cpu == 0)
 			continue;
-		cpu_down(cpu);
+		hotplug_core_cpu_down(&msm_hotplug_policy, cpu);
 	}
+
+	hotplug.msm_enabled = 0;
 }
 
+/*
+ * msm_hotplug keeps its own load history and adaptive update rate, so it
+ * does not use the core sampler; it only goes through the core for
+ * arbitration and the actual cpu_up/cpu_down calls.
+ */
+static struct hotplug_policy msm_hotplug_policy = {
+	.name = MSM_HOTPLUG,
+	.start = msm_hotplug_start,
+	.stop = msm_hotplug_stop,
+};
+
 static unsigned int *get_tokenized_data(const char *buf, int *num_tokens)
 {
 	const char *cp;
@@ -800,12 +822,9 @@ static ssize_t store_enable_hotplug(struct device *dev,
 	if (val == hotplug.msm_enabled)
 		return count;
 
-	hotplug.msm_enabled = val;
-
-	if (hotplug.msm_enabled)
-		ret = msm_hotplug_start();
-	else
-		msm_hotplug_stop();
+	ret = hotplug_core_enable(&msm_hotplug_policy, val);
+	if (ret)
+		return ret;
 
 	return count;
 }
@@ -1201,11 +1220,9 @@ static int msm_hotplug_probe(struct platform_device *pdev)
 		goto err_dev;
 	}
 
-	if (hotplug.msm_enabled) {
-		ret = msm_hotplug_start();
-		if (ret != 0)
-			goto err_dev;
-	}
+	ret = hotplug_core_register(&msm_hotplug_policy, HOTPLUG_ENABLED);
+	if (ret != 0)
+		goto err_dev;
 
 	return ret;
 err_dev:
@@ -1220,8 +1237,7 @@ static struct platform_device msm_hotplug_device = {
 
 static int msm_hotplug_remove(struct platform_device *pdev)
 {
-	if (hotplug.msm_enabled)
-		msm_hotplug_stop();
+	hotplug_core_unregister(&msm_hotplug_policy);
 
 	return 0;
 }
@@ -68,7 +68,11 @@ static struct cpu_limit {
 
 static struct workqueue_struct *limiter_wq;
 
-static void update_cpu_max_freq(unsigned int cpu)
+static struct cpufreq_limit msm_limiter_limit = {
+	.name = MSM_LIMIT,
+};
+
+static void update_cpu_limit(unsigned int cpu)
 {
 	uint32_t max_freq = 0, min_freq = 0;
 
@@ -78,18 +82,14 @@ static void update_cpu_max_freq(unsigned int cpu)
 	else
 		max_freq = limit.resume_max_freq[cpu];
 
-	if (limit.suspended && limit.suspend_min_freq[cpu] <= max_freq)
-		min_freq = limit.suspend_min_freq[cpu];
+	if (!max_freq)
+		max_freq = UINT_MAX;
 
-	cpufreq_set_freq(max_freq, min_freq, cpu);
+	if (limit.suspend_min_freq[cpu] <= max_freq)
+		min_freq = limit.suspend_min_freq[cpu];
 
-	mutex_unlock(&limit.msm_limiter_mutex[cpu]);
-}
+	cpufreq_limit_set(&msm_limiter_limit, cpu, min_freq, max_freq);
 
-static void update_cpu_min_freq(unsigned int cpu)
-{
-	mutex_lock(&limit.msm_limiter_mutex[cpu]);
-	cpufreq_set_freq(0, limit.suspend_min_freq[cpu], cpu);
 	mutex_unlock(&limit.msm_limiter_mutex[cpu]);
 }
 
@@ -106,7 +106,7 @@ static void msm_limit_suspend(struct work_struct *work)
 	mutex_unlock(&limit.resume_suspend_mutex);
 
 	for_each_possible_cpu(cpu)
-		update_cpu_max_freq(cpu);
+		update_cpu_limit(cpu);
 }
 
 static void msm_limit_resume(struct work_struct *work)
@@ -123,7 +123,7 @@ static void msm_limit_resume(struct work_struct *work)
 
 	/* Restore max allowed freq */
 	for_each_possible_cpu(cpu)
-		update_cpu_max_freq(cpu);
+		update_cpu_limit(cpu);
 }
 
 static void __msm_limit_suspend(void)
@@ -251,8 +251,10 @@ static void msm_cpufreq_limit_stop(void)
 	cancel_work_sync(&limit.resume_work);
 	cancel_delayed_work_sync(&limit.suspend_work);
 	mutex_destroy(&limit.resume_suspend_mutex);
-	for_each_possible_cpu(cpu)	
+	for_each_possible_cpu(cpu) {
 		mutex_destroy(&limit.msm_limiter_mutex[cpu]);
+		cpufreq_limit_set(&msm_limiter_limit, cpu, 0, UINT_MAX);
+	}
 
 #ifdef CONFIG_STATE_NOTIFIER
 	state_unregister_client(&limit.notif);
@@ -391,7 +393,7 @@ static ssize_t store_resume_max_freq_##cpu		\
 out:							\
 	limit.resume_max_freq[cpu] = val;		\
 	if (limit.limiter_enabled)			\
-		update_cpu_max_freq(cpu);		\
+		update_cpu_limit(cpu);			\
 	return count;					\
 }							\
 static ssize_t show_resume_max_freq_##cpu		\
@@ -420,7 +422,7 @@ static ssize_t store_suspend_min_freq_##cpu(		\
 out:							\
 	limit.suspend_min_freq[cpu] = val;		\
 	if (limit.limiter_enabled)			\
-		update_cpu_min_freq(cpu);		\
+		update_cpu_limit(cpu);			\
 	return count;					\
 }							\
 static ssize_t show_suspend_min_freq_##cpu(		\
@@ -594,6 +596,8 @@ static int msm_cpufreq_limit_init(void)
 		goto err_dev;
 	}
 
+	cpufreq_limit_register(&msm_limiter_limit);
+
 	if (limit.limiter_enabled)
 		msm_cpufreq_limit_start();
 
@@ -612,6 +616,7 @@ static void msm_cpufreq_limit_exit(void)
 	if (limit.limiter_enabled)
 		msm_cpufreq_limit_stop();
 
+	cpufreq_limit_unregister(&msm_limiter_limit);
 }
 
 late_initcall(msm_cpufreq_limit_init);
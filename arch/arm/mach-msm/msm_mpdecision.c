@@ -37,6 +37,7 @@
 #include <asm/page.h>
 #include <mach/msm_dcvs.h>
 #include <mach/msm_dcvs_scm.h>
+#include <mach/hotplug_core.h>
 #define CREATE_TRACE_POINTS
 #include <trace/events/mpdcvs_trace.h>
 
@@ -123,6 +124,7 @@ static struct dentry *debugfs_base;
 static struct mpdecision msm_mpd;
 
 static struct hp_latency hp_latencies;
+static struct hotplug_policy msm_mpd_policy;
 
 static unsigned long last_nr;
 static int num_present_hundreds;
@@ -165,7 +167,7 @@ static enum hrtimer_restart msm_mpd_rq_avg_poll_timer(struct hrtimer *timer)
 	msm_mpd.next_update = ktime_add_ns(curr_time,
 			(msm_mpd.rq_avg_poll_ms * NSEC_PER_MSEC));
 
-	sched_get_nr_running_avg(&nr, &nr_iowait);
+	hotplug_core_nr_running_avg(&nr, &nr_iowait);
 
 	if ((nr_iowait >= msm_mpd.iowait_threshold_pct) && (nr < last_nr))
 		nr = last_nr;
@@ -197,7 +199,7 @@ static void bring_up_cpu(int cpu)
 	int ret, ret1, ret2;
 
 	cpu_action_time_ms = ktime_to_ms(ktime_get());
-	ret = cpu_up(cpu);
+	ret = hotplug_core_cpu_up(&msm_mpd_policy, cpu);
 	if (ret) {
 		pr_debug("Error %d online core %d\n", ret, cpu);
 	} else {
@@ -225,7 +227,7 @@ static void bring_down_cpu(int cpu)
 
 	BUG_ON(cpu == 0);
 	cpu_action_time_ms = ktime_to_ms(ktime_get());
-	ret = cpu_down(cpu);
+	ret = hotplug_core_cpu_down(&msm_mpd_policy, cpu);
 	if (ret) {
 		pr_debug("Error %d offline" "core %d\n", ret, cpu);
 	} else {
@@ -428,7 +430,7 @@ static int msm_mpd_do_update_scm(void *data)
 	return 0;
 }
 
-static int __ref msm_mpd_set_enabled(uint32_t enable)
+static int __ref msm_mpd_do_set_enabled(uint32_t enable)
 {
 	int ret = 0;
 	int ret0 = 0;
@@ -491,6 +493,28 @@ static int __ref msm_mpd_set_enabled(uint32_t enable)
 	return ret;
 }
 
+static int msm_mpd_start(void)
+{
+	return msm_mpd_do_set_enabled(1);
+}
+
+static void msm_mpd_stop(void)
+{
+	msm_mpd_do_set_enabled(0);
+}
+
+/* The TZ algorithm is fed from its own rq_avg_poll_timer, not the core. */
+static struct hotplug_policy msm_mpd_policy = {
+	.name = "msm_mpdecision",
+	.start = msm_mpd_start,
+	.stop = msm_mpd_stop,
+};
+
+static int msm_mpd_set_enabled(uint32_t enable)
+{
+	return hotplug_core_enable(&msm_mpd_policy, enable > 0);
+}
+
 static int msm_mpd_set_rq_avg_poll_ms(uint32_t val)
 {
 	/*
@@ -668,6 +692,12 @@ static int __devinit msm_mpd_probe(struct platform_device *pdev)
 
 	memcpy(&msm_mpd.mp_param, param, sizeof(struct msm_mpd_algo_param));
 
+	ret = hotplug_core_register(&msm_mpd_policy, false);
+	if (ret) {
+		pr_err("Unable to register hotplug policy :%d\n", ret);
+		goto done;
+	}
+
 	debugfs_base = debugfs_create_dir("msm_mpdecision", NULL);
 	if (!debugfs_base) {
 		pr_err("Cannot create debugfs base msm_mpdecision\n");
@@ -684,6 +714,7 @@ done:
 
 static int __devexit msm_mpd_remove(struct platform_device *pdev)
 {
+	hotplug_core_unregister(&msm_mpd_policy);
 	platform_set_drvdata(pdev, NULL);
 
 	return 0;
@@ -27,6 +27,9 @@
 #include <linux/qmi_encdec.h>
 #include <linux/workqueue.h>
 #include <linux/mutex.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 
 #include <mach/msm_qmi_interface.h>
 #include <mach/msm_ipc_router.h>
@@ -41,6 +44,10 @@ static DEFINE_MUTEX(svc_event_nb_list_lock);
 static DEFINE_MUTEX(msm_qmi_init_lock);
 static struct workqueue_struct *msm_qmi_pending_workqueue;
 
+/* All kernel QMI handles, for the latency statistics in debugfs */
+static LIST_HEAD(qmi_handle_list);
+static DEFINE_MUTEX(qmi_handle_list_lock);
+
 struct elem_info qmi_response_type_v01_ei[] = {
 	{
 		.data_type	= QMI_SIGNED_2_BYTE_ENUM,
@@ -105,6 +112,82 @@ static void qmi_event_notify(unsigned event, void *priv)
 	mutex_unlock(&handle->handle_lock);
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int qmi_stats_show(struct seq_file *s, void *unused)
+{
+	struct qmi_handle *handle;
+	struct qmi_txn_stats stats;
+
+	seq_printf(s, "%-10s %-10s %8s %8s %6s %8s %8s %8s\n",
+		   "service", "instance", "reqs", "resps", "errs",
+		   "min_us", "avg_us", "max_us");
+	mutex_lock(&qmi_handle_list_lock);
+	list_for_each_entry(handle, &qmi_handle_list, handle_list) {
+		mutex_lock(&handle->handle_lock);
+		stats = handle->stats;
+		mutex_unlock(&handle->handle_lock);
+		seq_printf(s, "0x%08x 0x%08x %8u %8u %6u %8u %8llu %8u\n",
+			   handle->service_id, handle->service_ins,
+			   stats.num_reqs, stats.num_resps, stats.num_errs,
+			   stats.num_resps ? stats.min_us : 0,
+			   stats.num_resps ?
+			   div_u64(stats.total_us, stats.num_resps) : 0,
+			   stats.max_us);
+	}
+	mutex_unlock(&qmi_handle_list_lock);
+	return 0;
+}
+
+static int qmi_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, qmi_stats_show, NULL);
+}
+
+static const struct file_operations qmi_stats_fops = {
+	.open = qmi_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void qmi_debugfs_init(void)
+{
+	struct dentry *dent;
+
+	dent = debugfs_create_dir("msm_qmi", NULL);
+	if (IS_ERR_OR_NULL(dent))
+		return;
+	debugfs_create_file("stats", 0444, dent, NULL, &qmi_stats_fops);
+}
+#else
+static void qmi_debugfs_init(void)
+{
+}
+#endif
+
+/**
+ * qmi_txn_latency() - Account the round trip of a completed transaction
+ * @handle: QMI handle the transaction was sent on.
+ * @txn_handle: Transaction whose response has arrived.
+ *
+ * Must be called with handle_lock held.
+ */
+static void qmi_txn_latency(struct qmi_handle *handle,
+			    struct qmi_txn *txn_handle)
+{
+	struct qmi_txn_stats *stats = &handle->stats;
+	uint32_t usecs;
+
+	usecs = (uint32_t)ktime_to_us(ktime_sub(ktime_get(),
+						txn_handle->send_time));
+	if (!stats->num_resps || usecs < stats->min_us)
+		stats->min_us = usecs;
+	if (usecs > stats->max_us)
+		stats->max_us = usecs;
+	stats->total_us += usecs;
+	stats->num_resps++;
+}
+
 /**
  * init_msm_qmi() - Init function for kernel space QMI
  *
@@ -128,6 +211,7 @@ static void init_msm_qmi(void)
 	msm_qmi_inited = 1;
 	msm_qmi_pending_workqueue =
 			create_singlethread_workqueue("msm_qmi_rtx_q");
+	qmi_debugfs_init();
 	mutex_unlock(&msm_qmi_init_lock);
 }
 
@@ -220,6 +304,9 @@ struct qmi_handle *qmi_handle_create(
 	init_waitqueue_head(&temp_handle->reset_waitq);
 	INIT_DELAYED_WORK(&temp_handle->resume_tx_work, handle_resume_tx);
 	init_msm_qmi();
+	mutex_lock(&qmi_handle_list_lock);
+	list_add_tail(&temp_handle->handle_list, &qmi_handle_list);
+	mutex_unlock(&qmi_handle_list_lock);
 	return temp_handle;
 }
 EXPORT_SYMBOL(qmi_handle_create);
@@ -262,6 +349,10 @@ int qmi_handle_destroy(struct qmi_handle *handle)
 	if (!handle)
 		return -EINVAL;
 
+	mutex_lock(&qmi_handle_list_lock);
+	list_del(&handle->handle_list);
+	mutex_unlock(&qmi_handle_list_lock);
+
 	mutex_lock(&handle->handle_lock);
 	handle->handle_reset = 1;
 	clean_txn_info(handle);
@@ -300,7 +391,8 @@ int qmi_register_ind_cb(struct qmi_handle *handle,
 }
 EXPORT_SYMBOL(qmi_register_ind_cb);
 
-static int qmi_encode_and_send_req(struct qmi_txn **ret_txn_handle,
+/* Must be called with handle_lock held */
+static int __qmi_encode_and_send_req(struct qmi_txn **ret_txn_handle,
 	struct qmi_handle *handle, enum txn_type type,
 	struct msg_desc *req_desc, void *req, unsigned int req_len,
 	struct msg_desc *resp_desc, void *resp, unsigned int resp_len,
@@ -313,21 +405,16 @@ static int qmi_encode_and_send_req(struct qmi_txn **ret_txn_handle,
 	int rc, encoded_req_len;
 	void *encoded_req;
 
-	if (!handle || !handle->dest_info ||
-	    !req_desc || !req || !resp_desc || !resp)
+	if (!req_desc || !req || !resp_desc || !resp)
 		return -EINVAL;
 
-	mutex_lock(&handle->handle_lock);
-	if (handle->handle_reset) {
-		mutex_unlock(&handle->handle_lock);
+	if (handle->handle_reset)
 		return -ENETRESET;
-	}
 
 	/* Allocate Transaction Info */
 	txn_handle = kzalloc(sizeof(struct qmi_txn), GFP_KERNEL);
 	if (!txn_handle) {
 		pr_err("%s: Failed to allocate txn handle\n", __func__);
-		mutex_unlock(&handle->handle_lock);
 		return -ENOMEM;
 	}
 	txn_handle->type = type;
@@ -370,6 +457,8 @@ static int qmi_encode_and_send_req(struct qmi_txn **ret_txn_handle,
 			  txn_handle->txn_id, req_desc->msg_id,
 			  encoded_req_len);
 	encoded_req_len += QMI_HEADER_SIZE;
+	txn_handle->send_time = ktime_get();
+	handle->stats.num_reqs++;
 
 	/*
 	 * Check if this port has transactions queued to its pending list
@@ -396,14 +485,12 @@ append_pend_txn:
 		list_add_tail(&txn_handle->list, &handle->pending_txn_list);
 		if (ret_txn_handle)
 			*ret_txn_handle = txn_handle;
-		mutex_unlock(&handle->handle_lock);
 		return 0;
 	}
 	if (rc < 0) {
 		pr_err("%s: send_msg failed %d\n", __func__, rc);
 		goto encode_and_send_req_err3;
 	}
-	mutex_unlock(&handle->handle_lock);
 
 	kfree(encoded_req);
 	if (ret_txn_handle)
@@ -412,10 +499,33 @@ append_pend_txn:
 
 encode_and_send_req_err3:
 	list_del(&txn_handle->list);
+	handle->stats.num_errs++;
 encode_and_send_req_err2:
 	kfree(encoded_req);
 encode_and_send_req_err1:
 	kfree(txn_handle);
+	return rc;
+}
+
+static int qmi_encode_and_send_req(struct qmi_txn **ret_txn_handle,
+	struct qmi_handle *handle, enum txn_type type,
+	struct msg_desc *req_desc, void *req, unsigned int req_len,
+	struct msg_desc *resp_desc, void *resp, unsigned int resp_len,
+	void (*resp_cb)(struct qmi_handle *handle,
+			unsigned int msg_id, void *msg,
+			void *resp_cb_data, int stat),
+	void *resp_cb_data)
+{
+	int rc;
+
+	if (!handle || !handle->dest_info)
+		return -EINVAL;
+
+	mutex_lock(&handle->handle_lock);
+	rc = __qmi_encode_and_send_req(ret_txn_handle, handle, type,
+				       req_desc, req, req_len,
+				       resp_desc, resp, resp_len,
+				       resp_cb, resp_cb_data);
 	mutex_unlock(&handle->handle_lock);
 	return rc;
 }
@@ -495,6 +605,30 @@ int qmi_send_req_nowait(struct qmi_handle *handle,
 }
 EXPORT_SYMBOL(qmi_send_req_nowait);
 
+int qmi_send_req_batch(struct qmi_handle *handle,
+		       struct qmi_batch_req *reqs, int num_reqs)
+{
+	int i, rc = 0;
+
+	if (!handle || !handle->dest_info || !reqs || num_reqs <= 0)
+		return -EINVAL;
+
+	mutex_lock(&handle->handle_lock);
+	for (i = 0; i < num_reqs; i++) {
+		rc = __qmi_encode_and_send_req(NULL, handle, QMI_ASYNC_TXN,
+				reqs[i].req_desc, reqs[i].req, reqs[i].req_len,
+				reqs[i].resp_desc, reqs[i].resp,
+				reqs[i].resp_len,
+				reqs[i].resp_cb, reqs[i].resp_cb_data);
+		if (rc < 0)
+			break;
+	}
+	mutex_unlock(&handle->handle_lock);
+
+	return i ? i : rc;
+}
+EXPORT_SYMBOL(qmi_send_req_batch);
+
 static struct qmi_txn *find_txn_handle(struct qmi_handle *handle,
 				       uint16_t txn_id)
 {
@@ -528,6 +662,7 @@ static int handle_qmi_response(struct qmi_handle *handle,
 	if (rc < 0) {
 		pr_err("%s: Response Decode Failure <%d: %d: %d> rc: %d\n",
 			__func__, txn_id, msg_id, msg_len, rc);
+		handle->stats.num_errs++;
 		wake_up(&txn_handle->wait_q);
 		if (txn_handle->type == QMI_ASYNC_TXN) {
 			list_del(&txn_handle->list);
@@ -536,6 +671,8 @@ static int handle_qmi_response(struct qmi_handle *handle,
 		return rc;
 	}
 
+	qmi_txn_latency(handle, txn_handle);
+
 	/* Handle async or sync resp */
 	switch (txn_handle->type) {
 	case QMI_SYNC_TXN:
@@ -668,6 +805,8 @@ int qmi_connect_to_service(struct qmi_handle *handle,
 		return -ENETRESET;
 	}
 	handle->dest_info = svc_dest_addr;
+	handle->service_id = service_id;
+	handle->service_ins = instance_id;
 	mutex_unlock(&handle->handle_lock);
 
 	return 0;
@@ -21,6 +21,7 @@
 #include <linux/gfp.h>
 #include <linux/platform_device.h>
 #include <linux/qmi_encdec.h>
+#include <linux/ktime.h>
 
 #include <mach/msm_qmi_interface.h>
 
@@ -45,6 +46,7 @@ struct qmi_txn {
 			void *msg, void *resp_cb_data, int stat);
 	void *resp_cb_data;
 	wait_queue_head_t wait_q;
+	ktime_t send_time;
 };
 
 struct svc_event_nb {
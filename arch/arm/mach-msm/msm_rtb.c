@@ -13,9 +13,13 @@
 
 #include <linux/atomic.h>
 #include <linux/export.h>
+#include <linux/jump_label.h>
 #include <linux/kernel.h>
 #include <linux/memory_alloc.h>
 #include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
 #include <linux/mod_devicetable.h>
 #include <linux/platform_device.h>
 #include <linux/sched.h>
@@ -61,22 +65,70 @@ struct msm_rtb_state {
 	int enabled;
 	int initialized;
 	uint32_t filter;
+	unsigned int sample;
 	int step_size;
 };
 
+/*
+ * Each cpu owns every step_size'th entry, so the per-cpu index needs no
+ * atomic shared with the other cpus.
+ */
 #if defined(CONFIG_MSM_RTB_SEPARATE_CPUS)
-DEFINE_PER_CPU(atomic_t, msm_rtb_idx_cpu);
+static DEFINE_PER_CPU(int, msm_rtb_idx_cpu);
 #else
 static atomic_t msm_rtb_idx;
 #endif
 
+static DEFINE_PER_CPU(unsigned int, msm_rtb_sample_cnt);
+
 struct msm_rtb_state msm_rtb = {
 	.filter = 1 << LOGK_LOGBUF,
 	.enabled = 1,
 };
 
-module_param_named(filter, msm_rtb.filter, uint, 0644);
+/*
+ * One key per event type, flipped whenever the filter changes, so that a
+ * filtered out type costs a single nop in uncached_logk_pc().
+ */
+#define MSM_RTB_NR_KEYS	(LOGK_TIMESTAMP + 1)
+static struct static_key msm_rtb_keys[MSM_RTB_NR_KEYS];
+static DEFINE_MUTEX(msm_rtb_keys_lock);
+
+static void msm_rtb_update_keys(void)
+{
+	int i;
+
+	mutex_lock(&msm_rtb_keys_lock);
+	for (i = 0; i < MSM_RTB_NR_KEYS; i++) {
+		bool on = msm_rtb.filter & (1 << i);
+
+		if (on && !static_key_enabled(&msm_rtb_keys[i]))
+			static_key_slow_inc(&msm_rtb_keys[i]);
+		else if (!on && static_key_enabled(&msm_rtb_keys[i]))
+			static_key_slow_dec(&msm_rtb_keys[i]);
+	}
+	mutex_unlock(&msm_rtb_keys_lock);
+}
+
+static int msm_rtb_set_filter(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_uint(val, kp);
+
+	/* Before probe the keys are set up from the filter all at once */
+	if (!ret && msm_rtb.initialized)
+		msm_rtb_update_keys();
+	return ret;
+}
+
+static struct kernel_param_ops msm_rtb_filter_ops = {
+	.set = msm_rtb_set_filter,
+	.get = param_get_uint,
+};
+
+module_param_cb(filter, &msm_rtb_filter_ops, &msm_rtb.filter, 0644);
 module_param_named(enable, msm_rtb.enabled, int, 0644);
+/* Log only one in this many register accesses per cpu; 0 or 1 logs all */
+module_param_named(sample, msm_rtb.sample, uint, 0644);
 
 static int msm_rtb_panic_notifier(struct notifier_block *this,
 					unsigned long event, void *ptr)
@@ -96,10 +148,43 @@ void msm_rtb_disable(void)
 }
 EXPORT_SYMBOL(msm_rtb_disable);
 
+static __always_inline bool msm_rtb_type_enabled(enum logk_event_type type)
+{
+	/* static_key_false() needs a constant key */
+	switch (type) {
+	case LOGK_READL:
+		return static_key_false(&msm_rtb_keys[LOGK_READL]);
+	case LOGK_WRITEL:
+		return static_key_false(&msm_rtb_keys[LOGK_WRITEL]);
+	case LOGK_LOGBUF:
+		return static_key_false(&msm_rtb_keys[LOGK_LOGBUF]);
+	case LOGK_HOTPLUG:
+		return static_key_false(&msm_rtb_keys[LOGK_HOTPLUG]);
+	case LOGK_CTXID:
+		return static_key_false(&msm_rtb_keys[LOGK_CTXID]);
+	case LOGK_TIMESTAMP:
+		return static_key_false(&msm_rtb_keys[LOGK_TIMESTAMP]);
+	default:
+		return msm_rtb.initialized &&
+			((1 << type) & msm_rtb.filter);
+	}
+}
+
+static bool notrace msm_rtb_sample_skip(enum logk_event_type type)
+{
+	unsigned int n = msm_rtb.sample;
+
+	if (n <= 1 || (type != LOGK_READL && type != LOGK_WRITEL))
+		return false;
+	return this_cpu_inc_return(msm_rtb_sample_cnt) % n;
+}
+
 int notrace msm_rtb_event_should_log(enum logk_event_type log_type)
 {
-	return msm_rtb.initialized && msm_rtb.enabled &&
-		((1 << (log_type & ~LOGTYPE_NOPC)) & msm_rtb.filter);
+	enum logk_event_type type = log_type & ~LOGTYPE_NOPC;
+
+	return msm_rtb_type_enabled(type) && msm_rtb.enabled &&
+		!msm_rtb_sample_skip(type);
 }
 EXPORT_SYMBOL(msm_rtb_event_should_log);
 
@@ -164,18 +249,10 @@ static void uncached_logk_timestamp(int idx)
 #if defined(CONFIG_MSM_RTB_SEPARATE_CPUS)
 static int msm_rtb_get_idx(void)
 {
-	int cpu, i, offset;
-	atomic_t *index;
-
-	/*
-	 * ideally we would use get_cpu but this is a close enough
-	 * approximation for our purposes.
-	 */
-	cpu = raw_smp_processor_id();
-
-	index = &per_cpu(msm_rtb_idx_cpu, cpu);
+	int i, offset;
 
-	i = atomic_add_return(msm_rtb.step_size, index);
+	/* irq safe, and only ever touched by this cpu */
+	i = this_cpu_add_return(msm_rtb_idx_cpu, msm_rtb.step_size);
 	i -= msm_rtb.step_size;
 
 	/* Check if index has wrapped around */
@@ -183,7 +260,7 @@ static int msm_rtb_get_idx(void)
 		 ((i - msm_rtb.step_size) & (msm_rtb.nentries - 1));
 	if (offset < 0) {
 		uncached_logk_timestamp(i);
-		i = atomic_add_return(msm_rtb.step_size, index);
+		i = this_cpu_add_return(msm_rtb_idx_cpu, msm_rtb.step_size);
 		i -= msm_rtb.step_size;
 	}
 
@@ -284,10 +361,8 @@ int msm_rtb_probe(struct platform_device *pdev)
 
 
 #if defined(CONFIG_MSM_RTB_SEPARATE_CPUS)
-	for_each_possible_cpu(cpu) {
-		atomic_t *a = &per_cpu(msm_rtb_idx_cpu, cpu);
-		atomic_set(a, cpu);
-	}
+	for_each_possible_cpu(cpu)
+		per_cpu(msm_rtb_idx_cpu, cpu) = cpu;
 	msm_rtb.step_size = num_possible_cpus();
 #else
 	atomic_set(&msm_rtb_idx, 0);
@@ -297,6 +372,7 @@ int msm_rtb_probe(struct platform_device *pdev)
 	atomic_notifier_chain_register(&panic_notifier_list,
 						&msm_rtb_panic_blk);
 	msm_rtb.initialized = 1;
+	msm_rtb_update_keys();
 	return 0;
 }
 
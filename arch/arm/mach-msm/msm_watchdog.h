@@ -79,7 +79,9 @@ void g_pet_watchdog(void);
 #define pet_watchdog(void) g_pet_watchdog(void);
 void msm_watchdog_reset(unsigned int timeout);
 void msm_panic_wdt_set(unsigned int timeout);
+void msm_watchdog_idle_exit(void);
 #else
+static inline void msm_watchdog_idle_exit(void) { }
 #ifdef CONFIG_MSM_WATCHDOG
 void pet_watchdog(void);
 void msm_watchdog_reset(unsigned int timeout);
@@ -20,6 +20,8 @@
 #include <linux/mutex.h>
 #include <linux/sched.h>
 #include <linux/interrupt.h>
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
 #include <linux/irq.h>
 #include <linux/percpu.h>
 #include <linux/of.h>
@@ -76,6 +78,25 @@ struct msm_watchdog_data {
 	struct mutex disable_lock;
 	struct work_struct init_dogwork_struct;
 	struct delayed_work dogwork_struct;
+	/*
+	 * dogwork_struct is deferrable and CPUs pet on their way out of
+	 * idle, so the watchdog does not wake an idle system by itself
+	 * until force_timer says the bark is near. Only pets from wdog_wq
+	 * on CPU0 arm force_timer and move wq_deadline; idle pets are
+	 * refused past it, so a hung CPU0 or wdog_wq still barks.
+	 */
+	spinlock_t pet_lock;
+	bool pet_ready;
+	unsigned long next_pet;		/* jiffies */
+	unsigned long wq_deadline;	/* jiffies */
+	unsigned long force_jiffies;
+	cpumask_t idle_alive_mask;
+	struct hrtimer force_timer;
+	ktime_t force_delay;
+	struct work_struct force_dogwork_struct;
+	unsigned long work_pets;
+	unsigned long idle_pets;
+	unsigned long forced_pets;
 	bool irq_ppi;
 	struct msm_watchdog_data __percpu **wdog_cpu_dd;
 	struct notifier_block panic_blk;
@@ -220,6 +241,8 @@ static void wdog_disable(struct msm_watchdog_data *wdog_dd)
 	atomic_notifier_chain_unregister(&panic_notifier_list,
 						&wdog_dd->panic_blk);
 	cancel_delayed_work_sync(&wdog_dd->dogwork_struct);
+	hrtimer_cancel(&wdog_dd->force_timer);
+	cancel_work_sync(&wdog_dd->force_dogwork_struct);
 	/* may be suspended after the first write above */
 	__raw_writel(0, wdog_dd->base + WDT0_EN);
 	mb();
@@ -298,7 +321,26 @@ static ssize_t wdog_disable_set(struct device *dev,
 static DEVICE_ATTR(disable, S_IWUSR | S_IRUSR, wdog_disable_get,
 							wdog_disable_set);
 
-static void pet_watchdog(struct msm_watchdog_data *wdog_dd)
+/*
+ * Pets from idle exit and from the deferrable work happen while the cpu
+ * is up anyway; only forced pets cost a wakeup of their own.
+ */
+static ssize_t wdog_pet_stats_get(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct msm_watchdog_data *wdog_dd = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE,
+			"idle pets: %lu\nwork pets: %lu\nforced pets: %lu\n"
+			"wakeups avoided: %lu\n",
+			wdog_dd->idle_pets, wdog_dd->work_pets,
+			wdog_dd->forced_pets,
+			wdog_dd->idle_pets + wdog_dd->work_pets);
+}
+
+static DEVICE_ATTR(pet_stats, S_IRUSR, wdog_pet_stats_get, NULL);
+
+static void __pet_watchdog(struct msm_watchdog_data *wdog_dd, bool from_wq)
 {
 	int slack, i, count, prev_count = 0;
 	unsigned long long time_ns;
@@ -321,11 +363,60 @@ static void pet_watchdog(struct msm_watchdog_data *wdog_dd)
 	if (slack_ns < wdog_dd->min_slack_ns)
 		wdog_dd->min_slack_ns = slack_ns;
 	wdog_dd->last_pet = time_ns;
+
+	wdog_dd->next_pet = jiffies + msecs_to_jiffies(wdog_dd->pet_time);
+	cpumask_clear(&wdog_dd->idle_alive_mask);
+	if (from_wq && enable && wdog_dd->pet_ready) {
+		wdog_dd->wq_deadline = jiffies + wdog_dd->force_jiffies;
+		hrtimer_start(&wdog_dd->force_timer, wdog_dd->force_delay,
+			      HRTIMER_MODE_REL);
+	}
+}
+
+static void pet_watchdog(struct msm_watchdog_data *wdog_dd, bool from_wq)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&wdog_dd->pet_lock, flags);
+	__pet_watchdog(wdog_dd, from_wq);
+	spin_unlock_irqrestore(&wdog_dd->pet_lock, flags);
 }
 
 void g_pet_watchdog(void)
 {
-	pet_watchdog(g_wdog_dd);
+	pet_watchdog(g_wdog_dd, false);
+}
+
+/**
+ * msm_watchdog_idle_exit - pet the watchdog on the way out of idle
+ *
+ * Called by the low power mode code, with interrupts off, each time a
+ * cpu leaves idle. Once the pet period has passed the watchdog is pet
+ * from here, provided every online cpu has come through here since the
+ * last pet and wdog_wq has pet recently enough to show that CPU0 and
+ * the workqueue are still alive.
+ */
+void msm_watchdog_idle_exit(void)
+{
+	struct msm_watchdog_data *wdog_dd = g_wdog_dd;
+
+	if (!wdog_dd || !wdog_dd->pet_ready || !enable)
+		return;
+
+	cpumask_set_cpu(smp_processor_id(), &wdog_dd->idle_alive_mask);
+	if (time_before(jiffies, wdog_dd->next_pet))
+		return;
+	if (test_taint(TAINT_DIE) || oops_in_progress)
+		return;
+
+	spin_lock(&wdog_dd->pet_lock);
+	if (time_after_eq(jiffies, wdog_dd->next_pet) &&
+	    time_before(jiffies, wdog_dd->wq_deadline) &&
+	    cpumask_subset(cpu_online_mask, &wdog_dd->idle_alive_mask)) {
+		__pet_watchdog(wdog_dd, false);
+		wdog_dd->idle_pets++;
+	}
+	spin_unlock(&wdog_dd->pet_lock);
 }
 
 static void keep_alive_response(void *info)
@@ -364,9 +455,15 @@ static void pet_watchdog_work(struct work_struct *work)
 
 	delay_time = msecs_to_jiffies(wdog_dd->pet_time);
 	if (enable) {
-		if (wdog_dd->do_ipi_ping)
-			ping_other_cpus(wdog_dd);
-		pet_watchdog(wdog_dd);
+		if (time_before(jiffies, wdog_dd->next_pet)) {
+			/* pet from idle exit meanwhile */
+			delay_time = wdog_dd->next_pet - jiffies;
+		} else {
+			if (wdog_dd->do_ipi_ping)
+				ping_other_cpus(wdog_dd);
+			pet_watchdog(wdog_dd, true);
+			wdog_dd->work_pets++;
+		}
 	}
 	/* Check again before scheduling *
 	 * Could have been changed on other cpu */
@@ -375,6 +472,34 @@ static void pet_watchdog_work(struct work_struct *work)
 				&wdog_dd->dogwork_struct, delay_time);
 }
 
+static void force_pet_watchdog_work(struct work_struct *work)
+{
+	struct msm_watchdog_data *wdog_dd = container_of(work,
+						struct msm_watchdog_data,
+							force_dogwork_struct);
+
+	if (test_taint(TAINT_DIE) || oops_in_progress)
+		return;
+
+	if (enable) {
+		if (wdog_dd->do_ipi_ping)
+			ping_other_cpus(wdog_dd);
+		pet_watchdog(wdog_dd, true);
+		wdog_dd->forced_pets++;
+	}
+}
+
+/* nobody has pet the watchdog for a while: do it now, idle or not */
+static enum hrtimer_restart wdog_force_timer_fn(struct hrtimer *timer)
+{
+	struct msm_watchdog_data *wdog_dd = container_of(timer,
+						struct msm_watchdog_data,
+							force_timer);
+
+	queue_work_on(0, wdog_wq, &wdog_dd->force_dogwork_struct);
+	return HRTIMER_NORESTART;
+}
+
 static int msm_watchdog_remove(struct platform_device *pdev)
 {
 	struct wdog_disable_work_data work_data;
@@ -391,6 +516,7 @@ static int msm_watchdog_remove(struct platform_device *pdev)
 	}
 	mutex_unlock(&wdog_dd->disable_lock);
 	device_remove_file(wdog_dd->dev, &dev_attr_disable);
+	device_remove_file(wdog_dd->dev, &dev_attr_pet_stats);
 	if (wdog_dd->irq_ppi)
 		free_percpu(wdog_dd->wdog_cpu_dd);
 	printk(KERN_INFO "MSM Watchdog Exit - Deactivated\n");
@@ -1199,6 +1325,7 @@ static void init_watchdog_work(struct work_struct *work)
 						struct msm_watchdog_data,
 							init_dogwork_struct);
 	unsigned long delay_time;
+	unsigned int force_ms;
 	int error;
 	u64 timeout;
 	int ret;
@@ -1230,6 +1357,11 @@ static void init_watchdog_work(struct work_struct *work)
 	delay_time = msecs_to_jiffies(wdog_dd->pet_time);
 	wdog_dd->min_slack_ticks = UINT_MAX;
 	wdog_dd->min_slack_ns = ULLONG_MAX;
+	/* force a pet half way between the pet and the bark time */
+	force_ms = (wdog_dd->pet_time + wdog_dd->bark_time) / 2;
+	wdog_dd->force_delay = ktime_set(force_ms / MSEC_PER_SEC,
+				(force_ms % MSEC_PER_SEC) * NSEC_PER_MSEC);
+	wdog_dd->force_jiffies = msecs_to_jiffies(force_ms);
 	configure_bark_dump(wdog_dd);
 	timeout = (wdog_dd->bark_time * WDT_HZ)/1000;
 	__raw_writel(timeout, wdog_dd->base + WDT0_BARK_TIME);
@@ -1244,7 +1376,15 @@ static void init_watchdog_work(struct work_struct *work)
 	__raw_writel(1, wdog_dd->base + WDT0_EN);
 	__raw_writel(1, wdog_dd->base + WDT0_RST);
 	wdog_dd->last_pet = sched_clock();
+	wdog_dd->next_pet = jiffies + delay_time;
+	wdog_dd->wq_deadline = jiffies + wdog_dd->force_jiffies;
+	wdog_dd->pet_ready = true;
+	hrtimer_start(&wdog_dd->force_timer, wdog_dd->force_delay,
+		      HRTIMER_MODE_REL);
 	error = device_create_file(wdog_dd->dev, &dev_attr_disable);
+	if (error)
+		dev_err(wdog_dd->dev, "cannot create sysfs attribute\n");
+	error = device_create_file(wdog_dd->dev, &dev_attr_pet_stats);
 	if (error)
 		dev_err(wdog_dd->dev, "cannot create sysfs attribute\n");
 	if (wdog_dd->irq_ppi)
@@ -1342,7 +1482,12 @@ static int __devinit msm_watchdog_probe(struct platform_device *pdev)
 	platform_set_drvdata(pdev, wdog_dd);
 	cpumask_clear(&wdog_dd->alive_mask);
 	INIT_WORK(&wdog_dd->init_dogwork_struct, init_watchdog_work);
-	INIT_DELAYED_WORK(&wdog_dd->dogwork_struct, pet_watchdog_work);
+	INIT_DELAYED_WORK_DEFERRABLE(&wdog_dd->dogwork_struct,
+				     pet_watchdog_work);
+	INIT_WORK(&wdog_dd->force_dogwork_struct, force_pet_watchdog_work);
+	spin_lock_init(&wdog_dd->pet_lock);
+	hrtimer_init(&wdog_dd->force_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	wdog_dd->force_timer.function = wdog_force_timer_fn;
 	g_wdog_dd = wdog_dd;
 	queue_work_on(0, wdog_wq, &wdog_dd->init_dogwork_struct);
 	return 0;
@@ -25,6 +25,7 @@
 #include <linux/platform_device.h>
 #include <linux/workqueue.h>
 #include <linux/power_supply.h>
+#include <mach/hotplug_core.h>
 
 #define ZEN_DECISION "zen_decision"
 
@@ -53,6 +54,7 @@ static struct notifier_block fb_notifier;
 /* Worker Stuff */
 static struct workqueue_struct *zen_wake_wq;
 static struct delayed_work wake_work;
+static struct hotplug_policy zd_policy;
 
 /* Sysfs stuff */
 struct kobject *zendecision_kobj;
@@ -96,12 +98,12 @@ static int get_power_supply_level(void)
  * Core wake work function.
  * Brings all CPUs online. Called from worker thread.
  */
-static void __ref msm_zd_online_all_cpus(struct work_struct *work)
+static void msm_zd_online_all_cpus(struct work_struct *work)
 {
 	int cpu;
 
 	for_each_cpu_not(cpu, cpu_online_mask) {
-		cpu_up(cpu);
+		hotplug_core_cpu_up(&zd_policy, cpu);
 	}
 }
 
@@ -148,6 +150,25 @@ static int fb_notifier_callback(struct notifier_block *nb,
 	return 0;
 }
 
+static int zd_start(void)
+{
+	enabled = 1;
+	return 0;
+}
+
+static void zd_stop(void)
+{
+	enabled = 0;
+	flush_workqueue(zen_wake_wq);
+	cancel_delayed_work_sync(&wake_work);
+}
+
+static struct hotplug_policy zd_policy = {
+	.name = ZEN_DECISION,
+	.start = zd_start,
+	.stop = zd_stop,
+};
+
 /* Sysfs Start */
 static ssize_t enable_show(struct kobject *kobj,
 	struct kobj_attribute *attr, char *buf)
@@ -165,10 +186,9 @@ static ssize_t enable_store(struct kobject *kobj,
 	if (ret < 0)
 		return ret;
 
-	if (new_val > 0)
-		enabled = 1;
-	else
-		enabled = 0;
+	ret = hotplug_core_enable(&zd_policy, new_val > 0);
+	if (ret)
+		return ret;
 
 	return size;
 }
@@ -283,6 +303,12 @@ static int zd_probe(struct platform_device *pdev)
 	else
 		pr_info("[%s]: power supply '%s' found\n", ZEN_DECISION, ps_name);
 
+	ret = hotplug_core_register(&zd_policy, enabled);
+	if (ret) {
+		pr_err("[%s]: failed to register hotplug policy\n", ZEN_DECISION);
+		return ret;
+	}
+
 	/* Everything went well, lets say we loaded successfully */
 	pr_info("[%s]: driver initialized successfully \n", ZEN_DECISION);
 
@@ -291,6 +317,7 @@ static int zd_probe(struct platform_device *pdev)
 
 static int zd_remove(struct platform_device *pdev)
 {
+	hotplug_core_unregister(&zd_policy);
 	kobject_put(zendecision_kobj);
 
 	flush_workqueue(zen_wake_wq);
@@ -600,6 +600,15 @@ static int ocmem_timing_show(struct seq_file *f, void *dummy)
 				z->min_free_time, z->total_free_time,
 				get_ocmem_stat(z, 6));
 	}
+	for (i = OCMEM_GRAPHICS; i < OCMEM_CLIENT_MAX; i++) {
+		struct ocmem_zone *z = get_zone(i);
+		if (z && z->active == true)
+			seq_printf(f, "zone %s\t: queue_wait:[max:%u, total:%llu, cnt:%lu] eviction_wait:[max:%u, total:%llu, cnt:%lu]\n",
+				get_name(z->owner), z->max_wait_time,
+				z->total_wait_time, z->nr_waits,
+				z->max_evict_time, z->total_evict_time,
+				z->nr_evict_waits);
+	}
 	return 0;
 }
 
@@ -690,6 +699,12 @@ static int ocmem_zone_init(struct platform_device *pdev)
 		zone->max_free_time = 0;
 		zone->min_free_time = 0xFFFFFFFF;
 		zone->total_free_time = 0;
+		zone->max_wait_time = 0;
+		zone->total_wait_time = 0;
+		zone->nr_waits = 0;
+		zone->max_evict_time = 0;
+		zone->total_evict_time = 0;
+		zone->nr_evict_waits = 0;
 
 		if (part->p_tail) {
 			z_ops->allocate = allocate_tail;
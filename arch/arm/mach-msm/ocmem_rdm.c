@@ -29,6 +29,8 @@
 
 #define RDM_MAX_ENTRIES 32
 #define RDM_MAX_CLIENTS 2
+/* BR/DM table entries owned by each client */
+#define RDM_CLIENT_SLOTS 16
 
 /* Data Mover Parameters */
 #define DM_BLOCK_128 0x0
@@ -123,7 +125,7 @@ static inline int client_ctrl_id(int id)
 static inline int client_slot_start(int id)
 {
 
-	return client_ctrl_id(id) * 16;
+	return client_ctrl_id(id) * RDM_CLIENT_SLOTS;
 }
 
 static irqreturn_t ocmem_dm_irq_handler(int irq, void *dev_id)
@@ -181,9 +183,13 @@ int ocmem_clear(unsigned long start, unsigned long size)
 }
 #endif
 
-/* Lock during transfers */
-int ocmem_rdm_transfer(int id, struct ocmem_map_list *clist,
-			unsigned long start, int direction)
+/*
+ * Program one DM run of up to RDM_CLIENT_SLOTS table entries starting at
+ * chunk *idx, coalescing chunks that are also contiguous in DDR, and
+ * wait for it. Returns the OCMEM offset following the run.
+ */
+static unsigned long ocmem_rdm_run(int id, struct ocmem_map_list *clist,
+			int *idx, unsigned long start, int direction)
 {
 	int num_chunks = clist->num_chunks;
 	int slot = client_slot_start(id);
@@ -193,31 +199,21 @@ int ocmem_rdm_transfer(int id, struct ocmem_map_list *clist,
 	int br_id = 0;
 	int client_id = 0;
 	int dm_ctrl = 0;
-	int i = 0;
+	int i = *idx;
 	int j = 0;
 	int status = 0;
-	int rc = 0;
 
-	rc = ocmem_enable_core_clock();
+	for (j = slot; i < num_chunks && j < slot + RDM_CLIENT_SLOTS; j++) {
 
-	if (rc < 0) {
-		pr_err("RDM transfer failed for client %s (id: %d)\n",
-				get_name(id), id);
-		return rc;
-	}
-
-	/* Clear DM Mask */
-	ocmem_write(DM_MASK_RESET, dm_base + DM_INTR_MASK);
-	/* Clear DM Interrupts */
-	ocmem_write(DM_INTR_RESET, dm_base + DM_INTR_CLR);
-
-	for (i = 0, j = slot; i < num_chunks; i++, j++) {
-
-		struct ocmem_chunk *chunk = &clist->chunks[i];
+		struct ocmem_chunk *chunk = &clist->chunks[i++];
 		int sz = chunk->size;
 		int paddr = chunk->ddr_paddr;
 		int tbl_n_ctrl = 0;
 
+		while (i < num_chunks && clist->chunks[i].ro == chunk->ro &&
+				clist->chunks[i].ddr_paddr == paddr + sz)
+			sz += clist->chunks[i++].size;
+
 		tbl_n_ctrl |= BR_TBL_ENTRY_ENABLE;
 		if (chunk->ro)
 			tbl_n_ctrl |= (1 << BR_RW_SHIFT);
@@ -238,7 +234,7 @@ int ocmem_rdm_transfer(int id, struct ocmem_map_list *clist,
 
 	br_id = client_ctrl_id(id);
 	table_start = slot;
-	table_end = slot + num_chunks - 1;
+	table_end = j - 1;
 	br_ctrl |= (table_start << BR_TBL_START);
 	br_ctrl |= (table_end << BR_TBL_END);
 
@@ -268,7 +264,35 @@ int ocmem_rdm_transfer(int id, struct ocmem_map_list *clist,
 	pr_debug("ocmem: rdm: dm_ctrl %x br_ctrl %x\n", dm_ctrl, br_ctrl);
 
 	wait_for_completion(&dm_transfer_event);
-	pr_debug("Completed transferring %d segments\n", num_chunks);
+	pr_debug("Completed transferring %d segments in %d entries\n",
+			i - *idx, j - slot);
+	*idx = i;
+	return start;
+}
+
+/* Transfers must be serialized by the caller */
+int ocmem_rdm_transfer(int id, struct ocmem_map_list *clist,
+			unsigned long start, int direction)
+{
+	int i = 0;
+	int rc = 0;
+
+	rc = ocmem_enable_core_clock();
+
+	if (rc < 0) {
+		pr_err("RDM transfer failed for client %s (id: %d)\n",
+				get_name(id), id);
+		return rc;
+	}
+
+	/* Clear DM Mask */
+	ocmem_write(DM_MASK_RESET, dm_base + DM_INTR_MASK);
+	/* Clear DM Interrupts */
+	ocmem_write(DM_INTR_RESET, dm_base + DM_INTR_CLR);
+
+	while (i < clist->num_chunks)
+		start = ocmem_rdm_run(id, clist, &i, start, direction);
+
 	ocmem_disable_core_clock();
 	return 0;
 }
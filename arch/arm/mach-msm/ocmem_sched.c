@@ -93,9 +93,13 @@ struct ocmem_rdm_work {
 	struct ocmem_map_list *list;
 	struct ocmem_handle *handle;
 	int direction;
-	struct work_struct work;
+	/* Chain in rdm_queue */
+	struct list_head node;
 };
 
+static void ocmem_rdm_worker(struct work_struct *work);
+static DECLARE_WORK(ocmem_rdm_batch_work, ocmem_rdm_worker);
+
 /* OCMEM Operational modes */
 enum ocmem_client_modes {
 	OCMEM_PERFORMANCE = 1,
@@ -1213,14 +1217,18 @@ static void cancel_restore(struct ocmem_req *req)
 	return;
 }
 
+/* Pending requests are queued by priority and served FIFO within one */
 static int sched_enqueue(struct ocmem_req *priv)
 {
 	struct ocmem_req *next = NULL;
 	mutex_lock(&sched_queue_mutex);
 	SET_STATE(priv, R_ENQUEUED);
-	list_add_tail(&priv->sched_list, &sched_queue[priv->owner]);
+	/* A request put back in the queue keeps waiting since it came in */
+	if (!ktime_to_ns(priv->wait_start))
+		priv->wait_start = ktime_get();
+	list_add_tail(&priv->sched_list, &sched_queue[priv->prio]);
 	pr_debug("enqueued req %p\n", priv);
-	list_for_each_entry(next, &sched_queue[priv->owner], sched_list) {
+	list_for_each_entry(next, &sched_queue[priv->prio], sched_list) {
 		pr_debug("pending request %p for client %s\n", next,
 				get_name(next->owner));
 	}
@@ -1228,6 +1236,23 @@ static int sched_enqueue(struct ocmem_req *priv)
 	return 0;
 }
 
+static void sched_account_wait(struct ocmem_req *req)
+{
+	struct ocmem_zone *zone = zone_of(req);
+	unsigned int delay;
+
+	if (!zone || !ktime_to_ns(req->wait_start))
+		return;
+
+	delay = ktime_us_delta(ktime_get(), req->wait_start);
+	req->wait_start = ktime_set(0, 0);
+
+	if (delay > zone->max_wait_time)
+		zone->max_wait_time = delay;
+	zone->total_wait_time += delay;
+	zone->nr_waits++;
+}
+
 static void sched_dequeue(struct ocmem_req *victim_req)
 {
 	struct ocmem_req *req = NULL;
@@ -1237,7 +1262,7 @@ static void sched_dequeue(struct ocmem_req *victim_req)
 	if (!victim_req)
 		return;
 
-	id = victim_req->owner;
+	id = victim_req->prio;
 
 	mutex_lock(&sched_queue_mutex);
 
@@ -1259,26 +1284,22 @@ dequeue_done:
 	return;
 }
 
+/* Fetch the oldest of the highest priority pending requests */
 static struct ocmem_req *ocmem_fetch_req(void)
 {
 	int i;
 	struct ocmem_req *req = NULL;
-	struct ocmem_req *next = NULL;
 
 	mutex_lock(&sched_queue_mutex);
-	for (i = MIN_PRIO; i < MAX_OCMEM_PRIO; i++) {
+	for (i = MAX_OCMEM_PRIO - 1; i >= MIN_PRIO; i--) {
 		if (list_empty(&sched_queue[i]))
 			continue;
-		list_for_each_entry_safe(req, next, &sched_queue[i], sched_list)
-		{
-			if (req) {
-				pr_debug("ocmem: Fetched pending request %p\n",
-									req);
-				list_del(&req->sched_list);
-				CLEAR_STATE(req, R_ENQUEUED);
-				break;
-			}
-		}
+		req = list_first_entry(&sched_queue[i], struct ocmem_req,
+						sched_list);
+		pr_debug("ocmem: Fetched pending request %p\n", req);
+		list_del_init(&req->sched_list);
+		CLEAR_STATE(req, R_ENQUEUED);
+		break;
 	}
 	mutex_unlock(&sched_queue_mutex);
 	return req;
@@ -1358,6 +1379,9 @@ static int process_grow(struct ocmem_req *req)
 		goto power_ctl_error;
 	}
 
+	if (!TEST_STATE(req, R_ENQUEUED))
+		sched_account_wait(req);
+
 	/* Notify the client about the buffer growth */
 	rc = dispatch_notification(req->owner, OCMEM_ALLOC_GROW, req->buffer);
 	if (rc < 0) {
@@ -1581,30 +1605,57 @@ pending_shrink:
 	return -EAGAIN;
 }
 
+static struct ocmem_rdm_work *ocmem_rdm_fetch(void)
+{
+	struct ocmem_rdm_work *work_data = NULL;
+
+	mutex_lock(&rdm_mutex);
+	if (!list_empty(&rdm_queue)) {
+		work_data = list_first_entry(&rdm_queue,
+				struct ocmem_rdm_work, node);
+		list_del(&work_data->node);
+	}
+	mutex_unlock(&rdm_mutex);
+	return work_data;
+}
+
+/*
+ * Run every queued transfer back to back under one core clock vote, so
+ * that an eviction moving several clients out does not wait for a work
+ * item and a clock ramp per transfer.
+ */
 static void ocmem_rdm_worker(struct work_struct *work)
 {
 	int offset = 0;
 	int rc = 0;
+	int clk_rc;
 	int event;
-	struct ocmem_rdm_work *work_data = container_of(work,
-				struct ocmem_rdm_work, work);
-	int id = work_data->id;
-	struct ocmem_map_list *list = work_data->list;
-	int direction = work_data->direction;
-	struct ocmem_handle *handle = work_data->handle;
-	struct ocmem_req *req = handle_to_req(handle);
-	struct ocmem_buf *buffer = handle_to_buffer(handle);
+	struct ocmem_rdm_work *work_data;
 
-	down_write(&req->rw_sem);
-	offset = phys_to_offset(req->req_start);
-	rc = ocmem_rdm_transfer(id, list, offset, direction);
-	if (work_data->direction == TO_OCMEM)
-		event = (rc == 0) ? OCMEM_MAP_DONE : OCMEM_MAP_FAIL;
-	else
-		event = (rc == 0) ? OCMEM_UNMAP_DONE : OCMEM_UNMAP_FAIL;
-	up_write(&req->rw_sem);
-	kfree(work_data);
-	dispatch_notification(id, event, buffer);
+	clk_rc = ocmem_enable_core_clock();
+
+	while ((work_data = ocmem_rdm_fetch()) != NULL) {
+		int id = work_data->id;
+		struct ocmem_map_list *list = work_data->list;
+		struct ocmem_handle *handle = work_data->handle;
+		struct ocmem_req *req = handle_to_req(handle);
+		struct ocmem_buf *buffer = handle_to_buffer(handle);
+
+		down_write(&req->rw_sem);
+		offset = phys_to_offset(req->req_start);
+		rc = ocmem_rdm_transfer(id, list, offset,
+					work_data->direction);
+		if (work_data->direction == TO_OCMEM)
+			event = (rc == 0) ? OCMEM_MAP_DONE : OCMEM_MAP_FAIL;
+		else
+			event = (rc == 0) ? OCMEM_UNMAP_DONE : OCMEM_UNMAP_FAIL;
+		up_write(&req->rw_sem);
+		kfree(work_data);
+		dispatch_notification(id, event, buffer);
+	}
+
+	if (!clk_rc)
+		ocmem_disable_core_clock();
 }
 
 int queue_transfer(struct ocmem_req *req, struct ocmem_handle *handle,
@@ -1622,9 +1673,12 @@ int queue_transfer(struct ocmem_req *req, struct ocmem_handle *handle,
 	work_data->list = list;
 	work_data->id = req->owner;
 	work_data->direction = direction;
-	INIT_WORK(&work_data->work, ocmem_rdm_worker);
 	up_write(&req->rw_sem);
-	queue_work(ocmem_rdm_wq, &work_data->work);
+
+	mutex_lock(&rdm_mutex);
+	list_add_tail(&work_data->node, &rdm_queue);
+	mutex_unlock(&rdm_mutex);
+	queue_work(ocmem_rdm_wq, &ocmem_rdm_batch_work);
 	return 0;
 }
 
@@ -1814,6 +1868,24 @@ int process_xfer(int id, struct ocmem_handle *handle,
 	return rc;
 }
 
+/* How long a client waited for lower priority clients to move out */
+static void wait_for_eviction(int id, struct ocmem_eviction_data *edata)
+{
+	struct ocmem_zone *zone = get_zone(id);
+	ktime_t start = ktime_get();
+	unsigned int delay;
+
+	wait_for_completion(&edata->completion);
+
+	delay = ktime_us_delta(ktime_get(), start);
+	if (!zone)
+		return;
+	if (delay > zone->max_evict_time)
+		zone->max_evict_time = delay;
+	zone->total_evict_time += delay;
+	zone->nr_evict_waits++;
+}
+
 static struct ocmem_eviction_data *init_eviction(int id)
 {
 	struct ocmem_eviction_data *edata = NULL;
@@ -1937,6 +2009,7 @@ static void trigger_eviction(struct ocmem_eviction_data *edata)
 			buffer.addr = req->req_start;
 			buffer.len = 0x0;
 			CLEAR_STATE(req, R_MUST_SHRINK);
+			inc_ocmem_stat(zone_of(req), NR_EVICTIONS);
 			dispatch_notification(req->owner, OCMEM_ALLOC_SHRINK,
 								&buffer);
 			SET_STATE(req, R_WF_SHRINK);
@@ -1970,7 +2043,7 @@ int process_evict(int id)
 
 	mutex_unlock(&sched_mutex);
 
-	wait_for_completion(&edata->completion);
+	wait_for_eviction(id, edata);
 
 	return 0;
 
@@ -2008,7 +2081,7 @@ static int run_evict(struct ocmem_req *req)
 
 	mutex_unlock(&free_mutex);
 
-	wait_for_completion(&edata->completion);
+	wait_for_eviction(req->owner, edata);
 
 	pr_debug("ocmem: eviction completed successfully\n");
 	return 0;
@@ -2301,6 +2374,7 @@ int process_delayed_allocate(struct ocmem_req *req)
 		return 0;
 
 	inc_ocmem_stat(zone_of(req), NR_ASYNC_ALLOCATIONS);
+	sched_account_wait(req);
 
 	if (req->req_sz != 0) {
 
@@ -2370,35 +2444,42 @@ dump_error:
 	return -EINVAL;
 }
 
+/*
+ * Serve the pending requests highest priority first, until one of them
+ * has to wait again: anything behind it is of the same or lower
+ * priority and must not overtake it.
+ */
 static void ocmem_sched_wk_func(struct work_struct *work)
 {
 
 	struct ocmem_buf *buffer = NULL;
 	struct ocmem_handle *handle = NULL;
-	struct ocmem_req *req = ocmem_fetch_req();
+	struct ocmem_req *req;
 
-	if (!req) {
-		pr_debug("No Pending Requests found\n");
-		return;
-	}
+	while ((req = ocmem_fetch_req()) != NULL) {
+		pr_debug("ocmem: sched_wk pending req %p\n", req);
+		handle = req_to_handle(req);
+		buffer = handle_to_buffer(handle);
+		BUG_ON(req->op == SCHED_NOP);
 
-	pr_debug("ocmem: sched_wk pending req %p\n", req);
-	handle = req_to_handle(req);
-	buffer = handle_to_buffer(handle);
-	BUG_ON(req->op == SCHED_NOP);
+		switch (req->op) {
+		case SCHED_GROW:
+			process_grow(req);
+			break;
+		case SCHED_ALLOCATE:
+			/* frees req on failure */
+			if (process_delayed_allocate(req) < 0)
+				continue;
+			break;
+		default:
+			pr_err("ocmem: Unknown operation encountered\n");
+			break;
+		}
 
-	switch (req->op) {
-	case SCHED_GROW:
-		process_grow(req);
-		break;
-	case SCHED_ALLOCATE:
-		process_delayed_allocate(req);
-		break;
-	default:
-		pr_err("ocmem: Unknown operation encountered\n");
-		break;
+		if (TEST_STATE(req, R_ENQUEUED))
+			break;
 	}
-	return;
+	pr_debug("No more pending requests to serve\n");
 }
 
 static int ocmem_allocations_show(struct seq_file *f, void *dummy)
@@ -2456,7 +2537,8 @@ int ocmem_sched_init(struct platform_device *pdev)
 
 	mutex_init(&rdm_mutex);
 	INIT_LIST_HEAD(&rdm_queue);
-	ocmem_rdm_wq = alloc_workqueue("ocmem_rdm_wq", 0, 0);
+	/* One worker drains rdm_queue; the data mover runs one at a time */
+	ocmem_rdm_wq = alloc_ordered_workqueue("ocmem_rdm_wq", 0);
 	if (!ocmem_rdm_wq)
 		return -ENOMEM;
 	ocmem_eviction_wq = alloc_workqueue("ocmem_eviction_wq", 0, 0);
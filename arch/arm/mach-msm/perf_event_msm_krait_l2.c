@@ -70,6 +70,13 @@ static u32 l2_slv_filter_prefix = 0x000f0010;
 static int total_l2_ctrs;
 static int l2_cycle_ctr_idx;
 
+/*
+ * Counters and event groups claimed by other users of the L2PM, such as
+ * the cpubw_hwmon governor; perf leaves them alone.
+ */
+static u32 l2_reserved_ctrs;
+static u64 l2_reserved_groups;
+
 static u32 pmu_type;
 
 static struct arm_pmu krait_l2_pmu;
@@ -319,7 +326,9 @@ static void krait_l2_start(void)
 
 static void krait_l2_stop(void)
 {
-	set_l2_indirect_reg(L2PMCR, L2PMCR_GLOBAL_DISABLE);
+	/* Reserved counters keep running while perf reprograms its own */
+	if (!l2_reserved_ctrs)
+		set_l2_indirect_reg(L2PMCR, L2PMCR_GLOBAL_DISABLE);
 	isb();
 }
 
@@ -328,8 +337,8 @@ u32 get_reset_pmovsr(void)
 	int val;
 
 	val = get_l2_indirect_reg(L2PMOVSR);
-	/* reset it */
-	val &= 0xffffffff;
+	/* reset it, leaving the overflows of reserved counters to their owner */
+	val &= ~l2_reserved_ctrs;
 	set_l2_indirect_reg(L2PMOVSR, val);
 
 	return val;
@@ -398,19 +407,20 @@ static int krait_l2_map_event(struct perf_event *event)
 		return -ENOENT;
 }
 
+/* Shared with the cpubw_hwmon governor, hence ONESHOT to match its flags */
 static int
 krait_l2_pmu_generic_request_irq(int irq, irq_handler_t *handle_irq)
 {
 	return request_irq(irq, *handle_irq,
-			IRQF_DISABLED | IRQF_NOBALANCING,
-			"krait-l2-armpmu", NULL);
+			IRQF_DISABLED | IRQF_NOBALANCING | IRQF_SHARED |
+			IRQF_ONESHOT, "krait-l2-armpmu", &krait_l2_pmu);
 }
 
 static void
 krait_l2_pmu_generic_free_irq(int irq)
 {
 	if (irq >= 0)
-		free_irq(irq, NULL);
+		free_irq(irq, &krait_l2_pmu);
 }
 
 static int msm_l2_test_set_ev_constraint(struct perf_event *event)
@@ -497,6 +507,10 @@ static int msm_l2_clear_ev_constraint(struct perf_event *event)
 	}
 	bitmap_t = 1 << shift_idx;
 
+	/* A reserved group is still in use after the last perf event */
+	if (l2_reserved_groups & bitmap_t)
+		goto out;
+
 	/* Clear constraint bit. */
 	l2_pmu_constraints.pmu_bitmap &= ~bitmap_t;
 
@@ -507,6 +521,85 @@ out:
 	return err;
 }
 
+/**
+ * krait_l2_pmu_reserve - claim L2PM counters and event groups outside perf
+ * @counters: mask of event counters
+ * @reg: L2PMRESRn register holding the groups
+ * @groups: mask of the groups used in that register
+ * @code: event code programmed in those groups
+ *
+ * Perf will not allocate the counters until they are released and only
+ * accepts events in the groups that use the same code. The L2PM is left
+ * globally enabled.
+ */
+int krait_l2_pmu_reserve(u32 counters, u8 reg, u8 groups, u8 code)
+{
+	u64 group_bits = (u64)groups << (reg * 4);
+	unsigned long iflags, flags;
+	int i, ret = 0;
+
+	raw_spin_lock_irqsave(&krait_l2_pmu_hw_events.pmu_lock, iflags);
+	raw_spin_lock_irqsave(&l2_pmu_constraints.lock, flags);
+
+	for (i = 0; i < total_l2_ctrs - 1; i++)
+		if ((counters & BIT(i)) && test_bit(i, l2_used_mask))
+			ret = -EBUSY;
+	for (i = 0; i < PMU_CODES_SIZE; i++)
+		if ((group_bits & (1ULL << i)) &&
+		    (l2_pmu_constraints.pmu_bitmap & (1ULL << i)) &&
+		    l2_pmu_constraints.codes[i] != code)
+			ret = -EBUSY;
+	if (ret)
+		goto out;
+
+	for (i = 0; i < total_l2_ctrs - 1; i++)
+		if (counters & BIT(i))
+			set_bit(i, l2_used_mask);
+	for (i = 0; i < PMU_CODES_SIZE; i++)
+		if (group_bits & (1ULL << i))
+			l2_pmu_constraints.codes[i] = code;
+	l2_pmu_constraints.pmu_bitmap |= group_bits;
+	l2_reserved_groups |= group_bits;
+	l2_reserved_ctrs |= counters;
+
+	set_l2_indirect_reg(L2PMCR, L2PMCR_GLOBAL_ENABLE);
+out:
+	raw_spin_unlock_irqrestore(&l2_pmu_constraints.lock, flags);
+	raw_spin_unlock_irqrestore(&krait_l2_pmu_hw_events.pmu_lock, iflags);
+	return ret;
+}
+EXPORT_SYMBOL(krait_l2_pmu_reserve);
+
+/**
+ * krait_l2_pmu_release - give back what krait_l2_pmu_reserve() claimed
+ * @counters: mask of event counters
+ * @reg: L2PMRESRn register holding the groups
+ * @groups: mask of the groups used in that register
+ */
+void krait_l2_pmu_release(u32 counters, u8 reg, u8 groups)
+{
+	u64 group_bits = (u64)groups << (reg * 4);
+	unsigned long iflags, flags;
+	int i;
+
+	raw_spin_lock_irqsave(&krait_l2_pmu_hw_events.pmu_lock, iflags);
+	raw_spin_lock_irqsave(&l2_pmu_constraints.lock, flags);
+
+	for (i = 0; i < total_l2_ctrs - 1; i++)
+		if (counters & BIT(i))
+			clear_bit(i, l2_used_mask);
+	l2_reserved_ctrs &= ~counters;
+	l2_reserved_groups &= ~group_bits;
+	l2_pmu_constraints.pmu_bitmap &= ~group_bits;
+
+	if (bitmap_empty(l2_used_mask, MAX_KRAIT_L2_CTRS))
+		set_l2_indirect_reg(L2PMCR, L2PMCR_GLOBAL_DISABLE);
+
+	raw_spin_unlock_irqrestore(&l2_pmu_constraints.lock, flags);
+	raw_spin_unlock_irqrestore(&krait_l2_pmu_hw_events.pmu_lock, iflags);
+}
+EXPORT_SYMBOL(krait_l2_pmu_release);
+
 int get_num_events(void)
 {
 	int val;
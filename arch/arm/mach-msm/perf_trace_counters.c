@@ -12,6 +12,8 @@
 #include <asm/thread_notify.h>
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
+#include <linux/perf_event.h>
+#include <linux/rcupdate.h>
 #define CREATE_TRACE_POINTS
 #include "perf_trace_counters.h"
 
@@ -81,6 +83,155 @@ static void disable_tp_pid(void)
 	}
 }
 
+#ifdef CONFIG_MSM_TASK_PMU
+/*
+ * Always-on per-task counts: three pinned per-cpu counters, read at every
+ * context switch and charged to the thread that is being switched out.
+ * The notifier runs before __switch_to() changes the stack, so current is
+ * still that thread.
+ */
+enum {
+	TASK_PMU_CYCLES,
+	TASK_PMU_INSTRUCTIONS,
+	TASK_PMU_L2_MISSES,
+	TASK_PMU_NR,
+};
+
+#define A7_L2D_CACHE_REFILL	0x17
+
+static struct perf_event_attr task_pmu_attr[TASK_PMU_NR] = {
+	[TASK_PMU_CYCLES] = {
+		.type	= PERF_TYPE_HARDWARE,
+		.config	= PERF_COUNT_HW_CPU_CYCLES,
+	},
+	[TASK_PMU_INSTRUCTIONS] = {
+		.type	= PERF_TYPE_HARDWARE,
+		.config	= PERF_COUNT_HW_INSTRUCTIONS,
+	},
+	[TASK_PMU_L2_MISSES] = {
+		.type	= PERF_TYPE_RAW,
+		.config	= A7_L2D_CACHE_REFILL,
+	},
+};
+
+static DEFINE_PER_CPU(struct perf_event *[TASK_PMU_NR], task_pmu_events);
+static DEFINE_PER_CPU(u64[TASK_PMU_NR], task_pmu_last);
+
+static u64 task_pmu_delta(int cpu, int i)
+{
+	struct perf_event *event = per_cpu(task_pmu_events[i], cpu);
+	u64 now, delta;
+
+	if (!event || event->state != PERF_EVENT_STATE_ACTIVE)
+		return 0;
+
+	event->pmu->read(event);
+	now = local64_read(&event->count);
+	delta = now - per_cpu(task_pmu_last[i], cpu);
+	per_cpu(task_pmu_last[i], cpu) = now;
+	return delta;
+}
+
+static int task_pmu_notifier(struct notifier_block *self, unsigned long cmd,
+		void *v)
+{
+	struct thread_info *thread = v;
+	struct task_pmu_counts *c = &current->pmu_counts;
+	int cpu = thread->cpu;
+
+	if (cmd != THREAD_NOTIFY_SWITCH)
+		return NOTIFY_DONE;
+
+	c->cycles += task_pmu_delta(cpu, TASK_PMU_CYCLES);
+	c->instructions += task_pmu_delta(cpu, TASK_PMU_INSTRUCTIONS);
+	c->l2_misses += task_pmu_delta(cpu, TASK_PMU_L2_MISSES);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block task_pmu_notifier_block = {
+	.notifier_call  = task_pmu_notifier,
+};
+
+static void task_pmu_start(int cpu)
+{
+	struct perf_event *event;
+	int i;
+
+	for (i = 0; i < TASK_PMU_NR; i++) {
+		event = perf_event_create_kernel_counter(&task_pmu_attr[i],
+							 cpu, NULL, NULL, NULL);
+		if (IS_ERR(event)) {
+			pr_err("task_pmu: cpu%d counter %d: %ld\n", cpu, i,
+			       PTR_ERR(event));
+			continue;
+		}
+		per_cpu(task_pmu_last[i], cpu) = 0;
+		per_cpu(task_pmu_events[i], cpu) = event;
+	}
+}
+
+static void task_pmu_stop(int cpu)
+{
+	struct perf_event *events[TASK_PMU_NR];
+	int i;
+
+	for (i = 0; i < TASK_PMU_NR; i++) {
+		events[i] = per_cpu(task_pmu_events[i], cpu);
+		per_cpu(task_pmu_events[i], cpu) = NULL;
+	}
+	/* the switch notifier runs with preemption off */
+	synchronize_sched();
+	for (i = 0; i < TASK_PMU_NR; i++)
+		if (events[i])
+			perf_event_release_kernel(events[i]);
+}
+
+static int task_pmu_cpu_notifier(struct notifier_block *self,
+				 unsigned long action, void *hcpu)
+{
+	int cpu = (int)hcpu;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_ONLINE:
+		task_pmu_start(cpu);
+		break;
+	case CPU_DOWN_PREPARE:
+		task_pmu_stop(cpu);
+		break;
+	case CPU_DOWN_FAILED:
+		task_pmu_start(cpu);
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block task_pmu_cpu_notifier_block = {
+	.notifier_call = task_pmu_cpu_notifier,
+};
+
+static void __init task_pmu_init(void)
+{
+	int cpu, i;
+
+	for (i = 0; i < TASK_PMU_NR; i++) {
+		task_pmu_attr[i].size = sizeof(struct perf_event_attr);
+		task_pmu_attr[i].pinned = 1;
+	}
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		task_pmu_start(cpu);
+	register_cpu_notifier(&task_pmu_cpu_notifier_block);
+	put_online_cpus();
+
+	thread_register_notifier(&task_pmu_notifier_block);
+}
+#else
+static inline void task_pmu_init(void)
+{
+}
+#endif
+
 static ssize_t read_enabled_perftp_file_bool(struct file *file,
 		char __user *user_buf, size_t count, loff_t *ppos)
 {
@@ -143,6 +294,7 @@ int __init init_tracecounters(void)
 	register_cpu_notifier(&tracectr_cpu_hotplug_notifier_block);
 	for_each_possible_cpu(cpu)
 		per_cpu(old_pid, cpu) = -1;
+	task_pmu_init();
 	return 0;
 }
 
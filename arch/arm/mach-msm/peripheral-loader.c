@@ -31,6 +31,9 @@
 #include <linux/idr.h>
 #include <linux/interrupt.h>
 #include <linux/of_gpio.h>
+#include <linux/async.h>
+#include <linux/crc32.h>
+#include <linux/ktime.h>
 
 #include <asm/uaccess.h>
 #include <asm/setup.h>
@@ -76,6 +79,10 @@ struct pil_mdt {
  * @filesz: size of segment on disk
  * @num: segment number
  * @relocated: true if segment is relocated, false otherwise
+ * @desc: descriptor the segment is loaded for
+ * @cookie: async cookie of the blob request
+ * @fw_ret: result of the blob request
+ * @fw: blob contents, for images that are retained across restarts
  *
  * Loosely based on an elf program header. Contains all necessary information
  * to load and initialize a segment of the image in memory.
@@ -87,6 +94,24 @@ struct pil_seg {
 	int num;
 	struct list_head list;
 	bool relocated;
+	struct pil_desc *desc;
+	async_cookie_t cookie;
+	int fw_ret;
+	const struct firmware *fw;
+};
+
+/**
+ * struct pil_blob - segment blob kept in memory for the next boot
+ * @list: entry in pil_priv::blobs
+ * @num: segment number
+ * @fw: blob contents
+ * @crc: crc32 of @fw taken when it was retained
+ */
+struct pil_blob {
+	struct list_head list;
+	int num;
+	const struct firmware *fw;
+	u32 crc;
 };
 
 /**
@@ -116,6 +141,10 @@ struct pil_image_info {
  * non-relocatable images
  * @region: region allocated for relocatable images
  * @unvoted_flag: flag to keep track if we have unvoted or not.
+ * @seg_domain: async domain the segment blobs are requested in
+ * @retain: keep the image in memory after the first boot
+ * @mdt: retained metadata, or NULL if nothing is retained yet
+ * @blobs: retained segment blobs
  *
  * This struct contains data for a pil_desc that should not be exposed outside
  * of this file. This structure points to the descriptor and the descriptor
@@ -136,6 +165,10 @@ struct pil_priv {
 	struct pil_image_info __iomem *info;
 	int id;
 	int unvoted_flag;
+	struct list_head seg_domain;
+	bool retain;
+	const struct firmware *mdt;
+	struct list_head blobs;
 };
 
 /**
@@ -292,7 +325,7 @@ static struct pil_seg *pil_init_seg(const struct pil_desc *desc,
 		return ERR_PTR(-EINVAL);
 	}
 
-	seg = kmalloc(sizeof(*seg), GFP_KERNEL);
+	seg = kzalloc(sizeof(*seg), GFP_KERNEL);
 	if (!seg)
 		return ERR_PTR(-ENOMEM);
 	seg->num = num;
@@ -518,6 +551,142 @@ static void pil_release_mmap(struct pil_desc *desc)
 
 #define IOMAP_SIZE SZ_1M
 
+/*
+ * Peripherals marked qcom,pil-retain-image keep the .mdt and every blob
+ * in memory after the first successful boot, so a restart copies the
+ * image back into place instead of reading it from the filesystem
+ * again. Each blob's crc is checked before it is reused; any mismatch
+ * drops the whole copy and falls back to the files.
+ */
+static struct pil_blob *pil_find_blob(struct pil_priv *priv, int num)
+{
+	struct pil_blob *blob;
+
+	list_for_each_entry(blob, &priv->blobs, list)
+		if (blob->num == num)
+			return blob;
+	return NULL;
+}
+
+static void pil_release_blobs(struct pil_priv *priv)
+{
+	struct pil_blob *blob, *tmp;
+
+	list_for_each_entry_safe(blob, tmp, &priv->blobs, list) {
+		list_del(&blob->list);
+		release_firmware(blob->fw);
+		kfree(blob);
+	}
+	release_firmware(priv->mdt);
+	priv->mdt = NULL;
+}
+
+static bool pil_blobs_intact(struct pil_desc *desc)
+{
+	struct pil_priv *priv = desc->priv;
+	struct pil_blob *blob;
+
+	list_for_each_entry(blob, &priv->blobs, list) {
+		if (crc32_le(~0, blob->fw->data, blob->fw->size) != blob->crc) {
+			pil_err(desc, "Retained blob%d is corrupt, reloading image\n",
+				blob->num);
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Hand the mdt and the blobs just loaded over to priv->blobs */
+static void pil_retain_image(struct pil_desc *desc, const struct firmware *mdt)
+{
+	struct pil_priv *priv = desc->priv;
+	struct pil_blob *blob;
+	struct pil_seg *seg;
+
+	priv->mdt = mdt;
+	list_for_each_entry(seg, &priv->segs, list) {
+		if (!seg->fw)
+			continue;
+		blob = kmalloc(sizeof(*blob), GFP_KERNEL);
+		if (!blob) {
+			pil_err(desc, "Not retaining image: out of memory\n");
+			release_firmware(seg->fw);
+			seg->fw = NULL;
+			pil_release_blobs(priv);
+			return;
+		}
+		blob->num = seg->num;
+		blob->fw = seg->fw;
+		blob->crc = crc32_le(~0, seg->fw->data, seg->fw->size);
+		list_add_tail(&blob->list, &priv->blobs);
+		seg->fw = NULL;
+	}
+}
+
+static void pil_release_seg_fw(struct pil_priv *priv)
+{
+	struct pil_seg *seg;
+
+	list_for_each_entry(seg, &priv->segs, list) {
+		release_firmware(seg->fw);
+		seg->fw = NULL;
+	}
+}
+
+static int pil_copy_seg(struct pil_desc *desc, struct pil_seg *seg)
+{
+	phys_addr_t paddr = seg->paddr;
+	const u8 *data = seg->fw->data;
+	size_t count = seg->filesz;
+
+	while (count > 0) {
+		size_t size = min_t(size_t, IOMAP_SIZE, count);
+		u8 __iomem *buf;
+
+		buf = ioremap(paddr, size);
+		if (!buf) {
+			pil_err(desc, "Failed to map memory\n");
+			return -ENOMEM;
+		}
+		memcpy(buf, data, size);
+		iounmap(buf);
+
+		count -= size;
+		paddr += size;
+		data += size;
+	}
+	return 0;
+}
+
+static void pil_seg_name(const struct pil_seg *seg, char *buf, size_t len)
+{
+	snprintf(buf, len, "%s.b%02d", seg->desc->name, seg->num);
+}
+
+/*
+ * Every blob is requested at once, straight into its place in the
+ * region, so the reads overlap each other; pil_load_seg() then waits for
+ * them in order, which lets the peripheral verify one segment while the
+ * following ones are still being read.
+ */
+static void pil_request_seg(void *data, async_cookie_t cookie)
+{
+	struct pil_seg *seg = data;
+	char fw_name[30];
+
+	pil_seg_name(seg, fw_name, sizeof(fw_name));
+	if (!seg->desc->priv->retain) {
+		seg->fw_ret = request_firmware_direct(fw_name, seg->desc->dev,
+						      seg->paddr, seg->filesz);
+		return;
+	}
+
+	/* keep a copy: load through a buffer rather than in place */
+	seg->fw_ret = request_firmware(&seg->fw, fw_name, seg->desc->dev);
+	if (!seg->fw_ret)
+		seg->fw_ret = seg->fw->size;
+}
+
 static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
 {
 	int ret = 0, count;
@@ -526,10 +695,10 @@ static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
 	int num = seg->num;
 
 	if (seg->filesz) {
-		snprintf(fw_name, ARRAY_SIZE(fw_name), "%s.b%02d",
-				desc->name, num);
-		ret = request_firmware_direct(fw_name, desc->dev, seg->paddr,
-					      seg->filesz);
+		pil_seg_name(seg, fw_name, sizeof(fw_name));
+		async_synchronize_cookie_domain(seg->cookie + 1,
+						&desc->priv->seg_domain);
+		ret = seg->fw_ret;
 		if (ret < 0) {
 			pil_err(desc, "Failed to locate blob %s or blob is too big.\n",
 				fw_name);
@@ -542,6 +711,12 @@ static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
 			return -EPERM;
 		}
 		ret = 0;
+
+		if (seg->fw) {
+			ret = pil_copy_seg(desc, seg);
+			if (ret)
+				return ret;
+		}
 	}
 
 	/* Zero out trailing memory */
@@ -577,6 +752,9 @@ static void pil_parse_devicetree(struct pil_desc *desc)
 {
 	int clk_ready = 0;
 
+	desc->priv->retain = of_property_read_bool(desc->dev->of_node,
+						   "qcom,pil-retain-image");
+
 	if (desc->ops->proxy_unvote &&
 		of_find_property(desc->dev->of_node,
 				"qcom,gpio-proxy-unvote",
@@ -684,19 +862,32 @@ int pil_boot(struct pil_desc *desc)
 	const struct pil_mdt *mdt;
 	const struct elf32_hdr *ehdr;
 	struct pil_seg *seg;
+	struct pil_blob *blob;
 	const struct firmware *fw;
 	struct pil_priv *priv = desc->priv;
+	ktime_t start, t_mdt, t_segs, t_auth;
+	bool retained;
 
 	/* Reinitialize for new image */
 	pil_release_mmap(desc);
 
 	down_read(&pil_pm_rwsem);
-	snprintf(fw_name, sizeof(fw_name), "%s.mdt", desc->name);
-	ret = request_firmware(&fw, fw_name, desc->dev);
-	if (ret) {
-		pil_err(desc, "Failed to locate %s\n", fw_name);
-		goto out;
+	start = ktime_get();
+	if (priv->mdt && !pil_blobs_intact(desc))
+		pil_release_blobs(priv);
+	retained = priv->mdt;
+
+	if (retained) {
+		fw = priv->mdt;
+	} else {
+		snprintf(fw_name, sizeof(fw_name), "%s.mdt", desc->name);
+		ret = request_firmware(&fw, fw_name, desc->dev);
+		if (ret) {
+			pil_err(desc, "Failed to locate %s\n", fw_name);
+			goto out;
+		}
 	}
+	t_mdt = ktime_get();
 
 	if (fw->size < sizeof(*ehdr)) {
 		pil_err(desc, "Not big enough to be an elf header\n");
@@ -753,11 +944,35 @@ int pil_boot(struct pil_desc *desc)
 		goto release_fw;
 	}
 
+	list_for_each_entry(seg, &desc->priv->segs, list) {
+		seg->desc = desc;
+		if (!seg->filesz)
+			continue;
+		if (!retained) {
+			seg->cookie = async_schedule_domain(pil_request_seg,
+							    seg, &priv->seg_domain);
+			continue;
+		}
+		blob = pil_find_blob(priv, seg->num);
+		if (!blob) {
+			pil_err(desc, "No retained blob%d\n", seg->num);
+			ret = -EIO;
+			goto release_fw;
+		}
+		seg->fw = blob->fw;
+		seg->fw_ret = blob->fw->size;
+	}
+
 	list_for_each_entry(seg, &desc->priv->segs, list) {
 		ret = pil_load_seg(desc, seg);
 		if (ret)
-			goto release_fw;
+			break;
 	}
+	/* the region must stay put until every request has let go of it */
+	async_synchronize_full_domain(&priv->seg_domain);
+	if (ret)
+		goto release_fw;
+	t_segs = ktime_get();
 
 	desc->priv->unvoted_flag = 0;
 	ret = pil_proxy_vote(desc);
@@ -771,11 +986,26 @@ int pil_boot(struct pil_desc *desc)
 		pil_err(desc, "Failed to bring out of reset\n");
 		goto err_boot;
 	}
-	pil_info(desc, "Brought out of reset\n");
+	t_auth = ktime_get();
+	pil_info(desc, "Brought out of reset in %lld ms (mdt %lld, segments %lld, auth %lld)%s\n",
+		 ktime_to_ms(ktime_sub(t_auth, start)),
+		 ktime_to_ms(ktime_sub(t_mdt, start)),
+		 ktime_to_ms(ktime_sub(t_segs, t_mdt)),
+		 ktime_to_ms(ktime_sub(t_auth, t_segs)),
+		 retained ? " from retained image" : "");
 err_boot:
 	pil_proxy_unvote(desc, ret);
 release_fw:
-	release_firmware(fw);
+	if (retained) {
+		/* don't trust the copy again if booting from it failed */
+		if (ret)
+			pil_release_blobs(priv);
+	} else if (!ret && priv->retain) {
+		pil_retain_image(desc, fw);
+	} else {
+		pil_release_seg_fw(priv);
+		release_firmware(fw);
+	}
 out:
 	up_read(&pil_pm_rwsem);
 	if (ret) {
@@ -879,6 +1109,8 @@ int pil_desc_init(struct pil_desc *desc)
 	wake_lock_init(&priv->wlock, WAKE_LOCK_SUSPEND, priv->wname);
 	INIT_DELAYED_WORK(&priv->proxy, pil_proxy_unvote_work);
 	INIT_LIST_HEAD(&priv->segs);
+	INIT_LIST_HEAD(&priv->seg_domain);
+	INIT_LIST_HEAD(&priv->blobs);
 
 	return 0;
 err:
@@ -896,6 +1128,7 @@ void pil_desc_release(struct pil_desc *desc)
 	struct pil_priv *priv = desc->priv;
 
 	if (priv) {
+		pil_release_blobs(priv);
 		ida_simple_remove(&pil_ida, priv->id);
 		flush_delayed_work(&priv->proxy);
 		wake_lock_destroy(&priv->wlock);
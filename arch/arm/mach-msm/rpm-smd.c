@@ -16,17 +16,20 @@
 #include <linux/types.h>
 #include <linux/bug.h>
 #include <linux/completion.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/init.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
 #include <linux/irq.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/spinlock.h>
 #include <linux/string.h>
 #include <linux/device.h>
 #include <linux/notifier.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/workqueue.h>
 #include <linux/platform_device.h>
@@ -72,6 +75,9 @@ struct msm_rpm_driver_data {
 #define ERR "err\0"
 #define MAX_ERR_BUFFER_SIZE 128
 #define INIT_ERROR 1
+/* How long nowait active set votes are held for merging */
+#define MSM_RPM_BATCH_WINDOW msecs_to_jiffies(1)
+#define MSM_RPM_BATCH_MAX_KVPS 16
 
 static ATOMIC_NOTIFIER_HEAD(msm_rpm_sleep_notifier);
 static bool standalone;
@@ -130,6 +136,23 @@ struct slp_buf {
 	bool valid;
 };
 static struct rb_root tr_root = RB_ROOT;
+/* Last active set value sent for each resource */
+static struct rb_root act_root = RB_ROOT;
+static DEFINE_SPINLOCK(act_cache_lock);
+
+struct msm_rpm_stats {
+	u32 requests;		/* messages sent that get an ACK */
+	u32 acks;
+	u32 nacks;
+	u64 total_ack_us;
+	u32 max_ack_us;
+	u32 kvps_dropped;	/* KVPs matching the value last sent */
+	u32 msgs_dropped;	/* messages left with nothing to send */
+	u32 votes_merged;	/* nowait votes folded into a pending one */
+	u32 batches;		/* pending nowait messages sent */
+};
+static struct msm_rpm_stats msm_rpm_stats;
+
 static int msm_rpm_send_smd_buffer(char *buf, uint32_t size, bool noirq);
 static uint32_t msm_rpm_get_next_msg_id(void);
 
@@ -343,6 +366,66 @@ int msm_rpm_smd_buffer_request(char *buf, uint32_t size, gfp_t flag)
 
 	return 0;
 }
+
+static struct slp_buf *act_search(uint32_t rsc_type, uint32_t rsc_id)
+{
+	struct {
+		struct rpm_request_header req;
+		struct rpm_message_header msg;
+	} key = {
+		.msg.resource_type = rsc_type,
+		.msg.resource_id = rsc_id,
+	};
+
+	return tr_search(&act_root, (char *)&key);
+}
+
+static void msm_rpm_cache_active(char *buf)
+{
+	struct slp_buf *a;
+	unsigned long flags;
+	uint32_t size = get_buf_len(buf);
+
+	spin_lock_irqsave(&act_cache_lock, flags);
+	a = tr_search(&act_root, buf);
+
+	if (!a) {
+		if (size > MAX_SLEEP_BUFFER)
+			goto out;
+		a = kzalloc(sizeof(struct slp_buf), GFP_ATOMIC);
+		if (!a)
+			goto out;
+		a->buf = PTR_ALIGN(&a->ubuf[0], sizeof(u32));
+		memcpy(a->buf, buf, size);
+		if (tr_insert(&act_root, a))
+			kfree(a);
+	} else if (get_buf_len(a->buf) + get_data_len(buf) >
+			MAX_SLEEP_BUFFER) {
+		/* Too many keys to track, stop filtering this resource */
+		rb_erase(&a->node, &act_root);
+		kfree(a);
+	} else {
+		tr_update(a, buf);
+	}
+out:
+	spin_unlock_irqrestore(&act_cache_lock, flags);
+}
+
+/* The RPM rejected a vote, so what it holds is no longer known */
+static void msm_rpm_uncache_active(uint32_t rsc_type, uint32_t rsc_id)
+{
+	struct slp_buf *a;
+	unsigned long flags;
+
+	spin_lock_irqsave(&act_cache_lock, flags);
+	a = act_search(rsc_type, rsc_id);
+	if (a) {
+		rb_erase(&a->node, &act_root);
+		kfree(a);
+	}
+	spin_unlock_irqrestore(&act_cache_lock, flags);
+}
+
 static void msm_rpm_print_sleep_buffer(struct slp_buf *s)
 {
 	char buf[DEBUG_PRINT_BUFFER_SIZE] = {0};
@@ -437,6 +520,8 @@ struct msm_rpm_request {
 	uint32_t write_idx;
 	uint8_t *buf;
 	uint32_t numbytes;
+	/* Chain in msm_rpm_batch */
+	struct list_head list;
 };
 
 /*
@@ -451,6 +536,12 @@ struct msm_rpm_wait_data {
 	bool ack_recd;
 	int errno;
 	struct completion ack;
+	uint32_t rsc_type;
+	uint32_t rsc_id;
+	enum msm_rpm_set set;
+	/* Nobody waits, the ACK path frees the entry */
+	bool nowait;
+	ktime_t sent;
 };
 DEFINE_SPINLOCK(msm_rpm_list_lock);
 
@@ -717,7 +808,7 @@ static uint32_t msm_rpm_get_next_msg_id(void)
 	return id;
 }
 
-static int msm_rpm_add_wait_list(uint32_t msg_id)
+static int msm_rpm_add_wait_list(struct rpm_message_header *hdr, bool nowait)
 {
 	unsigned long flags;
 	struct msm_rpm_wait_data *data =
@@ -728,10 +819,16 @@ static int msm_rpm_add_wait_list(uint32_t msg_id)
 
 	init_completion(&data->ack);
 	data->ack_recd = false;
-	data->msg_id = msg_id;
+	data->msg_id = hdr->msg_id;
 	data->errno = INIT_ERROR;
+	data->rsc_type = hdr->resource_type;
+	data->rsc_id = hdr->resource_id;
+	data->set = hdr->set;
+	data->nowait = nowait;
+	data->sent = ktime_get();
 	spin_lock_irqsave(&msm_rpm_list_lock, flags);
 	list_add(&data->list, &msm_rpm_wait_list);
+	msm_rpm_stats.requests++;
 	spin_unlock_irqrestore(&msm_rpm_list_lock, flags);
 
 	return 0;
@@ -758,6 +855,26 @@ static void msm_rpm_process_ack(uint32_t msg_id, int errno)
 	list_for_each(ptr, &msm_rpm_wait_list) {
 		elem = list_entry(ptr, struct msm_rpm_wait_data, list);
 		if (elem && (elem->msg_id == msg_id)) {
+			uint32_t delay = ktime_us_delta(ktime_get(),
+							elem->sent);
+
+			msm_rpm_stats.acks++;
+			msm_rpm_stats.total_ack_us += delay;
+			if (delay > msm_rpm_stats.max_ack_us)
+				msm_rpm_stats.max_ack_us = delay;
+			if (errno) {
+				msm_rpm_stats.nacks++;
+				if (elem->set == MSM_RPM_CTX_ACTIVE_SET)
+					msm_rpm_uncache_active(elem->rsc_type,
+							elem->rsc_id);
+			}
+
+			if (elem->nowait) {
+				trace_rpm_ack_recd(0, msg_id);
+				list_del(&elem->list);
+				kfree(elem);
+				break;
+			}
 			elem->errno = errno;
 			elem->ack_recd = true;
 			complete(&elem->ack);
@@ -1027,8 +1144,48 @@ static int msm_rpm_send_smd_buffer(char *buf, uint32_t size, bool noirq)
 	return ret;
 
 }
+/*
+ * Leave out of an active set request the KVPs that hold what was last
+ * sent for the resource; the RPM already has them.
+ */
+static void msm_rpm_drop_redundant(struct msm_rpm_request *cdata)
+{
+	struct slp_buf *a;
+	struct kvp *e;
+	unsigned long flags;
+	uint32_t i;
+
+	spin_lock_irqsave(&act_cache_lock, flags);
+	a = act_search(cdata->msg_hdr.resource_type,
+			cdata->msg_hdr.resource_id);
+	if (!a)
+		goto out;
+
+	for (i = 0; i < cdata->write_idx; i++) {
+		struct msm_rpm_kvp_data *kvp = &cdata->kvp[i];
+
+		if (!kvp->valid)
+			continue;
+
+		for_each_kvp(a->buf, e) {
+			if (e->k != kvp->key)
+				continue;
+			if (e->s == kvp->nbytes &&
+				!memcmp(get_data(e), kvp->value, e->s)) {
+				kvp->valid = false;
+				cdata->msg_hdr.data_len -= kvp->nbytes +
+					sizeof(struct rpm_request_header);
+				msm_rpm_stats.kvps_dropped++;
+			}
+			break;
+		}
+	}
+out:
+	spin_unlock_irqrestore(&act_cache_lock, flags);
+}
+
 static int msm_rpm_send_data(struct msm_rpm_request *cdata,
-		int msg_type, bool noirq)
+		int msg_type, bool noirq, bool nowait)
 {
 	uint8_t *tmpbuff;
 	int ret;
@@ -1039,6 +1196,14 @@ static int msm_rpm_send_data(struct msm_rpm_request *cdata,
 	if (!cdata->msg_hdr.data_len)
 		return 1;
 
+	if (cdata->msg_hdr.set == MSM_RPM_CTX_ACTIVE_SET) {
+		msm_rpm_drop_redundant(cdata);
+		if (!cdata->msg_hdr.data_len) {
+			msm_rpm_stats.msgs_dropped++;
+			return 1;
+		}
+	}
+
 	req_hdr_sz = sizeof(cdata->req_hdr);
 	msg_hdr_sz = sizeof(cdata->msg_hdr);
 
@@ -1109,7 +1274,7 @@ static int msm_rpm_send_data(struct msm_rpm_request *cdata,
 		return ret;
 	}
 
-	msm_rpm_add_wait_list(cdata->msg_hdr.msg_id);
+	msm_rpm_add_wait_list(&cdata->msg_hdr, nowait);
 
 	ret = msm_rpm_send_smd_buffer(&cdata->buf[0], msg_size, noirq);
 
@@ -1118,6 +1283,8 @@ static int msm_rpm_send_data(struct msm_rpm_request *cdata,
 				cdata->msg_hdr.resource_type,
 				cdata->msg_hdr.resource_id,
 				cdata->msg_hdr.msg_id);
+		if (cdata->msg_hdr.set == MSM_RPM_CTX_ACTIVE_SET)
+			msm_rpm_cache_active(cdata->buf);
 		for (i = 0; (i < cdata->write_idx); i++)
 			cdata->kvp[i].valid = false;
 		cdata->msg_hdr.data_len = 0;
@@ -1134,13 +1301,52 @@ static int msm_rpm_send_data(struct msm_rpm_request *cdata,
 	return ret;
 }
 
+/* Active set votes from msm_rpm_send_message_nowait() not sent yet */
+static LIST_HEAD(msm_rpm_batch);
+static DEFINE_SPINLOCK(msm_rpm_batch_lock);
+
+/*
+ * Send what is pending for one resource, or for all of them if @handle
+ * is NULL. The lock is held across the send so that a pending vote can
+ * never reach the RPM after a later synchronous one.
+ */
+static void msm_rpm_flush_batch(struct msm_rpm_request *handle)
+{
+	struct msm_rpm_request *req, *next;
+	unsigned long flags;
+
+	spin_lock_irqsave(&msm_rpm_batch_lock, flags);
+	list_for_each_entry_safe(req, next, &msm_rpm_batch, list) {
+		if (handle && (req->msg_hdr.resource_type !=
+				handle->msg_hdr.resource_type ||
+				req->msg_hdr.resource_id !=
+				handle->msg_hdr.resource_id))
+			continue;
+		list_del(&req->list);
+		msm_rpm_send_data(req, MSM_RPM_MSG_REQUEST_TYPE, true, true);
+		msm_rpm_free_request(req);
+		msm_rpm_stats.batches++;
+	}
+	spin_unlock_irqrestore(&msm_rpm_batch_lock, flags);
+}
+
+static void msm_rpm_batch_work_fn(struct work_struct *work)
+{
+	msm_rpm_flush_batch(NULL);
+}
+static DECLARE_DELAYED_WORK(msm_rpm_batch_work, msm_rpm_batch_work_fn);
+
 int msm_rpm_send_request(struct msm_rpm_request *handle)
 {
 	int ret;
 	static DEFINE_MUTEX(send_mtx);
 
+	if (handle->msg_hdr.set == MSM_RPM_CTX_ACTIVE_SET)
+		msm_rpm_flush_batch(handle);
+
 	mutex_lock(&send_mtx);
-	ret = msm_rpm_send_data(handle, MSM_RPM_MSG_REQUEST_TYPE, false);
+	ret = msm_rpm_send_data(handle, MSM_RPM_MSG_REQUEST_TYPE, false,
+				false);
 	mutex_unlock(&send_mtx);
 
 	return ret;
@@ -1149,7 +1355,11 @@ EXPORT_SYMBOL(msm_rpm_send_request);
 
 int msm_rpm_send_request_noirq(struct msm_rpm_request *handle)
 {
-	return msm_rpm_send_data(handle, MSM_RPM_MSG_REQUEST_TYPE, true);
+	if (handle->msg_hdr.set == MSM_RPM_CTX_ACTIVE_SET)
+		msm_rpm_flush_batch(handle);
+
+	return msm_rpm_send_data(handle, MSM_RPM_MSG_REQUEST_TYPE, true,
+				false);
 }
 EXPORT_SYMBOL(msm_rpm_send_request_noirq);
 
@@ -1288,6 +1498,70 @@ bail:
 }
 EXPORT_SYMBOL(msm_rpm_send_message_noirq);
 
+int msm_rpm_send_message_nowait(enum msm_rpm_set set, uint32_t rsc_type,
+		uint32_t rsc_id, struct msm_rpm_kvp *kvp, int nelems)
+{
+	struct msm_rpm_request *req;
+	unsigned long flags;
+	bool found = false;
+	int i, rc = 0;
+
+	/* Sleep set votes are only buffered, there is no ACK to wait for */
+	if (set != MSM_RPM_CTX_ACTIVE_SET)
+		return msm_rpm_send_message_noirq(set, rsc_type, rsc_id,
+				kvp, nelems);
+
+	if (nelems > MSM_RPM_BATCH_MAX_KVPS)
+		return -EINVAL;
+
+	spin_lock_irqsave(&msm_rpm_batch_lock, flags);
+	list_for_each_entry(req, &msm_rpm_batch, list) {
+		if (req->msg_hdr.resource_type == rsc_type &&
+				req->msg_hdr.resource_id == rsc_id) {
+			found = true;
+			break;
+		}
+	}
+
+	if (found) {
+		if (req->write_idx + nelems > MSM_RPM_BATCH_MAX_KVPS) {
+			list_del(&req->list);
+			msm_rpm_send_data(req, MSM_RPM_MSG_REQUEST_TYPE,
+					true, true);
+			msm_rpm_free_request(req);
+			msm_rpm_stats.batches++;
+			found = false;
+		} else {
+			msm_rpm_stats.votes_merged++;
+		}
+	}
+
+	if (!found) {
+		req = msm_rpm_create_request_common(set, rsc_type, rsc_id,
+				MSM_RPM_BATCH_MAX_KVPS, true);
+		if (!req) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		list_add_tail(&req->list, &msm_rpm_batch);
+	}
+
+	/* A later value for a key replaces the pending one */
+	for (i = 0; i < nelems; i++) {
+		rc = msm_rpm_add_kvp_data_noirq(req, kvp[i].key,
+				kvp[i].data, kvp[i].length);
+		if (rc)
+			break;
+	}
+out:
+	spin_unlock_irqrestore(&msm_rpm_batch_lock, flags);
+
+	/* Runs a window after the first vote, however many follow */
+	schedule_delayed_work(&msm_rpm_batch_work, MSM_RPM_BATCH_WINDOW);
+	return rc;
+}
+EXPORT_SYMBOL(msm_rpm_send_message_nowait);
+
 /**
  * During power collapse, the rpm driver disables the SMD interrupts to make
  * sure that the interrupt doesn't wakes us from sleep.
@@ -1297,6 +1571,8 @@ int msm_rpm_enter_sleep(bool print, const struct cpumask *cpumask)
 	if (standalone)
 		return 0;
 
+	/* Active set votes still held for merging go out first */
+	msm_rpm_flush_batch(NULL);
 	msm_rpm_flush_requests(print);
 
 	return smd_mask_receive_interrupt(msm_rpm_data.ch_info, true, cpumask);
@@ -1316,6 +1592,34 @@ void msm_rpm_exit_sleep(void)
 }
 EXPORT_SYMBOL(msm_rpm_exit_sleep);
 
+static int msm_rpm_stats_show(struct seq_file *m, void *unused)
+{
+	struct msm_rpm_stats *st = &msm_rpm_stats;
+
+	seq_printf(m, "requests: %u\nacks: %u\nnacks: %u\n",
+			st->requests, st->acks, st->nacks);
+	seq_printf(m, "ack latency: avg %llu us max %u us\n",
+			st->acks ? div_u64(st->total_ack_us, st->acks) : 0,
+			st->max_ack_us);
+	seq_printf(m, "redundant kvps dropped: %u\n", st->kvps_dropped);
+	seq_printf(m, "redundant messages dropped: %u\n", st->msgs_dropped);
+	seq_printf(m, "nowait votes merged: %u\n", st->votes_merged);
+	seq_printf(m, "nowait messages sent: %u\n", st->batches);
+	return 0;
+}
+
+static int msm_rpm_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_rpm_stats_show, inode->i_private);
+}
+
+static const struct file_operations msm_rpm_stats_fops = {
+	.open = msm_rpm_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int __devinit msm_rpm_smd_remote_probe(struct platform_device *pdev)
 {
 	if (pdev && pdev->id == msm_rpm_data.ch_type)
@@ -1393,6 +1697,9 @@ static int __devinit msm_rpm_dev_probe(struct platform_device *pdev)
 
 	of_platform_populate(pdev->dev.of_node, NULL, NULL, &pdev->dev);
 
+	debugfs_create_file("rpm_smd_stats", S_IRUGO, NULL, NULL,
+			&msm_rpm_stats_fops);
+
 	if (standalone)
 		pr_info("%s(): RPM running in standalone mode\n", __func__);
 
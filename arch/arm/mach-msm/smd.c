@@ -149,6 +149,12 @@ int msm_smd_debug_mask = MSM_SMD_POWER_INFO | MSM_SMD_INFO |
 							MSM_SMSM_POWER_INFO;
 module_param_named(debug_mask, msm_smd_debug_mask,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static int smd_rx_batch = 1;
+module_param_named(rx_batch, smd_rx_batch, int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Passes over an edge's channels before its interrupt is unmasked */
+#define SMD_RX_BUDGET	8
 void *smd_log_ctx;
 void *smsm_log_ctx;
 #define NUM_LOG_PAGES 4
@@ -587,6 +593,11 @@ struct remote_proc_info {
 	struct list_head ch_list;
 	/* 2 total supported tables of channels */
 	unsigned char ch_allocated[SMEM_NUM_SMD_STREAM_CHANNELS * 2];
+	/* receive interrupt mitigation, see smd_rx_defer() */
+	struct tasklet_struct rx_tasklet;
+	int rx_irq;
+	unsigned rx_batches;
+	unsigned rx_passes;
 };
 
 static struct remote_proc_info remote_info[NUM_SMD_SUBSYSTEMS];
@@ -1287,7 +1298,11 @@ static void handle_smd_irq_closing_list(void)
 	spin_unlock_irqrestore(&smd_lock, flags);
 }
 
-static void handle_smd_irq(struct remote_proc_info *r_info,
+/*
+ * Returns the number of channels that had a data event, the batched
+ * receive path keeps calling until a pass comes back empty.
+ */
+static int handle_smd_irq(struct remote_proc_info *r_info,
 		void (*notify)(smd_channel_t *ch))
 {
 	unsigned long flags;
@@ -1296,6 +1311,8 @@ static void handle_smd_irq(struct remote_proc_info *r_info,
 	unsigned tmp;
 	unsigned char state_change;
 	struct list_head *list;
+	int data_events = 0;
+	int avail;
 
 	list = &r_info->ch_list;
 
@@ -1338,6 +1355,11 @@ static void handle_smd_irq(struct remote_proc_info *r_info,
 				ch->half_ch->get_tail(ch->recv),
 				ch->half_ch->get_head(ch->recv)
 				);
+			avail = smd_stream_read_avail(ch);
+			ch->rx_events++;
+			ch->rx_bytes += avail;
+			ch->rx_max = max_t(unsigned, ch->rx_max, avail);
+			data_events++;
 			ch->notify(ch->priv, SMD_EVENT_DATA);
 		}
 		if (ch_flags & 0x4 && !state_change) {
@@ -1348,6 +1370,76 @@ static void handle_smd_irq(struct remote_proc_info *r_info,
 	}
 	spin_unlock_irqrestore(&smd_lock, flags);
 	do_smd_probe(r_info->remote_pid);
+
+	return data_events;
+}
+
+/*
+ * Receive interrupt mitigation. An edge's interrupt masks itself and hands
+ * over to a tasklet. The tasklet keeps draining the edge's channels until
+ * a pass finds no new data or SMD_RX_BUDGET passes have run. A burst of
+ * packets from the remote then costs one interrupt, and each channel is
+ * notified once per pass instead of once per packet. The interrupts are
+ * edge triggered and lazily disabled, so one that fires while masked is
+ * replayed when it is unmasked.
+ */
+static void smd_rx_tasklet(unsigned long data)
+{
+	struct remote_proc_info *r_info = (struct remote_proc_info *)data;
+	int budget = SMD_RX_BUDGET;
+
+	r_info->rx_batches++;
+	do {
+		r_info->rx_passes++;
+	} while (handle_smd_irq(r_info, NULL) && --budget);
+	handle_smd_irq_closing_list();
+
+	enable_irq(r_info->rx_irq);
+}
+
+static int smd_rx_defer(struct remote_proc_info *r_info, int irq)
+{
+	if (!smd_rx_batch || !r_info->rx_tasklet.func)
+		return 0;
+
+	r_info->rx_irq = irq;
+	disable_irq_nosync(irq);
+	tasklet_hi_schedule(&r_info->rx_tasklet);
+	return 1;
+}
+
+int smd_rx_batch_stats(char *buf, int max)
+{
+	unsigned long flags;
+	struct smd_channel *ch;
+	int i = 0;
+	int n;
+
+	i += scnprintf(buf + i, max - i,
+		"   Subsystem    |  Batches  |   Passes\n");
+	for (n = 0; n < NUM_SMD_SUBSYSTEMS; ++n) {
+		if (!smd_pid_to_subsystem(n))
+			continue;
+		i += scnprintf(buf + i, max - i, "%-16s| %9u | %9u\n",
+			smd_pid_to_subsystem(n), remote_info[n].rx_batches,
+			remote_info[n].rx_passes);
+	}
+
+	i += scnprintf(buf + i, max - i,
+		"\n   Channel          |  Events   | Avg bytes | Max bytes\n");
+	spin_lock_irqsave(&smd_lock, flags);
+	for (n = 0; n < NUM_SMD_SUBSYSTEMS; ++n) {
+		list_for_each_entry(ch, &remote_info[n].ch_list, ch_list) {
+			i += scnprintf(buf + i, max - i,
+				"%-20s| %9u | %9u | %9u\n", ch->name,
+				ch->rx_events,
+				ch->rx_events ? ch->rx_bytes / ch->rx_events : 0,
+				ch->rx_max);
+		}
+	}
+	spin_unlock_irqrestore(&smd_lock, flags);
+
+	return i;
 }
 
 static inline void log_irq(uint32_t subsystem)
@@ -1363,6 +1455,8 @@ irqreturn_t smd_modem_irq_handler(int irq, void *data)
 {
 	log_irq(SMD_APPS_MODEM);
 	++interrupt_stats[SMD_MODEM].smd_in_count;
+	if (smd_rx_defer(&remote_info[SMD_MODEM], irq))
+		return IRQ_HANDLED;
 	handle_smd_irq(&remote_info[SMD_MODEM], notify_modem_smd);
 	handle_smd_irq_closing_list();
 	return IRQ_HANDLED;
@@ -1372,6 +1466,8 @@ irqreturn_t smd_dsp_irq_handler(int irq, void *data)
 {
 	log_irq(SMD_APPS_QDSP);
 	++interrupt_stats[SMD_Q6].smd_in_count;
+	if (smd_rx_defer(&remote_info[SMD_Q6], irq))
+		return IRQ_HANDLED;
 	handle_smd_irq(&remote_info[SMD_Q6], notify_dsp_smd);
 	handle_smd_irq_closing_list();
 	return IRQ_HANDLED;
@@ -1381,6 +1477,8 @@ irqreturn_t smd_dsps_irq_handler(int irq, void *data)
 {
 	log_irq(SMD_APPS_DSPS);
 	++interrupt_stats[SMD_DSPS].smd_in_count;
+	if (smd_rx_defer(&remote_info[SMD_DSPS], irq))
+		return IRQ_HANDLED;
 	handle_smd_irq(&remote_info[SMD_DSPS], notify_dsps_smd);
 	handle_smd_irq_closing_list();
 	return IRQ_HANDLED;
@@ -1390,6 +1488,8 @@ irqreturn_t smd_wcnss_irq_handler(int irq, void *data)
 {
 	log_irq(SMD_APPS_WCNSS);
 	++interrupt_stats[SMD_WCNSS].smd_in_count;
+	if (smd_rx_defer(&remote_info[SMD_WCNSS], irq))
+		return IRQ_HANDLED;
 	handle_smd_irq(&remote_info[SMD_WCNSS], notify_wcnss_smd);
 	handle_smd_irq_closing_list();
 	return IRQ_HANDLED;
@@ -1399,6 +1499,8 @@ irqreturn_t smd_rpm_irq_handler(int irq, void *data)
 {
 	log_irq(SMD_APPS_RPM);
 	++interrupt_stats[SMD_RPM].smd_in_count;
+	if (smd_rx_defer(&remote_info[SMD_RPM], irq))
+		return IRQ_HANDLED;
 	handle_smd_irq(&remote_info[SMD_RPM], notify_rpm_smd);
 	handle_smd_irq_closing_list();
 	return IRQ_HANDLED;
@@ -3364,6 +3466,8 @@ int __init msm_smd_init(void)
 		remote_info[i].free_space = UINT_MAX;
 		INIT_WORK(&remote_info[i].probe_work, smd_channel_probe_worker);
 		INIT_LIST_HEAD(&remote_info[i].ch_list);
+		tasklet_init(&remote_info[i].rx_tasklet, smd_rx_tasklet,
+				(unsigned long)&remote_info[i]);
 	}
 
 	channel_close_wq = create_singlethread_workqueue("smd_channel_close");
@@ -783,6 +783,7 @@ static int __init smd_debugfs_init(void)
 	debug_create("print_f3", 0444, dent, debug_f3);
 	debug_create("int_stats", 0444, dent, debug_int_stats);
 	debug_create("int_stats_reset", 0444, dent, debug_int_stats_reset);
+	debug_create("rx_batch", 0444, dent, smd_rx_batch_stats);
 
 	/* NNV: this is google only stuff */
 	debug_create("build", 0444, dent, debug_read_build_id);
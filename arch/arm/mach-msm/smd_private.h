@@ -190,6 +190,11 @@ struct smd_channel {
 
 	char is_pkt_ch;
 
+	/* receive batching, see smd_rx_batch_stats() */
+	unsigned rx_events;
+	unsigned rx_bytes;
+	unsigned rx_max;
+
 	/*
 	 * private internal functions to access *send and *recv.
 	 * never to be exported outside of smd
@@ -215,6 +220,8 @@ struct interrupt_stat {
 };
 extern struct interrupt_stat interrupt_stats[NUM_SMD_SUBSYSTEMS];
 
+int smd_rx_batch_stats(char *buf, int max);
+
 struct interrupt_config_item {
 	/* must be initialized */
 	irqreturn_t (*irq_handler)(int req, void *data);
@@ -244,6 +244,7 @@ static void smd_tty_read(unsigned long param)
 {
 	unsigned char *ptr;
 	int avail;
+	int pending = 0;
 	struct smd_tty_info *info = (struct smd_tty_info *)param;
 	struct tty_struct *tty = tty_port_tty_get(&info->port);
 	unsigned long flags;
@@ -256,6 +257,7 @@ static void smd_tty_read(unsigned long param)
 			/* signal TTY clients using TTY_BREAK */
 			tty_insert_flip_char(tty, 0x00, TTY_BREAK);
 			tty_flip_buffer_push(tty);
+			pending = 0;
 			break;
 		}
 
@@ -274,6 +276,8 @@ static void smd_tty_read(unsigned long param)
 
 		avail = tty_prepare_flip_string(tty, &ptr, avail);
 		if (avail <= 0) {
+			if (pending)
+				tty_flip_buffer_push(tty);
 			mod_timer(&info->buf_req_timer,
 					jiffies + msecs_to_jiffies(30));
 			tty_kref_put(tty);
@@ -297,9 +301,16 @@ static void smd_tty_read(unsigned long param)
 		 */
 		__pm_wakeup_event(&info->pending_ws, TTY_PUSH_WS_DELAY);
 
-		tty_flip_buffer_push(tty);
+		/*
+		 * Everything read in this pass goes to the line discipline
+		 * in one push, so the reader is woken once per batch.
+		 */
+		pending = 1;
 	}
 
+	if (pending)
+		tty_flip_buffer_push(tty);
+
 	/* XXX only when writable and necessary */
 	tty_wakeup(tty);
 	tty_kref_put(tty);
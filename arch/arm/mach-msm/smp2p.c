@@ -85,6 +85,9 @@ module_param_named(debug_mask, smp2p_debug_mask,
  * @prev_entry_val: Previous value of the entry.
  * @entry_ptr: Points to the current value in smem item.
  * @notifier_count: Counts the number of notifier registered per pid,entry.
+ * @snap_open: The entry was found in the last snapshot of the edge.
+ * @snap_update: The entry changed in the last snapshot of the edge.
+ * @snap: Values taken in the last snapshot of the edge.
  */
 struct smp2p_in {
 	int remote_pid;
@@ -94,6 +97,9 @@ struct smp2p_in {
 	uint32_t prev_entry_val;
 	uint32_t __iomem *entry_ptr;
 	uint32_t notifier_count;
+	bool snap_open;
+	bool snap_update;
+	struct msm_smp2p_update_notif snap;
 };
 
 /**
@@ -101,7 +107,9 @@ struct smp2p_in {
  *
  * @in_item_lock_lhb1: Lock protecting all elements of the structure.
  * @list: List head for the entries on remote processor.
- * @smem_edge_in: Pointer to the remote smem item.
+ * @smem_edge_in: Pointer to the remote smem item. Published after
+ *	safe_total_entries, so msm_smp2p_in_read() can look entries up
+ *	without taking the lock.
  */
 struct smp2p_in_list_item {
 	spinlock_t in_item_lock_lhb1;
@@ -1096,6 +1104,8 @@ static int smp2p_do_negotiation(int remote_pid,
 		spin_lock(&in_list[remote_pid].in_item_lock_lhb1);
 		(void)out_item->ops_ptr->validate_size(remote_pid, r_smem_ptr,
 				in_list[remote_pid].item_size);
+		/* pairs with smp_rmb() in msm_smp2p_in_read() */
+		smp_wmb();
 		in_list[remote_pid].smem_edge_in = r_smem_ptr;
 		spin_unlock(&in_list[remote_pid].in_item_lock_lhb1);
 	} else {
@@ -1327,25 +1337,24 @@ EXPORT_SYMBOL(msm_smp2p_out_modify);
  */
 int msm_smp2p_in_read(int remote_pid, const char *name, uint32_t *data)
 {
-	unsigned long flags;
-	struct smp2p_out_list_item *out_item;
+	struct smp2p_smem __iomem *smem_edge_in;
 	uint32_t *entry_ptr = NULL;
 
 	if (remote_pid >= SMP2P_NUM_PROCS)
 		return -EINVAL;
 
-	out_item = &out_list[remote_pid];
-	spin_lock_irqsave(&out_item->out_item_lock_lha1, flags);
-	spin_lock(&in_list[remote_pid].in_item_lock_lhb1);
-
-	if (in_list[remote_pid].smem_edge_in)
-		out_item->ops_ptr->find_entry(
-			in_list[remote_pid].smem_edge_in,
+	/*
+	 * The remote item only ever grows entries and its header is set
+	 * up before smem_edge_in is published, so the lookup needs no lock.
+	 */
+	smem_edge_in = ACCESS_ONCE(in_list[remote_pid].smem_edge_in);
+	if (smem_edge_in) {
+		smp_rmb();
+		ACCESS_ONCE(out_list[remote_pid].ops_ptr)->find_entry(
+			smem_edge_in,
 			in_list[remote_pid].safe_total_entries,
 			(char *)name, &entry_ptr, NULL);
-
-	spin_unlock(&in_list[remote_pid].in_item_lock_lhb1);
-	spin_unlock_irqrestore(&out_item->out_item_lock_lha1, flags);
+	}
 
 	if (!entry_ptr)
 		return -ENODEV;
@@ -1532,6 +1541,11 @@ static void smp2p_send_interrupt(int remote_pid)
  * the list of the clients registered for the entries on the remote
  * processor and notifies them if  the data changes.
  *
+ * All entries are read in one pass before any client is called, so the
+ * clients of one interrupt see the edge as it was at a single point in
+ * time even when several entries changed together, and each changed
+ * entry gets one notification however many of its bits flipped.
+ *
  * Note:  Edge state must be OPENED to avoid a race condition with
  *        out_list[pid].ops_ptr->find_entry.
  */
@@ -1553,7 +1567,11 @@ static void smp2p_in_edge_notify(int pid)
 		return;
 	}
 
+	/* snapshot every entry */
 	list_for_each_entry(pos, &in_list[pid].list, in_edge_list) {
+		pos->snap_open = false;
+		pos->snap_update = false;
+
 		if (pos->entry_ptr == NULL) {
 			/* entry not open - try to open it */
 			out_list[pid].ops_ptr->find_entry(smem_h_ptr,
@@ -1563,27 +1581,35 @@ static void smp2p_in_edge_notify(int pid)
 			if (entry_ptr) {
 				pos->entry_ptr = entry_ptr;
 				pos->prev_entry_val = 0;
-				data.previous_value = 0;
-				data.current_value = readl_relaxed(entry_ptr);
-				raw_notifier_call_chain(
-					    &pos->in_notifier_list,
-					    SMP2P_OPEN, (void *)&data);
+				pos->snap_open = true;
 			}
 		}
 
 		if (pos->entry_ptr != NULL) {
-			/* send update notification */
 			curr_data = readl_relaxed(pos->entry_ptr);
+			pos->snap.previous_value = pos->prev_entry_val;
+			pos->snap.current_value = curr_data;
 			if (curr_data != pos->prev_entry_val) {
-				data.previous_value = pos->prev_entry_val;
-				data.current_value = curr_data;
 				pos->prev_entry_val = curr_data;
-				raw_notifier_call_chain(
-					&pos->in_notifier_list,
-					SMP2P_ENTRY_UPDATE, (void *)&data);
+				pos->snap_update = true;
 			}
 		}
 	}
+
+	/* then notify the entries that opened or changed */
+	list_for_each_entry(pos, &in_list[pid].list, in_edge_list) {
+		if (pos->snap_open) {
+			data.previous_value = 0;
+			data.current_value = pos->snap.current_value;
+			raw_notifier_call_chain(&pos->in_notifier_list,
+					SMP2P_OPEN, (void *)&data);
+		}
+		if (pos->snap_update) {
+			data = pos->snap;
+			raw_notifier_call_chain(&pos->in_notifier_list,
+					SMP2P_ENTRY_UPDATE, (void *)&data);
+		}
+	}
 	spin_unlock_irqrestore(&in_list[pid].in_item_lock_lhb1, flags);
 }
 
@@ -371,19 +371,22 @@ static const struct irq_domain_ops smp2p_irq_domain_ops = {
  *
  * Whenever an entry changes, this callback is triggered to determine
  * which bits changed and if the corresponding interrupts need to be
- * triggered.
+ * triggered. The interrupt configuration is sampled once for all the
+ * bits of the update, and only bits that changed are looked at.
  */
 static void msm_summary_irq_handler(struct smp2p_chip_dev *chip,
 	struct msm_smp2p_update_notif *entry)
 {
-	int i;
+	unsigned long changed;
+	unsigned long rising;
+	unsigned long falling;
+	unsigned long enabled;
+	unsigned long trigger;
 	uint32_t cur_val;
 	uint32_t prev_val;
 	uint32_t edge;
 	unsigned long flags;
-	bool trigger_interrrupt;
-	bool irq_rising;
-	bool irq_falling;
+	int i;
 
 	cur_val = entry->current_value;
 	prev_val = entry->previous_value;
@@ -394,44 +397,43 @@ static void msm_summary_irq_handler(struct smp2p_chip_dev *chip,
 	SMP2P_GPIO("'%s':%d GPIO Summary IRQ Change %08x->%08x\n",
 			chip->name, chip->remote_pid, prev_val, cur_val);
 
-	for (i = 0; i < SMP2P_BITS_PER_ENTRY; ++i) {
-		spin_lock_irqsave(&chip->irq_lock, flags);
-		trigger_interrrupt = false;
-		edge = (prev_val & 0x1) << 1 | (cur_val & 0x1);
-		irq_rising = test_bit(i, chip->irq_rising_edge);
-		irq_falling = test_bit(i, chip->irq_falling_edge);
-
-		if (test_bit(i, chip->irq_enabled)) {
-			if (edge == 0x1 && irq_rising)
-				/* 0->1 transition */
-				trigger_interrrupt = true;
-			else if (edge == 0x2 && irq_falling)
-				/* 1->0 transition */
-				trigger_interrrupt = true;
-		} else {
-			SMP2P_GPIO(
-				"'%s':%d GPIO bit %d virq %d (%s,%s) - edge %s disabled\n",
-				chip->name, chip->remote_pid, i,
-				chip->irq_base + i,
-				edge_name_rising[irq_rising],
-				edge_name_falling[irq_falling],
-				edge_names[edge]);
-		}
-		spin_unlock_irqrestore(&chip->irq_lock, flags);
+	changed = prev_val ^ cur_val;
+	if (!changed)
+		return;
+
+	spin_lock_irqsave(&chip->irq_lock, flags);
+	enabled = chip->irq_enabled[0];
+	rising = chip->irq_rising_edge[0];
+	falling = chip->irq_falling_edge[0];
+	spin_unlock_irqrestore(&chip->irq_lock, flags);
 
-		if (trigger_interrrupt) {
-			SMP2P_INFO(
-				"'%s':%d GPIO bit %d virq %d (%s,%s) - edge %s triggering\n",
+	/* 0->1 transitions on rising edges, 1->0 on falling edges */
+	trigger = changed & enabled &
+		((cur_val & rising) | (~cur_val & falling));
+
+	for_each_set_bit(i, &changed, SMP2P_BITS_PER_ENTRY) {
+		edge = ((prev_val >> i) & 0x1) << 1 | ((cur_val >> i) & 0x1);
+
+		if (!test_bit(i, &trigger)) {
+			SMP2P_GPIO(
+				"'%s':%d GPIO bit %d virq %d (%s,%s) - edge %s %s\n",
 				chip->name, chip->remote_pid, i,
 				chip->irq_base + i,
-				edge_name_rising[irq_rising],
-				edge_name_falling[irq_falling],
-				edge_names[edge]);
-			(void)generic_handle_irq(chip->irq_base + i);
+				edge_name_rising[test_bit(i, &rising)],
+				edge_name_falling[test_bit(i, &falling)],
+				edge_names[edge],
+				test_bit(i, &enabled) ? "ignored" : "disabled");
+			continue;
 		}
 
-		cur_val >>= 1;
-		prev_val >>= 1;
+		SMP2P_INFO(
+			"'%s':%d GPIO bit %d virq %d (%s,%s) - edge %s triggering\n",
+			chip->name, chip->remote_pid, i,
+			chip->irq_base + i,
+			edge_name_rising[test_bit(i, &rising)],
+			edge_name_falling[test_bit(i, &falling)],
+			edge_names[edge]);
+		(void)generic_handle_irq(chip->irq_base + i);
 	}
 }
 
@@ -22,6 +22,7 @@
 #include <linux/io.h>
 #include <linux/kthread.h>
 #include <linux/time.h>
+#include <linux/ktime.h>
 #include <linux/wakelock.h>
 #include <linux/suspend.h>
 #include <linux/mutex.h>
@@ -664,6 +665,7 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 	struct subsys_tracking *track;
 	unsigned count;
 	unsigned long flags;
+	ktime_t start, t_down, t_dump, t_up;
 
 	/*
 	 * It's OK to not take the registration lock at this point.
@@ -694,9 +696,11 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 			desc->name);
 	if (!strncmp(desc->name, "modem", SUBSYS_NAME_MAX_LENGTH))
 		modem_restarts++;
+	start = ktime_get();
 	notify_each_subsys_device(list, count, SUBSYS_BEFORE_SHUTDOWN, NULL);
 	for_each_subsys_device(list, count, NULL, subsystem_shutdown);
 	notify_each_subsys_device(list, count, SUBSYS_AFTER_SHUTDOWN, NULL);
+	t_down = ktime_get();
 
 	notify_each_subsys_device(list, count, SUBSYS_RAMDUMP_NOTIFICATION,
 							  &enable_ramdumps);
@@ -707,13 +711,18 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 
 	/* Collect ram dumps for all subsystems in order here */
 	for_each_subsys_device(list, count, NULL, subsystem_ramdump);
+	t_dump = ktime_get();
 
 	notify_each_subsys_device(list, count, SUBSYS_BEFORE_POWERUP, NULL);
 	for_each_subsys_device(list, count, NULL, subsystem_powerup);
 	notify_each_subsys_device(list, count, SUBSYS_AFTER_POWERUP, NULL);
+	t_up = ktime_get();
 
-	pr_info("[%p]: Restart sequence for %s completed.\n",
-			current, desc->name);
+	pr_info("[%p]: Restart sequence for %s completed in %lld ms (shutdown %lld, ramdump %lld, powerup %lld).\n",
+		current, desc->name, ktime_to_ms(ktime_sub(t_up, start)),
+		ktime_to_ms(ktime_sub(t_down, start)),
+		ktime_to_ms(ktime_sub(t_dump, t_down)),
+		ktime_to_ms(ktime_sub(t_up, t_dump)));
 
 	mutex_unlock(&soc_order_reg_lock);
 	mutex_unlock(&track->lock);
@@ -10,6 +10,7 @@
 #include <linux/mm.h>
 #include <linux/gfp.h>
 #include <linux/highmem.h>
+#include <linux/rcupdate.h>
 #include <linux/slab.h>
 
 #include <asm/cp15.h>
@@ -157,3 +158,18 @@ no_pgd:
 #endif
 	__pgd_free(pgd_base);
 }
+
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Second half of __pte_free_tlb(): the grace period is over, so no
+ * speculative fault can still be looking at the table.
+ */
+void pte_free_rcu(struct rcu_head *head)
+{
+	struct page *pte = container_of((struct list_head *)head,
+					struct page, lru);
+
+	pgtable_page_dtor(pte);
+	put_page(pte);
+}
+#endif
@@ -675,6 +675,8 @@ static int vfp_bounce_open(struct inode *inode, struct file *file)
 /*
  * Kernel-side NEON support functions
  */
+DEFINE_PER_CPU(bool, kernel_neon_busy);
+
 void kernel_neon_begin(void)
 {
 	struct thread_info *thread = current_thread_info();
@@ -703,11 +705,13 @@ void kernel_neon_begin(void)
 		vfp_save_state(vfp_current_hw_state[cpu], fpexc);
 #endif
 	vfp_current_hw_state[cpu] = NULL;
+	per_cpu(kernel_neon_busy, cpu) = true;
 }
 EXPORT_SYMBOL(kernel_neon_begin);
 
 void kernel_neon_end(void)
 {
+	__this_cpu_write(kernel_neon_busy, false);
 	/* Disable the NEON/VFP unit. */
 	fmxr(FPEXC, fmrx(FPEXC) & ~FPEXC_EN);
 	put_cpu();
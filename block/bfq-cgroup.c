@@ -345,8 +345,17 @@ static struct bfq_group *__bfq_bic_change_cgroup(struct bfq_data *bfqd,
 
 	if (sync_bfqq != NULL) {
 		entity = &sync_bfqq->entity;
-		if (entity->sched_data != &bfqg->sched_data)
+		if (entity->sched_data != &bfqg->sched_data) {
 			bfq_bfqq_move(bfqd, sync_bfqq, entity, bfqg);
+			/*
+			 * A task coming to the foreground is about to be
+			 * interacted with: raise its weight right away
+			 * instead of waiting for it to look interactive.
+			 */
+			if (bgrp->foreground)
+				bfq_bfqq_start_wr(bfqd, sync_bfqq,
+						  BFQ_WR_FOREGROUND);
+		}
 	}
 
 	return bfqg;
@@ -652,6 +661,7 @@ static u64 bfqio_cgroup_##__VAR##_read(struct cgroup *cgroup,		\
 SHOW_FUNCTION(weight);
 SHOW_FUNCTION(ioprio);
 SHOW_FUNCTION(ioprio_class);
+SHOW_FUNCTION(foreground);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__VAR, __MIN, __MAX)				\
@@ -713,6 +723,27 @@ STORE_FUNCTION(ioprio, 0, IOPRIO_BE_NR - 1);
 STORE_FUNCTION(ioprio_class, IOPRIO_CLASS_RT, IOPRIO_CLASS_IDLE);
 #undef STORE_FUNCTION
 
+static int bfqio_cgroup_foreground_write(struct cgroup *cgroup,
+					 struct cftype *cftype, u64 val)
+{
+	struct bfqio_cgroup *bgrp;
+
+	if (val > 1)
+		return -EINVAL;
+
+	if (!cgroup_lock_live_group(cgroup))
+		return -ENODEV;
+
+	bgrp = cgroup_to_bfqio(cgroup);
+	spin_lock_irq(&bgrp->lock);
+	bgrp->foreground = val;
+	spin_unlock_irq(&bgrp->lock);
+
+	cgroup_unlock();
+
+	return 0;
+}
+
 static struct cftype bfqio_files[] = {
 	{
 		.name = "weight",
@@ -729,6 +760,11 @@ static struct cftype bfqio_files[] = {
 		.read_u64 = bfqio_cgroup_ioprio_class_read,
 		.write_u64 = bfqio_cgroup_ioprio_class_write,
 	},
+	{
+		.name = "foreground",
+		.read_u64 = bfqio_cgroup_foreground_read,
+		.write_u64 = bfqio_cgroup_foreground_write,
+	},
 };
 
 static int bfqio_populate(struct cgroup_subsys *subsys, struct cgroup *cgroup)
@@ -67,6 +67,7 @@
 #include <linux/jiffies.h>
 #include <linux/rbtree.h>
 #include <linux/ioprio.h>
+#include <linux/launch_prefetch.h>
 #include "bfq.h"
 #include "blk.h"
 
@@ -112,6 +113,13 @@ struct kmem_cache *bfq_pool;
 /* Min samples used for peak rate estimation (for autotuning). */
 #define BFQ_PEAK_RATE_SAMPLES	32
 
+/*
+ * eMMC profile: idle for this many request service times, and drop
+ * service time samples longer than this (the device was idle or asleep).
+ */
+#define BFQ_EMMC_IDLE_SERVICE_TIMES	3
+#define BFQ_EMMC_MAX_SERVICE_TIME_US	USEC_PER_SEC
+
 /* Shift used for peak rate fixed precision calculations. */
 #define BFQ_RATE_SHIFT		16
 
@@ -164,6 +172,8 @@ static int device_speed_thresh[2];
 #define RQ_BFQQ(rq)		((rq)->elv.priv[1])
 
 static inline void bfq_schedule_dispatch(struct bfq_data *bfqd);
+static void bfq_bfqq_start_wr(struct bfq_data *bfqd, struct bfq_queue *bfqq,
+			      enum bfq_wr_reason reason);
 
 #include "bfq-ioc.c"
 #include "bfq-sched.c"
@@ -579,6 +589,34 @@ bfq_bfqq_cooperations(struct bfq_queue *bfqq)
 	return bfqq->bic ? bfqq->bic->cooperations : 0;
 }
 
+/*
+ * Start, or recharge, an interactive weight-raising period for @bfqq on
+ * an external hint that its process is starting up or has just come to
+ * the foreground. The hint is trusted over the burst heuristic, which
+ * would otherwise take the many queues created by an app launch for a
+ * burst of background work.
+ */
+static void bfq_bfqq_start_wr(struct bfq_data *bfqd, struct bfq_queue *bfqq,
+			      enum bfq_wr_reason reason)
+{
+	if (!bfqd->low_latency || bfqq->bic == NULL ||
+	    bfq_bfqq_cooperations(bfqq) >= bfqd->bfq_coop_thresh)
+		return;
+
+	bfq_clear_bfqq_in_large_burst(bfqq);
+	if (bfqq->wr_coeff == 1) {
+		if (bfq_bfqq_busy(bfqq))
+			bfqd->wr_busy_queues++;
+		bfqq->wr_coeff = bfqd->bfq_wr_coeff;
+		bfqq->entity.ioprio_changed = 1;
+	}
+	bfqq->wr_cur_max_time = bfq_wr_duration(bfqd);
+	bfqq->last_wr_start_finish = jiffies;
+	bfqq->wr_stats.raised[reason]++;
+	bfq_log_bfqq(bfqd, bfqq, "wrais (%d) starting at %lu, rais_max_time %u",
+		     reason, jiffies, jiffies_to_msecs(bfqq->wr_cur_max_time));
+}
+
 static inline void
 bfq_bfqq_resume_state(struct bfq_queue *bfqq, struct bfq_io_cq *bic)
 {
@@ -937,14 +975,17 @@ static void bfq_add_request(struct request *rq)
 			else
 				bfqq->wr_cur_max_time =
 					bfqd->bfq_wr_rt_max_time;
+			bfqq->wr_stats.raised[interactive ? BFQ_WR_INTERACTIVE :
+					      BFQ_WR_SOFT_RT]++;
 			bfq_log_bfqq(bfqd, bfqq,
 				     "wrais starting at %lu, rais_max_time %u",
 				     jiffies,
 				     jiffies_to_msecs(bfqq->wr_cur_max_time));
 		} else if (old_wr_coeff > 1) {
-			if (interactive)
+			if (interactive) {
 				bfqq->wr_cur_max_time = bfq_wr_duration(bfqd);
-			else if (coop_or_in_burst ||
+				bfqq->wr_stats.raised[BFQ_WR_INTERACTIVE]++;
+			} else if (coop_or_in_burst ||
 				 (bfqq->wr_cur_max_time ==
 				  bfqd->bfq_wr_rt_max_time &&
 				  !soft_rt)) {
@@ -1007,6 +1048,7 @@ static void bfq_add_request(struct request *rq)
 				bfqq->last_wr_start_finish = jiffies;
 				bfqq->wr_cur_max_time =
 					bfqd->bfq_wr_rt_max_time;
+				bfqq->wr_stats.raised[BFQ_WR_SOFT_RT]++;
 			}
 		}
 set_ioprio_changed:
@@ -1024,6 +1066,7 @@ add_bfqq_busy:
 				bfqd->bfq_wr_min_inter_arr_async)) {
 			bfqq->wr_coeff = bfqd->bfq_wr_coeff;
 			bfqq->wr_cur_max_time = bfq_wr_duration(bfqd);
+			bfqq->wr_stats.raised[BFQ_WR_INTERACTIVE]++;
 
 			bfqd->wr_busy_queues++;
 			entity->ioprio_changed = 1;
@@ -1039,6 +1082,18 @@ add_bfqq_busy:
 	if (bfqd->low_latency &&
 		(old_wr_coeff == 1 || bfqq->wr_coeff == 1 || interactive))
 		bfqq->last_wr_start_finish = jiffies;
+
+	/*
+	 * A sync queue of an app being launched gets a full interactive
+	 * period even if the heuristics above missed it, e.g. because it
+	 * was created in the burst of queues that a launch causes, or was
+	 * only deemed soft real-time.
+	 */
+	if (bfq_bfqq_sync(bfqq) && !in_interrupt() &&
+	    (bfqq->wr_coeff == 1 ||
+	     bfqq->wr_cur_max_time == bfqd->bfq_wr_rt_max_time) &&
+	    launch_prefetch_launching(current->tgid, bfq_wr_duration(bfqd)))
+		bfq_bfqq_start_wr(bfqd, bfqq, BFQ_WR_LAUNCH);
 }
 
 static struct request *bfq_find_rq_fmerge(struct bfq_data *bfqd,
@@ -1066,6 +1121,8 @@ static void bfq_activate_request(struct request_queue *q, struct request *rq)
 {
 	struct bfq_data *bfqd = q->elevator->elevator_data;
 
+	if (bfqd->emmc && bfqd->rq_in_driver == 0)
+		bfqd->busy_start = ktime_get();
 	bfqd->rq_in_driver++;
 	bfqd->last_position = blk_rq_pos(rq) + blk_rq_sectors(rq);
 	bfq_log(bfqd, "activate_request: new bfqd->last_position %llu",
@@ -1686,6 +1743,24 @@ static inline unsigned long bfq_min_budget(struct bfq_data *bfqd)
 		return bfqd->bfq_max_budget / 32;
 }
 
+/*
+ * Maximum idling time. On eMMC there is no seek to save, so the only
+ * reason to idle is to preserve the service guarantees of the queue in
+ * service, and a request of that queue is only worth waiting for if it
+ * is likely to arrive within a few request service times.
+ */
+static unsigned long bfq_idle_time(struct bfq_data *bfqd)
+{
+	unsigned long sl;
+
+	if (!bfqd->emmc || bfqd->service_time_us == 0)
+		return bfqd->bfq_slice_idle;
+
+	sl = usecs_to_jiffies(BFQ_EMMC_IDLE_SERVICE_TIMES *
+			      bfqd->service_time_us);
+	return min_t(unsigned long, max(sl, 1UL), bfqd->bfq_slice_idle);
+}
+
 static void bfq_arm_slice_timer(struct bfq_data *bfqd)
 {
 	struct bfq_queue *bfqq = bfqd->in_service_queue;
@@ -1711,7 +1786,7 @@ static void bfq_arm_slice_timer(struct bfq_data *bfqd)
 	 * assigned budget before reducing the waiting time to
 	 * BFQ_MIN_TT. This happened to help reduce latency.
 	 */
-	sl = bfqd->bfq_slice_idle;
+	sl = bfq_idle_time(bfqd);
 	/*
 	 * Unless the queue is being weight-raised or the scenario is
 	 * asymmetric, grant only minimum idle time if the queue either
@@ -2494,10 +2569,11 @@ static inline bool bfq_bfqq_must_not_expire(struct bfq_queue *bfqq)
  * Condition for expiring a non-weight-raised queue (and hence not idling
  * the device).
  */
-#define cond_for_expiring_non_wr  (bfqd->hw_tag && \
-				   (bfqd->wr_busy_queues > 0 || \
-				    (blk_queue_nonrot(bfqd->queue) || \
-				      cond_for_seeky_on_ncq_hdd)))
+#define cond_for_expiring_non_wr  (bfqd->emmc || \
+				   (bfqd->hw_tag && \
+				    (bfqd->wr_busy_queues > 0 || \
+				     (blk_queue_nonrot(bfqd->queue) || \
+				      cond_for_seeky_on_ncq_hdd))))
 
 	return bfq_bfqq_sync(bfqq) &&
 		!cond_for_expiring_in_burst &&
@@ -2820,6 +2896,20 @@ static int bfq_dispatch_requests(struct request_queue *q, int force)
  *
  * Queue lock must be held here.
  */
+/* Add the weight-raising statistics of @bfqq, up to now, to @stats. */
+static void bfq_wr_stats_add(struct bfq_wr_stats *stats,
+			     struct bfq_queue *bfqq)
+{
+	int i;
+
+	for (i = 0; i < BFQ_WR_REASONS; i++)
+		stats->raised[i] += bfqq->wr_stats.raised[i];
+	stats->wr_time += bfqq->wr_stats.wr_time;
+	if (bfqq->wr_stats_start)
+		stats->wr_time += jiffies - bfqq->wr_stats_start;
+	stats->wr_sectors += bfqq->wr_stats.wr_sectors;
+}
+
 static void bfq_put_queue(struct bfq_queue *bfqq)
 {
 	struct bfq_data *bfqd = bfqq->bfqd;
@@ -2848,6 +2938,8 @@ static void bfq_put_queue(struct bfq_queue *bfqq)
 		 */
 		hlist_del_init(&bfqq->burst_list_node);
 
+	bfq_wr_stats_add(&bfqd->wr_stats, bfqq);
+
 	bfq_log_bfqq(bfqd, bfqq, "put_queue: %p freed", bfqq);
 
 	kmem_cache_free(bfq_pool, bfqq);
@@ -3231,7 +3323,7 @@ static void bfq_update_idle_window(struct bfq_data *bfqd,
 			bfqq->wr_coeff == 1))
 		enable_idle = 0;
 	else if (bfq_sample_valid(bic->ttime.ttime_samples)) {
-		if (bic->ttime.ttime_mean > bfqd->bfq_slice_idle &&
+		if (bic->ttime.ttime_mean > bfq_idle_time(bfqd) &&
 			bfqq->wr_coeff == 1)
 			enable_idle = 0;
 		else
@@ -3403,6 +3495,32 @@ static void bfq_update_hw_tag(struct bfq_data *bfqd)
 	bfqd->hw_tag_samples = 0;
 }
 
+/*
+ * Update the average service time of the device with the time elapsed
+ * since the previous completion, or since the device became busy if it
+ * was idle in between. For a device serving one request at a time, as
+ * eMMC mostly does, that is the time taken by the request just completed.
+ */
+static void bfq_update_service_time(struct bfq_data *bfqd)
+{
+	ktime_t now = ktime_get(), from = bfqd->last_completion;
+	s64 us;
+
+	if (ktime_to_ns(bfqd->busy_start) > ktime_to_ns(from))
+		from = bfqd->busy_start;
+	bfqd->last_completion = now;
+
+	us = ktime_us_delta(now, from);
+	if (us <= 0 || us > BFQ_EMMC_MAX_SERVICE_TIME_US)
+		return;
+
+	if (bfqd->service_time_us == 0)
+		bfqd->service_time_us = (unsigned int)us;
+	else
+		bfqd->service_time_us = (7 * bfqd->service_time_us +
+					 (unsigned int)us) / 8;
+}
+
 static void bfq_completed_request(struct request_queue *q, struct request *rq)
 {
 	struct bfq_queue *bfqq = RQ_BFQQ(rq);
@@ -3413,6 +3531,8 @@ static void bfq_completed_request(struct request_queue *q, struct request *rq)
 		     blk_rq_sectors(rq), sync);
 
 	bfq_update_hw_tag(bfqd);
+	if (bfqd->emmc)
+		bfq_update_service_time(bfqd);
 
 	BUG_ON(!bfqd->rq_in_driver);
 	BUG_ON(!bfqq->dispatched);
@@ -3892,10 +4012,12 @@ static void bfq_registered_queue(struct request_queue *q)
 	struct bfq_data *bfqd = e->elevator_data;
 
 	/*
-	 * Default to IOPS mode with no idling for SSDs
+	 * Non-rotational devices on this kind of hardware are eMMC: idle
+	 * only to preserve service guarantees, and only as long as the
+	 * device takes to serve a few requests (see bfq_idle_time()).
 	 */
 	if (blk_queue_nonrot(q))
-		bfqd->bfq_slice_idle = 0;
+		bfqd->emmc = true;
 }
 
 static void bfq_slab_kill(void)
@@ -3976,6 +4098,67 @@ static ssize_t bfq_weights_show(struct elevator_queue *e, char *page)
 	return num_char;
 }
 
+static ssize_t bfq_wr_stats_show_one(char *page, size_t size,
+				     const char *name,
+				     const struct bfq_wr_stats *stats)
+{
+	return scnprintf(page, size,
+			 "%s: interactive %lu soft_rt %lu launch %lu "
+			 "foreground %lu wr_ms %u wr_sectors %llu\n", name,
+			 stats->raised[BFQ_WR_INTERACTIVE],
+			 stats->raised[BFQ_WR_SOFT_RT],
+			 stats->raised[BFQ_WR_LAUNCH],
+			 stats->raised[BFQ_WR_FOREGROUND],
+			 jiffies_to_msecs(stats->wr_time),
+			 (unsigned long long)stats->wr_sectors);
+}
+
+/*
+ * Weight-raising statistics: the totals of the device, including the
+ * queues freed so far, then one line per existing queue.
+ */
+static ssize_t bfq_wr_stats_show(struct elevator_queue *e, char *page)
+{
+	struct bfq_data *bfqd = e->elevator_data;
+	struct list_head *lists[] = { &bfqd->active_list, &bfqd->idle_list };
+	struct bfq_wr_stats total;
+	struct bfq_queue *bfqq;
+	char name[24];
+	ssize_t num_char;
+	int i;
+
+	spin_lock_irq(bfqd->queue->queue_lock);
+
+	total = bfqd->wr_stats;
+	for (i = 0; i < ARRAY_SIZE(lists); i++)
+		list_for_each_entry(bfqq, lists[i], bfqq_list)
+			bfq_wr_stats_add(&total, bfqq);
+	num_char = bfq_wr_stats_show_one(page, PAGE_SIZE, "total", &total);
+
+	for (i = 0; i < ARRAY_SIZE(lists); i++)
+		list_for_each_entry(bfqq, lists[i], bfqq_list) {
+			struct bfq_wr_stats stats = { };
+
+			bfq_wr_stats_add(&stats, bfqq);
+			snprintf(name, sizeof(name), "pid%d%s", bfqq->pid,
+				 bfqq->wr_coeff > 1 ? " (raised)" : "");
+			num_char += bfq_wr_stats_show_one(page + num_char,
+							  PAGE_SIZE - num_char,
+							  name, &stats);
+		}
+
+	spin_unlock_irq(bfqd->queue->queue_lock);
+
+	return num_char;
+}
+
+static ssize_t bfq_service_time_us_show(struct elevator_queue *e, char *page)
+{
+	struct bfq_data *bfqd = e->elevator_data;
+
+	return bfq_var_show(bfqd->service_time_us, page);
+}
+
 #define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
 static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
 {									\
@@ -3996,6 +4179,7 @@ SHOW_FUNCTION(bfq_max_budget_async_rq_show,
 SHOW_FUNCTION(bfq_timeout_sync_show, bfqd->bfq_timeout[BLK_RW_SYNC], 1);
 SHOW_FUNCTION(bfq_timeout_async_show, bfqd->bfq_timeout[BLK_RW_ASYNC], 1);
 SHOW_FUNCTION(bfq_low_latency_show, bfqd->low_latency, 0);
+SHOW_FUNCTION(bfq_emmc_profile_show, bfqd->emmc, 0);
 SHOW_FUNCTION(bfq_wr_coeff_show, bfqd->bfq_wr_coeff, 0);
 SHOW_FUNCTION(bfq_wr_rt_max_time_show, bfqd->bfq_wr_rt_max_time, 1);
 SHOW_FUNCTION(bfq_wr_min_idle_time_show, bfqd->bfq_wr_min_idle_time, 1);
@@ -4043,6 +4227,7 @@ STORE_FUNCTION(bfq_wr_min_inter_arr_async_store,
 		&bfqd->bfq_wr_min_inter_arr_async, 0, INT_MAX, 1);
 STORE_FUNCTION(bfq_wr_max_softrt_rate_store, &bfqd->bfq_wr_max_softrt_rate, 0,
 		INT_MAX, 0);
+STORE_FUNCTION(bfq_emmc_profile_store, &bfqd->emmc, 0, 1, 0);
 #undef STORE_FUNCTION
 
 /* do nothing for the moment */
@@ -4138,6 +4323,9 @@ static struct elv_fs_entry bfq_attrs[] = {
 	BFQ_ATTR(wr_min_inter_arr_async),
 	BFQ_ATTR(wr_max_softrt_rate),
 	BFQ_ATTR(weights),
+	BFQ_ATTR(emmc_profile),
+	__ATTR(service_time_us, S_IRUGO, bfq_service_time_us_show, NULL),
+	__ATTR(wr_stats, S_IRUGO, bfq_wr_stats_show, NULL),
 	__ATTR_NULL
 };
 
@@ -594,6 +594,21 @@ static void bfq_forget_idle(struct bfq_service_tree *st)
 		bfq_put_idle_entity(st, first_idle);
 }
 
+/*
+ * Account the time @bfqq spends weight-raised. Called whenever its weight
+ * is recomputed, which is when a change of its wr_coeff takes effect.
+ */
+static void bfq_wr_stats_update(struct bfq_queue *bfqq)
+{
+	if (bfqq->wr_coeff > 1) {
+		if (!bfqq->wr_stats_start)
+			bfqq->wr_stats_start = jiffies | 1;
+	} else if (bfqq->wr_stats_start) {
+		bfqq->wr_stats.wr_time += jiffies - bfqq->wr_stats_start;
+		bfqq->wr_stats_start = 0;
+	}
+}
+
 static struct bfq_service_tree *
 __bfq_entity_update_weight_prio(struct bfq_service_tree *old_st,
 			 struct bfq_entity *entity)
@@ -665,6 +680,8 @@ __bfq_entity_update_weight_prio(struct bfq_service_tree *old_st,
 			bfq_weights_tree_remove(bfqd, entity, root);
 		}
 		entity->weight = new_weight;
+		if (bfqq != NULL)
+			bfq_wr_stats_update(bfqq);
 		/*
 		 * Add the entity to its weights tree only if it is
 		 * not associated with a weight-raised queue.
@@ -708,6 +725,8 @@ static void bfq_bfqq_served(struct bfq_queue *bfqq, unsigned long served)
 		st->vtime += bfq_delta(served, st->wsum);
 		bfq_forget_idle(st);
 	}
+	if (bfqq->wr_coeff > 1)
+		bfqq->wr_stats.wr_sectors += served;
 	bfq_log_bfqq(bfqq->bfqd, bfqq, "bfqq_served %lu secs", served);
 }
 
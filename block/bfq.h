@@ -178,6 +178,32 @@ struct bfq_entity {
 
 struct bfq_group;
 
+/*
+ * What started a weight-raising period: the interactive and soft real-time
+ * heuristics, a launch tagged by the launch prefetch engine, or a move to
+ * a bfqio cgroup marked as foreground.
+ */
+enum bfq_wr_reason {
+	BFQ_WR_INTERACTIVE,
+	BFQ_WR_SOFT_RT,
+	BFQ_WR_LAUNCH,
+	BFQ_WR_FOREGROUND,
+	BFQ_WR_REASONS,
+};
+
+/**
+ * struct bfq_wr_stats - weight-raising statistics.
+ * @raised: number of weight-raising periods started or recharged, by
+ *          reason.
+ * @wr_time: time spent weight-raised (jiffies).
+ * @wr_sectors: sectors served while weight-raised.
+ */
+struct bfq_wr_stats {
+	unsigned long raised[BFQ_WR_REASONS];
+	unsigned long wr_time;
+	u64 wr_sectors;
+};
+
 /**
  * struct bfq_queue - leaf schedulable entity.
  * @ref: reference counter.
@@ -226,6 +252,9 @@ struct bfq_group;
  *                           backlogged
  * @bic: pointer to the bfq_io_cq owning the bfq_queue, set to %NULL if the
  *	 queue is shared
+ * @wr_stats: weight-raising statistics of the queue
+ * @wr_stats_start: time the weight of the queue was last raised, 0 if it
+ *                  is not raised
  *
  * A bfq_queue is a leaf request queue; it can be associated with an
  * io_context or more, if it  is  async or shared  between  cooperating
@@ -281,6 +310,9 @@ struct bfq_queue {
 	unsigned int wr_coeff;
 	unsigned long last_idle_bklogged;
 	unsigned long service_from_backlogged;
+
+	struct bfq_wr_stats wr_stats;
+	unsigned long wr_stats_start;
 };
 
 /**
@@ -477,6 +509,13 @@ enum bfq_device_speed {
  * @RT_prod: cached value of the product R*T used for computing the maximum
  *	     duration of the weight raising automatically.
  * @device_speed: device-speed class for the low-latency heuristic.
+ * @emmc: if set, the eMMC profile is active: idle only to preserve
+ *        service guarantees, for a few times @service_time_us.
+ * @service_time_us: moving average of the time the device takes to
+ *                   complete one request while busy (usecs).
+ * @busy_start: time the device last went from idle to busy.
+ * @last_completion: time of the last request completion.
+ * @wr_stats: weight-raising statistics summed over freed queues.
  * @oom_bfqq: fallback dummy bfqq for extreme OOM conditions.
  *
  * All the fields are protected by the @queue lock.
@@ -559,6 +598,13 @@ struct bfq_data {
 	u64 RT_prod;
 	enum bfq_device_speed device_speed;
 
+	bool emmc;
+	unsigned int service_time_us;
+	ktime_t busy_start;
+	ktime_t last_completion;
+
+	struct bfq_wr_stats wr_stats;
+
 	struct bfq_queue oom_bfqq;
 };
 
@@ -700,6 +746,8 @@ struct bfq_group {
  * @ioprio_class: cgroup ioprio_class.
  * @lock: spinlock that protects @ioprio, @ioprio_class and @group_data.
  * @group_data: list containing the bfq_group belonging to this cgroup.
+ * @foreground: if set, tasks moved into this cgroup get their sync queues
+ *              weight-raised as if they had just been launched.
  *
  * @group_data is accessed using RCU, with @lock protecting the updates,
  * @ioprio and @ioprio_class are protected by @lock.
@@ -711,6 +759,8 @@ struct bfqio_cgroup {
 
 	spinlock_t lock;
 	struct hlist_head group_data;
+
+	bool foreground;
 };
 #else
 struct bfq_group {
@@ -17,6 +17,7 @@
 #include <linux/err.h>
 #include <linux/blkdev.h>
 #include <linux/slab.h>
+#include <linux/writeback.h>
 #include "blk-cgroup.h"
 #include <linux/genhd.h>
 
@@ -25,7 +26,10 @@
 static DEFINE_SPINLOCK(blkio_list_lock);
 static LIST_HEAD(blkio_list);
 
-struct blkio_cgroup blkio_root_cgroup = { .weight = 2*BLKIO_WEIGHT_DEFAULT };
+struct blkio_cgroup blkio_root_cgroup = {
+	.weight = 2*BLKIO_WEIGHT_DEFAULT,
+	.dirty_ratio = 100,
+};
 EXPORT_SYMBOL_GPL(blkio_root_cgroup);
 
 static struct cgroup_subsys_state *blkiocg_create(struct cgroup *);
@@ -118,6 +122,21 @@ struct blkio_cgroup *task_blkio_cgroup(struct task_struct *tsk)
 }
 EXPORT_SYMBOL_GPL(task_blkio_cgroup);
 
+/*
+ * Percentage of the dirty limits the tasks of @tsk's group may use before
+ * balance_dirty_pages() throttles them harder than other dirtiers.
+ */
+unsigned int blkcg_task_dirty_ratio(struct task_struct *tsk)
+{
+	unsigned int ratio;
+
+	rcu_read_lock();
+	ratio = task_blkio_cgroup(tsk)->dirty_ratio;
+	rcu_read_unlock();
+
+	return ratio;
+}
+
 static inline void
 blkio_update_group_weight(struct blkio_group *blkg, unsigned int weight)
 {
@@ -1350,6 +1369,8 @@ static u64 blkiocg_file_read_u64 (struct cgroup *cgrp, struct cftype *cft) {
 		switch(name) {
 		case BLKIO_PROP_weight:
 			return (u64)blkcg->weight;
+		case BLKIO_PROP_dirty_ratio:
+			return (u64)blkcg->dirty_ratio;
 		}
 		break;
 	default:
@@ -1372,6 +1393,11 @@ blkiocg_file_write_u64(struct cgroup *cgrp, struct cftype *cft, u64 val)
 		switch(name) {
 		case BLKIO_PROP_weight:
 			return blkio_weight_write(blkcg, val);
+		case BLKIO_PROP_dirty_ratio:
+			if (val < 1 || val > 100)
+				return -EINVAL;
+			blkcg->dirty_ratio = (unsigned int)val;
+			return 0;
 		}
 		break;
 	default:
@@ -1397,6 +1423,13 @@ struct cftype blkio_files[] = {
 		.read_u64 = blkiocg_file_read_u64,
 		.write_u64 = blkiocg_file_write_u64,
 	},
+	{
+		.name = "dirty_ratio",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_PROP,
+				BLKIO_PROP_dirty_ratio),
+		.read_u64 = blkiocg_file_read_u64,
+		.write_u64 = blkiocg_file_write_u64,
+	},
 	{
 		.name = "time",
 		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_PROP,
@@ -1610,6 +1643,7 @@ static struct cgroup_subsys_state *blkiocg_create(struct cgroup *cgroup)
 		return ERR_PTR(-ENOMEM);
 
 	blkcg->weight = BLKIO_WEIGHT_DEFAULT;
+	blkcg->dirty_ratio = 100;
 done:
 	spin_lock_init(&blkcg->lock);
 	INIT_HLIST_HEAD(&blkcg->blkg_list);
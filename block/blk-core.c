@@ -2055,6 +2055,31 @@ static void blk_account_io_completion(struct request *req, unsigned int bytes)
 	}
 }
 
+/*
+ * Read latency as seen by the submitter, from request allocation to
+ * completion, for the bdi latency target used by dirty throttling.
+ */
+static void blk_account_read_latency(struct request *req,
+				     unsigned long duration)
+{
+	struct backing_dev_info *bdi = &req->q->backing_dev_info;
+	u64 start = rq_start_time_ns(req);
+	u64 now;
+
+	if (!bdi->latency_target_us)
+		return;
+
+	if (start) {
+		now = sched_clock();
+		if (now < start)
+			return;
+		bdi_update_read_latency(bdi,
+				div_u64(now - start, NSEC_PER_USEC));
+	} else {
+		bdi_update_read_latency(bdi, jiffies_to_usecs(duration));
+	}
+}
+
 static void blk_account_io_done(struct request *req)
 {
 	/*
@@ -2078,6 +2103,9 @@ static void blk_account_io_done(struct request *req)
 
 		hd_struct_put(part);
 		part_stat_unlock();
+
+		if (rw == READ)
+			blk_account_read_latency(req, duration);
 	}
 }
 
@@ -2249,6 +2277,8 @@ void blk_dequeue_request(struct request *rq)
 void blk_start_request(struct request *req)
 {
 	blk_dequeue_request(req);
+	blk_rq_lat_dispatch(req);
+	blk_rq_lat_issue(req);
 
 	/*
 	 * We are now handing the request to the hardware, initialize
@@ -2520,7 +2550,7 @@ static void blk_finish_request(struct request *req, int error)
 	if (req->cmd_flags & REQ_DONTPREP)
 		blk_unprep_request(req);
 
-
+	blk_latency_account(req);
 	blk_account_io_done(req);
 
 	if (req->end_io)
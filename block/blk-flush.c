@@ -167,6 +167,7 @@ static bool blk_flush_complete_seq(struct request *rq, unsigned int seq,
 
 	case REQ_FSEQ_DATA:
 		list_move_tail(&rq->flush.list, &q->flush_data_in_flight);
+		blk_rq_lat_dispatch(rq);
 		list_add(&rq->queuelist, &q->queue_head);
 		queued = true;
 		break;
@@ -329,6 +330,7 @@ void blk_insert_flush(struct request *rq)
 	 */
 	if ((policy & REQ_FSEQ_DATA) &&
 	    !(policy & (REQ_FSEQ_PREFLUSH | REQ_FSEQ_POSTFLUSH))) {
+		blk_rq_lat_dispatch(rq);
 		list_add_tail(&rq->queuelist, &q->queue_head);
 		return;
 	}
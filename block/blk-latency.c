@@ -0,0 +1,121 @@
+/*
+ * Per-request latency breakdown.
+ *
+ * Every filesystem request is stamped when it is inserted into the queue,
+ * when it is moved to the dispatch list and when the driver takes it. A
+ * driver that knows more may also report when the command went out and
+ * when the data transfer finished, see blk_rq_lat_driver_times(). At
+ * completion the time spent in each stage is added to a log2 histogram
+ * of the queue, shown in /sys/block/<dev>/queue/latency_hist.
+ */
+
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "blk.h"
+
+static const char *blk_lat_stage_name[BLK_LAT_NR_STAGES] = {
+	[BLK_LAT_ELEVATOR]	= "elevator",
+	[BLK_LAT_DISPATCH]	= "dispatch",
+	[BLK_LAT_DRIVER]	= "driver",
+	[BLK_LAT_PREP]		= "prep",
+	[BLK_LAT_XFER]		= "xfer",
+	[BLK_LAT_BUSY]		= "busy",
+	[BLK_LAT_TOTAL]		= "total",
+};
+
+static void blk_lat_add(struct blk_latency_hist *hist, int rw,
+			enum blk_lat_stage stage, ktime_t from, ktime_t to)
+{
+	s64 us;
+	int bucket;
+
+	if (!from.tv64 || !to.tv64 || to.tv64 < from.tv64)
+		return;
+
+	us = ktime_us_delta(to, from);
+	bucket = min_t(int, fls64(us), BLK_LAT_BUCKETS - 1);
+	hist->count[rw][stage][bucket]++;
+	if (us > hist->max_us[rw][stage])
+		hist->max_us[rw][stage] = min_t(s64, us, UINT_MAX);
+}
+
+/*
+ * Called with the queue lock held from blk_finish_request().
+ */
+void blk_latency_account(struct request *rq)
+{
+	struct blk_latency_hist *hist = &rq->q->lat_hist;
+	struct blk_rq_lat *lat = &rq->lat;
+	int rw = rq_data_dir(rq);
+	ktime_t now;
+
+	if (rq->cmd_type != REQ_TYPE_FS || !lat->insert.tv64)
+		return;
+
+	now = ktime_get();
+	blk_lat_add(hist, rw, BLK_LAT_TOTAL, lat->insert, now);
+	blk_lat_add(hist, rw, BLK_LAT_ELEVATOR, lat->insert, lat->dispatch);
+	blk_lat_add(hist, rw, BLK_LAT_DISPATCH, lat->dispatch, lat->issue);
+	blk_lat_add(hist, rw, BLK_LAT_DRIVER, lat->issue, now);
+
+	if (lat->cmd.tv64) {
+		blk_lat_add(hist, rw, BLK_LAT_PREP, lat->issue, lat->cmd);
+		blk_lat_add(hist, rw, BLK_LAT_XFER, lat->cmd, lat->data);
+		blk_lat_add(hist, rw, BLK_LAT_BUSY,
+			    lat->data.tv64 ? lat->data : lat->cmd, now);
+	}
+}
+
+/*
+ * One line per direction and stage that saw any request:
+ *
+ *	<read|write> <stage> max <us>: <count below 1us> <below 2us> ...
+ */
+ssize_t blk_latency_hist_show(struct request_queue *q, char *page)
+{
+	struct blk_latency_hist *hist;
+	ssize_t len = 0;
+	int rw, stage, i, last;
+
+	hist = kmalloc(sizeof(*hist), GFP_KERNEL);
+	if (!hist)
+		return -ENOMEM;
+
+	spin_lock_irq(q->queue_lock);
+	memcpy(hist, &q->lat_hist, sizeof(*hist));
+	spin_unlock_irq(q->queue_lock);
+
+	for (rw = 0; rw < 2; rw++) {
+		for (stage = 0; stage < BLK_LAT_NR_STAGES; stage++) {
+			unsigned int *count = hist->count[rw][stage];
+
+			for (last = BLK_LAT_BUCKETS - 1; last >= 0; last--)
+				if (count[last])
+					break;
+			if (last < 0)
+				continue;
+
+			len += scnprintf(page + len, PAGE_SIZE - len,
+					 "%s %s max %u:", rw ? "write" : "read",
+					 blk_lat_stage_name[stage],
+					 hist->max_us[rw][stage]);
+			for (i = 0; i <= last; i++)
+				len += scnprintf(page + len, PAGE_SIZE - len,
+						 " %u", count[i]);
+			len += scnprintf(page + len, PAGE_SIZE - len, "\n");
+		}
+	}
+
+	kfree(hist);
+	return len;
+}
+
+void blk_latency_hist_clear(struct request_queue *q)
+{
+	spin_lock_irq(q->queue_lock);
+	memset(&q->lat_hist, 0, sizeof(q->lat_hist));
+	spin_unlock_irq(q->queue_lock);
+}
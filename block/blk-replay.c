@@ -0,0 +1,835 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Block I/O trace replay.
+ *
+ * Replays a captured blktrace against a block device through whatever
+ * I/O scheduler is selected for it, so that schedulers can be compared
+ * on the real device with a real workload. The trace is loaded as text,
+ * one request per line, in the format produced by
+ *
+ *	blkparse -a issue -f "%T.%9t %p %d %S %n\n"
+ *
+ * i.e. "<sec>.<nsec> <pid> <rwbs> <sector> <nr_sectors>". Lines that
+ * don't parse are ignored, as are discards and requests without data.
+ *
+ * Requests are issued at their original offset from the start of the
+ * trace. A read or sync write is additionally held back until the
+ * previous read or sync write of the same pid has completed, since the
+ * task that issued them originally was blocked on it.
+ *
+ * debugfs: /sys/kernel/debug/blk-replay/
+ *	device		path of the block device to replay against
+ *	allow_writes	writes are skipped unless set; they destroy data
+ *	trace		write trace lines to append, read back the count
+ *	control		"start", "stop" or "reset" (drops the trace)
+ *	results		per class latency percentiles, throughput, fairness
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/bio.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/kthread.h>
+#include <linux/hrtimer.h>
+#include <linux/mutex.h>
+#include <linux/sort.h>
+#include <linux/slab.h>
+
+#define MODULE_NAME "blk-replay"
+
+#define REPLAY_MAX_SECTORS	1024
+#define REPLAY_MAX_PIDS		256
+#define REPLAY_LINE_MAX		128
+
+enum replay_class {
+	REPLAY_READ = 0,
+	REPLAY_SYNC_WRITE,
+	REPLAY_WRITE,
+	REPLAY_CLASS_MAX,
+};
+
+static const char *replay_class_name[REPLAY_CLASS_MAX] = {
+	[REPLAY_READ]		= "read",
+	[REPLAY_SYNC_WRITE]	= "sync_write",
+	[REPLAY_WRITE]		= "write",
+};
+
+#define REC_HAS_DEPENDENT	BIT(0)
+#define REC_ISSUED		BIT(1)
+#define REC_ERROR		BIT(2)
+
+/**
+ * struct replay_rec - one request of the trace
+ * @t_ns:	issue time in the trace, relative to its first request
+ * @sector:	start sector in the trace
+ * @pid:	pid that issued the request originally
+ * @nr_sect:	size in sectors
+ * @class:	enum replay_class
+ * @flags:	REC_* flags
+ * @done:	set once the replayed request completed
+ * @dep:	index of the request this one waits for, -1 if none
+ * @issue_ns:	time the replayed request was submitted
+ * @done_ns:	time the replayed request completed
+ */
+struct replay_rec {
+	u64		t_ns;
+	sector_t	sector;
+	u32		pid;
+	u16		nr_sect;
+	u8		class;
+	u8		flags;
+	int		done;
+	int		dep;
+	u64		issue_ns;
+	u64		done_ns;
+};
+
+struct replay_class_result {
+	unsigned long	nr;
+	u64		bytes;
+	u32		p50_us;
+	u32		p90_us;
+	u32		p99_us;
+	u32		max_us;
+	u64		span_ns;
+	u64		trace_span_ns;
+};
+
+enum replay_state {
+	REPLAY_IDLE,
+	REPLAY_RUNNING,
+	REPLAY_DONE,
+};
+
+static struct replay_data {
+	struct mutex		lock;
+	enum replay_state	state;
+
+	struct replay_rec	*recs;
+	unsigned int		nr_recs;
+	unsigned int		max_recs;
+	char			partial[REPLAY_LINE_MAX];
+	unsigned int		partial_len;
+
+	char			path[64];
+	u32			allow_writes;
+	struct block_device	*bdev;
+	fmode_t			mode;
+	struct page		*pages[REPLAY_MAX_SECTORS >> (PAGE_SHIFT - 9)];
+
+	struct task_struct	*task;
+	struct completion	finished;
+	atomic_t		inflight;
+	bool			abort;
+	ktime_t			start;
+
+	unsigned int		nr_ignored;
+	unsigned int		nr_skipped;
+	unsigned int		nr_errors;
+	u64			lag_ns;
+	u64			duration_ns;
+	struct replay_class_result result[REPLAY_CLASS_MAX];
+	u32			fairness;
+
+	struct dentry		*debug_root;
+} rd;
+
+/******************** trace parsing ***********************/
+
+static int replay_add_rec(struct replay_rec *rec)
+{
+	struct replay_rec *recs;
+	unsigned int max;
+
+	if (rd.nr_recs == rd.max_recs) {
+		max = rd.max_recs ? rd.max_recs * 2 : 4096;
+		recs = vmalloc(max * sizeof(*recs));
+		if (!recs)
+			return -ENOMEM;
+		if (rd.recs) {
+			memcpy(recs, rd.recs, rd.nr_recs * sizeof(*recs));
+			vfree(rd.recs);
+		}
+		rd.recs = recs;
+		rd.max_recs = max;
+	}
+
+	rd.recs[rd.nr_recs++] = *rec;
+	return 0;
+}
+
+static int replay_parse_line(char *line)
+{
+	struct replay_rec rec;
+	unsigned long long sec, nsec, sector;
+	unsigned int pid, nr_sect;
+	char rwbs[8];
+
+	if (sscanf(line, "%llu.%llu %u %7s %llu %u", &sec, &nsec, &pid,
+		   rwbs, &sector, &nr_sect) != 6)
+		return 0;
+
+	if (!nr_sect || strchr(rwbs, 'D') || strchr(rwbs, 'N')) {
+		rd.nr_ignored++;
+		return 0;
+	}
+
+	memset(&rec, 0, sizeof(rec));
+	rec.t_ns = sec * NSEC_PER_SEC + nsec;
+	rec.sector = sector;
+	rec.pid = pid;
+	rec.nr_sect = min_t(unsigned int, nr_sect, REPLAY_MAX_SECTORS);
+	rec.dep = -1;
+	if (strchr(rwbs, 'R'))
+		rec.class = REPLAY_READ;
+	else if (strchr(rwbs, 'W'))
+		rec.class = strchr(rwbs, 'S') ? REPLAY_SYNC_WRITE :
+						REPLAY_WRITE;
+	else {
+		rd.nr_ignored++;
+		return 0;
+	}
+
+	return replay_add_rec(&rec);
+}
+
+static ssize_t replay_trace_write(struct file *file, const char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	char *buf, *line, *p;
+	ssize_t ret = count;
+
+	buf = kmalloc(count + REPLAY_LINE_MAX + 1, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	mutex_lock(&rd.lock);
+	if (rd.state == REPLAY_RUNNING) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	/* Lines may be split across writes */
+	memcpy(buf, rd.partial, rd.partial_len);
+	if (copy_from_user(buf + rd.partial_len, ubuf, count)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	buf[rd.partial_len + count] = '\0';
+	rd.partial_len = 0;
+
+	p = buf;
+	while ((line = strsep(&p, "\n")) != NULL) {
+		if (!p) {
+			/* No newline yet, keep it for the next write */
+			rd.partial_len = min_t(size_t, strlen(line),
+					       REPLAY_LINE_MAX - 1);
+			memcpy(rd.partial, line, rd.partial_len);
+			break;
+		}
+		if (replay_parse_line(line)) {
+			ret = -ENOMEM;
+			break;
+		}
+	}
+out:
+	mutex_unlock(&rd.lock);
+	kfree(buf);
+	return ret;
+}
+
+static ssize_t replay_trace_read(struct file *file, char __user *ubuf,
+				 size_t count, loff_t *ppos)
+{
+	char buf[48];
+	int len;
+
+	len = snprintf(buf, sizeof(buf), "%u requests, %u ignored\n",
+		       rd.nr_recs, rd.nr_ignored);
+	return simple_read_from_buffer(ubuf, count, ppos, buf, len);
+}
+
+static const struct file_operations replay_trace_fops = {
+	.open	= simple_open,
+	.read	= replay_trace_read,
+	.write	= replay_trace_write,
+};
+
+/******************** replay ***********************/
+
+static int replay_cmp_rec(const void *a, const void *b)
+{
+	const struct replay_rec *x = a, *y = b;
+
+	return x->t_ns < y->t_ns ? -1 : x->t_ns > y->t_ns;
+}
+
+/*
+ * Sort by issue time, make it relative to the first request and link
+ * the dependencies.
+ */
+static void replay_prepare(void)
+{
+	struct {
+		u32 pid;
+		int last;
+	} *pids;
+	unsigned int i, j, nr_pids = 0;
+	u64 t0;
+
+	sort(rd.recs, rd.nr_recs, sizeof(*rd.recs), replay_cmp_rec, NULL);
+	t0 = rd.recs[0].t_ns;
+
+	pids = kcalloc(REPLAY_MAX_PIDS, sizeof(*pids), GFP_KERNEL);
+
+	for (i = 0; i < rd.nr_recs; i++) {
+		struct replay_rec *r = &rd.recs[i];
+
+		r->t_ns -= t0;
+		r->flags = 0;
+		r->done = 0;
+		r->dep = -1;
+		if (!pids || r->class == REPLAY_WRITE)
+			continue;
+
+		for (j = 0; j < nr_pids; j++)
+			if (pids[j].pid == r->pid)
+				break;
+		if (j < nr_pids) {
+			r->dep = pids[j].last;
+			rd.recs[r->dep].flags |= REC_HAS_DEPENDENT;
+		} else if (nr_pids < REPLAY_MAX_PIDS) {
+			pids[nr_pids++].pid = r->pid;
+		} else {
+			continue;
+		}
+		pids[j].last = i;
+	}
+
+	kfree(pids);
+}
+
+static void replay_end_io(struct bio *bio, int err)
+{
+	struct replay_rec *r = bio->bi_private;
+
+	r->done_ns = ktime_to_ns(ktime_sub(ktime_get(), rd.start));
+	if (err)
+		r->flags |= REC_ERROR;
+	bio_put(bio);
+
+	smp_wmb();
+	r->done = 1;
+	if (atomic_dec_and_test(&rd.inflight) ||
+	    (r->flags & REC_HAS_DEPENDENT))
+		wake_up_process(rd.task);
+}
+
+static void replay_submit(struct replay_rec *r)
+{
+	struct request_queue *q = bdev_get_queue(rd.bdev);
+	sector_t nr_dev = i_size_read(rd.bdev->bd_inode) >> 9;
+	sector_t sector = r->sector;
+	unsigned int nr_sect, bytes, i;
+	struct bio *bio;
+	int rw;
+
+	r->issue_ns = ktime_to_ns(ktime_sub(ktime_get(), rd.start));
+	r->flags |= REC_ISSUED;
+
+	nr_sect = min_t(unsigned int, r->nr_sect, queue_max_sectors(q));
+	if (r->class != REPLAY_READ && !rd.allow_writes)
+		goto skip;
+	if (nr_dev <= nr_sect)
+		goto skip;
+
+	bio = bio_alloc(GFP_KERNEL, DIV_ROUND_UP(nr_sect << 9, PAGE_SIZE));
+	if (!bio)
+		goto skip;
+
+	/* Wrap requests beyond the end of a smaller device */
+	if (sector + nr_sect > nr_dev)
+		sector = sector_div(sector, nr_dev - nr_sect);
+
+	bio->bi_bdev = rd.bdev;
+	bio->bi_sector = sector;
+	bio->bi_end_io = replay_end_io;
+	bio->bi_private = r;
+
+	for (i = 0, bytes = nr_sect << 9; bytes; i++) {
+		unsigned int len = min_t(unsigned int, bytes, PAGE_SIZE);
+
+		if (bio_add_page(bio, rd.pages[i], len, 0) < len)
+			break;
+		bytes -= len;
+	}
+	r->nr_sect = bio->bi_size >> 9;
+	if (!bio->bi_size) {
+		bio_put(bio);
+		goto skip;
+	}
+
+	rw = r->class == REPLAY_READ ? READ : WRITE;
+	if (r->class != REPLAY_WRITE)
+		rw |= REQ_SYNC;
+
+	atomic_inc(&rd.inflight);
+	submit_bio(rw, bio);
+	return;
+
+skip:
+	rd.nr_skipped++;
+	r->done_ns = r->issue_ns;
+	r->done = 1;
+}
+
+static bool replay_dep_done(struct replay_rec *r)
+{
+	if (r->dep < 0)
+		return true;
+	if (!rd.recs[r->dep].done)
+		return false;
+	smp_rmb();
+	return true;
+}
+
+static int replay_thread(void *unused)
+{
+	unsigned int next = 0, nr_def = 0, i;
+	unsigned int *def;
+	ktime_t due = ktime_set(0, 0);
+
+	def = vmalloc(rd.nr_recs * sizeof(*def));
+	if (!def)
+		goto out;
+
+	rd.start = ktime_get();
+	while (!rd.abort) {
+		/* Held back requests whose dependency has completed */
+		for (i = 0; i < nr_def; ) {
+			if (replay_dep_done(&rd.recs[def[i]])) {
+				replay_submit(&rd.recs[def[i]]);
+				def[i] = def[--nr_def];
+			} else {
+				i++;
+			}
+		}
+
+		if (next == rd.nr_recs && !nr_def)
+			break;
+
+		if (next < rd.nr_recs) {
+			struct replay_rec *r = &rd.recs[next];
+
+			s64 late;
+
+			due = ktime_add_ns(rd.start, r->t_ns);
+			late = ktime_to_ns(ktime_sub(ktime_get(), due));
+			if (late >= 0) {
+				rd.lag_ns += late;
+				if (replay_dep_done(r))
+					replay_submit(r);
+				else
+					def[nr_def++] = next;
+				next++;
+				continue;
+			}
+		}
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		for (i = 0; i < nr_def; i++)
+			if (replay_dep_done(&rd.recs[def[i]]))
+				break;
+		if (i == nr_def) {
+			if (next < rd.nr_recs)
+				schedule_hrtimeout(&due, HRTIMER_MODE_ABS);
+			else
+				schedule();
+		}
+		__set_current_state(TASK_RUNNING);
+	}
+
+	/* Requests in flight point at the records, wait for all of them */
+	for (;;) {
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		if (!atomic_read(&rd.inflight))
+			break;
+		schedule();
+	}
+	__set_current_state(TASK_RUNNING);
+	rd.duration_ns = ktime_to_ns(ktime_sub(ktime_get(), rd.start));
+
+	vfree(def);
+out:
+	complete(&rd.finished);
+	return 0;
+}
+
+static int replay_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static u32 replay_percentile(u32 *lat, unsigned long nr, unsigned int pct)
+{
+	return lat[min_t(unsigned long, nr - 1, div_u64((u64)nr * pct, 100))];
+}
+
+static void replay_compute_results(void)
+{
+	struct replay_class_result *res;
+	u64 first[REPLAY_CLASS_MAX], last[REPLAY_CLASS_MAX];
+	u64 tfirst[REPLAY_CLASS_MAX], tlast[REPLAY_CLASS_MAX];
+	u64 sum = 0, sum_sq = 0, x;
+	unsigned int c, i, n = 0;
+	unsigned long nr;
+	u32 *lat;
+
+	memset(rd.result, 0, sizeof(rd.result));
+	rd.nr_errors = 0;
+	rd.fairness = 0;
+
+	lat = vmalloc(rd.nr_recs * sizeof(*lat));
+	if (!lat)
+		return;
+
+	for (c = 0; c < REPLAY_CLASS_MAX; c++) {
+		res = &rd.result[c];
+		first[c] = tfirst[c] = ULLONG_MAX;
+		last[c] = tlast[c] = 0;
+		nr = 0;
+
+		for (i = 0; i < rd.nr_recs; i++) {
+			struct replay_rec *r = &rd.recs[i];
+
+			if (r->class != c || !(r->flags & REC_ISSUED) ||
+			    r->done_ns == r->issue_ns)
+				continue;
+			if (r->flags & REC_ERROR) {
+				rd.nr_errors++;
+				continue;
+			}
+			lat[nr++] = div_u64(r->done_ns - r->issue_ns,
+					    NSEC_PER_USEC);
+			res->bytes += r->nr_sect << 9;
+			first[c] = min(first[c], r->issue_ns);
+			last[c] = max(last[c], r->done_ns);
+			tfirst[c] = min(tfirst[c], r->t_ns);
+			tlast[c] = max(tlast[c], r->t_ns);
+		}
+
+		res->nr = nr;
+		if (!nr)
+			continue;
+
+		sort(lat, nr, sizeof(*lat), replay_cmp_u32, NULL);
+		res->p50_us = replay_percentile(lat, nr, 50);
+		res->p90_us = replay_percentile(lat, nr, 90);
+		res->p99_us = replay_percentile(lat, nr, 99);
+		res->max_us = lat[nr - 1];
+		res->span_ns = last[c] - first[c];
+		res->trace_span_ns = tlast[c] - tfirst[c];
+
+		/*
+		 * Fairness is Jain's index over how much each class was
+		 * stretched relative to the trace: 1000 when all of them
+		 * were slowed down (or sped up) by the same factor.
+		 */
+		if (res->span_ns && res->trace_span_ns) {
+			x = div64_u64(res->trace_span_ns * 1000, res->span_ns);
+			sum += x;
+			sum_sq += x * x;
+			n++;
+		}
+	}
+
+	if (n && sum_sq)
+		rd.fairness = div64_u64(sum * sum * 1000, n * sum_sq);
+
+	vfree(lat);
+}
+
+static int replay_open_device(void)
+{
+	struct block_device *bdev;
+	unsigned int i;
+
+	rd.mode = FMODE_READ | FMODE_EXCL;
+	if (rd.allow_writes)
+		rd.mode |= FMODE_WRITE;
+
+	bdev = blkdev_get_by_path(strim(rd.path), rd.mode, &rd);
+	if (IS_ERR(bdev))
+		return PTR_ERR(bdev);
+	rd.bdev = bdev;
+
+	for (i = 0; i < ARRAY_SIZE(rd.pages); i++) {
+		if (rd.pages[i])
+			continue;
+		rd.pages[i] = alloc_page(GFP_KERNEL | __GFP_ZERO);
+		if (!rd.pages[i]) {
+			blkdev_put(rd.bdev, rd.mode);
+			rd.bdev = NULL;
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+static void replay_finish(void)
+{
+	if (rd.state != REPLAY_RUNNING)
+		return;
+
+	wait_for_completion(&rd.finished);
+	put_task_struct(rd.task);
+	rd.task = NULL;
+	blkdev_put(rd.bdev, rd.mode);
+	rd.bdev = NULL;
+	replay_compute_results();
+	rd.state = REPLAY_DONE;
+}
+
+static int replay_start(void)
+{
+	struct task_struct *task;
+	int ret;
+
+	if (rd.state == REPLAY_RUNNING)
+		return -EBUSY;
+	if (!rd.nr_recs)
+		return -ENODATA;
+
+	ret = replay_open_device();
+	if (ret) {
+		pr_err("%s: can't open %s (%d)\n", MODULE_NAME, rd.path, ret);
+		return ret;
+	}
+
+	replay_prepare();
+	rd.abort = false;
+	rd.lag_ns = 0;
+	rd.nr_skipped = 0;
+	atomic_set(&rd.inflight, 0);
+	init_completion(&rd.finished);
+
+	task = kthread_create(replay_thread, NULL, MODULE_NAME);
+	if (IS_ERR(task)) {
+		blkdev_put(rd.bdev, rd.mode);
+		rd.bdev = NULL;
+		return PTR_ERR(task);
+	}
+	get_task_struct(task);
+	rd.task = task;
+	rd.state = REPLAY_RUNNING;
+	wake_up_process(task);
+
+	return 0;
+}
+
+static void replay_reset(void)
+{
+	vfree(rd.recs);
+	rd.recs = NULL;
+	rd.nr_recs = rd.max_recs = 0;
+	rd.partial_len = 0;
+	rd.nr_ignored = 0;
+	rd.state = REPLAY_IDLE;
+}
+
+static ssize_t replay_control_write(struct file *file,
+				    const char __user *ubuf,
+				    size_t count, loff_t *ppos)
+{
+	char cmd[16];
+	int ret = 0;
+
+	if (count >= sizeof(cmd))
+		return -EINVAL;
+	if (copy_from_user(cmd, ubuf, count))
+		return -EFAULT;
+	cmd[count] = '\0';
+	strim(cmd);
+
+	mutex_lock(&rd.lock);
+	if (!strcmp(cmd, "start")) {
+		ret = replay_start();
+	} else if (!strcmp(cmd, "stop")) {
+		rd.abort = true;
+		if (rd.task)
+			wake_up_process(rd.task);
+		replay_finish();
+	} else if (!strcmp(cmd, "reset")) {
+		rd.abort = true;
+		if (rd.task)
+			wake_up_process(rd.task);
+		replay_finish();
+		replay_reset();
+	} else {
+		ret = -EINVAL;
+	}
+	mutex_unlock(&rd.lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations replay_control_fops = {
+	.open	= simple_open,
+	.write	= replay_control_write,
+};
+
+static ssize_t replay_device_read(struct file *file, char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	return simple_read_from_buffer(ubuf, count, ppos, rd.path,
+				       strlen(rd.path));
+}
+
+static ssize_t replay_device_write(struct file *file, const char __user *ubuf,
+				   size_t count, loff_t *ppos)
+{
+	ssize_t ret = count;
+
+	if (count >= sizeof(rd.path))
+		return -EINVAL;
+
+	mutex_lock(&rd.lock);
+	if (rd.state == REPLAY_RUNNING) {
+		ret = -EBUSY;
+	} else if (copy_from_user(rd.path, ubuf, count)) {
+		ret = -EFAULT;
+	} else {
+		rd.path[count] = '\0';
+		strim(rd.path);
+	}
+	mutex_unlock(&rd.lock);
+
+	return ret;
+}
+
+static const struct file_operations replay_device_fops = {
+	.open	= simple_open,
+	.read	= replay_device_read,
+	.write	= replay_device_write,
+};
+
+static int replay_results_show(struct seq_file *s, void *unused)
+{
+	struct replay_class_result *res;
+	unsigned int c;
+
+	mutex_lock(&rd.lock);
+	if (rd.state == REPLAY_RUNNING && completion_done(&rd.finished))
+		replay_finish();
+	if (rd.state != REPLAY_DONE) {
+		seq_puts(s, rd.state == REPLAY_RUNNING ? "running\n" :
+							 "no results\n");
+		goto out;
+	}
+
+	seq_printf(s, "device: %s\n", rd.path);
+	seq_printf(s, "requests: %u skipped: %u errors: %u\n",
+		   rd.nr_recs, rd.nr_skipped, rd.nr_errors);
+	seq_printf(s, "duration: %llu ms trace: %llu ms issue lag: %llu us\n",
+		   div_u64(rd.duration_ns, NSEC_PER_MSEC),
+		   div_u64(rd.nr_recs ? rd.recs[rd.nr_recs - 1].t_ns : 0,
+			   NSEC_PER_MSEC),
+		   div_u64(div_u64(rd.lag_ns, max(rd.nr_recs, 1U)),
+			   NSEC_PER_USEC));
+	seq_printf(s, "%-10s %8s %8s %8s %8s %8s %10s\n", "class", "nr",
+		   "p50_us", "p90_us", "p99_us", "max_us", "KB/s");
+	for (c = 0; c < REPLAY_CLASS_MAX; c++) {
+		res = &rd.result[c];
+		seq_printf(s, "%-10s %8lu %8u %8u %8u %8u %10llu\n",
+			   replay_class_name[c], res->nr, res->p50_us,
+			   res->p90_us, res->p99_us, res->max_us,
+			   res->span_ns ? div64_u64(res->bytes * NSEC_PER_SEC,
+						    res->span_ns * 1024) : 0);
+	}
+	seq_printf(s, "fairness: %u.%03u\n", rd.fairness / 1000,
+		   rd.fairness % 1000);
+out:
+	mutex_unlock(&rd.lock);
+	return 0;
+}
+
+static int replay_results_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, replay_results_show, inode->i_private);
+}
+
+static const struct file_operations replay_results_fops = {
+	.open		= replay_results_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init replay_init(void)
+{
+	mutex_init(&rd.lock);
+
+	rd.debug_root = debugfs_create_dir(MODULE_NAME, NULL);
+	if (!rd.debug_root)
+		return -ENOENT;
+
+	if (!debugfs_create_file("device", S_IRUGO | S_IWUSR, rd.debug_root,
+				 NULL, &replay_device_fops) ||
+	    !debugfs_create_u32("allow_writes", S_IRUGO | S_IWUSR,
+				rd.debug_root, &rd.allow_writes) ||
+	    !debugfs_create_file("trace", S_IRUGO | S_IWUSR, rd.debug_root,
+				 NULL, &replay_trace_fops) ||
+	    !debugfs_create_file("control", S_IWUSR, rd.debug_root,
+				 NULL, &replay_control_fops) ||
+	    !debugfs_create_file("results", S_IRUGO, rd.debug_root,
+				 NULL, &replay_results_fops)) {
+		debugfs_remove_recursive(rd.debug_root);
+		return -ENOENT;
+	}
+
+	return 0;
+}
+
+static void __exit replay_exit(void)
+{
+	unsigned int i;
+
+	debugfs_remove_recursive(rd.debug_root);
+
+	mutex_lock(&rd.lock);
+	rd.abort = true;
+	if (rd.task)
+		wake_up_process(rd.task);
+	replay_finish();
+	replay_reset();
+	mutex_unlock(&rd.lock);
+
+	for (i = 0; i < ARRAY_SIZE(rd.pages); i++)
+		if (rd.pages[i])
+			__free_page(rd.pages[i]);
+}
+
+module_init(replay_init);
+module_exit(replay_exit);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("Block I/O trace replay");
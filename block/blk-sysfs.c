@@ -275,6 +275,22 @@ queue_rq_affinity_store(struct request_queue *q, const char *page, size_t count)
 	return ret;
 }
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+static ssize_t queue_latency_hist_show(struct request_queue *q, char *page)
+{
+	return blk_latency_hist_show(q, page);
+}
+
+/* any write clears the histograms */
+static ssize_t
+queue_latency_hist_store(struct request_queue *q, const char *page,
+			 size_t count)
+{
+	blk_latency_hist_clear(q);
+	return count;
+}
+#endif
+
 static struct queue_sysfs_entry queue_requests_entry = {
 	.attr = {.name = "nr_requests", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_requests_show,
@@ -389,6 +405,14 @@ static struct queue_sysfs_entry queue_random_entry = {
 	.store = queue_store_random,
 };
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+static struct queue_sysfs_entry queue_latency_hist_entry = {
+	.attr = {.name = "latency_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_latency_hist_show,
+	.store = queue_latency_hist_store,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -411,6 +435,9 @@ static struct attribute *default_attrs[] = {
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
 	&queue_random_entry.attr,
+#ifdef CONFIG_BLK_LATENCY_HIST
+	&queue_latency_hist_entry.attr,
+#endif
 	NULL,
 };
 
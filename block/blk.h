@@ -214,6 +214,29 @@ static inline struct io_context *create_io_context(struct task_struct *task,
 	return task->io_context;
 }
 
+/*
+ * Per-request latency breakdown. Each stamp is taken once, so a requeued
+ * request keeps the times of its first pass.
+ */
+#ifdef CONFIG_BLK_LATENCY_HIST
+static inline void blk_rq_lat_mark(ktime_t *stamp)
+{
+	if (!stamp->tv64)
+		*stamp = ktime_get();
+}
+#define blk_rq_lat_insert(rq)	blk_rq_lat_mark(&(rq)->lat.insert)
+#define blk_rq_lat_dispatch(rq)	blk_rq_lat_mark(&(rq)->lat.dispatch)
+#define blk_rq_lat_issue(rq)	blk_rq_lat_mark(&(rq)->lat.issue)
+extern void blk_latency_account(struct request *rq);
+extern ssize_t blk_latency_hist_show(struct request_queue *q, char *page);
+extern void blk_latency_hist_clear(struct request_queue *q);
+#else
+#define blk_rq_lat_insert(rq)	do { } while (0)
+#define blk_rq_lat_dispatch(rq)	do { } while (0)
+#define blk_rq_lat_issue(rq)	do { } while (0)
+static inline void blk_latency_account(struct request *rq) { }
+#endif
+
 /*
  * Internal throttling interface
  */
@@ -426,6 +426,7 @@ void elv_dispatch_sort(struct request_queue *q, struct request *rq)
 			break;
 	}
 
+	blk_rq_lat_dispatch(rq);
 	list_add(&rq->queuelist, entry);
 }
 EXPORT_SYMBOL(elv_dispatch_sort);
@@ -446,6 +447,7 @@ void elv_dispatch_add_tail(struct request_queue *q, struct request *rq)
 
 	q->end_sector = rq_end_sector(rq);
 	q->boundary_rq = rq;
+	blk_rq_lat_dispatch(rq);
 	list_add_tail(&rq->queuelist, &q->queue_head);
 }
 EXPORT_SYMBOL(elv_dispatch_add_tail);
@@ -683,6 +685,7 @@ void __elv_add_request(struct request_queue *q, struct request *rq, int where)
 	trace_block_rq_insert(q, rq);
 
 	blk_pm_add_request(q, rq);
+	blk_rq_lat_insert(rq);
 
 	rq->q = q;
 
@@ -702,12 +705,14 @@ void __elv_add_request(struct request_queue *q, struct request *rq, int where)
 	case ELEVATOR_INSERT_REQUEUE:
 	case ELEVATOR_INSERT_FRONT:
 		rq->cmd_flags |= REQ_SOFTBARRIER;
+		blk_rq_lat_dispatch(rq);
 		list_add(&rq->queuelist, &q->queue_head);
 		break;
 
 	case ELEVATOR_INSERT_BACK:
 		rq->cmd_flags |= REQ_SOFTBARRIER;
 		elv_drain_elevator(q);
+		blk_rq_lat_dispatch(rq);
 		list_add_tail(&rq->queuelist, &q->queue_head);
 		/*
 		 * We kick the queue here for the following reasons.
@@ -26,6 +26,9 @@
 #include <linux/compiler.h>
 #include <linux/blktrace_api.h>
 #include <linux/hrtimer.h>
+#include <linux/rcupdate.h>
+
+#include "blk-cgroup.h"
 
 /*
  * enum row_queue_prio - Priorities of the ROW queues
@@ -35,6 +38,8 @@
  * the bigger is the "bus time" (or the dispatch quantum) given
  * to that queue.
  * ROWQ_PRIO_HIGH_READ - is the higher priority queue.
+ * ROWQ_PRIO_BG_READ/ROWQ_PRIO_BG_SWRITE hold regular priority requests
+ * submitted from a background blkio cgroup (see row_current_is_bg()).
  *
  */
 enum row_queue_prio {
@@ -45,6 +50,8 @@ enum row_queue_prio {
 	ROWQ_PRIO_REG_WRITE,
 	ROWQ_PRIO_LOW_READ,
 	ROWQ_PRIO_LOW_SWRITE,
+	ROWQ_PRIO_BG_READ,
+	ROWQ_PRIO_BG_SWRITE,
 	ROWQ_MAX_PRIO,
 };
 
@@ -92,13 +99,29 @@ static const struct row_queue_params row_queues_def[] = {
 	{false, 1, false},	/* ROWQ_PRIO_REG_SWRITE */
 	{false, 1, false},	/* ROWQ_PRIO_REG_WRITE */
 	{false, 1, false},	/* ROWQ_PRIO_LOW_READ */
-	{false, 1, false}	/* ROWQ_PRIO_LOW_SWRITE */
+	{false, 1, false},	/* ROWQ_PRIO_LOW_SWRITE */
+	{true, 1, false},	/* ROWQ_PRIO_BG_READ */
+	{false, 1, false}	/* ROWQ_PRIO_BG_SWRITE */
 };
 
 /* Default values for idling on read queues (in msec) */
 #define ROW_IDLE_TIME_MSEC 5
 #define ROW_READ_FREQ_MSEC 5
 
+/*
+ * Background reads don't idle by default: holding the device for a
+ * background app is never worth delaying a foreground request for.
+ */
+#define ROW_BG_IDLE_TIME_MSEC 0
+#define ROW_BG_READ_FREQ_MSEC 5
+
+/*
+ * Requests from a blkio cgroup with a weight at or below this are
+ * treated as background. Android puts background apps in a cgroup with
+ * a low blkio.weight; the root group defaults to BLKIO_WEIGHT_DEFAULT.
+ */
+#define ROW_BG_WEIGHT_THRESH 200
+
 /**
  * struct rowq_idling_data -  parameters for idling on the queue
  * @last_insert_time:	time the last request was inserted
@@ -143,6 +166,9 @@ struct row_queue {
  * @idle_time_ms:		idling duration (msec)
  * @freq_ms:		min time between two requests that
  *			triger idling (msec)
+ * @bg_idle_time_ms:	idling duration on background reads, 0 to
+ *			disable (msec)
+ * @bg_freq_ms:		@freq_ms for background reads (msec)
  * @hr_timer:	idling timer
  * @idle_work:	the work to be scheduled when idling timer expires
  * @idling_queue_idx:	index of the queues we're idling on
@@ -151,6 +177,8 @@ struct row_queue {
 struct idling_data {
 	s64				idle_time_ms;
 	s64				freq_ms;
+	s64				bg_idle_time_ms;
+	s64				bg_freq_ms;
 
 	struct hrtimer			hr_timer;
 	struct work_struct		idle_work;
@@ -171,6 +199,29 @@ struct starvation_data {
 	int				starvation_counter;
 };
 
+enum row_class {
+	ROW_CLASS_FG = 0,
+	ROW_CLASS_BG,
+	ROW_CLASS_MAX,
+};
+
+/**
+ * struct row_latency_stats - request latency per class and direction
+ * @nr:		number of completed requests
+ * @wait_us:	total time from insertion to dispatch (usec)
+ * @max_wait_us: longest insertion to dispatch time (usec)
+ * @lat_us:	total time from insertion to completion (usec)
+ * @max_lat_us:	longest insertion to completion time (usec)
+ *
+ */
+struct row_latency_stats {
+	unsigned long			nr;
+	u64				wait_us;
+	unsigned long			max_wait_us;
+	u64				lat_us;
+	unsigned long			max_lat_us;
+};
+
 /**
  * struct row_queue - Per block device rqueue structure
  * @dispatch_queue:	dispatch rqueue
@@ -187,6 +238,9 @@ struct starvation_data {
  * @reg_prio_starvation: starvation data for REGULAR priority queues
  * @low_prio_starvation: starvation data for LOW priority queues
  * @cycle_flags:	used for marking unserved queueus
+ * @bg_weight_thresh:	blkio weight at or below which requests are
+ *			queued as background, 0 to disable
+ * @stats:		latency statistics per class and direction
  *
  */
 struct row_data {
@@ -206,9 +260,55 @@ struct row_data {
 	struct starvation_data		low_prio_starvation;
 
 	unsigned int			cycle_flags;
+
+	int				bg_weight_thresh;
+	struct row_latency_stats	stats[ROW_CLASS_MAX][2];
 };
 
 #define RQ_ROWQ(rq) ((struct row_queue *) ((rq)->elv.priv[0]))
+/* Insertion time in usec, truncated; only used for differences */
+#define RQ_INSERT_US(rq) ((unsigned long)((rq)->elv.priv[1]))
+
+static inline unsigned long row_now_us(void)
+{
+	return (unsigned long)ktime_to_us(ktime_get());
+}
+
+static inline bool row_is_bg_queue(enum row_queue_prio prio)
+{
+	return prio == ROWQ_PRIO_BG_READ || prio == ROWQ_PRIO_BG_SWRITE;
+}
+
+static inline struct row_latency_stats *row_rq_stats(struct row_data *rd,
+						    struct request *rq)
+{
+	enum row_class c = row_is_bg_queue(RQ_ROWQ(rq)->prio) ?
+				ROW_CLASS_BG : ROW_CLASS_FG;
+
+	return &rd->stats[c][rq_data_dir(rq)];
+}
+
+static inline bool row_queue_idling_enabled(struct row_data *rd,
+					    enum row_queue_prio prio)
+{
+	if (prio == ROWQ_PRIO_BG_READ)
+		return rd->rd_idle_data.bg_idle_time_ms > 0;
+	return row_queues_def[prio].idling_enabled;
+}
+
+static inline s64 row_queue_idle_time(struct row_data *rd,
+				      enum row_queue_prio prio)
+{
+	return row_is_bg_queue(prio) ? rd->rd_idle_data.bg_idle_time_ms :
+				       rd->rd_idle_data.idle_time_ms;
+}
+
+static inline s64 row_queue_idle_freq(struct row_data *rd,
+				      enum row_queue_prio prio)
+{
+	return row_is_bg_queue(prio) ? rd->rd_idle_data.bg_freq_ms :
+				       rd->rd_idle_data.freq_ms;
+}
 
 #define row_log(q, fmt, args...)   \
 	blk_add_trace_msg(q, "%s():" fmt , __func__, ##args)
@@ -336,6 +436,7 @@ static void row_add_request(struct request_queue *q,
 	rd->nr_reqs[rq_data_dir(rq)]++;
 	rqueue->nr_req++;
 	rq_set_fifo_time(rq, jiffies); /* for statistics*/
+	rq->elv.priv[1] = (void *)row_now_us();
 
 	if (rq->cmd_flags & REQ_URGENT) {
 		WARN_ON(1);
@@ -343,7 +444,19 @@ static void row_add_request(struct request_queue *q,
 		rq->cmd_flags &= ~REQ_URGENT;
 	}
 
-	if (row_queues_def[rqueue->prio].idling_enabled) {
+	/* Foreground requests never wait for background idling */
+	if (!row_is_bg_queue(rqueue->prio) &&
+	    row_is_bg_queue(rd->rd_idle_data.idling_queue_idx) &&
+	    hrtimer_active(&rd->rd_idle_data.hr_timer)) {
+		if (hrtimer_try_to_cancel(&rd->rd_idle_data.hr_timer) >= 0) {
+			row_log_rowq(rd, rqueue->prio,
+				"Canceled background idling on %d",
+				rd->rd_idle_data.idling_queue_idx);
+			rd->rd_idle_data.idling_queue_idx = ROWQ_MAX_PRIO;
+		}
+	}
+
+	if (row_queue_idling_enabled(rd, rqueue->prio)) {
 		if (rd->rd_idle_data.idling_queue_idx == rqueue->prio &&
 		    hrtimer_active(&rd->rd_idle_data.hr_timer)) {
 			if (hrtimer_try_to_cancel(
@@ -363,7 +476,7 @@ static void row_add_request(struct request_queue *q,
 			rqueue->idle_data.begin_idling = false;
 			return;
 		}
-		if (diff_ms < rd->rd_idle_data.freq_ms) {
+		if (diff_ms < row_queue_idle_freq(rd, rqueue->prio)) {
 			rqueue->idle_data.begin_idling = true;
 			row_log_rowq(rd, rqueue->prio, "Enable idling");
 		} else {
@@ -452,6 +565,17 @@ static int row_reinsert_req(struct request_queue *q,
 static void row_completed_req(struct request_queue *q, struct request *rq)
 {
 	struct row_data *rd = q->elevator->elevator_data;
+	struct row_queue *rqueue = RQ_ROWQ(rq);
+	struct row_latency_stats *st;
+	unsigned long lat_us;
+
+	if (rqueue) {
+		st = row_rq_stats(rd, rq);
+		lat_us = row_now_us() - RQ_INSERT_US(rq);
+		st->nr++;
+		st->lat_us += lat_us;
+		st->max_lat_us = max(st->max_lat_us, lat_us);
+	}
 
 	 if (rq->cmd_flags & REQ_URGENT) {
 		if (!rd->urgent_in_flight) {
@@ -522,6 +646,11 @@ static void row_remove_request(struct row_data *rd,
 static void row_dispatch_insert(struct row_data *rd, struct request *rq)
 {
 	struct row_queue *rqueue = RQ_ROWQ(rq);
+	struct row_latency_stats *st = row_rq_stats(rd, rq);
+	unsigned long wait_us = row_now_us() - RQ_INSERT_US(rq);
+
+	st->wait_us += wait_us;
+	st->max_wait_us = max(st->max_wait_us, wait_us);
 
 	row_remove_request(rd, rq);
 	elv_dispatch_sort(rd->dispatch_queue, rq);
@@ -638,13 +767,21 @@ check_idling:
 		}
 	}
 
-	if (rd->nr_reqs[READ] || rd->nr_reqs[WRITE])
+	if (rd->nr_reqs[READ] || rd->nr_reqs[WRITE]) {
 		ret = IOPRIO_CLASS_IDLE;
+		goto done;
+	}
+
+	/* Background reads only idle on an otherwise empty scheduler */
+	i = ROWQ_PRIO_BG_READ;
+	if (!force && rd->row_queues[i].idle_data.begin_idling &&
+	    row_queue_idling_enabled(rd, i))
+		goto initiate_idling;
 	goto done;
 
 initiate_idling:
 	hrtimer_start(&rd->rd_idle_data.hr_timer,
-		ktime_set(0, rd->rd_idle_data.idle_time_ms * NSEC_PER_MSEC),
+		ktime_set(0, row_queue_idle_time(rd, i) * NSEC_PER_MSEC),
 		HRTIMER_MODE_REL);
 
 	rd->rd_idle_data.idling_queue_idx = i;
@@ -815,6 +952,9 @@ static void *row_init_queue(struct request_queue *q)
 	 */
 	rdata->rd_idle_data.idle_time_ms = ROW_IDLE_TIME_MSEC;
 	rdata->rd_idle_data.freq_ms = ROW_READ_FREQ_MSEC;
+	rdata->rd_idle_data.bg_idle_time_ms = ROW_BG_IDLE_TIME_MSEC;
+	rdata->rd_idle_data.bg_freq_ms = ROW_BG_READ_FREQ_MSEC;
+	rdata->bg_weight_thresh = ROW_BG_WEIGHT_THRESH;
 	hrtimer_init(&rdata->rd_idle_data.hr_timer,
 		CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 	rdata->rd_idle_data.hr_timer.function = &row_idle_hrtimer_fn;
@@ -868,6 +1008,36 @@ static void row_merged_requests(struct request_queue *q, struct request *rq,
 	rqueue->rdata->nr_reqs[rq_data_dir(rq)]--;
 }
 
+/*
+ * row_current_is_bg() - Check if the current task is in a background
+ *			 blkio cgroup
+ * @rd:		pointer to struct row_data
+ *
+ * Called from row_set_request(), in the context of the task allocating
+ * the request. Writeback is submitted by the flusher threads, so those
+ * requests are accounted to the root group regardless of which cgroup
+ * dirtied the pages.
+ */
+static bool row_current_is_bg(struct row_data *rd)
+{
+#ifdef CONFIG_BLK_CGROUP
+	struct blkio_cgroup *blkcg;
+	bool bg;
+
+	if (!rd->bg_weight_thresh)
+		return false;
+
+	rcu_read_lock();
+	blkcg = task_blkio_cgroup(current);
+	bg = blkcg && blkcg->weight <= rd->bg_weight_thresh;
+	rcu_read_unlock();
+
+	return bg;
+#else
+	return false;
+#endif
+}
+
 /*
  * row_get_queue_prio() - Get queue priority for a given request
  *
@@ -910,6 +1080,11 @@ static enum row_queue_prio row_get_queue_prio(struct request *rq,
 	case IOPRIO_CLASS_NONE:
 	case IOPRIO_CLASS_BE:
 	default:
+		if ((data_dir == READ || is_sync) && row_current_is_bg(rd)) {
+			q_type = data_dir == READ ? ROWQ_PRIO_BG_READ :
+						    ROWQ_PRIO_BG_SWRITE;
+			break;
+		}
 		if (data_dir == READ)
 			q_type = ROWQ_PRIO_REG_READ;
 		else if (is_sync)
@@ -978,8 +1153,15 @@ SHOW_FUNCTION(row_lp_read_quantum_show,
 	rowd->row_queues[ROWQ_PRIO_LOW_READ].disp_quantum);
 SHOW_FUNCTION(row_lp_swrite_quantum_show,
 	rowd->row_queues[ROWQ_PRIO_LOW_SWRITE].disp_quantum);
+SHOW_FUNCTION(row_bg_read_quantum_show,
+	rowd->row_queues[ROWQ_PRIO_BG_READ].disp_quantum);
+SHOW_FUNCTION(row_bg_swrite_quantum_show,
+	rowd->row_queues[ROWQ_PRIO_BG_SWRITE].disp_quantum);
 SHOW_FUNCTION(row_rd_idle_data_show, rowd->rd_idle_data.idle_time_ms);
 SHOW_FUNCTION(row_rd_idle_data_freq_show, rowd->rd_idle_data.freq_ms);
+SHOW_FUNCTION(row_bg_idle_data_show, rowd->rd_idle_data.bg_idle_time_ms);
+SHOW_FUNCTION(row_bg_idle_data_freq_show, rowd->rd_idle_data.bg_freq_ms);
+SHOW_FUNCTION(row_bg_weight_thresh_show, rowd->bg_weight_thresh);
 SHOW_FUNCTION(row_reg_starv_limit_show,
 	rowd->reg_prio_starvation.starvation_limit);
 SHOW_FUNCTION(row_low_starv_limit_show,
@@ -1020,10 +1202,22 @@ STORE_FUNCTION(row_lp_read_quantum_store,
 STORE_FUNCTION(row_lp_swrite_quantum_store,
 			&rowd->row_queues[ROWQ_PRIO_LOW_SWRITE].disp_quantum,
 			1, INT_MAX);
+STORE_FUNCTION(row_bg_read_quantum_store,
+			&rowd->row_queues[ROWQ_PRIO_BG_READ].disp_quantum,
+			1, INT_MAX);
+STORE_FUNCTION(row_bg_swrite_quantum_store,
+			&rowd->row_queues[ROWQ_PRIO_BG_SWRITE].disp_quantum,
+			1, INT_MAX);
 STORE_FUNCTION(row_rd_idle_data_store, &rowd->rd_idle_data.idle_time_ms,
 			1, INT_MAX);
 STORE_FUNCTION(row_rd_idle_data_freq_store, &rowd->rd_idle_data.freq_ms,
 			1, INT_MAX);
+STORE_FUNCTION(row_bg_idle_data_store, &rowd->rd_idle_data.bg_idle_time_ms,
+			0, INT_MAX);
+STORE_FUNCTION(row_bg_idle_data_freq_store, &rowd->rd_idle_data.bg_freq_ms,
+			1, INT_MAX);
+STORE_FUNCTION(row_bg_weight_thresh_store, &rowd->bg_weight_thresh,
+			0, BLKIO_WEIGHT_MAX);
 STORE_FUNCTION(row_reg_starv_limit_store,
 			&rowd->reg_prio_starvation.starvation_limit,
 			1, INT_MAX);
@@ -1033,6 +1227,53 @@ STORE_FUNCTION(row_low_starv_limit_store,
 
 #undef STORE_FUNCTION
 
+static const char *row_class_name[ROW_CLASS_MAX] = {
+	[ROW_CLASS_FG] = "fg",
+	[ROW_CLASS_BG] = "bg",
+};
+
+static ssize_t row_class_stats_show(struct elevator_queue *e, char *page)
+{
+	struct row_data *rowd = e->elevator_data;
+	struct row_latency_stats st;
+	ssize_t len = 0;
+	int c, dir;
+
+	len += scnprintf(page + len, PAGE_SIZE - len,
+			 "class dir nr avg_wait_us max_wait_us "
+			 "avg_lat_us max_lat_us\n");
+	for (c = 0; c < ROW_CLASS_MAX; c++) {
+		for (dir = READ; dir <= WRITE; dir++) {
+			spin_lock_irq(rowd->dispatch_queue->queue_lock);
+			st = rowd->stats[c][dir];
+			spin_unlock_irq(rowd->dispatch_queue->queue_lock);
+
+			len += scnprintf(page + len, PAGE_SIZE - len,
+				"%s %s %lu %llu %lu %llu %lu\n",
+				row_class_name[c], dir == READ ? "read" : "write",
+				st.nr, st.nr ? div_u64(st.wait_us, st.nr) : 0,
+				st.max_wait_us,
+				st.nr ? div_u64(st.lat_us, st.nr) : 0,
+				st.max_lat_us);
+		}
+	}
+
+	return len;
+}
+
+/* Any write clears the statistics */
+static ssize_t row_class_stats_store(struct elevator_queue *e,
+		const char *page, size_t count)
+{
+	struct row_data *rowd = e->elevator_data;
+
+	spin_lock_irq(rowd->dispatch_queue->queue_lock);
+	memset(rowd->stats, 0, sizeof(rowd->stats));
+	spin_unlock_irq(rowd->dispatch_queue->queue_lock);
+
+	return count;
+}
+
 #define ROW_ATTR(name) \
 	__ATTR(name, S_IRUGO|S_IWUSR, row_##name##_show, \
 				      row_##name##_store)
@@ -1045,10 +1286,16 @@ static struct elv_fs_entry row_attrs[] = {
 	ROW_ATTR(rp_write_quantum),
 	ROW_ATTR(lp_read_quantum),
 	ROW_ATTR(lp_swrite_quantum),
+	ROW_ATTR(bg_read_quantum),
+	ROW_ATTR(bg_swrite_quantum),
 	ROW_ATTR(rd_idle_data),
 	ROW_ATTR(rd_idle_data_freq),
+	ROW_ATTR(bg_idle_data),
+	ROW_ATTR(bg_idle_data_freq),
+	ROW_ATTR(bg_weight_thresh),
 	ROW_ATTR(reg_starv_limit),
 	ROW_ATTR(low_starv_limit),
+	ROW_ATTR(class_stats),
 	__ATTR_NULL
 };
 
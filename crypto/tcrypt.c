@@ -33,6 +33,13 @@
 #include <linux/jiffies.h>
 #include <linux/timex.h>
 #include <linux/interrupt.h>
+#include <linux/fs.h>
+#include <linux/highmem.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
 #include "tcrypt.h"
 #include "internal.h"
 
@@ -920,6 +927,214 @@ out:
 	crypto_free_ablkcipher(tfm);
 }
 
+/*
+ * Compression speed tests run over whole pages, either read from the
+ * file named by comp_corpus or copied from the anonymous memory of
+ * comp_pid, to get numbers that look like what zram sees.
+ */
+static char *comp_corpus;
+static int comp_pid;
+static unsigned int comp_pages = 256;
+static void *comp_input;
+static unsigned int comp_npages;
+
+static int comp_load_corpus(void)
+{
+	struct file *file;
+	unsigned int i;
+	int len;
+
+	file = filp_open(comp_corpus, O_RDONLY, 0);
+	if (IS_ERR(file)) {
+		pr_err("tcrypt: cannot open %s: %ld\n", comp_corpus,
+		       PTR_ERR(file));
+		return PTR_ERR(file);
+	}
+
+	for (i = 0; i < comp_pages; i++) {
+		len = kernel_read(file, (loff_t)i * PAGE_SIZE,
+				  comp_input + i * PAGE_SIZE, PAGE_SIZE);
+		if (len != PAGE_SIZE)
+			break;
+	}
+	comp_npages = i;
+
+	fput(file);
+	return 0;
+}
+
+static int comp_load_anon(void)
+{
+	struct task_struct *task;
+	struct vm_area_struct *vma;
+	struct mm_struct *mm;
+	unsigned long addr;
+	struct page *page;
+	void *kaddr;
+
+	rcu_read_lock();
+	task = get_pid_task(find_vpid(comp_pid), PIDTYPE_PID);
+	rcu_read_unlock();
+	if (!task)
+		return -ESRCH;
+	mm = get_task_mm(task);
+	if (!mm) {
+		put_task_struct(task);
+		return -EINVAL;
+	}
+
+	down_read(&mm->mmap_sem);
+	for (vma = mm->mmap; vma && comp_npages < comp_pages;
+	     vma = vma->vm_next) {
+		if (vma->vm_file || (vma->vm_flags & (VM_IO | VM_PFNMAP)))
+			continue;
+		for (addr = vma->vm_start;
+		     addr < vma->vm_end && comp_npages < comp_pages;
+		     addr += PAGE_SIZE) {
+			if (get_user_pages(task, mm, addr, 1, 0, 1,
+					   &page, NULL) != 1)
+				continue;
+			kaddr = comp_input + comp_npages * PAGE_SIZE;
+			copy_page(kaddr, kmap(page));
+			kunmap(page);
+			put_page(page);
+			/* zram stores these without compressing them */
+			if (memchr_inv(kaddr, 0, PAGE_SIZE))
+				comp_npages++;
+		}
+	}
+	up_read(&mm->mmap_sem);
+
+	mmput(mm);
+	put_task_struct(task);
+	return 0;
+}
+
+static int comp_load_input(void)
+{
+	int ret;
+
+	if (comp_input)
+		return comp_npages ? 0 : -ENODATA;
+
+	if (!comp_corpus && !comp_pid) {
+		pr_err("tcrypt: compression speed tests need comp_corpus= or comp_pid=\n");
+		return -EINVAL;
+	}
+
+	comp_input = vmalloc(comp_pages * PAGE_SIZE);
+	if (!comp_input)
+		return -ENOMEM;
+
+	if (comp_corpus)
+		ret = comp_load_corpus();
+	else
+		ret = comp_load_anon();
+	if (ret)
+		return ret;
+
+	pr_info("tcrypt: %u pages of %s input\n", comp_npages,
+		comp_corpus ? "corpus" : "anonymous");
+	return comp_npages ? 0 : -ENODATA;
+}
+
+static void comp_free_input(void)
+{
+	vfree(comp_input);
+	comp_input = NULL;
+}
+
+static int comp_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void comp_report(const char *what, u32 *lat, u64 total_ns)
+{
+	u64 bytes = (u64)comp_npages * PAGE_SIZE;
+
+	sort(lat, comp_npages, sizeof(*lat), comp_cmp_u32, NULL);
+	pr_info("%s: %6llu MB/s, %6u ns/page median, %6u ns/page p99\n",
+		what, total_ns ? div64_u64(bytes * 1000, total_ns) : 0,
+		lat[comp_npages / 2], lat[comp_npages * 99 / 100]);
+}
+
+static void test_comp_speed(const char *algo)
+{
+	struct crypto_comp *tfm;
+	unsigned int dlen, olen, i;
+	u64 comp_ns = 0, decomp_ns = 0, comp_bytes = 0;
+	u32 *clat = NULL, *dlat = NULL;
+	u8 *dst = NULL, *out = NULL;
+	ktime_t t0, t1, t2;
+	void *src;
+	int ret;
+
+	printk(KERN_INFO "\ntesting speed of compression %s\n", algo);
+
+	if (comp_load_input())
+		return;
+
+	tfm = crypto_alloc_comp(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n",
+		       algo, PTR_ERR(tfm));
+		return;
+	}
+
+	/* room for incompressible pages, which most algorithms expand */
+	dst = kmalloc(2 * PAGE_SIZE, GFP_KERNEL);
+	out = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	clat = vmalloc(comp_npages * sizeof(*clat));
+	dlat = vmalloc(comp_npages * sizeof(*dlat));
+	if (!dst || !out || !clat || !dlat) {
+		pr_err("tcrypt: out of memory\n");
+		goto out;
+	}
+
+	for (i = 0; i < comp_npages; i++) {
+		src = comp_input + i * PAGE_SIZE;
+		dlen = 2 * PAGE_SIZE;
+		olen = PAGE_SIZE;
+
+		t0 = ktime_get();
+		ret = crypto_comp_compress(tfm, src, PAGE_SIZE, dst, &dlen);
+		t1 = ktime_get();
+		if (ret) {
+			pr_err("compression failed on page %u: %d\n", i, ret);
+			goto out;
+		}
+		ret = crypto_comp_decompress(tfm, dst, dlen, out, &olen);
+		t2 = ktime_get();
+		if (ret || olen != PAGE_SIZE || memcmp(src, out, PAGE_SIZE)) {
+			pr_err("decompression mismatch on page %u: %d\n",
+			       i, ret);
+			goto out;
+		}
+
+		clat[i] = ktime_to_ns(ktime_sub(t1, t0));
+		dlat[i] = ktime_to_ns(ktime_sub(t2, t1));
+		comp_ns += clat[i];
+		decomp_ns += dlat[i];
+		comp_bytes += dlen;
+		cond_resched();
+	}
+
+	pr_info("%u pages, compressed to %llu%% of input\n", comp_npages,
+		div64_u64(comp_bytes * 100, (u64)comp_npages * PAGE_SIZE));
+	comp_report("compress  ", clat, comp_ns);
+	comp_report("decompress", dlat, decomp_ns);
+
+out:
+	vfree(dlat);
+	vfree(clat);
+	kfree(out);
+	kfree(dst);
+	crypto_free_comp(tfm);
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -1563,6 +1778,48 @@ static int do_test(int m)
 				   speed_template_32_64);
 		break;
 
+	case 600:
+		/* fall through */
+
+	case 601:
+		test_comp_speed("lzo");
+		if (mode > 600 && mode < 700) break;
+
+	case 602:
+		test_comp_speed("lz4");
+		if (mode > 600 && mode < 700) break;
+
+	case 603:
+		test_comp_speed("lz4hc");
+		if (mode > 600 && mode < 700) break;
+
+	case 604:
+		test_comp_speed("deflate");
+		if (mode > 600 && mode < 700) break;
+
+	case 699:
+		break;
+
+	case 700:
+		/* fall through */
+
+	case 701:
+		test_ahash_speed("sha1-generic", sec, page_hash_speed_template);
+		test_ahash_speed("sha1-asm", sec, page_hash_speed_template);
+		test_ahash_speed("sha1-neon", sec, page_hash_speed_template);
+		test_ahash_speed("qcrypto-sha1", sec, page_hash_speed_template);
+		if (mode > 700 && mode < 800) break;
+
+	case 702:
+		test_ahash_speed("sha256-generic", sec,
+				 page_hash_speed_template);
+		test_ahash_speed("qcrypto-sha256", sec,
+				 page_hash_speed_template);
+		if (mode > 700 && mode < 800) break;
+
+	case 799:
+		break;
+
 	case 1000:
 		test_available();
 		break;
@@ -1609,6 +1866,7 @@ static int __init tcrypt_mod_init(void)
 		err = -EAGAIN;
 
 err_free_tv:
+	comp_free_input();
 	for (i = 0; i < TVMEMSIZE && tvmem[i]; i++)
 		free_page((unsigned long)tvmem[i]);
 
@@ -1631,6 +1889,14 @@ module_param(mode, int, 0);
 module_param(sec, uint, 0);
 MODULE_PARM_DESC(sec, "Length in seconds of speed tests "
 		      "(defaults to zero which uses CPU cycles instead)");
+module_param(comp_corpus, charp, 0);
+MODULE_PARM_DESC(comp_corpus, "File to take compression test pages from");
+module_param(comp_pid, int, 0);
+MODULE_PARM_DESC(comp_pid, "Process to take anonymous compression test "
+			   "pages from");
+module_param(comp_pages, uint, 0);
+MODULE_PARM_DESC(comp_pages, "Number of pages to run compression tests "
+			     "over (default 256)");
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Quick & dirty crypto testing module");
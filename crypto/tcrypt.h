@@ -86,6 +86,15 @@ static struct hash_speed generic_hash_speed_template[] = {
 	{  .blen = 0,	.plen = 0, }
 };
 
+/* Block sized updates as done by dm-verity and friends */
+static struct hash_speed page_hash_speed_template[] = {
+	{ .blen = 4096,	.plen = 4096, },
+	{ .blen = 16384, .plen = 4096, },
+
+	/* End marker */
+	{  .blen = 0,	.plen = 0, }
+};
+
 static struct hash_speed hash_speed_template_16[] = {
 	{ .blen = 16,	.plen = 16,	.klen = 16, },
 	{ .blen = 64,	.plen = 16,	.klen = 16, },
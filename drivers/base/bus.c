@@ -719,9 +719,13 @@ int bus_add_driver(struct device_driver *drv)
 
 	klist_add_tail(&priv->knode_bus, &bus->p->klist_drivers);
 	if (drv->bus->p->drivers_autoprobe) {
-		error = driver_attach(drv);
-		if (error)
-			goto out_unregister;
+		if (drv->async_probe) {
+			driver_attach_async(drv);
+		} else {
+			error = driver_attach(drv);
+			if (error)
+				goto out_unregister;
+		}
 	}
 	module_add_driver(drv->owner, drv);
 
@@ -771,6 +775,10 @@ void bus_remove_driver(struct device_driver *drv)
 	if (!drv->bus)
 		return;
 
+	/* don't pull the driver out from under its pending attach */
+	if (drv->async_probe)
+		wait_for_async_probe();
+
 	if (!drv->suppress_bind_attrs)
 		remove_bind_files(drv);
 	driver_remove_attrs(drv->bus, drv);
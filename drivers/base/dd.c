@@ -23,6 +23,7 @@
 #include <linux/kthread.h>
 #include <linux/wait.h>
 #include <linux/async.h>
+#include <linux/boot_timeline.h>
 #include <linux/pm_runtime.h>
 #include <linux/pinctrl/devinfo.h>
 
@@ -267,6 +268,8 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 {
 	int ret = 0;
 	int local_trigger_count = atomic_read(&deferred_trigger_count);
+	enum boot_timeline_type ev = BOOT_EV_PROBE;
+	u64 start = boot_timeline_start();
 
 	atomic_inc(&probe_count);
 	pr_debug("bus: '%s': %s: probing driver %s with device %s\n",
@@ -310,6 +313,7 @@ probe_failed:
 	if (ret == -EPROBE_DEFER) {
 		/* Driver requested deferred probing */
 		dev_info(dev, "Driver %s requests probe deferral\n", drv->name);
+		ev = BOOT_EV_PROBE_DEFER;
 		driver_deferred_probe_add(dev);
 		/* Did a trigger occur while probing? Need to re-trigger if yes */
 		if (local_trigger_count != atomic_read(&deferred_trigger_count))
@@ -329,6 +333,7 @@ probe_failed:
 	 */
 	ret = 0;
 done:
+	boot_timeline_end(ev, start, "%s %s", drv->name, dev_name(dev));
 	atomic_dec(&probe_count);
 	wake_up(&probe_waitqueue);
 	return ret;
@@ -486,6 +491,49 @@ int driver_attach(struct device_driver *drv)
 }
 EXPORT_SYMBOL_GPL(driver_attach);
 
+/*
+ * Drivers with a slow probe (firmware checks, remote processor boot) can
+ * set async_probe so that registering them only queues the walk over the
+ * bus here. The probes then overlap each other and the rest of the
+ * initcalls, and are all done again by the time wait_for_device_probe()
+ * or the freeing of init memory returns.
+ *
+ * Dependencies are handled as for synchronous drivers: a consumer that
+ * gets -EPROBE_DEFER is retried once the async driver binds. Code that
+ * needs a device without being able to defer can wait_for_async_probe().
+ */
+static LIST_HEAD(async_probe_domain);
+
+static void __driver_attach_async(void *data, async_cookie_t cookie)
+{
+	struct device_driver *drv = data;
+	int ret;
+
+	ret = driver_attach(drv);
+	if (ret)
+		printk(KERN_WARNING "bus: '%s': async attach of %s failed: %d\n",
+		       drv->bus->name, drv->name, ret);
+}
+
+void driver_attach_async(struct device_driver *drv)
+{
+	pr_debug("bus: '%s': %s: scheduling driver %s\n",
+		 drv->bus->name, __func__, drv->name);
+	async_schedule_domain(__driver_attach_async, drv, &async_probe_domain);
+}
+
+/**
+ * wait_for_async_probe - wait for the async_probe drivers to attach
+ *
+ * Returns once every attach queued by driver_attach_async() so far has
+ * finished probing.
+ */
+void wait_for_async_probe(void)
+{
+	async_synchronize_full_domain(&async_probe_domain);
+}
+EXPORT_SYMBOL_GPL(wait_for_async_probe);
+
 /*
  * __device_release_driver() must be called with @dev lock held.
  * When called for a USB interface, @dev->parent lock must be held as well.
@@ -22,6 +22,7 @@
 #include <linux/slab.h>
 #include <linux/sched.h>
 #include <linux/io.h>
+#include <linux/boot_timeline.h>
 
 #define to_dev(obj) container_of(obj, struct device, kobj)
 
@@ -101,6 +102,10 @@ struct firmware_priv {
 	int page_array_size;
 	phys_addr_t dest_addr;
 	size_t dest_size;
+	struct mutex dest_lock;
+	u8 __iomem *dest_map;
+	size_t map_start;
+	size_t map_size;
 	struct timer_list timeout;
 	struct device dev;
 	bool nowait;
@@ -164,6 +169,8 @@ static void fw_dev_release(struct device *dev)
 	for (i = 0; i < fw_priv->nr_pages; i++)
 		__free_page(fw_priv->pages[i]);
 	kfree(fw_priv->pages);
+	if (fw_priv->dest_map)
+		iounmap(fw_priv->dest_map);
 	kfree(fw_priv);
 
 	module_put(THIS_MODULE);
@@ -298,6 +305,35 @@ out:
 
 static DEVICE_ATTR(loading, 0644, firmware_loading_show, firmware_loading_store);
 
+/*
+ * Direct loads are written in PAGE_SIZE pieces, so keep a window of the
+ * destination mapped rather than paying an ioremap()/iounmap() pair (and
+ * its TLB flush) for every write.
+ */
+#define FW_DIRECT_MAP_SIZE	(1 << 20)
+
+static u8 __iomem *fw_direct_map(struct firmware_priv *fw_priv, size_t offset,
+				 size_t count)
+{
+	if (fw_priv->dest_map && offset >= fw_priv->map_start &&
+	    offset + count <= fw_priv->map_start + fw_priv->map_size)
+		return fw_priv->dest_map + (offset - fw_priv->map_start);
+
+	if (fw_priv->dest_map)
+		iounmap(fw_priv->dest_map);
+
+	fw_priv->map_start = offset & ~(FW_DIRECT_MAP_SIZE - 1);
+	fw_priv->map_size = max_t(size_t, FW_DIRECT_MAP_SIZE,
+				  offset + count - fw_priv->map_start);
+	fw_priv->map_size = min_t(size_t, fw_priv->map_size,
+				  fw_priv->dest_size - fw_priv->map_start);
+	fw_priv->dest_map = ioremap(fw_priv->dest_addr + fw_priv->map_start,
+				    fw_priv->map_size);
+	if (!fw_priv->dest_map)
+		return NULL;
+	return fw_priv->dest_map + (offset - fw_priv->map_start);
+}
+
 static int __firmware_data_rw(struct firmware_priv *fw_priv, char *buffer,
 				loff_t *offset, size_t count, int read)
 {
@@ -310,8 +346,10 @@ static int __firmware_data_rw(struct firmware_priv *fw_priv, char *buffer,
 		goto out;
 	}
 
-	fw_buf = ioremap(fw_priv->dest_addr + *offset, count);
+	mutex_lock(&fw_priv->dest_lock);
+	fw_buf = fw_direct_map(fw_priv, *offset, count);
 	if (!fw_buf) {
+		mutex_unlock(&fw_priv->dest_lock);
 		pr_debug("%s: Failed ioremap.\n", __func__);
 		retval = -ENOMEM;
 		goto out;
@@ -321,9 +359,9 @@ static int __firmware_data_rw(struct firmware_priv *fw_priv, char *buffer,
 		memcpy(buffer, fw_buf, count);
 	else
 		memcpy(fw_buf, buffer, count);
+	mutex_unlock(&fw_priv->dest_lock);
 
 	*offset += count;
-	iounmap(fw_buf);
 
 out:
 	return retval;
@@ -456,16 +494,24 @@ static ssize_t firmware_direct_write(struct file *filp, struct kobject *kobj,
 	mutex_lock(&fw_lock);
 	fw = fw_priv->fw;
 	if (!fw || test_bit(FW_STATUS_DONE, &fw_priv->status)) {
-		retval = -ENODEV;
-		goto out;
+		mutex_unlock(&fw_lock);
+		return -ENODEV;
 	}
+	mutex_unlock(&fw_lock);
 
+	/*
+	 * Copy without fw_lock, which is global: the destination belongs to
+	 * this request alone, and the request cannot complete under us as
+	 * removing this attribute waits for the write to return.
+	 */
 	retval = __firmware_data_rw(fw_priv, buffer, &offset, count, 0);
 	if (retval < 0)
-		goto out;
+		return retval;
 
-	fw->size = max_t(size_t, offset, fw->size);
-out:
+	mutex_lock(&fw_lock);
+	fw = fw_priv->fw;
+	if (fw)
+		fw->size = max_t(size_t, offset, fw->size);
 	mutex_unlock(&fw_lock);
 	return retval;
 }
@@ -565,6 +611,7 @@ fw_create_instance(struct firmware *firmware, const char *fw_name,
 	fw_priv->fw = firmware;
 	fw_priv->nowait = nowait;
 	strcpy(fw_priv->fw_id, fw_name);
+	mutex_init(&fw_priv->dest_lock);
 	init_completion(&fw_priv->completion);
 	setup_timer(&fw_priv->timeout,
 		    firmware_class_timeout, (u_long) fw_priv);
@@ -572,7 +619,8 @@ fw_create_instance(struct firmware *firmware, const char *fw_name,
 	f_dev = &fw_priv->dev;
 
 	device_initialize(f_dev);
-	dev_set_name(f_dev, "%s", dev_name(device));
+	/* by image, so one device can have several requests in flight */
+	dev_set_name(f_dev, "%s", fw_name);
 	f_dev->parent = device;
 	f_dev->class = &firmware_class;
 
@@ -682,12 +730,15 @@ __request_firmware(const struct firmware **firmware_p, const char *name,
 		   struct device *device, phys_addr_t dest_addr, size_t size)
 {
 	struct firmware_priv *fw_priv;
+	u64 start = boot_timeline_start();
 	int ret;
 
 	fw_priv = _request_firmware_prepare(firmware_p, name, device, true,
 					    false);
-	if (IS_ERR_OR_NULL(fw_priv))
-		return PTR_RET(fw_priv);
+	if (IS_ERR_OR_NULL(fw_priv)) {
+		ret = PTR_RET(fw_priv);
+		goto out;
+	}
 
 	fw_priv->dest_addr = dest_addr;
 	fw_priv->dest_size = size;
@@ -702,7 +753,8 @@ __request_firmware(const struct firmware **firmware_p, const char *name,
 	}
 	if (ret)
 		_request_firmware_cleanup(firmware_p);
-
+ out:
+	boot_timeline_end(BOOT_EV_FIRMWARE, start, "%s", name);
 	return ret;
 }
 
@@ -785,6 +837,7 @@ static void request_firmware_work_func(struct work_struct *work)
 	struct firmware_work *fw_work;
 	const struct firmware *fw;
 	struct firmware_priv *fw_priv;
+	u64 start = boot_timeline_start();
 	long timeout;
 	int ret;
 
@@ -809,6 +862,7 @@ static void request_firmware_work_func(struct work_struct *work)
 		_request_firmware_cleanup(&fw);
 
  out:
+	boot_timeline_end(BOOT_EV_FIRMWARE, start, "%s", fw_work->name);
 	fw_work->cont(fw, fw_work->context);
 
 	module_put(fw_work->module);
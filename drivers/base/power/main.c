@@ -379,7 +379,7 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 			    pm_message_t state, char *info)
 {
-	ktime_t calltime;
+	ktime_t calltime, starttime;
 	int error;
 
 	if (!cb)
@@ -388,7 +388,9 @@ static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 	calltime = initcall_debug_start(dev);
 
 	pm_dev_dbg(dev, state, info);
+	starttime = dpm_latency_start();
 	error = cb(dev);
+	dpm_latency_account(dev, state, starttime);
 	suspend_report_result(cb, error);
 
 	initcall_debug_report(dev, calltime, error);
@@ -1090,11 +1092,13 @@ static int legacy_suspend(struct device *dev, pm_message_t state,
 			  int (*cb)(struct device *dev, pm_message_t state))
 {
 	int error;
-	ktime_t calltime;
+	ktime_t calltime, starttime;
 
 	calltime = initcall_debug_start(dev);
 
+	starttime = dpm_latency_start();
 	error = cb(dev, state);
+	dpm_latency_account(dev, state, starttime);
 	suspend_report_result(cb, error);
 
 	initcall_debug_report(dev, calltime, error);
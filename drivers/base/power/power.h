@@ -1,4 +1,5 @@
 #include <linux/pm_qos.h>
+#include <linux/ktime.h>
 
 #ifdef CONFIG_PM_RUNTIME
 
@@ -32,6 +33,28 @@ extern void device_pm_move_before(struct device *, struct device *);
 extern void device_pm_move_after(struct device *, struct device *);
 extern void device_pm_move_last(struct device *);
 
+#ifdef CONFIG_PM_SLEEP_LATENCY
+
+/* drivers/base/power/sleep_latency.c */
+extern void dpm_latency_account(struct device *dev, pm_message_t state,
+				ktime_t start);
+
+static inline ktime_t dpm_latency_start(void)
+{
+	return ktime_get();
+}
+
+#else /* !CONFIG_PM_SLEEP_LATENCY */
+
+static inline void dpm_latency_account(struct device *dev,
+				       pm_message_t state, ktime_t start) {}
+static inline ktime_t dpm_latency_start(void)
+{
+	return ktime_set(0, 0);
+}
+
+#endif /* !CONFIG_PM_SLEEP_LATENCY */
+
 #else /* !CONFIG_PM_SLEEP */
 
 static inline void device_pm_init(struct device *dev)
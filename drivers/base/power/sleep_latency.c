@@ -0,0 +1,108 @@
+/*
+ * drivers/base/power/sleep_latency.c - per-device suspend/resume latency
+ *
+ * This file is released under the GPLv2.
+ *
+ * Every suspend (suspend, suspend_late, suspend_noirq) and resume
+ * (resume_noirq, resume_early, resume) callback run by the PM core is
+ * timed and added to a log4 histogram kept in the device itself, so
+ * the numbers survive for as long as the device does and cost nothing
+ * to look up. /sys/kernel/debug/dpm_latency lists every device that has
+ * been timed; writing to it clears the histograms.
+ */
+
+#include <linux/device.h>
+#include <linux/debugfs.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
+
+#include "power.h"
+
+#define DPM_RESUME_EVENTS	(PM_EVENT_RESUME | PM_EVENT_THAW | \
+				 PM_EVENT_RESTORE | PM_EVENT_RECOVER)
+
+/* buckets end at 16us, 64us, ... 64ms; the last one is open */
+static int dpm_latency_bucket(u32 us)
+{
+	int b = (fls(us) - 3) / 2;
+
+	return clamp(b, 0, DPM_LATENCY_BUCKETS - 1);
+}
+
+void dpm_latency_account(struct device *dev, pm_message_t state,
+			 ktime_t start)
+{
+	struct dev_pm_latency *lat;
+	s64 us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+	lat = &dev->power.latency[!!(state.event & DPM_RESUME_EVENTS)];
+	us = min_t(s64, us, U32_MAX);
+	lat->count++;
+	lat->max_us = max_t(u32, lat->max_us, us);
+	lat->hist[dpm_latency_bucket(us)]++;
+}
+
+static const char * const dpm_latency_dir[] = { "suspend", "resume" };
+
+static int dpm_latency_show(struct seq_file *s, void *unused)
+{
+	struct dev_pm_latency *lat;
+	struct device *dev;
+	int dir, i;
+
+	seq_puts(s, "# device dir count max_us <16us <64us <256us <1ms <4ms <16ms <64ms more\n");
+
+	device_pm_lock();
+	list_for_each_entry(dev, &dpm_list, power.entry) {
+		for (dir = 0; dir < 2; dir++) {
+			lat = &dev->power.latency[dir];
+			if (!lat->count)
+				continue;
+			seq_printf(s, "%s %s %u %u", dev_name(dev),
+				   dpm_latency_dir[dir], lat->count,
+				   lat->max_us);
+			for (i = 0; i < DPM_LATENCY_BUCKETS; i++)
+				seq_printf(s, " %u", lat->hist[i]);
+			seq_putc(s, '\n');
+		}
+	}
+	device_pm_unlock();
+
+	return 0;
+}
+
+static int dpm_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dpm_latency_show, NULL);
+}
+
+static ssize_t dpm_latency_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct device *dev;
+
+	device_pm_lock();
+	list_for_each_entry(dev, &dpm_list, power.entry)
+		memset(dev->power.latency, 0, sizeof(dev->power.latency));
+	device_pm_unlock();
+
+	return count;
+}
+
+static const struct file_operations dpm_latency_fops = {
+	.open		= dpm_latency_open,
+	.read		= seq_read,
+	.write		= dpm_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init dpm_latency_init(void)
+{
+	debugfs_create_file("dpm_latency", S_IRUSR | S_IWUSR, NULL, NULL,
+			    &dpm_latency_fops);
+	return 0;
+}
+late_initcall(dpm_latency_init);
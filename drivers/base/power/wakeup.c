@@ -16,6 +16,7 @@
 #include <linux/suspend.h>
 #include <linux/seq_file.h>
 #include <linux/debugfs.h>
+#include <linux/sort.h>
 #include <trace/events/power.h>
 
 #include "power.h"
@@ -55,6 +56,20 @@ static LIST_HEAD(wakeup_sources);
 
 static DECLARE_WAIT_QUEUE_HEAD(wakeup_count_wait_queue);
 
+/*
+ * Active wakeup sources, for the exclusive time accounting.  While exactly one
+ * source is active it is the head of the list and gets credited with the time
+ * since exclusive_since once another source is activated or it is released.
+ * Nests inside ws->lock.
+ */
+static LIST_HEAD(active_wakeup_sources);
+static unsigned int nr_active_wakeup_sources;
+static ktime_t exclusive_since;
+static DEFINE_SPINLOCK(exclusive_lock);
+
+/* Holds longer than this trigger the wakeup_source_long_hold event. */
+static u32 long_hold_ms = 1000;
+
 /**
  * wakeup_source_prepare - Prepare a new wakeup source for initialization.
  * @ws: Wakeup source to prepare.
@@ -368,6 +383,59 @@ EXPORT_SYMBOL_GPL(device_set_wakeup_enable);
  * function executed when the timer expires, whichever comes first.
  */
 
+static void credit_exclusive_time(ktime_t now)
+{
+	struct wakeup_source *sole;
+
+	sole = list_first_entry(&active_wakeup_sources, struct wakeup_source,
+				active_entry);
+	sole->exclusive_time = ktime_add(sole->exclusive_time,
+					 ktime_sub(now, exclusive_since));
+}
+
+/**
+ * exclusive_time_start - Account for @ws becoming active.
+ * @ws: Wakeup source being activated.
+ * @now: Time of the activation.
+ *
+ * If one other source was active, it stops being the only one now.
+ */
+static void exclusive_time_start(struct wakeup_source *ws, ktime_t now)
+{
+	spin_lock(&exclusive_lock);
+	if (nr_active_wakeup_sources == 1)
+		credit_exclusive_time(now);
+	ws->start_exclusive_time = ws->exclusive_time;
+	list_add_tail(&ws->active_entry, &active_wakeup_sources);
+	if (++nr_active_wakeup_sources == 1)
+		exclusive_since = now;
+	spin_unlock(&exclusive_lock);
+}
+
+/**
+ * exclusive_time_stop - Account for @ws becoming inactive.
+ * @ws: Wakeup source being deactivated.
+ * @now: Time of the deactivation.
+ *
+ * Credit @ws if it was the only active source, or start the clock for the one
+ * left active.  Return the exclusive time of the hold that has just ended.
+ */
+static ktime_t exclusive_time_stop(struct wakeup_source *ws, ktime_t now)
+{
+	ktime_t held;
+
+	spin_lock(&exclusive_lock);
+	if (nr_active_wakeup_sources == 1)
+		credit_exclusive_time(now);
+	list_del(&ws->active_entry);
+	if (--nr_active_wakeup_sources == 1)
+		exclusive_since = now;
+	held = ktime_sub(ws->exclusive_time, ws->start_exclusive_time);
+	spin_unlock(&exclusive_lock);
+
+	return held;
+}
+
 /**
  * wakup_source_activate - Mark given wakeup source as active.
  * @ws: Wakeup source to handle.
@@ -385,6 +453,7 @@ static void wakeup_source_activate(struct wakeup_source *ws)
 	ws->last_time = ktime_get();
 	if (ws->autosleep_enabled)
 		ws->start_prevent_time = ws->last_time;
+	exclusive_time_start(ws, ws->last_time);
 
 	/* Increment the counter of events in progress. */
 	cec = atomic_inc_return(&combined_event_count);
@@ -477,6 +546,7 @@ static void wakeup_source_deactivate(struct wakeup_source *ws)
 {
 	unsigned int cnt, inpr, cec;
 	ktime_t duration;
+	ktime_t exclusive;
 	ktime_t now;
 
 	ws->relax_count++;
@@ -509,6 +579,11 @@ static void wakeup_source_deactivate(struct wakeup_source *ws)
 	if (ws->autosleep_enabled)
 		update_prevent_sleep_time(ws, now);
 
+	exclusive = exclusive_time_stop(ws, now);
+	if (ktime_to_ms(duration) > long_hold_ms)
+		trace_wakeup_source_long_hold(ws->name, ktime_to_ms(duration),
+					      ktime_to_ms(exclusive));
+
 	/*
 	 * Increment the counter of registered wakeup events and decrement the
 	 * couter of wakeup events in progress simultaneously.
@@ -918,10 +993,108 @@ static const struct file_operations wakeup_sources_stats_fops = {
 	.release = single_release,
 };
 
+struct exclusive_stat {
+	struct wakeup_source	*ws;
+	s64			exclusive_ms;
+};
+
+static int exclusive_stat_cmp(const void *a, const void *b)
+{
+	const struct exclusive_stat *x = a, *y = b;
+
+	if (x->exclusive_ms == y->exclusive_ms)
+		return 0;
+	return x->exclusive_ms < y->exclusive_ms ? 1 : -1;
+}
+
+/**
+ * wakeup_sources_exclusive_show - Print wakeup sources by exclusive time.
+ * @m: seq_file to print the table into.
+ *
+ * The sources that kept the system awake on their own come first; the rest
+ * of each source's total time overlapped with some other source.
+ */
+static int wakeup_sources_exclusive_show(struct seq_file *m, void *unused)
+{
+	struct exclusive_stat *stats;
+	struct wakeup_source *ws;
+	unsigned long flags;
+	unsigned int n = 0, i;
+	ktime_t now;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry)
+		n++;
+
+	stats = kcalloc(n, sizeof(*stats), GFP_ATOMIC);
+	if (!stats) {
+		rcu_read_unlock();
+		return -ENOMEM;
+	}
+
+	i = 0;
+	spin_lock_irqsave(&exclusive_lock, flags);
+	now = ktime_get();
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
+		ktime_t exclusive = ws->exclusive_time;
+
+		if (i == n)
+			break;
+		if (nr_active_wakeup_sources == 1 &&
+		    ws == list_first_entry(&active_wakeup_sources,
+					   struct wakeup_source, active_entry))
+			exclusive = ktime_add(exclusive,
+					      ktime_sub(now, exclusive_since));
+		stats[i].ws = ws;
+		stats[i++].exclusive_ms = ktime_to_ms(exclusive);
+	}
+	spin_unlock_irqrestore(&exclusive_lock, flags);
+
+	sort(stats, i, sizeof(*stats), exclusive_stat_cmp, NULL);
+
+	seq_puts(m, "name\t\texclusive_time\ttotal_time\n");
+	for (n = 0; n < i; n++) {
+		ktime_t total_time;
+
+		ws = stats[n].ws;
+		spin_lock_irqsave(&ws->lock, flags);
+		total_time = ws->total_time;
+		if (ws->active)
+			total_time = ktime_add(total_time,
+					ktime_sub(ktime_get(), ws->last_time));
+		spin_unlock_irqrestore(&ws->lock, flags);
+
+		seq_printf(m, "%-12s\t%lld\t\t%lld\n", ws->name,
+			   stats[n].exclusive_ms, ktime_to_ms(total_time));
+	}
+	rcu_read_unlock();
+
+	kfree(stats);
+	return 0;
+}
+
+static int wakeup_sources_exclusive_open(struct inode *inode,
+					 struct file *file)
+{
+	return single_open(file, wakeup_sources_exclusive_show, NULL);
+}
+
+static const struct file_operations wakeup_sources_exclusive_fops = {
+	.owner = THIS_MODULE,
+	.open = wakeup_sources_exclusive_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int __init wakeup_sources_debugfs_init(void)
 {
 	wakeup_sources_stats_dentry = debugfs_create_file("wakeup_sources",
 			S_IRUGO, NULL, NULL, &wakeup_sources_stats_fops);
+	debugfs_create_file("wakeup_sources_exclusive", S_IRUGO, NULL, NULL,
+			    &wakeup_sources_exclusive_fops);
+	debugfs_create_u32("wakeup_long_hold_ms", S_IRUGO | S_IWUSR, NULL,
+			   &long_hold_ms);
 	return 0;
 }
 
@@ -19,6 +19,9 @@
 #ifdef CONFIG_ZRAM_LZ4_COMPRESS
 #include "zcomp_lz4.h"
 #endif
+#ifdef CONFIG_ZRAM_LZ4HC_COMPRESS
+#include "zcomp_lz4hc.h"
+#endif
 
 /*
  * single zcomp_strm backend
@@ -47,6 +50,9 @@ static struct zcomp_backend *backends[] = {
 	&zcomp_lzo,
 #ifdef CONFIG_ZRAM_LZ4_COMPRESS
 	&zcomp_lz4,
+#endif
+#ifdef CONFIG_ZRAM_LZ4HC_COMPRESS
+	&zcomp_lz4hc,
 #endif
 	NULL
 };
@@ -0,0 +1,160 @@
+/*
+ * Compressed RAM block device - page deduplication
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/jhash.h>
+
+#include "zram_drv.h"
+
+u32 zram_dedup_checksum(unsigned char *mem)
+{
+	return jhash2((u32 *)mem, PAGE_SIZE / sizeof(u32), 0);
+}
+
+/*
+ * Compare @mem with the data of @entry. @buf is scratch space of at least
+ * PAGE_SIZE bytes used to decompress the stored object. Needs dedup_lock.
+ */
+static bool zram_dedup_match(struct zram *zram, struct zram_dedup_entry *entry,
+			     unsigned char *mem, unsigned char *buf)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned char *cmem;
+	bool match = false;
+
+	cmem = zs_map_object(meta->mem_pool, entry->handle, ZS_MM_RO);
+	if (entry->len == PAGE_SIZE)
+		match = !memcmp(mem, cmem, PAGE_SIZE);
+	else if (!zcomp_decompress(entry->alt ? zram->comp_alt : zram->comp,
+				   cmem, entry->len, buf))
+		match = !memcmp(mem, buf, PAGE_SIZE);
+	zs_unmap_object(meta->mem_pool, entry->handle);
+
+	return match;
+}
+
+/*
+ * Look for an object with the same contents as the page at @mem. On a hit
+ * the entry's refcount is raised and the entry returned.
+ */
+struct zram_dedup_entry *zram_dedup_find(struct zram *zram,
+		unsigned char *mem, u32 checksum, unsigned char *buf)
+{
+	struct zram_meta *meta = zram->meta;
+	struct zram_dedup_entry *entry;
+	struct rb_node *node, *prev;
+
+	spin_lock(&meta->dedup_lock);
+	node = meta->dedup_root.rb_node;
+	while (node) {
+		entry = rb_entry(node, struct zram_dedup_entry, rb_node);
+		if (checksum == entry->checksum)
+			break;
+		node = checksum < entry->checksum ?
+			node->rb_left : node->rb_right;
+	}
+
+	if (!node)
+		goto miss;
+
+	/* Entries with equal checksums are adjacent, start at the first */
+	for (prev = rb_prev(node); prev; prev = rb_prev(prev)) {
+		entry = rb_entry(prev, struct zram_dedup_entry, rb_node);
+		if (entry->checksum != checksum)
+			break;
+		node = prev;
+	}
+
+	for (; node; node = rb_next(node)) {
+		entry = rb_entry(node, struct zram_dedup_entry, rb_node);
+		if (entry->checksum != checksum)
+			break;
+
+		if (zram_dedup_match(zram, entry, mem, buf)) {
+			entry->refcount++;
+			spin_unlock(&meta->dedup_lock);
+
+			atomic64_inc(&zram->stats.dedup_hits);
+			atomic64_add(entry->len, &zram->stats.dup_data_size);
+			return entry;
+		}
+	}
+
+miss:
+	spin_unlock(&meta->dedup_lock);
+	atomic64_inc(&zram->stats.dedup_misses);
+	return NULL;
+}
+
+/*
+ * Make the freshly stored object @handle available for sharing. Returns
+ * NULL if no entry could be allocated; the object is then simply private
+ * to its slot.
+ */
+struct zram_dedup_entry *zram_dedup_insert(struct zram *zram, u32 checksum,
+		unsigned long handle, size_t len, bool alt)
+{
+	struct zram_meta *meta = zram->meta;
+	struct zram_dedup_entry *entry, *cur;
+	struct rb_node **link, *parent = NULL;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return NULL;
+
+	entry->checksum = checksum;
+	entry->len = len;
+	entry->alt = alt;
+	entry->refcount = 1;
+	entry->handle = handle;
+
+	spin_lock(&meta->dedup_lock);
+	link = &meta->dedup_root.rb_node;
+	while (*link) {
+		parent = *link;
+		cur = rb_entry(parent, struct zram_dedup_entry, rb_node);
+		if (checksum < cur->checksum)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&entry->rb_node, parent, link);
+	rb_insert_color(&entry->rb_node, &meta->dedup_root);
+	spin_unlock(&meta->dedup_lock);
+
+	return entry;
+}
+
+/* Drop one reference, freeing the object along with the last one */
+void zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry)
+{
+	struct zram_meta *meta = zram->meta;
+
+	spin_lock(&meta->dedup_lock);
+	if (--entry->refcount) {
+		spin_unlock(&meta->dedup_lock);
+		atomic64_sub(entry->len, &zram->stats.dup_data_size);
+		return;
+	}
+	rb_erase(&entry->rb_node, &meta->dedup_root);
+	spin_unlock(&meta->dedup_lock);
+
+	zs_free(meta->mem_pool, entry->handle);
+	kfree(entry);
+}
+
+void zram_dedup_init(struct zram_meta *meta)
+{
+	meta->dedup_root = RB_ROOT;
+	spin_lock_init(&meta->dedup_lock);
+}
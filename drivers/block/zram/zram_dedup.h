@@ -0,0 +1,63 @@
+/*
+ * Compressed RAM block device - page deduplication
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ */
+
+#ifndef _ZRAM_DEDUP_H_
+#define _ZRAM_DEDUP_H_
+
+#include <linux/rbtree.h>
+
+struct zram;
+struct zram_meta;
+
+/*
+ * A compressed object that may be shared by several zram slots holding
+ * identical pages. Entries live in the per-device zram_meta->dedup_root
+ * rbtree, sorted by checksum of the uncompressed page.
+ */
+struct zram_dedup_entry {
+	struct rb_node rb_node;
+	u32 checksum;
+	u32 len;
+	bool alt;	/* compressed by zram->comp_alt */
+	/* protected by zram_meta->dedup_lock */
+	unsigned long refcount;
+	unsigned long handle;
+};
+
+#ifdef CONFIG_ZRAM_DEDUP
+u32 zram_dedup_checksum(unsigned char *mem);
+struct zram_dedup_entry *zram_dedup_find(struct zram *zram,
+		unsigned char *mem, u32 checksum, unsigned char *buf);
+struct zram_dedup_entry *zram_dedup_insert(struct zram *zram, u32 checksum,
+		unsigned long handle, size_t len, bool alt);
+void zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry);
+void zram_dedup_init(struct zram_meta *meta);
+#else
+static inline u32 zram_dedup_checksum(unsigned char *mem) { return 0; }
+
+static inline struct zram_dedup_entry *zram_dedup_find(struct zram *zram,
+		unsigned char *mem, u32 checksum, unsigned char *buf)
+{
+	return NULL;
+}
+
+static inline struct zram_dedup_entry *zram_dedup_insert(struct zram *zram,
+		u32 checksum, unsigned long handle, size_t len, bool alt)
+{
+	return NULL;
+}
+
+static inline void zram_dedup_put(struct zram *zram,
+		struct zram_dedup_entry *entry) {}
+static inline void zram_dedup_init(struct zram_meta *meta) {}
+#endif
+
+#endif /* _ZRAM_DEDUP_H_ */
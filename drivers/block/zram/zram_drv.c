@@ -32,6 +32,10 @@
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 #include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/workqueue.h>
+#include <linux/cpumask.h>
 
 #include "zram_drv.h"
 
@@ -48,6 +52,25 @@ static const char *default_compressor = "lzo";
 /* Module params (documentation at end) */
 static unsigned int num_devices = 1;
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* Default age, in seconds, after which an untouched slot is idle */
+#define ZRAM_DEFAULT_IDLE_AGE	3600
+#endif
+
+#ifdef CONFIG_ZRAM_ASYNC_WRITE
+static struct workqueue_struct *zram_wq;
+static struct kmem_cache *zram_work_cache;
+static int zram_next_cpu;
+
+/* Wait for queued pages before the device metadata goes away */
+static void zram_async_flush(void)
+{
+	flush_workqueue(zram_wq);
+}
+#else
+static inline void zram_async_flush(void) {}
+#endif
+
 #define ZRAM_ATTR_RO(name)						\
 static ssize_t zram_attr_##name##_show(struct device *d,		\
 				struct device_attribute *attr, char *b)	\
@@ -114,6 +137,39 @@ static ssize_t mem_used_total_show(struct device *dev,
 	return scnprintf(buf, PAGE_SIZE, "%llu\n", val);
 }
 
+static ssize_t compact_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	meta = zram->meta;
+	zs_compact(meta->mem_pool);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t pages_compacted_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zs_pool_stats pool_stats = { 0 };
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	if (init_done(zram))
+		zs_pool_stats(zram->meta->mem_pool, &pool_stats);
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%lu\n", pool_stats.pages_compacted);
+}
+
 static ssize_t max_comp_streams_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -147,6 +203,8 @@ static ssize_t max_comp_streams_store(struct device *dev,
 			ret = -EINVAL;
 			goto out;
 		}
+		if (zram->comp_alt)
+			zcomp_set_max_streams(zram->comp_alt, num);
 	}
 
 	zram->max_comp_streams = num;
@@ -184,6 +242,64 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
+static ssize_t recomp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->recomp_algorithm, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+	/* "none" turns recompression off */
+	if (sysfs_streq(buf, "none"))
+		zram->recomp_algorithm[0] = '\0';
+	else
+		strlcpy(zram->recomp_algorithm, buf,
+			sizeof(zram->recomp_algorithm));
+	up_write(&zram->init_lock);
+	return len;
+}
+
+static ssize_t recomp_threshold_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%zu\n", zram->recomp_threshold);
+}
+
+static ssize_t recomp_threshold_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul(buf, 10, &val);
+	if (ret)
+		return ret;
+	if (val >= PAGE_SIZE)
+		return -EINVAL;
+
+	zram->recomp_threshold = val;
+	return len;
+}
+
 /* flag operations needs meta->tb_lock */
 static int zram_test_flag(struct zram_meta *meta, u32 index,
 			enum zram_pageflags flag)
@@ -197,30 +313,676 @@ static void zram_set_flag(struct zram_meta *meta, u32 index,
 	meta->table[index].value |= BIT(flag);
 }
 
-static void zram_clear_flag(struct zram_meta *meta, u32 index,
-			enum zram_pageflags flag)
+static void zram_clear_flag(struct zram_meta *meta, u32 index,
+			enum zram_pageflags flag)
+{
+	meta->table[index].value &= ~BIT(flag);
+}
+
+static size_t zram_get_obj_size(struct zram_meta *meta, u32 index)
+{
+	return meta->table[index].value & (BIT(ZRAM_FLAG_SHIFT) - 1);
+}
+
+static void zram_set_obj_size(struct zram_meta *meta,
+					u32 index, size_t size)
+{
+	unsigned long flags = meta->table[index].value >> ZRAM_FLAG_SHIFT;
+
+	meta->table[index].value = (flags << ZRAM_FLAG_SHIFT) | size;
+}
+
+static inline int is_partial_io(struct bio_vec *bvec)
+{
+	return bvec->bv_len != PAGE_SIZE;
+}
+
+#ifdef CONFIG_ZRAM_DEDUP
+static inline bool zram_dedup_enabled(struct zram *zram)
+{
+	return zram->use_dedup;
+}
+
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (kstrtoint(buf, 10, &val) || (val != 0 && val != 1))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+	return len;
+}
+
+/* needs meta->tb_lock */
+static inline void zram_set_dedup(struct zram_meta *meta, u32 index,
+				  struct zram_dedup_entry *entry)
+{
+	meta->table[index].dedup = entry;
+}
+#else
+static inline bool zram_dedup_enabled(struct zram *zram)
+{
+	return false;
+}
+
+static inline void zram_set_dedup(struct zram_meta *meta, u32 index,
+				  struct zram_dedup_entry *entry) {}
+#endif
+
+/*
+ * Release the zsmalloc object of a slot, which may be shared with other
+ * slots when deduplication is in use. Needs meta->tb_lock.
+ */
+static void zram_free_handle(struct zram *zram, u32 index)
+{
+	struct zram_meta *meta = zram->meta;
+
+#ifdef CONFIG_ZRAM_DEDUP
+	if (meta->table[index].dedup) {
+		zram_dedup_put(zram, meta->table[index].dedup);
+		meta->table[index].dedup = NULL;
+		return;
+	}
+#endif
+	zs_free(meta->mem_pool, meta->table[index].handle);
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* needs meta->tb_lock */
+static inline void zram_update_ac_time(struct zram_meta *meta, u32 index)
+{
+	meta->table[index].ac_time = jiffies;
+}
+
+static void reset_bdev(struct zram *zram)
+{
+	struct block_device *bdev;
+
+	if (!zram->backing_dev)
+		return;
+
+	bdev = zram->bdev;
+	/* hope filp_close flush all of IO */
+	set_blocksize(bdev, zram->old_block_size);
+	blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	filp_close(zram->backing_dev, NULL);
+	zram->backing_dev = NULL;
+	zram->old_block_size = 0;
+	zram->bdev = NULL;
+
+	vfree(zram->bitmap);
+	zram->bitmap = NULL;
+	zram->nr_pages = 0;
+}
+
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char *p;
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	if (!zram->backing_dev) {
+		up_read(&zram->init_lock);
+		return scnprintf(buf, PAGE_SIZE, "none\n");
+	}
+
+	p = d_path(&zram->backing_dev->f_path, buf, PAGE_SIZE - 1);
+	if (IS_ERR(p)) {
+		ret = PTR_ERR(p);
+		goto out;
+	}
+
+	ret = strlen(p);
+	memmove(buf, p, ret);
+	buf[ret++] = '\n';
+out:
+	up_read(&zram->init_lock);
+	return ret;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	char *file_name;
+	size_t sz;
+	struct file *backing_dev = NULL;
+	struct inode *inode;
+	struct block_device *bdev = NULL;
+	unsigned long nr_pages, *bitmap = NULL;
+	unsigned int old_block_size;
+	struct zram *zram = dev_to_zram(dev);
+	int err;
+
+	file_name = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!file_name)
+		return -ENOMEM;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		pr_info("Can't setup backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	strlcpy(file_name, buf, PATH_MAX);
+	/* ignore trailing newline */
+	sz = strlen(file_name);
+	if (sz > 0 && file_name[sz - 1] == '\n')
+		file_name[sz - 1] = 0x00;
+
+	backing_dev = filp_open(file_name, O_RDWR | O_LARGEFILE, 0);
+	if (IS_ERR(backing_dev)) {
+		err = PTR_ERR(backing_dev);
+		backing_dev = NULL;
+		goto out;
+	}
+
+	inode = backing_dev->f_mapping->host;
+
+	/* Support only block device in this moment */
+	if (!S_ISBLK(inode->i_mode)) {
+		err = -ENOTBLK;
+		goto out;
+	}
+
+	bdev = bdgrab(I_BDEV(inode));
+	err = blkdev_get(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (err < 0) {
+		bdev = NULL;
+		goto out;
+	}
+
+	nr_pages = i_size_read(inode) >> PAGE_SHIFT;
+	bitmap = vzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long));
+	if (!bitmap) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	old_block_size = block_size(bdev);
+	err = set_blocksize(bdev, PAGE_SIZE);
+	if (err)
+		goto out;
+
+	reset_bdev(zram);
+
+	zram->old_block_size = old_block_size;
+	zram->bdev = bdev;
+	zram->backing_dev = backing_dev;
+	zram->bitmap = bitmap;
+	zram->nr_pages = nr_pages;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", file_name);
+	kfree(file_name);
+
+	return len;
+out:
+	vfree(bitmap);
+
+	if (bdev)
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+
+	if (backing_dev)
+		filp_close(backing_dev, NULL);
+
+	up_write(&zram->init_lock);
+
+	kfree(file_name);
+
+	return err;
+}
+
+/*
+ * Block 0 of the backing device is never handed out, so a slot's handle
+ * is non-zero for every page that has been written back.
+ */
+static unsigned long alloc_block_bdev(struct zram *zram)
+{
+	unsigned long blk_idx = 1;
+retry:
+	blk_idx = find_next_zero_bit(zram->bitmap, zram->nr_pages, blk_idx);
+	if (blk_idx >= zram->nr_pages)
+		return 0;
+
+	if (test_and_set_bit(blk_idx, zram->bitmap))
+		goto retry;
+
+	return blk_idx;
+}
+
+static void free_block_bdev(struct zram *zram, unsigned long blk_idx)
+{
+	int was_set;
+
+	was_set = test_and_clear_bit(blk_idx, zram->bitmap);
+	WARN_ON_ONCE(!was_set);
+}
+
+static void zram_bdev_end_io(struct bio *bio, int err)
+{
+	complete(bio->bi_private);
+}
+
+/*
+ * Synchronously transfer one page between @page and block @entry of the
+ * backing device. Must not be called from zram_make_request(), see
+ * zram_bdev_read_page().
+ */
+static int zram_bdev_rw_page(struct zram *zram, struct page *page,
+			     unsigned long entry, int rw)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct bio *bio;
+	int ret = 0;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_sector = entry * SECTORS_PER_PAGE;
+	bio->bi_bdev = zram->bdev;
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	bio->bi_end_io = zram_bdev_end_io;
+	bio->bi_private = &done;
+	submit_bio(rw == READ ? READ_SYNC : WRITE_SYNC, bio);
+	wait_for_completion(&done);
+
+	if (!test_bit(BIO_UPTODATE, &bio->bi_flags))
+		ret = -EIO;
+	bio_put(bio);
+
+	if (rw == READ)
+		atomic64_inc(&zram->stats.bd_reads);
+	else
+		atomic64_inc(&zram->stats.bd_writes);
+
+	return ret;
+}
+
+struct zram_read_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct page *page;
+	unsigned long entry;
+	int ret;
+};
+
+static void zram_sync_read(struct work_struct *work)
+{
+	struct zram_read_work *rw;
+
+	rw = container_of(work, struct zram_read_work, work);
+	rw->ret = zram_bdev_rw_page(rw->zram, rw->page, rw->entry, READ);
+}
+
+/*
+ * Reads come in from zram_make_request(), where generic_make_request()
+ * only queues a nested bio on current->bio_list until we return, so
+ * waiting for it there would never finish. Submit and wait from a worker
+ * instead.
+ */
+static int zram_bdev_read_page(struct zram *zram, struct page *page,
+			       unsigned long entry)
+{
+	struct zram_read_work rw = {
+		.zram = zram,
+		.page = page,
+		.entry = entry,
+	};
+
+	INIT_WORK_ONSTACK(&rw.work, zram_sync_read);
+	queue_work(system_unbound_wq, &rw.work);
+	flush_work(&rw.work);
+	destroy_work_on_stack(&rw.work);
+
+	return rw.ret;
+}
+
+/* Read backing device block @entry into the kernel buffer @mem */
+static int read_from_bdev_to_buf(struct zram *zram, char *mem,
+				 unsigned long entry)
+{
+	struct page *page;
+	void *src;
+	int ret;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = zram_bdev_read_page(zram, page, entry);
+	if (!ret) {
+		src = kmap_atomic(page);
+		copy_page(mem, src);
+		kunmap_atomic(src);
+	}
+
+	__free_page(page);
+	return ret;
+}
+
+static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
+			  unsigned long entry, int offset)
+{
+	struct page *page;
+	void *src, *dst;
+	int ret;
+
+	/* Full pages are read straight into the caller's page */
+	if (!is_partial_io(bvec)) {
+		ret = zram_bdev_read_page(zram, bvec->bv_page, entry);
+		if (!ret)
+			flush_dcache_page(bvec->bv_page);
+		return ret;
+	}
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = zram_bdev_read_page(zram, page, entry);
+	if (!ret) {
+		src = kmap_atomic(page);
+		dst = kmap_atomic(bvec->bv_page);
+		memcpy(dst + bvec->bv_offset, src + offset, bvec->bv_len);
+		kunmap_atomic(dst);
+		kunmap_atomic(src);
+		flush_dcache_page(bvec->bv_page);
+	}
+
+	__free_page(page);
+	return ret;
+}
+
+static ssize_t idle_age_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", zram->idle_age);
+}
+
+static ssize_t idle_age_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	zram->idle_age = val;
+	return len;
+}
+
+static ssize_t writeback_limit_enable_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	spin_lock(&zram->wb_limit_lock);
+	val = zram->wb_limit_enable;
+	spin_unlock(&zram->wb_limit_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", val);
+}
+
+static ssize_t writeback_limit_enable_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	u64 val;
+	int ret;
+
+	ret = kstrtoull(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	spin_lock(&zram->wb_limit_lock);
+	zram->wb_limit_enable = val;
+	spin_unlock(&zram->wb_limit_lock);
+
+	return len;
+}
+
+static ssize_t writeback_limit_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	u64 val;
+	struct zram *zram = dev_to_zram(dev);
+
+	spin_lock(&zram->wb_limit_lock);
+	val = zram->bd_wb_limit;
+	spin_unlock(&zram->wb_limit_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%llu\n", val);
+}
+
+static ssize_t writeback_limit_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	u64 val;
+	int ret;
+
+	ret = kstrtoull(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	spin_lock(&zram->wb_limit_lock);
+	zram->bd_wb_limit = val;
+	spin_unlock(&zram->wb_limit_lock);
+
+	return len;
+}
+
+/*
+ * Returns true if one more page may be written back. When the limit is
+ * enabled this also consumes one page of the budget.
+ */
+static bool zram_wb_budget_get(struct zram *zram)
+{
+	bool ret = true;
+
+	spin_lock(&zram->wb_limit_lock);
+	if (zram->wb_limit_enable) {
+		if (zram->bd_wb_limit)
+			zram->bd_wb_limit--;
+		else
+			ret = false;
+	}
+	spin_unlock(&zram->wb_limit_lock);
+
+	return ret;
+}
+
+static void zram_wb_budget_put(struct zram *zram)
 {
-	meta->table[index].value &= ~BIT(flag);
+	spin_lock(&zram->wb_limit_lock);
+	if (zram->wb_limit_enable)
+		zram->bd_wb_limit++;
+	spin_unlock(&zram->wb_limit_lock);
 }
 
-static size_t zram_get_obj_size(struct zram_meta *meta, u32 index)
+/* needs meta->tb_lock */
+static bool zram_wb_candidate(struct zram *zram, u32 index, bool huge_only)
 {
-	return meta->table[index].value & (BIT(ZRAM_FLAG_SHIFT) - 1);
+	struct zram_meta *meta = zram->meta;
+
+	if (zram_test_flag(meta, index, ZRAM_SAME) ||
+	    !meta->table[index].handle ||
+	    zram_test_flag(meta, index, ZRAM_WB) ||
+	    zram_test_flag(meta, index, ZRAM_UNDER_WB))
+		return false;
+
+	if (huge_only)
+		return zram_test_flag(meta, index, ZRAM_HUGE);
+
+	return time_after_eq(jiffies, meta->table[index].ac_time +
+			(unsigned long)zram->idle_age * HZ);
 }
 
-static void zram_set_obj_size(struct zram_meta *meta,
-					u32 index, size_t size)
+static int zram_decompress_page(struct zram *zram, char *mem, u32 index);
+
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
 {
-	unsigned long flags = meta->table[index].value >> ZRAM_FLAG_SHIFT;
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	unsigned long nr_pages, index, blk_idx = 0;
+	struct page *page;
+	bool huge_only;
+	ssize_t ret = len;
+	void *mem;
+	int err;
 
-	meta->table[index].value = (flags << ZRAM_FLAG_SHIFT) | size;
+	if (sysfs_streq(buf, "idle"))
+		huge_only = false;
+	else if (sysfs_streq(buf, "huge"))
+		huge_only = true;
+	else
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	if (!zram->backing_dev) {
+		ret = -ENODEV;
+		goto release_init_lock;
+	}
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		ret = -ENOMEM;
+		goto release_init_lock;
+	}
+
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		if (!blk_idx) {
+			blk_idx = alloc_block_bdev(zram);
+			if (!blk_idx) {
+				ret = -ENOSPC;
+				break;
+			}
+		}
+
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (!zram_wb_candidate(zram, index, huge_only)) {
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			continue;
+		}
+		zram_set_flag(meta, index, ZRAM_UNDER_WB);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+		if (!zram_wb_budget_get(zram)) {
+			bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			ret = -EIO;
+			break;
+		}
+
+		mem = kmap(page);
+		err = zram_decompress_page(zram, mem, index);
+		kunmap(page);
+		if (!err)
+			err = zram_bdev_rw_page(zram, page, blk_idx, WRITE);
+
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		/*
+		 * The slot could have been freed or overwritten while the
+		 * write was in flight; zram_free_page() clears ZRAM_UNDER_WB
+		 * in that case and the block is reused for the next slot.
+		 */
+		if (err || !zram_test_flag(meta, index, ZRAM_UNDER_WB)) {
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			zram_wb_budget_put(zram);
+			if (err) {
+				ret = err;
+				break;
+			}
+			continue;
+		}
+
+		zram_free_handle(zram, index);
+		atomic64_sub(zram_get_obj_size(meta, index),
+				&zram->stats.compr_data_size);
+		zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+		zram_clear_flag(meta, index, ZRAM_HUGE);
+		zram_set_flag(meta, index, ZRAM_WB);
+		meta->table[index].handle = blk_idx;
+		zram_set_obj_size(meta, index, 0);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+		atomic64_inc(&zram->stats.bd_count);
+		blk_idx = 0;
+	}
+
+	if (blk_idx)
+		free_block_bdev(zram, blk_idx);
+	__free_page(page);
+release_init_lock:
+	up_read(&zram->init_lock);
+
+	return ret;
 }
+#else
+static inline void zram_update_ac_time(struct zram_meta *meta, u32 index) {}
+static inline void reset_bdev(struct zram *zram) {}
+static inline void free_block_bdev(struct zram *zram, unsigned long blk_idx) {}
 
-static inline int is_partial_io(struct bio_vec *bvec)
+static inline int read_from_bdev_to_buf(struct zram *zram, char *mem,
+					unsigned long entry)
 {
-	return bvec->bv_len != PAGE_SIZE;
+	return -EIO;
 }
 
+static inline int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
+				 unsigned long entry, int offset)
+{
+	return -EIO;
+}
+#endif
+
 /*
  * Check if request is within bounds and aligned on zram logical blocks.
  */
@@ -253,7 +1015,7 @@ static void zram_meta_free(struct zram_meta *meta)
 	kfree(meta);
 }
 
-static struct zram_meta *zram_meta_alloc(u64 disksize)
+static struct zram_meta *zram_meta_alloc(const char *pool_name, u64 disksize)
 {
 	size_t num_pages;
 	struct zram_meta *meta = kmalloc(sizeof(*meta), GFP_KERNEL);
@@ -267,12 +1029,14 @@ static struct zram_meta *zram_meta_alloc(u64 disksize)
 		goto free_meta;
 	}
 
-	meta->mem_pool = zs_create_pool(GFP_NOIO | __GFP_HIGHMEM);
+	meta->mem_pool = zs_create_pool(pool_name, GFP_NOIO | __GFP_HIGHMEM);
 	if (!meta->mem_pool) {
 		pr_err("Error creating memory pool\n");
 		goto free_table;
 	}
 
+	zram_dedup_init(meta);
+
 	return meta;
 
 free_table:
@@ -291,31 +1055,54 @@ static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 	*offset = (*offset + bvec->bv_len) % PAGE_SIZE;
 }
 
-static int page_zero_filled(void *ptr)
+/*
+ * Check whether the page is filled with a single unsigned long and
+ * return that value in @element.
+ */
+static int page_same_filled(void *ptr, unsigned long *element)
 {
-	unsigned int pos;
+	unsigned int pos, last_pos = PAGE_SIZE / sizeof(unsigned long) - 1;
 	unsigned long *page;
+	unsigned long val;
 
 	page = (unsigned long *)ptr;
+	val = page[0];
+
+	/* Most pages differ at the end already, so check that first */
+	if (val != page[last_pos])
+		return 0;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos < last_pos; pos++) {
+		if (val != page[pos])
 			return 0;
 	}
 
+	*element = val;
 	return 1;
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void zram_fill_page(void *ptr, unsigned long len,
+			   unsigned long value)
+{
+	unsigned long *page = ptr;
+	unsigned long pos;
+
+	WARN_ON_ONCE(!IS_ALIGNED(len, sizeof(unsigned long)));
+	if (likely(value == 0)) {
+		memset(ptr, 0, len);
+	} else {
+		for (pos = 0; pos < len / sizeof(*page); pos++)
+			page[pos] = value;
+	}
+}
+
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
 	user_mem = kmap_atomic(page);
-	if (is_partial_io(bvec))
-		memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
-	else
-		clear_page(user_mem);
+	zram_fill_page(user_mem + bvec->bv_offset, bvec->bv_len, element);
 	kunmap_atomic(user_mem);
 
 	flush_dcache_page(page);
@@ -332,19 +1119,43 @@ static void zram_free_page(struct zram *zram, size_t index)
 	struct zram_meta *meta = zram->meta;
 	unsigned long handle = meta->table[index].handle;
 
-	if (unlikely(!handle)) {
-		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
-		 */
-		if (zram_test_flag(meta, index, ZRAM_ZERO)) {
-			zram_clear_flag(meta, index, ZRAM_ZERO);
+	/* A pending writeback must not install its block over this slot */
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+	zram_clear_flag(meta, index, ZRAM_HUGE);
+
+	if (zram_test_flag(meta, index, ZRAM_COMP_ALT)) {
+		zram_clear_flag(meta, index, ZRAM_COMP_ALT);
+		atomic64_dec(&zram->stats.recomp_pages);
+	}
+
+	/*
+	 * No memory is allocated for same element filled pages.
+	 * Simply clear same page flag.
+	 */
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_clear_flag(meta, index, ZRAM_SAME);
+		if (!meta->table[index].element)
 			atomic64_dec(&zram->stats.zero_pages);
-		}
+		atomic64_dec(&zram->stats.same_pages);
+		meta->table[index].element = 0;
+		return;
+	}
+
+	if (unlikely(!handle))
+		return;
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		free_block_bdev(zram, handle);
+#ifdef CONFIG_ZRAM_WRITEBACK
+		atomic64_dec(&zram->stats.bd_count);
+#endif
+		atomic64_dec(&zram->stats.pages_stored);
+		meta->table[index].handle = 0;
 		return;
 	}
 
-	zs_free(meta->mem_pool, handle);
+	zram_free_handle(zram, index);
 
 	atomic64_sub(zram_get_obj_size(meta, index),
 			&zram->stats.compr_data_size);
@@ -366,15 +1177,29 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	handle = meta->table[index].handle;
 	size = zram_get_obj_size(meta, index);
 
-	if (!handle || zram_test_flag(meta, index, ZRAM_ZERO)) {
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		zram_fill_page(mem, PAGE_SIZE, meta->table[index].element);
+		return 0;
+	}
+
+	if (!handle) {
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 		clear_page(mem);
 		return 0;
 	}
 
+	/* Callers must not be atomic when the slot may be written back */
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return read_from_bdev_to_buf(zram, mem, handle);
+	}
+
 	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
 	if (size == PAGE_SIZE)
 		copy_page(mem, cmem);
+	else if (zram_test_flag(meta, index, ZRAM_COMP_ALT))
+		ret = zcomp_decompress(zram->comp_alt, cmem, size, mem);
 	else
 		ret = zcomp_decompress(zram->comp, cmem, size, mem);
 	zs_unmap_object(meta->mem_pool, handle);
@@ -396,15 +1221,29 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	struct page *page;
 	unsigned char *user_mem, *uncmem = NULL;
 	struct zram_meta *meta = zram->meta;
+	unsigned long handle;
 	page = bvec->bv_page;
 
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
-	if (unlikely(!meta->table[index].handle) ||
-			zram_test_flag(meta, index, ZRAM_ZERO)) {
+	zram_update_ac_time(meta, index);
+	handle = meta->table[index].handle;
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		/* element and handle share storage */
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		handle_same_page(bvec, handle);
+		return 0;
+	}
+
+	if (unlikely(!handle)) {
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
-		handle_zero_page(bvec);
+		handle_same_page(bvec, 0);
 		return 0;
 	}
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return read_from_bdev(zram, bvec, handle, offset);
+	}
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
 	if (is_partial_io(bvec))
@@ -448,8 +1287,13 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	struct page *page;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 	struct zram_meta *meta = zram->meta;
+	struct zcomp *comp = zram->comp;
 	struct zcomp_strm *zstrm;
 	bool locked = false;
+	bool alt = false;
+	unsigned long element = 0;
+	struct zram_dedup_entry *dentry = NULL;
+	u32 checksum = 0;
 
 	page = bvec->bv_page;
 	if (is_partial_io(bvec)) {
@@ -467,7 +1311,7 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			goto out;
 	}
 
-	zstrm = zcomp_strm_find(zram->comp);
+	zstrm = zcomp_strm_find(comp);
 	locked = true;
 	user_mem = kmap_atomic(page);
 
@@ -480,21 +1324,42 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = user_mem;
 	}
 
-	if (page_zero_filled(uncmem)) {
+	if (page_same_filled(uncmem, &element)) {
 		if (user_mem)
 			kunmap_atomic(user_mem);
 		/* Free memory associated with this sector now. */
 		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
 		zram_free_page(zram, index);
-		zram_set_flag(meta, index, ZRAM_ZERO);
+		zram_set_flag(meta, index, ZRAM_SAME);
+		meta->table[index].element = element;
+		zram_update_ac_time(meta, index);
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
-		atomic64_inc(&zram->stats.zero_pages);
+		if (!element)
+			atomic64_inc(&zram->stats.zero_pages);
+		atomic64_inc(&zram->stats.same_pages);
 		ret = 0;
 		goto out;
 	}
 
-	ret = zcomp_compress(zram->comp, zstrm, uncmem, &clen);
+	if (zram_dedup_enabled(zram)) {
+		checksum = zram_dedup_checksum(uncmem);
+		/* zstrm->buffer is free until compression, decompress there */
+		dentry = zram_dedup_find(zram, uncmem, checksum,
+					 zstrm->buffer);
+		if (dentry) {
+			if (user_mem)
+				kunmap_atomic(user_mem);
+			zcomp_strm_release(comp, zstrm);
+			locked = false;
+			handle = dentry->handle;
+			clen = dentry->len;
+			alt = dentry->alt;
+			goto found_dup;
+		}
+	}
+
+	ret = zcomp_compress(comp, zstrm, uncmem, &clen);
 	if (!is_partial_io(bvec)) {
 		kunmap_atomic(user_mem);
 		user_mem = NULL;
@@ -505,6 +1370,34 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		pr_err("Compression failed! err=%d\n", ret);
 		goto out;
 	}
+
+	if (zram->comp_alt && clen > zram->recomp_threshold) {
+		struct zcomp_strm *zstrm_alt;
+		size_t alt_clen;
+		int err;
+
+		/* Finding a stream may sleep, so the page is mapped again */
+		zstrm_alt = zcomp_strm_find(zram->comp_alt);
+		if (!is_partial_io(bvec))
+			user_mem = kmap_atomic(page);
+		err = zcomp_compress(zram->comp_alt, zstrm_alt,
+				     user_mem ? user_mem : uncmem, &alt_clen);
+		if (user_mem) {
+			kunmap_atomic(user_mem);
+			user_mem = NULL;
+		}
+
+		atomic64_inc(&zram->stats.num_recompress);
+		if (!err && alt_clen < clen && alt_clen <= max_zpage_size) {
+			zcomp_strm_release(comp, zstrm);
+			comp = zram->comp_alt;
+			zstrm = zstrm_alt;
+			clen = alt_clen;
+			alt = true;
+		} else {
+			zcomp_strm_release(zram->comp_alt, zstrm_alt);
+		}
+	}
 	src = zstrm->buffer;
 	if (unlikely(clen > max_zpage_size)) {
 		clen = PAGE_SIZE;
@@ -529,10 +1422,13 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		memcpy(cmem, src, clen);
 	}
 
-	zcomp_strm_release(zram->comp, zstrm);
+	zcomp_strm_release(comp, zstrm);
 	locked = false;
 	zs_unmap_object(meta->mem_pool, handle);
 
+	if (zram_dedup_enabled(zram))
+		dentry = zram_dedup_insert(zram, checksum, handle, clen, alt);
+found_dup:
 	/*
 	 * Free memory associated with this sector
 	 * before overwriting unused sectors.
@@ -541,15 +1437,23 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	zram_free_page(zram, index);
 
 	meta->table[index].handle = handle;
+	zram_set_dedup(meta, index, dentry);
 	zram_set_obj_size(meta, index, clen);
+	if (clen == PAGE_SIZE)
+		zram_set_flag(meta, index, ZRAM_HUGE);
+	if (alt)
+		zram_set_flag(meta, index, ZRAM_COMP_ALT);
+	zram_update_ac_time(meta, index);
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
 	/* Update stats */
 	atomic64_add(clen, &zram->stats.compr_data_size);
 	atomic64_inc(&zram->stats.pages_stored);
+	if (alt)
+		atomic64_inc(&zram->stats.recomp_pages);
 out:
 	if (locked)
-		zcomp_strm_release(zram->comp, zstrm);
+		zcomp_strm_release(comp, zstrm);
 	if (is_partial_io(bvec))
 		kfree(uncmem);
 	return ret;
@@ -628,18 +1532,25 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 		return;
 	}
 
+	zram_async_flush();
+
 	meta = zram->meta;
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		unsigned long handle = meta->table[index].handle;
-		if (!handle)
+		if (!handle || zram_test_flag(meta, index, ZRAM_SAME) ||
+		    zram_test_flag(meta, index, ZRAM_WB))
 			continue;
 
-		zs_free(meta->mem_pool, handle);
+		zram_free_handle(zram, index);
 	}
 
 	zcomp_destroy(zram->comp);
+	if (zram->comp_alt)
+		zcomp_destroy(zram->comp_alt);
+	zram->comp_alt = NULL;
 	zram->max_comp_streams = 1;
+	reset_bdev(zram);
 
 	zram_meta_free(zram->meta);
 	zram->meta = NULL;
@@ -665,7 +1576,7 @@ static ssize_t disksize_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	u64 disksize;
-	struct zcomp *comp;
+	struct zcomp *comp, *comp_alt = NULL;
 	struct zram_meta *meta;
 	struct zram *zram = dev_to_zram(dev);
 	int err;
@@ -675,7 +1586,7 @@ static ssize_t disksize_store(struct device *dev,
 		return -EINVAL;
 
 	disksize = PAGE_ALIGN(disksize);
-	meta = zram_meta_alloc(disksize);
+	meta = zram_meta_alloc(zram->disk->disk_name, disksize);
 	if (!meta)
 		return -ENOMEM;
 
@@ -687,6 +1598,18 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_free_meta;
 	}
 
+	if (zram->recomp_algorithm[0]) {
+		comp_alt = zcomp_create(zram->recomp_algorithm,
+					zram->max_comp_streams);
+		if (IS_ERR(comp_alt)) {
+			pr_info("Cannot initialise %s compressing backend\n",
+					zram->recomp_algorithm);
+			err = PTR_ERR(comp_alt);
+			comp_alt = NULL;
+			goto out_destroy_comp_unlocked;
+		}
+	}
+
 	down_write(&zram->init_lock);
 	if (init_done(zram)) {
 		pr_info("Cannot change disksize for initialized device\n");
@@ -696,6 +1619,7 @@ static ssize_t disksize_store(struct device *dev,
 
 	zram->meta = meta;
 	zram->comp = comp;
+	zram->comp_alt = comp_alt;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
 	up_write(&zram->init_lock);
@@ -711,6 +1635,9 @@ static ssize_t disksize_store(struct device *dev,
 
 out_destroy_comp:
 	up_write(&zram->init_lock);
+out_destroy_comp_unlocked:
+	if (comp_alt)
+		zcomp_destroy(comp_alt);
 	zcomp_destroy(comp);
 out_free_meta:
 	zram_meta_free(meta);
@@ -810,6 +1737,224 @@ out:
 	bio_io_error(bio);
 }
 
+#ifdef CONFIG_ZRAM_ASYNC_WRITE
+/* Shared by all pages of one write bio */
+struct zram_bio_ctx {
+	struct bio *bio;
+	atomic_t pending;
+	int error;
+};
+
+/* One page of a write bio, compressed by a worker */
+struct zram_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct zram_bio_ctx *ctx;
+	struct bio_vec bvec;
+	u32 index;
+	int offset;
+};
+
+static inline bool zram_async_enabled(struct zram *zram)
+{
+	return zram->async_write;
+}
+
+static ssize_t async_write_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->async_write;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
+}
+
+static ssize_t async_write_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (kstrtoint(buf, 10, &val) || (val != 0 && val != 1))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	zram->async_write = val;
+	up_write(&zram->init_lock);
+	return len;
+}
+
+static void zram_bio_ctx_put(struct zram_bio_ctx *ctx)
+{
+	if (!atomic_dec_and_test(&ctx->pending))
+		return;
+
+	if (ctx->error)
+		bio_io_error(ctx->bio);
+	else {
+		set_bit(BIO_UPTODATE, &ctx->bio->bi_flags);
+		bio_endio(ctx->bio, 0);
+	}
+	kfree(ctx);
+}
+
+static void zram_write_work(struct work_struct *work)
+{
+	struct zram_work *zw = container_of(work, struct zram_work, work);
+	struct zram_bio_ctx *ctx = zw->ctx;
+
+	if (zram_bvec_rw(zw->zram, &zw->bvec, zw->index, zw->offset,
+			 ctx->bio) < 0)
+		ctx->error = -EIO;
+
+	kmem_cache_free(zram_work_cache, zw);
+	zram_bio_ctx_put(ctx);
+}
+
+/* Spread the pages of a bio over the online CPUs in turn */
+static int zram_pick_cpu(void)
+{
+	int cpu = ACCESS_ONCE(zram_next_cpu);
+
+	cpu = cpumask_next(cpu, cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = cpumask_first(cpu_online_mask);
+	zram_next_cpu = cpu;
+	return cpu;
+}
+
+/*
+ * Queue one bio vector for compression on another CPU. Partial pages
+ * need a read-modify-write of the slot and are handled in place, as
+ * is everything when no work item can be allocated.
+ */
+static int zram_bvec_write_async(struct zram *zram, struct zram_bio_ctx *ctx,
+				 struct bio_vec *bvec, u32 index, int offset)
+{
+	struct zram_work *zw;
+
+	if (is_partial_io(bvec))
+		goto sync;
+
+	zw = kmem_cache_alloc(zram_work_cache, GFP_NOIO | __GFP_NOWARN);
+	if (!zw)
+		goto sync;
+
+	INIT_WORK(&zw->work, zram_write_work);
+	zw->zram = zram;
+	zw->ctx = ctx;
+	zw->bvec = *bvec;
+	zw->index = index;
+	zw->offset = offset;
+
+	atomic_inc(&ctx->pending);
+	queue_work_on(zram_pick_cpu(), zram_wq, &zw->work);
+	return 0;
+
+sync:
+	return zram_bvec_rw(zram, bvec, index, offset, ctx->bio);
+}
+
+static void __zram_make_request_async(struct zram *zram, struct bio *bio)
+{
+	int offset, i;
+	u32 index;
+	struct bio_vec *bvec;
+	struct zram_bio_ctx *ctx;
+
+	ctx = kmalloc(sizeof(*ctx), GFP_NOIO | __GFP_NOWARN);
+	if (!ctx) {
+		__zram_make_request(zram, bio);
+		return;
+	}
+	ctx->bio = bio;
+	ctx->error = 0;
+	/* Dropped once all bio vectors have been handed out */
+	atomic_set(&ctx->pending, 1);
+
+	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
+	offset = (bio->bi_sector &
+		  (SECTORS_PER_PAGE - 1)) << SECTOR_SHIFT;
+
+	bio_for_each_segment(bvec, bio, i) {
+		int max_transfer_size = PAGE_SIZE - offset;
+
+		if (bvec->bv_len > max_transfer_size) {
+			struct bio_vec bv;
+
+			bv.bv_page = bvec->bv_page;
+			bv.bv_len = max_transfer_size;
+			bv.bv_offset = bvec->bv_offset;
+
+			if (zram_bvec_write_async(zram, ctx, &bv,
+						  index, offset) < 0)
+				goto out;
+
+			bv.bv_len = bvec->bv_len - max_transfer_size;
+			bv.bv_offset += max_transfer_size;
+			if (zram_bvec_write_async(zram, ctx, &bv,
+						  index + 1, 0) < 0)
+				goto out;
+		} else
+			if (zram_bvec_write_async(zram, ctx, bvec,
+						  index, offset) < 0)
+				goto out;
+
+		update_position(&index, &offset, bvec);
+	}
+
+	zram_bio_ctx_put(ctx);
+	return;
+
+out:
+	ctx->error = -EIO;
+	zram_bio_ctx_put(ctx);
+}
+
+static int zram_async_init(void)
+{
+	zram_work_cache = KMEM_CACHE(zram_work, 0);
+	if (!zram_work_cache)
+		return -ENOMEM;
+
+	/* Writes may come from reclaim, so the queue needs a rescuer */
+	zram_wq = alloc_workqueue("zram", WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+	if (!zram_wq) {
+		kmem_cache_destroy(zram_work_cache);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void zram_async_exit(void)
+{
+	destroy_workqueue(zram_wq);
+	kmem_cache_destroy(zram_work_cache);
+}
+
+#else
+static inline bool zram_async_enabled(struct zram *zram)
+{
+	return false;
+}
+
+static inline void __zram_make_request_async(struct zram *zram,
+					     struct bio *bio)
+{
+}
+
+static inline int zram_async_init(void)
+{
+	return 0;
+}
+
+static inline void zram_async_exit(void) {}
+#endif
+
 /*
  * Handler function for all zram I/O requests.
  */
@@ -826,7 +1971,11 @@ static void zram_make_request(struct request_queue *queue, struct bio *bio)
 		goto error;
 	}
 
-	__zram_make_request(zram, bio);
+	if (zram_async_enabled(zram) && bio_data_dir(bio) == WRITE &&
+	    !(bio->bi_rw & REQ_DISCARD))
+		__zram_make_request_async(zram, bio);
+	else
+		__zram_make_request(zram, bio);
 	up_read(&zram->init_lock);
 
 	return;
@@ -862,10 +2011,35 @@ static DEVICE_ATTR(initstate, S_IRUGO, initstate_show, NULL);
 static DEVICE_ATTR(reset, S_IWUSR, NULL, reset_store);
 static DEVICE_ATTR(orig_data_size, S_IRUGO, orig_data_size_show, NULL);
 static DEVICE_ATTR(mem_used_total, S_IRUGO, mem_used_total_show, NULL);
+static DEVICE_ATTR(compact, S_IWUSR, NULL, compact_store);
+static DEVICE_ATTR(pages_compacted, S_IRUGO, pages_compacted_show, NULL);
 static DEVICE_ATTR(max_comp_streams, S_IRUGO | S_IWUSR,
 		max_comp_streams_show, max_comp_streams_store);
 static DEVICE_ATTR(comp_algorithm, S_IRUGO | S_IWUSR,
 		comp_algorithm_show, comp_algorithm_store);
+static DEVICE_ATTR(recomp_algorithm, S_IRUGO | S_IWUSR,
+		recomp_algorithm_show, recomp_algorithm_store);
+static DEVICE_ATTR(recomp_threshold, S_IRUGO | S_IWUSR,
+		recomp_threshold_show, recomp_threshold_store);
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR(use_dedup, S_IRUGO | S_IWUSR,
+		use_dedup_show, use_dedup_store);
+#endif
+#ifdef CONFIG_ZRAM_ASYNC_WRITE
+static DEVICE_ATTR(async_write, S_IRUGO | S_IWUSR,
+		async_write_show, async_write_store);
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR(backing_dev, S_IRUGO | S_IWUSR,
+		backing_dev_show, backing_dev_store);
+static DEVICE_ATTR(writeback, S_IWUSR, NULL, writeback_store);
+static DEVICE_ATTR(idle_age, S_IRUGO | S_IWUSR,
+		idle_age_show, idle_age_store);
+static DEVICE_ATTR(writeback_limit, S_IRUGO | S_IWUSR,
+		writeback_limit_show, writeback_limit_store);
+static DEVICE_ATTR(writeback_limit_enable, S_IRUGO | S_IWUSR,
+		writeback_limit_enable_show, writeback_limit_enable_store);
+#endif
 
 ZRAM_ATTR_RO(num_reads);
 ZRAM_ATTR_RO(num_writes);
@@ -874,7 +2048,20 @@ ZRAM_ATTR_RO(failed_writes);
 ZRAM_ATTR_RO(invalid_io);
 ZRAM_ATTR_RO(notify_free);
 ZRAM_ATTR_RO(zero_pages);
+ZRAM_ATTR_RO(same_pages);
+ZRAM_ATTR_RO(num_recompress);
+ZRAM_ATTR_RO(recomp_pages);
 ZRAM_ATTR_RO(compr_data_size);
+#ifdef CONFIG_ZRAM_DEDUP
+ZRAM_ATTR_RO(dedup_hits);
+ZRAM_ATTR_RO(dedup_misses);
+ZRAM_ATTR_RO(dup_data_size);
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+ZRAM_ATTR_RO(bd_count);
+ZRAM_ATTR_RO(bd_reads);
+ZRAM_ATTR_RO(bd_writes);
+#endif
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
@@ -888,10 +2075,36 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_notify_free.attr,
 	&dev_attr_zero_pages.attr,
 	&dev_attr_orig_data_size.attr,
+	&dev_attr_same_pages.attr,
 	&dev_attr_compr_data_size.attr,
 	&dev_attr_mem_used_total.attr,
+	&dev_attr_compact.attr,
+	&dev_attr_pages_compacted.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_recomp_threshold.attr,
+	&dev_attr_num_recompress.attr,
+	&dev_attr_recomp_pages.attr,
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+	&dev_attr_dedup_hits.attr,
+	&dev_attr_dedup_misses.attr,
+	&dev_attr_dup_data_size.attr,
+#endif
+#ifdef CONFIG_ZRAM_ASYNC_WRITE
+	&dev_attr_async_write.attr,
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_idle_age.attr,
+	&dev_attr_writeback_limit.attr,
+	&dev_attr_writeback_limit_enable.attr,
+	&dev_attr_bd_count.attr,
+	&dev_attr_bd_reads.attr,
+	&dev_attr_bd_writes.attr,
+#endif
 	NULL,
 };
 
@@ -971,6 +2184,11 @@ static int create_device(struct zram *zram, int device_id)
 	strlcpy(zram->compressor, default_compressor, sizeof(zram->compressor));
 	zram->meta = NULL;
 	zram->max_comp_streams = 1;
+	zram->recomp_threshold = default_recomp_threshold;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	spin_lock_init(&zram->wb_limit_lock);
+	zram->idle_age = ZRAM_DEFAULT_IDLE_AGE;
+#endif
 	return 0;
 
 out_free_disk:
@@ -1004,11 +2222,15 @@ static int __init zram_init(void)
 		goto out;
 	}
 
+	ret = zram_async_init();
+	if (ret)
+		goto out;
+
 	zram_major = register_blkdev(0, "zram");
 	if (zram_major <= 0) {
 		pr_warn("Unable to get major number\n");
 		ret = -EBUSY;
-		goto out;
+		goto free_async;
 	}
 
 	/* Allocate the device array and initialize each one */
@@ -1034,6 +2256,8 @@ free_devices:
 	kfree(zram_devices);
 unregister:
 	unregister_blkdev(zram_major, "zram");
+free_async:
+	zram_async_exit();
 out:
 	return ret;
 }
@@ -1057,6 +2281,7 @@ static void __exit zram_exit(void)
 	unregister_blkdev(zram_major, "zram");
 
 	kfree(zram_devices);
+	zram_async_exit();
 	pr_debug("Cleanup done!\n");
 }
 
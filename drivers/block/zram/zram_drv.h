@@ -19,6 +19,7 @@
 #include <linux/zsmalloc.h>
 
 #include "zcomp.h"
+#include "zram_dedup.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -40,6 +41,12 @@ static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
  * always return failure.
  */
 
+/*
+ * Pages whose primary compressed size exceeds this are retried with
+ * the secondary algorithm, if one is configured.
+ */
+static const size_t default_recomp_threshold = PAGE_SIZE / 2;
+
 /*-- End of configurable params */
 
 #define SECTOR_SHIFT		9
@@ -65,9 +72,13 @@ static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
 
 /* Flags for zram pages (table[page_no].value) */
 enum zram_pageflags {
-	/* Page consists entirely of zeros */
-	ZRAM_ZERO = ZRAM_FLAG_SHIFT + 1,
+	/* Page consists of the same unsigned long, stored in the handle */
+	ZRAM_SAME = ZRAM_FLAG_SHIFT + 1,
 	ZRAM_ACCESS,	/* page in now accessed */
+	ZRAM_WB,	/* page is stored on backing device */
+	ZRAM_UNDER_WB,	/* page is being written back */
+	ZRAM_HUGE,	/* incompressible page */
+	ZRAM_COMP_ALT,	/* compressed with recomp_algorithm */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -76,8 +87,17 @@ enum zram_pageflags {
 
 /* Allocated for each disk page */
 struct zram_table_entry {
-	unsigned long handle;
+	union {
+		unsigned long handle;	/* block index for ZRAM_WB */
+		unsigned long element;	/* fill value for ZRAM_SAME */
+	};
 	unsigned long value;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	unsigned long ac_time;	/* jiffies of the last read or write */
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+	struct zram_dedup_entry *dedup;	/* shared object, if any */
+#endif
 };
 
 struct zram_stats {
@@ -89,12 +109,29 @@ struct zram_stats {
 	atomic64_t invalid_io;	/* non-page-aligned I/O requests */
 	atomic64_t notify_free;	/* no. of swap slot free notifications */
 	atomic64_t zero_pages;		/* no. of zero filled pages */
+	atomic64_t same_pages;		/* no. of same element filled pages */
+	atomic64_t num_recompress;	/* no. of secondary compressions */
+	atomic64_t recomp_pages;	/* no. of pages stored by recomp_algorithm */
 	atomic64_t pages_stored;	/* no. of pages currently stored */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;		/* no. of pages in backing device */
+	atomic64_t bd_reads;		/* no. of reads from backing device */
+	atomic64_t bd_writes;		/* no. of writes to backing device */
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+	atomic64_t dedup_hits;		/* writes that matched a stored page */
+	atomic64_t dedup_misses;	/* writes that had to be compressed */
+	atomic64_t dup_data_size;	/* compressed bytes saved by sharing */
+#endif
 };
 
 struct zram_meta {
 	struct zram_table_entry *table;
 	struct zs_pool *mem_pool;
+#ifdef CONFIG_ZRAM_DEDUP
+	struct rb_root dedup_root;
+	spinlock_t dedup_lock;
+#endif
 };
 
 struct zram {
@@ -102,6 +139,8 @@ struct zram {
 	struct request_queue *queue;
 	struct gendisk *disk;
 	struct zcomp *comp;
+	/* secondary algorithm for poorly compressible pages, may be NULL */
+	struct zcomp *comp_alt;
 
 	/* Prevent concurrent execution of device init, reset and R/W request */
 	struct rw_semaphore init_lock;
@@ -113,5 +152,27 @@ struct zram {
 	int max_comp_streams;
 	struct zram_stats stats;
 	char compressor[10];
+	char recomp_algorithm[10];
+	size_t recomp_threshold;	/* bytes */
+#ifdef CONFIG_ZRAM_DEDUP
+	bool use_dedup;
+#endif
+#ifdef CONFIG_ZRAM_ASYNC_WRITE
+	bool async_write;
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct file *backing_dev;
+	struct block_device *bdev;
+	unsigned int old_block_size;
+	/* one bit per PAGE_SIZE block of the backing device */
+	unsigned long *bitmap;
+	unsigned long nr_pages;
+	/* slots not accessed for idle_age seconds are idle */
+	unsigned int idle_age;
+	/* protects wb_limit_enable and bd_wb_limit */
+	spinlock_t wb_limit_lock;
+	bool wb_limit_enable;
+	u64 bd_wb_limit;	/* pages */
+#endif
 };
 #endif
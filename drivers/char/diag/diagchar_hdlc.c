@@ -20,6 +20,7 @@
 #include <linux/uaccess.h>
 #include <linux/ratelimit.h>
 #include <linux/crc-ccitt.h>
+#include <linux/string.h>
 #include "diagchar_hdlc.h"
 #include "diagchar.h"
 
@@ -91,9 +92,25 @@ void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 					}
 
 				} else {
-					crc = CRC_16_L_STEP(crc, src_byte);
-					*dest++ = src_byte;
-					used++;
+					/*
+					 * Move the whole run of bytes that
+					 * need no escaping at once; crc_ccitt
+					 * is table driven over a buffer.
+					 */
+					const uint8_t *run = src - 1;
+					size_t n = min_t(size_t,
+						src_last - run + 1,
+						dest_last - dest + 1);
+
+					while (src < run + n &&
+					       *src != CONTROL_CHAR &&
+					       *src != ESC_CHAR)
+						src++;
+					n = src - run;
+					crc = crc_ccitt(crc, run, n);
+					memcpy(dest, run, n);
+					dest += n;
+					used += n;
 				}
 			}
 
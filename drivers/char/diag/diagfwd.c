@@ -64,6 +64,9 @@ int diag_debug_buf_idx;
 unsigned char diag_debug_buf[1024];
 /* Number of entries in table of buffers */
 static unsigned int buf_tbl_size = 10;
+/* Read all complete SMD data packets into one buffer when set */
+static bool smd_batch_read = 1;
+module_param(smd_batch_read, bool, S_IRUGO | S_IWUSR);
 struct diag_master_table entry;
 int wrap_enabled;
 uint16_t wrap_count;
@@ -706,6 +709,31 @@ static int diag_smd_resize_buf(struct diag_smd_info *smd_info, void **buf,
 	return success;
 }
 
+/*
+ * Append whole packets that are already available on the channel to buf,
+ * which holds total bytes of buf_size. When the apps processor does the
+ * HDLC encoding the batch is also kept small enough to encode in one go.
+ */
+static int diag_smd_read_batch(struct diag_smd_info *smd_info, void *buf,
+			       int total, int buf_size)
+{
+	int pkt_len;
+
+	if (smd_info->encode_hdlc)
+		buf_size = min(buf_size, (MAX_IN_BUF_SIZE - 3) / 2);
+
+	while (smd_info->ch) {
+		pkt_len = smd_cur_packet_size(smd_info->ch);
+		if (!pkt_len || pkt_len > buf_size - total ||
+		    smd_read_avail(smd_info->ch) < pkt_len)
+			break;
+		smd_read(smd_info->ch, buf + total, pkt_len);
+		total += pkt_len;
+	}
+
+	return total;
+}
+
 void diag_smd_send_req(struct diag_smd_info *smd_info)
 {
 	void *buf = NULL, *temp_buf = NULL;
@@ -846,6 +874,17 @@ void diag_smd_send_req(struct diag_smd_info *smd_info)
 			}
 		}
 
+		/*
+		 * Data channels carry a stream of log packets. Pull in any
+		 * further packets that are already complete in the FIFO and
+		 * fit the buffer, so that one USB/memory device write and
+		 * one trip through this work function carries many of them.
+		 */
+		if (smd_info->type == SMD_DATA_TYPE && !buf_full &&
+		    total_recd == pkt_len && smd_batch_read)
+			total_recd = diag_smd_read_batch(smd_info, buf,
+							 total_recd, buf_size);
+
 		if ((smd_info->type == SMD_DATA_TYPE ||
 		     smd_info->type == SMD_CMD_TYPE) &&
 		     driver->logging_mode == MEMORY_DEVICE_MODE)
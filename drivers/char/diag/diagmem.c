@@ -212,6 +212,12 @@ void diagmem_free(struct diagchar_dev *driver, void *buf, int pool_type)
 {
 	int index;
 	unsigned long flags;
+	/*
+	 * Apps pools can only be destroyed once the last client closed the
+	 * device, HSIC pools once their channel is down.  Don't walk every
+	 * pool in diagmem_exit() on each free while logging.
+	 */
+	int check_exit = (driver->ref_count == 0);
 
 	if (!buf)
 		return;
@@ -264,6 +270,7 @@ void diagmem_free(struct diagchar_dev *driver, void *buf, int pool_type)
 	} else if (pool_type == POOL_TYPE_HSIC ||
 				pool_type == POOL_TYPE_HSIC_2) {
 		index = pool_type - POOL_TYPE_HSIC;
+		check_exit = 1;
 		if (diag_hsic[index].diag_hsic_pool != NULL &&
 			diag_hsic[index].count_hsic_pool > 0) {
 			mempool_free(buf, diag_hsic[index].diag_hsic_pool);
@@ -275,6 +282,7 @@ void diagmem_free(struct diagchar_dev *driver, void *buf, int pool_type)
 	} else if (pool_type == POOL_TYPE_HSIC_WRITE ||
 				pool_type == POOL_TYPE_HSIC_2_WRITE) {
 		index = pool_type - POOL_TYPE_HSIC_WRITE;
+		check_exit = 1;
 		if (diag_hsic[index].diag_hsic_write_pool != NULL &&
 			diag_hsic[index].count_hsic_write_pool > 0) {
 			mempool_free(buf,
@@ -291,7 +299,8 @@ void diagmem_free(struct diagchar_dev *driver, void *buf, int pool_type)
 
 	}
 	spin_unlock_irqrestore(&driver->diag_mem_lock, flags);
-	diagmem_exit(driver, pool_type);
+	if (check_exit)
+		diagmem_exit(driver, pool_type);
 }
 
 void diagmem_init(struct diagchar_dev *driver)
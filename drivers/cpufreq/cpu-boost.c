@@ -21,6 +21,8 @@
 #include <linux/sched.h>
 #include <linux/jiffies.h>
 #include <linux/smpboot.h>
+#include <linux/kthread.h>
+#include <linux/err.h>
 #include <linux/moduleparam.h>
 #include <linux/slab.h>
 #include <linux/input.h>
@@ -44,7 +46,15 @@ static DEFINE_PER_CPU(struct cpu_sync, sync_info);
 static DEFINE_PER_CPU(struct task_struct *, thread);
 static struct workqueue_struct *cpu_boost_wq;
 
-static struct work_struct input_boost_work;
+/*
+ * Input boosts are applied from an RT kthread rather than the workqueue
+ * so a touch irq can raise the frequency without waiting for a worker
+ * or for the input core to deliver the event.
+ */
+static DEFINE_KTHREAD_WORKER(input_boost_worker);
+static struct task_struct *input_boost_task;
+static void do_input_boost(struct kthread_work *work);
+static DEFINE_KTHREAD_WORK(input_boost_work, do_input_boost);
 
 static struct notifier_block notif;
 
@@ -57,8 +67,55 @@ module_param(sync_threshold, uint, 0644);
 static bool input_boost_enabled;
 static bool suspended;
 
-static unsigned int input_boost_ms = 40;
-module_param(input_boost_ms, uint, 0644);
+/*
+ * Input boost profiles, one per class of input device. A boost lasts
+ * ms milliseconds and is removed in steps equal parts; each step lowers
+ * the boost by input_boost_freq / steps, so steps = 1 drops the whole
+ * boost at once. A profile with ms = 0 disables boosting for its class.
+ */
+enum boost_class {
+	BOOST_TOUCH,
+	BOOST_KEY,
+	BOOST_SENSOR,
+	BOOST_CLASS_MAX,
+};
+
+struct boost_profile {
+	unsigned int ms;
+	unsigned int steps;
+};
+
+static struct boost_profile boost_profiles[BOOST_CLASS_MAX] = {
+	[BOOST_TOUCH]	= { .ms = 40, .steps = 1 },
+	[BOOST_KEY]	= { .ms = 0, .steps = 1 },
+	[BOOST_SENSOR]	= { .ms = 0, .steps = 1 },
+};
+
+module_param_named(input_boost_ms, boost_profiles[BOOST_TOUCH].ms,
+		   uint, 0644);
+module_param_named(input_boost_steps, boost_profiles[BOOST_TOUCH].steps,
+		   uint, 0644);
+module_param_named(key_boost_ms, boost_profiles[BOOST_KEY].ms, uint, 0644);
+module_param_named(key_boost_steps, boost_profiles[BOOST_KEY].steps,
+		   uint, 0644);
+module_param_named(sensor_boost_ms, boost_profiles[BOOST_SENSOR].ms,
+		   uint, 0644);
+module_param_named(sensor_boost_steps, boost_profiles[BOOST_SENSOR].steps,
+		   uint, 0644);
+
+/* Class whose profile the next run of input_boost_work applies */
+static enum boost_class input_boost_class;
+/* Decay state of the boost in effect, owned by the boost works */
+static unsigned int input_boost_step;
+static unsigned int input_boost_nsteps;
+static unsigned int input_boost_step_ms;
+
+/*
+ * Percentage by which the speed of a touch gesture has to change before
+ * the boost is re-armed mid-gesture.
+ */
+static unsigned int touch_speed_delta = 50;
+module_param(touch_speed_delta, uint, 0644);
 
 static bool hotplug_boost = 1;
 module_param(hotplug_boost, bool, 0644);
@@ -68,6 +125,8 @@ module_param(wakeup_boost, bool, 0644);
 
 static struct delayed_work input_boost_rem;
 static u64 last_input_time;
+/* Last boost requested straight from a touch controller's irq */
+static u64 last_fast_boost;
 
 static unsigned int min_input_interval = 150;
 module_param(min_input_interval, uint, 0644);
@@ -140,46 +199,24 @@ static const struct kernel_param_ops param_ops_input_boost_freq = {
 };
 module_param_cb(input_boost_freq, &param_ops_input_boost_freq, NULL, 0644);
 
+static struct cpufreq_limit boost_limit = {
+	.name = "cpu_boost",
+};
+
 /*
- * The CPUFREQ_ADJUST notifier is used to override the current policy min to
- * make sure policy min >= boost_min. The cpufreq framework then does the job
- * of enforcing the new policy.
+ * Hand the larger of the sync and input boost floors of a cpu to the
+ * cpufreq limit aggregator. The policy is only re-evaluated if that
+ * moves the effective floor, and any ceiling still takes precedence.
  */
-static int boost_adjust_notify(struct notifier_block *nb, unsigned long val,
-				void *data)
+static void update_boost_limit(unsigned int cpu)
 {
-	struct cpufreq_policy *policy = data;
-	unsigned int cpu = policy->cpu;
 	struct cpu_sync *s = &per_cpu(sync_info, cpu);
-	unsigned int b_min = s->boost_min;
-	unsigned int ib_min = s->input_boost_min;
-	unsigned int min;
-
-	if (val != CPUFREQ_ADJUST)
-		return NOTIFY_OK;
-
-	if (!b_min && !ib_min)
-		return NOTIFY_OK;
-
-	min = max(b_min, ib_min);
-	min = min(min, policy->max);
+	unsigned int min = max(s->boost_min, s->input_boost_min);
 
-	pr_debug("CPU%u policy min before boost: %u kHz\n",
-		 cpu, policy->min);
 	pr_debug("CPU%u boost min: %u kHz\n", cpu, min);
-
-	cpufreq_verify_within_limits(policy, min, UINT_MAX);
-
-	pr_debug("CPU%u policy min after boost: %u kHz\n",
-		 cpu, policy->min);
-
-	return NOTIFY_OK;
+	cpufreq_limit_set(&boost_limit, cpu, min, UINT_MAX);
 }
 
-static struct notifier_block boost_adjust_nb = {
-	.notifier_call = boost_adjust_notify,
-};
-
 static void do_boost_rem(struct work_struct *work)
 {
 	struct cpu_sync *s = container_of(work, struct cpu_sync,
@@ -187,37 +224,36 @@ static void do_boost_rem(struct work_struct *work)
 
 	pr_debug("Removing boost for CPU%d\n", s->cpu);
 	s->boost_min = 0;
-	/* Force policy re-evaluation to trigger adjust notifier. */
-	cpufreq_update_policy(s->cpu);
+	update_boost_limit(s->cpu);
 }
 
-static void update_policy_online(void)
+static void set_input_boost_step(void)
 {
-	unsigned int i;
+	unsigned int i, left = input_boost_nsteps - input_boost_step;
+	struct cpu_sync *i_sync_info;
 
-	/* Re-evaluate policy to trigger adjust notifier for online CPUs */
-	get_online_cpus();
-	for_each_online_cpu(i) {
-		pr_debug("Updating policy for CPU%d\n", i);
-		cpufreq_update_policy(i);
+	/* Scale the input_boost_min for all CPUs in the system */
+	pr_debug("Setting input boost step %u/%u for all CPUs\n",
+		 input_boost_step, input_boost_nsteps);
+	for_each_possible_cpu(i) {
+		i_sync_info = &per_cpu(sync_info, i);
+		i_sync_info->input_boost_min =
+			i_sync_info->input_boost_freq * left /
+			input_boost_nsteps;
 	}
-	put_online_cpus();
+
+	for_each_possible_cpu(i)
+		update_boost_limit(i);
 }
 
 static void do_input_boost_rem(struct work_struct *work)
 {
-	unsigned int i;
-	struct cpu_sync *i_sync_info;
+	input_boost_step++;
+	set_input_boost_step();
 
-	/* Reset the input_boost_min for all CPUs in the system */
-	pr_debug("Resetting input boost min for all CPUs\n");
-	for_each_possible_cpu(i) {
-		i_sync_info = &per_cpu(sync_info, i);
-		i_sync_info->input_boost_min = 0;
-	}
-
-	/* Update policies for all online CPUs */
-	update_policy_online();
+	if (input_boost_step < input_boost_nsteps)
+		queue_delayed_work(cpu_boost_wq, &input_boost_rem,
+				   msecs_to_jiffies(input_boost_step_ms));
 }
 
 static int boost_migration_should_run(unsigned int cpu)
@@ -260,7 +296,6 @@ static void run_boost_migration(unsigned int cpu)
 	else
 		s->boost_min = src_policy.cur;
 
-	/* Force policy re-evaluation to trigger adjust notifier. */
 	get_online_cpus();
 	if (cpu_online(src_cpu))
 		/*
@@ -274,11 +309,12 @@ static void run_boost_migration(unsigned int cpu)
 		 */
 		cpufreq_update_policy(src_cpu);
 	if (cpu_online(dest_cpu)) {
-		cpufreq_update_policy(dest_cpu);
+		update_boost_limit(dest_cpu);
 		queue_delayed_work_on(dest_cpu, cpu_boost_wq,
 			&s->boost_rem, msecs_to_jiffies(boost_ms));
 	} else {
 		s->boost_min = 0;
+		update_boost_limit(dest_cpu);
 	}
 	put_online_cpus();
 }
@@ -338,46 +374,192 @@ static struct notifier_block boost_migration_nb = {
 	.notifier_call = boost_migration_notify,
 };
 
-static void do_input_boost(struct work_struct *work)
+static void do_input_boost(struct kthread_work *work)
 {
-	unsigned int i;
-	struct cpu_sync *i_sync_info;
+	struct boost_profile *p = &boost_profiles[input_boost_class];
 
 	cancel_delayed_work_sync(&input_boost_rem);
 
-	/* Set the input_boost_min for all CPUs in the system */
-	pr_debug("Setting input boost min for all CPUs\n");
-	for_each_possible_cpu(i) {
-		i_sync_info = &per_cpu(sync_info, i);
-		i_sync_info->input_boost_min = i_sync_info->input_boost_freq;
-	}
+	if (!p->ms)
+		return;
 
-	/* Update policies for all online CPUs */
-	update_policy_online();
+	input_boost_step = 0;
+	input_boost_nsteps = max(p->steps, 1U);
+	input_boost_step_ms = max(p->ms / input_boost_nsteps, 1U);
+	set_input_boost_step();
 
 	queue_delayed_work(cpu_boost_wq, &input_boost_rem,
-					msecs_to_jiffies(input_boost_ms));
+					msecs_to_jiffies(input_boost_step_ms));
+}
+
+static bool input_boost_pending(void)
+{
+	return !list_empty(&input_boost_work.node);
+}
+
+static void queue_input_boost(enum boost_class class)
+{
+	input_boost_class = class;
+	queue_kthread_work(&input_boost_worker, &input_boost_work);
+	last_input_time = ktime_to_us(ktime_get());
+}
+
+/**
+ * cpu_boost_touch_irq - boost for a touch straight from the hard irq
+ *
+ * Called by touch controller drivers from their primary irq handler,
+ * before the report has been read and long before the input core
+ * delivers it, so the frequency is up by the time the irq thread and
+ * userspace get to run. Safe in any context; boosts already pending or
+ * still at full strength are left alone.
+ */
+void cpu_boost_touch_irq(void)
+{
+	u64 now;
+
+	if (suspended || !input_boost_enabled || !input_boost_task ||
+	    !boost_profiles[BOOST_TOUCH].ms || input_boost_pending())
+		return;
+
+	now = ktime_to_us(ktime_get());
+	if (now - last_input_time < input_boost_step_ms * USEC_PER_MSEC)
+		return;
+
+	last_fast_boost = now;
+	queue_input_boost(BOOST_TOUCH);
+}
+EXPORT_SYMBOL(cpu_boost_touch_irq);
+
+/*
+ * Per device handle. For touch devices the first contact is followed
+ * from one SYN_REPORT to the next so that a gesture re-arms the boost
+ * only when it turns or changes speed, not on every move.
+ */
+struct cpuboost_handle {
+	struct input_handle handle;
+	enum boost_class class;
+	int slot;
+	bool down;
+	int x, y;
+	int last_x, last_y;
+	int last_dx, last_dy;
+	unsigned int last_speed;
+	u64 last_report;
+};
+
+static bool cpuboost_touch_changed(struct cpuboost_handle *h, u64 now)
+{
+	int dx = h->x - h->last_x;
+	int dy = h->y - h->last_y;
+	unsigned int dt_ms = max_t(u64, (now - h->last_report) /
+				   USEC_PER_MSEC, 1);
+	unsigned int speed = (abs(dx) + abs(dy)) / dt_ms;
+	unsigned int diff = abs((int)speed - (int)h->last_speed);
+	bool changed;
+
+	changed = dx * h->last_dx + dy * h->last_dy < 0 ||
+		  diff * 100 > h->last_speed * touch_speed_delta;
+
+	h->last_x = h->x;
+	h->last_y = h->y;
+	h->last_dx = dx;
+	h->last_dy = dy;
+	h->last_speed = speed;
+	h->last_report = now;
+
+	return changed;
+}
+
+static void cpuboost_touch_event(struct cpuboost_handle *h,
+		unsigned int type, unsigned int code, int value, u64 now)
+{
+	bool start = false;
+
+	switch (type) {
+	case EV_ABS:
+		if (code == ABS_MT_SLOT) {
+			h->slot = value;
+		} else if (h->slot != 0) {
+			break;
+		} else if (code == ABS_MT_TRACKING_ID) {
+			h->down = value >= 0;
+		} else if (code == ABS_MT_POSITION_X || code == ABS_X) {
+			h->x = value;
+		} else if (code == ABS_MT_POSITION_Y || code == ABS_Y) {
+			h->y = value;
+		}
+		return;
+	case EV_KEY:
+		if (code == BTN_TOUCH)
+			h->down = value;
+		return;
+	case EV_SYN:
+		if (code != SYN_REPORT)
+			return;
+		if (!h->down) {
+			h->last_report = 0;
+			return;
+		}
+		start = !h->last_report;
+		break;
+	default:
+		return;
+	}
+
+	if (start) {
+		h->last_x = h->x;
+		h->last_y = h->y;
+		h->last_dx = h->last_dy = 0;
+		h->last_speed = 0;
+		h->last_report = now;
+	} else if (!cpuboost_touch_changed(h, now)) {
+		return;
+	}
+
+	/*
+	 * A new contact always boosts, unless the controller's irq did
+	 * so already. A turn or change of pace only re-arms once the
+	 * boost has started decaying.
+	 */
+	if (now - (start ? last_fast_boost : last_input_time) <
+	    input_boost_step_ms * USEC_PER_MSEC)
+		return;
+
+	pr_debug("Input boost for touch %s.\n", start ? "down" : "change");
+	queue_input_boost(BOOST_TOUCH);
 }
 
 static void cpuboost_input_event(struct input_handle *handle,
 		unsigned int type, unsigned int code, int value)
 {
+	struct cpuboost_handle *h =
+		container_of(handle, struct cpuboost_handle, handle);
 	u64 now;
 	unsigned int min_interval;
 
 	if (suspended || !input_boost_enabled ||
-		work_pending(&input_boost_work))
+		!boost_profiles[h->class].ms ||
+		input_boost_pending())
 		return;
 
 	now = ktime_to_us(ktime_get());
-	min_interval = max(min_input_interval, input_boost_ms);
+
+	if (h->class == BOOST_TOUCH) {
+		cpuboost_touch_event(h, type, code, value, now);
+		return;
+	}
+
+	/* Key releases and sync markers carry no new work */
+	if (type == EV_SYN || (type == EV_KEY && !value))
+		return;
+
+	min_interval = max(min_input_interval, boost_profiles[h->class].ms);
 
 	if (now - last_input_time < min_interval * USEC_PER_MSEC)
 		return;
 
 	pr_debug("Input boost for input event.\n");
-	queue_work(cpu_boost_wq, &input_boost_work);
-	last_input_time = ktime_to_us(ktime_get());
+	queue_input_boost(h->class);
 }
 
 bool check_cpuboost(int cpu)
@@ -390,16 +572,29 @@ bool check_cpuboost(int cpu)
 	return false;
 }
 
+static enum boost_class cpuboost_input_class(struct input_dev *dev)
+{
+	if (test_bit(ABS_MT_POSITION_X, dev->absbit) ||
+	    test_bit(BTN_TOUCH, dev->keybit))
+		return BOOST_TOUCH;
+	if (test_bit(EV_KEY, dev->evbit))
+		return BOOST_KEY;
+	return BOOST_SENSOR;
+}
+
 static int cpuboost_input_connect(struct input_handler *handler,
 		struct input_dev *dev, const struct input_device_id *id)
 {
+	struct cpuboost_handle *h;
 	struct input_handle *handle;
 	int error;
 
-	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
-	if (!handle)
+	h = kzalloc(sizeof(struct cpuboost_handle), GFP_KERNEL);
+	if (!h)
 		return -ENOMEM;
 
+	h->class = cpuboost_input_class(dev);
+	handle = &h->handle;
 	handle->dev = dev;
 	handle->handler = handler;
 	handle->name = "cpufreq";
@@ -416,7 +611,7 @@ static int cpuboost_input_connect(struct input_handler *handler,
 err1:
 	input_unregister_handle(handle);
 err2:
-	kfree(handle);
+	kfree(h);
 	return error;
 }
 
@@ -424,7 +619,7 @@ static void cpuboost_input_disconnect(struct input_handle *handle)
 {
 	input_close_device(handle);
 	input_unregister_handle(handle);
-	kfree(handle);
+	kfree(container_of(handle, struct cpuboost_handle, handle));
 }
 
 static const struct input_device_id cpuboost_ids[] = {
@@ -443,6 +638,14 @@ static const struct input_device_id cpuboost_ids[] = {
 		.absbit = { [BIT_WORD(ABS_X)] =
 			BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
 	}, /* touchpad */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+	}, /* keys */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+	}, /* sensors */
 	{ },
 };
 
@@ -464,11 +667,10 @@ static int cpuboost_cpu_callback(struct notifier_block *cpu_nb,
 		break;
 	case CPU_ONLINE:
 		if (suspended || !hotplug_boost || !input_boost_enabled ||
-		     work_pending(&input_boost_work))
+		     input_boost_pending())
 			break;
 		pr_debug("Hotplug boost for CPU%d\n", (int)hcpu);
-		queue_work(cpu_boost_wq, &input_boost_work);
-		last_input_time = ktime_to_us(ktime_get());
+		queue_input_boost(BOOST_TOUCH);
 		break;
 	default:
 		break;
@@ -483,11 +685,10 @@ static struct notifier_block __refdata cpu_nblk = {
 static void __wakeup_boost(void)
 {
 	if (!wakeup_boost || !input_boost_enabled ||
-	     work_pending(&input_boost_work))
+	     input_boost_pending())
 		return;
 	pr_debug("Wakeup boost for display on event.\n");
-	queue_work(cpu_boost_wq, &input_boost_work);
-	last_input_time = ktime_to_us(ktime_get());
+	queue_input_boost(BOOST_TOUCH);
 }
 
 #ifdef CONFIG_STATE_NOTIFIER
@@ -512,6 +713,7 @@ static int state_notifier_callback(struct notifier_block *this,
 
 static int cpu_boost_init(void)
 {
+	struct sched_param boost_param = { .sched_priority = MAX_RT_PRIO - 1 };
 	int cpu, ret;
 	struct cpu_sync *s;
 
@@ -519,16 +721,24 @@ static int cpu_boost_init(void)
 	if (!cpu_boost_wq)
 		return -EFAULT;
 
-	INIT_WORK(&input_boost_work, do_input_boost);
 	INIT_DELAYED_WORK(&input_boost_rem, do_input_boost_rem);
 
+	input_boost_task = kthread_run(kthread_worker_fn, &input_boost_worker,
+				       "input_boost");
+	if (IS_ERR(input_boost_task)) {
+		destroy_workqueue(cpu_boost_wq);
+		input_boost_task = NULL;
+		return -EFAULT;
+	}
+	sched_setscheduler(input_boost_task, SCHED_FIFO, &boost_param);
+
 	for_each_possible_cpu(cpu) {
 		s = &per_cpu(sync_info, cpu);
 		s->cpu = cpu;
 		spin_lock_init(&s->lock);
 		INIT_DELAYED_WORK(&s->boost_rem, do_boost_rem);
 	}
-	cpufreq_register_notifier(&boost_adjust_nb, CPUFREQ_POLICY_NOTIFIER);
+	cpufreq_limit_register(&boost_limit);
 	atomic_notifier_chain_register(&migration_notifier_head,
 					&boost_migration_nb);
 
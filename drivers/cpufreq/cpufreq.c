@@ -119,6 +119,7 @@ static void handle_update(struct work_struct *work);
  * The mutex locks both lists.
  */
 static BLOCKING_NOTIFIER_HEAD(cpufreq_policy_notifier_list);
+static ATOMIC_NOTIFIER_HEAD(cpufreq_frame_notifier_list);
 static struct srcu_notifier_head cpufreq_transition_notifier_list;
 
 static bool init_cpufreq_transition_notifier_list_called;
@@ -1450,12 +1451,14 @@ static struct syscore_ops cpufreq_syscore_ops = {
 /**
  *	cpufreq_register_notifier - register a driver with cpufreq
  *	@nb: notifier function to register
- *      @list: CPUFREQ_TRANSITION_NOTIFIER or CPUFREQ_POLICY_NOTIFIER
+ *      @list: CPUFREQ_TRANSITION_NOTIFIER, CPUFREQ_POLICY_NOTIFIER or
+ *             CPUFREQ_FRAME_NOTIFIER
  *
- *	Add a driver to one of two lists: either a list of drivers that
+ *	Add a driver to one of three lists: either a list of drivers that
  *      are notified about clock rate changes (once before and once after
- *      the transition), or a list of drivers that are notified about
- *      changes in cpufreq policy.
+ *      the transition), a list of drivers that are notified about
+ *      changes in cpufreq policy, or a list of governors that are told
+ *      about display frames that missed or are about to miss a vsync.
  *
  *	This function may sleep, and has the same return conditions as
  *	blocking_notifier_chain_register.
@@ -1475,6 +1478,10 @@ int cpufreq_register_notifier(struct notifier_block *nb, unsigned int list)
 		ret = blocking_notifier_chain_register(
 				&cpufreq_policy_notifier_list, nb);
 		break;
+	case CPUFREQ_FRAME_NOTIFIER:
+		ret = atomic_notifier_chain_register(
+				&cpufreq_frame_notifier_list, nb);
+		break;
 	default:
 		ret = -EINVAL;
 	}
@@ -1507,6 +1514,10 @@ int cpufreq_unregister_notifier(struct notifier_block *nb, unsigned int list)
 		ret = blocking_notifier_chain_unregister(
 				&cpufreq_policy_notifier_list, nb);
 		break;
+	case CPUFREQ_FRAME_NOTIFIER:
+		ret = atomic_notifier_chain_unregister(
+				&cpufreq_frame_notifier_list, nb);
+		break;
 	default:
 		ret = -EINVAL;
 	}
@@ -1515,6 +1526,20 @@ int cpufreq_unregister_notifier(struct notifier_block *nb, unsigned int list)
 }
 EXPORT_SYMBOL(cpufreq_unregister_notifier);
 
+/**
+ *	cpufreq_notify_frame - tell governors about display frame timing
+ *	@event: CPUFREQ_FRAME_LATE, CPUFREQ_FRAME_BURST or CPUFREQ_FRAME_ON_TIME
+ *	@deadline_us: time until the next frame is due
+ *
+ *	May be called from interrupt context.
+ */
+void cpufreq_notify_frame(unsigned long event, unsigned int deadline_us)
+{
+	atomic_notifier_call_chain(&cpufreq_frame_notifier_list, event,
+				   &deadline_us);
+}
+EXPORT_SYMBOL(cpufreq_notify_frame);
+
 
 /*********************************************************************
  *                              GOVERNORS                            *
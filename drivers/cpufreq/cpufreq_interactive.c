@@ -19,6 +19,7 @@
 #include <linux/cpu.h>
 #include <linux/cpumask.h>
 #include <linux/cpufreq.h>
+#include <linux/irq_work.h>
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/rwsem.h>
@@ -54,6 +55,7 @@ struct cpufreq_interactive_cpuinfo {
 	struct rw_semaphore enable_sem;
 	int governor_enabled;
 	int prev_load;
+	struct irq_work sched_work;
 };
 
 static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
@@ -97,6 +99,15 @@ static unsigned long min_sample_time = DEFAULT_MIN_SAMPLE_TIME;
 #define DEFAULT_TIMER_RATE (20 * USEC_PER_MSEC)
 static unsigned long timer_rate = DEFAULT_TIMER_RATE;
 
+/*
+ * When non-zero, the scheduler asks for a re-evaluation as soon as the
+ * nr_running of a cpu crosses this value, and the timer only runs every
+ * safety_timer_rate to catch load changes that do not cross it.
+ */
+static struct sched_nr_hook sched_nr_hook;
+#define DEFAULT_SAFETY_TIMER_RATE (4 * DEFAULT_TIMER_RATE)
+static unsigned long safety_timer_rate = DEFAULT_SAFETY_TIMER_RATE;
+
 /* Busy SDF parameters*/
 #define MIN_BUSY_TIME (100 * USEC_PER_MSEC)
 
@@ -118,6 +129,16 @@ static int boostpulse_duration_val = DEFAULT_MIN_SAMPLE_TIME;
 /* End time of boost pulse in ktime converted to usecs */
 static u64 boostpulse_endtime;
 
+/* Non-zero means boost on late or back to back display frames */
+static int frame_boost_val = 1;
+/* End time of the current frame boost in ktime converted to usecs */
+static u64 frameboost_endtime;
+/* A frame boost is in effect and no frame has made its vsync since */
+static bool frame_boost_pending;
+static unsigned int frame_boosts;
+static unsigned int frame_boost_rescued;
+static DEFINE_SPINLOCK(frame_boost_lock);
+
 static bool boosted;
 
 /*
@@ -175,6 +196,11 @@ static inline cputime64_t get_cpu_idle_time(unsigned int cpu,
 	return idle_time;
 }
 
+static inline unsigned long sample_rate(void)
+{
+	return sched_nr_hook.threshold ? safety_timer_rate : timer_rate;
+}
+
 static void cpufreq_interactive_timer_resched(
 	struct cpufreq_interactive_cpuinfo *pcpu)
 {
@@ -187,7 +213,7 @@ static void cpufreq_interactive_timer_resched(
 				     &pcpu->time_in_idle_timestamp);
 	pcpu->cputime_speedadj = 0;
 	pcpu->cputime_speedadj_timestamp = pcpu->time_in_idle_timestamp;
-	expires = jiffies + usecs_to_jiffies(timer_rate);
+	expires = jiffies + usecs_to_jiffies(sample_rate());
 	mod_timer_pinned(&pcpu->cpu_timer, expires);
 
 	if (timer_slack_val >= 0 && pcpu->target_freq > pcpu->policy->min) {
@@ -205,7 +231,7 @@ static void cpufreq_interactive_timer_resched(
 static void cpufreq_interactive_timer_start(int cpu)
 {
 	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
-	unsigned long expires = jiffies + usecs_to_jiffies(timer_rate);
+	unsigned long expires = jiffies + usecs_to_jiffies(sample_rate());
 	unsigned long flags;
 
 	pcpu->cpu_timer.expires = expires;
@@ -413,7 +439,8 @@ static void cpufreq_interactive_timer(unsigned long data)
 	loadadjfreq = (unsigned int)cputime_speedadj * 100;
 	cpu_load = loadadjfreq / pcpu->target_freq;
 	pcpu->prev_load = cpu_load;
-	boosted = boost_val || now < boostpulse_endtime;
+	boosted = boost_val || now < boostpulse_endtime ||
+		now < frameboost_endtime;
 
 	if (cpu_load >= go_hispeed_load || boosted) {
 		if (pcpu->target_freq < hispeed_freq) {
@@ -534,6 +561,37 @@ exit:
 	return;
 }
 
+/*
+ * Runs on the cpu whose nr_running crossed the threshold, outside of its
+ * rq->lock. Pull the sampling timer in to the next tick so the load is
+ * evaluated from the usual timer context.
+ */
+static void cpufreq_interactive_sched_work(struct irq_work *work)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu =
+		container_of(work, struct cpufreq_interactive_cpuinfo,
+			     sched_work);
+
+	if (!down_read_trylock(&pcpu->enable_sem))
+		return;
+	if (pcpu->governor_enabled)
+		mod_timer_pinned(&pcpu->cpu_timer, jiffies);
+	up_read(&pcpu->enable_sem);
+}
+
+static void cpufreq_interactive_sched_hook(struct sched_nr_hook *hook,
+					   int cpu, unsigned long nr)
+{
+	/*
+	 * Wakeups of remote cpus are enqueued by the target itself, so
+	 * this mostly skips load balancing, which the timer still sees.
+	 */
+	if (cpu != smp_processor_id())
+		return;
+
+	irq_work_queue(&per_cpu(cpuinfo, cpu).sched_work);
+}
+
 static void cpufreq_interactive_idle_start(void)
 {
 	int cpu = smp_processor_id();
@@ -748,6 +806,52 @@ static struct notifier_block cpufreq_notifier_block = {
 	.notifier_call = cpufreq_interactive_notifier,
 };
 
+static int cpufreq_interactive_frame_notifier(
+	struct notifier_block *nb, unsigned long val, void *data)
+{
+	unsigned int deadline_us = *(unsigned int *)data;
+	unsigned long flags;
+	bool boost = false;
+	u64 now;
+
+	if (!frame_boost_val)
+		return 0;
+
+	spin_lock_irqsave(&frame_boost_lock, flags);
+	switch (val) {
+	case CPUFREQ_FRAME_LATE:
+	case CPUFREQ_FRAME_BURST:
+		now = ktime_to_us(ktime_get());
+		if (now + deadline_us > frameboost_endtime)
+			frameboost_endtime = now + deadline_us;
+		if (!frame_boost_pending) {
+			frame_boost_pending = true;
+			frame_boosts++;
+			boost = true;
+		}
+		break;
+	case CPUFREQ_FRAME_ON_TIME:
+		if (frame_boost_pending) {
+			frame_boost_pending = false;
+			frame_boost_rescued++;
+		}
+		break;
+	}
+	spin_unlock_irqrestore(&frame_boost_lock, flags);
+
+	if (boost) {
+		trace_cpufreq_interactive_boost("frame");
+		if (!boosted)
+			cpufreq_interactive_boost();
+	}
+
+	return 0;
+}
+
+static struct notifier_block cpufreq_frame_notifier_block = {
+	.notifier_call = cpufreq_interactive_frame_notifier,
+};
+
 static unsigned int *get_tokenized_data(const char *buf, int *num_tokens)
 {
 	const char *cp;
@@ -1018,6 +1122,52 @@ static ssize_t store_timer_rate(struct kobject *kobj,
 static struct global_attr timer_rate_attr = __ATTR(timer_rate, 0644,
 		show_timer_rate, store_timer_rate);
 
+static ssize_t show_sched_nr_threshold(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", sched_nr_hook.threshold);
+}
+
+static ssize_t store_sched_nr_threshold(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	sched_nr_hook.threshold = val;
+	return count;
+}
+
+static struct global_attr sched_nr_threshold_attr =
+	__ATTR(sched_nr_threshold, 0644,
+		show_sched_nr_threshold, store_sched_nr_threshold);
+
+static ssize_t show_safety_timer_rate(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", safety_timer_rate);
+}
+
+static ssize_t store_safety_timer_rate(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	safety_timer_rate = val;
+	return count;
+}
+
+static struct global_attr safety_timer_rate_attr =
+	__ATTR(safety_timer_rate, 0644,
+		show_safety_timer_rate, store_safety_timer_rate);
+
 static ssize_t show_timer_slack(
 	struct kobject *kobj, struct attribute *attr, char *buf)
 {
@@ -1115,6 +1265,46 @@ static ssize_t store_boostpulse_duration(
 
 define_one_global_rw(boostpulse_duration);
 
+static ssize_t show_frame_boost(struct kobject *kobj, struct attribute *attr,
+				char *buf)
+{
+	return sprintf(buf, "%d\n", frame_boost_val);
+}
+
+static ssize_t store_frame_boost(struct kobject *kobj, struct attribute *attr,
+				 const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	frame_boost_val = val;
+	if (!frame_boost_val)
+		frameboost_endtime = 0;
+	return count;
+}
+
+define_one_global_rw(frame_boost);
+
+static ssize_t show_frame_boosts(struct kobject *kobj, struct attribute *attr,
+				 char *buf)
+{
+	return sprintf(buf, "%u\n", frame_boosts);
+}
+
+define_one_global_ro(frame_boosts);
+
+static ssize_t show_frame_boost_rescued(struct kobject *kobj,
+					struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", frame_boost_rescued);
+}
+
+define_one_global_ro(frame_boost_rescued);
+
 static ssize_t show_io_is_busy(struct kobject *kobj,
 			struct attribute *attr, char *buf)
 {
@@ -1215,10 +1405,15 @@ static struct attribute *interactive_attributes[] = {
 	&go_lowspeed_load_attr.attr,
 	&min_sample_time_attr.attr,
 	&timer_rate_attr.attr,
+	&sched_nr_threshold_attr.attr,
+	&safety_timer_rate_attr.attr,
 	&timer_slack.attr,
 	&boost.attr,
 	&boostpulse.attr,
 	&boostpulse_duration.attr,
+	&frame_boost.attr,
+	&frame_boosts.attr,
+	&frame_boost_rescued.attr,
 	&io_is_busy_attr.attr,
 	&sampling_down_factor_attr.attr,
 	&sync_freq_attr.attr,
@@ -1322,6 +1517,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			cpufreq_interactive_timer_start(j);
 			pcpu->governor_enabled = 1;
 			up_write(&pcpu->enable_sem);
+			sched_set_nr_hook(j, &sched_nr_hook);
 		}
 
 		/*
@@ -1343,6 +1539,8 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		idle_notifier_register(&cpufreq_interactive_idle_nb);
 		cpufreq_register_notifier(
 			&cpufreq_notifier_block, CPUFREQ_TRANSITION_NOTIFIER);
+		cpufreq_register_notifier(
+			&cpufreq_frame_notifier_block, CPUFREQ_FRAME_NOTIFIER);
 		mutex_unlock(&gov_lock);
 		break;
 
@@ -1350,8 +1548,12 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		kthread_stop(speedchange_task);
 		put_task_struct(speedchange_task);
 		mutex_lock(&gov_lock);
+		for_each_cpu(j, policy->cpus)
+			sched_set_nr_hook(j, NULL);
+		synchronize_sched();
 		for_each_cpu(j, policy->cpus) {
 			pcpu = &per_cpu(cpuinfo, j);
+			irq_work_sync(&pcpu->sched_work);
 			down_write(&pcpu->enable_sem);
 			pcpu->governor_enabled = 0;
 			pcpu->target_freq = 0;
@@ -1365,6 +1567,8 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			return 0;
 		}
 
+		cpufreq_unregister_notifier(
+			&cpufreq_frame_notifier_block, CPUFREQ_FRAME_NOTIFIER);
 		cpufreq_unregister_notifier(
 			&cpufreq_notifier_block, CPUFREQ_TRANSITION_NOTIFIER);
 		idle_notifier_unregister(&cpufreq_interactive_idle_nb);
@@ -1425,6 +1629,13 @@ struct cpufreq_governor cpufreq_gov_interactive = {
 
 static int __init cpufreq_interactive_init(void)
 {
+	unsigned int i;
+
+	sched_nr_hook.func = cpufreq_interactive_sched_hook;
+	for_each_possible_cpu(i)
+		init_irq_work(&per_cpu(cpuinfo, i).sched_work,
+			      cpufreq_interactive_sched_work);
+
 	return cpufreq_register_governor(&cpufreq_gov_interactive);
 }
 
@@ -0,0 +1,257 @@
+/*
+ *  drivers/cpufreq/cpufreq_limit.c
+ *
+ *  Resolves the frequency floors and ceilings requested by in-kernel
+ *  clients (thermal mitigation, boosting, limiters) into one limit per
+ *  cpu.
+ *
+ *  Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Every client used to carry its own policy notifier and to call
+ * cpufreq_update_policy() whenever its own request moved, whether or
+ * not that changed what the policy ended up with. Clients now file
+ * their request here instead; the policy is re-evaluated only when the
+ * resolved limit of a cpu changes, and a single CPUFREQ_INCOMPATIBLE
+ * notifier applies it. debugfs cpufreq_limits shows every request and
+ * which client owns the effective floor and ceiling.
+ */
+
+#define pr_fmt(fmt) "cpufreq_limit: " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+struct limit_cpu {
+	unsigned int min;
+	unsigned int max;
+	const char *min_owner;
+	const char *max_owner;
+	unsigned long updates;
+	unsigned long skipped;
+};
+
+static LIST_HEAD(limit_list);
+static DEFINE_MUTEX(limit_mutex);
+static struct limit_cpu limit_cpu[NR_CPUS] = {
+	[0 ... NR_CPUS - 1] = {
+		.max = UINT_MAX,
+	},
+};
+
+/*
+ * Recompute the effective limit of @cpu from all requests. Returns true
+ * if it changed. Called with limit_mutex held.
+ */
+static bool limit_resolve(unsigned int cpu)
+{
+	struct limit_cpu *lc = &limit_cpu[cpu];
+	struct cpufreq_limit *l;
+	unsigned int min = 0, max = UINT_MAX;
+	const char *min_owner = NULL, *max_owner = NULL;
+
+	list_for_each_entry(l, &limit_list, node) {
+		if (l->min[cpu] > min) {
+			min = l->min[cpu];
+			min_owner = l->name;
+		}
+		if (l->max[cpu] < max) {
+			max = l->max[cpu];
+			max_owner = l->name;
+		}
+	}
+
+	/* A ceiling is a protection, a floor only a preference */
+	if (min > max) {
+		min = max;
+		min_owner = max_owner;
+	}
+
+	if (min == lc->min && max == lc->max) {
+		lc->skipped++;
+		return false;
+	}
+
+	lc->min = min;
+	lc->max = max;
+	lc->min_owner = min_owner;
+	lc->max_owner = max_owner;
+	lc->updates++;
+
+	pr_debug("cpu%u: min %u kHz (%s) max %u kHz (%s)\n", cpu,
+		 min, min_owner ? min_owner : "none",
+		 max, max_owner ? max_owner : "none");
+
+	return true;
+}
+
+static int limit_apply(unsigned int cpu)
+{
+	/* An offline cpu picks the limit up when its policy comes back */
+	if (!cpu_online(cpu))
+		return 0;
+
+	return cpufreq_update_policy(cpu);
+}
+
+/**
+ * cpufreq_limit_register() : Add a client. Its request starts out
+ *                            unrestricted on every cpu.
+ */
+int cpufreq_limit_register(struct cpufreq_limit *limit)
+{
+	unsigned int cpu;
+
+	for (cpu = 0; cpu < NR_CPUS; cpu++) {
+		limit->min[cpu] = 0;
+		limit->max[cpu] = UINT_MAX;
+	}
+
+	mutex_lock(&limit_mutex);
+	list_add_tail(&limit->node, &limit_list);
+	mutex_unlock(&limit_mutex);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpufreq_limit_register);
+
+/**
+ * cpufreq_limit_unregister() : Drop a client and release its request.
+ */
+void cpufreq_limit_unregister(struct cpufreq_limit *limit)
+{
+	unsigned int cpu;
+	cpumask_t changed;
+
+	cpumask_clear(&changed);
+
+	mutex_lock(&limit_mutex);
+	list_del(&limit->node);
+	for_each_possible_cpu(cpu)
+		if (limit_resolve(cpu))
+			cpumask_set_cpu(cpu, &changed);
+	mutex_unlock(&limit_mutex);
+
+	for_each_cpu(cpu, &changed)
+		limit_apply(cpu);
+}
+EXPORT_SYMBOL_GPL(cpufreq_limit_unregister);
+
+/**
+ * cpufreq_limit_set() : Update the request of @limit for @cpu.
+ * @min : Floor in kHz, 0 for none.
+ * @max : Ceiling in kHz, UINT_MAX for none.
+ *
+ * The policy of @cpu is re-evaluated only if the effective limit
+ * changed as a result. Must be called from process context.
+ */
+int cpufreq_limit_set(struct cpufreq_limit *limit, unsigned int cpu,
+		      unsigned int min, unsigned int max)
+{
+	bool changed;
+
+	if (cpu >= nr_cpu_ids)
+		return -EINVAL;
+
+	mutex_lock(&limit_mutex);
+	if (limit->min[cpu] == min && limit->max[cpu] == max) {
+		limit_cpu[cpu].skipped++;
+		mutex_unlock(&limit_mutex);
+		return 0;
+	}
+	limit->min[cpu] = min;
+	limit->max[cpu] = max;
+	changed = limit_resolve(cpu);
+	mutex_unlock(&limit_mutex);
+
+	return changed ? limit_apply(cpu) : 0;
+}
+EXPORT_SYMBOL_GPL(cpufreq_limit_set);
+
+static int limit_policy_notify(struct notifier_block *nb,
+			       unsigned long event, void *data)
+{
+	struct cpufreq_policy *policy = data;
+	struct limit_cpu *lc = &limit_cpu[policy->cpu];
+
+	/*
+	 * Applied last so that no CPUFREQ_ADJUST notifier can lift a
+	 * ceiling again.
+	 */
+	if (event != CPUFREQ_INCOMPATIBLE)
+		return NOTIFY_OK;
+
+	cpufreq_verify_within_limits(policy, ACCESS_ONCE(lc->min),
+				     ACCESS_ONCE(lc->max));
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block limit_policy_nb = {
+	.notifier_call = limit_policy_notify,
+};
+
+static int limit_debugfs_show(struct seq_file *m, void *unused)
+{
+	struct cpufreq_limit *l;
+	struct limit_cpu *lc;
+	unsigned int cpu;
+
+	mutex_lock(&limit_mutex);
+	for_each_possible_cpu(cpu) {
+		lc = &limit_cpu[cpu];
+		seq_printf(m, "cpu%u: min %u (%s) max %u (%s) "
+			   "updates %lu skipped %lu\n", cpu,
+			   lc->min, lc->min_owner ? lc->min_owner : "none",
+			   lc->max, lc->max_owner ? lc->max_owner : "none",
+			   lc->updates, lc->skipped);
+		list_for_each_entry(l, &limit_list, node)
+			seq_printf(m, "\t%-16s %u %u\n", l->name,
+				   l->min[cpu], l->max[cpu]);
+	}
+	mutex_unlock(&limit_mutex);
+
+	return 0;
+}
+
+static int limit_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, limit_debugfs_show, inode->i_private);
+}
+
+static const struct file_operations limit_debugfs_fops = {
+	.open		= limit_debugfs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init cpufreq_limit_init(void)
+{
+	return cpufreq_register_notifier(&limit_policy_nb,
+					 CPUFREQ_POLICY_NOTIFIER);
+}
+core_initcall(cpufreq_limit_init);
+
+static int __init cpufreq_limit_debugfs_init(void)
+{
+	debugfs_create_file("cpufreq_limits", S_IRUGO, NULL, NULL,
+			    &limit_debugfs_fops);
+	return 0;
+}
+late_initcall(cpufreq_limit_debugfs_init);
@@ -0,0 +1,723 @@
+/*
+ *  drivers/cpufreq/cpufreq_replay.c
+ *
+ *  Replays recorded per-cpu load traces against the active cpufreq
+ *  governor and reports how well it served them.
+ *
+ *  Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * A trace is a list of work items, one per line, written to
+ * debugfs cpufreq_replay/trace:
+ *
+ *	<cpu> <release_us> <work_us> <deadline_us>
+ *
+ * release_us is when the item becomes runnable, relative to the start of
+ * the replay, and must not decrease for a given cpu. work_us is the cpu
+ * time the item needs at the highest frequency of the cpu's frequency
+ * table; at lower frequencies it takes proportionally longer. deadline_us
+ * is relative to release_us, 0 meaning none. Gaps between items are idle.
+ *
+ * One thread per cpu executes the items in release order while the
+ * governor under test picks frequencies as usual; the harness follows
+ * the transitions and integrates a power model over the busy time.
+ */
+
+#define pr_fmt(fmt) "cpufreq_replay: " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/kthread.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+
+/* Busy loop granularity; preemption is off for one chunk at a time */
+#define REPLAY_CHUNK_US		50
+/* Longest single sleep, so that a stop request is noticed quickly */
+#define REPLAY_MAX_SLEEP_US	100000
+#define REPLAY_MAX_ITEMS	65536
+#define REPLAY_MAX_POWER	32
+
+struct replay_item {
+	u32 release_us;
+	u32 work_us;
+	u32 deadline_us;
+};
+
+struct replay_cpu {
+	unsigned int cpu;
+	struct replay_item *items;
+	unsigned int nr_items;
+	unsigned int max_items;
+	struct task_struct *task;
+	unsigned int max_freq;
+	unsigned int cur_freq;
+
+	/* results of the last replay, protected by lock */
+	spinlock_t lock;
+	unsigned int done;
+	unsigned int missed;
+	unsigned int transitions;
+	u64 busy_us;
+	u64 over_budget_us;
+	u64 energy_nj;
+	u64 end_us;
+};
+
+struct replay_power {
+	unsigned int freq;
+	unsigned int mw;
+};
+
+static DEFINE_PER_CPU(struct replay_cpu, replay_cpu);
+static DEFINE_MUTEX(replay_mutex);
+static struct dentry *replay_dir;
+
+static struct replay_power replay_power[REPLAY_MAX_POWER];
+static unsigned int replay_nr_power;
+
+/* Power model used when no table has been written, see replay_model() */
+static unsigned int max_mw = 1000;
+module_param(max_mw, uint, 0644);
+
+static unsigned int idle_mw;
+module_param(idle_mw, uint, 0644);
+
+static atomic_t replay_running = ATOMIC_INIT(0);
+static ktime_t replay_start;
+static char replay_governor[CPUFREQ_NAME_LEN];
+
+static u64 replay_elapsed_us(void)
+{
+	return ktime_us_delta(ktime_get(), replay_start);
+}
+
+static unsigned int replay_mw(unsigned int freq)
+{
+	unsigned int i, mw;
+
+	if (!replay_nr_power)
+		return 0;
+
+	mw = replay_power[0].mw;
+	for (i = 0; i < replay_nr_power; i++) {
+		if (replay_power[i].freq > freq)
+			break;
+		mw = replay_power[i].mw;
+	}
+
+	return mw;
+}
+
+/*
+ * Without a measured table, assume dynamic power grows with the cube of
+ * the frequency (voltage scaling roughly with frequency), reaching max_mw
+ * at the top of the table.
+ */
+static void replay_model(struct cpufreq_frequency_table *table,
+			 unsigned int fmax)
+{
+	unsigned int i;
+	u64 mw;
+
+	replay_nr_power = 0;
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END &&
+	     replay_nr_power < REPLAY_MAX_POWER; i++) {
+		if (table[i].frequency == CPUFREQ_ENTRY_INVALID)
+			continue;
+		mw = (u64)max_mw * table[i].frequency;
+		do_div(mw, fmax);
+		mw *= table[i].frequency;
+		do_div(mw, fmax);
+		mw *= table[i].frequency;
+		do_div(mw, fmax);
+		replay_power[replay_nr_power].freq = table[i].frequency;
+		replay_power[replay_nr_power].mw = mw;
+		replay_nr_power++;
+	}
+}
+
+static unsigned int replay_table_max(struct cpufreq_frequency_table *table)
+{
+	unsigned int i, fmax = 0;
+
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++)
+		if (table[i].frequency != CPUFREQ_ENTRY_INVALID)
+			fmax = max(fmax, table[i].frequency);
+
+	return fmax;
+}
+
+static void replay_run_item(struct replay_cpu *rc,
+			    const struct replay_item *item)
+{
+	s64 left_ns = (s64)item->work_us * NSEC_PER_USEC;
+	unsigned int freq, mw;
+	unsigned long flags;
+	u64 end, due;
+
+	while (left_ns > 0 && !kthread_should_stop()) {
+		preempt_disable();
+		freq = rc->cur_freq;
+		udelay(REPLAY_CHUNK_US);
+		preempt_enable();
+
+		left_ns -= div_u64((u64)REPLAY_CHUNK_US * NSEC_PER_USEC * freq,
+				   rc->max_freq);
+		mw = replay_mw(freq);
+
+		spin_lock_irqsave(&rc->lock, flags);
+		rc->busy_us += REPLAY_CHUNK_US;
+		rc->energy_nj += (u64)REPLAY_CHUNK_US * mw;
+		spin_unlock_irqrestore(&rc->lock, flags);
+
+		cond_resched();
+	}
+
+	if (left_ns > 0)
+		return;
+
+	end = replay_elapsed_us();
+	due = (u64)item->release_us + item->deadline_us;
+
+	spin_lock_irqsave(&rc->lock, flags);
+	rc->done++;
+	if (item->deadline_us && end > due) {
+		rc->missed++;
+		rc->over_budget_us += end - due;
+	}
+	spin_unlock_irqrestore(&rc->lock, flags);
+}
+
+static int replay_thread(void *data)
+{
+	struct replay_cpu *rc = data;
+	const struct replay_item *item;
+	unsigned int i = 0;
+	u64 now, wait;
+
+	while (i < rc->nr_items && !kthread_should_stop()) {
+		item = &rc->items[i];
+		now = replay_elapsed_us();
+		if (now < item->release_us) {
+			wait = min_t(u64, item->release_us - now,
+				     REPLAY_MAX_SLEEP_US);
+			usleep_range(wait, wait + REPLAY_CHUNK_US);
+			continue;
+		}
+		replay_run_item(rc, item);
+		i++;
+	}
+
+	rc->end_us = replay_elapsed_us();
+	atomic_dec(&replay_running);
+
+	return 0;
+}
+
+static int replay_transition(struct notifier_block *nb, unsigned long val,
+			     void *data)
+{
+	struct cpufreq_freqs *freq = data;
+	struct replay_cpu *rc = &per_cpu(replay_cpu, freq->cpu);
+	unsigned long flags;
+
+	if (val != CPUFREQ_POSTCHANGE)
+		return 0;
+
+	rc->cur_freq = freq->new;
+	if (rc->task) {
+		spin_lock_irqsave(&rc->lock, flags);
+		rc->transitions++;
+		spin_unlock_irqrestore(&rc->lock, flags);
+	}
+
+	return 0;
+}
+
+static struct notifier_block replay_transition_nb = {
+	.notifier_call = replay_transition,
+};
+
+static void replay_stop(void)
+{
+	unsigned int cpu;
+	struct replay_cpu *rc;
+
+	for_each_possible_cpu(cpu) {
+		rc = &per_cpu(replay_cpu, cpu);
+		if (!rc->task)
+			continue;
+		kthread_stop(rc->task);
+		put_task_struct(rc->task);
+		rc->task = NULL;
+	}
+}
+
+static int replay_start_cpu(struct replay_cpu *rc)
+{
+	struct cpufreq_frequency_table *table;
+	struct cpufreq_policy policy;
+
+	if (!cpu_online(rc->cpu)) {
+		pr_err("cpu%u has a trace but is offline\n", rc->cpu);
+		return -ENODEV;
+	}
+
+	table = cpufreq_frequency_get_table(rc->cpu);
+	if (!table || cpufreq_get_policy(&policy, rc->cpu)) {
+		pr_err("cpu%u has no frequency table\n", rc->cpu);
+		return -ENODEV;
+	}
+
+	rc->max_freq = replay_table_max(table);
+	if (!rc->max_freq)
+		return -ENODEV;
+	rc->cur_freq = policy.cur;
+	if (!replay_nr_power)
+		replay_model(table, rc->max_freq);
+	if (!replay_governor[0] && policy.governor)
+		strlcpy(replay_governor, policy.governor->name,
+			CPUFREQ_NAME_LEN);
+
+	rc->done = rc->missed = rc->transitions = 0;
+	rc->busy_us = rc->over_budget_us = rc->energy_nj = 0;
+	rc->end_us = 0;
+
+	rc->task = kthread_create(replay_thread, rc, "cpufreq_replay/%u",
+				  rc->cpu);
+	if (IS_ERR(rc->task)) {
+		int ret = PTR_ERR(rc->task);
+
+		rc->task = NULL;
+		return ret;
+	}
+	get_task_struct(rc->task);
+	kthread_bind(rc->task, rc->cpu);
+
+	return 0;
+}
+
+static int replay_start_all(void)
+{
+	unsigned int cpu;
+	struct replay_cpu *rc;
+	int ret = 0;
+
+	if (atomic_read(&replay_running))
+		return -EBUSY;
+
+	replay_stop();
+	replay_governor[0] = '\0';
+
+	get_online_cpus();
+	for_each_possible_cpu(cpu) {
+		rc = &per_cpu(replay_cpu, cpu);
+		if (!rc->nr_items)
+			continue;
+		ret = replay_start_cpu(rc);
+		if (ret)
+			break;
+	}
+
+	if (ret) {
+		put_online_cpus();
+		replay_stop();
+		return ret;
+	}
+
+	replay_start = ktime_get();
+	for_each_possible_cpu(cpu) {
+		rc = &per_cpu(replay_cpu, cpu);
+		if (!rc->task)
+			continue;
+		atomic_inc(&replay_running);
+		wake_up_process(rc->task);
+	}
+	put_online_cpus();
+
+	return 0;
+}
+
+static void replay_clear(void)
+{
+	unsigned int cpu;
+	struct replay_cpu *rc;
+
+	replay_stop();
+	for_each_possible_cpu(cpu) {
+		rc = &per_cpu(replay_cpu, cpu);
+		kfree(rc->items);
+		rc->items = NULL;
+		rc->nr_items = rc->max_items = 0;
+	}
+}
+
+static int replay_add_item(unsigned int cpu, const struct replay_item *item)
+{
+	struct replay_cpu *rc = &per_cpu(replay_cpu, cpu);
+	struct replay_item *items;
+	unsigned int size;
+
+	if (rc->nr_items &&
+	    item->release_us < rc->items[rc->nr_items - 1].release_us)
+		return -EINVAL;
+
+	if (rc->nr_items == rc->max_items) {
+		if (rc->max_items >= REPLAY_MAX_ITEMS)
+			return -ENOSPC;
+		size = rc->max_items ? rc->max_items * 2 : 64;
+		items = krealloc(rc->items, size * sizeof(*items), GFP_KERNEL);
+		if (!items)
+			return -ENOMEM;
+		rc->items = items;
+		rc->max_items = size;
+	}
+
+	rc->items[rc->nr_items++] = *item;
+
+	return 0;
+}
+
+static char *replay_copy_buf(const char __user *ubuf, size_t count)
+{
+	char *buf;
+
+	if (count >= PAGE_SIZE)
+		return ERR_PTR(-E2BIG);
+
+	buf = kmalloc(count + 1, GFP_KERNEL);
+	if (!buf)
+		return ERR_PTR(-ENOMEM);
+
+	if (copy_from_user(buf, ubuf, count)) {
+		kfree(buf);
+		return ERR_PTR(-EFAULT);
+	}
+	buf[count] = '\0';
+
+	return buf;
+}
+
+/* Each write must hold whole lines; '#' starts a comment line */
+static ssize_t replay_trace_write(struct file *file, const char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	struct replay_item item;
+	char *buf, *line, *cur;
+	unsigned int cpu;
+	int ret = 0;
+
+	buf = replay_copy_buf(ubuf, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	mutex_lock(&replay_mutex);
+	if (atomic_read(&replay_running)) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	cur = buf;
+	while ((line = strsep(&cur, "\n")) != NULL) {
+		line = skip_spaces(line);
+		if (!*line || *line == '#')
+			continue;
+		if (sscanf(line, "%u %u %u %u", &cpu, &item.release_us,
+			   &item.work_us, &item.deadline_us) != 4 ||
+		    cpu >= nr_cpu_ids || !cpu_possible(cpu)) {
+			ret = -EINVAL;
+			break;
+		}
+		ret = replay_add_item(cpu, &item);
+		if (ret)
+			break;
+	}
+out:
+	mutex_unlock(&replay_mutex);
+	kfree(buf);
+
+	return ret ? ret : count;
+}
+
+static int replay_trace_show(struct seq_file *m, void *unused)
+{
+	unsigned int cpu;
+	struct replay_cpu *rc;
+
+	mutex_lock(&replay_mutex);
+	for_each_possible_cpu(cpu) {
+		rc = &per_cpu(replay_cpu, cpu);
+		if (rc->nr_items)
+			seq_printf(m, "cpu%u: %u items, last release %u us\n",
+				   cpu, rc->nr_items,
+				   rc->items[rc->nr_items - 1].release_us);
+	}
+	mutex_unlock(&replay_mutex);
+
+	return 0;
+}
+
+static int replay_trace_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, replay_trace_show, inode->i_private);
+}
+
+static const struct file_operations replay_trace_fops = {
+	.open		= replay_trace_open,
+	.read		= seq_read,
+	.write		= replay_trace_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * Space separated <freq_khz>:<mw> pairs in ascending frequency order.
+ * An empty write goes back to the cubic model.
+ */
+static ssize_t replay_power_write(struct file *file, const char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	struct replay_power power[REPLAY_MAX_POWER];
+	unsigned int n = 0;
+	char *buf, *tok, *cur;
+	int ret = 0;
+
+	buf = replay_copy_buf(ubuf, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	cur = buf;
+	while ((tok = strsep(&cur, " \t\n")) != NULL) {
+		if (!*tok)
+			continue;
+		if (n == REPLAY_MAX_POWER ||
+		    sscanf(tok, "%u:%u", &power[n].freq, &power[n].mw) != 2 ||
+		    (n && power[n].freq <= power[n - 1].freq)) {
+			ret = -EINVAL;
+			break;
+		}
+		n++;
+	}
+
+	if (!ret) {
+		mutex_lock(&replay_mutex);
+		if (atomic_read(&replay_running)) {
+			ret = -EBUSY;
+		} else {
+			memcpy(replay_power, power, n * sizeof(*power));
+			replay_nr_power = n;
+		}
+		mutex_unlock(&replay_mutex);
+	}
+	kfree(buf);
+
+	return ret ? ret : count;
+}
+
+static int replay_power_show(struct seq_file *m, void *unused)
+{
+	unsigned int i;
+
+	mutex_lock(&replay_mutex);
+	for (i = 0; i < replay_nr_power; i++)
+		seq_printf(m, "%u:%u\n", replay_power[i].freq,
+			   replay_power[i].mw);
+	mutex_unlock(&replay_mutex);
+
+	return 0;
+}
+
+static int replay_power_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, replay_power_show, inode->i_private);
+}
+
+static const struct file_operations replay_power_fops = {
+	.open		= replay_power_open,
+	.read		= seq_read,
+	.write		= replay_power_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* "start", "stop" or "clear" */
+static ssize_t replay_control_write(struct file *file,
+				    const char __user *ubuf, size_t count,
+				    loff_t *ppos)
+{
+	char *buf;
+	int ret;
+
+	buf = replay_copy_buf(ubuf, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	mutex_lock(&replay_mutex);
+	if (sysfs_streq(buf, "start")) {
+		ret = replay_start_all();
+	} else if (sysfs_streq(buf, "stop")) {
+		replay_stop();
+		ret = 0;
+	} else if (sysfs_streq(buf, "clear")) {
+		replay_clear();
+		ret = 0;
+	} else {
+		ret = -EINVAL;
+	}
+	mutex_unlock(&replay_mutex);
+	kfree(buf);
+
+	return ret ? ret : count;
+}
+
+static int replay_control_show(struct seq_file *m, void *unused)
+{
+	seq_printf(m, "%s\n", atomic_read(&replay_running) ?
+		   "running" : "idle");
+
+	return 0;
+}
+
+static int replay_control_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, replay_control_show, inode->i_private);
+}
+
+static const struct file_operations replay_control_fops = {
+	.open		= replay_control_open,
+	.read		= seq_read,
+	.write		= replay_control_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int replay_results_show(struct seq_file *m, void *unused)
+{
+	unsigned int cpu, done = 0, missed = 0, items = 0;
+	u64 over = 0, energy = 0, duration = 0, busy, idle, cpu_energy;
+	bool running = atomic_read(&replay_running);
+	struct replay_cpu *rc;
+	unsigned long flags;
+
+	mutex_lock(&replay_mutex);
+	if (running)
+		duration = replay_elapsed_us();
+
+	seq_printf(m, "governor: %s\n", replay_governor[0] ?
+		   replay_governor : "none");
+	seq_printf(m, "state: %s\n", running ? "running" : "idle");
+
+	for_each_possible_cpu(cpu) {
+		rc = &per_cpu(replay_cpu, cpu);
+		if (!rc->nr_items)
+			continue;
+
+		spin_lock_irqsave(&rc->lock, flags);
+		busy = rc->busy_us;
+		idle = rc->end_us > busy ? rc->end_us - busy : 0;
+		/* mW * us = nJ */
+		cpu_energy = rc->energy_nj + idle * idle_mw;
+		seq_printf(m, "cpu%u: items=%u done=%u missed=%u over_budget_us=%llu busy_us=%llu energy_uj=%llu transitions=%u\n",
+			   cpu, rc->nr_items, rc->done, rc->missed,
+			   rc->over_budget_us, busy,
+			   div_u64(cpu_energy, 1000), rc->transitions);
+		items += rc->nr_items;
+		done += rc->done;
+		missed += rc->missed;
+		over += rc->over_budget_us;
+		energy += cpu_energy;
+		if (!running)
+			duration = max(duration, rc->end_us);
+		spin_unlock_irqrestore(&rc->lock, flags);
+	}
+
+	seq_printf(m, "total: items=%u done=%u missed=%u over_budget_us=%llu energy_uj=%llu duration_us=%llu\n",
+		   items, done, missed, over, div_u64(energy, 1000), duration);
+	mutex_unlock(&replay_mutex);
+
+	return 0;
+}
+
+static int replay_results_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, replay_results_show, inode->i_private);
+}
+
+static const struct file_operations replay_results_fops = {
+	.open		= replay_results_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init cpufreq_replay_init(void)
+{
+	unsigned int cpu;
+	struct replay_cpu *rc;
+	int ret;
+
+	for_each_possible_cpu(cpu) {
+		rc = &per_cpu(replay_cpu, cpu);
+		rc->cpu = cpu;
+		spin_lock_init(&rc->lock);
+	}
+
+	replay_dir = debugfs_create_dir("cpufreq_replay", NULL);
+	if (IS_ERR_OR_NULL(replay_dir))
+		return -ENODEV;
+
+	if (!debugfs_create_file("trace", S_IRUGO | S_IWUSR, replay_dir,
+				 NULL, &replay_trace_fops) ||
+	    !debugfs_create_file("power", S_IRUGO | S_IWUSR, replay_dir,
+				 NULL, &replay_power_fops) ||
+	    !debugfs_create_file("control", S_IRUGO | S_IWUSR, replay_dir,
+				 NULL, &replay_control_fops) ||
+	    !debugfs_create_file("results", S_IRUGO, replay_dir,
+				 NULL, &replay_results_fops)) {
+		debugfs_remove_recursive(replay_dir);
+		return -ENOMEM;
+	}
+
+	ret = cpufreq_register_notifier(&replay_transition_nb,
+					CPUFREQ_TRANSITION_NOTIFIER);
+	if (ret)
+		debugfs_remove_recursive(replay_dir);
+
+	return ret;
+}
+
+static void __exit cpufreq_replay_exit(void)
+{
+	debugfs_remove_recursive(replay_dir);
+	cpufreq_unregister_notifier(&replay_transition_nb,
+				    CPUFREQ_TRANSITION_NOTIFIER);
+	mutex_lock(&replay_mutex);
+	replay_clear();
+	mutex_unlock(&replay_mutex);
+}
+
+MODULE_DESCRIPTION("cpufreq governor trace replay harness");
+MODULE_LICENSE("GPL v2");
+
+module_init(cpufreq_replay_init);
+module_exit(cpufreq_replay_exit);
@@ -24,6 +24,9 @@
 #include <linux/err.h>
 #include <linux/of.h>
 #include <linux/sched.h>
+#include <linux/hashtable.h>
+#include <linux/proc_fs.h>
+#include <linux/vmalloc.h>
 #include <asm/cputime.h>
 
 static spinlock_t cpufreq_stats_lock;
@@ -140,6 +143,299 @@ static int get_index_all_cpufreq_stat(struct all_cpufreq_stats *all_stat,
 	return -1;
 }
 
+#ifdef CONFIG_CPU_FREQ_STAT_UID
+/*
+ * Per-UID residency. Frequencies get a slot in uid_freqs the first time
+ * any cpu runs at them and keep it, so the per-UID arrays never need to
+ * be reordered. Each cpu collects its ticks in a small batch keyed by
+ * (uid, frequency slot) and only takes uid_stats_lock to fold the batch
+ * into the UID table when it fills up or the table is read.
+ */
+#define UID_STATS_MAX_FREQS	64
+#define UID_STATS_BATCH		16
+#define UID_STATS_HASH_BITS	8
+
+#define UID_STATS_MAGIC		0x46444955	/* "UIDF" */
+#define UID_STATS_VERSION	1
+
+struct uid_stats_entry {
+	uid_t uid;
+	unsigned int nr_freqs;
+	u64 energy;
+	u64 *time_us;
+	struct hlist_node hash;
+};
+
+struct uid_stats_slot {
+	uid_t uid;
+	unsigned int index;
+	u64 time_us;
+	u64 energy;
+};
+
+struct uid_stats_batch {
+	spinlock_t lock;
+	unsigned int nr;
+	struct uid_stats_slot slot[UID_STATS_BATCH];
+};
+
+static DEFINE_SPINLOCK(uid_stats_lock);
+static DEFINE_HASHTABLE(uid_stats_table, UID_STATS_HASH_BITS);
+static unsigned int uid_stats_nr_uids;
+static unsigned int uid_freqs[UID_STATS_MAX_FREQS];
+static unsigned int uid_nr_freqs;
+
+static DEFINE_PER_CPU(int, uid_freq_index) = -1;
+static DEFINE_PER_CPU(struct uid_stats_batch, uid_stats_batch);
+
+static void uid_stats_set_freq(unsigned int cpu, unsigned int freq)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&uid_stats_lock, flags);
+	for (i = 0; i < uid_nr_freqs; i++)
+		if (uid_freqs[i] == freq)
+			break;
+	if (i == uid_nr_freqs) {
+		if (uid_nr_freqs < UID_STATS_MAX_FREQS)
+			uid_freqs[uid_nr_freqs++] = freq;
+		else
+			i = -1;
+	}
+	per_cpu(uid_freq_index, cpu) = i;
+	spin_unlock_irqrestore(&uid_stats_lock, flags);
+}
+
+/* Called with uid_stats_lock held */
+static struct uid_stats_entry *uid_stats_get(uid_t uid)
+{
+	struct uid_stats_entry *e;
+	struct hlist_node *node;
+
+	hash_for_each_possible(uid_stats_table, e, node, hash, uid)
+		if (e->uid == uid)
+			return e;
+
+	e = kzalloc(sizeof(*e), GFP_ATOMIC);
+	if (!e)
+		return NULL;
+	e->uid = uid;
+	hash_add(uid_stats_table, &e->hash, uid);
+	uid_stats_nr_uids++;
+
+	return e;
+}
+
+/* Called with the batch lock and uid_stats_lock held */
+static void uid_stats_fold(struct uid_stats_batch *b)
+{
+	struct uid_stats_slot *s;
+	struct uid_stats_entry *e;
+	u64 *time_us;
+	unsigned int i;
+
+	for (i = 0; i < b->nr; i++) {
+		s = &b->slot[i];
+		e = uid_stats_get(s->uid);
+		if (!e)
+			continue;
+		if (s->index >= e->nr_freqs) {
+			time_us = krealloc(e->time_us,
+					   uid_nr_freqs * sizeof(u64),
+					   GFP_ATOMIC);
+			if (!time_us)
+				continue;
+			memset(time_us + e->nr_freqs, 0,
+			       (uid_nr_freqs - e->nr_freqs) * sizeof(u64));
+			e->time_us = time_us;
+			e->nr_freqs = uid_nr_freqs;
+		}
+		e->time_us[s->index] += s->time_us;
+		e->energy += s->energy;
+	}
+	b->nr = 0;
+}
+
+static void uid_stats_account(struct task_struct *task, unsigned int cpu,
+			      unsigned int usecs, unsigned int curr)
+{
+	struct uid_stats_batch *b = &per_cpu(uid_stats_batch, cpu);
+	int index = per_cpu(uid_freq_index, cpu);
+	uid_t uid = task_uid(task);
+	struct uid_stats_slot *s;
+	unsigned long flags;
+	unsigned int i;
+
+	if (index < 0)
+		return;
+
+	spin_lock_irqsave(&b->lock, flags);
+	for (i = 0; i < b->nr; i++) {
+		s = &b->slot[i];
+		if (s->uid == uid && s->index == index)
+			goto add;
+	}
+
+	if (b->nr == UID_STATS_BATCH) {
+		spin_lock(&uid_stats_lock);
+		uid_stats_fold(b);
+		spin_unlock(&uid_stats_lock);
+	}
+	s = &b->slot[b->nr++];
+	s->uid = uid;
+	s->index = index;
+	s->time_us = 0;
+	s->energy = 0;
+add:
+	s->time_us += usecs;
+	s->energy += (u64)curr * usecs;
+	spin_unlock_irqrestore(&b->lock, flags);
+}
+
+/*
+ * /proc/uid_cpufreq_stats, native endian:
+ *
+ *	u32 magic, version, nr_freqs, nr_uids
+ *	u32 freq_khz[nr_freqs]
+ *	u32 padding, if nr_freqs is odd
+ *	nr_uids times:
+ *		u32 uid, reserved
+ *		u64 energy		(current-in-state units * usecs)
+ *		u64 time_us[nr_freqs]
+ */
+struct uid_stats_snapshot {
+	size_t size;
+	char data[0];
+};
+
+static size_t uid_stats_hdr_size(unsigned int nr_freqs)
+{
+	return ALIGN((4 + nr_freqs) * sizeof(u32), sizeof(u64));
+}
+
+static size_t uid_stats_size(unsigned int nr_freqs, unsigned int nr_uids)
+{
+	return uid_stats_hdr_size(nr_freqs) +
+		nr_uids * (2 * sizeof(u32) + (1 + nr_freqs) * sizeof(u64));
+}
+
+static void uid_stats_fill(char *p, unsigned int nr_freqs,
+			   unsigned int nr_uids)
+{
+	struct uid_stats_entry *e;
+	struct hlist_node *node;
+	unsigned long bkt;
+	u32 *hdr = (u32 *)p;
+	u64 *time_us;
+	unsigned int i;
+
+	hdr[0] = UID_STATS_MAGIC;
+	hdr[1] = UID_STATS_VERSION;
+	hdr[2] = nr_freqs;
+	hdr[3] = nr_uids;
+	memcpy(hdr + 4, uid_freqs, nr_freqs * sizeof(u32));
+	if (nr_freqs & 1)
+		hdr[4 + nr_freqs] = 0;
+	p += uid_stats_hdr_size(nr_freqs);
+
+	hash_for_each(uid_stats_table, bkt, node, e, hash) {
+		hdr = (u32 *)p;
+		hdr[0] = e->uid;
+		hdr[1] = 0;
+		time_us = (u64 *)(hdr + 2);
+		time_us[0] = e->energy;
+		for (i = 0; i < nr_freqs; i++)
+			time_us[1 + i] = i < e->nr_freqs ? e->time_us[i] : 0;
+		p += 2 * sizeof(u32) + (1 + nr_freqs) * sizeof(u64);
+	}
+}
+
+static int uid_stats_open(struct inode *inode, struct file *file)
+{
+	struct uid_stats_snapshot *snap = NULL;
+	struct uid_stats_batch *b;
+	unsigned int cpu, nr_freqs, nr_uids;
+	unsigned long flags;
+	size_t size;
+
+	for_each_possible_cpu(cpu) {
+		b = &per_cpu(uid_stats_batch, cpu);
+		spin_lock_irqsave(&b->lock, flags);
+		spin_lock(&uid_stats_lock);
+		uid_stats_fold(b);
+		spin_unlock(&uid_stats_lock);
+		spin_unlock_irqrestore(&b->lock, flags);
+	}
+
+	/* The table may grow while the buffer is allocated; retry then */
+	for (;;) {
+		spin_lock_irqsave(&uid_stats_lock, flags);
+		nr_freqs = uid_nr_freqs;
+		nr_uids = uid_stats_nr_uids;
+		size = uid_stats_size(nr_freqs, nr_uids);
+		if (snap && snap->size == size)
+			break;
+		spin_unlock_irqrestore(&uid_stats_lock, flags);
+
+		vfree(snap);
+		snap = vmalloc(sizeof(*snap) + size);
+		if (!snap)
+			return -ENOMEM;
+		snap->size = size;
+	}
+	uid_stats_fill(snap->data, nr_freqs, nr_uids);
+	spin_unlock_irqrestore(&uid_stats_lock, flags);
+
+	file->private_data = snap;
+	return 0;
+}
+
+static ssize_t uid_stats_read(struct file *file, char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	struct uid_stats_snapshot *snap = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, snap->data,
+				       snap->size);
+}
+
+static int uid_stats_release(struct inode *inode, struct file *file)
+{
+	vfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations uid_stats_fops = {
+	.open		= uid_stats_open,
+	.read		= uid_stats_read,
+	.llseek		= default_llseek,
+	.release	= uid_stats_release,
+};
+
+static void uid_stats_init(void)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu(uid_stats_batch, cpu).lock);
+
+	if (!proc_create("uid_cpufreq_stats", S_IRUGO, NULL, &uid_stats_fops))
+		pr_warn("Cannot create /proc/uid_cpufreq_stats\n");
+}
+
+static void uid_stats_exit(void)
+{
+	remove_proc_entry("uid_cpufreq_stats", NULL);
+}
+#else
+static inline void uid_stats_set_freq(unsigned int cpu, unsigned int freq) {}
+static inline void uid_stats_account(struct task_struct *task,
+		unsigned int cpu, unsigned int usecs, unsigned int curr) {}
+static inline void uid_stats_init(void) {}
+static inline void uid_stats_exit(void) {}
+#endif
+
 void acct_update_power(struct task_struct *task, cputime_t cputime) {
 	struct cpufreq_power_stats *powerstats;
 	struct cpufreq_stats *stats;
@@ -156,6 +452,7 @@ void acct_update_power(struct task_struct *task, cputime_t cputime) {
 	curr = powerstats->curr[stats->last_index];
 	if (task->cpu_power != ULLONG_MAX)
 		task->cpu_power += curr * cputime_to_usecs(cputime);
+	uid_stats_account(task, cpu_num, cputime_to_usecs(cputime), curr);
 }
 EXPORT_SYMBOL_GPL(acct_update_power);
 
@@ -425,6 +722,7 @@ static int cpufreq_stats_create_table(struct cpufreq_policy *policy,
 	stat->last_time = get_jiffies_64();
 	stat->last_index = freq_table_get_index(stat, policy->cur);
 	spin_unlock(&cpufreq_stats_lock);
+	uid_stats_set_freq(cpu, policy->cur);
 	cpufreq_cpu_put(data);
 	return 0;
 error_out:
@@ -640,6 +938,8 @@ static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 	if (old_index == new_index)
 		return 0;
 
+	uid_stats_set_freq(freq->cpu, freq->new);
+
 	spin_lock(&cpufreq_stats_lock);
 	stat->last_index = new_index;
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
@@ -763,6 +1063,8 @@ static int __init cpufreq_stats_init(void)
 	if (ret)
 		pr_warn("Cannot create sysfs file for cpufreq current stats\n");
 
+	uid_stats_init();
+
 	return 0;
 }
 static void __exit cpufreq_stats_exit(void)
@@ -780,6 +1082,7 @@ static void __exit cpufreq_stats_exit(void)
 	}
 	cpufreq_allstats_free();
 	cpufreq_powerstats_free();
+	uid_stats_exit();
 }
 
 MODULE_AUTHOR("Zou Nan hai <nanhai.zou@intel.com>");
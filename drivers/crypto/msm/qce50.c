@@ -2369,6 +2369,7 @@ static int _qce_sps_add_sg_data(struct qce_device *pce_dev,
 	uint32_t addr, data_cnt, len;
 	struct sps_iovec *iovec = sps_bam_pipe->iovec +
 						sps_bam_pipe->iovec_count;
+	struct sps_iovec *prev = NULL;
 
 	while (nbytes > 0) {
 		len = min(nbytes, sg_dma_len(sg_src));
@@ -2377,6 +2378,23 @@ static int _qce_sps_add_sg_data(struct qce_device *pce_dev,
 		if (pce_dev->ce_sps.minor_version == 0)
 			len = ALIGN(len, pce_dev->ce_sps.ce_burst_size);
 		while (len > 0) {
+			/*
+			 * Entries that continue the previous one, such as
+			 * the sectors of a multi sector cipher request, go
+			 * into the same descriptor. Burst aligned lengths
+			 * on minor version 0 may overrun an entry, so they
+			 * are kept apart.
+			 */
+			if (prev && pce_dev->ce_sps.minor_version &&
+			    prev->addr + prev->size == addr &&
+			    prev->size < SPS_MAX_PKT_SIZE) {
+				data_cnt = min_t(uint32_t, len,
+						SPS_MAX_PKT_SIZE - prev->size);
+				prev->size += data_cnt;
+				addr += data_cnt;
+				len -= data_cnt;
+				continue;
+			}
 			if (sps_bam_pipe->iovec_count == QCE_MAX_NUM_DSCR) {
 				pr_err("Num of descrptor %d exceed max (%d)",
 						sps_bam_pipe->iovec_count,
@@ -2394,6 +2412,7 @@ static int _qce_sps_add_sg_data(struct qce_device *pce_dev,
 				iovec->addr = addr;
 				iovec->flags = 0;
 			}
+			prev = iovec;
 			iovec++;
 			sps_bam_pipe->iovec_count++;
 			addr += data_cnt;
@@ -57,6 +57,16 @@
 
 #define QCRYPTO_HIGH_BANDWIDTH_TIMEOUT 1000
 
+/*
+ * AES ecb/cbc/ctr requests up to this many bytes are done in software;
+ * below it the engine setup, BAM round trip and completion tasklet cost
+ * more than the cipher itself. 0 sends everything to the engine.
+ */
+static unsigned int qcrypto_sw_threshold = 256;
+module_param_named(sw_threshold, qcrypto_sw_threshold, uint, 0644);
+MODULE_PARM_DESC(sw_threshold,
+	"Largest AES ecb/cbc/ctr request handled in software (bytes)");
+
 struct crypto_stat {
 	u32 aead_sha1_aes_enc;
 	u32 aead_sha1_aes_dec;
@@ -77,6 +87,7 @@ struct crypto_stat {
 	u32 ablk_cipher_3des_dec;
 	u32 ablk_cipher_op_success;
 	u32 ablk_cipher_op_fail;
+	u32 ablk_cipher_sw;
 	u32 sha1_digest;
 	u32 sha256_digest;
 	u32 sha_op_success;
@@ -244,6 +255,7 @@ struct qcrypto_cipher_ctx {
 	struct crypto_priv *cp;
 	unsigned int flags;
 	struct crypto_engine *pengine;  /* fixed engine assigned */
+	struct crypto_blkcipher *fallback; /* software path, small requests */
 };
 
 struct qcrypto_cipher_req_ctx {
@@ -645,6 +657,27 @@ static int _qcrypto_cra_ablkcipher_init(struct crypto_tfm *tfm)
 	return _qcrypto_cipher_cra_init(tfm);
 };
 
+static int _qcrypto_cra_aes_ablkcipher_init(struct crypto_tfm *tfm)
+{
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	const char *name = crypto_tfm_alg_name(tfm);
+	int ret;
+
+	ret = _qcrypto_cra_ablkcipher_init(tfm);
+	if (ret)
+		return ret;
+
+	if (!strncmp(name, "qcom-", strlen("qcom-")))
+		name += strlen("qcom-");
+
+	/* not fatal, everything just goes to the engine */
+	ctx->fallback = crypto_alloc_blkcipher(name, 0, CRYPTO_ALG_ASYNC);
+	if (IS_ERR(ctx->fallback))
+		ctx->fallback = NULL;
+
+	return 0;
+};
+
 static int _qcrypto_cra_aead_init(struct crypto_tfm *tfm)
 {
 	tfm->crt_aead.reqsize = sizeof(struct qcrypto_cipher_req_ctx);
@@ -659,6 +692,16 @@ static void _qcrypto_cra_ablkcipher_exit(struct crypto_tfm *tfm)
 		qcrypto_ce_bw_scaling_req(ctx->pengine, false);
 };
 
+static void _qcrypto_cra_aes_ablkcipher_exit(struct crypto_tfm *tfm)
+{
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	if (ctx->fallback)
+		crypto_free_blkcipher(ctx->fallback);
+	ctx->fallback = NULL;
+	_qcrypto_cra_ablkcipher_exit(tfm);
+};
+
 static void _qcrypto_cra_aead_exit(struct crypto_tfm *tfm)
 {
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
@@ -708,6 +751,9 @@ static int _disp_stats(int id)
 	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
 			"   ABLK CIPHER operation fail   : %d\n",
 					pstat->ablk_cipher_op_fail);
+	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   ABLK CIPHER done in software : %d\n",
+					pstat->ablk_cipher_sw);
 
 	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
 			"   AEAD SHA1-AES encryption      : %d\n",
@@ -889,6 +935,11 @@ static int _qcrypto_setkey_aes(struct crypto_ablkcipher *cipher, const u8 *key,
 				pr_err("%s Inavlid key pointer\n", __func__);
 				return -EINVAL;
 			}
+			if (ctx->fallback && crypto_blkcipher_setkey(
+						ctx->fallback, key, len)) {
+				crypto_free_blkcipher(ctx->fallback);
+				ctx->fallback = NULL;
+			}
 		}
 	}
 	return 0;
@@ -998,11 +1049,18 @@ static void req_done(unsigned long data)
 	pengine->req = NULL;
 	res = pengine->res;
 	spin_unlock_irqrestore(&cp->lock, flags);
+
+	/*
+	 * The engine has already handed back everything for areq, so give
+	 * it the next request before running the completion, which for
+	 * IPsec or dm-crypt tends to submit more work and take a while.
+	 */
+	_start_qcrypto_process(cp, pengine);
+
 	if (areq)
 		areq->complete(areq, res);
 	if (res)
 		pengine->err_req++;
-	_start_qcrypto_process(cp, pengine);
 };
 
 
@@ -1725,6 +1783,42 @@ static int _qcrypto_queue_req(struct crypto_priv *cp,
 	return ret;
 }
 
+static bool _qcrypto_use_sw(struct qcrypto_cipher_ctx *ctx,
+				unsigned int nbytes)
+{
+	return ctx->fallback && nbytes <= qcrypto_sw_threshold &&
+		ctx->enc_key_len &&
+		!(ctx->flags & (QCRYPTO_CTX_USE_HW_KEY |
+				QCRYPTO_CTX_USE_PIPE_KEY));
+}
+
+/* run a small request synchronously on the fallback, no engine involved */
+static int _qcrypto_ablk_sw_crypt(struct ablkcipher_request *req, bool enc)
+{
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct crypto_stat *pstat = &_qcrypto_stat;
+	struct blkcipher_desc desc;
+	int ret;
+
+	desc.tfm = ctx->fallback;
+	desc.info = req->info;
+	desc.flags = 0;
+
+	if (enc)
+		ret = crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+						  req->nbytes);
+	else
+		ret = crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+						  req->nbytes);
+
+	pstat->ablk_cipher_sw++;
+	if (ret)
+		pstat->ablk_cipher_op_fail++;
+	else
+		pstat->ablk_cipher_op_success++;
+	return ret;
+}
+
 static int _qcrypto_enc_aes_ecb(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
@@ -1746,6 +1840,8 @@ static int _qcrypto_enc_aes_ecb(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_ECB;
 
 	pstat->ablk_cipher_aes_enc++;
+	if (_qcrypto_use_sw(ctx, req->nbytes))
+		return _qcrypto_ablk_sw_crypt(req, true);
 	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
 };
 
@@ -1770,6 +1866,8 @@ static int _qcrypto_enc_aes_cbc(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CBC;
 
 	pstat->ablk_cipher_aes_enc++;
+	if (_qcrypto_use_sw(ctx, req->nbytes))
+		return _qcrypto_ablk_sw_crypt(req, true);
 	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
 };
 
@@ -1794,6 +1892,8 @@ static int _qcrypto_enc_aes_ctr(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CTR;
 
 	pstat->ablk_cipher_aes_enc++;
+	if (_qcrypto_use_sw(ctx, req->nbytes))
+		return _qcrypto_ablk_sw_crypt(req, true);
 	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
 };
 
@@ -1949,6 +2049,8 @@ static int _qcrypto_dec_aes_ecb(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_ECB;
 
 	pstat->ablk_cipher_aes_dec++;
+	if (_qcrypto_use_sw(ctx, req->nbytes))
+		return _qcrypto_ablk_sw_crypt(req, false);
 	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
 };
 
@@ -1974,6 +2076,8 @@ static int _qcrypto_dec_aes_cbc(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CBC;
 
 	pstat->ablk_cipher_aes_dec++;
+	if (_qcrypto_use_sw(ctx, req->nbytes))
+		return _qcrypto_ablk_sw_crypt(req, false);
 	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
 };
 
@@ -2000,6 +2104,8 @@ static int _qcrypto_dec_aes_ctr(struct ablkcipher_request *req)
 	rctx->dir = QCE_ENCRYPT;
 
 	pstat->ablk_cipher_aes_dec++;
+	if (_qcrypto_use_sw(ctx, req->nbytes))
+		return _qcrypto_ablk_sw_crypt(req, false);
 	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
 };
 
@@ -3466,8 +3572,8 @@ static struct crypto_alg _qcrypto_ablk_cipher_algos[] = {
 		.cra_alignmask	= 0,
 		.cra_type	= &crypto_ablkcipher_type,
 		.cra_module	= THIS_MODULE,
-		.cra_init	= _qcrypto_cra_ablkcipher_init,
-		.cra_exit	= _qcrypto_cra_ablkcipher_exit,
+		.cra_init	= _qcrypto_cra_aes_ablkcipher_init,
+		.cra_exit	= _qcrypto_cra_aes_ablkcipher_exit,
 		.cra_u		= {
 			.ablkcipher = {
 				.min_keysize	= AES_MIN_KEY_SIZE,
@@ -3488,8 +3594,8 @@ static struct crypto_alg _qcrypto_ablk_cipher_algos[] = {
 		.cra_alignmask	= 0,
 		.cra_type	= &crypto_ablkcipher_type,
 		.cra_module	= THIS_MODULE,
-		.cra_init	= _qcrypto_cra_ablkcipher_init,
-		.cra_exit	= _qcrypto_cra_ablkcipher_exit,
+		.cra_init	= _qcrypto_cra_aes_ablkcipher_init,
+		.cra_exit	= _qcrypto_cra_aes_ablkcipher_exit,
 		.cra_u		= {
 			.ablkcipher = {
 				.ivsize		= AES_BLOCK_SIZE,
@@ -3511,8 +3617,8 @@ static struct crypto_alg _qcrypto_ablk_cipher_algos[] = {
 		.cra_alignmask	= 0,
 		.cra_type	= &crypto_ablkcipher_type,
 		.cra_module	= THIS_MODULE,
-		.cra_init	= _qcrypto_cra_ablkcipher_init,
-		.cra_exit	= _qcrypto_cra_ablkcipher_exit,
+		.cra_init	= _qcrypto_cra_aes_ablkcipher_init,
+		.cra_exit	= _qcrypto_cra_aes_ablkcipher_exit,
 		.cra_u		= {
 			.ablkcipher = {
 				.ivsize		= AES_BLOCK_SIZE,
@@ -27,7 +27,12 @@
 #include <linux/interrupt.h>
 #include <linux/platform_device.h>
 #include <linux/of.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
 #include <linux/devfreq.h>
+#include <linux/perf_event.h>
 #include "governor.h"
 
 #include <mach/msm-krait-l2-accessors.h>
@@ -83,9 +88,28 @@ static unsigned int decay_rate = 90;
 static unsigned int io_percent = 16;
 static unsigned int bw_step = 190;
 
+/*
+ * In threshold mode the counters are still armed to interrupt once the
+ * traffic exceeds the current estimate, but the periodic sampling only
+ * runs every decay_ms to let the vote come back down.  An idle or steady
+ * memory load then costs no wakeups between interrupts.
+ */
+static unsigned int threshold_mode;
+static unsigned int decay_ms = 500;
+
+/*
+ * With cpufreq_boost set a cpu frequency increase re-measures the
+ * bandwidth before the switch and scales it by the frequency ratio, so
+ * that memory bound work does not have to wait for the next sample to
+ * get the bus bandwidth it will need at the higher frequency.
+ */
+static unsigned int cpufreq_boost = 1;
+static unsigned int boost_num, boost_den;
+
 #define MIN_MS	10U
 #define MAX_MS	500U
 static unsigned int sample_ms = 50;
+static struct devfreq *hw_df;
 static u32 prev_r_start_val;
 static u32 prev_w_start_val;
 static unsigned long prev_ab;
@@ -93,10 +117,19 @@ static ktime_t prev_ts;
 
 #define RD_MON	0
 #define WR_MON	1
+
+/* L2PMRESR2 groups 2 and 3 select the read/write beat events */
+#define MON_RESR	2
+#define MON_GROUPS	(BIT(2) | BIT(3))
+#define MON_CODE	0x0B
+
 static void mon_init(void)
 {
+	u32 regval;
+
 	/* Set up counters 0/1 to count write/read beats */
-	set_l2_indirect_reg(L2PMRESR2, 0x8B0B0000);
+	regval = get_l2_indirect_reg(L2PMRESR2) & 0xFFFF;
+	set_l2_indirect_reg(L2PMRESR2, regval | 0x8B0B0000);
 	set_l2_indirect_reg(L2PMnEVCNTCR(RD_MON), 0x0);
 	set_l2_indirect_reg(L2PMnEVCNTCR(WR_MON), 0x0);
 	set_l2_indirect_reg(L2PMnEVCNTR(RD_MON), 0xFFFFFFFF);
@@ -107,19 +140,6 @@ static void mon_init(void)
 	set_l2_indirect_reg(L2PMnEVTYPER(WR_MON), 0xB);
 }
 
-static void global_mon_enable(bool en)
-{
-	u32 regval;
-
-	/* Global counter enable */
-	regval = get_l2_indirect_reg(L2PMCR);
-	if (en)
-		regval |= BIT(0);
-	else
-		regval &= ~BIT(0);
-	set_l2_indirect_reg(L2PMCR, regval);
-}
-
 static void mon_enable(int n)
 {
 	/* Clear previous overflow state for event counter n */
@@ -184,18 +204,180 @@ unsigned int beats_to_mbps(long long beats, unsigned int us)
 
 static int to_limit(int mbps)
 {
+	/*
+	 * Traffic within the guard band never changes the vote; don't let
+	 * it raise interrupts when nothing else is waking us up.
+	 */
+	if (threshold_mode)
+		mbps = max_t(int, mbps, guard_band_mbps);
+
 	mbps *= (100 + tolerance_percent) * sample_ms;
 	mbps /= 100;
 	mbps = DIV_ROUND_UP(mbps, MSEC_PER_SEC);
 	return mbps;
 }
 
+/*
+ * Cortex-A7 has no L2PM. There the read and write traffic is L2 refills
+ * and write-backs, counted through each cpu's PMU with pinned perf events.
+ * Perf then shares the counters with "perf stat" and the governor needs
+ * no interrupt, so threshold mode is not available.
+ */
+#define A7_L2D_CACHE_REFILL	0x17
+#define A7_L2D_CACHE_WB		0x18
+
+static bool use_cpu_pmu;
+static struct perf_event *cpu_pmu_ev[NR_CPUS][2];
+static u64 cpu_pmu_last[NR_CPUS][2];
+/* counted on cpus that went offline since the last sample */
+static u64 cpu_pmu_gone[2];
+static bool cpu_pmu_running;
+static DEFINE_MUTEX(cpu_pmu_lock);
+
+static u64 cpu_pmu_read(int cpu, int n)
+{
+	u64 enabled, running, val, delta;
+
+	val = perf_event_read_value(cpu_pmu_ev[cpu][n], &enabled, &running);
+	delta = val - cpu_pmu_last[cpu][n];
+	cpu_pmu_last[cpu][n] = val;
+	return delta;
+}
+
+static void cpu_pmu_start_cpu(int cpu)
+{
+	struct perf_event_attr attr = {
+		.type		= PERF_TYPE_RAW,
+		.size		= sizeof(attr),
+		.pinned		= 1,
+	};
+	struct perf_event *ev;
+	int n;
+
+	for (n = RD_MON; n <= WR_MON; n++) {
+		attr.config = n == RD_MON ? A7_L2D_CACHE_REFILL :
+					    A7_L2D_CACHE_WB;
+		ev = perf_event_create_kernel_counter(&attr, cpu, NULL, NULL,
+						      NULL);
+		if (IS_ERR(ev)) {
+			pr_err("cpu%d: no PMU counter (%ld)\n", cpu,
+			       PTR_ERR(ev));
+			continue;
+		}
+		cpu_pmu_ev[cpu][n] = ev;
+		cpu_pmu_last[cpu][n] = 0;
+	}
+}
+
+static void cpu_pmu_stop_cpu(int cpu)
+{
+	int n;
+
+	for (n = RD_MON; n <= WR_MON; n++) {
+		if (!cpu_pmu_ev[cpu][n])
+			continue;
+		cpu_pmu_gone[n] += cpu_pmu_read(cpu, n);
+		perf_event_release_kernel(cpu_pmu_ev[cpu][n]);
+		cpu_pmu_ev[cpu][n] = NULL;
+	}
+}
+
+static int cpu_pmu_hotplug(struct notifier_block *nb, unsigned long action,
+			   void *hcpu)
+{
+	int cpu = (long)hcpu;
+
+	mutex_lock(&cpu_pmu_lock);
+	if (!cpu_pmu_running)
+		goto out;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_ONLINE:
+	case CPU_DOWN_FAILED:
+		cpu_pmu_start_cpu(cpu);
+		break;
+	case CPU_DOWN_PREPARE:
+		cpu_pmu_stop_cpu(cpu);
+		break;
+	}
+out:
+	mutex_unlock(&cpu_pmu_lock);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cpu_pmu_hotplug_nb = {
+	.notifier_call = cpu_pmu_hotplug,
+};
+
+static int cpu_pmu_start(void)
+{
+	int cpu;
+
+	get_online_cpus();
+	mutex_lock(&cpu_pmu_lock);
+	cpu_pmu_gone[RD_MON] = cpu_pmu_gone[WR_MON] = 0;
+	for_each_online_cpu(cpu)
+		cpu_pmu_start_cpu(cpu);
+	cpu_pmu_running = true;
+	mutex_unlock(&cpu_pmu_lock);
+	put_online_cpus();
+
+	return 0;
+}
+
+static void cpu_pmu_stop(void)
+{
+	int cpu;
+
+	get_online_cpus();
+	mutex_lock(&cpu_pmu_lock);
+	cpu_pmu_running = false;
+	for_each_online_cpu(cpu)
+		cpu_pmu_stop_cpu(cpu);
+	mutex_unlock(&cpu_pmu_lock);
+	put_online_cpus();
+}
+
+static unsigned long cpu_pmu_measure_bw(void)
+{
+	long beats[2], r_mbps, w_mbps;
+	unsigned int us;
+	ktime_t ts;
+	int cpu, n;
+
+	mutex_lock(&cpu_pmu_lock);
+	ts = ktime_get();
+	us = ktime_to_us(ktime_sub(ts, prev_ts));
+	if (!us)
+		us = 1;
+
+	for (n = RD_MON; n <= WR_MON; n++) {
+		beats[n] = cpu_pmu_gone[n];
+		cpu_pmu_gone[n] = 0;
+		for_each_online_cpu(cpu)
+			if (cpu_pmu_ev[cpu][n])
+				beats[n] += cpu_pmu_read(cpu, n);
+	}
+	prev_ts = ts;
+	mutex_unlock(&cpu_pmu_lock);
+
+	r_mbps = beats_to_mbps(beats[RD_MON], us);
+	w_mbps = beats_to_mbps(beats[WR_MON], us);
+	pr_debug("R/W/BW/us = %ld/%ld/%ld/%d\n", r_mbps, w_mbps,
+		 r_mbps + w_mbps, us);
+
+	return r_mbps + w_mbps;
+}
+
 unsigned long measure_bw_and_set_irq(void)
 {
 	long r_mbps, w_mbps, mbps;
 	ktime_t ts;
 	unsigned int us;
 
+	if (use_cpu_pmu)
+		return cpu_pmu_measure_bw();
+
 	/*
 	 * Since we are stopping the counters, we don't want this short work
 	 * to be interrupted by other tasks and cause the measurements to be
@@ -251,7 +433,158 @@ static void compute_bw(int mbps, unsigned long *freq, unsigned long *ab)
 	*freq = (new_bw * 100) / io_percent;
 }
 
+/*
+ * Time spent at each bandwidth level, broken down by the highest
+ * frequency of the online cpus.
+ */
+static struct cpufreq_frequency_table *cpu_freqs;
+static unsigned int nr_cpu_freqs;
+static u64 *residency;
+static ktime_t residency_ts;
+static unsigned int cur_cpu_freq[NR_CPUS];
+static DEFINE_SPINLOCK(residency_lock);
+
+static int cpu_freq_index(void)
+{
+	unsigned int cpu, freq = 0;
+	int i;
+
+	for_each_online_cpu(cpu)
+		freq = max(freq, cur_cpu_freq[cpu]);
+
+	for (i = nr_cpu_freqs - 1; i > 0; i--)
+		if (cpu_freqs[i].frequency <= freq)
+			break;
+
+	return i;
+}
+
+static void update_residency(struct devfreq *df)
+{
+	unsigned long flags;
+	ktime_t now;
+	int lev;
+
+	spin_lock_irqsave(&residency_lock, flags);
+	now = ktime_get();
+	lev = devfreq_get_freq_level(df, df->previous_freq);
+	if (residency && lev >= 0)
+		residency[cpu_freq_index() * df->profile->max_state + lev] +=
+			ktime_to_us(ktime_sub(now, residency_ts));
+	residency_ts = now;
+	spin_unlock_irqrestore(&residency_lock, flags);
+}
+
+static int residency_init(struct devfreq *df)
+{
+	struct cpufreq_frequency_table *table;
+	unsigned int cpu, i, n = 0;
+	u64 *res;
+
+	table = cpufreq_frequency_get_table(0);
+	if (!table || !df->profile->max_state)
+		return 0;
+
+	/* Drop invalid entries and keep the rows sorted */
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++)
+		n++;
+	cpu_freqs = kcalloc(n + 1, sizeof(*cpu_freqs), GFP_KERNEL);
+	if (!cpu_freqs)
+		return -ENOMEM;
+	nr_cpu_freqs = 0;
+	for (i = 0; i < n; i++) {
+		unsigned int f = table[i].frequency, j;
+
+		if (f == CPUFREQ_ENTRY_INVALID)
+			continue;
+		for (j = nr_cpu_freqs; j > 0 && cpu_freqs[j - 1].frequency > f;
+		     j--)
+			cpu_freqs[j] = cpu_freqs[j - 1];
+		cpu_freqs[j].frequency = f;
+		nr_cpu_freqs++;
+	}
+
+	if (!nr_cpu_freqs) {
+		kfree(cpu_freqs);
+		cpu_freqs = NULL;
+		return 0;
+	}
+
+	res = kcalloc(nr_cpu_freqs * df->profile->max_state, sizeof(*res),
+		      GFP_KERNEL);
+	if (!res) {
+		kfree(cpu_freqs);
+		cpu_freqs = NULL;
+		nr_cpu_freqs = 0;
+		return -ENOMEM;
+	}
+
+	for_each_possible_cpu(cpu)
+		cur_cpu_freq[cpu] = cpufreq_quick_get(cpu);
+
+	spin_lock_irq(&residency_lock);
+	residency = res;
+	residency_ts = ktime_get();
+	spin_unlock_irq(&residency_lock);
+
+	return 0;
+}
+
+static void residency_exit(void)
+{
+	u64 *res;
+
+	spin_lock_irq(&residency_lock);
+	res = residency;
+	residency = NULL;
+	spin_unlock_irq(&residency_lock);
+
+	kfree(res);
+	kfree(cpu_freqs);
+	cpu_freqs = NULL;
+	nr_cpu_freqs = 0;
+}
+
 #define TOO_SOON_US	(1 * USEC_PER_MSEC)
+
+static int cpufreq_trans_notifier(struct notifier_block *nb,
+				  unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freq = data;
+	struct devfreq *df = hw_df;
+	unsigned int us;
+
+	if (!df)
+		return 0;
+
+	if (val == CPUFREQ_POSTCHANGE) {
+		update_residency(df);
+		cur_cpu_freq[freq->cpu] = freq->new;
+		return 0;
+	}
+
+	if (val != CPUFREQ_PRECHANGE || !cpufreq_boost ||
+	    freq->new <= freq->old || !freq->old)
+		return 0;
+
+	mutex_lock(&df->lock);
+	us = ktime_to_us(ktime_sub(ktime_get(), prev_ts));
+	if (us > TOO_SOON_US) {
+		boost_num = freq->new;
+		boost_den = freq->old;
+		if (update_devfreq(df))
+			pr_err("Unable to update freq on cpufreq change!\n");
+		boost_num = boost_den = 0;
+	}
+	mutex_unlock(&df->lock);
+
+	return 0;
+}
+
+static struct notifier_block cpufreq_trans_nb = {
+	.notifier_call = cpufreq_trans_notifier,
+};
+
 static irqreturn_t mon_intr_handler(int irq, void *dev)
 {
 	struct devfreq *df = dev;
@@ -294,6 +627,12 @@ static int start_monitoring(struct devfreq *df)
 {
 	int ret, mbyte;
 
+	if (use_cpu_pmu) {
+		prev_ts = ktime_get();
+		prev_ab = 0;
+		return cpu_pmu_start();
+	}
+
 	ret = request_threaded_irq(l2pm_irq, NULL, mon_intr_handler,
 			  IRQF_ONESHOT | IRQF_SHARED,
 			  "cpubw_hwmon", df);
@@ -302,6 +641,15 @@ static int start_monitoring(struct devfreq *df)
 		return ret;
 	}
 
+	/* Keep the Krait L2 perf driver off our counters and event groups */
+	ret = krait_l2_pmu_reserve(BIT(RD_MON) | BIT(WR_MON), MON_RESR,
+				   MON_GROUPS, MON_CODE);
+	if (ret) {
+		pr_err("L2PM counters in use by perf\n");
+		free_irq(l2pm_irq, df);
+		return ret;
+	}
+
 	mon_init();
 	mon_disable(RD_MON);
 	mon_disable(WR_MON);
@@ -316,18 +664,22 @@ static int start_monitoring(struct devfreq *df)
 	mon_irq_enable(WR_MON, true);
 	mon_enable(RD_MON);
 	mon_enable(WR_MON);
-	global_mon_enable(true);
 
 	return 0;
 }
 
 static void stop_monitoring(struct devfreq *df)
 {
-	global_mon_enable(false);
+	if (use_cpu_pmu) {
+		cpu_pmu_stop();
+		return;
+	}
+
 	mon_disable(RD_MON);
 	mon_disable(WR_MON);
 	mon_irq_enable(RD_MON, false);
 	mon_irq_enable(WR_MON, false);
+	krait_l2_pmu_release(BIT(RD_MON) | BIT(WR_MON), MON_RESR, MON_GROUPS);
 
 	disable_irq(l2pm_irq);
 	free_irq(l2pm_irq, df);
@@ -339,17 +691,91 @@ static int devfreq_cpubw_hwmon_get_freq(struct devfreq *df,
 {
 	unsigned long mbps;
 
+	update_residency(df);
+
 	mbps = measure_bw_and_set_irq();
+	if (boost_den)
+		mbps = mult_frac(mbps, boost_num, boost_den);
 	compute_bw(mbps, freq, df->data);
 
 	return 0;
 }
 
+static void apply_poll_interval(struct devfreq *df)
+{
+	devfreq_monitor_stop(df);
+	df->profile->polling_ms = threshold_mode ? decay_ms : sample_ms;
+	devfreq_monitor_start(df);
+}
+
+static ssize_t show_threshold_mode(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", threshold_mode);
+}
+
+static ssize_t store_threshold_mode(struct device *dev,
+			struct device_attribute *attr, const char *buf,
+			size_t count)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u", &val) != 1)
+		return -EINVAL;
+	if (val && use_cpu_pmu)
+		return -EINVAL;
+
+	threshold_mode = !!val;
+	apply_poll_interval(to_devfreq(dev));
+
+	return count;
+}
+static DEVICE_ATTR(threshold_mode, 0644, show_threshold_mode,
+		   store_threshold_mode);
+
+static ssize_t show_cpufreq_residency(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct devfreq *df = to_devfreq(dev);
+	unsigned int max_state = df->profile->max_state;
+	ssize_t len = 0;
+	unsigned int i, j;
+
+	update_residency(df);
+
+	spin_lock_irq(&residency_lock);
+	if (!residency)
+		goto out;
+
+	len += scnprintf(buf + len, PAGE_SIZE - len, "%10s", "cpu\\bw");
+	for (j = 0; j < max_state; j++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%10lu",
+				 df->profile->freq_table[j]);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+
+	for (i = 0; i < nr_cpu_freqs; i++) {
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%10u",
+				 cpu_freqs[i].frequency);
+		for (j = 0; j < max_state; j++)
+			len += scnprintf(buf + len, PAGE_SIZE - len, "%10llu",
+				div_u64(residency[i * max_state + j],
+					USEC_PER_MSEC));
+		len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+	}
+out:
+	spin_unlock_irq(&residency_lock);
+
+	return len;
+}
+static DEVICE_ATTR(cpufreq_residency, 0444, show_cpufreq_residency, NULL);
+
 gov_attr(tolerance_percent, 0U, 30U);
 gov_attr(guard_band_mbps, 0U, 2000U);
 gov_attr(decay_rate, 0U, 100U);
 gov_attr(io_percent, 1U, 100U);
 gov_attr(bw_step, 50U, 1000U);
+gov_attr(decay_ms, MIN_MS, 5000U);
+gov_attr(cpufreq_boost, 0U, 1U);
 
 static struct attribute *dev_attr[] = {
 	&dev_attr_tolerance_percent.attr,
@@ -357,6 +783,10 @@ static struct attribute *dev_attr[] = {
 	&dev_attr_decay_rate.attr,
 	&dev_attr_io_percent.attr,
 	&dev_attr_bw_step.attr,
+	&dev_attr_threshold_mode.attr,
+	&dev_attr_decay_ms.attr,
+	&dev_attr_cpufreq_boost.attr,
+	&dev_attr_cpufreq_residency.attr,
 	NULL,
 };
 
@@ -382,7 +812,14 @@ static int devfreq_cpubw_hwmon_ev_handler(struct devfreq *df,
 		sample_ms = df->profile->polling_ms;
 		sample_ms = max(MIN_MS, sample_ms);
 		sample_ms = min(MAX_MS, sample_ms);
-		df->profile->polling_ms = sample_ms;
+		df->profile->polling_ms = threshold_mode ? decay_ms : sample_ms;
+
+		ret = residency_init(df);
+		if (ret)
+			pr_warn("No cpufreq residency table (%d)\n", ret);
+		hw_df = df;
+		cpufreq_register_notifier(&cpufreq_trans_nb,
+					  CPUFREQ_TRANSITION_NOTIFIER);
 		devfreq_monitor_start(df);
 
 		pr_debug("Enabled CPU BW HW monitor governor\n");
@@ -390,7 +827,11 @@ static int devfreq_cpubw_hwmon_ev_handler(struct devfreq *df,
 
 	case DEVFREQ_GOV_STOP:
 		sysfs_remove_group(&df->dev.kobj, &dev_attr_group);
+		cpufreq_unregister_notifier(&cpufreq_trans_nb,
+					    CPUFREQ_TRANSITION_NOTIFIER);
+		hw_df = NULL;
 		devfreq_monitor_stop(df);
+		residency_exit();
 		*(unsigned long *)df->data = 0;
 		stop_monitoring(df);
 		pr_debug("Disabled CPU BW HW monitor governor\n");
@@ -400,7 +841,10 @@ static int devfreq_cpubw_hwmon_ev_handler(struct devfreq *df,
 		sample_ms = *(unsigned int *)data;
 		sample_ms = max(MIN_MS, sample_ms);
 		sample_ms = min(MAX_MS, sample_ms);
-		devfreq_interval_update(df, &sample_ms);
+		if (threshold_mode)
+			apply_poll_interval(df);
+		else
+			devfreq_interval_update(df, &sample_ms);
 		break;
 	}
 
@@ -418,10 +862,16 @@ static int cpubw_hwmon_driver_probe(struct platform_device *pdev)
 	struct device *dev = &pdev->dev;
 	int ret;
 
-	l2pm_irq = platform_get_irq(pdev, 0);
-	if (l2pm_irq < 0) {
-		pr_err("Unable to get IRQ number\n");
-		return l2pm_irq;
+	use_cpu_pmu = of_device_is_compatible(dev->of_node,
+					      "qcom,cpubw-cpu-pmu");
+	if (use_cpu_pmu) {
+		register_cpu_notifier(&cpu_pmu_hotplug_nb);
+	} else {
+		l2pm_irq = platform_get_irq(pdev, 0);
+		if (l2pm_irq < 0) {
+			pr_err("Unable to get IRQ number\n");
+			return l2pm_irq;
+		}
 	}
 
 	ret = of_property_read_u32(dev->of_node, "qcom,bytes-per-beat",
@@ -442,6 +892,7 @@ static int cpubw_hwmon_driver_probe(struct platform_device *pdev)
 
 static struct of_device_id match_table[] = {
 	{ .compatible = "qcom,kraitbw-l2pm" },
+	{ .compatible = "qcom,cpubw-cpu-pmu" },
 	{}
 };
 
@@ -0,0 +1,326 @@
+/* Copyright (c) 2010-2013, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include <linux/errno.h>
+#include <linux/module.h>
+#include <linux/devfreq.h>
+#include <linux/math64.h>
+#include <linux/msm_adreno_devfreq.h>
+#include "governor.h"
+
+/*
+ * In kernel governor for the Adreno GPU. Each sample works out the lowest
+ * frequency that keeps the GPU under the target load and, when frames were
+ * retired, finishes the slowest frame within the frame time target. Both
+ * are scaled from the current frequency on the assumption that GPU time is
+ * inversely proportional to the clock.
+ *
+ * Going up jumps straight to the frequency needed, going down steps one
+ * level per sample so a short idle gap in a UI animation doesn't drop the
+ * clock all the way.
+ */
+
+/*
+ * FLOOR is 5msec to capture up to 3 re-draws
+ * per frame for 60fps content.
+ */
+#define FLOOR			5000
+
+/*
+ * CEILING is 50msec, larger than any standard
+ * frame length, but less than the idle timer.
+ */
+#define CEILING			50000
+
+#define TARGET_LOAD		85
+#define FRAME_TARGET		14000
+
+#define DEVFREQ_ADRENO_FRAME	"msm-adreno-frame"
+#define TAG "msm_adreno_frame: "
+
+static unsigned int frame_target_load = TARGET_LOAD;
+static unsigned int frame_target_time = FRAME_TARGET;
+
+/*
+ * _needed_freq - frequency that would have run the last sample on target
+ * @cur: The frequency the sample ran at
+ * @time: The measured time (busy or frame time)
+ * @target: The time we want it to take
+ */
+static unsigned long _needed_freq(unsigned long cur, u64 time, u64 target)
+{
+	if (target == 0)
+		return ULONG_MAX;
+
+	return (unsigned long) div64_u64((u64) cur * time, target);
+}
+
+static int frame_get_target_freq(struct devfreq *devfreq, unsigned long *freq,
+				u32 *flag)
+{
+	int result;
+	struct devfreq_msm_adreno_frame_data *priv = devfreq->data;
+	struct devfreq_dev_profile *profile = devfreq->profile;
+	struct devfreq_dev_status stats;
+	struct xstats b;
+	unsigned long need;
+	int level, i;
+
+	memset(&b, 0, sizeof(b));
+	stats.private_data = &b;
+
+	result = profile->get_dev_status(devfreq->dev.parent, &stats);
+	if (result) {
+		pr_err(TAG "get_status failed %d\n", result);
+		return result;
+	}
+
+	*freq = stats.current_frequency;
+	*flag = 0;
+
+	priv->bin.total_time += stats.total_time;
+	priv->bin.busy_time += stats.busy_time;
+	priv->bin.frames += b.frames;
+	priv->bin.frame_max = max(priv->bin.frame_max, b.frame_max);
+
+	/*
+	 * Do not waste CPU cycles running this algorithm if
+	 * the GPU just started, or if less than FLOOR time
+	 * has passed since the last run.
+	 */
+	if ((stats.total_time == 0) ||
+		(priv->bin.total_time < FLOOR))
+		return 1;
+
+	level = devfreq_get_freq_level(devfreq, stats.current_frequency);
+	if (level < 0) {
+		pr_err(TAG "bad freq %ld\n", stats.current_frequency);
+		return level;
+	}
+
+	/* An extended block of busy processing goes straight to the top */
+	if (priv->bin.busy_time > CEILING) {
+		level = 0;
+		goto clear;
+	}
+
+	need = _needed_freq(stats.current_frequency, priv->bin.busy_time * 100,
+		(u64) priv->bin.total_time * frame_target_load);
+
+	if (priv->bin.frames && priv->bin.frame_max > frame_target_time)
+		need = max(need, _needed_freq(stats.current_frequency,
+			priv->bin.frame_max, frame_target_time));
+
+	/* freq_table runs from the highest frequency down */
+	for (i = profile->max_state - 1; i > 0; i--)
+		if (profile->freq_table[i] >= need)
+			break;
+
+	if (i > level)
+		level++;
+	else
+		level = i;
+
+clear:
+	priv->bin.total_time = 0;
+	priv->bin.busy_time = 0;
+	priv->bin.frames = 0;
+	priv->bin.frame_max = 0;
+
+	*freq = profile->freq_table[level];
+	return 0;
+}
+
+static int frame_notify(struct notifier_block *nb, unsigned long type,
+		void *devp)
+{
+	int result = 0;
+	struct devfreq *devfreq = devp;
+
+	switch (type) {
+	case ADRENO_DEVFREQ_NOTIFY_IDLE:
+	case ADRENO_DEVFREQ_NOTIFY_RETIRE:
+		mutex_lock(&devfreq->lock);
+		result = update_devfreq(devfreq);
+		mutex_unlock(&devfreq->lock);
+		break;
+	/* ignored by this governor */
+	case ADRENO_DEVFREQ_NOTIFY_SUBMIT:
+	default:
+		break;
+	}
+	return notifier_from_errno(result);
+}
+
+static int frame_start(struct devfreq *devfreq)
+{
+	struct devfreq_msm_adreno_frame_data *priv;
+
+	if (devfreq->data == NULL) {
+		pr_err(TAG "data is required for this governor\n");
+		return -EINVAL;
+	}
+
+	priv = devfreq->data;
+	priv->nb.notifier_call = frame_notify;
+
+	return kgsl_devfreq_add_notifier(devfreq->dev.parent, &priv->nb);
+}
+
+static int frame_stop(struct devfreq *devfreq)
+{
+	struct devfreq_msm_adreno_frame_data *priv = devfreq->data;
+
+	kgsl_devfreq_del_notifier(devfreq->dev.parent, &priv->nb);
+	return 0;
+}
+
+static int frame_resume(struct devfreq *devfreq)
+{
+	struct devfreq_dev_profile *profile = devfreq->profile;
+	unsigned long freq;
+
+	freq = profile->initial_freq;
+
+	return profile->target(devfreq->dev.parent, &freq, 0);
+}
+
+static int frame_suspend(struct devfreq *devfreq)
+{
+	struct devfreq_msm_adreno_frame_data *priv = devfreq->data;
+
+	priv->bin.total_time = 0;
+	priv->bin.busy_time = 0;
+	priv->bin.frames = 0;
+	priv->bin.frame_max = 0;
+	return 0;
+}
+
+static ssize_t adreno_frame_load_show(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					char *buf)
+{
+	return sprintf(buf, "%u\n", frame_target_load);
+}
+
+static ssize_t adreno_frame_load_store(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u", &val) != 1 || val == 0 || val > 100)
+		return -EINVAL;
+
+	frame_target_load = val;
+
+	return count;
+}
+
+static ssize_t adreno_frame_time_show(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					char *buf)
+{
+	return sprintf(buf, "%u\n", frame_target_time);
+}
+
+static ssize_t adreno_frame_time_store(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u", &val) != 1 || val < FLOOR / 5)
+		return -EINVAL;
+
+	frame_target_time = val;
+
+	return count;
+}
+
+static struct kobj_attribute target_load_attribute =
+	__ATTR(target_load, 0664, adreno_frame_load_show,
+		adreno_frame_load_store);
+static struct kobj_attribute frame_time_attribute =
+	__ATTR(frame_time_us, 0664, adreno_frame_time_show,
+		adreno_frame_time_store);
+
+static struct attribute *attrs[] = {
+	&target_load_attribute.attr,
+	&frame_time_attribute.attr,
+	NULL,
+};
+
+static struct attribute_group attr_group = {
+	.attrs = attrs,
+	.name = DEVFREQ_ADRENO_FRAME,
+};
+
+static int frame_handler(struct devfreq *devfreq, unsigned int event,
+		void *data)
+{
+	int result;
+	BUG_ON(devfreq == NULL);
+
+	switch (event) {
+	case DEVFREQ_GOV_START:
+		result = frame_start(devfreq);
+		if (!result)
+			result = devfreq_policy_add_files(devfreq, attr_group);
+		break;
+
+	case DEVFREQ_GOV_STOP:
+		devfreq_policy_remove_files(devfreq, attr_group);
+		result = frame_stop(devfreq);
+		break;
+
+	case DEVFREQ_GOV_SUSPEND:
+		result = frame_suspend(devfreq);
+		break;
+
+	case DEVFREQ_GOV_RESUME:
+		result = frame_resume(devfreq);
+		break;
+
+	case DEVFREQ_GOV_INTERVAL:
+		/* ignored, this governor doesn't use polling */
+	default:
+		result = 0;
+		break;
+	}
+
+	return result;
+}
+
+static struct devfreq_governor msm_adreno_frame = {
+	.name = DEVFREQ_ADRENO_FRAME,
+	.get_target_freq = frame_get_target_freq,
+	.event_handler = frame_handler,
+};
+
+static int __init msm_adreno_frame_init(void)
+{
+	return devfreq_add_governor(&msm_adreno_frame);
+}
+subsys_initcall(msm_adreno_frame_init);
+
+static void __exit msm_adreno_frame_exit(void)
+{
+	int ret;
+	ret = devfreq_remove_governor(&msm_adreno_frame);
+	if (ret)
+		pr_err(TAG "failed to remove governor %d\n", ret);
+}
+
+module_exit(msm_adreno_frame_exit);
+
+MODULE_LICENSE("GPLv2");
@@ -23,6 +23,7 @@
 #include <linux/anon_inodes.h>
 #include <linux/ion.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/list_sort.h>
 #include <linux/memblock.h>
@@ -75,6 +76,7 @@ struct ion_device {
  * @lock:		lock protecting the tree of handles
  * @name:		used for debugging
  * @task:		used for debugging
+ * @stats:		allocation statistics, shown in the client debug file
  *
  * A client represents a list of buffers this client may access.
  * The mutex stored here is used to protect both handles tree
@@ -90,6 +92,7 @@ struct ion_client {
 	struct task_struct *task;
 	pid_t pid;
 	struct dentry *debug_root;
+	struct ion_alloc_stats stats;
 };
 
 /**
@@ -473,6 +476,52 @@ static int ion_handle_add(struct ion_client *client, struct ion_handle *handle)
 	return 0;
 }
 
+/* Allocations taking longer than this fire the ion_alloc_buffer_slow event */
+static unsigned int ion_alloc_slow_us = 10000;
+
+static void ion_alloc_stats_init(struct ion_alloc_stats *stats)
+{
+	spin_lock_init(&stats->lock);
+}
+
+static void ion_alloc_stats_add(struct ion_alloc_stats *stats,
+				unsigned int usecs, bool fallback)
+{
+	int bucket = fls(usecs / USEC_PER_MSEC);
+
+	spin_lock(&stats->lock);
+	stats->allocs++;
+	if (fallback)
+		stats->fallbacks++;
+	stats->max_us = max(stats->max_us, usecs);
+	stats->lat[min(bucket, ION_ALLOC_LAT_BUCKETS - 1)]++;
+	spin_unlock(&stats->lock);
+}
+
+static void ion_alloc_stats_fail(struct ion_alloc_stats *stats)
+{
+	spin_lock(&stats->lock);
+	stats->failed++;
+	spin_unlock(&stats->lock);
+}
+
+static void ion_alloc_stats_show(struct seq_file *s,
+				 struct ion_alloc_stats *stats)
+{
+	int i;
+
+	spin_lock(&stats->lock);
+	seq_printf(s, "allocs %lu fallbacks %lu failed %lu max_us %u\n",
+		   stats->allocs, stats->fallbacks, stats->failed,
+		   stats->max_us);
+	for (i = 0; i < ION_ALLOC_LAT_BUCKETS; i++)
+		seq_printf(s, "%s%ums %lu\n",
+			   i == ION_ALLOC_LAT_BUCKETS - 1 ? ">=" : "<",
+			   i == ION_ALLOC_LAT_BUCKETS - 1 ? 1 << (i - 1) : 1 << i,
+			   stats->lat[i]);
+	spin_unlock(&stats->lock);
+}
+
 struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 			     size_t align, unsigned int heap_id_mask,
 			     unsigned int flags)
@@ -486,6 +535,9 @@ struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 	const unsigned int MAX_DBG_STR_LEN = 64;
 	char dbg_str[MAX_DBG_STR_LEN];
 	unsigned int dbg_str_idx = 0;
+	ktime_t start, heap_start;
+	unsigned int usecs;
+	bool fallback = false;
 
 	dbg_str[0] = '\0';
 
@@ -510,6 +562,7 @@ struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 
 	len = PAGE_ALIGN(len);
 
+	start = ktime_get();
 	down_read(&dev->lock);
 	plist_for_each_entry(heap, &dev->heaps, node) {
 		/* if the caller didn't specify this heap id */
@@ -521,13 +574,19 @@ struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 			continue;
 		trace_ion_alloc_buffer_start(client->name, heap->name, len,
 					     heap_id_mask, flags);
+		heap_start = ktime_get();
 		buffer = ion_buffer_create(heap, dev,
 					   client->name, len, align, flags);
+		usecs = ktime_to_us(ktime_sub(ktime_get(), heap_start));
 		trace_ion_alloc_buffer_end(client->name, heap->name, len,
 					   heap_id_mask, flags);
-		if (!IS_ERR_OR_NULL(buffer))
+		if (!IS_ERR_OR_NULL(buffer)) {
+			ion_alloc_stats_add(&heap->stats, usecs, fallback);
 			break;
+		}
 
+		ion_alloc_stats_fail(&heap->stats);
+		fallback = true;
 		trace_ion_alloc_buffer_fallback(client->name, heap->name, len,
 					    heap_id_mask, flags,
 					    PTR_ERR(buffer));
@@ -549,6 +608,17 @@ struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 	}
 	up_read(&dev->lock);
 
+	if (IS_ERR_OR_NULL(buffer)) {
+		ion_alloc_stats_fail(&client->stats);
+	} else {
+		usecs = ktime_to_us(ktime_sub(ktime_get(), start));
+		ion_alloc_stats_add(&client->stats, usecs, fallback);
+		if (usecs >= ion_alloc_slow_us)
+			trace_ion_alloc_buffer_slow(client->name,
+						    buffer->heap->name, len,
+						    heap_id_mask, flags, usecs);
+	}
+
 	if (buffer == NULL) {
 		trace_ion_alloc_buffer_fail(client->name, dbg_str, len,
 					    heap_id_mask, flags, -ENODEV);
@@ -755,6 +825,9 @@ static int ion_debug_client_show(struct seq_file *s, void *unused)
 		seq_printf(s, "\n");
 	}
 	mutex_unlock(&client->lock);
+
+	seq_printf(s, "\n");
+	ion_alloc_stats_show(s, &client->stats);
 	return 0;
 }
 
@@ -843,6 +916,7 @@ struct ion_client *ion_client_create(struct ion_device *dev,
 	client->handles = RB_ROOT;
 	idr_init(&client->idr);
 	mutex_init(&client->lock);
+	ion_alloc_stats_init(&client->stats);
 
 	client->name = kzalloc(name_len+1, GFP_KERNEL);
 	if (!client->name) {
@@ -1681,6 +1755,9 @@ static int ion_debug_heap_show(struct seq_file *s, void *unused)
 	seq_printf(s, "%16.s %16u\n", "total ", total_size);
 	seq_printf(s, "----------------------------------------------------\n");
 
+	ion_alloc_stats_show(s, &heap->stats);
+	seq_printf(s, "----------------------------------------------------\n");
+
 	if (heap->debug_show)
 		heap->debug_show(heap, s, unused);
 
@@ -1751,6 +1828,7 @@ void ion_device_add_heap(struct ion_device *dev, struct ion_heap *heap)
 		ion_heap_init_deferred_free(heap);
 
 	heap->dev = dev;
+	ion_alloc_stats_init(&heap->stats);
 	down_write(&dev->lock);
 	/* use negative heap->id to reverse the priority -- when traversing
 	   the list later attempt higher id numbers first */
@@ -2045,6 +2123,8 @@ debugfs_done:
 	idev->clients = RB_ROOT;
 	debugfs_create_file("check_all_bufs", 0664, idev->debug_root, idev,
 			    &debug_allbufs_fops);
+	debugfs_create_u32("alloc_slow_us", 0644, idev->debug_root,
+			   &ion_alloc_slow_us);
 	return idev;
 }
 
@@ -33,6 +33,14 @@
 
 #define ION_CMA_ALLOCATE_FAILED NULL
 
+/*
+ * Prefetches are migrated in chunks of this size so an allocation coming in
+ * while one is running only waits for the current chunk, not the whole
+ * region. Chunks that fail are retried at half the size down to the minimum.
+ */
+#define ION_SECURE_CMA_PREFETCH_CHUNK		(4 << 20)
+#define ION_SECURE_CMA_PREFETCH_CHUNK_MIN	(1 << 20)
+
 struct ion_secure_cma_buffer_info {
 	/*
 	 * This needs to come first for compatibility with the secure buffer API
@@ -87,7 +95,15 @@ struct ion_cma_secure_heap {
 	int npages;
 	ion_phys_addr_t base;
 	struct work_struct work;
-	unsigned long last_alloc;
+	/*
+	 * Bytes the prefetch work still has to add to the pool, protected by
+	 * chunk_lock
+	 */
+	unsigned long prefetch_remaining;
+	/*
+	 * Number of threads in dma_alloc_attrs adding a chunk to the pool
+	 */
+	atomic_t adding;
 	struct shrinker shrinker;
 	atomic_t total_allocated;
 	atomic_t total_pool_size;
@@ -124,28 +140,31 @@ static int ion_secure_cma_add_to_pool(
 	void *cpu_addr;
 	dma_addr_t handle;
 	DEFINE_DMA_ATTRS(attrs);
-	int ret = 0;
 	struct ion_cma_alloc_chunk *chunk;
 
-	mutex_lock(&sheap->chunk_lock);
-
 	chunk = kzalloc(sizeof(*chunk), GFP_KERNEL);
-	if (!chunk) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	if (!chunk)
+		return -ENOMEM;
 
 	dma_set_attr(DMA_ATTR_NO_KERNEL_MAPPING, &attrs);
 	dma_set_attr(DMA_ATTR_SKIP_ZEROING, &attrs);
 
+	/*
+	 * This is where CMA migrates whatever is in the way, which can take
+	 * a long time. Don't hold chunk_lock for it, allocations that fit
+	 * in the chunks already in the pool can go ahead meanwhile.
+	 */
+	atomic_inc(&sheap->adding);
 	cpu_addr = dma_alloc_attrs(sheap->dev, len, &handle, GFP_KERNEL,
 								&attrs);
+	atomic_dec(&sheap->adding);
 
 	if (!cpu_addr) {
-		ret = -ENOMEM;
-		goto out_free;
+		kfree(chunk);
+		return -ENOMEM;
 	}
 
+	mutex_lock(&sheap->chunk_lock);
 	chunk->cpu_addr = cpu_addr;
 	chunk->handle = handle;
 	chunk->chunk_size = len;
@@ -155,21 +174,50 @@ static int ion_secure_cma_add_to_pool(
 	 /* clear the bitmap to indicate this region can be allocated from */
 	bitmap_clear(sheap->bitmap, (handle - sheap->base) >> PAGE_SHIFT,
 				len >> PAGE_SHIFT);
-	goto out;
-
-out_free:
-	kfree(chunk);
-out:
 	mutex_unlock(&sheap->chunk_lock);
-	return ret;
+	return 0;
 }
 
+/*
+ * Clear the prefetch region chunk by chunk. CMA hands out the lowest free
+ * range in the region so consecutive chunks normally end up next to each
+ * other and the bitmap can satisfy an allocation spanning several of them.
+ */
 static void ion_secure_pool_pages(struct work_struct *work)
 {
 	struct ion_cma_secure_heap *sheap = container_of(work,
 			struct ion_cma_secure_heap, work);
+	unsigned long chunk_size = ION_SECURE_CMA_PREFETCH_CHUNK;
+	unsigned long len;
+
+	while (1) {
+		mutex_lock(&sheap->chunk_lock);
+		len = min(sheap->prefetch_remaining, chunk_size);
+		sheap->prefetch_remaining -= len;
+		mutex_unlock(&sheap->chunk_lock);
+
+		if (!len)
+			break;
 
-	ion_secure_cma_add_to_pool(sheap, sheap->last_alloc);
+		if (!ion_secure_cma_add_to_pool(sheap, len))
+			continue;
+
+		/* Put it back and try a smaller chunk */
+		mutex_lock(&sheap->chunk_lock);
+		sheap->prefetch_remaining += len;
+		mutex_unlock(&sheap->chunk_lock);
+
+		chunk_size >>= 1;
+		if (chunk_size < ION_SECURE_CMA_PREFETCH_CHUNK_MIN) {
+			pr_debug("%s: prefetch stopped with %lx left\n",
+				__func__, sheap->prefetch_remaining);
+			break;
+		}
+	}
+
+	mutex_lock(&sheap->chunk_lock);
+	sheap->prefetch_remaining = 0;
+	mutex_unlock(&sheap->chunk_lock);
 }
 /*
  * @s1: start of the first region
@@ -229,6 +277,8 @@ int ion_secure_cma_prefetch(struct ion_heap *heap, void *data)
 	if (len == 0)
 		len = sheap->default_prefetch_size;
 
+	len = PAGE_ALIGN(len);
+
 	/*
 	 * Only prefetch as much space as there is left in the pool so
 	 * check against the current free size of the heap.
@@ -241,7 +291,9 @@ int ion_secure_cma_prefetch(struct ion_heap *heap, void *data)
 	if (len > diff)
 		len = diff;
 
-	sheap->last_alloc = len;
+	mutex_lock(&sheap->chunk_lock);
+	sheap->prefetch_remaining = len;
+	mutex_unlock(&sheap->chunk_lock);
 	schedule_work(&sheap->work);
 
 	return 0;
@@ -331,6 +383,12 @@ int ion_secure_cma_drain_pool(struct ion_heap *heap, void *unused)
 		container_of(heap, struct ion_cma_secure_heap, heap);
 	struct list_head *entry, *_n;
 
+	/* Stop a prefetch that's still running */
+	mutex_lock(&sheap->chunk_lock);
+	sheap->prefetch_remaining = 0;
+	mutex_unlock(&sheap->chunk_lock);
+	flush_work(&sheap->work);
+
 	mutex_lock(&sheap->chunk_lock);
 	list_for_each_safe(entry, _n, &sheap->chunks) {
 		struct ion_cma_alloc_chunk *chunk = container_of(entry,
@@ -357,8 +415,11 @@ static int ion_secure_cma_shrinker(struct shrinker *shrinker,
 
 	/*
 	 * Allocation path may recursively call the shrinker. Don't shrink if
-	 * that happens.
+	 * that happens, it would give back the chunks being collected.
 	 */
+	if (atomic_read(&sheap->adding))
+		return -1;
+
 	if (!mutex_trylock(&sheap->chunk_lock))
 		return -1;
 
@@ -437,6 +498,15 @@ static struct ion_secure_cma_buffer_info *__ion_secure_cma_allocate(
 	mutex_lock(&sheap->alloc_lock);
 	ret = ion_secure_cma_alloc_from_pool(sheap, &info->phys, len);
 
+	if (ret && (work_pending(&sheap->work) || sheap->prefetch_remaining)) {
+		/*
+		 * A prefetch is clearing the region already, migrating
+		 * alongside it would only slow both down.
+		 */
+		flush_work(&sheap->work);
+		ret = ion_secure_cma_alloc_from_pool(sheap, &info->phys, len);
+	}
+
 	if (ret) {
 retry:
 		ret = ion_secure_cma_add_to_pool(sheap, len);
@@ -55,6 +55,18 @@ static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 	__free_pages(page, pool->order);
 }
 
+static void ion_page_pool_add_item(struct ion_page_pool *pool,
+				   struct ion_page_pool_item *item)
+{
+	if (PageHighMem(item->page)) {
+		list_add_tail(&item->list, &pool->high_items);
+		pool->high_count++;
+	} else {
+		list_add_tail(&item->list, &pool->low_items);
+		pool->low_count++;
+	}
+}
+
 static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 {
 	struct ion_page_pool_item *item;
@@ -65,13 +77,24 @@ static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 
 	mutex_lock(&pool->mutex);
 	item->page = page;
-	if (PageHighMem(page)) {
-		list_add_tail(&item->list, &pool->high_items);
-		pool->high_count++;
-	} else {
-		list_add_tail(&item->list, &pool->low_items);
-		pool->low_count++;
-	}
+	ion_page_pool_add_item(pool, item);
+	mutex_unlock(&pool->mutex);
+	return 0;
+}
+
+static int ion_page_pool_add_dirty(struct ion_page_pool *pool,
+				   struct page *page)
+{
+	struct ion_page_pool_item *item;
+
+	item = kmalloc(sizeof(struct ion_page_pool_item), GFP_KERNEL);
+	if (!item)
+		return -ENOMEM;
+
+	mutex_lock(&pool->mutex);
+	item->page = page;
+	list_add_tail(&item->list, &pool->dirty_items);
+	pool->dirty_count++;
 	mutex_unlock(&pool->mutex);
 	return 0;
 }
@@ -99,6 +122,22 @@ static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 	return page;
 }
 
+static struct page *ion_page_pool_remove_dirty(struct ion_page_pool *pool)
+{
+	struct ion_page_pool_item *item;
+	struct page *page;
+
+	BUG_ON(!pool->dirty_count);
+	item = list_first_entry(&pool->dirty_items, struct ion_page_pool_item,
+				list);
+	pool->dirty_count--;
+
+	list_del(&item->list);
+	page = item->page;
+	kfree(item);
+	return page;
+}
+
 void *ion_page_pool_alloc(struct ion_page_pool *pool, bool *from_pool)
 {
 	struct page *page = NULL;
@@ -112,6 +151,14 @@ void *ion_page_pool_alloc(struct ion_page_pool *pool, bool *from_pool)
 			page = ion_page_pool_remove(pool, true);
 		else if (pool->low_count)
 			page = ion_page_pool_remove(pool, false);
+		else if (pool->dirty_count) {
+			/*
+			 * Still cheaper than going to the page allocator,
+			 * the caller zeroes it as if it came from there.
+			 */
+			page = ion_page_pool_remove_dirty(pool);
+			*from_pool = false;
+		}
 		mutex_unlock(&pool->mutex);
 	}
 	if (!page) {
@@ -125,11 +172,69 @@ void ion_page_pool_free(struct ion_page_pool *pool, struct page* page)
 {
 	int ret;
 
-	ret = ion_page_pool_add(pool, page);
+	ret = ion_page_pool_add_dirty(pool, page);
 	if (ret)
 		ion_page_pool_free_pages(pool, page);
 }
 
+int ion_page_pool_clean(struct ion_page_pool *pool, int nr_to_clean)
+{
+	struct ion_page_pool_item *item;
+	int nr_cleaned = 0;
+
+	while (nr_cleaned < nr_to_clean) {
+		mutex_lock(&pool->mutex);
+		if (!pool->dirty_count) {
+			mutex_unlock(&pool->mutex);
+			break;
+		}
+		item = list_first_entry(&pool->dirty_items,
+					struct ion_page_pool_item, list);
+		list_del(&item->list);
+		pool->dirty_count--;
+		mutex_unlock(&pool->mutex);
+
+		if (ion_heap_high_order_page_zero(item->page, pool->order)) {
+			ion_page_pool_free_pages(pool, item->page);
+			kfree(item);
+			continue;
+		}
+
+		mutex_lock(&pool->mutex);
+		ion_page_pool_add_item(pool, item);
+		mutex_unlock(&pool->mutex);
+		nr_cleaned++;
+	}
+
+	return nr_cleaned;
+}
+
+int ion_page_pool_fill(struct ion_page_pool *pool, int nr_to_fill)
+{
+	struct page *page;
+	int nr_filled = 0;
+
+	while (nr_filled < nr_to_fill) {
+		page = alloc_pages(pool->gfp_mask & ~__GFP_ZERO, pool->order);
+		if (!page)
+			break;
+
+		if (ion_heap_high_order_page_zero(page, pool->order) ||
+		    ion_page_pool_add(pool, page)) {
+			ion_page_pool_free_pages(pool, page);
+			break;
+		}
+		nr_filled++;
+	}
+
+	return nr_filled;
+}
+
+int ion_page_pool_count(struct ion_page_pool *pool)
+{
+	return pool->high_count + pool->low_count;
+}
+
 static int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 {
 	int total = 0;
@@ -137,6 +242,7 @@ static int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 	total += high ? (pool->high_count + pool->low_count) *
 		(1 << pool->order) :
 			pool->low_count * (1 << pool->order);
+	total += pool->dirty_count * (1 << pool->order);
 	return total;
 }
 
@@ -159,7 +265,9 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 		struct page *page;
 
 		mutex_lock(&pool->mutex);
-		if (pool->low_count) {
+		if (pool->dirty_count) {
+			page = ion_page_pool_remove_dirty(pool);
+		} else if (pool->low_count) {
 			page = ion_page_pool_remove(pool, false);
 		} else if (high && pool->high_count) {
 			page = ion_page_pool_remove(pool, true);
@@ -183,7 +291,9 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
 		return NULL;
 	pool->high_count = 0;
 	pool->low_count = 0;
+	pool->dirty_count = 0;
 	INIT_LIST_HEAD(&pool->low_items);
+	INIT_LIST_HEAD(&pool->dirty_items);
 	INIT_LIST_HEAD(&pool->high_items);
 	pool->gfp_mask = gfp_mask;
 	pool->order = order;
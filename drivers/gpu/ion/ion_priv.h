@@ -28,6 +28,7 @@
 #include "msm_ion_priv.h"
 #include <linux/sched.h>
 #include <linux/shrinker.h>
+#include <linux/spinlock.h>
 #include <linux/types.h>
 
 #define ION_ALLOC_CLIENT_NAME_SIZE 64
@@ -131,6 +132,29 @@ struct ion_heap_ops {
 	int (*unsecure_buffer)(struct ion_buffer *buffer, int force_unsecure);
 };
 
+/* Allocation latency histogram buckets: < 1ms, < 2ms, < 4ms ... >= 64ms */
+#define ION_ALLOC_LAT_BUCKETS	8
+
+/**
+ * struct ion_alloc_stats - allocation statistics of a heap or a client
+ * @lock:		protects the counters
+ * @allocs:		number of successful allocations
+ * @fallbacks:		for a heap, allocations it got after a higher
+ *			priority heap failed; for a client, allocations that
+ *			didn't succeed on the first heap tried
+ * @failed:		number of failed allocations
+ * @max_us:		longest successful allocation in microseconds
+ * @lat:		histogram of successful allocation times
+ */
+struct ion_alloc_stats {
+	spinlock_t lock;
+	unsigned long allocs;
+	unsigned long fallbacks;
+	unsigned long failed;
+	unsigned int max_us;
+	unsigned long lat[ION_ALLOC_LAT_BUCKETS];
+};
+
 /**
  * heap flags - flags between the heaps and core ion code
  */
@@ -159,6 +183,7 @@ struct ion_heap_ops {
  * @task:		task struct of deferred free thread
  * @debug_show:		called when heap debug file is read to add any
  *			heap specific debug info to output
+ * @stats:		allocation statistics, shown in the heap debug file
  *
  * Represents a pool of memory from which buffers can be made.  In some
  * systems the only heap is regular system memory allocated via vmalloc.
@@ -181,6 +206,7 @@ struct ion_heap {
 	wait_queue_head_t waitqueue;
 	struct task_struct *task;
 	int (*debug_show)(struct ion_heap *heap, struct seq_file *, void *);
+	struct ion_alloc_stats stats;
 };
 
 /**
@@ -349,8 +375,10 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * struct ion_page_pool - pagepool struct
  * @high_count:		number of highmem items in the pool
  * @low_count:		number of lowmem items in the pool
+ * @dirty_count:	number of items waiting to be zeroed
  * @high_items:		list of highmem items
  * @low_items:		list of lowmem items
+ * @dirty_items:	list of freed items that haven't been zeroed yet
  * @shrinker:		a shrinker for the items
  * @mutex:		lock protecting this struct and especially the count
  *			item list
@@ -370,8 +398,10 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
 struct ion_page_pool {
 	int high_count;
 	int low_count;
+	int dirty_count;
 	struct list_head high_items;
 	struct list_head low_items;
+	struct list_head dirty_items;
 	struct mutex mutex;
 	gfp_t gfp_mask;
 	unsigned int order;
@@ -383,6 +413,37 @@ void ion_page_pool_destroy(struct ion_page_pool *);
 void *ion_page_pool_alloc(struct ion_page_pool *, bool *from_pool);
 void ion_page_pool_free(struct ion_page_pool *, struct page *);
 
+/**
+ * ion_page_pool_clean - zero freed items and make them available to alloc
+ * @pool:		the pool
+ * @nr_to_clean:	maximum number of items to zero
+ *
+ * Pages freed to the pool are dirty until this is called on them, alloc
+ * only hands them out when there is nothing clean left and reports them
+ * as not from the pool so the caller zeroes them.
+ *
+ * returns the number of items cleaned
+ */
+int ion_page_pool_clean(struct ion_page_pool *pool, int nr_to_clean);
+
+/**
+ * ion_page_pool_fill - add zeroed pages from the page allocator to the pool
+ * @pool:		the pool
+ * @nr_to_fill:		number of items to add
+ *
+ * Stops at the first allocation failure, the pool's gfp_mask decides how
+ * hard it tries.
+ *
+ * returns the number of items added
+ */
+int ion_page_pool_fill(struct ion_page_pool *pool, int nr_to_fill);
+
+/**
+ * ion_page_pool_count - number of clean items in the pool
+ * @pool:		the pool
+ */
+int ion_page_pool_count(struct ion_page_pool *pool);
+
 /** ion_page_pool_shrink - shrinks the size of the memory cached in the pool
  * @pool:		the pool
  * @gfp_mask:		the memory type to reclaim
@@ -18,9 +18,13 @@
 #include <asm/page.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
+#include <linux/freezer.h>
 #include <linux/highmem.h>
 #include <linux/ion.h>
+#include <linux/kthread.h>
 #include <linux/mm.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
 #include <linux/scatterlist.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
@@ -51,10 +55,56 @@ static unsigned int order_to_size(int order)
 	return PAGE_SIZE << order;
 }
 
+/*
+ * Number of items the pool thread keeps in the uncached order-8 and order-4
+ * pools. It refills when an allocation takes a pool under half of that.
+ */
+static unsigned int pool_refill_order8 = 4;
+module_param_named(pool_refill_order8, pool_refill_order8, uint, 0644);
+static unsigned int pool_refill_order4 = 32;
+module_param_named(pool_refill_order4, pool_refill_order4, uint, 0644);
+
+/*
+ * Don't refill while less than 1/POOL_REFILL_FREE_RATIO of memory is free
+ * or for a second after the shrinker took pages back.
+ */
+#define POOL_REFILL_FREE_RATIO	8
+#define POOL_REFILL_BACKOFF	HZ
+
+static unsigned int pool_refill_target(unsigned int order)
+{
+	switch (order) {
+	case 8:
+		return pool_refill_order8;
+	case 4:
+		return pool_refill_order4;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * struct ion_system_heap - system heap
+ * @heap:		the ion heap
+ * @uncached_pools:	pools of pages for uncached buffers, one per order
+ * @cached_pools:	pools of pages for cached buffers, one per order
+ * @pool_task:		thread that zeroes freed pages and refills the pools
+ * @pool_wait:		wait queue for @pool_task
+ * @pool_refill:	set when an uncached pool went under its watermark
+ * @last_shrink:	jiffies at the last time the shrinker freed pages
+ * @order_allocs:	chunks of each order handed out to buffers
+ * @order_pool_hits:	how many of those were clean pages from a pool
+ */
 struct ion_system_heap {
 	struct ion_heap heap;
 	struct ion_page_pool **uncached_pools;
 	struct ion_page_pool **cached_pools;
+	struct task_struct *pool_task;
+	wait_queue_head_t pool_wait;
+	bool pool_refill;
+	unsigned long last_shrink;
+	atomic_t order_allocs[ARRAY_SIZE(orders)];
+	atomic_t order_pool_hits[ARRAY_SIZE(orders)];
 };
 
 struct page_info {
@@ -113,6 +163,84 @@ static void free_buffer_page(struct ion_system_heap *heap,
 }
 
 
+static bool ion_system_heap_pool_low(struct ion_system_heap *heap)
+{
+	int i;
+
+	for (i = 0; i < num_orders; i++)
+		if (ion_page_pool_count(heap->uncached_pools[i]) <
+			pool_refill_target(orders[i]) / 2)
+			return true;
+	return false;
+}
+
+static bool ion_system_heap_pool_dirty(struct ion_system_heap *heap)
+{
+	int i;
+
+	for (i = 0; i < num_orders; i++)
+		if (heap->uncached_pools[i]->dirty_count ||
+			heap->cached_pools[i]->dirty_count)
+			return true;
+	return false;
+}
+
+static bool ion_system_heap_can_refill(struct ion_system_heap *heap,
+				       unsigned int order)
+{
+	if (time_before(jiffies, heap->last_shrink + POOL_REFILL_BACKOFF))
+		return false;
+
+	return global_page_state(NR_FREE_PAGES) >
+		totalram_pages / POOL_REFILL_FREE_RATIO + (1 << order);
+}
+
+static void ion_system_heap_pool_refill(struct ion_system_heap *heap)
+{
+	int i;
+
+	for (i = 0; i < num_orders; i++) {
+		struct ion_page_pool *pool = heap->uncached_pools[i];
+
+		while (ion_page_pool_count(pool) <
+			pool_refill_target(orders[i])) {
+			if (kthread_should_stop() ||
+				!ion_system_heap_can_refill(heap, orders[i]))
+				return;
+			if (!ion_page_pool_fill(pool, 1))
+				break;
+			cond_resched();
+		}
+	}
+}
+
+static int ion_system_heap_pool_thread(void *data)
+{
+	struct ion_system_heap *heap = data;
+	int i;
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(heap->pool_wait,
+				     heap->pool_refill ||
+				     ion_system_heap_pool_dirty(heap) ||
+				     kthread_should_stop());
+
+		heap->pool_refill = false;
+
+		/* Zero what was freed first, it's usually what gets reused */
+		for (i = 0; i < num_orders; i++) {
+			while (ion_page_pool_clean(heap->uncached_pools[i], 1))
+				cond_resched();
+			while (ion_page_pool_clean(heap->cached_pools[i], 1))
+				cond_resched();
+		}
+
+		ion_system_heap_pool_refill(heap);
+	}
+
+	return 0;
+}
+
 static struct page_info *alloc_largest_available(struct ion_system_heap *heap,
 						 struct ion_buffer *buffer,
 						 unsigned long size,
@@ -132,6 +260,10 @@ static struct page_info *alloc_largest_available(struct ion_system_heap *heap,
 		if (!page)
 			continue;
 
+		atomic_inc(&heap->order_allocs[i]);
+		if (from_pool)
+			atomic_inc(&heap->order_pool_hits[i]);
+
 		info = kmalloc(sizeof(struct page_info), GFP_KERNEL);
 		if (info) {
 			info->page = page;
@@ -294,6 +426,11 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 	if (nents_sync)
 		sg_free_table(&table_sync);
 	ion_heap_free_pages_mem(&data);
+
+	if (ion_system_heap_pool_low(sys_heap)) {
+		sys_heap->pool_refill = true;
+		wake_up(&sys_heap->pool_wait);
+	}
 	return 0;
 err_free_sg2:
 	/* We failed to zero buffers. Bypass pool */
@@ -333,14 +470,15 @@ void ion_system_heap_free(struct ion_buffer *buffer)
 	LIST_HEAD(pages);
 	int i;
 
-	if (!(buffer->flags & ION_FLAG_FREED_FROM_SHRINKER))
-		ion_heap_buffer_zero(buffer);
-
+	/* Pages go back to the pools dirty, the pool thread zeroes them */
 	for_each_sg(table->sgl, sg, table->nents, i)
 		free_buffer_page(sys_heap, buffer, sg_page(sg),
 				get_order(sg_dma_len(sg)));
 	sg_free_table(table);
 	kfree(table);
+
+	if (!(buffer->flags & ION_FLAG_FREED_FROM_SHRINKER))
+		wake_up(&sys_heap->pool_wait);
 }
 
 struct sg_table *ion_system_heap_map_dma(struct ion_heap *heap,
@@ -380,6 +518,8 @@ static int ion_system_heap_shrink(struct shrinker *shrinker,
 	if (sc->nr_to_scan == 0)
 		goto end;
 
+	sys_heap->last_shrink = jiffies;
+
 	/* shrink the free list first, no point in zeroing the memory if
 	   we're just going to reclaim it. Also, skip any possible
 	   page pooling */
@@ -433,6 +573,10 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 			"%d order %u lowmem pages in uncached pool = %lu total\n",
 			pool->low_count, pool->order,
 			(1 << pool->order) * PAGE_SIZE * pool->low_count);
+		seq_printf(s,
+			"%d order %u dirty pages in uncached pool = %lu total\n",
+			pool->dirty_count, pool->order,
+			(1 << pool->order) * PAGE_SIZE * pool->dirty_count);
 	}
 
 	for (i = 0; i < num_orders; i++) {
@@ -445,8 +589,17 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 			"%d order %u lowmem pages in cached pool = %lu total\n",
 			pool->low_count, pool->order,
 			(1 << pool->order) * PAGE_SIZE * pool->low_count);
+		seq_printf(s,
+			"%d order %u dirty pages in cached pool = %lu total\n",
+			pool->dirty_count, pool->order,
+			(1 << pool->order) * PAGE_SIZE * pool->dirty_count);
 	}
 
+	for (i = 0; i < num_orders; i++)
+		seq_printf(s, "order %u allocations = %d, from pool = %d\n",
+			orders[i], atomic_read(&sys_heap->order_allocs[i]),
+			atomic_read(&sys_heap->order_pool_hits[i]));
+
 	return 0;
 }
 
@@ -489,6 +642,7 @@ err_create_pool:
 struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 {
 	struct ion_system_heap *heap;
+	struct sched_param param = { .sched_priority = 0 };
 	int pools_size = sizeof(struct ion_page_pool *) * num_orders;
 
 	heap = kzalloc(sizeof(struct ion_system_heap), GFP_KERNEL);
@@ -512,6 +666,17 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 	if (ion_system_heap_create_pools(heap->cached_pools))
 		goto err_create_cached_pools;
 
+	init_waitqueue_head(&heap->pool_wait);
+	heap->last_shrink = jiffies - POOL_REFILL_BACKOFF;
+	heap->pool_refill = true;
+	heap->pool_task = kthread_run(ion_system_heap_pool_thread, heap,
+				      "ion_system_pool");
+	if (IS_ERR(heap->pool_task)) {
+		pr_err("%s: creating pool thread failed\n", __func__);
+		goto err_create_pool_task;
+	}
+	sched_setscheduler(heap->pool_task, SCHED_IDLE, &param);
+
 	heap->heap.shrinker.shrink = ion_system_heap_shrink;
 	heap->heap.shrinker.seeks = DEFAULT_SEEKS;
 	heap->heap.shrinker.batch = 0;
@@ -519,6 +684,8 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 	heap->heap.debug_show = ion_system_heap_debug_show;
 	return &heap->heap;
 
+err_create_pool_task:
+	ion_system_heap_destroy_pools(heap->cached_pools);
 err_create_cached_pools:
 	ion_system_heap_destroy_pools(heap->uncached_pools);
 err_create_uncached_pools:
@@ -536,6 +703,7 @@ void ion_system_heap_destroy(struct ion_heap *heap)
 							struct ion_system_heap,
 							heap);
 
+	kthread_stop(sys_heap->pool_task);
 	ion_system_heap_destroy_pools(sys_heap->uncached_pools);
 	ion_system_heap_destroy_pools(sys_heap->cached_pools);
 	kfree(sys_heap->uncached_pools);
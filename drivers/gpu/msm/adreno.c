@@ -101,10 +101,15 @@ static struct devfreq_msm_adreno_tz_data adreno_conservative_data = {
 	.device_id = KGSL_DEVICE_3D0,
 };
 
+static struct devfreq_msm_adreno_frame_data adreno_frame_data = {
+	.device_id = KGSL_DEVICE_3D0,
+};
+
 static const struct devfreq_governor_data adreno_governors[] = {
 	{ .name = "simple_ondemand", .data = &adreno_ondemand_data },
 	{ .name = "msm-adreno-tz", .data = &adreno_tz_data },
 	{ .name = "conservative", .data = &adreno_conservative_data },
+	{ .name = "msm-adreno-frame", .data = &adreno_frame_data },
 };
 
 static const struct kgsl_functable adreno_functable;
@@ -880,6 +885,8 @@ static void adreno_cleanup_pt(struct kgsl_device *device,
 	kgsl_mmu_unmap(pagetable, &device->mmu.setstate_memory);
 
 	kgsl_mmu_unmap(pagetable, &adreno_dev->profile.shared_buffer);
+
+	kgsl_mmu_unmap(pagetable, &adreno_dev->gputime.buffer);
 }
 
 static int adreno_setup_pt(struct kgsl_device *device,
@@ -912,6 +919,10 @@ static int adreno_setup_pt(struct kgsl_device *device,
 		result = kgsl_mmu_map_global(pagetable,
 			&adreno_dev->profile.shared_buffer);
 
+	if (!result)
+		result = kgsl_mmu_map_global(pagetable,
+			&adreno_dev->gputime.buffer);
+
 	if (result) {
 		/* On error clean up what we have wrought */
 		adreno_cleanup_pt(device, pagetable);
@@ -923,7 +934,12 @@ static int adreno_setup_pt(struct kgsl_device *device,
 	 * For the IOMMU, this will be used to restrict access to the
 	 * mapped registers.
 	 */
-	device->mh.mpu_range = adreno_dev->profile.shared_buffer.gpuaddr +
+	if (adreno_dev->gputime.buffer.size)
+		device->mh.mpu_range = adreno_dev->gputime.buffer.gpuaddr +
+				adreno_dev->gputime.buffer.size;
+	else
+		device->mh.mpu_range =
+				adreno_dev->profile.shared_buffer.gpuaddr +
 				adreno_dev->profile.shared_buffer.size;
 
 	return 0;
@@ -1880,6 +1896,7 @@ adreno_probe(struct platform_device *pdev)
 
 	adreno_debugfs_init(device);
 	adreno_profile_init(device);
+	adreno_gputime_init(device);
 
 	adreno_ft_init_sysfs(device);
 
@@ -1923,6 +1940,7 @@ static int __devexit adreno_remove(struct platform_device *pdev)
 	input_unregister_handler(&adreno_input_handler);
 
 	adreno_coresight_remove(pdev);
+	adreno_gputime_close(device);
 	adreno_profile_close(device);
 
 	kgsl_pwrscale_close(device);
@@ -2926,6 +2944,49 @@ static int adreno_setproperty(struct kgsl_device_private *dev_priv,
 			kgsl_context_put(context);
 		}
 		break;
+	case KGSL_PROP_CONTEXT_PRIORITY: {
+			struct kgsl_context_priority prio;
+			struct kgsl_context *context;
+
+			if (sizebytes != sizeof(prio))
+				break;
+
+			if (copy_from_user(&prio, value, sizeof(prio))) {
+				status = -EFAULT;
+				break;
+			}
+
+			if (prio.priority < ADRENO_CONTEXT_MAX_PRIORITY ||
+				prio.priority > ADRENO_CONTEXT_MIN_PRIORITY)
+				break;
+
+			/*
+			 * Anybody may make their own contexts less important.
+			 * Raising a priority or changing the contexts of
+			 * another process is reserved for the compositor.
+			 */
+			if (capable(CAP_SYS_NICE))
+				context = kgsl_context_get(device,
+					prio.context_id);
+			else if (prio.priority >=
+				ADRENO_CONTEXT_DEFAULT_PRIORITY)
+				context = kgsl_context_get_owner(dev_priv,
+					prio.context_id);
+			else {
+				status = -EPERM;
+				break;
+			}
+
+			if (context == NULL)
+				break;
+
+			adreno_dispatcher_set_priority(adreno_dev,
+				ADRENO_CONTEXT(context), prio.priority);
+			status = 0;
+
+			kgsl_context_put(context);
+		}
+		break;
 	default:
 		break;
 	}
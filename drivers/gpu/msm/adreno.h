@@ -17,6 +17,7 @@
 #include "adreno_drawctxt.h"
 #include "adreno_ringbuffer.h"
 #include "adreno_profile.h"
+#include "adreno_gputime.h"
 #include "kgsl_iommu.h"
 #include <mach/ocmem.h>
 
@@ -44,6 +45,7 @@
 #define KGSL_CMD_FLAGS_PROFILE		BIT(3)
 #define KGSL_CMD_FLAGS_PWRON_FIXUP      BIT(4)
 #define KGSL_CMD_FLAGS_MEMLIST          BIT(5)
+#define KGSL_CMD_FLAGS_GPUTIME          BIT(6)
 
 /* Command identifiers */
 #define KGSL_CONTEXT_TO_MEM_IDENTIFIER	0x2EADBEEF
@@ -197,6 +199,7 @@ struct adreno_device {
 	struct ocmem_buf *ocmem_hdl;
 	unsigned int ocmem_base;
 	struct adreno_profile profile;
+	struct adreno_gputime gputime;
 	struct kgsl_memdesc pwron_fixup;
 	unsigned int pwron_fixup_dwords;
 	struct adreno_dispatcher dispatcher;
@@ -525,6 +528,8 @@ void adreno_dispatcher_schedule(struct kgsl_device *device);
 void adreno_dispatcher_pause(struct adreno_device *adreno_dev);
 void adreno_dispatcher_queue_context(struct kgsl_device *device,
 	struct adreno_context *drawctxt);
+void adreno_dispatcher_set_priority(struct adreno_device *adreno_dev,
+	struct adreno_context *drawctxt, unsigned int priority);
 int adreno_reset(struct kgsl_device *device);
 
 int adreno_ft_init_sysfs(struct kgsl_device *device);
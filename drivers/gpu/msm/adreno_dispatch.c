@@ -48,6 +48,19 @@ static unsigned int _fault_throttle_burst = 3;
 /* Number of command batches inflight in the ringbuffer at any time */
 static unsigned int _dispatcher_inflight = 15;
 
+/*
+ * Number of command batches inflight in the ringbuffer that a context with
+ * a lower than default priority may send, so that foreground work arriving
+ * later isn't stuck behind a full ringbuffer of background work
+ */
+static unsigned int _dispatcher_low_inflight = 8;
+
+/*
+ * Number of milliseconds a context may wait on the pending list before it
+ * is served ahead of higher priority contexts with its full inflight share
+ */
+static unsigned int _context_starve_time = 100;
+
 /* Command batch timeout (in milliseconds) */
 static unsigned int _cmdbatch_timeout = 2000;
 
@@ -371,6 +384,7 @@ static void  dispatcher_queue_context(struct adreno_device *adreno_dev,
 		/* Get a reference to the context while it sits on the list */
 		if (_kgsl_context_get(&drawctxt->base)) {
 			trace_dispatch_queue_context(drawctxt);
+			drawctxt->pending_since = jiffies;
 			plist_add(&drawctxt->pending, &dispatcher->pending);
 		}
 	}
@@ -436,6 +450,8 @@ static int sendcmd(struct adreno_device *adreno_dev,
 
 	trace_adreno_cmdbatch_submitted(cmdbatch, (int) dispatcher->inflight);
 
+	cmdbatch->submit_time = ktime_get();
+
 	dispatcher->cmdqueue[dispatcher->tail] = cmdbatch;
 	dispatcher->tail = (dispatcher->tail + 1) %
 		ADRENO_DISPATCH_CMDQUEUE_SIZE;
@@ -465,13 +481,14 @@ static int sendcmd(struct adreno_device *adreno_dev,
  * dispatcher_context_sendcmds() - Send commands from a context to the GPU
  * @adreno_dev: Pointer to the adreno device struct
  * @drawctxt: Pointer to the adreno context to dispatch commands from
+ * @inflight: Stop when this many command batches are inflight
  *
  * Dequeue and send a burst of commands from the specified context to the GPU
  * Returns postive if the context needs to be put back on the pending queue
  * 0 if the context is empty or detached and negative on error
  */
 static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
-		struct adreno_context *drawctxt)
+		struct adreno_context *drawctxt, unsigned int inflight)
 {
 	struct adreno_dispatcher *dispatcher = &adreno_dev->dispatcher;
 	int count = 0;
@@ -482,7 +499,7 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 	 * Each context can send a specific number of command batches per cycle
 	 */
 	while ((count < _context_cmdbatch_burst) &&
-		(dispatcher->inflight < _dispatcher_inflight)) {
+		(dispatcher->inflight < inflight)) {
 		int ret;
 		struct kgsl_cmdbatch *cmdbatch;
 
@@ -557,6 +574,34 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 	return (count || requeued) ? 1 : 0;
 }
 
+/**
+ * dispatcher_next_context() - Pick the next context to send commands from
+ * @dispatcher: Pointer to the adreno dispatcher struct
+ * @starved: Set to 1 if the context has waited longer than the starve time
+ *
+ * Return the highest priority pending context unless a context has been
+ * waiting for longer than _context_starve_time, in which case the starved
+ * context goes first. This function assumes the plist lock is held and the
+ * pending list is not empty.
+ */
+static struct adreno_context *dispatcher_next_context(
+		struct adreno_dispatcher *dispatcher, int *starved)
+{
+	struct adreno_context *drawctxt;
+	unsigned long wait = msecs_to_jiffies(_context_starve_time);
+
+	plist_for_each_entry(drawctxt, &dispatcher->pending, pending) {
+		if (time_after(jiffies, drawctxt->pending_since + wait)) {
+			*starved = 1;
+			return drawctxt;
+		}
+	}
+
+	*starved = 0;
+	return plist_first_entry(&dispatcher->pending,
+		struct adreno_context, pending);
+}
+
 /**
  * _adreno_dispatcher_issuecmds() - Issue commmands from pending contexts
  * @adreno_dev: Pointer to the adreno device struct
@@ -569,7 +614,8 @@ static int _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 	struct adreno_dispatcher *dispatcher = &adreno_dev->dispatcher;
 	struct adreno_context *drawctxt, *next;
 	struct plist_head requeue;
-	int ret;
+	unsigned int inflight;
+	int starved, ret;
 
 	/* Leave early if the dispatcher isn't in a happy state */
 	if (adreno_gpu_fault(adreno_dev) != 0)
@@ -592,8 +638,23 @@ static int _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 		}
 
 		/* Get the next entry on the list */
-		drawctxt = plist_first_entry(&dispatcher->pending,
-			struct adreno_context, pending);
+		drawctxt = dispatcher_next_context(dispatcher, &starved);
+
+		/*
+		 * Low priority contexts only get part of the ringbuffer unless
+		 * they have been waiting too long. Everything behind this one
+		 * on the list is at the same or a lower priority so there is
+		 * nothing more to do until some commands retire.
+		 */
+		inflight = _dispatcher_inflight;
+		if (!starved && drawctxt->pending.prio >
+			ADRENO_CONTEXT_DEFAULT_PRIORITY)
+			inflight = min(_dispatcher_low_inflight, inflight);
+
+		if (dispatcher->inflight >= inflight) {
+			spin_unlock(&dispatcher->plist_lock);
+			break;
+		}
 
 		plist_del(&drawctxt->pending, &dispatcher->pending);
 
@@ -605,7 +666,8 @@ static int _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 			continue;
 		}
 
-		ret = dispatcher_context_sendcmds(adreno_dev, drawctxt);
+		ret = dispatcher_context_sendcmds(adreno_dev, drawctxt,
+			inflight);
 
 		if (ret > 0) {
 			spin_lock(&dispatcher->plist_lock);
@@ -621,9 +683,10 @@ static int _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 			 * first time it went on the list.
 			 */
 
-			if (plist_node_empty(&drawctxt->pending))
+			if (plist_node_empty(&drawctxt->pending)) {
+				drawctxt->pending_since = jiffies;
 				plist_add(&drawctxt->pending, &requeue);
-			else
+			} else
 				kgsl_context_put(&drawctxt->base);
 
 			spin_unlock(&dispatcher->plist_lock);
@@ -1623,6 +1686,14 @@ static void adreno_dispatcher_work(struct work_struct *work)
 				ADRENO_DISPATCH_CMDQUEUE_SIZE);
 
 			kgsl_mutex_lock(&device->mutex, &device->mutex_owner);
+
+			adreno_gputime_retire(adreno_dev, cmdbatch);
+
+			/* Let the governor know how long the frame took */
+			if (cmdbatch->flags & KGSL_CMDBATCH_END_OF_FRAME)
+				kgsl_pwrscale_frame(device, ktime_us_delta(
+					ktime_get(), cmdbatch->submit_time));
+
 			/* Destroy the retired command batch */
 			kgsl_cmdbatch_destroy(cmdbatch);
 			kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
@@ -1774,6 +1845,41 @@ void adreno_dispatcher_queue_context(struct kgsl_device *device,
 	adreno_dispatcher_schedule(device);
 }
 
+/**
+ * adreno_dispatcher_set_priority() - Change the dispatch priority of a context
+ * @adreno_dev: Pointer to the adreno device struct
+ * @drawctxt: Pointer to the adreno context
+ * @priority: New priority, ADRENO_CONTEXT_MAX_PRIORITY to
+ * ADRENO_CONTEXT_MIN_PRIORITY
+ *
+ * Move the context to its new place on the pending list if it is queued.
+ * The dispatcher mutex is taken so the change doesn't race with
+ * _adreno_dispatcher_issuecmds() moving the context between lists.
+ */
+void adreno_dispatcher_set_priority(struct adreno_device *adreno_dev,
+	struct adreno_context *drawctxt, unsigned int priority)
+{
+	struct adreno_dispatcher *dispatcher = &adreno_dev->dispatcher;
+
+	mutex_lock(&dispatcher->mutex);
+	spin_lock(&dispatcher->plist_lock);
+
+	if (!plist_node_empty(&drawctxt->pending)) {
+		plist_del(&drawctxt->pending, &dispatcher->pending);
+		plist_node_init(&drawctxt->pending, priority);
+		plist_add(&drawctxt->pending, &dispatcher->pending);
+	} else
+		plist_node_init(&drawctxt->pending, priority);
+
+	drawctxt->base.flags &= ~KGSL_CONTEXT_PRIORITY_MASK;
+	drawctxt->base.flags |= priority << KGSL_CONTEXT_PRIORITY_SHIFT;
+
+	spin_unlock(&dispatcher->plist_lock);
+	mutex_unlock(&dispatcher->mutex);
+
+	adreno_dispatcher_schedule(&adreno_dev->dev);
+}
+
 /*
  * This is called on a regular basis while command batches are inflight.  Fault
  * detection registers are read and compared to the existing values - if they
@@ -1958,6 +2064,10 @@ static DISPATCHER_UINT_ATTR(fault_throttle_time, 0644, 0,
 	_fault_throttle_time);
 static DISPATCHER_UINT_ATTR(fault_throttle_burst, 0644, 0,
 	_fault_throttle_burst);
+static DISPATCHER_UINT_ATTR(low_priority_inflight, 0644,
+	ADRENO_DISPATCH_CMDQUEUE_SIZE, _dispatcher_low_inflight);
+static DISPATCHER_UINT_ATTR(context_starve_time, 0644, 0,
+	_context_starve_time);
 
 static struct attribute *dispatcher_attrs[] = {
 	&dispatcher_attr_inflight.attr,
@@ -1968,6 +2078,8 @@ static struct attribute *dispatcher_attrs[] = {
 	&dispatcher_attr_fault_detect_interval.attr,
 	&dispatcher_attr_fault_throttle_time.attr,
 	&dispatcher_attr_fault_throttle_burst.attr,
+	&dispatcher_attr_low_priority_inflight.attr,
+	&dispatcher_attr_context_starve_time.attr,
 	NULL,
 };
 
@@ -450,6 +450,7 @@ adreno_drawctxt_create(struct kgsl_device_private *dev_priv,
 	struct adreno_context *drawctxt;
 	struct kgsl_device *device = dev_priv->device;
 	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+	unsigned int priority;
 	int ret;
 
 	drawctxt = kzalloc(sizeof(struct adreno_context), GFP_KERNEL);
@@ -473,7 +474,8 @@ adreno_drawctxt_create(struct kgsl_device_private *dev_priv,
 		KGSL_CONTEXT_NO_FAULT_TOLERANCE |
 		KGSL_CONTEXT_CTX_SWITCH |
 		KGSL_CONTEXT_TYPE_MASK |
-		KGSL_CONTEXT_PWR_CONSTRAINT);
+		KGSL_CONTEXT_PWR_CONSTRAINT |
+		KGSL_CONTEXT_PRIORITY_MASK);
 
 	/* Always enable per-context timestamps */
 	drawctxt->base.flags |= KGSL_CONTEXT_PER_CONTEXT_TS;
@@ -484,12 +486,21 @@ adreno_drawctxt_create(struct kgsl_device_private *dev_priv,
 	init_waitqueue_head(&drawctxt->waiting);
 
 	/*
-	 * Set up the plist node for the dispatcher.  For now all contexts have
-	 * the same priority, but later the priority will be set at create time
-	 * by the user
+	 * Set up the plist node for the dispatcher with the priority asked
+	 * for, and report the one we settled on back in the flags
 	 */
 
-	plist_node_init(&drawctxt->pending, ADRENO_CONTEXT_DEFAULT_PRIORITY);
+	priority = (drawctxt->base.flags & KGSL_CONTEXT_PRIORITY_MASK) >>
+		KGSL_CONTEXT_PRIORITY_SHIFT;
+	if (priority == KGSL_CONTEXT_PRIORITY_UNDEF ||
+		(priority < ADRENO_CONTEXT_DEFAULT_PRIORITY &&
+		 !capable(CAP_SYS_NICE)))
+		priority = ADRENO_CONTEXT_DEFAULT_PRIORITY;
+
+	drawctxt->base.flags &= ~KGSL_CONTEXT_PRIORITY_MASK;
+	drawctxt->base.flags |= priority << KGSL_CONTEXT_PRIORITY_SHIFT;
+
+	plist_node_init(&drawctxt->pending, priority);
 
 	if (adreno_dev->gpudev->ctxt_create) {
 		ret = adreno_dev->gpudev->ctxt_create(adreno_dev, drawctxt);
@@ -33,7 +33,10 @@ struct adreno_context_type {
 
 #define ADRENO_CONTEXT_CMDQUEUE_SIZE 128
 
-#define ADRENO_CONTEXT_DEFAULT_PRIORITY 1
+/* Dispatch priorities, lower is more important (plist order) */
+#define ADRENO_CONTEXT_MAX_PRIORITY 1
+#define ADRENO_CONTEXT_DEFAULT_PRIORITY 8
+#define ADRENO_CONTEXT_MIN_PRIORITY 15
 
 #define ADRENO_CONTEXT_STATE_ACTIVE 0
 #define ADRENO_CONTEXT_STATE_INVALID 1
@@ -126,6 +129,7 @@ extern const struct adreno_context_ops adreno_preamble_ctx_ops;
  * @cmdqueue_head: Head of the cmdqueue queue
  * @cmdqueue_tail: Tail of the cmdqueue queue
  * @pending: Priority list node for the dispatcher list of pending contexts
+ * @pending_since: Jiffies when the context was put on the pending list
  * @wq: Workqueue structure for contexts to sleep pending room in the queue
  * @waiting: Workqueue structure for contexts waiting for a timestamp or event
  * @queued: Number of commands queued in the cmdqueue
@@ -133,6 +137,9 @@ extern const struct adreno_context_ops adreno_preamble_ctx_ops;
  * @fault_policy: GFT fault policy set in cmdbatch_skip_cmd();
  * @queued_timestamp: The last timestamp that was queued on this context
  * @submitted_timestamp: The last timestamp that was submitted for this context
+ * @gpu_time: GPU busy time used by this context in microseconds
+ * @frame_time: GPU busy time since the last end of frame in microseconds
+ * @frames: Number of end of frame command batches retired
  */
 struct adreno_context {
 	struct kgsl_context base;
@@ -174,6 +181,7 @@ struct adreno_context {
 	unsigned int cmdqueue_tail;
 
 	struct plist_node pending;
+	unsigned long pending_since;
 	wait_queue_head_t wq;
 	wait_queue_head_t waiting;
 
@@ -183,6 +191,9 @@ struct adreno_context {
 	unsigned int fault_policy;
 	unsigned int queued_timestamp;
 	unsigned int submitted_timestamp;
+	u64 gpu_time;
+	unsigned int frame_time;
+	unsigned int frames;
 };
 
 /**
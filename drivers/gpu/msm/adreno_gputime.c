@@ -0,0 +1,187 @@
+/* Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include <linux/kernel.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include "kgsl.h"
+#include "kgsl_sharedmem.h"
+#include "adreno.h"
+#include "adreno_trace.h"
+
+/*
+ * GPU time accounting. The ringbuffer has the CP copy the free running GPU
+ * busy counter into the command batch's slot before the IBs and again after
+ * the wait for idle that follows them. When the batch retires the
+ * difference is the number of cycles the GPU was busy on it, which is
+ * charged to the context and its process.
+ */
+
+/**
+ * adreno_gputime_ready() - Check if command batches should be sampled
+ * @adreno_dev: Pointer to the adreno device
+ *
+ * A2XX has no free running busy counter we can read from the CP
+ */
+bool adreno_gputime_ready(struct adreno_device *adreno_dev)
+{
+	return !adreno_is_a2xx(adreno_dev) &&
+		adreno_dev->gputime.buffer.hostptr != NULL;
+}
+
+/**
+ * adreno_gputime_retire() - Account the GPU time of a retired command batch
+ * @adreno_dev: Pointer to the adreno device
+ * @cmdbatch: The command batch that has just retired
+ *
+ * Called by the dispatcher in retire order with the device mutex held.
+ */
+void adreno_gputime_retire(struct adreno_device *adreno_dev,
+		struct kgsl_cmdbatch *cmdbatch)
+{
+	struct adreno_gputime *gputime = &adreno_dev->gputime;
+	struct kgsl_pwrctrl *pwr = &adreno_dev->dev.pwrctrl;
+	struct adreno_context *drawctxt = ADRENO_CONTEXT(cmdbatch->context);
+	unsigned int *slot, start, end, freq, usecs = 0;
+
+	if (!test_and_clear_bit(CMDBATCH_FLAG_GPUTIME, &cmdbatch->priv))
+		return;
+
+	slot = gputime->buffer.hostptr;
+	slot += cmdbatch->gputime_slot * 2;
+
+	rmb();
+	start = slot[0];
+	end = slot[1];
+
+	/*
+	 * The CP reads the start sample as soon as it gets to the batch,
+	 * likely while the previous one is still finishing. Don't charge
+	 * those cycles twice. If the counter was reset by a power collapse
+	 * last_end is meaningless and falls outside [start, end].
+	 */
+	if ((int) (gputime->last_end - start) > 0 &&
+		(int) (end - gputime->last_end) >= 0)
+		start = gputime->last_end;
+
+	gputime->last_end = end;
+
+	freq = kgsl_pwrctrl_active_freq(pwr) / 1000000;
+	if (freq && (int) (end - start) > 0)
+		usecs = (end - start) / freq;
+
+	drawctxt->gpu_time += usecs;
+	drawctxt->frame_time += usecs;
+	atomic64_add(usecs, &cmdbatch->context->proc_priv->gpu_time);
+
+	trace_adreno_cmdbatch_gputime(cmdbatch, usecs);
+
+	if (cmdbatch->flags & KGSL_CMDBATCH_END_OF_FRAME) {
+		int bucket = fls(drawctxt->frame_time / 1000);
+
+		gputime->frames[min(bucket, ADRENO_GPUTIME_BUCKETS - 1)]++;
+		drawctxt->frames++;
+		drawctxt->frame_time = 0;
+	}
+}
+
+static int gputime_print(struct seq_file *s, void *unused)
+{
+	struct kgsl_device *device = s->private;
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+	struct kgsl_process_private *private;
+	struct kgsl_context *context;
+	int i, next = 0;
+
+	seq_puts(s, "frame_ms frames\n");
+	for (i = 0; i < ADRENO_GPUTIME_BUCKETS; i++)
+		seq_printf(s, "%s%u %u\n",
+			i == ADRENO_GPUTIME_BUCKETS - 1 ? ">=" : "<",
+			i == ADRENO_GPUTIME_BUCKETS - 1 ? 1 << (i - 1) : 1 << i,
+			adreno_dev->gputime.frames[i]);
+
+	seq_puts(s, "\nctx pid gpu_time_us frames\n");
+	read_lock(&device->context_lock);
+	while (1) {
+		struct adreno_context *drawctxt;
+
+		context = idr_get_next(&device->context_idr, &next);
+		if (context == NULL)
+			break;
+
+		drawctxt = ADRENO_CONTEXT(context);
+		seq_printf(s, "%u %d %llu %u\n", context->id,
+			context->proc_priv->pid, drawctxt->gpu_time,
+			drawctxt->frames);
+		next++;
+	}
+	read_unlock(&device->context_lock);
+
+	seq_puts(s, "\npid gpu_time_us\n");
+	mutex_lock(&kgsl_driver.process_mutex);
+	list_for_each_entry(private, &kgsl_driver.process_list, list)
+		seq_printf(s, "%d %lld\n", private->pid,
+			(long long) atomic64_read(&private->gpu_time));
+	mutex_unlock(&kgsl_driver.process_mutex);
+
+	return 0;
+}
+
+static int gputime_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, gputime_print, inode->i_private);
+}
+
+static ssize_t gputime_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct kgsl_device *device = s->private;
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+
+	/* Any write clears the frame histogram */
+	memset(adreno_dev->gputime.frames, 0,
+		sizeof(adreno_dev->gputime.frames));
+
+	return count;
+}
+
+static const struct file_operations gputime_fops = {
+	.open = gputime_open,
+	.read = seq_read,
+	.write = gputime_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void adreno_gputime_init(struct kgsl_device *device)
+{
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+	struct adreno_gputime *gputime = &adreno_dev->gputime;
+
+	if (kgsl_allocate_contiguous(&gputime->buffer, PAGE_SIZE)) {
+		gputime->buffer.hostptr = NULL;
+		return;
+	}
+
+	debugfs_create_file("gputime", 0644, device->d_debugfs, device,
+			&gputime_fops);
+}
+
+void adreno_gputime_close(struct kgsl_device *device)
+{
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+
+	kgsl_sharedmem_free(&adreno_dev->gputime.buffer);
+	adreno_dev->gputime.buffer.hostptr = NULL;
+}
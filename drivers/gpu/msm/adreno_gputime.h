@@ -0,0 +1,57 @@
+/* Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#ifndef __ADRENO_GPUTIME_H
+#define __ADRENO_GPUTIME_H
+
+/*
+ * Each command batch gets a slot of two dwords in the gputime buffer, the
+ * GPU busy counter at the start and at the end of the batch. Slots are
+ * picked by the ringbuffer global timestamp so there must be more of them
+ * than command batches that can be inflight at once.
+ */
+#define ADRENO_GPUTIME_SLOTS	(PAGE_SIZE / (2 * sizeof(unsigned int)))
+
+#define ADRENO_GPUTIME_SLOT(_ts) ((_ts) % ADRENO_GPUTIME_SLOTS)
+
+#define ADRENO_GPUTIME_START(_adreno_dev, _ts) \
+	((_adreno_dev)->gputime.buffer.gpuaddr + \
+	 ADRENO_GPUTIME_SLOT(_ts) * 2 * sizeof(unsigned int))
+
+#define ADRENO_GPUTIME_END(_adreno_dev, _ts) \
+	(ADRENO_GPUTIME_START(_adreno_dev, _ts) + sizeof(unsigned int))
+
+/* Frame histogram buckets: < 1ms, < 2ms, < 4ms ... >= 256ms */
+#define ADRENO_GPUTIME_BUCKETS	10
+
+/**
+ * struct adreno_gputime - Per device GPU time accounting
+ * @buffer: Memory the GPU writes the busy counter samples into
+ * @last_end: Busy counter at the end of the last retired command batch
+ * @frames: Histogram of GPU time per frame
+ */
+struct adreno_gputime {
+	struct kgsl_memdesc buffer;
+	unsigned int last_end;
+	unsigned int frames[ADRENO_GPUTIME_BUCKETS];
+};
+
+struct adreno_device;
+struct kgsl_cmdbatch;
+
+void adreno_gputime_init(struct kgsl_device *device);
+void adreno_gputime_close(struct kgsl_device *device);
+bool adreno_gputime_ready(struct adreno_device *adreno_dev);
+void adreno_gputime_retire(struct adreno_device *adreno_dev,
+		struct kgsl_cmdbatch *cmdbatch);
+
+#endif
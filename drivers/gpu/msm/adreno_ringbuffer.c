@@ -673,6 +673,9 @@ adreno_ringbuffer_addcmds(struct adreno_ringbuffer *rb,
 	if (profile_ready)
 		total_sizedwords += 6;   /* space for pre_ib and post_ib */
 
+	if (flags & KGSL_CMD_FLAGS_GPUTIME)
+		total_sizedwords += 6;   /* busy counter start and end */
+
 	/* Add space for the power on shader fixup if we need it */
 	if (flags & KGSL_CMD_FLAGS_PWRON_FIXUP)
 		total_sizedwords += 9;
@@ -730,6 +733,16 @@ adreno_ringbuffer_addcmds(struct adreno_ringbuffer *rb,
 		KGSL_MEMSTORE_OFFSET(context_id, soptimestamp)));
 	GSL_RB_WRITE(rb->device, ringcmds, rcmd_gpu, timestamp);
 
+	if (flags & KGSL_CMD_FLAGS_GPUTIME) {
+		GSL_RB_WRITE(rb->device, ringcmds, rcmd_gpu,
+			cp_type3_packet(CP_REG_TO_MEM, 2));
+		GSL_RB_WRITE(rb->device, ringcmds, rcmd_gpu,
+			adreno_getreg(adreno_dev,
+				ADRENO_REG_RBBM_PERFCTR_PWR_1_LO));
+		GSL_RB_WRITE(rb->device, ringcmds, rcmd_gpu,
+			ADRENO_GPUTIME_START(adreno_dev, rb->global_ts));
+	}
+
 	if (flags & KGSL_CMD_FLAGS_PMODE) {
 		/* disable protected mode error checking */
 		GSL_RB_WRITE(rb->device, ringcmds, rcmd_gpu,
@@ -774,6 +787,17 @@ adreno_ringbuffer_addcmds(struct adreno_ringbuffer *rb,
 		GSL_RB_WRITE(rb->device, ringcmds, rcmd_gpu, 0x00);
 	}
 
+	/* The wait for idle above makes this land after the IBs are done */
+	if (flags & KGSL_CMD_FLAGS_GPUTIME) {
+		GSL_RB_WRITE(rb->device, ringcmds, rcmd_gpu,
+			cp_type3_packet(CP_REG_TO_MEM, 2));
+		GSL_RB_WRITE(rb->device, ringcmds, rcmd_gpu,
+			adreno_getreg(adreno_dev,
+				ADRENO_REG_RBBM_PERFCTR_PWR_1_LO));
+		GSL_RB_WRITE(rb->device, ringcmds, rcmd_gpu,
+			ADRENO_GPUTIME_END(adreno_dev, rb->global_ts));
+	}
+
 	/* Add any postIB required for profiling if it is enabled and has
 	   assigned counters */
 	if (profile_ready)
@@ -1321,6 +1345,9 @@ int adreno_ringbuffer_submitcmd(struct adreno_device *adreno_dev,
 	/* Set the constraints before adding to ringbuffer */
 	adreno_ringbuffer_set_constraint(device, cmdbatch);
 
+	if (adreno_gputime_ready(adreno_dev))
+		flags |= KGSL_CMD_FLAGS_GPUTIME;
+
 	/* CFF stuff executed only if CFF is enabled */
 	kgsl_cffdump_capture_ib_desc(device, context, cmdbatch);
 
@@ -1330,6 +1357,12 @@ int adreno_ringbuffer_submitcmd(struct adreno_device *adreno_dev,
 					&link[0], (cmds - link),
 					cmdbatch->timestamp);
 
+	if (ret == 0 && (flags & KGSL_CMD_FLAGS_GPUTIME)) {
+		cmdbatch->gputime_slot =
+			ADRENO_GPUTIME_SLOT(adreno_dev->ringbuffer.global_ts);
+		set_bit(CMDBATCH_FLAG_GPUTIME, &cmdbatch->priv);
+	}
+
 #ifdef CONFIG_MSM_KGSL_CFF_DUMP
 	if (ret)
 		goto done;
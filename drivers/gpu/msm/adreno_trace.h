@@ -103,6 +103,30 @@ TRACE_EVENT(adreno_cmdbatch_retired,
 	)
 );
 
+TRACE_EVENT(adreno_cmdbatch_gputime,
+	TP_PROTO(struct kgsl_cmdbatch *cmdbatch, unsigned int usecs),
+	TP_ARGS(cmdbatch, usecs),
+	TP_STRUCT__entry(
+		__field(unsigned int, id)
+		__field(unsigned int, timestamp)
+		__field(unsigned int, usecs)
+		__field(unsigned int, flags)
+	),
+	TP_fast_assign(
+		__entry->id = cmdbatch->context->id;
+		__entry->timestamp = cmdbatch->timestamp;
+		__entry->usecs = usecs;
+		__entry->flags = cmdbatch->flags;
+	),
+	TP_printk(
+		"ctx=%u ts=%u usecs=%u flags=%s",
+			__entry->id, __entry->timestamp, __entry->usecs,
+			__entry->flags ? __print_flags(__entry->flags, "|",
+				{ KGSL_CMDBATCH_END_OF_FRAME, "EOF" },
+				{ KGSL_CMDBATCH_MARKER, "MARKER" }) : "none"
+	)
+);
+
 TRACE_EVENT(adreno_cmdbatch_fault,
 	TP_PROTO(struct kgsl_cmdbatch *cmdbatch, unsigned int fault),
 	TP_ARGS(cmdbatch, fault),
@@ -31,12 +31,14 @@
 #include <linux/mman.h>
 #include <linux/sort.h>
 #include <asm/cacheflush.h>
+#include <asm/tlbflush.h>
 
 #include "kgsl.h"
 #include "kgsl_debugfs.h"
 #include "kgsl_cffdump.h"
 #include "kgsl_log.h"
 #include "kgsl_sharedmem.h"
+#include "kgsl_pool.h"
 #include "kgsl_device.h"
 #include "kgsl_trace.h"
 #include "kgsl_sync.h"
@@ -3175,6 +3177,92 @@ error:
 	return result;
 }
 
+static struct vm_operations_struct kgsl_gpumem_vm_ops;
+
+struct kgsl_dirty_walk {
+	struct vm_area_struct *vma;
+	bool dirty;
+};
+
+static int kgsl_clear_dirty_pte_range(pmd_t *pmd, unsigned long addr,
+				      unsigned long end, struct mm_walk *walk)
+{
+	struct kgsl_dirty_walk *dw = walk->private;
+	struct mm_struct *mm = dw->vma->vm_mm;
+	spinlock_t *ptl;
+	pte_t *pte, ptent;
+
+	pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		ptent = *pte;
+		if (!pte_present(ptent) || !pte_dirty(ptent))
+			continue;
+
+		/* the next write faults and marks the pte dirty again */
+		set_pte_at(mm, addr, pte, pte_mkclean(ptent));
+		dw->dirty = true;
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+
+	return 0;
+}
+
+/*
+ * _kgsl_mem_entry_test_clear_dirty - Check if the CPU may have written to
+ * the buffer since the last call, and start tracking again from here.
+ *
+ * Writes through the userspace mapping of the calling process are found
+ * from the dirty bits of its ptes, which are cleared. Anything we can't
+ * see that way (a kernel mapping, a mapping held by another process, a
+ * writable mapping that has been torn down) counts as dirty.
+ */
+static bool _kgsl_mem_entry_test_clear_dirty(struct kgsl_mem_entry *entry)
+{
+	struct kgsl_memdesc *memdesc = &entry->memdesc;
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
+	struct kgsl_dirty_walk dw = { .dirty = false };
+	struct mm_walk walk = {
+		.pmd_entry = kgsl_clear_dirty_pte_range,
+		.private = &dw,
+	};
+	unsigned long start = memdesc->useraddr;
+
+	if (memdesc->priv & KGSL_MEMDESC_CPU_DIRTY) {
+		memdesc->priv &= ~KGSL_MEMDESC_CPU_DIRTY;
+		dw.dirty = true;
+	}
+
+	if (memdesc->hostptr)
+		dw.dirty = true;
+
+	if (!start || dw.dirty)
+		return dw.dirty;
+
+	if (!mm)
+		return true;
+
+	down_read(&mm->mmap_sem);
+	vma = find_vma(mm, start);
+	if (vma && vma->vm_start == start &&
+	    vma->vm_end - start == kgsl_memdesc_mmapsize(memdesc) &&
+	    vma->vm_ops == &kgsl_gpumem_vm_ops &&
+	    vma->vm_private_data == entry) {
+		if (vma->vm_flags & VM_WRITE) {
+			dw.vma = vma;
+			walk.mm = mm;
+			walk_page_range(start, vma->vm_end, &walk);
+			if (dw.dirty)
+				flush_tlb_range(vma, start, vma->vm_end);
+		}
+	} else {
+		dw.dirty = true;
+	}
+	up_read(&mm->mmap_sem);
+
+	return dw.dirty;
+}
+
 static int _kgsl_gpumem_sync_cache(struct kgsl_mem_entry *entry, int op)
 {
 	int ret = 0;
@@ -3199,12 +3287,21 @@ static int _kgsl_gpumem_sync_cache(struct kgsl_mem_entry *entry, int op)
 	}
 
 	mode = kgsl_memdesc_get_cachemode(&entry->memdesc);
-	if (mode != KGSL_CACHEMODE_UNCACHED
-		&& mode != KGSL_CACHEMODE_WRITECOMBINE) {
-		trace_kgsl_mem_sync_cache(entry, op);
-		kgsl_cache_range_op(&entry->memdesc, cacheop);
+	if (mode == KGSL_CACHEMODE_UNCACHED
+		|| mode == KGSL_CACHEMODE_WRITECOMBINE)
+		goto done;
+
+	/* nothing to write back if the CPU hasn't written */
+	if (cacheop != KGSL_CACHE_OP_INV &&
+	    !_kgsl_mem_entry_test_clear_dirty(entry)) {
+		if (cacheop == KGSL_CACHE_OP_CLEAN)
+			goto done;
+		cacheop = KGSL_CACHE_OP_INV;
 	}
 
+	trace_kgsl_mem_sync_cache(entry, op);
+	kgsl_cache_range_op(&entry->memdesc, cacheop);
+
 done:
 	return ret;
 }
@@ -3903,6 +4000,10 @@ kgsl_gpumem_vm_close(struct vm_area_struct *vma)
 	if (!entry)
 		return;
 
+	/* the CPU caches may still hold what was written through it */
+	if (vma->vm_flags & VM_WRITE)
+		entry->memdesc.priv |= KGSL_MEMDESC_CPU_DIRTY;
+
 	entry->memdesc.useraddr = 0;
 	kgsl_mem_entry_put(entry);
 }
@@ -4557,6 +4658,7 @@ static void kgsl_core_exit(void)
 		kmem_cache_destroy(memobjs_cache);
 
 	kgsl_memfree_exit();
+	kgsl_pool_exit();
 	unregister_chrdev_region(kgsl_driver.major, KGSL_DEVICE_MAX);
 }
 
@@ -4613,6 +4715,7 @@ static int __init kgsl_core_init(void)
 
 	kgsl_core_debugfs_init();
 
+	kgsl_sharedmem_calibrate_cache();
 	kgsl_sharedmem_init_sysfs();
 	kgsl_cffdump_init();
 
@@ -4640,6 +4743,9 @@ static int __init kgsl_core_init(void)
 
 	kgsl_events_init();
 
+	/* without the pool we just allocate from the system */
+	kgsl_pool_init();
+
 	return 0;
 
 err:
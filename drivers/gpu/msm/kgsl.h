@@ -120,6 +120,8 @@ struct kgsl_driver {
 		atomic_t coherent_max;
 		atomic_t mapped;
 		atomic_t mapped_max;
+		atomic_t pool_hits;
+		atomic_t pool_misses;
 	} stats;
 	unsigned int full_cache_threshold;
 };
@@ -147,6 +149,8 @@ struct kgsl_memdesc_ops {
 #define KGSL_MEMDESC_FROZEN BIT(2)
 /* The memdesc is mapped into a pagetable */
 #define KGSL_MEMDESC_MAPPED BIT(3)
+/* The CPU may have written to the memdesc since its last cache clean */
+#define KGSL_MEMDESC_CPU_DIRTY BIT(4)
 
 /* shared memory allocation */
 struct kgsl_memdesc {
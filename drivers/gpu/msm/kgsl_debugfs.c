@@ -13,6 +13,7 @@
 
 #include <linux/module.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "kgsl.h"
 #include "kgsl_device.h"
@@ -123,6 +124,41 @@ KGSL_DEBUGFS_LOG(ctxt_log);
 KGSL_DEBUGFS_LOG(mem_log);
 KGSL_DEBUGFS_LOG(pwr_log);
 
+static int event_stats_print(struct seq_file *s, void *unused)
+{
+	struct kgsl_device *device = s->private;
+	struct kgsl_event_stats stats;
+	int i;
+
+	spin_lock(&device->events_fired_lock);
+	stats = device->event_stats;
+	spin_unlock(&device->events_fired_lock);
+
+	seq_printf(s, "batches %u\nevents %u\nmax %u\n", stats.batches,
+		stats.events, stats.max);
+
+	seq_puts(s, "events_per_batch count\n");
+	for (i = 0; i < KGSL_EVENT_BATCH_BUCKETS; i++)
+		seq_printf(s, "%s%u %u\n",
+			i == KGSL_EVENT_BATCH_BUCKETS - 1 ? ">=" : "<",
+			i == KGSL_EVENT_BATCH_BUCKETS - 1 ? 1 << i : 1 << (i + 1),
+			stats.hist[i]);
+
+	return 0;
+}
+
+static int event_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, event_stats_print, inode->i_private);
+}
+
+static const struct file_operations event_stats_fops = {
+	.open = event_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 void kgsl_device_debugfs_init(struct kgsl_device *device)
 {
 	if (kgsl_debugfs_dir && !IS_ERR(kgsl_debugfs_dir))
@@ -142,6 +178,8 @@ void kgsl_device_debugfs_init(struct kgsl_device *device)
 				&mem_log_fops);
 	debugfs_create_file("log_level_pwr", 0644, device->d_debugfs, device,
 				&pwr_log_fops);
+	debugfs_create_file("event_stats", 0444, device->d_debugfs, device,
+				&event_stats_fops);
 
 	/* Create postmortem dump control files */
 
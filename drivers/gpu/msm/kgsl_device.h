@@ -165,9 +165,9 @@ typedef void (*kgsl_event_func)(struct kgsl_device *, struct kgsl_context *,
  * @timestamp: Timestamp for the event to expire
  * @func: Callback function for for the event when it expires
  * @priv: Private data passed to the callback function
- * @node: List node for the kgsl_event_group list
+ * @node: List node for the kgsl_event_group list, then the device list of
+ * events waiting for their callback
  * @created: Jiffies when the event was created
- * @work: Work struct for dispatching the callback
  * @result: KGSL event result type to pass to the callback
  */
 struct kgsl_event {
@@ -178,15 +178,31 @@ struct kgsl_event {
 	void *priv;
 	struct list_head node;
 	unsigned int created;
-	struct work_struct work;
 	int result;
 };
 
+/* Events per callback batch: 1, 2-3, 4-7 ... >= 64 */
+#define KGSL_EVENT_BATCH_BUCKETS 7
+
+/**
+ * struct kgsl_event_stats - How events are batched up for their callbacks
+ * @batches: Number of times the event worker ran callbacks
+ * @events: Number of events fired
+ * @max: Largest number of events fired in one batch
+ * @hist: Histogram of events per batch
+ */
+struct kgsl_event_stats {
+	unsigned int batches;
+	unsigned int events;
+	unsigned int max;
+	unsigned int hist[KGSL_EVENT_BATCH_BUCKETS];
+};
+
 /**
  * struct event_group - A list of GPU events
  * @context: Pointer to the active context for the events
  * @lock: Spinlock for protecting the list
- * @events: List of active GPU events
+ * @events: List of active GPU events, sorted by timestamp
  * @group: Node for the master group list
  * @processed: Last processed timestamp
  */
@@ -256,6 +272,8 @@ struct kgsl_cmdbatch {
 	struct list_head synclist;
 	struct timer_list timer;
 	unsigned int marker_timestamp;
+	ktime_t submit_time;
+	unsigned int gputime_slot;
 };
 
 /**
@@ -265,6 +283,8 @@ struct kgsl_cmdbatch {
  * @CMDBATCH_FLAG_WFI - Force wait-for-idle for the submission
  * @CMDBATCH_FLAG_FENCE_LOG - Set if the cmdbatch is dumping fence logs via the
  * cmdbatch timer - this is used to avoid recursion
+ * @CMDBATCH_FLAG_GPUTIME - Set if the GPU samples its busy counter for the
+ * cmdbatch in the gputime slot
  */
 
 enum kgsl_cmdbatch_priv {
@@ -272,6 +292,7 @@ enum kgsl_cmdbatch_priv {
 	CMDBATCH_FLAG_FORCE_PREAMBLE,
 	CMDBATCH_FLAG_WFI,
 	CMDBATCH_FLAG_FENCE_LOG,
+	CMDBATCH_FLAG_GPUTIME,
 };
 
 struct kgsl_device {
@@ -362,6 +383,11 @@ struct kgsl_device {
 	int reset_counter; /* Track how many GPU core resets have occured */
 	int cff_dump_enable;
 	struct workqueue_struct *events_wq;
+	/* Events retired or cancelled, waiting for events_work to run them */
+	struct list_head events_fired;
+	spinlock_t events_fired_lock;
+	struct work_struct events_work;
+	struct kgsl_event_stats event_stats;
 
 	struct kgsl_event_group global_events;
 	struct kgsl_event_group iommu_events;
@@ -375,6 +401,10 @@ struct kgsl_device {
 			kgsl_idle_check),\
 	.event_work  = __WORK_INITIALIZER((_dev).event_work,\
 			kgsl_process_events),\
+	.events_fired = LIST_HEAD_INIT((_dev).events_fired),\
+	.events_fired_lock = __SPIN_LOCK_UNLOCKED((_dev).events_fired_lock),\
+	.events_work = __WORK_INITIALIZER((_dev).events_work,\
+			kgsl_fire_events),\
 	.context_idr = IDR_INIT((_dev).context_idr),\
 	.wait_queue = __WAIT_QUEUE_HEAD_INITIALIZER((_dev).wait_queue),\
 	.active_cnt_wq = __WAIT_QUEUE_HEAD_INITIALIZER((_dev).active_cnt_wq),\
@@ -462,6 +492,7 @@ struct kgsl_process_private {
 	struct rb_root mem_rb;
 	struct idr mem_idr;
 	struct kgsl_pagetable *pagetable;
+	atomic64_t gpu_time;
 	struct list_head list;
 	struct kobject kobj;
 	struct dentry *debug_root;
@@ -607,6 +638,7 @@ void kgsl_process_event_group(struct kgsl_device *device,
 	struct kgsl_event_group *group);
 
 void kgsl_process_events(struct work_struct *work);
+void kgsl_fire_events(struct work_struct *work);
 
 static inline struct kgsl_device_platform_data *
 kgsl_device_get_drvdata(struct kgsl_device *dev)
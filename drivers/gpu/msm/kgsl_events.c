@@ -25,35 +25,78 @@
  */
 static struct kmem_cache *events_cache;
 
+/*
+ * Fired events are moved to the device list and run in batches by a single
+ * work item, so an interrupt retiring a lot of timestamps takes one trip
+ * through the workqueue instead of one per event. Callers queue the work
+ * once they are done signaling.
+ */
 static inline void signal_event(struct kgsl_device *device,
 		struct kgsl_event *event, int result)
 {
-	list_del(&event->node);
 	event->result = result;
-	queue_work(device->events_wq, &event->work);
+
+	spin_lock(&device->events_fired_lock);
+	list_move_tail(&event->node, &device->events_fired);
+	spin_unlock(&device->events_fired_lock);
+}
+
+static inline void fire_events(struct kgsl_device *device)
+{
+	queue_work(device->events_wq, &device->events_work);
+}
+
+static void _kgsl_event_stats(struct kgsl_device *device, unsigned int count)
+{
+	struct kgsl_event_stats *stats = &device->event_stats;
+	int bucket = min(fls(count) - 1, KGSL_EVENT_BATCH_BUCKETS - 1);
+
+	stats->batches++;
+	stats->events += count;
+	stats->max = max(stats->max, count);
+	stats->hist[bucket]++;
 }
 
 /**
- * _kgsl_event_worker() - Work handler for processing GPU event callbacks
- * @work: Pointer to the work_struct for the event
+ * kgsl_fire_events() - Work handler for processing GPU event callbacks
+ * @work: Pointer to the work_struct for the device
  *
- * Each event callback has its own work struct and is run on a event specific
- * workqeuue.  This is the worker that queues up the event callback function.
+ * Runs the callbacks of every event fired since the last time, in the
+ * order they were fired, on the event specific workqueue.
  */
-static void _kgsl_event_worker(struct work_struct *work)
+void kgsl_fire_events(struct work_struct *work)
 {
-	struct kgsl_event *event = container_of(work, struct kgsl_event, work);
-	int id = KGSL_CONTEXT_ID(event->context);
+	struct kgsl_device *device = container_of(work, struct kgsl_device,
+		events_work);
+	struct kgsl_event *event, *tmp;
+	unsigned int count = 0;
+	LIST_HEAD(events);
+
+	spin_lock(&device->events_fired_lock);
+	list_splice_init(&device->events_fired, &events);
+	list_for_each_entry(event, &events, node)
+		count++;
+	if (count)
+		_kgsl_event_stats(device, count);
+	spin_unlock(&device->events_fired_lock);
+
+	list_for_each_entry_safe(event, tmp, &events, node) {
+		int id = KGSL_CONTEXT_ID(event->context);
+
+		list_del(&event->node);
 
-	trace_kgsl_fire_event(id, event->timestamp, event->result, jiffies - event->created,
-		event->func);
+		trace_kgsl_fire_event(id, event->timestamp, event->result,
+			jiffies - event->created, event->func);
 
-	if (event->func)
-		event->func(event->device, event->context, event->priv, event->result);
+		if (event->func)
+			event->func(event->device, event->context, event->priv,
+				event->result);
 
-	kgsl_context_put(event->context);
-	kmem_cache_free(events_cache, event);
+		kgsl_context_put(event->context);
+		kmem_cache_free(events_cache, event);
+	}
 }
+EXPORT_SYMBOL(kgsl_fire_events);
 
 /**
  * kgsl_process_event_group() - Handle all the retired events in a group
@@ -85,12 +128,15 @@ void kgsl_process_event_group(struct kgsl_device *device,
 	if (timestamp_cmp(timestamp, group->processed) <= 0)
 		goto out;
 
+	/* The list is sorted, stop at the first event still pending */
 	list_for_each_entry_safe(event, tmp, &group->events, node) {
-		if (timestamp_cmp(event->timestamp, timestamp) <= 0)
-			signal_event(device, event, KGSL_EVENT_RETIRED);
+		if (timestamp_cmp(event->timestamp, timestamp) > 0)
+			break;
+		signal_event(device, event, KGSL_EVENT_RETIRED);
 	}
 
 	group->processed = timestamp;
+	fire_events(device);
 
 out:
 	spin_unlock(&group->lock);
@@ -116,6 +162,7 @@ void kgsl_cancel_events_timestamp(struct kgsl_device *device,
 			signal_event(device, event, KGSL_EVENT_CANCELLED);
 	}
 
+	fire_events(device);
 	spin_unlock(&group->lock);
 }
 EXPORT_SYMBOL(kgsl_cancel_events_timestamp);
@@ -135,6 +182,7 @@ void kgsl_cancel_events(struct kgsl_device *device,
 	list_for_each_entry_safe(event, tmp, &group->events, node)
 		signal_event(device, event, KGSL_EVENT_CANCELLED);
 
+	fire_events(device);
 	spin_unlock(&group->lock);
 }
 EXPORT_SYMBOL(kgsl_cancel_events);
@@ -160,6 +208,7 @@ void kgsl_cancel_event(struct kgsl_device *device,
 			signal_event(device, event, KGSL_EVENT_CANCELLED);
 	}
 
+	fire_events(device);
 	spin_unlock(&group->lock);
 }
 EXPORT_SYMBOL(kgsl_cancel_event);
@@ -177,7 +226,7 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 {
 	unsigned int queued, retired;
 	struct kgsl_context *context = group->context;
-	struct kgsl_event *event;
+	struct kgsl_event *event, *prev;
 
 	if (!func)
 		return -EINVAL;
@@ -206,8 +255,7 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 	event->priv = priv;
 	event->func = func;
 	event->created = jiffies;
-
-	INIT_WORK(&event->work, _kgsl_event_worker);
+	INIT_LIST_HEAD(&event->node);
 
 	trace_kgsl_register_event(KGSL_CONTEXT_ID(context), timestamp, func);
 
@@ -220,14 +268,21 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 	retired = kgsl_readtimestamp(device, context, KGSL_TIMESTAMP_RETIRED);
 
 	if (timestamp_cmp(retired, timestamp) >= 0) {
-		event->result = KGSL_EVENT_RETIRED;
-		queue_work(device->events_wq, &event->work);
+		signal_event(device, event, KGSL_EVENT_RETIRED);
+		fire_events(device);
 		spin_unlock(&group->lock);
 		return 0;
 	}
 
-	/* Add the event to the group list */
-	list_add_tail(&event->node, &group->events);
+	/*
+	 * Keep the group sorted by timestamp so retiring can stop at the
+	 * first pending event. New events almost always go at the end.
+	 */
+	list_for_each_entry_reverse(prev, &group->events, node) {
+		if (timestamp_cmp(prev->timestamp, timestamp) <= 0)
+			break;
+	}
+	list_add(&event->node, &prev->node);
 
 	spin_unlock(&group->lock);
 
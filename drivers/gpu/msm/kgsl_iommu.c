@@ -1754,8 +1754,11 @@ static void kgsl_iommu_flush_tlb_pt_current(struct kgsl_pagetable *pt)
 	if (kgsl_mmu_is_perprocess(pt->mmu) &&
 		iommu->iommu_units[0].dev[KGSL_IOMMU_CONTEXT_USER].attached &&
 		kgsl_iommu_pt_equal(pt->mmu, pt,
-		kgsl_iommu_get_current_ptbase(pt->mmu)))
+		kgsl_iommu_get_current_ptbase(pt->mmu))) {
 		kgsl_iommu_default_setstate(pt->mmu, KGSL_MMUFLAGS_TLBFLUSH);
+		/* That took care of any flush deferred by an unmap too */
+		kgsl_mmu_pt_get_flags(pt, device->id);
+	}
 
 	if (lock_taken)
 		kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
@@ -1782,7 +1785,7 @@ kgsl_iommu_unmap(struct kgsl_pagetable *pt,
 	if (kgsl_memdesc_has_guard_page(memdesc))
 		range += PAGE_SIZE;
 
-	ret = iommu_unmap_range(iommu_pt->domain, gpuaddr, range);
+	ret = iommu_unmap_range_nosync(iommu_pt->domain, gpuaddr, range);
 	if (ret) {
 		KGSL_CORE_ERR("iommu_unmap_range(%p, %x, %d) failed "
 			"with err: %d\n", iommu_pt->domain, gpuaddr,
@@ -1790,7 +1793,18 @@ kgsl_iommu_unmap(struct kgsl_pagetable *pt,
 		return ret;
 	}
 
-	kgsl_iommu_flush_tlb_pt_current(pt);
+	/*
+	 * Don't flush the TLB for every buffer that goes away. Nothing left
+	 * in the ringbuffer refers to an unmapped buffer so mark every device
+	 * as needing a flush and let it happen with the next setstate, ahead
+	 * of the next command batch that could use this range again. That
+	 * turns a pile of frees between two submissions into one flush. A
+	 * pagetable switch flushes anyway, so the mark is harmless if this
+	 * isn't the current pagetable.
+	 */
+	spin_lock(&pt->lock);
+	*tlb_flags = UINT_MAX;
+	spin_unlock(&pt->lock);
 
 	return ret;
 }
@@ -683,6 +683,9 @@ kgsl_mmu_get_gpuaddr(struct kgsl_pagetable *pagetable,
 		 */
 		if (kgsl_memdesc_get_align(memdesc) > 0)
 			page_align = kgsl_memdesc_get_align(memdesc);
+		else if (size >= SZ_64K)
+			/* let map_range use 64K entries for pool pages */
+			page_align = ilog2(SZ_64K);
 		if (kgsl_memdesc_is_global(memdesc)) {
 			/*
 			 * Only the default pagetable has a kgsl_pool, and
@@ -0,0 +1,306 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/highmem.h>
+#include <linux/kthread.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <asm/cacheflush.h>
+
+#include "kgsl.h"
+#include "kgsl_pool.h"
+
+/*
+ * A pool of pages freed by GPU buffers, for reuse by the next buffers.
+ *
+ * Freed pages go on the dirty list of the pool for their order. A
+ * SCHED_IDLE thread zeroes them, flushes them out of the CPU caches and
+ * moves them to the clean list; only clean pages are handed out, so a
+ * pool hit needs no clearing or cache maintenance at allocation time.
+ * Both lists are given back to the system under memory pressure.
+ */
+
+struct kgsl_page_pool {
+	unsigned int order;
+	spinlock_t lock;
+	struct list_head clean;
+	struct list_head dirty;
+	unsigned int clean_count;
+	unsigned int dirty_count;
+};
+
+/* the two sizes _kgsl_sharedmem_page_alloc() allocates */
+static struct kgsl_page_pool kgsl_pools[] = {
+	{ .order = 0 },
+	{ .order = 16 - PAGE_SHIFT },	/* SZ_64K */
+};
+
+/* in PAGE_SIZE pages, over all pools */
+static unsigned int kgsl_pool_max = 4096;
+static atomic_t kgsl_pool_pages = ATOMIC_INIT(0);
+
+static struct task_struct *kgsl_pool_thread;
+static DECLARE_WAIT_QUEUE_HEAD(kgsl_pool_wait);
+
+static struct kgsl_page_pool *kgsl_pool_get(unsigned int order)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++)
+		if (kgsl_pools[i].order == order)
+			return &kgsl_pools[i];
+
+	return NULL;
+}
+
+/**
+ * kgsl_pool_alloc_page() - Get a zeroed, flushed page from the pool
+ * @order: order of the page
+ *
+ * Returns NULL if the pool for @order has no clean page. The caller
+ * then allocates from the system and clears the page itself.
+ */
+struct page *kgsl_pool_alloc_page(unsigned int order)
+{
+	struct kgsl_page_pool *pool = kgsl_pool_get(order);
+	struct page *page = NULL;
+
+	if (pool) {
+		spin_lock(&pool->lock);
+		if (pool->clean_count) {
+			page = list_first_entry(&pool->clean, struct page,
+						lru);
+			list_del(&page->lru);
+			pool->clean_count--;
+		}
+		spin_unlock(&pool->lock);
+	}
+
+	if (page) {
+		atomic_sub(1 << order, &kgsl_pool_pages);
+		atomic_inc(&kgsl_driver.stats.pool_hits);
+	} else {
+		atomic_inc(&kgsl_driver.stats.pool_misses);
+	}
+
+	return page;
+}
+
+/**
+ * kgsl_pool_free_page() - Give a page of a freed GPU buffer back
+ * @page: the page
+ * @order: order of the page
+ *
+ * The page is kept for reuse if the pool isn't full, otherwise it is
+ * freed.
+ */
+void kgsl_pool_free_page(struct page *page, unsigned int order)
+{
+	struct kgsl_page_pool *pool = kgsl_pool_get(order);
+
+	if (!pool || !kgsl_pool_thread ||
+	    atomic_read(&kgsl_pool_pages) + (1 << order) > kgsl_pool_max) {
+		__free_pages(page, order);
+		return;
+	}
+
+	atomic_add(1 << order, &kgsl_pool_pages);
+	spin_lock(&pool->lock);
+	list_add_tail(&page->lru, &pool->dirty);
+	pool->dirty_count++;
+	spin_unlock(&pool->lock);
+
+	wake_up(&kgsl_pool_wait);
+}
+
+static void kgsl_pool_zero_page(struct page *page, unsigned int order)
+{
+	int i;
+
+	for (i = 0; i < (1 << order); i++) {
+		void *ptr = kmap_atomic(nth_page(page, i));
+
+		memset(ptr, 0, PAGE_SIZE);
+		dmac_flush_range(ptr, ptr + PAGE_SIZE);
+		kunmap_atomic(ptr);
+	}
+
+	outer_flush_range(page_to_phys(page),
+			  page_to_phys(page) + (PAGE_SIZE << order));
+}
+
+/* Clean one dirty page, returns false if there was none */
+static bool kgsl_pool_clean_one(void)
+{
+	struct kgsl_page_pool *pool;
+	struct page *page;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++) {
+		pool = &kgsl_pools[i];
+
+		spin_lock(&pool->lock);
+		if (!pool->dirty_count) {
+			spin_unlock(&pool->lock);
+			continue;
+		}
+		page = list_first_entry(&pool->dirty, struct page, lru);
+		list_del(&page->lru);
+		pool->dirty_count--;
+		spin_unlock(&pool->lock);
+
+		kgsl_pool_zero_page(page, pool->order);
+
+		spin_lock(&pool->lock);
+		list_add_tail(&page->lru, &pool->clean);
+		pool->clean_count++;
+		spin_unlock(&pool->lock);
+		return true;
+	}
+
+	return false;
+}
+
+static bool kgsl_pool_has_dirty(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++)
+		if (ACCESS_ONCE(kgsl_pools[i].dirty_count))
+			return true;
+
+	return false;
+}
+
+static int kgsl_pool_zero_thread(void *data)
+{
+	struct sched_param param = { .sched_priority = 0 };
+
+	/* only clear pages when there is nothing else to do */
+	sched_setscheduler_nocheck(current, SCHED_IDLE, &param);
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(kgsl_pool_wait,
+			kgsl_pool_has_dirty() || kthread_should_stop());
+
+		while (kgsl_pool_clean_one())
+			cond_resched();
+	}
+
+	return 0;
+}
+
+/* Free up to @nr_pages pages from the pool, dirty ones first */
+static void kgsl_pool_drain(int nr_pages)
+{
+	struct kgsl_page_pool *pool;
+	struct page *page;
+	int i;
+
+	for (i = ARRAY_SIZE(kgsl_pools) - 1; i >= 0 && nr_pages > 0; i--) {
+		pool = &kgsl_pools[i];
+
+		while (nr_pages > 0) {
+			spin_lock(&pool->lock);
+			if (pool->dirty_count) {
+				page = list_first_entry(&pool->dirty,
+							struct page, lru);
+				pool->dirty_count--;
+			} else if (pool->clean_count) {
+				page = list_first_entry(&pool->clean,
+							struct page, lru);
+				pool->clean_count--;
+			} else {
+				spin_unlock(&pool->lock);
+				break;
+			}
+			list_del(&page->lru);
+			spin_unlock(&pool->lock);
+
+			atomic_sub(1 << pool->order, &kgsl_pool_pages);
+			__free_pages(page, pool->order);
+			nr_pages -= 1 << pool->order;
+		}
+	}
+}
+
+static int kgsl_pool_shrink(struct shrinker *shrinker,
+			    struct shrink_control *sc)
+{
+	if (sc->nr_to_scan)
+		kgsl_pool_drain(sc->nr_to_scan);
+
+	return atomic_read(&kgsl_pool_pages);
+}
+
+static struct shrinker kgsl_pool_shrinker = {
+	.shrink = kgsl_pool_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+/* Number of PAGE_SIZE pages in the pool */
+unsigned int kgsl_pool_size(void)
+{
+	return atomic_read(&kgsl_pool_pages);
+}
+
+unsigned int kgsl_pool_get_max(void)
+{
+	return kgsl_pool_max;
+}
+
+void kgsl_pool_set_max(unsigned int pages)
+{
+	int excess;
+
+	kgsl_pool_max = pages;
+	excess = atomic_read(&kgsl_pool_pages) - (int)pages;
+	if (excess > 0)
+		kgsl_pool_drain(excess);
+}
+
+int kgsl_pool_init(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++) {
+		spin_lock_init(&kgsl_pools[i].lock);
+		INIT_LIST_HEAD(&kgsl_pools[i].clean);
+		INIT_LIST_HEAD(&kgsl_pools[i].dirty);
+	}
+
+	kgsl_pool_thread = kthread_run(kgsl_pool_zero_thread, NULL,
+				       "kgsl-pool");
+	if (IS_ERR(kgsl_pool_thread)) {
+		KGSL_CORE_ERR("kthread_run(kgsl-pool) failed\n");
+		kgsl_pool_thread = NULL;
+		return -ENOMEM;
+	}
+
+	register_shrinker(&kgsl_pool_shrinker);
+	return 0;
+}
+
+void kgsl_pool_exit(void)
+{
+	if (!kgsl_pool_thread)
+		return;
+
+	unregister_shrinker(&kgsl_pool_shrinker);
+	kthread_stop(kgsl_pool_thread);
+	kgsl_pool_thread = NULL;
+	kgsl_pool_drain(INT_MAX);
+}
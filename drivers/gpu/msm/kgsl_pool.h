@@ -0,0 +1,28 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#ifndef __KGSL_POOL_H
+#define __KGSL_POOL_H
+
+struct page;
+
+struct page *kgsl_pool_alloc_page(unsigned int order);
+void kgsl_pool_free_page(struct page *page, unsigned int order);
+
+unsigned int kgsl_pool_size(void);
+unsigned int kgsl_pool_get_max(void);
+void kgsl_pool_set_max(unsigned int pages);
+
+int kgsl_pool_init(void);
+void kgsl_pool_exit(void);
+
+#endif /* __KGSL_POOL_H */
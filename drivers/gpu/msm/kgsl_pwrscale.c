@@ -133,6 +133,28 @@ void kgsl_pwrscale_update(struct kgsl_device *device)
 }
 EXPORT_SYMBOL(kgsl_pwrscale_update);
 
+/*
+ * kgsl_pwrscale_frame - account the submit to retire time of a frame
+ * @device: The device
+ * @time: Microseconds from submission of the end of frame command batch to
+ * its retirement
+ *
+ * The longest frame since the last get_dev_status call is passed on to
+ * governors that ask for the extended statistics.
+ */
+void kgsl_pwrscale_frame(struct kgsl_device *device, s64 time)
+{
+	BUG_ON(!mutex_is_locked(&device->mutex));
+
+	if (!device->pwrscale.enabled || time < 0)
+		return;
+
+	device->pwrscale.frames++;
+	if (time > device->pwrscale.frame_max)
+		device->pwrscale.frame_max = min_t(s64, time, UINT_MAX);
+}
+EXPORT_SYMBOL(kgsl_pwrscale_frame);
+
 /*
  * kgsl_pwrscale_disable - temporarily disable the governor
  * @device: The device
@@ -297,7 +319,11 @@ int kgsl_devfreq_get_dev_status(struct device *dev,
 		b->ram_time = device->pwrscale.accum_stats.ram_time;
 		b->ram_wait = device->pwrscale.accum_stats.ram_wait;
 		b->mod = device->pwrctrl.bus_mod;
+		b->frames = pwrscale->frames;
+		b->frame_max = pwrscale->frame_max;
 	}
+	pwrscale->frames = 0;
+	pwrscale->frame_max = 0;
 
 	trace_kgsl_pwrstats(device, stat->total_time, &pwrscale->accum_stats);
 	memset(&pwrscale->accum_stats, 0, sizeof(pwrscale->accum_stats));
@@ -41,12 +41,15 @@ struct kgsl_pwrscale {
 	struct work_struct devfreq_resume_ws;
 	struct work_struct devfreq_notify_ws;
 	unsigned long next_governor_call;
+	unsigned int frames;
+	unsigned int frame_max;
 };
 
 int kgsl_pwrscale_init(struct device *dev, const char *governor);
 void kgsl_pwrscale_close(struct kgsl_device *device);
 
 void kgsl_pwrscale_update(struct kgsl_device *device);
+void kgsl_pwrscale_frame(struct kgsl_device *device, s64 time);
 void kgsl_pwrscale_busy(struct kgsl_device *device);
 void kgsl_pwrscale_idle(struct kgsl_device *device);
 void kgsl_pwrscale_sleep(struct kgsl_device *device);
@@ -18,11 +18,14 @@
 #include <linux/slab.h>
 #include <linux/kmemleak.h>
 #include <linux/highmem.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #include "kgsl.h"
 #include "kgsl_sharedmem.h"
 #include "kgsl_cffdump.h"
 #include "kgsl_device.h"
+#include "kgsl_pool.h"
 
 DEFINE_MUTEX(kernel_map_global_lock);
 
@@ -235,6 +238,12 @@ static int kgsl_drv_memstat_show(struct device *dev,
 		val = atomic_read(&kgsl_driver.stats.mapped);
 	else if (!strncmp(attr->attr.name, "mapped_max", 10))
 		val = atomic_read(&kgsl_driver.stats.mapped_max);
+	else if (!strncmp(attr->attr.name, "pool_hits", 9))
+		val = atomic_read(&kgsl_driver.stats.pool_hits);
+	else if (!strncmp(attr->attr.name, "pool_misses", 11))
+		val = atomic_read(&kgsl_driver.stats.pool_misses);
+	else if (!strncmp(attr->attr.name, "pool_pages", 10))
+		val = kgsl_pool_size();
 
 	return snprintf(buf, PAGE_SIZE, "%u\n", val);
 }
@@ -262,6 +271,28 @@ static int kgsl_drv_full_cache_threshold_show(struct device *dev,
 			kgsl_driver.full_cache_threshold);
 }
 
+static int kgsl_drv_pool_max_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	int ret;
+	unsigned int pages = 0;
+
+	ret = kgsl_sysfs_store(buf, &pages);
+	if (ret)
+		return ret;
+
+	kgsl_pool_set_max(pages);
+	return count;
+}
+
+static int kgsl_drv_pool_max_show(struct device *dev,
+				  struct device_attribute *attr,
+				  char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", kgsl_pool_get_max());
+}
+
 DEVICE_ATTR(vmalloc, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(vmalloc_max, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(page_alloc, 0444, kgsl_drv_memstat_show, NULL);
@@ -273,6 +304,11 @@ DEVICE_ATTR(mapped_max, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(full_cache_threshold, 0644,
 		kgsl_drv_full_cache_threshold_show,
 		kgsl_drv_full_cache_threshold_store);
+DEVICE_ATTR(pool_hits, 0444, kgsl_drv_memstat_show, NULL);
+DEVICE_ATTR(pool_misses, 0444, kgsl_drv_memstat_show, NULL);
+DEVICE_ATTR(pool_pages, 0444, kgsl_drv_memstat_show, NULL);
+DEVICE_ATTR(pool_max_pages, 0644, kgsl_drv_pool_max_show,
+		kgsl_drv_pool_max_store);
 
 static const struct device_attribute *drv_attr_list[] = {
 	&dev_attr_vmalloc,
@@ -284,9 +320,63 @@ static const struct device_attribute *drv_attr_list[] = {
 	&dev_attr_mapped,
 	&dev_attr_mapped_max,
 	&dev_attr_full_cache_threshold,
+	&dev_attr_pool_hits,
+	&dev_attr_pool_misses,
+	&dev_attr_pool_pages,
+	&dev_attr_pool_max_pages,
 	NULL
 };
 
+#define KGSL_CALIBRATE_SIZE	SZ_1M
+#define KGSL_CALIBRATE_RUNS	4
+
+/*
+ * kgsl_sharedmem_calibrate_cache - Set full_cache_threshold to the size
+ * above which flushing the whole CPU cache is cheaper than flushing the
+ * range, as measured on this CPU: the time to flush a dirty buffer of
+ * KGSL_CALIBRATE_SIZE is compared with the time to flush everything,
+ * keeping the best of a few runs of each.
+ */
+void kgsl_sharedmem_calibrate_cache(void)
+{
+	char *buf;
+	s64 range_ns = LLONG_MAX, full_ns = LLONG_MAX, ns;
+	ktime_t start;
+	u64 thresh;
+	int i;
+
+	buf = vmalloc(KGSL_CALIBRATE_SIZE);
+	if (buf == NULL)
+		return;
+
+	for (i = 0; i < KGSL_CALIBRATE_RUNS; i++) {
+		memset(buf, i, KGSL_CALIBRATE_SIZE);
+		preempt_disable();
+		start = ktime_get();
+		dmac_flush_range(buf, buf + KGSL_CALIBRATE_SIZE);
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		preempt_enable();
+		range_ns = min(range_ns, ns);
+
+		memset(buf, i, KGSL_CALIBRATE_SIZE);
+		preempt_disable();
+		start = ktime_get();
+		__cpuc_flush_kern_all();
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		preempt_enable();
+		full_ns = min(full_ns, ns);
+	}
+
+	vfree(buf);
+
+	if (range_ns <= 0)
+		return;
+
+	thresh = div64_u64((u64)full_ns * KGSL_CALIBRATE_SIZE, range_ns);
+	kgsl_driver.full_cache_threshold = clamp_t(u64, thresh, SZ_256K,
+						   SZ_64M);
+}
+
 void
 kgsl_sharedmem_uninit_sysfs(void)
 {
@@ -448,7 +538,7 @@ static void kgsl_page_alloc_free(struct kgsl_memdesc *memdesc)
 			BUG_ON(true);
 		}
 		for_each_sg(memdesc->sg, sg, sglen, i) {
-			__free_pages(sg_page(sg), get_order(sg->length));
+			kgsl_pool_free_page(sg_page(sg), get_order(sg->length));
 			kgsl_sg_clean(sg);
 		}
 	}
@@ -735,6 +825,14 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 		else
 			gfp_mask |= GFP_KERNEL;
 
+		/* pages from the pool are already zeroed and flushed */
+		page = kgsl_pool_alloc_page(get_order(page_size));
+		if (page != NULL) {
+			sg_set_page(&memdesc->sg[sglen++], page, page_size, 0);
+			len -= page_size;
+			continue;
+		}
+
 		page = alloc_pages(gfp_mask, get_order(page_size));
 
 		if (page == NULL) {
@@ -785,6 +883,9 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 	 * but only on the order of a few microseconds at best. The 'step'
 	 * size is based on a guess at the amount of free vmalloc space, but
 	 * will scale down if there's not enough free space.
+	 *
+	 * Pages that came from the kgsl page pool were cleared in the
+	 * background already and aren't in pages[].
 	 */
 	for (j = 0; j < pcount; j += step) {
 		step = min(step, pcount - j);
@@ -811,8 +912,10 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 		}
 	}
 
-	outer_cache_range_op_sg(memdesc->sg, memdesc->sglen,
-				KGSL_CACHE_OP_FLUSH);
+	/* pcount is zero if the pool served us entirely */
+	if (pcount)
+		outer_cache_range_op_sg(memdesc->sg, memdesc->sglen,
+					KGSL_CACHE_OP_FLUSH);
 
 done:
 	KGSL_STATS_ADD(memdesc->size, &kgsl_driver.stats.page_alloc,
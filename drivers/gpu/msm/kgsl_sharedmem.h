@@ -73,6 +73,7 @@ void kgsl_process_uninit_sysfs(struct kgsl_process_private *private);
 
 int kgsl_sharedmem_init_sysfs(void);
 void kgsl_sharedmem_uninit_sysfs(void);
+void kgsl_sharedmem_calibrate_cache(void);
 
 /*
  * kgsl_memdesc_get_align - Get alignment flags from a memdesc
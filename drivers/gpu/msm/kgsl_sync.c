@@ -91,7 +91,22 @@ static void kgsl_fence_event_cb(struct kgsl_device *device,
 		struct kgsl_context *context, void *priv, int result)
 {
 	struct kgsl_fence_event_priv *ev = priv;
-	kgsl_sync_timeline_signal(ev->context->timeline, ev->timestamp);
+	unsigned int timestamp = ev->timestamp;
+
+	/*
+	 * Signal everything the context has retired so far. The other fence
+	 * events fired in the same batch then find their timestamp already
+	 * signaled and don't walk the timeline again.
+	 */
+	if (result == KGSL_EVENT_RETIRED) {
+		unsigned int retired = kgsl_readtimestamp(device, ev->context,
+			KGSL_TIMESTAMP_RETIRED);
+
+		if (timestamp_cmp(retired, timestamp) > 0)
+			timestamp = retired;
+	}
+
+	kgsl_sync_timeline_signal(ev->context->timeline, timestamp);
 	kgsl_context_put(ev->context);
 	kfree(ev);
 }
@@ -332,8 +347,14 @@ void kgsl_sync_timeline_signal(struct sync_timeline *timeline,
 	struct kgsl_sync_timeline *ktimeline =
 		(struct kgsl_sync_timeline *) timeline;
 
-	if (timestamp_cmp(timestamp, ktimeline->last_timestamp) > 0)
-		ktimeline->last_timestamp = timestamp;
+	/*
+	 * Points up to last_timestamp were either released by the signal that
+	 * set it or found signaled when they were activated.
+	 */
+	if (timestamp_cmp(timestamp, ktimeline->last_timestamp) <= 0)
+		return;
+
+	ktimeline->last_timestamp = timestamp;
 	sync_timeline_signal(timeline);
 }
 
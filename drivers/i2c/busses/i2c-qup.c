@@ -36,6 +36,10 @@
 #include <linux/of.h>
 #include <linux/of_i2c.h>
 #include <linux/of_gpio.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
 #include <mach/board.h>
 #include <mach/gpiomux.h>
 #include <mach/msm_bus_board.h>
@@ -172,6 +176,27 @@ struct qup_i2c_clk_path_vote {
 	bool                        reg_err;
 };
 
+/**
+ * qup_i2c_stats: per bus transfer statistics, updated under mlock
+ *
+ * @xfers successful qup_i2c_xfer() calls
+ * @errors failed ones, of which @timeouts timed out
+ * @bytes payload moved by the successful calls
+ * @irqs QUP interrupts taken while a transfer was in flight, i.e. one per
+ *      FIFO or block refill
+ * @total_us, @max_us time spent in qup_i2c_xfer(), including runtime
+ *      resume and the QUP reset
+ */
+struct qup_i2c_stats {
+	u32                          xfers;
+	u32                          errors;
+	u32                          timeouts;
+	u64                          bytes;
+	u32                          irqs;
+	u64                          total_us;
+	u32                          max_us;
+};
+
 #define RECOVER_FAILED_PANIC_COUNT	100
 struct qup_i2c_dev {
 	struct device                *dev;
@@ -204,6 +229,8 @@ struct qup_i2c_dev {
 	int                          i2c_gpios[ARRAY_SIZE(i2c_rsrcs)];
 	struct qup_i2c_clk_path_vote clk_path_vote;
 	unsigned int                 recover_failed_count;
+	struct qup_i2c_stats         stats;
+	struct dentry                *dbgfs;
 };
 
 #ifdef CONFIG_PM
@@ -250,6 +277,8 @@ qup_i2c_interrupt(int irq, void *devid)
 		return IRQ_HANDLED;
 	}
 
+	dev->stats.irqs++;
+
 	if (status & I2C_STATUS_ERROR_MASK) {
 		dev_err(dev->dev, "QUP: I2C status flags :0x%x, irq:%d\n",
 			status, irq);
@@ -1055,6 +1084,9 @@ qup_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 	int rem = num;
 	long timeout;
 	int err;
+	struct i2c_msg *xfer_msgs = msgs;
+	ktime_t start;
+	unsigned int us;
 
 	/*
 	 * If all slaves of this controller behave as expected, they will
@@ -1075,6 +1107,7 @@ qup_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 		mutex_unlock(&dev->mlock);
 		return -EIO;
 	}
+	start = ktime_get();
 	/* request runtime-PM to go active */
 	pm_runtime_get_sync(dev->dev);
 	/* if runtime PM callback was not invoked */
@@ -1395,6 +1428,20 @@ timeout_err:
 	dev->cnt = 0;
 	if (dev->pdata->clk_ctl_xfer)
 		i2c_qup_pm_suspend_clk(dev);
+
+	us = ktime_us_delta(ktime_get(), start);
+	if (ret == num) {
+		dev->stats.xfers++;
+		for (rem = 0; rem < num; rem++)
+			dev->stats.bytes += xfer_msgs[rem].len;
+	} else {
+		dev->stats.errors++;
+		if (ret == -ETIMEDOUT)
+			dev->stats.timeouts++;
+	}
+	dev->stats.total_us += us;
+	if (us > dev->stats.max_us)
+		dev->stats.max_us = us;
 	mutex_unlock(&dev->mlock);
 	pm_runtime_mark_last_busy(dev->dev);
 	pm_runtime_put_autosuspend(dev->dev);
@@ -1486,6 +1533,53 @@ int __devinit msm_i2c_rsrcs_dt_to_pdata_map(struct platform_device *pdev,
 	return err;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *qup_i2c_dbgfs_root;
+
+static int qup_i2c_stats_show(struct seq_file *m, void *unused)
+{
+	struct qup_i2c_dev *dev = m->private;
+	struct qup_i2c_stats st;
+	u32 n;
+
+	mutex_lock(&dev->mlock);
+	st = dev->stats;
+	mutex_unlock(&dev->mlock);
+
+	n = st.xfers + st.errors;
+	seq_printf(m, "xfers: %u\nerrors: %u\ntimeouts: %u\nbytes: %llu\n",
+		   st.xfers, st.errors, st.timeouts, st.bytes);
+	seq_printf(m, "irqs: %u\navg_us: %llu\nmax_us: %u\n", st.irqs,
+		   n ? div_u64(st.total_us, n) : 0, st.max_us);
+	return 0;
+}
+
+static int qup_i2c_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, qup_i2c_stats_show, inode->i_private);
+}
+
+static const struct file_operations qup_i2c_stats_fops = {
+	.open		= qup_i2c_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void qup_i2c_dbgfs_create(struct qup_i2c_dev *dev)
+{
+	if (!qup_i2c_dbgfs_root)
+		qup_i2c_dbgfs_root = debugfs_create_dir("i2c-qup", NULL);
+	if (IS_ERR_OR_NULL(qup_i2c_dbgfs_root))
+		return;
+
+	dev->dbgfs = debugfs_create_file(dev_name(dev->dev), S_IRUGO,
+				qup_i2c_dbgfs_root, dev, &qup_i2c_stats_fops);
+}
+#else
+static inline void qup_i2c_dbgfs_create(struct qup_i2c_dev *dev) {}
+#endif
+
 static u32
 qup_i2c_func(struct i2c_adapter *adap)
 {
@@ -1773,6 +1867,7 @@ blsp_core_init:
 			of_i2c_register_devices(&dev->adapter);
 		}
 
+		qup_i2c_dbgfs_create(dev);
 		return 0;
 	}
 
@@ -1820,6 +1915,7 @@ qup_i2c_remove(struct platform_device *pdev)
 {
 	struct qup_i2c_dev *dev = platform_get_drvdata(pdev);
 
+	debugfs_remove(dev->dbgfs);
 	i2c_qup_sys_suspend(dev);
 	mutex_destroy(&dev->mlock);
 	platform_set_drvdata(pdev, NULL);
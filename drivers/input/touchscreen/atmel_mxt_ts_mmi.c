@@ -5096,6 +5096,7 @@ static struct i2c_driver mxt_driver = {
 		.name	= DRIVER_NAME,
 		.owner	= THIS_MODULE,
 		.of_match_table = mxt_match_table,
+		.async_probe = true,
 #ifdef CONFIG_PM
 		.pm	= &mxt_pm_ops,
 #endif
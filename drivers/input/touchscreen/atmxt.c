@@ -141,6 +141,7 @@ static struct i2c_driver atmxt_driver = {
 		.name = ATMXT_I2C_NAME,
 		.owner = THIS_MODULE,
 		.of_match_table = of_match_ptr(atmxt_match_tbl),
+		.async_probe = true,
 	},
 	.probe = atmxt_probe,
 	.remove = __devexit_p(atmxt_remove),
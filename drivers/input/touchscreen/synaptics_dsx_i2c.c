@@ -32,6 +32,10 @@
 #include <linux/jiffies.h>
 #include <linux/semaphore.h>
 #include <linux/regulator/consumer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sched.h>
+#include <linux/cpufreq.h>
 #include <linux/input/synaptics_rmi_dsx.h>
 #include "synaptics_dsx_i2c.h"
 #ifdef KERNEL_ABOVE_2_6_38
@@ -76,6 +80,11 @@
 #define F12_STD_QUERY_LEN 10
 #define F12_STD_CTRL_LEN 4
 #define F12_STD_DATA_LEN 80
+/* F11 finger status registers, then the data of every finger */
+#define F11_BULK_DATA_LEN (3 + MAX_NUMBER_OF_FINGERS * F11_STD_DATA_LEN)
+
+/* Just above the other irq threads */
+#define SYN_IRQ_THREAD_PRIO (MAX_USER_RT_PRIO / 2 + 1)
 
 #define NORMAL_OPERATION (0 << 0)
 #define SENSOR_SLEEP (1 << 0)
@@ -1547,6 +1556,27 @@ exit:
 	return retval;
 }
 
+ /**
+ * synaptics_rmi4_account_latency()
+ *
+ * Called right after input_sync() of a finger report, to account the
+ * time from the attention irq to the report reaching the input core.
+ */
+static void synaptics_rmi4_account_latency(
+		struct synaptics_rmi4_data *rmi4_data)
+{
+	s64 us = ktime_us_delta(ktime_get(), rmi4_data->irq_time);
+	int bucket = 0;
+
+	if (us > rmi4_data->latency_max_us)
+		rmi4_data->latency_max_us = us;
+
+	while (bucket < SYN_LATENCY_BUCKETS - 1 &&
+			us >= (USEC_PER_MSEC << bucket))
+		bucket++;
+	rmi4_data->latency_hist[bucket]++;
+}
+
  /**
  * synaptics_rmi4_f12_abs_report()
  *
@@ -1574,11 +1604,13 @@ static int synaptics_rmi4_f12_abs_report(struct synaptics_rmi4_data *rmi4_data,
 	int p;
 	int w;
 	int id;
-	struct timespec hw_time = ktime_to_timespec(ktime_get());
+	struct timespec hw_time = ktime_to_timespec(rmi4_data->irq_time);
 
 	fingers_supported = fhandler->num_of_data_points;
 	data_addr = fhandler->full_addr.data_base;
 	data_size = fingers_supported * fhandler->size_of_data_register_block;
+	if (data_size > sizeof(finger_data))
+		data_size = sizeof(finger_data);
 
 	retval = synaptics_rmi4_i2c_read(rmi4_data,
 			data_addr,
@@ -1653,6 +1685,7 @@ static int synaptics_rmi4_f12_abs_report(struct synaptics_rmi4_data *rmi4_data,
 		input_mt_sync(rmi4_data->input_dev);
 #endif
 	input_sync(rmi4_data->input_dev);
+	synaptics_rmi4_account_latency(rmi4_data);
 
 	return touch_count;
 }
@@ -1680,16 +1713,17 @@ static int synaptics_rmi4_f11_abs_report(struct synaptics_rmi4_data *rmi4_data,
 	unsigned char finger_shift;
 	unsigned char finger_status;
 	unsigned char data_reg_blk_size;
-	unsigned char finger_status_reg[3];
-	unsigned char data[F11_STD_DATA_LEN];
+	unsigned char *finger_status_reg;
+	unsigned char *data;
+	unsigned char buf[F11_BULK_DATA_LEN];
 	unsigned short data_addr;
-	unsigned short data_offset;
+	unsigned short data_size;
 	int x;
 	int y;
 	int wx;
 	int wy;
 	int z;
-	struct timespec hw_time = ktime_to_timespec(ktime_get());
+	struct timespec hw_time = ktime_to_timespec(rmi4_data->irq_time);
 
 	/*
 	 * The number of finger status registers is determined by the
@@ -1701,13 +1735,23 @@ static int synaptics_rmi4_f11_abs_report(struct synaptics_rmi4_data *rmi4_data,
 	num_of_finger_status_regs = (fingers_supported + 3) / 4;
 	data_addr = fhandler->full_addr.data_base;
 	data_reg_blk_size = fhandler->size_of_data_register_block;
+	data_size = num_of_finger_status_regs +
+			fingers_supported * data_reg_blk_size;
+	if (data_size > sizeof(buf))
+		return 0;
 
+	/*
+	 * Read the status and the data of all fingers in one transfer:
+	 * one i2c transaction costs less than the status read followed by
+	 * a read per finger present.
+	 */
 	retval = synaptics_rmi4_i2c_read(rmi4_data,
 			data_addr,
-			finger_status_reg,
-			num_of_finger_status_regs);
+			buf,
+			data_size);
 	if (retval < 0)
 		return 0;
+	finger_status_reg = buf;
 
 	if (atomic_read(&rmi4_data->panel_off_flag)) {
 		synaptics_dsx_resumeinfo_ignore(rmi4_data);
@@ -1739,15 +1783,8 @@ static int synaptics_rmi4_f11_abs_report(struct synaptics_rmi4_data *rmi4_data,
 					MT_TOOL_FINGER, finger_status);
 #endif
 		if (finger_status) {
-			data_offset = data_addr +
-					num_of_finger_status_regs +
+			data = buf + num_of_finger_status_regs +
 					(finger * data_reg_blk_size);
-			retval = synaptics_rmi4_i2c_read(rmi4_data,
-					data_offset,
-					data,
-					data_reg_blk_size);
-			if (retval < 0)
-				goto end;
 
 			x = (data[0] << 4) | (data[2] & MASK_4BIT);
 			y = (data[1] << 4) | ((data[2] >> 4) & MASK_4BIT);
@@ -1794,13 +1831,13 @@ static int synaptics_rmi4_f11_abs_report(struct synaptics_rmi4_data *rmi4_data,
 		}
 	}
 
-end:
 #ifndef TYPE_B_PROTOCOL
 	if (!touch_count)
 		input_mt_sync(rmi4_data->input_dev);
 #endif
 
 	input_sync(rmi4_data->input_dev);
+	synaptics_rmi4_account_latency(rmi4_data);
 
 	return touch_count;
 }
@@ -2090,6 +2127,22 @@ static int synaptics_rmi4_sensor_report(struct synaptics_rmi4_data *rmi4_data)
 	return touch_count;
 }
 
+ /**
+ * synaptics_rmi4_hardirq()
+ *
+ * Timestamp the attention irq for the input events and the latency
+ * histogram and kick the cpu boost, then let the irq thread read the
+ * report.
+ */
+static irqreturn_t synaptics_rmi4_hardirq(int irq, void *data)
+{
+	struct synaptics_rmi4_data *rmi4_data = data;
+
+	rmi4_data->irq_time = ktime_get();
+	cpu_boost_touch_irq();
+	return IRQ_WAKE_THREAD;
+}
+
  /**
  * synaptics_rmi4_irq()
  *
@@ -2105,6 +2158,15 @@ static irqreturn_t synaptics_rmi4_irq(int irq, void *data)
 	struct synaptics_rmi4_data *rmi4_data = data;
 	struct synaptics_rmi4_irq_info *tmp_q;
 
+	if (!rmi4_data->irq_thread_rt) {
+		struct sched_param param = {
+			.sched_priority = SYN_IRQ_THREAD_PRIO,
+		};
+
+		sched_setscheduler(current, SCHED_FIFO, &param);
+		rmi4_data->irq_thread_rt = true;
+	}
+
 	if (rmi4_data->number_irq > 0) {
 		rmi4_data->last_irq++;
 		if (rmi4_data->last_irq >= rmi4_data->number_irq)
@@ -2156,8 +2218,10 @@ static int synaptics_rmi4_irq_enable(struct synaptics_rmi4_data *rmi4_data,
 		if (retval < 0)
 			return retval;
 
-		retval = request_threaded_irq(rmi4_data->irq, NULL,
-				synaptics_rmi4_irq, platform_data->irq_flags,
+		rmi4_data->irq_thread_rt = false;
+		retval = request_threaded_irq(rmi4_data->irq,
+				synaptics_rmi4_hardirq, synaptics_rmi4_irq,
+				platform_data->irq_flags | IRQF_ONESHOT,
 				DRIVER_NAME, rmi4_data);
 		if (retval < 0) {
 			dev_err(&rmi4_data->i2c_client->dev,
@@ -3128,6 +3192,46 @@ exit:
 }
 EXPORT_SYMBOL(synaptics_rmi4_new_function);
 
+static int synaptics_rmi4_latency_show(struct seq_file *m, void *unused)
+{
+	struct synaptics_rmi4_data *rmi4_data = m->private;
+	int i;
+
+	for (i = 0; i < SYN_LATENCY_BUCKETS - 1; i++)
+		seq_printf(m, "<%3ums:\t%u\n", 1 << i,
+				rmi4_data->latency_hist[i]);
+	seq_printf(m, ">=%2ums:\t%u\n", 1 << i, rmi4_data->latency_hist[i]);
+	seq_printf(m, "max:\t%uus\n", rmi4_data->latency_max_us);
+
+	return 0;
+}
+
+static int synaptics_rmi4_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, synaptics_rmi4_latency_show, inode->i_private);
+}
+
+static ssize_t synaptics_rmi4_latency_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	struct synaptics_rmi4_data *rmi4_data = m->private;
+
+	memset(rmi4_data->latency_hist, 0, sizeof(rmi4_data->latency_hist));
+	rmi4_data->latency_max_us = 0;
+
+	return count;
+}
+
+static const struct file_operations synaptics_rmi4_latency_fops = {
+	.owner = THIS_MODULE,
+	.open = synaptics_rmi4_latency_open,
+	.read = seq_read,
+	.write = synaptics_rmi4_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
  /**
  * synaptics_rmi4_probe()
  *
@@ -3316,6 +3420,13 @@ static int __devinit synaptics_rmi4_probe(struct i2c_client *client,
 
 	synaptics_dsx_sensor_ready_state(rmi4_data, true);
 
+	/* Writing anything to latency clears the histogram */
+	rmi4_data->debugfs = debugfs_create_dir(DRIVER_NAME, NULL);
+	if (!IS_ERR_OR_NULL(rmi4_data->debugfs))
+		debugfs_create_file("latency", S_IRUGO | S_IWUSR,
+				rmi4_data->debugfs, rmi4_data,
+				&synaptics_rmi4_latency_fops);
+
 	mutex_lock(&exp_fn_ctrl_mutex);
 	exp_fn_ctrl.rmi4_data_ptr = rmi4_data;
 	mutex_unlock(&exp_fn_ctrl_mutex);
@@ -3381,6 +3492,8 @@ static int __devexit synaptics_rmi4_remove(struct i2c_client *client)
 
 	synaptics_rmi4_irq_enable(rmi4_data, false);
 
+	debugfs_remove_recursive(rmi4_data->debugfs);
+
 	for (attr_count = 0; attr_count < ARRAY_SIZE(attrs); attr_count++) {
 		sysfs_remove_file(&rmi4_data->i2c_client->dev.kobj,
 				&attrs[attr_count].attr);
@@ -3873,6 +3986,7 @@ static struct i2c_driver synaptics_rmi4_driver = {
 	.driver = {
 		.name = DRIVER_NAME,
 		.owner = THIS_MODULE,
+		.async_probe = true,
 #if !defined(CONFIG_FB) && defined(CONFIG_PM)
 		.pm = &synaptics_rmi4_dev_pm_ops,
 #endif
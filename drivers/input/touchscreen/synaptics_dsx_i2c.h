@@ -24,6 +24,7 @@
 
 #include <linux/version.h>
 #include <linux/lcd_notify.h>
+#include <linux/ktime.h>
 
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 38))
 #define KERNEL_ABOVE_2_6_38
@@ -67,6 +68,7 @@
 #define F34_PROPERTIES_OFFSET 1
 
 #define MAX_NUMBER_OF_FINGERS 10
+#define SYN_LATENCY_BUCKETS 8
 #define MAX_NUMBER_OF_BUTTONS 4
 #define MAX_INTR_REGISTERS 4
 
@@ -230,6 +232,11 @@ struct synaptics_rmi4_device_info {
  * @i2c_read: pointer to i2c read function
  * @i2c_write: pointer to i2c write function
  * @irq_enable: pointer to irq enable function
+ * @irq_time: when the hard irq for the report being handled fired
+ * @irq_thread_rt: the irq thread has been given its RT priority
+ * @latency_hist: reports by irq to input_sync latency, power of 2 ms buckets
+ * @latency_max_us: worst irq to input_sync latency seen
+ * @debugfs: debugfs directory of the device
  */
 struct synaptics_rmi4_data {
 	struct i2c_client *i2c_client;
@@ -289,6 +296,11 @@ struct synaptics_rmi4_data {
 	int number_irq;
 	int last_irq;
 	struct synaptics_rmi4_irq_info *irq_info;
+	ktime_t irq_time;
+	bool irq_thread_rt;
+	unsigned int latency_hist[SYN_LATENCY_BUCKETS];
+	unsigned int latency_max_us;
+	struct dentry *debugfs;
 };
 
 struct f34_properties {
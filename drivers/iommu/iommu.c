@@ -911,6 +911,23 @@ int iommu_unmap_range(struct iommu_domain *domain, unsigned int iova,
 }
 EXPORT_SYMBOL_GPL(iommu_unmap_range);
 
+/*
+ * Like iommu_unmap_range() but the driver may leave the TLB invalidation to
+ * the caller, so that a batch of unmaps can be followed by a single flush.
+ * Drivers that can't do that fall back to a normal unmap.
+ */
+int iommu_unmap_range_nosync(struct iommu_domain *domain, unsigned int iova,
+		      unsigned int len)
+{
+	if (domain->ops->unmap_range_nosync == NULL)
+		return iommu_unmap_range(domain, iova, len);
+
+	BUG_ON(iova & (~PAGE_MASK));
+
+	return domain->ops->unmap_range_nosync(domain, iova, len);
+}
+EXPORT_SYMBOL_GPL(iommu_unmap_range_nosync);
+
 phys_addr_t iommu_get_pt_base_addr(struct iommu_domain *domain)
 {
 	if (unlikely(domain->ops->get_pt_base_addr == NULL))
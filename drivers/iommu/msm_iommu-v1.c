@@ -897,6 +897,25 @@ static int msm_iommu_unmap_range(struct iommu_domain *domain, unsigned int va,
 	return 0;
 }
 
+/*
+ * Leave the TLB invalidation to the caller unless a second level table was
+ * freed, the walker may still be holding on to it.
+ */
+static int msm_iommu_unmap_range_nosync(struct iommu_domain *domain,
+				 unsigned int va, unsigned int len)
+{
+	struct msm_iommu_priv *priv;
+
+	mutex_lock(&msm_iommu_lock);
+
+	priv = domain->priv;
+	if (msm_iommu_pagetable_unmap_range(&priv->pt, va, len))
+		__flush_iotlb(domain);
+
+	mutex_unlock(&msm_iommu_lock);
+	return 0;
+}
+
 static phys_addr_t msm_iommu_iova_to_phys(struct iommu_domain *domain,
 					  unsigned long va)
 {
@@ -1142,6 +1161,7 @@ static struct iommu_ops msm_iommu_ops = {
 	.unmap = msm_iommu_unmap,
 	.map_range = msm_iommu_map_range,
 	.unmap_range = msm_iommu_unmap_range,
+	.unmap_range_nosync = msm_iommu_unmap_range_nosync,
 	.iova_to_phys = msm_iommu_iova_to_phys,
 	.domain_has_cap = msm_iommu_domain_has_cap,
 	.get_pt_base_addr = msm_iommu_get_pt_base_addr,
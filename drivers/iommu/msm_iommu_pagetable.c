@@ -549,7 +549,12 @@ fail:
 	return ret;
 }
 
-void msm_iommu_pagetable_unmap_range(struct msm_iommu_pt *pt, unsigned int va,
+/*
+ * Returns the number of second level tables that were freed.  The caller
+ * must invalidate the TLB before those pages can be reused, even if it
+ * otherwise defers the invalidation.
+ */
+int msm_iommu_pagetable_unmap_range(struct msm_iommu_pt *pt, unsigned int va,
 				 unsigned int len)
 {
 	unsigned int offset = 0;
@@ -557,7 +562,7 @@ void msm_iommu_pagetable_unmap_range(struct msm_iommu_pt *pt, unsigned int va,
 	unsigned long fl_offset;
 	unsigned long *sl_table;
 	unsigned long sl_start, sl_end;
-	int used, i;
+	int used, i, freed = 0;
 
 	BUG_ON(len & (SZ_4K - 1));
 
@@ -601,6 +606,7 @@ void msm_iommu_pagetable_unmap_range(struct msm_iommu_pt *pt, unsigned int va,
 				*fl_pte = 0;
 
 				clean_pte(fl_pte, fl_pte + 1, pt->redirect);
+				freed++;
 			}
 
 			sl_start = 0;
@@ -613,6 +619,8 @@ void msm_iommu_pagetable_unmap_range(struct msm_iommu_pt *pt, unsigned int va,
 		}
 		fl_pte++;
 	}
+
+	return freed;
 }
 
 static int __init get_tex_class(int icp, int ocp, int mt, int nos)
@@ -28,6 +28,19 @@
 
 #include <linux/device-mapper.h>
 
+#ifdef CONFIG_DM_CRYPT_QCRYPTO_BULK
+#include <mach/qcrypto.h>
+
+/*
+ * Scatterlist entries per request and sectors per request when the
+ * cipher converts whole runs of sectors at a time.
+ */
+#define DM_CRYPT_MAX_SG		32
+#define DM_CRYPT_BULK_SECTORS	256
+#else
+#define DM_CRYPT_MAX_SG		1
+#endif
+
 #define DM_MSG_PREFIX "crypt"
 
 /*
@@ -64,8 +77,8 @@ struct dm_crypt_io {
 
 struct dm_crypt_request {
 	struct convert_context *ctx;
-	struct scatterlist sg_in;
-	struct scatterlist sg_out;
+	struct scatterlist sg_in[DM_CRYPT_MAX_SG];
+	struct scatterlist sg_out[DM_CRYPT_MAX_SG];
 	sector_t iv_sector;
 };
 
@@ -155,6 +168,12 @@ struct crypt_config {
 	 */
 	unsigned int dmreq_start;
 
+	/*
+	 * Sectors converted by one crypto request. Only ciphers that derive
+	 * the IV of each sector themselves take more than one.
+	 */
+	unsigned int bulk_sectors;
+
 	unsigned long flags;
 	unsigned int key_size;
 	unsigned int key_parts;
@@ -562,8 +581,8 @@ static int crypt_iv_lmk_gen(struct crypt_config *cc, u8 *iv,
 	int r = 0;
 
 	if (bio_data_dir(dmreq->ctx->bio_in) == WRITE) {
-		src = kmap_atomic(sg_page(&dmreq->sg_in));
-		r = crypt_iv_lmk_one(cc, iv, dmreq, src + dmreq->sg_in.offset);
+		src = kmap_atomic(sg_page(dmreq->sg_in));
+		r = crypt_iv_lmk_one(cc, iv, dmreq, src + dmreq->sg_in->offset);
 		kunmap_atomic(src);
 	} else
 		memset(iv, 0, cc->iv_size);
@@ -580,12 +599,12 @@ static int crypt_iv_lmk_post(struct crypt_config *cc, u8 *iv,
 	if (bio_data_dir(dmreq->ctx->bio_in) == WRITE)
 		return 0;
 
-	dst = kmap_atomic(sg_page(&dmreq->sg_out));
-	r = crypt_iv_lmk_one(cc, iv, dmreq, dst + dmreq->sg_out.offset);
+	dst = kmap_atomic(sg_page(dmreq->sg_out));
+	r = crypt_iv_lmk_one(cc, iv, dmreq, dst + dmreq->sg_out->offset);
 
 	/* Tweak the first block of plaintext sector */
 	if (!r)
-		crypto_xor(dst + dmreq->sg_out.offset, iv, cc->iv_size);
+		crypto_xor(dst + dmreq->sg_out->offset, iv, cc->iv_size);
 
 	kunmap_atomic(dst);
 	return r;
@@ -660,13 +679,43 @@ static u8 *iv_of_dmreq(struct crypt_config *cc,
 		crypto_ablkcipher_alignmask(any_tfm(cc)) + 1);
 }
 
+/*
+ * Does the data at offset of page directly follow the last entry of sg?
+ */
+static bool crypt_sg_contiguous(struct scatterlist *sg, unsigned int nents,
+				struct page *page, unsigned int offset)
+{
+	struct scatterlist *last;
+
+	if (!nents)
+		return false;
+
+	last = &sg[nents - 1];
+	return sg_page(last) == page && last->offset + last->length == offset;
+}
+
+static void crypt_sg_add(struct scatterlist *sg, unsigned int *nents,
+			 struct page *page, unsigned int offset,
+			 unsigned int len)
+{
+	if (crypt_sg_contiguous(sg, *nents, page, offset))
+		sg[*nents - 1].length += len;
+	else
+		sg_set_page(&sg[(*nents)++], page, len, offset);
+}
+
+/*
+ * Set up a request for the sectors at the current position of ctx:
+ * a single sector, or up to cc->bulk_sectors of them for ciphers that
+ * step the IV from one sector to the next on their own.
+ */
 static int crypt_convert_block(struct crypt_config *cc,
 			       struct convert_context *ctx,
 			       struct ablkcipher_request *req)
 {
-	struct bio_vec *bv_in = bio_iovec_idx(ctx->bio_in, ctx->idx_in);
-	struct bio_vec *bv_out = bio_iovec_idx(ctx->bio_out, ctx->idx_out);
 	struct dm_crypt_request *dmreq;
+	unsigned int max = (cc->bulk_sectors ? : 1) << SECTOR_SHIFT;
+	unsigned int len = 0, nents_in = 0, nents_out = 0;
 	u8 *iv;
 	int r = 0;
 
@@ -675,25 +724,50 @@ static int crypt_convert_block(struct crypt_config *cc,
 
 	dmreq->iv_sector = ctx->sector;
 	dmreq->ctx = ctx;
-	sg_init_table(&dmreq->sg_in, 1);
-	sg_set_page(&dmreq->sg_in, bv_in->bv_page, 1 << SECTOR_SHIFT,
-		    bv_in->bv_offset + ctx->offset_in);
-
-	sg_init_table(&dmreq->sg_out, 1);
-	sg_set_page(&dmreq->sg_out, bv_out->bv_page, 1 << SECTOR_SHIFT,
-		    bv_out->bv_offset + ctx->offset_out);
-
-	ctx->offset_in += 1 << SECTOR_SHIFT;
-	if (ctx->offset_in >= bv_in->bv_len) {
-		ctx->offset_in = 0;
-		ctx->idx_in++;
-	}
+	sg_init_table(dmreq->sg_in, DM_CRYPT_MAX_SG);
+	sg_init_table(dmreq->sg_out, DM_CRYPT_MAX_SG);
+
+	do {
+		struct bio_vec *bv_in = bio_iovec_idx(ctx->bio_in, ctx->idx_in);
+		struct bio_vec *bv_out = bio_iovec_idx(ctx->bio_out, ctx->idx_out);
+		unsigned int off_in = bv_in->bv_offset + ctx->offset_in;
+		unsigned int off_out = bv_out->bv_offset + ctx->offset_out;
+		unsigned int n = min3(bv_in->bv_len - ctx->offset_in,
+				      bv_out->bv_len - ctx->offset_out,
+				      max - len);
+
+		if ((nents_in == DM_CRYPT_MAX_SG &&
+		     !crypt_sg_contiguous(dmreq->sg_in, nents_in,
+					  bv_in->bv_page, off_in)) ||
+		    (nents_out == DM_CRYPT_MAX_SG &&
+		     !crypt_sg_contiguous(dmreq->sg_out, nents_out,
+					  bv_out->bv_page, off_out)))
+			break;
 
-	ctx->offset_out += 1 << SECTOR_SHIFT;
-	if (ctx->offset_out >= bv_out->bv_len) {
-		ctx->offset_out = 0;
-		ctx->idx_out++;
-	}
+		crypt_sg_add(dmreq->sg_in, &nents_in, bv_in->bv_page,
+			     off_in, n);
+		crypt_sg_add(dmreq->sg_out, &nents_out, bv_out->bv_page,
+			     off_out, n);
+		len += n;
+
+		ctx->offset_in += n;
+		if (ctx->offset_in >= bv_in->bv_len) {
+			ctx->offset_in = 0;
+			ctx->idx_in++;
+		}
+
+		ctx->offset_out += n;
+		if (ctx->offset_out >= bv_out->bv_len) {
+			ctx->offset_out = 0;
+			ctx->idx_out++;
+		}
+	} while (len < max &&
+		 ctx->idx_in < ctx->bio_in->bi_vcnt &&
+		 ctx->idx_out < ctx->bio_out->bi_vcnt);
+
+	sg_mark_end(&dmreq->sg_in[nents_in - 1]);
+	sg_mark_end(&dmreq->sg_out[nents_out - 1]);
+	ctx->sector += len >> SECTOR_SHIFT;
 
 	if (cc->iv_gen_ops) {
 		r = cc->iv_gen_ops->generator(cc, iv, dmreq);
@@ -701,8 +775,8 @@ static int crypt_convert_block(struct crypt_config *cc,
 			return r;
 	}
 
-	ablkcipher_request_set_crypt(req, &dmreq->sg_in, &dmreq->sg_out,
-				     1 << SECTOR_SHIFT, iv);
+	ablkcipher_request_set_crypt(req, dmreq->sg_in, dmreq->sg_out,
+				     len, iv);
 
 	if (bio_data_dir(ctx->bio_in) == WRITE)
 		r = crypto_ablkcipher_encrypt(req);
@@ -758,13 +832,11 @@ static int crypt_convert(struct crypt_config *cc,
 			wait_for_completion(&ctx->restart);
 			INIT_COMPLETION(ctx->restart);
 			ctx->req = NULL;
-			ctx->sector++;
 			continue;
 
 		/* sync */
 		case 0:
 			atomic_dec(&ctx->pending);
-			ctx->sector++;
 			cond_resched();
 			continue;
 
@@ -1518,6 +1590,35 @@ bad_mem:
 	return -ENOMEM;
 }
 
+#ifdef CONFIG_DM_CRYPT_QCRYPTO_BULK
+/*
+ * With the data unit size set to 512 bytes, the crypto engine behind
+ * qcrypto's xts(aes) restarts XTS every 512 bytes of a request and
+ * increments the tweak each time, which is just what plain64 does from
+ * one sector to the next. Such a request can then cover many sectors,
+ * so the engine is not left idle between single sector requests.
+ */
+static void crypt_setup_bulk(struct crypt_config *cc)
+{
+	struct crypto_tfm *tfm = crypto_ablkcipher_tfm(any_tfm(cc));
+	struct ablkcipher_request *req;
+
+	if (cc->iv_gen_ops != &crypt_iv_plain64_ops || cc->tfms_count != 1 ||
+	    strcmp(crypto_tfm_alg_driver_name(tfm), "qcrypto-xts-aes"))
+		return;
+
+	req = mempool_alloc(cc->req_pool, GFP_KERNEL);
+	ablkcipher_request_set_tfm(req, any_tfm(cc));
+	if (!qcrypto_cipher_set_flag(req, QCRYPTO_CTX_XTS_DU_SIZE_512B))
+		cc->bulk_sectors = DM_CRYPT_BULK_SECTORS;
+	mempool_free(req, cc->req_pool);
+}
+#else
+static void crypt_setup_bulk(struct crypt_config *cc)
+{
+}
+#endif
+
 /*
  * Construct an encryption mapping:
  * <cipher> <key> <iv_offset> <dev_path> <start>
@@ -1587,6 +1688,8 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad;
 	}
 
+	crypt_setup_bulk(cc);
+
 	cc->page_pool = mempool_create_page_pool(MIN_POOL_PAGES, 0);
 	if (!cc->page_pool) {
 		ti->error = "Cannot allocate page mempool";
@@ -12,13 +12,23 @@
  * hash device. Setting this greatly improves performance when data and hash
  * are on the same disk on different partitions on devices with poor random
  * access behavior.
+ *
+ * In "/sys/module/dm_verity/parameters/parallel" you can set how many
+ * workers at most verify the blocks of one bio in parallel. Each worker
+ * gets at least DM_VERITY_MIN_PARALLEL_BLOCKS blocks, so small bios are
+ * still verified in one go.
+ *
+ * When sha256 is implemented by sha256-neon, data blocks are hashed
+ * DM_VERITY_MB_BLOCKS at a time with its multi-buffer sha256_finup_mb().
  */
 
 #include "dm-bufio.h"
 
 #include <linux/module.h>
 #include <linux/device-mapper.h>
+#include <linux/vmalloc.h>
 #include <crypto/hash.h>
+#include <crypto/sha.h>
 
 #define DM_MSG_PREFIX			"verity"
 
@@ -28,10 +38,21 @@
 
 #define DM_VERITY_MAX_LEVELS		63
 
+#define DM_VERITY_MAX_PARALLEL		8
+#define DM_VERITY_MIN_PARALLEL_BLOCKS	8
+
+#define DM_VERITY_MB_BLOCKS		4
+
+#define DM_VERITY_OPT_HASH_ONCE		"hash_verify_once"
+
 static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
 module_param_named(prefetch_cluster, dm_verity_prefetch_cluster, uint, S_IRUGO | S_IWUSR);
 
+static unsigned dm_verity_parallel = DM_VERITY_MAX_PARALLEL;
+
+module_param_named(parallel, dm_verity_parallel, uint, S_IRUGO | S_IWUSR);
+
 struct dm_verity {
 	struct dm_dev *data_dev;
 	struct dm_dev *hash_dev;
@@ -54,6 +75,16 @@ struct dm_verity {
 	unsigned digest_size;	/* digest size for the current hash algorithm */
 	unsigned shash_descsize;/* the size of temporary space for crypto */
 	int hash_failed;	/* set to 1 if hash of any block failed */
+	unsigned parallel;	/* the number of dm_verity_work per io */
+	typeof(sha256_finup_mb) *finup_mb;	/* batched data hashing or NULL */
+	unsigned work_size;	/* dm_verity_work with its variable fields */
+
+	/*
+	 * With "hash_verify_once", bit n is set once hash block
+	 * hash_start + n verified. It is then trusted even after dm-bufio
+	 * evicted and reread it.
+	 */
+	unsigned long *verified_bitmap;
 
 	mempool_t *io_mempool;	/* mempool of struct dm_verity_io */
 	mempool_t *vec_mempool;	/* mempool of bio vector */
@@ -81,9 +112,33 @@ struct dm_verity_io {
 
 	struct work_struct work;
 
+	/* dm_verity_work still running, and the first error they hit */
+	atomic_t pending;
+	int error;
+
 	/* A space for short vectors; longer vectors are allocated separately. */
 	struct bio_vec io_vec_inline[DM_VERITY_IO_VEC_INLINE];
 
+	/*
+	 * v->parallel dm_verity_work structures of v->work_size bytes each
+	 * follow this struct. To access them use io_work().
+	 */
+};
+
+/*
+ * A range of blocks of an io, verified by one worker.
+ */
+struct dm_verity_work {
+	struct dm_verity_io *io;
+	struct work_struct work;
+
+	unsigned block;		/* first block, relative to io->block */
+	unsigned n_blocks;
+
+	/* position of the first block in io->io_vec */
+	unsigned vector;
+	unsigned offset;
+
 	/*
 	 * Three variably-size fields follow this struct:
 	 *
@@ -95,19 +150,25 @@ struct dm_verity_io {
 	 */
 };
 
-static struct shash_desc *io_hash_desc(struct dm_verity *v, struct dm_verity_io *io)
+static struct dm_verity_work *io_work(struct dm_verity *v,
+				      struct dm_verity_io *io, unsigned i)
 {
-	return (struct shash_desc *)(io + 1);
+	return (struct dm_verity_work *)((u8 *)(io + 1) + i * v->work_size);
 }
 
-static u8 *io_real_digest(struct dm_verity *v, struct dm_verity_io *io)
+static struct shash_desc *io_hash_desc(struct dm_verity *v, struct dm_verity_work *w)
 {
-	return (u8 *)(io + 1) + v->shash_descsize;
+	return (struct shash_desc *)(w + 1);
 }
 
-static u8 *io_want_digest(struct dm_verity *v, struct dm_verity_io *io)
+static u8 *io_real_digest(struct dm_verity *v, struct dm_verity_work *w)
 {
-	return (u8 *)(io + 1) + v->shash_descsize + v->digest_size;
+	return (u8 *)(w + 1) + v->shash_descsize;
+}
+
+static u8 *io_want_digest(struct dm_verity *v, struct dm_verity_work *w)
+{
+	return (u8 *)(w + 1) + v->shash_descsize + v->digest_size;
 }
 
 /*
@@ -178,17 +239,17 @@ static void verity_hash_at_level(struct dm_verity *v, sector_t block, int level,
  * Verify hash of a metadata block pertaining to the specified data block
  * ("block" argument) at a specified level ("level" argument).
  *
- * On successful return, io_want_digest(v, io) contains the hash value for
+ * On successful return, io_want_digest(v, w) contains the hash value for
  * a lower tree level or for the data block (if we're at the lowest leve).
  *
  * If "skip_unverified" is true, unverified buffer is skipped and 1 is returned.
  * If "skip_unverified" is false, unverified buffer is hashed and verified
- * against current value of io_want_digest(v, io).
+ * against current value of io_want_digest(v, w).
  */
-static int verity_verify_level(struct dm_verity_io *io, sector_t block,
+static int verity_verify_level(struct dm_verity_work *w, sector_t block,
 			       int level, bool skip_unverified)
 {
-	struct dm_verity *v = io->v;
+	struct dm_verity *v = w->io->v;
 	struct dm_buffer *buf;
 	struct buffer_aux *aux;
 	u8 *data;
@@ -204,6 +265,10 @@ static int verity_verify_level(struct dm_verity_io *io, sector_t block,
 
 	aux = dm_bufio_get_aux_data(buf);
 
+	if (!aux->hash_verified && v->verified_bitmap &&
+	    test_bit(hash_block - v->hash_start, v->verified_bitmap))
+		aux->hash_verified = 1;
+
 	if (!aux->hash_verified) {
 		struct shash_desc *desc;
 		u8 *result;
@@ -213,7 +278,7 @@ static int verity_verify_level(struct dm_verity_io *io, sector_t block,
 			goto release_ret_r;
 		}
 
-		desc = io_hash_desc(v, io);
+		desc = io_hash_desc(v, w);
 		desc->tfm = v->tfm;
 		desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
 		r = crypto_shash_init(desc);
@@ -244,25 +309,29 @@ static int verity_verify_level(struct dm_verity_io *io, sector_t block,
 			}
 		}
 
-		result = io_real_digest(v, io);
+		result = io_real_digest(v, w);
 		r = crypto_shash_final(desc, result);
 		if (r < 0) {
 			DMERR("crypto_shash_final failed: %d", r);
 			goto release_ret_r;
 		}
-		if (unlikely(memcmp(result, io_want_digest(v, io), v->digest_size))) {
+		if (unlikely(memcmp(result, io_want_digest(v, w), v->digest_size))) {
 			DMERR_LIMIT("metadata block %llu is corrupted",
 				(unsigned long long)hash_block);
 			v->hash_failed = 1;
 			r = -EIO;
 			goto release_ret_r;
-		} else
+		} else {
 			aux->hash_verified = 1;
+			if (v->verified_bitmap)
+				set_bit(hash_block - v->hash_start,
+					v->verified_bitmap);
+		}
 	}
 
 	data += offset;
 
-	memcpy(io_want_digest(v, io), data, v->digest_size);
+	memcpy(io_want_digest(v, w), data, v->digest_size);
 
 	dm_bufio_release(buf);
 	return 0;
@@ -274,46 +343,141 @@ release_ret_r:
 }
 
 /*
- * Verify one "dm_verity_io" structure.
+ * Get the expected hash of a data block into io_want_digest(v, w),
+ * verifying the hash blocks on the way down from the root as needed.
+ */
+static int verity_want_digest(struct dm_verity_work *w, sector_t block)
+{
+	struct dm_verity *v = w->io->v;
+	int i;
+
+	if (likely(v->levels)) {
+		/*
+		 * First, we try to get the requested hash for
+		 * the current block. If the hash block itself is
+		 * verified, zero is returned. If it isn't, this
+		 * function returns 0 and we fall back to whole
+		 * chain verification.
+		 */
+		int r = verity_verify_level(w, block, 0, true);
+		if (likely(!r))
+			return 0;
+		if (r < 0)
+			return r;
+	}
+
+	memcpy(io_want_digest(v, w), v->root_digest, v->digest_size);
+
+	for (i = v->levels - 1; i >= 0; i--) {
+		int r = verity_verify_level(w, block, i, false);
+		if (unlikely(r))
+			return r;
+	}
+
+	return 0;
+}
+
+/*
+ * Verify DM_VERITY_MB_BLOCKS data blocks starting at block b with one
+ * v->finup_mb() call. Returns 1 without doing anything if one of the
+ * blocks is split between bio vector entries.
+ */
+static int verity_verify_blocks_mb(struct dm_verity_work *w, unsigned b,
+				   unsigned *vector, unsigned *offset)
+{
+	struct dm_verity_io *io = w->io;
+	struct dm_verity *v = io->v;
+	unsigned block_size = 1 << v->data_dev_block_bits;
+	u8 want[DM_VERITY_MB_BLOCKS][SHA256_DIGEST_SIZE];
+	u8 real[DM_VERITY_MB_BLOCKS][SHA256_DIGEST_SIZE];
+	const u8 *data[DM_VERITY_MB_BLOCKS];
+	u8 *out[DM_VERITY_MB_BLOCKS];
+	struct bio_vec *bv[DM_VERITY_MB_BLOCKS];
+	unsigned bv_off[DM_VERITY_MB_BLOCKS];
+	unsigned vec = *vector, off = *offset;
+	void *page[DM_VERITY_MB_BLOCKS];
+	int i, r;
+
+	for (i = 0; i < DM_VERITY_MB_BLOCKS; i++) {
+		BUG_ON(vec >= io->io_vec_size);
+		bv[i] = &io->io_vec[vec];
+		if (bv[i]->bv_len - off < block_size)
+			return 1;
+		bv_off[i] = bv[i]->bv_offset + off;
+		off += block_size;
+		if (off == bv[i]->bv_len) {
+			off = 0;
+			vec++;
+		}
+	}
+
+	for (i = 0; i < DM_VERITY_MB_BLOCKS; i++) {
+		r = verity_want_digest(w, io->block + b + i);
+		if (unlikely(r))
+			return r;
+		memcpy(want[i], io_want_digest(v, w), SHA256_DIGEST_SIZE);
+	}
+
+	for (i = 0; i < DM_VERITY_MB_BLOCKS; i++) {
+		page[i] = kmap_atomic(bv[i]->bv_page);
+		data[i] = page[i] + bv_off[i];
+		out[i] = real[i];
+	}
+	r = v->finup_mb(v->salt, v->salt_size, data, block_size, out,
+			DM_VERITY_MB_BLOCKS);
+	for (i = DM_VERITY_MB_BLOCKS - 1; i >= 0; i--)
+		kunmap_atomic(page[i]);
+	if (r < 0) {
+		DMERR("sha256_finup_mb failed: %d", r);
+		return r;
+	}
+
+	for (i = 0; i < DM_VERITY_MB_BLOCKS; i++) {
+		if (unlikely(memcmp(real[i], want[i], SHA256_DIGEST_SIZE))) {
+			DMERR_LIMIT("data block %llu is corrupted",
+				(unsigned long long)(io->block + b + i));
+			v->hash_failed = 1;
+			return -EIO;
+		}
+	}
+
+	*vector = vec;
+	*offset = off;
+	return 0;
+}
+
+/*
+ * Verify the blocks of one "dm_verity_work" structure.
  */
-static int verity_verify_io(struct dm_verity_io *io)
+static int verity_verify_blocks(struct dm_verity_work *w)
 {
+	struct dm_verity_io *io = w->io;
 	struct dm_verity *v = io->v;
 	unsigned b;
-	int i;
-	unsigned vector = 0, offset = 0;
+	unsigned vector = w->vector, offset = w->offset;
 
-	for (b = 0; b < io->n_blocks; b++) {
+	for (b = w->block; b < w->block + w->n_blocks; b++) {
 		struct shash_desc *desc;
 		u8 *result;
 		int r;
 		unsigned todo;
 
-		if (likely(v->levels)) {
-			/*
-			 * First, we try to get the requested hash for
-			 * the current block. If the hash block itself is
-			 * verified, zero is returned. If it isn't, this
-			 * function returns 0 and we fall back to whole
-			 * chain verification.
-			 */
-			int r = verity_verify_level(io, io->block + b, 0, true);
-			if (likely(!r))
-				goto test_block_hash;
+		if (v->finup_mb &&
+		    w->block + w->n_blocks - b >= DM_VERITY_MB_BLOCKS) {
+			r = verity_verify_blocks_mb(w, b, &vector, &offset);
 			if (r < 0)
 				return r;
+			if (!r) {
+				b += DM_VERITY_MB_BLOCKS - 1;
+				continue;
+			}
 		}
 
-		memcpy(io_want_digest(v, io), v->root_digest, v->digest_size);
-
-		for (i = v->levels - 1; i >= 0; i--) {
-			int r = verity_verify_level(io, io->block + b, i, false);
-			if (unlikely(r))
-				return r;
-		}
+		r = verity_want_digest(w, io->block + b);
+		if (unlikely(r))
+			return r;
 
-test_block_hash:
-		desc = io_hash_desc(v, io);
+		desc = io_hash_desc(v, w);
 		desc->tfm = v->tfm;
 		desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
 		r = crypto_shash_init(desc);
@@ -365,21 +529,23 @@ test_block_hash:
 			}
 		}
 
-		result = io_real_digest(v, io);
+		result = io_real_digest(v, w);
 		r = crypto_shash_final(desc, result);
 		if (r < 0) {
 			DMERR("crypto_shash_final failed: %d", r);
 			return r;
 		}
-		if (unlikely(memcmp(result, io_want_digest(v, io), v->digest_size))) {
+		if (unlikely(memcmp(result, io_want_digest(v, w), v->digest_size))) {
 			DMERR_LIMIT("data block %llu is corrupted",
 				(unsigned long long)(io->block + b));
 			v->hash_failed = 1;
 			return -EIO;
 		}
 	}
-	BUG_ON(vector != io->io_vec_size);
-	BUG_ON(offset);
+	if (w->block + w->n_blocks == io->n_blocks) {
+		BUG_ON(vector != io->io_vec_size);
+		BUG_ON(offset);
+	}
 
 	return 0;
 }
@@ -403,11 +569,81 @@ static void verity_finish_io(struct dm_verity_io *io, int error)
 	bio_endio(bio, error);
 }
 
-static void verity_work(struct work_struct *w)
+static void verity_work_done(struct dm_verity_work *w, int error)
+{
+	struct dm_verity_io *io = w->io;
+
+	if (unlikely(error))
+		cmpxchg(&io->error, 0, error);
+
+	if (atomic_dec_and_test(&io->pending))
+		verity_finish_io(io, io->error);
+}
+
+static void verity_parallel_work(struct work_struct *ws)
 {
-	struct dm_verity_io *io = container_of(w, struct dm_verity_io, work);
+	struct dm_verity_work *w = container_of(ws, struct dm_verity_work, work);
 
-	verity_finish_io(io, verity_verify_io(io));
+	verity_work_done(w, verity_verify_blocks(w));
+}
+
+/*
+ * Split the blocks of an io over up to v->parallel workers. The first
+ * range is verified right here, the others are queued on verify_wq where
+ * they run on other cpus. Whichever finishes last ends the io.
+ */
+static void verity_work(struct work_struct *ws)
+{
+	struct dm_verity_io *io = container_of(ws, struct dm_verity_io, work);
+	struct dm_verity *v = io->v;
+	struct dm_verity_work *w;
+	unsigned nr, i, block, vector, offset, todo;
+
+	nr = min(v->parallel, *(volatile unsigned *)&dm_verity_parallel);
+	nr = min(nr, io->n_blocks / DM_VERITY_MIN_PARALLEL_BLOCKS);
+	if (!nr)
+		nr = 1;
+
+	io->error = 0;
+	atomic_set(&io->pending, nr);
+
+	block = vector = offset = 0;
+	for (i = 0; i < nr; i++) {
+		w = io_work(v, io, i);
+		w->io = io;
+		w->block = block;
+		w->n_blocks = io->n_blocks / nr + (i < io->n_blocks % nr);
+		w->vector = vector;
+		w->offset = offset;
+		block += w->n_blocks;
+
+		if (i == nr - 1)
+			break;
+
+		/* Find where the next range starts in the bio vector */
+		todo = w->n_blocks << v->data_dev_block_bits;
+		while (todo) {
+			unsigned len = io->io_vec[vector].bv_len - offset;
+
+			if (len > todo)
+				len = todo;
+			offset += len;
+			if (offset == io->io_vec[vector].bv_len) {
+				offset = 0;
+				vector++;
+			}
+			todo -= len;
+		}
+	}
+
+	for (i = 1; i < nr; i++) {
+		w = io_work(v, io, i);
+		INIT_WORK(&w->work, verity_parallel_work);
+		queue_work(v->verify_wq, &w->work);
+	}
+
+	w = io_work(v, io, 0);
+	verity_work_done(w, verity_verify_blocks(w));
 }
 
 static void verity_end_io(struct bio *bio, int error)
@@ -544,6 +780,8 @@ static void verity_status(struct dm_target *ti, status_type_t type,
 		else
 			for (x = 0; x < v->salt_size; x++)
 				DMEMIT("%02x", v->salt[x]);
+		if (v->verified_bitmap)
+			DMEMIT(" 1 " DM_VERITY_OPT_HASH_ONCE);
 		break;
 	}
 }
@@ -614,6 +852,10 @@ static void verity_dtr(struct dm_target *ti)
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
 
+	if (v->finup_mb)
+		symbol_put(sha256_finup_mb);
+
+	vfree(v->verified_bitmap);
 	kfree(v->salt);
 	kfree(v->root_digest);
 
@@ -644,6 +886,14 @@ static void verity_dtr(struct dm_target *ti)
  *	<algorithm>
  *	<digest>
  *	<salt>		Hex string or "-" if no salt.
+ *
+ * Optionally followed by:
+ *	<#opt_params>	The number of optional parameters.
+ *	hash_verify_once
+ *			Verify each hash block only once per activation,
+ *			rather than every time it is read from the hash
+ *			device. Only safe if the hash device cannot be
+ *			changed behind the back of the kernel.
  */
 static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 {
@@ -669,8 +919,8 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
-	if (argc != 10) {
-		ti->error = "Invalid argument count: exactly 10 arguments required";
+	if (argc < 10) {
+		ti->error = "Invalid argument count: at least 10 arguments required";
 		r = -EINVAL;
 		goto bad;
 	}
@@ -822,6 +1072,32 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	}
 	v->hash_blocks = hash_position;
 
+	if (argc > 10) {
+		if (sscanf(argv[10], "%u%c", &num, &dummy) != 1 ||
+		    num != argc - 11) {
+			ti->error = "Invalid number of optional parameters";
+			r = -EINVAL;
+			goto bad;
+		}
+		for (i = 11; i < argc; i++) {
+			if (!strcasecmp(argv[i], DM_VERITY_OPT_HASH_ONCE) &&
+			    !v->verified_bitmap) {
+				v->verified_bitmap = vzalloc(BITS_TO_LONGS(
+					v->hash_blocks - v->hash_start) *
+					sizeof(unsigned long));
+				if (!v->verified_bitmap) {
+					ti->error = "Cannot allocate verified hash block bitmap";
+					r = -ENOMEM;
+					goto bad;
+				}
+				continue;
+			}
+			ti->error = "Invalid optional parameter";
+			r = -EINVAL;
+			goto bad;
+		}
+	}
+
 	v->bufio = dm_bufio_client_create(v->hash_dev->bdev,
 		1 << v->hash_dev_block_bits, 1, sizeof(struct buffer_aux),
 		dm_bufio_alloc_callback, NULL);
@@ -838,8 +1114,20 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
+	/*
+	 * Version 0 hashes the salt after the block, which the multi-buffer
+	 * helper does not do.
+	 */
+	if (v->version >= 1 &&
+	    !strcmp(crypto_tfm_alg_driver_name(crypto_shash_tfm(v->tfm)),
+		    "sha256-neon"))
+		v->finup_mb = symbol_get(sha256_finup_mb);
+
+	v->parallel = clamp_t(unsigned, num_online_cpus(), 1, DM_VERITY_MAX_PARALLEL);
+	v->work_size = ALIGN(sizeof(struct dm_verity_work) + v->shash_descsize +
+			     v->digest_size * 2, __alignof__(struct shash_desc));
 	v->io_mempool = mempool_create_kmalloc_pool(DM_VERITY_MEMPOOL_SIZE,
-	  sizeof(struct dm_verity_io) + v->shash_descsize + v->digest_size * 2);
+	  sizeof(struct dm_verity_io) + v->parallel * v->work_size);
 	if (!v->io_mempool) {
 		ti->error = "Cannot allocate io mempool";
 		r = -ENOMEM;
@@ -872,7 +1160,7 @@ bad:
 
 static struct target_type verity_target = {
 	.name		= "verity",
-	.version	= {1, 0, 0},
+	.version	= {1, 1, 0},
 	.module		= THIS_MODULE,
 	.ctr		= verity_ctr,
 	.dtr		= verity_dtr,
@@ -20,6 +20,8 @@
 #include <linux/proc_fs.h>
 #include <linux/videodev2.h>
 #include <linux/vmalloc.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 
 #include <media/v4l2-dev.h>
@@ -119,8 +121,125 @@ static int msm_isp_free_buf_handle(struct msm_isp_buf_mgr *buf_mgr,
 	return 0;
 }
 
+/*
+ * Idle mappings are kept so that a buffer queued again, by the same or
+ * a later stream of this session, skips ion_map_iommu(). Only the most
+ * recently used MSM_ISP_MAP_CACHE_IDLE_MAX idle ones are kept, the rest
+ * are unmapped; everything goes when the ION client does.
+ */
+static void msm_isp_evict_map(struct msm_isp_buf_mgr *buf_mgr,
+	struct msm_isp_buf_map *map)
+{
+	ion_unmap_iommu(buf_mgr->client, map->handle,
+		buf_mgr->iommu_domain_num, 0);
+	ion_free(buf_mgr->client, map->handle);
+	list_del(&map->list);
+	kfree(map);
+	buf_mgr->map_evictions++;
+}
+
+static void msm_isp_trim_map_cache(struct msm_isp_buf_mgr *buf_mgr)
+{
+	struct msm_isp_buf_map *map, *tmp;
+	int idle = 0;
+
+	list_for_each_entry_safe(map, tmp, &buf_mgr->map_cache, list) {
+		if (map->refcount)
+			continue;
+		if (++idle > MSM_ISP_MAP_CACHE_IDLE_MAX)
+			msm_isp_evict_map(buf_mgr, map);
+	}
+}
+
+static void msm_isp_flush_map_cache(struct msm_isp_buf_mgr *buf_mgr)
+{
+	struct msm_isp_buf_map *map, *tmp;
+
+	mutex_lock(&buf_mgr->map_lock);
+	list_for_each_entry_safe(map, tmp, &buf_mgr->map_cache, list) {
+		WARN_ON(map->refcount);
+		msm_isp_evict_map(buf_mgr, map);
+	}
+	mutex_unlock(&buf_mgr->map_lock);
+}
+
+static int msm_isp_map_buf(struct msm_isp_buf_mgr *buf_mgr,
+	struct msm_isp_bufq *bufq,
+	struct msm_isp_buffer_mapped_info *mapped_info, int fd)
+{
+	struct ion_handle *handle;
+	struct msm_isp_buf_map *map;
+
+	handle = ion_import_dma_buf(buf_mgr->client, fd);
+	if (IS_ERR_OR_NULL(handle)) {
+		pr_err("%s: buf has null/error ION handle %pK\n",
+			__func__, handle);
+		return -EINVAL;
+	}
+
+	mutex_lock(&buf_mgr->map_lock);
+	/* ION hands out the same handle for a buffer this client has */
+	list_for_each_entry(map, &buf_mgr->map_cache, list) {
+		if (map->handle == handle) {
+			/* the cache already holds a reference */
+			ion_free(buf_mgr->client, handle);
+			map->refcount++;
+			list_move(&map->list, &buf_mgr->map_cache);
+			bufq->map_hits++;
+			buf_mgr->map_hits++;
+			goto done;
+		}
+	}
+
+	map = kzalloc(sizeof(struct msm_isp_buf_map), GFP_KERNEL);
+	if (!map) {
+		pr_err("%s: No free memory for buf map\n", __func__);
+		goto error;
+	}
+	if (ion_map_iommu(buf_mgr->client, handle,
+			buf_mgr->iommu_domain_num, 0, SZ_4K,
+			0, &map->paddr, &map->len, 0, 0) < 0) {
+		pr_err("%s: cannot map address", __func__);
+		kfree(map);
+		goto error;
+	}
+	map->handle = handle;
+	map->refcount = 1;
+	list_add(&map->list, &buf_mgr->map_cache);
+	bufq->map_misses++;
+	buf_mgr->map_misses++;
+	msm_isp_trim_map_cache(buf_mgr);
+done:
+	mapped_info->handle = handle;
+	mapped_info->paddr = map->paddr;
+	mapped_info->len = map->len;
+	mutex_unlock(&buf_mgr->map_lock);
+	return 0;
+error:
+	mutex_unlock(&buf_mgr->map_lock);
+	ion_free(buf_mgr->client, handle);
+	return -EINVAL;
+}
+
+static void msm_isp_unmap_buf(struct msm_isp_buf_mgr *buf_mgr,
+	struct msm_isp_buffer_mapped_info *mapped_info)
+{
+	struct msm_isp_buf_map *map;
+
+	mutex_lock(&buf_mgr->map_lock);
+	list_for_each_entry(map, &buf_mgr->map_cache, list) {
+		if (map->handle == mapped_info->handle) {
+			if (!WARN_ON(!map->refcount))
+				map->refcount--;
+			msm_isp_trim_map_cache(buf_mgr);
+			break;
+		}
+	}
+	mutex_unlock(&buf_mgr->map_lock);
+}
+
 static int msm_isp_prepare_v4l2_buf(struct msm_isp_buf_mgr *buf_mgr,
-	struct msm_isp_buffer *buf_info,
+	struct msm_isp_bufq *bufq, struct msm_isp_buffer *buf_info,
 	struct v4l2_buffer *v4l2_buf)
 {
 	int i, rc = -1;
@@ -129,21 +248,9 @@ static int msm_isp_prepare_v4l2_buf(struct msm_isp_buf_mgr *buf_mgr,
 
 	for (i = 0; i < v4l2_buf->length; i++) {
 		mapped_info = &buf_info->mapped_info[i];
-		mapped_info->handle =
-		ion_import_dma_buf(buf_mgr->client,
-			v4l2_buf->m.planes[i].m.userptr);
-		if (IS_ERR_OR_NULL(mapped_info->handle)) {
-			pr_err("%s: buf has null/error ION handle %pK\n",
-				__func__, mapped_info->handle);
-			goto ion_map_error;
-		}
-		if (ion_map_iommu(buf_mgr->client, mapped_info->handle,
-				buf_mgr->iommu_domain_num, 0, SZ_4K,
-				0, &(mapped_info->paddr),
-				&(mapped_info->len), 0, 0) < 0) {
+		if (msm_isp_map_buf(buf_mgr, bufq, mapped_info,
+				v4l2_buf->m.planes[i].m.userptr) < 0) {
 			rc = -EINVAL;
-			pr_err("%s: cannot map address", __func__);
-			ion_free(buf_mgr->client, mapped_info->handle);
 			goto ion_map_error;
 		}
 		mapped_info->paddr += v4l2_buf->m.planes[i].data_offset;
@@ -164,9 +271,7 @@ static int msm_isp_prepare_v4l2_buf(struct msm_isp_buf_mgr *buf_mgr,
 ion_map_error:
 	for (--i; i >= 0; i--) {
 		mapped_info = &buf_info->mapped_info[i];
-		ion_unmap_iommu(buf_mgr->client, mapped_info->handle,
-		buf_mgr->iommu_domain_num, 0);
-		ion_free(buf_mgr->client, mapped_info->handle);
+		msm_isp_unmap_buf(buf_mgr, mapped_info);
 	}
 	return rc;
 }
@@ -187,10 +292,7 @@ static void msm_isp_unprepare_v4l2_buf(
 				break;
 
 			if (buf_pending->mapped_info == mapped_info) {
-				ion_unmap_iommu(buf_mgr->client,
-					mapped_info->handle,
-					buf_mgr->iommu_domain_num, 0);
-				ion_free(buf_mgr->client, mapped_info->handle);
+				msm_isp_unmap_buf(buf_mgr, mapped_info);
 
 				list_del_init(&buf_pending->list);
 				kfree(buf_pending);
@@ -261,7 +363,7 @@ static int msm_isp_buf_prepare(struct msm_isp_buf_mgr *buf_mgr,
 		buf->m.planes = plane;
 	}
 
-	rc = msm_isp_prepare_v4l2_buf(buf_mgr, buf_info, buf);
+	rc = msm_isp_prepare_v4l2_buf(buf_mgr, bufq, buf_info, buf);
 	if (rc < 0) {
 		pr_err("%s: Prepare buffer error\n", __func__);
 		kfree(plane);
@@ -707,9 +809,13 @@ static int msm_isp_release_bufq(struct msm_isp_buf_mgr *buf_mgr,
 	}
 
 	msm_isp_buf_unprepare(buf_mgr, bufq_handle);
+	CDBG("%s: stream %x map cache hits %u misses %u\n", __func__,
+		bufq->stream_id, bufq->map_hits, bufq->map_misses);
 
+	mutex_lock(&buf_mgr->map_lock);
 	kfree(bufq->bufs);
 	msm_isp_free_buf_handle(buf_mgr, bufq_handle);
+	mutex_unlock(&buf_mgr->map_lock);
 	return 0;
 }
 
@@ -797,9 +903,13 @@ static int msm_isp_deinit_isp_buf_mgr(
 	if (--buf_mgr->open_count)
 		return 0;
 	msm_isp_release_all_bufq(buf_mgr);
+	msm_isp_flush_map_cache(buf_mgr);
 	ion_client_destroy(buf_mgr->client);
+	mutex_lock(&buf_mgr->map_lock);
 	kfree(buf_mgr->bufq);
+	buf_mgr->bufq = NULL;
 	buf_mgr->num_buf_q = 0;
+	mutex_unlock(&buf_mgr->map_lock);
 	msm_isp_detach_ctx(buf_mgr);
 	return 0;
 }
@@ -827,6 +937,46 @@ int msm_isp_proc_buf_cmd(struct msm_isp_buf_mgr *buf_mgr,
 	return 0;
 }
 
+static int msm_isp_map_stats_show(struct seq_file *m, void *unused)
+{
+	struct msm_isp_buf_mgr *buf_mgr = m->private;
+	struct msm_isp_buf_map *map;
+	struct msm_isp_bufq *bufq;
+	int i, mapped = 0, idle = 0;
+
+	mutex_lock(&buf_mgr->map_lock);
+	list_for_each_entry(map, &buf_mgr->map_cache, list) {
+		mapped++;
+		if (!map->refcount)
+			idle++;
+	}
+	seq_printf(m, "mapped %d idle %d hits %u misses %u evictions %u\n",
+		mapped, idle, buf_mgr->map_hits, buf_mgr->map_misses,
+		buf_mgr->map_evictions);
+	for (i = 0; i < buf_mgr->num_buf_q; i++) {
+		bufq = &buf_mgr->bufq[i];
+		if (!bufq->bufq_handle)
+			continue;
+		seq_printf(m, "session %u stream %x: hits %u misses %u\n",
+			bufq->session_id, bufq->stream_id,
+			bufq->map_hits, bufq->map_misses);
+	}
+	mutex_unlock(&buf_mgr->map_lock);
+	return 0;
+}
+
+static int msm_isp_map_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_isp_map_stats_show, inode->i_private);
+}
+
+static const struct file_operations msm_isp_map_stats_fops = {
+	.open		= msm_isp_map_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static struct msm_isp_buf_ops isp_buf_ops = {
 	.request_buf = msm_isp_request_bufq,
 	.enqueue_buf = msm_isp_buf_enqueue,
@@ -868,6 +1018,10 @@ int msm_isp_create_isp_buf_mgr(
 
 	buf_mgr->ops = &isp_buf_ops;
 	buf_mgr->vb2_ops = vb2_ops;
+	mutex_init(&buf_mgr->map_lock);
+	INIT_LIST_HEAD(&buf_mgr->map_cache);
+	debugfs_create_file("msm_isp_buf_map", S_IRUGO, NULL, buf_mgr,
+		&msm_isp_map_stats_fops);
 	buf_mgr->init_done = 1;
 	buf_mgr->open_count = 0;
 	return 0;
@@ -20,6 +20,8 @@
 /*Buffer source can be from userspace / HAL*/
 #define BUF_SRC(id) (id & ISP_NATIVE_BUF_BIT)
 #define ISP_SHARE_BUF_CLIENT 2
+/* idle IOMMU mappings kept around for buffers that come back */
+#define MSM_ISP_MAP_CACHE_IDLE_MAX 16
 
 struct msm_isp_buf_mgr;
 
@@ -49,6 +51,15 @@ struct buffer_cmd {
 	struct msm_isp_buffer_mapped_info *mapped_info;
 };
 
+/* One IOMMU mapping of an ION buffer, shared by every plane using it */
+struct msm_isp_buf_map {
+	struct list_head list;
+	struct ion_handle *handle;
+	unsigned long paddr;
+	unsigned long len;
+	uint32_t refcount;
+};
+
 struct msm_isp_buffer {
 	/*Common Data structure*/
 	int num_planes;
@@ -87,6 +98,9 @@ struct msm_isp_bufq {
 	/*Share buffer cache queue*/
 	struct list_head share_head;
 	uint8_t buf_client_count;
+
+	uint32_t map_hits;
+	uint32_t map_misses;
 };
 
 struct msm_isp_buf_ops {
@@ -144,6 +158,13 @@ struct msm_isp_buf_mgr {
 	int num_iommu_ctx;
 	struct device *iommu_ctx[2];
 	struct list_head buffer_q;
+
+	/*IOMMU mapping cache, most recently used first*/
+	struct mutex map_lock;
+	struct list_head map_cache;
+	uint32_t map_hits;
+	uint32_t map_misses;
+	uint32_t map_evictions;
 };
 
 int msm_isp_create_isp_buf_mgr(struct msm_isp_buf_mgr *buf_mgr,
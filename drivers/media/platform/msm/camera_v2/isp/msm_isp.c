@@ -147,6 +147,7 @@ static int __devinit vfe_probe(struct platform_device *pdev)
 	vfe_dev->buf_mgr->ops->register_ctx(vfe_dev->buf_mgr,
 		&vfe_dev->iommu_ctx[0], vfe_dev->hw_info->num_iommu_ctx);
 	vfe_dev->vfe_open_cnt = 0;
+	msm_isp_irq_stats_debugfs_init(vfe_dev);
 end:
 	return rc;
 }
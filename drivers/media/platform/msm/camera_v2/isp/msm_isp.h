@@ -220,6 +220,9 @@ struct msm_vfe_hardware_info {
 	struct v4l2_subdev_internal_ops *subdev_internal_ops;
 	struct v4l2_subdev_ops *subdev_ops;
 	uint32_t dmi_reg_offset;
+	/* SOF and reg update bits, each of which starts a new irq event */
+	uint32_t frame_start_irq_mask0;
+	uint32_t frame_start_irq_mask1;
 };
 
 struct msm_vfe_axi_hardware_info {
@@ -406,6 +409,17 @@ struct msm_vfe_tasklet_queue_cmd {
 
 #define MSM_VFE_TASKLETQ_SIZE 200
 
+struct msm_vfe_irq_stats {
+	uint32_t irqs;
+	uint32_t events;	/* entries queued for the tasklet */
+	uint32_t coalesced;	/* irqs folded into a queued entry */
+	uint32_t frames;
+	uint64_t frame_isr_ns;	/* isr time of the frame in progress */
+	uint64_t last_isr_ns;
+	uint64_t max_isr_ns;
+	uint64_t total_isr_ns;
+};
+
 struct msm_vfe_error_info {
 	atomic_t overflow_state;
 	uint32_t overflow_recover_irq_mask0;
@@ -455,6 +469,7 @@ struct vfe_device {
 	struct tasklet_struct vfe_tasklet;
 	struct msm_vfe_tasklet_queue_cmd
 	tasklet_queue_cmd[MSM_VFE_TASKLETQ_SIZE];
+	struct msm_vfe_irq_stats irq_stats;
 	uint32_t soc_hw_version;
 	uint32_t vfe_hw_version;
 	struct msm_vfe_hardware_info *hw_info;
@@ -1206,6 +1206,8 @@ struct msm_vfe_hardware_info vfe32_hw_info = {
 		},
 	},
 	.dmi_reg_offset = 0x5A0,
+	.frame_start_irq_mask0 = 0x21, /* SOF, PIX reg update */
+	.frame_start_irq_mask1 = 0x1C000000, /* RDI reg update */
 	.axi_hw_info = &msm_vfe32_axi_hw_info,
 	.stats_hw_info = &msm_vfe32_stats_hw_info,
 	.subdev_ops = &msm_vfe32_subdev_ops,
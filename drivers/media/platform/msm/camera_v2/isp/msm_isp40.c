@@ -1574,6 +1574,8 @@ struct msm_vfe_hardware_info vfe40_hw_info = {
 		},
 	},
 	.dmi_reg_offset = 0x918,
+	.frame_start_irq_mask0 = 0xF1, /* SOF, PIX/RDI reg update */
+	.frame_start_irq_mask1 = 0,
 	.axi_hw_info = &msm_vfe40_axi_hw_info,
 	.stats_hw_info = &msm_vfe40_stats_hw_info,
 	.subdev_ops = &msm_vfe40_subdev_ops,
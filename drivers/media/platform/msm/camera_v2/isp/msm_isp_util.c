@@ -13,6 +13,10 @@
 #include <linux/io.h>
 #include <media/v4l2-subdev.h>
 #include <linux/ratelimit.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
 
 #include "msm.h"
 #include "msm_isp_util.h"
@@ -1152,6 +1156,61 @@ static void msm_isp_process_overflow_recovery(
 	}
 }
 
+static bool msm_isp_is_frame_start(struct vfe_device *vfe_dev,
+	uint32_t irq_status0, uint32_t irq_status1)
+{
+	return (irq_status0 & vfe_dev->hw_info->frame_start_irq_mask0) ||
+		(irq_status1 & vfe_dev->hw_info->frame_start_irq_mask1);
+}
+
+/*
+ * Fold the irq into the newest entry the tasklet has not picked up yet.
+ * SOF and reg update always open an entry of their own, so the rest of
+ * a frame (EOF, write master and stats done) collapses into one tasklet
+ * pass without reordering anything against a frame boundary. A status
+ * bit already pending is never merged, so no event is lost.
+ */
+static bool msm_isp_coalesce_irq(struct vfe_device *vfe_dev,
+	uint32_t irq_status0, uint32_t irq_status1, bool frame_start)
+{
+	struct msm_vfe_tasklet_queue_cmd *queue_cmd;
+
+	if (frame_start || list_empty(&vfe_dev->tasklet_q) ||
+		atomic_read(&vfe_dev->error_info.overflow_state) !=
+		NO_OVERFLOW)
+		return false;
+
+	queue_cmd = list_entry(vfe_dev->tasklet_q.prev,
+		struct msm_vfe_tasklet_queue_cmd, list);
+	if (msm_isp_is_frame_start(vfe_dev, queue_cmd->vfeInterruptStatus0,
+			queue_cmd->vfeInterruptStatus1) ||
+		(queue_cmd->vfeInterruptStatus0 & irq_status0) ||
+		(queue_cmd->vfeInterruptStatus1 & irq_status1))
+		return false;
+
+	queue_cmd->vfeInterruptStatus0 |= irq_status0;
+	queue_cmd->vfeInterruptStatus1 |= irq_status1;
+	vfe_dev->irq_stats.coalesced++;
+	return true;
+}
+
+static void msm_isp_account_isr(struct vfe_device *vfe_dev,
+	bool frame_start, uint64_t isr_ns)
+{
+	struct msm_vfe_irq_stats *stats = &vfe_dev->irq_stats;
+
+	if (frame_start && stats->frame_isr_ns) {
+		stats->frames++;
+		stats->last_isr_ns = stats->frame_isr_ns;
+		stats->total_isr_ns += stats->frame_isr_ns;
+		if (stats->frame_isr_ns > stats->max_isr_ns)
+			stats->max_isr_ns = stats->frame_isr_ns;
+		stats->frame_isr_ns = 0;
+	}
+	stats->irqs++;
+	stats->frame_isr_ns += isr_ns;
+}
+
 irqreturn_t msm_isp_process_irq(int irq_num, void *data)
 {
 	unsigned long flags;
@@ -1159,6 +1218,8 @@ irqreturn_t msm_isp_process_irq(int irq_num, void *data)
 	struct vfe_device *vfe_dev = (struct vfe_device *) data;
 	uint32_t irq_status0, irq_status1;
 	uint32_t error_mask0, error_mask1;
+	uint64_t isr_start = sched_clock();
+	bool frame_start;
 
 	vfe_dev->hw_info->vfe_ops.irq_ops.
 		read_irq_status(vfe_dev, &irq_status0, &irq_status1);
@@ -1181,7 +1242,16 @@ irqreturn_t msm_isp_process_irq(int irq_num, void *data)
 		return IRQ_HANDLED;
 	}
 
+	frame_start = msm_isp_is_frame_start(vfe_dev, irq_status0, irq_status1);
 	spin_lock_irqsave(&vfe_dev->tasklet_lock, flags);
+	if (msm_isp_coalesce_irq(vfe_dev, irq_status0, irq_status1,
+			frame_start)) {
+		msm_isp_account_isr(vfe_dev, frame_start,
+			sched_clock() - isr_start);
+		spin_unlock_irqrestore(&vfe_dev->tasklet_lock, flags);
+		return IRQ_HANDLED;
+	}
+
 	queue_cmd = &vfe_dev->tasklet_queue_cmd[vfe_dev->taskletq_idx];
 	if (queue_cmd->cmd_used) {
 		pr_err_ratelimited("%s: Tasklet queue overflow: %d\n",
@@ -1197,6 +1267,8 @@ irqreturn_t msm_isp_process_irq(int irq_num, void *data)
 	vfe_dev->taskletq_idx =
 		(vfe_dev->taskletq_idx + 1) % MSM_VFE_TASKLETQ_SIZE;
 	list_add_tail(&queue_cmd->list, &vfe_dev->tasklet_q);
+	vfe_dev->irq_stats.events++;
+	msm_isp_account_isr(vfe_dev, frame_start, sched_clock() - isr_start);
 	spin_unlock_irqrestore(&vfe_dev->tasklet_lock, flags);
 	tasklet_schedule(&vfe_dev->vfe_tasklet);
 	return IRQ_HANDLED;
@@ -1251,6 +1323,45 @@ void msm_isp_do_tasklet(unsigned long data)
 	}
 }
 
+static int msm_isp_irq_stats_show(struct seq_file *m, void *unused)
+{
+	struct vfe_device *vfe_dev = m->private;
+	struct msm_vfe_irq_stats stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&vfe_dev->tasklet_lock, flags);
+	stats = vfe_dev->irq_stats;
+	spin_unlock_irqrestore(&vfe_dev->tasklet_lock, flags);
+
+	seq_printf(m, "irqs %u events %u coalesced %u frames %u\n",
+		stats.irqs, stats.events, stats.coalesced, stats.frames);
+	seq_printf(m, "isr per frame: last %llu max %llu avg %llu ns\n",
+		stats.last_isr_ns, stats.max_isr_ns, stats.frames ?
+		div_u64(stats.total_isr_ns, stats.frames) : 0);
+	return 0;
+}
+
+static int msm_isp_irq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_isp_irq_stats_show, inode->i_private);
+}
+
+static const struct file_operations msm_isp_irq_stats_fops = {
+	.open		= msm_isp_irq_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+void msm_isp_irq_stats_debugfs_init(struct vfe_device *vfe_dev)
+{
+	char name[16];
+
+	snprintf(name, sizeof(name), "msm_vfe%d_irq", vfe_dev->pdev->id);
+	debugfs_create_file(name, S_IRUGO, NULL, vfe_dev,
+		&msm_isp_irq_stats_fops);
+}
+
 int msm_isp_set_src_state(struct vfe_device *vfe_dev, void *arg)
 {
 	struct msm_vfe_axi_src_state *src_state = arg;
@@ -1316,6 +1427,7 @@ int msm_isp_open_node(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 	vfe_dev->axi_data.hw_info = vfe_dev->hw_info->axi_hw_info;
 	vfe_dev->vfe_open_cnt++;
 	vfe_dev->taskletq_idx = 0;
+	memset(&vfe_dev->irq_stats, 0, sizeof(vfe_dev->irq_stats));
 	vfe_dev->vt_enable = 0;
 	mutex_unlock(&vfe_dev->core_mutex);
 	mutex_unlock(&vfe_dev->realtime_mutex);
@@ -1302,6 +1302,7 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 	}
 	mutex_lock(&inst->sync_lock);
 	if (!list_empty(&inst->pendingq)) {
+		call_hfi_op(hdev, cmdq_batch, hdev->hfi_device_data, true);
 		list_for_each_safe(ptr, next, &inst->pendingq) {
 			temp = list_entry(ptr, struct vb2_buf_entry, list);
 			rc = msm_comm_qbuf(temp->vb);
@@ -1313,6 +1314,7 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 			list_del(&temp->list);
 			kfree(temp);
 		}
+		call_hfi_op(hdev, cmdq_batch, hdev->hfi_device_data, false);
 	}
 	mutex_unlock(&inst->sync_lock);
 	return rc;
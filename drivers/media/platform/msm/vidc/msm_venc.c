@@ -1063,12 +1063,14 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 {
 	int rc = 0;
 	struct vb2_buf_entry *temp;
+	struct hfi_device *hdev;
 	struct list_head *ptr, *next;
 
 	if (!inst || !inst->core || !inst->core->device) {
 		dprintk(VIDC_ERR, "%s invalid parameters\n", __func__);
 		return -EINVAL;
 	}
+	hdev = inst->core->device;
 
 	if (inst->capability.pixelprocess_capabilities &
 		HAL_VIDEO_ENCODER_SCALING_CAPABILITY)
@@ -1104,6 +1106,7 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 	}
 	mutex_lock(&inst->sync_lock);
 	if (!list_empty(&inst->pendingq)) {
+		call_hfi_op(hdev, cmdq_batch, hdev->hfi_device_data, true);
 		list_for_each_safe(ptr, next, &inst->pendingq) {
 			temp = list_entry(ptr, struct vb2_buf_entry, list);
 			rc = msm_comm_qbuf(temp->vb);
@@ -1115,6 +1118,7 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 			list_del(&temp->list);
 			kfree(temp);
 		}
+		call_hfi_op(hdev, cmdq_batch, hdev->hfi_device_data, false);
 	}
 	mutex_unlock(&inst->sync_lock);
 	return rc;
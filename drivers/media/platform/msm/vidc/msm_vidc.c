@@ -1232,6 +1232,7 @@ void *msm_vidc_open(int core_id, int session_type)
 	inst->state = MSM_VIDC_CORE_UNINIT_DONE;
 	inst->core = core;
 	inst->map_output_buffer = false;
+	msm_comm_init_dcvs(inst);
 
 	for (i = SESSION_MSG_INDEX(SESSION_MSG_START);
 		i <= SESSION_MSG_INDEX(SESSION_MSG_END); i++) {
@@ -1387,6 +1388,7 @@ int msm_vidc_close(void *instance)
 			list_del(&inst->list);
 	}
 	mutex_unlock(&core->lock);
+	cancel_work_sync(&inst->dcvs.work);
 
 	if (inst->session_type == MSM_VIDC_DECODER)
 		msm_vdec_ctrl_deinit(inst);
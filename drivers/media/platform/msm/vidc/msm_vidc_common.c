@@ -143,9 +143,118 @@ static int msm_comm_get_inst_load(struct msm_vidc_inst *inst,
 		(quirks & LOAD_CALC_IGNORE_NON_REALTIME_LOAD))
 		load = msm_comm_get_mbs_per_sec(inst) / inst->prop.fps;
 
+	if (msm_vidc_dcvs_mode && !is_turbo_session(inst) &&
+		!is_thumbnail_session(inst) && !is_non_realtime_session(inst))
+		load = load * inst->dcvs.load_pct / 100;
+
         return load;
 }
 
+/*
+ * Frames are DCVS_WINDOW at a time compared against the frame period:
+ * a slow one puts the session back to its full load at once, a window
+ * that averaged under DCVS_LOW_PCT of the period steps the load down.
+ */
+#define DCVS_WINDOW 8
+#define DCVS_HIGH_PCT 90
+#define DCVS_LOW_PCT 50
+#define DCVS_STEP_PCT 25
+#define DCVS_MIN_PCT 25
+
+static void msm_comm_dcvs_etb(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_dcvs *dcvs = &inst->dcvs;
+	unsigned long flags;
+
+	/* only the first input after a frame came out starts the clock */
+	spin_lock_irqsave(&dcvs->lock, flags);
+	if (ktime_to_ns(dcvs->last_etb) <= ktime_to_ns(dcvs->last_fbd))
+		dcvs->last_etb = ktime_get();
+	spin_unlock_irqrestore(&dcvs->lock, flags);
+}
+
+static void msm_comm_dcvs_fbd(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_dcvs *dcvs = &inst->dcvs;
+	ktime_t now = ktime_get(), start;
+	u32 deadline_us, busy_us, load_pct;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dcvs->lock, flags);
+	start = ktime_to_ns(dcvs->last_etb) > ktime_to_ns(dcvs->last_fbd) ?
+		dcvs->last_etb : dcvs->last_fbd;
+	dcvs->last_fbd = now;
+	load_pct = dcvs->load_pct;
+
+	if (!msm_vidc_dcvs_mode || !inst->prop.fps || !ktime_to_ns(start))
+		goto exit;
+
+	deadline_us = USEC_PER_SEC / inst->prop.fps;
+	busy_us = ktime_us_delta(now, start);
+
+	if (busy_us > deadline_us * DCVS_HIGH_PCT / 100) {
+		dcvs->load_pct = 100;
+		dcvs->frames = 0;
+		dcvs->busy_us = 0;
+		goto exit;
+	}
+
+	dcvs->busy_us += busy_us;
+	if (++dcvs->frames < DCVS_WINDOW)
+		goto exit;
+
+	if (div_u64(dcvs->busy_us, dcvs->frames) <
+			deadline_us * DCVS_LOW_PCT / 100 &&
+			dcvs->load_pct > DCVS_MIN_PCT)
+		dcvs->load_pct -= DCVS_STEP_PCT;
+	dcvs->frames = 0;
+	dcvs->busy_us = 0;
+exit:
+	if (dcvs->load_pct != load_pct) {
+		dprintk(VIDC_PROF, "%s: %pK load %u%% -> %u%%\n", __func__,
+			inst, load_pct, dcvs->load_pct);
+		/* votes take core->lock and may sleep, not from here */
+		schedule_work(&dcvs->work);
+	}
+	spin_unlock_irqrestore(&dcvs->lock, flags);
+}
+
+static int msm_comm_dcvs_level(struct msm_vidc_core *core, int load)
+{
+	struct load_freq_table *table = core->resources.load_freq_tbl;
+	int i, level = 0;
+
+	/* same walk as the clock driver when it picks the rate */
+	for (i = 0; i < core->resources.load_freq_tbl_size; i++) {
+		if (load > table[i].load)
+			break;
+		level = i;
+	}
+	return min(level, MSM_VIDC_DCVS_MAX_LEVELS - 1);
+}
+
+static void msm_comm_dcvs_set_level(struct msm_vidc_core *core, int load)
+{
+	struct msm_vidc_inst *inst;
+	struct msm_vidc_dcvs *dcvs;
+	int level = msm_comm_dcvs_level(core, load);
+	ktime_t now = ktime_get();
+	unsigned long flags;
+
+	mutex_lock(&core->lock);
+	list_for_each_entry(inst, &core->instances, list) {
+		dcvs = &inst->dcvs;
+		spin_lock_irqsave(&dcvs->lock, flags);
+		if (dcvs->level >= 0)
+			dcvs->residency_us[dcvs->level] +=
+				ktime_us_delta(now, dcvs->level_start);
+		dcvs->level = level;
+		dcvs->level_start = now;
+		spin_unlock_irqrestore(&dcvs->lock, flags);
+	}
+	mutex_unlock(&core->lock);
+}
+
 static int msm_comm_get_load(struct msm_vidc_core *core,
 	enum session_type type, enum load_calc_quirks quirks)
 {
@@ -802,6 +911,7 @@ int msm_comm_queue_output_buffers(struct msm_vidc_inst *inst)
 		output_buf->buffer_count_actual,
 		output_buf->buffer_size);
 
+	call_hfi_op(hdev, cmdq_batch, hdev->hfi_device_data, true);
 	list_for_each_entry(binfo, &inst->outputbufs, list) {
 		if (binfo->buffer_ownership != DRIVER)
 			continue;
@@ -818,6 +928,7 @@ int msm_comm_queue_output_buffers(struct msm_vidc_inst *inst)
 			(void *) inst->session, &frame_data);
 		binfo->buffer_ownership = FIRMWARE;
 	}
+	call_hfi_op(hdev, cmdq_batch, hdev->hfi_device_data, false);
 	return 0;
 }
 
@@ -1390,9 +1501,11 @@ static void handle_fbd(enum command_response cmd, void *data)
 			break;
 		}
 		inst->count.fbd++;
-		if (fill_buf_done->filled_len1)
+		if (fill_buf_done->filled_len1) {
 			msm_vidc_debugfs_update(inst,
 				MSM_VIDC_DEBUGFS_EVENT_FBD);
+			msm_comm_dcvs_fbd(inst);
+		}
 
 		dprintk(VIDC_DBG,
 		"Got fbd from hal: device_addr: 0x%x, alloc: %d, filled: %d, offset: %d, ts: %lld, flags: 0x%x, crop: %d %d %d %d, pic_type: 0x%x\n",
@@ -1573,6 +1686,8 @@ static int msm_comm_scale_clocks(struct msm_vidc_core *core)
 		hdev->hfi_device_data, num_mbs_per_sec);
 	if (rc)
 		dprintk(VIDC_ERR, "Failed to set clock rate: %d\n", rc);
+	else
+		msm_comm_dcvs_set_level(core, num_mbs_per_sec);
 	return rc;
 }
 
@@ -1604,6 +1719,25 @@ void msm_comm_scale_clocks_and_bus(struct msm_vidc_inst *inst)
 	}
 }
 
+static void msm_comm_dcvs_work(struct work_struct *work)
+{
+	struct msm_vidc_inst *inst = container_of(work,
+			struct msm_vidc_inst, dcvs.work);
+
+	msm_comm_scale_clocks_and_bus(inst);
+}
+
+void msm_comm_init_dcvs(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_dcvs *dcvs = &inst->dcvs;
+
+	memset(dcvs, 0, sizeof(*dcvs));
+	spin_lock_init(&dcvs->lock);
+	dcvs->load_pct = 100;
+	dcvs->level = -1;
+	INIT_WORK(&dcvs->work, msm_comm_dcvs_work);
+}
+
 static inline unsigned long get_ocmem_requirement(u32 height, u32 width)
 {
 	int num_mbs = 0;
@@ -2703,9 +2837,11 @@ int msm_comm_qbuf(struct vb2_buffer *vb)
 				frame_data.timestamp, frame_data.flags);
 			rc = call_hfi_op(hdev, session_etb, (void *)
 					inst->session, &frame_data);
-			if (!rc)
+			if (!rc) {
 				msm_vidc_debugfs_update(inst,
 					MSM_VIDC_DEBUGFS_EVENT_ETB);
+				msm_comm_dcvs_etb(inst);
+			}
 			dprintk(VIDC_DBG, "Sent etb to HAL\n");
 		} else if (q->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
 			struct vidc_seq_hdr seq_hdr;
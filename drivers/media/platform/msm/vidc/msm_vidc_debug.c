@@ -22,6 +22,7 @@ int msm_fw_debug_mode = 0x1;
 int msm_fw_low_power_mode = 0x1;
 int msm_vidc_hw_rsp_timeout = 1000;
 u32 msm_vidc_firmware_unload_delay = 15000;
+int msm_vidc_dcvs_mode = 0x1;
 
 struct debug_buffer {
 	char ptr[MAX_DBG_BUF_SIZE];
@@ -203,6 +204,11 @@ struct dentry *msm_vidc_debugfs_init_core(struct msm_vidc_core *core,
 			"debugfs_create_file: firmware_unload_delay fail\n");
 		goto failed_create_dir;
 	}
+	if (!debugfs_create_u32("dcvs_mode", S_IRUGO | S_IWUSR,
+			parent, &msm_vidc_dcvs_mode)) {
+		dprintk(VIDC_ERR, "debugfs_create_file: dcvs_mode fail\n");
+		goto failed_create_dir;
+	}
 failed_create_dir:
 	return dir;
 }
@@ -244,6 +250,32 @@ static int publish_unreleased_reference(struct msm_vidc_inst *inst)
 	return 0;
 }
 
+static void publish_dcvs_residency(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_dcvs *dcvs = &inst->dcvs;
+	struct load_freq_table *table = inst->core->resources.load_freq_tbl;
+	u64 residency_us[MSM_VIDC_DCVS_MAX_LEVELS];
+	unsigned long flags;
+	u32 load_pct;
+	int i, levels;
+
+	levels = min_t(int, inst->core->resources.load_freq_tbl_size,
+			MSM_VIDC_DCVS_MAX_LEVELS);
+
+	spin_lock_irqsave(&dcvs->lock, flags);
+	memcpy(residency_us, dcvs->residency_us, sizeof(residency_us));
+	if (dcvs->level >= 0)
+		residency_us[dcvs->level] +=
+			ktime_us_delta(ktime_get(), dcvs->level_start);
+	load_pct = dcvs->load_pct;
+	spin_unlock_irqrestore(&dcvs->lock, flags);
+
+	write_str(&dbg_buf, "DCVS load: %u%%\n", load_pct);
+	for (i = 0; i < levels; i++)
+		write_str(&dbg_buf, "residency at %u Hz: %llu ms\n",
+			table[i].freq, div_u64(residency_us[i], USEC_PER_MSEC));
+}
+
 static ssize_t inst_info_read(struct file *file, char __user *buf,
 		size_t count, loff_t *ppos)
 {
@@ -299,6 +331,7 @@ static ssize_t inst_info_read(struct file *file, char __user *buf,
 	write_str(&dbg_buf, "EBD Count: %d\n", inst->count.ebd);
 	write_str(&dbg_buf, "FTB Count: %d\n", inst->count.ftb);
 	write_str(&dbg_buf, "FBD Count: %d\n", inst->count.fbd);
+	publish_dcvs_residency(inst);
 	publish_unreleased_reference(inst);
 
 	return simple_read_from_buffer(buf, count, ppos,
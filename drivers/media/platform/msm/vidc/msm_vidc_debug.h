@@ -55,6 +55,7 @@ extern int msm_fw_low_power_mode;
 extern int msm_vp8_low_tier;
 extern int msm_vidc_hw_rsp_timeout;
 extern u32 msm_vidc_firmware_unload_delay;
+extern int msm_vidc_dcvs_mode;
 
 #define dprintk(__level, __fmt, arg...)	\
 	do { \
@@ -15,7 +15,9 @@
 #define _MSM_VIDC_INTERNAL_H_
 
 #include <linux/atomic.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/spinlock.h>
 #include <linux/time.h>
 #include <linux/types.h>
 #include <linux/completion.h>
@@ -179,6 +181,27 @@ struct msm_vidc_debug {
 	int samples;
 };
 
+#define MSM_VIDC_DCVS_MAX_LEVELS 8
+
+/*
+ * Per session clock scaling state. The host side busy time of a frame
+ * runs from its ETB (or the previous FBD, whichever is later) to its FBD
+ * and is compared against the frame period; load_pct scales the load
+ * the session votes for.
+ */
+struct msm_vidc_dcvs {
+	spinlock_t lock;
+	u32 load_pct;
+	ktime_t last_etb;
+	ktime_t last_fbd;
+	u32 frames;
+	u64 busy_us;
+	int level;
+	ktime_t level_start;
+	u64 residency_us[MSM_VIDC_DCVS_MAX_LEVELS];
+	struct work_struct work;
+};
+
 enum msm_vidc_modes {
 	VIDC_SECURE = 1 << 0,
 	VIDC_TURBO = 1 << 1,
@@ -248,6 +271,7 @@ struct msm_vidc_inst {
 	void *priv;
 	struct msm_vidc_debug debug;
 	struct buf_count count;
+	struct msm_vidc_dcvs dcvs;
 	enum msm_vidc_modes flags;
 	u32 multi_stream_mode;
 	struct msm_vidc_core_capability capability;
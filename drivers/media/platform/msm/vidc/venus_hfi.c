@@ -1455,7 +1455,9 @@ static int venus_hfi_iface_cmdq_write_nolock(struct venus_hfi_device *device,
 			dprintk(VIDC_ERR, "Clock scaling failed\n");
 			goto err_q_write;
 		}
-		if (rx_req_is_set)
+		if (rx_req_is_set && device->cmdq_batch)
+			device->cmdq_doorbell_pending = true;
+		else if (rx_req_is_set)
 			venus_hfi_write_register(
 				device,
 				VIDC_CPU_IC_SOFTINT,
@@ -1469,6 +1471,47 @@ err_q_null:
 	return result;
 }
 
+/*
+ * Between begin and end, packets are still written to the command queue
+ * as they come but the firmware is only interrupted once, at the end.
+ * Batches nest.
+ */
+static int venus_hfi_cmdq_batch(void *dev, bool begin)
+{
+	struct venus_hfi_device *device = dev;
+	int rc = 0;
+
+	if (!device) {
+		dprintk(VIDC_ERR, "Invalid Params");
+		return -EINVAL;
+	}
+	mutex_lock(&device->write_lock);
+	if (begin) {
+		device->cmdq_batch++;
+		goto exit;
+	}
+	if (WARN_ON(!device->cmdq_batch) || --device->cmdq_batch ||
+		!device->cmdq_doorbell_pending)
+		goto exit;
+
+	device->cmdq_doorbell_pending = false;
+	if (!IS_VENUS_IN_VALID_STATE(device)) {
+		rc = -EINVAL;
+		goto exit;
+	}
+	mutex_lock(&device->clk_pwr_lock);
+	rc = venus_hfi_clk_gating_off(device);
+	if (!rc)
+		venus_hfi_write_register(device, VIDC_CPU_IC_SOFTINT,
+			1 << VIDC_CPU_IC_SOFTINT_H2A_SHFT, 0);
+	else
+		dprintk(VIDC_ERR, "%s : Clock enable failed\n", __func__);
+	mutex_unlock(&device->clk_pwr_lock);
+exit:
+	mutex_unlock(&device->write_lock);
+	return rc;
+}
+
 static int venus_hfi_iface_msgq_read(struct venus_hfi_device *device, void *pkt)
 {
 	u32 tx_req_is_set = 0;
@@ -3905,6 +3948,7 @@ static void venus_init_hfi_callbacks(struct hfi_device *hdev)
 	hdev->session_resume = venus_hfi_session_resume;
 	hdev->session_etb = venus_hfi_session_etb;
 	hdev->session_ftb = venus_hfi_session_ftb;
+	hdev->cmdq_batch = venus_hfi_cmdq_batch;
 	hdev->session_parse_seq_hdr = venus_hfi_session_parse_seq_hdr;
 	hdev->session_get_seq_hdr = venus_hfi_session_get_seq_hdr;
 	hdev->session_get_buf_req = venus_hfi_session_get_buf_req;
@@ -225,6 +225,8 @@ struct venus_hfi_device {
 	struct msm_vidc_platform_resources *res;
 	struct regulator *gdsc;
 	enum venus_hfi_state state;
+	int cmdq_batch;
+	bool cmdq_doorbell_pending;
 };
 
 void venus_hfi_delete_device(void *device);
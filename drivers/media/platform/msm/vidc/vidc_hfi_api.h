@@ -1141,6 +1141,7 @@ struct hfi_device {
 			struct vidc_frame_data *input_frame);
 	int (*session_ftb)(void *sess,
 			struct vidc_frame_data *output_frame);
+	int (*cmdq_batch)(void *dev, bool begin);
 	int (*session_parse_seq_hdr)(void *sess,
 			struct vidc_seq_hdr *seq_hdr);
 	int (*session_get_seq_hdr)(void *sess,
@@ -1852,6 +1852,7 @@ static struct slim_driver taiko_slim_driver = {
 	.driver = {
 		.name = "taiko-slim",
 		.owner = THIS_MODULE,
+		.async_probe = true,
 	},
 	.probe = wcd9xxx_slim_probe,
 	.remove = wcd9xxx_slim_remove,
@@ -1872,6 +1873,7 @@ static struct slim_driver tapan_slim_driver = {
 	.driver = {
 		.name = "tapan-slim",
 		.owner = THIS_MODULE,
+		.async_probe = true,
 	},
 	.probe = wcd9xxx_slim_probe,
 	.remove = wcd9xxx_slim_remove,
@@ -1212,6 +1212,8 @@ static int stm401_probe(struct i2c_client *client,
 
 	mutex_unlock(&ps_stm401->lock);
 
+	device_enable_async_suspend(&client->dev);
+
 	dev_info(&client->dev, "probed finished\n");
 
 	return 0;
@@ -1437,6 +1439,7 @@ static struct i2c_driver stm401_driver = {
 		   .name = NAME,
 		   .owner = THIS_MODULE,
 		   .of_match_table = of_match_ptr(stm401_match_tbl),
+		   .async_probe = true,
 #ifdef CONFIG_PM
 		   .pm = &stm401_pm_ops,
 #endif
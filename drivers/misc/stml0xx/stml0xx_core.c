@@ -18,6 +18,7 @@
 
 #include <linux/cdev.h>
 #include <linux/delay.h>
+#include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/errno.h>
 #include <linux/export.h>
@@ -674,6 +675,18 @@ EXIT:
 	mutex_unlock(&ps_stml0xx->lock);
 }
 
+static void stml0xx_spi_free_bufs(struct stml0xx_data *ps_stml0xx)
+{
+	if (ps_stml0xx->spi_tx_buf)
+		dma_free_coherent(ps_stml0xx->spi_dma_dev, SPI_BUFF_SIZE,
+			ps_stml0xx->spi_tx_buf, ps_stml0xx->spi_tx_dma);
+	if (ps_stml0xx->spi_rx_buf)
+		dma_free_coherent(ps_stml0xx->spi_dma_dev, SPI_BUFF_SIZE,
+			ps_stml0xx->spi_rx_buf, ps_stml0xx->spi_rx_dma);
+	ps_stml0xx->spi_tx_buf = NULL;
+	ps_stml0xx->spi_rx_buf = NULL;
+}
+
 static int stml0xx_probe(struct spi_device *spi)
 {
 	struct stml0xx_platform_data *pdata;
@@ -722,13 +735,19 @@ static int stml0xx_probe(struct spi_device *spi)
 		goto err_pdata;
 	}
 
-	/* Allocate SPI buffers */
-	ps_stml0xx->spi_tx_buf =
-		devm_kzalloc(&spi->dev, SPI_BUFF_SIZE, GFP_KERNEL);
-	ps_stml0xx->spi_rx_buf =
-		devm_kzalloc(&spi->dev, SPI_BUFF_SIZE, GFP_KERNEL);
-	if (!ps_stml0xx->spi_tx_buf || !ps_stml0xx->spi_rx_buf)
+	/*
+	 * Allocate SPI buffers. They are mapped once here, against the
+	 * controller, so that no transfer has to map or unmap them again.
+	 */
+	ps_stml0xx->spi_dma_dev = spi->master->dev.parent;
+	ps_stml0xx->spi_tx_buf = dma_alloc_coherent(ps_stml0xx->spi_dma_dev,
+		SPI_BUFF_SIZE, &ps_stml0xx->spi_tx_dma, GFP_KERNEL);
+	ps_stml0xx->spi_rx_buf = dma_alloc_coherent(ps_stml0xx->spi_dma_dev,
+		SPI_BUFF_SIZE, &ps_stml0xx->spi_rx_dma, GFP_KERNEL);
+	if (!ps_stml0xx->spi_tx_buf || !ps_stml0xx->spi_rx_buf) {
+		err = -ENOMEM;
 		goto err_nomem;
+	}
 
 	/* global buffers used exclusively in bootloader mode */
 	stml0xx_boot_cmdbuff = ps_stml0xx->spi_tx_buf;
@@ -804,6 +823,9 @@ static int stml0xx_probe(struct spi_device *spi)
 	INIT_WORK(&ps_stml0xx->clear_interrupt_status_work,
 		  clear_interrupt_status_work_func);
 	INIT_WORK(&ps_stml0xx->initialize_work, stml0xx_initialize_work_func);
+	INIT_WORK(&ps_stml0xx->irq_work.ws, stml0xx_irq_work_func);
+	spin_lock_init(&ps_stml0xx->irq_lock);
+	ps_stml0xx->stats_jiffies = jiffies;
 
 	ps_stml0xx->irq_work_queue =
 	    create_singlethread_workqueue("stml0xx_wq");
@@ -969,6 +991,9 @@ static int stml0xx_probe(struct spi_device *spi)
 		goto err11;
 	}
 
+	if (device_create_file(&spi->dev, &dev_attr_wakeups))
+		dev_err(&spi->dev, "couldn't create wakeups attribute");
+
 	ps_stml0xx->is_suspended = false;
 
 	switch_stml0xx_mode(NORMALMODE);
@@ -1016,6 +1041,7 @@ err_gpio_init:
 	regulator_put(ps_stml0xx->regulator_1);
 err_regulator:
 err_nomem:
+	stml0xx_spi_free_bufs(ps_stml0xx);
 err_pdata:
 err_other:
 	return err;
@@ -1025,6 +1051,7 @@ static int stml0xx_remove(struct spi_device *spi)
 {
 	struct stml0xx_data *ps_stml0xx = spi_get_drvdata(spi);
 
+	device_remove_file(&spi->dev, &dev_attr_wakeups);
 	led_classdev_unregister(&ps_stml0xx->led_cdev);
 
 	switch_dev_unregister(&ps_stml0xx->dsdev);
@@ -1062,6 +1089,8 @@ static int stml0xx_remove(struct spi_device *spi)
 	regulator_put(ps_stml0xx->regulator_2);
 	regulator_put(ps_stml0xx->regulator_1);
 
+	stml0xx_spi_free_bufs(ps_stml0xx);
+
 	return 0;
 }
 
@@ -44,27 +44,26 @@
 
 irqreturn_t stml0xx_isr(int irq, void *dev)
 {
-	static struct timespec ts;
-	static struct stml0xx_work_struct *stm_ws;
+	struct timespec ts;
 	struct stml0xx_data *ps_stml0xx = dev;
 	get_monotonic_boottime(&ts);
 
 	if (stml0xx_irq_disable)
 		return IRQ_HANDLED;
 
-	stm_ws = kmalloc(
-		sizeof(struct stml0xx_work_struct),
-		GFP_ATOMIC);
-	if (!stm_ws) {
-		dev_err(&ps_stml0xx->spi->dev,
-			"stml0xx_isr: unable to allocate work struct");
-		return IRQ_HANDLED;
+	spin_lock(&ps_stml0xx->irq_lock);
+	ps_stml0xx->irq_count++;
+	if (ps_stml0xx->irq_pending) {
+		/* the queued read picks these samples up as well */
+		ps_stml0xx->irq_coalesced++;
+	} else {
+		ps_stml0xx->irq_pending = true;
+		ps_stml0xx->irq_work.ts_ns = ts_to_ns(ts);
+		queue_work(ps_stml0xx->irq_work_queue,
+			   &ps_stml0xx->irq_work.ws);
 	}
+	spin_unlock(&ps_stml0xx->irq_lock);
 
-	INIT_WORK((struct work_struct *)stm_ws, stml0xx_irq_work_func);
-	stm_ws->ts_ns = ts_to_ns(ts);
-
-	queue_work(ps_stml0xx->irq_work_queue, (struct work_struct *)stm_ws);
 	return IRQ_HANDLED;
 }
 
@@ -75,8 +74,20 @@ void stml0xx_irq_work_func(struct work_struct *work)
 	struct stml0xx_work_struct *stm_ws = (struct stml0xx_work_struct *)work;
 	struct stml0xx_data *ps_stml0xx = stml0xx_misc_data;
 	unsigned char buf[SPI_MSG_SIZE];
+	uint64_t irq_ts_ns;
 
 	dev_dbg(&stml0xx_misc_data->spi->dev, "stml0xx_irq_work_func");
+
+	/*
+	 * The timestamp is that of the oldest interrupt folded into this
+	 * read, which is when the oldest queued sample was taken. Later
+	 * interrupts queue another read.
+	 */
+	spin_lock_irq(&ps_stml0xx->irq_lock);
+	irq_ts_ns = stm_ws->ts_ns;
+	ps_stml0xx->irq_pending = false;
+	spin_unlock_irq(&ps_stml0xx->irq_lock);
+
 	mutex_lock(&ps_stml0xx->lock);
 
 	stml0xx_wake(ps_stml0xx);
@@ -112,7 +123,7 @@ void stml0xx_irq_work_func(struct work_struct *work)
 
 		data_buf = &buf[IRQ_IDX_ACCEL1];
 
-		ts_ns = stm_ws->ts_ns;
+		ts_ns = irq_ts_ns;
 		head = data_buf[28];
 		tail = data_buf[32];
 		for (
@@ -147,7 +158,7 @@ void stml0xx_irq_work_func(struct work_struct *work)
 			&buf[IRQ_IDX_ACCEL2],
 			6,
 			0,
-			stm_ws->ts_ns);
+			irq_ts_ns);
 
 		dev_dbg(&stml0xx_misc_data->spi->dev,
 			"Sending acc2(x,y,z)values:x=%d,y=%d,z=%d",
@@ -162,7 +173,7 @@ void stml0xx_irq_work_func(struct work_struct *work)
 			&buf[IRQ_IDX_ALS],
 			2,
 			0,
-			stm_ws->ts_ns);
+			irq_ts_ns);
 
 		dev_dbg(&stml0xx_misc_data->spi->dev,
 			"Sending ALS %d", STM16_TO_HOST(ALS_VALUE,
@@ -171,7 +182,7 @@ void stml0xx_irq_work_func(struct work_struct *work)
 	if (irq_status & M_DISP_ROTATE) {
 		stml0xx_as_data_buffer_write(ps_stml0xx, DT_DISP_ROTATE,
 					&buf[IRQ_IDX_DISP_ROTATE],
-					1, 0, stm_ws->ts_ns);
+					1, 0, irq_ts_ns);
 
 		dev_dbg(&stml0xx_misc_data->spi->dev,
 			"Sending disp_rotate(x)value: %d",
@@ -180,15 +191,49 @@ void stml0xx_irq_work_func(struct work_struct *work)
 	if (irq_status & M_DISP_BRIGHTNESS) {
 		stml0xx_as_data_buffer_write(ps_stml0xx, DT_DISP_BRIGHT,
 						&buf[IRQ_IDX_DISP_BRIGHTNESS],
-						 1, 0, stm_ws->ts_ns);
+						 1, 0, irq_ts_ns);
 
 		dev_dbg(&stml0xx_misc_data->spi->dev,
 			"Sending Display Brightness %d",
 			buf[IRQ_IDX_DISP_BRIGHTNESS]);
 	}
 EXIT:
-	kfree((void *)stm_ws);
 	stml0xx_sleep(ps_stml0xx);
 	/* For now HAE needs events even if the activity is still */
 	mutex_unlock(&ps_stml0xx->lock);
 }
+
+/*
+ * Interrupt totals, plus the rate of each since the previous read of
+ * the attribute, to see how often the hub wakes the AP.
+ */
+static ssize_t stml0xx_wakeups_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	struct stml0xx_data *ps_stml0xx = spi_get_drvdata(to_spi_device(dev));
+	unsigned int irqs, wake_irqs, coalesced, secs_x100;
+	unsigned int irq_rate, wake_irq_rate;
+	unsigned long now = jiffies;
+
+	spin_lock_irq(&ps_stml0xx->irq_lock);
+	irqs = ps_stml0xx->irq_count;
+	coalesced = ps_stml0xx->irq_coalesced;
+	spin_unlock_irq(&ps_stml0xx->irq_lock);
+	wake_irqs = ACCESS_ONCE(ps_stml0xx->wake_irq_count);
+
+	secs_x100 = max(jiffies_to_msecs(now - ps_stml0xx->stats_jiffies) / 10,
+			1U);
+	irq_rate = (irqs - ps_stml0xx->stats_irq_count) * 100 / secs_x100;
+	wake_irq_rate = (wake_irqs - ps_stml0xx->stats_wake_irq_count) * 100 /
+			secs_x100;
+
+	ps_stml0xx->stats_irq_count = irqs;
+	ps_stml0xx->stats_wake_irq_count = wake_irqs;
+	ps_stml0xx->stats_jiffies = now;
+
+	return scnprintf(buf, PAGE_SIZE,
+			 "irq: %u (%u/s, %u coalesced)\nwake_irq: %u (%u/s)\n",
+			 irqs, irq_rate, coalesced, wake_irqs, wake_irq_rate);
+}
+
+DEVICE_ATTR(wakeups, S_IRUGO, stml0xx_wakeups_show, NULL);
@@ -69,26 +69,41 @@ int stml0xx_spi_sensorhub_ack(void)
 	return gpio_get_value(stml0xx_misc_data->pdata->gpio_spi_data_ack);
 }
 
-/* Transfer data over SPI */
+/*
+ * Transfer data over SPI
+ *
+ * Most callers pass buffers on their stack, which the SPI controller
+ * cannot DMA to or from, so every transfer moves through the coherent
+ * spi_tx_buf/spi_rx_buf instead and the controller does not fall back
+ * to PIO. Those are mapped once at probe, so the message is handed over
+ * already mapped and the controller skips its per-transfer mapping.
+ */
 int stml0xx_spi_transfer(unsigned char *tx_buf, unsigned char *rx_buf, int len)
 {
+	unsigned char *dma_tx_buf = stml0xx_misc_data->spi_tx_buf;
+	unsigned char *dma_rx_buf = stml0xx_misc_data->spi_rx_buf;
 	struct spi_message msg;
 	struct spi_transfer transfer;
 	int rc;
 
-	if ((!tx_buf && !rx_buf) || len == 0)
+	if ((!tx_buf && !rx_buf) || len == 0 || len > SPI_BUFF_SIZE)
 		return -EFAULT;
 
 	mutex_lock(&stml0xx_misc_data->spi_lock);
 
 	if (!rx_buf)
-		rx_buf = stml0xx_misc_data->spi_rx_buf;
+		rx_buf = dma_rx_buf;
 
-	memset(rx_buf, 0, len);
+	if (tx_buf && tx_buf != dma_tx_buf)
+		memcpy(dma_tx_buf, tx_buf, len);
+	memset(dma_rx_buf, 0, len);
 	memset(&transfer, 0, sizeof(transfer));
 	spi_message_init(&msg);
-	transfer.tx_buf = tx_buf;
-	transfer.rx_buf = rx_buf;
+	transfer.tx_buf = tx_buf ? dma_tx_buf : NULL;
+	transfer.rx_buf = dma_rx_buf;
+	transfer.tx_dma = stml0xx_misc_data->spi_tx_dma;
+	transfer.rx_dma = stml0xx_misc_data->spi_rx_dma;
+	msg.is_dma_mapped = 1;
 	transfer.len = len;
 	transfer.bits_per_word = 8;
 	transfer.delay_usecs = 0;
@@ -136,11 +151,11 @@ int stml0xx_spi_transfer(unsigned char *tx_buf, unsigned char *rx_buf, int len)
 			if (tx_buf) {
 				dev_dbg(&stml0xx_misc_data->spi->dev,
 					"SPI Write 0x%02x, Read 0x%02x",
-					tx_buf[i], rx_buf[i]);
+					tx_buf[i], dma_rx_buf[i]);
 			} else {
 				dev_dbg(&stml0xx_misc_data->spi->dev,
 					"SPI ----------, Read 0x%02x",
-					rx_buf[i]);
+					dma_rx_buf[i]);
 			}
 		}
 #endif
@@ -148,6 +163,8 @@ int stml0xx_spi_transfer(unsigned char *tx_buf, unsigned char *rx_buf, int len)
 		goto EXIT;
 	}
 EXIT:
+	if (rx_buf != dma_rx_buf)
+		memcpy(rx_buf, dma_rx_buf, len);
 	mutex_unlock(&stml0xx_misc_data->spi_lock);
 	return rc;
 }
@@ -65,6 +65,7 @@ irqreturn_t stml0xx_wake_isr(int irq, void *dev)
 	if (stml0xx_irq_disable)
 		return IRQ_HANDLED;
 
+	ps_stml0xx->wake_irq_count++;
 	wake_lock_timeout(&ps_stml0xx->wake_sensor_wakelock, HZ);
 	stm_ws = kmalloc(
 		sizeof(struct stml0xx_delayed_work_struct),
@@ -136,6 +136,9 @@ struct mmc_blk_data {
 	struct device_attribute num_wr_reqs_to_start_packing;
 	struct device_attribute bkops_check_threshold;
 	struct device_attribute no_pack_for_random;
+	struct device_attribute pack_read_delay_us;
+	struct device_attribute discard_idle_ms;
+	struct device_attribute discard_max_ranges;
 	struct device_attribute total_requests;
 	struct device_attribute total_request_errors;
 	struct device_attribute current_health;
@@ -495,6 +498,126 @@ exit:
 	return ret;
 }
 
+static ssize_t
+pack_read_delay_us_show(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret;
+
+	if (!md)
+		return -EINVAL;
+	ret = snprintf(buf, PAGE_SIZE, "%u\n", md->queue.pack_read_delay_us);
+
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t
+pack_read_delay_us_store(struct device *dev,
+			 struct device_attribute *attr,
+			 const char *buf, size_t count)
+{
+	unsigned int value;
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret = count;
+
+	if (!md)
+		return -EINVAL;
+
+	if (kstrtouint(buf, 0, &value)) {
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	/* 0 turns adaptive packing off, the trigger alone decides */
+	md->queue.pack_read_delay_us = value;
+
+exit:
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t
+discard_idle_ms_show(struct device *dev,
+		     struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret;
+
+	if (!md)
+		return -EINVAL;
+	ret = snprintf(buf, PAGE_SIZE, "%u\n", md->queue.discard_idle_ms);
+
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t
+discard_idle_ms_store(struct device *dev,
+		      struct device_attribute *attr,
+		      const char *buf, size_t count)
+{
+	unsigned int value;
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret = count;
+
+	if (!md)
+		return -EINVAL;
+
+	if (kstrtouint(buf, 0, &value)) {
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	/* 0 issues discards as they come; pending ones go out when idle */
+	md->queue.discard_idle_ms = value;
+	wake_up_process(md->queue.thread);
+
+exit:
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t
+discard_max_ranges_show(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret;
+
+	if (!md)
+		return -EINVAL;
+	ret = snprintf(buf, PAGE_SIZE, "%u\n", md->queue.discard_max_ranges);
+
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t
+discard_max_ranges_store(struct device *dev,
+			 struct device_attribute *attr,
+			 const char *buf, size_t count)
+{
+	unsigned int value;
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret = count;
+
+	if (!md)
+		return -EINVAL;
+
+	if (kstrtouint(buf, 0, &value) || !value) {
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	md->queue.discard_max_ranges = value;
+
+exit:
+	mmc_blk_put(md);
+	return ret;
+}
+
 static ssize_t
 current_health_show(struct device *dev, struct device_attribute *attr,
 		    char *buf)
@@ -1492,11 +1615,12 @@ static int mmc_blk_throttle_back(struct mmc_blk_data *md, struct mmc_host *host)
 	return err;
 }
 
-static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
+static int mmc_blk_do_discard(struct mmc_queue *mq, unsigned int from,
+			      unsigned int nr)
 {
 	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
-	unsigned int from, nr, arg;
+	unsigned int arg;
 	int err = 0, type = MMC_BLK_DISCARD;
 
 	if (!mmc_can_erase(card)) {
@@ -1504,11 +1628,8 @@ static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
 		goto out;
 	}
 
-	from = blk_rq_pos(req);
-	nr = blk_rq_sectors(req);
-
 	if (card->ext_csd.bkops_en)
-		card->bkops_info.sectors_changed += blk_rq_sectors(req);
+		card->bkops_info.sectors_changed += nr;
 
 	if (mmc_can_discard(card))
 		arg = MMC_DISCARD_ARG;
@@ -1533,11 +1654,121 @@ out:
 		goto retry;
 	if (!err)
 		mmc_blk_reset_success(md, card->host, type);
+
+	return err;
+}
+
+static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
+{
+	int err;
+
+	err = mmc_blk_do_discard(mq, blk_rq_pos(req), blk_rq_sectors(req));
 	blk_end_request(req, err, blk_rq_bytes(req));
 
 	return err ? 0 : 1;
 }
 
+/*
+ * Deferred discard.  Online discard from the filesystem sends a stream of
+ * small discards and each one stalls the queue on eMMC.  Instead they are
+ * completed right away and collected in mq->discard_root, merged, and
+ * issued in large chunks once the queue has been idle for
+ * discard_idle_ms, when the screen goes off, when discard_max_ranges is
+ * reached, before a sanitize and on shutdown.  Writes punch holes into
+ * the pending ranges.  Not done when the queue promises zeroed data
+ * after discard.
+ */
+static void mmc_blk_flush_discards(struct mmc_queue *mq, bool idle)
+{
+	struct request_queue *q = mq->queue;
+	unsigned int max = q->limits.max_discard_sectors ? : UINT_MAX;
+	struct mmc_discard_range *range;
+	struct rb_node *n;
+	unsigned int nr;
+	bool busy;
+	int err;
+
+	while ((n = rb_first(&mq->discard_root))) {
+		if (idle) {
+			spin_lock_irq(q->queue_lock);
+			busy = blk_peek_request(q) != NULL;
+			spin_unlock_irq(q->queue_lock);
+			if (busy)
+				break;
+		}
+
+		range = rb_entry(n, struct mmc_discard_range, node);
+		nr = min_t(sector_t, range->end - range->start, max);
+		err = mmc_blk_do_discard(mq, range->start, nr);
+		if (err) {
+			pr_debug("%s: deferred discard of %u sectors at %llu failed %d\n",
+				 mmc_hostname(mq->card->host), nr,
+				 (unsigned long long)range->start, err);
+			/* advisory anyway, don't retry forever */
+			range->start = range->end;
+		} else {
+			range->start += nr;
+		}
+
+		if (range->start >= range->end) {
+			rb_erase(n, &mq->discard_root);
+			kfree(range);
+			mq->nr_discard_ranges--;
+		}
+	}
+}
+
+static void mmc_blk_issue_deferred_discards(struct mmc_queue *mq, bool idle)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+
+	mmc_rpm_hold(card->host, &card->dev);
+	mmc_claim_host(card->host);
+	if (card->ext_csd.bkops_en)
+		mmc_stop_bkops(card);
+
+	if (!mmc_blk_part_switch(card, md))
+		mmc_blk_flush_discards(mq, idle);
+	else
+		mmc_queue_discard_free(mq);
+
+	mmc_release_host(card->host);
+	mmc_rpm_release(card->host, &card->dev);
+}
+
+static void mmc_blk_discard_idle(struct mmc_queue *mq)
+{
+	mmc_blk_issue_deferred_discards(mq, true);
+}
+
+static bool mmc_blk_defer_discard(struct mmc_queue *mq, struct request *req)
+{
+	sector_t start = blk_rq_pos(req);
+
+	if (!mq->discard_idle_ms || mq->queue->limits.discard_zeroes_data ||
+	    !mmc_can_erase(mq->card))
+		return false;
+
+	if (mmc_queue_discard_add(mq, start, start + blk_rq_sectors(req)))
+		return false;
+
+	blk_end_request(req, 0, blk_rq_bytes(req));
+
+	if (mq->nr_discard_ranges >= mq->discard_max_ranges)
+		mmc_blk_flush_discards(mq, false);
+
+	return true;
+}
+
+static inline void mmc_blk_discard_written(struct mmc_queue *mq,
+					   struct request *req)
+{
+	if (mq->nr_discard_ranges && rq_data_dir(req) == WRITE)
+		mmc_queue_discard_remove(mq, blk_rq_pos(req),
+					 blk_rq_pos(req) + blk_rq_sectors(req));
+}
+
 static int mmc_blk_issue_secdiscard_rq(struct mmc_queue *mq,
 				       struct request *req)
 {
@@ -2284,6 +2515,128 @@ static int get_packed_trigger(int potential, struct mmc_card *card,
 	return trigger;
 }
 
+/*
+ * Adaptive packing.  The time a packed write keeps the card busy is
+ * estimated from the measured service time per sector.  While reads have
+ * been seen recently the packed size is capped so that a read queued
+ * behind it waits at most pack_read_delay_us; with no reads around,
+ * packing starts without waiting for the trigger.
+ */
+#define PACK_READ_WINDOW_MS	100
+#define PACK_EAGER_MIN_REQS	2
+#define PACK_MIN_CAP_SECTORS	8
+#define PACK_EWMA_SHIFT		3
+
+static bool mmc_blk_pack_reads_recent(struct mmc_queue *mq)
+{
+	return mq->card->host->context_info.is_urgent ||
+		time_before(jiffies, mq->last_read_jiffies +
+			    msecs_to_jiffies(PACK_READ_WINDOW_MS));
+}
+
+static unsigned int mmc_blk_pack_sector_cap(struct mmc_queue *mq)
+{
+	unsigned int cap;
+
+	if (!mq->pack_read_delay_us || !mq->pack_ns_per_sect ||
+	    !mmc_blk_pack_reads_recent(mq))
+		return UINT_MAX;
+
+	cap = div_u64((u64)mq->pack_read_delay_us * NSEC_PER_USEC,
+		      mq->pack_ns_per_sect);
+	return max_t(unsigned int, cap, PACK_MIN_CAP_SECTORS);
+}
+
+static void mmc_blk_pack_note_read_wait(struct mmc_queue *mq)
+{
+	struct mmc_context_info *cntx = &mq->card->host->context_info;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cntx->lock, flags);
+	if (!ktime_to_ns(mq->read_wait_start))
+		mq->read_wait_start = ktime_get();
+	spin_unlock_irqrestore(&cntx->lock, flags);
+}
+
+static inline int mmc_blk_hist_bucket(u64 val)
+{
+	if (val < 2)
+		return 0;
+	return min_t(int, ilog2(val), MMC_PACK_HIST_BUCKETS - 1);
+}
+
+#ifdef CONFIG_BLK_LATENCY_HIST
+/* Hand when the command went out and the data was done to the block layer */
+static void mmc_blk_lat_driver_times(struct mmc_queue_req *mq_rq)
+{
+	struct mmc_request *mrq = &mq_rq->brq.mrq;
+	struct request *prq;
+
+	if (mq_rq->packed_cmd == MMC_PACKED_NONE) {
+		blk_rq_lat_driver_times(mq_rq->req, mrq->cmd_time,
+					mrq->data_time);
+		return;
+	}
+
+	list_for_each_entry(prq, &mq_rq->packed_list, queuelist)
+		blk_rq_lat_driver_times(prq, mrq->cmd_time, mrq->data_time);
+}
+#else
+static inline void mmc_blk_lat_driver_times(struct mmc_queue_req *mq_rq) {}
+#endif
+
+static void mmc_blk_pack_account(struct mmc_queue *mq,
+				 struct mmc_queue_req *mq_rq,
+				 enum mmc_blk_status status)
+{
+	struct mmc_wr_pack_stats *stats = &mq->card->wr_pack_stats;
+	struct mmc_context_info *cntx = &mq->card->host->context_info;
+	ktime_t now = ktime_get();
+	ktime_t start = mq_rq->issue_time;
+	ktime_t wait;
+	unsigned long flags;
+	u64 ns;
+
+	/*
+	 * With two requests in flight the card only gets to this one once
+	 * the previous one is done.
+	 */
+	if (ktime_to_ns(ktime_sub(mq->last_done, start)) > 0)
+		start = mq->last_done;
+	mq->last_done = now;
+
+	if (mq_rq->packed_cmd == MMC_PACKED_NONE)
+		return;
+
+	spin_lock_irqsave(&cntx->lock, flags);
+	wait = mq->read_wait_start;
+	mq->read_wait_start = ktime_set(0, 0);
+	spin_unlock_irqrestore(&cntx->lock, flags);
+
+	if (status == MMC_BLK_SUCCESS && mq_rq->packed_blocks) {
+		ns = div_u64(ktime_to_ns(ktime_sub(now, start)),
+			     mq_rq->packed_blocks);
+		ns = min_t(u64, ns, UINT_MAX);
+		if (!mq->pack_ns_per_sect)
+			mq->pack_ns_per_sect = ns;
+		else
+			mq->pack_ns_per_sect =
+				((u64)mq->pack_ns_per_sect *
+				 ((1 << PACK_EWMA_SHIFT) - 1) + ns) >>
+				PACK_EWMA_SHIFT;
+	}
+
+	spin_lock(&stats->lock);
+	if (stats->enabled) {
+		stats->pack_sectors_hist[
+			mmc_blk_hist_bucket(mq_rq->packed_blocks)]++;
+		if (ktime_to_ns(wait))
+			stats->read_delay_hist[mmc_blk_hist_bucket(
+				ktime_to_us(ktime_sub(now, wait)))]++;
+	}
+	spin_unlock(&stats->lock);
+}
+
 static void mmc_blk_write_packing_control(struct mmc_queue *mq,
 					  struct request *req)
 {
@@ -2302,6 +2655,13 @@ static void mmc_blk_write_packing_control(struct mmc_queue *mq,
 	 * not have an effect on the write packing. Therefore we have to enable
 	 * the write packing
 	 */
+	if (req && rq_data_dir(req) == READ) {
+		mq->last_read_jiffies = jiffies;
+		if (mq->mqrq_prev->req &&
+		    mq->mqrq_prev->packed_cmd != MMC_PACKED_NONE)
+			mmc_blk_pack_note_read_wait(mq);
+	}
+
 	if (!(host->caps2 & MMC_CAP2_PACKED_WR_CONTROL)) {
 		mq->wr_packing_enabled = true;
 		return;
@@ -2338,6 +2698,10 @@ static void mmc_blk_write_packing_control(struct mmc_queue *mq,
 			mq->num_wr_reqs_to_start_packing)
 		mq->wr_packing_enabled = true;
 
+	/* nobody to hurt: don't wait for the trigger */
+	if (mq->pack_read_delay_us && !mmc_blk_pack_reads_recent(mq) &&
+	    mq->num_of_potential_packed_wr_reqs >= PACK_EAGER_MIN_REQS)
+		mq->wr_packing_enabled = true;
 }
 
 struct mmc_wr_pack_stats *mmc_blk_get_packed_statistics(struct mmc_card *card)
@@ -2364,6 +2728,10 @@ void mmc_blk_init_packed_statistics(struct mmc_card *card)
 	       sizeof(*card->wr_pack_stats.packing_events));
 	memset(&card->wr_pack_stats.pack_stop_reason, 0,
 		sizeof(card->wr_pack_stats.pack_stop_reason));
+	memset(&card->wr_pack_stats.pack_sectors_hist, 0,
+		sizeof(card->wr_pack_stats.pack_sectors_hist));
+	memset(&card->wr_pack_stats.read_delay_hist, 0,
+		sizeof(card->wr_pack_stats.read_delay_hist));
 	card->wr_pack_stats.enabled = true;
 	spin_unlock(&card->wr_pack_stats.lock);
 }
@@ -2377,13 +2745,14 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 	struct mmc_blk_data *md = mq->data;
 	bool en_rel_wr = card->ext_csd.rel_param & EXT_CSD_WR_REL_PARAM_EN;
 	unsigned int req_sectors = 0, phys_segments = 0;
-	unsigned int max_blk_count, max_phys_segs;
+	unsigned int max_blk_count, max_phys_segs, lat_cap;
 	u8 put_back = 0;
 	u8 max_packed_rw = 0;
 	u8 reqs = 0;
 	struct mmc_wr_pack_stats *stats = &card->wr_pack_stats;
 
 	mmc_blk_clear_packed(mq->mqrq_cur);
+	mmc_blk_discard_written(mq, cur);
 
 	if (!(md->flags & MMC_BLK_CMD23) ||
 			!card->ext_csd.packed_event_en)
@@ -2416,6 +2785,8 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 	if (unlikely(max_blk_count > 0xffff))
 		max_blk_count = 0xffff;
 
+	lat_cap = mmc_blk_pack_sector_cap(mq);
+
 	max_phys_segs = queue_max_segments(q);
 	req_sectors += blk_rq_sectors(cur);
 	phys_segments += cur->nr_phys_segments;
@@ -2478,6 +2849,12 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 			break;
 		}
 
+		if (req_sectors > lat_cap) {
+			MMC_BLK_UPDATE_STOP_REASON(stats, READ_LATENCY);
+			put_back = 1;
+			break;
+		}
+
 		phys_segments +=  next->nr_phys_segments;
 		if (phys_segments > max_phys_segs) {
 			MMC_BLK_UPDATE_STOP_REASON(stats, EXCEEDS_SEGMENTS);
@@ -2500,6 +2877,7 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 				card->bkops_info.sectors_changed +=
 					blk_rq_sectors(next);
 		}
+		mmc_blk_discard_written(mq, next);
 		list_add_tail(&next->queuelist, &mq->mqrq_cur->packed_list);
 		cur = next;
 		reqs++;
@@ -2752,6 +3130,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 			else
 				mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
 			areq = &mq->mqrq_cur->mmc_active;
+			mq->mqrq_cur->issue_time = ktime_get();
 		} else
 			areq = NULL;
 		areq = mmc_start_req(card->host, areq, (int *) &status);
@@ -2766,6 +3145,8 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		req = mq_rq->req;
 		type = rq_data_dir(req) == READ ? MMC_BLK_READ : MMC_BLK_WRITE;
 		mmc_queue_bounce_post(mq_rq);
+		mmc_blk_pack_account(mq, mq_rq, status);
+		mmc_blk_lat_driver_times(mq_rq);
 
 		switch (status) {
 		case MMC_BLK_URGENT:
@@ -2986,6 +3367,7 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		/* complete ongoing async transfer before issuing sanitize */
 		if (card->host && card->host->areq)
 			mmc_blk_issue_rw_rq(mq, NULL);
+		mmc_blk_flush_discards(mq, false);
 		ret = mmc_blk_issue_sanitize_rq(mq, req);
 	} else if (cmd_flags & REQ_DISCARD) {
 		/* complete ongoing async transfer before issuing discard */
@@ -2994,6 +3376,8 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		if (cmd_flags & REQ_SECURE &&
 			!(card->quirks & MMC_QUIRK_SEC_ERASE_TRIM_BROKEN))
 			ret = mmc_blk_issue_secdiscard_rq(mq, req);
+		else if (mmc_blk_defer_discard(mq, req))
+			ret = 1;
 		else
 			ret = mmc_blk_issue_discard_rq(mq, req);
 	} else if (cmd_flags & REQ_FLUSH) {
@@ -3096,6 +3480,7 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 		goto err_putdisk;
 
 	md->queue.issue_fn = mmc_blk_issue_rq;
+	md->queue.discard_idle_fn = mmc_blk_discard_idle;
 	md->queue.data = md;
 
 	md->disk->major	= MMC_BLOCK_MAJOR;
@@ -3346,6 +3731,36 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	if (ret)
 		goto no_pack_for_random_fails;
 
+	md->pack_read_delay_us.show = pack_read_delay_us_show;
+	md->pack_read_delay_us.store = pack_read_delay_us_store;
+	sysfs_attr_init(&md->pack_read_delay_us.attr);
+	md->pack_read_delay_us.attr.name = "pack_read_delay_us";
+	md->pack_read_delay_us.attr.mode = S_IRUGO | S_IWUSR;
+	ret = device_create_file(disk_to_dev(md->disk),
+				 &md->pack_read_delay_us);
+	if (ret)
+		goto pack_read_delay_us_fails;
+
+	md->discard_idle_ms.show = discard_idle_ms_show;
+	md->discard_idle_ms.store = discard_idle_ms_store;
+	sysfs_attr_init(&md->discard_idle_ms.attr);
+	md->discard_idle_ms.attr.name = "discard_idle_ms";
+	md->discard_idle_ms.attr.mode = S_IRUGO | S_IWUSR;
+	ret = device_create_file(disk_to_dev(md->disk),
+				 &md->discard_idle_ms);
+	if (ret)
+		goto discard_idle_ms_fails;
+
+	md->discard_max_ranges.show = discard_max_ranges_show;
+	md->discard_max_ranges.store = discard_max_ranges_store;
+	sysfs_attr_init(&md->discard_max_ranges.attr);
+	md->discard_max_ranges.attr.name = "discard_max_ranges";
+	md->discard_max_ranges.attr.mode = S_IRUGO | S_IWUSR;
+	ret = device_create_file(disk_to_dev(md->disk),
+				 &md->discard_max_ranges);
+	if (ret)
+		goto discard_max_ranges_fails;
+
 	md->current_health.show = current_health_show;
 	sysfs_attr_init(&md->current_health.attr);
 	md->current_health.attr.name = "current_health";
@@ -3384,6 +3799,15 @@ failure_ratio_fails:
 	device_remove_file(disk_to_dev(md->disk),
 			   &md->current_health);
 current_health_fails:
+	device_remove_file(disk_to_dev(md->disk),
+			   &md->discard_max_ranges);
+discard_max_ranges_fails:
+	device_remove_file(disk_to_dev(md->disk),
+			   &md->discard_idle_ms);
+discard_idle_ms_fails:
+	device_remove_file(disk_to_dev(md->disk),
+			   &md->pack_read_delay_us);
+pack_read_delay_us_fails:
 	device_remove_file(disk_to_dev(md->disk),
 			   &md->no_pack_for_random);
 no_pack_for_random_fails:
@@ -3561,6 +3985,14 @@ static void mmc_blk_shutdown(struct mmc_card *card)
 			if (rc)
 				goto suspend_error;
 		}
+
+		/* queue threads are parked now, issue what they deferred */
+		if (md->queue.nr_discard_ranges)
+			mmc_blk_issue_deferred_discards(&md->queue, false);
+		list_for_each_entry(part_md, &md->part, part)
+			if (part_md->queue.nr_discard_ranges)
+				mmc_blk_issue_deferred_discards(
+					&part_md->queue, false);
 	}
 
 	/* send power off notification */
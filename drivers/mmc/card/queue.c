@@ -32,6 +32,9 @@
  * manage to keep the high write throughput.
  */
 #define DEFAULT_NUM_REQS_TO_START_PACK 17
+#define DEFAULT_PACK_READ_DELAY_US 5000
+#define DEFAULT_DISCARD_IDLE_MS 1000
+#define DEFAULT_DISCARD_MAX_RANGES 1024
 
 /*
  * Prepare a MMC request. This just filters out odd stuff.
@@ -56,6 +59,20 @@ static int mmc_prep_request(struct request_queue *q, struct request *req)
 	return BLKPREP_OK;
 }
 
+/*
+ * Deferred discards are flushed once the queue has been idle for
+ * discard_idle_ms, or right away when the screen goes off.
+ */
+static bool mmc_queue_discard_due(struct mmc_queue *mq)
+{
+	if (!mq->nr_discard_ranges || !mq->discard_idle_fn)
+		return false;
+	if (test_and_clear_bit(MMC_QUEUE_DISCARD_FLUSH, &mq->flags))
+		return true;
+	return time_after_eq(jiffies, mq->last_busy +
+			     msecs_to_jiffies(mq->discard_idle_ms));
+}
+
 static int mmc_queue_thread(void *d)
 {
 	struct mmc_queue *mq = d;
@@ -82,6 +99,7 @@ static int mmc_queue_thread(void *d)
 
 		if (req || mq->mqrq_prev->req) {
 			set_current_state(TASK_RUNNING);
+			mq->last_busy = jiffies;
 			mq->issue_fn(mq, req);
 			if (test_bit(MMC_QUEUE_NEW_REQUEST, &mq->flags)) {
 				continue; /* fetch again */
@@ -113,10 +131,19 @@ static int mmc_queue_thread(void *d)
 				set_current_state(TASK_RUNNING);
 				break;
 			}
+			if (mmc_queue_discard_due(mq)) {
+				set_current_state(TASK_RUNNING);
+				mq->discard_idle_fn(mq);
+				continue;
+			}
 			mmc_start_delayed_bkops(card);
 			mq->card->host->context_info.is_urgent = false;
 			up(&mq->thread_sem);
-			schedule();
+			if (mq->nr_discard_ranges)
+				schedule_timeout(
+					msecs_to_jiffies(mq->discard_idle_ms));
+			else
+				schedule();
 			down(&mq->thread_sem);
 		}
 	} while (1);
@@ -195,6 +222,12 @@ static void mmc_urgent_request(struct request_queue *q)
 		 * so disable the write packing
 		 */
 		mmc_blk_disable_wr_packing(mq);
+		if (!ktime_to_ns(mq->read_wait_start) &&
+		    ((mq->mqrq_cur->req &&
+		      mq->mqrq_cur->packed_cmd != MMC_PACKED_NONE) ||
+		     (mq->mqrq_prev->req &&
+		      mq->mqrq_prev->packed_cmd != MMC_PACKED_NONE)))
+			mq->read_wait_start = ktime_get();
 		cntx->is_urgent = true;
 		spin_unlock_irqrestore(&cntx->lock, flags);
 		wake_up_interruptible(&cntx->wait);
@@ -240,6 +273,155 @@ static void mmc_queue_setup_discard(struct request_queue *q,
 		queue_flag_set_unlocked(QUEUE_FLAG_SECDISCARD, q);
 }
 
+/*
+ * The deferred discard tree holds disjoint ranges sorted by start.
+ * Touching or overlapping ranges are merged on insert.
+ */
+int mmc_queue_discard_add(struct mmc_queue *mq, sector_t start, sector_t end)
+{
+	struct rb_node **p = &mq->discard_root.rb_node, *parent = NULL;
+	struct rb_node *n;
+	struct mmc_discard_range *range, *new;
+
+	new = kmalloc(sizeof(*new), GFP_NOIO);
+	if (!new)
+		return -ENOMEM;
+
+	/* find the first range that ends at or after start */
+	n = mq->discard_root.rb_node;
+	range = NULL;
+	while (n) {
+		struct mmc_discard_range *r =
+			rb_entry(n, struct mmc_discard_range, node);
+
+		if (r->end >= start) {
+			range = r;
+			n = n->rb_left;
+		} else {
+			n = n->rb_right;
+		}
+	}
+
+	/* swallow everything it touches */
+	while (range && range->start <= end) {
+		n = rb_next(&range->node);
+		start = min(start, range->start);
+		end = max(end, range->end);
+		rb_erase(&range->node, &mq->discard_root);
+		kfree(range);
+		mq->nr_discard_ranges--;
+		range = n ? rb_entry(n, struct mmc_discard_range, node) : NULL;
+	}
+
+	new->start = start;
+	new->end = end;
+	while (*p) {
+		parent = *p;
+		range = rb_entry(parent, struct mmc_discard_range, node);
+		if (start < range->start)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&new->node, parent, p);
+	rb_insert_color(&new->node, &mq->discard_root);
+	mq->nr_discard_ranges++;
+
+	return 0;
+}
+EXPORT_SYMBOL(mmc_queue_discard_add);
+
+/*
+ * Called for every write so a deferred discard never lands on data
+ * written after it.
+ */
+void mmc_queue_discard_remove(struct mmc_queue *mq, sector_t start,
+			      sector_t end)
+{
+	struct rb_node *n = mq->discard_root.rb_node;
+	struct mmc_discard_range *range = NULL, *tail;
+
+	while (n) {
+		struct mmc_discard_range *r =
+			rb_entry(n, struct mmc_discard_range, node);
+
+		if (r->end > start) {
+			range = r;
+			n = n->rb_left;
+		} else {
+			n = n->rb_right;
+		}
+	}
+
+	while (range && range->start < end) {
+		n = rb_next(&range->node);
+
+		if (range->start >= start && range->end <= end) {
+			rb_erase(&range->node, &mq->discard_root);
+			kfree(range);
+			mq->nr_discard_ranges--;
+		} else if (range->start < start && range->end > end) {
+			/*
+			 * Split.  If that fails the tail is simply not
+			 * discarded, which is always safe.
+			 */
+			tail = kmalloc(sizeof(*tail), GFP_NOIO);
+			if (tail) {
+				tail->start = end;
+				tail->end = range->end;
+			}
+			range->end = start;
+			if (tail) {
+				struct rb_node **p = &range->node.rb_right;
+				struct rb_node *parent = &range->node;
+
+				while (*p) {
+					parent = *p;
+					p = &parent->rb_left;
+				}
+				rb_link_node(&tail->node, parent, p);
+				rb_insert_color(&tail->node,
+						&mq->discard_root);
+				mq->nr_discard_ranges++;
+			}
+			break;
+		} else if (range->start < start) {
+			range->end = start;
+		} else {
+			range->start = end;
+		}
+
+		range = n ? rb_entry(n, struct mmc_discard_range, node) : NULL;
+	}
+}
+EXPORT_SYMBOL(mmc_queue_discard_remove);
+
+void mmc_queue_discard_free(struct mmc_queue *mq)
+{
+	struct rb_node *n;
+
+	while ((n = rb_first(&mq->discard_root))) {
+		rb_erase(n, &mq->discard_root);
+		kfree(rb_entry(n, struct mmc_discard_range, node));
+	}
+	mq->nr_discard_ranges = 0;
+}
+EXPORT_SYMBOL(mmc_queue_discard_free);
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void mmc_queue_discard_early_suspend(struct early_suspend *h)
+{
+	struct mmc_queue *mq = container_of(h, struct mmc_queue,
+					    discard_early_suspend);
+
+	if (!mq->nr_discard_ranges)
+		return;
+
+	set_bit(MMC_QUEUE_DISCARD_FLUSH, &mq->flags);
+	wake_up_process(mq->thread);
+}
+#endif
+
 static void mmc_queue_setup_sanitize(struct request_queue *q)
 {
 	queue_flag_set_unlocked(QUEUE_FLAG_SANITIZE, q);
@@ -288,6 +470,10 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	mq->num_wr_reqs_to_start_packing =
 		min_t(int, (int)card->ext_csd.max_packed_writes,
 		     DEFAULT_NUM_REQS_TO_START_PACK);
+	mq->pack_read_delay_us = DEFAULT_PACK_READ_DELAY_US;
+	mq->discard_root = RB_ROOT;
+	mq->discard_idle_ms = DEFAULT_DISCARD_IDLE_MS;
+	mq->discard_max_ranges = DEFAULT_DISCARD_MAX_RANGES;
 
 	mq->queue->backing_dev_info.ra_pages = (256 * 1024) / PAGE_CACHE_SIZE;
 
@@ -406,6 +592,12 @@ success:
 		goto free_bounce_sg;
 	}
 
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	mq->discard_early_suspend.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN;
+	mq->discard_early_suspend.suspend = mmc_queue_discard_early_suspend;
+	register_early_suspend(&mq->discard_early_suspend);
+#endif
+
 	return 0;
  free_bounce_sg:
 	kfree(mqrq_cur->bounce_sg);
@@ -435,12 +627,19 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	struct mmc_queue_req *mqrq_cur = mq->mqrq_cur;
 	struct mmc_queue_req *mqrq_prev = mq->mqrq_prev;
 
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	unregister_early_suspend(&mq->discard_early_suspend);
+#endif
+
 	/* Make sure the queue isn't suspended, as that will deadlock */
 	mmc_queue_resume(mq);
 
 	/* Then terminate our worker thread */
 	kthread_stop(mq->thread);
 
+	/* whatever was not flushed on shutdown is dropped */
+	mmc_queue_discard_free(mq);
+
 	/* Empty the queue */
 	spin_lock_irqsave(q->queue_lock, flags);
 	q->queuedata = NULL;
@@ -1,6 +1,11 @@
 #ifndef MMC_QUEUE_H
 #define MMC_QUEUE_H
 
+#include <linux/rbtree.h>
+#ifdef CONFIG_HAS_EARLYSUSPEND
+#include <linux/earlysuspend.h>
+#endif
+
 struct request;
 struct task_struct;
 
@@ -32,6 +37,7 @@ struct mmc_queue_req {
 	int		packed_retries;
 	int		packed_fail_idx;
 	u8		packed_num;
+	ktime_t		issue_time;
 };
 
 struct mmc_queue {
@@ -42,6 +48,7 @@ struct mmc_queue {
 #define MMC_QUEUE_SUSPENDED		0
 #define MMC_QUEUE_NEW_REQUEST		1
 #define MMC_QUEUE_URGENT_REQUEST	2
+#define MMC_QUEUE_DISCARD_FLUSH		3
 
 	int			(*issue_fn)(struct mmc_queue *, struct request *);
 	void			*data;
@@ -53,6 +60,22 @@ struct mmc_queue {
 	int			num_of_potential_packed_wr_reqs;
 	int			num_wr_reqs_to_start_packing;
 	bool			no_pack_for_random;
+	/* adaptive packing, see mmc_blk_pack_adapt() */
+	unsigned int		pack_read_delay_us; /* 0 disables */
+	unsigned int		pack_ns_per_sect;   /* EWMA, 0 until measured */
+	unsigned long		last_read_jiffies;
+	ktime_t			last_done;
+	ktime_t			read_wait_start;    /* under context_info.lock */
+	/* deferred discard, only touched by the queue thread */
+	struct rb_root		discard_root;
+	unsigned int		nr_discard_ranges;
+	unsigned int		discard_idle_ms;    /* 0 disables */
+	unsigned int		discard_max_ranges;
+	unsigned long		last_busy;
+	void (*discard_idle_fn) (struct mmc_queue *);
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	struct early_suspend	discard_early_suspend;
+#endif
 	int (*err_check_fn) (struct mmc_card *, struct mmc_async_req *);
 	void (*packed_test_fn) (struct request_queue *, struct mmc_queue_req *);
 };
@@ -70,4 +93,15 @@ extern void mmc_queue_bounce_post(struct mmc_queue_req *);
 
 extern void print_mmc_packing_stats(struct mmc_card *card);
 
+/* a deferred discard, [start, end) in sectors */
+struct mmc_discard_range {
+	struct rb_node		node;
+	sector_t		start;
+	sector_t		end;
+};
+
+extern int mmc_queue_discard_add(struct mmc_queue *, sector_t, sector_t);
+extern void mmc_queue_discard_remove(struct mmc_queue *, sector_t, sector_t);
+extern void mmc_queue_discard_free(struct mmc_queue *);
+
 #endif
@@ -253,6 +253,9 @@ void mmc_request_done(struct mmc_host *host, struct mmc_request *mrq)
 			cmd->resp[2], cmd->resp[3]);
 
 		if (mrq->data) {
+#ifdef CONFIG_BLK_LATENCY_HIST
+			mrq->data_time = ktime_get();
+#endif
 #ifdef CONFIG_MMC_PERF_PROFILING
 			if (host->perf_enable) {
 				diff = ktime_sub(ktime_get(), host->perf.start);
@@ -377,6 +380,9 @@ mmc_start_request(struct mmc_host *host, struct mmc_request *mrq)
 	if (host->card)
 		host->requests++;
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+	mrq->cmd_time = ktime_get();
+#endif
 	host->ops->request(host, mrq);
 }
 
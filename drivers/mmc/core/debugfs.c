@@ -659,6 +659,26 @@ static int mmc_wr_pack_stats_open(struct inode *inode, struct file *filp)
 }
 
 #define TEMP_BUF_SIZE 256
+static void mmc_wr_pack_hist_print(struct mmc_card *card, const char *name,
+				   u32 *hist, char __user *ubuf, size_t cnt,
+				   char *temp_buf)
+{
+	int i;
+
+	snprintf(temp_buf, TEMP_BUF_SIZE, "%s: %s histogram:\n",
+		 mmc_hostname(card->host), name);
+	strlcat(ubuf, temp_buf, cnt);
+
+	for (i = 0; i < MMC_PACK_HIST_BUCKETS; i++) {
+		if (!hist[i])
+			continue;
+		snprintf(temp_buf, TEMP_BUF_SIZE,
+			 "%s: [%u - %u): %u\n", mmc_hostname(card->host),
+			 i ? 1U << i : 0, 1U << (i + 1), hist[i]);
+		strlcat(ubuf, temp_buf, cnt);
+	}
+}
+
 static ssize_t mmc_wr_pack_stats_read(struct file *filp, char __user *ubuf,
 				size_t cnt, loff_t *ppos)
 {
@@ -788,6 +808,20 @@ static ssize_t mmc_wr_pack_stats_read(struct file *filp, char __user *ubuf,
 			pack_stats->pack_stop_reason[FUA]);
 		strlcat(ubuf, temp_buf, cnt);
 	}
+	if (pack_stats->pack_stop_reason[READ_LATENCY]) {
+		snprintf(temp_buf, TEMP_BUF_SIZE,
+			 "%s: %d times: read latency cap\n",
+			mmc_hostname(card->host),
+			pack_stats->pack_stop_reason[READ_LATENCY]);
+		strlcat(ubuf, temp_buf, cnt);
+	}
+
+	mmc_wr_pack_hist_print(card, "packed sectors",
+			       pack_stats->pack_sectors_hist,
+			       ubuf, cnt, temp_buf);
+	mmc_wr_pack_hist_print(card, "read delay behind pack (us)",
+			       pack_stats->read_delay_hist,
+			       ubuf, cnt, temp_buf);
 
 	spin_unlock(&pack_stats->lock);
 
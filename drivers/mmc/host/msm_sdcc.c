@@ -1305,6 +1305,8 @@ msmsdcc_start_data(struct msmsdcc_host *host, struct mmc_data *data,
 		datactrl |= MCI_AUTO_PROG_DONE;
 
 	if (msmsdcc_is_dma_possible(host, data)) {
+		ktime_t start = ktime_get();
+
 		if (is_dma_mode(host) && !msmsdcc_config_dma(host, data)) {
 			datactrl |= MCI_DPSM_DMAENABLE;
 		} else if (is_sps_mode(host)) {
@@ -1316,6 +1318,9 @@ msmsdcc_start_data(struct msmsdcc_host *host, struct mmc_data *data,
 				host->sps.busy = 1;
 			}
 		}
+		host->req_inline++;
+		host->req_inline_ns += ktime_to_ns(ktime_sub(ktime_get(),
+							     start));
 	}
 
 	/* Is data transfer in PIO mode required? */
@@ -2109,6 +2114,8 @@ msmsdcc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
 {
 	struct msmsdcc_host *host = mmc_priv(mmc);
 	struct mmc_data *data = mrq->data;
+	unsigned long flags;
+	ktime_t start;
 	int rc = 0;
 
 	if (unlikely(!data)) {
@@ -2127,6 +2134,7 @@ msmsdcc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
 	if (!msmsdcc_is_dma_possible(host, data))
 		return;
 
+	start = ktime_get();
 	rc = msmsdcc_prep_xfer(host, data);
 	if (unlikely(rc < 0)) {
 		data->host_cookie = 0;
@@ -2134,6 +2142,11 @@ msmsdcc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
 	}
 
 	data->host_cookie = 1;
+
+	spin_lock_irqsave(&host->lock, flags);
+	host->req_premapped++;
+	host->req_premap_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	spin_unlock_irqrestore(&host->lock, flags);
 }
 
 static void
@@ -5215,6 +5228,33 @@ store_enable_auto_cmd21(struct device *dev, struct device_attribute *attr,
 	return count;
 }
 
+static ssize_t
+show_req_overhead(struct device *dev, struct device_attribute *attr,
+		  char *buf)
+{
+	struct mmc_host *mmc = dev_get_drvdata(dev);
+	struct msmsdcc_host *host = mmc_priv(mmc);
+	unsigned long flags, inline_cnt, premap_cnt;
+	u64 inline_ns, premap_ns;
+
+	spin_lock_irqsave(&host->lock, flags);
+	inline_cnt = host->req_inline;
+	inline_ns = host->req_inline_ns;
+	premap_cnt = host->req_premapped;
+	premap_ns = host->req_premap_ns;
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	if (inline_cnt)
+		do_div(inline_ns, inline_cnt);
+	if (premap_cnt)
+		do_div(premap_ns, premap_cnt);
+
+	return snprintf(buf, PAGE_SIZE,
+			"inline: %lu reqs, %llu ns avg\n"
+			"premapped: %lu reqs, %llu ns avg\n",
+			inline_cnt, inline_ns, premap_cnt, premap_ns);
+}
+
 static void msmsdcc_print_regs(const char *name, void __iomem *base,
 				resource_size_t phys_base,
 				unsigned int no_of_regs)
@@ -6315,6 +6355,7 @@ msmsdcc_probe(struct platform_device *pdev)
 		pm_runtime_enable(&(pdev)->dev);
 	}
 #endif
+	device_enable_async_suspend(&pdev->dev);
 	host->idle_tout = MSM_MMC_DEFAULT_IDLE_TIMEOUT;
 	setup_timer(&host->req_tout_timer, msmsdcc_req_tout_timer_hdlr,
 			(unsigned long)host);
@@ -6392,6 +6433,14 @@ msmsdcc_probe(struct platform_device *pdev)
 	if (ret)
 		goto remove_polling_file;
 
+	host->req_overhead.show = show_req_overhead;
+	sysfs_attr_init(&host->req_overhead.attr);
+	host->req_overhead.attr.name = "req_overhead";
+	host->req_overhead.attr.mode = S_IRUGO;
+	ret = device_create_file(&pdev->dev, &host->req_overhead);
+	if (ret)
+		goto remove_idle_timeout_file;
+
 	if (!is_auto_cmd19(host))
 		goto add_auto_cmd21_atrr;
 
@@ -6403,7 +6452,7 @@ msmsdcc_probe(struct platform_device *pdev)
 	host->auto_cmd19_attr.attr.mode = S_IRUGO | S_IWUSR;
 	ret = device_create_file(&pdev->dev, &host->auto_cmd19_attr);
 	if (ret)
-		goto remove_idle_timeout_file;
+		goto remove_req_overhead_file;
 
  add_auto_cmd21_atrr:
 	if (!is_auto_cmd21(host))
@@ -6425,6 +6474,8 @@ msmsdcc_probe(struct platform_device *pdev)
  remove_auto_cmd19_attr_file:
 	if (is_auto_cmd19(host))
 		device_remove_file(&pdev->dev, &host->auto_cmd19_attr);
+ remove_req_overhead_file:
+	device_remove_file(&pdev->dev, &host->req_overhead);
  remove_idle_timeout_file:
 	device_remove_file(&pdev->dev, &host->idle_timeout);
  remove_polling_file:
@@ -6527,6 +6578,7 @@ static int msmsdcc_remove(struct platform_device *pdev)
 	if (!plat->status_irq)
 		device_remove_file(&pdev->dev, &host->polling);
 	device_remove_file(&pdev->dev, &host->idle_timeout);
+	device_remove_file(&pdev->dev, &host->req_overhead);
 
 	msmsdcc_remove_debugfs(host);
 
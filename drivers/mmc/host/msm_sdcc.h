@@ -432,6 +432,12 @@ struct msmsdcc_host {
 	struct device_attribute idle_timeout;
 	struct device_attribute auto_cmd19_attr;
 	struct device_attribute auto_cmd21_attr;
+	struct device_attribute req_overhead;
+	/* host side cost of setting up DMA, see req_overhead in sysfs */
+	unsigned long req_premapped;	/* sg mapped ahead in pre_req */
+	u64 req_premap_ns;
+	unsigned long req_inline;	/* DMA set up at request start */
+	u64 req_inline_ns;
 	struct dentry *debugfs_host_dir;
 	struct dentry *debugfs_idle_tout;
 	struct dentry *debugfs_pio_mode;
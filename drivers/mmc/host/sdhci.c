@@ -164,6 +164,26 @@ store_sdhci_pm_qos_tout(struct device *dev, struct device_attribute *attr,
 	return count;
 }
 
+static ssize_t
+show_sdhci_req_overhead(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+	struct sdhci_host *host = dev_get_drvdata(dev);
+	u64 inline_ns = host->req_inline_ns;
+	u64 prebuild_ns = host->req_prebuild_ns;
+
+	if (host->req_inline)
+		do_div(inline_ns, host->req_inline);
+	if (host->req_prebuilt)
+		do_div(prebuild_ns, host->req_prebuilt);
+
+	return snprintf(buf, PAGE_SIZE,
+			"inline: %lu reqs, %llu ns avg\n"
+			"prebuilt: %lu reqs, %llu ns avg\n",
+			host->req_inline, inline_ns,
+			host->req_prebuilt, prebuild_ns);
+}
+
 /*****************************************************************************\
  *                                                                           *
  * Low level functions                                                       *
@@ -541,15 +561,17 @@ static int sdhci_pre_dma_transfer(struct sdhci_host *host,
 	return sg_count;
 }
 
-static int sdhci_adma_table_pre(struct sdhci_host *host,
-	struct mmc_data *data)
+/*
+ * Fill @desc_base with the ADMA table for the already mapped @data.
+ * Without an @align buffer, as when building ahead in pre_req, an
+ * unaligned entry cannot be bounced and -EAGAIN is returned.
+ */
+static int sdhci_adma_table_fill(struct sdhci_host *host,
+	struct mmc_data *data, int sg_count, u8 *desc_base,
+	u8 *align, dma_addr_t align_addr)
 {
-	int direction;
-
-	u8 *desc;
-	u8 *align;
+	u8 *desc = desc_base;
 	dma_addr_t addr;
-	dma_addr_t align_addr;
 	int len, offset;
 
 	struct scatterlist *sg;
@@ -562,33 +584,7 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 	 * We currently guess that it is LE.
 	 */
 
-	if (data->flags & MMC_DATA_READ)
-		direction = DMA_FROM_DEVICE;
-	else
-		direction = DMA_TO_DEVICE;
-
-	/*
-	 * The ADMA descriptor table is mapped further down as we
-	 * need to fill it with data first.
-	 */
-	host->align_addr = dma_map_single(mmc_dev(host->mmc),
-					  host->align_buffer,
-					  host->align_buf_sz,
-					  direction);
-	if (dma_mapping_error(mmc_dev(host->mmc), host->align_addr))
-		goto fail;
-	BUG_ON(host->align_addr & 0x3);
-
-	host->sg_count = sdhci_pre_dma_transfer(host, data, NULL);
-	if (host->sg_count < 0)
-		goto unmap_align;
-
-	desc = host->adma_desc;
-	align = host->align_buffer;
-
-	align_addr = host->align_addr;
-
-	for_each_sg(data->sg, sg, host->sg_count, i) {
+	for_each_sg(data->sg, sg, sg_count, i) {
 		addr = sg_dma_address(sg);
 		len = sg_dma_len(sg);
 
@@ -601,6 +597,9 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 		 */
 		offset = (4 - (addr & 0x3)) & 0x3;
 		if (offset) {
+			if (!align)
+				return -EAGAIN;
+
 			if (data->flags & MMC_DATA_WRITE) {
 				buffer = sdhci_kmap_atomic(sg, &flags);
 				WARN_ON(((long)buffer & PAGE_MASK) > (PAGE_SIZE - 3));
@@ -632,7 +631,7 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 		 * If this triggers then we have a calculation bug
 		 * somewhere. :/
 		 */
-		WARN_ON((desc - host->adma_desc) > host->adma_desc_sz);
+		WARN_ON((desc - desc_base) > host->adma_desc_sz);
 
 	}
 
@@ -640,7 +639,7 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 		/*
 		* Mark the last descriptor as the terminating descriptor
 		*/
-		if (desc != host->adma_desc) {
+		if (desc != desc_base) {
 			desc -= 8;
 			desc[0] |= 0x2; /* end */
 		}
@@ -653,6 +652,104 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 		sdhci_set_adma_desc(desc, 0, 0, 0x3);
 	}
 
+	return 0;
+}
+
+/*
+ * Called from pre_req while the current request is still running, so
+ * that the table is ready when the next request is started.  The two
+ * tables are swapped when that happens.
+ */
+static void sdhci_adma_table_prebuild(struct sdhci_host *host,
+	struct mmc_data *data)
+{
+	ktime_t start = ktime_get();
+	int ret;
+
+	host->next_data.adma_ready = false;
+
+	dma_sync_single_for_cpu(mmc_dev(host->mmc), host->next_adma_addr,
+				host->adma_desc_sz, DMA_TO_DEVICE);
+	ret = sdhci_adma_table_fill(host, data, host->next_data.sg_count,
+				    host->next_adma_desc, NULL, 0);
+	dma_sync_single_for_device(mmc_dev(host->mmc), host->next_adma_addr,
+				   host->adma_desc_sz, DMA_TO_DEVICE);
+	if (ret)
+		return;	/* needs the bounce buffer, built at request time */
+
+	host->next_data.adma_ready = true;
+	host->req_prebuild_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static int sdhci_adma_map_tables(struct sdhci_host *host)
+{
+	struct device *dev = mmc_dev(host->mmc);
+
+	host->adma_addr = dma_map_single(dev, host->adma_desc,
+					 host->adma_desc_sz, DMA_TO_DEVICE);
+	if (dma_mapping_error(dev, host->adma_addr))
+		return -ENOMEM;
+
+	host->next_adma_addr = dma_map_single(dev, host->next_adma_desc,
+					      host->adma_desc_sz,
+					      DMA_TO_DEVICE);
+	if (dma_mapping_error(dev, host->next_adma_addr)) {
+		dma_unmap_single(dev, host->adma_addr, host->adma_desc_sz,
+				 DMA_TO_DEVICE);
+		return -ENOMEM;
+	}
+	BUG_ON((host->adma_addr | host->next_adma_addr) & 0x3);
+
+	return 0;
+}
+
+static int sdhci_adma_table_pre(struct sdhci_host *host,
+	struct mmc_data *data)
+{
+	int direction;
+	ktime_t start;
+
+	if (data->flags & MMC_DATA_READ)
+		direction = DMA_FROM_DEVICE;
+	else
+		direction = DMA_TO_DEVICE;
+
+	if (data->host_cookie && host->next_data.adma_ready &&
+	    data->host_cookie == host->next_data.cookie) {
+		swap(host->adma_desc, host->next_adma_desc);
+		swap(host->adma_addr, host->next_adma_addr);
+		host->next_data.adma_ready = false;
+		host->sg_count = sdhci_pre_dma_transfer(host, data, NULL);
+		if (host->sg_count < 0)
+			goto fail;
+		host->align_mapped = false;
+		host->req_prebuilt++;
+		return 0;
+	}
+
+	start = ktime_get();
+
+	host->align_addr = dma_map_single(mmc_dev(host->mmc),
+					  host->align_buffer,
+					  host->align_buf_sz,
+					  direction);
+	if (dma_mapping_error(mmc_dev(host->mmc), host->align_addr))
+		goto fail;
+	BUG_ON(host->align_addr & 0x3);
+
+	host->sg_count = sdhci_pre_dma_transfer(host, data, NULL);
+	if (host->sg_count < 0)
+		goto unmap_align;
+
+	/*
+	 * The descriptor tables stay mapped for the lifetime of the
+	 * host, only their contents are synced.
+	 */
+	dma_sync_single_for_cpu(mmc_dev(host->mmc), host->adma_addr,
+				host->adma_desc_sz, DMA_TO_DEVICE);
+	sdhci_adma_table_fill(host, data, host->sg_count, host->adma_desc,
+			      host->align_buffer, host->align_addr);
+
 	/*
 	 * Resync align buffer as we might have changed it.
 	 */
@@ -663,19 +760,15 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 					   direction);
 	}
 
-	host->adma_addr = dma_map_single(mmc_dev(host->mmc),
-					 host->adma_desc,
-					 host->adma_desc_sz,
-					 DMA_TO_DEVICE);
-	if (dma_mapping_error(mmc_dev(host->mmc), host->adma_addr))
-		goto unmap_entries;
-	BUG_ON(host->adma_addr & 0x3);
+	dma_sync_single_for_device(mmc_dev(host->mmc), host->adma_addr,
+				   host->adma_desc_sz, DMA_TO_DEVICE);
+	host->align_mapped = true;
+
+	host->req_inline++;
+	host->req_inline_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
 
 	return 0;
 
-unmap_entries:
-	dma_unmap_sg(mmc_dev(host->mmc), data->sg,
-		data->sg_len, direction);
 unmap_align:
 	dma_unmap_single(mmc_dev(host->mmc), host->align_addr,
 			 host->align_buf_sz, direction);
@@ -699,11 +792,11 @@ static void sdhci_adma_table_post(struct sdhci_host *host,
 	else
 		direction = DMA_TO_DEVICE;
 
-	dma_unmap_single(mmc_dev(host->mmc), host->adma_addr,
-			 host->adma_desc_sz, DMA_TO_DEVICE);
-
-	dma_unmap_single(mmc_dev(host->mmc), host->align_addr,
-			 host->align_buf_sz, direction);
+	if (host->align_mapped) {
+		dma_unmap_single(mmc_dev(host->mmc), host->align_addr,
+				 host->align_buf_sz, direction);
+		host->align_mapped = false;
+	}
 
 	if (data->flags & MMC_DATA_READ) {
 		dma_sync_sg_for_cpu(mmc_dev(host->mmc), data->sg,
@@ -1476,9 +1569,12 @@ static void sdhci_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
 		return;
 	}
 
-	if (host->flags & SDHCI_REQ_USE_DMA)
+	if (host->flags & SDHCI_REQ_USE_DMA) {
 		if (sdhci_pre_dma_transfer(host, mrq->data, &host->next_data) < 0)
 			mrq->data->host_cookie = 0;
+		else if (host->flags & SDHCI_USE_ADMA)
+			sdhci_adma_table_prebuild(host, mrq->data);
+	}
 }
 
 static void sdhci_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
@@ -1488,6 +1584,8 @@ static void sdhci_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
 	struct mmc_data *data = mrq->data;
 
 	if (host->flags & SDHCI_REQ_USE_DMA) {
+		if (data->host_cookie == host->next_data.cookie)
+			host->next_data.adma_ready = false;
 		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
 			     (data->flags & MMC_DATA_WRITE) ?
 			     DMA_TO_DEVICE : DMA_FROM_DEVICE);
@@ -3217,15 +3315,27 @@ int sdhci_add_host(struct sdhci_host *host)
 			mmc_hostname(host->mmc), __func__, host->adma_desc_sz);
 		host->adma_desc = kmalloc(host->adma_desc_sz,
 					  GFP_KERNEL);
+		host->next_adma_desc = kmalloc(host->adma_desc_sz,
+					       GFP_KERNEL);
 		host->align_buffer = kmalloc(host->align_buf_sz,
 					     GFP_KERNEL);
-		if (!host->adma_desc || !host->align_buffer) {
+		if (!host->adma_desc || !host->next_adma_desc ||
+		    !host->align_buffer) {
 			kfree(host->adma_desc);
+			kfree(host->next_adma_desc);
 			kfree(host->align_buffer);
 			pr_warning("%s: Unable to allocate ADMA "
 				"buffers. Falling back to standard DMA.\n",
 				mmc_hostname(mmc));
 			host->flags &= ~SDHCI_USE_ADMA;
+		} else if (sdhci_adma_map_tables(host)) {
+			kfree(host->adma_desc);
+			kfree(host->next_adma_desc);
+			kfree(host->align_buffer);
+			pr_warning("%s: Unable to map ADMA "
+				"tables. Falling back to standard DMA.\n",
+				mmc_hostname(mmc));
+			host->flags &= ~SDHCI_USE_ADMA;
 		}
 	}
 
@@ -3597,6 +3707,15 @@ int sdhci_add_host(struct sdhci_host *host)
 					mmc_hostname(mmc), ret);
 	}
 
+	host->req_overhead.show = show_sdhci_req_overhead;
+	sysfs_attr_init(&host->req_overhead.attr);
+	host->req_overhead.attr.name = "req_overhead";
+	host->req_overhead.attr.mode = S_IRUGO;
+	ret = device_create_file(mmc_dev(mmc), &host->req_overhead);
+	if (ret)
+		pr_err("%s: cannot create req_overhead %d\n",
+				mmc_hostname(mmc), ret);
+
 	mmc_add_host(mmc);
 
 	pr_info("%s: SDHCI controller on %s [%s] using %s\n",
@@ -3667,10 +3786,21 @@ void sdhci_remove_host(struct sdhci_host *host, int dead)
 	if (host->vmmc)
 		regulator_put(host->vmmc);
 
+	device_remove_file(mmc_dev(host->mmc), &host->req_overhead);
+
+	if (host->flags & SDHCI_USE_ADMA) {
+		dma_unmap_single(mmc_dev(host->mmc), host->adma_addr,
+				 host->adma_desc_sz, DMA_TO_DEVICE);
+		dma_unmap_single(mmc_dev(host->mmc), host->next_adma_addr,
+				 host->adma_desc_sz, DMA_TO_DEVICE);
+	}
+
 	kfree(host->adma_desc);
+	kfree(host->next_adma_desc);
 	kfree(host->align_buffer);
 
 	host->adma_desc = NULL;
+	host->next_adma_desc = NULL;
 	host->align_buffer = NULL;
 }
 
@@ -47,6 +47,10 @@ module_param(msm_rmnet_bam_headroom_check_failure, ulong, S_IRUGO);
 MODULE_PARM_DESC(msm_rmnet_bam_headroom_check_failure,
 		 "Number of packets with insufficient headroom");
 
+/* Deliver downlink packets through NAPI/GRO instead of netif_rx() */
+static int msm_rmnet_bam_napi = 1;
+module_param_named(napi, msm_rmnet_bam_napi, int, S_IRUGO | S_IWUSR | S_IWGRP);
+
 #define DEBUG_MASK_LVL0 (1U << 0)
 #define DEBUG_MASK_LVL1 (1U << 1)
 #define DEBUG_MASK_LVL2 (1U << 2)
@@ -75,6 +79,8 @@ MODULE_PARM_DESC(msm_rmnet_bam_headroom_check_failure,
 #define HEADROOM_FOR_QOS    8
 #define TAILROOM            8 /* for padding by mux layer */
 
+#define RMNET_NAPI_WEIGHT   64
+
 struct rmnet_private {
 	struct net_device_stats stats;
 	uint32_t ch_id;
@@ -88,6 +94,8 @@ struct rmnet_private {
 	spinlock_t lock;
 	spinlock_t tx_queue_lock;
 	struct tasklet_struct tsklt;
+	struct napi_struct napi;
+	struct sk_buff_head rx_queue;
 	u32 operation_mode; /* IOCTL specified mode (protocol, QoS header) */
 	uint8_t device_up;
 	uint8_t in_reset;
@@ -253,44 +261,103 @@ static int count_this_packet(void *_hdr, int len)
 	return 1;
 }
 
-/* Rx Callback, Called in Work Queue context */
-static void bam_recv_notify(void *dev, struct sk_buff *skb)
+static void rmnet_rx_deliver(struct net_device *dev, struct sk_buff *skb,
+			     struct napi_struct *napi)
 {
 	struct rmnet_private *p = netdev_priv(dev);
 	unsigned long flags;
 	u32 opmode;
 
-	if (skb) {
-		skb->dev = dev;
-		/* Handle Rx frame format */
-		spin_lock_irqsave(&p->lock, flags);
-		opmode = p->operation_mode;
-		spin_unlock_irqrestore(&p->lock, flags);
+	skb->dev = dev;
+	/* Handle Rx frame format */
+	spin_lock_irqsave(&p->lock, flags);
+	opmode = p->operation_mode;
+	spin_unlock_irqrestore(&p->lock, flags);
 
-		if (RMNET_IS_MODE_IP(opmode)) {
-			/* Driver in IP mode */
-			skb->protocol = rmnet_ip_type_trans(skb, dev);
-		} else {
-			/* Driver in Ethernet mode */
-			skb->protocol = eth_type_trans(skb, dev);
-		}
-		if (RMNET_IS_MODE_IP(opmode) ||
-		    count_this_packet(skb->data, skb->len)) {
+	if (RMNET_IS_MODE_IP(opmode)) {
+		/* Driver in IP mode */
+		skb->protocol = rmnet_ip_type_trans(skb, dev);
+		skb_reset_mac_header(skb);
+		skb_reset_network_header(skb);
+	} else {
+		/* Driver in Ethernet mode */
+		skb->protocol = eth_type_trans(skb, dev);
+	}
+	if (RMNET_IS_MODE_IP(opmode) ||
+	    count_this_packet(skb->data, skb->len)) {
 #ifdef CONFIG_MSM_RMNET_DEBUG
-			p->wakeups_rcv += rmnet_cause_wakeup(p);
+		p->wakeups_rcv += rmnet_cause_wakeup(p);
 #endif
-			p->stats.rx_packets++;
-			p->stats.rx_bytes += skb->len;
-		}
-		DBG1("[%s] Rx packet #%lu len=%d\n",
-			((struct net_device *)dev)->name,
-			p->stats.rx_packets, skb->len);
+		p->stats.rx_packets++;
+		p->stats.rx_bytes += skb->len;
+	}
+	DBG1("[%s] Rx packet #%lu len=%d\n",
+		dev->name, p->stats.rx_packets, skb->len);
 
-		/* Deliver to network stack */
+	/* Deliver to network stack */
+	if (napi)
+		napi_gro_receive(napi, skb);
+	else
 		netif_rx(skb);
-	} else
+}
+
+/*
+ * NAPI poll, runs in softirq context.  Packets queued by bam_recv_notify()
+ * since the last poll are handed to GRO in one batch, so back to back TCP
+ * segments are coalesced before they reach the stack.
+ */
+static int rmnet_poll(struct napi_struct *napi, int budget)
+{
+	struct rmnet_private *p = container_of(napi, struct rmnet_private,
+					       napi);
+	struct sk_buff *skb;
+	int work = 0;
+
+	while (work < budget) {
+		skb = skb_dequeue(&p->rx_queue);
+		if (!skb)
+			break;
+		rmnet_rx_deliver(napi->dev, skb, napi);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* catch packets queued while the poll was finishing */
+		if (!skb_queue_empty(&p->rx_queue))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+
+/* Rx Callback, Called in Work Queue context */
+static void bam_recv_notify(void *dev, struct sk_buff *skb)
+{
+	struct rmnet_private *p = netdev_priv(dev);
+
+	if (!skb) {
 		pr_err("[%s] %s: No skb received",
 			((struct net_device *)dev)->name, __func__);
+		return;
+	}
+
+	if (!msm_rmnet_bam_napi) {
+		rmnet_rx_deliver(dev, skb, NULL);
+		return;
+	}
+
+	/*
+	 * Only the first packet of a burst schedules the poll, the rest are
+	 * picked up by the poll already pending.
+	 */
+	if (skb_queue_len(&p->rx_queue) >= netdev_max_backlog) {
+		p->stats.rx_dropped++;
+		dev_kfree_skb_any(skb);
+		return;
+	}
+	skb_queue_tail(&p->rx_queue, skb);
+	napi_schedule(&p->napi);
 }
 
 static struct sk_buff *_rmnet_add_headroom(struct sk_buff **skb,
@@ -937,6 +1004,9 @@ static int __init rmnet_init(void)
 		p->device_up = DEVICE_UNINITIALIZED;
 		spin_lock_init(&p->lock);
 		spin_lock_init(&p->tx_queue_lock);
+		skb_queue_head_init(&p->rx_queue);
+		netif_napi_add(dev, &p->napi, rmnet_poll, RMNET_NAPI_WEIGHT);
+		napi_enable(&p->napi);
 #ifdef CONFIG_MSM_RMNET_DEBUG
 		p->timeout_us = timeout_us;
 		p->wakeups_xmit = p->wakeups_rcv = 0;
@@ -1003,6 +1073,9 @@ static int __init rmnet_init(void)
 		p->device_up = DEVICE_UNINITIALIZED;
 		spin_lock_init(&p->lock);
 		spin_lock_init(&p->tx_queue_lock);
+		skb_queue_head_init(&p->rx_queue);
+		netif_napi_add(dev, &p->napi, rmnet_poll, RMNET_NAPI_WEIGHT);
+		napi_enable(&p->napi);
 
 		ret = register_netdev(dev);
 		if (ret) {
@@ -2739,6 +2739,7 @@ static struct platform_driver wcnss_wlan_driver = {
 		.name	= DEVICE,
 		.owner	= THIS_MODULE,
 		.pm	= &wcnss_wlan_pm_ops,
+		.async_probe = true,
 #ifdef CONFIG_WCNSS_CORE_PRONTO
 		.of_match_table = msm_wcnss_pronto_match,
 #endif
@@ -27,6 +27,8 @@
 #include <linux/qpnp/qpnp-adc.h>
 #include <linux/qpnp/power-on.h>
 #include <linux/of_batterydata.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 /* BMS Register Offsets */
 #define REVISION1			0x0
@@ -179,6 +181,13 @@ struct qpnp_bms_chip {
 	struct pc_temp_ocv_lut		*pc_temp_ocv_lut;
 	struct sf_lut			*pc_sf_lut;
 	struct sf_lut			*rbatt_sf_lut;
+	struct ocv_temp_cache		ocv_cache;
+	struct single_row_lut		*fcc_cache_lut;
+	int				fcc_cache_temp;
+	int				fcc_cache_uah;
+	unsigned long			fcc_cache_hits;
+	unsigned long			fcc_cache_misses;
+	spinlock_t			lut_cache_lock;
 	int				default_rbatt_mohm;
 	int				rbatt_capacitive_mohm;
 	int				rbatt_mohm;
@@ -208,6 +217,14 @@ struct qpnp_bms_chip {
 	int				low_soc_calculate_soc_ms;
 	int				low_voltage_calculate_soc_ms;
 	int				calculate_soc_ms;
+	int				soc_period_ms;
+	bool				event_driven_soc;
+	unsigned long			soc_calcs;
+	unsigned long			soc_event_calcs;
+	unsigned long			soc_calcs_avoided;
+	unsigned long			adc_reads;
+	unsigned long			adc_reads_avoided;
+	struct dentry			*dent;
 	struct bms_wakeup_source	soc_wake_source;
 	struct wake_lock		cv_wake_lock;
 
@@ -992,6 +1009,23 @@ static void reset_for_new_battery(struct qpnp_bms_chip *chip, int batt_temp)
 
 #define SIGN(x) ((x) < 0 ? -1 : 1)
 #define UV_PER_SPIN 50000
+/*
+ * The soc algorithm looks the ocv up many times at the same temperature,
+ * so the lut's ocv column for the current temperature is kept around.
+ */
+static int bms_interpolate_ocv(struct qpnp_bms_chip *chip, int batt_temp,
+				int pc)
+{
+	unsigned long flags;
+	int ocv_mv;
+
+	spin_lock_irqsave(&chip->lut_cache_lock, flags);
+	ocv_mv = interpolate_ocv_cached(chip->pc_temp_ocv_lut,
+				&chip->ocv_cache, batt_temp, pc);
+	spin_unlock_irqrestore(&chip->lut_cache_lock, flags);
+	return ocv_mv;
+}
+
 static int find_ocv_for_pc(struct qpnp_bms_chip *chip, int batt_temp, int pc)
 {
 	int new_pc;
@@ -1001,7 +1035,7 @@ static int find_ocv_for_pc(struct qpnp_bms_chip *chip, int batt_temp, int pc)
 	int count = 0;
 	int sign, new_sign;
 
-	ocv_mv = interpolate_ocv(chip->pc_temp_ocv_lut, batt_temp, pc);
+	ocv_mv = bms_interpolate_ocv(chip, batt_temp, pc);
 
 	new_pc = interpolate_pc(chip->pc_temp_ocv_lut, batt_temp, ocv_mv);
 	pr_debug("test revlookup pc = %d for ocv = %d\n", new_pc, ocv_mv);
@@ -1145,18 +1179,30 @@ static int calculate_pc(struct qpnp_bms_chip *chip, int ocv_uv,
 
 static int calculate_fcc(struct qpnp_bms_chip *chip, int batt_temp)
 {
+	struct single_row_lut *fcc_lut;
+	unsigned long flags;
 	int fcc_uah;
 
-	if (chip->adjusted_fcc_temp_lut == NULL) {
-		/* interpolate_fcc returns a mv value. */
-		fcc_uah = interpolate_fcc(chip->fcc_temp_lut,
-						batt_temp) * 1000;
-		pr_debug("fcc = %d uAh\n", fcc_uah);
-		return fcc_uah;
+	fcc_lut = chip->adjusted_fcc_temp_lut;
+	if (fcc_lut == NULL)
+		fcc_lut = chip->fcc_temp_lut;
+
+	spin_lock_irqsave(&chip->lut_cache_lock, flags);
+	if (chip->fcc_cache_lut == fcc_lut
+			&& chip->fcc_cache_temp == batt_temp) {
+		fcc_uah = chip->fcc_cache_uah;
+		chip->fcc_cache_hits++;
 	} else {
-		return 1000 * interpolate_fcc(chip->adjusted_fcc_temp_lut,
-				batt_temp);
+		/* interpolate_fcc returns a mv value. */
+		fcc_uah = interpolate_fcc(fcc_lut, batt_temp) * 1000;
+		chip->fcc_cache_lut = fcc_lut;
+		chip->fcc_cache_temp = batt_temp;
+		chip->fcc_cache_uah = fcc_uah;
+		chip->fcc_cache_misses++;
 	}
+	spin_unlock_irqrestore(&chip->lut_cache_lock, flags);
+	pr_debug("fcc = %d uAh\n", fcc_uah);
+	return fcc_uah;
 }
 
 /* calculate remaining charge at the time of ocv */
@@ -1289,8 +1335,7 @@ static int calculate_termination_uuc(struct qpnp_bms_chip *chip,
 	int uuc_rbatt_mohm;
 
 	for (i = 0; i <= 100; i++) {
-		ocv_mv = interpolate_ocv(chip->pc_temp_ocv_lut,
-				batt_temp, i);
+		ocv_mv = bms_interpolate_ocv(chip, batt_temp, i);
 		rbatt_mohm = get_rbatt(chip, i, batt_temp);
 		unusable_uv = (rbatt_mohm * uuc_iavg_ma)
 							+ (chip->v_cutoff_uv);
@@ -1348,8 +1393,8 @@ static int adjust_uuc(struct qpnp_bms_chip *chip,
 	new_uuc_uah = (params->fcc_uah * chip->prev_pc_unusable) / 100;
 
 	/* also find update the iavg_ma accordingly */
-	new_unusable_mv = interpolate_ocv(chip->pc_temp_ocv_lut,
-			batt_temp, chip->prev_pc_unusable);
+	new_unusable_mv = bms_interpolate_ocv(chip, batt_temp,
+			chip->prev_pc_unusable);
 	if (new_unusable_mv < chip->v_cutoff_uv/1000)
 		new_unusable_mv = chip->v_cutoff_uv/1000;
 
@@ -2248,7 +2293,7 @@ static int64_t convert_cc_uah_to_raw(struct qpnp_bms_chip *chip, int64_t cc_uah)
 #define OCV_STEP_INCREMENT	0x10
 static void configure_soc_wakeup(struct qpnp_bms_chip *chip,
 				struct soc_params *params,
-				int batt_temp, int target_soc)
+				int batt_temp, int target_soc, bool full)
 {
 	int target_ocv_uv;
 	int64_t target_cc_uah, cc_raw_64, current_shdw_cc_raw_64;
@@ -2274,10 +2319,16 @@ static void configure_soc_wakeup(struct qpnp_bms_chip *chip,
 	 * Since the BMS driver resets the shadow coulomb counter every
 	 * 20 seconds when the device is awake, calculate the threshold as
 	 * a delta from the current shadow coulomb count.
+	 *
+	 * When discharging from below full, wake up once another percent
+	 * of the usable charge has been drawn.
 	 */
-	target_cc_uah = (100 - target_soc)
-		* (params->fcc_uah - params->uuc_uah)
-		/ 100 - current_shdw_cc_uah;
+	if (full)
+		target_cc_uah = (100 - target_soc)
+			* (params->fcc_uah - params->uuc_uah)
+			/ 100 - current_shdw_cc_uah;
+	else
+		target_cc_uah = (params->fcc_uah - params->uuc_uah) / 100;
 	if (target_cc_uah < 0) {
 		/*
 		 * If the target cc is below 0, that means we have already
@@ -2379,6 +2430,25 @@ static int calculate_raw_soc(struct qpnp_bms_chip *chip,
 }
 
 #define SLEEP_RECALC_INTERVAL	3
+
+/*
+ * With qcom,event-driven-soc the periodic soc work only runs every
+ * EVENT_RECALC_INTERVAL calculate-soc-ms periods while the battery is
+ * discharging in its normal range. In between, the soc is recalculated
+ * when the sw cc or ocv threshold set up by configure_soc_wakeup() trips,
+ * on charger and battery insertion events, and when the die temperature
+ * monitor sees a change of more than tm-temp-margin.
+ */
+#define EVENT_RECALC_INTERVAL	10
+static bool soc_event_driven(struct qpnp_bms_chip *chip, int soc)
+{
+	return chip->event_driven_soc
+		&& !chip->use_voltage_soc
+		&& !wake_lock_active(&chip->low_voltage_wake_lock)
+		&& soc >= chip->low_soc_calc_threshold
+		&& !is_battery_charging(chip);
+}
+
 static int calculate_state_of_charge(struct qpnp_bms_chip *chip,
 					struct raw_soc_params *raw,
 					int batt_temp)
@@ -2386,6 +2456,7 @@ static int calculate_state_of_charge(struct qpnp_bms_chip *chip,
 	struct soc_params params;
 	int soc, previous_soc, shutdown_soc, new_calculated_soc;
 	int remaining_usable_charge_uah;
+	bool full;
 
 	calculate_soc_params(chip, raw, &params, batt_temp);
 	if (!is_battery_present(chip)) {
@@ -2446,12 +2517,13 @@ static int calculate_state_of_charge(struct qpnp_bms_chip *chip,
 	new_calculated_soc = clamp_soc_based_on_voltage(chip,
 					new_calculated_soc);
 	/*
-	 * If the battery is full, configure the cc threshold so the system
-	 * wakes up after SoC changes
+	 * If the battery is full, or the soc is only recalculated on events,
+	 * configure the cc threshold so the system wakes up after SoC changes
 	 */
-	if (is_battery_full(chip)) {
-		configure_soc_wakeup(chip, &params,
-				batt_temp, bound_soc(new_calculated_soc - 1));
+	full = is_battery_full(chip);
+	if (full || soc_event_driven(chip, new_calculated_soc)) {
+		configure_soc_wakeup(chip, &params, batt_temp,
+				bound_soc(new_calculated_soc - 1), full);
 	} else {
 		disable_bms_irq(&chip->ocv_thr_irq);
 		disable_bms_irq(&chip->sw_cc_thr_irq);
@@ -2473,7 +2545,7 @@ done_calculating:
 	 * allowed to become unbounded by the last reported SoC
 	 */
 	if (params.delta_time_s * 1000 >
-			chip->calculate_soc_ms * SLEEP_RECALC_INTERVAL
+			chip->soc_period_ms * SLEEP_RECALC_INTERVAL
 			&& !chip->first_time_calc_soc) {
 		chip->last_soc_unbound = true;
 		chip->last_soc_change_sec = chip->last_recalc_time;
@@ -2592,10 +2664,14 @@ static int recalculate_soc(struct qpnp_bms_chip *chip)
 	if (chip->use_voltage_soc) {
 		soc = calculate_soc_from_voltage(chip);
 	} else {
-		if (!chip->batfet_closed)
+		if (!chip->batfet_closed) {
 			qpnp_iadc_calibrate_for_trim(chip->iadc_dev, false);
+			chip->adc_reads++;
+		}
 		rc = qpnp_vadc_read(chip->vadc_dev, LR_MUX1_BATT_THERM,
 								&result);
+		chip->adc_reads++;
+		chip->soc_calcs++;
 		if (rc) {
 			pr_err("error reading vadc LR_MUX1_BATT_THERM = %d, rc = %d\n",
 						LR_MUX1_BATT_THERM, rc);
@@ -2622,6 +2698,7 @@ static void recalculate_work(struct work_struct *work)
 				struct qpnp_bms_chip,
 				recalc_work);
 
+	chip->soc_event_calcs++;
 	recalculate_soc(chip);
 }
 
@@ -2631,20 +2708,40 @@ static int get_calculation_delay_ms(struct qpnp_bms_chip *chip)
 		return chip->low_voltage_calculate_soc_ms;
 	else if (chip->calculated_soc < chip->low_soc_calc_threshold)
 		return chip->low_soc_calculate_soc_ms;
+	else if (soc_event_driven(chip, chip->calculated_soc))
+		return chip->calculate_soc_ms * EVENT_RECALC_INTERVAL;
 	else
 		return chip->calculate_soc_ms;
 }
 
+/*
+ * Every calculate-soc-ms period the stretched soc work sleeps through is
+ * a soc calculation and a battery therm read that did not happen.
+ */
+static void account_skipped_calcs(struct qpnp_bms_chip *chip, int delay_ms)
+{
+	int skipped = delay_ms / chip->calculate_soc_ms - 1;
+
+	if (skipped > 0) {
+		chip->soc_calcs_avoided += skipped;
+		chip->adc_reads_avoided += skipped;
+	}
+	chip->soc_period_ms = max(delay_ms, chip->calculate_soc_ms);
+}
+
 static void calculate_soc_work(struct work_struct *work)
 {
 	struct qpnp_bms_chip *chip = container_of(work,
 				struct qpnp_bms_chip,
 				calculate_soc_delayed_work.work);
+	int delay_ms;
 
 	recalculate_soc(chip);
-	schedule_delayed_work(&chip->calculate_soc_delayed_work,
-		round_jiffies_relative(msecs_to_jiffies
-		(get_calculation_delay_ms(chip))));
+	delay_ms = get_calculation_delay_ms(chip);
+	account_skipped_calcs(chip, delay_ms);
+	queue_delayed_work(system_power_efficient_wq,
+		&chip->calculate_soc_delayed_work,
+		round_jiffies_relative(msecs_to_jiffies(delay_ms)));
 }
 
 static void configure_vbat_monitor_low(struct qpnp_bms_chip *chip)
@@ -2661,7 +2758,7 @@ static void configure_vbat_monitor_low(struct qpnp_bms_chip *chip)
 			wake_lock(&chip->low_voltage_wake_lock);
 			cancel_delayed_work_sync(
 					&chip->calculate_soc_delayed_work);
-			schedule_delayed_work(
+			queue_delayed_work(system_power_efficient_wq,
 					&chip->calculate_soc_delayed_work, 0);
 		}
 		chip->vbat_monitor_params.state_request =
@@ -3796,6 +3893,7 @@ static inline int bms_read_properties(struct qpnp_bms_chip *chip)
 	SPMI_PROP_READ(low_voltage_calculate_soc_ms,
 			"low-voltage-calculate-soc-ms", rc);
 	SPMI_PROP_READ(calculate_soc_ms, "calculate-soc-ms", rc);
+	chip->soc_period_ms = chip->calculate_soc_ms;
 	SPMI_PROP_READ(high_ocv_correction_limit_uv,
 			"high-ocv-correction-limit-uv", rc);
 	SPMI_PROP_READ(low_ocv_correction_limit_uv,
@@ -3820,6 +3918,9 @@ static inline int bms_read_properties(struct qpnp_bms_chip *chip)
 	chip->use_ocv_thresholds = of_property_read_bool(
 			chip->spmi->dev.of_node,
 			"qcom,use-ocv-thresholds");
+	chip->event_driven_soc = of_property_read_bool(
+			chip->spmi->dev.of_node,
+			"qcom,event-driven-soc");
 
 	if (chip->adjust_soc_low_threshold >= 45)
 		chip->adjust_soc_low_threshold = 45;
@@ -4177,6 +4278,49 @@ static int setup_die_temp_monitoring(struct qpnp_bms_chip *chip)
 	return 0;
 }
 
+static int bms_stats_show(struct seq_file *m, void *unused)
+{
+	struct qpnp_bms_chip *chip = m->private;
+
+	seq_printf(m, "event_driven: %d\n",
+			soc_event_driven(chip, chip->calculated_soc));
+	seq_printf(m, "soc_period_ms: %d\n", chip->soc_period_ms);
+	seq_printf(m, "soc_calcs: %lu\n", chip->soc_calcs);
+	seq_printf(m, "soc_event_calcs: %lu\n", chip->soc_event_calcs);
+	seq_printf(m, "soc_calcs_avoided: %lu\n", chip->soc_calcs_avoided);
+	seq_printf(m, "adc_reads: %lu\n", chip->adc_reads);
+	seq_printf(m, "adc_reads_avoided: %lu\n", chip->adc_reads_avoided);
+	seq_printf(m, "ocv_lut_hits: %lu\n", chip->ocv_cache.hits);
+	seq_printf(m, "ocv_lut_misses: %lu\n", chip->ocv_cache.misses);
+	seq_printf(m, "fcc_lut_hits: %lu\n", chip->fcc_cache_hits);
+	seq_printf(m, "fcc_lut_misses: %lu\n", chip->fcc_cache_misses);
+	return 0;
+}
+
+static int bms_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bms_stats_show, inode->i_private);
+}
+
+static const struct file_operations bms_stats_fops = {
+	.open		= bms_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void create_debugfs_entries(struct qpnp_bms_chip *chip)
+{
+	chip->dent = debugfs_create_dir("qpnp-bms", NULL);
+	if (IS_ERR_OR_NULL(chip->dent)) {
+		pr_err("couldn't create debugfs dir\n");
+		chip->dent = NULL;
+		return;
+	}
+	debugfs_create_file("soc_stats", 0444, chip->dent, chip,
+			&bms_stats_fops);
+}
+
 static int __devinit qpnp_bms_probe(struct spmi_device *spmi)
 {
 	struct qpnp_bms_chip *chip;
@@ -4201,6 +4345,7 @@ static int __devinit qpnp_bms_probe(struct spmi_device *spmi)
 	mutex_init(&chip->soc_invalidation_mutex);
 	mutex_init(&chip->last_soc_mutex);
 	mutex_init(&chip->status_lock);
+	spin_lock_init(&chip->lut_cache_lock);
 	init_waitqueue_head(&chip->bms_wait_queue);
 
 	warm_reset = qpnp_pon_is_warm_reset();
@@ -4363,6 +4508,7 @@ static int __devinit qpnp_bms_probe(struct spmi_device *spmi)
 	pr_info("probe success: soc =%d vbatt = %d ocv = %d r_sense_uohm = %u warm_reset = %d\n",
 			get_prop_bms_capacity(chip), vbatt, chip->last_ocv_uv,
 			chip->r_sense_uohm, warm_reset);
+	create_debugfs_entries(chip);
 	return 0;
 
 unregister_dc:
@@ -4380,6 +4526,10 @@ error_read:
 
 static int qpnp_bms_remove(struct spmi_device *spmi)
 {
+	struct qpnp_bms_chip *chip = dev_get_drvdata(&spmi->dev);
+
+	if (chip)
+		debugfs_remove_recursive(chip->dent);
 	dev_set_drvdata(&spmi->dev, NULL);
 	return 0;
 }
@@ -4416,7 +4566,8 @@ static int bms_resume(struct device *dev)
 
 	if (time_until_next_recalc == 0)
 		bms_stay_awake(&chip->soc_wake_source);
-	schedule_delayed_work(&chip->calculate_soc_delayed_work,
+	queue_delayed_work(system_power_efficient_wq,
+		&chip->calculate_soc_delayed_work,
 		round_jiffies_relative(msecs_to_jiffies
 		(time_until_next_recalc)));
 	return 0;
@@ -65,6 +65,7 @@ static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	struct timespec new_alarm_time;
 	struct timespec new_rtc_time;
 	struct timespec tmp_time;
+	struct android_alarm_window window;
 	enum android_alarm_type alarm_type = ANDROID_ALARM_IOCTL_TO_TYPE(cmd);
 	uint32_t alarm_type_mask = 1U << alarm_type;
 
@@ -161,6 +162,37 @@ from_old_alarm_set:
 		alarm_pending = 0;
 		spin_unlock_irqrestore(&alarm_slock, flags);
 		break;
+	case ANDROID_ALARM_SET_WINDOW(0):
+		/* power-on alarms are programmed to the second, no window */
+		if (alarm_type == ANDROID_ALARM_RTC_POWEROFF_WAKEUP) {
+			rv = -EINVAL;
+			goto err1;
+		}
+		if (copy_from_user(&window, (void __user *)arg,
+		    sizeof(window))) {
+			rv = -EFAULT;
+			goto err1;
+		}
+		if (!timespec_valid_strict(&window.start) ||
+		    !timespec_valid_strict(&window.end) ||
+		    timespec_compare(&window.end, &window.start) < 0) {
+			pr_alarm(INFO, "Invalid alarm window: %ld.%09ld - "
+				"%ld.%09ld\n", window.start.tv_sec,
+				window.start.tv_nsec, window.end.tv_sec,
+				window.end.tv_nsec);
+			rv = -EINVAL;
+			goto err1;
+		}
+		spin_lock_irqsave(&alarm_slock, flags);
+		pr_alarm(IO, "alarm %d set window %ld.%09ld - %ld.%09ld\n",
+			alarm_type, window.start.tv_sec, window.start.tv_nsec,
+			window.end.tv_sec, window.end.tv_nsec);
+		alarm_enabled |= alarm_type_mask;
+		alarm_start_range(&alarms[alarm_type],
+			timespec_to_ktime(window.start),
+			timespec_to_ktime(window.end));
+		spin_unlock_irqrestore(&alarm_slock, flags);
+		break;
 	case ANDROID_ALARM_SET_RTC:
 		if (copy_from_user(&new_rtc_time, (void __user *)arg,
 		    sizeof(new_rtc_time))) {
@@ -24,6 +24,9 @@
 #include <linux/wakelock.h>
 
 #include <asm/mach/time.h>
+#ifdef CONFIG_MSM_EVENT_TIMER
+#include <mach/event_timer.h>
+#endif
 
 #define ALARM_DELTA 120
 #define ANDROID_ALARM_PRINT_ERROR (1U << 0)
@@ -38,6 +41,14 @@ static int debug_mask = ANDROID_ALARM_PRINT_ERROR | \
 			ANDROID_ALARM_PRINT_INIT_STATUS;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* line windowed wakeup alarms up with other wakeups */
+static int coalesce = 1;
+module_param(coalesce, int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* wakeup alarms that went off early, together with another wakeup */
+static unsigned long coalesced_wakeups;
+module_param(coalesced_wakeups, ulong, S_IRUGO);
+
 #define pr_alarm(debug_level_mask, args...) \
 	do { \
 		if (debug_mask & ANDROID_ALARM_PRINT_##debug_level_mask) { \
@@ -88,13 +99,62 @@ void set_power_on_alarm(long secs, bool enable)
 	alarm_shutdown(NULL);
 }
 
+static inline bool alarm_queue_is_wakeup(struct alarm_queue *base)
+{
+	return base == &alarms[ANDROID_ALARM_RTC_WAKEUP] ||
+		base == &alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP] ||
+		base == &alarms[ANDROID_ALARM_RTC_POWEROFF_WAKEUP];
+}
+
+/* wall time of the next msm lpm event timer, zero if there is none */
+static ktime_t alarm_next_lpm_event(void)
+{
+#ifdef CONFIG_MSM_EVENT_TIMER
+	ktime_t next = get_next_event_time();
+
+	if (next.tv64 > 0)
+		return ktime_add(ktime_get_real(), next);
+#endif
+	return ktime_set(0, 0);
+}
+
+/*
+ * alarm_coalesce_locked - pick the time to wake up for a windowed alarm
+ * that may go off anywhere from 'soft' to 'hard' (wall time).  The
+ * earliest wakeup already due inside the window, of another wakeup alarm
+ * queue or of an lpm event timer, is used so the SoC comes up only once.
+ */
+static ktime_t alarm_coalesce_locked(struct alarm_queue *base,
+				     ktime_t soft, ktime_t hard)
+{
+	ktime_t best = hard;
+	ktime_t t;
+	int i;
+
+	for (i = 0; i < ANDROID_ALARM_SYSTEMTIME; i++) {
+		struct alarm_queue *other = &alarms[i];
+
+		if (other == base || !alarm_queue_is_wakeup(other) ||
+		    !other->first || !hrtimer_active(&other->timer))
+			continue;
+
+		t = hrtimer_get_expires(&other->timer);
+		if (t.tv64 >= soft.tv64 && t.tv64 < best.tv64)
+			best = t;
+	}
+
+	t = alarm_next_lpm_event();
+	if (t.tv64 >= soft.tv64 && t.tv64 < best.tv64)
+		best = t;
+
+	return best;
+}
 
 static void update_timer_locked(struct alarm_queue *base, bool head_removed)
 {
 	struct alarm *alarm;
-	bool is_wakeup = base == &alarms[ANDROID_ALARM_RTC_WAKEUP] ||
-			base == &alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP] ||
-			base == &alarms[ANDROID_ALARM_RTC_POWEROFF_WAKEUP];
+	bool is_wakeup = alarm_queue_is_wakeup(base);
+	ktime_t soft, hard;
 
 	if (base->stopped) {
 		pr_alarm(FLOW, "changed alarm while setting the wall time\n");
@@ -118,9 +178,14 @@ static void update_timer_locked(struct alarm_queue *base, bool head_removed)
 		return;
 	}
 
+	soft = ktime_add(base->delta, alarm->softexpires);
+	hard = ktime_add(base->delta, alarm->expires);
+	if (is_wakeup && coalesce && soft.tv64 < hard.tv64)
+		hard = alarm_coalesce_locked(base, soft, hard);
+
 	hrtimer_try_to_cancel(&base->timer);
-	base->timer.node.expires = ktime_add(base->delta, alarm->expires);
-	base->timer._softexpires = ktime_add(base->delta, alarm->softexpires);
+	base->timer.node.expires = hard;
+	base->timer._softexpires = soft;
 	hrtimer_start_expires(&base->timer, HRTIMER_MODE_ABS);
 }
 
@@ -390,6 +455,9 @@ static enum hrtimer_restart alarm_timer_triggered(struct hrtimer *timer)
 		base->first = rb_next(&alarm->node);
 		rb_erase(&alarm->node, &base->alarms);
 		RB_CLEAR_NODE(&alarm->node);
+		if (alarm_queue_is_wakeup(base) &&
+		    alarm->expires.tv64 > now.tv64)
+			coalesced_wakeups++;
 		pr_alarm(CALL, "call alarm, type %d, func %pF, %lld (s %lld)\n",
 			alarm->type, alarm->function,
 			ktime_to_ns(alarm->expires),
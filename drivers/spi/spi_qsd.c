@@ -41,6 +41,7 @@
 #include <linux/mutex.h>
 #include <linux/atomic.h>
 #include <linux/pm_runtime.h>
+#include <linux/ktime.h>
 #include <mach/msm_spi.h>
 #include <mach/sps.h>
 #include <mach/dma.h>
@@ -1307,7 +1308,8 @@ static irqreturn_t msm_spi_error_irq(int irq, void *dev_id)
  *
  * calls dma_map_single() on the read/write buffers, effectively invalidating
  * their cash entries. for For WR-WR and WR-RD transfers, allocates temporary
- * buffer and copy the data to/from the client buffers
+ * buffer and copy the data to/from the client buffers. A single transfer the
+ * client has already mapped is used as it is.
  */
 static int msm_spi_dma_map_buffers(struct msm_spi *dd)
 {
@@ -1318,6 +1320,9 @@ static int msm_spi_dma_map_buffers(struct msm_spi *dd)
 	unsigned tx_len, rx_len;
 	int ret = -EINVAL;
 
+	if (dd->cur_msg->is_dma_mapped && !dd->multi_xfr)
+		return 0;
+
 	dev = &dd->cur_msg->spi->dev;
 	first_xfr = dd->cur_transfer;
 	tx_buf = (void *)first_xfr->tx_buf;
@@ -1395,7 +1400,7 @@ static void msm_spi_dmov_unmap_buffers(struct msm_spi *dd)
 	u32 offset;
 
 	dev = &dd->cur_msg->spi->dev;
-	if (dd->cur_msg->is_dma_mapped)
+	if (dd->cur_msg->is_dma_mapped && !dd->multi_xfr)
 		goto unmap_end;
 
 	if (dd->multi_xfr) {
@@ -1462,7 +1467,7 @@ static void msm_spi_bam_unmap_buffers(struct msm_spi *dd)
 	struct device *dev;
 
 	 /* mapped by client */
-	if (dd->cur_msg->is_dma_mapped)
+	if (dd->cur_msg->is_dma_mapped && !dd->multi_xfr)
 		return;
 
 	dev = &dd->cur_msg->spi->dev;
@@ -1693,11 +1698,15 @@ static void msm_spi_process_transfer(struct msm_spi *dd)
 
 	msm_spi_set_transfer_mode(dd, bpw, read_count);
 	msm_spi_set_mx_counts(dd, read_count);
-	if ((dd->mode == SPI_BAM_MODE) || (dd->mode == SPI_DMOV_MODE))
-		if (msm_spi_dma_map_buffers(dd) < 0) {
+	if ((dd->mode == SPI_BAM_MODE) || (dd->mode == SPI_DMOV_MODE)) {
+		int ret = msm_spi_dma_map_buffers(dd);
+
+		if (ret < 0) {
 			pr_err("Mapping DMA buffers\n");
+			dd->cur_msg->status = ret;
 			return;
 		}
+	}
 	msm_spi_set_qup_io_modes(dd);
 	msm_spi_set_spi_config(dd, bpw);
 	msm_spi_set_qup_config(dd, bpw);
@@ -1934,19 +1943,10 @@ static void msm_spi_process_message(struct msm_spi *dd)
 			}
 		} else {
 			/* Handling of a single transfer or
-			 * WR-WR or WR-RD transfers
+			 * WR-WR or WR-RD transfers. DMA buffers are
+			 * mapped by msm_spi_process_transfer() once the
+			 * mode is known.
 			 */
-			if ((!dd->cur_msg->is_dma_mapped) &&
-			    (msm_spi_use_dma(dd, dd->cur_transfer,
-					dd->cur_transfer->bits_per_word))) {
-				/* Mapping of DMA buffers */
-				int ret = msm_spi_dma_map_buffers(dd);
-				if (ret < 0) {
-					dd->cur_msg->status = ret;
-					goto error;
-				}
-			}
-
 			dd->cur_tx_transfer = dd->cur_transfer;
 			dd->cur_rx_transfer = dd->cur_transfer;
 			msm_spi_process_transfer(dd);
@@ -1962,6 +1962,20 @@ error:
 	}
 }
 
+/* process the current message, counting it towards the bus utilization */
+static void msm_spi_account_message(struct msm_spi *dd)
+{
+	struct spi_transfer *tr;
+	ktime_t start = ktime_get();
+
+	msm_spi_process_message(dd);
+
+	dd->stat_busy_us += ktime_us_delta(ktime_get(), start);
+	dd->stat_msgs++;
+	list_for_each_entry(tr, &dd->cur_msg->transfers, transfer_list)
+		dd->stat_bytes += tr->len;
+}
+
 /* workqueue - pull messages from queue & process */
 static void msm_spi_workq(struct work_struct *work)
 {
@@ -2004,7 +2018,7 @@ static void msm_spi_workq(struct work_struct *work)
 		if (status_error)
 			dd->cur_msg->status = -EIO;
 		else
-			msm_spi_process_message(dd);
+			msm_spi_account_message(dd);
 		if (dd->cur_msg->complete)
 			dd->cur_msg->complete(dd->cur_msg->context);
 		spin_lock_irqsave(&dd->queue_lock, flags);
@@ -2192,6 +2206,7 @@ static ssize_t show_stats(struct device *dev, struct device_attribute *attr,
 {
 	struct spi_master *master = dev_get_drvdata(dev);
 	struct msm_spi *dd =  spi_master_get_devdata(master);
+	s64 elapsed = ktime_us_delta(ktime_get(), dd->stat_start);
 
 	return snprintf(buf, PAGE_SIZE,
 			"Device       %s\n"
@@ -2208,6 +2223,9 @@ static ssize_t show_stats(struct device *dev, struct device_attribute *attr,
 			"Rx isrs  = %d\n"
 			"Tx isrs  = %d\n"
 			"DMA error  = %d\n"
+			"messages = %u\n"
+			"bytes    = %llu\n"
+			"busy     = %llu us (%llu%% of %lld us)\n"
 			"--debug--\n"
 			"NA yet\n",
 			dev_name(dev),
@@ -2224,7 +2242,12 @@ static ssize_t show_stats(struct device *dev, struct device_attribute *attr,
 			dd->rx_dma_crci,
 			dd->stat_rx + dd->stat_dmov_rx,
 			dd->stat_tx + dd->stat_dmov_tx,
-			dd->stat_dmov_tx_err + dd->stat_dmov_rx_err
+			dd->stat_dmov_tx_err + dd->stat_dmov_rx_err,
+			dd->stat_msgs,
+			dd->stat_bytes,
+			dd->stat_busy_us,
+			elapsed > 0 ? div64_u64(dd->stat_busy_us * 100, elapsed) : 0,
+			elapsed
 			);
 }
 
@@ -2232,13 +2255,21 @@ static ssize_t show_stats(struct device *dev, struct device_attribute *attr,
 static ssize_t set_stats(struct device *dev, struct device_attribute *attr,
 			 const char *buf, size_t count)
 {
-	struct msm_spi *dd = dev_get_drvdata(dev);
+	struct spi_master *master = dev_get_drvdata(dev);
+	struct msm_spi *dd = spi_master_get_devdata(master);
+
+	mutex_lock(&dd->core_lock);
 	dd->stat_rx = 0;
 	dd->stat_tx = 0;
 	dd->stat_dmov_rx = 0;
 	dd->stat_dmov_tx = 0;
 	dd->stat_dmov_rx_err = 0;
 	dd->stat_dmov_tx_err = 0;
+	dd->stat_msgs = 0;
+	dd->stat_bytes = 0;
+	dd->stat_busy_us = 0;
+	dd->stat_start = ktime_get();
+	mutex_unlock(&dd->core_lock);
 	return count;
 }
 
@@ -2904,6 +2935,7 @@ skip_dma_resources:
 	mutex_init(&dd->core_lock);
 	INIT_LIST_HEAD(&dd->queue);
 	INIT_WORK(&dd->work_data, msm_spi_workq);
+	dd->stat_start = ktime_get();
 	init_waitqueue_head(&dd->continue_suspend);
 	dd->workqueue = create_singlethread_workqueue(
 			dev_name(master->dev.parent));
@@ -367,6 +367,11 @@ struct msm_spi {
 	int                      stat_dmov_rx;
 	int                      stat_tx;
 	int                      stat_dmov_tx;
+	/* Bus utilization since the statistics were last reset */
+	u32                      stat_msgs;
+	u64                      stat_bytes;
+	u64                      stat_busy_us;
+	ktime_t                  stat_start;
 #ifdef CONFIG_DEBUG_FS
 	struct dentry *dent_spi;
 	struct dentry *debugfs_spi_regs[ARRAY_SIZE(debugfs_spi_regs)];
@@ -27,6 +27,9 @@
 #include <linux/personality.h>
 #include <linux/bitops.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/rbtree.h>
+#include <linux/kref.h>
 #include <linux/shmem_fs.h>
 #include <linux/ashmem.h>
 #include <asm/cacheflush.h>
@@ -35,15 +38,21 @@
 #define ASHMEM_NAME_PREFIX_LEN (sizeof(ASHMEM_NAME_PREFIX) - 1)
 #define ASHMEM_FULL_NAME_LEN (ASHMEM_NAME_LEN + ASHMEM_NAME_PREFIX_LEN)
 
+/* give up a shrink pass after this many ranges of busy areas */
+#define ASHMEM_SHRINK_MAX_BUSY 32
+
 /*
  * ashmem_area - anonymous shared memory area
- * Lifecycle: From our parent file's open() until its release()
- * Locking: Protected by `ashmem_mutex'
+ * Lifecycle: From our parent file's open() until its release(), and for
+ *	      as long as the shrinker is purging one of its ranges
+ * Locking: Protected by its own `mutex'
  * Big Note: Mappings do NOT pin this structure; it dies on close()
  */
 struct ashmem_area {
 	char name[ASHMEM_FULL_NAME_LEN]; /* optional name in /proc/pid/maps */
-	struct list_head unpinned_list;	 /* list of all ashmem areas */
+	struct mutex mutex;		 /* protects the area and its ranges */
+	struct kref ref;		 /* held by the file and the shrinker */
+	struct rb_root unpinned_root;	 /* unpinned ranges, by pgstart */
 	struct file *file;		 /* the shmem-based backing file */
 	size_t size;			 /* size of the mapping, in bytes */
 	unsigned long vm_start;		 /* Start address of vm_area
@@ -54,29 +63,33 @@ struct ashmem_area {
 /*
  * ashmem_range - represents an interval of unpinned (evictable) pages
  * Lifecycle: From unpin to pin
- * Locking: Protected by `ashmem_mutex'
+ * Locking: Protected by its area's `mutex', 'lru' by `ashmem_lru_lock'
+ *
+ * The ranges of an area never overlap, so keeping them sorted by pgstart
+ * also keeps them sorted by pgend and the tree works as an interval tree.
  */
 struct ashmem_range {
 	struct list_head lru;		/* entry in LRU list */
-	struct list_head unpinned;	/* entry in its area's unpinned list */
+	struct rb_node node;		/* entry in its area's unpinned tree */
 	struct ashmem_area *asma;	/* associated area */
 	size_t pgstart;			/* starting page, inclusive */
 	size_t pgend;			/* ending page, inclusive */
 	unsigned int purged;		/* ASHMEM_NOT or ASHMEM_WAS_PURGED */
 };
 
-/* LRU list of unpinned pages, protected by ashmem_mutex */
+/* LRU list of unpinned pages, protected by ashmem_lru_lock */
 static LIST_HEAD(ashmem_lru_list);
 
-/* Count of pages on our LRU list, protected by ashmem_mutex */
+/* Count of pages on our LRU list, protected by ashmem_lru_lock */
 static unsigned long lru_count;
 
 /*
- * ashmem_mutex - protects the list of and each individual ashmem_area
+ * ashmem_lru_lock - protects the LRU list and lru_count
  *
- * Lock Ordering: ashmex_mutex -> i_mutex -> i_alloc_sem
+ * Lock Ordering: asma->mutex -> ashmem_lru_lock, and
+ *		  asma->mutex -> i_mutex -> i_alloc_sem
  */
-static DEFINE_MUTEX(ashmem_mutex);
+static DEFINE_SPINLOCK(ashmem_lru_lock);
 
 static struct kmem_cache *ashmem_area_cachep __read_mostly;
 static struct kmem_cache *ashmem_range_cachep __read_mostly;
@@ -105,31 +118,82 @@ static struct kmem_cache *ashmem_range_cachep __read_mostly;
 
 #define PROT_MASK		(PROT_EXEC | PROT_READ | PROT_WRITE)
 
+/* Caller must hold ashmem_lru_lock. */
 static inline void lru_add(struct ashmem_range *range)
 {
 	list_add_tail(&range->lru, &ashmem_lru_list);
 	lru_count += range_size(range);
 }
 
+/* Caller must hold ashmem_lru_lock. */
 static inline void lru_del(struct ashmem_range *range)
 {
 	list_del(&range->lru);
 	lru_count -= range_size(range);
 }
 
+/*
+ * range_first - returns the first range of 'asma' that ends at or after
+ * page 'pgstart', or NULL if there is none.
+ *
+ * Caller must hold asma->mutex.
+ */
+static struct ashmem_range *range_first(struct ashmem_area *asma,
+					size_t pgstart)
+{
+	struct rb_node *node = asma->unpinned_root.rb_node;
+	struct ashmem_range *range, *first = NULL;
+
+	while (node) {
+		range = rb_entry(node, struct ashmem_range, node);
+		if (range_before_page(range, pgstart)) {
+			node = node->rb_right;
+		} else {
+			first = range;
+			node = node->rb_left;
+		}
+	}
+
+	return first;
+}
+
+static inline struct ashmem_range *range_next(struct ashmem_range *range)
+{
+	struct rb_node *node = rb_next(&range->node);
+
+	return node ? rb_entry(node, struct ashmem_range, node) : NULL;
+}
+
+static void range_insert(struct ashmem_area *asma, struct ashmem_range *range)
+{
+	struct rb_node **p = &asma->unpinned_root.rb_node;
+	struct rb_node *parent = NULL;
+	struct ashmem_range *entry;
+
+	while (*p) {
+		parent = *p;
+		entry = rb_entry(parent, struct ashmem_range, node);
+		if (range->pgstart < entry->pgstart)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+
+	rb_link_node(&range->node, parent, p);
+	rb_insert_color(&range->node, &asma->unpinned_root);
+}
+
 /*
  * range_alloc - allocate and initialize a new ashmem_range structure
  *
  * 'asma' - associated ashmem_area
- * 'prev_range' - the previous ashmem_range in the sorted asma->unpinned list
  * 'purged' - initial purge value (ASMEM_NOT_PURGED or ASHMEM_WAS_PURGED)
  * 'start' - starting page, inclusive
  * 'end' - ending page, inclusive
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
-static int range_alloc(struct ashmem_area *asma,
-		       struct ashmem_range *prev_range, unsigned int purged,
+static int range_alloc(struct ashmem_area *asma, unsigned int purged,
 		       size_t start, size_t end)
 {
 	struct ashmem_range *range;
@@ -143,26 +207,33 @@ static int range_alloc(struct ashmem_area *asma,
 	range->pgend = end;
 	range->purged = purged;
 
-	list_add_tail(&range->unpinned, &prev_range->unpinned);
+	range_insert(asma, range);
 
-	if (range_on_lru(range))
+	if (range_on_lru(range)) {
+		spin_lock(&ashmem_lru_lock);
 		lru_add(range);
+		spin_unlock(&ashmem_lru_lock);
+	}
 
 	return 0;
 }
 
+/* Caller must hold range->asma->mutex. */
 static void range_del(struct ashmem_range *range)
 {
-	list_del(&range->unpinned);
-	if (range_on_lru(range))
+	rb_erase(&range->node, &range->asma->unpinned_root);
+	if (range_on_lru(range)) {
+		spin_lock(&ashmem_lru_lock);
 		lru_del(range);
+		spin_unlock(&ashmem_lru_lock);
+	}
 	kmem_cache_free(ashmem_range_cachep, range);
 }
 
 /*
  * range_shrink - shrinks a range
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static inline void range_shrink(struct ashmem_range *range,
 				size_t start, size_t end)
@@ -172,8 +243,18 @@ static inline void range_shrink(struct ashmem_range *range,
 	range->pgstart = start;
 	range->pgend = end;
 
-	if (range_on_lru(range))
+	if (range_on_lru(range)) {
+		spin_lock(&ashmem_lru_lock);
 		lru_count -= pre - range_size(range);
+		spin_unlock(&ashmem_lru_lock);
+	}
+}
+
+static void ashmem_area_free(struct kref *ref)
+{
+	struct ashmem_area *asma = container_of(ref, struct ashmem_area, ref);
+
+	kmem_cache_free(ashmem_area_cachep, asma);
 }
 
 static int ashmem_open(struct inode *inode, struct file *file)
@@ -189,7 +270,9 @@ static int ashmem_open(struct inode *inode, struct file *file)
 	if (unlikely(!asma))
 		return -ENOMEM;
 
-	INIT_LIST_HEAD(&asma->unpinned_list);
+	mutex_init(&asma->mutex);
+	kref_init(&asma->ref);
+	asma->unpinned_root = RB_ROOT;
 	memcpy(asma->name, ASHMEM_NAME_PREFIX, ASHMEM_NAME_PREFIX_LEN);
 	asma->prot_mask = PROT_MASK;
 	file->private_data = asma;
@@ -200,16 +283,16 @@ static int ashmem_open(struct inode *inode, struct file *file)
 static int ashmem_release(struct inode *ignored, struct file *file)
 {
 	struct ashmem_area *asma = file->private_data;
-	struct ashmem_range *range, *next;
+	struct rb_node *node;
 
-	mutex_lock(&ashmem_mutex);
-	list_for_each_entry_safe(range, next, &asma->unpinned_list, unpinned)
-		range_del(range);
-	mutex_unlock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
+	while ((node = rb_first(&asma->unpinned_root)))
+		range_del(rb_entry(node, struct ashmem_range, node));
+	mutex_unlock(&asma->mutex);
 
 	if (asma->file)
 		fput(asma->file);
-	kmem_cache_free(ashmem_area_cachep, asma);
+	kref_put(&asma->ref, ashmem_area_free);
 
 	return 0;
 }
@@ -220,7 +303,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* If size is not set, or set to 0, always return EOF. */
 	if (asma->size == 0)
@@ -231,7 +314,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 		goto out_unlock;
 	}
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	/*
 	 * asma and asma->file are used outside the lock here.  We assume
@@ -247,7 +330,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	return ret;
 
 out_unlock:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -256,7 +339,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	struct ashmem_area *asma = file->private_data;
 	int ret;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	if (asma->size == 0) {
 		ret = -EINVAL;
@@ -276,7 +359,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	file->f_pos = asma->file->f_pos;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -292,7 +375,7 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* user needs to SET_SIZE before mapping */
 	if (unlikely(!asma->size)) {
@@ -336,7 +419,7 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	asma->vm_start = vma->vm_start;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -353,11 +436,15 @@ out:
  *
  * We approximate LRU via least-recently-unpinned, jettisoning unpinned partial
  * chunks of ashmem regions LRU-wise one-at-a-time until we hit 'nr_to_scan'
- * pages freed.
+ * pages freed.  Only the area of the range being purged is locked, and
+ * ranges of areas that are busy pinning or unpinning are skipped.
  */
 static int ashmem_shrink(struct shrinker *s, struct shrink_control *sc)
 {
-	struct ashmem_range *range, *next;
+	struct ashmem_range *range;
+	struct ashmem_area *asma;
+	long nr_to_scan = sc->nr_to_scan;
+	int busy = 0;
 
 	/* We might recurse into filesystem code, so bail out if necessary */
 	if (sc->nr_to_scan && !(sc->gfp_mask & __GFP_FS))
@@ -365,23 +452,42 @@ static int ashmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	if (!sc->nr_to_scan)
 		return lru_count;
 
-	if (!mutex_trylock(&ashmem_mutex))
-		return -1;
+	spin_lock(&ashmem_lru_lock);
+	while (nr_to_scan > 0 && !list_empty(&ashmem_lru_list)) {
+		struct inode *inode;
+		loff_t start, end;
+
+		range = list_first_entry(&ashmem_lru_list,
+					 struct ashmem_range, lru);
+		asma = range->asma;
+
+		/* the owner may be allocating with it held, don't wait */
+		if (!mutex_trylock(&asma->mutex)) {
+			if (++busy >= ASHMEM_SHRINK_MAX_BUSY)
+				break;
+			list_move_tail(&range->lru, &ashmem_lru_list);
+			continue;
+		}
 
-	list_for_each_entry_safe(range, next, &ashmem_lru_list, lru) {
-		struct inode *inode = range->asma->file->f_dentry->d_inode;
-		loff_t start = range->pgstart * PAGE_SIZE;
-		loff_t end = (range->pgend + 1) * PAGE_SIZE - 1;
+		lru_del(range);
+		range->purged = ASHMEM_WAS_PURGED;
+		/* release() may free asma as soon as we unlock it */
+		kref_get(&asma->ref);
+		spin_unlock(&ashmem_lru_lock);
 
+		inode = asma->file->f_dentry->d_inode;
+		start = range->pgstart * PAGE_SIZE;
+		end = (range->pgend + 1) * PAGE_SIZE - 1;
 		vmtruncate_range(inode, start, end);
-		range->purged = ASHMEM_WAS_PURGED;
-		lru_del(range);
+		nr_to_scan -= range_size(range);
+
+		mutex_unlock(&asma->mutex);
+		kref_put(&asma->ref, ashmem_area_free);
 
-		sc->nr_to_scan -= range_size(range);
-		if (sc->nr_to_scan <= 0)
-			break;
+		cond_resched();
+		spin_lock(&ashmem_lru_lock);
 	}
-	mutex_unlock(&ashmem_mutex);
+	spin_unlock(&ashmem_lru_lock);
 
 	return lru_count;
 }
@@ -395,7 +501,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* the user can only remove, not add, protection bits */
 	if (unlikely((asma->prot_mask & prot) != prot)) {
@@ -410,7 +516,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 	asma->prot_mask = prot;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -421,10 +527,10 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 	char local_name[ASHMEM_NAME_LEN];
 
 	/*
-	 * Holding the ashmem_mutex while doing a copy_from_user might cause
+	 * Holding the asma->mutex while doing a copy_from_user might cause
 	 * an data abort which would try to access mmap_sem. If another
 	 * thread has invoked ashmem_mmap then it will be holding the
-	 * semaphore and will be waiting for ashmem_mutex, there by leading to
+	 * semaphore and will be waiting for asma->mutex, there by leading to
 	 * deadlock. We'll release the mutex  and take the name to a local
 	 * variable that does not need protection and later copy the local
 	 * variable to the structure member with lock held.
@@ -434,14 +540,14 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 		return len;
 	if (len == ASHMEM_NAME_LEN)
 		local_name[ASHMEM_NAME_LEN - 1] = '\0';
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 	/* cannot change an existing mapping's name */
 	if (unlikely(asma->file))
 		ret = -EINVAL;
 	else
 		strcpy(asma->name + ASHMEM_NAME_PREFIX_LEN, local_name);
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -457,7 +563,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 	 */
 	char local_name[ASHMEM_NAME_LEN];
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 	if (asma->name[ASHMEM_NAME_PREFIX_LEN] != '\0') {
 
 		/*
@@ -470,7 +576,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 		len = sizeof(ASHMEM_NAME_DEF);
 		memcpy(local_name, ASHMEM_NAME_DEF, len);
 	}
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	/*
 	 * Now we are just copying from the stack variable to userland
@@ -485,17 +591,17 @@ static int get_name(struct ashmem_area *asma, void __user *name)
  * ashmem_pin - pin the given ashmem region, returning whether it was
  * previously purged (ASHMEM_WAS_PURGED) or not (ASHMEM_NOT_PURGED).
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 {
 	struct ashmem_range *range, *next;
 	int ret = ASHMEM_NOT_PURGED;
 
-	list_for_each_entry_safe(range, next, &asma->unpinned_list, unpinned) {
-		/* moved past last applicable page; we can short circuit */
-		if (range_before_page(range, pgstart))
-			break;
+	/* every range visited overlaps the requested one */
+	for (range = range_first(asma, pgstart);
+	     range && range->pgstart <= pgend; range = next) {
+		next = range_next(range);
 
 		/*
 		 * The user can ask us to pin pages that span multiple ranges,
@@ -512,37 +618,34 @@ static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 		 *    so we have to update one side of the range and then
 		 *    create a new range for the other side.
 		 */
-		if (page_range_in_range(range, pgstart, pgend)) {
-			ret |= range->purged;
-
-			/* Case #1: Easy. Just nuke the whole thing. */
-			if (page_range_subsumes_range(range, pgstart, pgend)) {
-				range_del(range);
-				continue;
-			}
-
-			/* Case #2: We overlap from the start, so adjust it */
-			if (range->pgstart >= pgstart) {
-				range_shrink(range, pgend + 1, range->pgend);
-				continue;
-			}
-
-			/* Case #3: We overlap from the rear, so adjust it */
-			if (range->pgend <= pgend) {
-				range_shrink(range, range->pgstart, pgstart-1);
-				continue;
-			}
-
-			/*
-			 * Case #4: We eat a chunk out of the middle. A bit
-			 * more complicated, we allocate a new range for the
-			 * second half and adjust the first chunk's endpoint.
-			 */
-			range_alloc(asma, range, range->purged,
-				    pgend + 1, range->pgend);
-			range_shrink(range, range->pgstart, pgstart - 1);
-			break;
+		ret |= range->purged;
+
+		/* Case #1: Easy. Just nuke the whole thing. */
+		if (page_range_subsumes_range(range, pgstart, pgend)) {
+			range_del(range);
+			continue;
+		}
+
+		/* Case #2: We overlap from the start, so adjust it */
+		if (range->pgstart >= pgstart) {
+			range_shrink(range, pgend + 1, range->pgend);
+			continue;
 		}
+
+		/* Case #3: We overlap from the rear, so adjust it */
+		if (range->pgend <= pgend) {
+			range_shrink(range, range->pgstart, pgstart-1);
+			continue;
+		}
+
+		/*
+		 * Case #4: We eat a chunk out of the middle. A bit
+		 * more complicated, we allocate a new range for the
+		 * second half and adjust the first chunk's endpoint.
+		 */
+		range_alloc(asma, range->purged, pgend + 1, range->pgend);
+		range_shrink(range, range->pgstart, pgstart - 1);
+		break;
 	}
 
 	return ret;
@@ -551,18 +654,16 @@ static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 /*
  * ashmem_unpin - unpin the given range of pages. Returns zero on success.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_unpin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 {
 	struct ashmem_range *range, *next;
 	unsigned int purged = ASHMEM_NOT_PURGED;
 
-restart:
-	list_for_each_entry_safe(range, next, &asma->unpinned_list, unpinned) {
-		/* short circuit: this is our insertion point */
-		if (range_before_page(range, pgstart))
-			break;
+	for (range = range_first(asma, pgstart);
+	     range && range->pgstart <= pgend; range = next) {
+		next = range_next(range);
 
 		/*
 		 * The user can ask us to unpin pages that are already entirely
@@ -570,40 +671,32 @@ restart:
 		 */
 		if (page_range_subsumed_by_range(range, pgstart, pgend))
 			return 0;
-		if (page_range_in_range(range, pgstart, pgend)) {
-			pgstart = min_t(size_t, range->pgstart, pgstart),
-			pgend = max_t(size_t, range->pgend, pgend);
-			purged |= range->purged;
-			range_del(range);
-			goto restart;
-		}
+
+		/* the next range starts past this one, so it still applies */
+		pgstart = min_t(size_t, range->pgstart, pgstart),
+		pgend = max_t(size_t, range->pgend, pgend);
+		purged |= range->purged;
+		range_del(range);
 	}
 
-	return range_alloc(asma, range, purged, pgstart, pgend);
+	return range_alloc(asma, purged, pgstart, pgend);
 }
 
 /*
  * ashmem_get_pin_status - Returns ASHMEM_IS_UNPINNED if _any_ pages in the
  * given interval are unpinned and ASHMEM_IS_PINNED otherwise.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_get_pin_status(struct ashmem_area *asma, size_t pgstart,
 				 size_t pgend)
 {
-	struct ashmem_range *range;
-	int ret = ASHMEM_IS_PINNED;
-
-	list_for_each_entry(range, &asma->unpinned_list, unpinned) {
-		if (range_before_page(range, pgstart))
-			break;
-		if (page_range_in_range(range, pgstart, pgend)) {
-			ret = ASHMEM_IS_UNPINNED;
-			break;
-		}
-	}
+	struct ashmem_range *range = range_first(asma, pgstart);
 
-	return ret;
+	if (range && range->pgstart <= pgend)
+		return ASHMEM_IS_UNPINNED;
+
+	return ASHMEM_IS_PINNED;
 }
 
 static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
@@ -635,7 +728,7 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 	pgstart = pin.offset / PAGE_SIZE;
 	pgend = pgstart + (pin.len / PAGE_SIZE) - 1;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	switch (cmd) {
 	case ASHMEM_PIN:
@@ -649,7 +742,7 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 		break;
 	}
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	return ret;
 }
@@ -21,6 +21,7 @@
 #include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/list.h>
+#include <linux/math64.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
 #include <linux/module.h>
@@ -39,9 +40,13 @@
 
 #include "binder.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/binder.h>
+
 static DEFINE_MUTEX(binder_lock);
 static DEFINE_MUTEX(binder_deferred_lock);
 static DEFINE_MUTEX(binder_mmap_lock);
+static DECLARE_WAIT_QUEUE_HEAD(binder_tmp_ref_wait);
 
 static HLIST_HEAD(binder_procs);
 static HLIST_HEAD(binder_deferred_list);
@@ -110,6 +115,11 @@ module_param_named(debug_mask, binder_debug_mask, uint, S_IWUSR | S_IRUGO);
 static bool binder_debug_no_lock;
 module_param_named(proc_no_lock, binder_debug_no_lock, bool, S_IWUSR | S_IRUGO);
 
+/* log synchronous transactions slower than this, 0 to disable */
+static unsigned int binder_latency_threshold_ms;
+module_param_named(latency_threshold_ms, binder_latency_threshold_ms,
+		   uint, S_IWUSR | S_IRUGO);
+
 static DECLARE_WAIT_QUEUE_HEAD(binder_user_error_wait);
 static int binder_stop_on_user_error;
 
@@ -152,7 +162,7 @@ enum binder_stat_types {
 
 struct binder_stats {
 	int br[_IOC_NR(BR_FAILED_REPLY) + 1];
-	int bc[_IOC_NR(BC_DEAD_BINDER_DONE) + 1];
+	int bc[_IOC_NR(BC_REPLY_SG) + 1];
 	int obj_created[BINDER_STAT_COUNT];
 	int obj_deleted[BINDER_STAT_COUNT];
 };
@@ -215,6 +225,31 @@ struct binder_work {
 	} type;
 };
 
+/*
+ * log2 histogram of latencies in usecs: bucket 0 counts latencies below
+ * 1us, bucket i [2^(i-1), 2^i) us, and the last one everything above.
+ */
+#define BINDER_LAT_BUCKETS 22
+
+struct binder_lat_hist {
+	u32 count[BINDER_LAT_BUCKETS];
+};
+
+enum binder_lat_stage {
+	BINDER_LAT_COPY,	/* binder_transaction() until queued */
+	BINDER_LAT_QUEUE,	/* queued until picked up */
+	BINDER_LAT_THREAD_WAIT,	/* same, but no thread was waiting */
+	BINDER_LAT_EXEC,	/* picked up until the reply is sent */
+	BINDER_LAT_NR,
+};
+
+static const char * const binder_lat_stage_names[] = {
+	"copy",
+	"queue",
+	"thread_wait",
+	"exec",
+};
+
 struct binder_node {
 	int debug_id;
 	struct binder_work work;
@@ -237,6 +272,16 @@ struct binder_node {
 	unsigned accept_fds:1;
 	unsigned min_priority:8;
 	struct list_head async_todo;
+	struct binder_lat_hist exec_lat;
+};
+
+/*
+ * A scheduling policy together with a kernel priority (0 is the highest
+ * RT priority, MAX_RT_PRIO + 20 is nice 0).  Lower prio is better.
+ */
+struct binder_priority {
+	unsigned int sched_policy;
+	int prio;
 };
 
 struct binder_ref_death {
@@ -275,6 +320,7 @@ struct binder_buffer {
 	struct binder_node *target_node;
 	size_t data_size;
 	size_t offsets_size;
+	size_t extra_buffers_size;
 	uint8_t data[0];
 };
 
@@ -300,6 +346,13 @@ struct binder_proc {
 	void *buffer;
 	ptrdiff_t user_buffer_offset;
 
+	/*
+	 * alloc_lock protects the buffer allocator (buffers, free_buffers,
+	 * allocated_buffers, free_async_space and pages).  It nests inside
+	 * binder_lock but may also be taken on its own, so that buffer
+	 * allocation does not have to hold binder_lock.
+	 */
+	struct mutex alloc_lock;
 	struct list_head buffers;
 	struct rb_root free_buffers;
 	struct rb_root allocated_buffers;
@@ -316,8 +369,15 @@ struct binder_proc {
 	int requested_threads;
 	int requested_threads_started;
 	int ready_threads;
-	long default_priority;
+	struct binder_priority default_priority;
 	struct dentry *debugfs_entry;
+	/*
+	 * Transactions in flight to this proc that have dropped
+	 * binder_lock; release waits for tmp_ref to drop to zero.
+	 */
+	int tmp_ref;
+	bool is_dead;
+	struct binder_lat_hist lat[BINDER_LAT_NR];
 };
 
 enum {
@@ -358,9 +418,13 @@ struct binder_transaction {
 	struct binder_buffer *buffer;
 	unsigned int	code;
 	unsigned int	flags;
-	long	priority;
-	long	saved_priority;
+	struct binder_priority	priority;
+	struct binder_priority	saved_priority;
 	uid_t	sender_euid;
+	unsigned waited_for_thread:1;
+	u64	start_ts;	/* local_clock() at binder_transaction() */
+	u64	enqueue_ts;	/* ... when queued to the target */
+	u64	dequeue_ts;	/* ... when picked up by a target thread */
 };
 
 struct binder_stats_data {
@@ -540,6 +604,72 @@ static void binder_set_nice(long nice)
 	binder_user_error("binder: %d RLIMIT_NICE not set\n", current->pid);
 }
 
+static inline bool binder_is_rt_policy(unsigned int policy)
+{
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+static inline int binder_nice_to_prio(long nice)
+{
+	return MAX_RT_PRIO + 20 + nice;
+}
+
+static struct binder_priority binder_get_priority(struct task_struct *task)
+{
+	struct binder_priority p;
+
+	p.sched_policy = task->policy;
+	p.prio = task->normal_prio;
+	return p;
+}
+
+/*
+ * Switch current to the given policy and priority.  RT priorities are
+ * only ever lent by an RT caller, so they are applied without the
+ * RLIMIT_RTPRIO check; nice values still go through binder_set_nice().
+ */
+static void binder_set_priority(struct binder_priority desired)
+{
+	struct sched_param params;
+
+	if (binder_is_rt_policy(desired.sched_policy)) {
+		params.sched_priority = MAX_RT_PRIO - 1 - desired.prio;
+		if (current->policy != desired.sched_policy ||
+		    current->rt_priority != params.sched_priority)
+			sched_setscheduler_nocheck(current,
+						   desired.sched_policy,
+						   &params);
+		return;
+	}
+	if (current->policy != desired.sched_policy) {
+		params.sched_priority = 0;
+		sched_setscheduler_nocheck(current, desired.sched_policy,
+					   &params);
+	}
+	binder_set_nice(desired.prio - binder_nice_to_prio(0));
+}
+
+/*
+ * Run the thread picking up t at the caller's policy and priority, but
+ * never below the node's minimum priority.  One-way transactions only
+ * get the node's minimum, and only if that is an improvement.
+ */
+static void binder_transaction_priority(struct binder_transaction *t,
+					struct binder_node *node)
+{
+	struct binder_priority node_prio;
+
+	node_prio.sched_policy = SCHED_NORMAL;
+	node_prio.prio = binder_nice_to_prio(node->min_priority);
+
+	t->saved_priority = binder_get_priority(current);
+	if (!(t->flags & TF_ONE_WAY) && t->priority.prio < node_prio.prio)
+		binder_set_priority(t->priority);
+	else if (!(t->flags & TF_ONE_WAY) ||
+		 t->saved_priority.prio > node_prio.prio)
+		binder_set_priority(node_prio);
+}
+
 static size_t binder_buffer_size(struct binder_proc *proc,
 				 struct binder_buffer *buffer)
 {
@@ -608,8 +738,8 @@ static void binder_insert_allocated_buffer(struct binder_proc *proc,
 	rb_insert_color(&new_buffer->rb_node, &proc->allocated_buffers);
 }
 
-static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
-						  void __user *user_ptr)
+static struct binder_buffer *
+binder_buffer_lookup_locked(struct binder_proc *proc, void __user *user_ptr)
 {
 	struct rb_node *n = proc->allocated_buffers.rb_node;
 	struct binder_buffer *buffer;
@@ -632,6 +762,17 @@ static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
 	return NULL;
 }
 
+static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
+						  void __user *user_ptr)
+{
+	struct binder_buffer *buffer;
+
+	mutex_lock(&proc->alloc_lock);
+	buffer = binder_buffer_lookup_locked(proc, user_ptr);
+	mutex_unlock(&proc->alloc_lock);
+	return buffer;
+}
+
 static int binder_update_page_range(struct binder_proc *proc, int allocate,
 				    void *start, void *end,
 				    struct vm_area_struct *vma)
@@ -739,9 +880,11 @@ err_no_vma:
 	return -ENOMEM;
 }
 
-static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
-					      size_t data_size,
-					      size_t offsets_size, int is_async)
+static struct binder_buffer *binder_alloc_buf_locked(struct binder_proc *proc,
+						     size_t data_size,
+						     size_t offsets_size,
+						     size_t extra_buffers_size,
+						     int is_async)
 {
 	struct rb_node *n = proc->free_buffers.rb_node;
 	struct binder_buffer *buffer;
@@ -766,6 +909,13 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 			"size %zd-%zd\n", proc->pid, data_size, offsets_size);
 		return NULL;
 	}
+	size += ALIGN(extra_buffers_size, sizeof(void *));
+	if (size < extra_buffers_size) {
+		binder_user_error("binder: %d: got transaction with invalid "
+			"extra_buffers_size %zd\n", proc->pid,
+			extra_buffers_size);
+		return NULL;
+	}
 
 	if (is_async &&
 	    proc->free_async_space < size + sizeof(struct binder_buffer)) {
@@ -835,7 +985,11 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		     "%p\n", proc->pid, size, buffer);
 	buffer->data_size = data_size;
 	buffer->offsets_size = offsets_size;
+	buffer->extra_buffers_size = extra_buffers_size;
 	buffer->async_transaction = is_async;
+	buffer->allow_user_free = 0;
+	buffer->transaction = NULL;
+	buffer->target_node = NULL;
 	if (is_async) {
 		proc->free_async_space -= size + sizeof(struct binder_buffer);
 		binder_debug(BINDER_DEBUG_BUFFER_ALLOC_ASYNC,
@@ -847,6 +1001,21 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	return buffer;
 }
 
+static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
+					      size_t data_size,
+					      size_t offsets_size,
+					      size_t extra_buffers_size,
+					      int is_async)
+{
+	struct binder_buffer *buffer;
+
+	mutex_lock(&proc->alloc_lock);
+	buffer = binder_alloc_buf_locked(proc, data_size, offsets_size,
+					 extra_buffers_size, is_async);
+	mutex_unlock(&proc->alloc_lock);
+	return buffer;
+}
+
 static void *buffer_start_page(struct binder_buffer *buffer)
 {
 	return (void *)((uintptr_t)buffer & PAGE_MASK);
@@ -904,15 +1073,16 @@ static void binder_delete_free_buffer(struct binder_proc *proc,
 	}
 }
 
-static void binder_free_buf(struct binder_proc *proc,
-			    struct binder_buffer *buffer)
+static void binder_free_buf_locked(struct binder_proc *proc,
+				   struct binder_buffer *buffer)
 {
 	size_t size, buffer_size;
 
 	buffer_size = binder_buffer_size(proc, buffer);
 
 	size = ALIGN(buffer->data_size, sizeof(void *)) +
-		ALIGN(buffer->offsets_size, sizeof(void *));
+		ALIGN(buffer->offsets_size, sizeof(void *)) +
+		ALIGN(buffer->extra_buffers_size, sizeof(void *));
 
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "binder: %d: binder_free_buf %p size %zd buffer"
@@ -959,6 +1129,14 @@ static void binder_free_buf(struct binder_proc *proc,
 	binder_insert_free_buffer(proc, buffer);
 }
 
+static void binder_free_buf(struct binder_proc *proc,
+			    struct binder_buffer *buffer)
+{
+	mutex_lock(&proc->alloc_lock);
+	binder_free_buf_locked(proc, buffer);
+	mutex_unlock(&proc->alloc_lock);
+}
+
 static struct binder_node *binder_get_node(struct binder_proc *proc,
 					   void __user *ptr)
 {
@@ -1341,6 +1519,33 @@ static void binder_send_failed_reply(struct binder_transaction *t,
 	}
 }
 
+/*
+ * Check that a valid object starts at offset in buffer's data and return
+ * its size, or 0 if there is none.
+ */
+static size_t binder_validate_object(struct binder_buffer *buffer,
+				     size_t offset)
+{
+	struct flat_binder_object *fp;
+	size_t object_size;
+
+	if (buffer->data_size < sizeof(*fp) ||
+	    offset > buffer->data_size - sizeof(*fp) ||
+	    !IS_ALIGNED(offset, sizeof(void *)))
+		return 0;
+
+	fp = (struct flat_binder_object *)(buffer->data + offset);
+	if (fp->type == BINDER_TYPE_PTR)
+		object_size = sizeof(struct binder_buffer_object);
+	else
+		object_size = sizeof(*fp);
+	if (buffer->data_size < object_size ||
+	    offset > buffer->data_size - object_size)
+		return 0;
+
+	return object_size;
+}
+
 static void binder_transaction_buffer_release(struct binder_proc *proc,
 					      struct binder_buffer *buffer,
 					      size_t *failed_at)
@@ -1364,9 +1569,7 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 		off_end = (void *)offp + buffer->offsets_size;
 	for (; offp < off_end; offp++) {
 		struct flat_binder_object *fp;
-		if (*offp > buffer->data_size - sizeof(*fp) ||
-		    buffer->data_size < sizeof(*fp) ||
-		    !IS_ALIGNED(*offp, sizeof(void *))) {
+		if (!binder_validate_object(buffer, *offp)) {
 			binder_debug(BINDER_DEBUG_TOP_ERRORS,
 				     "binder: transaction release %d bad"
 				     "offset %zd, size %zd\n", debug_id,
@@ -1417,6 +1620,10 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 				task_close_fd(proc, fp->handle);
 			break;
 
+		case BINDER_TYPE_PTR:
+			/* lives in the buffer itself, nothing to release */
+			break;
+
 		default:
 			binder_debug(BINDER_DEBUG_TOP_ERRORS,
 				     "binder: transaction release %d bad "
@@ -1426,9 +1633,176 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 	}
 }
 
+static u64 binder_ts_delta(u64 start, u64 end)
+{
+	/* local_clock() can go slightly backwards across cpus */
+	return end > start ? end - start : 0;
+}
+
+static void binder_lat_add(struct binder_lat_hist *hist, u64 delta_ns)
+{
+	u64 us = div_u64(delta_ns, NSEC_PER_USEC);
+	int bucket = us ? fls64(us) : 0;
+
+	if (bucket >= BINDER_LAT_BUCKETS)
+		bucket = BINDER_LAT_BUCKETS - 1;
+	hist->count[bucket]++;
+}
+
+/* t has been picked up from the todo list by thread */
+static void binder_transaction_dequeued(struct binder_proc *proc,
+					struct binder_thread *thread,
+					struct binder_transaction *t)
+{
+	u64 queue_ns;
+
+	t->dequeue_ts = local_clock();
+	queue_ns = binder_ts_delta(t->enqueue_ts, t->dequeue_ts);
+	binder_lat_add(&proc->lat[t->waited_for_thread ?
+		       BINDER_LAT_THREAD_WAIT : BINDER_LAT_QUEUE], queue_ns);
+	trace_binder_transaction_received(t->debug_id, proc->pid,
+					  thread->pid, queue_ns,
+					  t->waited_for_thread);
+}
+
+/* thread in proc is replying to t, which came from thread 'from' */
+static void binder_transaction_done(struct binder_proc *proc,
+				    struct binder_thread *thread,
+				    struct binder_thread *from,
+				    struct binder_transaction *t, u64 now)
+{
+	u64 copy_ns = binder_ts_delta(t->start_ts, t->enqueue_ts);
+	u64 queue_ns = binder_ts_delta(t->enqueue_ts, t->dequeue_ts);
+	u64 exec_ns = binder_ts_delta(t->dequeue_ts, now);
+	u64 total_ns = binder_ts_delta(t->start_ts, now);
+
+	binder_lat_add(&proc->lat[BINDER_LAT_EXEC], exec_ns);
+	if (t->buffer && t->buffer->target_node)
+		binder_lat_add(&t->buffer->target_node->exec_lat, exec_ns);
+
+	trace_binder_transaction_done(t->debug_id, from->proc->pid, from->pid,
+				      proc->pid, thread->pid, copy_ns,
+				      queue_ns, exec_ns, total_ns);
+
+	if (binder_latency_threshold_ms &&
+	    total_ns > (u64)binder_latency_threshold_ms * NSEC_PER_MSEC)
+		printk_ratelimited(KERN_INFO "binder: transaction %d from "
+			"%d:%d to %d:%d took %llu us (copy %llu, queue %llu, "
+			"exec %llu)\n", t->debug_id, from->proc->pid,
+			from->pid, proc->pid, thread->pid,
+			div_u64(total_ns, NSEC_PER_USEC),
+			div_u64(copy_ns, NSEC_PER_USEC),
+			div_u64(queue_ns, NSEC_PER_USEC),
+			div_u64(exec_ns, NSEC_PER_USEC));
+}
+
+static void binder_proc_dec_tmpref(struct binder_proc *proc)
+{
+	proc->tmp_ref--;
+	if (proc->is_dead && !proc->tmp_ref)
+		wake_up(&binder_tmp_ref_wait);
+}
+
+/*
+ * Find the thread in target_proc that the synchronous transactions on
+ * thread's stack came from, so that a nested call goes back to it.
+ */
+static struct binder_thread *binder_stack_target_thread(
+				struct binder_thread *thread,
+				struct binder_proc *target_proc)
+{
+	struct binder_transaction *tmp;
+	struct binder_thread *target_thread = NULL;
+
+	for (tmp = thread->transaction_stack; tmp; tmp = tmp->from_parent) {
+		if (tmp->from && tmp->from->proc == target_proc)
+			target_thread = tmp->from;
+	}
+	return target_thread;
+}
+
+/*
+ * Copy the blocks described by the BINDER_TYPE_PTR objects in buffer
+ * into the space after its offsets array, and point the objects (and
+ * their parents, if they have one) at the copies in target_proc.
+ * Called without binder_lock; only buffer itself is touched.
+ */
+static int binder_copy_sg_buffers(struct binder_proc *proc,
+				  struct binder_thread *thread,
+				  struct binder_proc *target_proc,
+				  struct binder_buffer *buffer,
+				  size_t *off_start, size_t *off_end)
+{
+	size_t *offp;
+	size_t off_min = 0;
+	size_t object_size, len;
+	size_t sg_left = buffer->extra_buffers_size;
+	void *sg_bufp = (void *)off_start +
+			ALIGN(buffer->offsets_size, sizeof(void *));
+
+	for (offp = off_start; offp < off_end; offp++) {
+		struct binder_buffer_object *bp, *parent;
+		void *fixup;
+
+		object_size = binder_validate_object(buffer, *offp);
+		if (!object_size || *offp < off_min) {
+			binder_user_error("binder: %d:%d got transaction with "
+				"invalid offset, %zd\n",
+				proc->pid, thread->pid, *offp);
+			return -EINVAL;
+		}
+		off_min = *offp + object_size;
+		bp = (struct binder_buffer_object *)(buffer->data + *offp);
+		if (bp->type != BINDER_TYPE_PTR)
+			continue;
+
+		if (bp->length > sg_left) {
+			binder_user_error("binder: %d:%d got transaction with "
+				"too large sg buffer, %zd > %zd\n",
+				proc->pid, thread->pid, bp->length, sg_left);
+			return -EINVAL;
+		}
+		if (copy_from_user(sg_bufp, bp->buffer, bp->length)) {
+			binder_user_error("binder: %d:%d got transaction with "
+				"invalid sg buffer ptr\n",
+				proc->pid, thread->pid);
+			return -EFAULT;
+		}
+		bp->buffer = sg_bufp + target_proc->user_buffer_offset;
+		len = ALIGN(bp->length, sizeof(void *));
+		sg_bufp += len;
+		sg_left -= min(len, sg_left);
+
+		if (!(bp->flags & BINDER_BUFFER_FLAG_HAS_PARENT))
+			continue;
+		if (bp->parent >= offp - off_start) {
+			binder_user_error("binder: %d:%d got sg buffer with "
+				"invalid parent %zd\n",
+				proc->pid, thread->pid, bp->parent);
+			return -EINVAL;
+		}
+		parent = (struct binder_buffer_object *)
+			(buffer->data + off_start[bp->parent]);
+		if (parent->type != BINDER_TYPE_PTR ||
+		    parent->length < sizeof(void *) ||
+		    bp->parent_offset > parent->length - sizeof(void *) ||
+		    !IS_ALIGNED(bp->parent_offset, sizeof(void *))) {
+			binder_user_error("binder: %d:%d got sg buffer with "
+				"invalid parent offset %zd\n",
+				proc->pid, thread->pid, bp->parent_offset);
+			return -EINVAL;
+		}
+		fixup = parent->buffer - target_proc->user_buffer_offset +
+			bp->parent_offset;
+		*(void **)fixup = bp->buffer;
+	}
+	return 0;
+}
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
-			       struct binder_transaction_data *tr, int reply)
+			       struct binder_transaction_data *tr, int reply,
+			       size_t extra_buffers_size)
 {
 	struct binder_transaction *t;
 	struct binder_work *tcomplete;
@@ -1442,6 +1816,7 @@ static void binder_transaction(struct binder_proc *proc,
 	struct binder_transaction *in_reply_to = NULL;
 	struct binder_transaction_log_entry *e;
 	uint32_t return_error;
+	u64 start_ts = local_clock();
 
 	e = binder_transaction_log_add(&binder_transaction_log);
 	e->call_type = reply ? 2 : !!(tr->flags & TF_ONE_WAY);
@@ -1460,7 +1835,7 @@ static void binder_transaction(struct binder_proc *proc,
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
-		binder_set_nice(in_reply_to->saved_priority);
+		binder_set_priority(in_reply_to->saved_priority);
 		if (in_reply_to->to_thread != thread) {
 			binder_user_error("binder: %d:%d got reply transaction "
 				"with bad transaction stack,"
@@ -1537,20 +1912,13 @@ static void binder_transaction(struct binder_proc *proc,
 				return_error = BR_FAILED_REPLY;
 				goto err_bad_call_stack;
 			}
-			while (tmp) {
-				if (tmp->from && tmp->from->proc == target_proc)
-					target_thread = tmp->from;
-				tmp = tmp->from_parent;
-			}
+			target_thread = binder_stack_target_thread(thread,
+								   target_proc);
 		}
 	}
-	if (target_thread) {
-		e->to_thread = target_thread->pid;
-		target_list = &target_thread->todo;
-		target_wait = &target_thread->wait;
-	} else {
-		target_list = &target_proc->todo;
-		target_wait = &target_proc->wait;
+	if (target_proc->is_dead) {
+		return_error = BR_DEAD_REPLY;
+		goto err_dead_binder;
 	}
 	e->to_proc = target_proc->pid;
 
@@ -1570,6 +1938,7 @@ static void binder_transaction(struct binder_proc *proc,
 	binder_stats_created(BINDER_STAT_TRANSACTION_COMPLETE);
 
 	t->debug_id = ++binder_last_id;
+	t->start_ts = start_ts;
 	e->debug_id = t->debug_id;
 
 	if (reply)
@@ -1595,34 +1964,54 @@ static void binder_transaction(struct binder_proc *proc,
 		t->from = NULL;
 	t->sender_euid = proc->tsk->cred->euid;
 	t->to_proc = target_proc;
-	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
-	t->priority = task_nice(current);
+	t->priority = binder_get_priority(current);
+	if (!binder_is_rt_policy(t->priority.sched_policy))
+		t->priority.sched_policy = SCHED_NORMAL;
+
+	/*
+	 * Allocating the buffer may have to map pages under the target's
+	 * mmap_sem, and copying the payload may fault on the sender's
+	 * pages, so do both without binder_lock.  The tmp_ref keeps
+	 * target_proc (and its buffer space) from being released, and the
+	 * node reference that the buffer holds keeps target_node alive.
+	 * Our own thread and its transaction stack cannot go away, but
+	 * the threads on the stack can, so the target thread is looked up
+	 * again once binder_lock has been retaken.
+	 */
+	target_proc->tmp_ref++;
+	if (target_node)
+		binder_inc_node(target_node, 1, 0, NULL);
+	mutex_unlock(&binder_lock);
+
 	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
-		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
+		tr->offsets_size, extra_buffers_size,
+		!reply && (t->flags & TF_ONE_WAY));
 	if (t->buffer == NULL) {
+		mutex_lock(&binder_lock);
+		if (target_node)
+			binder_dec_node(target_node, 1, 0);
 		return_error = BR_FAILED_REPLY;
 		goto err_binder_alloc_buf_failed;
 	}
-	t->buffer->allow_user_free = 0;
 	t->buffer->debug_id = t->debug_id;
 	t->buffer->transaction = t;
 	t->buffer->target_node = target_node;
-	if (target_node)
-		binder_inc_node(target_node, 1, 0, NULL);
 
 	offp = (size_t *)(t->buffer->data + ALIGN(tr->data_size, sizeof(void *)));
 
 	if (copy_from_user(t->buffer->data, tr->data.ptr.buffer, tr->data_size)) {
 		binder_user_error("binder: %d:%d got transaction with invalid "
 			"data ptr\n", proc->pid, thread->pid);
+		mutex_lock(&binder_lock);
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
 	if (copy_from_user(offp, tr->data.ptr.offsets, tr->offsets_size)) {
 		binder_user_error("binder: %d:%d got transaction with invalid "
 			"offsets ptr\n", proc->pid, thread->pid);
+		mutex_lock(&binder_lock);
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
@@ -1630,17 +2019,54 @@ static void binder_transaction(struct binder_proc *proc,
 		binder_user_error("binder: %d:%d got transaction with "
 			"invalid offsets size, %zd\n",
 			proc->pid, thread->pid, tr->offsets_size);
+		mutex_lock(&binder_lock);
 		return_error = BR_FAILED_REPLY;
 		goto err_bad_offset;
 	}
 	off_end = (void *)offp + tr->offsets_size;
+	if (extra_buffers_size &&
+	    binder_copy_sg_buffers(proc, thread, target_proc, t->buffer,
+				   offp, off_end)) {
+		mutex_lock(&binder_lock);
+		return_error = BR_FAILED_REPLY;
+		goto err_bad_offset;
+	}
+	mutex_lock(&binder_lock);
+
+	if (target_proc->is_dead) {
+		return_error = BR_DEAD_REPLY;
+		goto err_dead_target;
+	}
+	if (reply) {
+		if (in_reply_to->from != target_thread) {
+			return_error = BR_DEAD_REPLY;
+			goto err_dead_target;
+		}
+		if (target_thread->transaction_stack != in_reply_to) {
+			return_error = BR_FAILED_REPLY;
+			in_reply_to = NULL;
+			goto err_dead_target;
+		}
+	} else if (!(tr->flags & TF_ONE_WAY) && thread->transaction_stack) {
+		target_thread = binder_stack_target_thread(thread,
+							   target_proc);
+	}
+	if (target_thread) {
+		e->to_thread = target_thread->pid;
+		target_list = &target_thread->todo;
+		target_wait = &target_thread->wait;
+	} else {
+		target_list = &target_proc->todo;
+		target_wait = &target_proc->wait;
+	}
+	t->to_thread = target_thread;
+
 	off_min = 0;
 	for (; offp < off_end; offp++) {
 		struct flat_binder_object *fp;
-		if (*offp > t->buffer->data_size - sizeof(*fp) ||
-		    *offp < off_min ||
-		    t->buffer->data_size < sizeof(*fp) ||
-		    !IS_ALIGNED(*offp, sizeof(void *))) {
+		size_t object_size = binder_validate_object(t->buffer, *offp);
+
+		if (!object_size || *offp < off_min) {
 			binder_user_error("%d:%d got transaction with invalid offset, %lld (min %lld, max %lld)\n",
 					  proc->pid, thread->pid, (u64)*offp,
 					  (u64)off_min,
@@ -1650,7 +2076,7 @@ static void binder_transaction(struct binder_proc *proc,
 			goto err_bad_offset;
 		}
 		fp = (struct flat_binder_object *)(t->buffer->data + *offp);
-		off_min = *offp + sizeof(struct flat_binder_object);
+		off_min = *offp + object_size;
 		switch (fp->type) {
 		case BINDER_TYPE_BINDER:
 		case BINDER_TYPE_WEAK_BINDER: {
@@ -1795,6 +2221,16 @@ static void binder_transaction(struct binder_proc *proc,
 			fp->handle = target_fd;
 		} break;
 
+		case BINDER_TYPE_PTR:
+			/* already copied by binder_copy_sg_buffers() */
+			if (extra_buffers_size)
+				break;
+			binder_user_error("binder: %d:%d got sg buffer object "
+				"in a transaction without sg buffers\n",
+				proc->pid, thread->pid);
+			return_error = BR_FAILED_REPLY;
+			goto err_bad_object_type;
+
 		default:
 			binder_user_error("binder: %d:%d got transactio"
 				"n with invalid object type, %lx\n",
@@ -1803,8 +2239,18 @@ static void binder_transaction(struct binder_proc *proc,
 			goto err_bad_object_type;
 		}
 	}
+	t->enqueue_ts = local_clock();
+	t->waited_for_thread = !target_thread && !target_proc->ready_threads;
+	binder_lat_add(&target_proc->lat[BINDER_LAT_COPY],
+		       binder_ts_delta(t->start_ts, t->enqueue_ts));
+	trace_binder_transaction(t->debug_id, reply, t->flags, t->code,
+				 proc->pid, thread->pid, target_proc->pid,
+				 target_thread ? target_thread->pid : 0,
+				 binder_ts_delta(t->start_ts, t->enqueue_ts));
 	if (reply) {
 		BUG_ON(t->buffer->async_transaction != 0);
+		binder_transaction_done(proc, thread, target_thread,
+					in_reply_to, t->start_ts);
 		binder_pop_transaction(target_thread, in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
@@ -1826,6 +2272,7 @@ static void binder_transaction(struct binder_proc *proc,
 	list_add_tail(&tcomplete->entry, &thread->todo);
 	if (target_wait)
 		wake_up_interruptible(target_wait);
+	binder_proc_dec_tmpref(target_proc);
 	return;
 
 err_get_unused_fd_failed:
@@ -1836,11 +2283,13 @@ err_binder_get_ref_failed:
 err_binder_new_node_failed:
 err_bad_object_type:
 err_bad_offset:
+err_dead_target:
 err_copy_data_failed:
 	binder_transaction_buffer_release(target_proc, t->buffer, offp);
 	t->buffer->transaction = NULL;
 	binder_free_buf(target_proc, t->buffer);
 err_binder_alloc_buf_failed:
+	binder_proc_dec_tmpref(target_proc);
 	kfree(tcomplete);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
 err_alloc_tcomplete_failed:
@@ -2071,7 +2520,19 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			if (copy_from_user(&tr, ptr, sizeof(tr)))
 				return -EFAULT;
 			ptr += sizeof(tr);
-			binder_transaction(proc, thread, &tr, cmd == BC_REPLY);
+			binder_transaction(proc, thread, &tr, cmd == BC_REPLY, 0);
+			break;
+		}
+
+		case BC_TRANSACTION_SG:
+		case BC_REPLY_SG: {
+			struct binder_transaction_data_sg tr;
+
+			if (copy_from_user(&tr, ptr, sizeof(tr)))
+				return -EFAULT;
+			ptr += sizeof(tr);
+			binder_transaction(proc, thread, &tr.transaction_data,
+					   cmd == BC_REPLY_SG, tr.buffers_size);
 			break;
 		}
 
@@ -2344,7 +2805,7 @@ retry:
 			wait_event_interruptible(binder_user_error_wait,
 						 binder_stop_on_user_error < 2);
 		}
-		binder_set_nice(proc->default_priority);
+		binder_set_priority(proc->default_priority);
 		if (non_block) {
 			if (!binder_has_proc_work(proc, thread))
 				ret = -EAGAIN;
@@ -2503,17 +2964,12 @@ retry:
 			continue;
 
 		BUG_ON(t->buffer == NULL);
+		binder_transaction_dequeued(proc, thread, t);
 		if (t->buffer->target_node) {
 			struct binder_node *target_node = t->buffer->target_node;
 			tr.target.ptr = target_node->ptr;
 			tr.cookie =  target_node->cookie;
-			t->saved_priority = task_nice(current);
-			if (t->priority < target_node->min_priority &&
-			    !(t->flags & TF_ONE_WAY))
-				binder_set_nice(t->priority);
-			else if (!(t->flags & TF_ONE_WAY) ||
-				 t->saved_priority > target_node->min_priority)
-				binder_set_nice(target_node->min_priority);
+			binder_transaction_priority(t, target_node);
 			cmd = BR_TRANSACTION;
 		} else {
 			tr.target.ptr = NULL;
@@ -3083,7 +3539,8 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	proc->tsk = current;
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
-	proc->default_priority = task_nice(current);
+	mutex_init(&proc->alloc_lock);
+	proc->default_priority = binder_get_priority(current);
 	mutex_lock(&binder_lock);
 	binder_stats_created(BINDER_STAT_PROC);
 	hlist_add_head(&proc->proc_node, &binder_procs);
@@ -3297,8 +3754,20 @@ static void binder_deferred_func(struct work_struct *work)
 		if (defer & BINDER_DEFERRED_FLUSH)
 			binder_deferred_flush(proc);
 
-		if (defer & BINDER_DEFERRED_RELEASE)
+		if (defer & BINDER_DEFERRED_RELEASE) {
+			/*
+			 * Transactions that are copying into this proc's
+			 * buffers without binder_lock must finish first.
+			 */
+			proc->is_dead = true;
+			while (proc->tmp_ref) {
+				mutex_unlock(&binder_lock);
+				wait_event(binder_tmp_ref_wait,
+					   !ACCESS_ONCE(proc->tmp_ref));
+				mutex_lock(&binder_lock);
+			}
 			binder_deferred_release(proc); /* frees proc */
+		}
 
 		mutex_unlock(&binder_lock);
 		if (files)
@@ -3324,13 +3793,14 @@ static void print_binder_transaction(struct seq_file *m, const char *prefix,
 				     struct binder_transaction *t)
 {
 	seq_printf(m,
-		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %ld r%d",
+		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %u:%d r%d",
 		   prefix, t->debug_id, t,
 		   t->from ? t->from->proc->pid : 0,
 		   t->from ? t->from->pid : 0,
 		   t->to_proc ? t->to_proc->pid : 0,
 		   t->to_thread ? t->to_thread->pid : 0,
-		   t->code, t->flags, t->priority, t->need_reply);
+		   t->code, t->flags, t->priority.sched_policy,
+		   t->priority.prio, t->need_reply);
 	if (t->buffer == NULL) {
 		seq_puts(m, " buffer free\n");
 		return;
@@ -3346,9 +3816,10 @@ static void print_binder_transaction(struct seq_file *m, const char *prefix,
 static void print_binder_buffer(struct seq_file *m, const char *prefix,
 				struct binder_buffer *buffer)
 {
-	seq_printf(m, "%s %d: %p size %zd:%zd %s\n",
+	seq_printf(m, "%s %d: %p size %zd:%zd:%zd %s\n",
 		   prefix, buffer->debug_id, buffer->data,
 		   buffer->data_size, buffer->offsets_size,
+		   buffer->extra_buffers_size,
 		   buffer->transaction ? "active" : "delivered");
 }
 
@@ -3481,9 +3952,11 @@ static void print_binder_proc(struct seq_file *m,
 			print_binder_ref(m, rb_entry(n, struct binder_ref,
 						     rb_node_desc));
 	}
+	mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		print_binder_buffer(m, "  buffer",
 				    rb_entry(n, struct binder_buffer, rb_node));
+	mutex_unlock(&proc->alloc_lock);
 	list_for_each_entry(w, &proc->todo, entry)
 		print_binder_work(m, "  ", "  pending transaction", w);
 	list_for_each_entry(w, &proc->delivered_death, entry) {
@@ -3532,7 +4005,9 @@ static const char *binder_command_strings[] = {
 	"BC_EXIT_LOOPER",
 	"BC_REQUEST_DEATH_NOTIFICATION",
 	"BC_CLEAR_DEATH_NOTIFICATION",
-	"BC_DEAD_BINDER_DONE"
+	"BC_DEAD_BINDER_DONE",
+	"BC_TRANSACTION_SG",
+	"BC_REPLY_SG"
 };
 
 static const char *binder_objstat_strings[] = {
@@ -3613,8 +4088,10 @@ static void print_binder_proc_stats(struct seq_file *m,
 	seq_printf(m, "  refs: %d s %d w %d\n", count, strong, weak);
 
 	count = 0;
+	mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		count++;
+	mutex_unlock(&proc->alloc_lock);
 	seq_printf(m, "  buffers: %d\n", count);
 
 	count = 0;
@@ -3835,13 +4312,16 @@ static int print_binder_proc_sub(struct seq_file *m, struct binder_proc *proc,
 			return 0;
 		}
 
+	mutex_lock(&proc->alloc_lock);
 	for (r = rb_first(&proc->allocated_buffers); r; r = rb_next(r))
 		if (cnt-- == 0) {
 			struct binder_buffer *b;
 			b = rb_entry(r, struct binder_buffer, rb_node);
 			print_binder_buffer(m, "  buffer", b);
+			mutex_unlock(&proc->alloc_lock);
 			return 0;
 		}
+	mutex_unlock(&proc->alloc_lock);
 
 	list_for_each_entry(w, &proc->todo, entry)
 		if (cnt-- == 0) {
@@ -3932,6 +4412,58 @@ static int binder_proc_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static void print_binder_lat_hist(struct seq_file *m, const char *prefix,
+				  struct binder_lat_hist *hist)
+{
+	int i, last = -1;
+
+	for (i = 0; i < BINDER_LAT_BUCKETS; i++)
+		if (hist->count[i])
+			last = i;
+	if (last < 0)
+		return;
+
+	seq_printf(m, "%s", prefix);
+	for (i = 0; i <= last; i++)
+		seq_printf(m, " %lu:%u", i ? 1UL << (i - 1) : 0UL,
+			   hist->count[i]);
+	seq_puts(m, "\n");
+}
+
+static int binder_latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_proc *proc;
+	struct hlist_node *pos;
+	struct rb_node *n;
+	char prefix[32];
+	int do_lock = !binder_debug_no_lock;
+	int i;
+
+	if (do_lock)
+		mutex_lock(&binder_lock);
+
+	seq_puts(m, "binder latency (usecs:count, log2 buckets):\n");
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node) {
+		seq_printf(m, "proc %d\n", proc->pid);
+		for (i = 0; i < BINDER_LAT_NR; i++) {
+			snprintf(prefix, sizeof(prefix), "  %s:",
+				 binder_lat_stage_names[i]);
+			print_binder_lat_hist(m, prefix, &proc->lat[i]);
+		}
+		for (n = rb_first(&proc->nodes); n != NULL; n = rb_next(n)) {
+			struct binder_node *node = rb_entry(n,
+						struct binder_node, rb_node);
+
+			snprintf(prefix, sizeof(prefix), "  node %d exec:",
+				 node->debug_id);
+			print_binder_lat_hist(m, prefix, &node->exec_lat);
+		}
+	}
+	if (do_lock)
+		mutex_unlock(&binder_lock);
+	return 0;
+}
+
 static void print_binder_transaction_log_entry(struct seq_file *m,
 					struct binder_transaction_log_entry *e)
 {
@@ -3975,6 +4507,7 @@ static struct miscdevice binder_miscdev = {
 
 BINDER_DEBUG_ENTRY(transactions);
 BINDER_DEBUG_ENTRY(transaction_log);
+BINDER_DEBUG_ENTRY(latency);
 
 static const struct seq_operations binder_stats_seq_ops = {
 	.start = binder_stats_seq_start,
@@ -4105,6 +4638,11 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    &binder_transaction_log_failed,
 				    &binder_transaction_log_fops);
+		debugfs_create_file("latency",
+				    S_IRUGO,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_latency_fops);
 	}
 	return ret;
 }
@@ -32,6 +32,7 @@ enum {
 	BINDER_TYPE_HANDLE	= B_PACK_CHARS('s', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_WEAK_HANDLE	= B_PACK_CHARS('w', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_FD		= B_PACK_CHARS('f', 'd', '*', B_TYPE_LARGE),
+	BINDER_TYPE_PTR		= B_PACK_CHARS('p', 't', '*', B_TYPE_LARGE),
 };
 
 enum {
@@ -61,6 +62,33 @@ struct flat_binder_object {
 	void			*cookie;
 };
 
+enum {
+	BINDER_BUFFER_FLAG_HAS_PARENT = 0x01,
+};
+
+/*
+ * A BINDER_TYPE_PTR object describes a block of sender memory that the
+ * driver copies straight into the target's buffer, after the offsets
+ * array, instead of it being flattened into the transaction data first.
+ * 'buffer' is rewritten to the block's address in the target.
+ *
+ * If BINDER_BUFFER_FLAG_HAS_PARENT is set, 'parent' is the index in the
+ * offsets array of an earlier BINDER_TYPE_PTR object, and the pointer at
+ * 'parent_offset' (which must be pointer aligned) inside that object's
+ * block is patched to point at the copy of this one.
+ *
+ * The total size of all blocks, each rounded up to pointer size, is
+ * passed as buffers_size with BC_TRANSACTION_SG or BC_REPLY_SG.
+ */
+struct binder_buffer_object {
+	unsigned long		type;
+	unsigned long		flags;
+	void			*buffer;
+	size_t			length;
+	size_t			parent;
+	size_t			parent_offset;
+};
+
 /*
  * On 64-bit platforms where user code may run in 32-bits the driver must
  * translate the buffer (and local binder) addresses apropriately.
@@ -153,6 +181,11 @@ struct binder_transaction_data {
 	} data;
 };
 
+struct binder_transaction_data_sg {
+	struct binder_transaction_data transaction_data;
+	size_t	buffers_size;	/* number of bytes of BINDER_TYPE_PTR data */
+};
+
 struct binder_ptr_cookie {
 	void *ptr;
 	void *cookie;
@@ -330,6 +363,13 @@ enum BinderDriverCommandProtocol {
 	/*
 	 * void *: cookie
 	 */
+
+	BC_TRANSACTION_SG = _IOW('c', 17, struct binder_transaction_data_sg),
+	BC_REPLY_SG = _IOW('c', 18, struct binder_transaction_data_sg),
+	/*
+	 * binder_transaction_data_sg: the sent command, followed by the
+	 * size of the scatter-gather buffers it carries.
+	 */
 };
 
 #endif /* _LINUX_BINDER_H */
@@ -27,6 +27,8 @@
 #include <linux/slab.h>
 #include <linux/time.h>
 #include <linux/interrupt.h>
+#include <linux/percpu.h>
+#include <linux/lz4.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
@@ -39,6 +41,66 @@ static DEFINE_SPINLOCK(log_lock);
 static struct work_struct write_console_wq;
 static struct tasklet_struct schedule_work_tasklet;
 
+#ifdef CONFIG_ANDROID_LOGGER_PERCPU_STAGING
+/* must hold at least one maximum sized entry */
+#define LOGGER_STAGE_SIZE	8192
+
+/*
+ * struct logger_stage - per-cpu buffer that writers append entries to
+ *
+ * Writers only take 'lock' of the cpu they happen to run on.  The log
+ * swaps 'buf' and 'spare' under 'lock' when it wants the entries, and
+ * then merges 'spare' into the log under log->mutex.
+ */
+struct logger_stage {
+	struct mutex	lock;		/* protects buf and used */
+	unsigned char	*buf;		/* entries being appended */
+	size_t		used;
+	unsigned char	*spare;		/* entries being merged */
+	size_t		spare_len;
+	size_t		spare_off;
+};
+#endif
+
+#ifdef CONFIG_ANDROID_LOGGER_HISTORY
+/* uncompressed size of one history chunk, holds a maximum sized entry */
+#define LOGGER_CHUNK_SIZE	(16 * 1024)
+#define LOGGER_HISTORY_SIZE	(CONFIG_ANDROID_LOGGER_HISTORY_SIZE * 1024)
+
+/*
+ * struct logger_chunk - a run of entries overwritten in the ring, compressed
+ *
+ * Positions count the bytes of entries ever moved into the history, so
+ * they keep growing while chunks come and go.
+ */
+struct logger_chunk {
+	struct list_head	list;	/* entry in logger_history's chunks */
+	u64			start;	/* position of the first entry */
+	u32			len;	/* uncompressed length */
+	u32			clen;	/* compressed length */
+	unsigned char		data[];
+};
+
+/*
+ * struct logger_history - entries that fell off the start of the ring
+ *
+ * Entries are collected in 'stage' and compressed into a chunk once it is
+ * full.  Everything between 'start' and 'end' can be read back: the
+ * chunks hold [start, end - stage_len), 'stage' holds the rest.  Protected
+ * by log->mutex.
+ */
+struct logger_history {
+	struct list_head	chunks;	/* oldest first */
+	size_t			bytes;	/* memory used by chunks */
+	u64			start;	/* oldest position still held */
+	u64			end;	/* position of the ring's head */
+	unsigned char		*stage;
+	size_t			stage_len;
+	void			*wrkmem; /* lz4 compression state */
+	unsigned char		*cbuf;	/* compression output */
+};
+#endif
+
 /*
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  *
@@ -56,6 +118,12 @@ struct logger_log {
 	size_t			head;	/* new readers start here */
 	size_t			size;	/* size of the log */
 	struct logger_log	*log_bottom; /* bottom section of the log */
+#ifdef CONFIG_ANDROID_LOGGER_PERCPU_STAGING
+	struct logger_stage __percpu *stage; /* per-cpu writer buffers */
+#endif
+#ifdef CONFIG_ANDROID_LOGGER_HISTORY
+	struct logger_history	*history; /* compressed overwritten entries */
+#endif
 };
 
 /*
@@ -70,9 +138,19 @@ struct logger_reader {
 	size_t			r_off;	/* current read head offset */
 	bool			r_all;	/* reader can read all entries */
 	int			r_ver;	/* reader ABI version */
+#ifdef CONFIG_ANDROID_LOGGER_HISTORY
+	bool			r_archive; /* still reading the history */
+	u64			a_pos;	/* current history read position */
+	unsigned char		*a_buf;	/* last chunk decompressed */
+	u64			a_buf_start; /* start of the chunk in a_buf */
+#endif
 };
 
 static void update_log_from_bottom_locked(struct logger_log *log_dst);
+static void logger_flush_stage_locked(struct logger_log *log);
+static bool logger_stage_pending(struct logger_log *log);
+static void logger_history_add(struct logger_log *log, size_t off,
+			       size_t end);
 
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
 size_t logger_offset(struct logger_log *log, size_t n)
@@ -275,10 +353,14 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 start:
 	while (1) {
 		mutex_lock(&log->mutex);
+		logger_flush_stage_locked(log);
 
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
-		ret = (log->w_off == reader->r_off);
+		/* writers staging after the flush wake us up again */
+		ret = (log->w_off == reader->r_off) &&
+			!logger_stage_pending(log) &&
+			!logger_history_pending(reader);
 		mutex_unlock(&log->mutex);
 		if (!ret)
 			break;
@@ -303,6 +385,12 @@ start:
 	mutex_lock(&log->mutex);
 
 	update_log_from_bottom_locked(log);
+	logger_flush_stage_locked(log);
+
+	/* entries overwritten in the ring come first */
+	ret = logger_read_history(log, reader, buf, count);
+	if (ret)
+		goto out;
 
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
@@ -394,8 +482,12 @@ static void fix_up_readers(struct logger_log *log, size_t len)
 	size_t new = logger_offset(log, old + len);
 	struct logger_reader *reader;
 
-	if (is_between(old, new, log->head))
-		log->head = get_next_entry(log, log->head, len);
+	if (is_between(old, new, log->head)) {
+		size_t head = get_next_entry(log, log->head, len);
+
+		logger_history_add(log, log->head, head);
+		log->head = head;
+	}
 
 	list_for_each_entry(reader, &log->readers, list)
 		if (is_between(old, new, reader->r_off))
@@ -453,6 +545,505 @@ static ssize_t do_write_log_from_user(struct logger_log *log,
 	return count;
 }
 
+#ifdef CONFIG_ANDROID_LOGGER_PERCPU_STAGING
+/*
+ * logger_flush_stage_locked - merge the entries staged by writers on all
+ * cpus into 'log', oldest first.
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void logger_flush_stage_locked(struct logger_log *log)
+{
+	struct logger_stage *stage, *best;
+	struct logger_entry *entry, *best_entry;
+	unsigned char *tmp;
+	bool staged = false;
+	int cpu;
+
+	if (!log->stage)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		stage = per_cpu_ptr(log->stage, cpu);
+		if (!ACCESS_ONCE(stage->used))
+			continue;
+
+		mutex_lock(&stage->lock);
+		tmp = stage->spare;
+		stage->spare = stage->buf;
+		stage->buf = tmp;
+		stage->spare_len = stage->used;
+		stage->spare_off = 0;
+		stage->used = 0;
+		mutex_unlock(&stage->lock);
+		staged = true;
+	}
+	if (!staged)
+		return;
+
+	while (1) {
+		size_t len;
+
+		best = NULL;
+		best_entry = NULL;
+		for_each_possible_cpu(cpu) {
+			stage = per_cpu_ptr(log->stage, cpu);
+			if (stage->spare_off >= stage->spare_len)
+				continue;
+
+			entry = (struct logger_entry *)
+				(stage->spare + stage->spare_off);
+			if (!best || entry->sec < best_entry->sec ||
+			    (entry->sec == best_entry->sec &&
+			     entry->nsec < best_entry->nsec)) {
+				best = stage;
+				best_entry = entry;
+			}
+		}
+		if (!best)
+			break;
+
+		len = sizeof(struct logger_entry) + best_entry->len;
+		fix_up_readers(log, len);
+		do_write_log(log, best_entry, len);
+		best->spare_off += ALIGN(len, sizeof(u32));
+	}
+}
+
+/* are there entries staged that have not been merged into 'log'? */
+static bool logger_stage_pending(struct logger_log *log)
+{
+	int cpu;
+
+	if (!log->stage)
+		return false;
+
+	for_each_possible_cpu(cpu)
+		if (ACCESS_ONCE(per_cpu_ptr(log->stage, cpu)->used))
+			return true;
+	return false;
+}
+
+static void logger_flush_stage(struct logger_log *log)
+{
+	mutex_lock(&log->mutex);
+	logger_flush_stage_locked(log);
+	mutex_unlock(&log->mutex);
+
+	wake_up_interruptible(&log->wq);
+}
+
+/*
+ * logger_stage_write - append an entry to the current cpu's staging
+ * buffer.  Migrating to another cpu in the middle is harmless, the
+ * buffer is only used to spread writers out.
+ */
+static ssize_t logger_stage_write(struct logger_log *log,
+				  struct logger_entry *header,
+				  const struct iovec *iov,
+				  unsigned long nr_segs)
+{
+	struct logger_stage *stage;
+	struct timespec now;
+	size_t need = ALIGN(sizeof(struct logger_entry) + header->len,
+			    sizeof(u32));
+	unsigned char *msg;
+	size_t copied = 0;
+
+	while (1) {
+		stage = per_cpu_ptr(log->stage, raw_smp_processor_id());
+		mutex_lock(&stage->lock);
+		if (stage->used + need <= LOGGER_STAGE_SIZE)
+			break;
+		mutex_unlock(&stage->lock);
+		logger_flush_stage(log);
+	}
+
+	/* stamp under the lock so each staging buffer stays sorted */
+	getnstimeofday(&now);
+	header->sec = now.tv_sec;
+	header->nsec = now.tv_nsec;
+
+	memcpy(stage->buf + stage->used, header, sizeof(struct logger_entry));
+	msg = stage->buf + stage->used + sizeof(struct logger_entry);
+
+	while (nr_segs-- > 0 && copied < header->len) {
+		size_t len = min_t(size_t, iov->iov_len, header->len - copied);
+
+		/* abandon the whole entry, as do_write_log_from_user() does */
+		if (len && copy_from_user(msg + copied, iov->iov_base, len)) {
+			mutex_unlock(&stage->lock);
+			return -EFAULT;
+		}
+		copied += len;
+		iov++;
+	}
+
+	stage->used += need;
+	mutex_unlock(&stage->lock);
+
+	/* wake up any blocked readers, they merge the entry in */
+	wake_up_interruptible(&log->wq);
+
+	return copied;
+}
+
+static void __init logger_init_stage(struct logger_log *log)
+{
+	struct logger_stage *stage;
+	int cpu;
+
+	log->stage = alloc_percpu(struct logger_stage);
+	if (!log->stage)
+		goto fail;
+
+	for_each_possible_cpu(cpu) {
+		stage = per_cpu_ptr(log->stage, cpu);
+		mutex_init(&stage->lock);
+		stage->buf = kmalloc(LOGGER_STAGE_SIZE, GFP_KERNEL);
+		stage->spare = kmalloc(LOGGER_STAGE_SIZE, GFP_KERNEL);
+		if (!stage->buf || !stage->spare)
+			goto fail_free;
+	}
+	return;
+
+fail_free:
+	for_each_possible_cpu(cpu) {
+		stage = per_cpu_ptr(log->stage, cpu);
+		kfree(stage->buf);
+		kfree(stage->spare);
+	}
+	free_percpu(log->stage);
+	log->stage = NULL;
+fail:
+	printk(KERN_WARNING "logger: no staging buffers for log '%s'\n",
+	       log->misc.name);
+}
+#else
+static inline void logger_flush_stage_locked(struct logger_log *log)
+{
+}
+
+static inline bool logger_stage_pending(struct logger_log *log)
+{
+	return false;
+}
+
+static inline void logger_init_stage(struct logger_log *log)
+{
+}
+#endif
+
+#ifdef CONFIG_ANDROID_LOGGER_HISTORY
+static void logger_history_drop(struct logger_history *hist)
+{
+	struct logger_chunk *chunk, *tmp;
+
+	list_for_each_entry_safe(chunk, tmp, &hist->chunks, list) {
+		list_del(&chunk->list);
+		kfree(chunk);
+	}
+	hist->bytes = 0;
+	hist->stage_len = 0;
+	hist->start = hist->end;
+}
+
+/*
+ * logger_history_seal - compress the staged entries into a new chunk and
+ * drop the oldest chunks that no longer fit the budget.
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void logger_history_seal(struct logger_history *hist)
+{
+	struct logger_chunk *chunk = NULL;
+	size_t clen;
+
+	if (!hist->stage_len)
+		return;
+
+	if (!lz4_compress(hist->stage, hist->stage_len, hist->cbuf, &clen,
+			  hist->wrkmem))
+		chunk = kmalloc(sizeof(*chunk) + clen, GFP_KERNEL);
+	if (!chunk) {
+		/* the history must not have holes, start over */
+		logger_history_drop(hist);
+		return;
+	}
+
+	chunk->start = hist->end - hist->stage_len;
+	chunk->len = hist->stage_len;
+	chunk->clen = clen;
+	memcpy(chunk->data, hist->cbuf, clen);
+	list_add_tail(&chunk->list, &hist->chunks);
+	hist->bytes += sizeof(*chunk) + clen;
+	hist->stage_len = 0;
+
+	while (hist->bytes > LOGGER_HISTORY_SIZE) {
+		chunk = list_first_entry(&hist->chunks, struct logger_chunk,
+					 list);
+		list_del(&chunk->list);
+		hist->bytes -= sizeof(*chunk) + chunk->clen;
+		kfree(chunk);
+
+		if (list_empty(&hist->chunks))
+			hist->start = hist->end;
+		else
+			hist->start = list_first_entry(&hist->chunks,
+					struct logger_chunk, list)->start;
+	}
+}
+
+/*
+ * logger_history_add - move the entries in [off, end) of the ring, which
+ * are about to be overwritten, into the history.
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void logger_history_add(struct logger_log *log, size_t off,
+			       size_t end)
+{
+	struct logger_history *hist = log->history;
+
+	if (!hist)
+		return;
+
+	while (off != end) {
+		size_t len = sizeof(struct logger_entry) +
+			get_entry_msg_len(log, off);
+		size_t part = min(len, log->size - off);
+
+		if (hist->stage_len + len > LOGGER_CHUNK_SIZE)
+			logger_history_seal(hist);
+
+		memcpy(hist->stage + hist->stage_len, log->buffer + off, part);
+		if (part != len)
+			memcpy(hist->stage + hist->stage_len + part,
+			       log->buffer, len - part);
+		hist->stage_len += len;
+		hist->end += len;
+
+		off = logger_offset(log, off + len);
+	}
+}
+
+/*
+ * logger_history_entry - returns the history entry at the reader's
+ * position, decompressing its chunk if needed, or NULL if the chunk
+ * cannot be read back.
+ */
+static struct logger_entry *logger_history_entry(struct logger_history *hist,
+						 struct logger_reader *reader)
+{
+	u64 stage_start = hist->end - hist->stage_len;
+	struct logger_chunk *chunk;
+	size_t len;
+
+	if (reader->a_pos >= stage_start)
+		return (struct logger_entry *)
+			(hist->stage + (size_t)(reader->a_pos - stage_start));
+
+	list_for_each_entry(chunk, &hist->chunks, list)
+		if (reader->a_pos < chunk->start + chunk->len)
+			break;
+
+	if (reader->a_buf_start != chunk->start) {
+		if (!reader->a_buf)
+			reader->a_buf = kmalloc(LOGGER_CHUNK_SIZE, GFP_KERNEL);
+		if (!reader->a_buf)
+			return NULL;
+
+		len = LOGGER_CHUNK_SIZE;
+		if (lz4_decompress_unknownoutputsize(chunk->data, chunk->clen,
+						     reader->a_buf, &len) ||
+		    len != chunk->len) {
+			reader->a_buf_start = ~0ULL;
+			reader->a_pos = chunk->start + chunk->len;
+			return NULL;
+		}
+		reader->a_buf_start = chunk->start;
+	}
+
+	return (struct logger_entry *)
+		(reader->a_buf + (size_t)(reader->a_pos - chunk->start));
+}
+
+/*
+ * logger_history_next - returns the next history entry 'reader' may read.
+ * Once the reader has caught up with the ring it continues from the head
+ * of the ring and NULL is returned.
+ *
+ * The caller needs to hold log->mutex.
+ */
+static struct logger_entry *logger_history_next(struct logger_log *log,
+						struct logger_reader *reader)
+{
+	struct logger_history *hist = log->history;
+	struct logger_entry *entry;
+
+	while (reader->r_archive) {
+		/* lapped by the history itself, or it was flushed */
+		if (reader->a_pos < hist->start)
+			reader->a_pos = hist->start;
+
+		if (reader->a_pos >= hist->end) {
+			reader->r_archive = false;
+			reader->r_off = log->head;
+			break;
+		}
+
+		entry = logger_history_entry(hist, reader);
+		if (!entry) {
+			if (!reader->a_buf)
+				reader->a_pos = hist->end;
+			continue;
+		}
+
+		if (reader->r_all || entry->euid == current_euid())
+			return entry;
+
+		reader->a_pos += sizeof(struct logger_entry) + entry->len;
+	}
+
+	return NULL;
+}
+
+static inline bool logger_history_pending(struct logger_reader *reader)
+{
+	return reader->r_archive;
+}
+
+/*
+ * logger_read_history - reads the next history entry into 'buf'. Returns
+ * zero if the reader has caught up with the ring.
+ *
+ * The caller needs to hold log->mutex.
+ */
+static ssize_t logger_read_history(struct logger_log *log,
+				   struct logger_reader *reader,
+				   char __user *buf, size_t count)
+{
+	struct logger_entry *entry;
+	size_t hdr_len = get_user_hdr_len(reader->r_ver);
+	ssize_t ret;
+
+	entry = logger_history_next(log, reader);
+	if (!entry)
+		return 0;
+
+	ret = hdr_len + entry->len;
+	if (count < ret)
+		return -EINVAL;
+
+	if (copy_header_to_user(reader->r_ver, entry, buf) ||
+	    copy_to_user(buf + hdr_len, (void *) entry +
+			 sizeof(struct logger_entry), entry->len))
+		return -EFAULT;
+
+	reader->a_pos += sizeof(struct logger_entry) + entry->len;
+
+	return ret;
+}
+
+/* new readers start with the oldest entry in the history */
+static void logger_history_open(struct logger_log *log,
+				struct logger_reader *reader)
+{
+	struct logger_history *hist = log->history;
+
+	reader->r_archive = hist && hist->start != hist->end;
+	reader->a_pos = hist ? hist->start : 0;
+	reader->a_buf = NULL;
+	reader->a_buf_start = ~0ULL;
+}
+
+static void logger_history_release(struct logger_reader *reader)
+{
+	kfree(reader->a_buf);
+}
+
+/* The caller needs to hold log->mutex. */
+static void logger_history_flush(struct logger_log *log)
+{
+	struct logger_reader *reader;
+
+	if (!log->history)
+		return;
+
+	logger_history_drop(log->history);
+	list_for_each_entry(reader, &log->readers, list)
+		reader->r_archive = false;
+}
+
+static void __init logger_init_history(struct logger_log *log)
+{
+	struct logger_history *hist;
+
+	hist = kzalloc(sizeof(*hist), GFP_KERNEL);
+	if (!hist)
+		goto fail;
+
+	INIT_LIST_HEAD(&hist->chunks);
+	hist->stage = kmalloc(LOGGER_CHUNK_SIZE, GFP_KERNEL);
+	hist->wrkmem = kmalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
+	hist->cbuf = kmalloc(lz4_compressbound(LOGGER_CHUNK_SIZE), GFP_KERNEL);
+	if (!hist->stage || !hist->wrkmem || !hist->cbuf)
+		goto fail_free;
+
+	log->history = hist;
+	return;
+
+fail_free:
+	kfree(hist->stage);
+	kfree(hist->wrkmem);
+	kfree(hist->cbuf);
+	kfree(hist);
+fail:
+	printk(KERN_WARNING "logger: no history for log '%s'\n",
+	       log->misc.name);
+}
+#else
+static inline void logger_history_add(struct logger_log *log, size_t off,
+				      size_t end)
+{
+}
+
+static inline struct logger_entry *logger_history_next(struct logger_log *log,
+					struct logger_reader *reader)
+{
+	return NULL;
+}
+
+static inline bool logger_history_pending(struct logger_reader *reader)
+{
+	return false;
+}
+
+static inline ssize_t logger_read_history(struct logger_log *log,
+					  struct logger_reader *reader,
+					  char __user *buf, size_t count)
+{
+	return 0;
+}
+
+static inline void logger_history_open(struct logger_log *log,
+				       struct logger_reader *reader)
+{
+}
+
+static inline void logger_history_release(struct logger_reader *reader)
+{
+}
+
+static inline void logger_history_flush(struct logger_log *log)
+{
+}
+
+static inline void logger_init_history(struct logger_log *log)
+{
+}
+#endif
+
 /*
  * logger_aio_write - our write method, implementing support for write(),
  * writev(), and aio_write(). Writes are our fast path, and we try to optimize
@@ -481,6 +1072,11 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
+#ifdef CONFIG_ANDROID_LOGGER_PERCPU_STAGING
+	if (log->stage)
+		return logger_stage_write(log, &header, iov, nr_segs);
+#endif
+
 	mutex_lock(&log->mutex);
 
 	/*
@@ -556,6 +1152,7 @@ static int logger_open(struct inode *inode, struct file *file)
 
 		mutex_lock(&log->mutex);
 		reader->r_off = log->head;
+		logger_history_open(log, reader);
 		list_add_tail(&reader->list, &log->readers);
 		mutex_unlock(&log->mutex);
 
@@ -581,6 +1178,7 @@ static int logger_release(struct inode *ignored, struct file *file)
 		list_del(&reader->list);
 		mutex_unlock(&log->mutex);
 
+		logger_history_release(reader);
 		kfree(reader);
 	}
 
@@ -611,11 +1209,12 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 	poll_wait(file, &log->wq, wait);
 
 	mutex_lock(&log->mutex);
+	logger_flush_stage_locked(log);
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
 			reader->r_off, current_euid());
 
-	if (log->w_off != reader->r_off)
+	if (log->w_off != reader->r_off || logger_history_pending(reader))
 		ret |= POLLIN | POLLRDNORM;
 	mutex_unlock(&log->mutex);
 
@@ -639,10 +1238,12 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct logger_log *log = file_get_log(file);
 	struct logger_reader *reader;
+	struct logger_entry *entry;
 	long ret = -EINVAL;
 	void __user *argp = (void __user *) arg;
 
 	mutex_lock(&log->mutex);
+	logger_flush_stage_locked(log);
 
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
@@ -666,6 +1267,12 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		}
 		reader = file->private_data;
 
+		entry = logger_history_next(log, reader);
+		if (entry) {
+			ret = get_user_hdr_len(reader->r_ver) + entry->len;
+			break;
+		}
+
 		if (!reader->r_all)
 			reader->r_off = get_next_entry_by_uid(log,
 				reader->r_off, current_euid());
@@ -684,6 +1291,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		list_for_each_entry(reader, &log->readers, list)
 			reader->r_off = log->w_off;
 		log->head = log->w_off;
+		logger_history_flush(log);
 		ret = 0;
 		break;
 	case LOGGER_GET_VERSION:
@@ -908,6 +1516,7 @@ static int init_log_kernel_bottom(void)
 
 	mutex_lock(&log->mutex);
 	reader->r_off = log->head;
+	logger_history_open(log, reader);
 	list_add_tail(&reader->list, &log->readers);
 	mutex_unlock(&log->mutex);
 	return 0;
@@ -917,6 +1526,8 @@ static int __init init_log(struct logger_log *log)
 {
 	int ret;
 
+	logger_init_stage(log);
+
 	ret = misc_register(&log->misc);
 	if (unlikely(ret)) {
 		printk(KERN_ERR "logger: failed to register misc "
@@ -934,6 +1545,12 @@ static int __init logger_init(void)
 {
 	int ret;
 
+	/* log_kernel is also written under log_lock, keep it out */
+	logger_init_history(&log_main);
+	logger_init_history(&log_events);
+	logger_init_history(&log_radio);
+	logger_init_history(&log_system);
+
 	ret = init_log(&log_main);
 	if (unlikely(ret))
 		goto out;
@@ -51,6 +51,12 @@
 #include <linux/cpuset.h>
 #include <linux/show_mem_notifier.h>
 #include <linux/vmpressure.h>
+#include <linux/kthread.h>
+#include <linux/wait.h>
+#include <linux/hugetlb.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <trace/events/memkill.h>
 #define CREATE_TRACE_POINTS
@@ -132,6 +138,92 @@ int adjust_minadj(short *min_score_adj)
 	return ret;
 }
 
+/*
+ * Kill path statistics. The last vmpressure event and the last victim
+ * are only updated under scan_mutex, apart from the event time which
+ * is a plain snapshot.
+ */
+static unsigned long lmk_last_pressure;
+static ktime_t lmk_last_pressure_time;
+
+static struct {
+	pid_t tgid;
+	unsigned long rss;	/* pages at kill time */
+	ktime_t time;
+	bool pending;		/* not seen releasing its memory yet */
+} lmk_victim;
+
+/* log2 histograms, bucket i counts values in [2^(i-1), 2^i) */
+#define LMK_HIST_BUCKETS	16
+
+enum lmk_hist_type {
+	LMK_HIST_PRESSURE_TO_KILL,	/* ms */
+	LMK_HIST_SCAN,			/* us */
+	LMK_HIST_KILL_TO_FREE,		/* ms */
+	LMK_HIST_FREED,			/* pages */
+	NR_LMK_HIST,
+};
+
+static const char * const lmk_hist_names[NR_LMK_HIST] = {
+	"pressure_to_kill_ms",
+	"scan_us",
+	"kill_to_free_ms",
+	"freed_pages",
+};
+
+static atomic_t lmk_hist[NR_LMK_HIST][LMK_HIST_BUCKETS];
+
+static void lmk_hist_add(enum lmk_hist_type type, s64 val)
+{
+	int bucket = 0;
+
+	if (val > 0)
+		bucket = min_t(int, fls64(val), LMK_HIST_BUCKETS - 1);
+	atomic_inc(&lmk_hist[type][bucket]);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int lmk_hist_show(struct seq_file *m, void *unused)
+{
+	int i, j;
+
+	for (i = 0; i < NR_LMK_HIST; i++) {
+		seq_printf(m, "%s:", lmk_hist_names[i]);
+		for (j = 0; j < LMK_HIST_BUCKETS; j++)
+			seq_printf(m, " %d", atomic_read(&lmk_hist[i][j]));
+		seq_putc(m, '\n');
+	}
+
+	return 0;
+}
+
+static int lmk_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lmk_hist_show, NULL);
+}
+
+static const struct file_operations lmk_hist_fops = {
+	.open		= lmk_hist_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void lmk_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("lowmemorykiller", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+	debugfs_create_file("histogram", S_IRUGO, dir, NULL, &lmk_hist_fops);
+}
+#else
+static inline void lmk_debugfs_init(void)
+{
+}
+#endif
+
 static int lmk_vmpressure_notifier(struct notifier_block *nb,
 			unsigned long action, void *data)
 {
@@ -139,6 +231,9 @@ static int lmk_vmpressure_notifier(struct notifier_block *nb,
 	unsigned long pressure = action;
 	int array_size = ARRAY_SIZE(lowmem_adj);
 
+	lmk_last_pressure = pressure;
+	lmk_last_pressure_time = ktime_get();
+
 	if (!enable_adaptive_lmk)
 		return 0;
 
@@ -206,6 +301,71 @@ static int test_task_flag(struct task_struct *p, int flag)
 
 static DEFINE_MUTEX(scan_mutex);
 
+/* Record the kill of @p, called with scan_mutex held */
+static void lmk_victim_killed(struct task_struct *p, short adj,
+			      unsigned long rss, int minfree, s64 scan_us)
+{
+	ktime_t now = ktime_get();
+	unsigned long swap = 0;
+	s64 pressure_us = -1;
+	struct task_struct *t;
+
+	t = find_lock_task_mm(p);
+	if (t) {
+		swap = get_mm_counter(t->mm, MM_SWAPENTS);
+		task_unlock(t);
+	}
+
+	if (lmk_last_pressure_time.tv64) {
+		pressure_us = ktime_us_delta(now, lmk_last_pressure_time);
+		lmk_hist_add(LMK_HIST_PRESSURE_TO_KILL, pressure_us / 1000);
+	}
+	lmk_hist_add(LMK_HIST_SCAN, scan_us);
+	trace_almk_kill(p->pid, adj, rss, swap, lmk_last_pressure,
+			pressure_us, minfree, scan_us);
+
+	lmk_victim.tgid = p->tgid;
+	lmk_victim.rss = rss;
+	lmk_victim.time = now;
+	lmk_victim.pending = true;
+}
+
+/*
+ * Account the memory the last victim gave back once it has been reaped
+ * or has released its mm. Called with scan_mutex held and a reference
+ * on @tsk.
+ */
+static void lmk_victim_check(struct task_struct *tsk)
+{
+	struct task_struct *p;
+	unsigned long rss = 0, freed = 0;
+	s64 kill_us;
+	int released;
+
+	if (!lmk_victim.pending || tsk->tgid != lmk_victim.tgid)
+		return;
+
+	rcu_read_lock();
+	released = test_task_flag(tsk, TIF_MM_RELEASED);
+	rcu_read_unlock();
+	if (!released)
+		return;
+
+	p = find_lock_task_mm(tsk);
+	if (p) {
+		rss = get_mm_rss(p->mm);
+		task_unlock(p);
+	}
+	if (lmk_victim.rss > rss)
+		freed = lmk_victim.rss - rss;
+
+	kill_us = ktime_us_delta(ktime_get(), lmk_victim.time);
+	lmk_hist_add(LMK_HIST_KILL_TO_FREE, kill_us / 1000);
+	lmk_hist_add(LMK_HIST_FREED, freed);
+	trace_almk_freed(tsk->pid, freed, kill_us);
+	lmk_victim.pending = false;
+}
+
 int can_use_cma_pages(gfp_t gfp_mask)
 {
 	int can_use = 0;
@@ -407,6 +567,213 @@ static struct task_struct *pick_first_task(void);
 static struct task_struct *pick_last_task(void);
 #endif
 
+#ifdef CONFIG_ANDROID_LMK_REAPER
+/*
+ * A killed task only frees its memory once it gets a CPU and runs
+ * exit_mmap(). The reaper thread unmaps the private memory of each
+ * victim right away, and lowmem_shrink() waits for that to happen
+ * instead of picking further victims in the meantime.
+ */
+#define LMK_REAP_QUEUE		8
+#define LMK_REAP_RETRIES	10
+/* Upper bound lowmem_shrink() waits on a single victim */
+#define LMK_REAP_WAIT		(HZ / 10)
+
+static struct task_struct *lmk_reaper_th;
+static DECLARE_WAIT_QUEUE_HEAD(lmk_reaper_wait);
+static DECLARE_WAIT_QUEUE_HEAD(lmk_reaped_wait);
+static DEFINE_SPINLOCK(lmk_reap_lock);
+static struct task_struct *lmk_reap_queue[LMK_REAP_QUEUE];
+static unsigned int lmk_reap_head, lmk_reap_tail;
+
+/* Is @mm also used by a process that is not being killed? */
+static bool lmk_mm_shared(struct mm_struct *mm, struct task_struct *tsk)
+{
+	struct task_struct *p;
+	bool ret = false;
+
+	rcu_read_lock();
+	for_each_process(p) {
+		if (same_thread_group(p, tsk) || (p->flags & PF_KTHREAD))
+			continue;
+		if (p->mm == mm && !fatal_signal_pending(p)) {
+			ret = true;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+
+static bool lmk_reap_mm(struct task_struct *tsk)
+{
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	struct task_struct *p;
+
+	p = find_lock_task_mm(tsk);
+	if (!p)
+		return true;
+	mm = p->mm;
+	if (!atomic_inc_not_zero(&mm->mm_users)) {
+		task_unlock(p);
+		return true;
+	}
+	task_unlock(p);
+
+	if (lmk_mm_shared(mm, tsk)) {
+		mmput(mm);
+		return true;
+	}
+
+	if (!down_read_trylock(&mm->mmap_sem)) {
+		mmput(mm);
+		return false;
+	}
+
+	/*
+	 * The victim may still be in a syscall: make its faults fail from
+	 * now on rather than silently refill what is zapped below.
+	 */
+	set_bit(MMF_UNSTABLE, &mm->flags);
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (is_vm_hugetlb_page(vma))
+			continue;
+		if (vma->vm_flags & (VM_LOCKED | VM_SPECIAL))
+			continue;
+		/* Shared mappings would not free anything */
+		if (vma->vm_flags & VM_SHARED)
+			continue;
+		zap_page_range(vma, vma->vm_start,
+			       vma->vm_end - vma->vm_start, NULL);
+	}
+	up_read(&mm->mmap_sem);
+
+	lowmem_print(2, "reaped '%s' (%d), now anon-rss %lukB\n",
+		     tsk->comm, tsk->pid,
+		     get_mm_counter(mm, MM_ANONPAGES) * (PAGE_SIZE / 1024));
+	mmput(mm);
+	return true;
+}
+
+static struct task_struct *lmk_reap_dequeue(void)
+{
+	struct task_struct *tsk = NULL;
+
+	spin_lock(&lmk_reap_lock);
+	if (lmk_reap_head != lmk_reap_tail) {
+		tsk = lmk_reap_queue[lmk_reap_tail % LMK_REAP_QUEUE];
+		lmk_reap_tail++;
+	}
+	spin_unlock(&lmk_reap_lock);
+
+	return tsk;
+}
+
+static int lmk_reaper(void *unused)
+{
+	while (!kthread_should_stop()) {
+		struct task_struct *tsk;
+		int attempts = 0;
+
+		wait_event_interruptible(lmk_reaper_wait,
+					 lmk_reap_head != lmk_reap_tail ||
+					 kthread_should_stop());
+
+		tsk = lmk_reap_dequeue();
+		if (!tsk)
+			continue;
+
+		/* The victim may hold mmap_sem for a short while */
+		while (!lmk_reap_mm(tsk) && ++attempts < LMK_REAP_RETRIES)
+			schedule_timeout_uninterruptible(HZ / 100);
+
+		/* Mark the victim as done even if mmap_sem stayed busy */
+		set_tsk_thread_flag(tsk, TIF_MM_RELEASED);
+		put_task_struct(tsk);
+		wake_up_all(&lmk_reaped_wait);
+	}
+
+	return 0;
+}
+
+static void lmk_queue_reap(struct task_struct *tsk)
+{
+	bool queued = false;
+
+	if (!lmk_reaper_th)
+		return;
+
+	spin_lock(&lmk_reap_lock);
+	if (lmk_reap_head - lmk_reap_tail < LMK_REAP_QUEUE) {
+		get_task_struct(tsk);
+		lmk_reap_queue[lmk_reap_head % LMK_REAP_QUEUE] = tsk;
+		lmk_reap_head++;
+		queued = true;
+	}
+	spin_unlock(&lmk_reap_lock);
+
+	if (queued)
+		wake_up(&lmk_reaper_wait);
+}
+
+/*
+ * Wait until the memory of @tsk has been reaped or released by exit. The
+ * caller holds a reference on @tsk.
+ */
+static void lmk_wait_reaped(struct task_struct *tsk)
+{
+	long timeout = LMK_REAP_WAIT;
+
+	if (time_before(lowmem_deathpending_timeout, jiffies + timeout))
+		timeout = max_t(long, lowmem_deathpending_timeout - jiffies, 1);
+
+	wait_event_timeout(lmk_reaped_wait,
+			   test_tsk_thread_flag(tsk, TIF_MM_RELEASED), timeout);
+}
+
+static void lmk_reaper_init(void)
+{
+	lmk_reaper_th = kthread_run(lmk_reaper, NULL, "lmk_reaper");
+	if (IS_ERR(lmk_reaper_th)) {
+		pr_err("failed to start lmk_reaper\n");
+		lmk_reaper_th = NULL;
+	}
+}
+
+static void lmk_reaper_exit(void)
+{
+	struct task_struct *tsk;
+
+	if (!lmk_reaper_th)
+		return;
+
+	kthread_stop(lmk_reaper_th);
+	while ((tsk = lmk_reap_dequeue()))
+		put_task_struct(tsk);
+}
+#else
+static inline void lmk_queue_reap(struct task_struct *tsk)
+{
+}
+
+static inline void lmk_wait_reaped(struct task_struct *tsk)
+{
+	/* give the system time to free up the memory */
+	msleep_interruptible(20);
+}
+
+static inline void lmk_reaper_init(void)
+{
+}
+
+static inline void lmk_reaper_exit(void)
+{
+}
+#endif
+
 static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 {
 	struct task_struct *tsk;
@@ -424,6 +791,8 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	int other_file;
 	unsigned long nr_to_scan = sc->nr_to_scan;
 	struct zone_avail zall[MAX_NUMNODES][MAX_NR_ZONES];
+	ktime_t scan_start;
+	s64 scan_us;
 
 	rcu_read_lock();
 	tsk = current->group_leader;
@@ -499,6 +868,7 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	}
 	selected_oom_score_adj = min_score_adj;
 
+	scan_start = ktime_get();
 	rcu_read_lock();
 
 #ifdef CONFIG_ANDROID_LMK_ADJ_RBTREE
@@ -520,13 +890,15 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 
 		if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
 			if (test_task_flag(tsk, TIF_MEMDIE)) {
+				get_task_struct(tsk);
 				rcu_read_unlock();
-				/* give the system time to free up the memory */
-				if (!same_thread_group(current, tsk))
-					msleep_interruptible(20);
-				else
+				if (!same_thread_group(current, tsk)) {
+					lmk_wait_reaped(tsk);
+					lmk_victim_check(tsk);
+				} else
 					set_tsk_thread_flag(current,
 								TIF_MEMDIE);
+				put_task_struct(tsk);
 				mutex_unlock(&scan_mutex);
 				return 0;
 			}
@@ -580,6 +952,7 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		lowmem_print(3, "select '%s' (%d), adj %hd, size %d, to kill\n",
 			     p->comm, p->pid, oom_score_adj, tasksize);
 	}
+	scan_us = ktime_us_delta(ktime_get(), scan_start);
 	if (selected) {
 		int i, j;
 		char zinfo[ZINFO_LENGTH];
@@ -648,9 +1021,14 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		set_tsk_thread_flag(selected, TIF_MEMDIE);
 		send_sig(SIGKILL, selected, 0);
 		rem -= selected_tasksize;
+		get_task_struct(selected);
 		rcu_read_unlock();
-		/* give the system time to free up the memory */
-		msleep_interruptible(20);
+		lmk_victim_killed(selected, selected_oom_score_adj,
+				  selected_tasksize, minfree, scan_us);
+		lmk_queue_reap(selected);
+		lmk_wait_reaped(selected);
+		lmk_victim_check(selected);
+		put_task_struct(selected);
 		trace_almk_shrink(selected_tasksize, ret,
 			other_free, other_file, selected_oom_score_adj);
 	} else {
@@ -696,12 +1074,15 @@ static int __init lowmem_init(void)
 					&tsk_migration_nb);
 #endif
 	vmpressure_notifier_register(&lmk_vmpr_nb);
+	lmk_reaper_init();
+	lmk_debugfs_init();
 	return 0;
 }
 
 static void __exit lowmem_exit(void)
 {
 	unregister_shrinker(&lowmem_shrinker);
+	lmk_reaper_exit();
 #ifdef CONFIG_ANDROID_BG_SCAN_MEM
 	raw_notifier_chain_unregister(&bgtsk_migration_notifier_head,
 					&tsk_migration_nb);
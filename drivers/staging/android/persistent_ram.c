@@ -20,10 +20,14 @@
 #include <linux/io.h>
 #include <linux/list.h>
 #include <linux/memblock.h>
+#include <linux/notifier.h>
 #include <linux/persistent_ram.h>
+#include <linux/reboot.h>
 #include <linux/rslib.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 
 struct persistent_ram_buffer {
 	uint32_t    sig;
@@ -104,41 +108,177 @@ static int persistent_ram_decode_rs8(struct persistent_ram_zone *prz,
 				NULL, 0, NULL, 0, NULL);
 }
 
-static void notrace persistent_ram_update_ecc(struct persistent_ram_zone *prz,
-	unsigned int start, unsigned int count)
+static void notrace persistent_ram_encode_block(struct persistent_ram_zone *prz,
+	unsigned int index)
 {
 	struct persistent_ram_buffer *buffer = prz->buffer;
 	uint8_t *buffer_end = buffer->data + prz->buffer_size;
-	uint8_t *block;
-	uint8_t *par;
-	int ecc_block_size = prz->ecc_block_size;
-	int ecc_size = prz->ecc_size;
+	uint8_t *block = buffer->data + index * prz->ecc_block_size;
 	int size = prz->ecc_block_size;
 
-	if (!prz->ecc)
-		return;
+	if (block + size > buffer_end)
+		size = buffer_end - block;
+	persistent_ram_encode_rs8(prz, block, size,
+				  prz->par_buffer + index * prz->ecc_size);
+}
 
-	block = buffer->data + (start & ~(ecc_block_size - 1));
-	par = prz->par_buffer + (start / ecc_block_size) * prz->ecc_size;
+static void notrace
+persistent_ram_encode_header(struct persistent_ram_zone *prz)
+{
+	persistent_ram_encode_rs8(prz, (uint8_t *)prz->buffer,
+				  sizeof(*prz->buffer), prz->par_header);
+}
 
-	do {
-		if (block + ecc_block_size > buffer_end)
-			size = buffer_end - block;
-		persistent_ram_encode_rs8(prz, block, size, par);
-		block += ecc_block_size;
-		par += ecc_size;
-	} while (block < buffer->data + start + count);
+#ifdef CONFIG_ANDROID_PERSISTENT_RAM_DEFERRED_ECC
+/* delay between a write and the ECC for it being computed */
+#define PERSISTENT_RAM_ECC_DELAY	(HZ / 10)
+
+static LIST_HEAD(persistent_ram_zones);
+static DEFINE_SPINLOCK(persistent_ram_zones_lock);
+
+/*
+ * persistent_ram_flush_ecc - encode every block marked stale.  A block
+ * written again while it is being encoded is marked again, after its
+ * data, and picked up by the next flush.
+ *
+ * The header bit doubles as "flush scheduled", so it is cleared first:
+ * a write that comes after that schedules another flush.
+ */
+static void notrace persistent_ram_flush_ecc(struct persistent_ram_zone *prz)
+{
+	bool header = test_and_clear_bit(prz->ecc_blocks, prz->ecc_dirty);
+	unsigned int i;
+
+	for_each_set_bit(i, prz->ecc_dirty, prz->ecc_blocks)
+		if (test_and_clear_bit(i, prz->ecc_dirty))
+			persistent_ram_encode_block(prz, i);
+
+	if (header)
+		persistent_ram_encode_header(prz);
 }
 
-static void persistent_ram_update_header_ecc(struct persistent_ram_zone *prz)
+static void persistent_ram_ecc_work(struct work_struct *work)
 {
-	struct persistent_ram_buffer *buffer = prz->buffer;
+	struct persistent_ram_zone *prz = container_of(work,
+		struct persistent_ram_zone, ecc_work.work);
+
+	persistent_ram_flush_ecc(prz);
+}
+
+static void notrace persistent_ram_mark_ecc(struct persistent_ram_zone *prz,
+	unsigned int first, unsigned int last)
+{
+	/* the data must be in place before the block is marked */
+	smp_wmb();
+	for (; first <= last; first++)
+		set_bit(first, prz->ecc_dirty);
+
+	/* every write also updates the header, so it tracks the zone */
+	if (!test_and_set_bit(prz->ecc_blocks, prz->ecc_dirty) &&
+	    keventd_up())
+		schedule_delayed_work(&prz->ecc_work,
+				      PERSISTENT_RAM_ECC_DELAY);
+}
+
+static int persistent_ram_ecc_notify(struct notifier_block *nb,
+	unsigned long event, void *unused)
+{
+	struct persistent_ram_zone *prz;
+
+	/* no locking, this may be the last thing a crashing cpu does */
+	list_for_each_entry(prz, &persistent_ram_zones, node)
+		persistent_ram_flush_ecc(prz);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block persistent_ram_panic_nb = {
+	.notifier_call	= persistent_ram_ecc_notify,
+	.priority	= INT_MIN,	/* after everyone else has logged */
+};
+
+static struct notifier_block persistent_ram_reboot_nb = {
+	.notifier_call	= persistent_ram_ecc_notify,
+	.priority	= INT_MIN,
+};
+
+static int persistent_ram_init_deferred_ecc(struct persistent_ram_zone *prz,
+	int ecc_blocks)
+{
+	static bool registered;
+	unsigned long flags;
+
+	/* one more bit for the header */
+	prz->ecc_blocks = ecc_blocks;
+	prz->ecc_dirty = kzalloc(BITS_TO_LONGS(ecc_blocks + 1) *
+				 sizeof(unsigned long), GFP_KERNEL);
+	if (!prz->ecc_dirty)
+		return -ENOMEM;
+	INIT_DELAYED_WORK(&prz->ecc_work, persistent_ram_ecc_work);
+
+	spin_lock_irqsave(&persistent_ram_zones_lock, flags);
+	list_add_tail(&prz->node, &persistent_ram_zones);
+	spin_unlock_irqrestore(&persistent_ram_zones_lock, flags);
+
+	if (!registered) {
+		atomic_notifier_chain_register(&panic_notifier_list,
+					       &persistent_ram_panic_nb);
+		register_reboot_notifier(&persistent_ram_reboot_nb);
+		registered = true;
+	}
+
+	return 0;
+}
 
+/* writes made before the workqueues were up were only marked */
+static int __init persistent_ram_ecc_late_init(void)
+{
+	struct persistent_ram_zone *prz;
+	unsigned long flags;
+
+	spin_lock_irqsave(&persistent_ram_zones_lock, flags);
+	list_for_each_entry(prz, &persistent_ram_zones, node)
+		schedule_delayed_work(&prz->ecc_work, 0);
+	spin_unlock_irqrestore(&persistent_ram_zones_lock, flags);
+
+	return 0;
+}
+late_initcall(persistent_ram_ecc_late_init);
+#else
+static inline int
+persistent_ram_init_deferred_ecc(struct persistent_ram_zone *prz,
+	int ecc_blocks)
+{
+	return 0;
+}
+#endif
+
+static void notrace persistent_ram_update_ecc(struct persistent_ram_zone *prz,
+	unsigned int start, unsigned int count)
+{
+	unsigned int first = start / prz->ecc_block_size;
+	unsigned int last = (start + count - 1) / prz->ecc_block_size;
+
+	if (!prz->ecc || !count)
+		return;
+
+#ifdef CONFIG_ANDROID_PERSISTENT_RAM_DEFERRED_ECC
+	persistent_ram_mark_ecc(prz, first, last);
+#else
+	for (; first <= last; first++)
+		persistent_ram_encode_block(prz, first);
+#endif
+}
+
+static void persistent_ram_update_header_ecc(struct persistent_ram_zone *prz)
+{
 	if (!prz->ecc)
 		return;
 
-	persistent_ram_encode_rs8(prz, (uint8_t *)buffer, sizeof(*buffer),
-				  prz->par_header);
+	/* the header is flushed together with the blocks */
+#ifndef CONFIG_ANDROID_PERSISTENT_RAM_DEFERRED_ECC
+	persistent_ram_encode_header(prz);
+#endif
 }
 
 static void persistent_ram_ecc_old(struct persistent_ram_zone *prz)
@@ -214,6 +354,11 @@ static int persistent_ram_init_ecc(struct persistent_ram_zone *prz,
 	prz->corrected_bytes = 0;
 	prz->bad_blocks = 0;
 
+	if (persistent_ram_init_deferred_ecc(prz, ecc_blocks)) {
+		pr_info("persistent_ram: no memory for deferred ecc\n");
+		return -ENOMEM;
+	}
+
 	numerr = persistent_ram_decode_rs8(prz, buffer, sizeof(*buffer),
 					   prz->par_header);
 	if (numerr > 0) {
@@ -2396,6 +2396,25 @@ This feature requires the dependent cfg.ini "gRoamPrefer5GHz" set to 1 */
 #define CFG_BURST_MODE_BE_TXOP_VALUE_MAX       ( 12288 )
 #define CFG_BURST_MODE_BE_TXOP_VALUE_DEFAULT   ( 0 )
 
+/*
+ * Budget of the STA RX NAPI context. Received frames are queued by the
+ * TL callback and delivered to the stack with GRO from NAPI.
+ * 0 delivers each frame with netif_rx_ni() as before.
+ */
+#define CFG_RX_NAPI_BUDGET_NAME                "gRxNapiBudget"
+#define CFG_RX_NAPI_BUDGET_MIN                 ( 0 )
+#define CFG_RX_NAPI_BUDGET_MAX                 ( 256 )
+#define CFG_RX_NAPI_BUDGET_DEFAULT             ( 64 )
+
+/*
+ * Adapt the per-AC TX queue stop threshold to how fast TL drains each
+ * queue instead of stopping the netdev queue only when it is full.
+ */
+#define CFG_TX_DYNAMIC_QUEUE_LIMIT_NAME        "gTxDynamicQueueLimit"
+#define CFG_TX_DYNAMIC_QUEUE_LIMIT_MIN         ( 0 )
+#define CFG_TX_DYNAMIC_QUEUE_LIMIT_MAX         ( 1 )
+#define CFG_TX_DYNAMIC_QUEUE_LIMIT_DEFAULT     ( 1 )
+
 /*--------------------------------------------------------------------------- 
   Type declarations
   -------------------------------------------------------------------------*/ 
@@ -2885,6 +2904,8 @@ typedef struct
    v_U8_t                      acsScanBandPreference;
    v_U16_t                     acsBandSwitchThreshold;
    v_U32_t                     enableDynamicRAStartRate;
+   v_U32_t                     rxNapiBudget;
+   v_U32_t                     txDynamicQueueLimit;
 } hdd_config_t;
 /*--------------------------------------------------------------------------- 
   Function declarations and documenation
@@ -45,6 +45,7 @@
 #include <i_vos_types.h>
 #include <vos_status.h>
 #include <linux/spinlock.h>
+#include <linux/ktime.h>
 #include <vos_trace.h>
 #include <vos_list.h>
 
@@ -71,6 +72,7 @@ typedef struct
    hdd_list_node_t anchor;
    struct sk_buff *skb;
    int userPriority;
+   ktime_t enqueueTime;
 } skb_list_node_t;
 
 //FIXME Need a helper function to cleanup skbs in a queue. Required for cleanup/shutdown
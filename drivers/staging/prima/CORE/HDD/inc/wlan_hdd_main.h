@@ -80,6 +80,13 @@
  *  when HDD queue becomes full. This Low watermark is used to enable
  *  the Net Device queue again */
 #define HDD_TX_QUEUE_LOW_WATER_MARK (HDD_TX_QUEUE_MAX_LEN*3/4)
+/** Floor of the adaptive per-AC Tx queue limit */
+#define HDD_TX_QUEUE_MIN_LIMIT 8
+/** Net Device TX queue is re-enabled once the HDD queue drains to this
+ *  fraction of the current adaptive limit */
+#define HDD_TX_LIMIT_LOW_WATER_MARK(limit) ((limit)*3/4)
+/** Interval over which the standing backlog of an AC is measured */
+#define HDD_TX_LIMIT_SLACK_HOLD_TIME HZ
 /** Bytes to reserve in the headroom */
 #define LIBRA_HW_NEEDED_HEADROOM   128
 /** Hdd Tx Time out value */
@@ -285,6 +292,19 @@ extern spinlock_t hdd_context_lock;
 #define WLAN_HDD_DRIVER_MIRACAST_CFG_MIN_VAL 0
 #define WLAN_HDD_DRIVER_MIRACAST_CFG_MAX_VAL 2
 
+/** Adaptive limit of one AC's Tx queue, in frames. TL fetching frames is
+ *  the completion event: the limit grows when TL drains a queue that was
+ *  back-pressured and shrinks by the backlog which stood in the queue for
+ *  a whole slack interval, as BQL does for hardware rings */
+typedef struct hdd_tx_limit_s
+{
+   v_SIZE_t limit;
+   v_SIZE_t minBacklog;
+   v_BOOL_t overLimit;
+   v_BOOL_t starved;
+   unsigned long slackStart;
+} hdd_tx_limit_t;
+
 typedef struct hdd_tx_rx_stats_s
 {
    // start_xmit stats
@@ -314,12 +334,16 @@ typedef struct hdd_tx_rx_stats_s
    // Deque depressure stats
    __u32    txDequeDePressured;
    __u32    txDequeDePressuredAC[NUM_TX_QUEUES];
+   // time spent in the HDD queue, from start_xmit to TL fetch
+   __u64    txQueueDelayUsAC[NUM_TX_QUEUES];
+   __u32    txQueueDelayMaxUsAC[NUM_TX_QUEUES];
    // rx stats
    __u32    rxChains;
    __u32    rxPackets;
    __u32    rxDropped;
    __u32    rxDelivered;
    __u32    rxRefused;
+   __u32    rxNapiPolls;
    __u32    pkt_tx_count; //TX pkt Counter used for dynamic splitscan
    __u32    pkt_rx_count; //RX pkt Counter used for dynamic splitscan
 #ifdef WLAN_FEATURE_LINK_LAYER_STATS
@@ -845,6 +869,11 @@ struct hdd_adapter_s
    /** Handle to the network device */
    struct net_device *dev;
 
+   /** RX frames from TL waiting for delivery by rx_napi (STA only) */
+   struct napi_struct rx_napi;
+   struct sk_buff_head rx_napi_queue;
+   v_BOOL_t rx_napi_enabled;
+
 #ifdef WLAN_NS_OFFLOAD
    /** IPv6 notifier callback for handling NS offload on change in IP */
    struct work_struct  ipv6NotifierWorkQueue;
@@ -942,6 +971,9 @@ struct hdd_adapter_s
    /**Track whether OS TX queue has been disabled.*/
    v_BOOL_t isTxSuspended[NUM_TX_QUEUES];
 
+   /** Current stop threshold of the per-AC Tx queues */
+   hdd_tx_limit_t txLimit[NUM_TX_QUEUES];
+
    /** WMM Status */
    hdd_wmm_status_t hddWmmStatus;
 /*************************************************************
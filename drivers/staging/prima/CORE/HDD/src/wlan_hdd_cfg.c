@@ -3224,6 +3224,22 @@ REG_VARIABLE( CFG_EXTSCAN_ENABLE, WLAN_PARAM_Integer,
                   CFG_ENABLE_DYNAMIC_RA_START_RATE_DEFAULT,
                   CFG_ENABLE_DYNAMIC_RA_START_RATE_MIN,
                   CFG_ENABLE_DYNAMIC_RA_START_RATE_MAX),
+
+   REG_VARIABLE( CFG_RX_NAPI_BUDGET_NAME, WLAN_PARAM_Integer,
+                  hdd_config_t, rxNapiBudget,
+                  VAR_FLAGS_OPTIONAL |
+                  VAR_FLAGS_RANGE_CHECK_ASSUME_DEFAULT,
+                  CFG_RX_NAPI_BUDGET_DEFAULT,
+                  CFG_RX_NAPI_BUDGET_MIN,
+                  CFG_RX_NAPI_BUDGET_MAX ),
+
+   REG_VARIABLE( CFG_TX_DYNAMIC_QUEUE_LIMIT_NAME, WLAN_PARAM_Integer,
+                  hdd_config_t, txDynamicQueueLimit,
+                  VAR_FLAGS_OPTIONAL |
+                  VAR_FLAGS_RANGE_CHECK_ASSUME_DEFAULT,
+                  CFG_TX_DYNAMIC_QUEUE_LIMIT_DEFAULT,
+                  CFG_TX_DYNAMIC_QUEUE_LIMIT_MIN,
+                  CFG_TX_DYNAMIC_QUEUE_LIMIT_MAX ),
 };
 
 /*
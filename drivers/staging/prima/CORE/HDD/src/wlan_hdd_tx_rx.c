@@ -187,6 +187,76 @@ static void transport_thread(hdd_adapter_t *pAdapter)
 #endif
 
 
+/**============================================================================
+  @brief hdd_tx_limit_init() - Reset the adaptive Tx queue limits
+
+  @param pAdapter : [in] pointer to adapter context
+  @return         : None
+  ===========================================================================*/
+static void hdd_tx_limit_init( hdd_adapter_t *pAdapter )
+{
+   v_SINT_t i;
+
+   for (i = 0; i < NUM_TX_QUEUES; i++)
+   {
+      pAdapter->txLimit[i].limit = HDD_TX_QUEUE_MAX_LEN;
+      pAdapter->txLimit[i].minBacklog = HDD_TX_QUEUE_MAX_LEN;
+      pAdapter->txLimit[i].overLimit = VOS_FALSE;
+      pAdapter->txLimit[i].starved = VOS_FALSE;
+      pAdapter->txLimit[i].slackStart = jiffies;
+   }
+}
+
+/**============================================================================
+  @brief hdd_tx_limit_update() - Adjust the limit of an AC after TL fetched
+  a frame from it. Must be called with the AC queue lock held.
+
+  @param pAdapter : [in] pointer to adapter context
+  @param ac       : [in] access category the frame was fetched from
+  @param backlog  : [in] frames left in the queue after the fetch
+  @return         : None
+  ===========================================================================*/
+static void hdd_tx_limit_update( hdd_adapter_t *pAdapter,
+                                 WLANTL_ACEnumType ac, v_SIZE_t backlog )
+{
+   hdd_tx_limit_t *pLimit = &pAdapter->txLimit[ac];
+   hdd_context_t *pHddCtx = WLAN_HDD_GET_CTX(pAdapter);
+
+   if (!pHddCtx->cfg_ini->txDynamicQueueLimit)
+      return;
+
+   if (backlog < pLimit->minBacklog)
+      pLimit->minBacklog = backlog;
+
+   /* TL drained a queue we had to stop: the OS could not refill it in
+    * time, so let more frames in before stopping next time */
+   if (0 == backlog && pLimit->overLimit)
+   {
+      pLimit->limit += VOS_MAX(pLimit->limit / 2, 1);
+      if (pLimit->limit > HDD_TX_QUEUE_MAX_LEN)
+         pLimit->limit = HDD_TX_QUEUE_MAX_LEN;
+      pLimit->overLimit = VOS_FALSE;
+      pLimit->starved = VOS_TRUE;
+   }
+
+   if (time_before(jiffies, pLimit->slackStart + HDD_TX_LIMIT_SLACK_HOLD_TIME))
+      return;
+
+   /* The queue never went below minBacklog for a whole interval: those
+    * frames only added latency */
+   if (!pLimit->starved && pLimit->minBacklog)
+   {
+      if (pLimit->limit > HDD_TX_QUEUE_MIN_LIMIT + pLimit->minBacklog)
+         pLimit->limit -= pLimit->minBacklog;
+      else
+         pLimit->limit = HDD_TX_QUEUE_MIN_LIMIT;
+   }
+
+   pLimit->minBacklog = HDD_TX_QUEUE_MAX_LEN;
+   pLimit->starved = VOS_FALSE;
+   pLimit->slackStart = jiffies;
+}
+
 /**============================================================================
   @brief hdd_flush_tx_queues() - Utility function to flush the TX queues
 
@@ -297,7 +367,7 @@ void hdd_flush_ibss_tx_queues( hdd_adapter_t *pAdapter, v_U8_t STAId)
       txq = netdev_get_tx_queue(pAdapter->dev, i);
 
       if (VOS_TRUE == pAdapter->isTxSuspended[i] &&
-          size <= HDD_TX_QUEUE_LOW_WATER_MARK &&
+          size <= HDD_TX_LIMIT_LOW_WATER_MARK(pAdapter->txLimit[i].limit) &&
           netif_tx_queue_stopped(txq) )
       {
          netif_tx_start_queue(txq);
@@ -867,13 +937,14 @@ int hdd_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
          return NETDEV_TX_OK;
       }
    }
-   //If we have already reached the max queue size, disable the TX queue
-   if ( pAdapter->wmm_tx_queue[ac].count == pAdapter->wmm_tx_queue[ac].max_size)
+   //If we have already reached the queue limit, disable the TX queue
+   if ( pAdapter->wmm_tx_queue[ac].count >= pAdapter->txLimit[ac].limit)
    {
          ++pAdapter->hdd_stats.hddTxRxStats.txXmitBackPressured;
          ++pAdapter->hdd_stats.hddTxRxStats.txXmitBackPressuredAC[ac];
          netif_tx_stop_queue(netdev_get_tx_queue(dev, skb_get_queue_mapping(skb)));
          pAdapter->isTxSuspended[ac] = VOS_TRUE;
+         pAdapter->txLimit[ac].overLimit = VOS_TRUE;
          txSuspended = VOS_TRUE;
    }
 
@@ -915,6 +986,7 @@ int hdd_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
    //Stick the User Priority inside this node
    pktNode->userPriority = up;
 
+   pktNode->enqueueTime = ktime_get();
 
    INIT_LIST_HEAD(&pktNode->anchor);
 
@@ -1167,6 +1239,82 @@ struct net_device_stats* hdd_stats(struct net_device *dev)
 }
 
 
+/**============================================================================
+  @brief hdd_rx_napi_poll() - NAPI poll of the STA RX path. Delivers the
+  frames queued by hdd_rx_packet_cbk() through GRO.
+
+  @param napi   : [in] pointer to the adapter's rx_napi
+  @param budget : [in] maximum number of frames to deliver
+  @return       : number of frames delivered
+  ===========================================================================*/
+static int hdd_rx_napi_poll(struct napi_struct *napi, int budget)
+{
+   hdd_adapter_t *pAdapter = container_of(napi, hdd_adapter_t, rx_napi);
+   struct sk_buff *skb;
+   int work = 0;
+
+   while (work < budget)
+   {
+      skb = skb_dequeue(&pAdapter->rx_napi_queue);
+      if (NULL == skb)
+         break;
+
+      if (GRO_DROP == napi_gro_receive(napi, skb))
+      {
+         ++pAdapter->hdd_stats.hddTxRxStats.rxRefused;
+      }
+      else
+      {
+         ++pAdapter->hdd_stats.hddTxRxStats.rxDelivered;
+         ++pAdapter->hdd_stats.hddTxRxStats.pkt_rx_count;
+      }
+      work++;
+   }
+   ++pAdapter->hdd_stats.hddTxRxStats.rxNapiPolls;
+
+   if (work < budget)
+   {
+      napi_complete(napi);
+      /* A chain queued after the last dequeue found NAPI still scheduled */
+      if (!skb_queue_empty(&pAdapter->rx_napi_queue))
+         napi_reschedule(napi);
+   }
+
+   return work;
+}
+
+/**============================================================================
+  @brief hdd_rx_napi_queue_batch() - Hand the frames collected from one TL
+  chain to the NAPI context and schedule it.
+
+  @param pAdapter : [in] pointer to adapter context
+  @param batch    : [in] frames to queue, empty on return
+  @return         : None
+  ===========================================================================*/
+static void hdd_rx_napi_queue_batch(hdd_adapter_t *pAdapter,
+                                    struct sk_buff_head *batch)
+{
+   if (skb_queue_empty(batch))
+      return;
+
+   spin_lock_bh(&pAdapter->rx_napi_queue.lock);
+   if (skb_queue_len(&pAdapter->rx_napi_queue) < netdev_max_backlog)
+      skb_queue_splice_tail_init(batch, &pAdapter->rx_napi_queue);
+   spin_unlock_bh(&pAdapter->rx_napi_queue.lock);
+
+   if (!skb_queue_empty(batch))
+   {
+      // NAPI is not keeping up, drop the chain
+      pAdapter->hdd_stats.hddTxRxStats.rxRefused += skb_queue_len(batch);
+      __skb_queue_purge(batch);
+   }
+
+   // bh enable runs NET_RX right here, once for the whole chain
+   local_bh_disable();
+   napi_schedule(&pAdapter->rx_napi);
+   local_bh_enable();
+}
+
 /**============================================================================
   @brief hdd_init_tx_rx() - Init function to initialize Tx/RX
   modules in HDD
@@ -1178,6 +1326,7 @@ struct net_device_stats* hdd_stats(struct net_device *dev)
 VOS_STATUS hdd_init_tx_rx( hdd_adapter_t *pAdapter )
 {
    VOS_STATUS status = VOS_STATUS_SUCCESS;
+   hdd_context_t *pHddCtx;
    v_SINT_t i = -1;
 
    if ( NULL == pAdapter )
@@ -1199,6 +1348,17 @@ VOS_STATUS hdd_init_tx_rx( hdd_adapter_t *pAdapter )
       pAdapter->isTxSuspended[i] = VOS_FALSE; 
       hdd_list_init( &pAdapter->wmm_tx_queue[i], HDD_TX_QUEUE_MAX_LEN);
    }
+   hdd_tx_limit_init(pAdapter);
+
+   pHddCtx = WLAN_HDD_GET_CTX(pAdapter);
+   if (!pAdapter->rx_napi_enabled && pHddCtx && pHddCtx->cfg_ini->rxNapiBudget)
+   {
+      skb_queue_head_init(&pAdapter->rx_napi_queue);
+      netif_napi_add(pAdapter->dev, &pAdapter->rx_napi, hdd_rx_napi_poll,
+                     pHddCtx->cfg_ini->rxNapiBudget);
+      napi_enable(&pAdapter->rx_napi);
+      pAdapter->rx_napi_enabled = VOS_TRUE;
+   }
 
    return status;
 }
@@ -1236,6 +1396,14 @@ VOS_STATUS hdd_deinit_tx_rx( hdd_adapter_t *pAdapter )
       hdd_list_destroy( &pAdapter->wmm_tx_queue[i] );
    }
 
+   if (pAdapter->rx_napi_enabled)
+   {
+      napi_disable(&pAdapter->rx_napi);
+      netif_napi_del(&pAdapter->rx_napi);
+      skb_queue_purge(&pAdapter->rx_napi_queue);
+      pAdapter->rx_napi_enabled = VOS_FALSE;
+   }
+
    return status;
 }
 
@@ -1552,13 +1720,24 @@ VOS_STATUS hdd_tx_fetch_packet_cbk( v_VOID_t *vosContext,
    //Remove the packet from the queue
    spin_lock_bh(&pAdapter->wmm_tx_queue[ac].lock);
    status = hdd_list_remove_front( &pAdapter->wmm_tx_queue[ac], &anchor );
+   if(VOS_STATUS_SUCCESS == status)
+   {
+      hdd_tx_limit_update(pAdapter, ac, pAdapter->wmm_tx_queue[ac].count);
+   }
    spin_unlock_bh(&pAdapter->wmm_tx_queue[ac].lock);
 
    if(VOS_STATUS_SUCCESS == status)
    {
+      s64 delayUs;
+
       //If success then we got a valid packet from some AC
       pktNode = list_entry(anchor, skb_list_node_t, anchor);
       skb = pktNode->skb;
+
+      delayUs = ktime_us_delta(ktime_get(), pktNode->enqueueTime);
+      pAdapter->hdd_stats.hddTxRxStats.txQueueDelayUsAC[ac] += delayUs;
+      if (delayUs > pAdapter->hdd_stats.hddTxRxStats.txQueueDelayMaxUsAC[ac])
+         pAdapter->hdd_stats.hddTxRxStats.txQueueDelayMaxUsAC[ac] = delayUs;
    }
    else
    {
@@ -1737,7 +1916,7 @@ VOS_STATUS hdd_tx_fetch_packet_cbk( v_VOID_t *vosContext,
 
    // if we are in a backpressure situation see if we can turn the hose back on
    if ( (pAdapter->isTxSuspended[ac]) &&
-        (size <= HDD_TX_QUEUE_LOW_WATER_MARK) )
+        (size <= HDD_TX_LIMIT_LOW_WATER_MARK(pAdapter->txLimit[ac].limit)) )
    {
       ++pAdapter->hdd_stats.hddTxRxStats.txFetchDePressured;
       ++pAdapter->hdd_stats.hddTxRxStats.txFetchDePressuredAC[ac];
@@ -1900,6 +2079,7 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
    VOS_STATUS status = VOS_STATUS_E_FAILURE;
    int rxstat;
    struct sk_buff *skb = NULL;
+   struct sk_buff_head rxBatch;
    vos_pkt_t* pVosPacket;
    vos_pkt_t* pNextVosPacket;
    v_U8_t proto_type;
@@ -1933,6 +2113,9 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
 
    ++pAdapter->hdd_stats.hddTxRxStats.rxChains;
 
+   // frames for NAPI are collected here and queued once per chain
+   __skb_queue_head_init(&rxBatch);
+
    // walk the chain until all are processed
    pVosPacket = pVosPacketChain;
    do
@@ -1947,6 +2130,7 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
          ++pAdapter->hdd_stats.hddTxRxStats.rxDropped;
          VOS_TRACE( VOS_MODULE_ID_HDD_DATA, VOS_TRACE_LEVEL_ERROR,
                          "%s: Failure walking packet chain", __func__);
+         hdd_rx_napi_queue_batch(pAdapter, &rxBatch);
          return VOS_STATUS_E_FAILURE;
       }
 
@@ -1958,6 +2142,7 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
          ++pAdapter->hdd_stats.hddTxRxStats.rxDropped;
          VOS_TRACE( VOS_MODULE_ID_HDD_DATA, VOS_TRACE_LEVEL_ERROR,
                                 "%s: Failure extracting skb from vos pkt", __func__);
+         hdd_rx_napi_queue_batch(pAdapter, &rxBatch);
          return VOS_STATUS_E_FAILURE;
       }
 
@@ -1965,6 +2150,7 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
       {
          VOS_TRACE(VOS_MODULE_ID_HDD_DATA, VOS_TRACE_LEVEL_FATAL,
            "Magic cookie(%x) for adapter sanity verification is invalid", pAdapter->magic);
+         hdd_rx_napi_queue_batch(pAdapter, &rxBatch);
          return eHAL_STATUS_FAILURE;
       }
 
@@ -2042,21 +2228,30 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
       wake_lock_timeout(&pHddCtx->rx_wake_lock, msecs_to_jiffies(HDD_WAKE_LOCK_DURATION));
 #endif
 #endif
-      rxstat = netif_rx_ni(skb);
-      if (NET_RX_SUCCESS == rxstat)
+      if (pAdapter->rx_napi_enabled)
       {
-         ++pAdapter->hdd_stats.hddTxRxStats.rxDelivered;
-         ++pAdapter->hdd_stats.hddTxRxStats.pkt_rx_count;
+         __skb_queue_tail(&rxBatch, skb);
       }
       else
       {
-         ++pAdapter->hdd_stats.hddTxRxStats.rxRefused;
+         rxstat = netif_rx_ni(skb);
+         if (NET_RX_SUCCESS == rxstat)
+         {
+            ++pAdapter->hdd_stats.hddTxRxStats.rxDelivered;
+            ++pAdapter->hdd_stats.hddTxRxStats.pkt_rx_count;
+         }
+         else
+         {
+            ++pAdapter->hdd_stats.hddTxRxStats.rxRefused;
+         }
       }
       // now process the next packet in the chain
       pVosPacket = pNextVosPacket;
 
    } while (pVosPacket);
 
+   hdd_rx_napi_queue_batch(pAdapter, &rxBatch);
+
    //Return the entire VOS packet chain to the resource pool
    status = vos_pkt_return_packet( pVosPacketChain );
    if(!VOS_IS_STATUS_SUCCESS( status ))
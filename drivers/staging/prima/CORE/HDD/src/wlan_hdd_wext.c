@@ -51,6 +51,7 @@
 #include <linux/init.h>
 #include <linux/wireless.h>
 #include <linux/ratelimit.h>
+#include <linux/math64.h>
 #include <macTrace.h>
 #include <wlan_hdd_includes.h>
 #include <wlan_btc_svc.h>
@@ -5537,7 +5538,7 @@ static int __iw_get_char_setnone(struct net_device *dev,
                      "\nDeque depressured BK %u, BE %u, VI %u, VO %u"
                      "\n      flushed BK %u, BE %u, VI %u, VO %u"
                      "\n\nReceive"
-                     "\nchains %u, packets %u, dropped %u, delivered %u, refused %u"
+                     "\nchains %u, packets %u, dropped %u, delivered %u, refused %u, napi polls %u"
                      "\n\nResetsStats"
                      "\n TotalLogp %u Cmd53 %u MutexRead %u  MIF-Error %u FW-Heartbeat %u Others %u"
                      "\n",
@@ -5607,6 +5608,7 @@ static int __iw_get_char_setnone(struct net_device *dev,
                      pStats->rxDropped,
                      pStats->rxDelivered,
                      pStats->rxRefused,
+                     pStats->rxNapiPolls,
 
                      pResetStats->totalLogpResets,
                      pResetStats->totalCMD53Failures,
@@ -5617,6 +5619,25 @@ static int __iw_get_char_setnone(struct net_device *dev,
                      );
             wrqu->data.length = strlen(extra);
 
+            if (wrqu->data.length < WE_MAX_STR_LEN) {
+                __u32 ac;
+
+                for (ac = 0; ac < NUM_TX_QUEUES; ac++) {
+                    __u32 dequeued = pStats->txFetchDequeuedAC[ac];
+
+                    snprintf(extra + wrqu->data.length,
+                             WE_MAX_STR_LEN - wrqu->data.length,
+                             "%sAC%u limit %u, queue delay avg %llu us max %u us",
+                             ac ? "\n" : "\nTransmit queue\n", ac,
+                             pAdapter->txLimit[ac].limit,
+                             dequeued ? (unsigned long long)
+                                 div_u64(pStats->txQueueDelayUsAC[ac],
+                                         dequeued) : 0ULL,
+                             pStats->txQueueDelayMaxUsAC[ac]);
+                    wrqu->data.length = strlen(extra);
+                }
+            }
+
             hHal = WLAN_HDD_GET_HAL_CTX( pAdapter );
 
             if (hHal)
@@ -36,6 +36,7 @@
 #include <mach/rpm-regulator-smd.h>
 #include <linux/regulator/consumer.h>
 #include <linux/msm_thermal_ioctl.h>
+#include <linux/math64.h>
 #include <linux/sched.h>
 
 #define MAX_CURRENT_UA 1000000
@@ -51,6 +52,7 @@ static uint32_t wakeup_ms;
 static struct alarm thermal_rtc;
 static struct kobject *tt_kobj;
 static struct kobject *cc_kobj;
+static struct kobject *pid_kobj;
 static struct work_struct timer_work;
 static struct task_struct *hotplug_task;
 static struct task_struct *freq_mitigation_task;
@@ -84,6 +86,47 @@ static DEFINE_MUTEX(vdd_rstr_mutex);
 static DEFINE_MUTEX(psm_mutex);
 static DEFINE_MUTEX(ocr_mutex);
 static uint32_t min_freq_limit;
+static DEFINE_MUTEX(pid_mutex);
+
+#define PID_SAMPLES 8
+
+/*
+ * Predictive frequency control. Instead of stepping the limit down on
+ * every poll above limit_temp_degC and back up once the die cooled
+ * below the hysteresis, fit the temperature slope over the last few
+ * tsens samples, project it horizon_ms ahead and run a PID controller
+ * on the projected temperature. The integral term settles on the
+ * frequency index the device can sustain at the setpoint, so a steady
+ * load parks there instead of oscillating around the limit.
+ *
+ * Gains are in milli-steps of the frequency table: kp per degC of
+ * error, ki per degC*s of accumulated error and kd per degC/s of
+ * slope.
+ */
+static struct {
+	bool enabled;
+	uint32_t kp;
+	uint32_t ki;
+	uint32_t kd;
+	uint32_t horizon_ms;
+	int32_t setpoint_degC;
+
+	unsigned int nr_samples;
+	unsigned int head;
+	long temp_mC[PID_SAMPLES];
+	unsigned long stamp[PID_SAMPLES];
+
+	long slope_mCps;
+	long predicted_mC;
+	long error_mC;
+	s64 integral;
+	long output;
+} pid = {
+	.kp = 1000,
+	.ki = 250,
+	.kd = 0,
+	.horizon_ms = 2000,
+};
 
 enum thermal_threshold {
 	HOTPLUG_THRESHOLD_HIGH,
@@ -199,31 +242,8 @@ enum ocr_request {
 #define PSM_REG_MODE_FROM_ATTRIBS(attr) \
 	(container_of(attr, struct psm_rail, mode_attr));
 
-static int  msm_thermal_cpufreq_callback(struct notifier_block *nfb,
-		unsigned long event, void *data)
-{
-	struct cpufreq_policy *policy = data;
-	uint32_t max_freq_req = cpus[policy->cpu].limited_max_freq;
-	uint32_t min_freq_req = cpus[policy->cpu].limited_min_freq;
-
-	switch (event) {
-	case CPUFREQ_INCOMPATIBLE:
-		pr_debug("%s: mitigating cpu %d to freq max: %u min: %u\n",
-		KBUILD_MODNAME, policy->cpu, max_freq_req, min_freq_req);
-
-		cpufreq_verify_within_limits(policy, min_freq_req,
-			max_freq_req);
-
-		if (max_freq_req < min_freq_req)
-			pr_err("Invalid frequency request Max:%u Min:%u\n",
-				max_freq_req, min_freq_req);
-		break;
-	}
-	return NOTIFY_OK;
-}
-
-static struct notifier_block msm_thermal_cpufreq_notifier = {
-	.notifier_call = msm_thermal_cpufreq_callback,
+static struct cpufreq_limit msm_thermal_limit = {
+	.name = KBUILD_MODNAME,
 };
 
 /* If freq table exists, then we can send freq request */
@@ -244,10 +264,19 @@ static int check_freq_table(void)
 
 static void update_cpu_freq(int cpu)
 {
-	if (cpu_online(cpu)) {
-		if (cpufreq_update_policy(cpu))
-			pr_err("Unable to update policy for cpu:%d\n", cpu);
-	}
+	uint32_t max_freq_req = cpus[cpu].limited_max_freq;
+	uint32_t min_freq_req = cpus[cpu].limited_min_freq;
+
+	pr_debug("%s: mitigating cpu %d to freq max: %u min: %u\n",
+		KBUILD_MODNAME, cpu, max_freq_req, min_freq_req);
+
+	if (max_freq_req < min_freq_req)
+		pr_err("Invalid frequency request Max:%u Min:%u\n",
+			max_freq_req, min_freq_req);
+
+	if (cpufreq_limit_set(&msm_thermal_limit, cpu, min_freq_req,
+			max_freq_req))
+		pr_err("Unable to update policy for cpu:%d\n", cpu);
 }
 
 static int update_cpu_min_freq_all(uint32_t min)
@@ -1137,6 +1166,240 @@ static void __ref do_freq_control(long temp)
 	put_online_cpus();
 }
 
+static void pid_reset(void)
+{
+	pid.nr_samples = 0;
+	pid.head = 0;
+	pid.slope_mCps = 0;
+	pid.predicted_mC = 0;
+	pid.error_mC = 0;
+	pid.output = 0;
+	/* Start from the limit currently applied, not from full speed */
+	pid.integral = (s64)(limit_idx - limit_idx_high) * 1000;
+}
+
+/* Least squares slope of the sample ring in milli-degC per second */
+static long pid_fit_slope(void)
+{
+	unsigned int i, idx;
+	s64 x, y, sx = 0, sy = 0, sxy = 0, sxx = 0, n, den;
+	unsigned long t0;
+
+	n = pid.nr_samples;
+	if (n < 2)
+		return 0;
+
+	idx = (pid.head + PID_SAMPLES - pid.nr_samples) % PID_SAMPLES;
+	t0 = pid.stamp[idx];
+	for (i = 0; i < pid.nr_samples; i++) {
+		idx = (pid.head + PID_SAMPLES - pid.nr_samples + i) %
+			PID_SAMPLES;
+		x = jiffies_to_msecs(pid.stamp[idx] - t0);
+		y = pid.temp_mC[idx];
+		sx += x;
+		sy += y;
+		sxy += x * y;
+		sxx += x * x;
+	}
+
+	den = n * sxx - sx * sx;
+	if (den <= 0)
+		return 0;
+	return (long)div64_s64((n * sxy - sx * sy) * MSEC_PER_SEC, den);
+}
+
+static void __ref do_freq_control_pid(long temp)
+{
+	uint32_t cpu = 0;
+	uint32_t max_freq;
+	unsigned long now = jiffies;
+	unsigned int dt_ms, prev;
+	int32_t setpoint;
+	s64 integral, range;
+	long out;
+	int idx;
+
+	mutex_lock(&pid_mutex);
+	if (pid.nr_samples) {
+		prev = (pid.head + PID_SAMPLES - 1) % PID_SAMPLES;
+		dt_ms = jiffies_to_msecs(now - pid.stamp[prev]);
+	} else {
+		dt_ms = 0;
+	}
+	pid.temp_mC[pid.head] = temp * 1000;
+	pid.stamp[pid.head] = now;
+	pid.head = (pid.head + 1) % PID_SAMPLES;
+	if (pid.nr_samples < PID_SAMPLES)
+		pid.nr_samples++;
+
+	setpoint = pid.setpoint_degC ? pid.setpoint_degC :
+		msm_thermal_info.limit_temp_degC;
+	pid.slope_mCps = pid_fit_slope();
+	pid.predicted_mC = temp * 1000 +
+		(long)div_s64((s64)pid.slope_mCps * pid.horizon_ms,
+			      MSEC_PER_SEC);
+	pid.error_mC = setpoint * 1000 - pid.predicted_mC;
+
+	/*
+	 * The integral only ever holds the limit down: clamp it to the
+	 * table range so a long cool period cannot wind it up, and so the
+	 * controller never needs longer to release than to throttle.
+	 */
+	range = (s64)(limit_idx_high - limit_idx_low) * 1000;
+	integral = pid.integral + div_s64((s64)pid.ki * pid.error_mC * dt_ms,
+					  1000 * MSEC_PER_SEC);
+	pid.integral = clamp_t(s64, integral, -range, 0);
+
+	out = (long)div_s64((s64)pid.kp * pid.error_mC, 1000) +
+		(long)pid.integral -
+		(long)div_s64((s64)pid.kd * pid.slope_mCps, 1000);
+	pid.output = out;
+
+	/* Round towards the lower frequency while the output is negative */
+	idx = limit_idx_high + (out < 0 ? -DIV_ROUND_UP(-out, 1000) : 0);
+	if (idx < limit_idx_low)
+		idx = limit_idx_low;
+	limit_idx = idx;
+	mutex_unlock(&pid_mutex);
+
+	if (idx >= limit_idx_high)
+		max_freq = UINT_MAX;
+	else
+		max_freq = table[idx].frequency;
+
+	if (max_freq == cpus[cpu].limited_max_freq)
+		return;
+
+	get_online_cpus();
+	for_each_possible_cpu(cpu) {
+		if (!(msm_thermal_info.bootup_freq_control_mask & BIT(cpu)))
+			continue;
+		cpus[cpu].limited_max_freq = max_freq;
+		update_cpu_freq(cpu);
+	}
+	put_online_cpus();
+}
+
+/*
+ * Outside the mitigation band check_temp() does not poll. It arms the
+ * sensor's upper and lower thresholds CHECK_TEMP_BAND_DEGC around the
+ * current temperature, the upper one no higher than the start of the
+ * band, and runs again when one of them trips. Otherwise it polls every
+ * poll_ms, or about once per degree of change when the measured dT/dt
+ * is faster than that, down to poll_ms / 4.
+ */
+#define CHECK_TEMP_BAND_DEGC	2
+static bool threshold_wakeup = true;
+module_param(threshold_wakeup, bool, 0644);
+MODULE_PARM_DESC(threshold_wakeup, "wait for tsens thresholds when cool");
+
+static int check_temp_sensor = -ENODEV;
+static bool check_temp_armed;
+static struct sensor_threshold check_temp_threshold[MAX_THRESHOLD];
+static long check_temp_last;
+static unsigned long check_temp_stamp;
+static long check_temp_slope_mCps;
+
+static long mitigation_band_degC(void)
+{
+	long band = msm_thermal_info.limit_temp_degC -
+			msm_thermal_info.temp_hysteresis_degC;
+
+	if (core_control_enabled)
+		band = min_t(long, band,
+			msm_thermal_info.core_limit_temp_degC -
+			msm_thermal_info.core_temp_hysteresis_degC);
+	return band;
+}
+
+static void check_temp_update_slope(long temp)
+{
+	unsigned long now = jiffies;
+	unsigned int dt_ms;
+
+	if (check_temp_stamp) {
+		dt_ms = jiffies_to_msecs(now - check_temp_stamp);
+		if (dt_ms)
+			check_temp_slope_mCps = (temp - check_temp_last) *
+						1000 * 1000 / (long)dt_ms;
+	}
+	check_temp_last = temp;
+	check_temp_stamp = now;
+}
+
+static unsigned int check_temp_interval_ms(void)
+{
+	unsigned int poll_ms = msm_thermal_info.poll_ms;
+
+	if (check_temp_slope_mCps <= 0)
+		return poll_ms;
+	return clamp_t(long, 1000 * 1000 / check_temp_slope_mCps,
+			poll_ms / 4, poll_ms);
+}
+
+static bool check_temp_can_sleep(long temp)
+{
+	char name[THERMAL_NAME_LENGTH];
+
+	if (!threshold_wakeup)
+		return false;
+	/* these look at every sensor, or want a steady stream of samples */
+	if (vdd_rstr_enabled || psm_enabled || ocr_enabled || pid.enabled)
+		return false;
+	if (limit_idx != limit_idx_high || cpus_offlined)
+		return false;
+	if (temp >= mitigation_band_degC())
+		return false;
+
+	if (check_temp_sensor < 0) {
+		snprintf(name, sizeof(name), "tsens_tz_sensor%d",
+				msm_thermal_info.sensor_id);
+		check_temp_sensor = sensor_get_id(name);
+	}
+	return check_temp_sensor >= 0;
+}
+
+static int check_temp_notify(enum thermal_trip_type type, int temp,
+				void *data)
+{
+	cancel_delayed_work(&check_temp_work);
+	queue_delayed_work(system_power_efficient_wq, &check_temp_work, 0);
+	return 0;
+}
+
+static int check_temp_arm(long temp)
+{
+	struct sensor_threshold *hi = &check_temp_threshold[0];
+	struct sensor_threshold *lo = &check_temp_threshold[1];
+	int ret;
+
+	hi->trip = THERMAL_TRIP_CONFIGURABLE_HI;
+	hi->temp = min_t(long, temp + CHECK_TEMP_BAND_DEGC,
+			mitigation_band_degC());
+	lo->trip = THERMAL_TRIP_CONFIGURABLE_LOW;
+	lo->temp = temp - CHECK_TEMP_BAND_DEGC;
+	hi->notify = lo->notify = check_temp_notify;
+
+	ret = set_and_activate_threshold(check_temp_sensor, hi);
+	if (!ret)
+		ret = set_and_activate_threshold(check_temp_sensor, lo);
+	check_temp_armed = true;
+	return ret;
+}
+
+static void check_temp_disarm(void)
+{
+	int i;
+
+	if (!check_temp_armed)
+		return;
+	for (i = 0; i < MAX_THRESHOLD; i++)
+		if (check_temp_threshold[i].active)
+			sensor_activate_trip(check_temp_sensor,
+					&check_temp_threshold[i], false);
+	check_temp_armed = false;
+}
+
 static void __ref check_temp(struct work_struct *work)
 {
 	static int limit_init;
@@ -1160,16 +1423,25 @@ static void __ref check_temp(struct work_struct *work)
 			limit_init = 1;
 	}
 
+	check_temp_update_slope(temp);
 	do_core_control(temp);
 	do_vdd_restriction();
 	do_psm();
 	do_ocr();
-	do_freq_control(temp);
+	if (pid.enabled)
+		do_freq_control_pid(temp);
+	else
+		do_freq_control(temp);
+
+	if (enabled && check_temp_can_sleep(temp) && !check_temp_arm(temp))
+		return;
 
 reschedule:
+	check_temp_disarm();
 	if (enabled)
-		schedule_delayed_work(&check_temp_work,
-				msecs_to_jiffies(msm_thermal_info.poll_ms));
+		queue_delayed_work(system_power_efficient_wq,
+				&check_temp_work,
+				msecs_to_jiffies(check_temp_interval_ms()));
 }
 
 static int __ref msm_thermal_cpu_callback(struct notifier_block *nfb,
@@ -1224,7 +1496,7 @@ static void thermal_rtc_callback(struct alarm *al)
 {
 	struct timeval ts;
 	ts = ktime_to_timeval(alarm_get_elapsed_realtime());
-	schedule_work(&timer_work);
+	queue_work(system_power_efficient_wq, &timer_work);
 	pr_debug("%s: Time on alarm expiry: %ld %ld\n", KBUILD_MODNAME,
 			ts.tv_sec, ts.tv_usec);
 }
@@ -1516,6 +1788,7 @@ static void __ref disable_msm_thermal(void)
 	/* make sure check_temp is no longer running */
 	cancel_delayed_work(&check_temp_work);
 	flush_scheduled_work();
+	check_temp_disarm();
 
 	get_online_cpus();
 	for_each_possible_cpu(cpu) {
@@ -1697,6 +1970,136 @@ static __refdata struct attribute_group tt_attr_group = {
 	.attrs = tt_attrs,
 };
 
+static ssize_t show_pid_enabled(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", pid.enabled);
+}
+
+static ssize_t store_pid_enabled(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	int ret = 0;
+	uint32_t val = 0;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret) {
+		pr_err("%s: Invalid input %s\n", KBUILD_MODNAME, buf);
+		return ret;
+	}
+
+	mutex_lock(&pid_mutex);
+	if (pid.enabled != !!val) {
+		pid_reset();
+		pid.enabled = !!val;
+	}
+	mutex_unlock(&pid_mutex);
+
+	return count;
+}
+
+#define define_pid_knob(name, fmt, parse)				\
+static ssize_t show_pid_##name(struct kobject *kobj,			\
+		struct kobj_attribute *attr, char *buf)			\
+{									\
+	return snprintf(buf, PAGE_SIZE, fmt "\n", pid.name);		\
+}									\
+static ssize_t store_pid_##name(struct kobject *kobj,			\
+		struct kobj_attribute *attr, const char *buf, size_t count) \
+{									\
+	int ret;							\
+									\
+	mutex_lock(&pid_mutex);						\
+	ret = parse(buf, 10, &pid.name);				\
+	mutex_unlock(&pid_mutex);					\
+	if (ret) {							\
+		pr_err("%s: Invalid input %s\n", KBUILD_MODNAME, buf);	\
+		return ret;						\
+	}								\
+	return count;							\
+}									\
+static __refdata struct kobj_attribute pid_##name##_attr =		\
+__ATTR(name, 0644, show_pid_##name, store_pid_##name)
+
+define_pid_knob(kp, "%u", kstrtouint);
+define_pid_knob(ki, "%u", kstrtouint);
+define_pid_knob(kd, "%u", kstrtouint);
+define_pid_knob(horizon_ms, "%u", kstrtouint);
+define_pid_knob(setpoint_degC, "%d", kstrtoint);
+
+static ssize_t show_pid_state(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	ssize_t len;
+
+	mutex_lock(&pid_mutex);
+	len = snprintf(buf, PAGE_SIZE,
+		"slope_mCps:%ld predicted_mC:%ld error_mC:%ld integral:%lld "
+		"output:%ld limit_idx:%d max_freq:%u\n",
+		pid.slope_mCps, pid.predicted_mC, pid.error_mC,
+		pid.integral, pid.output, limit_idx,
+		cpus[0].limited_max_freq);
+	mutex_unlock(&pid_mutex);
+
+	return len;
+}
+
+static __refdata struct kobj_attribute pid_enabled_attr =
+__ATTR(enabled, 0644, show_pid_enabled, store_pid_enabled);
+
+static __refdata struct kobj_attribute pid_state_attr =
+__ATTR(state, 0444, show_pid_state, NULL);
+
+static __refdata struct attribute *pid_attrs[] = {
+	&pid_enabled_attr.attr,
+	&pid_kp_attr.attr,
+	&pid_ki_attr.attr,
+	&pid_kd_attr.attr,
+	&pid_horizon_ms_attr.attr,
+	&pid_setpoint_degC_attr.attr,
+	&pid_state_attr.attr,
+	NULL,
+};
+
+static __refdata struct attribute_group pid_attr_group = {
+	.attrs = pid_attrs,
+};
+
+static __init int msm_thermal_add_pid_nodes(void)
+{
+	struct kobject *module_kobj = NULL;
+	int ret = 0;
+
+	module_kobj = kset_find_obj(module_kset, KBUILD_MODNAME);
+	if (!module_kobj) {
+		pr_err("%s: cannot find kobject for module\n",
+			KBUILD_MODNAME);
+		ret = -ENOENT;
+		goto done_pid_nodes;
+	}
+
+	pid_kobj = kobject_create_and_add("predictive", module_kobj);
+	if (!pid_kobj) {
+		pr_err("%s: cannot create predictive kobj\n",
+				KBUILD_MODNAME);
+		ret = -ENOMEM;
+		goto done_pid_nodes;
+	}
+
+	ret = sysfs_create_group(pid_kobj, &pid_attr_group);
+	if (ret) {
+		pr_err("%s: cannot create group\n", KBUILD_MODNAME);
+		goto done_pid_nodes;
+	}
+
+	return 0;
+
+done_pid_nodes:
+	if (pid_kobj)
+		kobject_del(pid_kobj);
+	return ret;
+}
+
 static __init int msm_thermal_add_cc_nodes(void)
 {
 	struct kobject *module_kobj = NULL;
@@ -1797,13 +2200,12 @@ int __devinit msm_thermal_init(struct msm_thermal_data *pdata)
 		return -EINVAL;
 
 	enabled = 1;
-	ret = cpufreq_register_notifier(&msm_thermal_cpufreq_notifier,
-			CPUFREQ_POLICY_NOTIFIER);
+	ret = cpufreq_limit_register(&msm_thermal_limit);
 	if (ret)
-		pr_err("%s: cannot register cpufreq notifier\n",
+		pr_err("%s: cannot register cpufreq limit\n",
 			KBUILD_MODNAME);
 	INIT_DELAYED_WORK(&check_temp_work, check_temp);
-	schedule_delayed_work(&check_temp_work, 0);
+	queue_delayed_work(system_power_efficient_wq, &check_temp_work, 0);
 
 	if (num_possible_cpus() > 1)
 		register_cpu_notifier(&msm_thermal_cpu_notifier);
@@ -2637,6 +3039,7 @@ int __init msm_thermal_late_init(void)
 			thermal_rtc_callback);
 	INIT_WORK(&timer_work, timer_work_fn);
 	msm_thermal_add_timer_nodes();
+	msm_thermal_add_pid_nodes();
 
 	return 0;
 }
@@ -55,6 +55,8 @@
 #include <linux/device.h>
 #include <linux/wakelock.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
 #include <linux/of_gpio.h>
@@ -92,6 +94,14 @@ static int hs_serial_debug_mask = INFO_LEV;
 module_param_named(debug_mask, hs_serial_debug_mask,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * While RX transfers keep arriving back-to-back the stale timeout is
+ * stretched, up to this many us, so that a burst is collected into one
+ * transfer instead of one per packet. 0 keeps the per-baud timeout.
+ */
+static unsigned int rx_stale_max_us = 500;
+module_param(rx_stale_max_us, uint, S_IRUGO | S_IWUSR);
+
 #define MSM_HS_DBG(x...) do { \
 	if (hs_serial_debug_mask >= DBG_LEV) { \
 		if (ipc_msm_hs_log_ctxt) \
@@ -187,6 +197,15 @@ struct msm_hs_tx {
 	struct msm_hs_sps_ep_conn_data cons;
 };
 
+struct msm_hs_rx_stats {
+	unsigned long xfers;		/* rx dma completions */
+	unsigned long full;		/* ... that filled the whole buffer */
+	unsigned long stale_irqs;
+	unsigned long stalls;		/* tty buffer had no room */
+	unsigned long stale_changes;
+	u64 bytes;
+};
+
 struct msm_hs_rx {
 	enum flush_reason flush;
 	struct msm_dmov_cmd xfer;
@@ -205,6 +224,12 @@ struct msm_hs_rx {
 	struct msm_hs_sps_ep_conn_data prod;
 	bool rx_cmd_queued;
 	bool rx_cmd_exec;
+	/* stale timeout in character times: per-baud base, cap and current */
+	unsigned int stale_base;
+	unsigned int stale_max;
+	unsigned int stale_cur;
+	ktime_t last_xfer;
+	struct msm_hs_rx_stats stats;
 };
 enum buffer_states {
 	NONE_PENDING = 0x0,
@@ -247,6 +272,7 @@ struct msm_hs_port {
 	struct wake_lock dma_wake_lock;  /* held while any DMA active */
 
 	struct dentry *loopback_dir;
+	struct dentry *rx_stats_dir;
 	struct work_struct clock_off_w; /* work for actual clock off */
 	struct workqueue_struct *hsuart_wq; /* hsuart workqueue */
 	struct mutex clk_mutex; /* mutex to guard against clock off/clock on */
@@ -750,11 +776,76 @@ static int msm_serial_loopback_enable_get(void *data, u64 *val)
 DEFINE_SIMPLE_ATTRIBUTE(loopback_enable_fops, msm_serial_loopback_enable_get,
 			msm_serial_loopback_enable_set, "%llu\n");
 
+static int msm_serial_rx_stats_show(struct seq_file *m, void *unused)
+{
+	struct msm_hs_port *msm_uport = m->private;
+	struct uart_port *uport = &msm_uport->uport;
+	struct msm_hs_rx *rx = &msm_uport->rx;
+	struct msm_hs_rx_stats st;
+	unsigned int stale_cur, stale_base, stale_max;
+	unsigned long flags;
+	u64 per_kb = 0;
+	u32 rem;
+
+	spin_lock_irqsave(&uport->lock, flags);
+	st = rx->stats;
+	stale_cur = rx->stale_cur;
+	stale_base = rx->stale_base;
+	stale_max = rx->stale_max;
+	spin_unlock_irqrestore(&uport->lock, flags);
+
+	/* dma completions plus stale interrupts per 1024 bytes, x100 */
+	if (st.bytes)
+		per_kb = div64_u64((u64)(st.xfers + st.stale_irqs) * 1024 * 100,
+				   st.bytes);
+	rem = do_div(per_kb, 100);
+
+	seq_printf(m, "rx transfers:   %lu (%lu full)\n", st.xfers, st.full);
+	seq_printf(m, "rx bytes:       %llu\n", st.bytes);
+	seq_printf(m, "stale irqs:     %lu\n", st.stale_irqs);
+	seq_printf(m, "irqs per KB:    %llu.%02u\n", per_kb, rem);
+	seq_printf(m, "tty stalls:     %lu\n", st.stalls);
+	seq_printf(m, "stale timeout:  %u chars (%u..%u), %lu changes\n",
+		   stale_cur, stale_base, stale_max, st.stale_changes);
+	return 0;
+}
+
+static int msm_serial_rx_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_serial_rx_stats_show, inode->i_private);
+}
+
+/* writing anything clears the counters */
+static ssize_t msm_serial_rx_stats_write(struct file *file,
+					 const char __user *buf,
+					 size_t count, loff_t *ppos)
+{
+	struct msm_hs_port *msm_uport =
+		((struct seq_file *)file->private_data)->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&msm_uport->uport.lock, flags);
+	memset(&msm_uport->rx.stats, 0, sizeof(msm_uport->rx.stats));
+	spin_unlock_irqrestore(&msm_uport->uport.lock, flags);
+	return count;
+}
+
+static const struct file_operations rx_stats_fops = {
+	.open		= msm_serial_rx_stats_open,
+	.read		= seq_read,
+	.write		= msm_serial_rx_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 /*
  * msm_serial_hs debugfs node: <debugfs_root>/msm_serial_hs/loopback.<id>
  * writing 1 turns on internal loopback mode in HW. Useful for automation
  * test scripts.
  * writing 0 disables the internal loopback mode. Default is disabled.
+ *
+ * <debugfs_root>/msm_serial_hs/rx_stats.<id> shows the receive path
+ * counters and the current stale timeout; writing to it resets them.
  */
 static void __devinit msm_serial_debugfs_init(struct msm_hs_port *msm_uport,
 					   int id)
@@ -770,6 +861,17 @@ static void __devinit msm_serial_debugfs_init(struct msm_hs_port *msm_uport,
 	if (IS_ERR_OR_NULL(msm_uport->loopback_dir))
 		MSM_HS_ERR("%s(): Cannot create loopback.%d debug entry",
 							__func__, id);
+
+	snprintf(node_name, sizeof(node_name), "rx_stats.%d", id);
+	msm_uport->rx_stats_dir = debugfs_create_file(node_name,
+						S_IRUGO | S_IWUSR,
+						debug_base,
+						msm_uport,
+						&rx_stats_fops);
+
+	if (IS_ERR_OR_NULL(msm_uport->rx_stats_dir))
+		MSM_HS_ERR("%s(): Cannot create rx_stats.%d debug entry",
+							__func__, id);
 }
 
 static int __devexit msm_hs_remove(struct platform_device *pdev)
@@ -790,6 +892,7 @@ static int __devexit msm_hs_remove(struct platform_device *pdev)
 	dev = msm_uport->uport.dev;
 	sysfs_remove_file(&pdev->dev.kobj, &dev_attr_clock.attr);
 	debugfs_remove(msm_uport->loopback_dir);
+	debugfs_remove(msm_uport->rx_stats_dir);
 
 	dma_unmap_single(dev, msm_uport->rx.mapped_cmd_ptr, sizeof(dmov_box),
 			 DMA_TO_DEVICE);
@@ -931,6 +1034,56 @@ reg_event_err:
 	return ret;
 }
 
+static void msm_hs_write_stale(struct uart_port *uport, unsigned int rxstale)
+{
+	unsigned long data;
+
+	data = rxstale & UARTDM_IPR_STALE_LSB_BMSK;
+	data |= UARTDM_IPR_STALE_TIMEOUT_MSB_BMSK & (rxstale << 2);
+
+	msm_hs_write(uport, UART_DM_IPR, data);
+}
+
+/* program the per-baud stale timeout and the limit it may be stretched to */
+static void msm_hs_set_stale_locked(struct uart_port *uport,
+				    unsigned int bps, unsigned int rxstale)
+{
+	struct msm_hs_rx *rx = &UARTDM_TO_MSM(uport)->rx;
+
+	rx->stale_base = rxstale;
+	rx->stale_cur = rxstale;
+	rx->stale_max = max_t(unsigned int, rxstale,
+			      DIV_ROUND_UP((bps / 10) * rx_stale_max_us,
+					   USEC_PER_SEC));
+	msm_hs_write_stale(uport, rxstale);
+}
+
+/*
+ * Called for every completed rx transfer. A transfer that follows the
+ * previous one closely means a burst is being received: double the stale
+ * timeout, so that the next transfer gathers more of it. After a gap the
+ * per-baud timeout comes back, so a lone event is not held up.
+ */
+#define RX_BURST_GAP_US	2000
+
+static void msm_hs_rx_adapt_stale(struct msm_hs_port *msm_uport)
+{
+	struct msm_hs_rx *rx = &msm_uport->rx;
+	ktime_t now = ktime_get();
+	unsigned int stale = rx->stale_base;
+
+	if (rx_stale_max_us &&
+	    ktime_us_delta(now, rx->last_xfer) < RX_BURST_GAP_US)
+		stale = min(rx->stale_cur * 2, rx->stale_max);
+	rx->last_xfer = now;
+
+	if (stale == rx->stale_cur || msm_uport->clk_state != MSM_HS_CLK_ON)
+		return;
+	rx->stale_cur = stale;
+	rx->stats.stale_changes++;
+	msm_hs_write_stale(&msm_uport->uport, stale);
+}
+
 /*
  * programs the UARTDM_CSR register with correct bit rates
  *
@@ -944,7 +1097,6 @@ static void msm_hs_set_bps_locked(struct uart_port *uport,
 			       unsigned int bps)
 {
 	unsigned long rxstale;
-	unsigned long data;
 	struct msm_hs_port *msm_uport = UARTDM_TO_MSM(uport);
 
 	switch (bps) {
@@ -1058,10 +1210,7 @@ static void msm_hs_set_bps_locked(struct uart_port *uport,
 		WARN_ON(1);
 	}
 
-	data = rxstale & UARTDM_IPR_STALE_LSB_BMSK;
-	data |= UARTDM_IPR_STALE_TIMEOUT_MSB_BMSK & (rxstale << 2);
-
-	msm_hs_write(uport, UART_DM_IPR, data);
+	msm_hs_set_stale_locked(uport, bps, rxstale);
 	/*
 	 * It is suggested to do reset of transmitter and receiver after
 	 * changing any protocol configuration. Here Baud rate and stale
@@ -1076,7 +1225,6 @@ static void msm_hs_set_std_bps_locked(struct uart_port *uport,
 			       unsigned int bps)
 {
 	unsigned long rxstale;
-	unsigned long data;
 
 	switch (bps) {
 	case 9600:
@@ -1115,10 +1263,7 @@ static void msm_hs_set_std_bps_locked(struct uart_port *uport,
 		break;
 	}
 
-	data = rxstale & UARTDM_IPR_STALE_LSB_BMSK;
-	data |= UARTDM_IPR_STALE_TIMEOUT_MSB_BMSK & (rxstale << 2);
-
-	msm_hs_write(uport, UART_DM_IPR, data);
+	msm_hs_set_stale_locked(uport, bps, rxstale);
 }
 
 
@@ -1728,6 +1873,11 @@ static void msm_serial_hs_rx_tlet(unsigned long tlet_ptr)
 
 	MSM_HS_DBG("%s():[UART_RX]<%d>\n", __func__, rx_count);
 	hex_dump_ipc("HSUART Read: ", msm_uport->rx.buffer, rx_count);
+	rx->stats.xfers++;
+	rx->stats.bytes += rx_count;
+	if (rx_count >= UARTDM_RX_BUF_SIZE)
+		rx->stats.full++;
+	msm_hs_rx_adapt_stale(msm_uport);
 	if (0 != (uport->read_status_mask & CREAD)) {
 		retval = tty_insert_flip_string(tty, msm_uport->rx.buffer,
 						rx_count);
@@ -1757,6 +1907,7 @@ static void msm_serial_hs_rx_tlet(unsigned long tlet_ptr)
 out:
 	if (msm_uport->rx.buffer_pending) {
 		MSM_HS_WARN("tty buffer exhausted.Stalling\n");
+		rx->stats.stalls++;
 		schedule_delayed_work(&msm_uport->rx.flip_insert_work
 				      , msecs_to_jiffies(RETRY_TIMEOUT));
 	}
@@ -2255,6 +2406,7 @@ static irqreturn_t msm_hs_isr(int irq, void *dev)
 	}
 	/* Stale rx interrupt */
 	if (isr_status & UARTDM_ISR_RXSTALE_BMSK) {
+		rx->stats.stale_irqs++;
 		msm_hs_write(uport, UART_DM_CR, STALE_EVENT_DISABLE);
 		msm_hs_write(uport, UART_DM_CR, RESET_STALE_INT);
 		/*
@@ -283,6 +283,8 @@
 #include <linux/kref.h>
 #include <linux/kthread.h>
 #include <linux/limits.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
 #include <linux/rwsem.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
@@ -314,6 +316,37 @@ static const char fsg_string_interface[] = "Mass Storage";
 static int write_error_after_csw_sent;
 static int csw_hack_sent;
 #endif
+
+/* Largest pipeline buffer we accept */
+#define FSG_MAX_BUFLEN	((u32)262144)
+
+/*
+ * Size of each pipeline buffer.  Larger buffers mean fewer and bigger
+ * vfs_read()/vfs_write() calls per SCSI command.
+ */
+static unsigned int fsg_buflen = FSG_BUFLEN;
+module_param_named(buflen, fsg_buflen, uint, S_IRUGO);
+MODULE_PARM_DESC(buflen, "Size of each pipeline buffer, a multiple of 4096");
+
+static unsigned int fsg_readahead_kb = 512;
+module_param_named(readahead_kb, fsg_readahead_kb, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(readahead_kb,
+		 "Readahead past the end of sequential READs, 0 disables readahead");
+
+static unsigned int fsg_writeback_kb = 1024;
+module_param_named(writeback_kb, fsg_writeback_kb, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(writeback_kb,
+		 "Start writeback of sequential WRITEs every this many KB, 0 disables");
+
+static inline int fsg_buflen_validate(void)
+{
+	if (fsg_buflen >= 4096 && fsg_buflen <= FSG_MAX_BUFLEN &&
+	    !(fsg_buflen % 4096))
+		return 0;
+	pr_err("fsg_buflen %u is not a multiple of 4096 from 4096 to %u\n",
+	       fsg_buflen, FSG_MAX_BUFLEN);
+	return -EINVAL;
+}
 /*-------------------------------------------------------------------------*/
 
 struct fsg_dev;
@@ -751,6 +784,63 @@ static int sleep_thread(struct fsg_common *common)
 
 /*-------------------------------------------------------------------------*/
 
+/*
+ * Submit the page cache reads for a whole READ command before it is copied
+ * out buffer by buffer, so the block layer sees one large request instead
+ * of one per pipeline buffer.  A READ that starts where the previous one
+ * ended also prefetches readahead_kb for the command that will follow.
+ */
+static void fsg_lun_readahead(struct fsg_lun *curlun, loff_t offset,
+			      u32 amount)
+{
+	struct file	*filp = curlun->filp;
+	loff_t		end = offset + amount;
+	pgoff_t		index;
+	unsigned long	nr_pages;
+
+	if (!fsg_readahead_kb)
+		return;
+
+	if (offset == curlun->ra_next)
+		end += (loff_t)fsg_readahead_kb << 10;
+	curlun->ra_next = offset + amount;
+
+	end = min(end, curlun->file_length);
+	if (end <= offset)
+		return;
+
+	index = offset >> PAGE_CACHE_SHIFT;
+	nr_pages = ((end - 1) >> PAGE_CACHE_SHIFT) - index + 1;
+	if (filp->f_ra.ra_pages < nr_pages)
+		filp->f_ra.ra_pages = nr_pages;
+	page_cache_sync_readahead(filp->f_mapping, &filp->f_ra, filp,
+				  index, nr_pages);
+}
+
+/*
+ * Start writeback once a sequential stream of WRITEs has dirtied
+ * writeback_kb, so the data goes out in large chunks while the host is
+ * still sending instead of piling up for the flusher threads.
+ */
+static void fsg_lun_writeback(struct fsg_lun *curlun, loff_t offset,
+			      ssize_t amount)
+{
+	if (!fsg_writeback_kb)
+		return;
+
+	if (offset != curlun->wb_end)
+		curlun->wb_start = offset;
+	curlun->wb_end = offset + amount;
+
+	if (curlun->wb_end - curlun->wb_start <
+	    ((loff_t)fsg_writeback_kb << 10))
+		return;
+
+	filemap_fdatawrite_range(curlun->filp->f_mapping, curlun->wb_start,
+				 curlun->wb_end - 1);
+	curlun->wb_start = curlun->wb_end;
+}
+
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
@@ -795,6 +885,8 @@ static int do_read(struct fsg_common *common)
 	if (unlikely(amount_left == 0))
 		return -EIO;		/* No default reply */
 
+	fsg_lun_readahead(curlun, file_offset, amount_left);
+
 	for (;;) {
 		/*
 		 * Figure out how much we need to read:
@@ -802,7 +894,7 @@ static int do_read(struct fsg_common *common)
 		 * But don't read more than the buffer size.
 		 * And don't try to read past the end of the file.
 		 */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, fsg_buflen);
 		amount = min((loff_t)amount,
 			     curlun->file_length - file_offset);
 
@@ -851,6 +943,9 @@ static int do_read(struct fsg_common *common)
 		diff = ktime_sub(ktime_get(), start);
 		curlun->perf.rbytes += nread;
 		curlun->perf.rtime = ktime_add(curlun->perf.rtime, diff);
+		curlun->perf.rcount++;
+		if (ktime_to_ns(diff) > ktime_to_ns(curlun->perf.rmax))
+			curlun->perf.rmax = diff;
 #endif
 		if (signal_pending(current))
 			return -EINTR;
@@ -977,7 +1072,7 @@ static int do_write(struct fsg_common *common)
 			 * Try to get the remaining amount,
 			 * but not more than the buffer size.
 			 */
-			amount = min(amount_left_to_req, FSG_BUFLEN);
+			amount = min(amount_left_to_req, fsg_buflen);
 
 			/* Beyond the end of the backing file? */
 			if (usb_offset >= curlun->file_length) {
@@ -1072,6 +1167,9 @@ static int do_write(struct fsg_common *common)
 			curlun->perf.wbytes += nwritten;
 			curlun->perf.wtime =
 					ktime_add(curlun->perf.wtime, diff);
+			curlun->perf.wcount++;
+			if (ktime_to_ns(diff) > ktime_to_ns(curlun->perf.wmax))
+				curlun->perf.wmax = diff;
 #endif
 			if (signal_pending(current))
 				return -EINTR;		/* Interrupted! */
@@ -1085,6 +1183,8 @@ static int do_write(struct fsg_common *common)
 				     (int)nwritten, amount);
 				nwritten = round_down(nwritten, curlun->blksize);
 			}
+			if (nwritten > 0)
+				fsg_lun_writeback(curlun, file_offset, nwritten);
 			file_offset += nwritten;
 			amount_left_to_write -= nwritten;
 			common->residue -= nwritten;
@@ -1228,7 +1328,7 @@ static int do_verify(struct fsg_common *common)
 		 * the buffer size.
 		 * And don't try to read past the end of the file.
 		 */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, fsg_buflen);
 		amount = min((loff_t)amount,
 			     curlun->file_length - file_offset);
 		if (amount == 0) {
@@ -1780,7 +1880,7 @@ static int throw_away_data(struct fsg_common *common)
 		bh = common->next_buffhd_to_fill;
 		if (bh->state == BUF_STATE_EMPTY
 		 && common->usb_amount_left > 0) {
-			amount = min(common->usb_amount_left, FSG_BUFLEN);
+			amount = min(common->usb_amount_left, fsg_buflen);
 
 			/*
 			 * Except at the end of the transfer, amount will be
@@ -2973,6 +3073,10 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 	if (rc != 0)
 		return ERR_PTR(rc);
 
+	rc = fsg_buflen_validate();
+	if (rc != 0)
+		return ERR_PTR(rc);
+
 	/* Find out how many LUNs there should be */
 	nluns = cfg->nluns;
 	if (nluns < 1 || nluns > FSG_MAX_LUNS) {
@@ -3079,7 +3183,7 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 		bh->next = bh + 1;
 		++bh;
 buffhds_first_it:
-		bh->buf = kmalloc(FSG_BUFLEN, GFP_KERNEL);
+		bh->buf = kmalloc(fsg_buflen, GFP_KERNEL);
 		if (unlikely(!bh->buf)) {
 			rc = -ENOMEM;
 			goto error_release;
@@ -3287,7 +3391,7 @@ static int fsg_bind(struct usb_configuration *c, struct usb_function *f)
 		unsigned	max_burst;
 
 		/* Calculate bMaxBurst, we know packet size is 1024 */
-		max_burst = min_t(unsigned, FSG_BUFLEN / 1024, 15);
+		max_burst = min_t(unsigned, fsg_buflen / 1024, 15);
 
 		fsg_ss_bulk_in_desc.bEndpointAddress =
 			fsg_fs_bulk_in_desc.bEndpointAddress;
@@ -37,6 +37,7 @@
 #include <linux/usb/f_mtp.h>
 
 #define MTP_BULK_BUFFER_SIZE       16384
+#define MTP_HS_BULK_BUFFER_SIZE    65536
 #define INTR_BUFFER_SIZE           28
 
 /* String IDs */
@@ -51,7 +52,8 @@
 
 /* number of tx and rx requests to allocate */
 #define MTP_TX_REQ_MAX 8
-#define RX_REQ_MAX 2
+#define MTP_RX_REQ_MAX 8
+#define MTP_RX_REQS 4
 #define INTR_REQ_MAX 5
 
 /* ID for Microsoft MTP OS String */
@@ -78,6 +80,9 @@ module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
 unsigned int mtp_tx_reqs = MTP_TX_REQ_MAX;
 module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
 
+unsigned int mtp_rx_reqs = MTP_RX_REQS;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+
 static const char mtp_shortname[] = "mtp_usb";
 
 struct mtp_dev {
@@ -102,7 +107,8 @@ struct mtp_dev {
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
 	wait_queue_head_t intr_wq;
-	struct usb_request *rx_req[RX_REQ_MAX];
+	struct usb_request *rx_req[MTP_RX_REQ_MAX];
+	/* number of rx_req completions since it was last cleared */
 	int rx_done;
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
@@ -454,7 +460,7 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
 
-	dev->rx_done = 1;
+	dev->rx_done++;
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
@@ -473,50 +479,31 @@ static void mtp_complete_intr(struct usb_ep *ep, struct usb_request *req)
 	wake_up(&dev->intr_wq);
 }
 
-static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
-				struct usb_endpoint_descriptor *in_desc,
-				struct usb_endpoint_descriptor *out_desc,
-				struct usb_endpoint_descriptor *intr_desc)
+static void mtp_free_xfer_requests(struct mtp_dev *dev)
 {
-	struct usb_composite_dev *cdev = dev->cdev;
 	struct usb_request *req;
-	struct usb_ep *ep;
 	int i;
 
-	DBG(cdev, "create_bulk_endpoints dev: %p\n", dev);
-
-	ep = usb_ep_autoconfig(cdev->gadget, in_desc);
-	if (!ep) {
-		DBG(cdev, "usb_ep_autoconfig for ep_in failed\n");
-		return -ENODEV;
-	}
-	DBG(cdev, "usb_ep_autoconfig for ep_in got %s\n", ep->name);
-	ep->driver_data = dev;		/* claim the endpoint */
-	dev->ep_in = ep;
-
-	ep = usb_ep_autoconfig(cdev->gadget, out_desc);
-	if (!ep) {
-		DBG(cdev, "usb_ep_autoconfig for ep_out failed\n");
-		return -ENODEV;
+	while ((req = mtp_req_get(dev, &dev->tx_idle)))
+		mtp_request_free(req, dev->ep_in);
+	for (i = 0; i < MTP_RX_REQ_MAX; i++) {
+		mtp_request_free(dev->rx_req[i], dev->ep_out);
+		dev->rx_req[i] = NULL;
 	}
-	DBG(cdev, "usb_ep_autoconfig for mtp ep_out got %s\n", ep->name);
-	ep->driver_data = dev;		/* claim the endpoint */
-	dev->ep_out = ep;
+}
 
-	ep = usb_ep_autoconfig(cdev->gadget, intr_desc);
-	if (!ep) {
-		DBG(cdev, "usb_ep_autoconfig for ep_intr failed\n");
-		return -ENODEV;
-	}
-	DBG(cdev, "usb_ep_autoconfig for mtp ep_intr got %s\n", ep->name);
-	ep->driver_data = dev;		/* claim the endpoint */
-	dev->ep_intr = ep;
+/* allocate the bulk requests described by mtp_{tx,rx}_req{s,_len},
+ * falling back to the default buffer size if larger ones can't be had
+ */
+static int mtp_alloc_xfer_requests(struct mtp_dev *dev)
+{
+	struct usb_request *req;
+	int i;
 
 retry_tx_alloc:
-	if (mtp_tx_req_len > MTP_BULK_BUFFER_SIZE)
+	if (mtp_tx_req_len > MTP_BULK_BUFFER_SIZE && mtp_tx_reqs > 4)
 		mtp_tx_reqs = 4;
 
-	/* now allocate requests for our endpoints */
 	for (i = 0; i < mtp_tx_reqs; i++) {
 		req = mtp_request_new(dev->ep_in, mtp_tx_req_len);
 		if (!req) {
@@ -540,21 +527,86 @@ retry_tx_alloc:
 	 */
 	if (mtp_rx_req_len % 1024)
 		mtp_rx_req_len = MTP_BULK_BUFFER_SIZE;
+	if (mtp_rx_reqs == 0 || mtp_rx_reqs > MTP_RX_REQ_MAX)
+		mtp_rx_reqs = MTP_RX_REQS;
 
 retry_rx_alloc:
-	for (i = 0; i < RX_REQ_MAX; i++) {
+	for (i = 0; i < mtp_rx_reqs; i++) {
 		req = mtp_request_new(dev->ep_out, mtp_rx_req_len);
 		if (!req) {
 			if (mtp_rx_req_len <= MTP_BULK_BUFFER_SIZE)
 				goto fail;
-			for (; i > 0; i--)
+			while (--i >= 0) {
 				mtp_request_free(dev->rx_req[i], dev->ep_out);
+				dev->rx_req[i] = NULL;
+			}
 			mtp_rx_req_len = MTP_BULK_BUFFER_SIZE;
 			goto retry_rx_alloc;
 		}
 		req->complete = mtp_complete_out;
 		dev->rx_req[i] = req;
 	}
+
+	return 0;
+
+fail:
+	mtp_free_xfer_requests(dev);
+	return -ENOMEM;
+}
+
+static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
+				struct usb_endpoint_descriptor *in_desc,
+				struct usb_endpoint_descriptor *out_desc,
+				struct usb_endpoint_descriptor *intr_desc)
+{
+	struct usb_composite_dev *cdev = dev->cdev;
+	struct usb_request *req;
+	struct usb_ep *ep;
+	int i;
+
+	DBG(cdev, "create_bulk_endpoints dev: %p\n", dev);
+
+	ep = usb_ep_autoconfig(cdev->gadget, in_desc);
+	if (!ep) {
+		DBG(cdev, "usb_ep_autoconfig for ep_in failed\n");
+		return -ENODEV;
+	}
+	DBG(cdev, "usb_ep_autoconfig for ep_in got %s\n", ep->name);
+	ep->driver_data = dev;		/* claim the endpoint */
+	dev->ep_in = ep;
+
+	ep = usb_ep_autoconfig(cdev->gadget, out_desc);
+	if (!ep) {
+		DBG(cdev, "usb_ep_autoconfig for ep_out failed\n");
+		return -ENODEV;
+	}
+	DBG(cdev, "usb_ep_autoconfig for mtp ep_out got %s\n", ep->name);
+	ep->driver_data = dev;		/* claim the endpoint */
+	dev->ep_out = ep;
+
+	ep = usb_ep_autoconfig(cdev->gadget, intr_desc);
+	if (!ep) {
+		DBG(cdev, "usb_ep_autoconfig for ep_intr failed\n");
+		return -ENODEV;
+	}
+	DBG(cdev, "usb_ep_autoconfig for mtp ep_intr got %s\n", ep->name);
+	ep->driver_data = dev;		/* claim the endpoint */
+	dev->ep_intr = ep;
+
+	/* high speed capable controllers get larger requests unless the
+	 * sizes were set explicitly
+	 */
+	if (gadget_is_dualspeed(cdev->gadget)) {
+		if (mtp_tx_req_len == MTP_BULK_BUFFER_SIZE)
+			mtp_tx_req_len = MTP_HS_BULK_BUFFER_SIZE;
+		if (mtp_rx_req_len == MTP_BULK_BUFFER_SIZE)
+			mtp_rx_req_len = MTP_HS_BULK_BUFFER_SIZE;
+	}
+
+	/* now allocate requests for our endpoints */
+	if (mtp_alloc_xfer_requests(dev))
+		goto fail;
+
 	for (i = 0; i < INTR_REQ_MAX; i++) {
 		req = mtp_request_new(dev->ep_intr, INTR_BUFFER_SIZE);
 		if (!req)
@@ -863,11 +915,11 @@ static void receive_file_work(struct work_struct *data)
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
 						receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *read_req;
 	struct file *filp;
 	loff_t offset;
-	int64_t count;
-	int ret, len, cur_buf = 0;
+	int64_t count, unqueued;
+	int ret, len, rx_reqs, head = 0, tail = 0, pending = 0, done = 0;
 	int r = 0;
 
 	/* read our parameters */
@@ -878,23 +930,29 @@ static void receive_file_work(struct work_struct *data)
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
+	/* A transfer of unknown length (0xFFFFFFFF) ends with a short
+	 * packet, and a read queued past it would swallow the next
+	 * command from the host, so only those run one read at a time.
+	 */
+	rx_reqs = (count == 0xFFFFFFFF) ? 1 : mtp_rx_reqs;
+	unqueued = count;
+	dev->rx_done = 0;
+
+	while (count > 0) {
+		/* keep the OUT endpoint busy while we write to the file */
+		while (unqueued > 0 && pending < rx_reqs) {
+			read_req = dev->rx_req[tail];
 
 			/* The ALIGN macro may overflow if count is very large, so we only use it
 			 * if count <= mtp_rx_req_len.  This is safe because mtp_rx_req_len
 			 * should already be aligned.
 			 */
-			if (count <= mtp_rx_req_len)
-				len = ALIGN(count, dev->ep_out->maxpacket);
+			if (unqueued <= mtp_rx_req_len)
+				len = ALIGN(unqueued, dev->ep_out->maxpacket);
 			else
 				len = mtp_rx_req_len;
 			read_req->length = len;
 
-			dev->rx_done = 0;
 			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
@@ -902,59 +960,71 @@ static void receive_file_work(struct work_struct *data)
 					dev->state = STATE_ERROR;
 				break;
 			}
+			tail = (tail + 1) % rx_reqs;
+			pending++;
+			if (unqueued != 0xFFFFFFFF)
+				unqueued -= len;
 		}
+		if (r || !pending)
+			break;
 
-		if (write_req) {
-			DBG(cdev, "rx %p %d\n", write_req, write_req->actual);
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			DBG(cdev, "vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
+		/* wait for the oldest read to complete */
+		read_req = dev->rx_req[head];
+		ret = wait_event_interruptible(dev->read_wq,
+			dev->rx_done > done || dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED
+				|| dev->state == STATE_OFFLINE) {
+			if (dev->state == STATE_OFFLINE)
 				r = -EIO;
-				if (dev->state != STATE_OFFLINE)
-					dev->state = STATE_ERROR;
-				break;
-			}
-			write_req = NULL;
+			else
+				r = -ECANCELED;
+			break;
 		}
-
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED
-					|| dev->state == STATE_OFFLINE) {
-				if (dev->state == STATE_OFFLINE)
-					r = -EIO;
-				else
-					r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			/* Check if we aligned the size due to MTU constraint */
-			if (count < read_req->length)
-				read_req->actual = (read_req->actual > count ?
-						count : read_req->actual);
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
+		if (dev->rx_done <= done) {
+			r = ret < 0 ? ret : -EIO;
+			break;
+		}
+		done++;
+		head = (head + 1) % rx_reqs;
+		pending--;
+
+		/* Check if we aligned the size due to MTU constraint */
+		if (count < read_req->length)
+			read_req->actual = (read_req->actual > count ?
+					count : read_req->actual);
+		/* if xfer_file_length is 0xFFFFFFFF, then we read until
+		 * we get a zero length packet
+		 */
+		if (count != 0xFFFFFFFF)
+			count -= read_req->actual;
+		if (read_req->actual < read_req->length) {
+			/*
+			 * short packet is used to signal EOF for
+			 * sizes > 4 gig
 			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/*
-				 * short packet is used to signal EOF for
-				 * sizes > 4 gig
-				 */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
+			DBG(cdev, "got short packet\n");
+			count = 0;
+			unqueued = 0;
+		}
 
-			write_req = read_req;
-			read_req = NULL;
+		DBG(cdev, "rx %p %d\n", read_req, read_req->actual);
+		ret = vfs_write(filp, read_req->buf, read_req->actual,
+			&offset);
+		DBG(cdev, "vfs_write %d\n", ret);
+		if (ret != read_req->actual) {
+			r = -EIO;
+			if (dev->state != STATE_OFFLINE)
+				dev->state = STATE_ERROR;
+			break;
 		}
 	}
 
+	/* take back reads still queued after an error or a short packet */
+	while (pending--) {
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[head]);
+		head = (head + 1) % rx_reqs;
+	}
+
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -992,6 +1062,43 @@ static int mtp_send_event(struct mtp_dev *dev, struct mtp_event *event)
 	return ret;
 }
 
+static int mtp_set_xfer_config(struct mtp_dev *dev,
+		struct mtp_xfer_config *cfg)
+{
+	struct usb_request *req;
+	unsigned idle = 0;
+
+	DBG(dev->cdev, "mtp_set_xfer_config(%u x %u, %u x %u)\n",
+		cfg->tx_reqs, cfg->tx_req_len, cfg->rx_reqs, cfg->rx_req_len);
+
+	if (!cfg->tx_reqs || !cfg->tx_req_len ||
+	    cfg->tx_req_len > KMALLOC_MAX_SIZE ||
+	    !cfg->rx_reqs || cfg->rx_reqs > MTP_RX_REQ_MAX ||
+	    !cfg->rx_req_len || cfg->rx_req_len % 1024 ||
+	    cfg->rx_req_len > KMALLOC_MAX_SIZE)
+		return -EINVAL;
+
+	/* every IN request must be back from the controller */
+	spin_lock_irq(&dev->lock);
+	if (dev->state == STATE_BUSY) {
+		spin_unlock_irq(&dev->lock);
+		return -EBUSY;
+	}
+	list_for_each_entry(req, &dev->tx_idle, list)
+		idle++;
+	spin_unlock_irq(&dev->lock);
+	if (idle != mtp_tx_reqs)
+		return -EBUSY;
+
+	mtp_free_xfer_requests(dev);
+	mtp_tx_req_len = cfg->tx_req_len;
+	mtp_tx_reqs = cfg->tx_reqs;
+	mtp_rx_req_len = cfg->rx_req_len;
+	mtp_rx_reqs = cfg->rx_reqs;
+
+	return mtp_alloc_xfer_requests(dev);
+}
+
 static long mtp_ioctl(struct file *fp, unsigned code, unsigned long value)
 {
 	struct mtp_dev *dev = fp->private_data;
@@ -1080,6 +1187,16 @@ static long mtp_ioctl(struct file *fp, unsigned code, unsigned long value)
 			ret = mtp_send_event(dev, &event);
 		goto out;
 	}
+	case MTP_SET_XFER_CONFIG:
+	{
+		struct mtp_xfer_config	cfg;
+
+		if (copy_from_user(&cfg, (void __user *)value, sizeof(cfg)))
+			ret = -EFAULT;
+		else
+			ret = mtp_set_xfer_config(dev, &cfg);
+		goto out;
+	}
 	}
 
 fail:
@@ -1274,12 +1391,8 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 {
 	struct mtp_dev	*dev = func_to_mtp(f);
 	struct usb_request *req;
-	int i;
 
-	while ((req = mtp_req_get(dev, &dev->tx_idle)))
-		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
-		mtp_request_free(dev->rx_req[i], dev->ep_out);
+	mtp_free_xfer_requests(dev);
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
 	dev->state = STATE_OFFLINE;
@@ -503,6 +503,8 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 	buf = (rndis_init_msg_type *)req->buf;
 
 	if (buf->MessageType == REMOTE_NDIS_INITIALIZE_MSG) {
+		rndis->port.dl_max_xfer_size =
+				le32_to_cpu(buf->MaxTransferSize);
 		if (buf->MaxTransferSize > 2048)
 			rndis->port.multi_pkt_xfer = 1;
 		else
@@ -44,9 +44,9 @@
  */
 
 /*
- * When USB_GADGET_DEBUG_FILES is defined the module param num_buffers
- * sets the number of pipeline buffers (length of the fsg_buffhd array).
- * The valid range of num_buffers is: num >= 2 && num <= 4.
+ * The module param num_buffers sets the number of pipeline buffers
+ * (length of the fsg_buffhd array).
+ * The valid range of num_buffers is: num >= 2 && num <= 32.
  */
 
 
@@ -206,6 +206,11 @@ struct fsg_lun {
 
 	unsigned int	blkbits;	/* Bits of logical block size of bound block device */
 	unsigned int	blksize;	/* logical block size of bound block device */
+
+	loff_t		ra_next;	/* where a sequential READ would start */
+	loff_t		wb_start;	/* written range not yet sent to writeback */
+	loff_t		wb_end;
+
 	struct device	dev;
 #ifdef CONFIG_USB_MSC_PROFILING
 	spinlock_t	lock;
@@ -215,6 +220,10 @@ struct fsg_lun {
 		unsigned long wbytes;
 		ktime_t rtime;
 		ktime_t wtime;
+		unsigned long rcount;
+		unsigned long wcount;
+		ktime_t rmax;
+		ktime_t wmax;
 	} perf;
 
 #endif
@@ -232,33 +241,31 @@ static struct fsg_lun *fsg_lun_from_dev(struct device *dev)
 #define EP0_BUFSIZE	256
 #define DELAYED_STATUS	(EP0_BUFSIZE + 999)	/* An impossibly large value */
 
+/* Maximal number of pipeline buffers */
+#define FSG_MAX_NUM_BUFFERS	32
+
 #ifdef CONFIG_USB_CSW_HACK
 #define fsg_num_buffers		4
-#else
-#ifdef CONFIG_USB_GADGET_DEBUG_FILES
-
-static unsigned int fsg_num_buffers = CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS;
-module_param_named(num_buffers, fsg_num_buffers, uint, S_IRUGO);
-MODULE_PARM_DESC(num_buffers, "Number of pipeline buffers");
-
 #else
 
 /*
  * Number of buffers we will use.
- * 2 is usually enough for good buffering pipeline
+ * 2 is usually enough for good buffering pipeline, more help to ride
+ * out bursty VFS latencies.
  */
-#define fsg_num_buffers	CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS
+static unsigned int fsg_num_buffers = CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS;
+module_param_named(num_buffers, fsg_num_buffers, uint, S_IRUGO);
+MODULE_PARM_DESC(num_buffers, "Number of pipeline buffers");
 
-#endif /* CONFIG_USB_DEBUG */
 #endif /* CONFIG_USB_CSW_HACK */
 
 /* check if fsg_num_buffers is within a valid range */
 static inline int fsg_num_buffers_validate(void)
 {
-	if (fsg_num_buffers >= 2 && fsg_num_buffers <= 4)
+	if (fsg_num_buffers >= 2 && fsg_num_buffers <= FSG_MAX_NUM_BUFFERS)
 		return 0;
 	pr_err("fsg_num_buffers %u is out of range (%d to %d)\n",
-	       fsg_num_buffers, 2 ,4);
+	       fsg_num_buffers, 2, FSG_MAX_NUM_BUFFERS);
 	return -EINVAL;
 }
 
@@ -806,21 +813,40 @@ static ssize_t fsg_show_perf(struct device *dev, struct device_attribute *attr,
 			      char *buf)
 {
 	struct fsg_lun	*curlun = fsg_lun_from_dev(dev);
-	unsigned long rbytes, wbytes;
-	int64_t rtime, wtime;
+	unsigned long rbytes, wbytes, rcount, wcount;
+	int64_t rtime, wtime, rmax, wmax;
 
 	spin_lock(&curlun->lock);
 	rbytes = curlun->perf.rbytes;
 	wbytes = curlun->perf.wbytes;
 	rtime = ktime_to_us(curlun->perf.rtime);
 	wtime = ktime_to_us(curlun->perf.wtime);
+	rcount = curlun->perf.rcount;
+	wcount = curlun->perf.wcount;
+	rmax = ktime_to_us(curlun->perf.rmax);
+	wmax = ktime_to_us(curlun->perf.wmax);
 	spin_unlock(&curlun->lock);
 
+	/* KB/s over the time spent in VFS, average and worst call latency */
 	return snprintf(buf, PAGE_SIZE, "Write performance :"
 					"%lu bytes in %lld microseconds\n"
 					"Read performance :"
-					"%lu bytes in %lld microseconds\n",
-					wbytes, wtime, rbytes, rtime);
+					"%lu bytes in %lld microseconds\n"
+					"Write: %llu KB/s, %lu calls, "
+					"latency avg %lld max %lld us\n"
+					"Read: %llu KB/s, %lu calls, "
+					"latency avg %lld max %lld us\n",
+					wbytes, wtime, rbytes, rtime,
+					wtime ? div64_u64((u64)wbytes * 1000000 >> 10,
+							  wtime) : 0ULL,
+					wcount,
+					wcount ? div64_s64(wtime, wcount) : 0LL,
+					wmax,
+					rtime ? div64_u64((u64)rbytes * 1000000 >> 10,
+							  rtime) : 0ULL,
+					rcount,
+					rcount ? div64_s64(rtime, rcount) : 0LL,
+					rmax);
 }
 static ssize_t fsg_store_perf(struct device *dev, struct device_attribute *attr,
 			const char *buf, size_t count)
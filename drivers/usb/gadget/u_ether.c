@@ -19,6 +19,7 @@
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
+#include <linux/hrtimer.h>
 
 #include "u_ether.h"
 
@@ -66,6 +67,14 @@ struct eth_dev {
 	int			no_tx_req_used;
 	int			tx_skb_hold_count;
 	u32			tx_req_bufsize;
+	/* sends a partly filled multi packet request nobody else flushed */
+	struct hrtimer		tx_timer;
+
+	/* USB transfers and the frames they carried, see eth_stats_strings */
+	u64			tx_xfers;
+	u64			tx_pkts;
+	u64			rx_xfers;
+	u64			rx_pkts;
 
 	struct sk_buff_head	rx_frames;
 
@@ -97,6 +106,11 @@ static unsigned qmult = 5;
 module_param(qmult, uint, S_IRUGO|S_IWUSR);
 MODULE_PARM_DESC(qmult, "queue length multiplier at high/super speed");
 
+static unsigned tx_aggr_flush_us = 1000;
+module_param(tx_aggr_flush_us, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(tx_aggr_flush_us,
+		 "max time a partly aggregated tx transfer is held, 0 = no limit");
+
 /* for dual-speed hardware, use deeper queues at high/super speed */
 static inline int qlen(struct usb_gadget *gadget)
 {
@@ -181,9 +195,43 @@ static void eth_get_drvinfo(struct net_device *net, struct ethtool_drvinfo *p)
  *   - ... probably more ethtool ops
  */
 
+static const char eth_stats_strings[][ETH_GSTRING_LEN] = {
+	"tx_usb_xfers",
+	"tx_usb_pkts",
+	"rx_usb_xfers",
+	"rx_usb_pkts",
+};
+
+static int eth_get_sset_count(struct net_device *net, int sset)
+{
+	if (sset != ETH_SS_STATS)
+		return -EOPNOTSUPP;
+	return ARRAY_SIZE(eth_stats_strings);
+}
+
+static void eth_get_strings(struct net_device *net, u32 sset, u8 *data)
+{
+	if (sset == ETH_SS_STATS)
+		memcpy(data, eth_stats_strings, sizeof(eth_stats_strings));
+}
+
+static void eth_get_ethtool_stats(struct net_device *net,
+				  struct ethtool_stats *stats, u64 *data)
+{
+	struct eth_dev	*dev = netdev_priv(net);
+
+	data[0] = dev->tx_xfers;
+	data[1] = dev->tx_pkts;
+	data[2] = dev->rx_xfers;
+	data[3] = dev->rx_pkts;
+}
+
 static const struct ethtool_ops ops = {
 	.get_drvinfo = eth_get_drvinfo,
 	.get_link = ethtool_op_get_link,
+	.get_sset_count = eth_get_sset_count,
+	.get_strings = eth_get_strings,
+	.get_ethtool_stats = eth_get_ethtool_stats,
 };
 
 static void defer_kevent(struct eth_dev *dev, int flag)
@@ -285,13 +333,16 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 		skb_put(skb, req->actual);
 
 		if (dev->unwrap) {
+			struct sk_buff_head	frames;
 			unsigned long	flags;
 
+			/* unwrap into a private list to count the frames */
+			skb_queue_head_init(&frames);
 			spin_lock_irqsave(&dev->lock, flags);
 			if (dev->port_usb) {
 				status = dev->unwrap(dev->port_usb,
 							skb,
-							&dev->rx_frames);
+							&frames);
 				if (status == -EINVAL)
 					dev->net->stats.rx_errors++;
 				else if (status == -EOVERFLOW)
@@ -301,7 +352,15 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 				status = -ENOTCONN;
 			}
 			spin_unlock_irqrestore(&dev->lock, flags);
+
+			dev->rx_xfers++;
+			dev->rx_pkts += skb_queue_len(&frames);
+			spin_lock_irqsave(&dev->rx_frames.lock, flags);
+			skb_queue_splice_tail_init(&frames, &dev->rx_frames);
+			spin_unlock_irqrestore(&dev->rx_frames.lock, flags);
 		} else {
+			dev->rx_xfers++;
+			dev->rx_pkts++;
 			skb_queue_tail(&dev->rx_frames, skb);
 		}
 
@@ -490,15 +549,91 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+/*
+ * In multi packet mode eth_start_xmit() may leave a partly filled request
+ * at the head of tx_reqs while enough others are in flight.  Send it now:
+ * called when one of those completes, or when tx_timer expires.
+ */
+static void tx_send_held_req(struct eth_dev *dev)
+{
+	struct usb_request	*req;
+	struct usb_ep		*in;
+	unsigned long		flags;
+	int			length;
+	int			retval;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	in = dev->port_usb ? dev->port_usb->in_ep : NULL;
+	spin_unlock_irqrestore(&dev->lock, flags);
+	if (!in)
+		return;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (list_empty(&dev->tx_reqs)) {
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return;
+	}
+	req = container_of(dev->tx_reqs.next, struct usb_request, list);
+	if (!req->length) {
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return;
+	}
+	list_del(&req->list);
+	dev->tx_xfers++;
+	dev->tx_pkts += dev->tx_skb_hold_count;
+	dev->tx_skb_hold_count = 0;
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	length = req->length;
+
+	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
+	if (dev->port_usb->is_fixed &&
+		length == dev->port_usb->fixed_in_len &&
+		(length % in->maxpacket) == 0)
+		req->zero = 0;
+	else
+		req->zero = 1;
+
+	/* use zlp framing on tx for strict CDC-Ether
+	 * conformance, though any robust network rx
+	 * path ignores extra padding. and some hardware
+	 * doesn't like to write zlps.
+	 */
+	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0) {
+		req->zero = 0;
+		length++;
+	}
+
+	req->length = length;
+	req->complete = tx_complete;
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	spin_lock_irqsave(&dev->req_lock, flags);
+	switch (retval) {
+	default:
+		DBG(dev, "tx queue err %d\n", retval);
+		req->length = 0;
+		list_add_tail(&req->list, &dev->tx_reqs);
+		break;
+	case 0:
+		dev->no_tx_req_used++;
+		dev->net->trans_start = jiffies;
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
+static enum hrtimer_restart tx_timer_expired(struct hrtimer *timer)
+{
+	struct eth_dev	*dev = container_of(timer, struct eth_dev, tx_timer);
+
+	tx_send_held_req(dev);
+	return HRTIMER_NORESTART;
+}
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb;
 	struct eth_dev	*dev;
 	struct net_device *net;
-	struct usb_request *new_req;
-	struct usb_ep *in;
-	int length;
-	int retval;
 
 	if (!ep->driver_data) {
 		usb_ep_free_request(ep, req);
@@ -535,68 +670,8 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	if (dev->port_usb->multi_pkt_xfer) {
 		dev->no_tx_req_used--;
 		req->length = 0;
-		in = dev->port_usb->in_ep;
-
-		if (!list_empty(&dev->tx_reqs)) {
-			new_req = container_of(dev->tx_reqs.next,
-					struct usb_request, list);
-			list_del(&new_req->list);
-			spin_unlock(&dev->req_lock);
-			if (new_req->length > 0) {
-				length = new_req->length;
-
-				/* NCM requires no zlp if transfer is
-				 * dwNtbInMaxSize */
-				if (dev->port_usb->is_fixed &&
-					length == dev->port_usb->fixed_in_len &&
-					(length % in->maxpacket) == 0)
-					new_req->zero = 0;
-				else
-					new_req->zero = 1;
-
-				/* use zlp framing on tx for strict CDC-Ether
-				 * conformance, though any robust network rx
-				 * path ignores extra padding. and some hardware
-				 * doesn't like to write zlps.
-				 */
-				if (new_req->zero && !dev->zlp &&
-						(length % in->maxpacket) == 0) {
-					new_req->zero = 0;
-					length++;
-				}
-
-				new_req->length = length;
-				new_req->complete = tx_complete;
-				retval = usb_ep_queue(in, new_req, GFP_ATOMIC);
-				switch (retval) {
-				default:
-					DBG(dev, "tx queue err %d\n", retval);
-					new_req->length = 0;
-					spin_lock(&dev->req_lock);
-					list_add_tail(&new_req->list,
-							&dev->tx_reqs);
-					spin_unlock(&dev->req_lock);
-					break;
-				case 0:
-					spin_lock(&dev->req_lock);
-					dev->no_tx_req_used++;
-					spin_unlock(&dev->req_lock);
-					net->trans_start = jiffies;
-				}
-			} else {
-				spin_lock(&dev->req_lock);
-				/*
-				 * Put the idle request at the back of the
-				 * queue. The xmit function will put the
-				 * unfinished request at the beginning of the
-				 * queue.
-				 */
-				list_add_tail(&new_req->list, &dev->tx_reqs);
-				spin_unlock(&dev->req_lock);
-			}
-		} else {
-			spin_unlock(&dev->req_lock);
-		}
+		spin_unlock(&dev->req_lock);
+		tx_send_held_req(dev);
 	} else {
 		skb = req->context;
 		spin_unlock(&dev->req_lock);
@@ -656,12 +731,14 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	struct usb_ep		*in;
 	u16			cdc_filter;
 	bool			multi_pkt_xfer = false;
+	u32			max_xfer_size = 0;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->port_usb) {
 		in = dev->port_usb->in_ep;
 		cdc_filter = dev->port_usb->cdc_filter;
 		multi_pkt_xfer = dev->port_usb->multi_pkt_xfer;
+		max_xfer_size = dev->port_usb->dl_max_xfer_size;
 	} else {
 		in = NULL;
 		cdc_filter = 0;
@@ -756,19 +833,36 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 
 		spin_lock_irqsave(&dev->req_lock, flags);
 		dev->tx_skb_hold_count++;
-		if (dev->tx_skb_hold_count < dev->dl_max_pkts_per_xfer) {
+		/*
+		 * Hold the request for more packets only while the next
+		 * full sized one still fits in the host's MaxTransferSize
+		 * (an RNDIS host drops the whole transfer otherwise).
+		 */
+		if (dev->tx_skb_hold_count < dev->dl_max_pkts_per_xfer &&
+		    (!max_xfer_size || req->length + dev->header_len +
+		     net->mtu + ETH_HLEN <= max_xfer_size)) {
 			if (dev->no_tx_req_used > TX_REQ_THRESHOLD) {
 				list_add(&req->list, &dev->tx_reqs);
 				spin_unlock_irqrestore(&dev->req_lock, flags);
+				if (tx_aggr_flush_us &&
+				    !hrtimer_active(&dev->tx_timer))
+					hrtimer_start(&dev->tx_timer,
+						ns_to_ktime(tx_aggr_flush_us *
+							    NSEC_PER_USEC),
+						HRTIMER_MODE_REL);
 				goto success;
 			}
 		}
 
 		dev->no_tx_req_used++;
+		dev->tx_xfers++;
+		dev->tx_pkts += dev->tx_skb_hold_count;
 		dev->tx_skb_hold_count = 0;
 		spin_unlock_irqrestore(&dev->req_lock, flags);
 	} else {
 		spin_unlock_irqrestore(&dev->lock, flags);
+		dev->tx_xfers++;
+		dev->tx_pkts++;
 		length = skb->len;
 		req->buf = skb->data;
 		req->context = skb;
@@ -1034,6 +1128,8 @@ int gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 	spin_lock_init(&dev->req_lock);
 	INIT_WORK(&dev->work, eth_work);
 	INIT_WORK(&dev->rx_work, process_rx_w);
+	hrtimer_init(&dev->tx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->tx_timer.function = tx_timer_expired;
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
@@ -1226,6 +1322,7 @@ void gether_disconnect(struct gether *link)
 
 	netif_stop_queue(dev->net);
 	netif_carrier_off(dev->net);
+	hrtimer_cancel(&dev->tx_timer);
 
 	/* disable endpoints, forcing (synchronous) completion
 	 * of all pending i/o.  then free the request objects
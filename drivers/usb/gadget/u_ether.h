@@ -56,6 +56,8 @@ struct gether {
 
 	unsigned			ul_max_pkts_per_xfer;
 	unsigned			dl_max_pkts_per_xfer;
+	/* largest IN transfer the host accepts, 0 if it set no limit */
+	u32				dl_max_xfer_size;
 	bool				multi_pkt_xfer;
 	struct sk_buff			*(*wrap)(struct gether *port,
 						struct sk_buff *skb);
@@ -5002,6 +5002,7 @@ static int __init msm_otg_probe(struct platform_device *pdev)
 	wake_lock(&motg->wlock);
 	pm_runtime_set_active(&pdev->dev);
 	pm_runtime_enable(&pdev->dev);
+	device_enable_async_suspend(&pdev->dev);
 
 	if (motg->pdata->delay_lpm_on_disconnect) {
 		pm_runtime_set_autosuspend_delay(&pdev->dev,
@@ -1050,6 +1050,60 @@ static int msm_dsi_cal_clk_rate(struct mdss_panel_data *pdata,
 	return 0;
 }
 
+/* Size of the frame the MDP streams to a command mode panel */
+static void msm_dsi_cmd_stream_config(struct mipi_panel_info *mipi,
+					int width, int height)
+{
+	unsigned char *ctrl_base = dsi_host_private->dsi_base;
+	u32 data;
+	int bpp, ystride;
+
+	if (mipi->dst_format == DSI_CMD_DST_FORMAT_RGB888)
+		bpp = 3;
+	else if (mipi->dst_format == DSI_CMD_DST_FORMAT_RGB666)
+		bpp = 3;
+	else if (mipi->dst_format == DSI_CMD_DST_FORMAT_RGB565)
+		bpp = 2;
+	else
+		bpp = 3;	/* Default format set to RGB888 */
+
+	ystride = width * bpp + 1;
+
+	data = (ystride << 16) | (mipi->vc << 8) | DTYPE_DCS_LWRITE;
+	MIPI_OUTP(ctrl_base + DSI_COMMAND_MODE_MDP_STREAM0_CTRL, data);
+	MIPI_OUTP(ctrl_base + DSI_COMMAND_MODE_MDP_STREAM1_CTRL, data);
+
+	data = height << 16 | width;
+	MIPI_OUTP(ctrl_base + DSI_COMMAND_MODE_MDP_STREAM1_TOTAL, data);
+	MIPI_OUTP(ctrl_base + DSI_COMMAND_MODE_MDP_STREAM0_TOTAL, data);
+}
+
+/*
+ * Switch the MDP stream to the region in panel_info.roi_* and have the
+ * panel set its column and page address window to match.
+ */
+static int msm_dsi_partial_update(struct mdss_panel_data *pdata)
+{
+	struct mdss_dsi_ctrl_pdata *ctrl_pdata;
+	int rc = 0;
+
+	ctrl_pdata = container_of(pdata, struct mdss_dsi_ctrl_pdata,
+				panel_data);
+
+	if (pdata->panel_info.type != MIPI_CMD_PANEL)
+		return -EINVAL;
+
+	mutex_lock(&ctrl_pdata->mutex);
+	msm_dsi_cmd_stream_config(&pdata->panel_info.mipi,
+		pdata->panel_info.roi_w, pdata->panel_info.roi_h);
+	mutex_unlock(&ctrl_pdata->mutex);
+
+	if (ctrl_pdata->partial_update_fnc)
+		rc = ctrl_pdata->partial_update_fnc(pdata);
+
+	return rc;
+}
+
 static int msm_dsi_on(struct mdss_panel_data *pdata)
 {
 	int ret = 0;
@@ -1057,7 +1111,6 @@ static int msm_dsi_on(struct mdss_panel_data *pdata)
 	struct mdss_panel_info *pinfo;
 	struct mipi_panel_info *mipi;
 	u32 hbp, hfp, vbp, vfp, hspw, vspw, width, height;
-	u32 ystride, bpp, data;
 	u32 dummy_xres, dummy_yres;
 	u32 bitclk_rate = 0, byteclk_rate = 0, pclk_rate = 0, dsiclk_rate = 0;
 	unsigned char *ctrl_base = dsi_host_private->dsi_base;
@@ -1126,28 +1179,7 @@ static int msm_dsi_on(struct mdss_panel_data *pdata)
 				(vspw << 16));
 
 	} else {		/* command mode */
-		if (mipi->dst_format == DSI_CMD_DST_FORMAT_RGB888)
-			bpp = 3;
-		else if (mipi->dst_format == DSI_CMD_DST_FORMAT_RGB666)
-			bpp = 3;
-		else if (mipi->dst_format == DSI_CMD_DST_FORMAT_RGB565)
-			bpp = 2;
-		else
-			bpp = 3;	/* Default format set to RGB888 */
-
-		ystride = width * bpp + 1;
-
-		data = (ystride << 16) | (mipi->vc << 8) | DTYPE_DCS_LWRITE;
-		MIPI_OUTP(ctrl_base + DSI_COMMAND_MODE_MDP_STREAM0_CTRL,
-			data);
-		MIPI_OUTP(ctrl_base + DSI_COMMAND_MODE_MDP_STREAM1_CTRL,
-			data);
-
-		data = height << 16 | width;
-		MIPI_OUTP(ctrl_base + DSI_COMMAND_MODE_MDP_STREAM1_TOTAL,
-			data);
-		MIPI_OUTP(ctrl_base + DSI_COMMAND_MODE_MDP_STREAM0_TOTAL,
-			data);
+		msm_dsi_cmd_stream_config(mipi, width, height);
 	}
 
 	msm_dsi_sw_reset();
@@ -1605,6 +1637,7 @@ static int __devinit msm_dsi_probe(struct platform_device *pdev)
 	intf.cont_on = msm_dsi_cont_on;
 	intf.clk_ctrl = msm_dsi_clk_ctrl;
 	intf.op_mode_config = msm_dsi_op_mode_config;
+	intf.partial_update = msm_dsi_partial_update;
 	intf.index = 0;
 	intf.private = NULL;
 	dsi_register_interface(&intf);
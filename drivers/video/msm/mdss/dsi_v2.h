@@ -32,6 +32,7 @@ struct dsi_interface {
 	int (*cont_on)(struct mdss_panel_data *pdata);
 	int (*clk_ctrl)(struct mdss_panel_data *pdata, int enable);
 	void (*op_mode_config)(int mode, struct mdss_panel_data *pdata);
+	int (*partial_update)(struct mdss_panel_data *pdata);
 	int index;
 	void *private;
 };
@@ -1693,11 +1693,18 @@ int mdp3_parse_dt_splash(struct msm_fb_data_type *mfd)
 	return rc;
 }
 
+/*
+ * Called after every frame the DMA has taken from a buffer of our own. In
+ * video mode the update has waited for the vsync that latched the new
+ * address, in command mode the splash was only read until the DMA was
+ * reset for the kernel, so nothing scans the bootloader buffer any more.
+ */
 void mdp3_release_splash_memory(struct msm_fb_data_type *mfd)
 {
 	/* Give back the reserved memory to the system */
 	if (mdp3_res->splash_mem_addr) {
-		pr_debug("mdp3_release_splash_memory\n");
+		pr_info("releasing %u bytes of splash memory\n",
+			mdp3_res->splash_mem_size);
 		memblock_free(mdp3_res->splash_mem_addr,
 				mdp3_res->splash_mem_size);
 		free_bootmem_late(mdp3_res->splash_mem_addr,
@@ -1936,8 +1943,18 @@ static ssize_t mdp3_show_capabilities(struct device *dev,
 
 static DEVICE_ATTR(caps, S_IRUGO, mdp3_show_capabilities, NULL);
 
+/* last, average and max PPP composition time per frame in us, frames */
+static ssize_t mdp3_show_ppp_frame_time(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	return mdp3_ppp_show_frame_time(buf, PAGE_SIZE);
+}
+
+static DEVICE_ATTR(ppp_frame_time, S_IRUGO, mdp3_show_ppp_frame_time, NULL);
+
 static struct attribute *mdp3_fs_attrs[] = {
 	&dev_attr_caps.attr,
+	&dev_attr_ppp_frame_time.attr,
 	NULL
 };
 
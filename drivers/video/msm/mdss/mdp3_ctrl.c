@@ -20,14 +20,21 @@
 #include <linux/module.h>
 #include <linux/uaccess.h>
 #include <linux/delay.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "mdp3_ctrl.h"
 #include "mdp3.h"
 #include "mdp3_ppp.h"
 #include "dsi_v2.h"
 #include "mdss_dsi.h"
+#include "mdss_debug.h"
+
+#include <trace/events/mdss.h>
 
 #define VSYNC_EXPIRE_TICK	4
+#define CLK_IDLE_MAX_MS		100
 
 static void mdp3_ctrl_pan_display(struct msm_fb_data_type *mfd,
 					struct mdp_overlay *req,
@@ -37,6 +44,7 @@ static int mdp3_overlay_unset(struct msm_fb_data_type *mfd, int ndx);
 static int mdp3_histogram_stop(struct mdp3_session_data *session,
 					u32 block);
 static int mdp3_ctrl_clk_enable(struct msm_fb_data_type *mfd, int enable);
+static int mdp3_ctrl_res_req_bus(struct msm_fb_data_type *mfd, int status);
 static int mdp3_ctrl_vsync_enable(struct msm_fb_data_type *mfd, int enable);
 static int mdp3_ctrl_get_intf_type(struct msm_fb_data_type *mfd);
 
@@ -112,9 +120,31 @@ int mdp3_ctrl_notify(struct mdp3_session_data *ses, int event)
 	return blocking_notifier_call_chain(&ses->notifier_head, event, ses);
 }
 
+/*
+ * Display latency accounting. Three intervals are sampled per session:
+ * from the commit ioctl to the DMA being handed the buffer, from the DMA
+ * done interrupt to the release fence being signaled (command mode only,
+ * video mode signals straight from the kickoff) and how far each vsync
+ * lands from the panel refresh period.
+ */
+static void mdp3_ctrl_latency_add(struct mdp3_session_data *session,
+				struct mdp3_latency *lat, u32 usecs)
+{
+	unsigned long flag;
+	int bucket = min(fls(usecs >> 8), MDP3_LAT_BUCKETS - 1);
+
+	spin_lock_irqsave(&session->lat_lock, flag);
+	lat->count++;
+	lat->total_us += usecs;
+	lat->max_us = max(lat->max_us, usecs);
+	lat->hist[bucket]++;
+	spin_unlock_irqrestore(&session->lat_lock, flag);
+}
+
 static void mdp3_dispatch_dma_done(struct work_struct *work)
 {
 	struct mdp3_session_data *session;
+	u32 usecs;
 
 	pr_debug("%s\n", __func__);
 	session = container_of(work, struct mdp3_session_data,
@@ -123,6 +153,10 @@ static void mdp3_dispatch_dma_done(struct work_struct *work)
 		return;
 
 	mdp3_ctrl_notify(session, MDP_NOTIFY_FRAME_DONE);
+
+	usecs = ktime_us_delta(ktime_get(), session->dma_done_time);
+	mdp3_ctrl_latency_add(session, &session->release_lat, usecs);
+	trace_mdp3_done_to_release(session->mfd->index, usecs);
 }
 
 static void mdp3_dispatch_clk_off(struct work_struct *work)
@@ -151,13 +185,26 @@ static void mdp3_dispatch_clk_off(struct work_struct *work)
 void vsync_notify_handler(void *arg)
 {
 	struct mdp3_session_data *session = (struct mdp3_session_data *)arg;
-	session->vsync_time = ktime_get();
+	ktime_t now = ktime_get();
+	s64 delta = ktime_us_delta(now, session->vsync_time);
+
+	/* Only back to back vsyncs, not the first one after enabling */
+	if (delta > 0 && delta < 2 * session->vsync_period_us) {
+		u32 jitter = abs((s32) (delta - session->vsync_period_us));
+
+		mdp3_ctrl_latency_add(session, &session->vsync_jitter, jitter);
+		trace_mdp3_vsync(session->mfd->index, (u32) delta);
+	}
+
+	session->vsync_time = now;
 	sysfs_notify_dirent(session->vsync_event_sd);
+	mdss_fb_frame_vsync(session->mfd);
 }
 
 void dma_done_notify_handler(void *arg)
 {
 	struct mdp3_session_data *session = (struct mdp3_session_data *)arg;
+	session->dma_done_time = ktime_get();
 	schedule_work(&session->dma_done_work);
 }
 
@@ -170,11 +217,60 @@ void vsync_count_down(void *arg)
 		schedule_work(&session->clk_off_work);
 }
 
+/*
+ * Track the interval between frames. A gap longer than the idle limit
+ * starts a new sequence, there is no cadence worth holding clocks for.
+ */
+static void mdp3_ctrl_update_cadence(struct mdp3_session_data *session)
+{
+	ktime_t now = ktime_get();
+	s64 interval = ktime_us_delta(now, session->last_kickoff);
+
+	session->last_kickoff = now;
+
+	if (interval <= 0 || interval > session->clk_idle_max_ms * 1000) {
+		session->commit_interval_us = 0;
+		return;
+	}
+
+	if (session->commit_interval_us)
+		session->commit_interval_us =
+			(session->commit_interval_us * 3 + (u32) interval) / 4;
+	else
+		session->commit_interval_us = (u32) interval;
+}
+
+/*
+ * Command mode panels turn the clocks and the bus vote off once the
+ * countdown armed here runs out of vsyncs. At a steady frame rate a fixed
+ * VSYNC_EXPIRE_TICK could let them drop between every frame, so keep
+ * them for one and a half commit intervals, up to clk_idle_max_ms. The
+ * countdown never goes below VSYNC_EXPIRE_TICK.
+ */
 void mdp3_ctrl_reset_countdown(struct mdp3_session_data *session,
 		struct msm_fb_data_type *mfd)
 {
-	if (mdp3_ctrl_get_intf_type(mfd) == MDP3_DMA_OUTPUT_SEL_DSI_CMD)
-		atomic_set(&session->vsync_countdown, VSYNC_EXPIRE_TICK);
+	int ticks = VSYNC_EXPIRE_TICK;
+	int max_ticks, elapsed;
+
+	if (mdp3_ctrl_get_intf_type(mfd) != MDP3_DMA_OUTPUT_SEL_DSI_CMD)
+		return;
+
+	if (session->commit_interval_us && session->vsync_period_us) {
+		ticks = DIV_ROUND_UP(session->commit_interval_us * 3 / 2,
+			session->vsync_period_us);
+		max_ticks = session->clk_idle_max_ms * 1000 /
+			session->vsync_period_us;
+		ticks = clamp(ticks, VSYNC_EXPIRE_TICK,
+			max(max_ticks, VSYNC_EXPIRE_TICK));
+	}
+
+	elapsed = session->idle_ticks - atomic_read(&session->vsync_countdown);
+	if (session->clk_on && elapsed >= VSYNC_EXPIRE_TICK)
+		session->clk_cycles_avoided++;
+
+	session->idle_ticks = ticks;
+	atomic_set(&session->vsync_countdown, ticks);
 }
 
 static int mdp3_ctrl_vsync_enable(struct msm_fb_data_type *mfd, int enable)
@@ -304,8 +400,56 @@ static ssize_t mdp3_vsync_show_event(struct device *dev,
 
 static DEVICE_ATTR(vsync_event, S_IRUGO, mdp3_vsync_show_event, NULL);
 
+static ssize_t mdp3_clk_idle_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)fbi->par;
+	struct mdp3_session_data *mdp3_session = mfd->mdp.private1;
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n",
+		mdp3_session->clk_idle_max_ms);
+}
+
+static ssize_t mdp3_clk_idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)fbi->par;
+	struct mdp3_session_data *mdp3_session = mfd->mdp.private1;
+	unsigned int val;
+
+	if (kstrtouint(buf, 0, &val))
+		return -EINVAL;
+
+	mutex_lock(&mdp3_session->lock);
+	mdp3_session->clk_idle_max_ms = val;
+	mutex_unlock(&mdp3_session->lock);
+
+	return count;
+}
+
+static ssize_t mdp3_clk_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)fbi->par;
+	struct mdp3_session_data *mdp3_session = mfd->mdp.private1;
+
+	return scnprintf(buf, PAGE_SIZE,
+		"cycles=%u avoided=%u idle_ticks=%d interval_us=%u\n",
+		mdp3_session->clk_cycles, mdp3_session->clk_cycles_avoided,
+		mdp3_session->idle_ticks, mdp3_session->commit_interval_us);
+}
+
+static DEVICE_ATTR(clk_idle_max_ms, S_IRUGO | S_IWUSR, mdp3_clk_idle_show,
+	mdp3_clk_idle_store);
+static DEVICE_ATTR(clk_stats, S_IRUGO, mdp3_clk_stats_show, NULL);
+
 static struct attribute *vsync_fs_attrs[] = {
 	&dev_attr_vsync_event.attr,
+	&dev_attr_clk_idle_max_ms.attr,
+	&dev_attr_clk_stats.attr,
 	NULL,
 };
 
@@ -327,11 +471,18 @@ static int mdp3_ctrl_clk_enable(struct msm_fb_data_type *mfd, int enable)
 	if (!panel->event_handler)
 		return 0;
 
-	if ((enable && session->clk_on == 0) ||
-				(!enable && session->clk_on == 1)) {
+	if (enable && session->clk_on == 0) {
+		session->clk_cycles++;
+		rc = mdp3_ctrl_res_req_bus(mfd, 1);
+		rc |= panel->event_handler(panel,
+			MDSS_EVENT_PANEL_CLK_CTRL, (void *)enable);
+		rc |= mdp3_clk_enable(enable, 1);
+	} else if (!enable && session->clk_on == 1) {
 		rc = panel->event_handler(panel,
 			MDSS_EVENT_PANEL_CLK_CTRL, (void *)enable);
 		rc |= mdp3_clk_enable(enable, 1);
+		/* Nothing fetches with the clocks off */
+		rc |= mdp3_ctrl_res_req_bus(mfd, 0);
 	} else {
 		pr_debug("enable = %d, clk_on=%d\n", enable, session->clk_on);
 	}
@@ -345,9 +496,15 @@ static int mdp3_ctrl_res_req_bus(struct msm_fb_data_type *mfd, int status)
 	int rc = 0;
 	if (status) {
 		struct mdss_panel_info *panel_info = mfd->panel_info;
+		struct mdp3_session_data *session = mfd->mdp.private1;
 		int ab = 0;
 		int ib = 0;
-		ab = panel_info->xres * panel_info->yres * 4;
+
+		/* Partial updates only fetch the region being updated */
+		if (session->roi.w && session->roi.h)
+			ab = session->roi.w * session->roi.h * 4;
+		else
+			ab = panel_info->xres * panel_info->yres * 4;
 		ab *= panel_info->mipi.frame_rate;
 		ib = (ab * 3) / 2;
 		rc = mdp3_bus_scale_set_quota(MDP3_CLIENT_DMA_P, ab, ib);
@@ -493,6 +650,69 @@ static int mdp3_ctrl_intf_init(struct msm_fb_data_type *mfd,
 	return rc;
 }
 
+static void roi_notify_handler(void *arg)
+{
+	struct mdp3_session_data *session = arg;
+	struct mdss_panel_data *panel = session->panel;
+	int rc;
+
+	panel->panel_info.roi_x = session->roi.x;
+	panel->panel_info.roi_y = session->roi.y;
+	panel->panel_info.roi_w = session->roi.w;
+	panel->panel_info.roi_h = session->roi.h;
+
+	rc = mdp3_ctrl_res_req_bus(session->mfd, 1);
+	if (rc)
+		pr_err("fail to scale bus for roi\n");
+
+	if (panel->event_handler) {
+		rc = panel->event_handler(panel,
+			MDSS_EVENT_ENABLE_PARTIAL_UPDATE, NULL);
+		if (rc)
+			pr_err("fail to set panel roi\n");
+	}
+}
+
+/*
+ * Partial update on command mode panels. DMA_P fetches only the dirty
+ * region of the frame and the panel is told to put it where it belongs,
+ * the rest of its frame memory is left as it was. The new region is
+ * programmed by the dma update once the previous frame is out.
+ *
+ * Returns the offset of the region into the frame buffer.
+ */
+static u32 mdp3_ctrl_update_roi(struct mdp3_session_data *session,
+				struct mdp_display_commit *cmt_data)
+{
+	struct msm_fb_data_type *mfd = session->mfd;
+	struct mdss_panel_info *panel_info = mfd->panel_info;
+	struct mdp3_dma *dma = session->dma;
+	struct mdp_rect roi = {0, 0, panel_info->xres, panel_info->yres};
+
+	if (!panel_info->partial_update_enabled ||
+		mdp3_ctrl_get_intf_type(mfd) != MDP3_DMA_OUTPUT_SEL_DSI_CMD)
+		return 0;
+
+	if (cmt_data && cmt_data->roi.w && cmt_data->roi.h &&
+		cmt_data->roi.x < panel_info->xres &&
+		cmt_data->roi.y < panel_info->yres &&
+		cmt_data->roi.w <= panel_info->xres - cmt_data->roi.x &&
+		cmt_data->roi.h <= panel_info->yres - cmt_data->roi.y)
+		roi = cmt_data->roi;
+
+	if (memcmp(&roi, &session->roi, sizeof(roi))) {
+		pr_debug("roi %d,%d %dx%d\n", roi.x, roi.y, roi.w, roi.h);
+		session->roi = roi;
+		dma->source_config.width = roi.w;
+		dma->source_config.height = roi.h;
+		dma->update_src_cfg = true;
+		dma->update_roi = true;
+	}
+
+	return roi.y * dma->source_config.stride +
+		roi.x * ppp_bpp(session->overlay.src.format);
+}
+
 static int mdp3_ctrl_dma_init(struct msm_fb_data_type *mfd,
 				struct mdp3_dma *dma)
 {
@@ -544,9 +764,17 @@ static int mdp3_ctrl_dma_init(struct msm_fb_data_type *mfd,
 		rc = -EINVAL;
 
 	if (outputConfig.out_sel == MDP3_DMA_OUTPUT_SEL_DSI_CMD) {
+		struct mdp3_session_data *session = mfd->mdp.private1;
+
 		dma_done_callback.handler = dma_done_notify_handler;
 		dma_done_callback.arg = mfd->mdp.private1;
 		dma->dma_done_notifier(dma, &dma_done_callback);
+
+		/* The panel is back to full frame, program it on next commit */
+		memset(&session->roi, 0, sizeof(session->roi));
+		dma->update_roi = false;
+		dma->roi_notifier.handler = roi_notify_handler;
+		dma->roi_notifier.arg = session;
 	}
 
 	return rc;
@@ -970,12 +1198,35 @@ static int mdp3_overlay_play(struct msm_fb_data_type *mfd,
 	return rc;
 }
 
+/*
+ * Called with the buffer handed to the DMA. pan_display_ex waits for the
+ * previous commit to be idle before it queues a new one, so commit_time
+ * always belongs to the frame being kicked off.
+ */
+static void mdp3_ctrl_kickoff_latency(struct mdp3_session_data *session)
+{
+	struct msm_fb_data_type *mfd = session->mfd;
+	s64 usecs;
+
+	if (!ktime_to_ns(mfd->commit_time))
+		return;
+
+	usecs = ktime_us_delta(session->dma->start_time, mfd->commit_time);
+	mfd->commit_time = ktime_set(0, 0);
+	if (usecs < 0)
+		return;
+
+	mdp3_ctrl_latency_add(session, &session->kickoff_lat, (u32) usecs);
+	trace_mdp3_commit_to_kickoff(mfd->index, (u32) usecs);
+}
+
 static int mdp3_ctrl_display_commit_kickoff(struct msm_fb_data_type *mfd,
 					struct mdp_display_commit *cmt_data)
 {
 	struct mdp3_session_data *mdp3_session;
 	struct mdp3_img_data *data;
 	struct mdss_panel_info *panel_info;
+	u32 offset;
 	int rc = 0;
 
 	if (!mfd || !mfd->mdp.private1)
@@ -1007,21 +1258,25 @@ static int mdp3_ctrl_display_commit_kickoff(struct msm_fb_data_type *mfd,
 	mdp3_ctrl_notify(mdp3_session, MDP_NOTIFY_FRAME_BEGIN);
 	data = mdp3_bufq_pop(&mdp3_session->bufq_in);
 	if (data) {
+		mdp3_ctrl_update_cadence(mdp3_session);
 		mdp3_ctrl_reset_countdown(mdp3_session, mfd);
 		mdp3_ctrl_clk_enable(mfd, 1);
+		offset = mdp3_ctrl_update_roi(mdp3_session, cmt_data);
 		rc = mdp3_session->dma->update(mdp3_session->dma,
-			(void *)data->addr,
+			(void *)(data->addr + offset),
 			mdp3_session->intf);
 		/* This is for the previous frame */
 		if (rc < 0) {
 			mdp3_ctrl_notify(mdp3_session,
 				MDP_NOTIFY_FRAME_TIMEOUT);
 		} else {
+			mdp3_ctrl_kickoff_latency(mdp3_session);
 			if (mdp3_ctrl_get_intf_type(mfd) ==
 						MDP3_DMA_OUTPUT_SEL_DSI_VIDEO) {
 				mdp3_ctrl_notify(mdp3_session,
 					MDP_NOTIFY_FRAME_DONE);
 			}
+			mdp3_release_splash_memory(mfd);
 		}
 
 		mdp3_ctrl_notify(mdp3_session, MDP_NOTIFY_FRAME_FLUSHED);
@@ -1029,7 +1284,6 @@ static int mdp3_ctrl_display_commit_kickoff(struct msm_fb_data_type *mfd,
 	}
 
 	if (mdp3_bufq_count(&mdp3_session->bufq_out) > 1) {
-		mdp3_release_splash_memory(mfd);
 		data = mdp3_bufq_pop(&mdp3_session->bufq_out);
 		if (data)
 			mdp3_put_img(data, MDP3_CLIENT_DMA_P);
@@ -1096,6 +1350,7 @@ static void mdp3_ctrl_pan_display(struct msm_fb_data_type *mfd,
 	}
 
 	if (mfd->fbi->screen_base) {
+		mdp3_ctrl_update_cadence(mdp3_session);
 		mdp3_ctrl_reset_countdown(mdp3_session, mfd);
 		mdp3_ctrl_notify(mdp3_session, MDP_NOTIFY_FRAME_BEGIN);
 		mdp3_ctrl_clk_enable(mfd, 1);
@@ -1112,6 +1367,7 @@ static void mdp3_ctrl_pan_display(struct msm_fb_data_type *mfd,
 				mdp3_ctrl_notify(mdp3_session,
 					MDP_NOTIFY_FRAME_DONE);
 			}
+			mdp3_release_splash_memory(mfd);
 		}
 		mdp3_ctrl_notify(mdp3_session, MDP_NOTIFY_FRAME_FLUSHED);
 	} else {
@@ -1900,6 +2156,71 @@ static int mdp3_ctrl_ioctl_handler(struct msm_fb_data_type *mfd,
 	return rc;
 }
 
+static void mdp3_latency_print(struct seq_file *s, const char *name,
+				struct mdp3_latency *lat)
+{
+	int i;
+
+	seq_printf(s, "%s: count=%u avg_us=%llu max_us=%u\n", name,
+		lat->count,
+		lat->count ? div_u64(lat->total_us, lat->count) : 0,
+		lat->max_us);
+	for (i = 0; i < MDP3_LAT_BUCKETS; i++)
+		seq_printf(s, "  %s%u %u\n",
+			i == MDP3_LAT_BUCKETS - 1 ? ">=" : "<",
+			i == MDP3_LAT_BUCKETS - 1 ? 1 << (i + 7) : 1 << (i + 8),
+			lat->hist[i]);
+}
+
+static int mdp3_latency_show(struct seq_file *s, void *unused)
+{
+	struct mdp3_session_data *session = s->private;
+	struct mdp3_latency kickoff, release, vsync;
+	unsigned long flag;
+
+	spin_lock_irqsave(&session->lat_lock, flag);
+	kickoff = session->kickoff_lat;
+	release = session->release_lat;
+	vsync = session->vsync_jitter;
+	spin_unlock_irqrestore(&session->lat_lock, flag);
+
+	mdp3_latency_print(s, "commit_to_kickoff", &kickoff);
+	mdp3_latency_print(s, "done_to_release", &release);
+	mdp3_latency_print(s, "vsync_jitter", &vsync);
+
+	return 0;
+}
+
+static int mdp3_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mdp3_latency_show, inode->i_private);
+}
+
+static ssize_t mdp3_latency_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct mdp3_session_data *session = s->private;
+	unsigned long flag;
+
+	/* Any write clears the histograms */
+	spin_lock_irqsave(&session->lat_lock, flag);
+	memset(&session->kickoff_lat, 0, sizeof(session->kickoff_lat));
+	memset(&session->release_lat, 0, sizeof(session->release_lat));
+	memset(&session->vsync_jitter, 0, sizeof(session->vsync_jitter));
+	spin_unlock_irqrestore(&session->lat_lock, flag);
+
+	return count;
+}
+
+static const struct file_operations mdp3_latency_fops = {
+	.open = mdp3_latency_open,
+	.read = seq_read,
+	.write = mdp3_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 int mdp3_ctrl_init(struct msm_fb_data_type *mfd)
 {
 	struct device *dev = mfd->fbi->dev;
@@ -1908,6 +2229,7 @@ int mdp3_ctrl_init(struct msm_fb_data_type *mfd)
 	u32 intf_type = MDP3_DMA_OUTPUT_SEL_DSI_VIDEO;
 	int rc;
 	int splash_mismatch = 0;
+	char name[16];
 
 	pr_debug("mdp3_ctrl_init\n");
 	rc = mdp3_parse_dt_splash(mfd);
@@ -1974,6 +2296,10 @@ int mdp3_ctrl_init(struct msm_fb_data_type *mfd)
 	mdp3_session->vsync_timer.function = mdp3_vsync_timer_func;
 	mdp3_session->vsync_timer.data = (u32)mdp3_session;
 	mdp3_session->vsync_period = 1000 / mfd->panel_info->mipi.frame_rate;
+	mdp3_session->vsync_period_us =
+		USEC_PER_SEC / mfd->panel_info->mipi.frame_rate;
+	spin_lock_init(&mdp3_session->lat_lock);
+	mdp3_session->clk_idle_max_ms = CLK_IDLE_MAX_MS;
 	mfd->mdp.private1 = mdp3_session;
 
 #ifdef CONFIG_FB_MSM_MDSS_MDP3_KCAL_CTRL
@@ -2010,6 +2336,10 @@ int mdp3_ctrl_init(struct msm_fb_data_type *mfd)
 	kobject_uevent(&dev->kobj, KOBJ_ADD);
 	pr_debug("vsync kobject_uevent(KOBJ_ADD)\n");
 
+	snprintf(name, sizeof(name), "fb%d_latency", mfd->index);
+	if (mdss_debug_create_file(name, mdp3_session, &mdp3_latency_fops))
+		pr_debug("no debugfs node for display latency\n");
+
 	if (mdp3_get_cont_spash_en()) {
 		mdp3_session->clk_on = 1;
 		mdp3_ctrl_notifier_register(mdp3_session,
@@ -57,6 +57,16 @@ struct kcal_lut_data {
 };
 #endif
 
+/* Latency histogram buckets: < 256us, < 512us, < 1ms ... >= 64ms */
+#define MDP3_LAT_BUCKETS	10
+
+struct mdp3_latency {
+	u32 count;
+	u32 max_us;
+	u64 total_us;
+	u32 hist[MDP3_LAT_BUCKETS];
+};
+
 struct mdp3_session_data {
 	struct mutex lock;
 	struct mutex offlock;
@@ -87,6 +97,25 @@ struct mdp3_session_data {
 	int vsync_enabled;
 	atomic_t vsync_countdown; /* Used to count down  */
 
+	/* Region of the panel DMA_P updates, all zero until first commit */
+	struct mdp_rect roi;
+
+	/* Display latency, see mdp3_ctrl_latency_add() */
+	spinlock_t lat_lock;
+	struct mdp3_latency kickoff_lat;
+	struct mdp3_latency release_lat;
+	struct mdp3_latency vsync_jitter;
+	ktime_t dma_done_time;
+	u32 vsync_period_us;
+
+	/* Command mode clock idle timeout, see mdp3_ctrl_reset_countdown() */
+	ktime_t last_kickoff;
+	u32 commit_interval_us;	/* running average of the commit cadence */
+	u32 clk_idle_max_ms;
+	int idle_ticks;		/* countdown armed by the last reset */
+	u32 clk_cycles;		/* clock and bus off/on cycles */
+	u32 clk_cycles_avoided;	/* kept on past the fixed VSYNC_EXPIRE_TICK */
+
 #ifdef CONFIG_FB_MSM_MDSS_MDP3_KCAL_CTRL
 	struct kcal_lut_data lut_data;
 #endif
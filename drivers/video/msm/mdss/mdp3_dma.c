@@ -744,6 +744,12 @@ static int mdp3_dmap_update(struct mdp3_dma *dma, void *buf,
 			}
 		}
 	}
+	/* The previous frame is out, the panel can take a new window */
+	if (dma->update_roi) {
+		if (dma->roi_notifier.handler)
+			dma->roi_notifier.handler(dma->roi_notifier.arg);
+		dma->update_roi = false;
+	}
 	if (dma->update_src_cfg) {
 		if (dma->output_config.out_sel ==
 				 MDP3_DMA_OUTPUT_SEL_DSI_VIDEO && intf->active)
@@ -758,6 +764,7 @@ static int mdp3_dmap_update(struct mdp3_dma *dma, void *buf,
 		mdp3_ccs_update(dma);
 		MDP3_REG_WRITE(MDP3_REG_DMA_P_START, 1);
 	}
+	dma->start_time = ktime_get();
 
 	if (!intf->active) {
 		pr_debug("mdp3_dmap_update start interface\n");
@@ -16,6 +16,7 @@
 
 #include <linux/notifier.h>
 #include <linux/sched.h>
+#include <linux/ktime.h>
 
 #define MDP_HISTOGRAM_BL_SCALE_MAX 1024
 #define MDP_HISTOGRAM_BL_LEVEL_MAX 255
@@ -261,6 +262,9 @@ struct mdp3_dma {
 	struct mdp3_dma_histogram_data histo_data;
 	unsigned int vsync_status;
 	bool update_src_cfg;
+	bool update_roi;
+	struct mdp3_notification roi_notifier;
+	ktime_t start_time;	/* last buffer handed to the hardware */
 
 	int (*dma_config)(struct mdp3_dma *dma,
 			struct mdp3_dma_source *source_config,
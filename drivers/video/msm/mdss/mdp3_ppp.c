@@ -14,6 +14,7 @@
 #include <linux/file.h>
 #include <linux/io.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/major.h>
 #include <linux/slab.h>
 #include <linux/types.h>
@@ -99,6 +100,13 @@ struct ppp_status {
 	struct timer_list free_bw_timer;
 	struct work_struct free_bw_work;
 	bool bw_on;
+	u64 bw_ab;
+
+	/* Time taken to compose each request list */
+	u32 frame_last_us;
+	u32 frame_max_us;
+	u32 frame_avg_us;
+	u32 frames;
 };
 
 static struct ppp_status *ppp_stat;
@@ -326,38 +334,99 @@ static int mdp3_ppp_callback_setup(void)
 	return rc;
 }
 
+/*
+ * The PPP_DONE interrupt is enabled by the blit worker for the whole run of
+ * requests, not per blit.
+ */
 void mdp3_ppp_kickoff(void)
 {
 	init_completion(&ppp_stat->ppp_comp);
-	mdp3_irq_enable(MDP3_PPP_DONE);
 	ppp_enable();
 	mdp3_ppp_pipe_wait();
-	mdp3_irq_disable(MDP3_PPP_DONE);
 }
 
-int mdp3_ppp_turnon(struct msm_fb_data_type *mfd, int on_off)
+/*
+ * Bandwidth needed to compose a request list once per panel frame: every
+ * source is read once and the destination is read and written for
+ * blending. Never more than the worst case for a full screen of the
+ * largest format.
+ */
+static u64 mdp3_ppp_req_bw(struct msm_fb_data_type *mfd,
+		struct blit_req_list *req)
 {
 	struct mdss_panel_info *panel_info = mfd->panel_info;
-	uint64_t ab = 0, ib = 0;
+	u64 bytes = 0, max_ab;
+	int i, bpp;
+
+	for (i = 0; i < req->count; i++) {
+		struct mdp_blit_req *r = &req->req_list[i];
+
+		if (r->flags & MDP_NO_BLIT)
+			continue;
+
+		bpp = ppp_get_bpp(r->dst.format, mfd->fb_imgType);
+		if (bpp > 0)
+			bytes += (u64) r->dst_rect.w * r->dst_rect.h * bpp * 2;
+
+		if (r->flags & MDP_SOLID_FILL)
+			continue;
+
+		bpp = ppp_get_bpp(r->src.format, mfd->fb_imgType);
+		if (bpp > 0)
+			bytes += (u64) r->src_rect.w * r->src_rect.h * bpp;
+	}
+
+	max_ab = (u64) panel_info->xres * panel_info->yres *
+		panel_info->mipi.frame_rate *
+		MDP_PPP_MAX_BPP *
+		MDP_PPP_DYNAMIC_FACTOR *
+		MDP_PPP_MAX_READ_WRITE;
+
+	return min(bytes * panel_info->mipi.frame_rate * MDP_PPP_DYNAMIC_FACTOR,
+		max_ab);
+}
+
+/*
+ * Only ever raise the vote while the resources are on, it drops back when
+ * the release timer turns them off. Updating the bus request is far more
+ * expensive than over voting for the few ms until then.
+ */
+static int mdp3_ppp_vote_bw(u64 ab)
+{
+	int rc;
+
+	if (ab <= ppp_stat->bw_ab)
+		return 0;
+
+	rc = mdp3_bus_scale_set_quota(MDP3_CLIENT_PPP, ab, (ab * 3) / 2);
+	if (rc < 0) {
+		pr_err("%s: scale_set_quota failed\n", __func__);
+		return rc;
+	}
+	ppp_stat->bw_ab = ab;
+	return 0;
+}
+
+int mdp3_ppp_turnon(struct msm_fb_data_type *mfd, int on_off, u64 ab)
+{
 	int rate = 0;
 	int rc;
 
-	if (on_off) {
+	if (on_off)
 		rate = MDP_BLIT_CLK_RATE;
-		ab = panel_info->xres * panel_info->yres *
-			panel_info->mipi.frame_rate *
-			MDP_PPP_MAX_BPP *
-			MDP_PPP_DYNAMIC_FACTOR *
-			MDP_PPP_MAX_READ_WRITE;
-		ib = (ab * 3) / 2;
-	}
 	mdp3_clk_set_rate(MDP3_CLK_CORE, rate, MDP3_CLIENT_PPP);
 	rc = mdp3_clk_enable(on_off, 0);
 	if (rc < 0) {
 		pr_err("%s: mdp3_clk_enable failed\n", __func__);
 		return rc;
 	}
-	rc = mdp3_bus_scale_set_quota(MDP3_CLIENT_PPP, ab, ib);
+	if (on_off) {
+		ppp_stat->bw_ab = 0;
+		rc = mdp3_ppp_vote_bw(ab);
+	} else {
+		rc = mdp3_bus_scale_set_quota(MDP3_CLIENT_PPP, 0, 0);
+		ppp_stat->bw_ab = 0;
+	}
 	if (rc < 0) {
 		mdp3_clk_enable(!on_off, 0);
 		pr_err("%s: scale_set_quota failed\n", __func__);
@@ -1002,7 +1071,7 @@ static void mdp3_free_bw_wq_handler(struct work_struct *work)
 
 	mutex_lock(&ppp_stat->config_ppp_mutex);
 	if (ppp_stat->bw_on) {
-		mdp3_ppp_turnon(mfd, 0);
+		mdp3_ppp_turnon(mfd, 0, 0);
 		rc = mdp3_iommu_disable(MDP3_CLIENT_PPP);
 		if (rc < 0)
 			WARN(1, "Unable to disable ppp iommu\n");
@@ -1010,10 +1079,39 @@ static void mdp3_free_bw_wq_handler(struct work_struct *work)
 	mutex_unlock(&ppp_stat->config_ppp_mutex);
 }
 
+static void mdp3_ppp_frame_time(ktime_t start)
+{
+	u32 usecs = (u32) ktime_to_us(ktime_sub(ktime_get(), start));
+
+	ppp_stat->frame_last_us = usecs;
+	ppp_stat->frame_max_us = max(ppp_stat->frame_max_us, usecs);
+	/* Running average over the last 8 or so frames */
+	if (ppp_stat->frames++)
+		ppp_stat->frame_avg_us = (ppp_stat->frame_avg_us * 7 +
+			usecs) / 8;
+	else
+		ppp_stat->frame_avg_us = usecs;
+}
+
+ssize_t mdp3_ppp_show_frame_time(char *buf, size_t len)
+{
+	if (!ppp_stat)
+		return scnprintf(buf, len, "0 0 0 0\n");
+
+	return scnprintf(buf, len, "%u %u %u %u\n", ppp_stat->frame_last_us,
+		ppp_stat->frame_avg_us, ppp_stat->frame_max_us,
+		ppp_stat->frames);
+}
+
+/*
+ * Runs everything in the queue back to back with the clocks, bus vote and
+ * done interrupt set up once for the whole run.
+ */
 static void mdp3_ppp_blit_wq_handler(struct work_struct *work)
 {
 	struct msm_fb_data_type *mfd = ppp_stat->mfd;
 	struct blit_req_list *req;
+	ktime_t start;
 	int i, rc = 0;
 
 	mutex_lock(&ppp_stat->config_ppp_mutex);
@@ -1030,7 +1128,7 @@ static void mdp3_ppp_blit_wq_handler(struct work_struct *work)
 			pr_err("%s: mdp3_iommu_enable failed\n", __func__);
 			return;
 		}
-		mdp3_ppp_turnon(mfd, 1);
+		rc = mdp3_ppp_turnon(mfd, 1, mdp3_ppp_req_bw(mfd, req));
 		if (rc < 0) {
 			mdp3_iommu_disable(MDP3_CLIENT_PPP);
 			mutex_unlock(&ppp_stat->config_ppp_mutex);
@@ -1038,8 +1136,11 @@ static void mdp3_ppp_blit_wq_handler(struct work_struct *work)
 			return;
 		}
 	}
+	mdp3_irq_enable(MDP3_PPP_DONE);
 	while (req) {
 		mdp3_ppp_wait_for_fence(req);
+		mdp3_ppp_vote_bw(mdp3_ppp_req_bw(mfd, req));
+		start = ktime_get();
 		for (i = 0; i < req->count; i++) {
 			if (!(req->req_list[i].flags & MDP_NO_BLIT)) {
 				/* Do the actual blit. */
@@ -1055,6 +1156,7 @@ static void mdp3_ppp_blit_wq_handler(struct work_struct *work)
 					MDP3_CLIENT_PPP);
 			}
 		}
+		mdp3_ppp_frame_time(start);
 		/* Signal to release fence */
 		mutex_lock(&ppp_stat->req_mutex);
 		mdp3_ppp_signal_timeline(req);
@@ -1064,6 +1166,7 @@ static void mdp3_ppp_blit_wq_handler(struct work_struct *work)
 			complete(&ppp_stat->pop_q_comp);
 		mutex_unlock(&ppp_stat->req_mutex);
 	}
+	mdp3_irq_disable(MDP3_PPP_DONE);
 	mod_timer(&ppp_stat->free_bw_timer, jiffies +
 		msecs_to_jiffies(MDP_RELEASE_BW_TIMEOUT));
 	mutex_unlock(&ppp_stat->config_ppp_mutex);
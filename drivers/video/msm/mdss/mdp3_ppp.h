@@ -412,5 +412,6 @@ void ppp_enable(void);
 int mdp3_ppp_parse_req(void __user *p,
 	struct mdp_async_blit_req_list *req_list_header,
 	int async);
+ssize_t mdp3_ppp_show_frame_time(char *buf, size_t len);
 
 #endif
@@ -297,6 +297,27 @@ off_fail:
 	return -ENODEV;
 }
 
+int mdss_debug_create_file(const char *name, void *data,
+			   const struct file_operations *fops)
+{
+	struct mdss_data_type *mdata = mdss_res;
+	struct mdss_debug_data *mdd;
+	struct dentry *ent;
+
+	if (!mdata || !mdata->debug_inf.debug_data)
+		return -ENODEV;
+
+	mdd = mdata->debug_inf.debug_data;
+
+	ent = debugfs_create_file(name, 0644, mdd->root, data, fops);
+	if (IS_ERR_OR_NULL(ent)) {
+		pr_err("debugfs_create_file: %s fail\n", name);
+		return -ENODEV;
+	}
+
+	return 0;
+}
+
 
 static int mdss_debug_stat_open(struct inode *inode, struct file *file)
 {
@@ -44,6 +44,7 @@
 #include <linux/file.h>
 #include <linux/memory_alloc.h>
 #include <linux/kthread.h>
+#include <linux/cpufreq.h>
 
 #include <mach/board.h>
 #include <mach/memory.h>
@@ -53,6 +54,9 @@
 
 #include "mdss_fb.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/mdss.h>
+
 #ifdef CONFIG_FB_MSM_TRIPLE_BUFFER
 #define MDSS_FB_NUM 3
 #else
@@ -626,6 +630,7 @@ static int mdss_fb_probe(struct platform_device *pdev)
 	if (rc < 0)
 		pr_err("pm_runtime: fail to set active.\n");
 	pm_runtime_enable(mfd->fbi->dev);
+	device_enable_async_suspend(&pdev->dev);
 
 	/* android supports only one lcd-backlight/lcd for now */
 	if (!lcd_backlight_registered) {
@@ -1867,6 +1872,9 @@ void mdss_fb_signal_timeline(struct msm_sync_pt_data *sync_pt_data)
 			sync_pt_data->timeline) {
 		sw_sync_timeline_inc(sync_pt_data->timeline, 1);
 		sync_pt_data->timeline_value++;
+		trace_mdss_fb_release_fence(sync_pt_data->fence_name,
+			sync_pt_data->timeline_value,
+			atomic_read(&sync_pt_data->commit_cnt));
 
 		pr_debug("%s: buffer signaled! timeline val=%d remaining=%d\n",
 			sync_pt_data->fence_name, sync_pt_data->timeline_value,
@@ -1979,6 +1987,66 @@ static int mdss_fb_pan_idle(struct msm_fb_data_type *mfd)
 	return 0;
 }
 
+static u32 mdss_fb_frame_period_us(struct msm_fb_data_type *mfd)
+{
+	u32 fps = mdss_panel_get_framerate(mfd->panel_info);
+
+	return fps ? USEC_PER_SEC / fps : 0;
+}
+
+/*
+ * Classify a commit against the panel refresh period and let the cpufreq
+ * governor know when userspace has started producing frames back to back
+ * or has just missed one, so that it can raise the frequency before the
+ * next frame instead of after its load sampling window.
+ */
+static void mdss_fb_frame_boost(struct msm_fb_data_type *mfd)
+{
+	ktime_t now = ktime_get();
+	u32 period = mdss_fb_frame_period_us(mfd);
+	s64 delta;
+
+	if (!period || mfd->panel_info->type == WRITEBACK_PANEL)
+		return;
+
+	delta = ktime_us_delta(now, mfd->last_commit_time);
+	mfd->last_commit_time = now;
+
+	if (delta > 4 * period) {
+		/* display was idle, this frame starts a new sequence */
+		mfd->frame_burst = 0;
+		return;
+	}
+
+	if (delta > period + period / 2) {
+		mfd->frame_burst = 0;
+		cpufreq_notify_frame(CPUFREQ_FRAME_LATE, period);
+	} else if (++mfd->frame_burst == 2) {
+		cpufreq_notify_frame(CPUFREQ_FRAME_BURST, period);
+	} else {
+		cpufreq_notify_frame(CPUFREQ_FRAME_ON_TIME, period);
+	}
+}
+
+/**
+ * mdss_fb_frame_vsync() - report a vsync to the frame boost logic
+ * @mfd:	Framebuffer data structure for display
+ *
+ * Called by the mdp driver from its vsync handler. A commit that is still
+ * pending when vsync arrives has missed that refresh.
+ */
+void mdss_fb_frame_vsync(struct msm_fb_data_type *mfd)
+{
+	u32 period;
+
+	if (!atomic_read(&mfd->commits_pending))
+		return;
+
+	period = mdss_fb_frame_period_us(mfd);
+	if (period)
+		cpufreq_notify_frame(CPUFREQ_FRAME_LATE, period);
+}
+EXPORT_SYMBOL(mdss_fb_frame_vsync);
 
 int mdss_fb_pan_display_ex(struct fb_info *info,
 		struct mdp_display_commit *disp_commit)
@@ -2016,8 +2084,11 @@ int mdss_fb_pan_display_ex(struct fb_info *info,
 	mfd->msm_fb_backup.info = *info;
 	mfd->msm_fb_backup.disp_commit = *disp_commit;
 
+	mdss_fb_frame_boost(mfd);
+	mfd->commit_time = ktime_get();
 	atomic_inc(&mfd->mdp_sync_pt_data.commit_cnt);
 	atomic_inc(&mfd->commits_pending);
+	trace_mdss_fb_commit(mfd->index, atomic_read(&mfd->commits_pending));
 	wake_up_all(&mfd->commit_wait_q);
 	mutex_unlock(&mfd->mdp_sync_pt_data.sync_mutex);
 	if (wait_for_finish)
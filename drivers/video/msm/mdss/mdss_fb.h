@@ -216,6 +216,9 @@ struct msm_fb_data_type {
 	/* for non-blocking */
 	struct task_struct *disp_thread;
 	atomic_t commits_pending;
+	ktime_t last_commit_time;
+	ktime_t commit_time;	/* queued by the last commit ioctl */
+	u32 frame_burst;
 	wait_queue_head_t commit_wait_q;
 	wait_queue_head_t idle_wait_q;
 	bool shutdown_pending;
@@ -279,5 +282,6 @@ int mdss_fb_dcm(struct msm_fb_data_type *mfd, int req_state);
 int mdss_fb_pan_display_ex(struct fb_info *info,
 			   struct mdp_display_commit *disp_commit);
 int mdss_fb_blank_sub(int blank_mode, struct fb_info *info, int op_enable);
+void mdss_fb_frame_vsync(struct msm_fb_data_type *mfd);
 
 #endif /* MDSS_FB_H */
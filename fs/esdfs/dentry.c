@@ -13,6 +13,61 @@
 #include <linux/ctype.h>
 #include "esdfs.h"
 
+/*
+ * The checks of esdfs_d_revalidate() that can be made in RCU-walk mode:
+ * no references are taken and nothing sleeps. The dentry data and the
+ * lower dentries stay allocated until the walk leaves its RCU read side
+ * section. Stale derived permissions, and anything that would have to
+ * be invalidated, are left for ref-walk to deal with.
+ */
+static int esdfs_d_revalidate_rcu(struct dentry *dentry)
+{
+	struct dentry *parent = ACCESS_ONCE(dentry->d_parent);
+	struct esdfs_dentry_info *info = ACCESS_ONCE(dentry->d_fsdata);
+	struct esdfs_dentry_info *parent_info;
+	struct inode *inode = ACCESS_ONCE(dentry->d_inode);
+	struct dentry *lower_dentry, *lower_parent, *real_parent;
+	int valid;
+
+	if (parent == dentry)
+		return 1;
+	parent_info = ACCESS_ONCE(parent->d_fsdata);
+	if (!info || !parent_info)
+		return -ECHILD;
+
+	if (ESDFS_DERIVE_PERMS(ESDFS_SB(dentry->d_sb)) && inode) {
+		if (ESDFS_INODE_IS_STALE(ESDFS_I(inode)) ||
+		    !ACCESS_ONCE(parent->d_inode) ||
+		    esdfs_derived_revalidate(dentry, parent))
+			return -ECHILD;
+	}
+
+	spin_lock(&info->lock);
+	lower_dentry = info->lower_path.dentry;
+	real_parent = info->real_parent;
+	spin_unlock(&info->lock);
+	spin_lock(&parent_info->lock);
+	lower_parent = parent_info->lower_path.dentry;
+	spin_unlock(&parent_info->lock);
+	if (!lower_dentry || !lower_parent)
+		return -ECHILD;
+
+	spin_lock(&lower_dentry->d_lock);
+	spin_lock(&dentry->d_lock);
+
+	if (!real_parent)
+		real_parent = lower_dentry->d_parent;
+	valid = !d_unhashed(lower_dentry) && real_parent == lower_parent &&
+		lower_dentry->d_name.len == dentry->d_name.len &&
+		!strncasecmp(lower_dentry->d_name.name, dentry->d_name.name,
+			     dentry->d_name.len);
+
+	spin_unlock(&dentry->d_lock);
+	spin_unlock(&lower_dentry->d_lock);
+
+	return valid ? 1 : -ECHILD;
+}
+
 /*
  * returns: -ERRNO if error (returned to user)
  *          0: tell VFS to invalidate dentry
@@ -27,8 +82,11 @@ static int esdfs_d_revalidate(struct dentry *dentry, struct nameidata *nd)
 	struct dentry *lower_parent_dentry = NULL;
 	int err = 1;
 
-	if (nd && (nd->flags & LOOKUP_RCU))
-		return -ECHILD;
+	if (nd && (nd->flags & LOOKUP_RCU)) {
+		err = esdfs_d_revalidate_rcu(dentry);
+		esdfs_count_rcu_walk(dentry->d_sb, err);
+		return err;
+	}
 
 	/* short-circuit if it's root */
 	spin_lock(&dentry->d_lock);
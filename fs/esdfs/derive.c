@@ -537,6 +537,10 @@ int esdfs_check_derived_permission(struct inode *inode, int mask)
 	    cred->uid == 0 || cred->uid == inode->i_uid)
 		return 0;
 
+	/* the package list lookup below sleeps */
+	if (mask & MAY_NOT_BLOCK)
+		return -ECHILD;
+
 	/*
 	 * Since Android now allows sdcard_r access to the tree and it does not
 	 * know how to use extended attributes, we have to double-check write
@@ -28,6 +28,7 @@
 #include <linux/slab.h>
 #include <linux/sched.h>
 #include <linux/fs_struct.h>
+#include <linux/percpu_counter.h>
 
 /* the file system name */
 #define ESDFS_NAME "esdfs"
@@ -152,6 +153,7 @@ struct esdfs_dentry_info {
 	struct path lower_path;
 	struct path lower_stub_path;
 	struct dentry *real_parent;
+	struct rcu_head rcu;	/* RCU-walk may still look at a freed dentry */
 };
 
 /* esdfs super-block data in memory */
@@ -162,6 +164,9 @@ struct esdfs_sb_info {
 	struct esdfs_perms upper_perms;	/* root in derived mode */
 	struct dentry *obb_parent;	/* pinned dentry for obb link parent */
 	unsigned int options;
+	/* revalidations done in RCU-walk mode, and those sent to ref-walk */
+	struct percpu_counter rcu_walks;
+	struct percpu_counter rcu_walk_fallbacks;
 };
 
 extern struct esdfs_perms esdfs_perms_table[ESDFS_PERMS_TABLE_SIZE];
@@ -199,6 +204,16 @@ static inline struct esdfs_inode_info *ESDFS_I(const struct inode *inode)
 /* file to private Data */
 #define ESDFS_F(file) ((struct esdfs_file_info *)((file)->private_data))
 
+static inline void esdfs_count_rcu_walk(struct super_block *sb, int err)
+{
+	struct esdfs_sb_info *sbi = ESDFS_SB(sb);
+
+	if (err == -ECHILD)
+		percpu_counter_inc(&sbi->rcu_walk_fallbacks);
+	else
+		percpu_counter_inc(&sbi->rcu_walks);
+}
+
 /* file to lower file */
 static inline struct file *esdfs_lower_file(const struct file *f)
 {
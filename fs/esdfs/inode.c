@@ -306,6 +306,9 @@ static int esdfs_permission(struct inode *inode, int mask)
 
 	/* Basic checking of the lower inode (can't override creds here) */
 	lower_inode = esdfs_lower_inode(inode);
+	/* RCU-walk can meet an inode that is already being evicted */
+	if (!lower_inode)
+		return -ECHILD;
 	if (lower_inode->i_uid != sbi->lower_perms.uid ||
 	    lower_inode->i_gid != sbi->lower_perms.gid ||
 	    S_ISSOCK(lower_inode->i_mode) ||
@@ -27,16 +27,29 @@ int esdfs_init_dentry_cache(void)
 
 void esdfs_destroy_dentry_cache(void)
 {
+	/* wait for the dentry data still queued by free_dentry_private_data */
+	rcu_barrier();
 	if (esdfs_dentry_cachep)
 		kmem_cache_destroy(esdfs_dentry_cachep);
 }
 
+static void esdfs_free_dentry_info(struct rcu_head *head)
+{
+	struct esdfs_dentry_info *info =
+		container_of(head, struct esdfs_dentry_info, rcu);
+
+	kmem_cache_free(esdfs_dentry_cachep, info);
+}
+
 void free_dentry_private_data(struct dentry *dentry)
 {
+	struct esdfs_dentry_info *info;
+
 	if (!dentry || !dentry->d_fsdata)
 		return;
-	kmem_cache_free(esdfs_dentry_cachep, dentry->d_fsdata);
+	info = dentry->d_fsdata;
 	dentry->d_fsdata = NULL;
+	call_rcu(&info->rcu, esdfs_free_dentry_info);
 }
 
 /* allocate new dentry private data */
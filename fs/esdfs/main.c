@@ -229,6 +229,12 @@ static int esdfs_read_super(struct super_block *sb, const char *dev_name,
 		err = -ENOMEM;
 		goto out_pput;
 	}
+	err = percpu_counter_init(&sbi->rcu_walks, 0);
+	if (err)
+		goto out_free;
+	err = percpu_counter_init(&sbi->rcu_walk_fallbacks, 0);
+	if (err)
+		goto out_free;
 
 	/* set defaults and then parse the mount options */
 	memcpy(&sbi->lower_perms,
@@ -353,6 +359,8 @@ out_sput:
 	/* drop refs we took earlier */
 	atomic_dec(&lower_sb->s_active);
 out_free:
+	percpu_counter_destroy(&sbi->rcu_walks);
+	percpu_counter_destroy(&sbi->rcu_walk_fallbacks);
 	kfree(ESDFS_SB(sb));
 	sb->s_fs_info = NULL;
 out_pput:
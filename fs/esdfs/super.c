@@ -45,6 +45,8 @@ static void esdfs_put_super(struct super_block *sb)
 	esdfs_set_lower_super(sb, NULL);
 	atomic_dec(&s->s_active);
 
+	percpu_counter_destroy(&spd->rcu_walks);
+	percpu_counter_destroy(&spd->rcu_walk_fallbacks);
 	kfree(spd);
 	sb->s_fs_info = NULL;
 }
@@ -122,11 +124,18 @@ static struct inode *esdfs_alloc_inode(struct super_block *sb)
 	return &i->vfs_inode;
 }
 
-static void esdfs_destroy_inode(struct inode *inode)
+static void esdfs_i_callback(struct rcu_head *head)
 {
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
 	kmem_cache_free(esdfs_inode_cachep, ESDFS_I(inode));
 }
 
+static void esdfs_destroy_inode(struct inode *inode)
+{
+	call_rcu(&inode->i_rcu, esdfs_i_callback);
+}
+
 /* esdfs inode cache constructor */
 static void init_once(void *obj)
 {
@@ -151,6 +160,7 @@ int esdfs_init_inode_cache(void)
 /* esdfs inode cache destructor */
 void esdfs_destroy_inode_cache(void)
 {
+	rcu_barrier();
 	if (esdfs_inode_cachep)
 		kmem_cache_destroy(esdfs_inode_cachep);
 }
@@ -209,6 +219,16 @@ static int esdfs_show_options(struct seq_file *seq, struct dentry *root)
 	return 0;
 }
 
+static int esdfs_show_stats(struct seq_file *seq, struct dentry *root)
+{
+	struct esdfs_sb_info *sbi = ESDFS_SB(root->d_sb);
+
+	seq_printf(seq, " rcu_walks=%lld rcu_walk_fallbacks=%lld",
+		   percpu_counter_sum(&sbi->rcu_walks),
+		   percpu_counter_sum(&sbi->rcu_walk_fallbacks));
+	return 0;
+}
+
 const struct super_operations esdfs_sops = {
 	.put_super	= esdfs_put_super,
 	.statfs		= esdfs_statfs,
@@ -216,6 +236,7 @@ const struct super_operations esdfs_sops = {
 	.evict_inode	= esdfs_evict_inode,
 	.umount_begin	= esdfs_umount_begin,
 	.show_options	= esdfs_show_options,
+	.show_stats	= esdfs_show_stats,
 	.alloc_inode	= esdfs_alloc_inode,
 	.destroy_inode	= esdfs_destroy_inode,
 	.drop_inode	= generic_delete_inode,
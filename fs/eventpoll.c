@@ -87,7 +87,10 @@
  */
 
 /* Epoll private bits inside the event mask */
-#define EP_PRIVATE_BITS (EPOLLONESHOT | EPOLLET)
+#define EP_PRIVATE_BITS (EPOLLONESHOT | EPOLLET | EPOLLEXCLUSIVE)
+
+#define EP_EXCLUSIVE_OK_BITS (EPOLLEXCLUSIVE | POLLIN | POLLOUT | POLLERR | \
+			      POLLHUP | EPOLLET)
 
 /* Maximum number of nesting allowed inside epoll sets */
 #define EP_MAX_NESTS 4
@@ -98,6 +101,9 @@
 
 #define EP_ITEM_COST (sizeof(struct epitem) + sizeof(struct eppoll_entry))
 
+/* Events copied to userspace by each __copy_to_user() in epoll_wait() */
+#define EP_SEND_BATCH 16
+
 struct epoll_filefd {
 	struct file *file;
 	int fd;
@@ -202,6 +208,15 @@ struct eventpoll {
 	/* used to optimize loop detection check */
 	int visited;
 	struct list_head visited_list_link;
+
+	/*
+	 * Statistics shown in /proc/<pid>/fdinfo: callbacks and wakeups
+	 * are counted under ->lock, events and batches under ->mtx.
+	 */
+	unsigned long nr_callbacks;
+	unsigned long nr_wakeups;
+	unsigned long nr_events;
+	unsigned long nr_batches;
 };
 
 /* Wait structure used by the poll hooks */
@@ -776,6 +791,29 @@ static const struct file_operations eventpoll_fops = {
 	.llseek		= noop_llseek,
 };
 
+/*
+ * Called from /proc/<pid>/fdinfo with the owner's ->file_lock held, so
+ * this only takes a snapshot of the counters. A low ep_wakeups to
+ * ep_callbacks ratio means most target wakeups found nobody waiting,
+ * and ep_events / ep_batches is the number of events per copy-out.
+ */
+int eventpoll_fdinfo(struct file *file, char *buf, size_t size)
+{
+	struct eventpoll *ep;
+
+	if (!is_file_epoll(file))
+		return 0;
+
+	ep = file->private_data;
+	return scnprintf(buf, size,
+			 "ep_callbacks:\t%lu\n"
+			 "ep_wakeups:\t%lu\n"
+			 "ep_events:\t%lu\n"
+			 "ep_batches:\t%lu\n",
+			 ep->nr_callbacks, ep->nr_wakeups,
+			 ep->nr_events, ep->nr_batches);
+}
+
 /*
  * This is called from eventpoll_release() to unlink files from the eventpoll
  * interface. We need to have this facility to cleanup correctly files that are
@@ -882,6 +920,7 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
 static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *key)
 {
 	int pwake = 0;
+	int ewake = 0;
 	unsigned long flags;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
@@ -898,6 +937,7 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	}
 
 	spin_lock_irqsave(&ep->lock, flags);
+	ep->nr_callbacks++;
 
 	/*
 	 * If the event mask does not contain any poll(2) event, we consider the
@@ -928,6 +968,8 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 			epi->next = ep->ovflist;
 			ep->ovflist = epi;
 		}
+		/* somebody is collecting events right now and will see it */
+		ewake = 1;
 		goto out_unlock;
 	}
 
@@ -939,8 +981,11 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
 	 * wait list.
 	 */
-	if (waitqueue_active(&ep->wq))
+	if (waitqueue_active(&ep->wq)) {
+		ep->nr_wakeups++;
+		ewake = 1;
 		wake_up_locked(&ep->wq);
+	}
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
 
@@ -951,6 +996,14 @@ out_unlock:
 	if (pwake)
 		ep_poll_safewake(&ep->poll_wait);
 
+	/*
+	 * An exclusive item only counts as a wakeup for the target's wait
+	 * queue if it really woke an epoll_wait() caller, so that the next
+	 * exclusive epoll set gets a chance when this one had nobody waiting.
+	 */
+	if (epi->event.events & EPOLLEXCLUSIVE)
+		return ewake;
+
 	return 1;
 }
 
@@ -968,7 +1021,10 @@ static void ep_ptable_queue_proc(struct file *file, wait_queue_head_t *whead,
 		init_waitqueue_func_entry(&pwq->wait, ep_poll_callback);
 		pwq->whead = whead;
 		pwq->base = epi;
-		add_wait_queue(whead, &pwq->wait);
+		if (epi->event.events & EPOLLEXCLUSIVE)
+			add_wait_queue_exclusive(whead, &pwq->wait);
+		else
+			add_wait_queue(whead, &pwq->wait);
 		list_add_tail(&pwq->llink, &epi->pwqlist);
 		epi->nwait++;
 	} else {
@@ -1281,14 +1337,63 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 	return 0;
 }
 
+/*
+ * Copy a batch of ready events out with a single __copy_to_user() and
+ * then do the ONESHOT and Level Trigger bookkeeping for the items that
+ * made it. Items whose event could not be copied go back to the front
+ * of @head, in their original order, for ep_scan_ready_list() to requeue.
+ * Returns the number of events delivered.
+ */
+static int ep_send_batch(struct eventpoll *ep, struct list_head *head,
+			 struct epoll_event __user *uevent,
+			 struct epoll_event *batch, struct epitem **items,
+			 int nr)
+{
+	unsigned long left;
+	int i, done;
+
+	left = __copy_to_user(uevent, batch, nr * sizeof(*batch));
+	done = nr - DIV_ROUND_UP(left, sizeof(*batch));
+
+	for (i = nr - 1; i >= done; i--)
+		list_add(&items[i]->rdllink, head);
+
+	for (i = 0; i < done; i++) {
+		struct epitem *epi = items[i];
+
+		if (epi->event.events & EPOLLONESHOT)
+			epi->event.events &= EP_PRIVATE_BITS;
+		else if (!(epi->event.events & EPOLLET)) {
+			/*
+			 * If this file has been added with Level
+			 * Trigger mode, we need to insert back inside
+			 * the ready list, so that the next call to
+			 * epoll_wait() will check again the events
+			 * availability. At this point, no one can insert
+			 * into ep->rdllist besides us. The epoll_ctl()
+			 * callers are locked out by
+			 * ep_scan_ready_list() holding "mtx" and the
+			 * poll callback will queue them in ep->ovflist.
+			 */
+			list_add_tail(&epi->rdllink, &ep->rdllist);
+		}
+	}
+
+	ep->nr_events += done;
+	ep->nr_batches++;
+
+	return done;
+}
+
 static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 			       void *priv)
 {
 	struct ep_send_events_data *esed = priv;
-	int eventcnt;
+	struct epoll_event batch[EP_SEND_BATCH];
+	struct epitem *items[EP_SEND_BATCH];
+	int eventcnt, nr, done;
 	unsigned int revents;
 	struct epitem *epi;
-	struct epoll_event __user *uevent;
 	poll_table pt;
 
 	init_poll_funcptr(&pt, NULL);
@@ -1298,8 +1403,8 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 	 * Items cannot vanish during the loop because ep_scan_ready_list() is
 	 * holding "mtx" during this call.
 	 */
-	for (eventcnt = 0, uevent = esed->events;
-	     !list_empty(head) && eventcnt < esed->maxevents;) {
+	for (eventcnt = 0, nr = 0;
+	     !list_empty(head) && eventcnt + nr < esed->maxevents;) {
 		epi = list_first_entry(head, struct epitem, rdllink);
 
 		list_del_init(&epi->rdllink);
@@ -1314,31 +1419,29 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 		 * is holding "mtx", so no operations coming from userspace
 		 * can change the item.
 		 */
-		if (revents) {
-			if (__put_user(revents, &uevent->events) ||
-			    __put_user(epi->event.data, &uevent->data)) {
-				list_add(&epi->rdllink, head);
-				return eventcnt ? eventcnt : -EFAULT;
-			}
-			eventcnt++;
-			uevent++;
-			if (epi->event.events & EPOLLONESHOT)
-				epi->event.events &= EP_PRIVATE_BITS;
-			else if (!(epi->event.events & EPOLLET)) {
-				/*
-				 * If this file has been added with Level
-				 * Trigger mode, we need to insert back inside
-				 * the ready list, so that the next call to
-				 * epoll_wait() will check again the events
-				 * availability. At this point, no one can insert
-				 * into ep->rdllist besides us. The epoll_ctl()
-				 * callers are locked out by
-				 * ep_scan_ready_list() holding "mtx" and the
-				 * poll callback will queue them in ep->ovflist.
-				 */
-				list_add_tail(&epi->rdllink, &ep->rdllist);
-			}
-		}
+		if (!revents)
+			continue;
+
+		batch[nr].events = revents;
+		batch[nr].data = epi->event.data;
+		items[nr++] = epi;
+		if (nr < EP_SEND_BATCH)
+			continue;
+
+		done = ep_send_batch(ep, head, esed->events + eventcnt,
+				     batch, items, nr);
+		eventcnt += done;
+		if (done < nr)
+			return eventcnt ? eventcnt : -EFAULT;
+		nr = 0;
+	}
+
+	if (nr) {
+		done = ep_send_batch(ep, head, esed->events + eventcnt,
+				     batch, items, nr);
+		eventcnt += done;
+		if (done < nr)
+			return eventcnt ? eventcnt : -EFAULT;
 	}
 
 	return eventcnt;
@@ -1664,6 +1767,18 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	 */
 	ep = file->private_data;
 
+	/*
+	 * epoll adds to the wakeup queue at EPOLL_CTL_ADD time only, so
+	 * EPOLLEXCLUSIVE is not allowed for a EPOLL_CTL_MOD operation.
+	 * Also, we do not currently support nested exclusive wakeups, and
+	 * only the plain readiness events are allowed along with it.
+	 */
+	if (ep_op_has_event(op) && (epds.events & EPOLLEXCLUSIVE)) {
+		if (op == EPOLL_CTL_MOD || is_file_epoll(tfile) ||
+		    (epds.events & ~EP_EXCLUSIVE_OK_BITS))
+			goto error_tgt_fput;
+	}
+
 	/*
 	 * When we insert an epoll file descriptor, inside another epoll file
 	 * descriptor, there is the change of creating closed loops, which are
@@ -1718,8 +1833,10 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 		break;
 	case EPOLL_CTL_MOD:
 		if (epi) {
-			epds.events |= POLLERR | POLLHUP;
-			error = ep_modify(ep, epi, &epds);
+			if (!(epi->event.events & EPOLLEXCLUSIVE)) {
+				epds.events |= POLLERR | POLLHUP;
+				error = ep_modify(ep, epi, &epds);
+			}
 		} else
 			error = -ENOENT;
 		break;
@@ -78,6 +78,8 @@ typedef __u32 ext4_lblk_t;
 /* data type for block group number */
 typedef unsigned int ext4_group_t;
 
+#include "extents_status.h"
+
 /*
  * Flags used in mballoc's allocation_context flags field.
  *
@@ -902,6 +904,8 @@ struct ext4_inode_info {
 	struct jbd2_inode *jinode;
 
 	struct ext4_ext_cache i_cached_extent;
+	/* written extents, looked up without i_data_sem */
+	struct ext4_es_tree i_es_tree;
 	/*
 	 * File creation time. Its function is same as that of
 	 * struct timespec i_{a,c,m}time in the generic inode.
@@ -1304,6 +1308,12 @@ struct ext4_sb_info {
 
 	/* record the last minlen when FITRIM is called. */
 	atomic_t s_last_trim_minblks;
+
+	/* inodes with cached extents, for the extent status shrinker */
+	struct list_head s_es_lru;
+	spinlock_t s_es_lru_lock;
+	atomic_t s_es_nr;
+	struct shrinker s_es_shrinker;
 };
 
 static inline struct ext4_sb_info *EXT4_SB(struct super_block *sb)
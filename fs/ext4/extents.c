@@ -2555,6 +2555,7 @@ static int ext4_ext_remove_space(struct inode *inode, ext4_lblk_t start,
 
 again:
 	ext4_ext_invalidate_cache(inode);
+	ext4_es_remove_extent(inode, start, end - start + 1);
 
 	trace_ext4_ext_remove_space(inode, start, depth);
 
@@ -0,0 +1,413 @@
+/*
+ *  fs/ext4/extents_status.c
+ *
+ * In-memory cache of the written extents of an inode.
+ *
+ * ext4_map_blocks() looks blocks up here before it takes i_data_sem and
+ * walks the on-disk extent tree. A hit maps a read without any sleeping
+ * lock and without reading extent blocks; a miss falls back to the extent
+ * tree, whose answer is inserted while i_data_sem is still held.
+ *
+ * Only initialized (written) extents are cached. Extents are only ever
+ * removed from the tree with i_data_sem held for writing, and the paths
+ * doing so drop the corresponding range here first. Since insertions are
+ * done with i_data_sem held for reading, a stale mapping can never be
+ * inserted after the range was dropped.
+ *
+ * Each superblock keeps its inodes with cached extents on an LRU list,
+ * which a shrinker trims under memory pressure.
+ */
+
+#include <linux/fs.h>
+#include <linux/list.h>
+#include <linux/slab.h>
+#include "ext4.h"
+
+/* more than enough for the height of any red-black tree we can build */
+#define EXT4_ES_MAX_DEPTH	64
+
+static struct kmem_cache *ext4_es_cachep;
+
+int __init ext4_init_es(void)
+{
+	ext4_es_cachep = KMEM_CACHE(extent_status, SLAB_RECLAIM_ACCOUNT);
+	if (ext4_es_cachep == NULL)
+		return -ENOMEM;
+	return 0;
+}
+
+void ext4_exit_es(void)
+{
+	/* Wait for the entries still queued for freeing */
+	rcu_barrier();
+	kmem_cache_destroy(ext4_es_cachep);
+}
+
+void ext4_es_init_tree(struct ext4_es_tree *tree)
+{
+	tree->root = RB_ROOT;
+	seqcount_init(&tree->seq);
+	spin_lock_init(&tree->lock);
+	tree->nr = 0;
+	tree->referenced = 0;
+	INIT_LIST_HEAD(&tree->lru);
+}
+
+static inline u64 es_end(struct extent_status *es)
+{
+	return (u64)es->es_lblk + es->es_len;
+}
+
+static inline struct extent_status *es_next(struct extent_status *es)
+{
+	struct rb_node *node = rb_next(&es->rb_node);
+
+	return node ? rb_entry(node, struct extent_status, rb_node) : NULL;
+}
+
+static void es_free_rcu(struct rcu_head *head)
+{
+	kmem_cache_free(ext4_es_cachep,
+			container_of(head, struct extent_status, rcu));
+}
+
+/* Called with tree->lock held, inside a tree->seq write section */
+static void es_erase(struct ext4_es_tree *tree, struct extent_status *es)
+{
+	rb_erase(&es->rb_node, &tree->root);
+	tree->nr--;
+	call_rcu(&es->rcu, es_free_rcu);
+}
+
+/* Called with tree->lock held, inside a tree->seq write section */
+static void es_link(struct ext4_es_tree *tree, struct extent_status *new)
+{
+	struct rb_node **p = &tree->root.rb_node;
+	struct rb_node *parent = NULL;
+	struct extent_status *es;
+
+	while (*p) {
+		parent = *p;
+		es = rb_entry(parent, struct extent_status, rb_node);
+		if (new->es_lblk < es->es_lblk)
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+	rb_link_node(&new->rb_node, parent, p);
+	rb_insert_color(&new->rb_node, &tree->root);
+	tree->nr++;
+}
+
+/*
+ * Find the entry containing @lblk or, failing that, the first one after
+ * it. Called with tree->lock held.
+ */
+static struct extent_status *es_search(struct ext4_es_tree *tree,
+				       ext4_lblk_t lblk)
+{
+	struct rb_node *node = tree->root.rb_node;
+	struct extent_status *es, *next = NULL;
+
+	while (node) {
+		es = rb_entry(node, struct extent_status, rb_node);
+		if (lblk < es->es_lblk) {
+			next = es;
+			node = node->rb_left;
+		} else if (lblk - es->es_lblk >= es->es_len) {
+			node = node->rb_right;
+		} else {
+			return es;
+		}
+	}
+	return next;
+}
+
+/*
+ * Lockless version of es_search() for exact hits, called under
+ * rcu_read_lock(). A concurrent rebalance can send the walk astray or
+ * hand us a half-updated entry; the caller retries on tree->seq, and the
+ * depth bound keeps a walk through rotating nodes from looping.
+ */
+static int es_search_rcu(struct ext4_es_tree *tree, ext4_lblk_t lblk,
+			 struct extent_status *res)
+{
+	struct rb_node *node = ACCESS_ONCE(tree->root.rb_node);
+	struct extent_status *es;
+	int depth = 0;
+
+	while (node && depth++ < EXT4_ES_MAX_DEPTH) {
+		es = rb_entry(node, struct extent_status, rb_node);
+		if (lblk < ACCESS_ONCE(es->es_lblk)) {
+			node = ACCESS_ONCE(node->rb_left);
+		} else if (lblk - ACCESS_ONCE(es->es_lblk) >=
+			   ACCESS_ONCE(es->es_len)) {
+			node = ACCESS_ONCE(node->rb_right);
+		} else {
+			res->es_lblk = es->es_lblk;
+			res->es_len = es->es_len;
+			res->es_pblk = es->es_pblk;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * ext4_es_lookup_extent() - map @map->m_lblk from the cache
+ *
+ * On a hit @map is filled in the way ext4_map_blocks() would for an
+ * initialized extent, and the number of mapped blocks is returned.
+ * Returns 0 on a miss. Takes no lock.
+ */
+int ext4_es_lookup_extent(struct inode *inode, struct ext4_map_blocks *map)
+{
+	struct ext4_es_tree *tree = &EXT4_I(inode)->i_es_tree;
+	struct extent_status es;
+	unsigned int seq;
+	int found;
+
+	if (!ACCESS_ONCE(tree->nr) || !map->m_len)
+		return 0;
+
+	rcu_read_lock();
+	do {
+		seq = read_seqcount_begin(&tree->seq);
+		found = es_search_rcu(tree, map->m_lblk, &es);
+	} while (read_seqcount_retry(&tree->seq, seq));
+	rcu_read_unlock();
+
+	if (!found)
+		return 0;
+
+	if (!tree->referenced)
+		tree->referenced = 1;
+
+	map->m_pblk = es.es_pblk + (map->m_lblk - es.es_lblk);
+	map->m_len = min_t(unsigned int, map->m_len,
+			   es.es_len - (map->m_lblk - es.es_lblk));
+	map->m_flags = EXT4_MAP_MAPPED;
+	return map->m_len;
+}
+
+static void es_lru_add(struct inode *inode, struct ext4_es_tree *tree)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(inode->i_sb);
+
+	if (!list_empty(&tree->lru))
+		return;
+
+	spin_lock(&sbi->s_es_lru_lock);
+	if (list_empty(&tree->lru))
+		list_add_tail(&tree->lru, &sbi->s_es_lru);
+	spin_unlock(&sbi->s_es_lru_lock);
+}
+
+/*
+ * ext4_es_insert_extent() - cache that [@lblk, @lblk + @len) is written
+ *			     and maps to @pblk onwards
+ *
+ * Must be called with i_data_sem held, with the mapping just read from or
+ * written to the extent tree. Neighbouring entries that continue the
+ * mapping physically are merged with it; entries overlapping it with a
+ * different mapping are stale and dropped.
+ */
+void ext4_es_insert_extent(struct inode *inode, ext4_lblk_t lblk,
+			   ext4_lblk_t len, ext4_fsblk_t pblk)
+{
+	struct ext4_es_tree *tree = &EXT4_I(inode)->i_es_tree;
+	struct ext4_sb_info *sbi = EXT4_SB(inode->i_sb);
+	struct extent_status *new, *es, *next;
+	u64 start = lblk, end = (u64)lblk + len;
+	unsigned int nr;
+
+	if (!len)
+		return;
+
+	new = kmem_cache_alloc(ext4_es_cachep, GFP_NOFS);
+	if (!new)
+		return;
+
+	spin_lock(&tree->lock);
+	write_seqcount_begin(&tree->seq);
+	nr = tree->nr;
+
+	/* Start from an entry that may end right at @lblk */
+	es = es_search(tree, lblk ? lblk - 1 : 0);
+	while (es && es->es_lblk <= end) {
+		next = es_next(es);
+		if (es->es_pblk + lblk == pblk + es->es_lblk) {
+			start = min_t(u64, start, es->es_lblk);
+			end = max(end, es_end(es));
+			es_erase(tree, es);
+		} else if (es->es_lblk < end && es_end(es) > start) {
+			es_erase(tree, es);
+		}
+		es = next;
+	}
+
+	new->es_lblk = start;
+	new->es_len = end - start;
+	new->es_pblk = pblk - (lblk - start);
+	es_link(tree, new);
+
+	atomic_add(tree->nr - nr, &sbi->s_es_nr);
+	write_seqcount_end(&tree->seq);
+	spin_unlock(&tree->lock);
+
+	es_lru_add(inode, tree);
+}
+
+/*
+ * ext4_es_remove_extent() - forget any mapping of [@lblk, @lblk + @len)
+ *
+ * Must be called with i_data_sem held for writing, before the extent
+ * tree stops mapping the range.
+ */
+void ext4_es_remove_extent(struct inode *inode, ext4_lblk_t lblk,
+			   ext4_lblk_t len)
+{
+	struct ext4_es_tree *tree = &EXT4_I(inode)->i_es_tree;
+	struct ext4_sb_info *sbi = EXT4_SB(inode->i_sb);
+	struct extent_status *es, *next, *right;
+	u64 end = (u64)lblk + len;
+	u64 es_e;
+	unsigned int nr;
+
+	if (!ACCESS_ONCE(tree->nr) || !len)
+		return;
+
+	spin_lock(&tree->lock);
+	write_seqcount_begin(&tree->seq);
+	nr = tree->nr;
+
+	es = es_search(tree, lblk);
+	while (es && es->es_lblk < end) {
+		next = es_next(es);
+		es_e = es_end(es);
+		if (es->es_lblk < lblk) {
+			/*
+			 * Keep the head. A hole punched in the middle also
+			 * keeps the tail if we can get an entry for it;
+			 * dropping it is always safe.
+			 */
+			if (es_e > end) {
+				right = kmem_cache_alloc(ext4_es_cachep,
+							 GFP_ATOMIC);
+				if (right) {
+					right->es_lblk = end;
+					right->es_len = es_e - end;
+					right->es_pblk = es->es_pblk +
+							 (end - es->es_lblk);
+				}
+				es->es_len = lblk - es->es_lblk;
+				if (right)
+					es_link(tree, right);
+				break;
+			}
+			es->es_len = lblk - es->es_lblk;
+		} else if (es_e > end) {
+			es->es_pblk += end - es->es_lblk;
+			es->es_len = es_e - end;
+			es->es_lblk = end;
+		} else {
+			es_erase(tree, es);
+		}
+		es = next;
+	}
+
+	atomic_sub(nr - tree->nr, &sbi->s_es_nr);
+	write_seqcount_end(&tree->seq);
+	spin_unlock(&tree->lock);
+}
+
+/* Called with tree->lock held; returns the number of entries dropped */
+static unsigned int __es_remove_all(struct ext4_sb_info *sbi,
+				    struct ext4_es_tree *tree)
+{
+	struct rb_node *node;
+	unsigned int nr = tree->nr;
+
+	if (!nr)
+		return 0;
+
+	write_seqcount_begin(&tree->seq);
+	while ((node = rb_first(&tree->root)))
+		es_erase(tree, rb_entry(node, struct extent_status, rb_node));
+	write_seqcount_end(&tree->seq);
+
+	atomic_sub(nr, &sbi->s_es_nr);
+	return nr;
+}
+
+/* Drop all entries of @inode, e.g. when it is evicted */
+void ext4_es_remove_all(struct inode *inode)
+{
+	struct ext4_es_tree *tree = &EXT4_I(inode)->i_es_tree;
+	struct ext4_sb_info *sbi = EXT4_SB(inode->i_sb);
+
+	spin_lock(&tree->lock);
+	__es_remove_all(sbi, tree);
+	spin_unlock(&tree->lock);
+
+	if (list_empty(&tree->lru))
+		return;
+
+	spin_lock(&sbi->s_es_lru_lock);
+	list_del_init(&tree->lru);
+	spin_unlock(&sbi->s_es_lru_lock);
+}
+
+/*
+ * Drop the cached extents of whole inodes, least recently added first.
+ * An inode looked up since the previous scan gets a second chance.
+ */
+static int ext4_es_shrink(struct shrinker *shrink, struct shrink_control *sc)
+{
+	struct ext4_sb_info *sbi = container_of(shrink, struct ext4_sb_info,
+						s_es_shrinker);
+	struct ext4_es_tree *tree, *tmp;
+	int nr_to_scan = sc->nr_to_scan;
+	LIST_HEAD(skipped);
+
+	if (!nr_to_scan)
+		return atomic_read(&sbi->s_es_nr);
+
+	spin_lock(&sbi->s_es_lru_lock);
+	list_for_each_entry_safe(tree, tmp, &sbi->s_es_lru, lru) {
+		if (nr_to_scan <= 0)
+			break;
+
+		if (tree->referenced) {
+			tree->referenced = 0;
+			list_move_tail(&tree->lru, &skipped);
+			continue;
+		}
+
+		spin_lock(&tree->lock);
+		nr_to_scan -= __es_remove_all(sbi, tree);
+		spin_unlock(&tree->lock);
+		list_del_init(&tree->lru);
+	}
+	list_splice_tail(&skipped, &sbi->s_es_lru);
+	spin_unlock(&sbi->s_es_lru_lock);
+
+	return atomic_read(&sbi->s_es_nr);
+}
+
+void ext4_es_register_shrinker(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+
+	INIT_LIST_HEAD(&sbi->s_es_lru);
+	spin_lock_init(&sbi->s_es_lru_lock);
+	atomic_set(&sbi->s_es_nr, 0);
+	sbi->s_es_shrinker.shrink = ext4_es_shrink;
+	sbi->s_es_shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&sbi->s_es_shrinker);
+}
+
+void ext4_es_unregister_shrinker(struct super_block *sb)
+{
+	unregister_shrinker(&EXT4_SB(sb)->s_es_shrinker);
+}
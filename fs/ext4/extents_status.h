@@ -0,0 +1,62 @@
+/*
+ *  fs/ext4/extents_status.h
+ *
+ * In-memory cache of the written extents of an inode, looked up without
+ * i_data_sem.
+ */
+
+#ifndef _EXT4_EXTENTS_STATUS_H
+#define _EXT4_EXTENTS_STATUS_H
+
+#include <linux/list.h>
+#include <linux/rbtree.h>
+#include <linux/rcupdate.h>
+#include <linux/seqlock.h>
+#include <linux/spinlock.h>
+
+/*
+ * A run of logical blocks mapped to contiguous, initialized physical
+ * blocks. Holes, delayed and uninitialized extents are not cached, so a
+ * lookup miss just means "ask the extent tree".
+ */
+struct extent_status {
+	struct rb_node rb_node;
+	ext4_lblk_t es_lblk;		/* first logical block */
+	ext4_lblk_t es_len;		/* length in blocks */
+	ext4_fsblk_t es_pblk;		/* first physical block */
+	struct rcu_head rcu;
+};
+
+/*
+ * Entries are added and removed under @lock, inside a @seq write section.
+ * Lookups walk the tree under rcu_read_lock() and retry when @seq shows a
+ * concurrent update; removed entries are freed after a grace period so a
+ * racing walk never touches freed memory.
+ */
+struct ext4_es_tree {
+	struct rb_root root;
+	seqcount_t seq;
+	spinlock_t lock;
+	unsigned int nr;		/* entries in @root */
+	unsigned int referenced;	/* looked up since the last shrink scan */
+	struct list_head lru;		/* on ext4_sb_info.s_es_lru */
+};
+
+struct ext4_map_blocks;
+
+extern int __init ext4_init_es(void);
+extern void ext4_exit_es(void);
+extern void ext4_es_init_tree(struct ext4_es_tree *tree);
+
+extern int ext4_es_lookup_extent(struct inode *inode,
+				 struct ext4_map_blocks *map);
+extern void ext4_es_insert_extent(struct inode *inode, ext4_lblk_t lblk,
+				  ext4_lblk_t len, ext4_fsblk_t pblk);
+extern void ext4_es_remove_extent(struct inode *inode, ext4_lblk_t lblk,
+				  ext4_lblk_t len);
+extern void ext4_es_remove_all(struct inode *inode);
+
+extern void ext4_es_register_shrinker(struct super_block *sb);
+extern void ext4_es_unregister_shrinker(struct super_block *sb);
+
+#endif /* _EXT4_EXTENTS_STATUS_H */
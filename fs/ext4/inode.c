@@ -347,6 +347,33 @@ static int __check_block_validity(struct inode *inode, const char *func,
 #define check_block_validity(inode, map)	\
 	__check_block_validity((inode), __func__, __LINE__, (map))
 
+/*
+ * Cache a mapping of written blocks just read from or added to the extent
+ * tree. Called with i_data_sem held. Mappings that would fail
+ * check_block_validity() are left out so that a cache hit never has to
+ * be checked again.
+ *
+ * ext4_ext_map_blocks() only reports uninitialized extents as UNWRITTEN
+ * on a plain lookup. When it allocates, splits or finds preallocated
+ * blocks on behalf of fallocate or direct I/O it returns them MAPPED,
+ * and freshly allocated blocks hold no data yet either, so anything
+ * coming out of an uninit request or flagged NEW or UNINIT is left for
+ * a later lookup to cache.
+ */
+static void ext4_es_cache_map(struct inode *inode,
+			      struct ext4_map_blocks *map, int retval,
+			      int flags)
+{
+	if (flags & EXT4_GET_BLOCKS_UNINIT_EXT)
+		return;
+
+	if (retval > 0 && (map->m_flags & EXT4_MAP_MAPPED) &&
+	    !(map->m_flags & (EXT4_MAP_UNWRITTEN | EXT4_MAP_NEW |
+			      EXT4_MAP_UNINIT)) &&
+	    ext4_data_block_valid(EXT4_SB(inode->i_sb), map->m_pblk, retval))
+		ext4_es_insert_extent(inode, map->m_lblk, retval, map->m_pblk);
+}
+
 /*
  * Return the number of contiguous dirty pages in a given inode
  * starting at page frame idx.
@@ -481,6 +508,16 @@ int ext4_map_blocks(handle_t *handle, struct inode *inode,
 	ext_debug("ext4_map_blocks(): inode %lu, flag %d, max_blocks %u,"
 		  "logical block %lu\n", inode->i_ino, flags, map->m_len,
 		  (unsigned long) map->m_lblk);
+
+	/*
+	 * Written blocks found in the extent status cache need neither
+	 * i_data_sem nor the extent tree, whether or not the caller would
+	 * allocate: allocated blocks are returned as they are.
+	 */
+	retval = ext4_es_lookup_extent(inode, map);
+	if (retval > 0)
+		return retval;
+
 	/*
 	 * Try to see if we can get the block without requesting a new
 	 * file system block.
@@ -489,6 +526,7 @@ int ext4_map_blocks(handle_t *handle, struct inode *inode,
 	if (ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS)) {
 		retval = ext4_ext_map_blocks(handle, inode, map, flags &
 					     EXT4_GET_BLOCKS_KEEP_SIZE);
+		ext4_es_cache_map(inode, map, retval, 0);
 	} else {
 		retval = ext4_ind_map_blocks(handle, inode, map, flags &
 					     EXT4_GET_BLOCKS_KEEP_SIZE);
@@ -549,6 +587,7 @@ int ext4_map_blocks(handle_t *handle, struct inode *inode,
 	 */
 	if (ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS)) {
 		retval = ext4_ext_map_blocks(handle, inode, map, flags);
+		ext4_es_cache_map(inode, map, retval, flags);
 	} else {
 		retval = ext4_ind_map_blocks(handle, inode, map, flags);
 
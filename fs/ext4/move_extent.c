@@ -631,6 +631,8 @@ mext_replace_branches(handle_t *handle, struct inode *orig_inode,
 
 	/* Protect extent trees against block allocations via delalloc */
 	double_down_write_data_sem(orig_inode, donor_inode);
+	ext4_es_remove_extent(orig_inode, from, count);
+	ext4_es_remove_extent(donor_inode, from, count);
 
 	/* Get the original extent for the block "orig_off" */
 	*err = get_ext_path(orig_inode, orig_off, &orig_path);
@@ -74,6 +74,14 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->dirty_sits = SIT_I(sbi)->dirty_sentries;
 	si->fnids = NM_I(sbi)->fcnt;
 	si->bg_gc = sbi->bg_gc;
+	si->fsync_count = atomic_read(&sbi->fsync_count);
+	si->fsync_cp = atomic_read(&sbi->fsync_cp);
+	si->fsync_tracked = atomic_read(&sbi->fsync_tracked);
+	si->fsync_scanned = atomic_read(&sbi->fsync_scanned);
+	si->fsync_avg_us = !si->fsync_count ? 0 :
+		div_u64(div_u64(atomic64_read(&sbi->fsync_time),
+				si->fsync_count), NSEC_PER_USEC);
+	si->fsync_max_us = div_u64(sbi->fsync_time_max, NSEC_PER_USEC);
 	si->util_free = (int)(free_user_blocks(sbi) >> sbi->log_blocks_per_seg)
 		* 100 / (int)(sbi->user_block_count >> sbi->log_blocks_per_seg)
 		/ 2;
@@ -280,6 +288,12 @@ static int stat_show(struct seq_file *s, void *v)
 			   si->prefree_count, si->free_segs, si->free_secs);
 		seq_printf(s, "CP calls: %d (BG: %d)\n",
 				si->cp_count, si->bg_cp_count);
+		seq_printf(s, "fsync calls: %d (CP: %d)\n",
+				si->fsync_count, si->fsync_cp);
+		seq_printf(s, "  - node writes: tracked %d, scanned %d\n",
+				si->fsync_tracked, si->fsync_scanned);
+		seq_printf(s, "  - latency: avg %llu us, max %llu us\n",
+				si->fsync_avg_us, si->fsync_max_us);
 		seq_printf(s, "GC calls: %d (BG: %d)\n",
 			   si->call_count, si->bg_gc);
 		seq_printf(s, "  - data segments : %d (%d)\n",
@@ -370,6 +384,19 @@ static const struct file_operations stat_fops = {
 	.release = single_release,
 };
 
+void f2fs_update_fsync_stat(struct f2fs_sb_info *sbi, ktime_t start)
+{
+	s64 delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	atomic_inc(&sbi->fsync_count);
+	atomic64_add(delta, &sbi->fsync_time);
+
+	spin_lock(&sbi->stat_lock);
+	if (delta > sbi->fsync_time_max)
+		sbi->fsync_time_max = delta;
+	spin_unlock(&sbi->stat_lock);
+}
+
 int f2fs_build_stats(struct f2fs_sb_info *sbi)
 {
 	struct f2fs_super_block *raw_super = F2FS_RAW_SUPER(sbi);
@@ -398,6 +425,12 @@ int f2fs_build_stats(struct f2fs_sb_info *sbi)
 	atomic_set(&sbi->inline_xattr, 0);
 	atomic_set(&sbi->inline_inode, 0);
 	atomic_set(&sbi->inline_dir, 0);
+	atomic_set(&sbi->fsync_count, 0);
+	atomic_set(&sbi->fsync_cp, 0);
+	atomic_set(&sbi->fsync_tracked, 0);
+	atomic_set(&sbi->fsync_scanned, 0);
+	atomic64_set(&sbi->fsync_time, 0);
+	sbi->fsync_time_max = 0;
 	atomic_set(&sbi->inplace_count, 0);
 
 	mutex_lock(&f2fs_stat_mutex);
@@ -22,6 +22,7 @@
 #include <linux/crc32.h>
 #include <linux/magic.h>
 #include <linux/kobject.h>
+#include <linux/ktime.h>
 #include <linux/sched.h>
 #include <linux/vmalloc.h>
 #include <linux/bio.h>
@@ -613,6 +614,10 @@ struct f2fs_nm_info {
 	unsigned int fcnt;		/* the number of free node id */
 	struct mutex build_lock;	/* lock for build free nids */
 
+	/* dirty direct nodes tracked per inode for fsync */
+	struct radix_tree_root fsync_dnode_root;/* root of the fsync sets */
+	spinlock_t fsync_dnode_lock;	/* protect fsync_dnode_root */
+
 	/* for checkpoint */
 	char *nat_bitmap;		/* NAT bitmap pointer */
 	int bitmap_size;		/* bitmap size */
@@ -936,6 +941,12 @@ struct f2fs_sb_info {
 	atomic_t inline_dir;			/* # of inline_dentry inodes */
 	int bg_gc;				/* background gc calls */
 	unsigned int ndirty_inode[NR_INODE_TYPE];	/* # of dirty inodes */
+	atomic_t fsync_count;			/* # of fsync calls */
+	atomic_t fsync_cp;			/* # of fsyncs done by checkpoint */
+	atomic_t fsync_tracked;			/* # of tracked dnode writes */
+	atomic_t fsync_scanned;			/* # of full dirty node scans */
+	atomic64_t fsync_time;			/* total fsync latency in ns */
+	s64 fsync_time_max;			/* worst fsync latency in ns */
 #endif
 	unsigned int last_victim[2];		/* last victim segment # */
 	spinlock_t stat_lock;			/* lock for stat operations */
@@ -2032,6 +2043,7 @@ struct page *get_node_page_ra(struct page *, int);
 void move_node_page(struct page *, int);
 int fsync_node_pages(struct f2fs_sb_info *, struct inode *,
 			struct writeback_control *, bool);
+void remove_fsync_dnode_set(struct f2fs_sb_info *, nid_t);
 int sync_node_pages(struct f2fs_sb_info *, struct writeback_control *);
 void build_free_nids(struct f2fs_sb_info *);
 bool alloc_nid(struct f2fs_sb_info *, nid_t *);
@@ -2181,6 +2193,8 @@ struct f2fs_stat_info {
 	int nats, dirty_nats, sits, dirty_sits, fnids;
 	int total_count, utilization;
 	int bg_gc, wb_bios;
+	int fsync_count, fsync_cp, fsync_tracked, fsync_scanned;
+	unsigned long long fsync_avg_us, fsync_max_us;
 	int inline_xattr, inline_inode, inline_dir, orphans;
 	unsigned int valid_count, valid_node_count, valid_inode_count;
 	unsigned int bimodal, avg_vblocks;
@@ -2211,6 +2225,9 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 #define stat_inc_bg_cp_count(si)	((si)->bg_cp_count++)
 #define stat_inc_call_count(si)		((si)->call_count++)
 #define stat_inc_bggc_count(sbi)	((sbi)->bg_gc++)
+#define stat_inc_fsync_cp(sbi)		(atomic_inc(&(sbi)->fsync_cp))
+#define stat_inc_fsync_tracked(sbi)	(atomic_inc(&(sbi)->fsync_tracked))
+#define stat_inc_fsync_scanned(sbi)	(atomic_inc(&(sbi)->fsync_scanned))
 #define stat_inc_dirty_inode(sbi, type)	((sbi)->ndirty_inode[type]++)
 #define stat_dec_dirty_inode(sbi, type)	((sbi)->ndirty_inode[type]--)
 #define stat_inc_total_hit(sbi)		(atomic64_inc(&(sbi)->total_hit_ext))
@@ -2285,6 +2302,7 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 		si->bg_node_blks += (gc_type == BG_GC) ? (blks) : 0;	\
 	} while (0)
 
+void f2fs_update_fsync_stat(struct f2fs_sb_info *, ktime_t);
 int f2fs_build_stats(struct f2fs_sb_info *);
 void f2fs_destroy_stats(struct f2fs_sb_info *);
 int __init f2fs_create_root_stats(void);
@@ -2294,6 +2312,9 @@ void f2fs_destroy_root_stats(void);
 #define stat_inc_bg_cp_count(si)
 #define stat_inc_call_count(si)
 #define stat_inc_bggc_count(si)
+#define stat_inc_fsync_cp(sbi)
+#define stat_inc_fsync_tracked(sbi)
+#define stat_inc_fsync_scanned(sbi)
 #define stat_inc_dirty_inode(sbi, type)
 #define stat_dec_dirty_inode(sbi, type)
 #define stat_inc_total_hit(sb)
@@ -2314,6 +2335,8 @@ void f2fs_destroy_root_stats(void);
 #define stat_inc_data_blk_count(sbi, blks, gc_type)
 #define stat_inc_node_blk_count(sbi, blks, gc_type)
 
+static inline void f2fs_update_fsync_stat(struct f2fs_sb_info *sbi,
+						ktime_t start) { }
 static inline int f2fs_build_stats(struct f2fs_sb_info *sbi) { return 0; }
 static inline void f2fs_destroy_stats(struct f2fs_sb_info *sbi) { }
 static inline int __init f2fs_create_root_stats(void) { return 0; }
@@ -185,6 +185,7 @@ static int f2fs_do_sync_file(struct file *file, loff_t start, loff_t end,
 	nid_t ino = inode->i_ino;
 	int ret = 0;
 	bool need_cp = false;
+	ktime_t start;
 	struct writeback_control wbc = {
 		.sync_mode = WB_SYNC_ALL,
 		.nr_to_write = LONG_MAX,
@@ -194,6 +195,8 @@ static int f2fs_do_sync_file(struct file *file, loff_t start, loff_t end,
 	if (unlikely(f2fs_readonly(inode->i_sb)))
 		return 0;
 
+	start = ktime_get();
+
 	trace_f2fs_sync_file_enter(inode);
 
 	/* if fdatasync is triggered, let's do in-place-update */
@@ -248,6 +251,7 @@ go_write:
 		try_to_fix_pino(inode);
 		clear_inode_flag(inode, FI_APPEND_WRITE);
 		clear_inode_flag(inode, FI_UPDATE_WRITE);
+		stat_inc_fsync_cp(sbi);
 		goto out;
 	}
 sync_nodes:
@@ -280,6 +284,7 @@ flush_out:
 	ret = f2fs_issue_flush(sbi);
 	f2fs_update_time(sbi, REQ_TIME);
 out:
+	f2fs_update_fsync_stat(sbi, start);
 	trace_f2fs_sync_file_exit(inode, need_cp, datasync, ret);
 	f2fs_trace_ios(NULL, 1);
 	return ret;
@@ -16,6 +16,7 @@
 #include <linux/kthread.h>
 #include <linux/delay.h>
 #include <linux/freezer.h>
+#include <linux/power_supply.h>
 
 #include "f2fs.h"
 #include "node.h"
@@ -23,12 +24,19 @@
 #include "gc.h"
 #include <trace/events/f2fs.h>
 
+/* nobody is looking at the screen, or we are on the charger */
+static bool gc_device_idle(struct f2fs_gc_kthread *gc_th)
+{
+	return gc_th->screen_off || power_supply_is_system_supplied() > 0;
+}
+
 static int gc_thread_func(void *data)
 {
 	struct f2fs_sb_info *sbi = data;
 	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
 	wait_queue_head_t *wq = &sbi->gc_thread->gc_wait_queue_head;
 	long wait_ms;
+	int urgency, batch;
 
 	wait_ms = gc_th->min_sleep_time;
 
@@ -50,35 +58,62 @@ static int gc_thread_func(void *data)
 		/*
 		 * [GC triggering condition]
 		 * 0. GC is not conducted currently.
-		 * 1. There are enough dirty segments.
+		 * 1. There are enough dirty segments, or free sections are
+		 *    running low (see gc_urgency()).
 		 * 2. IO subsystem is idle by checking the # of writeback pages.
 		 * 3. IO subsystem is idle by checking the # of requests in
-		 *    bdev's request list.
+		 *    bdev's request list, unless free space is urgent.
 		 *
 		 * Note) We have to avoid triggering GCs frequently.
 		 * Because it is possible that some segments can be
 		 * invalidated soon after by user update or deletion.
 		 * So, I'd like to wait some time to collect dirty segments.
 		 */
+		urgency = gc_urgency(sbi, gc_th);
+		if (urgency == GC_URGENCY_NONE ||
+		    (urgency == GC_URGENCY_LOW && !gc_device_idle(gc_th))) {
+			increase_sleep_time(gc_th, &wait_ms);
+			continue;
+		}
+
 		if (!mutex_trylock(&sbi->gc_mutex))
 			continue;
 
-		if (!is_idle(sbi)) {
+		if (urgency < GC_URGENCY_HIGH && !is_idle(sbi)) {
 			increase_sleep_time(gc_th, &wait_ms);
 			mutex_unlock(&sbi->gc_mutex);
 			continue;
 		}
 
-		if (has_enough_invalid_blocks(sbi))
-			decrease_sleep_time(gc_th, &wait_ms);
+		if (urgency == GC_URGENCY_HIGH)
+			wait_ms = gc_th->urgent_sleep_time;
+		else if (urgency == GC_URGENCY_MID)
+			wait_ms = gc_th->min_sleep_time;
 		else
-			increase_sleep_time(gc_th, &wait_ms);
+			decrease_sleep_time(gc_th, &wait_ms);
+
+		/* idle devices and urgent cases collect several victims */
+		batch = (urgency == GC_URGENCY_HIGH ||
+			 gc_device_idle(gc_th)) ? gc_th->idle_batch : 1;
 
 		stat_inc_bggc_count(sbi);
 
-		/* if return value is not zero, no victim was selected */
-		if (f2fs_gc(sbi, test_opt(sbi, FORCE_FG_GC)))
-			wait_ms = gc_th->no_gc_sleep_time;
+		/* f2fs_gc() drops gc_mutex */
+		while (1) {
+			/* if return value is not zero, no victim was selected */
+			if (f2fs_gc(sbi, test_opt(sbi, FORCE_FG_GC))) {
+				wait_ms = gc_th->no_gc_sleep_time;
+				break;
+			}
+			if (--batch <= 0 || kthread_should_stop())
+				break;
+			if (!mutex_trylock(&sbi->gc_mutex))
+				break;
+			if (urgency < GC_URGENCY_HIGH && !is_idle(sbi)) {
+				mutex_unlock(&sbi->gc_mutex);
+				break;
+			}
+		}
 
 		trace_f2fs_background_gc(sbi->sb, wait_ms,
 				prefree_segments(sbi), free_segments(sbi));
@@ -90,6 +125,25 @@ static int gc_thread_func(void *data)
 	return 0;
 }
 
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void gc_early_suspend(struct early_suspend *h)
+{
+	struct f2fs_gc_kthread *gc_th =
+		container_of(h, struct f2fs_gc_kthread, early_suspend);
+
+	gc_th->screen_off = true;
+	wake_up(&gc_th->gc_wait_queue_head);
+}
+
+static void gc_late_resume(struct early_suspend *h)
+{
+	struct f2fs_gc_kthread *gc_th =
+		container_of(h, struct f2fs_gc_kthread, early_suspend);
+
+	gc_th->screen_off = false;
+}
+#endif
+
 int start_gc_thread(struct f2fs_sb_info *sbi)
 {
 	struct f2fs_gc_kthread *gc_th;
@@ -105,9 +159,15 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 	gc_th->min_sleep_time = DEF_GC_THREAD_MIN_SLEEP_TIME;
 	gc_th->max_sleep_time = DEF_GC_THREAD_MAX_SLEEP_TIME;
 	gc_th->no_gc_sleep_time = DEF_GC_THREAD_NOGC_SLEEP_TIME;
+	gc_th->urgent_sleep_time = DEF_GC_THREAD_URGENT_SLEEP_TIME;
 
 	gc_th->gc_idle = 0;
 
+	gc_th->urgent_high = DEF_GC_URGENT_HIGH;
+	gc_th->urgent_mid = DEF_GC_URGENT_MID;
+	gc_th->idle_batch = DEF_GC_IDLE_BATCH;
+	gc_th->screen_off = false;
+
 	sbi->gc_thread = gc_th;
 	init_waitqueue_head(&sbi->gc_thread->gc_wait_queue_head);
 	sbi->gc_thread->f2fs_gc_task = kthread_run(gc_thread_func, sbi,
@@ -116,7 +176,15 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 		err = PTR_ERR(gc_th->f2fs_gc_task);
 		kfree(gc_th);
 		sbi->gc_thread = NULL;
+		goto out;
 	}
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	gc_th->early_suspend.level = EARLY_SUSPEND_LEVEL_DISABLE_FB + 1;
+	gc_th->early_suspend.suspend = gc_early_suspend;
+	gc_th->early_suspend.resume = gc_late_resume;
+	register_early_suspend(&gc_th->early_suspend);
+#endif
 out:
 	return err;
 }
@@ -126,6 +194,9 @@ void stop_gc_thread(struct f2fs_sb_info *sbi)
 	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
 	if (!gc_th)
 		return;
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	unregister_early_suspend(&gc_th->early_suspend);
+#endif
 	kthread_stop(gc_th->f2fs_gc_task);
 	kfree(gc_th);
 	sbi->gc_thread = NULL;
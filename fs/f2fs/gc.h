@@ -8,6 +8,10 @@
  * it under the terms of the GNU General Public License version 2 as
  * published by the Free Software Foundation.
  */
+#ifdef CONFIG_HAS_EARLYSUSPEND
+#include <linux/earlysuspend.h>
+#endif
+
 #define GC_THREAD_MIN_WB_PAGES		1	/*
 						 * a threshold to determine
 						 * whether IO subsystem is idle
@@ -16,12 +20,33 @@
 #define DEF_GC_THREAD_MIN_SLEEP_TIME	30000	/* milliseconds */
 #define DEF_GC_THREAD_MAX_SLEEP_TIME	60000
 #define DEF_GC_THREAD_NOGC_SLEEP_TIME	300000	/* wait 5 min */
+#define DEF_GC_THREAD_URGENT_SLEEP_TIME	500	/* running out of space */
+
+/* free sections above the reserved ones, in % of main area sections */
+#define DEF_GC_URGENT_HIGH	5
+#define DEF_GC_URGENT_MID	15
+#define DEF_GC_IDLE_BATCH	8	/* victims per wakeup on an idle device */
 #define LIMIT_INVALID_BLOCK	40 /* percentage over total user space */
 #define LIMIT_FREE_BLOCK	40 /* percentage over invalid + free space */
 
 /* Search max. number of dirty segments to select a victim segment */
 #define DEF_MAX_VICTIM_SEARCH 4096 /* covers 8GB */
 
+/*
+ * Background GC urgency, from the number of free sections.
+ *  LOW:  there is garbage worth collecting, but only while the device
+ *        is idle (screen off or charging) and the queue is idle.
+ *  MID:  whenever the queue is idle.
+ *  HIGH: regardless of foreground I/O, so that foreground GC from
+ *        f2fs_balance_fs() stays rare.
+ */
+enum {
+	GC_URGENCY_NONE,
+	GC_URGENCY_LOW,
+	GC_URGENCY_MID,
+	GC_URGENCY_HIGH,
+};
+
 struct f2fs_gc_kthread {
 	struct task_struct *f2fs_gc_task;
 	wait_queue_head_t gc_wait_queue_head;
@@ -30,9 +55,20 @@ struct f2fs_gc_kthread {
 	unsigned int min_sleep_time;
 	unsigned int max_sleep_time;
 	unsigned int no_gc_sleep_time;
+	unsigned int urgent_sleep_time;
 
 	/* for changing gc mode */
 	unsigned int gc_idle;
+
+	/* urgency thresholds and batching */
+	unsigned int urgent_high;
+	unsigned int urgent_mid;
+	unsigned int idle_batch;
+
+	bool screen_off;
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	struct early_suspend early_suspend;
+#endif
 };
 
 struct gc_inode_list {
@@ -100,3 +136,22 @@ static inline bool has_enough_invalid_blocks(struct f2fs_sb_info *sbi)
 		return true;
 	return false;
 }
+
+static inline int gc_urgency(struct f2fs_sb_info *sbi,
+				struct f2fs_gc_kthread *gc_th)
+{
+	int free_secs = free_sections(sbi) - reserved_sections(sbi);
+	unsigned int pct;
+
+	if (free_secs <= 0)
+		return GC_URGENCY_HIGH;
+
+	pct = free_secs * 100 / MAIN_SECS(sbi);
+	if (pct < gc_th->urgent_high)
+		return GC_URGENCY_HIGH;
+	if (pct < gc_th->urgent_mid)
+		return GC_URGENCY_MID;
+	if (has_enough_invalid_blocks(sbi))
+		return GC_URGENCY_LOW;
+	return GC_URGENCY_NONE;
+}
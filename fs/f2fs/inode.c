@@ -347,6 +347,7 @@ void f2fs_evict_inode(struct inode *inode)
 
 	f2fs_bug_on(sbi, get_dirty_pages(inode));
 	remove_dirty_inode(inode);
+	remove_fsync_dnode_set(sbi, inode->i_ino);
 
 	f2fs_destroy_extent_tree(inode);
 
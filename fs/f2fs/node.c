@@ -37,6 +37,7 @@ static inline int __must_check PTR_ERR_OR_ZERO(__force const void *ptr)
 static struct kmem_cache *nat_entry_slab;
 static struct kmem_cache *free_nid_slab;
 static struct kmem_cache *nat_entry_set_slab;
+static struct kmem_cache *fsync_dnode_slab;
 
 bool available_free_memory(struct f2fs_sb_info *sbi, int type)
 {
@@ -1321,6 +1322,128 @@ continue_unlock:
 	return last_page;
 }
 
+/*
+ * Remember a direct node page that is about to become dirty in the fsync
+ * set of its owner. Only inodes that were fsynced before have a set, so
+ * this stays a single radix tree lookup for everybody else.
+ */
+static void track_fsync_dnode(struct f2fs_sb_info *sbi, struct page *page)
+{
+	struct f2fs_nm_info *nm_i = NM_I(sbi);
+	struct fsync_dnode_set *set;
+	nid_t nid = page->index;
+	unsigned int i;
+
+	if (!IS_DNODE(page) || !is_cold_node(page))
+		return;
+
+	spin_lock(&nm_i->fsync_dnode_lock);
+	set = radix_tree_lookup(&nm_i->fsync_dnode_root, ino_of_node(page));
+	if (!set || set->overflow)
+		goto unlock;
+	for (i = 0; i < set->cnt; i++)
+		if (set->nids[i] == nid)
+			goto unlock;
+	if (set->cnt == FSYNC_DNODE_NIDS)
+		set->overflow = true;
+	else
+		set->nids[set->cnt++] = nid;
+unlock:
+	spin_unlock(&nm_i->fsync_dnode_lock);
+}
+
+/*
+ * Detach the set of dnodes dirtied since the last fsync of @ino and install
+ * an empty one that collects what gets dirtied from now on. NULL means that
+ * nothing is known about the dirty nodes of @ino.
+ */
+static struct fsync_dnode_set *grab_fsync_dnode_set(struct f2fs_sb_info *sbi,
+								nid_t ino)
+{
+	struct f2fs_nm_info *nm_i = NM_I(sbi);
+	struct fsync_dnode_set *old, *new;
+
+	new = kmem_cache_alloc(fsync_dnode_slab, GFP_NOFS);
+	if (new) {
+		new->ino = ino;
+		new->overflow = false;
+		new->cnt = 0;
+	}
+
+	spin_lock(&nm_i->fsync_dnode_lock);
+	old = radix_tree_delete(&nm_i->fsync_dnode_root, ino);
+	if (new && radix_tree_insert(&nm_i->fsync_dnode_root, ino, new)) {
+		kmem_cache_free(fsync_dnode_slab, new);
+		new = NULL;
+	}
+	spin_unlock(&nm_i->fsync_dnode_lock);
+	return old;
+}
+
+void remove_fsync_dnode_set(struct f2fs_sb_info *sbi, nid_t ino)
+{
+	struct f2fs_nm_info *nm_i = NM_I(sbi);
+	struct fsync_dnode_set *set;
+
+	spin_lock(&nm_i->fsync_dnode_lock);
+	set = radix_tree_delete(&nm_i->fsync_dnode_root, ino);
+	spin_unlock(&nm_i->fsync_dnode_lock);
+	if (set)
+		kmem_cache_free(fsync_dnode_slab, set);
+}
+
+static int fsync_tracked_dnodes(struct f2fs_sb_info *sbi, struct inode *inode,
+		struct writeback_control *wbc, struct fsync_dnode_set *set)
+{
+	nid_t ino = inode->i_ino;
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < set->cnt; i++) {
+		struct page *page;
+
+		if (unlikely(f2fs_cp_error(sbi)))
+			return -EIO;
+
+		page = find_get_page(NODE_MAPPING(sbi), set->nids[i]);
+		if (!page)
+			continue;
+
+		lock_page(page);
+
+		/* truncated, written by someone else or reused by other inode */
+		if (unlikely(page->mapping != NODE_MAPPING(sbi)) ||
+				!PageDirty(page) || !IS_DNODE(page) ||
+				!is_cold_node(page) || ino_of_node(page) != ino) {
+			f2fs_put_page(page, 1);
+			continue;
+		}
+
+		f2fs_wait_on_page_writeback(page, NODE, true);
+		BUG_ON(PageWriteback(page));
+
+		set_fsync_mark(page, 1);
+		if (IS_INODE(page)) {
+			if (is_inode_flag_set(inode, FI_DIRTY_INODE))
+				update_inode(inode, page);
+			set_dentry_mark(page, need_dentry_mark(sbi, ino));
+		}
+
+		if (!clear_page_dirty_for_io(page)) {
+			f2fs_put_page(page, 1);
+			continue;
+		}
+
+		ret = NODE_MAPPING(sbi)->a_ops->writepage(page, wbc);
+		if (ret) {
+			f2fs_put_page(page, 1);
+			break;
+		}
+		f2fs_put_page(page, 0);
+	}
+	return ret ? -EIO : 0;
+}
+
 int fsync_node_pages(struct f2fs_sb_info *sbi, struct inode *inode,
 			struct writeback_control *wbc, bool atomic)
 {
@@ -1335,6 +1458,18 @@ int fsync_node_pages(struct f2fs_sb_info *sbi, struct inode *inode,
 		last_page = last_fsync_dnode(sbi, ino);
 		if (IS_ERR_OR_NULL(last_page))
 			return PTR_ERR_OR_ZERO(last_page);
+	} else {
+		struct fsync_dnode_set *set = grab_fsync_dnode_set(sbi, ino);
+
+		if (set && !set->overflow) {
+			ret = fsync_tracked_dnodes(sbi, inode, wbc, set);
+			kmem_cache_free(fsync_dnode_slab, set);
+			stat_inc_fsync_tracked(sbi);
+			return ret;
+		}
+		if (set)
+			kmem_cache_free(fsync_dnode_slab, set);
+		stat_inc_fsync_scanned(sbi);
 	}
 retry:
 	pagevec_init(&pvec, 0);
@@ -1669,6 +1804,8 @@ static int f2fs_set_node_page_dirty(struct page *page)
 	if (!PageUptodate(page))
 		SetPageUptodate(page);
 	if (!PageDirty(page)) {
+		/* record it before the dirty bit can be seen by fsync */
+		track_fsync_dnode(F2FS_P_SB(page), page);
 		f2fs_set_page_dirty_nobuffers(page);
 		inc_page_count(F2FS_P_SB(page), F2FS_DIRTY_NODES);
 		SetPagePrivate(page);
@@ -2281,9 +2418,11 @@ static int init_node_manager(struct f2fs_sb_info *sbi)
 	INIT_RADIX_TREE(&nm_i->nat_root, GFP_NOIO);
 	INIT_RADIX_TREE(&nm_i->nat_set_root, GFP_NOIO);
 	INIT_LIST_HEAD(&nm_i->nat_entries);
+	INIT_RADIX_TREE(&nm_i->fsync_dnode_root, GFP_ATOMIC);
 
 	mutex_init(&nm_i->build_lock);
 	spin_lock_init(&nm_i->free_nid_list_lock);
+	spin_lock_init(&nm_i->fsync_dnode_lock);
 	init_rwsem(&nm_i->nat_tree_lock);
 
 	nm_i->next_scan_nid = le32_to_cpu(sbi->ckpt->next_free_nid);
@@ -2321,12 +2460,27 @@ void destroy_node_manager(struct f2fs_sb_info *sbi)
 	struct free_nid *i, *next_i;
 	struct nat_entry *natvec[NATVEC_SIZE];
 	struct nat_entry_set *setvec[SETVEC_SIZE];
+	struct fsync_dnode_set *fsyncvec[SETVEC_SIZE];
 	nid_t nid = 0;
 	unsigned int found;
 
 	if (!nm_i)
 		return;
 
+	/* destroy fsync dnode sets */
+	spin_lock(&nm_i->fsync_dnode_lock);
+	while ((found = radix_tree_gang_lookup(&nm_i->fsync_dnode_root,
+				(void **)fsyncvec, 0, SETVEC_SIZE))) {
+		unsigned idx;
+
+		for (idx = 0; idx < found; idx++) {
+			radix_tree_delete(&nm_i->fsync_dnode_root,
+						fsyncvec[idx]->ino);
+			kmem_cache_free(fsync_dnode_slab, fsyncvec[idx]);
+		}
+	}
+	spin_unlock(&nm_i->fsync_dnode_lock);
+
 	/* destroy free nid list */
 	spin_lock(&nm_i->free_nid_list_lock);
 	list_for_each_entry_safe(i, next_i, &nm_i->free_nid_list, list) {
@@ -2389,8 +2543,15 @@ int __init create_node_manager_caches(void)
 			sizeof(struct nat_entry_set));
 	if (!nat_entry_set_slab)
 		goto destroy_free_nid;
+
+	fsync_dnode_slab = f2fs_kmem_cache_create("fsync_dnode_set",
+			sizeof(struct fsync_dnode_set));
+	if (!fsync_dnode_slab)
+		goto destroy_nat_entry_set;
 	return 0;
 
+destroy_nat_entry_set:
+	kmem_cache_destroy(nat_entry_set_slab);
 destroy_free_nid:
 	kmem_cache_destroy(free_nid_slab);
 destroy_nat_entry:
@@ -2401,6 +2562,7 @@ fail:
 
 void destroy_node_manager_caches(void)
 {
+	kmem_cache_destroy(fsync_dnode_slab);
 	kmem_cache_destroy(nat_entry_set_slab);
 	kmem_cache_destroy(free_nid_slab);
 	kmem_cache_destroy(nat_entry_slab);
@@ -150,6 +150,21 @@ struct nat_entry_set {
 	unsigned int entry_cnt;		/* the # of nat entries in set */
 };
 
+/*
+ * Direct node pages of one inode that became dirty since its last fsync.
+ * fsync writes exactly these instead of scanning every dirty node page;
+ * once more than FSYNC_DNODE_NIDS pages are dirtied, overflow is set and
+ * the next fsync falls back to the full scan.
+ */
+#define FSYNC_DNODE_NIDS	32
+
+struct fsync_dnode_set {
+	nid_t ino;			/* owner inode */
+	bool overflow;			/* nids[] is incomplete */
+	unsigned int cnt;		/* the # of valid nids */
+	nid_t nids[FSYNC_DNODE_NIDS];	/* dirtied direct nodes */
+};
+
 /*
  * For free nid mangement
  */
@@ -64,6 +64,9 @@ struct fuse_req *fuse_request_alloc_nofs(void)
 
 void fuse_request_free(struct fuse_req *req)
 {
+	/* an open reply nobody picked up */
+	if (req->passthrough_filp)
+		fput(req->passthrough_filp);
 	kmem_cache_free(fuse_req_cachep, req);
 }
 
@@ -1788,6 +1791,8 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 		req->out.h.error = kern_path((char *)req->out.args[0].value, 0,
 							req->canonical_path);
 	}
+	if (!err && fc->passthrough)
+		fuse_passthrough_setup(fc, req);
 	fuse_copy_finish(cs);
 
 	spin_lock(&fc->lock);
@@ -15,11 +15,13 @@
 #include <linux/module.h>
 #include <linux/compat.h>
 #include <linux/swap.h>
+#include <linux/file.h>
 
 static const struct file_operations fuse_direct_io_file_operations;
 
 static int fuse_send_open(struct fuse_conn *fc, u64 nodeid, struct file *file,
-			  int opcode, struct fuse_open_out *outargp)
+			  int opcode, struct fuse_open_out *outargp,
+			  struct fuse_file *ff)
 {
 	struct fuse_open_in inarg;
 	struct fuse_req *req;
@@ -43,6 +45,8 @@ static int fuse_send_open(struct fuse_conn *fc, u64 nodeid, struct file *file,
 	req->out.args[0].value = outargp;
 	fuse_request_send(fc, req);
 	err = req->out.h.error;
+	if (!err)
+		fuse_passthrough_open(ff, req, file->f_flags);
 	fuse_put_request(fc, req);
 
 	return err;
@@ -64,6 +68,7 @@ struct fuse_file *fuse_file_alloc(struct fuse_conn *fc)
 	}
 
 	INIT_LIST_HEAD(&ff->write_entry);
+	ff->passthrough_filp = NULL;
 	atomic_set(&ff->count, 0);
 	RB_CLEAR_NODE(&ff->polled_node);
 	init_waitqueue_head(&ff->poll_wait);
@@ -77,6 +82,8 @@ struct fuse_file *fuse_file_alloc(struct fuse_conn *fc)
 
 void fuse_file_free(struct fuse_file *ff)
 {
+	if (ff->passthrough_filp)
+		fput(ff->passthrough_filp);
 	fuse_request_free(ff->reserved_req);
 	kfree(ff);
 }
@@ -133,6 +140,8 @@ static void fuse_file_put(struct fuse_file *ff, bool sync)
 			req->end = fuse_release_end;
 			fuse_request_send_background(ff->fc, req);
 		}
+		if (ff->passthrough_filp)
+			fput(ff->passthrough_filp);
 		kfree(ff);
 	}
 }
@@ -149,7 +158,7 @@ int fuse_do_open(struct fuse_conn *fc, u64 nodeid, struct file *file,
 	if (!ff)
 		return -ENOMEM;
 
-	err = fuse_send_open(fc, nodeid, file, opcode, &outarg);
+	err = fuse_send_open(fc, nodeid, file, opcode, &outarg, ff);
 	if (err) {
 		fuse_file_free(ff);
 		return err;
@@ -172,7 +181,7 @@ void fuse_finish_open(struct inode *inode, struct file *file)
 	struct fuse_file *ff = file->private_data;
 	struct fuse_conn *fc = get_fuse_conn(inode);
 
-	if (ff->open_flags & FOPEN_DIRECT_IO)
+	if ((ff->open_flags & FOPEN_DIRECT_IO) && !ff->passthrough_filp)
 		file->f_op = &fuse_direct_io_file_operations;
 	if (!(ff->open_flags & FOPEN_KEEP_CACHE))
 		invalidate_inode_pages2(inode->i_mapping);
@@ -742,6 +751,10 @@ static ssize_t fuse_file_aio_read(struct kiocb *iocb, const struct iovec *iov,
 				  unsigned long nr_segs, loff_t pos)
 {
 	struct inode *inode = iocb->ki_filp->f_mapping->host;
+	struct fuse_file *ff = iocb->ki_filp->private_data;
+
+	if (ff->passthrough_filp)
+		return fuse_passthrough_aio_read(iocb, iov, nr_segs, pos);
 
 	if (pos + iov_length(iov, nr_segs) > i_size_read(inode)) {
 		int err;
@@ -979,9 +992,13 @@ static ssize_t fuse_file_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	ssize_t err;
 	struct iov_iter i;
 	loff_t endbyte = 0;
+	struct fuse_file *ff = file->private_data;
 
 	WARN_ON(iocb->ki_pos != pos);
 
+	if (ff->passthrough_filp)
+		return fuse_passthrough_aio_write(iocb, iov, nr_segs, pos);
+
 	ocount = 0;
 	err = generic_segment_checks(iov, &nr_segs, &ocount, VERIFY_READ);
 	if (err)
@@ -1423,6 +1440,11 @@ static const struct vm_operations_struct fuse_file_vm_ops = {
 
 static int fuse_file_mmap(struct file *file, struct vm_area_struct *vma)
 {
+	struct fuse_file *ff = file->private_data;
+
+	if (ff->passthrough_filp)
+		return fuse_passthrough_mmap(file, vma);
+
 	if ((vma->vm_flags & VM_SHARED) && (vma->vm_flags & VM_MAYWRITE)) {
 		struct inode *inode = file->f_dentry->d_inode;
 		struct fuse_conn *fc = get_fuse_conn(inode);
@@ -26,6 +26,8 @@
 /** Max number of pages that can be used in a single read request */
 #define FUSE_MAX_PAGES_PER_REQ 32
 
+#define FUSE_SUPER_MAGIC 0x65735546
+
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
 
@@ -150,6 +152,9 @@ struct fuse_file {
 
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+	/** Lower file for FOPEN_PASSTHROUGH opens, NULL otherwise */
+	struct file *passthrough_filp;
 };
 
 /** One input argument of a request */
@@ -317,6 +322,9 @@ struct fuse_req {
 	/** Path used for completing d_canonical_path */
 	struct path *canonical_path;
 
+	/** Lower file resolved while the open reply was written */
+	struct file *passthrough_filp;
+
 	/** Link on fi->writepages */
 	struct list_head writepages_entry;
 
@@ -493,6 +501,9 @@ struct fuse_conn {
 	/** Are BSD file locking primitives not implemented by fs? */
 	unsigned no_flock:1;
 
+	/** May open replies hand over a lower file? */
+	unsigned passthrough:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -793,4 +804,14 @@ int fuse_dev_release(struct inode *inode, struct file *file);
 
 void fuse_write_update_size(struct inode *inode, loff_t pos);
 
+/* passthrough.c */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req);
+void fuse_passthrough_open(struct fuse_file *ff, struct fuse_req *req,
+			   int flags);
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
@@ -0,0 +1,176 @@
+/*
+  FUSE: Filesystem in Userspace
+  Passthrough of read, write and mmap to a lower file
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+/*
+ * Passthrough lets the filesystem answer an OPEN or CREATE with a file it
+ * has open itself.  read, write and mmap of the FUSE file then go straight
+ * to that lower file without a round trip through userspace.  The lower
+ * file is accessed with the credentials it was opened with, i.e. those of
+ * the daemon.  Passthrough files bypass the FUSE page cache; the daemon is
+ * responsible for not mixing them with regular opens it cares about.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/fsnotify.h>
+#include <linux/cred.h>
+#include <linux/uio.h>
+
+/*
+ * Called while the daemon writes the reply, so that passthrough_fd is
+ * looked up in the daemon's file table.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct file *filp;
+	struct inode *inode;
+
+	if (req->in.h.opcode == FUSE_OPEN)
+		outarg = req->out.args[0].value;
+	else if (req->in.h.opcode == FUSE_CREATE)
+		outarg = req->out.args[1].value;
+	else
+		return;
+
+	if (req->out.h.error || !(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+
+	filp = fget(outarg->passthrough_fd);
+	if (!filp)
+		return;
+
+	inode = filp->f_path.dentry->d_inode;
+	if (!S_ISREG(inode->i_mode) ||
+	    inode->i_sb->s_magic == FUSE_SUPER_MAGIC ||
+	    !filp->f_op || !filp->f_op->aio_read || !filp->f_op->aio_write) {
+		fput(filp);
+		return;
+	}
+	req->passthrough_filp = filp;
+}
+
+/*
+ * Move the lower file of a finished open request over to the FUSE file.
+ * It is dropped if it was opened for less than the FUSE file needs.
+ */
+void fuse_passthrough_open(struct fuse_file *ff, struct fuse_req *req,
+			   int flags)
+{
+	struct file *filp = req->passthrough_filp;
+
+	if (!filp)
+		return;
+	req->passthrough_filp = NULL;
+
+	if (((flags & O_ACCMODE) != O_WRONLY && !(filp->f_mode & FMODE_READ)) ||
+	    ((flags & O_ACCMODE) != O_RDONLY && !(filp->f_mode & FMODE_WRITE))) {
+		fput(filp);
+		return;
+	}
+	ff->passthrough_filp = filp;
+}
+
+static ssize_t fuse_passthrough_rw(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos, int rw)
+{
+	struct fuse_file *ff = iocb->ki_filp->private_data;
+	struct file *lower = ff->passthrough_filp;
+	size_t len = iov_length(iov, nr_segs);
+	const struct cred *old_cred;
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	init_sync_kiocb(&kiocb, lower);
+	kiocb.ki_pos = pos;
+	kiocb.ki_left = len;
+	kiocb.ki_nbytes = len;
+
+	old_cred = override_creds(lower->f_cred);
+	if (rw == WRITE)
+		ret = lower->f_op->aio_write(&kiocb, iov, nr_segs, pos);
+	else
+		ret = lower->f_op->aio_read(&kiocb, iov, nr_segs, pos);
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+	revert_creds(old_cred);
+
+	if (ret > 0) {
+		if (rw == WRITE)
+			fsnotify_modify(lower);
+		else
+			fsnotify_access(lower);
+	}
+	iocb->ki_pos = kiocb.ki_pos;
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_rw(iocb, iov, nr_segs, pos, READ);
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct inode *inode = file->f_mapping->host;
+	struct inode *lower_inode = ff->passthrough_filp->f_mapping->host;
+	ssize_t ret;
+
+	mutex_lock(&inode->i_mutex);
+	if (file->f_flags & O_APPEND)
+		pos = i_size_read(lower_inode);
+
+	ret = fuse_passthrough_rw(iocb, iov, nr_segs, pos, WRITE);
+	if (ret > 0) {
+		fuse_write_update_size(inode, iocb->ki_pos);
+		/* regular opens of the same inode must not see stale data */
+		if (inode->i_mapping->nrpages)
+			invalidate_inode_pages2_range(inode->i_mapping,
+					pos >> PAGE_CACHE_SHIFT,
+					(iocb->ki_pos - 1) >> PAGE_CACHE_SHIFT);
+	}
+	fuse_invalidate_attr(inode);
+	mutex_unlock(&inode->i_mutex);
+
+	return ret;
+}
+
+/*
+ * Hand the mapping to the lower file: the vma keeps a reference to it
+ * instead of the FUSE file, so faults never reach the FUSE address space.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	const struct cred *old_cred;
+	int ret;
+
+	if (!lower->f_op->mmap)
+		return -ENODEV;
+
+	get_file(lower);
+	vma->vm_file = lower;
+
+	old_cred = override_creds(lower->f_cred);
+	ret = lower->f_op->mmap(lower, vma);
+	revert_creds(old_cred);
+
+	if (ret) {
+		vma->vm_file = file;
+		fput(lower);
+	} else {
+		fput(file);
+	}
+	return ret;
+}
@@ -174,9 +174,24 @@ static int ovl_set_mode(struct dentry *upperdentry, umode_t mode)
 	return notify_change(upperdentry, &attr);
 }
 
+static int ovl_set_size(struct dentry *upperdentry, loff_t size)
+{
+	struct iattr attr = {
+		.ia_valid = ATTR_SIZE,
+		.ia_size = size,
+	};
+
+	return notify_change(upperdentry, &attr);
+}
+
+/*
+ * With @metaonly the upper file is created with the size of the lower one
+ * but without its data, and marked so that reads go to the lower file
+ * until ovl_copy_up_data_deferred() copies the data.
+ */
 static int ovl_copy_up_locked(struct dentry *upperdir, struct dentry *dentry,
 			      struct path *lowerpath, struct kstat *stat,
-			      const char *link)
+			      const char *link, bool metaonly)
 {
 	int err;
 	struct path newpath;
@@ -191,18 +206,23 @@ static int ovl_copy_up_locked(struct dentry *upperdir, struct dentry *dentry,
 	if (IS_ERR(newpath.dentry))
 		return PTR_ERR(newpath.dentry);
 
-	if (S_ISREG(stat->mode)) {
+	err = 0;
+	if (metaonly)
+		err = vfs_setxattr(newpath.dentry, ovl_metacopy_xattr,
+				   "y", 1, 0);
+	else if (S_ISREG(stat->mode))
 		err = ovl_copy_up_data(lowerpath, &newpath, stat->size);
-		if (err)
-			goto err_remove;
-	}
+	if (err)
+		goto err_remove;
 
 	err = ovl_copy_up_xattr(lowerpath->dentry, newpath.dentry);
 	if (err)
 		goto err_remove;
 
 	mutex_lock(&newpath.dentry->d_inode->i_mutex);
-	if (!S_ISLNK(stat->mode))
+	if (metaonly)
+		err = ovl_set_size(newpath.dentry, stat->size);
+	if (!err && !S_ISLNK(stat->mode))
 		err = ovl_set_mode(newpath.dentry, mode);
 	if (!err)
 		err = ovl_set_timestamps(newpath.dentry, stat);
@@ -210,6 +230,10 @@ static int ovl_copy_up_locked(struct dentry *upperdir, struct dentry *dentry,
 	if (err)
 		goto err_remove;
 
+	if (metaonly) {
+		ovl_dentry_set_metacopy(dentry, true);
+		ovl_metacopy_account(stat->size);
+	}
 	ovl_dentry_update(dentry, newpath.dentry);
 
 	/*
@@ -249,7 +273,8 @@ err_remove:
  * that point the file will have already been copied up anyway.
  */
 static int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
-			   struct path *lowerpath, struct kstat *stat)
+			   struct path *lowerpath, struct kstat *stat,
+			   bool metaonly)
 {
 	int err;
 	struct kstat pstat;
@@ -262,6 +287,10 @@ static int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 	ovl_path_upper(parent, &parentpath);
 	upperdir = parentpath.dentry;
 
+	/* nothing to gain for an empty file */
+	if (!S_ISREG(stat->mode) || !stat->size)
+		metaonly = false;
+
 	err = vfs_getattr(parentpath.mnt, parentpath.dentry, &pstat);
 	if (err)
 		return err;
@@ -298,7 +327,7 @@ static int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 		err = 0;
 	} else {
 		err = ovl_copy_up_locked(upperdir, dentry, lowerpath,
-					 stat, link);
+					 stat, link, metaonly);
 		if (!err) {
 			/* Restore timestamps on parent (best effort) */
 			ovl_set_timestamps(upperdir, &pstat);
@@ -317,7 +346,7 @@ out_free_link:
 	return err;
 }
 
-int ovl_copy_up(struct dentry *dentry)
+static int __ovl_copy_up(struct dentry *dentry, bool metaonly)
 {
 	int err;
 
@@ -348,7 +377,8 @@ int ovl_copy_up(struct dentry *dentry)
 		ovl_path_lower(next, &lowerpath);
 		err = vfs_getattr(lowerpath.mnt, lowerpath.dentry, &stat);
 		if (!err)
-			err = ovl_copy_up_one(parent, next, &lowerpath, &stat);
+			err = ovl_copy_up_one(parent, next, &lowerpath, &stat,
+					      metaonly && next == dentry);
 
 		dput(parent);
 		dput(next);
@@ -357,6 +387,101 @@ int ovl_copy_up(struct dentry *dentry)
 	return err;
 }
 
+/* Copy up @dentry and its ancestors, including the data of @dentry */
+int ovl_copy_up(struct dentry *dentry)
+{
+	int err;
+
+	err = __ovl_copy_up(dentry, false);
+	if (!err && ovl_dentry_is_metacopy(dentry))
+		err = ovl_copy_up_data_deferred(dentry, LLONG_MAX);
+
+	return err;
+}
+
+/*
+ * Copy up for a change of metadata only (mode, owner, times, xattrs):
+ * if the filesystem allows it, the data of a regular file stays in the
+ * lower layer until it is opened for write or truncated.
+ */
+int ovl_copy_up_meta(struct dentry *dentry)
+{
+	return __ovl_copy_up(dentry, ovl_want_metacopy(dentry));
+}
+
+/*
+ * Copy the first @size bytes of data of a file that had a metadata only
+ * copy up, and drop the mark. The rest of the upper file is left
+ * as a hole, for a truncate to @size to cut off.
+ */
+int ovl_copy_up_data_deferred(struct dentry *dentry, loff_t size)
+{
+	int err;
+	struct dentry *parent;
+	struct path parentpath, lowerpath, upperpath;
+	struct kstat stat, ustat;
+	const struct cred *old_cred;
+	struct cred *override_cred;
+
+	if (!ovl_dentry_is_metacopy(dentry))
+		return 0;
+
+	parent = dget_parent(dentry);
+	ovl_path_upper(parent, &parentpath);
+	ovl_path_lower(dentry, &lowerpath);
+	ovl_path_upper(dentry, &upperpath);
+
+	err = vfs_getattr(lowerpath.mnt, lowerpath.dentry, &stat);
+	if (!err)
+		err = vfs_getattr(upperpath.mnt, upperpath.dentry, &ustat);
+	if (err)
+		goto out_dput_parent;
+
+	err = -ENOMEM;
+	override_cred = prepare_creds();
+	if (!override_cred)
+		goto out_dput_parent;
+
+	/*
+	 * CAP_SYS_ADMIN for the private xattr
+	 * CAP_DAC_OVERRIDE for opening the upper file for write
+	 * CAP_FOWNER for restoring the timestamps
+	 */
+	cap_raise(override_cred->cap_effective, CAP_SYS_ADMIN);
+	cap_raise(override_cred->cap_effective, CAP_DAC_OVERRIDE);
+	cap_raise(override_cred->cap_effective, CAP_FOWNER);
+	old_cred = override_creds(override_cred);
+
+	/* exclusion against other copy ups, see ovl_copy_up_one() */
+	mutex_lock_nested(&parentpath.dentry->d_inode->i_mutex,
+			  I_MUTEX_PARENT);
+	err = 0;
+	/* another dentry of the same file may have done it already */
+	if (ovl_dentry_is_metacopy(dentry) &&
+	    ovl_is_metacopy(upperpath.dentry)) {
+		err = ovl_copy_up_data(&lowerpath, &upperpath,
+				       min(size, stat.size));
+		if (!err)
+			err = vfs_removexattr(upperpath.dentry,
+					      ovl_metacopy_xattr);
+		if (!err) {
+			ovl_metacopy_account(-stat.size);
+			mutex_lock(&upperpath.dentry->d_inode->i_mutex);
+			ovl_set_timestamps(upperpath.dentry, &ustat);
+			mutex_unlock(&upperpath.dentry->d_inode->i_mutex);
+		}
+	}
+	if (!err)
+		ovl_dentry_set_metacopy(dentry, false);
+	mutex_unlock(&parentpath.dentry->d_inode->i_mutex);
+
+	revert_creds(old_cred);
+	put_cred(override_cred);
+out_dput_parent:
+	dput(parent);
+	return err;
+}
+
 /* Optimize by not copying up the file first and truncating later */
 int ovl_copy_up_truncate(struct dentry *dentry, loff_t size)
 {
@@ -377,7 +502,7 @@ int ovl_copy_up_truncate(struct dentry *dentry, loff_t size)
 	if (size < stat.size)
 		stat.size = size;
 
-	err = ovl_copy_up_one(parent, dentry, &lowerpath, &stat);
+	err = ovl_copy_up_one(parent, dentry, &lowerpath, &stat, false);
 
 out_dput_parent:
 	dput(parent);
@@ -17,10 +17,12 @@ int ovl_setattr(struct dentry *dentry, struct iattr *attr)
 	struct dentry *upperdentry;
 	int err;
 
-	if ((attr->ia_valid & ATTR_SIZE) && !ovl_dentry_upper(dentry))
+	if (!(attr->ia_valid & ATTR_SIZE))
+		err = ovl_copy_up_meta(dentry);
+	else if (!ovl_dentry_upper(dentry))
 		err = ovl_copy_up_truncate(dentry, attr->ia_size);
 	else
-		err = ovl_copy_up(dentry);
+		err = ovl_copy_up_data_deferred(dentry, attr->ia_size);
 	if (err)
 		return err;
 
@@ -196,7 +198,7 @@ int ovl_setxattr(struct dentry *dentry, const char *name,
 	if (ovl_is_private_xattr(name))
 		return -EPERM;
 
-	err = ovl_copy_up(dentry);
+	err = ovl_copy_up_meta(dentry);
 	if (err)
 		return err;
 
@@ -260,7 +262,7 @@ int ovl_removexattr(struct dentry *dentry, const char *name)
 		if (err < 0)
 			return err;
 
-		err = ovl_copy_up(dentry);
+		err = ovl_copy_up_meta(dentry);
 		if (err)
 			return err;
 
@@ -288,7 +290,7 @@ static bool ovl_open_need_copy_up(int flags, enum ovl_path_type type,
 static struct file *ovl_open(struct dentry *dentry, struct file *file,
 			     const struct cred *cred)
 {
-	int err;
+	int err = 0;
 	struct path realpath;
 	enum ovl_path_type type;
 
@@ -302,6 +304,16 @@ static struct file *ovl_open(struct dentry *dentry, struct file *file,
 			return ERR_PTR(err);
 
 		ovl_path_upper(dentry, &realpath);
+	} else if (ovl_dentry_is_metacopy(dentry)) {
+		/* writers need the data, readers can have the lower file */
+		if (file->f_flags & O_TRUNC)
+			err = ovl_copy_up_data_deferred(dentry, 0);
+		else if (OPEN_FMODE(file->f_flags) & FMODE_WRITE)
+			err = ovl_copy_up_data_deferred(dentry, LLONG_MAX);
+		else
+			ovl_path_lower(dentry, &realpath);
+		if (err)
+			return ERR_PTR(err);
 	}
 
 	return vfs_open(&realpath, file, cred);
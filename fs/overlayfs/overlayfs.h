@@ -17,6 +17,7 @@ enum ovl_path_type {
 
 extern const char *ovl_opaque_xattr;
 extern const char *ovl_whiteout_xattr;
+extern const char *ovl_metacopy_xattr;
 extern const struct dentry_operations ovl_dentry_operations;
 
 enum ovl_path_type ovl_path_type(struct dentry *dentry);
@@ -31,7 +32,12 @@ struct dentry *ovl_dentry_real(struct dentry *dentry);
 struct dentry *ovl_entry_real(struct ovl_entry *oe, bool *is_upper);
 bool ovl_dentry_is_opaque(struct dentry *dentry);
 void ovl_dentry_set_opaque(struct dentry *dentry, bool opaque);
+bool ovl_dentry_is_metacopy(struct dentry *dentry);
+void ovl_dentry_set_metacopy(struct dentry *dentry, bool metacopy);
+bool ovl_want_metacopy(struct dentry *dentry);
+void ovl_metacopy_account(loff_t bytes);
 bool ovl_is_whiteout(struct dentry *dentry);
+bool ovl_is_metacopy(struct dentry *dentry);
 void ovl_dentry_update(struct dentry *dentry, struct dentry *upperdentry);
 struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 			  struct nameidata *nd);
@@ -61,4 +67,6 @@ extern const struct inode_operations ovl_dir_inode_operations;
 
 /* copy_up.c */
 int ovl_copy_up(struct dentry *dentry);
+int ovl_copy_up_meta(struct dentry *dentry);
+int ovl_copy_up_data_deferred(struct dentry *dentry, loff_t size);
 int ovl_copy_up_truncate(struct dentry *dentry, loff_t size);
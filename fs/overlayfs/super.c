@@ -27,6 +27,7 @@ MODULE_LICENSE("GPL");
 struct ovl_config {
 	char *lowerdir;
 	char *upperdir;
+	bool metacopy;
 };
 
 /* private information held for overlayfs's superblock */
@@ -49,6 +50,8 @@ struct ovl_entry {
 		struct {
 			u64 version;
 			bool opaque;
+			/* upper holds metadata only, data still in lower */
+			bool metacopy;
 		};
 		struct rcu_head rcu;
 	};
@@ -56,6 +59,30 @@ struct ovl_entry {
 
 const char *ovl_whiteout_xattr = "trusted.overlay.whiteout";
 const char *ovl_opaque_xattr = "trusted.overlay.opaque";
+const char *ovl_metacopy_xattr = "trusted.overlay.metacopy";
+
+/*
+ * Size of the lower files whose copy up is currently limited to their
+ * metadata, i.e. the data that didn't have to be copied (yet).
+ */
+static atomic64_t ovl_metacopy_bytes = ATOMIC64_INIT(0);
+
+static int ovl_metacopy_bytes_get(char *buffer, const struct kernel_param *kp)
+{
+	return sprintf(buffer, "%lld", atomic64_read(&ovl_metacopy_bytes));
+}
+
+static struct kernel_param_ops ovl_metacopy_bytes_ops = {
+	.get = ovl_metacopy_bytes_get,
+};
+module_param_cb(metacopy_bytes_saved, &ovl_metacopy_bytes_ops, NULL, 0444);
+MODULE_PARM_DESC(metacopy_bytes_saved,
+		 "Lower file data not copied up thanks to metadata only copy up");
+
+void ovl_metacopy_account(loff_t bytes)
+{
+	atomic64_add(bytes, &ovl_metacopy_bytes);
+}
 
 
 enum ovl_path_type ovl_path_type(struct dentry *dentry)
@@ -162,6 +189,24 @@ void ovl_dentry_set_opaque(struct dentry *dentry, bool opaque)
 	oe->opaque = opaque;
 }
 
+bool ovl_dentry_is_metacopy(struct dentry *dentry)
+{
+	struct ovl_entry *oe = dentry->d_fsdata;
+	return oe->metacopy;
+}
+
+void ovl_dentry_set_metacopy(struct dentry *dentry, bool metacopy)
+{
+	struct ovl_entry *oe = dentry->d_fsdata;
+	oe->metacopy = metacopy;
+}
+
+bool ovl_want_metacopy(struct dentry *dentry)
+{
+	struct ovl_fs *ofs = dentry->d_sb->s_fs_info;
+	return ofs->config.metacopy;
+}
+
 void ovl_dentry_update(struct dentry *dentry, struct dentry *upperdentry)
 {
 	struct ovl_entry *oe = dentry->d_fsdata;
@@ -223,6 +268,21 @@ static bool ovl_is_opaquedir(struct dentry *dentry)
 	return false;
 }
 
+bool ovl_is_metacopy(struct dentry *dentry)
+{
+	int res;
+	char val;
+
+	if (!S_ISREG(dentry->d_inode->i_mode))
+		return false;
+
+	res = vfs_getxattr(dentry, ovl_metacopy_xattr, &val, 1);
+	if (res == 1 && val == 'y')
+		return true;
+
+	return false;
+}
+
 static void ovl_entry_free(struct rcu_head *head)
 {
 	struct ovl_entry *oe = container_of(head, struct ovl_entry, rcu);
@@ -295,7 +355,8 @@ static int ovl_do_lookup(struct dentry *dentry)
 
 		if (lowerdir && upperdentry &&
 		    (S_ISLNK(upperdentry->d_inode->i_mode) ||
-		     S_ISDIR(upperdentry->d_inode->i_mode))) {
+		     S_ISDIR(upperdentry->d_inode->i_mode) ||
+		     S_ISREG(upperdentry->d_inode->i_mode))) {
 			const struct cred *old_cred;
 			struct cred *override_cred;
 
@@ -314,6 +375,8 @@ static int ovl_do_lookup(struct dentry *dentry)
 				dput(upperdentry);
 				upperdentry = NULL;
 				oe->opaque = true;
+			} else if (ovl_is_metacopy(upperdentry)) {
+				oe->metacopy = true;
 			}
 			revert_creds(old_cred);
 			put_cred(override_cred);
@@ -326,7 +389,16 @@ static int ovl_do_lookup(struct dentry *dentry)
 			goto out_dput_upper;
 	}
 
-	if (lowerdentry && upperdentry &&
+	/* the data of a metadata only copy up is in the lower file */
+	if (oe->metacopy &&
+	    (!lowerdentry || !S_ISREG(lowerdentry->d_inode->i_mode))) {
+		printk(KERN_WARNING "overlayfs: lower data of %s missing\n",
+		       dentry->d_name.name);
+		err = -EIO;
+		goto out_dput;
+	}
+
+	if (lowerdentry && upperdentry && !oe->metacopy &&
 	    (!S_ISDIR(upperdentry->d_inode->i_mode) ||
 	     !S_ISDIR(lowerdentry->d_inode->i_mode))) {
 		dput(lowerdentry);
@@ -450,6 +522,8 @@ static int ovl_show_options(struct seq_file *m, struct dentry *dentry)
 
 	seq_printf(m, ",lowerdir=%s", ufs->config.lowerdir);
 	seq_printf(m, ",upperdir=%s", ufs->config.upperdir);
+	if (ufs->config.metacopy)
+		seq_puts(m, ",metacopy");
 	return 0;
 }
 
@@ -463,12 +537,14 @@ static const struct super_operations ovl_super_operations = {
 enum {
 	Opt_lowerdir,
 	Opt_upperdir,
+	Opt_metacopy,
 	Opt_err,
 };
 
 static const match_table_t ovl_tokens = {
 	{Opt_lowerdir,			"lowerdir=%s"},
 	{Opt_upperdir,			"upperdir=%s"},
+	{Opt_metacopy,			"metacopy"},
 	{Opt_err,			NULL}
 };
 
@@ -478,6 +554,7 @@ static int ovl_parse_opt(char *opt, struct ovl_config *config)
 
 	config->upperdir = NULL;
 	config->lowerdir = NULL;
+	config->metacopy = false;
 
 	while ((p = strsep(&opt, ",")) != NULL) {
 		int token;
@@ -502,6 +579,10 @@ static int ovl_parse_opt(char *opt, struct ovl_config *config)
 				return -ENOMEM;
 			break;
 
+		case Opt_metacopy:
+			config->metacopy = true;
+			break;
+
 		default:
 			return -EINVAL;
 		}
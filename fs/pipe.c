@@ -42,6 +42,15 @@ unsigned int pipe_min_size = PAGE_SIZE;
 unsigned long pipe_user_pages_hard;
 unsigned long pipe_user_pages_soft = PIPE_DEF_BUFFERS * INR_OPEN_CUR;
 
+/*
+ * A pipe that its writers fill PIPE_GROW_FILLS times within a second is
+ * doubled, up to PIPE_GROW_MAX_BUFFERS pages: a streaming writer then
+ * runs further ahead of its reader instead of waking it, and being woken
+ * back, for every 64K. Pipes that are not busy keep the default size.
+ */
+#define PIPE_GROW_FILLS		8
+#define PIPE_GROW_MAX_BUFFERS	64
+
 /*
  * We use a start+len construction, which provides full use of the 
  * allocated memory.
@@ -647,6 +656,8 @@ redo2:
 		}
 		if (bufs < pipe->buffers)
 			continue;
+		if (pipe_grow_when_full(pipe))
+			continue;
 		if (filp->f_flags & O_NONBLOCK) {
 			if (!ret)
 				ret = -EAGAIN;
@@ -975,6 +986,7 @@ struct pipe_inode_info * alloc_pipe_info(struct inode *inode)
 		if (pipe->bufs) {
 			init_waitqueue_head(&pipe->wait);
 			pipe->r_counter = pipe->w_counter = 1;
+			pipe->fill_stamp = jiffies;
 			pipe->inode = inode;
 			pipe->buffers = pipe_bufs;
 			pipe->user = user;
@@ -1250,6 +1262,41 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long nr_pages)
 	return nr_pages * PAGE_SIZE;
 }
 
+/**
+ * pipe_grow_when_full - give a busy pipe more buffers
+ * @pipe:	the pipe, locked, which a writer found full
+ *
+ * Returns true if the pipe was grown and the writer can carry on
+ * instead of waiting for the reader.
+ */
+bool pipe_grow_when_full(struct pipe_inode_info *pipe)
+{
+	unsigned int nr_pages = pipe->buffers * 2;
+
+	if (!pipe->inode || pipe->size_fixed)
+		return false;
+
+	if (time_after(jiffies, pipe->fill_stamp + HZ)) {
+		pipe->fill_stamp = jiffies;
+		pipe->nr_fills = 0;
+	}
+	if (++pipe->nr_fills < PIPE_GROW_FILLS)
+		return false;
+
+	if (nr_pages > PIPE_GROW_MAX_BUFFERS ||
+	    nr_pages * PAGE_SIZE > pipe_max_size ||
+	    too_many_pipe_buffers_soft(pipe->user) ||
+	    too_many_pipe_buffers_hard(pipe->user))
+		return false;
+
+	if (pipe_set_size(pipe, nr_pages) < 0)
+		return false;
+
+	pipe->nr_fills = 0;
+	count_vm_event(PIPE_GROW);
+	return true;
+}
+
 /*
  * Currently we rely on the pipe array holding a power-of-2 number
  * of pages.
@@ -1323,6 +1370,8 @@ long pipe_fcntl(struct file *file, unsigned int cmd, unsigned long arg)
 			goto out;
 		}
 		ret = pipe_set_size(pipe, nr_pages);
+		if (ret > 0)
+			pipe->size_fixed = true;
 		break;
 		}
 	case F_GETPIPE_SZ:
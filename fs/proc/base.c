@@ -58,6 +58,7 @@
 #include <linux/capability.h>
 #include <linux/file.h>
 #include <linux/fdtable.h>
+#include <linux/eventpoll.h>
 #include <linux/string.h>
 #include <linux/seq_file.h>
 #include <linux/namei.h>
@@ -84,6 +85,7 @@
 #include <linux/fs_struct.h>
 #include <linux/slab.h>
 #include <linux/flex_array.h>
+#include <linux/ksm.h>
 #ifdef CONFIG_HARDWALL
 #include <asm/hardwall.h>
 #endif
@@ -341,6 +343,34 @@ static int proc_pid_stack(struct seq_file *m, struct pid_namespace *ns,
 }
 #endif
 
+#ifdef CONFIG_MSM_TASK_PMU
+/*
+ * Provides /proc/PID/task/TID/pmu; ipc and l2_mpki (misses per thousand
+ * instructions) with three decimals.
+ */
+static void show_ratio(struct seq_file *m, const char *name, u64 n, u64 d)
+{
+	u64 r = d ? div64_u64(n * 1000, d) : 0;
+	u32 frac;
+
+	frac = do_div(r, 1000);
+	seq_printf(m, "%s:\t%llu.%03u\n", name, r, frac);
+}
+
+static int proc_tid_pmu(struct seq_file *m, struct pid_namespace *ns,
+			struct pid *pid, struct task_struct *task)
+{
+	struct task_pmu_counts c = task->pmu_counts;
+
+	seq_printf(m, "cycles:\t\t%llu\ninstructions:\t%llu\n"
+		   "l2_misses:\t%llu\n",
+		   c.cycles, c.instructions, c.l2_misses);
+	show_ratio(m, "ipc\t", c.instructions, c.cycles);
+	show_ratio(m, "l2_mpki\t", c.l2_misses * 1000, c.instructions);
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 /*
  * Provides /proc/PID/schedstat
@@ -1306,6 +1336,57 @@ static const struct file_operations proc_pid_sched_operations = {
 
 #endif
 
+#ifdef CONFIG_SCHED_LATENCY
+/*
+ * Wakeup latency histogram of a task; any write clears it.
+ */
+static int sched_latency_show(struct seq_file *m, void *v)
+{
+	struct inode *inode = m->private;
+	struct task_struct *p;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+	proc_sched_latency_show_task(p, m);
+
+	put_task_struct(p);
+
+	return 0;
+}
+
+static ssize_t
+sched_latency_write(struct file *file, const char __user *buf,
+		    size_t count, loff_t *offset)
+{
+	struct inode *inode = file->f_path.dentry->d_inode;
+	struct task_struct *p;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+	proc_sched_latency_reset_task(p);
+
+	put_task_struct(p);
+
+	return count;
+}
+
+static int sched_latency_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, sched_latency_show, inode);
+}
+
+static const struct file_operations proc_pid_sched_latency_operations = {
+	.open		= sched_latency_open,
+	.read		= seq_read,
+	.write		= sched_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+#endif
+
 #ifdef CONFIG_SCHED_AUTOGROUP
 /*
  * Print out autogroup related information:
@@ -1766,7 +1847,7 @@ out:
 	return ~0U;
 }
 
-#define PROC_FDINFO_MAX 64
+#define PROC_FDINFO_MAX 320
 
 static int proc_fd_info(struct inode *inode, struct path *path, char *info)
 {
@@ -1799,12 +1880,25 @@ static int proc_fd_info(struct inode *inode, struct path *path, char *info)
 				*path = file->f_path;
 				path_get(&file->f_path);
 			}
-			if (info)
-				snprintf(info, PROC_FDINFO_MAX,
+			if (info) {
+				int len;
+
+				len = scnprintf(info, PROC_FDINFO_MAX,
 					 "pos:\t%lli\n"
-					 "flags:\t0%o\n",
+					 "flags:\t0%o\n"
+					 "ra_pattern:\t%d\n"
+					 "ra_pages:\t%u\n"
+					 "ra_hits:\t%u\n"
+					 "ra_misses:\t%u\n",
 					 (long long) file->f_pos,
-					 f_flags);
+					 f_flags,
+					 file->f_ra.mmap_score,
+					 file->f_ra.ra_submitted,
+					 file->f_ra.ra_hits,
+					 file->f_ra.ra_misses);
+				eventpoll_fdinfo(file, info + len,
+						 PROC_FDINFO_MAX - len);
+			}
 			spin_unlock(&files->file_lock);
 			put_files_struct(files);
 			return 0;
@@ -2967,6 +3061,23 @@ static int proc_tgid_io_accounting(struct task_struct *task, char *buffer)
 }
 #endif /* CONFIG_TASK_IO_ACCOUNTING */
 
+#ifdef CONFIG_KSM
+static int proc_pid_ksm_stat(struct seq_file *m, struct pid_namespace *ns,
+				struct pid *pid, struct task_struct *task)
+{
+	unsigned long scanned = 0, merged = 0;
+	struct mm_struct *mm = get_task_mm(task);
+
+	if (mm) {
+		ksm_mm_stat(mm, &scanned, &merged);
+		mmput(mm);
+	}
+	seq_printf(m, "pages_scanned %lu\npages_merged %lu\n",
+		   scanned, merged);
+	return 0;
+}
+#endif /* CONFIG_KSM */
+
 static int proc_pid_personality(struct seq_file *m, struct pid_namespace *ns,
 				struct pid *pid, struct task_struct *task)
 {
@@ -3003,6 +3114,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_SCHED_DEBUG
 	REG("sched",      S_IRUGO|S_IWUSR, proc_pid_sched_operations),
 #endif
+#ifdef CONFIG_SCHED_LATENCY
+	REG("sched_latency", S_IRUGO|S_IWUSR, proc_pid_sched_latency_operations),
+#endif
 #ifdef CONFIG_SCHED_AUTOGROUP
 	REG("autogroup",  S_IRUGO|S_IWUSR, proc_pid_sched_autogroup_operations),
 #endif
@@ -3027,8 +3141,15 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_PROC_PAGE_MONITOR
 	REG("clear_refs", S_IWUSR, proc_clear_refs_operations),
 	REG("smaps",      S_IRUGO, proc_pid_smaps_operations),
+	REG("smaps_rollup", S_IRUGO, proc_pid_smaps_rollup_operations),
 	REG("pagemap",    S_IRUGO, proc_pagemap_operations),
 #endif
+#ifdef CONFIG_PROCESS_RECLAIM
+	REG("reclaim",    S_IWUSR, proc_reclaim_operations),
+#endif
+#ifdef CONFIG_KSM
+	ONE("ksm_stat",   S_IRUGO, proc_pid_ksm_stat),
+#endif
 #ifdef CONFIG_SECURITY
 	DIR("attr",       S_IRUGO|S_IXUGO, proc_attr_dir_inode_operations, proc_attr_dir_operations),
 #endif
@@ -3364,6 +3485,9 @@ static const struct pid_entry tid_base_stuff[] = {
 	INF("limits",	 S_IRUGO, proc_pid_limits),
 #ifdef CONFIG_SCHED_DEBUG
 	REG("sched",     S_IRUGO|S_IWUSR, proc_pid_sched_operations),
+#endif
+#ifdef CONFIG_SCHED_LATENCY
+	REG("sched_latency", S_IRUGO|S_IWUSR, proc_pid_sched_latency_operations),
 #endif
 	REG("comm",      S_IRUGO|S_IWUSR, proc_pid_set_comm_operations),
 #ifdef CONFIG_HAVE_ARCH_TRACEHOOK
@@ -3399,6 +3523,9 @@ static const struct pid_entry tid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat", S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_MSM_TASK_PMU
+	ONE("pmu",       S_IRUGO, proc_tid_pmu),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
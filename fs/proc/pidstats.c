@@ -0,0 +1,191 @@
+/*
+ * /proc/pidstats - memory and cpu statistics of every process in one
+ * binary read, for the low memory killer daemon and monitors that would
+ * otherwise parse stat, statm, status and oom_score_adj of each process
+ * in turn. The layout is described in include/linux/pidstats.h.
+ */
+
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/oom.h>
+#include <linux/pid_namespace.h>
+#include <linux/pidstats.h>
+#include <linux/proc_fs.h>
+#include <linux/ptrace.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/vmstat.h>
+
+struct pidstats_buf {
+	size_t	size;
+	char	data[0];
+};
+
+/* room for processes forked between counting and filling the records */
+#define PIDSTATS_SLACK	32
+
+static const char pidstats_state_chars[] = "RSDTtZXxKW";
+
+static u8 pidstats_state(struct task_struct *p)
+{
+	unsigned int state = (p->state & TASK_REPORT) | p->exit_state;
+	int i = 0;
+
+	BUILD_BUG_ON(1 + ilog2(TASK_STATE_MAX) !=
+			sizeof(pidstats_state_chars) - 1);
+
+	while (state) {
+		i++;
+		state >>= 1;
+	}
+	return pidstats_state_chars[i];
+}
+
+/*
+ * Fill @r for the thread group led by @p. Called under rcu_read_lock();
+ * the only lock taken is task_lock() of the thread whose mm is read.
+ */
+static void pidstats_fill(struct pidstats_record *r, struct task_struct *p,
+			  struct pid_namespace *ns)
+{
+	struct signal_struct *sig = p->signal;
+	struct task_struct *t;
+	cputime_t utime, stime;
+	unsigned long min_flt, maj_flt;
+
+	r->pid = task_tgid_nr_ns(p, ns);
+	r->ppid = task_tgid_nr_ns(rcu_dereference(p->real_parent), ns);
+	r->uid = __task_cred(p)->uid;
+	r->nr_threads = get_nr_threads(p);
+	r->oom_score_adj = sig->oom_score_adj;
+	r->state = pidstats_state(p);
+
+	t = find_lock_task_mm(p);
+	if (t) {
+		r->rss_anon_kb = get_mm_counter(t->mm, MM_ANONPAGES)
+					<< (PAGE_SHIFT - 10);
+		r->rss_file_kb = get_mm_counter(t->mm, MM_FILEPAGES)
+					<< (PAGE_SHIFT - 10);
+		r->swap_kb = get_mm_counter(t->mm, MM_SWAPENTS)
+					<< (PAGE_SHIFT - 10);
+		task_unlock(t);
+	}
+
+	utime = sig->utime;
+	stime = sig->stime;
+	min_flt = sig->min_flt;
+	maj_flt = sig->maj_flt;
+	t = p;
+	do {
+		utime += t->utime;
+		stime += t->stime;
+		min_flt += t->min_flt;
+		maj_flt += t->maj_flt;
+	} while_each_thread(p, t);
+
+	r->utime_us = cputime_to_usecs(utime);
+	r->stime_us = cputime_to_usecs(stime);
+	r->min_flt = min_flt;
+	r->maj_flt = maj_flt;
+}
+
+/*
+ * Summing rss over all processes counts a shared page once per process
+ * mapping it. Scale @kb by the ratio of pages really in use to that sum,
+ * which gives every process its share of the system-wide sharing.
+ */
+static u64 pidstats_scale(u64 kb, unsigned long pages, u64 sum_kb)
+{
+	u64 total_kb = (u64)pages << (PAGE_SHIFT - 10);
+
+	if (!sum_kb || total_kb >= sum_kb)
+		return kb;
+	return div64_u64(kb * total_kb, sum_kb);
+}
+
+static int pidstats_open(struct inode *inode, struct file *file)
+{
+	struct pid_namespace *ns = inode->i_sb->s_fs_info;
+	bool restricted = ns->hide_pid && !in_group_p(ns->pid_gid);
+	struct pidstats_header *hdr;
+	struct pidstats_record *rec;
+	struct pidstats_buf *buf;
+	struct task_struct *p;
+	unsigned int nr = 0, max = PIDSTATS_SLACK, i;
+	u64 sum_anon_kb = 0, sum_file_kb = 0;
+	unsigned long anon, mapped;
+
+	rcu_read_lock();
+	for_each_process(p)
+		max++;
+	rcu_read_unlock();
+
+	buf = vmalloc(sizeof(*buf) + sizeof(*hdr) + max * sizeof(*rec));
+	if (!buf)
+		return -ENOMEM;
+	hdr = (struct pidstats_header *)buf->data;
+	rec = (struct pidstats_record *)(hdr + 1);
+
+	rcu_read_lock();
+	for_each_process(p) {
+		if (nr == max)
+			break;
+		if (!pid_alive(p) || !task_tgid_nr_ns(p, ns))
+			continue;
+		if (restricted && !ptrace_may_access(p, PTRACE_MODE_READ))
+			continue;
+		memset(&rec[nr], 0, sizeof(*rec));
+		pidstats_fill(&rec[nr], p, ns);
+		sum_anon_kb += rec[nr].rss_anon_kb;
+		sum_file_kb += rec[nr].rss_file_kb;
+		nr++;
+	}
+	rcu_read_unlock();
+
+	anon = global_page_state(NR_ANON_PAGES);
+	mapped = global_page_state(NR_FILE_MAPPED);
+	for (i = 0; i < nr; i++)
+		rec[i].pss_estimate_kb =
+			pidstats_scale(rec[i].rss_anon_kb, anon, sum_anon_kb) +
+			pidstats_scale(rec[i].rss_file_kb, mapped, sum_file_kb);
+
+	hdr->version = PIDSTATS_VERSION;
+	hdr->header_size = sizeof(*hdr);
+	hdr->record_size = sizeof(*rec);
+	hdr->nr_records = nr;
+	buf->size = sizeof(*hdr) + nr * sizeof(*rec);
+
+	file->private_data = buf;
+	return 0;
+}
+
+static ssize_t pidstats_read(struct file *file, char __user *ubuf,
+			     size_t count, loff_t *ppos)
+{
+	struct pidstats_buf *buf = file->private_data;
+
+	return simple_read_from_buffer(ubuf, count, ppos, buf->data,
+				       buf->size);
+}
+
+static int pidstats_release(struct inode *inode, struct file *file)
+{
+	vfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations proc_pidstats_operations = {
+	.open		= pidstats_open,
+	.read		= pidstats_read,
+	.llseek		= default_llseek,
+	.release	= pidstats_release,
+};
+
+static int __init proc_pidstats_init(void)
+{
+	proc_create("pidstats", S_IRUGO, NULL, &proc_pidstats_operations);
+	return 0;
+}
+module_init(proc_pidstats_init);
@@ -11,6 +11,8 @@
 #include <linux/rmap.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
+#include <linux/vmalloc.h>
+#include <linux/futex.h>
 
 #include <asm/elf.h>
 #include <asm/uaccess.h>
@@ -63,6 +65,22 @@ void task_mem(struct seq_file *m, struct mm_struct *mm)
 		mm->stack_vm << (PAGE_SHIFT-10), text, lib,
 		(PTRS_PER_PTE*sizeof(pte_t)*mm->nr_ptes) >> 10,
 		swap << (PAGE_SHIFT-10));
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	seq_printf(m,
+		"SpecFaults:\t%lu\n"
+		"SpecRetries:\t%lu\n",
+		atomic_long_read(&mm->spf_success),
+		atomic_long_read(&mm->spf_retry));
+#endif
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+	seq_printf(m,
+		"FutexBuckets:\t%u\n"
+		"FutexWaits:\t%lu\n"
+		"FutexCollisions:\t%lu\n",
+		futex_hash_buckets(mm),
+		atomic_long_read(&mm->futex_waits),
+		atomic_long_read(&mm->futex_collisions));
+#endif
 }
 
 unsigned long task_vsize(struct mm_struct *mm)
@@ -394,6 +412,7 @@ struct mem_size_stats {
 	unsigned long anonymous_thp;
 	unsigned long swap;
 	u64 pss;
+	u64 swap_pss;
 };
 
 
@@ -406,7 +425,16 @@ static void smaps_pte_entry(pte_t ptent, unsigned long addr,
 	int mapcount;
 
 	if (is_swap_pte(ptent)) {
+		swp_entry_t swpent = pte_to_swp_entry(ptent);
+
 		mss->swap += ptent_size;
+		if (non_swap_entry(swpent))
+			return;
+		mapcount = swp_swapcount(swpent);
+		if (mapcount >= 2)
+			mss->swap_pss += (ptent_size << PSS_SHIFT) / mapcount;
+		else
+			mss->swap_pss += (ptent_size << PSS_SHIFT);
 		return;
 	}
 
@@ -470,23 +498,30 @@ static int smaps_pte_range(pmd_t *pmd, unsigned long addr, unsigned long end,
 	return 0;
 }
 
-static int show_smap(struct seq_file *m, void *v, int is_pid)
+static void smap_gather_stats(struct vm_area_struct *vma,
+			      struct mem_size_stats *mss)
 {
-	struct proc_maps_private *priv = m->private;
-	struct task_struct *task = priv->task;
-	struct vm_area_struct *vma = v;
-	struct mem_size_stats mss;
 	struct mm_walk smaps_walk = {
 		.pmd_entry = smaps_pte_range,
 		.mm = vma->vm_mm,
-		.private = &mss,
+		.private = mss,
 	};
 
-	memset(&mss, 0, sizeof mss);
-	mss.vma = vma;
-	/* mmap_sem is held in m_start */
+	memset(mss, 0, sizeof(*mss));
+	mss->vma = vma;
+	/* mmap_sem is held by the caller */
 	if (vma->vm_mm && !is_vm_hugetlb_page(vma))
 		walk_page_range(vma->vm_start, vma->vm_end, &smaps_walk);
+}
+
+static int show_smap(struct seq_file *m, void *v, int is_pid)
+{
+	struct proc_maps_private *priv = m->private;
+	struct task_struct *task = priv->task;
+	struct vm_area_struct *vma = v;
+	struct mem_size_stats mss;
+
+	smap_gather_stats(vma, &mss);
 
 	show_map_vma(m, vma, is_pid);
 
@@ -502,6 +537,7 @@ static int show_smap(struct seq_file *m, void *v, int is_pid)
 		   "Anonymous:      %8lu kB\n"
 		   "AnonHugePages:  %8lu kB\n"
 		   "Swap:           %8lu kB\n"
+		   "SwapPss:        %8lu kB\n"
 		   "KernelPageSize: %8lu kB\n"
 		   "MMUPageSize:    %8lu kB\n"
 		   "Locked:         %8lu kB\n",
@@ -516,6 +552,7 @@ static int show_smap(struct seq_file *m, void *v, int is_pid)
 		   mss.anonymous >> 10,
 		   mss.anonymous_thp >> 10,
 		   mss.swap >> 10,
+		   (unsigned long)(mss.swap_pss >> (10 + PSS_SHIFT)),
 		   vma_kernel_pagesize(vma) >> 10,
 		   vma_mmu_pagesize(vma) >> 10,
 		   (vma->vm_flags & VM_LOCKED) ?
@@ -575,6 +612,201 @@ const struct file_operations proc_tid_smaps_operations = {
 	.release	= seq_release_private,
 };
 
+/*
+ * /proc/<pid>/smaps_rollup: the smaps totals of the whole process in one
+ * walk, without formatting every vma. Each read remembers what it found
+ * per vma, and rereading the same open file (pread or lseek to 0) only
+ * walks again the vmas that may have changed since: a read-only file
+ * mapping with no anonymous pages is taken from the previous read when
+ * the vma itself, the page cache size of its file and the file rss of
+ * the mm are all unchanged. Sharing with other processes still moves
+ * Pss under such a mapping, so everything is walked again once the
+ * previous full walk is older than SMAPS_ROLLUP_REFRESH.
+ */
+#define SMAPS_ROLLUP_REFRESH	(10 * HZ)
+
+struct smaps_rollup_vma {
+	unsigned long start;
+	unsigned long end;
+	unsigned long pgoff;
+	vm_flags_t flags;
+	struct file *file;		/* compared only, no reference held */
+	unsigned long nrpages;
+	struct mem_size_stats mss;
+};
+
+struct smaps_rollup_private {
+	struct pid *pid;
+	struct smaps_rollup_vma *vmas;	/* sorted by start, as in the mm */
+	int nr_vmas;
+	unsigned long file_rss;
+	unsigned long scanned;		/* jiffies of the last full walk */
+};
+
+static bool smaps_rollup_reusable(struct smaps_rollup_vma *r,
+				  struct vm_area_struct *vma)
+{
+	if (!vma->vm_file || vma->anon_vma || (vma->vm_flags & VM_WRITE))
+		return false;
+
+	return r->start == vma->vm_start && r->end == vma->vm_end &&
+		r->pgoff == vma->vm_pgoff && r->flags == vma->vm_flags &&
+		r->file == vma->vm_file &&
+		r->nrpages == vma->vm_file->f_mapping->nrpages;
+}
+
+static void smaps_rollup_record(struct smaps_rollup_vma *r,
+				struct vm_area_struct *vma)
+{
+	r->start = vma->vm_start;
+	r->end = vma->vm_end;
+	r->pgoff = vma->vm_pgoff;
+	r->flags = vma->vm_flags;
+	r->file = vma->vm_file;
+	r->nrpages = vma->vm_file ? vma->vm_file->f_mapping->nrpages : 0;
+	smap_gather_stats(vma, &r->mss);
+}
+
+static void smaps_rollup_add(struct mem_size_stats *total,
+			     struct mem_size_stats *mss)
+{
+	total->resident += mss->resident;
+	total->shared_clean += mss->shared_clean;
+	total->shared_dirty += mss->shared_dirty;
+	total->private_clean += mss->private_clean;
+	total->private_dirty += mss->private_dirty;
+	total->referenced += mss->referenced;
+	total->anonymous += mss->anonymous;
+	total->anonymous_thp += mss->anonymous_thp;
+	total->swap += mss->swap;
+	total->pss += mss->pss;
+	total->swap_pss += mss->swap_pss;
+}
+
+static int show_smaps_rollup(struct seq_file *m, void *v)
+{
+	struct smaps_rollup_private *priv = m->private;
+	struct smaps_rollup_vma *vmas, *old, *old_end;
+	struct task_struct *task;
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	struct mem_size_stats total;
+	unsigned long file_rss;
+	u64 locked = 0;
+	bool reuse;
+	int nr = 0;
+
+	task = get_pid_task(priv->pid, PIDTYPE_PID);
+	if (!task)
+		return -ESRCH;
+	mm = mm_for_maps(task);
+	put_task_struct(task);
+	if (!mm)
+		return 0;
+	if (IS_ERR(mm))
+		return PTR_ERR(mm);
+
+	down_read(&mm->mmap_sem);
+	vmas = vmalloc(max(mm->map_count, 1) * sizeof(*vmas));
+	if (!vmas) {
+		up_read(&mm->mmap_sem);
+		mmput(mm);
+		return -ENOMEM;
+	}
+
+	file_rss = get_mm_counter(mm, MM_FILEPAGES);
+	reuse = priv->vmas && file_rss == priv->file_rss &&
+		time_before(jiffies, priv->scanned + SMAPS_ROLLUP_REFRESH);
+	if (!reuse)
+		priv->scanned = jiffies;
+	priv->file_rss = file_rss;
+
+	memset(&total, 0, sizeof(total));
+	old = priv->vmas;
+	old_end = old + priv->nr_vmas;
+	for (vma = mm->mmap; vma && nr < mm->map_count; vma = vma->vm_next) {
+		struct smaps_rollup_vma *r = &vmas[nr++];
+
+		while (old < old_end && old->start < vma->vm_start)
+			old++;
+		if (reuse && old < old_end && smaps_rollup_reusable(old, vma)) {
+			*r = *old;
+			r->mss.vma = vma;
+		} else {
+			smaps_rollup_record(r, vma);
+		}
+
+		smaps_rollup_add(&total, &r->mss);
+		if (vma->vm_flags & VM_LOCKED)
+			locked += r->mss.pss;
+	}
+	up_read(&mm->mmap_sem);
+	mmput(mm);
+
+	vfree(priv->vmas);
+	priv->vmas = vmas;
+	priv->nr_vmas = nr;
+
+	seq_printf(m,
+		   "Rss:            %8lu kB\n"
+		   "Pss:            %8lu kB\n"
+		   "Shared_Clean:   %8lu kB\n"
+		   "Shared_Dirty:   %8lu kB\n"
+		   "Private_Clean:  %8lu kB\n"
+		   "Private_Dirty:  %8lu kB\n"
+		   "Referenced:     %8lu kB\n"
+		   "Anonymous:      %8lu kB\n"
+		   "AnonHugePages:  %8lu kB\n"
+		   "Swap:           %8lu kB\n"
+		   "SwapPss:        %8lu kB\n"
+		   "Locked:         %8lu kB\n",
+		   total.resident >> 10,
+		   (unsigned long)(total.pss >> (10 + PSS_SHIFT)),
+		   total.shared_clean  >> 10,
+		   total.shared_dirty  >> 10,
+		   total.private_clean >> 10,
+		   total.private_dirty >> 10,
+		   total.referenced >> 10,
+		   total.anonymous >> 10,
+		   total.anonymous_thp >> 10,
+		   total.swap >> 10,
+		   (unsigned long)(total.swap_pss >> (10 + PSS_SHIFT)),
+		   (unsigned long)(locked >> (10 + PSS_SHIFT)));
+	return 0;
+}
+
+static int smaps_rollup_open(struct inode *inode, struct file *file)
+{
+	struct smaps_rollup_private *priv;
+	int ret;
+
+	priv = kzalloc(sizeof(*priv), GFP_KERNEL);
+	if (!priv)
+		return -ENOMEM;
+	priv->pid = proc_pid(inode);
+	ret = single_open(file, show_smaps_rollup, priv);
+	if (ret)
+		kfree(priv);
+	return ret;
+}
+
+static int smaps_rollup_release(struct inode *inode, struct file *file)
+{
+	struct seq_file *m = file->private_data;
+	struct smaps_rollup_private *priv = m->private;
+
+	vfree(priv->vmas);
+	kfree(priv);
+	return single_release(inode, file);
+}
+
+const struct file_operations proc_pid_smaps_rollup_operations = {
+	.open		= smaps_rollup_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= smaps_rollup_release,
+};
+
 static int clear_refs_pte_range(pmd_t *pmd, unsigned long addr,
 				unsigned long end, struct mm_walk *walk)
 {
@@ -674,6 +906,145 @@ const struct file_operations proc_clear_refs_operations = {
 	.llseek		= noop_llseek,
 };
 
+#ifdef CONFIG_PROCESS_RECLAIM
+static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
+				unsigned long end, struct mm_walk *walk)
+{
+	struct vm_area_struct *vma = walk->private;
+	pte_t *orig_pte, *pte, ptent;
+	spinlock_t *ptl;
+	struct page *page;
+	LIST_HEAD(page_list);
+	int isolated = 0;
+
+	split_huge_page_pmd(walk->mm, pmd);
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	while (addr != end) {
+		orig_pte = pte = pte_offset_map_lock(vma->vm_mm, pmd, addr,
+						     &ptl);
+		for (; addr != end && isolated < SWAP_CLUSTER_MAX;
+		     pte++, addr += PAGE_SIZE) {
+			ptent = *pte;
+			if (!pte_present(ptent))
+				continue;
+
+			page = vm_normal_page(vma, addr, ptent);
+			if (!page)
+				continue;
+
+			/* Leave pages shared with other processes alone */
+			if (page_mapcount(page) != 1)
+				continue;
+
+			if (isolate_lru_page(page))
+				continue;
+
+			list_add(&page->lru, &page_list);
+			isolated++;
+		}
+		pte_unmap_unlock(orig_pte, ptl);
+
+		if (isolated) {
+			reclaim_pages_from_list(&page_list);
+			isolated = 0;
+		}
+		cond_resched();
+	}
+
+	return 0;
+}
+
+enum reclaim_type {
+	RECLAIM_FILE,
+	RECLAIM_ANON,
+	RECLAIM_ALL,
+};
+
+static ssize_t reclaim_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct task_struct *task;
+	char buffer[200];
+	char *type_buf, *rest;
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	enum reclaim_type type;
+	unsigned long start = 0, end = TASK_SIZE;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	rest = strstrip(buffer);
+	type_buf = strsep(&rest, " ");
+	if (!strcmp(type_buf, "file"))
+		type = RECLAIM_FILE;
+	else if (!strcmp(type_buf, "anon"))
+		type = RECLAIM_ANON;
+	else if (!strcmp(type_buf, "all"))
+		type = RECLAIM_ALL;
+	else
+		return -EINVAL;
+
+	/* Optional "<start> <size>" limits reclaim to an address range */
+	if (rest && *rest) {
+		unsigned long size;
+
+		if (sscanf(rest, "%lx %lu", &start, &size) != 2)
+			return -EINVAL;
+		if (start & ~PAGE_MASK || !size)
+			return -EINVAL;
+		size = PAGE_ALIGN(size);
+		if (start + size < start || start + size > TASK_SIZE)
+			return -EINVAL;
+		end = start + size;
+	}
+
+	task = get_proc_task(file->f_path.dentry->d_inode);
+	if (!task)
+		return -ESRCH;
+
+	mm = get_task_mm(task);
+	if (mm) {
+		struct mm_walk reclaim_walk = {
+			.pmd_entry = reclaim_pte_range,
+			.mm = mm,
+		};
+
+		down_read(&mm->mmap_sem);
+		for (vma = find_vma(mm, start); vma && vma->vm_start < end;
+		     vma = vma->vm_next) {
+			if (is_vm_hugetlb_page(vma))
+				continue;
+			if (vma->vm_flags & VM_LOCKED)
+				continue;
+			if (type == RECLAIM_ANON && vma->vm_file)
+				continue;
+			if (type == RECLAIM_FILE && !vma->vm_file)
+				continue;
+
+			reclaim_walk.private = vma;
+			walk_page_range(max(vma->vm_start, start),
+					min(vma->vm_end, end), &reclaim_walk);
+		}
+		up_read(&mm->mmap_sem);
+		mmput(mm);
+	}
+	put_task_struct(task);
+
+	return count;
+}
+
+const struct file_operations proc_reclaim_operations = {
+	.write		= reclaim_write,
+	.llseek		= noop_llseek,
+};
+#endif
+
 typedef struct {
 	u64 pme;
 } pagemap_entry_t;
@@ -30,6 +30,8 @@
 #include <linux/uaccess.h>
 #include <linux/hardirq.h>
 #include <linux/workqueue.h>
+#include <linux/lz4.h>
+#include <asm/byteorder.h>
 
 #include "internal.h"
 
@@ -68,6 +70,135 @@ void pstore_set_kmsg_bytes(int bytes)
 /* Tag each group of saved records with a sequence number */
 static int	oopscount;
 
+#ifdef CONFIG_PSTORE_COMPRESS
+/*
+ * A compressed record is this header followed by the LZ4 data. Plain
+ * dmesg records start with the "Oops#1 Part1" text, so they can't be
+ * mistaken for one.
+ */
+struct pstore_zhdr {
+	__le32	magic;
+	__le32	size;		/* uncompressed size */
+};
+
+#define PSTORE_ZMAGIC	0x345a5350	/* "PSZ4" */
+#define PSTORE_ZRATIO	4		/* log text per byte of backend buffer */
+
+static bool compress = true;
+module_param(compress, bool, 0644);
+MODULE_PARM_DESC(compress, "Compress oops records");
+
+/* Allocated at register time, used under psinfo->buf_lock */
+static char	*zin;		/* text to compress */
+static size_t	zin_size;
+static char	*zout;		/* lz4_compressbound(zin_size) */
+static void	*zwork;
+
+static void pstore_zalloc(struct pstore_info *psi)
+{
+	zin_size = psi->bufsize * PSTORE_ZRATIO;
+	zin = kmalloc(zin_size, GFP_KERNEL);
+	zout = kmalloc(lz4_compressbound(zin_size), GFP_KERNEL);
+	zwork = kmalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
+	if (!zin || !zout || !zwork) {
+		pr_warn("pstore: no memory for compression buffers\n");
+		kfree(zin);
+		kfree(zout);
+		kfree(zwork);
+		zin = NULL;
+	}
+}
+
+static inline bool pstore_zenabled(void)
+{
+	return compress && zin;
+}
+
+/*
+ * Store the @hsize bytes of header at @in followed by as much of the
+ * *@payload bytes of log after it as fits in psinfo->buf, compressed if
+ * that gets more in. The oldest log text is given up first. Returns
+ * the size of the record and sets *@payload to the log bytes kept.
+ */
+static size_t pstore_zip(char *in, size_t hsize, size_t *payload)
+{
+	struct pstore_zhdr *zhdr = (struct pstore_zhdr *)psinfo->buf;
+	size_t room = psinfo->bufsize - sizeof(*zhdr);
+	size_t plain = psinfo->bufsize - hsize;
+	size_t zlen, keep, drop;
+
+	while (*payload > plain) {
+		if (!lz4_compress(in, hsize + *payload, zout, &zlen, zwork) &&
+		    zlen <= room) {
+			zhdr->magic = cpu_to_le32(PSTORE_ZMAGIC);
+			zhdr->size = cpu_to_le32(hsize + *payload);
+			memcpy(zhdr + 1, zout, zlen);
+			return sizeof(*zhdr) + zlen;
+		}
+
+		/* didn't fit: drop a quarter of the oldest text and retry */
+		keep = max(*payload - *payload / 4, plain);
+		drop = *payload - keep;
+		memmove(in + drop, in, hsize);
+		in += drop;
+		*payload = keep;
+	}
+
+	memcpy(psinfo->buf, in, hsize + *payload);
+	return hsize + *payload;
+}
+
+/*
+ * Replace *@buf with its decompressed contents if it is a compressed
+ * record. Records that fail to decompress are left as they are.
+ */
+static ssize_t pstore_unzip(char **buf, ssize_t size)
+{
+	struct pstore_zhdr *zhdr = (struct pstore_zhdr *)*buf;
+	size_t len;
+	char *out;
+
+	if (size < sizeof(*zhdr) || le32_to_cpu(zhdr->magic) != PSTORE_ZMAGIC)
+		return size;
+
+	len = le32_to_cpu(zhdr->size);
+	if (len > zin_size)
+		return size;
+	out = kmalloc(len, GFP_KERNEL);
+	if (!out)
+		return size;
+
+	if (lz4_decompress_unknownoutputsize((unsigned char *)(zhdr + 1),
+					     size - sizeof(*zhdr), out, &len)) {
+		kfree(out);
+		return size;
+	}
+
+	kfree(*buf);
+	*buf = out;
+	return len;
+}
+#else
+static inline void pstore_zalloc(struct pstore_info *psi)
+{
+}
+
+static inline bool pstore_zenabled(void)
+{
+	return false;
+}
+
+static inline size_t pstore_zip(char *in, size_t hsize, size_t *payload)
+{
+	return 0;
+}
+
+static inline ssize_t pstore_unzip(char **buf, ssize_t size)
+{
+	return size;
+}
+#endif
+
 static const char *get_reason_str(enum kmsg_dump_reason reason)
 {
 	switch (reason) {
@@ -122,7 +253,8 @@ static void pstore_dump(struct kmsg_dumper *dumper,
 	unsigned long	s1_start, s2_start;
 	unsigned long	l1_cpy, l2_cpy;
 	unsigned long	size, total = 0;
-	char		*dst;
+	size_t		len, payload, drop;
+	char		*dst, *rec;
 	const char	*why;
 	u64		id;
 	int		hsize, ret;
@@ -142,9 +274,16 @@ static void pstore_dump(struct kmsg_dumper *dumper,
 		spin_lock_irqsave(&psinfo->buf_lock, flags);
 	oopscount++;
 	while (total < kmsg_bytes) {
-		dst = psinfo->buf;
+		if (pstore_zenabled()) {
+			rec = zin;
+			size = zin_size;
+		} else {
+			rec = psinfo->buf;
+			size = psinfo->bufsize;
+		}
+		dst = rec;
 		hsize = sprintf(dst, "%s#%d Part%d\n", why, oopscount, part);
-		size = psinfo->bufsize - hsize;
+		size -= hsize;
 		dst += hsize;
 
 		l2_cpy = min(l2, size);
@@ -159,8 +298,22 @@ static void pstore_dump(struct kmsg_dumper *dumper,
 		memcpy(dst, s1 + s1_start, l1_cpy);
 		memcpy(dst + l1_cpy, s2 + s2_start, l2_cpy);
 
+		len = hsize + l1_cpy + l2_cpy;
+		if (rec != psinfo->buf) {
+			/* whatever didn't fit is left for the next part */
+			payload = l1_cpy + l2_cpy;
+			len = pstore_zip(rec, hsize, &payload);
+			drop = l1_cpy + l2_cpy - payload;
+			if (drop > l1_cpy) {
+				l2_cpy -= drop - l1_cpy;
+				l1_cpy = 0;
+			} else {
+				l1_cpy -= drop;
+			}
+		}
+
 		ret = psinfo->write(PSTORE_TYPE_DMESG, reason, &id, part,
-				   hsize + l1_cpy + l2_cpy, psinfo);
+				   len, psinfo);
 		if (ret == 0 && reason == KMSG_DUMP_OOPS && pstore_is_mounted())
 			pstore_new_entry = 1;
 		l1 -= l1_cpy;
@@ -212,6 +365,8 @@ int pstore_register(struct pstore_info *psi)
 		return -EINVAL;
 	}
 
+	pstore_zalloc(psi);
+
 	if (pstore_is_mounted())
 		pstore_get_records(0);
 
@@ -248,6 +403,8 @@ void pstore_get_records(int quiet)
 		goto out;
 
 	while ((size = psi->read(&id, &type, &time, &buf, psi)) > 0) {
+		if (type == PSTORE_TYPE_DMESG)
+			size = pstore_unzip(&buf, size);
 		rc = pstore_mkfile(type, psi->name, id, buf, (size_t)size,
 				  time, psi);
 		kfree(buf);
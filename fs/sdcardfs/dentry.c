@@ -21,6 +21,61 @@
 #include "sdcardfs.h"
 #include "linux/ctype.h"
 
+/*
+ * The checks of sdcardfs_d_revalidate() that can be made in RCU-walk
+ * mode: no references are taken and nothing sleeps. The dentry data and
+ * the lower dentries stay allocated until the walk leaves its RCU read
+ * side section. Graft (obb) dentries, and anything that would have to
+ * be invalidated, are left for ref-walk to deal with.
+ */
+static int sdcardfs_d_revalidate_rcu(struct dentry *dentry)
+{
+	struct dentry *parent = ACCESS_ONCE(dentry->d_parent);
+	struct sdcardfs_dentry_info *info = ACCESS_ONCE(dentry->d_fsdata);
+	struct sdcardfs_dentry_info *parent_info;
+	struct dentry *lower_dentry, *lower_parent;
+	int valid;
+
+	if (parent == dentry)
+		return 1;
+	parent_info = ACCESS_ONCE(parent->d_fsdata);
+	if (!info || !parent_info)
+		return -ECHILD;
+
+	spin_lock(&info->lock);
+	lower_dentry = info->orig_path.dentry ? NULL : info->lower_path.dentry;
+	spin_unlock(&info->lock);
+	spin_lock(&parent_info->lock);
+	lower_parent = parent_info->lower_path.dentry;
+	spin_unlock(&parent_info->lock);
+	if (!lower_dentry || !lower_parent)
+		return -ECHILD;
+
+	if (dentry < lower_dentry) {
+		spin_lock(&dentry->d_lock);
+		spin_lock(&lower_dentry->d_lock);
+	} else {
+		spin_lock(&lower_dentry->d_lock);
+		spin_lock(&dentry->d_lock);
+	}
+
+	valid = !d_unhashed(lower_dentry) &&
+		lower_dentry->d_parent == lower_parent &&
+		dentry->d_name.len == lower_dentry->d_name.len &&
+		!strncasecmp(dentry->d_name.name, lower_dentry->d_name.name,
+			     dentry->d_name.len);
+
+	if (dentry < lower_dentry) {
+		spin_unlock(&lower_dentry->d_lock);
+		spin_unlock(&dentry->d_lock);
+	} else {
+		spin_unlock(&dentry->d_lock);
+		spin_unlock(&lower_dentry->d_lock);
+	}
+
+	return valid ? 1 : -ECHILD;
+}
+
 /*
  * returns: -ERRNO if error (returned to user)
  *          0: tell VFS to invalidate dentry
@@ -35,8 +90,11 @@ static int sdcardfs_d_revalidate(struct dentry *dentry, struct nameidata *nd)
 	struct dentry *lower_cur_parent_dentry = NULL;
 	struct dentry *lower_dentry = NULL;
 
-	if (nd && nd->flags & LOOKUP_RCU)
-		return -ECHILD;
+	if (nd && nd->flags & LOOKUP_RCU) {
+		err = sdcardfs_d_revalidate_rcu(dentry);
+		sdcardfs_count_rcu_walk(dentry->d_sb, err);
+		return err;
+	}
 
 	spin_lock(&dentry->d_lock);
 	if (IS_ROOT(dentry)) {
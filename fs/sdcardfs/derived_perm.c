@@ -46,6 +46,45 @@ void setup_derived_state(struct inode *inode, perm_t perm, userid_t userid,
 	info->top = top;
 }
 
+/* get_appid() for the name of @dentry, remembered until packages.list changes */
+static appid_t get_cached_appid(struct sdcardfs_sb_info *sbi, struct dentry *dentry)
+{
+	struct sdcardfs_dentry_info *di = SDCARDFS_D(dentry);
+	unsigned int gen = get_packagelist_gen();
+	appid_t appid;
+
+	if (!di)
+		return get_appid(sbi->pkgl_id, dentry->d_name.name);
+
+	spin_lock(&di->lock);
+	if (di->appid_gen == gen) {
+		appid = di->appid;
+		spin_unlock(&di->lock);
+		return appid;
+	}
+	spin_unlock(&di->lock);
+
+	appid = get_appid(sbi->pkgl_id, dentry->d_name.name);
+
+	spin_lock(&di->lock);
+	di->appid = appid;
+	di->appid_gen = gen;
+	spin_unlock(&di->lock);
+	return appid;
+}
+
+/* The cache belongs to the name, so drop it when d_move() changes it */
+void invalidate_cached_appid(struct dentry *dentry)
+{
+	struct sdcardfs_dentry_info *di = SDCARDFS_D(dentry);
+
+	if (!di)
+		return;
+	spin_lock(&di->lock);
+	di->appid_gen = 0;
+	spin_unlock(&di->lock);
+}
+
 /* While renaming, there is a point where we want the path from dentry, but the name from newdentry */
 void get_derived_permission_new(struct dentry *parent, struct dentry *dentry, struct dentry *newdentry)
 {
@@ -103,7 +142,7 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry, st
 		case PERM_ANDROID_DATA:
 		case PERM_ANDROID_OBB:
 		case PERM_ANDROID_MEDIA:
-			appid = get_appid(sbi->pkgl_id, newdentry->d_name.name);
+			appid = get_cached_appid(sbi, newdentry);
 			if (appid != 0) {
 				info->d_uid = multiuser_get_uid(parent_info->userid, appid);
 			}
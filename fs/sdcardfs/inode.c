@@ -551,6 +551,9 @@ static int sdcardfs_rename(struct inode *old_dir, struct dentry *old_dentry,
 	get_derived_permission_new(new_dentry->d_parent, old_dentry, new_dentry);
 	fix_derived_permission(old_dentry->d_inode);
 	fixup_top_recursive(old_dentry);
+	/* d_move() swaps the names once we return */
+	invalidate_cached_appid(old_dentry);
+	invalidate_cached_appid(new_dentry);
 
 out_err:
 	mnt_drop_write(lower_new_path.mnt);
@@ -644,6 +647,9 @@ static int sdcardfs_permission(struct inode *inode, int mask)
 
 	/* Ensure owner is up to date */
 	if (inode->i_uid != top->i_uid) {
+		/* fix_derived_permission() needs a live lower inode */
+		if (mask & MAY_NOT_BLOCK)
+			return -ECHILD;
 		SDCARDFS_I(inode)->d_uid = SDCARDFS_I(top)->d_uid;
 		fix_derived_permission(inode);
 	}
@@ -36,16 +36,29 @@ int sdcardfs_init_dentry_cache(void)
 
 void sdcardfs_destroy_dentry_cache(void)
 {
+	/* wait for the dentry data still queued by free_dentry_private_data */
+	rcu_barrier();
 	if (sdcardfs_dentry_cachep)
 		kmem_cache_destroy(sdcardfs_dentry_cachep);
 }
 
+static void sdcardfs_free_dentry_info(struct rcu_head *head)
+{
+	struct sdcardfs_dentry_info *info =
+		container_of(head, struct sdcardfs_dentry_info, rcu);
+
+	kmem_cache_free(sdcardfs_dentry_cachep, info);
+}
+
 void free_dentry_private_data(struct dentry *dentry)
 {
+	struct sdcardfs_dentry_info *info;
+
 	if (!dentry || !dentry->d_fsdata)
 		return;
-	kmem_cache_free(sdcardfs_dentry_cachep, dentry->d_fsdata);
+	info = dentry->d_fsdata;
 	dentry->d_fsdata = NULL;
+	call_rcu(&info->rcu, sdcardfs_free_dentry_info);
 }
 
 /* allocate new dentry private data */
@@ -211,6 +211,13 @@ static int sdcardfs_read_super(struct super_block *sb, const char *dev_name,
 	}
 
 	sb_info = sb->s_fs_info;
+	err = percpu_counter_init(&sb_info->rcu_walks, 0);
+	if (err)
+		goto out_freesbi;
+	err = percpu_counter_init(&sb_info->rcu_walk_fallbacks, 0);
+	if (err)
+		goto out_freesbi;
+
 	/* parse options */
 	err = parse_options(sb, raw_data, silent, &debug, &sb_info->options);
 	if (err) {
@@ -296,6 +303,8 @@ out_sput:
 	/* drop refs we took earlier */
 	atomic_dec(&lower_sb->s_active);
 out_freesbi:
+	percpu_counter_destroy(&sb_info->rcu_walks);
+	percpu_counter_destroy(&sb_info->rcu_walk_fallbacks);
 	kfree(SDCARDFS_SB(sb));
 	sb->s_fs_info = NULL;
 out_free:
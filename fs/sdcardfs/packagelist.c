@@ -28,6 +28,8 @@
 #include <linux/slab.h>
 
 #include <linux/configfs.h>
+#include <linux/ctype.h>
+#include <linux/rculist.h>
 
 #define STRING_BUF_SIZE		(512)
 
@@ -35,6 +37,7 @@ struct hashtable_entry {
         struct hlist_node hlist;
         void *key;
 	unsigned int value;
+	struct rcu_head rcu;
 };
 
 struct sb_list {
@@ -49,38 +52,53 @@ struct packagelist_data {
 
 static struct packagelist_data *pkgl_data_all;
 
+/* bumped whenever package_to_appid changes, see get_cached_appid() */
+static atomic_t pkgl_generation = ATOMIC_INIT(1);
+
 static struct kmem_cache *hashtable_entry_cachep;
 
+/* case insensitive, entries are compared with strcasecmp() */
 static unsigned int str_hash(const char *key) {
-	int i;
 	unsigned int h = strlen(key);
-	char *data = (char *)key;
 
-	for (i = 0; i < strlen(key); i++) {
-		h = h * 31 + *data;
-		data++;
-	}
+	for (; *key; key++)
+		h = h * 31 + tolower(*key);
 	return h;
 }
 
+/* Lock free; writers serialize on hashtable_lock and free after a grace period */
 appid_t get_appid(void *pkgl_id, const char *app_name)
 {
 	struct packagelist_data *pkgl_dat = pkgl_data_all;
 	struct hashtable_entry *hash_cur;
 	struct hlist_node *h_n;
 	unsigned int hash = str_hash(app_name);
-	appid_t ret_id;
+	appid_t ret_id = 0;
 
-	spin_lock(&pkgl_dat->hashtable_lock);
-	hash_for_each_possible(pkgl_dat->package_to_appid, hash_cur, h_n, hlist, hash) {
+	rcu_read_lock();
+	hash_for_each_possible_rcu(pkgl_dat->package_to_appid, hash_cur, h_n, hlist, hash) {
 		if (!strcasecmp(app_name, hash_cur->key)) {
-			ret_id = (appid_t)hash_cur->value;
-			spin_unlock(&pkgl_dat->hashtable_lock);
-			return ret_id;
+			ret_id = (appid_t)ACCESS_ONCE(hash_cur->value);
+			break;
 		}
 	}
-	spin_unlock(&pkgl_dat->hashtable_lock);
-	return 0;
+	rcu_read_unlock();
+	return ret_id;
+}
+
+unsigned int get_packagelist_gen(void)
+{
+	unsigned int gen = atomic_read(&pkgl_generation);
+
+	/* pairs with smp_mb__before_atomic_inc() in packagelist_changed() */
+	smp_rmb();
+	return gen;
+}
+
+static void packagelist_changed(void)
+{
+	smp_mb__before_atomic_inc();
+	atomic_inc(&pkgl_generation);
 }
 
 /* Kernel has already enforced everything we returned through
@@ -120,27 +138,33 @@ int open_flags_to_access_mode(int open_flags) {
 	}
 }
 
-static int insert_str_to_int_lock(struct packagelist_data *pkgl_dat, char *key,
-		unsigned int value)
+static void free_hashtable_entry(struct hashtable_entry *h_entry)
+{
+	kfree(h_entry->key);
+	kmem_cache_free(hashtable_entry_cachep, h_entry);
+}
+
+static void free_hashtable_entry_rcu(struct rcu_head *head)
+{
+	free_hashtable_entry(container_of(head, struct hashtable_entry, rcu));
+}
+
+/* @new_entry is consumed, either linked or freed */
+static void insert_str_to_int_lock(struct packagelist_data *pkgl_dat,
+		struct hashtable_entry *new_entry)
 {
 	struct hashtable_entry *hash_cur;
-	struct hashtable_entry *new_entry;
 	struct hlist_node *h_n;
-	unsigned int hash = str_hash(key);
+	unsigned int hash = str_hash(new_entry->key);
 
 	hash_for_each_possible(pkgl_dat->package_to_appid, hash_cur, h_n, hlist, hash) {
-		if (!strcasecmp(key, hash_cur->key)) {
-			hash_cur->value = value;
-			return 0;
+		if (!strcasecmp(new_entry->key, hash_cur->key)) {
+			ACCESS_ONCE(hash_cur->value) = new_entry->value;
+			free_hashtable_entry(new_entry);
+			return;
 		}
 	}
-	new_entry = kmem_cache_alloc(hashtable_entry_cachep, GFP_ATOMIC);
-	if (!new_entry)
-		return -ENOMEM;
-	new_entry->key = kstrdup(key, GFP_ATOMIC);
-	new_entry->value = value;
-	hash_add(pkgl_dat->package_to_appid, &new_entry->hlist, hash);
-	return 0;
+	hash_add_rcu(pkgl_dat->package_to_appid, &new_entry->hlist, hash);
 }
 
 static void fixup_perms(struct super_block *sb, const char *key) {
@@ -151,12 +175,24 @@ static void fixup_perms(struct super_block *sb, const char *key) {
 
 static int insert_str_to_int(struct packagelist_data *pkgl_dat, char *key,
 		unsigned int value) {
-	int ret;
+	struct hashtable_entry *new_entry;
 	struct sdcardfs_sb_info *sbinfo;
+
+	new_entry = kmem_cache_alloc(hashtable_entry_cachep, GFP_KERNEL);
+	if (!new_entry)
+		return -ENOMEM;
+	new_entry->key = kstrdup(key, GFP_KERNEL);
+	if (!new_entry->key) {
+		kmem_cache_free(hashtable_entry_cachep, new_entry);
+		return -ENOMEM;
+	}
+	new_entry->value = value;
+
 	mutex_lock(&sdcardfs_super_list_lock);
 	spin_lock(&pkgl_dat->hashtable_lock);
-	ret = insert_str_to_int_lock(pkgl_dat, key, value);
+	insert_str_to_int_lock(pkgl_dat, new_entry);
 	spin_unlock(&pkgl_dat->hashtable_lock);
+	packagelist_changed();
 
 	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
 		if (sbinfo) {
@@ -164,13 +200,12 @@ static int insert_str_to_int(struct packagelist_data *pkgl_dat, char *key,
 		}
 	}
 	mutex_unlock(&sdcardfs_super_list_lock);
-	return ret;
+	return 0;
 }
 
 static void remove_str_to_int_lock(struct hashtable_entry *h_entry) {
-	kfree(h_entry->key);
-	hash_del(&h_entry->hlist);
-	kmem_cache_free(hashtable_entry_cachep, h_entry);
+	hash_del_rcu(&h_entry->hlist);
+	call_rcu(&h_entry->rcu, free_hashtable_entry_rcu);
 }
 
 static void remove_str_to_int(struct packagelist_data *pkgl_dat, const char *key)
@@ -188,6 +223,7 @@ static void remove_str_to_int(struct packagelist_data *pkgl_dat, const char *key
 		}
 	}
 	spin_unlock(&pkgl_data_all->hashtable_lock);
+	packagelist_changed();
 	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
 		if (sbinfo) {
 			fixup_perms(sbinfo->sb, key);
@@ -230,9 +266,10 @@ static struct packagelist_data * packagelist_create(void)
 
 static void packagelist_destroy(struct packagelist_data *pkgl_dat)
 {
-	spin_lock(&pkgl_dat->hashtable_lock);
 	remove_all_hashentrys(pkgl_dat);
-	spin_unlock(&pkgl_dat->hashtable_lock);
+	packagelist_changed();
+	/* wait for the entries queued by remove_str_to_int_lock() */
+	rcu_barrier();
 	printk(KERN_INFO "sdcardfs: destroyed packagelist pkgld\n");
 	kfree(pkgl_dat);
 }
@@ -351,14 +388,13 @@ static ssize_t packages_attr_show(struct config_item *item,
 					 char *page)
 {
 	struct hashtable_entry *hash_cur;
-	struct hlist_node *h_t;
 	struct hlist_node *h_n;
 	int i;
 	int count = 0, written = 0;
 	char errormsg[] = "<truncated>\n";
 
-	spin_lock(&pkgl_data_all->hashtable_lock);
-	hash_for_each_safe(pkgl_data_all->package_to_appid, i, h_t, h_n, hash_cur, hlist) {
+	rcu_read_lock();
+	hash_for_each_rcu(pkgl_data_all->package_to_appid, i, h_n, hash_cur, hlist) {
 		written = scnprintf(page + count, PAGE_SIZE - sizeof(errormsg) - count, "%s %d\n", (char *)hash_cur->key, hash_cur->value);
 		if (count + written == PAGE_SIZE - sizeof(errormsg)) {
 			count += scnprintf(page + count, PAGE_SIZE - count, errormsg);
@@ -366,7 +402,7 @@ static ssize_t packages_attr_show(struct config_item *item,
 		}
 		count += written;
 	}
-	spin_unlock(&pkgl_data_all->hashtable_lock);
+	rcu_read_unlock();
 
 
 	return count;
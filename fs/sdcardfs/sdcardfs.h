@@ -43,6 +43,7 @@
 #include <linux/security.h>
 #include <linux/string.h>
 #include <linux/list.h>
+#include <linux/percpu_counter.h>
 #include "multiuser.h"
 
 /* the file system name */
@@ -177,9 +178,13 @@ struct sdcardfs_inode_info {
 
 /* sdcardfs dentry data in memory */
 struct sdcardfs_dentry_info {
-	spinlock_t lock;	/* protects lower_path */
+	spinlock_t lock;	/* protects lower_path and the appid cache */
 	struct path lower_path;
 	struct path orig_path;
+	/* packages.list entry for d_name, valid while appid_gen is current */
+	appid_t appid;
+	unsigned int appid_gen;
+	struct rcu_head rcu;	/* RCU-walk may still look at a freed dentry */
 };
 
 struct sdcardfs_mount_options {
@@ -204,6 +209,9 @@ struct sdcardfs_sb_info {
 	struct path obbpath;
 	void *pkgl_id;
 	struct list_head list;
+	/* revalidations done in RCU-walk mode, and those sent to ref-walk */
+	struct percpu_counter rcu_walks;
+	struct percpu_counter rcu_walk_fallbacks;
 };
 
 /*
@@ -227,6 +235,16 @@ static inline struct sdcardfs_inode_info *SDCARDFS_I(const struct inode *inode)
 /* file to private Data */
 #define SDCARDFS_F(file) ((struct sdcardfs_file_info *)((file)->private_data))
 
+static inline void sdcardfs_count_rcu_walk(struct super_block *sb, int err)
+{
+	struct sdcardfs_sb_info *sbi = SDCARDFS_SB(sb);
+
+	if (err == -ECHILD)
+		percpu_counter_inc(&sbi->rcu_walk_fallbacks);
+	else
+		percpu_counter_inc(&sbi->rcu_walks);
+}
+
 /* file to lower file */
 static inline struct file *sdcardfs_lower_file(const struct file *f)
 {
@@ -398,6 +416,7 @@ extern struct list_head sdcardfs_super_list;
 
 /* for packagelist.c */
 extern appid_t get_appid(void *pkgl_id, const char *app_name);
+extern unsigned int get_packagelist_gen(void);
 extern int check_caller_access_to_name(struct inode *parent_node, const char* name);
 extern int open_flags_to_access_mode(int open_flags);
 extern int packagelist_init(void);
@@ -410,6 +429,7 @@ extern void get_derived_permission(struct dentry *parent, struct dentry *dentry)
 extern void get_derived_permission_new(struct dentry *parent, struct dentry *dentry, struct dentry *newdentry);
 extern void fixup_top_recursive(struct dentry *parent);
 extern void fixup_perms_recursive(struct dentry *dentry, const char *name, size_t len);
+extern void invalidate_cached_appid(struct dentry *dentry);
 
 extern void update_derived_permission_lock(struct dentry *dentry);
 extern int need_graft_path(struct dentry *dentry);
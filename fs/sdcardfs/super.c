@@ -46,6 +46,8 @@ static void sdcardfs_put_super(struct super_block *sb)
 	sdcardfs_set_lower_super(sb, NULL);
 	atomic_dec(&s->s_active);
 
+	percpu_counter_destroy(&spd->rcu_walks);
+	percpu_counter_destroy(&spd->rcu_walk_fallbacks);
 	kfree(spd);
 	sb->s_fs_info = NULL;
 }
@@ -144,11 +146,18 @@ static struct inode *sdcardfs_alloc_inode(struct super_block *sb)
 	return &i->vfs_inode;
 }
 
-static void sdcardfs_destroy_inode(struct inode *inode)
+static void sdcardfs_i_callback(struct rcu_head *head)
 {
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
 	kmem_cache_free(sdcardfs_inode_cachep, SDCARDFS_I(inode));
 }
 
+static void sdcardfs_destroy_inode(struct inode *inode)
+{
+	call_rcu(&inode->i_rcu, sdcardfs_i_callback);
+}
+
 /* sdcardfs inode cache constructor */
 static void init_once(void *obj)
 {
@@ -173,6 +182,7 @@ int sdcardfs_init_inode_cache(void)
 /* sdcardfs inode cache destructor */
 void sdcardfs_destroy_inode_cache(void)
 {
+	rcu_barrier();
 	if (sdcardfs_inode_cachep)
 		kmem_cache_destroy(sdcardfs_inode_cachep);
 }
@@ -209,6 +219,16 @@ static int sdcardfs_show_options(struct seq_file *m, struct dentry *root)
 	return 0;
 };
 
+static int sdcardfs_show_stats(struct seq_file *m, struct dentry *root)
+{
+	struct sdcardfs_sb_info *sbi = SDCARDFS_SB(root->d_sb);
+
+	seq_printf(m, " rcu_walks=%lld rcu_walk_fallbacks=%lld",
+		   percpu_counter_sum(&sbi->rcu_walks),
+		   percpu_counter_sum(&sbi->rcu_walk_fallbacks));
+	return 0;
+}
+
 const struct super_operations sdcardfs_sops = {
 	.put_super	= sdcardfs_put_super,
 	.statfs		= sdcardfs_statfs,
@@ -216,6 +236,7 @@ const struct super_operations sdcardfs_sops = {
 	.evict_inode	= sdcardfs_evict_inode,
 	.umount_begin	= sdcardfs_umount_begin,
 	.show_options	= sdcardfs_show_options,
+	.show_stats	= sdcardfs_show_stats,
 	.alloc_inode	= sdcardfs_alloc_inode,
 	.destroy_inode	= sdcardfs_destroy_inode,
 	.drop_inode	= generic_delete_inode,
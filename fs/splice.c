@@ -20,6 +20,8 @@
 #include <linux/fs.h>
 #include <linux/file.h>
 #include <linux/pagemap.h>
+#include <linux/buffer_head.h>
+#include <linux/backing-dev.h>
 #include <linux/splice.h>
 #include <linux/memcontrol.h>
 #include <linux/mm_inline.h>
@@ -231,6 +233,9 @@ ssize_t splice_to_pipe(struct pipe_inode_info *pipe,
 			break;
 		}
 
+		if (pipe_grow_when_full(pipe))
+			continue;
+
 		if (spd->flags & SPLICE_F_NONBLOCK) {
 			if (!ret)
 				ret = -EAGAIN;
@@ -707,6 +712,79 @@ static int pipe_to_sendpage(struct pipe_inode_info *pipe,
 				    sd->len, &pos, more);
 }
 
+/*
+ * Put a whole, page aligned pipe buffer into the page cache of the output
+ * file in place of @page, which ->write_begin() has just created for this
+ * index, instead of copying the data. Only done if the pipe holds the
+ * only reference to its page and the filesystem lets pages migrate, so
+ * that the buffers ->write_begin() attached can move along with the data.
+ * Returns the page to hand to ->write_end(): @page itself if the data has
+ * to be copied.
+ */
+static struct page *splice_move_page(struct pipe_inode_info *pipe,
+				     struct pipe_buffer *buf,
+				     struct page *page)
+{
+	struct address_space *mapping = page->mapping;
+	struct page *new = buf->page;
+	struct buffer_head *bh, *head;
+
+	if (buf->offset || buf->len < PAGE_CACHE_SIZE)
+		return page;
+	if (mapping_cap_swap_backed(mapping) || !mapping->a_ops->migratepage)
+		return page;
+	/* buffer_head users of a lowmem mapping dereference b_data */
+	if (PageHighMem(new) && !(mapping_gfp_mask(mapping) & __GFP_HIGHMEM))
+		return page;
+	if (PageUptodate(page) || PageDirty(page) || PageWriteback(page) ||
+	    page_mapped(page))
+		return page;
+
+	/* returns with the page locked if the pipe holds the only reference */
+	if (buf->ops->steal(pipe, buf))
+		return page;
+
+	/*
+	 * Stealing a page cache buffer took the page out of its file; if
+	 * it is not moved after all, the data is still good to copy.
+	 */
+	buf->ops = &user_page_pipe_buf_ops;
+
+	/* a gifted anonymous page still belongs to the swap side of the vm */
+	if (new->mapping || PageSwapBacked(new))
+		goto fail;
+
+	if (replace_page_cache_page(page, new, GFP_KERNEL))
+		goto fail;
+
+	if (page_has_buffers(page)) {
+		head = page_buffers(page);
+		ClearPagePrivate(page);
+		set_page_private(page, 0);
+		put_page(page);
+
+		bh = head;
+		do {
+			set_bh_page(bh, new, bh_offset(bh));
+			bh = bh->b_this_page;
+		} while (bh != head);
+		attach_page_buffers(new, head);
+	}
+
+	if (!(buf->flags & PIPE_BUF_FLAG_LRU))
+		lru_cache_add_file(new);
+
+	/* ->write_end() unlocks and releases it as it would have @page */
+	page_cache_get(new);
+	unlock_page(page);
+	page_cache_release(page);
+	return new;
+
+fail:
+	unlock_page(new);
+	return page;
+}
+
 /*
  * This is a little more tricky than the file -> pipe splicing. There are
  * basically three cases:
@@ -748,6 +826,9 @@ int pipe_to_file(struct pipe_inode_info *pipe, struct pipe_buffer *buf,
 	if (unlikely(ret))
 		goto out;
 
+	if ((sd->flags & SPLICE_F_MOVE) && this_len == PAGE_CACHE_SIZE)
+		page = splice_move_page(pipe, buf, page);
+
 	if (buf->page != page) {
 		char *src = buf->ops->map(pipe, buf, 1);
 		char *dst = kmap_atomic(page);
@@ -756,7 +837,9 @@ int pipe_to_file(struct pipe_inode_info *pipe, struct pipe_buffer *buf,
 		flush_dcache_page(page);
 		kunmap_atomic(dst);
 		buf->ops->unmap(pipe, buf, src);
-	}
+		count_vm_event(SPLICE_PAGE_COPIED);
+	} else
+		count_vm_event(SPLICE_PAGE_MOVED);
 	ret = pagecache_write_end(file, mapping, sd->pos, this_len, this_len,
 				page, fsdata);
 out:
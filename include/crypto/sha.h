@@ -90,6 +90,11 @@ extern int crypto_sha1_update(struct shash_desc *desc, const u8 *data,
 extern int crypto_sha256_update(struct shash_desc *desc, const u8 *data,
 			      unsigned int len);
 
+/* Multi-buffer sha256, provided by sha256-neon; see symbol_get() */
+extern int sha256_finup_mb(const u8 *prefix, unsigned int plen,
+			   const u8 * const data[], unsigned int len,
+			   u8 * const out[], unsigned int n);
+
 extern int crypto_sha512_update(struct shash_desc *desc, const u8 *data,
 			      unsigned int len);
 #endif
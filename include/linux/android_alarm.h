@@ -80,6 +80,15 @@ void alarm_update_timedelta(struct timespec tv, struct timespec ts);
 
 #endif
 
+/*
+ * A tolerant alarm.  The kernel lines its wakeup up with other wakeups
+ * that happen inside [start, end] instead of waking up just for it.
+ */
+struct android_alarm_window {
+	struct timespec start;
+	struct timespec end;
+};
+
 enum android_alarm_return_flags {
 	ANDROID_ALARM_RTC_WAKEUP_MASK = 1U << ANDROID_ALARM_RTC_WAKEUP,
 	ANDROID_ALARM_RTC_MASK = 1U << ANDROID_ALARM_RTC,
@@ -104,6 +113,9 @@ enum android_alarm_return_flags {
 #define ANDROID_ALARM_SET_AND_WAIT(type)    ALARM_IOW(3, type, struct timespec)
 #define ANDROID_ALARM_GET_TIME(type)        ALARM_IOW(4, type, struct timespec)
 #define ANDROID_ALARM_SET_RTC               _IOW('a', 5, struct timespec)
+/* Set a wakeup alarm that may go off anywhere from start to end */
+#define ANDROID_ALARM_SET_WINDOW(type)      ALARM_IOW(6, type, \
+						struct android_alarm_window)
 #define ANDROID_ALARM_BASE_CMD(cmd)         (cmd & ~(_IOC(0, 0, 0xf0, 0)))
 #define ANDROID_ALARM_IOCTL_TO_TYPE(cmd)    (_IOC_NR(cmd) >> 4)
 
@@ -95,6 +95,15 @@ struct backing_dev_info {
 	unsigned int min_ratio;
 	unsigned int max_ratio, max_prop_frac;
 
+	/*
+	 * Dirtiers in a blkio cgroup with a dirty_ratio below 100 are
+	 * throttled harder while the smoothed read latency of the device
+	 * is above @latency_target_us (0 disables the latency target).
+	 */
+	unsigned int latency_target_us;
+	unsigned long read_latency_us;
+	unsigned long read_latency_stamp;
+
 	struct bdi_writeback wb;  /* default writeback info for this bdi */
 	spinlock_t wb_lock;	  /* protects work_list */
 
@@ -111,6 +120,36 @@ struct backing_dev_info {
 };
 
 int bdi_init(struct backing_dev_info *bdi);
+
+/* A latency sample older than this no longer throttles anybody */
+#define BDI_READ_LATENCY_VALID	HZ
+
+/*
+ * Feed a read completion latency into the bdi's moving average. A sample
+ * arriving after an idle period restarts the average.
+ */
+static inline void bdi_update_read_latency(struct backing_dev_info *bdi,
+					   unsigned long usecs)
+{
+	if (!bdi->latency_target_us)
+		return;
+
+	if (time_after(jiffies, bdi->read_latency_stamp +
+		       BDI_READ_LATENCY_VALID))
+		bdi->read_latency_us = usecs;
+	else
+		bdi->read_latency_us = (7 * bdi->read_latency_us + usecs) / 8;
+	bdi->read_latency_stamp = jiffies;
+}
+
+/* Recent average read latency, 0 if there was no read lately */
+static inline unsigned long bdi_read_latency(struct backing_dev_info *bdi)
+{
+	if (time_after(jiffies, bdi->read_latency_stamp +
+		       BDI_READ_LATENCY_VALID))
+		return 0;
+	return bdi->read_latency_us;
+}
 void bdi_destroy(struct backing_dev_info *bdi);
 
 int bdi_register(struct backing_dev_info *bdi, struct device *parent,
@@ -72,6 +72,23 @@ struct pc_temp_ocv_lut {
 	int ocv[PC_TEMP_ROWS][PC_TEMP_COLS];
 };
 
+/**
+ * struct ocv_temp_cache -
+ * @valid:	whether @ocv holds the column for @batt_temp
+ * @batt_temp:	the temperature the column was interpolated at
+ * @ocv:	the ocv of each percent charge row of a pc_temp_ocv_lut
+ *		at @batt_temp
+ * @hits:	lookups served from the cached column
+ * @misses:	lookups that had to interpolate a new column
+ */
+struct ocv_temp_cache {
+	int		valid;
+	int		batt_temp;
+	int		ocv[PC_TEMP_ROWS];
+	unsigned long	hits;
+	unsigned long	misses;
+};
+
 struct batt_ids {
 	int kohm[MAX_BATT_ID_NUM];
 	int num;
@@ -148,6 +165,9 @@ int interpolate_pc(struct pc_temp_ocv_lut *pc_temp_ocv,
 				int batt_temp_degc, int ocv);
 int interpolate_ocv(struct pc_temp_ocv_lut *pc_temp_ocv,
 				int batt_temp_degc, int pc);
+int interpolate_ocv_cached(struct pc_temp_ocv_lut *pc_temp_ocv,
+				struct ocv_temp_cache *cache,
+				int batt_temp_degc, int pc);
 int linear_interpolate(int y0, int x0, int y1, int x1, int x);
 int is_between(int left, int right, int value);
 #else
@@ -176,6 +196,13 @@ static inline int interpolate_ocv(struct pc_temp_ocv_lut *pc_temp_ocv,
 {
 	return -EINVAL;
 }
+static inline int interpolate_ocv_cached(
+			struct pc_temp_ocv_lut *pc_temp_ocv,
+			struct ocv_temp_cache *cache,
+			int batt_temp_degc, int pc)
+{
+	return -EINVAL;
+}
 static inline int linear_interpolate(int y0, int x0, int y1, int x1, int x)
 {
 	return -EINVAL;
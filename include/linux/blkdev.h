@@ -9,6 +9,7 @@
 #include <linux/genhd.h>
 #include <linux/list.h>
 #include <linux/timer.h>
+#include <linux/ktime.h>
 #include <linux/workqueue.h>
 #include <linux/pagemap.h>
 #include <linux/backing-dev.h>
@@ -73,6 +74,48 @@ enum rq_cmd_type_bits {
 
 #define BLK_MAX_CDB	16
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+/*
+ * Stages of a request's life, from insertion into the queue to the
+ * completion. All are accounted separately for reads and writes.
+ *
+ * ELEVATOR:	inserted -> moved to the dispatch queue
+ * DISPATCH:	dispatch queue -> taken by the driver (blk_start_request)
+ * DRIVER:	taken by the driver -> completed
+ * PREP:	taken by the driver -> command sent	(driver stamped)
+ * XFER:	command sent -> data transfer done	(driver stamped)
+ * BUSY:	data transfer done -> completed		(driver stamped)
+ * TOTAL:	inserted -> completed
+ */
+enum blk_lat_stage {
+	BLK_LAT_ELEVATOR,
+	BLK_LAT_DISPATCH,
+	BLK_LAT_DRIVER,
+	BLK_LAT_PREP,
+	BLK_LAT_XFER,
+	BLK_LAT_BUSY,
+	BLK_LAT_TOTAL,
+	BLK_LAT_NR_STAGES,
+};
+
+/* bucket i counts latencies below 2^i us, the last one everything else */
+#define BLK_LAT_BUCKETS		24
+
+struct blk_rq_lat {
+	ktime_t insert;
+	ktime_t dispatch;
+	ktime_t issue;
+	ktime_t cmd;
+	ktime_t data;
+};
+
+/* Updated at completion, under the queue lock */
+struct blk_latency_hist {
+	unsigned int count[2][BLK_LAT_NR_STAGES][BLK_LAT_BUCKETS];
+	unsigned int max_us[2][BLK_LAT_NR_STAGES];
+};
+#endif
+
 /*
  * try to put the fields that are referenced together in the same cacheline.
  * if you modify this structure, be sure to check block/blk-core.c:blk_rq_init()
@@ -133,6 +176,9 @@ struct request {
 #ifdef CONFIG_BLK_CGROUP
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
+#endif
+#ifdef CONFIG_BLK_LATENCY_HIST
+	struct blk_rq_lat lat;
 #endif
 	/* Number of scatter-gather DMA addr+len pairs after
 	 * physical address coalescing is performed.
@@ -409,6 +455,10 @@ struct request_queue {
 	/* Throttle data */
 	struct throtl_data *td;
 #endif
+
+#ifdef CONFIG_BLK_LATENCY_HIST
+	struct blk_latency_hist lat_hist;
+#endif
 };
 
 #define QUEUE_FLAG_QUEUED	1	/* uses generic tag queueing */
@@ -1246,6 +1296,25 @@ static inline uint64_t rq_io_start_time_ns(struct request *req)
 }
 #endif
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+/*
+ * blk_rq_lat_driver_times() - Report when the driver sent the command of
+ *			       @req and when its data transfer finished, for
+ *			       the PREP, XFER and BUSY latency stages. Either
+ *			       may be zero if unknown. Call before completing
+ *			       the request.
+ */
+static inline void blk_rq_lat_driver_times(struct request *req,
+					   ktime_t cmd, ktime_t data)
+{
+	req->lat.cmd = cmd;
+	req->lat.data = data;
+}
+#else
+static inline void blk_rq_lat_driver_times(struct request *req,
+					   ktime_t cmd, ktime_t data) {}
+#endif
+
 #define MODULE_ALIAS_BLOCKDEV(major,minor) \
 	MODULE_ALIAS("block-major-" __stringify(major) "-" __stringify(minor))
 #define MODULE_ALIAS_BLOCKDEV_MAJOR(major) \
@@ -0,0 +1,45 @@
+/*
+ * boot_timeline.h: record where the time goes during boot
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ */
+#ifndef _LINUX_BOOT_TIMELINE_H
+#define _LINUX_BOOT_TIMELINE_H
+
+#include <linux/types.h>
+#include <linux/compiler.h>
+
+enum boot_timeline_type {
+	BOOT_EV_INITCALL,
+	BOOT_EV_PROBE,
+	BOOT_EV_PROBE_DEFER,
+	BOOT_EV_FIRMWARE,
+	BOOT_EV_MODULE,
+};
+
+#ifdef CONFIG_BOOT_TIMELINE
+extern u64 boot_timeline_start(void);
+extern __printf(3, 4)
+void boot_timeline_end(enum boot_timeline_type type, u64 start,
+		       const char *fmt, ...);
+extern void boot_timeline_set_base(u64 now_ns);
+#else
+static inline u64 boot_timeline_start(void)
+{
+	return 0;
+}
+
+static inline __printf(3, 4)
+void boot_timeline_end(enum boot_timeline_type type, u64 start,
+		       const char *fmt, ...)
+{
+}
+
+static inline void boot_timeline_set_base(u64 now_ns)
+{
+}
+#endif
+
+#endif /* _LINUX_BOOT_TIMELINE_H */
@@ -0,0 +1,54 @@
+/*
+ * cgroup_timer_slack.h - timer slack cgroup controller
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ */
+#ifndef _LINUX_CGROUP_TIMER_SLACK_H
+#define _LINUX_CGROUP_TIMER_SLACK_H
+
+#include <linux/hrtimer.h>
+#include <linux/sched.h>
+
+#ifdef CONFIG_CGROUP_TIMER_SLACK
+extern unsigned long task_timer_slack_min(struct task_struct *p);
+extern bool task_timers_deferrable(struct task_struct *p);
+extern void timer_slack_count_coalesced(struct task_struct *p);
+extern void timer_slack_count_deferred(struct task_struct *p);
+
+/*
+ * A sleeper's hrtimer that runs before its hard expiry was run early,
+ * inside its slack, by a wakeup that was happening anyway.
+ */
+static inline void timer_slack_hrtimer_expired(struct hrtimer *timer,
+					       struct task_struct *p)
+{
+	s64 hard = hrtimer_get_expires_tv64(timer);
+
+	if (hrtimer_get_softexpires_tv64(timer) != hard &&
+	    timer->base->get_time().tv64 < hard)
+		timer_slack_count_coalesced(p);
+}
+#else
+static inline unsigned long task_timer_slack_min(struct task_struct *p)
+{
+	return 0;
+}
+
+static inline bool task_timers_deferrable(struct task_struct *p)
+{
+	return false;
+}
+
+static inline void timer_slack_count_deferred(struct task_struct *p)
+{
+}
+
+static inline void timer_slack_hrtimer_expired(struct hrtimer *timer,
+					       struct task_struct *p)
+{
+}
+#endif
+
+#endif /* _LINUX_CGROUP_TIMER_SLACK_H */
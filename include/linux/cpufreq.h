@@ -31,10 +31,17 @@
 
 #define CPUFREQ_TRANSITION_NOTIFIER	(0)
 #define CPUFREQ_POLICY_NOTIFIER		(1)
+#define CPUFREQ_FRAME_NOTIFIER		(2)
+
+/* Frame notifier events; data points to the frame deadline in usecs */
+#define CPUFREQ_FRAME_LATE		(0)	/* a frame missed its vsync */
+#define CPUFREQ_FRAME_BURST		(1)	/* back to back commits began */
+#define CPUFREQ_FRAME_ON_TIME		(2)	/* a frame made its vsync */
 
 #ifdef CONFIG_CPU_FREQ
 int cpufreq_register_notifier(struct notifier_block *nb, unsigned int list);
 int cpufreq_unregister_notifier(struct notifier_block *nb, unsigned int list);
+void cpufreq_notify_frame(unsigned long event, unsigned int deadline_us);
 extern void disable_cpufreq(void);
 #else		/* CONFIG_CPU_FREQ */
 static inline int cpufreq_register_notifier(struct notifier_block *nb,
@@ -47,6 +54,8 @@ static inline int cpufreq_unregister_notifier(struct notifier_block *nb,
 {
 	return 0;
 }
+static inline void cpufreq_notify_frame(unsigned long event,
+					unsigned int deadline_us) { }
 static inline void disable_cpufreq(void) { }
 #endif		/* CONFIG_CPU_FREQ */
 
@@ -357,6 +366,53 @@ static inline unsigned int cpufreq_quick_get_max(unsigned int cpu)
 #endif
 
 
+/*********************************************************************
+ *                    FREQUENCY LIMIT AGGREGATION                    *
+ *********************************************************************/
+
+/**
+ * struct cpufreq_limit - one client's min/max request for every cpu
+ * @name:	shown in the debugfs summary and in the debug log
+ * @min:	requested floor per cpu in kHz, 0 for none
+ * @max:	requested ceiling per cpu in kHz, UINT_MAX for none
+ *
+ * All registered requests are resolved into one effective limit per
+ * cpu: the highest floor and the lowest ceiling. A ceiling always wins
+ * over a floor. The policy is only re-evaluated when the effective
+ * limit of a cpu changes.
+ */
+struct cpufreq_limit {
+	const char *name;
+	struct list_head node;
+	unsigned int min[NR_CPUS];
+	unsigned int max[NR_CPUS];
+};
+
+#ifdef CONFIG_CPU_FREQ
+int cpufreq_limit_register(struct cpufreq_limit *limit);
+void cpufreq_limit_unregister(struct cpufreq_limit *limit);
+int cpufreq_limit_set(struct cpufreq_limit *limit, unsigned int cpu,
+		      unsigned int min, unsigned int max);
+#else
+static inline int cpufreq_limit_register(struct cpufreq_limit *limit)
+{
+	return 0;
+}
+static inline void cpufreq_limit_unregister(struct cpufreq_limit *limit) {}
+static inline int cpufreq_limit_set(struct cpufreq_limit *limit,
+		unsigned int cpu, unsigned int min, unsigned int max)
+{
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_CPU_BOOST
+void cpu_boost_touch_irq(void);
+#else
+static inline void cpu_boost_touch_irq(void) {}
+#endif
+
+
 /*********************************************************************
  *                       CPUFREQ DEFAULT GOVERNOR                    *
  *********************************************************************/
@@ -189,6 +189,8 @@ extern struct klist *bus_get_device_klist(struct bus_type *bus);
  * @owner:	The module owner.
  * @mod_name:	Used for built-in modules.
  * @suppress_bind_attrs: Disables bind/unbind via sysfs.
+ * @async_probe: Probe the devices already present when the driver is
+ *		registered from an async thread instead of the caller.
  * @of_match_table: The open firmware table.
  * @probe:	Called to query the existence of a specific device,
  *		whether this driver can work with it, and bind the driver
@@ -221,6 +223,7 @@ struct device_driver {
 	const char		*mod_name;	/* used for built-in modules */
 
 	bool suppress_bind_attrs;	/* disables bind/unbind via sysfs */
+	bool async_probe;		/* attach from the async probe domain */
 
 	const struct of_device_id	*of_match_table;
 
@@ -244,6 +247,7 @@ extern struct device_driver *driver_find(const char *name,
 					 struct bus_type *bus);
 extern int driver_probe_done(void);
 extern void wait_for_device_probe(void);
+extern void wait_for_async_probe(void);
 
 
 /* sysfs interface for exporting driver attributes */
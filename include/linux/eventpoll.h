@@ -26,6 +26,9 @@
 #define EPOLL_CTL_DEL 2
 #define EPOLL_CTL_MOD 3
 
+/* Set exclusive wakeup mode for the target file descriptor */
+#define EPOLLEXCLUSIVE (1 << 28)
+
 /* Set the One Shot behaviour for the target file descriptor */
 #define EPOLLONESHOT (1 << 30)
 
@@ -96,10 +99,17 @@ static inline void eventpoll_release(struct file *file)
 	eventpoll_release_file(file);
 }
 
+/* Appends the epoll statistics to /proc/<pid>/fdinfo/<fd> */
+int eventpoll_fdinfo(struct file *file, char *buf, size_t size);
+
 #else
 
 static inline void eventpoll_init_file(struct file *file) {}
 static inline void eventpoll_release(struct file *file) {}
+static inline int eventpoll_fdinfo(struct file *file, char *buf, size_t size)
+{
+	return 0;
+}
 
 #endif
 
@@ -1079,6 +1079,13 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+
+	pgoff_t mmap_prev;		/* Page of the last mmap fault */
+	int mmap_score;			/* > 0: faults look sequential,
+					   < 0: faults look random */
+	unsigned int ra_submitted;	/* pages read in by readahead */
+	unsigned int ra_hits;		/* page cache hits of reads/faults */
+	unsigned int ra_misses;		/* page cache misses of reads/faults */
 };
 
 /*
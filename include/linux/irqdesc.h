@@ -64,6 +64,12 @@ struct irq_desc {
 #ifdef CONFIG_GENERIC_PENDING_IRQ
 	cpumask_var_t		pending_mask;
 #endif
+#endif
+#ifdef CONFIG_IRQ_BALANCE
+	u64			balance_ns;	/* time spent in the handlers */
+	u64			balance_last_ns;
+	unsigned int		balance_last_count;
+	int			balance_cpu;	/* where the balancer put it, or -1 */
 #endif
 	unsigned long		threads_oneshot;
 	atomic_t		threads_active;
@@ -24,6 +24,8 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags);
 int __ksm_enter(struct mm_struct *mm);
 void __ksm_exit(struct mm_struct *mm);
+void ksm_mm_stat(struct mm_struct *mm, unsigned long *pages_scanned,
+		 unsigned long *pages_merged);
 
 static inline int ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
 {
@@ -0,0 +1,46 @@
+#ifndef _LINUX_LAUNCH_PREFETCH_H
+#define _LINUX_LAUNCH_PREFETCH_H
+
+#include <linux/fs.h>
+#include <linux/sched.h>
+
+#ifdef CONFIG_LAUNCH_PREFETCH
+/* tgid of the process whose page cache accesses are recorded, 0 if none */
+extern pid_t launch_prefetch_tgid;
+
+extern void __launch_prefetch_record(struct file *file, pgoff_t index);
+
+/*
+ * Called for every page looked up on behalf of a read or a fault. It is
+ * a single compare unless a launch is being recorded.
+ */
+static inline void launch_prefetch_record(struct file *file, pgoff_t index)
+{
+	if (unlikely(launch_prefetch_tgid) &&
+	    current->tgid == launch_prefetch_tgid)
+		__launch_prefetch_record(file, index);
+}
+
+/* Last app launch tagged by userspace, for the I/O schedulers */
+extern pid_t launch_prefetch_launch_tgid;
+extern unsigned long launch_prefetch_launch_time;
+
+/* Was @tgid tagged as launching within the last @window jiffies? */
+static inline bool launch_prefetch_launching(pid_t tgid, unsigned long window)
+{
+	return tgid == ACCESS_ONCE(launch_prefetch_launch_tgid) &&
+	       time_before(jiffies,
+			   ACCESS_ONCE(launch_prefetch_launch_time) + window);
+}
+#else
+static inline void launch_prefetch_record(struct file *file, pgoff_t index)
+{
+}
+
+static inline bool launch_prefetch_launching(pid_t tgid, unsigned long window)
+{
+	return false;
+}
+#endif
+
+#endif /* _LINUX_LAUNCH_PREFETCH_H */
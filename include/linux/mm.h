@@ -43,6 +43,8 @@ extern int sysctl_legacy_va_layout;
 #define sysctl_legacy_va_layout 0
 #endif
 
+extern int sysctl_fork_lazy_ptes;
+
 #ifdef CONFIG_HAVE_ARCH_MMAP_RND_BITS
 extern const int mmap_rnd_bits_min;
 extern const int mmap_rnd_bits_max;
@@ -1010,6 +1012,24 @@ extern int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 			unsigned long address, unsigned int flags);
 extern int fixup_user_fault(struct task_struct *tsk, struct mm_struct *mm,
 			    unsigned long address, unsigned int fault_flags);
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+extern int handle_speculative_fault(struct mm_struct *mm,
+			unsigned long address, unsigned int flags,
+			unsigned long vm_flags_mask);
+
+static inline void mm_seq_write_begin(struct mm_struct *mm)
+{
+	write_seqcount_begin(&mm->mm_seq);
+}
+
+static inline void mm_seq_write_end(struct mm_struct *mm)
+{
+	write_seqcount_end(&mm->mm_seq);
+}
+#else
+static inline void mm_seq_write_begin(struct mm_struct *mm) { }
+static inline void mm_seq_write_end(struct mm_struct *mm) { }
+#endif
 #else
 static inline int handle_mm_fault(struct mm_struct *mm,
 			struct vm_area_struct *vma, unsigned long address,
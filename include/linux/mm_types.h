@@ -11,6 +11,7 @@
 #include <linux/rbtree.h>
 #include <linux/rwsem.h>
 #include <linux/completion.h>
+#include <linux/seqlock.h>
 #include <linux/cpumask.h>
 #include <linux/page-debug-flags.h>
 #include <asm/page.h>
@@ -22,6 +23,7 @@
 #define AT_VECTOR_SIZE (2*(AT_VECTOR_SIZE_ARCH + AT_VECTOR_SIZE_BASE + 1))
 
 struct address_space;
+struct futex_private_hash;
 
 #define USE_SPLIT_PTLOCKS	(NR_CPUS >= CONFIG_SPLIT_PTLOCK_CPUS)
 
@@ -263,6 +265,9 @@ struct vm_area_struct {
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
 #endif
+#ifdef CONFIG_SWAP
+	atomic_long_t swap_readahead_info; /* swapin readahead window state */
+#endif
 };
 
 struct core_thread {
@@ -318,6 +323,22 @@ struct mm_struct {
 
 	spinlock_t page_table_lock;		/* Protects page tables and some counters */
 	struct rw_semaphore mmap_sem;
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	/*
+	 * Bumped, under mmap_sem held for writing, around every change to
+	 * a vma's range, flags or protection and around unmapping, so that
+	 * handle_speculative_fault() can tell a vma it read without mmap_sem
+	 * is still valid.
+	 */
+	seqcount_t mm_seq;
+	atomic_long_t spf_success;		/* faults handled without mmap_sem */
+	atomic_long_t spf_retry;		/* ... that fell back to the locked path */
+#endif
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+	struct futex_private_hash *futex_hash;	/* private futex buckets, set once */
+	atomic_long_t futex_waits;		/* futex waiters queued */
+	atomic_long_t futex_collisions;		/* ... behind another futex's waiters */
+#endif
 
 	struct list_head mmlist;		/* List of maybe swapped mm's.	These are globally strung
 						 * together off init_mm.mmlist, and are protected
@@ -226,6 +226,7 @@ enum mmc_packed_stop_reasons {
 	LARGE_SEC_ALIGN,
 	RANDOM,
 	FUA,
+	READ_LATENCY,
 	MAX_REASONS,
 };
 
@@ -245,9 +246,14 @@ enum mmc_blk_status {
 	MMC_BLK_BUS_ERR,
 };
 
+/* log2 buckets: [0] counts values < 2, [n] counts [2^n, 2^(n+1)) */
+#define MMC_PACK_HIST_BUCKETS	16
+
 struct mmc_wr_pack_stats {
 	u32 *packing_events;
 	u32 pack_stop_reason[MAX_REASONS];
+	u32 pack_sectors_hist[MMC_PACK_HIST_BUCKETS];
+	u32 read_delay_hist[MMC_PACK_HIST_BUCKETS];	/* usecs */
 	spinlock_t lock;
 	bool enabled;
 	bool print_in_read;
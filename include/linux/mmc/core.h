@@ -11,6 +11,7 @@
 #ifdef __KERNEL__
 #include <linux/interrupt.h>
 #include <linux/completion.h>
+#include <linux/ktime.h>
 
 struct request;
 struct mmc_data;
@@ -139,6 +140,10 @@ struct mmc_request {
 	struct completion	completion;
 	void			(*done)(struct mmc_request *);/* completion function */
 	struct mmc_host		*host;
+#ifdef CONFIG_BLK_LATENCY_HIST
+	ktime_t			cmd_time;	/* handed to the host driver */
+	ktime_t			data_time;	/* data transfer completed */
+#endif
 };
 
 struct mmc_card;
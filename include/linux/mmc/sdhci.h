@@ -21,6 +21,7 @@
 struct sdhci_next {
 	unsigned int sg_count;
 	s32 cookie;
+	bool adma_ready;	/* next_adma_desc holds the table for cookie */
 };
 
 enum sdhci_power_policy {
@@ -222,6 +223,17 @@ struct sdhci_host {
 
 	dma_addr_t adma_addr;	/* Mapped ADMA descr. table */
 	dma_addr_t align_addr;	/* Mapped bounce buffer */
+	bool align_mapped;	/* align_addr valid for the current request */
+
+	u8 *next_adma_desc;	/* Table pre-built in pre_req */
+	dma_addr_t next_adma_addr;
+
+	/* host side cost of setting up DMA, see req_overhead in sysfs */
+	unsigned long req_inline;	/* tables built at request time */
+	u64 req_inline_ns;
+	unsigned long req_prebuilt;	/* tables built ahead in pre_req */
+	u64 req_prebuild_ns;
+	struct device_attribute req_overhead;
 
 	struct tasklet_struct card_tasklet;	/* Tasklet structures */
 	struct tasklet_struct finish_tasklet;
@@ -237,8 +237,23 @@ struct per_cpu_pages {
 	struct list_head lists[MIGRATE_PCPTYPES];
 };
 
+#ifdef CONFIG_PCP_HIGH_ORDER
+#define NR_PCP_HIGH_ORDERS	2
+
+/* Per-cpu list of free MIGRATE_UNMOVABLE pages of one order above 0 */
+struct per_cpu_high_pages {
+	int count;		/* number of blocks in the list */
+	int high;		/* high watermark, emptying needed */
+	int batch;		/* chunk size for buddy add/remove */
+	struct list_head list;
+};
+#endif
+
 struct per_cpu_pageset {
 	struct per_cpu_pages pcp;
+#ifdef CONFIG_PCP_HIGH_ORDER
+	struct per_cpu_high_pages hpcp[NR_PCP_HIGH_ORDERS];
+#endif
 #ifdef CONFIG_NUMA
 	s8 expire;
 #endif
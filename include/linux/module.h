@@ -265,6 +265,11 @@ struct module
 	const unsigned long *gpl_future_crcs;
 	unsigned int num_gpl_future_syms;
 
+#ifdef CONFIG_MODULE_SYMBOL_HASH
+	/* This module's exports in the kernel-wide symbol hash. */
+	struct ksym_table *ksym_table;
+#endif
+
 	/* Exception table */
 	unsigned int num_exentries;
 	struct exception_table_entry *extable;
@@ -20,6 +20,9 @@ struct xstats {
 	u64 ram_time;
 	u64 ram_wait;
 	int mod;
+	/* end of frame command batches retired and the longest, in usecs */
+	u32 frames;
+	u32 frame_max;
 };
 
 struct devfreq_msm_adreno_tz_data {
@@ -44,6 +47,17 @@ struct devfreq_msm_adreno_tz_data {
 	unsigned int device_id;
 };
 
+struct devfreq_msm_adreno_frame_data {
+	struct notifier_block nb;
+	struct {
+		s64 total_time;
+		s64 busy_time;
+		u32 frames;
+		u32 frame_max;
+	} bin;
+	unsigned int device_id;
+};
+
 struct devfreq_conservative_data {
 	struct {
 		unsigned long total_time;
@@ -40,7 +40,14 @@
 /* This is a cmdbatch exclusive flag - use the CMDBATCH equivalent instead */
 #define KGSL_CONTEXT_SYNC               0x00000400
 #define KGSL_CONTEXT_PWR_CONSTRAINT     0x00000800
-/* bits [12:15] are reserved for future use */
+/*
+ * Dispatch priority of the context, 1 (highest) to 15 (lowest). 0 means
+ * the default priority. Asking for more than the default needs
+ * CAP_SYS_NICE.
+ */
+#define KGSL_CONTEXT_PRIORITY_MASK      0x0000F000
+#define KGSL_CONTEXT_PRIORITY_SHIFT     12
+#define KGSL_CONTEXT_PRIORITY_UNDEF     0
 #define KGSL_CONTEXT_TYPE_MASK          0x01F00000
 #define KGSL_CONTEXT_TYPE_SHIFT         20
 #define KGSL_CONTEXT_TYPE_ANY		0
@@ -234,6 +241,7 @@ enum kgsl_property_type {
 	KGSL_PROP_GPU_RESET_STAT  = 0x00000009,
 	KGSL_PROP_PWRCTRL         = 0x0000000E,
 	KGSL_PROP_PWR_CONSTRAINT  = 0x00000012,
+	KGSL_PROP_CONTEXT_PRIORITY = 0x00000013,
 };
 
 struct kgsl_shadowprop {
@@ -953,6 +961,20 @@ struct kgsl_device_constraint_pwrlevel {
 	unsigned int level;
 };
 
+/**
+ * struct kgsl_context_priority - KGSL_PROP_CONTEXT_PRIORITY argument
+ * @context_id: KGSL context ID
+ * @priority: new dispatch priority, see KGSL_CONTEXT_PRIORITY_MASK
+ *
+ * A process may lower the priority of its own contexts. Raising a priority
+ * above the default or changing the context of another process, as a
+ * compositor does for the foreground application, needs CAP_SYS_NICE.
+ */
+struct kgsl_context_priority {
+	unsigned int context_id;
+	unsigned int priority;
+};
+
 #ifdef __KERNEL__
 #ifdef CONFIG_MSM_KGSL_DRM
 int kgsl_gem_obj_addr(int drm_fd, int handle, unsigned long *start,
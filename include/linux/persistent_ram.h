@@ -19,6 +19,7 @@
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/types.h>
+#include <linux/workqueue.h>
 
 struct persistent_ram_buffer;
 
@@ -59,6 +60,11 @@ struct persistent_ram_zone {
 	int ecc_size;
 	int ecc_symsize;
 	int ecc_poly;
+#ifdef CONFIG_ANDROID_PERSISTENT_RAM_DEFERRED_ECC
+	int ecc_blocks;
+	unsigned long *ecc_dirty;	/* stale blocks, then the header */
+	struct delayed_work ecc_work;
+#endif
 
 	char *old_log;
 	size_t old_log_size;
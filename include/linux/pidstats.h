@@ -0,0 +1,53 @@
+/* pidstats.h - binary per-process statistics in /proc/pidstats
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ */
+
+#ifndef _LINUX_PIDSTATS_H
+#define _LINUX_PIDSTATS_H
+
+#include <linux/types.h>
+
+/*
+ * A read of /proc/pidstats returns one struct pidstats_header followed
+ * by nr_records records of record_size bytes, one per process. Fields
+ * are only ever appended to the record: a reader built against an
+ * older version uses header_size and record_size to step over what it
+ * does not know, and checks version before using anything added later.
+ */
+#define PIDSTATS_VERSION	1
+
+struct pidstats_header {
+	__u32	version;
+	__u32	header_size;
+	__u32	record_size;
+	__u32	nr_records;
+};
+
+struct pidstats_record {
+	__s32	pid;
+	__s32	ppid;
+	__u32	uid;
+	__u32	nr_threads;
+	__s16	oom_score_adj;
+	__u8	state;		/* letter as in /proc/<pid>/stat */
+	__u8	__pad[5];
+
+	__u64	rss_anon_kb;
+	__u64	rss_file_kb;
+	__u64	swap_kb;
+	/*
+	 * rss with anon and file pages scaled by how much they are shared
+	 * across the whole system, without walking the page tables
+	 */
+	__u64	pss_estimate_kb;
+
+	__u64	utime_us;
+	__u64	stime_us;
+	__u64	min_flt;
+	__u64	maj_flt;
+};
+
+#endif /* _LINUX_PIDSTATS_H */
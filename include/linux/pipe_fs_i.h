@@ -42,6 +42,9 @@ struct pipe_buffer {
  *	@inode: inode this pipe is attached to
  *	@bufs: the circular array of pipe buffers
  *	@user: the user who created this pipe
+ *	@nr_fills: times writers found the pipe full since @fill_stamp
+ *	@fill_stamp: jiffies when @nr_fills started counting
+ *	@size_fixed: size was set with F_SETPIPE_SZ, don't grow it
  **/
 struct pipe_inode_info {
 	wait_queue_head_t wait;
@@ -57,6 +60,9 @@ struct pipe_inode_info {
 	struct inode *inode;
 	struct pipe_buffer *bufs;
 	struct user_struct *user;
+	unsigned int nr_fills;
+	unsigned long fill_stamp;
+	bool size_fixed;
 };
 
 /*
@@ -150,6 +156,9 @@ int pipe_proc_fn(struct ctl_table *, int, void __user *, size_t *, loff_t *);
 /* Drop the inode semaphore and wait for a pipe event, atomically */
 void pipe_wait(struct pipe_inode_info *pipe);
 
+/* Called by writers about to wait for room, with the pipe locked */
+bool pipe_grow_when_full(struct pipe_inode_info *pipe);
+
 struct pipe_inode_info * alloc_pipe_info(struct inode * inode);
 void free_pipe_info(struct inode * inode);
 void __free_pipe_info(struct pipe_inode_info *);
@@ -503,6 +503,17 @@ struct pm_subsys_data {
 #endif
 };
 
+#ifdef CONFIG_PM_SLEEP_LATENCY
+#define DPM_LATENCY_BUCKETS	8
+
+/* Callback times of one device in one direction, see sleep_latency.c */
+struct dev_pm_latency {
+	u32			count;
+	u32			max_us;
+	u32			hist[DPM_LATENCY_BUCKETS];
+};
+#endif
+
 struct dev_pm_info {
 	pm_message_t		power_state;
 	unsigned int		can_wakeup:1;
@@ -516,6 +527,9 @@ struct dev_pm_info {
 	struct completion	completion;
 	struct wakeup_source	*wakeup;
 	bool			wakeup_path:1;
+#ifdef CONFIG_PM_SLEEP_LATENCY
+	struct dev_pm_latency	latency[2];	/* suspend, resume */
+#endif
 #else
 	unsigned int		should_wakeup:1;
 #endif
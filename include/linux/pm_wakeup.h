@@ -35,6 +35,7 @@
  * @max_time: Maximum time this wakeup source has been continuously active.
  * @last_time: Monotonic clock when the wakeup source's was touched last time.
  * @prevent_sleep_time: Total time this source has been preventing autosleep.
+ * @exclusive_time: Total time this source has been the only one active.
  * @event_count: Number of signaled wakeup events.
  * @active_count: Number of times the wakeup sorce was activated.
  * @relax_count: Number of times the wakeup sorce was deactivated.
@@ -54,6 +55,9 @@ struct wakeup_source {
 	ktime_t last_time;
 	ktime_t start_prevent_time;
 	ktime_t prevent_sleep_time;
+	ktime_t exclusive_time;
+	ktime_t start_exclusive_time;
+	struct list_head	active_entry;
 	unsigned long		event_count;
 	unsigned long		active_count;
 	unsigned long		relax_count;
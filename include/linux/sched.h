@@ -145,6 +145,17 @@ extern unsigned long this_cpu_load(void);
 extern void sched_update_nr_prod(int cpu, unsigned long nr, bool inc);
 extern void sched_get_nr_running_avg(int *avg, int *iowait_avg);
 
+/*
+ * Called with the rq->lock of @cpu held whenever the nr_running of @cpu
+ * moves across @threshold, in either direction.
+ */
+struct sched_nr_hook {
+	void (*func)(struct sched_nr_hook *hook, int cpu, unsigned long nr);
+	unsigned long threshold;
+};
+
+extern void sched_set_nr_hook(int cpu, struct sched_nr_hook *hook);
+
 extern void calc_global_load(unsigned long ticks);
 extern void update_cpu_load_nohz(void);
 
@@ -153,6 +164,12 @@ extern unsigned long get_parent_ip(unsigned long addr);
 struct seq_file;
 struct cfs_rq;
 struct task_group;
+#ifdef CONFIG_SCHED_LATENCY
+extern unsigned int sysctl_sched_latency_dump_us;
+extern void proc_sched_latency_show_task(struct task_struct *p,
+					 struct seq_file *m);
+extern void proc_sched_latency_reset_task(struct task_struct *p);
+#endif
 #ifdef CONFIG_SCHED_DEBUG
 extern void proc_sched_show_task(struct task_struct *p, struct seq_file *m);
 extern void proc_sched_set_task(struct task_struct *p);
@@ -457,6 +474,7 @@ extern int get_dumpable(struct mm_struct *mm);
 					/* leave room for more dump flags */
 #define MMF_VM_MERGEABLE	16	/* KSM may merge identical pages */
 #define MMF_VM_HUGEPAGE		17	/* set when VM_HUGEPAGE is set on vma */
+#define MMF_UNSTABLE		18	/* reaped, faults must fail */
 
 #define MMF_INIT_MASK		(MMF_DUMPABLE_MASK | MMF_DUMP_FILTER_MASK)
 
@@ -772,6 +790,21 @@ extern struct user_struct root_user;
 struct backing_dev_info;
 struct reclaim_state;
 
+#ifdef CONFIG_SCHED_LATENCY
+/*
+ * Wakeup latency histogram: bucket 0 counts wakeups served within 1us,
+ * bucket n those served within [2^(n-1), 2^n) us; the last bucket is
+ * open-ended.
+ */
+#define SCHED_LATENCY_BUCKETS	16
+
+struct sched_latency {
+	u64 wakeup_stamp;	/* rq clock at ttwu, 0 when not waiting */
+	u64 max;		/* worst latency seen, in ns */
+	u32 hist[SCHED_LATENCY_BUCKETS];
+};
+#endif
+
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 struct sched_info {
 	/* cumulative counters */
@@ -1242,6 +1275,13 @@ struct sched_entity {
 
 	u64			nr_migrations;
 
+#ifdef CONFIG_SMP
+	/* cpu utilization between wakeups, for small task packing */
+	u64			pack_stamp;
+	u64			pack_runtime;
+	unsigned int		pack_util;
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	struct sched_statistics statistics;
 #endif
@@ -1287,6 +1327,12 @@ enum perf_event_task_context {
 	perf_nr_task_contexts,
 };
 
+struct task_pmu_counts {
+	u64 cycles;
+	u64 instructions;
+	u64 l2_misses;
+};
+
 struct task_struct {
 	volatile long state;	/* -1 unrunnable, 0 runnable, >0 stopped */
 	void *stack;
@@ -1345,6 +1391,9 @@ struct task_struct {
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 	struct sched_info sched_info;
 #endif
+#ifdef CONFIG_SCHED_LATENCY
+	struct sched_latency sched_latency;
+#endif
 
 	struct list_head tasks;
 #ifdef CONFIG_SMP
@@ -1611,6 +1660,10 @@ struct task_struct {
 #ifdef CONFIG_LATENCYTOP
 	int latency_record_count;
 	struct latency_record latency_record[LT_SAVECOUNT];
+#endif
+#ifdef CONFIG_MSM_TASK_PMU
+	/* PMU counts accumulated at context switch, see /proc/PID/task/TID/pmu */
+	struct task_pmu_counts pmu_counts;
 #endif
 	/*
 	 * time slack values; these are used to round up poll() and
@@ -2105,11 +2158,20 @@ extern void wake_up_idle_cpu(int cpu);
 static inline void wake_up_idle_cpu(int cpu) { }
 #endif
 
+#ifdef CONFIG_NO_HZ_FULL
+extern bool sched_can_stop_tick(void);
+#endif
+
 extern unsigned int sysctl_sched_latency;
 extern unsigned int sysctl_sched_min_granularity;
 extern unsigned int sysctl_sched_wakeup_granularity;
 extern unsigned int sysctl_sched_child_runs_first;
 extern unsigned int sysctl_sched_wake_to_idle;
+#ifdef CONFIG_SMP
+extern unsigned int sysctl_sched_packing;
+extern unsigned int sysctl_sched_small_task_pct;
+extern unsigned int sysctl_sched_pack_capacity_pct;
+#endif
 
 enum sched_tunable_scaling {
 	SCHED_TUNABLESCALING_NONE,
@@ -43,6 +43,15 @@ enum stat_item {
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
 	NR_SLUB_STAT_ITEMS };
 
+#ifdef CONFIG_SLUB_PROFILE
+/* Sampled latency of allocations or frees, in nanoseconds */
+struct kmem_cache_latency {
+	unsigned long samples;
+	u64 total_ns;
+	u64 max_ns;
+};
+#endif
+
 struct kmem_cache_cpu {
 	void **freelist;	/* Pointer to next available object */
 	unsigned long tid;	/* Globally unique transaction id */
@@ -52,6 +61,12 @@ struct kmem_cache_cpu {
 #ifdef CONFIG_SLUB_STATS
 	unsigned stat[NR_SLUB_STAT_ITEMS];
 #endif
+#ifdef CONFIG_SLUB_PROFILE
+	unsigned int profile_tick;	/* Operations since the last sample */
+	unsigned long refills;		/* Cpu slabs acquired while profiling */
+	struct kmem_cache_latency alloc_lat;
+	struct kmem_cache_latency free_lat;
+#endif
 };
 
 struct kmem_cache_node {
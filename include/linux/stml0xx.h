@@ -629,6 +629,20 @@ struct stml0xx_platform_data {
 	int accel_orientation_2;
 };
 
+struct stml0xx_work_struct {
+	/* Base struct */
+	struct work_struct ws;
+	/* Timestamp in nanoseconds */
+	uint64_t ts_ns;
+};
+
+struct stml0xx_delayed_work_struct {
+	/* Base struct */
+	struct delayed_work ws;
+	/* Timestamp in nanoseconds */
+	uint64_t ts_ns;
+};
+
 struct stml0xx_data {
 	struct stml0xx_platform_data *pdata;
 	struct mutex lock;
@@ -651,6 +665,9 @@ struct stml0xx_data {
 	struct mutex spi_lock;
 	unsigned char *spi_tx_buf;
 	unsigned char *spi_rx_buf;
+	struct device *spi_dma_dev;	/* buffers are mapped for this */
+	dma_addr_t spi_tx_dma;
+	dma_addr_t spi_rx_dma;
 
 	atomic_t enabled;
 	int irq;
@@ -687,25 +704,29 @@ struct stml0xx_data {
 	bool is_suspended;
 	bool pending_wake_work;
 
+	/*
+	 * Non-wake interrupts raised while a read of the hub is still
+	 * queued are folded into that read, which drains every sample
+	 * the hub queued up meanwhile in one transfer.
+	 */
+	struct stml0xx_work_struct irq_work;
+	spinlock_t irq_lock;
+	bool irq_pending;
+
+	/* interrupt counts, see the wakeups attribute */
+	unsigned int irq_count;
+	unsigned int irq_coalesced;
+	unsigned int wake_irq_count;
+	unsigned int stats_irq_count;
+	unsigned int stats_wake_irq_count;
+	unsigned long stats_jiffies;
+
 	struct led_classdev led_cdev;
 };
 
 #ifndef ts_to_ns
 # define ts_to_ns(ts) ((ts).tv_sec*1000000000LL + (ts).tv_nsec)
 #endif
-struct stml0xx_work_struct {
-	/* Base struct */
-	struct work_struct ws;
-	/* Timestamp in nanoseconds */
-	uint64_t ts_ns;
-};
-
-struct stml0xx_delayed_work_struct {
-	/* Base struct */
-	struct delayed_work ws;
-	/* Timestamp in nanoseconds */
-	uint64_t ts_ns;
-};
 
 /* per algo config, request, and event registers */
 struct stml0xx_algo_info_t {
@@ -724,6 +745,7 @@ struct stml0xx_algo_requst_t {
 
 #define STML0XX_LED_NAME "rgb"
 extern struct attribute_group stml0xx_notification_attribute_group;
+extern struct device_attribute dev_attr_wakeups;
 
 irqreturn_t stml0xx_isr(int irq, void *dev);
 void stml0xx_irq_work_func(struct work_struct *work);
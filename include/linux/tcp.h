@@ -168,6 +168,10 @@ struct tcp_info {
 	__u32	tcpi_rcv_space;
 
 	__u32	tcpi_total_retrans;
+
+	__u64	tcpi_pacing_rate;	/* bytes per second, 0 if not paced */
+	__u64	tcpi_delivery_rate;	/* bottleneck bandwidth estimate, B/s */
+	__u32	tcpi_min_rtt;		/* path RTT estimate, usec */
 };
 
 /* for TCP_MD5SIG socket option */
@@ -209,6 +213,7 @@ struct tcp_cookie_transactions {
 
 #include <linux/skbuff.h>
 #include <linux/dmaengine.h>
+#include <linux/interrupt.h>
 #include <net/sock.h>
 #include <net/inet_connection_sock.h>
 #include <net/inet_timewait_sock.h>
@@ -391,6 +396,14 @@ struct tcp_sock {
 				 * receiver in Recovery. */
 	u32	prr_out;	/* Total number of pkts sent during Recovery. */
 
+/*
+ *	Pacing, set by congestion controls that model the path rate
+ */
+	u32	pacing_rate;	/* Bytes per second, 0 means unpaced	*/
+	unsigned long pacing_flags;
+	ktime_t	pacing_next;	/* Earliest time the next skb may leave	*/
+	struct tasklet_hrtimer pacing_timer;
+
  	u32	rcv_wnd;	/* Current receiver window		*/
 	u32	write_seq;	/* Tail(+1) of data held in tcp send buffer */
 	u32	pushed_seq;	/* Last pushed seq, required to talk to windows */
@@ -424,6 +437,12 @@ struct tcp_sock {
 
 	u32	lost_retrans_low;	/* Sent seq after any rxmit (lowest) */
 
+	u32	tlp_high_seq;	/* snd_nxt at the time of TLP retransmit */
+	struct tcp_rack {
+		u32	xmit_time;	/* send time of the latest delivered skb */
+		u8	advanced;	/* xmit_time moved since the last check */
+	} rack;
+
 	u32	prior_ssthresh; /* ssthresh saved at recovery start	*/
 	u32	high_seq;	/* snd_nxt at onset of congestion	*/
 
@@ -67,6 +67,14 @@ struct tick_sched {
 	unsigned long			next_jiffies;
 	ktime_t				idle_expires;
 	int				do_timer_last;
+#ifdef CONFIG_NO_HZ_FULL
+	int				full_stretched;
+	int				full_kick;
+	ktime_t				full_last_tick;
+	unsigned long			full_next_jiffies;
+	unsigned long			full_stretches;
+	unsigned long			full_saved_ticks;
+#endif
 };
 
 extern void __init tick_init(void);
@@ -141,4 +149,16 @@ static inline u64 get_cpu_idle_time_us(int cpu, u64 *unused) { return -1; }
 static inline u64 get_cpu_iowait_time_us(int cpu, u64 *unused) { return -1; }
 # endif /* !NO_HZ */
 
+# ifdef CONFIG_NO_HZ_FULL
+extern bool tick_nohz_full_cpu(int cpu);
+extern void tick_nohz_full_kick_cpu(int cpu);
+extern void tick_nohz_full_kick_timer(int cpu, unsigned long expires);
+extern void tick_nohz_full_check(void);
+# else
+static inline bool tick_nohz_full_cpu(int cpu) { return false; }
+static inline void tick_nohz_full_kick_cpu(int cpu) { }
+static inline void tick_nohz_full_kick_timer(int cpu, unsigned long expires) { }
+static inline void tick_nohz_full_check(void) { }
+# endif /* !NO_HZ_FULL */
+
 #endif
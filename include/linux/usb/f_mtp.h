@@ -59,6 +59,17 @@ struct mtp_event {
 	void		*data;
 };
 
+struct mtp_xfer_config {
+	/* size of each bulk IN request buffer */
+	uint32_t	tx_req_len;
+	/* size of each bulk OUT request buffer, a multiple of 1024 */
+	uint32_t	rx_req_len;
+	/* number of bulk IN requests that may be in flight */
+	uint32_t	tx_reqs;
+	/* number of bulk OUT requests that may be in flight */
+	uint32_t	rx_reqs;
+};
+
 /* Sends the specified file range to the host */
 #define MTP_SEND_FILE              _IOW('M', 0, struct mtp_file_range)
 /* Receives data from the host and writes it to a file.
@@ -71,5 +82,9 @@ struct mtp_event {
  * with a 12 byte MTP data packet header at the beginning.
  */
 #define MTP_SEND_FILE_WITH_HEADER  _IOW('M', 4, struct mtp_file_range)
+/* Reallocates the bulk transfer requests with the given sizes.
+ * Must not be called while a transfer is in progress.
+ */
+#define MTP_SET_XFER_CONFIG        _IOW('M', 5, struct mtp_xfer_config)
 
 #endif /* __LINUX_USB_F_MTP_H */
@@ -48,6 +48,9 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
+#endif
+#ifdef CONFIG_PCP_HIGH_ORDER
+		PCP_HIGH_ORDER_HIT, PCP_HIGH_ORDER_MISS,
 #endif
 		UNEVICTABLE_PGCULLED,	/* culled to noreclaim list */
 		UNEVICTABLE_PGSCANNED,	/* scanned for reclaimability */
@@ -57,6 +60,16 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		UNEVICTABLE_PGCLEARED,	/* on COW, page truncate */
 		UNEVICTABLE_PGSTRANDED,	/* unable to isolate on unlock */
 		UNEVICTABLE_MLOCKFREED,
+		FORK_LAZY_PT,		/* page tables fork did not copy */
+		FORK_LAZY_PTE,		/* ptes left for the child to fault */
+		VMAP_PURGE,		/* lazy vmap purges that flushed */
+		VMAP_PURGE_PAGES,	/* pages of kva they freed */
+		VMAP_PURGE_SKIPPED,	/* purges left to a purge in progress */
+		VMAP_LOCK_CONTENDED,	/* vmap_area_lock found held */
+		VMAP_BLOCK_REUSED,	/* vmap blocks set up from a spare */
+		SPLICE_PAGE_MOVED,	/* pipe pages spliced into the page cache */
+		SPLICE_PAGE_COPIED,	/* ... and copies made instead */
+		PIPE_GROW,		/* busy pipes given more buffers */
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 		THP_FAULT_ALLOC,
 		THP_FAULT_FALLBACK,
@@ -7,6 +7,13 @@
 #include <linux/gfp.h>
 #include <linux/types.h>
 #include <linux/cgroup.h>
+#include <linux/spinlock.h>
+
+enum vmpressure_stall_states {
+	VMPRESSURE_STALL_SOME = 0,	/* at least one task stalled */
+	VMPRESSURE_STALL_FULL,		/* stalled tasks on every CPU */
+	VMPRESSURE_STALL_NR,
+};
 
 struct vmpressure {
 	unsigned long scanned;
@@ -21,6 +28,32 @@ struct vmpressure {
 	struct mutex events_lock;
 
 	struct work_struct work;
+
+	/*
+	 * Time tasks spent stalled on memory: direct reclaim, direct
+	 * compaction and swap-in. Protected by stall_lock.
+	 */
+	spinlock_t stall_lock;
+	unsigned int nr_stalled;
+	u64 stall_state_time;		/* ns, last change of nr_stalled */
+	u64 stall_last;			/* ns, last time a stall ended */
+	u64 stall_total[VMPRESSURE_STALL_NR];	/* ns */
+	/* 10s, 60s and 300s averages, FIXED_1 based percentages */
+	unsigned long stall_avg[VMPRESSURE_STALL_NR][3];
+	u64 stall_avg_total[VMPRESSURE_STALL_NR];
+	u64 stall_avg_time;
+	struct delayed_work stall_avg_work;
+	bool stall_avg_running;
+	/* pollable stall triggers */
+	struct list_head stall_triggers;
+};
+
+/* Filled in by vmpressure_stall_enter(), handed back on leave */
+struct vmpressure_stall {
+	bool global;
+#ifdef CONFIG_CGROUP_MEM_RES_CTLR
+	struct cgroup_subsys_state *css;
+#endif
 };
 
 struct mem_cgroup;
@@ -30,6 +63,8 @@ extern int vmpressure_notifier_unregister(struct notifier_block *nb);
 extern void vmpressure(gfp_t gfp, struct mem_cgroup *memcg,
 		       unsigned long scanned, unsigned long reclaimed);
 extern void vmpressure_prio(gfp_t gfp, struct mem_cgroup *memcg, int prio);
+extern void vmpressure_stall_enter(struct vmpressure_stall *stall);
+extern void vmpressure_stall_leave(struct vmpressure_stall *stall);
 
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR
 extern void vmpressure_init(struct vmpressure *vmpr);
@@ -41,6 +76,16 @@ extern int vmpressure_register_event(struct cgroup *cg, struct cftype *cft,
 				     const char *args);
 extern void vmpressure_unregister_event(struct cgroup *cg, struct cftype *cft,
 					struct eventfd_ctx *eventfd);
+extern void vmpressure_cleanup(struct vmpressure *vmpr);
+extern int vmpressure_stall_read(struct cgroup *cg, struct cftype *cft,
+				 struct seq_file *m);
+extern int vmpressure_stall_register_event(struct cgroup *cg,
+					   struct cftype *cft,
+					   struct eventfd_ctx *eventfd,
+					   const char *args);
+extern void vmpressure_stall_unregister_event(struct cgroup *cg,
+					      struct cftype *cft,
+					      struct eventfd_ctx *eventfd);
 #else
 static inline struct vmpressure *memcg_to_vmpressure(struct mem_cgroup *memcg)
 {
@@ -19,5 +19,6 @@
 #define _LINUX_WAKEUP_REASON_H
 
 void log_wakeup_reason(int irq);
+void log_resume_start(void);
 
 #endif /* _LINUX_WAKEUP_REASON_H */
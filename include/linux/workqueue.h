@@ -254,6 +254,14 @@ enum {
 	WQ_MEM_RECLAIM		= 1 << 3, /* may be used for memory reclaim */
 	WQ_HIGHPRI		= 1 << 4, /* high priority */
 	WQ_CPU_INTENSIVE	= 1 << 5, /* cpu instensive workqueue */
+	/*
+	 * Per-cpu workqueues are generally preferred because they tend to
+	 * show better performance thanks to cache locality, but they keep
+	 * waking up whichever cpu queued the work last. A power efficient
+	 * workqueue is unbound when workqueue.power_efficient is set, so
+	 * its work runs on a cpu that is awake anyway.
+	 */
+	WQ_POWER_EFFICIENT	= 1 << 8,
 
 	WQ_DRAINING		= 1 << 6, /* internal: workqueue is draining */
 	WQ_RESCUER		= 1 << 7, /* internal: workqueue has rescuer */
@@ -292,6 +300,11 @@ enum {
  *
  * system_nrt_freezable_wq is equivalent to system_nrt_wq except that
  * it's freezable.
+ *
+ * *_power_efficient_wq are inclined towards saving power and are
+ * converted into WQ_UNBOUND variants if workqueue.power_efficient is
+ * set; otherwise they are the same as their non-power-efficient
+ * counterparts, system_wq and system_freezable_wq.
  */
 extern struct workqueue_struct *system_wq;
 extern struct workqueue_struct *system_long_wq;
@@ -299,6 +312,8 @@ extern struct workqueue_struct *system_nrt_wq;
 extern struct workqueue_struct *system_unbound_wq;
 extern struct workqueue_struct *system_freezable_wq;
 extern struct workqueue_struct *system_nrt_freezable_wq;
+extern struct workqueue_struct *system_power_efficient_wq;
+extern struct workqueue_struct *system_freezable_power_efficient_wq;
 
 extern struct workqueue_struct *
 __alloc_workqueue_key(const char *fmt, unsigned int flags, int max_active,
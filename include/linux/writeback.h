@@ -157,6 +157,15 @@ void global_dirty_limits(unsigned long *pbackground, unsigned long *pdirty);
 unsigned long bdi_dirty_limit(struct backing_dev_info *bdi,
 			       unsigned long dirty);
 
+#ifdef CONFIG_BLK_CGROUP
+unsigned int blkcg_task_dirty_ratio(struct task_struct *tsk);
+#else
+static inline unsigned int blkcg_task_dirty_ratio(struct task_struct *tsk)
+{
+	return 100;
+}
+#endif
+
 void __bdi_update_bandwidth(struct backing_dev_info *bdi,
 			    unsigned long thresh,
 			    unsigned long bg_thresh,
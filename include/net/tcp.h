@@ -256,6 +256,10 @@ extern int sysctl_tcp_thin_linear_timeouts;
 extern int sysctl_tcp_thin_dupack;
 extern int sysctl_tcp_challenge_ack_limit;
 extern int sysctl_tcp_default_init_rwnd;
+extern int sysctl_tcp_early_retrans;
+extern int sysctl_tcp_recovery;
+
+#define TCP_RACK_LOSS_DETECTION	0x1 /* Use RACK to detect losses */
 
 /* sysctl variables for controlling various tcp parameters */
 extern int sysctl_tcp_delack_seg;
@@ -485,6 +489,7 @@ static inline __u32 cookie_v6_init_sequence(struct sock *sk,
 extern void __tcp_push_pending_frames(struct sock *sk, unsigned int cur_mss,
 				      int nonagle);
 extern int tcp_may_send_now(struct sock *sk);
+extern int __tcp_retransmit_skb(struct sock *, struct sk_buff *);
 extern int tcp_retransmit_skb(struct sock *, struct sk_buff *);
 extern void tcp_retransmit_timer(struct sock *sk);
 extern void tcp_xmit_retransmit_queue(struct sock *);
@@ -493,6 +498,8 @@ extern int tcp_trim_head(struct sock *, struct sk_buff *, u32);
 extern int tcp_fragment(struct sock *, struct sk_buff *, u32, unsigned int);
 
 extern void tcp_send_probe0(struct sock *);
+extern bool tcp_schedule_loss_probe(struct sock *sk);
+extern void tcp_send_loss_probe(struct sock *sk);
 extern void tcp_send_partial(struct sock *);
 extern int tcp_write_wakeup(struct sock *);
 extern void tcp_send_fin(struct sock *sk);
@@ -507,12 +514,18 @@ extern void tcp_send_delayed_ack(struct sock *sk);
 
 /* tcp_input.c */
 extern void tcp_cwnd_application_limited(struct sock *sk);
+extern void tcp_rearm_rto(struct sock *sk);
 
 /* tcp_timer.c */
 extern void tcp_init_xmit_timers(struct sock *);
+extern void tcp_pacing_timer_cancel(struct sock *sk);
+
+/* tcp_sock pacing_flags bits */
+#define TCP_PACING_TIMER_ARMED	0
 static inline void tcp_clear_xmit_timers(struct sock *sk)
 {
 	inet_csk_clear_xmit_timers(sk);
+	tcp_pacing_timer_cancel(sk);
 }
 
 extern unsigned int tcp_sync_mss(struct sock *sk, u32 pmtu);
@@ -732,6 +745,8 @@ struct tcp_congestion_ops {
 	void (*pkts_acked)(struct sock *sk, u32 num_acked, s32 rtt_us);
 	/* get info for inet_diag (optional) */
 	void (*get_info)(struct sock *sk, u32 ext, struct sk_buff *skb);
+	/* fill path model estimates for TCP_INFO (optional) */
+	void (*get_tcp_info)(const struct sock *sk, struct tcp_info *info);
 
 	char 		name[TCP_CA_NAME_MAX];
 	struct module 	*owner;
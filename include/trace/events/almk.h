@@ -78,6 +78,78 @@ TRACE_EVENT(almk_shrink,
 		__entry->adj)
 );
 
+TRACE_EVENT(almk_kill,
+
+	TP_PROTO(pid_t pid,
+		 short adj,
+		 unsigned long rss,
+		 unsigned long swap,
+		 unsigned long pressure,
+		 s64 pressure_us,
+		 int minfree,
+		 s64 scan_us),
+
+	TP_ARGS(pid, adj, rss, swap, pressure, pressure_us, minfree, scan_us),
+
+	TP_STRUCT__entry(
+		__field(pid_t, pid)
+		__field(short, adj)
+		__field(unsigned long, rss)
+		__field(unsigned long, swap)
+		__field(unsigned long, pressure)
+		__field(s64, pressure_us)
+		__field(int, minfree)
+		__field(s64, scan_us)
+	),
+
+	TP_fast_assign(
+		__entry->pid		= pid;
+		__entry->adj		= adj;
+		__entry->rss		= rss;
+		__entry->swap		= swap;
+		__entry->pressure	= pressure;
+		__entry->pressure_us	= pressure_us;
+		__entry->minfree	= minfree;
+		__entry->scan_us	= scan_us;
+	),
+
+	TP_printk("%d, %d, %lu, %lu, %lu, %lld, %d, %lld",
+		__entry->pid,
+		__entry->adj,
+		__entry->rss,
+		__entry->swap,
+		__entry->pressure,
+		__entry->pressure_us,
+		__entry->minfree,
+		__entry->scan_us)
+);
+
+TRACE_EVENT(almk_freed,
+
+	TP_PROTO(pid_t pid,
+		 unsigned long freed,
+		 s64 kill_us),
+
+	TP_ARGS(pid, freed, kill_us),
+
+	TP_STRUCT__entry(
+		__field(pid_t, pid)
+		__field(unsigned long, freed)
+		__field(s64, kill_us)
+	),
+
+	TP_fast_assign(
+		__entry->pid		= pid;
+		__entry->freed		= freed;
+		__entry->kill_us	= kill_us;
+	),
+
+	TP_printk("%d, %lu, %lld",
+		__entry->pid,
+		__entry->freed,
+		__entry->kill_us)
+);
+
 #endif
 
 #include <trace/define_trace.h>
@@ -0,0 +1,124 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM binder
+
+#if !defined(_TRACE_BINDER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_BINDER_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(binder_transaction,
+
+	TP_PROTO(int debug_id, int reply, unsigned int flags,
+		 unsigned int code, int from_proc, int from_thread,
+		 int to_proc, int to_thread, u64 copy_ns),
+
+	TP_ARGS(debug_id, reply, flags, code, from_proc, from_thread,
+		to_proc, to_thread, copy_ns),
+
+	TP_STRUCT__entry(
+		__field(int, debug_id)
+		__field(int, reply)
+		__field(unsigned int, flags)
+		__field(unsigned int, code)
+		__field(int, from_proc)
+		__field(int, from_thread)
+		__field(int, to_proc)
+		__field(int, to_thread)
+		__field(u64, copy_ns)
+	),
+
+	TP_fast_assign(
+		__entry->debug_id	= debug_id;
+		__entry->reply		= reply;
+		__entry->flags		= flags;
+		__entry->code		= code;
+		__entry->from_proc	= from_proc;
+		__entry->from_thread	= from_thread;
+		__entry->to_proc	= to_proc;
+		__entry->to_thread	= to_thread;
+		__entry->copy_ns	= copy_ns;
+	),
+
+	TP_printk("transaction=%d from %d:%d to %d:%d reply=%d flags=0x%x code=0x%x copy_ns=%llu",
+		__entry->debug_id, __entry->from_proc, __entry->from_thread,
+		__entry->to_proc, __entry->to_thread, __entry->reply,
+		__entry->flags, __entry->code,
+		(unsigned long long)__entry->copy_ns)
+);
+
+TRACE_EVENT(binder_transaction_received,
+
+	TP_PROTO(int debug_id, int to_proc, int to_thread, u64 queue_ns,
+		 int waited_for_thread),
+
+	TP_ARGS(debug_id, to_proc, to_thread, queue_ns, waited_for_thread),
+
+	TP_STRUCT__entry(
+		__field(int, debug_id)
+		__field(int, to_proc)
+		__field(int, to_thread)
+		__field(u64, queue_ns)
+		__field(int, waited_for_thread)
+	),
+
+	TP_fast_assign(
+		__entry->debug_id		= debug_id;
+		__entry->to_proc		= to_proc;
+		__entry->to_thread		= to_thread;
+		__entry->queue_ns		= queue_ns;
+		__entry->waited_for_thread	= waited_for_thread;
+	),
+
+	TP_printk("transaction=%d by %d:%d queue_ns=%llu waited_for_thread=%d",
+		__entry->debug_id, __entry->to_proc, __entry->to_thread,
+		(unsigned long long)__entry->queue_ns,
+		__entry->waited_for_thread)
+);
+
+TRACE_EVENT(binder_transaction_done,
+
+	TP_PROTO(int debug_id, int from_proc, int from_thread,
+		 int to_proc, int to_thread, u64 copy_ns, u64 queue_ns,
+		 u64 exec_ns, u64 total_ns),
+
+	TP_ARGS(debug_id, from_proc, from_thread, to_proc, to_thread,
+		copy_ns, queue_ns, exec_ns, total_ns),
+
+	TP_STRUCT__entry(
+		__field(int, debug_id)
+		__field(int, from_proc)
+		__field(int, from_thread)
+		__field(int, to_proc)
+		__field(int, to_thread)
+		__field(u64, copy_ns)
+		__field(u64, queue_ns)
+		__field(u64, exec_ns)
+		__field(u64, total_ns)
+	),
+
+	TP_fast_assign(
+		__entry->debug_id	= debug_id;
+		__entry->from_proc	= from_proc;
+		__entry->from_thread	= from_thread;
+		__entry->to_proc	= to_proc;
+		__entry->to_thread	= to_thread;
+		__entry->copy_ns	= copy_ns;
+		__entry->queue_ns	= queue_ns;
+		__entry->exec_ns	= exec_ns;
+		__entry->total_ns	= total_ns;
+	),
+
+	TP_printk("transaction=%d from %d:%d to %d:%d copy_ns=%llu queue_ns=%llu exec_ns=%llu total_ns=%llu",
+		__entry->debug_id, __entry->from_proc, __entry->from_thread,
+		__entry->to_proc, __entry->to_thread,
+		(unsigned long long)__entry->copy_ns,
+		(unsigned long long)__entry->queue_ns,
+		(unsigned long long)__entry->exec_ns,
+		(unsigned long long)__entry->total_ns)
+);
+
+#endif /* _TRACE_BINDER_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,46 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM filemap
+
+#if !defined(_TRACE_FILEMAP_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_FILEMAP_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+#include <linux/fs.h>
+#include <linux/kdev_t.h>
+
+/*
+ * A read or a fault missed the page cache and @nr pages starting at
+ * @index of @file are read in, either by readahead or one by one.
+ */
+TRACE_EVENT(mm_filemap_page_cache_miss,
+
+	TP_PROTO(struct file *file, pgoff_t index, unsigned long nr),
+
+	TP_ARGS(file, index, nr),
+
+	TP_STRUCT__entry(
+		__field(dev_t, s_dev)
+		__field(unsigned long, i_ino)
+		__field(pgoff_t, index)
+		__field(unsigned long, nr)
+	),
+
+	TP_fast_assign(
+		__entry->s_dev = file->f_mapping->host->i_sb->s_dev;
+		__entry->i_ino = file->f_mapping->host->i_ino;
+		__entry->index = index;
+		__entry->nr = nr;
+	),
+
+	TP_printk("dev %d:%d ino %lx index %lu nr %lu",
+		MAJOR(__entry->s_dev), MINOR(__entry->s_dev),
+		__entry->i_ino,
+		(unsigned long)__entry->index,
+		__entry->nr)
+);
+
+#endif /* _TRACE_FILEMAP_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -423,6 +423,45 @@ DEFINE_EVENT(ion_alloc_error, ion_alloc_buffer_fail,
 	TP_ARGS(client_name, heap_name, len, mask, flags, error)
 );
 
+TRACE_EVENT(ion_alloc_buffer_slow,
+
+	TP_PROTO(const char *client_name,
+		 const char *heap_name,
+		 size_t len,
+		 unsigned int mask,
+		 unsigned int flags,
+		 unsigned int usecs),
+
+	TP_ARGS(client_name, heap_name, len, mask, flags, usecs),
+
+	TP_STRUCT__entry(
+		__array(char,		client_name, 64)
+		__field(const char *,	heap_name)
+		__field(size_t,		len)
+		__field(unsigned int,	mask)
+		__field(unsigned int,	flags)
+		__field(unsigned int,	usecs)
+	),
+
+	TP_fast_assign(
+		strlcpy(__entry->client_name, client_name, 64);
+		__entry->heap_name	= heap_name;
+		__entry->len		= len;
+		__entry->mask		= mask;
+		__entry->flags		= flags;
+		__entry->usecs		= usecs;
+	),
+
+	TP_printk(
+	"client_name=%s heap_name=%s len=%zu mask=0x%x flags=0x%x usecs=%u",
+		__entry->client_name,
+		__entry->heap_name,
+		__entry->len,
+		__entry->mask,
+		__entry->flags,
+		__entry->usecs)
+);
+
 
 DECLARE_EVENT_CLASS(alloc_retry,
 
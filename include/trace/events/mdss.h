@@ -0,0 +1,87 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mdss
+
+#if !defined(_TRACE_MDSS_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MDSS_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(mdss_fb_commit,
+	TP_PROTO(int index, int commits_pending),
+
+	TP_ARGS(index, commits_pending),
+
+	TP_STRUCT__entry(
+		__field(int, index)
+		__field(int, commits_pending)
+	),
+
+	TP_fast_assign(
+		__entry->index = index;
+		__entry->commits_pending = commits_pending;
+	),
+
+	TP_printk("fb%d pending=%d", __entry->index, __entry->commits_pending)
+);
+
+TRACE_EVENT(mdss_fb_release_fence,
+	TP_PROTO(const char *name, int timeline_value, int remaining),
+
+	TP_ARGS(name, timeline_value, remaining),
+
+	TP_STRUCT__entry(
+		__string(name, name)
+		__field(int, timeline_value)
+		__field(int, remaining)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->timeline_value = timeline_value;
+		__entry->remaining = remaining;
+	),
+
+	TP_printk("%s value=%d remaining=%d", __get_str(name),
+		__entry->timeline_value, __entry->remaining)
+);
+
+DECLARE_EVENT_CLASS(mdp3_latency_template,
+	TP_PROTO(int index, u32 usecs),
+
+	TP_ARGS(index, usecs),
+
+	TP_STRUCT__entry(
+		__field(int, index)
+		__field(u32, usecs)
+	),
+
+	TP_fast_assign(
+		__entry->index = index;
+		__entry->usecs = usecs;
+	),
+
+	TP_printk("fb%d usecs=%u", __entry->index, __entry->usecs)
+);
+
+/* From the commit ioctl to the DMA being kicked off */
+DEFINE_EVENT(mdp3_latency_template, mdp3_commit_to_kickoff,
+	TP_PROTO(int index, u32 usecs),
+	TP_ARGS(index, usecs)
+);
+
+/* From the DMA done interrupt to the release fence being signaled */
+DEFINE_EVENT(mdp3_latency_template, mdp3_done_to_release,
+	TP_PROTO(int index, u32 usecs),
+	TP_ARGS(index, usecs)
+);
+
+/* Interval between two vsync interrupts */
+DEFINE_EVENT(mdp3_latency_template, mdp3_vsync,
+	TP_PROTO(int index, u32 usecs),
+	TP_ARGS(index, usecs)
+);
+
+#endif /* if !defined(_TRACE_MDSS_H) || defined(TRACE_HEADER_MULTI_READ) */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
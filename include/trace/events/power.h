@@ -141,6 +141,28 @@ DEFINE_EVENT(wakeup_source, wakeup_source_deactivate,
 	TP_ARGS(name, state)
 );
 
+TRACE_EVENT(wakeup_source_long_hold,
+
+	TP_PROTO(const char *name, s64 held_ms, s64 exclusive_ms),
+
+	TP_ARGS(name, held_ms, exclusive_ms),
+
+	TP_STRUCT__entry(
+		__string(       name,           name            )
+		__field(        s64,            held_ms         )
+		__field(        s64,            exclusive_ms    )
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->held_ms = held_ms;
+		__entry->exclusive_ms = exclusive_ms;
+	),
+
+	TP_printk("%s held=%lldms exclusive=%lldms", __get_str(name),
+		__entry->held_ms, __entry->exclusive_ms)
+);
+
 /*
  * The clock events are used for clock enable/disable and for
  *  clock rate change
@@ -62,6 +62,59 @@ TRACE_EVENT(sock_exceed_buf_limit,
 		__entry->rmem_alloc)
 );
 
+TRACE_EVENT(sock_rcvqueue_enqueue,
+
+	TP_PROTO(struct sock *sk, struct sk_buff *skb),
+
+	TP_ARGS(sk, skb),
+
+	TP_STRUCT__entry(
+		__field(int, rmem_alloc)
+		__field(unsigned int, truesize)
+		__field(int, sk_rcvbuf)
+		__field(__u32, qlen)
+	),
+
+	TP_fast_assign(
+		__entry->rmem_alloc = atomic_read(&sk->sk_rmem_alloc);
+		__entry->truesize   = skb->truesize;
+		__entry->sk_rcvbuf  = sk->sk_rcvbuf;
+		__entry->qlen       = skb_queue_len(&sk->sk_receive_queue);
+	),
+
+	TP_printk("rmem_alloc=%d truesize=%u sk_rcvbuf=%d qlen=%u",
+		__entry->rmem_alloc, __entry->truesize, __entry->sk_rcvbuf,
+		__entry->qlen)
+);
+
+/*
+ * An skb leaves the receive queue because the application read it.
+ * delay_us is the time since the stack received it, or -1 when the skb
+ * carries no receive timestamp (see net_enable_timestamp()).
+ */
+TRACE_EVENT(sock_rcvqueue_dequeue,
+
+	TP_PROTO(struct sock *sk, struct sk_buff *skb),
+
+	TP_ARGS(sk, skb),
+
+	TP_STRUCT__entry(
+		__field(int, rmem_alloc)
+		__field(unsigned int, len)
+		__field(s64, delay_us)
+	),
+
+	TP_fast_assign(
+		__entry->rmem_alloc = atomic_read(&sk->sk_rmem_alloc);
+		__entry->len        = skb->len;
+		__entry->delay_us   = skb->tstamp.tv64 ?
+			ktime_us_delta(ktime_get_real(), skb->tstamp) : -1;
+	),
+
+	TP_printk("rmem_alloc=%d len=%u delay_us=%lld",
+		__entry->rmem_alloc, __entry->len, __entry->delay_us)
+);
+
 #endif /* _TRACE_SOCK_H */
 
 /* This part must be outside protection */
@@ -372,6 +372,55 @@ TRACE_EVENT(balance_dirty_pages,
 	  )
 );
 
+TRACE_EVENT(balance_dirty_pages_bg,
+
+	TP_PROTO(struct backing_dev_info *bdi,
+		 unsigned int dirty_ratio,
+		 unsigned long thresh,
+		 unsigned long dirty,
+		 unsigned long latency,
+		 unsigned long bg_ratio,
+		 unsigned long task_ratelimit),
+
+	TP_ARGS(bdi, dirty_ratio, thresh, dirty, latency, bg_ratio,
+		task_ratelimit),
+
+	TP_STRUCT__entry(
+		__array(	 char,	bdi, 32)
+		__field(unsigned int,	dirty_ratio)
+		__field(unsigned long,	cg_limit)
+		__field(unsigned long,	dirty)
+		__field(unsigned long,	latency)
+		__field(unsigned int,	latency_target)
+		__field(unsigned long,	bg_ratio)
+		__field(unsigned long,	task_ratelimit)
+	),
+
+	TP_fast_assign(
+		strlcpy(__entry->bdi, dev_name(bdi->dev), 32);
+		__entry->dirty_ratio	= dirty_ratio;
+		__entry->cg_limit	= thresh * dirty_ratio / 100;
+		__entry->dirty		= dirty;
+		__entry->latency	= latency;
+		__entry->latency_target	= bdi->latency_target_us;
+		__entry->bg_ratio	= bg_ratio;
+		__entry->task_ratelimit	= KBps(task_ratelimit);
+	),
+
+	TP_printk("bdi %s: dirty_ratio=%u cg_limit=%lu dirty=%lu "
+		  "latency=%lu latency_target=%u bg_ratio=%lu "
+		  "task_ratelimit=%lu",
+		  __entry->bdi,
+		  __entry->dirty_ratio,
+		  __entry->cg_limit,
+		  __entry->dirty,
+		  __entry->latency,		/* us */
+		  __entry->latency_target,	/* us */
+		  __entry->bg_ratio,		/* 1/1024 */
+		  __entry->task_ratelimit	/* KB/s */
+	)
+);
+
 DECLARE_EVENT_CLASS(writeback_congest_waited_template,
 
 	TP_PROTO(unsigned int usec_timeout, unsigned int usec_delayed),
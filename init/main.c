@@ -63,6 +63,7 @@
 #include <linux/kgdb.h>
 #include <linux/ftrace.h>
 #include <linux/async.h>
+#include <linux/boot_timeline.h>
 #include <linux/kmemcheck.h>
 #include <linux/sfi.h>
 #include <linux/shmem_fs.h>
@@ -684,6 +685,7 @@ static int __init_or_module do_one_initcall_debug(initcall_t fn)
 int __init_or_module do_one_initcall(initcall_t fn)
 {
 	int count = preempt_count();
+	u64 start = boot_timeline_start();
 	int ret;
 
 	if (initcall_debug)
@@ -691,6 +693,8 @@ int __init_or_module do_one_initcall(initcall_t fn)
 	else
 		ret = fn();
 
+	boot_timeline_end(BOOT_EV_INITCALL, start, "%pf", fn);
+
 	msgbuf[0] = 0;
 
 	if (ret && ret != -ENODEV && initcall_debug)
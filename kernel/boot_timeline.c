@@ -0,0 +1,192 @@
+/*
+ * kernel/boot_timeline.c
+ *
+ * Keep a small ring of timed boot events - initcalls, driver probes
+ * (including deferred retries) and firmware loads - and dump it through
+ * debugfs as Chrome trace-event JSON, which chrome://tracing and most
+ * flame chart viewers load directly:
+ *
+ *	cat /sys/kernel/debug/boot_timeline > boot.json
+ *
+ * Events are stamped with local_clock(). Once a platform reports what
+ * its always-on counter reads (boot_timeline_set_base()), every event is
+ * shown on that time base instead, so the kernel's events line up with
+ * the bootloader's markers. Writing to the file empties the ring.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ */
+
+#include <linux/boot_timeline.h>
+#include <linux/debugfs.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+
+#define BOOT_TIMELINE_LEN	(1 << CONFIG_BOOT_TIMELINE_SHIFT)
+
+struct boot_timeline_event {
+	u64	ts;		/* local_clock() at start, ns */
+	u32	dur;		/* us */
+	pid_t	pid;
+	u8	type;
+	char	name[47];	/* 64 bytes a record */
+};
+
+static struct boot_timeline_event boot_timeline[BOOT_TIMELINE_LEN];
+static unsigned int boot_timeline_head;	/* total events recorded */
+static s64 boot_timeline_offset;
+static DEFINE_SPINLOCK(boot_timeline_lock);
+
+static const char * const boot_timeline_cat[] = {
+	[BOOT_EV_INITCALL]	= "initcall",
+	[BOOT_EV_PROBE]		= "probe",
+	[BOOT_EV_PROBE_DEFER]	= "probe_defer",
+	[BOOT_EV_FIRMWARE]	= "firmware",
+	[BOOT_EV_MODULE]	= "module",
+};
+
+u64 boot_timeline_start(void)
+{
+	return local_clock();
+}
+EXPORT_SYMBOL(boot_timeline_start);
+
+void boot_timeline_end(enum boot_timeline_type type, u64 start,
+		       const char *fmt, ...)
+{
+	struct boot_timeline_event *ev;
+	u64 dur = local_clock() - start;
+	unsigned long flags;
+	va_list args;
+	char *c;
+
+	spin_lock_irqsave(&boot_timeline_lock, flags);
+	ev = &boot_timeline[boot_timeline_head++ & (BOOT_TIMELINE_LEN - 1)];
+	ev->ts = start;
+	ev->dur = min_t(u64, dur >> 10, U32_MAX);
+	ev->pid = task_pid_nr(current);
+	ev->type = type;
+
+	va_start(args, fmt);
+	vscnprintf(ev->name, sizeof(ev->name), fmt, args);
+	va_end(args);
+
+	/* keep the JSON valid whatever the driver called itself */
+	for (c = ev->name; *c; c++)
+		if (*c == '"' || *c == '\\' || *c < ' ')
+			*c = '_';
+	spin_unlock_irqrestore(&boot_timeline_lock, flags);
+}
+EXPORT_SYMBOL(boot_timeline_end);
+
+/**
+ * boot_timeline_set_base - put the timeline on the platform's time base
+ * @now_ns: what the platform counter reads right now, in ns
+ *
+ * Applies to events already recorded as well as to later ones.
+ */
+void boot_timeline_set_base(u64 now_ns)
+{
+	boot_timeline_offset = now_ns - local_clock();
+}
+EXPORT_SYMBOL(boot_timeline_set_base);
+
+/*
+ * seq_file positions count from the oldest event still in the ring; the
+ * position after the newest one closes the JSON array.
+ */
+static unsigned int boot_timeline_first(void)
+{
+	if (boot_timeline_head <= BOOT_TIMELINE_LEN)
+		return 0;
+	return boot_timeline_head - BOOT_TIMELINE_LEN;
+}
+
+static void *boot_timeline_seq_start(struct seq_file *m, loff_t *pos)
+{
+	if (*pos > boot_timeline_head - boot_timeline_first())
+		return NULL;
+	return pos;
+}
+
+static void *boot_timeline_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return boot_timeline_seq_start(m, pos);
+}
+
+static void boot_timeline_seq_stop(struct seq_file *m, void *v)
+{
+}
+
+static int boot_timeline_seq_show(struct seq_file *m, void *v)
+{
+	loff_t pos = *(loff_t *)v;
+	struct boot_timeline_event ev;
+	unsigned long flags;
+	u64 ts;
+	u32 rem;
+
+	spin_lock_irqsave(&boot_timeline_lock, flags);
+	if (pos == boot_timeline_head - boot_timeline_first()) {
+		spin_unlock_irqrestore(&boot_timeline_lock, flags);
+		seq_puts(m, pos ? "]\n" : "[]\n");
+		return 0;
+	}
+	ev = boot_timeline[(boot_timeline_first() + pos) &
+			   (BOOT_TIMELINE_LEN - 1)];
+	spin_unlock_irqrestore(&boot_timeline_lock, flags);
+
+	ts = ev.ts + boot_timeline_offset;
+	rem = do_div(ts, NSEC_PER_USEC);
+
+	seq_printf(m, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+		   "\"ts\":%llu.%03u,\"dur\":%u,\"pid\":0,\"tid\":%d}\n",
+		   pos ? "," : "[", ev.name, boot_timeline_cat[ev.type],
+		   ts, rem, ev.dur, ev.pid);
+	return 0;
+}
+
+static const struct seq_operations boot_timeline_seq_ops = {
+	.start	= boot_timeline_seq_start,
+	.next	= boot_timeline_seq_next,
+	.stop	= boot_timeline_seq_stop,
+	.show	= boot_timeline_seq_show,
+};
+
+static int boot_timeline_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &boot_timeline_seq_ops);
+}
+
+static ssize_t boot_timeline_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&boot_timeline_lock, flags);
+	boot_timeline_head = 0;
+	spin_unlock_irqrestore(&boot_timeline_lock, flags);
+	return count;
+}
+
+static const struct file_operations boot_timeline_fops = {
+	.open		= boot_timeline_open,
+	.read		= seq_read,
+	.write		= boot_timeline_write,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init boot_timeline_debugfs_init(void)
+{
+	debugfs_create_file("boot_timeline", S_IRUSR | S_IWUSR, NULL, NULL,
+			    &boot_timeline_fops);
+	return 0;
+}
+late_initcall(boot_timeline_debugfs_init);
@@ -21,6 +21,7 @@
 #include <linux/uaccess.h>
 #include <linux/freezer.h>
 #include <linux/seq_file.h>
+#include <linux/ktime.h>
 
 enum freezer_state {
 	CGROUP_THAWED = 0,
@@ -28,10 +29,24 @@ enum freezer_state {
 	CGROUP_FROZEN,
 };
 
+/* cost of the freezer.state writes of one kind, in ns */
+struct freezer_stat {
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+};
+
 struct freezer {
 	struct cgroup_subsys_state css;
 	enum freezer_state state;
+	bool lazy;	/* don't wake sleeping tasks to freeze them */
 	spinlock_t lock; /* protects _writes_ to state */
+
+	/* statistics, protected by lock */
+	struct freezer_stat freeze_stat;
+	struct freezer_stat thaw_stat;
+	ktime_t freeze_start;		/* when FREEZING was entered */
+	u64 frozen_latency_ns;		/* FREEZING -> FROZEN, last time */
 };
 
 static inline struct freezer *cgroup_freezer(
@@ -138,6 +153,8 @@ static struct cgroup_subsys_state *freezer_create(struct cgroup *cgroup)
 
 	spin_lock_init(&freezer->lock);
 	freezer->state = CGROUP_THAWED;
+	if (cgroup->parent)
+		freezer->lazy = cgroup_freezer(cgroup->parent)->lazy;
 	return &freezer->css;
 }
 
@@ -150,11 +167,40 @@ static void freezer_destroy(struct cgroup *cgroup)
 	kfree(freezer);
 }
 
-/* task is frozen or will freeze immediately when next it gets woken */
-static bool is_task_frozen_enough(struct task_struct *task)
+/*
+ * task is frozen or will freeze immediately when next it gets woken; with
+ * lazy freezing that includes a user task asleep interruptibly that has
+ * been marked by freeze_task_lazy()
+ */
+static bool is_task_frozen_enough(struct task_struct *task, bool lazy)
+{
+	if (frozen(task))
+		return true;
+	if (!freezing(task))
+		return false;
+	if (task_is_stopped_or_traced(task))
+		return true;
+	return lazy && task->state == TASK_INTERRUPTIBLE &&
+		!(task->flags & PF_KTHREAD) &&
+		test_tsk_thread_flag(task, TIF_SIGPENDING);
+}
+
+static bool freezer_freeze_task(struct freezer *freezer,
+				struct task_struct *task)
 {
-	return frozen(task) ||
-		(task_is_stopped_or_traced(task) && freezing(task));
+	if (freezer->lazy)
+		return freeze_task_lazy(task);
+	return freeze_task(task);
+}
+
+static void freezer_stat_add(struct freezer_stat *stat, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	stat->count++;
+	stat->total_ns += ns;
+	if (ns > stat->max_ns)
+		stat->max_ns = ns;
 }
 
 /*
@@ -201,7 +247,7 @@ static void freezer_fork(struct task_struct *task)
 
 	/* Locking avoids race with FREEZING -> THAWED transitions. */
 	if (freezer->state == CGROUP_FREEZING)
-		freeze_task(task);
+		freezer_freeze_task(freezer, task);
 
 	spin_unlock_irq(&freezer->lock);
 out:
@@ -222,15 +268,18 @@ static void update_if_frozen(struct cgroup *cgroup,
 	cgroup_iter_start(cgroup, &it);
 	while ((task = cgroup_iter_next(cgroup, &it))) {
 		ntotal++;
-		if (freezing(task) && is_task_frozen_enough(task))
+		if (freezing(task) && is_task_frozen_enough(task, freezer->lazy))
 			nfrozen++;
 	}
 
 	if (old_state == CGROUP_THAWED) {
 		BUG_ON(nfrozen > 0);
 	} else if (old_state == CGROUP_FREEZING) {
-		if (nfrozen == ntotal)
+		if (nfrozen == ntotal) {
 			freezer->state = CGROUP_FROZEN;
+			freezer->frozen_latency_ns = ktime_to_ns(
+				ktime_sub(ktime_get(), freezer->freeze_start));
+		}
 	} else { /* old_state == CGROUP_FROZEN */
 		BUG_ON(nfrozen != ntotal);
 	}
@@ -272,9 +321,9 @@ static int try_to_freeze_cgroup(struct cgroup *cgroup, struct freezer *freezer)
 
 	cgroup_iter_start(cgroup, &it);
 	while ((task = cgroup_iter_next(cgroup, &it))) {
-		if (!freeze_task(task))
+		if (!freezer_freeze_task(freezer, task))
 			continue;
-		if (is_task_frozen_enough(task))
+		if (is_task_frozen_enough(task, freezer->lazy))
 			continue;
 		if (!freezing(task) && !freezer_should_skip(task))
 			num_cant_freeze_now++;
@@ -299,12 +348,14 @@ static int freezer_change_state(struct cgroup *cgroup,
 				enum freezer_state goal_state)
 {
 	struct freezer *freezer;
+	ktime_t start;
 	int retval = 0;
 
 	freezer = cgroup_freezer(cgroup);
 
 	spin_lock_irq(&freezer->lock);
 
+	start = ktime_get();
 	update_if_frozen(cgroup, freezer);
 
 	switch (goal_state) {
@@ -313,12 +364,18 @@ static int freezer_change_state(struct cgroup *cgroup,
 			atomic_dec(&system_freezing_cnt);
 		freezer->state = CGROUP_THAWED;
 		unfreeze_cgroup(cgroup, freezer);
+		freezer_stat_add(&freezer->thaw_stat, start);
 		break;
 	case CGROUP_FROZEN:
-		if (freezer->state == CGROUP_THAWED)
+		if (freezer->state == CGROUP_THAWED) {
 			atomic_inc(&system_freezing_cnt);
+			freezer->freeze_start = start;
+		}
 		freezer->state = CGROUP_FREEZING;
 		retval = try_to_freeze_cgroup(cgroup, freezer);
+		if (!retval)
+			update_if_frozen(cgroup, freezer);
+		freezer_stat_add(&freezer->freeze_stat, start);
 		break;
 	default:
 		BUG();
@@ -350,12 +407,63 @@ static int freezer_write(struct cgroup *cgroup,
 	return retval;
 }
 
+static u64 freezer_lazy_read(struct cgroup *cgroup, struct cftype *cft)
+{
+	return cgroup_freezer(cgroup)->lazy;
+}
+
+static int freezer_lazy_write(struct cgroup *cgroup, struct cftype *cft,
+			      u64 val)
+{
+	struct freezer *freezer = cgroup_freezer(cgroup);
+
+	if (val > 1)
+		return -EINVAL;
+
+	spin_lock_irq(&freezer->lock);
+	freezer->lazy = val;
+	spin_unlock_irq(&freezer->lock);
+	return 0;
+}
+
+static int freezer_stat_read(struct cgroup *cgroup, struct cftype *cft,
+			     struct cgroup_map_cb *cb)
+{
+	struct freezer *freezer = cgroup_freezer(cgroup);
+	struct freezer_stat freeze, thaw;
+	u64 latency;
+
+	spin_lock_irq(&freezer->lock);
+	freeze = freezer->freeze_stat;
+	thaw = freezer->thaw_stat;
+	latency = freezer->frozen_latency_ns;
+	spin_unlock_irq(&freezer->lock);
+
+	cb->fill(cb, "freeze_count", freeze.count);
+	cb->fill(cb, "freeze_time_ns", freeze.total_ns);
+	cb->fill(cb, "freeze_max_ns", freeze.max_ns);
+	cb->fill(cb, "frozen_latency_ns", latency);
+	cb->fill(cb, "thaw_count", thaw.count);
+	cb->fill(cb, "thaw_time_ns", thaw.total_ns);
+	cb->fill(cb, "thaw_max_ns", thaw.max_ns);
+	return 0;
+}
+
 static struct cftype files[] = {
 	{
 		.name = "state",
 		.read_seq_string = freezer_read,
 		.write_string = freezer_write,
 	},
+	{
+		.name = "lazy",
+		.read_u64 = freezer_lazy_read,
+		.write_u64 = freezer_lazy_write,
+	},
+	{
+		.name = "stat",
+		.read_map = freezer_stat_read,
+	},
 };
 
 static int freezer_populate(struct cgroup_subsys *ss, struct cgroup *cgroup)
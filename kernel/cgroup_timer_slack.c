@@ -0,0 +1,211 @@
+/*
+ * cgroup_timer_slack.c - timer slack cgroup controller
+ *
+ * Gives the tasks of a group a minimum timer slack, so that the short
+ * timers of background tasks can be run together with other wakeups
+ * instead of each pulling the cpu out of idle, and optionally makes
+ * their schedule_timeout() timers deferrable.
+ *
+ *	timer_slack.min_slack_ns	minimum slack of the group's tasks;
+ *					0 leaves their slack alone
+ *	timer_slack.deferrable		1: timeouts wait for the cpu to be
+ *					awake for another reason
+ *	timer_slack.coalesced		sleeps that expired early, inside
+ *					their slack, on another wakeup
+ *	timer_slack.deferred		timeouts that ran late because they
+ *					were deferrable
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ */
+
+#include <linux/atomic.h>
+#include <linux/cgroup.h>
+#include <linux/cgroup_timer_slack.h>
+#include <linux/err.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+struct timer_slack_cgroup {
+	struct cgroup_subsys_state css;
+	unsigned long min_slack_ns;
+	bool deferrable;
+	atomic_long_t coalesced;
+	atomic_long_t deferred;
+};
+
+static inline struct timer_slack_cgroup *cgroup_timer_slack(
+		struct cgroup *cgroup)
+{
+	return container_of(cgroup_subsys_state(cgroup, timer_slack_subsys_id),
+			    struct timer_slack_cgroup, css);
+}
+
+static inline struct timer_slack_cgroup *task_timer_slack_cgroup(
+		struct task_struct *p)
+{
+	return container_of(task_subsys_state(p, timer_slack_subsys_id),
+			    struct timer_slack_cgroup, css);
+}
+
+unsigned long task_timer_slack_min(struct task_struct *p)
+{
+	unsigned long slack;
+
+	rcu_read_lock();
+	slack = task_timer_slack_cgroup(p)->min_slack_ns;
+	rcu_read_unlock();
+	return slack;
+}
+
+bool task_timers_deferrable(struct task_struct *p)
+{
+	bool deferrable;
+
+	rcu_read_lock();
+	deferrable = task_timer_slack_cgroup(p)->deferrable;
+	rcu_read_unlock();
+	return deferrable;
+}
+
+void timer_slack_count_coalesced(struct task_struct *p)
+{
+	rcu_read_lock();
+	atomic_long_inc(&task_timer_slack_cgroup(p)->coalesced);
+	rcu_read_unlock();
+}
+
+void timer_slack_count_deferred(struct task_struct *p)
+{
+	rcu_read_lock();
+	atomic_long_inc(&task_timer_slack_cgroup(p)->deferred);
+	rcu_read_unlock();
+}
+
+static void timer_slack_apply(struct task_struct *p, unsigned long min_slack)
+{
+	p->timer_slack_ns = max(p->default_timer_slack_ns, min_slack);
+}
+
+static struct cgroup_subsys_state *timer_slack_create(struct cgroup *cgroup)
+{
+	struct timer_slack_cgroup *tsc;
+
+	tsc = kzalloc(sizeof(*tsc), GFP_KERNEL);
+	if (!tsc)
+		return ERR_PTR(-ENOMEM);
+
+	/* a child group starts out with its parent's settings */
+	if (cgroup->parent) {
+		struct timer_slack_cgroup *parent =
+			cgroup_timer_slack(cgroup->parent);
+
+		tsc->min_slack_ns = parent->min_slack_ns;
+		tsc->deferrable = parent->deferrable;
+	}
+	return &tsc->css;
+}
+
+static void timer_slack_destroy(struct cgroup *cgroup)
+{
+	kfree(cgroup_timer_slack(cgroup));
+}
+
+static void timer_slack_attach(struct cgroup *cgroup,
+			       struct cgroup_taskset *tset)
+{
+	unsigned long min_slack = cgroup_timer_slack(cgroup)->min_slack_ns;
+	struct task_struct *p;
+
+	cgroup_taskset_for_each(p, cgroup, tset)
+		timer_slack_apply(p, min_slack);
+}
+
+static u64 timer_slack_min_read(struct cgroup *cgroup, struct cftype *cft)
+{
+	return cgroup_timer_slack(cgroup)->min_slack_ns;
+}
+
+static int timer_slack_min_write(struct cgroup *cgroup, struct cftype *cft,
+				 u64 val)
+{
+	struct timer_slack_cgroup *tsc = cgroup_timer_slack(cgroup);
+	struct cgroup_iter it;
+	struct task_struct *p;
+
+	if (val > ULONG_MAX)
+		return -EINVAL;
+
+	tsc->min_slack_ns = val;
+
+	cgroup_iter_start(cgroup, &it);
+	while ((p = cgroup_iter_next(cgroup, &it)))
+		timer_slack_apply(p, tsc->min_slack_ns);
+	cgroup_iter_end(cgroup, &it);
+	return 0;
+}
+
+static u64 timer_slack_deferrable_read(struct cgroup *cgroup,
+				       struct cftype *cft)
+{
+	return cgroup_timer_slack(cgroup)->deferrable;
+}
+
+static int timer_slack_deferrable_write(struct cgroup *cgroup,
+					struct cftype *cft, u64 val)
+{
+	if (val > 1)
+		return -EINVAL;
+	cgroup_timer_slack(cgroup)->deferrable = val;
+	return 0;
+}
+
+static u64 timer_slack_coalesced_read(struct cgroup *cgroup,
+				      struct cftype *cft)
+{
+	return atomic_long_read(&cgroup_timer_slack(cgroup)->coalesced);
+}
+
+static u64 timer_slack_deferred_read(struct cgroup *cgroup,
+				     struct cftype *cft)
+{
+	return atomic_long_read(&cgroup_timer_slack(cgroup)->deferred);
+}
+
+static struct cftype files[] = {
+	{
+		.name = "min_slack_ns",
+		.read_u64 = timer_slack_min_read,
+		.write_u64 = timer_slack_min_write,
+	},
+	{
+		.name = "deferrable",
+		.read_u64 = timer_slack_deferrable_read,
+		.write_u64 = timer_slack_deferrable_write,
+	},
+	{
+		.name = "coalesced",
+		.read_u64 = timer_slack_coalesced_read,
+	},
+	{
+		.name = "deferred",
+		.read_u64 = timer_slack_deferred_read,
+	},
+};
+
+static int timer_slack_populate(struct cgroup_subsys *ss,
+				struct cgroup *cgroup)
+{
+	return cgroup_add_files(cgroup, ss, files, ARRAY_SIZE(files));
+}
+
+struct cgroup_subsys timer_slack_subsys = {
+	.name		= "timer_slack",
+	.create		= timer_slack_create,
+	.destroy	= timer_slack_destroy,
+	.populate	= timer_slack_populate,
+	.attach		= timer_slack_attach,
+	.subsys_id	= timer_slack_subsys_id,
+};
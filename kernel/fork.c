@@ -515,6 +515,16 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p)
 	mm->nr_ptes = 0;
 	memset(&mm->rss_stat, 0, sizeof(mm->rss_stat));
 	spin_lock_init(&mm->page_table_lock);
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	seqcount_init(&mm->mm_seq);
+	atomic_long_set(&mm->spf_success, 0);
+	atomic_long_set(&mm->spf_retry, 0);
+#endif
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+	mm->futex_hash = NULL;
+	atomic_long_set(&mm->futex_waits, 0);
+	atomic_long_set(&mm->futex_collisions, 0);
+#endif
 	mm->free_area_cache = TASK_UNMAPPED_BASE;
 	mm->cached_hole_size = ~0UL;
 	mm_init_aio(mm);
@@ -574,6 +584,7 @@ void __mmdrop(struct mm_struct *mm)
 	mm_free_pgd(mm);
 	destroy_context(mm);
 	mmu_notifier_mm_destroy(mm);
+	futex_hash_free(mm);
 	check_mm(mm);
 	free_mm(mm);
 }
@@ -1234,6 +1245,9 @@ static struct task_struct *copy_process(unsigned long clone_flags,
 #if defined(SPLIT_RSS_COUNTING)
 	memset(&p->rss_stat, 0, sizeof(p->rss_stat));
 #endif
+#ifdef CONFIG_MSM_TASK_PMU
+	memset(&p->pmu_counts, 0, sizeof(p->pmu_counts));
+#endif
 
 	p->default_timer_slack_ns = current->timer_slack_ns;
 
@@ -1679,7 +1693,13 @@ void __init proc_caches_init(void)
 	mm_cachep = kmem_cache_create("mm_struct",
 			sizeof(struct mm_struct), ARCH_MIN_MMSTRUCT_ALIGN,
 			SLAB_HWCACHE_ALIGN|SLAB_PANIC|SLAB_NOTRACK, NULL);
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	/* speculative faults may still be copying a vma being freed */
+	vm_area_cachep = KMEM_CACHE(vm_area_struct,
+				    SLAB_PANIC|SLAB_DESTROY_BY_RCU);
+#else
 	vm_area_cachep = KMEM_CACHE(vm_area_struct, SLAB_PANIC);
+#endif
 	mmap_init();
 	nsproxy_cache_init();
 }
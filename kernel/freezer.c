@@ -135,6 +135,47 @@ bool freeze_task(struct task_struct *p)
 	return true;
 }
 
+/**
+ * freeze_task_lazy - send a freeze request without waking the task up
+ * @p: task to send the request to
+ *
+ * Like freeze_task(), but a user task only gets TIF_SIGPENDING set and,
+ * if it is running on another cpu, a reschedule IPI. A sleeping task is
+ * left asleep; it enters the refrigerator on its way back to userspace
+ * once something else wakes it. Kernel threads are woken as usual.
+ *
+ * RETURNS:
+ * %false, if @p is not freezing or already frozen; %true, otherwise
+ */
+bool freeze_task_lazy(struct task_struct *p)
+{
+	unsigned long flags, sflags;
+
+	spin_lock_irqsave(&freezer_lock, flags);
+	if (!freezing(p) || frozen(p)) {
+		spin_unlock_irqrestore(&freezer_lock, flags);
+		return false;
+	}
+
+	if (!(p->flags & PF_KTHREAD)) {
+		/*
+		 * recalc_sigpending() leaves TIF_SIGPENDING alone while
+		 * freezing(p), so the mark survives until p gets to
+		 * get_signal_to_deliver().
+		 */
+		if (lock_task_sighand(p, &sflags)) {
+			set_tsk_thread_flag(p, TIF_SIGPENDING);
+			kick_process(p);
+			unlock_task_sighand(p, &sflags);
+		}
+	} else {
+		wake_up_state(p, TASK_INTERRUPTIBLE);
+	}
+
+	spin_unlock_irqrestore(&freezer_lock, flags);
+	return true;
+}
+
 void __thaw_task(struct task_struct *p)
 {
 	unsigned long flags;
@@ -61,6 +61,7 @@
 #include <linux/nsproxy.h>
 #include <linux/ptrace.h>
 #include <linux/hugetlb.h>
+#include <linux/log2.h>
 
 #include <asm/futex.h>
 
@@ -151,6 +152,94 @@ struct futex_hash_bucket {
 
 static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
 
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+/*
+ * The PROCESS_PRIVATE futexes of a multi-threaded process are hashed into
+ * a table of its own, so that one app's mutexes and condition variables
+ * do not share buckets and bucket locks with everybody else's.
+ *
+ * The table is set up by the first private futex operation made while
+ * the mm has more than one user and is never replaced afterwards. A task
+ * alone in its mm cannot have a private waiter queued while it is itself
+ * in sys_futex(), so moving the mm off futex_queues[] at that point cannot
+ * strand a waiter. If the allocation fails the mm stays on futex_queues[]
+ * for good.
+ */
+#define FUTEX_PRIVATE_MIN_BUCKETS	16
+#define FUTEX_PRIVATE_THREAD_BUCKETS	4	/* buckets per thread */
+#define FUTEX_HASH_GLOBAL	((struct futex_private_hash *)1UL)
+
+struct futex_private_hash {
+	unsigned int mask;
+	struct futex_hash_bucket buckets[0];
+};
+
+static void futex_private_hash_init(struct mm_struct *mm)
+{
+	struct futex_private_hash *fph;
+	unsigned int i, nr;
+
+	if (likely(mm->futex_hash) || atomic_read(&mm->mm_users) == 1)
+		return;
+
+	nr = clamp_t(unsigned int,
+		     get_nr_threads(current) * FUTEX_PRIVATE_THREAD_BUCKETS,
+		     FUTEX_PRIVATE_MIN_BUCKETS, 1 << FUTEX_HASHBITS);
+	nr = roundup_pow_of_two(nr);
+
+	fph = kmalloc(sizeof(*fph) + nr * sizeof(fph->buckets[0]), GFP_KERNEL);
+	if (fph) {
+		fph->mask = nr - 1;
+		for (i = 0; i < nr; i++) {
+			plist_head_init(&fph->buckets[i].chain);
+			spin_lock_init(&fph->buckets[i].lock);
+		}
+	} else
+		fph = FUTEX_HASH_GLOBAL;
+
+	/* a successful cmpxchg() orders the bucket setup before it */
+	if (cmpxchg(&mm->futex_hash, NULL, fph) && fph != FUTEX_HASH_GLOBAL)
+		kfree(fph);
+}
+
+static struct futex_private_hash *futex_private_hash(union futex_key *key)
+{
+	struct futex_private_hash *fph;
+
+	if (key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED))
+		return NULL;
+
+	fph = ACCESS_ONCE(key->private.mm->futex_hash);
+	smp_read_barrier_depends();
+	return fph == FUTEX_HASH_GLOBAL ? NULL : fph;
+}
+
+unsigned int futex_hash_buckets(struct mm_struct *mm)
+{
+	struct futex_private_hash *fph = ACCESS_ONCE(mm->futex_hash);
+
+	if (!fph || fph == FUTEX_HASH_GLOBAL)
+		return 0;
+	return fph->mask + 1;
+}
+
+void futex_hash_free(struct mm_struct *mm)
+{
+	if (mm->futex_hash != FUTEX_HASH_GLOBAL)
+		kfree(mm->futex_hash);
+}
+#else
+static inline void futex_private_hash_init(struct mm_struct *mm)
+{
+}
+
+static inline struct futex_private_hash *
+futex_private_hash(union futex_key *key)
+{
+	return NULL;
+}
+#endif
+
 /*
  * We hash on the keys returned from get_futex_key (see below).
  */
@@ -159,6 +248,12 @@ static struct futex_hash_bucket *hash_futex(union futex_key *key)
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+	struct futex_private_hash *fph = futex_private_hash(key);
+
+	if (fph)
+		return &fph->buckets[hash & fph->mask];
+#endif
 	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
 }
 
@@ -263,6 +358,7 @@ get_futex_key(u32 __user *uaddr, int fshared, union futex_key *key, int rw)
 		key->private.mm = mm;
 		key->private.address = address;
 		get_futex_key_refs(key);
+		futex_private_hash_init(mm);
 		return 0;
 	}
 
@@ -1635,6 +1731,40 @@ queue_unlock(struct futex_q *q, struct futex_hash_bucket *hb)
  * state is implicit in the state of woken task (see futex_wait_requeue_pi() for
  * an example).
  */
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+/*
+ * Account a waiter about to be queued on @hb to its process, and count a
+ * collision if the bucket already holds waiters for another futex. The
+ * chain is sorted by priority rather than by key, so only its two ends
+ * are looked at.
+ */
+static void futex_count_wait(struct futex_q *q, struct futex_hash_bucket *hb)
+{
+	struct mm_struct *mm = current->mm;
+	struct futex_q *other;
+
+	if (!mm)
+		return;
+
+	atomic_long_inc(&mm->futex_waits);
+	if (plist_head_empty(&hb->chain))
+		return;
+
+	other = plist_first_entry(&hb->chain, struct futex_q, list);
+	if (match_futex(&other->key, &q->key)) {
+		other = plist_last_entry(&hb->chain, struct futex_q, list);
+		if (match_futex(&other->key, &q->key))
+			return;
+	}
+	atomic_long_inc(&mm->futex_collisions);
+}
+#else
+static inline void
+futex_count_wait(struct futex_q *q, struct futex_hash_bucket *hb)
+{
+}
+#endif
+
 static inline void queue_me(struct futex_q *q, struct futex_hash_bucket *hb)
 	__releases(&hb->lock)
 {
@@ -1650,6 +1780,7 @@ static inline void queue_me(struct futex_q *q, struct futex_hash_bucket *hb)
 	 */
 	prio = min(current->normal_prio, MAX_RT_PRIO);
 
+	futex_count_wait(q, hb);
 	plist_node_init(&q->list, prio);
 	plist_add(&q->list, &hb->chain);
 	q->task = current;
@@ -2104,6 +2235,48 @@ static long futex_wait_restart(struct restart_block *restart)
 				restart->futex.val, tp, restart->futex.bitset);
 }
 
+/*
+ * Before queueing on a PI futex, spin for a while if its owner is running
+ * on another cpu and nobody is waiting for it yet: such an owner usually
+ * releases it with its own TID -> 0 cmpxchg within a few microseconds,
+ * and taking it then spares the waiter a sleep on the rt_mutex and the
+ * owner a trip through futex_unlock_pi(). Returns 1 if we got the futex.
+ */
+#define FUTEX_PI_SPIN_LOOPS	1000
+
+static int futex_pi_spin_on_owner(u32 __user *uaddr)
+{
+	u32 uval, curval, vpid = task_pid_vnr(current);
+	struct task_struct *owner;
+	int i, ret = 0;
+	pid_t tid;
+
+	if (get_user(uval, uaddr))
+		return 0;
+
+	tid = uval & FUTEX_TID_MASK;
+	if (!tid || tid == vpid || uval != tid)
+		return 0;
+
+	owner = futex_find_get_task(tid);
+	if (!owner)
+		return 0;
+
+	for (i = 0; i < FUTEX_PI_SPIN_LOOPS && uval == tid; i++) {
+		if (!task_curr(owner) || need_resched())
+			goto out_put;
+		cpu_relax();
+		if (get_user(uval, uaddr))
+			goto out_put;
+	}
+
+	if (!uval && !cmpxchg_futex_value_locked(&curval, uaddr, 0, vpid) &&
+	    !curval)
+		ret = 1;
+out_put:
+	put_task_struct(owner);
+	return ret;
+}
 
 /*
  * Userspace tried a 0 -> TID atomic transition of the futex value
@@ -2122,6 +2295,9 @@ static int futex_lock_pi(u32 __user *uaddr, unsigned int flags, int detect,
 	if (refill_pi_state_cache())
 		return -ENOMEM;
 
+	if (!trylock && futex_pi_spin_on_owner(uaddr))
+		return 0;
+
 	if (time) {
 		to = &timeout;
 		hrtimer_init_on_stack(&to->timer, CLOCK_REALTIME,
@@ -45,6 +45,7 @@
 #include <linux/debugobjects.h>
 #include <linux/sched.h>
 #include <linux/timer.h>
+#include <linux/cgroup_timer_slack.h>
 
 #include <asm/uaccess.h>
 
@@ -1531,8 +1532,10 @@ static enum hrtimer_restart hrtimer_wakeup(struct hrtimer *timer)
 	struct task_struct *task = t->task;
 
 	t->task = NULL;
-	if (task)
+	if (task) {
+		timer_slack_hrtimer_expired(timer, task);
 		wake_up_process(task);
+	}
 
 	return HRTIMER_NORESTART;
 }
@@ -0,0 +1,426 @@
+/*
+ * kernel/irq/balance.c
+ *
+ * In-kernel balancing of device interrupts.
+ *
+ * Every irq_balance.interval_ms the load of each device interrupt is
+ * estimated as the time spent in its handlers plus a fixed cost per
+ * interrupt. The busiest ones are then placed, heaviest first, on the
+ * online cpu with the least interrupt load so far. An interrupt stays
+ * where it is unless another cpu is clearly better, and a cpu that spent
+ * most of the last interval in power collapse is only woken for an
+ * interrupt heavy enough to be worth it. Interrupts that drop below
+ * irq_balance.min_load go back to the default affinity, and those on a
+ * cpu about to go offline are moved before it does.
+ *
+ * Interrupts whose affinity was set by anybody else (a driver, an
+ * affinity hint or /proc/irq/N/smp_affinity) are left alone.
+ *
+ *	cat /sys/kernel/debug/irq_balance
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpu_pm.h>
+#include <linux/debugfs.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/kernel_stat.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/sort.h>
+#include <linux/workqueue.h>
+
+#include "internals.h"
+
+#undef MODULE_PARAM_PREFIX
+#define MODULE_PARAM_PREFIX "irq_balance."
+
+static bool enabled = true;
+module_param(enabled, bool, 0644);
+
+static unsigned int interval_ms = 2000;
+module_param(interval_ms, uint, 0644);
+
+/* share of a cpu, in 1/1000, above which an interrupt is balanced */
+static unsigned int min_load = 5;
+module_param(min_load, uint, 0644);
+
+/* share of a cpu, in 1/1000, worth waking a cpu out of power collapse */
+static unsigned int wake_load = 50;
+module_param(wake_load, uint, 0644);
+
+/* entry, exit and cache cost charged per interrupt on top of the handlers */
+static unsigned int irq_cost_ns = 2000;
+module_param(irq_cost_ns, uint, 0644);
+
+#define IRQ_BALANCE_MAX		32	/* interrupts placed per pass */
+
+struct irq_balance_cpu {
+	u64	pc_start;	/* when it entered power collapse, or 0 */
+	u64	pc_ns;		/* total time in power collapse */
+	u64	pc_last_ns;	/* pc_ns at the last pass */
+	u64	load;		/* interrupt load placed on it, ns */
+	bool	asleep;		/* mostly collapsed during the last pass */
+};
+
+static DEFINE_PER_CPU(struct irq_balance_cpu, irq_balance_cpu);
+
+struct irq_balance_entry {
+	unsigned int	irq;
+	unsigned int	rate;	/* interrupts during the last pass */
+	u64		load;	/* ns during the last pass */
+};
+
+/* all of the below is protected by irq_balance_mutex */
+static struct irq_balance_entry irq_balance_heavy[IRQ_BALANCE_MAX];
+static int irq_balance_nr_heavy;
+static u64 irq_balance_last;
+static u64 irq_balance_interval;
+static unsigned long irq_balance_passes;
+static unsigned long irq_balance_moves;
+static unsigned long irq_balance_hotplug_moves;
+static DEFINE_MUTEX(irq_balance_mutex);
+
+static void irq_balance_work_fn(struct work_struct *work);
+static DECLARE_DEFERRED_WORK(irq_balance_work, irq_balance_work_fn);
+
+static int irq_balance_cpu_pm(struct notifier_block *nb, unsigned long cmd,
+			      void *v)
+{
+	struct irq_balance_cpu *bc = &__get_cpu_var(irq_balance_cpu);
+
+	switch (cmd) {
+	case CPU_PM_ENTER:
+		bc->pc_start = local_clock();
+		break;
+	case CPU_PM_ENTER_FAILED:
+	case CPU_PM_EXIT:
+		if (bc->pc_start) {
+			bc->pc_ns += local_clock() - bc->pc_start;
+			bc->pc_start = 0;
+		}
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block irq_balance_cpu_pm_nb = {
+	.notifier_call = irq_balance_cpu_pm,
+};
+
+/* load is a fraction @permille of the last interval */
+static bool irq_balance_above(u64 load, unsigned int permille)
+{
+	return load * 1000 >= (u64)permille * irq_balance_interval;
+}
+
+static void irq_balance_update_cpus(u64 now)
+{
+	unsigned int cpu;
+
+	for_each_online_cpu(cpu) {
+		struct irq_balance_cpu *bc = &per_cpu(irq_balance_cpu, cpu);
+		u64 start = ACCESS_ONCE(bc->pc_start);
+		u64 pc = bc->pc_ns;
+
+		if (start && now > start)
+			pc += now - start;
+		bc->asleep = (pc - bc->pc_last_ns) * 2 > irq_balance_interval;
+		bc->pc_last_ns = pc;
+		bc->load = 0;
+	}
+}
+
+/*
+ * Hand an interrupt the balancer placed back to the default affinity,
+ * with desc->lock held.
+ */
+static void irq_balance_release(struct irq_desc *desc)
+{
+	struct irq_data *d = irq_desc_get_irq_data(desc);
+
+	desc->balance_cpu = -1;
+	__irq_set_affinity_locked(d, irq_default_affinity);
+	irqd_clear(d, IRQD_AFFINITY_SET);
+}
+
+/* with desc->lock held: may the balancer move this interrupt? */
+static bool irq_balance_manageable(struct irq_desc *desc)
+{
+	struct irq_data *d = irq_desc_get_irq_data(desc);
+	struct irq_chip *chip = irq_data_get_irq_chip(d);
+
+	if (!desc->action || !irqd_can_balance(d) || desc->affinity_hint ||
+	    !chip || !chip->irq_set_affinity)
+		return false;
+
+	if (!irqd_affinity_was_set(d) || irqd_is_setaffinity_pending(d))
+		return true;
+
+	/* somebody else has set the affinity since we last did */
+	if (desc->balance_cpu < 0 ||
+	    !cpumask_equal(d->affinity, cpumask_of(desc->balance_cpu))) {
+		desc->balance_cpu = -1;
+		return false;
+	}
+	return true;
+}
+
+static void irq_balance_add_heavy(unsigned int irq, unsigned int rate,
+				  u64 load)
+{
+	struct irq_balance_entry *e;
+	int i, min = 0;
+
+	if (irq_balance_nr_heavy < IRQ_BALANCE_MAX) {
+		e = &irq_balance_heavy[irq_balance_nr_heavy++];
+	} else {
+		for (i = 1; i < IRQ_BALANCE_MAX; i++)
+			if (irq_balance_heavy[i].load <
+			    irq_balance_heavy[min].load)
+				min = i;
+		e = &irq_balance_heavy[min];
+		if (e->load >= load)
+			return;
+	}
+	e->irq = irq;
+	e->rate = rate;
+	e->load = load;
+}
+
+/* measure every interrupt, keep the heaviest and release the light ones */
+static void irq_balance_collect(void)
+{
+	struct irq_desc *desc;
+	unsigned int irq;
+
+	irq_balance_nr_heavy = 0;
+
+	for_each_irq_desc(irq, desc) {
+		unsigned int count = kstat_irqs(irq), rate;
+		u64 ns, load;
+
+		raw_spin_lock_irq(&desc->lock);
+		ns = desc->balance_ns - desc->balance_last_ns;
+		rate = count - desc->balance_last_count;
+		desc->balance_last_ns = desc->balance_ns;
+		desc->balance_last_count = count;
+
+		if (!irq_balance_manageable(desc)) {
+			raw_spin_unlock_irq(&desc->lock);
+			continue;
+		}
+
+		/* a torn read of balance_ns: go by the rate alone */
+		if (ns > irq_balance_interval)
+			ns = 0;
+		load = ns + (u64)rate * irq_cost_ns;
+
+		if (irq_balance_above(load, min_load))
+			irq_balance_add_heavy(irq, rate, load);
+		else if (desc->balance_cpu >= 0)
+			irq_balance_release(desc);
+		raw_spin_unlock_irq(&desc->lock);
+	}
+}
+
+static int irq_balance_cmp(const void *a, const void *b)
+{
+	const struct irq_balance_entry *ea = a, *eb = b;
+
+	if (ea->load == eb->load)
+		return 0;
+	return ea->load < eb->load ? 1 : -1;
+}
+
+/*
+ * The cpu with the least interrupt load for an interrupt of @load now on
+ * @cur. Moving away from @cur has to gain a quarter of the interrupt's
+ * load, so that similar interrupts do not swap cpus every pass.
+ */
+static int irq_balance_pick(u64 load, int cur, int exclude)
+{
+	u64 cost, best_cost = ULLONG_MAX;
+	int cpu, best = -1;
+
+	for_each_cpu_and(cpu, cpu_online_mask, irq_default_affinity) {
+		struct irq_balance_cpu *bc = &per_cpu(irq_balance_cpu, cpu);
+
+		if (cpu == exclude)
+			continue;
+		cost = bc->load;
+		if (cpu != cur)
+			cost += load >> 2;
+		if (bc->asleep && !bc->load &&
+		    !irq_balance_above(load, wake_load))
+			cost += irq_balance_interval;
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = cpu;
+		}
+	}
+	return best;
+}
+
+static void irq_balance_place(void)
+{
+	int i;
+
+	sort(irq_balance_heavy, irq_balance_nr_heavy,
+	     sizeof(irq_balance_heavy[0]), irq_balance_cmp, NULL);
+
+	for (i = 0; i < irq_balance_nr_heavy; i++) {
+		struct irq_balance_entry *e = &irq_balance_heavy[i];
+		struct irq_desc *desc = irq_to_desc(e->irq);
+		struct irq_data *d;
+		int cur, cpu;
+
+		if (!desc)
+			continue;
+
+		raw_spin_lock_irq(&desc->lock);
+		d = irq_desc_get_irq_data(desc);
+		if (!irq_balance_manageable(desc)) {
+			raw_spin_unlock_irq(&desc->lock);
+			continue;
+		}
+
+		cur = desc->balance_cpu;
+		if (cur < 0)
+			cur = cpumask_first_and(d->affinity, cpu_online_mask);
+		cpu = irq_balance_pick(e->load, cur, -1);
+		if (cpu >= 0) {
+			per_cpu(irq_balance_cpu, cpu).load += e->load;
+			if (cpu != cur &&
+			    !__irq_set_affinity_locked(d, cpumask_of(cpu))) {
+				desc->balance_cpu = cpu;
+				irq_balance_moves++;
+			}
+		}
+		raw_spin_unlock_irq(&desc->lock);
+	}
+}
+
+static void irq_balance_work_fn(struct work_struct *work)
+{
+	u64 now;
+
+	get_online_cpus();
+	mutex_lock(&irq_balance_mutex);
+
+	now = local_clock();
+	irq_balance_interval = now - irq_balance_last;
+	if (enabled && irq_balance_last) {
+		irq_balance_update_cpus(now);
+		irq_balance_collect();
+		irq_balance_place();
+		irq_balance_passes++;
+	}
+	irq_balance_last = enabled ? now : 0;
+
+	mutex_unlock(&irq_balance_mutex);
+	put_online_cpus();
+
+	schedule_delayed_work(&irq_balance_work,
+			      msecs_to_jiffies(max(interval_ms, 100U)));
+}
+
+/* move everything the balancer placed on @dying somewhere else */
+static void irq_balance_evacuate(unsigned int dying)
+{
+	struct irq_desc *desc;
+	unsigned int irq;
+
+	mutex_lock(&irq_balance_mutex);
+	for_each_irq_desc(irq, desc) {
+		int cpu;
+
+		raw_spin_lock_irq(&desc->lock);
+		if (desc->balance_cpu == dying) {
+			cpu = irq_balance_pick(0, -1, dying);
+			if (cpu < 0 || __irq_set_affinity_locked(
+					irq_desc_get_irq_data(desc),
+					cpumask_of(cpu)))
+				irq_balance_release(desc);
+			else
+				desc->balance_cpu = cpu;
+			irq_balance_hotplug_moves++;
+		}
+		raw_spin_unlock_irq(&desc->lock);
+	}
+	per_cpu(irq_balance_cpu, dying).load = 0;
+	mutex_unlock(&irq_balance_mutex);
+}
+
+static int __cpuinit irq_balance_cpu_callback(struct notifier_block *nb,
+					      unsigned long action, void *hcpu)
+{
+	if ((action & ~CPU_TASKS_FROZEN) == CPU_DOWN_PREPARE)
+		irq_balance_evacuate((long)hcpu);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block __cpuinitdata irq_balance_cpu_nb = {
+	.notifier_call = irq_balance_cpu_callback,
+};
+
+static int irq_balance_show(struct seq_file *m, void *v)
+{
+	unsigned int cpu;
+	int i;
+
+	mutex_lock(&irq_balance_mutex);
+	seq_printf(m, "passes: %lu moves: %lu hotplug_moves: %lu\n",
+		   irq_balance_passes, irq_balance_moves,
+		   irq_balance_hotplug_moves);
+
+	for_each_online_cpu(cpu) {
+		struct irq_balance_cpu *bc = &per_cpu(irq_balance_cpu, cpu);
+
+		seq_printf(m, "cpu%u: load %llu ns%s\n", cpu, bc->load,
+			   bc->asleep ? " (asleep)" : "");
+	}
+
+	for (i = 0; i < irq_balance_nr_heavy; i++) {
+		struct irq_balance_entry *e = &irq_balance_heavy[i];
+		struct irq_desc *desc = irq_to_desc(e->irq);
+
+		seq_printf(m, "irq %u: rate %u load %llu ns cpu %d\n",
+			   e->irq, e->rate, e->load,
+			   desc ? desc->balance_cpu : -1);
+	}
+	mutex_unlock(&irq_balance_mutex);
+	return 0;
+}
+
+static int irq_balance_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, irq_balance_show, NULL);
+}
+
+static const struct file_operations irq_balance_fops = {
+	.open		= irq_balance_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init irq_balance_init(void)
+{
+	cpu_pm_register_notifier(&irq_balance_cpu_pm_nb);
+	register_hotcpu_notifier(&irq_balance_cpu_nb);
+	debugfs_create_file("irq_balance", S_IRUGO, NULL, NULL,
+			    &irq_balance_fops);
+	schedule_delayed_work(&irq_balance_work,
+			      msecs_to_jiffies(interval_ms));
+	return 0;
+}
+late_initcall(irq_balance_init);
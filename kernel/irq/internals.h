@@ -184,3 +184,23 @@ static inline bool irqd_has_set(struct irq_data *d, unsigned int mask)
 {
 	return d->state_use_accessors & mask;
 }
+
+#ifdef CONFIG_IRQ_BALANCE
+/* handler time, for the load estimate of the irq balancer */
+static inline u64 irq_balance_clock(void)
+{
+	return local_clock();
+}
+
+static inline void irq_balance_account(struct irq_desc *desc, u64 start)
+{
+	desc->balance_ns += local_clock() - start;
+}
+#else
+static inline u64 irq_balance_clock(void)
+{
+	return 0;
+}
+
+static inline void irq_balance_account(struct irq_desc *desc, u64 start) { }
+#endif
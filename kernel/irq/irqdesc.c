@@ -88,6 +88,12 @@ static void desc_set_defaults(unsigned int irq, struct irq_desc *desc, int node,
 	desc->irqs_unhandled = 0;
 	desc->name = NULL;
 	desc->owner = owner;
+#ifdef CONFIG_IRQ_BALANCE
+	desc->balance_ns = 0;
+	desc->balance_last_ns = 0;
+	desc->balance_last_count = 0;
+	desc->balance_cpu = -1;
+#endif
 	for_each_possible_cpu(cpu)
 		*per_cpu_ptr(desc->kstat_irqs, cpu) = 0;
 	desc_smp_init(desc, node);
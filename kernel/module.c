@@ -57,6 +57,9 @@
 #include <linux/jump_label.h>
 #include <linux/pfn.h>
 #include <linux/bsearch.h>
+#include <linux/hash.h>
+#include <linux/dcache.h>
+#include <linux/boot_timeline.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/module.h>
@@ -247,59 +250,73 @@ static bool each_symbol_in_section(const struct symsearch *arr,
 	return false;
 }
 
-/* Returns true as soon as fn returns true, otherwise false. */
-bool each_symbol_section(bool (*fn)(const struct symsearch *arr,
-				    struct module *owner,
-				    void *data),
-			 void *data)
+static const struct symsearch core_symsearch[] = {
+	{ __start___ksymtab, __stop___ksymtab, __start___kcrctab,
+	  NOT_GPL_ONLY, false },
+	{ __start___ksymtab_gpl, __stop___ksymtab_gpl,
+	  __start___kcrctab_gpl,
+	  GPL_ONLY, false },
+	{ __start___ksymtab_gpl_future, __stop___ksymtab_gpl_future,
+	  __start___kcrctab_gpl_future,
+	  WILL_BE_GPL_ONLY, false },
+#ifdef CONFIG_UNUSED_SYMBOLS
+	{ __start___ksymtab_unused, __stop___ksymtab_unused,
+	  __start___kcrctab_unused,
+	  NOT_GPL_ONLY, true },
+	{ __start___ksymtab_unused_gpl, __stop___ksymtab_unused_gpl,
+	  __start___kcrctab_unused_gpl,
+	  GPL_ONLY, true },
+#endif
+};
+
+#define NR_SYMSEARCH	ARRAY_SIZE(core_symsearch)
+
+/* Fill arr[NR_SYMSEARCH] with the export tables of mod. */
+static void module_symsearch(struct module *mod, struct symsearch *arr)
 {
-	struct module *mod;
-	static const struct symsearch arr[] = {
-		{ __start___ksymtab, __stop___ksymtab, __start___kcrctab,
+	const struct symsearch tmp[] = {
+		{ mod->syms, mod->syms + mod->num_syms, mod->crcs,
 		  NOT_GPL_ONLY, false },
-		{ __start___ksymtab_gpl, __stop___ksymtab_gpl,
-		  __start___kcrctab_gpl,
+		{ mod->gpl_syms, mod->gpl_syms + mod->num_gpl_syms,
+		  mod->gpl_crcs,
 		  GPL_ONLY, false },
-		{ __start___ksymtab_gpl_future, __stop___ksymtab_gpl_future,
-		  __start___kcrctab_gpl_future,
+		{ mod->gpl_future_syms,
+		  mod->gpl_future_syms + mod->num_gpl_future_syms,
+		  mod->gpl_future_crcs,
 		  WILL_BE_GPL_ONLY, false },
 #ifdef CONFIG_UNUSED_SYMBOLS
-		{ __start___ksymtab_unused, __stop___ksymtab_unused,
-		  __start___kcrctab_unused,
+		{ mod->unused_syms,
+		  mod->unused_syms + mod->num_unused_syms,
+		  mod->unused_crcs,
 		  NOT_GPL_ONLY, true },
-		{ __start___ksymtab_unused_gpl, __stop___ksymtab_unused_gpl,
-		  __start___kcrctab_unused_gpl,
+		{ mod->unused_gpl_syms,
+		  mod->unused_gpl_syms + mod->num_unused_gpl_syms,
+		  mod->unused_gpl_crcs,
 		  GPL_ONLY, true },
 #endif
 	};
 
-	if (each_symbol_in_section(arr, ARRAY_SIZE(arr), NULL, fn, data))
+	BUILD_BUG_ON(ARRAY_SIZE(tmp) != NR_SYMSEARCH);
+	memcpy(arr, tmp, sizeof(tmp));
+}
+
+/* Returns true as soon as fn returns true, otherwise false. */
+bool each_symbol_section(bool (*fn)(const struct symsearch *arr,
+				    struct module *owner,
+				    void *data),
+			 void *data)
+{
+	struct module *mod;
+
+	if (each_symbol_in_section(core_symsearch, NR_SYMSEARCH, NULL,
+				   fn, data))
 		return true;
 
 	list_for_each_entry_rcu(mod, &modules, list) {
-		struct symsearch arr[] = {
-			{ mod->syms, mod->syms + mod->num_syms, mod->crcs,
-			  NOT_GPL_ONLY, false },
-			{ mod->gpl_syms, mod->gpl_syms + mod->num_gpl_syms,
-			  mod->gpl_crcs,
-			  GPL_ONLY, false },
-			{ mod->gpl_future_syms,
-			  mod->gpl_future_syms + mod->num_gpl_future_syms,
-			  mod->gpl_future_crcs,
-			  WILL_BE_GPL_ONLY, false },
-#ifdef CONFIG_UNUSED_SYMBOLS
-			{ mod->unused_syms,
-			  mod->unused_syms + mod->num_unused_syms,
-			  mod->unused_crcs,
-			  NOT_GPL_ONLY, true },
-			{ mod->unused_gpl_syms,
-			  mod->unused_gpl_syms + mod->num_unused_gpl_syms,
-			  mod->unused_gpl_crcs,
-			  GPL_ONLY, true },
-#endif
-		};
+		struct symsearch arr[NR_SYMSEARCH];
 
-		if (each_symbol_in_section(arr, ARRAY_SIZE(arr), mod, fn, data))
+		module_symsearch(mod, arr);
+		if (each_symbol_in_section(arr, NR_SYMSEARCH, mod, fn, data))
 			return true;
 	}
 	return false;
@@ -381,6 +398,154 @@ static bool find_symbol_in_section(const struct symsearch *syms,
 	return false;
 }
 
+#ifdef CONFIG_MODULE_SYMBOL_HASH
+/*
+ * Every exported symbol, from the kernel and from each loaded module, is
+ * also hashed by name so find_symbol() costs one probe instead of a
+ * bsearch through every table in turn.  Each owner gets one ksym_table
+ * holding its symsearch array and one entry per symbol.  Entries are
+ * added under module_mutex and removed under stop_machine (or before a
+ * synchronize_sched() on the load error path), so the rules for readers
+ * are those of find_symbol().
+ */
+#define KSYM_HASH_BITS	12
+#define KSYM_SEC_SHIFT	28
+
+struct ksym_entry {
+	struct hlist_node node;
+	struct ksym_table *table;
+	unsigned int idx;		/* section << KSYM_SEC_SHIFT | symbol */
+};
+
+struct ksym_table {
+	struct module *owner;
+	unsigned int num;
+	struct symsearch arr[NR_SYMSEARCH];
+	struct ksym_entry ent[];
+};
+
+static struct hlist_head ksym_hash[1 << KSYM_HASH_BITS];
+static bool ksym_hash_ready;
+
+static inline struct hlist_head *ksym_bucket(const char *name)
+{
+	return &ksym_hash[hash_32(full_name_hash(name, strlen(name)),
+				  KSYM_HASH_BITS)];
+}
+
+static struct ksym_table *ksym_table_add(struct module *owner,
+					 const struct symsearch *arr)
+{
+	struct ksym_table *table;
+	unsigned int i, j, num = 0;
+	size_t size;
+
+	for (i = 0; i < NR_SYMSEARCH; i++)
+		num += arr[i].stop - arr[i].start;
+
+	size = sizeof(*table) + num * sizeof(table->ent[0]);
+	if (size > PAGE_SIZE)
+		table = vmalloc(size);
+	else
+		table = kmalloc(size, GFP_KERNEL);
+	if (!table)
+		return NULL;
+
+	table->owner = owner;
+	table->num = num;
+	memcpy(table->arr, arr, sizeof(table->arr));
+
+	num = 0;
+	for (i = 0; i < NR_SYMSEARCH; i++) {
+		for (j = 0; j < arr[i].stop - arr[i].start; j++) {
+			struct ksym_entry *e = &table->ent[num++];
+
+			e->table = table;
+			e->idx = i << KSYM_SEC_SHIFT | j;
+			hlist_add_head_rcu(&e->node,
+					   ksym_bucket(arr[i].start[j].name));
+		}
+	}
+	return table;
+}
+
+/* Called with module_mutex held, after mod is on the modules list. */
+static void ksym_hash_add_module(struct module *mod)
+{
+	struct symsearch arr[NR_SYMSEARCH];
+
+	if (!ksym_hash_ready)
+		return;
+
+	module_symsearch(mod, arr);
+	mod->ksym_table = ksym_table_add(mod, arr);
+	/*
+	 * Without a table the module's symbols are unreachable through the
+	 * hash, so drop back to walking the tables for everyone.
+	 */
+	if (!mod->ksym_table) {
+		pr_warn("%s: no memory for symbol hash, disabling it\n",
+			mod->name);
+		ksym_hash_ready = false;
+	}
+}
+
+/* Unhash mod's symbols; readers may still see them until the next RCU-sched
+ * grace period, so the table itself is freed by ksym_hash_free_module(). */
+static void ksym_hash_del_module(struct module *mod)
+{
+	struct ksym_table *table = mod->ksym_table;
+	unsigned int i;
+
+	if (!table)
+		return;
+	for (i = 0; i < table->num; i++)
+		hlist_del_rcu(&table->ent[i].node);
+}
+
+static void ksym_hash_free_module(struct module *mod)
+{
+	if (is_vmalloc_addr(mod->ksym_table))
+		vfree(mod->ksym_table);
+	else
+		kfree(mod->ksym_table);
+	mod->ksym_table = NULL;
+}
+
+static bool ksym_hash_find(struct find_symbol_arg *fsa)
+{
+	struct ksym_entry *e;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry_rcu(e, pos, ksym_bucket(fsa->name), node) {
+		const struct symsearch *syms;
+		unsigned int symnum = e->idx & ((1U << KSYM_SEC_SHIFT) - 1);
+
+		syms = &e->table->arr[e->idx >> KSYM_SEC_SHIFT];
+		if (strcmp(syms->start[symnum].name, fsa->name) == 0)
+			return check_symbol(syms, e->table->owner, symnum, fsa);
+	}
+	return false;
+}
+
+static int __init ksym_hash_init(void)
+{
+	/* No module can have been loaded yet. */
+	ksym_hash_ready = ksym_table_add(NULL, core_symsearch) != NULL;
+	return 0;
+}
+core_initcall(ksym_hash_init);
+#else
+#define ksym_hash_ready false
+static inline bool ksym_hash_find(struct find_symbol_arg *fsa)
+{
+	return false;
+}
+static inline void ksym_hash_add_module(struct module *mod) { }
+static inline void ksym_hash_del_module(struct module *mod) { }
+static inline void ksym_hash_free_module(struct module *mod) { }
+#endif /* CONFIG_MODULE_SYMBOL_HASH */
+
 /* Find a symbol and return it, along with, (optional) crc and
  * (optional) module which owns it.  Needs preempt disabled or module_mutex. */
 const struct kernel_symbol *find_symbol(const char *name,
@@ -395,7 +560,8 @@ const struct kernel_symbol *find_symbol(const char *name,
 	fsa.gplok = gplok;
 	fsa.warn = warn;
 
-	if (each_symbol_section(find_symbol_in_section, &fsa)) {
+	if (ksym_hash_ready ? ksym_hash_find(&fsa) :
+	    each_symbol_section(find_symbol_in_section, &fsa)) {
 		if (owner)
 			*owner = fsa.owner;
 		if (crc)
@@ -1201,11 +1367,32 @@ static const struct kernel_symbol *resolve_symbol(struct module *mod,
 	struct module *owner;
 	const struct kernel_symbol *sym;
 	const unsigned long *crc;
+	bool gplok = !(mod->taints & (1 << TAINT_PROPRIETARY_MODULE));
 	int err;
 
+	/*
+	 * The kernel's own exports never go away and need no reference, so
+	 * with the symbol hash they are resolved without module_mutex and
+	 * modules being loaded side by side do not take turns on it once
+	 * per undefined symbol.
+	 */
+	if (ksym_hash_ready) {
+		preempt_disable();
+		sym = find_symbol(name, &owner, &crc, gplok, true);
+		preempt_enable();
+		if (!sym)
+			return NULL;
+		if (!owner) {
+			if (!check_version(info->sechdrs, info->index.vers,
+					   name, mod, crc, NULL))
+				sym = ERR_PTR(-EINVAL);
+			strncpy(ownername, module_name(NULL), MODULE_NAME_LEN);
+			return sym;
+		}
+	}
+
 	mutex_lock(&module_mutex);
-	sym = find_symbol(name, &owner, &crc,
-			  !(mod->taints & (1 << TAINT_PROPRIETARY_MODULE)), true);
+	sym = find_symbol(name, &owner, &crc, gplok, !ksym_hash_ready);
 	if (!sym)
 		goto unlock;
 
@@ -1669,6 +1856,7 @@ static int __unlink_module(void *_mod)
 {
 	struct module *mod = _mod;
 	list_del(&mod->list);
+	ksym_hash_del_module(mod);
 	module_bug_cleanup(mod);
 	return 0;
 }
@@ -1825,6 +2013,8 @@ static void free_module(struct module *mod)
 	/* Free lock-classes: */
 	lockdep_free_key_range(mod->module_core, mod->core_size);
 
+	ksym_hash_free_module(mod);
+
 	/* Finally, free the core (containing the module structure) */
 	unset_module_core_ro_nx(mod);
 	module_free(mod, mod->module_core);
@@ -2916,6 +3106,7 @@ static struct module *load_module(void __user *umod,
 
 	module_bug_finalize(info.hdr, info.sechdrs, mod);
 	list_add_rcu(&mod->list, &modules);
+	ksym_hash_add_module(mod);
 	mutex_unlock(&module_mutex);
 
 	/* Module is ready to execute: parsing args may do that. */
@@ -2940,6 +3131,7 @@ static struct module *load_module(void __user *umod,
 	mutex_lock(&module_mutex);
 	/* Unlink carefully: kallsyms could be walking list. */
 	list_del_rcu(&mod->list);
+	ksym_hash_del_module(mod);
 	module_bug_cleanup(mod);
 
  ddebug:
@@ -2947,6 +3139,7 @@ static struct module *load_module(void __user *umod,
  unlock:
 	mutex_unlock(&module_mutex);
 	synchronize_sched();
+	ksym_hash_free_module(mod);
 	kfree(mod->args);
  free_arch_cleanup:
 	module_arch_cleanup(mod);
@@ -2977,6 +3170,7 @@ SYSCALL_DEFINE3(init_module, void __user *, umod,
 		unsigned long, len, const char __user *, uargs)
 {
 	struct module *mod;
+	u64 start;
 	int ret = 0;
 
 	/* Must have permission */
@@ -2984,9 +3178,11 @@ SYSCALL_DEFINE3(init_module, void __user *, umod,
 		return -EPERM;
 
 	/* Do all the hard work */
+	start = boot_timeline_start();
 	mod = load_module(umod, len, uargs);
 	if (IS_ERR(mod))
 		return PTR_ERR(mod);
+	boot_timeline_end(BOOT_EV_MODULE, start, "%s", mod->name);
 
 	blocking_notifier_call_chain(&module_notify_list,
 			MODULE_STATE_COMING, mod);
@@ -26,6 +26,7 @@
 #include <linux/spinlock.h>
 #include <linux/notifier.h>
 #include <linux/suspend.h>
+#include <linux/ktime.h>
 
 
 #define MAX_WAKEUP_REASON_IRQS 32
@@ -33,6 +34,9 @@ static int irq_list[MAX_WAKEUP_REASON_IRQS];
 static int irqcount;
 static struct kobject *wakeup_reason;
 static spinlock_t resume_reason_lock;
+static ktime_t resume_start;
+static bool resume_started;
+static s64 last_resume_time_us;
 
 static ssize_t last_resume_reason_show(struct kobject *kobj, struct kobj_attribute *attr,
 		char *buf)
@@ -55,8 +59,17 @@ static ssize_t last_resume_reason_show(struct kobject *kobj, struct kobj_attribu
 
 static struct kobj_attribute resume_reason = __ATTR_RO(last_resume_reason);
 
+static ssize_t last_resume_time_us_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lld\n", last_resume_time_us);
+}
+
+static struct kobj_attribute resume_time = __ATTR_RO(last_resume_time_us);
+
 static struct attribute *attrs[] = {
 	&resume_reason.attr,
+	&resume_time.attr,
 	NULL,
 };
 static struct attribute_group attr_group = {
@@ -89,15 +102,45 @@ void log_wakeup_reason(int irq)
 	spin_unlock(&resume_reason_lock);
 }
 
+/*
+ * Called from suspend_enter() once timekeeping is back, with interrupts
+ * still off: the resume time of a wakeup runs from here until tasks are
+ * thawed again.
+ */
+void log_resume_start(void)
+{
+	resume_start = ktime_get();
+	resume_started = true;
+}
+
 /* Detects a suspend and clears all the previous wake up reasons*/
 static int wakeup_reason_pm_event(struct notifier_block *notifier,
 		unsigned long pm_event, void *unused)
 {
+	int irq;
+
 	switch (pm_event) {
 	case PM_SUSPEND_PREPARE:
 		spin_lock(&resume_reason_lock);
 		irqcount = 0;
 		spin_unlock(&resume_reason_lock);
+		resume_started = false;
+		break;
+	case PM_POST_SUSPEND:
+		if (!resume_started)
+			break;
+		resume_started = false;
+		last_resume_time_us = ktime_to_us(ktime_sub(ktime_get(),
+							    resume_start));
+		spin_lock(&resume_reason_lock);
+		irq = irqcount ? irq_list[0] : -1;
+		spin_unlock(&resume_reason_lock);
+		if (irq >= 0)
+			printk(KERN_INFO "Resume from IRQ %d took %lld us\n",
+					irq, last_resume_time_us);
+		else
+			printk(KERN_INFO "Resume took %lld us\n",
+					last_resume_time_us);
 		break;
 	default:
 		break;
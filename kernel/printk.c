@@ -41,6 +41,10 @@
 #include <linux/cpu.h>
 #include <linux/notifier.h>
 #include <linux/rculist.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/apanic_mmc.h>
 
 #include <asm/uaccess.h>
@@ -118,6 +122,26 @@ static unsigned log_start;	/* Index into log_buf: next char to be read by syslog
 static unsigned con_start;	/* Index into log_buf: next char to be sent to consoles */
 static unsigned log_end;	/* Index into log_buf: most-recently-written-char + 1 */
 
+/* Console backlog statistics, in chars */
+static unsigned con_dropped;		/* overwritten before reaching the consoles */
+static unsigned con_max_backlog;
+static unsigned long con_async_flushes;
+
+/*
+ * In async mode printk() only stores into log_buf and the printk kthread
+ * writes it out to the consoles.  Output goes synchronous again while an
+ * oops or panic is in progress and outside of SYSTEM_RUNNING.
+ */
+#if defined(CONFIG_PRINTK_ASYNC_CONSOLE)
+static bool printk_async = 1;
+#else
+static bool printk_async;
+#endif
+module_param_named(async, printk_async, bool, S_IRUGO | S_IWUSR);
+
+static struct task_struct *printk_kthread;
+static void printk_async_kick(void);
+
 /*
  * If exclusive_console is non-NULL then only this console is to be printed to.
  */
@@ -742,8 +766,10 @@ static void emit_log_char(char c)
 	log_end++;
 	if (log_end - log_start > log_buf_len)
 		log_start = log_end - log_buf_len;
-	if (log_end - con_start > log_buf_len)
+	if (log_end - con_start > log_buf_len) {
 		con_start = log_end - log_buf_len;
+		con_dropped++;
+	}
 	if (logged_chars < log_buf_len)
 		logged_chars++;
 
@@ -1049,7 +1075,15 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	 * will release 'logbuf_lock' regardless of whether it
 	 * actually gets the semaphore or not.
 	 */
-	if (console_trylock_for_printk(this_cpu))
+	if (log_end - con_start > con_max_backlog)
+		con_max_backlog = log_end - con_start;
+
+	if (printk_async && printk_kthread && !oops_in_progress &&
+	    system_state == SYSTEM_RUNNING) {
+		printk_cpu = UINT_MAX;
+		raw_spin_unlock(&logbuf_lock);
+		printk_async_kick();
+	} else if (console_trylock_for_printk(this_cpu))
 		console_unlock();
 
 	lockdep_on();
@@ -1324,6 +1358,7 @@ int is_console_locked(void)
 
 #define PRINTK_PENDING_WAKEUP	0x01
 #define PRINTK_PENDING_SCHED	0x02
+#define PRINTK_PENDING_ASYNC	0x04
 
 static DEFINE_PER_CPU(int, printk_pending);
 static DEFINE_PER_CPU(char [PRINTK_BUF_SIZE], printk_sched_buf);
@@ -1338,9 +1373,85 @@ void printk_tick(void)
 		}
 		if (pending & PRINTK_PENDING_WAKEUP)
 			wake_up_interruptible(&log_wait);
+		if ((pending & PRINTK_PENDING_ASYNC) && printk_kthread)
+			wake_up_process(printk_kthread);
+	}
+}
+
+/*
+ * printk() may be called with the runqueue locks held, so the console
+ * kthread is woken from the next tick, like klogd.
+ */
+static void printk_async_kick(void)
+{
+	this_cpu_or(printk_pending, PRINTK_PENDING_ASYNC);
+}
+
+static unsigned console_backlog(void)
+{
+	unsigned long flags;
+	unsigned backlog;
+
+	raw_spin_lock_irqsave(&logbuf_lock, flags);
+	backlog = log_end - con_start;
+	raw_spin_unlock_irqrestore(&logbuf_lock, flags);
+
+	return backlog;
+}
+
+static int printk_async_thread(void *unused)
+{
+	/* Suspended consoles don't drain, so stay out of their way */
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!console_backlog())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+		if (try_to_freeze())
+			continue;
+
+		con_async_flushes++;
+		console_lock();
+		console_unlock();
 	}
+	return 0;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int console_backlog_show(struct seq_file *m, void *unused)
+{
+	seq_printf(m, "async:\t\t%d\nbacklog:\t%u\nmax_backlog:\t%u\n"
+		   "dropped:\t%u\nflushes:\t%lu\n",
+		   printk_async && printk_kthread, console_backlog(),
+		   con_max_backlog, con_dropped, con_async_flushes);
+	return 0;
+}
+
+static int console_backlog_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, console_backlog_show, NULL);
+}
+
+static const struct file_operations console_backlog_fops = {
+	.open		= console_backlog_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init console_backlog_debugfs_init(void)
+{
+	debugfs_create_file("console_backlog", S_IRUGO, NULL, NULL,
+			    &console_backlog_fops);
+}
+#else
+static inline void console_backlog_debugfs_init(void)
+{
+}
+#endif
+
 int printk_needs_cpu(int cpu)
 {
 	if (cpu_is_offline(cpu))
@@ -1741,6 +1852,13 @@ static int __init printk_late_init(void)
 		}
 	}
 	hotcpu_notifier(console_cpu_notify, 0);
+
+	printk_kthread = kthread_run(printk_async_thread, NULL, "printk");
+	if (IS_ERR(printk_kthread)) {
+		printk(KERN_ERR "printk: no console thread, output stays synchronous\n");
+		printk_kthread = NULL;
+	}
+	console_backlog_debugfs_init();
 	return 0;
 }
 late_initcall(printk_late_init);
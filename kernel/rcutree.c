@@ -47,6 +47,7 @@
 #include <linux/mutex.h>
 #include <linux/time.h>
 #include <linux/kernel_stat.h>
+#include <linux/tick.h>
 #include <linux/wait.h>
 #include <linux/kthread.h>
 #include <linux/prefetch.h>
@@ -693,6 +694,9 @@ static int rcu_implicit_dynticks_qs(struct rcu_data *rdp)
 		return 1;
 	}
 
+	/* A CPU running on a stretched tick reports from its next tick. */
+	tick_nohz_full_kick_cpu(rdp->cpu);
+
 	/* Go check for the CPU being offline. */
 	return rcu_implicit_offline_qs(rdp);
 }
@@ -1801,9 +1805,13 @@ static void invoke_rcu_core(void)
 	raise_softirq(RCU_SOFTIRQ);
 }
 
+/*
+ * Queue a callback on this CPU's list.  If @offload and this is a
+ * no-CBs CPU, the callback is handed to the CPU's rcuo kthread instead.
+ */
 static void
-__call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
-	   struct rcu_state *rsp, bool lazy)
+__call_rcu_queue(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
+		 struct rcu_state *rsp, bool lazy, bool offload)
 {
 	unsigned long flags;
 	struct rcu_data *rdp;
@@ -1824,6 +1832,11 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 	local_irq_save(flags);
 	rdp = this_cpu_ptr(rsp->rda);
 
+	if (offload && __call_rcu_nocb(rdp, head, lazy)) {
+		local_irq_restore(flags);
+		return;
+	}
+
 	/* Add the callback to our list. */
 	*rdp->nxttail[RCU_NEXT_TAIL] = head;
 	rdp->nxttail[RCU_NEXT_TAIL] = &head->next;
@@ -1877,6 +1890,13 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 	local_irq_restore(flags);
 }
 
+static void
+__call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
+	   struct rcu_state *rsp, bool lazy)
+{
+	__call_rcu_queue(head, func, rsp, lazy, true);
+}
+
 /*
  * Queue an RCU-sched callback for invocation after a grace period.
  */
@@ -2267,6 +2287,7 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	WARN_ON_ONCE(atomic_read(&rdp->dynticks->dynticks) != 1);
 	rdp->cpu = cpu;
 	rdp->rsp = rsp;
+	rcu_boot_init_nocb_percpu_data(rdp);
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
 }
 
@@ -2506,6 +2527,7 @@ void __init rcu_init(void)
 	int cpu;
 
 	rcu_bootup_announce();
+	rcu_init_nocb();
 	rcu_init_one(&rcu_sched_state, &rcu_sched_data);
 	rcu_init_one(&rcu_bh_state, &rcu_bh_data);
 	__rcu_init_preempt();
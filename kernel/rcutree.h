@@ -27,6 +27,7 @@
 #include <linux/threads.h>
 #include <linux/cpumask.h>
 #include <linux/seqlock.h>
+#include <linux/wait.h>
 
 /*
  * Define shape of hierarchy based on NR_CPUS and CONFIG_RCU_FANOUT.
@@ -301,6 +302,17 @@ struct rcu_data {
 	unsigned long n_rp_need_fqs;
 	unsigned long n_rp_need_nothing;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+	/* 6) Callback offloading. */
+	struct rcu_head *nocb_head;	/* CBs waiting for kthread. */
+	struct rcu_head **nocb_tail;
+	atomic_long_t nocb_q_count;	/* # CBs waiting for kthread. */
+	wait_queue_head_t nocb_wq;	/* For nocb kthread to sleep on. */
+	struct task_struct *nocb_kthread;
+	unsigned long n_nocb_queued;	/* # CBs handed to the kthread. */
+	unsigned long n_nocb_invoked;	/* # CBs the kthread invoked. */
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 	int cpu;
 	struct rcu_state *rsp;
 };
@@ -476,5 +488,9 @@ static void print_cpu_stall_info(struct rcu_state *rsp, int cpu);
 static void print_cpu_stall_info_end(void);
 static void zero_cpu_stall_ticks(struct rcu_data *rdp);
 static void increment_cpu_stall_ticks(void);
+static void __init rcu_init_nocb(void);
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp);
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    bool lazy);
 
 #endif /* #ifndef RCU_TREE_NONCORE */
@@ -25,6 +25,7 @@
  */
 
 #include <linux/delay.h>
+#include <linux/bootmem.h>
 
 #define RCU_KTHREAD_PRIO 1
 
@@ -2320,3 +2321,234 @@ static void increment_cpu_stall_ticks(void)
 }
 
 #endif /* #else #ifdef CONFIG_RCU_CPU_STALL_INFO */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Offload callback processing from the CPUs given by the rcu_nocbs=
+ * boot parameter.  Each such CPU gets one "rcuo" kthread per RCU
+ * flavor.  call_rcu() and friends on a no-CBs CPU append the callback
+ * to a lockless list, and the kthread, which runs only on the CPUs
+ * that process their own callbacks, takes the whole list, waits for a
+ * grace period and invokes it.  The no-CBs CPU itself then need not
+ * run RCU_SOFTIRQ to invoke callbacks and can stay idle or go offline.
+ */
+
+static cpumask_var_t rcu_nocb_mask;	/* CPUs to have callbacks offloaded. */
+static bool have_rcu_nocb_mask;		/* Was rcu_nocb_mask allocated? */
+static cpumask_var_t rcu_nocb_housekeeping; /* Where the kthreads run. */
+
+/* Parse the boot-time rcu_nocbs= CPU list from the kernel parameters. */
+static int __init rcu_nocb_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	have_rcu_nocb_mask = true;
+	cpulist_parse(str, rcu_nocb_mask);
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+/* Is the specified CPU a no-CBs CPU? */
+static bool rcu_is_nocb_cpu(int cpu)
+{
+	if (have_rcu_nocb_mask)
+		return cpumask_test_cpu(cpu, rcu_nocb_mask);
+	return false;
+}
+
+static void __init rcu_init_nocb(void)
+{
+	char buf[64];
+
+	if (!have_rcu_nocb_mask)
+		return;
+
+	/* Someone has to invoke the kthreads' own grace-period callbacks. */
+	if (cpumask_test_cpu(0, rcu_nocb_mask)) {
+		printk(KERN_INFO "\tCPU 0 cannot be a no-CBs CPU, ignoring it.\n");
+		cpumask_clear_cpu(0, rcu_nocb_mask);
+	}
+	if (cpumask_empty(rcu_nocb_mask)) {
+		have_rcu_nocb_mask = false;
+		return;
+	}
+	cpulist_scnprintf(buf, sizeof(buf), rcu_nocb_mask);
+	printk(KERN_INFO "\tOffloading callbacks from CPUs: %s.\n", buf);
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+	rdp->nocb_tail = &rdp->nocb_head;
+	init_waitqueue_head(&rdp->nocb_wq);
+}
+
+/*
+ * Enqueue the callback on the specified CPU's no-CBs list and wake up
+ * its kthread if the list was empty.  Called with interrupts disabled.
+ * Returns false if this is not a no-CBs CPU, in which case the caller
+ * queues the callback as usual.
+ */
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    bool lazy)
+{
+	struct rcu_head **old_rhpp;
+	struct task_struct *t;
+
+	if (!rcu_is_nocb_cpu(rdp->cpu))
+		return false;
+
+	old_rhpp = xchg(&rdp->nocb_tail, &rhp->next);
+	ACCESS_ONCE(*old_rhpp) = rhp;
+	atomic_long_inc(&rdp->nocb_q_count);
+	rdp->n_nocb_queued++;
+
+	if (__is_kfree_rcu_offset((unsigned long)rhp->func))
+		trace_rcu_kfree_callback(rdp->rsp->name, rhp,
+					 (unsigned long)rhp->func, 0,
+					 atomic_long_read(&rdp->nocb_q_count));
+	else
+		trace_rcu_callback(rdp->rsp->name, rhp, 0,
+				   atomic_long_read(&rdp->nocb_q_count));
+
+	/* Before the kthreads are spawned, the callbacks simply wait. */
+	t = ACCESS_ONCE(rdp->nocb_kthread);
+	if (t && old_rhpp == &rdp->nocb_head)
+		wake_up(&rdp->nocb_wq);
+	return true;
+}
+
+struct rcu_nocb_gp {
+	struct rcu_head head;
+	struct completion completion;
+};
+
+static void rcu_nocb_gp_done(struct rcu_head *head)
+{
+	struct rcu_nocb_gp *gp = container_of(head, struct rcu_nocb_gp, head);
+
+	complete(&gp->completion);
+}
+
+/*
+ * Wait for a grace period of the kthread's flavor.  The callback is
+ * queued without offloading: should the kthread find itself on a
+ * no-CBs CPU, it must not end up waiting for its own list.
+ */
+static void rcu_nocb_wait_gp(struct rcu_data *rdp)
+{
+	struct rcu_nocb_gp gp;
+
+	init_rcu_head_on_stack(&gp.head);
+	init_completion(&gp.completion);
+	__call_rcu_queue(&gp.head, rcu_nocb_gp_done, rdp->rsp, 0, false);
+	wait_for_completion(&gp.completion);
+	destroy_rcu_head_on_stack(&gp.head);
+}
+
+/*
+ * Per-rcu_data kthread: take the whole list, wait for a grace period,
+ * invoke the callbacks in order, repeat.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_data *rdp = arg;
+	struct rcu_head *list;
+	struct rcu_head *next;
+	struct rcu_head **tail;
+	long c;
+
+	set_cpus_allowed_ptr(current, rcu_nocb_housekeeping);
+	for (;;) {
+		wait_event(rdp->nocb_wq, ACCESS_ONCE(rdp->nocb_head));
+		list = ACCESS_ONCE(rdp->nocb_head);
+		if (!list)
+			continue;
+
+		/* Detach the list, the enqueuers start a fresh one. */
+		ACCESS_ONCE(rdp->nocb_head) = NULL;
+		tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+
+		rcu_nocb_wait_gp(rdp);
+
+		c = 0;
+		while (list) {
+			next = list->next;
+			/* An enqueuer may not have linked its callback yet. */
+			while (next == NULL && &list->next != tail) {
+				schedule_timeout_interruptible(1);
+				next = ACCESS_ONCE(list->next);
+			}
+			debug_rcu_head_unqueue(list);
+			local_bh_disable();
+			__rcu_reclaim(rdp->rsp->name, list);
+			local_bh_enable();
+			list = next;
+			c++;
+			cond_resched();
+		}
+		atomic_long_sub(c, &rdp->nocb_q_count);
+		ACCESS_ONCE(rdp->n_nocb_invoked) += c;
+		trace_rcu_batch_end(rdp->rsp->name, c, 0, need_resched(), 0, 1);
+	}
+	return 0;
+}
+
+static void __init rcu_spawn_nocb_kthreads(struct rcu_state *rsp)
+{
+	struct rcu_data *rdp;
+	struct task_struct *t;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		if (!rcu_is_nocb_cpu(cpu))
+			continue;
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		t = kthread_run(rcu_nocb_kthread, rdp, "rcuo%c/%d",
+				rsp->name[4], cpu);
+		if (IS_ERR(t)) {
+			printk(KERN_ERR "rcu: no rcuo kthread for CPU %d\n",
+			       cpu);
+			continue;
+		}
+		ACCESS_ONCE(rdp->nocb_kthread) = t;
+		/* Pick up whatever was queued before the kthread existed. */
+		wake_up(&rdp->nocb_wq);
+	}
+}
+
+static int __init rcu_spawn_nocb_kthreads_all(void)
+{
+	if (!have_rcu_nocb_mask)
+		return 0;
+
+	if (!zalloc_cpumask_var(&rcu_nocb_housekeeping, GFP_KERNEL))
+		return -ENOMEM;
+	cpumask_andnot(rcu_nocb_housekeeping, cpu_possible_mask,
+		       rcu_nocb_mask);
+
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_nocb_kthreads(&rcu_preempt_state);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	rcu_spawn_nocb_kthreads(&rcu_sched_state);
+	rcu_spawn_nocb_kthreads(&rcu_bh_state);
+	return 0;
+}
+early_initcall(rcu_spawn_nocb_kthreads_all);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static void __init rcu_init_nocb(void)
+{
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+}
+
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    bool lazy)
+{
+	return false;
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
@@ -1468,6 +1468,7 @@ ttwu_do_activate(struct rq *rq, struct task_struct *p, int wake_flags)
 #endif
 
 	ttwu_activate(rq, p, ENQUEUE_WAKEUP | ENQUEUE_WAKING);
+	sched_latency_wakeup(rq, p);
 	ttwu_do_wakeup(rq, p, wake_flags);
 }
 
@@ -1512,8 +1513,10 @@ static void sched_ttwu_pending(void)
 
 void scheduler_ipi(void)
 {
-	if (llist_empty(&this_rq()->wake_list) && !got_nohz_idle_kick())
+	if (llist_empty(&this_rq()->wake_list) && !got_nohz_idle_kick()) {
+		tick_nohz_full_check();
 		return;
+	}
 
 	/*
 	 * Not all reschedule IPI handlers call irq_enter/irq_exit, since
@@ -1759,9 +1762,19 @@ static void __sched_fork(struct task_struct *p)
 	p->se.vruntime			= 0;
 	INIT_LIST_HEAD(&p->se.group_node);
 
+#ifdef CONFIG_SMP
+	/* Unknown until the first sleep, treat as a heavy task */
+	p->se.pack_stamp		= 0;
+	p->se.pack_runtime		= 0;
+	p->se.pack_util			= SCHED_POWER_SCALE;
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
+#ifdef CONFIG_SCHED_LATENCY
+	memset(&p->sched_latency, 0, sizeof(p->sched_latency));
+#endif
 
 	INIT_LIST_HEAD(&p->rt.run_list);
 
@@ -3471,6 +3484,7 @@ need_resched:
 
 	put_prev_task(rq, prev);
 	next = pick_next_task(rq);
+	sched_latency_arrive(rq, next);
 	clear_tsk_need_resched(prev);
 	rq->skip_clock_update = 0;
 
@@ -4266,6 +4280,20 @@ int idle_cpu(int cpu)
 	return 1;
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * sched_can_stop_tick - is the current task alone on this cpu?
+ *
+ * With nothing to preempt it for, the tick can be stopped while it runs.
+ */
+bool sched_can_stop_tick(void)
+{
+	struct rq *rq = this_rq();
+
+	return rq->nr_running == 1 && rq->curr != rq->idle;
+}
+#endif
+
 /**
  * idle_task - return the idle task for a given cpu.
  * @cpu: the processor in question.
@@ -84,6 +84,18 @@ unsigned int sysctl_sched_child_runs_first __read_mostly;
  */
 unsigned int __read_mostly sysctl_sched_wake_to_idle;
 
+#ifdef CONFIG_SMP
+/*
+ * Small task packing: wake tasks that use less than sched_small_task_pct
+ * of a cpu on the lowest-numbered cpu that stays below
+ * sched_pack_capacity_pct with them on board, so that the higher cpus
+ * stay idle long enough for hotplug to take them down.
+ */
+unsigned int __read_mostly sysctl_sched_packing;
+unsigned int __read_mostly sysctl_sched_small_task_pct = 20;
+unsigned int __read_mostly sysctl_sched_pack_capacity_pct = 80;
+#endif
+
 /*
  * SCHED_OTHER wake-up granularity.
  * (default: 1 msec * (1 + ilog(ncpus)), units: nanoseconds)
@@ -2667,6 +2679,111 @@ find_idlest_cpu(struct sched_group *group, struct task_struct *p, int this_cpu)
 	return idlest;
 }
 
+/*
+ * Runqueue utilization is folded every PACK_WINDOW ns; an idle
+ * runqueue's figure halves for every window it stays idle.
+ */
+#define PACK_WINDOW_SHIFT	23
+#define PACK_WINDOW		(1ULL << PACK_WINDOW_SHIFT)
+
+/*
+ * Called with the rq lock held and a fresh rq->clock, right before
+ * nr_running changes.
+ */
+void update_rq_pack_util(struct rq *rq)
+{
+	u64 now = rq->clock;
+	u64 delta;
+	unsigned long util;
+
+	if (rq->nr_running)
+		rq->pack_busy += now - rq->pack_stamp;
+	rq->pack_stamp = now;
+
+	delta = now - rq->pack_window_start;
+	if (delta < PACK_WINDOW)
+		return;
+
+	util = div64_u64(rq->pack_busy << SCHED_POWER_SHIFT, delta);
+	util = min_t(unsigned long, util, SCHED_POWER_SCALE);
+	rq->pack_util = (rq->pack_util + util) >> 1;
+	rq->pack_busy = 0;
+	rq->pack_window_start = now;
+}
+
+/*
+ * Remote, unlocked read: the stamp may tear on 32-bit, which at worst
+ * misjudges one packing decision.
+ */
+static unsigned int rq_pack_util(struct rq *rq, u64 now)
+{
+	unsigned int util = ACCESS_ONCE(rq->pack_util);
+	u64 stamp = ACCESS_ONCE(rq->pack_stamp);
+	unsigned int windows;
+
+	if (now <= stamp)
+		return util;
+
+	windows = min_t(u64, (now - stamp) >> PACK_WINDOW_SHIFT, 31);
+	if (rq->nr_running)
+		return windows ? SCHED_POWER_SCALE : util;
+
+	return util >> windows;
+}
+
+/* Fold the busy fraction since the previous wakeup into p's estimate */
+static void update_task_pack_util(struct task_struct *p, u64 now)
+{
+	struct sched_entity *se = &p->se;
+	u64 elapsed = now - se->pack_stamp;
+	u64 runtime = se->sum_exec_runtime - se->pack_runtime;
+	unsigned long util;
+
+	if (se->pack_stamp && elapsed >= PACK_WINDOW >> 3) {
+		util = div64_u64(runtime << SCHED_POWER_SHIFT, elapsed);
+		util = min_t(unsigned long, util, SCHED_POWER_SCALE);
+		se->pack_util = (se->pack_util * 3 + util) >> 2;
+	} else if (se->pack_stamp) {
+		return;
+	}
+
+	se->pack_stamp = now;
+	se->pack_runtime = se->sum_exec_runtime;
+}
+
+static inline bool task_small(struct task_struct *p)
+{
+	return p->se.pack_util * 100 <=
+		sysctl_sched_small_task_pct * SCHED_POWER_SCALE;
+}
+
+static inline bool rq_has_room(struct rq *rq, unsigned int util, u64 now)
+{
+	return (rq_pack_util(rq, now) + util) * 100 <=
+		sysctl_sched_pack_capacity_pct * SCHED_POWER_SCALE;
+}
+
+/*
+ * Returns the cpu a waking small task should be packed on, or -1 to
+ * let the regular wakeup balancing decide.
+ */
+static int select_packing_cpu(struct task_struct *p)
+{
+	u64 now = local_clock();
+	int i;
+
+	update_task_pack_util(p, now);
+	if (!sysctl_sched_packing || !task_small(p))
+		return -1;
+
+	for_each_cpu_and(i, cpu_active_mask, tsk_cpus_allowed(p)) {
+		if (rq_has_room(cpu_rq(i), p->se.pack_util, now))
+			return i;
+	}
+
+	return -1;
+}
+
 /*
  * Try and locate an idle CPU in the sched_domain.
  */
@@ -2750,6 +2867,11 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 		return prev_cpu;
 
 	if (sd_flag & SD_BALANCE_WAKE) {
+		new_cpu = select_packing_cpu(p);
+		if (new_cpu >= 0)
+			return new_cpu;
+		new_cpu = cpu;
+
 		if (cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
 			want_affine = 1;
 		new_cpu = prev_cpu;
@@ -3181,6 +3303,19 @@ task_hot(struct task_struct *p, u64 now, struct sched_domain *sd)
 	return delta < (s64)sysctl_sched_migration_cost;
 }
 
+/*
+ * Keep the periodic and idle balancers from spreading packed small
+ * tasks back out to higher cpus while their cpu still has room.
+ */
+static bool pack_defers_migration(struct task_struct *p, struct lb_env *env)
+{
+	if (!sysctl_sched_packing || env->dst_cpu < env->src_cpu)
+		return false;
+
+	return task_small(p) &&
+		rq_has_room(env->src_rq, 0, env->src_rq->clock);
+}
+
 /*
  * can_migrate_task - may task p from runqueue rq be migrated to this_cpu?
  */
@@ -3200,6 +3335,9 @@ int can_migrate_task(struct task_struct *p, struct lb_env *env)
 	}
 	env->flags &= ~LBF_ALL_PINNED;
 
+	if (pack_defers_migration(p, env))
+		return 0;
+
 	if (task_running(env->src_rq, p)) {
 		schedstat_inc(p, se.statistics.nr_failed_migrations_running);
 		return 0;
@@ -0,0 +1,229 @@
+/*
+ * Wakeup latency accounting: the time from try_to_wake_up() queueing a
+ * task until pick_next_task() selects it, kept as log2 histograms per
+ * task (/proc/<pid>/sched_latency) and per cpu (/proc/sched_latency).
+ *
+ * When kernel.sched_latency_dump_us is non-zero, a wakeup that waited
+ * at least that long snapshots the runqueue it waited on; the snapshot
+ * is printed from irq_work since the rq lock is held while it is taken.
+ */
+
+#include <linux/slab.h>
+#include <linux/fs.h>
+#include <linux/seq_file.h>
+#include <linux/proc_fs.h>
+#include <linux/irq_work.h>
+#include <linux/uaccess.h>
+
+#include "sched.h"
+
+#define DUMP_MAX_TASKS	8
+
+unsigned int sysctl_sched_latency_dump_us;
+
+struct latency_dump_task {
+	char comm[TASK_COMM_LEN];
+	pid_t pid;
+	int prio;
+};
+
+struct latency_dump {
+	struct irq_work work;
+	bool busy;
+	int cpu;
+	u64 latency_us;
+	struct latency_dump_task woken;
+	struct latency_dump_task prev;
+	unsigned long nr_running;
+	unsigned long cfs_nr_running;
+	unsigned long rt_nr_running;
+	unsigned int nr_tasks;
+	struct latency_dump_task tasks[DUMP_MAX_TASKS];
+};
+
+struct latency_cpu {
+	u64 max;
+	u32 hist[SCHED_LATENCY_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct latency_cpu, latency_cpu);
+static DEFINE_PER_CPU(struct latency_dump, latency_dump);
+
+static inline unsigned int latency_bucket(u64 us)
+{
+	if (!us)
+		return 0;
+	return min_t(unsigned int, ilog2(us) + 1, SCHED_LATENCY_BUCKETS - 1);
+}
+
+static void dump_fill_task(struct latency_dump_task *t, struct task_struct *p)
+{
+	memcpy(t->comm, p->comm, TASK_COMM_LEN);
+	t->pid = p->pid;
+	t->prio = p->prio;
+}
+
+static void latency_dump_print(struct irq_work *work)
+{
+	struct latency_dump *d = container_of(work, struct latency_dump, work);
+	unsigned int i;
+
+	pr_info("sched_latency: %s:%d prio %d waited %lluus on cpu%d\n",
+		d->woken.comm, d->woken.pid, d->woken.prio, d->latency_us,
+		d->cpu);
+	pr_info("sched_latency: cpu%d nr_running %lu cfs %lu rt %lu, "
+		"switching from %s:%d prio %d\n", d->cpu, d->nr_running,
+		d->cfs_nr_running, d->rt_nr_running,
+		d->prev.comm, d->prev.pid, d->prev.prio);
+	for (i = 0; i < d->nr_tasks; i++)
+		pr_info("sched_latency:   queued %s:%d prio %d\n",
+			d->tasks[i].comm, d->tasks[i].pid, d->tasks[i].prio);
+
+	smp_wmb();
+	d->busy = false;
+}
+
+/*
+ * Called with the rq lock held; only records what stayed queued ahead of
+ * @p, the printing happens later.
+ */
+static void latency_dump_rq(struct rq *rq, struct task_struct *p, u64 us)
+{
+	struct latency_dump *d = &per_cpu(latency_dump, cpu_of(rq));
+#ifdef CONFIG_SMP
+	struct task_struct *t;
+#endif
+
+	if (d->busy)
+		return;
+	d->busy = true;
+
+	d->cpu = cpu_of(rq);
+	d->latency_us = us;
+	dump_fill_task(&d->woken, p);
+	dump_fill_task(&d->prev, rq->curr);
+	d->nr_running = rq->nr_running;
+	d->cfs_nr_running = rq->cfs.h_nr_running;
+	d->rt_nr_running = rq->rt.rt_nr_running;
+	d->nr_tasks = 0;
+#ifdef CONFIG_SMP
+	list_for_each_entry(t, &rq->cfs_tasks, se.group_node) {
+		if (t == p || d->nr_tasks >= DUMP_MAX_TASKS)
+			continue;
+		dump_fill_task(&d->tasks[d->nr_tasks++], t);
+	}
+#endif
+
+	irq_work_queue(&d->work);
+}
+
+void __sched_latency_arrive(struct rq *rq, struct task_struct *p, u64 delta)
+{
+	struct latency_cpu *lc = &per_cpu(latency_cpu, cpu_of(rq));
+	u64 us = delta;
+	unsigned int b;
+
+	do_div(us, NSEC_PER_USEC);
+	b = latency_bucket(us);
+
+	p->sched_latency.hist[b]++;
+	if (delta > p->sched_latency.max)
+		p->sched_latency.max = delta;
+
+	lc->hist[b]++;
+	if (delta > lc->max)
+		lc->max = delta;
+
+	if (unlikely(sysctl_sched_latency_dump_us) &&
+	    us >= sysctl_sched_latency_dump_us)
+		latency_dump_rq(rq, p, us);
+}
+
+static void latency_show_hist(struct seq_file *m, const u32 *hist, u64 max)
+{
+	unsigned int b;
+
+	seq_printf(m, "<1us %u\n", hist[0]);
+	for (b = 1; b < SCHED_LATENCY_BUCKETS - 1; b++)
+		seq_printf(m, "%uus %u\n", 1U << (b - 1), hist[b]);
+	seq_printf(m, "%uus+ %u\n", 1U << (b - 1), hist[b]);
+	do_div(max, NSEC_PER_USEC);
+	seq_printf(m, "max %lluus\n", max);
+}
+
+void proc_sched_latency_show_task(struct task_struct *p, struct seq_file *m)
+{
+	struct sched_latency lat = p->sched_latency;
+
+	latency_show_hist(m, lat.hist, lat.max);
+}
+
+void proc_sched_latency_reset_task(struct task_struct *p)
+{
+	memset(p->sched_latency.hist, 0, sizeof(p->sched_latency.hist));
+	p->sched_latency.max = 0;
+}
+
+static int sched_latency_show(struct seq_file *m, void *v)
+{
+	u32 hist[SCHED_LATENCY_BUCKETS] = { 0 };
+	struct latency_cpu *lc;
+	u64 max = 0;
+	unsigned int b;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		lc = &per_cpu(latency_cpu, cpu);
+		for (b = 0; b < SCHED_LATENCY_BUCKETS; b++)
+			hist[b] += lc->hist[b];
+		max = max(max, lc->max);
+	}
+	latency_show_hist(m, hist, max);
+
+	return 0;
+}
+
+static ssize_t sched_latency_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct latency_cpu *lc;
+	struct rq *rq;
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		rq = cpu_rq(cpu);
+		lc = &per_cpu(latency_cpu, cpu);
+		raw_spin_lock_irqsave(&rq->lock, flags);
+		memset(lc, 0, sizeof(*lc));
+		raw_spin_unlock_irqrestore(&rq->lock, flags);
+	}
+
+	return count;
+}
+
+static int sched_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sched_latency_show, NULL);
+}
+
+static const struct file_operations proc_sched_latency_operations = {
+	.open    = sched_latency_open,
+	.read    = seq_read,
+	.write   = sched_latency_write,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+static int __init proc_sched_latency_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		init_irq_work(&per_cpu(latency_dump, cpu).work,
+			      latency_dump_print);
+	proc_create("sched_latency", S_IRUGO | S_IWUSR, NULL,
+		    &proc_sched_latency_operations);
+	return 0;
+}
+module_init(proc_sched_latency_init);
@@ -3,6 +3,7 @@
 #include <linux/mutex.h>
 #include <linux/spinlock.h>
 #include <linux/stop_machine.h>
+#include <linux/tick.h>
 
 #include "cpupri.h"
 
@@ -420,6 +421,12 @@ struct rq {
 	u64 age_stamp;
 	u64 idle_stamp;
 	u64 avg_idle;
+
+	/* fraction of time nr_running > 0, see update_rq_pack_util() */
+	u64 pack_stamp;
+	u64 pack_window_start;
+	u64 pack_busy;
+	unsigned int pack_util;
 #endif
 
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
@@ -925,15 +932,27 @@ extern void cpuacct_charge(struct task_struct *tsk, u64 cputime);
 static inline void cpuacct_charge(struct task_struct *tsk, u64 cputime) {}
 #endif
 
+#ifdef CONFIG_SMP
+extern void update_rq_pack_util(struct rq *rq);
+#else
+static inline void update_rq_pack_util(struct rq *rq) { }
+#endif
+
 static inline void inc_nr_running(struct rq *rq)
 {
 	sched_update_nr_prod(cpu_of(rq), rq->nr_running, true);
+	update_rq_pack_util(rq);
 	rq->nr_running++;
+
+	/* a stretched tick is needed back for preemption */
+	if (rq->nr_running == 2)
+		tick_nohz_full_kick_cpu(cpu_of(rq));
 }
 
 static inline void dec_nr_running(struct rq *rq)
 {
 	sched_update_nr_prod(cpu_of(rq), rq->nr_running, false);
+	update_rq_pack_util(rq);
 	rq->nr_running--;
 }
 
@@ -17,14 +17,40 @@
 #include <linux/percpu.h>
 #include <linux/hrtimer.h>
 #include <linux/sched.h>
+#include <linux/seqlock.h>
 #include <linux/math64.h>
+#include <linux/rcupdate.h>
 
-static DEFINE_PER_CPU(u64, nr_prod_sum);
-static DEFINE_PER_CPU(u64, last_time);
-static DEFINE_PER_CPU(u64, nr);
-static DEFINE_PER_CPU(unsigned long, iowait_prod_sum);
-static DEFINE_PER_CPU(spinlock_t, nr_lock) = __SPIN_LOCK_UNLOCKED(nr_lock);
-static s64 last_get_time;
+/*
+ * The sums below only ever grow; readers keep their own copy of the
+ * previous values and work on the difference, so the update side never
+ * has to be reset by, or wait for, a reader.  Updates of one cpu are
+ * already serialized by its rq->lock, which also keeps interrupts off,
+ * so the seqcount needs no lock of its own.
+ */
+struct nr_stats {
+	seqcount_t seq;
+	u64 nr_prod_sum;
+	u64 iowait_prod_sum;
+	u64 last_time;
+	unsigned long nr;
+};
+
+/*
+ * What the reader saw at its last poll: the committed sums, and what it
+ * added on top for the interval that was still open then.
+ */
+struct nr_prev {
+	u64 nr_prod_sum;
+	u64 iowait_prod_sum;
+	u64 nr_open;
+	u64 iowait_open;
+};
+
+static DEFINE_PER_CPU(struct nr_stats, nr_stats);
+static DEFINE_PER_CPU(struct nr_prev, nr_prev);
+static DEFINE_PER_CPU(struct sched_nr_hook *, nr_hook);
+static u64 last_get_time;
 
 /**
  * sched_get_nr_running_avg
@@ -49,21 +75,49 @@ void sched_get_nr_running_avg(int *avg, int *iowait_avg)
 		return;
 
 	last_get_time = curr_time;
-	/* read and reset nr_running counts */
 	for_each_possible_cpu(cpu) {
-		unsigned long flags;
-
-		spin_lock_irqsave(&per_cpu(nr_lock, cpu), flags);
-		tmp_avg += per_cpu(nr_prod_sum, cpu);
-		tmp_avg += per_cpu(nr, cpu) *
-			(curr_time - per_cpu(last_time, cpu));
-		tmp_iowait = per_cpu(iowait_prod_sum, cpu);
-		tmp_iowait +=  nr_iowait_cpu(cpu) *
-			(curr_time - per_cpu(last_time, cpu));
-		per_cpu(last_time, cpu) = curr_time;
-		per_cpu(nr_prod_sum, cpu) = 0;
-		per_cpu(iowait_prod_sum, cpu) = 0;
-		spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
+		struct nr_stats *st = &per_cpu(nr_stats, cpu);
+		struct nr_prev *prev = &per_cpu(nr_prev, cpu);
+		u64 nr_sum, iowait_sum, last_time;
+		u64 nr_open = 0, iowait_open = 0;
+		s64 nr_delta, iowait_delta;
+		unsigned long nr;
+		unsigned int seq;
+
+		do {
+			seq = read_seqcount_begin(&st->seq);
+			nr_sum = st->nr_prod_sum;
+			iowait_sum = st->iowait_prod_sum;
+			last_time = st->last_time;
+			nr = st->nr;
+		} while (read_seqcount_retry(&st->seq, seq));
+
+		/*
+		 * Account the time since the last update at the current
+		 * values, separately from the committed sums: the update
+		 * that closes the interval adds all of it again, with the
+		 * iowait count of that moment, which may be lower than the
+		 * one used here.
+		 */
+		if (curr_time > last_time) {
+			nr_open = nr * (curr_time - last_time);
+			iowait_open = nr_iowait_cpu(cpu) *
+				(curr_time - last_time);
+		}
+
+		nr_delta = nr_sum - prev->nr_prod_sum + nr_open -
+			   prev->nr_open;
+		iowait_delta = iowait_sum - prev->iowait_prod_sum +
+			       iowait_open - prev->iowait_open;
+		if (nr_delta > 0)
+			tmp_avg += nr_delta;
+		if (iowait_delta > 0)
+			tmp_iowait += iowait_delta;
+
+		prev->nr_prod_sum = nr_sum;
+		prev->iowait_prod_sum = iowait_sum;
+		prev->nr_open = nr_open;
+		prev->iowait_open = iowait_open;
 	}
 
 	*avg = (int)div64_u64(tmp_avg * 100, diff);
@@ -83,24 +137,53 @@ EXPORT_SYMBOL(sched_get_nr_running_avg);
  * @inc: Whether we are increasing or decreasing the count
  * @return: N/A
  *
- * Update average with latest nr_running value for CPU
+ * Update average with latest nr_running value for CPU.
+ * Called with the rq->lock of @cpu held.
  */
 void sched_update_nr_prod(int cpu, unsigned long nr_running, bool inc)
 {
-	int diff;
-	s64 curr_time;
-	unsigned long flags;
+	struct nr_stats *st = &per_cpu(nr_stats, cpu);
+	struct sched_nr_hook *hook;
+	u64 curr_time, diff = 0;
 
-	spin_lock_irqsave(&per_cpu(nr_lock, cpu), flags);
 	curr_time = sched_clock();
-	diff = curr_time - per_cpu(last_time, cpu);
-	per_cpu(last_time, cpu) = curr_time;
-	per_cpu(nr, cpu) = nr_running + (inc ? 1 : -1);
 
-	BUG_ON(per_cpu(nr, cpu) < 0);
+	write_seqcount_begin(&st->seq);
+	if (curr_time > st->last_time)
+		diff = curr_time - st->last_time;
+	st->last_time = curr_time;
+	st->nr = nr_running + (inc ? 1 : -1);
 
-	per_cpu(nr_prod_sum, cpu) += nr_running * diff;
-	per_cpu(iowait_prod_sum, cpu) += nr_iowait_cpu(cpu) * diff;
-	spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
+	BUG_ON((long)st->nr < 0);
+
+	/*
+	 * A reader that polled since the last update already counted part
+	 * of this interval on top of the committed sums; it takes that back
+	 * out at its next poll, so the full interval is added here.
+	 */
+	st->nr_prod_sum += nr_running * diff;
+	st->iowait_prod_sum += nr_iowait_cpu(cpu) * diff;
+	write_seqcount_end(&st->seq);
+
+	hook = rcu_dereference_sched(per_cpu(nr_hook, cpu));
+	if (hook && (nr_running < hook->threshold) !=
+		    (st->nr < hook->threshold))
+		hook->func(hook, cpu, st->nr);
 }
 EXPORT_SYMBOL(sched_update_nr_prod);
+
+/**
+ * sched_set_nr_hook
+ * @cpu: The core id the hook is for.
+ * @hook: The hook, or NULL to remove the current one.
+ * @return: N/A
+ *
+ * Install a callback for nr_running threshold crossings of @cpu. After
+ * removing a hook the caller must wait for synchronize_sched() before
+ * freeing it or anything the callback uses.
+ */
+void sched_set_nr_hook(int cpu, struct sched_nr_hook *hook)
+{
+	rcu_assign_pointer(per_cpu(nr_hook, cpu), hook);
+}
+EXPORT_SYMBOL(sched_set_nr_hook);
@@ -229,3 +229,35 @@ static inline void account_group_exec_runtime(struct task_struct *tsk,
 	cputimer->cputime.sum_exec_runtime += ns;
 	raw_spin_unlock(&cputimer->lock);
 }
+
+#ifdef CONFIG_SCHED_LATENCY
+extern void __sched_latency_arrive(struct rq *rq, struct task_struct *p,
+				   u64 delta);
+
+/* Called with the rq lock held once ttwu() has queued @p */
+static inline void sched_latency_wakeup(struct rq *rq, struct task_struct *p)
+{
+	p->sched_latency.wakeup_stamp = rq->clock ? rq->clock : 1;
+}
+
+/* Called with the rq lock held when @p was picked to run next */
+static inline void sched_latency_arrive(struct rq *rq, struct task_struct *p)
+{
+	u64 stamp = p->sched_latency.wakeup_stamp;
+	u64 now = rq->clock;
+
+	if (!stamp)
+		return;
+	p->sched_latency.wakeup_stamp = 0;
+
+	/* The task may have been woken on another cpu's clock */
+	__sched_latency_arrive(rq, p, now > stamp ? now - stamp : 0);
+}
+#else
+static inline void sched_latency_wakeup(struct rq *rq, struct task_struct *p)
+{
+}
+static inline void sched_latency_arrive(struct rq *rq, struct task_struct *p)
+{
+}
+#endif
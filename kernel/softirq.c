@@ -350,6 +350,8 @@ void irq_exit(void)
 	if (idle_cpu(smp_processor_id()) && !in_interrupt() && !need_resched())
 		tick_nohz_irq_exit();
 #endif
+	if (!in_interrupt())
+		tick_nohz_full_check();
 	rcu_irq_exit();
 	sched_preempt_enable_no_resched();
 }
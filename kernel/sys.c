@@ -14,6 +14,7 @@
 #include <linux/fs.h>
 #include <linux/kmod.h>
 #include <linux/perf_event.h>
+#include <linux/cgroup_timer_slack.h>
 #include <linux/resource.h>
 #include <linux/kernel.h>
 #include <linux/kexec.h>
@@ -1966,6 +1967,9 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 					current->default_timer_slack_ns;
 			else
 				current->timer_slack_ns = arg2;
+			/* no less than the timer slack cgroup asks for */
+			current->timer_slack_ns = max(current->timer_slack_ns,
+					task_timer_slack_min(current));
 			error = 0;
 			break;
 		case PR_MCE_KILL:
@@ -11,6 +11,7 @@
  *
  *  Distribute under GPLv2.
  */
+#include <linux/bootmem.h>
 #include <linux/cpu.h>
 #include <linux/err.h>
 #include <linux/hrtimer.h>
@@ -129,6 +130,225 @@ static int __init setup_tick_nohz(char *str)
 
 __setup("nohz=", setup_tick_nohz);
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Adaptive tick: on the CPUs given by nohz_full=, a tick that finds a
+ * single task running in user mode is pushed out to the next timer
+ * wheel event, at most TICK_NOHZ_FULL_MAX_JIFFIES away. Whatever needs
+ * the tick back - a second runnable task, an earlier timer, a grace
+ * period waiting on this CPU - kicks the CPU with an IPI and the tick
+ * is restarted on the way out of that interrupt. The ticks that did
+ * not happen are charged to the task as user time afterwards.
+ *
+ * Jiffies are kept by a housekeeping CPU, which does not stop its
+ * tick while any nohz_full CPU is busy.
+ */
+#define TICK_NOHZ_FULL_MAX_JIFFIES	HZ
+
+static cpumask_var_t tick_nohz_full_mask;
+static bool have_nohz_full_mask;
+
+static int __init tick_nohz_full_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&tick_nohz_full_mask);
+	if (cpulist_parse(str, tick_nohz_full_mask) < 0) {
+		pr_warning("NOHZ: bad nohz_full= cpu list\n");
+		return 1;
+	}
+	/* the boot CPU keeps jiffies */
+	cpumask_clear_cpu(0, tick_nohz_full_mask);
+	have_nohz_full_mask = !cpumask_empty(tick_nohz_full_mask);
+	return 1;
+}
+__setup("nohz_full=", tick_nohz_full_setup);
+
+bool tick_nohz_full_cpu(int cpu)
+{
+	return have_nohz_full_mask && cpumask_test_cpu(cpu, tick_nohz_full_mask);
+}
+
+/**
+ * tick_nohz_full_kick_cpu - give a CPU its tick back
+ * @cpu: the CPU, which may be the current one
+ *
+ * No-op unless @cpu has its tick stretched right now.
+ */
+void tick_nohz_full_kick_cpu(int cpu)
+{
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+
+	if (!ACCESS_ONCE(ts->full_stretched) || ACCESS_ONCE(ts->full_kick))
+		return;
+	ACCESS_ONCE(ts->full_kick) = 1;
+	smp_send_reschedule(cpu);
+}
+
+/* A timer was queued on @cpu; kick it if its tick would be late for it. */
+void tick_nohz_full_kick_timer(int cpu, unsigned long expires)
+{
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+
+	if (ACCESS_ONCE(ts->full_stretched) &&
+	    time_before(expires, ts->full_next_jiffies))
+		tick_nohz_full_kick_cpu(cpu);
+}
+
+/*
+ * Charge the ticks missed since the last one that ran. A tick that
+ * runs accounts for itself, so from the tick one less is missing.
+ */
+static void tick_nohz_full_account(struct tick_sched *ts, ktime_t now,
+				   int from_tick)
+{
+	u64 delta = ktime_to_ns(ktime_sub(now, ts->full_last_tick));
+	unsigned long missed;
+	cputime_t t;
+
+	missed = div_u64(delta, (u32)ktime_to_ns(tick_period));
+	if (from_tick && missed)
+		missed--;
+	if (!missed)
+		return;
+
+	t = jiffies_to_cputime(missed);
+	account_user_time(current, t, cputime_to_scaled(t));
+	ts->full_saved_ticks += missed;
+}
+
+static void tick_nohz_full_restart(struct tick_sched *ts, ktime_t now)
+{
+	tick_nohz_full_account(ts, now, 0);
+	ts->full_stretched = 0;
+	ts->full_kick = 0;
+
+	hrtimer_cancel(&ts->sched_timer);
+	hrtimer_set_expires(&ts->sched_timer, ts->full_last_tick);
+	for (;;) {
+		hrtimer_forward(&ts->sched_timer, now, tick_period);
+		hrtimer_start_expires(&ts->sched_timer,
+				      HRTIMER_MODE_ABS_PINNED);
+		/* Check, if the timer was already in the past */
+		if (hrtimer_active(&ts->sched_timer))
+			break;
+		now = ktime_get();
+	}
+}
+
+/**
+ * tick_nohz_full_check - restart a stretched tick if it was kicked
+ *
+ * Called from irq_exit() with interrupts disabled.
+ */
+void tick_nohz_full_check(void)
+{
+	struct tick_sched *ts = &__get_cpu_var(tick_cpu_sched);
+
+	if (ts->full_stretched && ACCESS_ONCE(ts->full_kick))
+		tick_nohz_full_restart(ts, ktime_get());
+}
+
+/* Hand the jiffies update to a housekeeping CPU. */
+static void tick_nohz_full_drop_timekeeping(void)
+{
+	int hk;
+
+	tick_do_timer_cpu = TICK_DO_TIMER_NONE;
+	for_each_online_cpu(hk) {
+		if (!tick_nohz_full_cpu(hk)) {
+			wake_up_idle_cpu(hk);
+			break;
+		}
+	}
+}
+
+/*
+ * Called by a housekeeping CPU about to stop its idle tick: while a
+ * nohz_full CPU is busy, the jiffies update stays with (or moves to)
+ * this CPU and the tick keeps running.
+ */
+static bool tick_nohz_full_keep_timekeeping(int cpu)
+{
+	int i;
+
+	if (!have_nohz_full_mask || tick_nohz_full_cpu(cpu))
+		return false;
+
+	for_each_cpu_and(i, tick_nohz_full_mask, cpu_online_mask) {
+		if (!idle_cpu(i)) {
+			if (tick_do_timer_cpu == TICK_DO_TIMER_NONE)
+				tick_do_timer_cpu = cpu;
+			return tick_do_timer_cpu == cpu;
+		}
+	}
+	return false;
+}
+
+/*
+ * Called from the tick. Returns true if the next tick was moved out
+ * past the following jiffy, in which case the sched timer is already
+ * set to it.
+ */
+static bool tick_nohz_full_stretch(struct tick_sched *ts, int cpu, int user,
+				   ktime_t now)
+{
+	unsigned long seq, last_jiffies, delta_jiffies, rcu_delta_jiffies;
+	ktime_t last_update;
+
+	if (ts->full_stretched) {
+		tick_nohz_full_account(ts, hrtimer_get_expires(&ts->sched_timer),
+				       1);
+		ts->full_stretched = 0;
+	}
+
+	if (!user || !tick_nohz_full_cpu(cpu) ||
+	    ts->nohz_mode != NOHZ_MODE_HIGHRES)
+		return false;
+
+	if (tick_do_timer_cpu == cpu) {
+		tick_nohz_full_drop_timekeeping();
+		return false;
+	}
+
+	if (!sched_can_stop_tick() || need_resched() ||
+	    local_softirq_pending() || printk_needs_cpu(cpu) ||
+	    arch_needs_cpu(cpu))
+		return false;
+
+	/* Callbacks need the tick to move their grace periods along */
+	if (rcu_needs_cpu(cpu, &rcu_delta_jiffies) ||
+	    rcu_delta_jiffies != ULONG_MAX)
+		return false;
+
+	do {
+		seq = read_seqbegin(&xtime_lock);
+		last_update = last_jiffies_update;
+		last_jiffies = jiffies;
+	} while (read_seqretry(&xtime_lock, seq));
+
+	delta_jiffies = get_next_timer_interrupt(last_jiffies) - last_jiffies;
+	delta_jiffies = min_t(unsigned long, delta_jiffies,
+			      TICK_NOHZ_FULL_MAX_JIFFIES);
+	if ((long)delta_jiffies <= 1)
+		return false;
+
+	ts->full_last_tick = hrtimer_get_expires(&ts->sched_timer);
+	ts->full_next_jiffies = last_jiffies + delta_jiffies;
+	ts->full_kick = 0;
+	ts->full_stretched = 1;
+	ts->full_stretches++;
+
+	hrtimer_set_expires(&ts->sched_timer,
+			    ktime_add_ns(last_update,
+					 ktime_to_ns(tick_period) * delta_jiffies));
+	return true;
+}
+#else
+static inline bool tick_nohz_full_keep_timekeeping(int cpu)
+{
+	return false;
+}
+#endif /* CONFIG_NO_HZ_FULL */
+
 /**
  * tick_nohz_update_jiffies - update jiffies when idle was interrupted
  *
@@ -284,6 +504,7 @@ static void tick_nohz_stop_sched_tick(struct tick_sched *ts)
 	ktime_t last_update, expires, now;
 	struct clock_event_device *dev = __get_cpu_var(tick_cpu_device).evtdev;
 	u64 time_delta;
+	bool keep_timekeeping;
 	int cpu;
 
 	cpu = smp_processor_id();
@@ -329,8 +550,10 @@ static void tick_nohz_stop_sched_tick(struct tick_sched *ts)
 		time_delta = timekeeping_max_deferment();
 	} while (read_seqretry(&xtime_lock, seq));
 
+	keep_timekeeping = tick_nohz_full_keep_timekeeping(cpu);
+
 	if (rcu_needs_cpu(cpu, &rcu_delta_jiffies) || printk_needs_cpu(cpu) ||
-	    arch_needs_cpu(cpu)) {
+	    arch_needs_cpu(cpu) || keep_timekeeping) {
 		next_jiffies = last_jiffies + 1;
 		delta_jiffies = 1;
 	} else {
@@ -365,7 +588,7 @@ static void tick_nohz_stop_sched_tick(struct tick_sched *ts)
 		 * max_deferement value which we retrieved
 		 * above. Otherwise we can sleep as long as we want.
 		 */
-		if (cpu == tick_do_timer_cpu) {
+		if (cpu == tick_do_timer_cpu && !keep_timekeeping) {
 			tick_do_timer_cpu = TICK_DO_TIMER_NONE;
 			ts->do_timer_last = 1;
 		} else if (tick_do_timer_cpu != TICK_DO_TIMER_NONE) {
@@ -882,6 +1105,10 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 			 */
 			wakeup_user();
 		}
+#ifdef CONFIG_NO_HZ_FULL
+		if (tick_nohz_full_stretch(ts, cpu, user_mode(regs), now))
+			return HRTIMER_RESTART;
+#endif
 	}
 
 	hrtimer_forward(timer, now, tick_period);
@@ -937,6 +1164,9 @@ void tick_cancel_sched_timer(int cpu)
 	ts->inidle = 0;
 	ts->tick_stopped = 0;
 	ts->idle_active = 0;
+#ifdef CONFIG_NO_HZ_FULL
+	ts->full_stretched = 0;
+#endif
 }
 #endif
 
@@ -40,6 +40,7 @@
 #include <linux/irq_work.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/cgroup_timer_slack.h>
 
 #include <asm/uaccess.h>
 #include <asm/unistd.h>
@@ -761,6 +762,8 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	    !tbase_get_deferrable(timer->base))
 		base->next_timer = timer->expires;
 	internal_add_timer(base, timer);
+	if (base == new_base && !tbase_get_deferrable(timer->base))
+		tick_nohz_full_kick_timer(cpu, timer->expires);
 
 out_unlock:
 	spin_unlock_irqrestore(&base->lock, flags);
@@ -932,6 +935,8 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	 * the timer wheel.
 	 */
 	wake_up_idle_cpu(cpu);
+	if (!tbase_get_deferrable(timer->base))
+		tick_nohz_full_kick_timer(cpu, timer->expires);
 	spin_unlock_irqrestore(&base->lock, flags);
 }
 EXPORT_SYMBOL_GPL(add_timer_on);
@@ -1490,6 +1495,7 @@ signed long __sched schedule_timeout(signed long timeout)
 {
 	struct timer_list timer;
 	unsigned long expire;
+	bool deferrable;
 
 	switch (timeout)
 	{
@@ -1522,7 +1528,14 @@ signed long __sched schedule_timeout(signed long timeout)
 
 	expire = timeout + jiffies;
 
-	setup_timer_on_stack(&timer, process_timeout, (unsigned long)current);
+	/* timer slack cgroup may let this wait for an already awake cpu */
+	deferrable = task_timers_deferrable(current);
+	if (deferrable)
+		setup_deferrable_timer_on_stack(&timer, process_timeout,
+						(unsigned long)current);
+	else
+		setup_timer_on_stack(&timer, process_timeout,
+				     (unsigned long)current);
 	__mod_timer(&timer, expire, false, TIMER_NOT_PINNED);
 	schedule();
 	del_singleshot_timer_sync(&timer);
@@ -1531,6 +1544,8 @@ signed long __sched schedule_timeout(signed long timeout)
 	destroy_timer_on_stack(&timer);
 
 	timeout = expire - jiffies;
+	if (deferrable && timeout < 0)
+		timer_slack_count_deferred(current);
 
  out:
 	return timeout < 0 ? 0 : timeout;
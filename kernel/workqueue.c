@@ -41,6 +41,9 @@
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
 #include <linux/idr.h>
+#include <linux/moduleparam.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "workqueue_sched.h"
 
@@ -243,6 +246,7 @@ struct workqueue_struct {
 
 	int			nr_drainers;	/* W: drain in progress */
 	int			saved_max_active; /* W: saved cwq max_active */
+	atomic_t		nr_idle_wakeups; /* works queued to an idle cpu */
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map	lockdep_map;
 #endif
@@ -255,12 +259,19 @@ struct workqueue_struct *system_nrt_wq __read_mostly;
 struct workqueue_struct *system_unbound_wq __read_mostly;
 struct workqueue_struct *system_freezable_wq __read_mostly;
 struct workqueue_struct *system_nrt_freezable_wq __read_mostly;
+struct workqueue_struct *system_power_efficient_wq __read_mostly;
+struct workqueue_struct *system_freezable_power_efficient_wq __read_mostly;
 EXPORT_SYMBOL_GPL(system_wq);
 EXPORT_SYMBOL_GPL(system_long_wq);
 EXPORT_SYMBOL_GPL(system_nrt_wq);
 EXPORT_SYMBOL_GPL(system_unbound_wq);
 EXPORT_SYMBOL_GPL(system_freezable_wq);
 EXPORT_SYMBOL_GPL(system_nrt_freezable_wq);
+EXPORT_SYMBOL_GPL(system_power_efficient_wq);
+EXPORT_SYMBOL_GPL(system_freezable_power_efficient_wq);
+
+static bool wq_power_efficient = IS_ENABLED(CONFIG_WQ_POWER_EFFICIENT_DEFAULT);
+module_param_named(power_efficient, wq_power_efficient, bool, 0444);
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/workqueue.h>
@@ -1048,6 +1059,15 @@ static void __queue_work(unsigned int cpu, struct workqueue_struct *wq,
 		spin_lock_irqsave(&gcwq->lock, flags);
 	}
 
+	/*
+	 * Count the works that have to run on a cpu which was idle when
+	 * they were queued (a remote cpu, or this one woken by the timer
+	 * of a delayed work); an unbound work runs where it was queued.
+	 */
+	if (idle_cpu(wq->flags & WQ_UNBOUND ? raw_smp_processor_id() :
+		     gcwq->cpu))
+		atomic_inc(&wq->nr_idle_wakeups);
+
 	/* gcwq determined, get cwq and queue */
 	cwq = get_cwq(gcwq->cpu, wq);
 	trace_workqueue_queue_work(cpu, cwq, work);
@@ -3035,6 +3055,9 @@ struct workqueue_struct *__alloc_workqueue_key(const char *fmt,
 	if (flags & WQ_MEM_RECLAIM)
 		flags |= WQ_RESCUER;
 
+	if ((flags & WQ_POWER_EFFICIENT) && wq_power_efficient)
+		flags |= WQ_UNBOUND;
+
 	/*
 	 * Unbound workqueues aren't concurrency managed and should be
 	 * dispatched to workers immediately.
@@ -3915,9 +3938,50 @@ static int __init init_workqueues(void)
 					      WQ_FREEZABLE, 0);
 	system_nrt_freezable_wq = alloc_workqueue("events_nrt_freezable",
 			WQ_NON_REENTRANT | WQ_FREEZABLE, 0);
+	system_power_efficient_wq = alloc_workqueue("events_power_efficient",
+					      WQ_POWER_EFFICIENT, 0);
+	system_freezable_power_efficient_wq = alloc_workqueue(
+			"events_freezable_power_efficient",
+			WQ_FREEZABLE | WQ_POWER_EFFICIENT, 0);
 	BUG_ON(!system_wq || !system_long_wq || !system_nrt_wq ||
 	       !system_unbound_wq || !system_freezable_wq ||
-		!system_nrt_freezable_wq);
+		!system_nrt_freezable_wq || !system_power_efficient_wq ||
+		!system_freezable_power_efficient_wq);
 	return 0;
 }
 early_initcall(init_workqueues);
+
+#ifdef CONFIG_DEBUG_FS
+static int wq_wakeups_show(struct seq_file *m, void *v)
+{
+	struct workqueue_struct *wq;
+
+	spin_lock(&workqueue_lock);
+	list_for_each_entry(wq, &workqueues, list)
+		seq_printf(m, "%-32s %-7s %u\n", wq->name,
+			   wq->flags & WQ_UNBOUND ? "unbound" : "percpu",
+			   atomic_read(&wq->nr_idle_wakeups));
+	spin_unlock(&workqueue_lock);
+	return 0;
+}
+
+static int wq_wakeups_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_wakeups_show, NULL);
+}
+
+static const struct file_operations wq_wakeups_fops = {
+	.open		= wq_wakeups_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wq_debugfs_init(void)
+{
+	debugfs_create_file("workqueue_wakeups", S_IRUGO, NULL, NULL,
+			    &wq_wakeups_fops);
+	return 0;
+}
+late_initcall(wq_debugfs_init);
+#endif
@@ -31,6 +31,135 @@
 #define LZ4_DEFAULT_UNCOMPRESSED_CHUNK_SIZE (8 << 20)
 #define ARCHIVE_MAGICNUMBER 0x184C2102
 
+#ifndef PREBOOT
+#include <linux/kernel.h>
+#include <linux/cpumask.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+/*
+ * Legacy LZ4 chunks are independent of each other, so with the whole
+ * image in memory (initramfs, initrd) the chunks can be decompressed by
+ * the other cpus while this one feeds the results, in order, to flush.
+ * That only helps if there are several chunks: lz4c -l always cuts at
+ * 8MB, so scripts/lz4_chunked.sh packs smaller ones. Chunks that do not
+ * fit LZ4_PARALLEL_CHUNK_SIZE are redone here with the full buffer.
+ */
+#define LZ4_PARALLEL_CHUNK_SIZE	(1 << 20)
+#define LZ4_PARALLEL_MAX_SLOTS	8
+
+struct unlz4_slot {
+	struct work_struct work;
+	const u8 *in;
+	size_t in_len;
+	u8 *out;
+	size_t out_len;
+	int ret;
+};
+
+static void unlz4_slot_work(struct work_struct *work)
+{
+	struct unlz4_slot *slot = container_of(work, struct unlz4_slot, work);
+
+	slot->out_len = LZ4_PARALLEL_CHUNK_SIZE;
+	slot->ret = lz4_decompress_unknownoutputsize(slot->in, slot->in_len,
+						     slot->out,
+						     &slot->out_len);
+}
+
+/*
+ * Returns 0 or -1 like unlz4(), or 1 if it could not set up and the
+ * caller should decompress serially instead. @big is an output buffer
+ * of LZ4_DEFAULT_UNCOMPRESSED_CHUNK_SIZE.
+ */
+static int INIT unlz4_parallel(u8 *inp, int size, u8 *big,
+				int (*flush) (void *, unsigned int),
+				int *posp, void (*error) (char *x))
+{
+	struct unlz4_slot *slots, *slot;
+	unsigned int nslots, submitted = 0, flushed = 0, i;
+	size_t chunksize, dest_len;
+	u8 *out;
+	int ret = -1;
+
+	nslots = min_t(unsigned int, num_online_cpus(),
+		       LZ4_PARALLEL_MAX_SLOTS);
+	slots = kcalloc(nslots, sizeof(*slots), GFP_KERNEL);
+	if (!slots)
+		return 1;
+	for (i = 0; i < nslots; i++) {
+		slots[i].out = large_malloc(LZ4_PARALLEL_CHUNK_SIZE);
+		if (!slots[i].out) {
+			ret = 1;
+			goto exit;
+		}
+		INIT_WORK(&slots[i].work, unlz4_slot_work);
+	}
+
+	for (;;) {
+		/* keep every slot busy */
+		while (submitted - flushed < nslots && size > 0) {
+			if (size < 4) {
+				error("data corrupted");
+				goto drain;
+			}
+			chunksize = get_unaligned_le32(inp);
+			inp += 4;
+			size -= 4;
+			if (posp)
+				*posp += 4;
+			if (chunksize == ARCHIVE_MAGICNUMBER)
+				continue;
+			if (chunksize > size) {
+				error("data corrupted");
+				goto drain;
+			}
+
+			slot = &slots[submitted++ % nslots];
+			slot->in = inp;
+			slot->in_len = chunksize;
+			queue_work(system_unbound_wq, &slot->work);
+
+			inp += chunksize;
+			size -= chunksize;
+			if (posp)
+				*posp += chunksize;
+		}
+		if (flushed == submitted)
+			break;
+
+		slot = &slots[flushed % nslots];
+		flush_work(&slot->work);
+		out = slot->out;
+		dest_len = slot->out_len;
+		if (slot->ret < 0) {
+			/* too big for the slot buffer, or corrupt */
+			out = big;
+			dest_len = LZ4_DEFAULT_UNCOMPRESSED_CHUNK_SIZE;
+			if (lz4_decompress_unknownoutputsize(slot->in,
+					slot->in_len, big, &dest_len) < 0) {
+				error("Decoding failed");
+				goto drain;
+			}
+		}
+		if (flush(out, dest_len) != dest_len)
+			goto drain;
+		flushed++;
+	}
+	ret = 0;
+
+drain:
+	for (; flushed < submitted; flushed++)
+		flush_work(&slots[flushed % nslots].work);
+exit:
+	for (i = 0; i < nslots; i++)
+		if (slots[i].out)
+			large_free(slots[i].out);
+	kfree(slots);
+	return ret;
+}
+#endif
+
 STATIC inline int INIT unlz4(u8 *input, int in_len,
 				int (*fill) (void *, unsigned int),
 				int (*flush) (void *, unsigned int),
@@ -98,6 +227,15 @@ STATIC inline int INIT unlz4(u8 *input, int in_len,
 	if (posp)
 		*posp += 4;
 
+#ifndef PREBOOT
+	if (!fill && !output && num_online_cpus() > 1) {
+		ret = unlz4_parallel(inp, size, outp, flush, posp, error);
+		if (ret <= 0)
+			goto exit_2;
+		ret = -1;
+	}
+#endif
+
 	for (;;) {
 
 		if (fill)
@@ -47,6 +47,36 @@
 
 #include "lz4defs.h"
 
+#if defined(CONFIG_LZ4_DECOMPRESS_NEON) && !defined(STATIC)
+#include <linux/hardirq.h>
+#include <asm/neon.h>
+
+/* Bounds the time spent with preemption off in one NEON section */
+#define LZ4_NEON_CHUNK	(32 * 1024)
+
+static int lz4_uncompress_neon(const BYTE **ip, BYTE **op, const BYTE *iend,
+			       BYTE *oend, const BYTE *dest)
+{
+	BYTE *start;
+	int ret;
+
+	if (!cpu_has_neon() || in_interrupt() || irqs_disabled() ||
+	    this_cpu_read(kernel_neon_busy))
+		return 0;
+
+	do {
+		start = *op;
+		kernel_neon_begin();
+		ret = lz4_decompress_neon(ip, op, iend, oend,
+					  min(oend, start + LZ4_NEON_CHUNK),
+					  dest);
+		kernel_neon_end();
+	} while (!ret && *op != start && *op < oend);
+
+	return ret;
+}
+#endif
+
 static int lz4_uncompress(const char *source, char *dest, int osize)
 {
 	const BYTE *ip = (const BYTE *) source;
@@ -179,6 +209,12 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 	size_t dec64table[] = {0, 0, 0, -1, 0, 1, 2, 3};
 #endif
 
+#if defined(CONFIG_LZ4_DECOMPRESS_NEON) && !defined(STATIC)
+	/* the bulk of the block, the generic loop finishes it */
+	if (lz4_uncompress_neon(&ip, &op, iend, oend, (BYTE *) dest) < 0)
+		goto _output_error;
+#endif
+
 	/* Main Loop */
 	while (ip < iend) {
 
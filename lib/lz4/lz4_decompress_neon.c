@@ -0,0 +1,164 @@
+/*
+ * NEON fast path for the LZ4 decompressor
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Decodes sequences with 16 byte wide literal and match copies for as
+ * long as both buffers have enough slack to absorb the overshoot, and
+ * leaves the last few sequences (and anything it does not like) to the
+ * generic code in lz4_decompress.c, which resumes from the first
+ * sequence not consumed here. Must run inside kernel_neon_begin/end,
+ * which cannot be called from this file as it is built with NEON enabled.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <asm/unaligned.h>
+#include <arm_neon.h>
+
+#include "lz4defs.h"
+
+/*
+ * Both copies below may write up to 15 bytes past their end, and the
+ * next token and offset are read without checks, so a sequence is only
+ * decoded here when this much is left over in both buffers.
+ */
+#define LZ4_NEON_MARGIN		32
+
+/* Row n replicates a period of n bytes over 16 lanes */
+static const u8 lz4_neon_period[16][16] = {
+	{ 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1 },
+	{ 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+	{ 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3 },
+	{ 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0 },
+	{ 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3 },
+	{ 0, 1, 2, 3, 4, 5, 6, 0, 1, 2, 3, 4, 5, 6, 0, 1 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 0, 1, 2, 3, 4, 5, 6 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 1, 2, 3, 4, 5 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 0, 1, 2, 3, 4 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 0, 1, 2, 3 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 0, 1, 2 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 0, 1 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 0 },
+};
+
+static inline void lz4_neon_wildcopy(const u8 *s, u8 *d, u8 *e)
+{
+	do {
+		vst1q_u8(d, vld1q_u8(s));
+		d += 16;
+		s += 16;
+	} while (d < e);
+}
+
+/*
+ * Matches closer than 16 bytes overlap the wide copy. Build one 16 byte
+ * vector holding the repeating pattern and store it at steps of the
+ * largest multiple of the offset that fits, so every store lines up
+ * with the period.
+ */
+static inline void lz4_neon_patterncopy(const u8 *ref, u8 *d, u8 *e,
+					size_t offset)
+{
+	uint8x16_t src = vld1q_u8(ref);
+	uint8x16_t idx = vld1q_u8(lz4_neon_period[offset]);
+	uint8x8x2_t tbl = { { vget_low_u8(src), vget_high_u8(src) } };
+	uint8x16_t pat = vcombine_u8(vtbl2_u8(tbl, vget_low_u8(idx)),
+				     vtbl2_u8(tbl, vget_high_u8(idx)));
+	size_t step = 16 - 16 % offset;
+
+	do {
+		vst1q_u8(d, pat);
+		d += step;
+	} while (d < e);
+}
+
+/*
+ * Decode from *ipp to *opp until @olimit is reached or a sequence
+ * comes too close to @iend or @oend. Returns -1 on corrupt input,
+ * otherwise 0 with *ipp and *opp at the next sequence to decode.
+ */
+int lz4_decompress_neon(const u8 **ipp, u8 **opp, const u8 *iend,
+			u8 *oend, const u8 *olimit, const u8 *dest)
+{
+	const u8 *ip = *ipp;
+	u8 *op = *opp;
+
+	while (op < olimit && iend - ip > LZ4_NEON_MARGIN) {
+		const u8 *seq = ip;
+		const u8 *ref;
+		unsigned token;
+		size_t length;
+		size_t offset;
+		u8 *cpy;
+
+		/* literal run */
+		token = *ip++;
+		length = token >> ML_BITS;
+		if (length == RUN_MASK) {
+			unsigned s;
+
+			do {
+				if (iend - ip <= LZ4_NEON_MARGIN)
+					goto stop;
+				s = *ip++;
+				length += s;
+			} while (s == 255);
+		}
+		if (length + LZ4_NEON_MARGIN > iend - ip ||
+		    length + LZ4_NEON_MARGIN > oend - op)
+			goto stop;
+
+		cpy = op + length;
+		lz4_neon_wildcopy(ip, op, cpy);
+		ip += length;
+
+		/* match */
+		offset = get_unaligned_le16(ip);
+		ref = cpy - offset;
+		if (unlikely(ref < dest))
+			return -1;
+		/* the generic code decides what an offset of 0 means */
+		if (unlikely(!offset))
+			goto stop;
+		ip += 2;
+
+		length = token & ML_MASK;
+		if (length == ML_MASK) {
+			unsigned s;
+
+			do {
+				if (iend - ip <= LZ4_NEON_MARGIN)
+					goto stop;
+				s = *ip++;
+				length += s;
+			} while (s == 255);
+		}
+		length += MINMATCH;
+		if (length + LZ4_NEON_MARGIN > oend - cpy)
+			goto stop;
+
+		op = cpy;
+		cpy = op + length;
+		if (offset >= 16)
+			lz4_neon_wildcopy(ref, op, cpy);
+		else
+			lz4_neon_patterncopy(ref, op, cpy, offset);
+		op = cpy;
+		continue;
+stop:
+		/* nothing of this sequence is committed */
+		ip = seq;
+		break;
+	}
+
+	*ipp = ip;
+	*opp = op;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lz4_decompress_neon);
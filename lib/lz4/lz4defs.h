@@ -149,6 +149,11 @@ typedef struct _U64_S { u64 v; } U64_S;
 		LZ4_COPYPACKET(s, d);	\
 	} while (d < e)
 
+#ifdef CONFIG_LZ4_DECOMPRESS_NEON
+int lz4_decompress_neon(const u8 **ipp, u8 **opp, const u8 *iend,
+			u8 *oend, const u8 *olimit, const u8 *dest);
+#endif
+
 #define LZ4_BLINDCOPY(s, d, l)	\
 	do {	\
 		u8 *e = (d) + l;	\
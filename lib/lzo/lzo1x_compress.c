@@ -43,11 +43,11 @@ literal:
 next:
 		if (unlikely(ip >= ip_end))
 			break;
-		dv = get_unaligned_le32(ip);
+		dv = LZO_GET_LE32(ip);
 		t = ((dv * 0x1824429d) >> (32 - D_BITS)) & D_MASK;
 		m_pos = in + dict[t];
 		dict[t] = (lzo_dict_t) (ip - in);
-		if (unlikely(dv != get_unaligned_le32(m_pos)))
+		if (unlikely(dv != LZO_GET_LE32(m_pos)))
 			goto literal;
 
 		ii -= ti;
@@ -90,7 +90,7 @@ next:
 
 		m_len = 4;
 		{
-#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS) && defined(LZO_USE_CTZ64)
+#if defined(LZO_EFFICIENT_UNALIGNED_ACCESS) && defined(LZO_USE_CTZ64)
 		u64 v;
 		v = get_unaligned((const u64 *) (ip + m_len)) ^
 		    get_unaligned((const u64 *) (m_pos + m_len));
@@ -110,20 +110,19 @@ next:
 #  else
 #    error "missing endian definition"
 #  endif
-#elif defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS) && defined(LZO_USE_CTZ32)
+#elif defined(LZO_EFFICIENT_UNALIGNED_ACCESS) && defined(LZO_USE_CTZ32)
 		u32 v;
-		v = get_unaligned((const u32 *) (ip + m_len)) ^
-		    get_unaligned((const u32 *) (m_pos + m_len));
+		v = LZO_GET32(ip + m_len) ^ LZO_GET32(m_pos + m_len);
 		if (unlikely(v == 0)) {
 			do {
 				m_len += 4;
-				v = get_unaligned((const u32 *) (ip + m_len)) ^
-				    get_unaligned((const u32 *) (m_pos + m_len));
+				v = LZO_GET32(ip + m_len) ^
+				    LZO_GET32(m_pos + m_len);
 				if (v != 0)
 					break;
 				m_len += 4;
-				v = get_unaligned((const u32 *) (ip + m_len)) ^
-				    get_unaligned((const u32 *) (m_pos + m_len));
+				v = LZO_GET32(ip + m_len) ^
+				    LZO_GET32(m_pos + m_len);
 				if (unlikely(ip + m_len >= ip_end))
 					goto m_len_done;
 			} while (v == 0);
@@ -81,11 +81,13 @@ int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 				}
 				t += 3;
 copy_literal_run:
-#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
+#if defined(LZO_EFFICIENT_UNALIGNED_ACCESS)
 				if (likely(HAVE_IP(t + 15) && HAVE_OP(t + 15))) {
 					const unsigned char *ie = ip + t;
 					unsigned char *oe = op + t;
-					do {
+					if (unlikely(t >= LZO_LONG_COPY))
+						memcpy(op, ip, t);
+					else do {
 						COPY8(op, ip);
 						op += 8;
 						ip += 8;
@@ -149,7 +151,7 @@ copy_literal_run:
 				NEED_IP(2);
 			}
 			m_pos = op - 1;
-			next = get_unaligned_le16(ip);
+			next = LZO_GET_LE16(ip);
 			ip += 2;
 			m_pos -= next >> 2;
 			next &= 3;
@@ -173,7 +175,7 @@ copy_literal_run:
 				t += offset + 7 + *ip++;
 				NEED_IP(2);
 			}
-			next = get_unaligned_le16(ip);
+			next = LZO_GET_LE16(ip);
 			ip += 2;
 			m_pos -= next >> 2;
 			next &= 3;
@@ -182,11 +184,13 @@ copy_literal_run:
 			m_pos -= 0x4000;
 		}
 		TEST_LB(m_pos);
-#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
+#if defined(LZO_EFFICIENT_UNALIGNED_ACCESS)
 		if (op - m_pos >= 8) {
 			unsigned char *oe = op + t;
 			if (likely(HAVE_OP(t + 15))) {
-				do {
+				if (unlikely(t >= LZO_LONG_COPY) && op - m_pos >= t)
+					memcpy(op, m_pos, t);
+				else do {
 					COPY8(op, m_pos);
 					op += 8;
 					m_pos += 8;
@@ -224,7 +228,7 @@ copy_literal_run:
 match_next:
 		state = next;
 		t = next;
-#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
+#if defined(LZO_EFFICIENT_UNALIGNED_ACCESS)
 		if (likely(HAVE_IP(6) && HAVE_OP(4))) {
 			COPY4(op, ip);
 			op += t;
@@ -12,8 +12,35 @@
  */
 
 
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
+#define LZO_EFFICIENT_UNALIGNED_ACCESS	1
+#elif defined(CONFIG_LZO_ARM_UNALIGNED) && (__LINUX_ARM_ARCH__ >= 6) && \
+	!defined(STATIC)
+/*
+ * ARMv6+ does unaligned ldr/str in hardware, but get_unaligned() is built
+ * from byte loads on ARM. Packed structs let the compiler use plain word
+ * accesses and keep it away from ldrd/ldm, which would still trap. Not in
+ * the boot decompressor, which may run with the MMU off.
+ */
+#define LZO_EFFICIENT_UNALIGNED_ACCESS	1
+struct lzo_una_u16 { u16 x; } __packed;
+struct lzo_una_u32 { u32 x; } __packed;
+#define LZO_GET32(p)		(((const struct lzo_una_u32 *)(p))->x)
+#define LZO_PUT32(p, v)		(((struct lzo_una_u32 *)(p))->x = (v))
+#define LZO_GET_LE16(p)	\
+		le16_to_cpu(((const struct lzo_una_u16 *)(p))->x)
+#define LZO_GET_LE32(p)		le32_to_cpu(LZO_GET32(p))
+#endif
+
+#ifndef LZO_GET32
+#define LZO_GET32(p)		get_unaligned((const u32 *)(p))
+#define LZO_PUT32(p, v)		put_unaligned((v), (u32 *)(p))
+#define LZO_GET_LE16(p)		get_unaligned_le16(p)
+#define LZO_GET_LE32(p)		get_unaligned_le32(p)
+#endif
+
 #define COPY4(dst, src)	\
-		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
+		LZO_PUT32(dst, LZO_GET32(src))
 #if defined(__x86_64__)
 #define COPY8(dst, src)	\
 		put_unaligned(get_unaligned((const u64 *)(src)), (u64 *)(dst))
@@ -33,6 +60,9 @@
 #define LZO_USE_CTZ32	1
 #endif
 
+/* Literal runs and matches this long are handed to memcpy() */
+#define LZO_LONG_COPY	128
+
 #define M1_MAX_OFFSET	0x0400
 #define M2_MAX_OFFSET	0x0800
 #define M3_MAX_OFFSET	0x4000
@@ -0,0 +1,270 @@
+/*
+ * Time the string helpers used in path lookup and log parsing
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Load the module to get one line per function and length with the cpu
+ * cycles (or ns, without a cycle counter) per call of the kernel's
+ * version and of a plain byte loop. The module refuses to stay loaded
+ * once done. memchr, strlen and strnlen are first checked against the
+ * byte loops, and loading fails with -EINVAL on any mismatch.
+ */
+#include <linux/dcache.h>
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/perf_event.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#define BENCH_MAX	4096
+#define BENCH_LOOPS	256
+
+#define CHECK_WORD	sizeof(unsigned long)
+/* four words and a bit, from each of the first four start offsets */
+#define CHECK_LEN	(4 * CHECK_WORD + 1)
+#define CHECK_OFFS	4
+
+enum bench_op {
+	BENCH_MEMCHR,
+	BENCH_STRLEN,
+	BENCH_STRNLEN,
+	BENCH_NAME_HASH,
+};
+
+static const char * const bench_names[] = {
+	[BENCH_MEMCHR]		= "memchr",
+	[BENCH_STRLEN]		= "strlen",
+	[BENCH_STRNLEN]		= "strnlen",
+	[BENCH_NAME_HASH]	= "full_name_hash",
+};
+
+/* path components, log tags, then larger buffers */
+static const size_t bench_sizes[] __initconst = {
+	4, 8, 15, 32, 64, 255, 1024, 4096,
+};
+
+static struct perf_event *cycles;
+static char *bench_buf;
+
+/* the generic byte loops, for reference */
+static noinline const void * __init byte_memchr(const void *s, int c,
+						size_t n)
+{
+	const unsigned char *p = s;
+
+	while (n--) {
+		if (*p == (unsigned char)c)
+			return p;
+		p++;
+	}
+	return NULL;
+}
+
+static noinline size_t __init byte_strnlen(const char *s, size_t count)
+{
+	const char *sc;
+
+	for (sc = s; count-- && *sc != '\0'; ++sc)
+		/* nothing */;
+	return sc - s;
+}
+
+static noinline unsigned int __init byte_name_hash(const unsigned char *name,
+						   unsigned int len)
+{
+	unsigned long hash = init_name_hash();
+
+	while (len--)
+		hash = partial_name_hash(*name++, hash);
+	return end_name_hash(hash);
+}
+
+/* first, middle and last byte of a word, where the masks get it wrong */
+static bool __init check_pos(const char *s, size_t pos)
+{
+	unsigned long a = (unsigned long)(s + pos) & (CHECK_WORD - 1);
+
+	return a == 0 || a == CHECK_WORD / 2 || a == CHECK_WORD - 1;
+}
+
+/*
+ * One case: s is bench_buf + off, len bytes, with the hit at pos or no
+ * hit when pos == len. The other bytes differ from the hit in bit 0
+ * only, and a hit sits right past the end, so an off-by-one or an
+ * over-read in the word loops shows up as a wrong answer.
+ */
+static int __init check_one(size_t off, size_t len, size_t pos, int c)
+{
+	char *s = bench_buf + off;
+	const void *want, *got;
+	size_t wantn, gotn;
+	int err = 0;
+
+	memset(bench_buf, c ^ 1, CHECK_OFFS + CHECK_LEN + 2 * CHECK_WORD);
+	if (pos < len)
+		s[pos] = c;
+	s[len] = c;
+	want = byte_memchr(s, c, len);
+	got = memchr(s, c, len);
+	if (got != want) {
+		pr_err("test_string_speed: memchr(+%zu, %#x, %zu) hit %zu: %td, want %td\n",
+		       off, c & 0xff, len, pos,
+		       got ? (const char *)got - s : -1,
+		       want ? (const char *)want - s : -1);
+		err++;
+	}
+
+	/* NUL one word past the end: strnlen must stop at len */
+	memset(bench_buf, 0x01, CHECK_OFFS + CHECK_LEN + 2 * CHECK_WORD);
+	if (pos < len)
+		s[pos] = '\0';
+	s[len + CHECK_WORD] = '\0';
+	wantn = byte_strnlen(s, len);
+	gotn = strnlen(s, len);
+	if (gotn != wantn) {
+		pr_err("test_string_speed: strnlen(+%zu, %zu) NUL %zu: %zu, want %zu\n",
+		       off, len, pos, gotn, wantn);
+		err++;
+	}
+
+	s[len] = '\0';
+	wantn = byte_strnlen(s, ~0);
+	gotn = strlen(s);
+	if (gotn != wantn) {
+		pr_err("test_string_speed: strlen(+%zu) len %zu NUL %zu: %zu, want %zu\n",
+		       off, len, pos, gotn, wantn);
+		err++;
+	}
+	return err;
+}
+
+static int __init check_strings(void)
+{
+	static const int chars[] __initconst = { '/', 0x80, 0xff };
+	size_t off, len, pos;
+	int i, err = 0;
+
+	for (off = 0; off < CHECK_OFFS; off++)
+		for (len = 0; len <= CHECK_LEN; len++)
+			for (i = 0; i < ARRAY_SIZE(chars); i++) {
+				err += check_one(off, len, len, chars[i]);
+				for (pos = 0; pos < len; pos++)
+					if (check_pos(bench_buf + off, pos))
+						err += check_one(off, len, pos,
+								 chars[i]);
+			}
+	return err;
+}
+
+static u64 __init bench_now(void)
+{
+	u64 enabled, running;
+
+	if (cycles)
+		return perf_event_read_value(cycles, &enabled, &running);
+	/* No cycle counter: report nanoseconds instead */
+	return ktime_to_ns(ktime_get());
+}
+
+static unsigned long __init bench_one(enum bench_op op, bool ref, size_t n)
+{
+	const char *s = bench_buf;
+	const unsigned char *us = (const unsigned char *)bench_buf;
+
+	switch (op) {
+	case BENCH_MEMCHR:
+		return (unsigned long)(ref ? byte_memchr(s, '/', n) :
+				       memchr(s, '/', n));
+	case BENCH_STRLEN:
+		return ref ? byte_strnlen(s, ~0) : strlen(s);
+	case BENCH_STRNLEN:
+		return ref ? byte_strnlen(s, n) : strnlen(s, n);
+	case BENCH_NAME_HASH:
+		return ref ? byte_name_hash(us, n) : full_name_hash(us, n);
+	}
+	return 0;
+}
+
+static u64 __init bench_run(enum bench_op op, bool ref, size_t n)
+{
+	unsigned long sink = 0;
+	u64 start, t;
+	int i;
+
+	/* NUL for strlen, no '/' for memchr, so every call walks n bytes */
+	memset(bench_buf, 'a', n);
+	bench_buf[n] = '\0';
+
+	bench_one(op, ref, n);
+
+	start = bench_now();
+	for (i = 0; i < BENCH_LOOPS; i++)
+		sink += bench_one(op, ref, n);
+	t = bench_now() - start;
+
+	/* keep the calls from being optimised away */
+	if (sink == 1)
+		pr_debug("test_string_speed: %lu\n", sink);
+	return div_u64(t, BENCH_LOOPS);
+}
+
+static void __init bench_report(enum bench_op op, size_t n)
+{
+	u64 ref = bench_run(op, true, n);
+	u64 opt = bench_run(op, false, n);
+
+	pr_info("%-14s %5zu: byte %6llu kernel %6llu %s\n",
+		bench_names[op], n, ref, opt, cycles ? "cycles" : "ns");
+}
+
+static int __init test_string_speed_init(void)
+{
+	struct perf_event_attr attr = {
+		.type		= PERF_TYPE_HARDWARE,
+		.config		= PERF_COUNT_HW_CPU_CYCLES,
+		.size		= sizeof(attr),
+		.exclude_user	= 1,
+	};
+	int i;
+
+	bench_buf = kmalloc(BENCH_MAX + 1, GFP_KERNEL);
+	if (!bench_buf)
+		return -ENOMEM;
+
+	i = check_strings();
+	if (i) {
+		pr_err("test_string_speed: %d mismatches, not timing\n", i);
+		kfree(bench_buf);
+		return -EINVAL;
+	}
+
+	cycles = perf_event_create_kernel_counter(&attr, -1, current,
+						  NULL, NULL);
+	if (IS_ERR(cycles)) {
+		pr_info("test_string_speed: no cycle counter (%ld), timing in ns\n",
+			PTR_ERR(cycles));
+		cycles = NULL;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		bench_report(BENCH_MEMCHR, bench_sizes[i]);
+		bench_report(BENCH_STRLEN, bench_sizes[i]);
+		bench_report(BENCH_STRNLEN, bench_sizes[i]);
+		bench_report(BENCH_NAME_HASH, bench_sizes[i]);
+	}
+
+	if (cycles)
+		perf_event_release_kernel(cycles);
+	kfree(bench_buf);
+	return -EAGAIN;
+}
+module_init(test_string_speed_init);
+
+MODULE_DESCRIPTION("memchr/strlen/strnlen/full_name_hash benchmark");
+MODULE_LICENSE("GPL");
@@ -225,12 +225,34 @@ static ssize_t max_ratio_store(struct device *dev,
 }
 BDI_SHOW(max_ratio, bdi->max_ratio)
 
+static ssize_t latency_target_us_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct backing_dev_info *bdi = dev_get_drvdata(dev);
+	char *end;
+	unsigned long usecs;
+	ssize_t ret = -EINVAL;
+
+	usecs = simple_strtoul(buf, &end, 10);
+	if (*buf && (end[0] == '\0' || (end[0] == '\n' && end[1] == '\0')) &&
+	    usecs <= UINT_MAX) {
+		bdi->latency_target_us = usecs;
+		ret = count;
+	}
+	return ret;
+}
+BDI_SHOW(latency_target_us, bdi->latency_target_us)
+
+BDI_SHOW(read_latency_us, bdi_read_latency(bdi))
+
 #define __ATTR_RW(attr) __ATTR(attr, 0644, attr##_show, attr##_store)
 
 static struct device_attribute bdi_dev_attrs[] = {
 	__ATTR_RW(read_ahead_kb),
 	__ATTR_RW(min_ratio),
 	__ATTR_RW(max_ratio),
+	__ATTR_RW(latency_target_us),
+	__ATTR(read_latency_us, 0444, read_latency_us_show, NULL),
 	__ATTR_NULL,
 };
 
@@ -680,6 +702,9 @@ int bdi_init(struct backing_dev_info *bdi)
 	bdi->min_ratio = 0;
 	bdi->max_ratio = 100;
 	bdi->max_prop_frac = PROP_FRAC_BASE;
+	bdi->latency_target_us = 0;
+	bdi->read_latency_us = 0;
+	bdi->read_latency_stamp = jiffies - BDI_READ_LATENCY_VALID - 1;
 	spin_lock_init(&bdi->wb_lock);
 	INIT_LIST_HEAD(&bdi->bdi_list);
 	INIT_LIST_HEAD(&bdi->work_list);
@@ -1103,17 +1103,41 @@ static struct compact_thread {
 	struct task_struct *task;
 	struct timer_list timer;
 	atomic_t should_run;
+	/* watermark driven compaction of compact_orders[] */
+	struct timer_list poll_timer;
+	atomic_t proactive;
+	bool screen_on;
 } compact_thread;
 
 static uint compact_interval_sec = 1800;
 module_param_named(interval, compact_interval_sec, uint,
 			S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Proactive compaction keeps at least compact_min_free[i] free blocks of
+ * order compact_orders[i] around, for the high-order allocations of ION
+ * and the GPU. The free lists are checked every compact_poll_msec, zero
+ * turns the check off.
+ */
+static int compact_orders[MAX_ORDER] = { 4, 8 };
+static int compact_orders_size = 2;
+module_param_array_named(orders, compact_orders, int, &compact_orders_size,
+			S_IRUGO | S_IWUSR);
+
+static int compact_min_free[MAX_ORDER] = { 32, 4 };
+static int compact_min_free_size = 2;
+module_param_array_named(min_free, compact_min_free, int,
+			&compact_min_free_size, S_IRUGO | S_IWUSR);
+
+static uint compact_poll_msec = 2000;
+module_param_named(poll_msec, compact_poll_msec, uint, S_IRUGO | S_IWUSR);
+
 static void compact_nodes(void);
 
 static int compact_thread_should_run(void)
 {
-	return atomic_read(&compact_thread.should_run);
+	return atomic_read(&compact_thread.should_run) ||
+		atomic_read(&compact_thread.proactive);
 }
 
 static void compact_thread_wakeup(void)
@@ -1129,15 +1153,80 @@ static void compact_thread_timer_func(unsigned long data)
 			jiffies + (HZ * compact_interval_sec));
 }
 
+/* Free blocks of at least @order, counted in units of @order */
+static unsigned long nr_free_blocks(int order)
+{
+	struct zone *zone;
+	unsigned long nr = 0;
+	int o;
+
+	for_each_populated_zone(zone)
+		for (o = order; o < MAX_ORDER; o++)
+			nr += zone->free_area[o].nr_free << (o - order);
+
+	return nr;
+}
+
+static bool compact_order_low(int i)
+{
+	int order = compact_orders[i];
+
+	if (order <= 0 || order >= MAX_ORDER || i >= compact_min_free_size)
+		return false;
+
+	return nr_free_blocks(order) < compact_min_free[i];
+}
+
+/* With the screen on, only compact when the CPUs have time to spare */
+static bool compact_thread_busy(void)
+{
+	return compact_thread.screen_on && nr_running() > num_online_cpus();
+}
+
+static void compact_thread_poll_func(unsigned long data)
+{
+	int i;
+
+	for (i = 0; compact_poll_msec && i < compact_orders_size; i++) {
+		if (compact_order_low(i)) {
+			atomic_set(&compact_thread.proactive, 1);
+			wake_up(&compact_thread.waitqueue);
+			break;
+		}
+	}
+	/* Keep polling slowly while disabled so the knob can be reenabled */
+	mod_timer(&compact_thread.poll_timer,
+			jiffies + msecs_to_jiffies(compact_poll_msec ?: 1000));
+}
+
+static void compact_proactive(void)
+{
+	int i, nid;
+
+	for (i = 0; i < compact_orders_size; i++) {
+		if (compact_thread_busy())
+			return;
+		if (!compact_order_low(i))
+			continue;
+
+		for_each_online_node(nid)
+			compact_pgdat(NODE_DATA(nid), compact_orders[i]);
+	}
+}
+
 static int compact_thread_func(void *data)
 {
 	set_freezable();
 	for ( ; ; ) {
 		wait_event_freezable(compact_thread.waitqueue,
 				compact_thread_should_run());
-		if (compact_thread_should_run()) {
+		if (atomic_read(&compact_thread.should_run)) {
 			compact_nodes();
 			atomic_set(&compact_thread.should_run, 0);
+			atomic_set(&compact_thread.proactive, 0);
+		} else if (atomic_read(&compact_thread.proactive)) {
+			compact_proactive();
+			atomic_set(&compact_thread.proactive, 0);
 		}
 	}
 	return 0;
@@ -1152,10 +1241,12 @@ static int compact_notifier(struct notifier_block *self,
 		int blank = *(int *)evdata->data;
 
 		if (blank == FB_BLANK_POWERDOWN) {
+			compact_thread.screen_on = false;
 			del_timer_sync(&compact_thread.timer);
 			compact_thread_wakeup();
 			return NOTIFY_OK;
 		} else if (blank == FB_BLANK_UNBLANK) {
+			compact_thread.screen_on = true;
 			if (!timer_pending(&compact_thread.timer))
 				mod_timer(&compact_thread.timer, jiffies +
 						(HZ * compact_interval_sec));
@@ -1301,11 +1392,17 @@ static int  __init mem_compaction_init(void)
 
 	init_timer_deferrable(&compact_thread.timer);
 	compact_thread.timer.function = compact_thread_timer_func;
+	init_timer_deferrable(&compact_thread.poll_timer);
+	compact_thread.poll_timer.function = compact_thread_poll_func;
+	compact_thread.screen_on = true;
 	init_waitqueue_head(&compact_thread.waitqueue);
 	compact_thread.task = kthread_run(compact_thread_func, NULL,
 				"%s", "kcompact");
-	if (!IS_ERR(compact_thread.task))
+	if (!IS_ERR(compact_thread.task)) {
 		sched_setscheduler(compact_thread.task, SCHED_IDLE, &param);
+		mod_timer(&compact_thread.poll_timer,
+			jiffies + msecs_to_jiffies(compact_poll_msec));
+	}
 
 	fb_register_client(&compact_notifier_block);
 	return 0;
@@ -34,8 +34,12 @@
 #include <linux/hardirq.h> /* for BUG_ON(!in_atomic()) only */
 #include <linux/memcontrol.h>
 #include <linux/cleancache.h>
+#include <linux/launch_prefetch.h>
 #include "internal.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/filemap.h>
+
 /*
  * FIXME: remove all knowledge of the buffer layer from the core VM
  */
@@ -1106,14 +1110,18 @@ static void do_generic_file_read(struct file *filp, loff_t *ppos,
 
 		cond_resched();
 find_page:
+		launch_prefetch_record(filp, index);
 		page = find_get_page(mapping, index);
 		if (!page) {
+			ra->ra_misses++;
 			page_cache_sync_readahead(mapping,
 					ra, filp,
 					index, last_index - index);
 			page = find_get_page(mapping, index);
 			if (unlikely(page == NULL))
 				goto no_cached_page;
+		} else {
+			ra->ra_hits++;
 		}
 		if (PageReadahead(page)) {
 			page_cache_async_readahead(mapping,
@@ -1270,6 +1278,7 @@ no_cached_page:
 		 * Ok, it wasn't cached, so we need to create a new
 		 * page..
 		 */
+		trace_mm_filemap_page_cache_miss(filp, index, 1);
 		page = page_cache_alloc_cold(mapping);
 		if (!page) {
 			desc->error = -ENOMEM;
@@ -1528,6 +1537,36 @@ static int page_cache_read(struct file *file, pgoff_t offset)
 
 #define MMAP_LOTSAMISS  (100)
 
+/*
+ * Fault pattern scoring. A fault on the page after the previous one (or
+ * the one after that) counts as sequential, any other new page as
+ * random. Past the thresholds, faults no longer read around: random
+ * mappings only read the faulting page, sequential ones read ahead of it
+ * with the full window.
+ */
+#define MMAP_SCORE_MAX		8
+#define MMAP_SEQ_GAP		2
+#define MMAP_SEQ_THRESH		4
+#define MMAP_RANDOM_THRESH	(-4)
+
+static void mmap_update_pattern(struct file_ra_state *ra, pgoff_t offset)
+{
+	pgoff_t prev = ra->mmap_prev;
+	int score = ra->mmap_score;
+
+	/* A retried or repeated fault tells nothing new */
+	if (offset == prev)
+		return;
+
+	if (offset > prev && offset - prev <= MMAP_SEQ_GAP)
+		score = min(score + 1, MMAP_SCORE_MAX);
+	else
+		score = max(score - 1, -MMAP_SCORE_MAX);
+
+	ra->mmap_score = score;
+	ra->mmap_prev = offset;
+}
+
 /*
  * Synchronous readahead happens when we don't even find
  * a page in the page cache at all.
@@ -1546,12 +1585,17 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 	if (!ra->ra_pages)
 		return;
 
-	if (VM_SequentialReadHint(vma)) {
+	if (VM_SequentialReadHint(vma) ||
+	    ra->mmap_score >= MMAP_SEQ_THRESH) {
 		page_cache_sync_readahead(mapping, ra, file, offset,
 					  ra->ra_pages);
 		return;
 	}
 
+	/* Reading around a random fault only fills memory */
+	if (ra->mmap_score <= MMAP_RANDOM_THRESH)
+		return;
+
 	/* Avoid banging the cache line if not needed */
 	if (ra->mmap_miss < MMAP_LOTSAMISS * 10)
 		ra->mmap_miss++;
@@ -1590,6 +1634,8 @@ static void do_async_mmap_readahead(struct vm_area_struct *vma,
 		return;
 	if (ra->mmap_miss > 0)
 		ra->mmap_miss--;
+	if (ra->mmap_score <= MMAP_RANDOM_THRESH)
+		return;
 	if (PageReadahead(page))
 		page_cache_async_readahead(mapping, ra, file,
 					   page, offset, ra->ra_pages);
@@ -1623,11 +1669,16 @@ int filemap_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	if (offset >= size)
 		return VM_FAULT_SIGBUS;
 
+	launch_prefetch_record(file, offset);
+	if (!VM_RandomReadHint(vma) && !VM_SequentialReadHint(vma))
+		mmap_update_pattern(ra, offset);
+
 	/*
 	 * Do we have something in the page cache already?
 	 */
 	page = find_get_page(mapping, offset);
 	if (likely(page)) {
+		ra->ra_hits++;
 		/*
 		 * We found the page, so try async readahead before
 		 * waiting for the lock.
@@ -1635,6 +1686,7 @@ int filemap_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 		do_async_mmap_readahead(vma, ra, file, page, offset);
 	} else {
 		/* No page in the page cache at all */
+		ra->ra_misses++;
 		do_sync_mmap_readahead(vma, ra, file, offset);
 		count_vm_event(PGMAJFAULT);
 		mem_cgroup_count_vm_event(vma->vm_mm, PGMAJFAULT);
@@ -1684,6 +1736,7 @@ no_cached_page:
 	 * We're only likely to ever get here if MADV_RANDOM is in
 	 * effect.
 	 */
+	trace_mm_filemap_page_cache_miss(file, offset, 1);
 	error = page_cache_read(file, offset);
 
 	/*
@@ -36,6 +36,7 @@
 #include <linux/hash.h>
 #include <linux/freezer.h>
 #include <linux/oom.h>
+#include <linux/fb.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -86,12 +87,16 @@
  * @mm_list: link into the mm_slots list, rooted in ksm_mm_head
  * @rmap_list: head for this mm_slot's singly-linked list of rmap_items
  * @mm: the mm that this information is valid for
+ * @pages_scanned: number of pages of this mm that ksmd has scanned
+ * @pages_merged: number of those scans that merged the page into a ksm page
  */
 struct mm_slot {
 	struct hlist_node link;
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
 	struct mm_struct *mm;
+	unsigned long pages_scanned;
+	unsigned long pages_merged;
 };
 
 /**
@@ -192,6 +197,26 @@ static unsigned int ksm_thread_sleep_millisecs = 20;
 /* Boolean to indicate whether to use deferred timer or not */
 static bool use_deferred_timer;
 
+/*
+ * Auto-tuning: when enabled, ksmd scales its batch between
+ * ksm_auto_pages_min and ksm_auto_pages_max (and then its sleep up to
+ * ksm_auto_sleep_max_millisecs) by the merge ratio of recent batches,
+ * always sleeps on a deferrable timer, and stops while the screen is off.
+ */
+static bool ksm_auto_tune;
+static unsigned int ksm_auto_pages_min = 100;
+static unsigned int ksm_auto_pages_max = 2000;
+static unsigned int ksm_auto_sleep_max_millisecs = 2000;
+
+/* Merge ratio in permille above which to speed up, below which to back off */
+#define KSM_AUTO_RATIO_HIGH	100
+#define KSM_AUTO_RATIO_LOW	10
+
+static unsigned int ksm_auto_pages = 100;
+static unsigned int ksm_auto_sleep_millisecs = 20;
+static unsigned int ksm_merge_ratio;
+static bool ksm_screen_on = true;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -1413,21 +1438,74 @@ next_mm:
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
  * @scan_npages - number of pages we want to scan before we return.
+ * @nr_scanned - incremented for each page scanned.
+ *
+ * Returns the number of scanned pages that got merged.
  */
-static void ksm_do_scan(unsigned int scan_npages)
+static unsigned int ksm_do_scan(unsigned int scan_npages,
+				unsigned int *nr_scanned)
 {
 	struct rmap_item *rmap_item;
+	struct mm_slot *slot;
 	struct page *uninitialized_var(page);
+	unsigned int nr_merged = 0;
 
 	while (scan_npages-- && likely(!freezing(current))) {
 		cond_resched();
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
-			return;
-		if (!PageKsm(page) || !in_stable_tree(rmap_item))
+			break;
+		/* The cursor has not moved past the rmap_item's mm_slot */
+		slot = ksm_scan.mm_slot;
+		slot->pages_scanned++;
+		(*nr_scanned)++;
+		if (!PageKsm(page) || !in_stable_tree(rmap_item)) {
 			cmp_and_merge_page(page, rmap_item);
+			if (in_stable_tree(rmap_item)) {
+				slot->pages_merged++;
+				nr_merged++;
+			}
+		}
 		put_page(page);
 	}
+	return nr_merged;
+}
+
+/*
+ * Feed the result of the last batch into ksm_merge_ratio, a running average
+ * in permille, and scale the batch size and sleep by it: double the batch
+ * while merging pays off, halve it when it does not, and once the batch is
+ * at its minimum start doubling the sleep instead.
+ */
+static void ksm_auto_tune_scan(unsigned int nr_scanned, unsigned int nr_merged)
+{
+	unsigned int ratio;
+
+	if (!nr_scanned)
+		return;
+
+	ratio = nr_merged * 1000 / nr_scanned;
+	ksm_merge_ratio = (3 * ksm_merge_ratio + ratio) / 4;
+
+	if (ksm_merge_ratio >= KSM_AUTO_RATIO_HIGH) {
+		ksm_auto_sleep_millisecs = ksm_thread_sleep_millisecs;
+		ksm_auto_pages = min(ksm_auto_pages * 2, ksm_auto_pages_max);
+	} else if (ksm_merge_ratio < KSM_AUTO_RATIO_LOW) {
+		if (ksm_auto_pages > ksm_auto_pages_min)
+			ksm_auto_pages = max(ksm_auto_pages / 2,
+					     ksm_auto_pages_min);
+		else
+			ksm_auto_sleep_millisecs = min(max(
+					ksm_auto_sleep_millisecs * 2, 1U),
+					ksm_auto_sleep_max_millisecs);
+	}
+}
+
+static void ksm_auto_tune_reset(void)
+{
+	ksm_auto_pages = ksm_auto_pages_min;
+	ksm_auto_sleep_millisecs = ksm_thread_sleep_millisecs;
+	ksm_merge_ratio = 0;
 }
 
 static void process_timeout(unsigned long __data)
@@ -1467,24 +1545,40 @@ out:
 
 static int ksmd_should_run(void)
 {
+	if (ksm_auto_tune && !ksm_screen_on)
+		return 0;
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
 }
 
 static int ksm_scan_thread(void *nothing)
 {
+	unsigned int nr_scanned, nr_merged;
+
 	set_freezable();
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+		if (ksmd_should_run()) {
+			nr_scanned = 0;
+			if (ksm_auto_tune) {
+				nr_merged = ksm_do_scan(ksm_auto_pages,
+							&nr_scanned);
+				ksm_auto_tune_scan(nr_scanned, nr_merged);
+			} else {
+				ksm_do_scan(ksm_thread_pages_to_scan,
+					    &nr_scanned);
+			}
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
 
 		if (ksmd_should_run()) {
-			if (use_deferred_timer)
+			if (ksm_auto_tune)
+				deferred_schedule_timeout(
+				msecs_to_jiffies(ksm_auto_sleep_millisecs));
+			else if (use_deferred_timer)
 				deferred_schedule_timeout(
 				msecs_to_jiffies(ksm_thread_sleep_millisecs));
 			else
@@ -1498,6 +1592,56 @@ static int ksm_scan_thread(void *nothing)
 	return 0;
 }
 
+static int ksm_fb_notifier(struct notifier_block *self,
+				unsigned long event, void *data)
+{
+	struct fb_event *evdata = (struct fb_event *)data;
+
+	if ((event == FB_EVENT_BLANK) && evdata && evdata->data) {
+		int blank = *(int *)evdata->data;
+
+		if (blank == FB_BLANK_POWERDOWN) {
+			ksm_screen_on = false;
+			return NOTIFY_OK;
+		} else if (blank == FB_BLANK_UNBLANK) {
+			ksm_screen_on = true;
+			wake_up_interruptible(&ksm_thread_wait);
+			return NOTIFY_OK;
+		}
+	}
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ksm_fb_notifier_block = {
+	.notifier_call = ksm_fb_notifier,
+	.priority = -1,
+};
+
+/**
+ * ksm_mm_stat - report ksmd's scan statistics for an mm
+ * @mm: the mm to report on
+ * @pages_scanned: set to the number of pages of @mm ksmd has scanned
+ * @pages_merged: set to the number of those that ksmd merged
+ *
+ * Both are left zero if @mm is not registered with ksm.
+ */
+void ksm_mm_stat(struct mm_struct *mm, unsigned long *pages_scanned,
+		 unsigned long *pages_merged)
+{
+	struct mm_slot *mm_slot;
+
+	*pages_scanned = 0;
+	*pages_merged = 0;
+
+	spin_lock(&ksm_mmlist_lock);
+	mm_slot = get_mm_slot(mm);
+	if (mm_slot) {
+		*pages_scanned = mm_slot->pages_scanned;
+		*pages_merged = mm_slot->pages_merged;
+	}
+	spin_unlock(&ksm_mmlist_lock);
+}
+
 int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags)
 {
@@ -1988,6 +2132,124 @@ static ssize_t deferred_timer_store(struct kobject *kobj,
 }
 KSM_ATTR(deferred_timer);
 
+static ssize_t auto_tune_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_auto_tune);
+}
+
+static ssize_t auto_tune_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	unsigned long enable;
+	int err;
+
+	err = kstrtoul(buf, 10, &enable);
+	if (err || enable > 1)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	if (ksm_auto_tune != enable) {
+		ksm_auto_tune = enable;
+		ksm_auto_tune_reset();
+	}
+	mutex_unlock(&ksm_thread_mutex);
+
+	wake_up_interruptible(&ksm_thread_wait);
+
+	return count;
+}
+KSM_ATTR(auto_tune);
+
+static ssize_t auto_pages_min_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_auto_pages_min);
+}
+
+static ssize_t auto_pages_min_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	unsigned long nr_pages;
+	int err;
+
+	err = kstrtoul(buf, 10, &nr_pages);
+	if (err || !nr_pages || nr_pages > ksm_auto_pages_max)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	ksm_auto_pages_min = nr_pages;
+	if (ksm_auto_pages < nr_pages)
+		ksm_auto_pages = nr_pages;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return count;
+}
+KSM_ATTR(auto_pages_min);
+
+static ssize_t auto_pages_max_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_auto_pages_max);
+}
+
+static ssize_t auto_pages_max_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	unsigned long nr_pages;
+	int err;
+
+	err = kstrtoul(buf, 10, &nr_pages);
+	if (err || nr_pages < ksm_auto_pages_min || nr_pages > UINT_MAX / 2)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	ksm_auto_pages_max = nr_pages;
+	if (ksm_auto_pages > nr_pages)
+		ksm_auto_pages = nr_pages;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return count;
+}
+KSM_ATTR(auto_pages_max);
+
+static ssize_t auto_sleep_max_millisecs_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_auto_sleep_max_millisecs);
+}
+
+static ssize_t auto_sleep_max_millisecs_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	unsigned long msecs;
+	int err;
+
+	err = kstrtoul(buf, 10, &msecs);
+	if (err || msecs > UINT_MAX / 2)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	ksm_auto_sleep_max_millisecs = msecs;
+	if (ksm_auto_sleep_millisecs > msecs)
+		ksm_auto_sleep_millisecs = msecs;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return count;
+}
+KSM_ATTR(auto_sleep_max_millisecs);
+
+static ssize_t merge_ratio_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_merge_ratio);
+}
+KSM_ATTR_RO(merge_ratio);
+
 static ssize_t pages_shared_show(struct kobject *kobj,
 				 struct kobj_attribute *attr, char *buf)
 {
@@ -2043,6 +2305,11 @@ static struct attribute *ksm_attrs[] = {
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
 	&deferred_timer_attr.attr,
+	&auto_tune_attr.attr,
+	&auto_pages_min_attr.attr,
+	&auto_pages_max_attr.attr,
+	&auto_sleep_max_millisecs_attr.attr,
+	&merge_ratio_attr.attr,
 	NULL,
 };
 
@@ -2087,6 +2354,7 @@ static int __init ksm_init(void)
 	 */
 	hotplug_memory_notifier(ksm_memory_callback, 100);
 #endif
+	fb_register_client(&ksm_fb_notifier_block);
 	return 0;
 
 out_free:
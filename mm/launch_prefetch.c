@@ -0,0 +1,1014 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * App launch prefetch.
+ *
+ * A cold start spends most of its time waiting on small random reads
+ * from the apk, odex and library files of the app. Those reads are the
+ * same from one launch to the next, so they are recorded once and read
+ * ahead in large sorted requests on the following launches.
+ *
+ * Userspace tags a launch with the app name and the pid of the process
+ * it was started in. If a profile exists for the app, its pages are read
+ * ahead from a kernel worker while the app initializes. If there is none
+ * yet, every page cache lookup done by a read or a fault of that process
+ * on a block device backed file is recorded for record_ms. The records
+ * are then sorted, merged into extents, and kept as the profile of the
+ * app. Profiles are lost on reboot unless userspace saves them from
+ * "profiles" and writes them back to "load".
+ *
+ * Boot works the same way, under the profile name "boot", except that
+ * the page cache misses of all tasks are recorded, as reported by the
+ * mm_filemap_page_cache_miss tracepoint, until userspace writes "stop"
+ * or boot_record_ms passed. Its extents are sorted by their location on
+ * the device rather than by file, so that replaying them early in boot
+ * streams through each partition in large ascending requests while init
+ * carries on.
+ *
+ * The last tagged launch is also published to the I/O schedulers, so that
+ * BFQ can weight-raise the app's queues while it starts.
+ *
+ * debugfs: /sys/kernel/debug/launch_prefetch/
+ *	launch		"<app> <pid>" tags a launch, "boot" tags the start
+ *			of boot once the partitions are mounted, "stop"
+ *			ends recording early
+ *	record_ms	how long a launch is recorded for
+ *	max_records	number of page accesses recorded per launch
+ *	boot_record_ms	how long boot is recorded for
+ *	boot_max_records number of page cache misses recorded for boot
+ *	merge_gap	pages that may be read in between two accesses to
+ *			merge them into one extent
+ *	rerecord	record launches that already have a profile again
+ *	profiles	all profiles. An "app <name>" line, a "file <path>"
+ *			line per file, then a "<file> <start> <nr>" line
+ *			per extent, where <file> counts the file lines
+ *	load		write profiles back in the format of "profiles"
+ *	status		recording state and statistics
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/export.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/path.h>
+#include <linux/dcache.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/hash.h>
+#include <linux/kref.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/blkdev.h>
+#include <linux/launch_prefetch.h>
+#include <trace/events/filemap.h>
+
+#define MODULE_NAME "launch_prefetch"
+
+#define LP_NAME_LEN		64
+#define LP_LINE_MAX		(PATH_MAX + 16)
+#define LP_MAX_FILES		256
+#define LP_BOOT_MAX_FILES	4096
+#define LP_HASH_BITS		10
+#define LP_MAX_RECORDS		(1 << 20)
+#define LP_MAX_PROFILES		64
+#define LP_MAX_PENDING		2
+#define LP_BOOT_NAME		"boot"
+
+/**
+ * struct lp_rec_file - a file touched by the recorded process
+ * @node:	entry in lp_session.hash
+ * @inode:	inode of the file, the key
+ * @path:	reference to the path the file was first touched through
+ */
+struct lp_rec_file {
+	struct hlist_node	node;
+	struct inode		*inode;
+	struct path		path;
+};
+
+struct lp_record {
+	u32	file;
+	u32	index;
+	u32	nr;
+};
+
+struct lp_extent {
+	u32	file;
+	u32	start;
+	u32	nr;
+};
+
+/**
+ * struct lp_profile - the recorded page cache accesses of one launch
+ * @paths:	files in the order they were first touched, NULL if the
+ *		path could not be resolved
+ * @extents:	sorted by file, then by start, or by device location for
+ *		the boot profile
+ * @nr_pages:	sum of the extent sizes
+ */
+struct lp_profile {
+	struct list_head	list;
+	struct kref		kref;
+	char			name[LP_NAME_LEN];
+	unsigned int		nr_files;
+	char			**paths;
+	unsigned int		nr_extents;
+	struct lp_extent	*extents;
+	unsigned long		nr_pages;
+};
+
+struct lp_prefetch {
+	struct work_struct	work;
+	struct lp_profile	*profile;
+	bool			boot;
+};
+
+pid_t launch_prefetch_tgid;
+pid_t launch_prefetch_launch_tgid;
+EXPORT_SYMBOL_GPL(launch_prefetch_launch_tgid);
+unsigned long launch_prefetch_launch_time;
+EXPORT_SYMBOL_GPL(launch_prefetch_launch_time);
+
+/*
+ * A launch or boot being recorded. @lock protects everything but @work.
+ * @tgid is unused for boot, which records all tasks.
+ */
+static struct lp_session {
+	spinlock_t		lock;
+	bool			active;
+	bool			boot;
+	char			name[LP_NAME_LEN];
+	pid_t			tgid;
+	struct hlist_head	hash[1 << LP_HASH_BITS];
+	struct lp_rec_file	*files;
+	unsigned int		nr_files;
+	unsigned int		max_files;
+	struct lp_record	*recs;
+	unsigned int		nr_recs;
+	unsigned int		max_recs;
+	unsigned int		nr_dropped;
+	struct delayed_work	work;
+} lps;
+
+/* Profile being written to "load" */
+static struct lp_loader {
+	struct lp_profile	*profile;
+	unsigned int		max_files;
+	unsigned int		max_extents;
+	char			partial[LP_LINE_MAX];
+	size_t			partial_len;
+} lpl;
+
+static struct lp_stats {
+	unsigned long		launches;
+	unsigned long		hits;
+	unsigned long		recorded;
+	unsigned long		loaded;
+	unsigned long		busy;
+	atomic_long_t		prefetches;
+	atomic_long_t		skipped;
+	atomic_long_t		pages;
+	atomic_long_t		open_errors;
+	unsigned long		boot_pages;
+	s64			boot_ms;
+} lp_stats;
+
+/* Protects the profile list, the loader and starting/stopping lps */
+static DEFINE_MUTEX(lp_lock);
+static LIST_HEAD(lp_profiles);
+static unsigned int lp_nr_profiles;
+static atomic_t lp_pending = ATOMIC_INIT(0);
+
+static u32 lp_record_ms = 3000;
+static u32 lp_max_records = 32768;
+static u32 lp_boot_record_ms = 60000;
+static u32 lp_boot_max_records = 262144;
+static u32 lp_merge_gap = 4;
+static u32 lp_rerecord;
+
+static struct dentry *lp_debug_root;
+
+static void *lp_alloc(size_t size)
+{
+	if (size <= PAGE_SIZE)
+		return kmalloc(size, GFP_KERNEL);
+	return vmalloc(size);
+}
+
+static void lp_free(const void *addr)
+{
+	if (is_vmalloc_addr(addr))
+		vfree(addr);
+	else
+		kfree(addr);
+}
+
+static void lp_record(struct file *file, pgoff_t index, unsigned long nr,
+		      bool boot)
+{
+	struct inode *inode = file->f_mapping->host;
+	struct hlist_head *head;
+	struct hlist_node *pos;
+	struct lp_rec_file *f;
+	struct lp_record *rec;
+	u32 id;
+
+	/* Anything not on a block device is already as fast as it gets */
+	if (!inode->i_sb->s_bdev || index >= U32_MAX || !nr)
+		return;
+	nr = min_t(unsigned long, nr, U32_MAX - index);
+
+	spin_lock(&lps.lock);
+	if (!lps.active || lps.boot != boot)
+		goto out;
+	if (!boot && current->tgid != lps.tgid)
+		goto out;
+
+	head = &lps.hash[hash_ptr(inode, LP_HASH_BITS)];
+	hlist_for_each_entry(f, pos, head, node)
+		if (f->inode == inode)
+			goto found;
+
+	if (lps.nr_files == lps.max_files) {
+		lps.nr_dropped++;
+		goto out;
+	}
+	f = &lps.files[lps.nr_files++];
+	f->inode = inode;
+	f->path = file->f_path;
+	path_get(&f->path);
+	hlist_add_head(&f->node, head);
+found:
+	id = f - lps.files;
+
+	/* A read touches the same page once per copy, keep only the first */
+	if (lps.nr_recs) {
+		rec = &lps.recs[lps.nr_recs - 1];
+		if (rec->file == id && rec->index <= index &&
+		    (u64)index + nr <= (u64)rec->index + rec->nr)
+			goto out;
+	}
+	if (lps.nr_recs == lps.max_recs) {
+		lps.nr_dropped++;
+		goto out;
+	}
+	rec = &lps.recs[lps.nr_recs++];
+	rec->file = id;
+	rec->index = index;
+	rec->nr = nr;
+out:
+	spin_unlock(&lps.lock);
+}
+
+void __launch_prefetch_record(struct file *file, pgoff_t index)
+{
+	lp_record(file, index, 1, false);
+}
+
+static void lp_boot_probe(void *data, struct file *file, pgoff_t index,
+			  unsigned long nr)
+{
+	/* Leave out our own replay and other kernel readers */
+	if (current->flags & PF_KTHREAD)
+		return;
+	lp_record(file, index, nr, true);
+}
+
+static void lp_profile_release(struct kref *kref)
+{
+	struct lp_profile *p = container_of(kref, struct lp_profile, kref);
+	unsigned int i;
+
+	for (i = 0; i < p->nr_files; i++)
+		kfree(p->paths[i]);
+	lp_free(p->paths);
+	lp_free(p->extents);
+	kfree(p);
+}
+
+static void lp_profile_put(struct lp_profile *p)
+{
+	kref_put(&p->kref, lp_profile_release);
+}
+
+static struct lp_profile *lp_profile_alloc(const char *name)
+{
+	struct lp_profile *p;
+
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (!p)
+		return NULL;
+	kref_init(&p->kref);
+	INIT_LIST_HEAD(&p->list);
+	strlcpy(p->name, name, sizeof(p->name));
+	return p;
+}
+
+/* Called with lp_lock held. Moves the profile to the front of the LRU. */
+static struct lp_profile *lp_find_profile(const char *name)
+{
+	struct lp_profile *p;
+
+	list_for_each_entry(p, &lp_profiles, list) {
+		if (!strcmp(p->name, name)) {
+			list_move(&p->list, &lp_profiles);
+			return p;
+		}
+	}
+	return NULL;
+}
+
+/* Called with lp_lock held. Replaces a profile of the same name. */
+static void lp_add_profile(struct lp_profile *p)
+{
+	struct lp_profile *old;
+
+	old = lp_find_profile(p->name);
+	if (old) {
+		list_del(&old->list);
+		lp_nr_profiles--;
+		lp_profile_put(old);
+	}
+
+	list_add(&p->list, &lp_profiles);
+	if (++lp_nr_profiles > LP_MAX_PROFILES) {
+		old = list_entry(lp_profiles.prev, struct lp_profile, list);
+		list_del(&old->list);
+		lp_nr_profiles--;
+		lp_profile_put(old);
+	}
+}
+
+static int lp_record_cmp(const void *a, const void *b)
+{
+	const struct lp_record *ra = a, *rb = b;
+
+	if (ra->file != rb->file)
+		return ra->file < rb->file ? -1 : 1;
+	if (ra->index != rb->index)
+		return ra->index < rb->index ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Merge sorted records into extents. Returns the number of extents, and
+ * fills @ext unless it is NULL.
+ */
+static unsigned int lp_merge(const struct lp_record *recs, unsigned int nr,
+			     u32 gap, struct lp_extent *ext)
+{
+	struct lp_extent cur = { 0, 0, 0 };
+	unsigned int i, n = 0;
+
+	for (i = 0; i < nr; i++) {
+		const struct lp_record *r = &recs[i];
+
+		if (n && r->file == cur.file &&
+		    r->index <= (u64)cur.start + cur.nr + gap) {
+			if ((u64)r->index + r->nr > (u64)cur.start + cur.nr)
+				cur.nr = r->index + r->nr - cur.start;
+			continue;
+		}
+		if (n && ext)
+			ext[n - 1] = cur;
+		cur.file = r->file;
+		cur.start = r->index;
+		cur.nr = r->nr;
+		n++;
+	}
+	if (n && ext)
+		ext[n - 1] = cur;
+	return n;
+}
+
+struct lp_phys_extent {
+	dev_t			dev;
+	sector_t		block;
+	struct lp_extent	ext;
+};
+
+static int lp_phys_cmp(const void *a, const void *b)
+{
+	const struct lp_phys_extent *pa = a, *pb = b;
+
+	if (pa->dev != pb->dev)
+		return pa->dev < pb->dev ? -1 : 1;
+	if (pa->block != pb->block)
+		return pa->block < pb->block ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Order the extents of @p by the device block their first page maps to.
+ * Extents whose block is unknown go last. On failure the file order is
+ * kept, which is merely slower to replay.
+ */
+static void lp_sort_physical(struct lp_profile *p)
+{
+	struct lp_phys_extent *phys;
+	struct inode *inode;
+	sector_t block;
+	unsigned int i;
+
+	phys = lp_alloc(p->nr_extents * sizeof(*phys));
+	if (!phys)
+		return;
+
+	for (i = 0; i < p->nr_extents; i++) {
+		inode = lps.files[p->extents[i].file].path.dentry->d_inode;
+		block = 0;
+		if (inode->i_mapping->a_ops->bmap)
+			block = bmap(inode, (sector_t)p->extents[i].start <<
+				     (PAGE_CACHE_SHIFT - inode->i_blkbits));
+		phys[i].dev = inode->i_sb->s_dev;
+		phys[i].block = block ? block : (sector_t)-1;
+		phys[i].ext = p->extents[i];
+	}
+
+	sort(phys, p->nr_extents, sizeof(*phys), lp_phys_cmp, NULL);
+	for (i = 0; i < p->nr_extents; i++)
+		p->extents[i] = phys[i].ext;
+	lp_free(phys);
+}
+
+/* Called once recording stopped, so lps is no longer changed behind us */
+static struct lp_profile *lp_build_profile(void)
+{
+	struct lp_profile *p;
+	unsigned int i;
+	char *buf, *path;
+	u32 gap = lp_merge_gap;
+
+	if (!lps.nr_recs)
+		return NULL;
+
+	p = lp_profile_alloc(lps.name);
+	buf = (char *)__get_free_page(GFP_KERNEL);
+	if (!p || !buf)
+		goto fail;
+
+	sort(lps.recs, lps.nr_recs, sizeof(struct lp_record),
+	     lp_record_cmp, NULL);
+	p->nr_extents = lp_merge(lps.recs, lps.nr_recs, gap, NULL);
+	p->extents = lp_alloc(p->nr_extents * sizeof(struct lp_extent));
+	p->paths = lp_alloc(lps.nr_files * sizeof(char *));
+	if (!p->extents || !p->paths)
+		goto fail;
+	lp_merge(lps.recs, lps.nr_recs, gap, p->extents);
+	for (i = 0; i < p->nr_extents; i++)
+		p->nr_pages += p->extents[i].nr;
+	if (lps.boot)
+		lp_sort_physical(p);
+
+	for (i = 0; i < lps.nr_files; i++) {
+		path = d_path(&lps.files[i].path, buf, PAGE_SIZE);
+		if (IS_ERR(path) || strchr(path, '\n'))
+			p->paths[i] = NULL;
+		else
+			p->paths[i] = kstrdup(path, GFP_KERNEL);
+		p->nr_files++;
+	}
+
+	free_page((unsigned long)buf);
+	return p;
+fail:
+	free_page((unsigned long)buf);
+	if (p)
+		lp_profile_put(p);
+	return NULL;
+}
+
+/* Called with lp_lock held. @tgid is 0 to record boot. */
+static int lp_record_start(const char *name, pid_t tgid)
+{
+	bool boot = !tgid;
+	struct lp_rec_file *files;
+	struct lp_record *recs;
+	unsigned int max_files = boot ? LP_BOOT_MAX_FILES : LP_MAX_FILES;
+	u32 nr = min_t(u32, boot ? lp_boot_max_records : lp_max_records,
+		       LP_MAX_RECORDS);
+	int ret;
+
+	if (lps.active) {
+		lp_stats.busy++;
+		return -EBUSY;
+	}
+	if (!nr)
+		return -EINVAL;
+
+	recs = vmalloc(nr * sizeof(*recs));
+	files = vmalloc(max_files * sizeof(*files));
+	if (!recs || !files) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	spin_lock(&lps.lock);
+	strlcpy(lps.name, name, sizeof(lps.name));
+	lps.boot = boot;
+	lps.tgid = tgid;
+	lps.recs = recs;
+	lps.max_recs = nr;
+	lps.nr_recs = 0;
+	lps.files = files;
+	lps.max_files = max_files;
+	lps.nr_files = 0;
+	lps.nr_dropped = 0;
+	lps.active = true;
+	launch_prefetch_tgid = tgid;
+	spin_unlock(&lps.lock);
+
+	if (boot) {
+		ret = register_trace_mm_filemap_page_cache_miss(lp_boot_probe,
+								NULL);
+		if (ret) {
+			spin_lock(&lps.lock);
+			lps.active = false;
+			spin_unlock(&lps.lock);
+			goto fail;
+		}
+	}
+
+	schedule_delayed_work(&lps.work, msecs_to_jiffies(boot ?
+			      lp_boot_record_ms : lp_record_ms));
+	return 0;
+fail:
+	vfree(recs);
+	vfree(files);
+	lps.recs = NULL;
+	lps.files = NULL;
+	return ret;
+}
+
+/* Called with lp_lock held */
+static void lp_record_finish(void)
+{
+	struct lp_profile *p;
+	unsigned int i;
+
+	spin_lock(&lps.lock);
+	if (!lps.active) {
+		spin_unlock(&lps.lock);
+		return;
+	}
+	lps.active = false;
+	launch_prefetch_tgid = 0;
+	spin_unlock(&lps.lock);
+
+	/* The probe checks lps.active under the lock, nothing to wait for */
+	if (lps.boot)
+		unregister_trace_mm_filemap_page_cache_miss(lp_boot_probe, NULL);
+
+	p = lp_build_profile();
+	if (p) {
+		lp_add_profile(p);
+		lp_stats.recorded++;
+	}
+
+	for (i = 0; i < lps.nr_files; i++)
+		path_put(&lps.files[i].path);
+	for (i = 0; i < ARRAY_SIZE(lps.hash); i++)
+		INIT_HLIST_HEAD(&lps.hash[i]);
+	lps.nr_files = 0;
+	vfree(lps.files);
+	lps.files = NULL;
+	vfree(lps.recs);
+	lps.recs = NULL;
+}
+
+static void lp_record_workfn(struct work_struct *work)
+{
+	mutex_lock(&lp_lock);
+	lp_record_finish();
+	mutex_unlock(&lp_lock);
+}
+
+static void lp_prefetch_workfn(struct work_struct *work)
+{
+	struct lp_prefetch *pf = container_of(work, struct lp_prefetch, work);
+	struct lp_profile *p = pf->profile;
+	struct file **filps, *filp;
+	struct blk_plug plug;
+	unsigned long pages = 0;
+	ktime_t start = ktime_get();
+	unsigned int i;
+
+	filps = lp_alloc(p->nr_files * sizeof(*filps));
+	if (!filps) {
+		atomic_long_inc(&lp_stats.skipped);
+		goto out;
+	}
+	memset(filps, 0, p->nr_files * sizeof(*filps));
+
+	/*
+	 * Launch profiles come in the order the app first touched its
+	 * files, and the boot profile in device order, so the plug mostly
+	 * gets to merge what each readahead call submits.
+	 */
+	blk_start_plug(&plug);
+	for (i = 0; i < p->nr_extents; i++) {
+		struct lp_extent *e = &p->extents[i];
+
+		if (e->file >= p->nr_files || !p->paths[e->file])
+			continue;
+
+		filp = filps[e->file];
+		if (!filp) {
+			filp = filp_open(p->paths[e->file],
+					 O_RDONLY | O_LARGEFILE, 0);
+			if (IS_ERR(filp))
+				atomic_long_inc(&lp_stats.open_errors);
+			filps[e->file] = filp;
+		}
+		if (IS_ERR(filp))
+			continue;
+
+		force_page_cache_readahead(filp->f_mapping, filp,
+					   e->start, e->nr);
+		pages += e->nr;
+	}
+	blk_finish_plug(&plug);
+
+	for (i = 0; i < p->nr_files; i++)
+		if (filps[i] && !IS_ERR(filps[i]))
+			fput(filps[i]);
+	lp_free(filps);
+
+	atomic_long_add(pages, &lp_stats.pages);
+	if (pf->boot) {
+		lp_stats.boot_pages = pages;
+		lp_stats.boot_ms = ktime_to_ms(ktime_sub(ktime_get(), start));
+		pr_info("%s: boot replay of %lu pages took %lld ms\n",
+			MODULE_NAME, pages, lp_stats.boot_ms);
+	}
+out:
+	lp_profile_put(p);
+	kfree(pf);
+	atomic_dec(&lp_pending);
+}
+
+/* Called with lp_lock held */
+static void lp_prefetch(struct lp_profile *p, bool boot)
+{
+	struct lp_prefetch *pf;
+
+	if (atomic_inc_return(&lp_pending) > LP_MAX_PENDING)
+		goto skip;
+
+	pf = kmalloc(sizeof(*pf), GFP_KERNEL);
+	if (!pf)
+		goto skip;
+
+	kref_get(&p->kref);
+	pf->profile = p;
+	pf->boot = boot;
+	INIT_WORK(&pf->work, lp_prefetch_workfn);
+	queue_work(system_unbound_wq, &pf->work);
+	atomic_long_inc(&lp_stats.prefetches);
+	return;
+skip:
+	atomic_dec(&lp_pending);
+	atomic_long_inc(&lp_stats.skipped);
+}
+
+static ssize_t lp_launch_write(struct file *file, const char __user *ubuf,
+			       size_t count, loff_t *ppos)
+{
+	char buf[LP_NAME_LEN + 16], name[LP_NAME_LEN];
+	struct lp_profile *p;
+	int pid, ret = 0;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+	strim(buf);
+
+	if (!strcmp(buf, "stop")) {
+		cancel_delayed_work_sync(&lps.work);
+		mutex_lock(&lp_lock);
+		lp_record_finish();
+		mutex_unlock(&lp_lock);
+		return count;
+	}
+
+	/*
+	 * Boot is either replayed or recorded. Recording while replaying
+	 * would only catch what the replay missed.
+	 */
+	if (!strcmp(buf, LP_BOOT_NAME)) {
+		mutex_lock(&lp_lock);
+		p = lp_find_profile(LP_BOOT_NAME);
+		if (p && !lp_rerecord)
+			lp_prefetch(p, true);
+		else
+			ret = lp_record_start(LP_BOOT_NAME, 0);
+		mutex_unlock(&lp_lock);
+		return ret ? ret : count;
+	}
+
+	if (sscanf(buf, "%63s %d", name, &pid) != 2 || pid <= 0 ||
+	    !strcmp(name, LP_BOOT_NAME))
+		return -EINVAL;
+
+	launch_prefetch_launch_time = jiffies;
+	smp_wmb();
+	launch_prefetch_launch_tgid = pid;
+
+	mutex_lock(&lp_lock);
+	lp_stats.launches++;
+	p = lp_find_profile(name);
+	if (p) {
+		lp_stats.hits++;
+		lp_prefetch(p, false);
+	}
+	if (!p || lp_rerecord)
+		ret = lp_record_start(name, pid);
+	mutex_unlock(&lp_lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations lp_launch_fops = {
+	.open	= simple_open,
+	.write	= lp_launch_write,
+};
+
+static int lp_profiles_show(struct seq_file *s, void *unused)
+{
+	struct lp_profile *p;
+	struct lp_extent *e;
+	unsigned int i;
+
+	mutex_lock(&lp_lock);
+	list_for_each_entry(p, &lp_profiles, list) {
+		seq_printf(s, "app %s\n", p->name);
+		for (i = 0; i < p->nr_files; i++)
+			seq_printf(s, "file %s\n", p->paths[i] ?
+				   p->paths[i] : "-");
+		for (i = 0; i < p->nr_extents; i++) {
+			e = &p->extents[i];
+			seq_printf(s, "%u %u %u\n", e->file, e->start, e->nr);
+		}
+	}
+	mutex_unlock(&lp_lock);
+
+	return 0;
+}
+
+static int lp_profiles_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lp_profiles_show, inode->i_private);
+}
+
+static const struct file_operations lp_profiles_fops = {
+	.open		= lp_profiles_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* Grow a lp_alloc()ed array to hold at least @nr elements */
+static int lp_grow(void **array, unsigned int *max_nr, unsigned int nr,
+		   size_t size)
+{
+	unsigned int new_max;
+	void *new;
+
+	if (nr <= *max_nr)
+		return 0;
+
+	new_max = max(nr, *max_nr ? *max_nr * 2 : 16U);
+	new = lp_alloc(new_max * size);
+	if (!new)
+		return -ENOMEM;
+	if (*array)
+		memcpy(new, *array, *max_nr * size);
+	lp_free(*array);
+	*array = new;
+	*max_nr = new_max;
+	return 0;
+}
+
+/* Called with lp_lock held */
+static void lp_load_commit(void)
+{
+	struct lp_profile *p = lpl.profile;
+
+	lpl.profile = NULL;
+	lpl.max_files = lpl.max_extents = 0;
+	if (!p)
+		return;
+
+	if (!p->nr_extents) {
+		lp_profile_put(p);
+		return;
+	}
+	lp_add_profile(p);
+	lp_stats.loaded++;
+}
+
+/* Called with lp_lock held. Lines that don't parse are ignored. */
+static int lp_load_line(char *line)
+{
+	struct lp_profile *p;
+	struct lp_extent *e;
+	unsigned int file, start, nr;
+
+	line = strim(line);
+
+	if (!strncmp(line, "app ", 4)) {
+		lp_load_commit();
+		line = strim(line + 4);
+		if (!*line)
+			return 0;
+		lpl.profile = lp_profile_alloc(line);
+		return lpl.profile ? 0 : -ENOMEM;
+	}
+
+	p = lpl.profile;
+	if (!p)
+		return 0;
+
+	if (!strncmp(line, "file ", 5)) {
+		line = strim(line + 5);
+		if (lp_grow((void **)&p->paths, &lpl.max_files,
+			    p->nr_files + 1, sizeof(char *)))
+			return -ENOMEM;
+		p->paths[p->nr_files] = *line == '/' ?
+					kstrdup(line, GFP_KERNEL) : NULL;
+		p->nr_files++;
+		return 0;
+	}
+
+	if (sscanf(line, "%u %u %u", &file, &start, &nr) != 3 ||
+	    file >= p->nr_files || !nr)
+		return 0;
+	if (lp_grow((void **)&p->extents, &lpl.max_extents,
+		    p->nr_extents + 1, sizeof(struct lp_extent)))
+		return -ENOMEM;
+	e = &p->extents[p->nr_extents++];
+	e->file = file;
+	e->start = start;
+	e->nr = nr;
+	p->nr_pages += nr;
+	return 0;
+}
+
+static ssize_t lp_load_write(struct file *file, const char __user *ubuf,
+			     size_t count, loff_t *ppos)
+{
+	char *buf, *line, *p;
+	ssize_t ret = count;
+
+	buf = kmalloc(count + LP_LINE_MAX + 1, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	mutex_lock(&lp_lock);
+
+	/* Lines may be split across writes */
+	memcpy(buf, lpl.partial, lpl.partial_len);
+	if (copy_from_user(buf + lpl.partial_len, ubuf, count)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	buf[lpl.partial_len + count] = '\0';
+	lpl.partial_len = 0;
+
+	p = buf;
+	while ((line = strsep(&p, "\n")) != NULL) {
+		if (!p) {
+			/* No newline yet, keep it for the next write */
+			lpl.partial_len = min_t(size_t, strlen(line),
+						LP_LINE_MAX - 1);
+			memcpy(lpl.partial, line, lpl.partial_len);
+			break;
+		}
+		if (lp_load_line(line)) {
+			ret = -ENOMEM;
+			break;
+		}
+	}
+out:
+	mutex_unlock(&lp_lock);
+	kfree(buf);
+	return ret;
+}
+
+static int lp_load_release(struct inode *inode, struct file *file)
+{
+	mutex_lock(&lp_lock);
+	if (lpl.partial_len) {
+		lpl.partial[lpl.partial_len] = '\0';
+		lp_load_line(lpl.partial);
+		lpl.partial_len = 0;
+	}
+	lp_load_commit();
+	mutex_unlock(&lp_lock);
+	return 0;
+}
+
+static const struct file_operations lp_load_fops = {
+	.open		= simple_open,
+	.write		= lp_load_write,
+	.release	= lp_load_release,
+};
+
+static int lp_status_show(struct seq_file *s, void *unused)
+{
+	mutex_lock(&lp_lock);
+	spin_lock(&lps.lock);
+	if (lps.active)
+		seq_printf(s, "recording: %s pid %d records %u/%u files %u/%u dropped %u\n",
+			   lps.name, lps.tgid, lps.nr_recs, lps.max_recs,
+			   lps.nr_files, lps.max_files, lps.nr_dropped);
+	else
+		seq_puts(s, "recording: none\n");
+	spin_unlock(&lps.lock);
+
+	seq_printf(s, "profiles: %u\n", lp_nr_profiles);
+	seq_printf(s, "boot replay: %lu pages in %lld ms\n",
+		   lp_stats.boot_pages, lp_stats.boot_ms);
+	seq_printf(s, "launches: %lu hits: %lu recorded: %lu loaded: %lu busy: %lu\n",
+		   lp_stats.launches, lp_stats.hits, lp_stats.recorded,
+		   lp_stats.loaded, lp_stats.busy);
+	mutex_unlock(&lp_lock);
+
+	seq_printf(s, "prefetches: %ld skipped: %ld pages: %ld open errors: %ld\n",
+		   atomic_long_read(&lp_stats.prefetches),
+		   atomic_long_read(&lp_stats.skipped),
+		   atomic_long_read(&lp_stats.pages),
+		   atomic_long_read(&lp_stats.open_errors));
+	return 0;
+}
+
+static int lp_status_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lp_status_show, inode->i_private);
+}
+
+static const struct file_operations lp_status_fops = {
+	.open		= lp_status_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init launch_prefetch_init(void)
+{
+	unsigned int i;
+
+	spin_lock_init(&lps.lock);
+	for (i = 0; i < ARRAY_SIZE(lps.hash); i++)
+		INIT_HLIST_HEAD(&lps.hash[i]);
+	INIT_DELAYED_WORK(&lps.work, lp_record_workfn);
+
+	lp_debug_root = debugfs_create_dir(MODULE_NAME, NULL);
+	if (!lp_debug_root)
+		return -ENOENT;
+
+	if (!debugfs_create_file("launch", S_IWUSR, lp_debug_root,
+				 NULL, &lp_launch_fops) ||
+	    !debugfs_create_u32("record_ms", S_IRUGO | S_IWUSR,
+				lp_debug_root, &lp_record_ms) ||
+	    !debugfs_create_u32("max_records", S_IRUGO | S_IWUSR,
+				lp_debug_root, &lp_max_records) ||
+	    !debugfs_create_u32("boot_record_ms", S_IRUGO | S_IWUSR,
+				lp_debug_root, &lp_boot_record_ms) ||
+	    !debugfs_create_u32("boot_max_records", S_IRUGO | S_IWUSR,
+				lp_debug_root, &lp_boot_max_records) ||
+	    !debugfs_create_u32("merge_gap", S_IRUGO | S_IWUSR,
+				lp_debug_root, &lp_merge_gap) ||
+	    !debugfs_create_u32("rerecord", S_IRUGO | S_IWUSR,
+				lp_debug_root, &lp_rerecord) ||
+	    !debugfs_create_file("profiles", S_IRUSR, lp_debug_root,
+				 NULL, &lp_profiles_fops) ||
+	    !debugfs_create_file("load", S_IWUSR, lp_debug_root,
+				 NULL, &lp_load_fops) ||
+	    !debugfs_create_file("status", S_IRUGO, lp_debug_root,
+				 NULL, &lp_status_fops)) {
+		debugfs_remove_recursive(lp_debug_root);
+		return -ENOENT;
+	}
+
+	return 0;
+}
+late_initcall(launch_prefetch_init);
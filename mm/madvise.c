@@ -117,7 +117,9 @@ success:
 	/*
 	 * vm_flags is protected by the mmap_sem held in write mode.
 	 */
+	mm_seq_write_begin(mm);
 	vma->vm_flags = new_flags;
+	mm_seq_write_end(mm);
 
 out:
 	if (error == -ENOMEM)
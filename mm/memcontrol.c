@@ -4763,6 +4763,12 @@ static struct cftype mem_cgroup_files[] = {
 		.register_event = vmpressure_register_event,
 		.unregister_event = vmpressure_unregister_event,
 	},
+	{
+		.name = "stall",
+		.read_seq_string = vmpressure_stall_read,
+		.register_event = vmpressure_stall_register_event,
+		.unregister_event = vmpressure_stall_unregister_event,
+	},
 #ifdef CONFIG_NUMA
 	{
 		.name = "numa_stat",
@@ -5084,6 +5090,7 @@ static void mem_cgroup_destroy(struct cgroup *cont)
 	struct mem_cgroup *memcg = mem_cgroup_from_cont(cont);
 
 	kmem_cgroup_destroy(cont);
+	vmpressure_cleanup(&memcg->vmpressure);
 
 	mem_cgroup_put(memcg);
 }
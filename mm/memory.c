@@ -42,6 +42,7 @@
 #include <linux/mm.h>
 #include <linux/hugetlb.h>
 #include <linux/mman.h>
+#include <linux/mempolicy.h>
 #include <linux/swap.h>
 #include <linux/highmem.h>
 #include <linux/pagemap.h>
@@ -56,6 +57,7 @@
 #include <linux/mmu_notifier.h>
 #include <linux/kallsyms.h>
 #include <linux/swapops.h>
+#include <linux/vmpressure.h>
 #include <linux/elf.h>
 #include <linux/gfp.h>
 #include <linux/bug.h>
@@ -114,6 +116,12 @@ __setup("norandmaps", disable_randmaps);
 unsigned long zero_pfn __read_mostly;
 unsigned long highest_memmap_pfn __read_mostly;
 
+/*
+ * Let fork leave the page cache ptes of read-only private file mappings
+ * to be faulted back in by the child, see copy_pte_range().
+ */
+int sysctl_fork_lazy_ptes __read_mostly = 1;
+
 /*
  * CONFIG_MMU architectures set up ZERO_PAGE in their paging_init()
  */
@@ -920,6 +928,60 @@ out_set_pte:
 	return 0;
 }
 
+/*
+ * A read-only private file mapping gets an anon_vma as soon as one of
+ * its pages is COWed (relocations, RELRO), and from then on fork copies
+ * all of its ptes although most of them map page cache pages that a
+ * fault would bring back just as well. With sysctl_fork_lazy_ptes set,
+ * only anonymous pages and swap entries are copied for such a mapping,
+ * and a page table with none of those is not allocated in the child.
+ */
+static inline bool fork_lazy_vma(struct vm_area_struct *vma)
+{
+	return sysctl_fork_lazy_ptes && vma->vm_file &&
+	       !(vma->vm_flags & (VM_WRITE | VM_HUGETLB | VM_NONLINEAR |
+				  VM_PFNMAP | VM_MIXEDMAP | VM_INSERTPAGE));
+}
+
+/* Can the child fault this pte in by itself? */
+static inline bool fork_lazy_pte(struct vm_area_struct *vma,
+				 unsigned long addr, pte_t pte)
+{
+	struct page *page;
+
+	if (!pte_present(pte))
+		return false;
+	page = vm_normal_page(vma, addr, pte);
+	return page && !PageAnon(page);
+}
+
+/*
+ * Returns the number of present ptes in [addr, end) if the child can
+ * fault in all of them, or -1 if at least one has to be copied.
+ */
+static int fork_lazy_pte_range(struct mm_struct *src_mm, pmd_t *src_pmd,
+			       struct vm_area_struct *vma,
+			       unsigned long addr, unsigned long end)
+{
+	pte_t *src_pte, *orig_src_pte;
+	spinlock_t *src_ptl;
+	int nr = 0;
+
+	orig_src_pte = src_pte = pte_offset_map_lock(src_mm, src_pmd, addr,
+						     &src_ptl);
+	do {
+		if (pte_none(*src_pte))
+			continue;
+		if (!fork_lazy_pte(vma, addr, *src_pte)) {
+			nr = -1;
+			break;
+		}
+		nr++;
+	} while (src_pte++, addr += PAGE_SIZE, addr != end);
+	pte_unmap_unlock(orig_src_pte, src_ptl);
+	return nr;
+}
+
 int copy_pte_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		   pmd_t *dst_pmd, pmd_t *src_pmd, struct vm_area_struct *vma,
 		   unsigned long addr, unsigned long end)
@@ -930,9 +992,21 @@ int copy_pte_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 	int progress = 0;
 	int rss[NR_MM_COUNTERS];
 	swp_entry_t entry = (swp_entry_t){0};
+	bool lazy = fork_lazy_vma(vma);
+	int nr_lazy;
+
+	if (lazy) {
+		nr_lazy = fork_lazy_pte_range(src_mm, src_pmd, vma, addr, end);
+		if (nr_lazy >= 0) {
+			count_vm_event(FORK_LAZY_PT);
+			count_vm_events(FORK_LAZY_PTE, nr_lazy);
+			return 0;
+		}
+	}
 
 again:
 	init_rss_vec(rss);
+	nr_lazy = 0;
 
 	dst_pte = pte_alloc_map_lock(dst_mm, dst_pmd, addr, &dst_ptl);
 	if (!dst_pte)
@@ -959,6 +1033,11 @@ again:
 			progress++;
 			continue;
 		}
+		if (lazy && fork_lazy_pte(vma, addr, *src_pte)) {
+			nr_lazy++;
+			progress++;
+			continue;
+		}
 		entry.val = copy_one_pte(dst_mm, src_mm, dst_pte, src_pte,
 							vma, addr, rss);
 		if (entry.val)
@@ -971,6 +1050,8 @@ again:
 	pte_unmap(orig_src_pte);
 	add_mm_rss_vec(dst_mm, rss);
 	pte_unmap_unlock(orig_dst_pte, dst_ptl);
+	if (nr_lazy)
+		count_vm_events(FORK_LAZY_PTE, nr_lazy);
 	cond_resched();
 
 	if (entry.val) {
@@ -2991,6 +3072,7 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	pte_t pte;
 	int locked;
 	struct mem_cgroup *ptr;
+	struct vmpressure_stall stall = { };
 	int exclusive = 0;
 	int ret = 0;
 
@@ -3020,8 +3102,9 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		goto out;
 	}
 	delayacct_set_flag(DELAYACCT_PF_SWAPIN);
-	page = lookup_swap_cache(entry);
+	page = lookup_swap_cache(entry, vma);
 	if (!page) {
+		vmpressure_stall_enter(&stall);
 		page = swapin_readahead(entry,
 					GFP_HIGHUSER_MOVABLE, vma, address);
 		if (!page) {
@@ -3033,6 +3116,7 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 			if (likely(pte_same(*page_table, orig_pte)))
 				ret = VM_FAULT_OOM;
 			delayacct_clear_flag(DELAYACCT_PF_SWAPIN);
+			vmpressure_stall_leave(&stall);
 			goto unlock;
 		}
 
@@ -3053,6 +3137,7 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	locked = lock_page_or_retry(page, mm, flags);
 
 	delayacct_clear_flag(DELAYACCT_PF_SWAPIN);
+	vmpressure_stall_leave(&stall);
 	if (!locked) {
 		ret |= VM_FAULT_RETRY;
 		goto out_release;
@@ -3607,6 +3692,14 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	/* do counter updates before entering really critical section. */
 	check_sync_rss_stat(current);
 
+	/*
+	 * The private memory of this mm has been reaped while its owner
+	 * dies: a refault would hand out zeroes in place of the lost data,
+	 * which the owner could still pass on from inside a syscall.
+	 */
+	if (unlikely(test_bit(MMF_UNSTABLE, &mm->flags)))
+		return VM_FAULT_SIGBUS;
+
 	if (unlikely(is_vm_hugetlb_page(vma)))
 		return hugetlb_fault(mm, vma, address, flags);
 
@@ -3667,6 +3760,233 @@ retry:
 	return handle_pte_fault(mm, vma, address, pte, pmd, flags);
 }
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Find the pmd covering @address and snapshot it into @pmdval, without
+ * allocating or clearing anything: only a pmd that already points to a
+ * pte table will do.  Called under rcu_read_lock(), which keeps that
+ * table from being freed (see __pte_free_tlb()).
+ */
+static pmd_t *spf_walk_pmd(struct mm_struct *mm, unsigned long address,
+			   pmd_t *pmdval)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	pgd = pgd_offset(mm, address);
+	if (pgd_none(*pgd) || unlikely(pgd_bad(*pgd)))
+		return NULL;
+	pud = pud_offset(pgd, address);
+	if (pud_none(*pud) || unlikely(pud_bad(*pud)))
+		return NULL;
+	pmd = pmd_offset(pud, address);
+	*pmdval = ACCESS_ONCE(*pmd);
+	barrier();
+	if (pmd_none(*pmdval) || unlikely(pmd_bad(*pmdval)) ||
+	    pmd_trans_huge(*pmdval))
+		return NULL;
+	return pmd;
+}
+
+/**
+ * handle_speculative_fault - fill in a missing pte without mmap_sem
+ * @mm:		mm of the faulting task, current->mm
+ * @address:	faulting address
+ * @flags:	FAULT_FLAG_xxx
+ * @vm_flags_mask: the fault is an access error unless the vma has one of
+ *		these VM_xxx flags
+ *
+ * Handles the common faults that only need a pte filled in where there
+ * was none - a read or write of private anonymous memory and a read of
+ * an ordinary page cache mapping - working on a copy of the vma that is
+ * validated against mm->mm_seq, once after it is copied and again under
+ * the pte lock before the pte is set.
+ *
+ * Returns VM_FAULT_RETRY if the fault is not one of those, or if anything
+ * changed under it; the caller must then take mmap_sem and go through
+ * handle_mm_fault().  Otherwise returns 0 or VM_FAULT_MAJOR, and the
+ * caller only has the fault accounting to do.
+ */
+int handle_speculative_fault(struct mm_struct *mm, unsigned long address,
+			     unsigned int flags, unsigned long vm_flags_mask)
+{
+	struct vm_area_struct *vma, vmc;
+	struct page *page = NULL;
+	struct file *file = NULL;
+	struct vm_fault vmf;
+	pmd_t *pmd, pmdval, pmdcur;
+	spinlock_t *ptl;
+	pte_t *pte, entry;
+	unsigned int seq;
+	int ret = 0;
+
+	__set_current_state(TASK_RUNNING);
+	check_sync_rss_stat(current);
+
+	address &= PAGE_MASK;
+	flags &= ~(FAULT_FLAG_ALLOW_RETRY | FAULT_FLAG_KILLABLE);
+
+	rcu_read_lock();
+	/*
+	 * An odd count makes the check below fail rather than wait for the
+	 * writer, who holds mmap_sem and may sleep.
+	 */
+	seq = raw_seqcount_begin(&mm->mm_seq);
+	vma = ACCESS_ONCE(mm->mmap_cache);
+	if (!vma)
+		goto out_unlock;
+	/* vm_area_cachep is SLAB_DESTROY_BY_RCU: this is some vma or other */
+	memcpy(&vmc, vma, sizeof(vmc));
+	if (read_seqcount_retry(&mm->mm_seq, seq))
+		goto retry_unlock;
+
+	if (vmc.vm_mm != mm || address < vmc.vm_start ||
+	    address >= vmc.vm_end || !(vmc.vm_flags & vm_flags_mask))
+		goto out_unlock;
+	if (vmc.vm_flags & (VM_GROWSDOWN | VM_GROWSUP | VM_HUGETLB |
+			    VM_PFNMAP | VM_MIXEDMAP | VM_NONLINEAR | VM_IO |
+			    VM_LOCKED | VM_INSERTPAGE))
+		goto out_unlock;
+	if (vma_policy(&vmc))
+		goto out_unlock;
+
+	pmd = spf_walk_pmd(mm, address, &pmdval);
+	if (!pmd)
+		goto out_unlock;
+	pte = pte_offset_map(&pmdval, address);
+	entry = *pte;
+	pte_unmap(pte);
+	if (!pte_none(entry))
+		goto out_unlock;
+
+	if (!vmc.vm_ops) {
+		if (vmc.vm_flags & VM_SHARED)
+			goto out_unlock;
+
+		if (!(flags & FAULT_FLAG_WRITE)) {
+			entry = pte_mkspecial(pfn_pte(my_zero_pfn(address),
+						      vmc.vm_page_prot));
+			goto install;
+		}
+
+		/* anon_vma_prepare() needs mmap_sem */
+		if (!vmc.anon_vma)
+			goto out_unlock;
+		rcu_read_unlock();
+
+		page = alloc_zeroed_user_highpage_movable(&vmc, address);
+		if (!page)
+			goto out;
+		__SetPageUptodate(page);
+		if (mem_cgroup_newpage_charge(page, mm, GFP_KERNEL)) {
+			page_cache_release(page);
+			page = NULL;
+			goto out;
+		}
+
+		entry = mk_pte(page, vmc.vm_page_prot);
+		if (vmc.vm_flags & VM_WRITE)
+			entry = pte_mkwrite(pte_mkdirty(entry));
+	} else if (vmc.vm_ops->fault == filemap_fault &&
+		   !(flags & FAULT_FLAG_WRITE)) {
+		/*
+		 * The file is freed by RCU too; while the vma is valid it
+		 * holds a reference, so pin it before looking again.
+		 */
+		if (!vmc.vm_file ||
+		    !atomic_long_inc_not_zero(&vmc.vm_file->f_count))
+			goto out_unlock;
+		file = vmc.vm_file;
+		if (read_seqcount_retry(&mm->mm_seq, seq))
+			goto retry_unlock;
+		rcu_read_unlock();
+
+		vmf.virtual_address = (void __user *)address;
+		vmf.pgoff = ((address - vmc.vm_start) >> PAGE_SHIFT) +
+			    vmc.vm_pgoff;
+		vmf.flags = flags;
+		vmf.page = NULL;
+
+		ret = filemap_fault(&vmc, &vmf);
+		if (unlikely(ret & (VM_FAULT_ERROR | VM_FAULT_NOPAGE |
+				    VM_FAULT_RETRY)))
+			goto out;
+		page = vmf.page;
+		if (unlikely(!(ret & VM_FAULT_LOCKED)))
+			lock_page(page);
+		if (unlikely(PageHWPoison(page))) {
+			unlock_page(page);
+			page_cache_release(page);
+			page = NULL;
+			goto out;
+		}
+		ret &= VM_FAULT_MAJOR;
+
+		entry = mk_pte(page, vmc.vm_page_prot);
+	} else
+		goto out_unlock;
+
+	rcu_read_lock();
+install:
+	/* the pte table may have gone while we were not under RCU */
+	if (spf_walk_pmd(mm, address, &pmdcur) != pmd ||
+	    pmd_val(pmdcur) != pmd_val(pmdval))
+		goto retry_unlock;
+
+	ptl = pte_lockptr(mm, &pmdval);
+	pte = pte_offset_map(&pmdval, address);
+	spin_lock(ptl);
+	if (unlikely(pmd_val(*pmd) != pmd_val(pmdval) ||
+		     read_seqcount_retry(&mm->mm_seq, seq) ||
+		     !pte_none(*pte))) {
+		pte_unmap_unlock(pte, ptl);
+		goto retry_unlock;
+	}
+
+	if (file) {
+		flush_icache_page(&vmc, page);
+		inc_mm_counter_fast(mm, MM_FILEPAGES);
+		page_add_file_rmap(page);
+	} else if (page) {
+		inc_mm_counter_fast(mm, MM_ANONPAGES);
+		page_add_new_anon_rmap(page, &vmc, address);
+	}
+	set_pte_at(mm, address, pte, entry);
+
+	/* No need to invalidate - it was non-present before */
+	update_mmu_cache(&vmc, address, pte);
+	pte_unmap_unlock(pte, ptl);
+	rcu_read_unlock();
+
+	if (file) {
+		unlock_page(page);
+		fput(file);
+	}
+
+	count_vm_event(PGFAULT);
+	mem_cgroup_count_vm_event(mm, PGFAULT);
+	atomic_long_inc(&mm->spf_success);
+	return ret;
+
+retry_unlock:
+	atomic_long_inc(&mm->spf_retry);
+out_unlock:
+	rcu_read_unlock();
+out:
+	if (page) {
+		if (file)
+			unlock_page(page);
+		else
+			mem_cgroup_uncharge_page(page);
+		page_cache_release(page);
+	}
+	if (file)
+		fput(file);
+	return VM_FAULT_RETRY;
+}
+#endif /* CONFIG_SPECULATIVE_PAGE_FAULT */
+
 #ifndef __PAGETABLE_PUD_FOLDED
 /*
  * Allocate page upper directory.
@@ -368,9 +368,11 @@ success:
 	 * set VM_LOCKED, __mlock_vma_pages_range will bring it back.
 	 */
 
-	if (lock)
+	if (lock) {
+		mm_seq_write_begin(mm);
 		vma->vm_flags = newflags;
-	else
+		mm_seq_write_end(mm);
+	} else
 		munlock_vma_pages_range(vma, start, end);
 
 out:
@@ -624,6 +624,7 @@ again:			remove_next = 1 + (end > next->vm_end);
 			vma_prio_tree_remove(next, root);
 	}
 
+	mm_seq_write_begin(mm);
 	vma->vm_start = start;
 	vma->vm_end = end;
 	vma->vm_pgoff = pgoff;
@@ -655,6 +656,7 @@ again:			remove_next = 1 + (end > next->vm_end);
 		 */
 		__insert_vm_struct(mm, insert);
 	}
+	mm_seq_write_end(mm);
 
 	if (anon_vma)
 		anon_vma_unlock(anon_vma);
@@ -2031,6 +2033,7 @@ detach_vmas_to_be_unmapped(struct mm_struct *mm, struct vm_area_struct *vma,
 	unsigned long addr;
 
 	insertion_point = (prev ? &prev->vm_next : &mm->mmap);
+	mm_seq_write_begin(mm);
 	vma->vm_prev = NULL;
 	do {
 		rb_erase(&vma->vm_rb, &mm->mm_rb);
@@ -2048,6 +2051,7 @@ detach_vmas_to_be_unmapped(struct mm_struct *mm, struct vm_area_struct *vma,
 		addr = vma ?  vma->vm_start : mm->mmap_base;
 	mm->unmap_area(mm, addr);
 	mm->mmap_cache = NULL;		/* Kill the cache. */
+	mm_seq_write_end(mm);
 }
 
 /*
@@ -1172,6 +1172,48 @@ static long bdi_min_pause(struct backing_dev_info *bdi,
 	return pages >= DIRTY_POLL_THRESH ? 1 + t / 2 : t;
 }
 
+/*
+ * Extra throttling for the dirtiers of a background blkio cgroup, i.e. one
+ * whose blkio.dirty_ratio is below 100. Returns the factor to apply to
+ * task_ratelimit, in RATELIMIT_CALC_SHIFT fixed point.
+ *
+ * - Above the group's share of @thresh the rate falls linearly, down to
+ *   1/8 at @thresh itself.
+ * - While the read latency of @bdi is above its latency target the rate
+ *   is scaled by target / latency, again no lower than 1/8.
+ *
+ * The smaller of the two wins. The floor keeps background dirtiers
+ * making progress when foreground tasks keep the device busy.
+ */
+static unsigned long bg_dirty_ratio(struct backing_dev_info *bdi,
+				    unsigned int cg_ratio,
+				    unsigned long thresh,
+				    unsigned long dirty,
+				    unsigned long *latency)
+{
+	const unsigned long one = 1 << RATELIMIT_CALC_SHIFT;
+	const unsigned long min_ratio = one / 8;
+	unsigned long cg_thresh = thresh * cg_ratio / 100;
+	unsigned int target = bdi->latency_target_us;
+	unsigned long ratio = one;
+	unsigned long lat_ratio;
+
+	if (dirty >= thresh)
+		ratio = min_ratio;
+	else if (dirty > cg_thresh)
+		ratio = one - div_u64((u64)(one - min_ratio) *
+				      (dirty - cg_thresh), thresh - cg_thresh);
+
+	*latency = target ? bdi_read_latency(bdi) : 0;
+	if (target && *latency > target) {
+		lat_ratio = div_u64((u64)target << RATELIMIT_CALC_SHIFT,
+				    *latency);
+		ratio = min(ratio, max(lat_ratio, min_ratio));
+	}
+
+	return ratio;
+}
+
 /*
  * balance_dirty_pages() must be called by processes which are generating dirty
  * data.  It looks at the number of dirty pages in the machine and will force
@@ -1201,6 +1243,9 @@ static void balance_dirty_pages(struct address_space *mapping,
 	unsigned long pos_ratio;
 	struct backing_dev_info *bdi = mapping->backing_dev_info;
 	unsigned long start_time = jiffies;
+	unsigned int cg_ratio = blkcg_task_dirty_ratio(current);
+	unsigned long bg_ratio;
+	unsigned long latency;
 
 	for (;;) {
 		unsigned long now = jiffies;
@@ -1224,6 +1269,9 @@ static void balance_dirty_pages(struct address_space *mapping,
 		 */
 		freerun = dirty_freerun_ceiling(dirty_thresh,
 						background_thresh);
+		/* Background groups are throttled from their own share on */
+		if (cg_ratio < 100)
+			freerun = min(freerun, dirty_thresh * cg_ratio / 100);
 		if (nr_dirty <= freerun) {
 			current->dirty_paused_when = now;
 			current->nr_dirtied = 0;
@@ -1285,6 +1333,20 @@ static void balance_dirty_pages(struct address_space *mapping,
 					       bdi_thresh, bdi_dirty);
 		task_ratelimit = ((u64)dirty_ratelimit * pos_ratio) >>
 							RATELIMIT_CALC_SHIFT;
+		if (cg_ratio < 100) {
+			bg_ratio = bg_dirty_ratio(bdi, cg_ratio, dirty_thresh,
+						  nr_dirty, &latency);
+			if (bg_ratio < (1 << RATELIMIT_CALC_SHIFT)) {
+				task_ratelimit = ((u64)task_ratelimit *
+					bg_ratio) >> RATELIMIT_CALC_SHIFT;
+				trace_balance_dirty_pages_bg(bdi, cg_ratio,
+							     dirty_thresh,
+							     nr_dirty,
+							     latency,
+							     bg_ratio,
+							     task_ratelimit);
+			}
+		}
 		max_pause = bdi_max_pause(bdi, bdi_dirty);
 		min_pause = bdi_min_pause(bdi, max_pause,
 					  task_ratelimit, dirty_ratelimit,
@@ -60,6 +60,7 @@
 #include <linux/mm_inline.h>
 #include <linux/migrate.h>
 #include <linux/page-debug-flags.h>
+#include <linux/vmpressure.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -155,6 +156,7 @@ int pageblock_order __read_mostly;
 #endif
 
 static void __free_pages_ok(struct page *page, unsigned int order);
+static bool free_pcp_high_page(struct page *page, int order);
 
 /*
  * results with 256, 32 in the lowmem_reserve sysctl:
@@ -763,7 +765,8 @@ static void __free_pages_ok(struct page *page, unsigned int order)
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
+	if (!free_pcp_high_page(page, order))
+		free_one_page(page_zone(page), page, order,
 					get_pageblock_migratetype(page));
 	local_irq_restore(flags);
 }
@@ -1229,6 +1232,179 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 	return i;
 }
 
+#ifdef CONFIG_PCP_HIGH_ORDER
+/*
+ * Orders above 0 that get per-cpu free lists, so that bursts of same-order
+ * allocations (ION and KGSL buffers) and frees do not each take zone->lock.
+ * Only MIGRATE_UNMOVABLE blocks are cached.  0 marks an unused slot; set
+ * with pcp_high_orders=<order>[,<order>] on the command line.
+ */
+static int pcp_high_orders[NR_PCP_HIGH_ORDERS] = { 4 };
+
+/* Pages moved per refill or drain, whatever the order */
+#define PCP_HIGH_BATCH_PAGES	64
+
+static int __init setup_pcp_high_orders(char *str)
+{
+	int i, order, rc;
+
+	memset(pcp_high_orders, 0, sizeof(pcp_high_orders));
+	for (i = 0; i < NR_PCP_HIGH_ORDERS; i++) {
+		rc = get_option(&str, &order);
+		if (!rc)
+			break;
+		if (order > 0 && order < MAX_ORDER)
+			pcp_high_orders[i] = order;
+		if (rc != 2)
+			break;
+	}
+	return 0;
+}
+early_param("pcp_high_orders", setup_pcp_high_orders);
+
+static int pcp_high_slot(int order)
+{
+	int i;
+
+	for (i = 0; i < NR_PCP_HIGH_ORDERS; i++)
+		if (order && pcp_high_orders[i] == order)
+			return i;
+	return -1;
+}
+
+static void setup_pcp_high(struct per_cpu_pageset *p)
+{
+	int i;
+
+	for (i = 0; i < NR_PCP_HIGH_ORDERS; i++) {
+		struct per_cpu_high_pages *hpcp = &p->hpcp[i];
+
+		hpcp->count = 0;
+		hpcp->batch = max(1, PCP_HIGH_BATCH_PAGES >> pcp_high_orders[i]);
+		hpcp->high = 4 * hpcp->batch;
+		INIT_LIST_HEAD(&hpcp->list);
+	}
+}
+
+/*
+ * Return up to count blocks from a high-order pcp list to the buddy
+ * allocator.  Called with interrupts disabled.
+ */
+static void free_pcp_high_bulk(struct zone *zone, int order, int count,
+			       struct per_cpu_high_pages *hpcp)
+{
+	spin_lock(&zone->lock);
+	zone->pages_scanned = 0;
+
+	while (count-- && !list_empty(&hpcp->list)) {
+		struct page *page;
+		int mt;
+
+		page = list_entry(hpcp->list.prev, struct page, lru);
+		mt = get_pageblock_migratetype(page);
+		if (likely(mt != MIGRATE_ISOLATE))
+			mt = page_private(page);
+
+		list_del(&page->lru);
+		hpcp->count--;
+		__free_one_page(page, zone, order, mt);
+		if (likely(mt != MIGRATE_ISOLATE))
+			__mod_zone_freepage_state(zone, 1 << order, mt);
+	}
+	spin_unlock(&zone->lock);
+}
+
+static void drain_pcp_high(struct zone *zone, struct per_cpu_pageset *pset)
+{
+	int i;
+
+	for (i = 0; i < NR_PCP_HIGH_ORDERS; i++) {
+		struct per_cpu_high_pages *hpcp = &pset->hpcp[i];
+
+		if (hpcp->count)
+			free_pcp_high_bulk(zone, pcp_high_orders[i],
+					   hpcp->count, hpcp);
+	}
+}
+
+/*
+ * Put a freed block on this cpu's list for its order, if that order is
+ * cached.  Called with interrupts disabled.
+ */
+static bool free_pcp_high_page(struct page *page, int order)
+{
+	struct per_cpu_high_pages *hpcp;
+	struct zone *zone;
+	int slot = pcp_high_slot(order);
+
+	if (slot < 0 ||
+	    get_pageblock_migratetype(page) != MIGRATE_UNMOVABLE)
+		return false;
+
+	zone = page_zone(page);
+	hpcp = &this_cpu_ptr(zone->pageset)->hpcp[slot];
+	set_page_private(page, MIGRATE_UNMOVABLE);
+	list_add(&page->lru, &hpcp->list);
+	hpcp->count++;
+	if (hpcp->count >= hpcp->high)
+		free_pcp_high_bulk(zone, order, hpcp->batch, hpcp);
+	return true;
+}
+
+/*
+ * Take a block from this cpu's list for its order, refilling the list
+ * from the buddy allocator in one batch when it is empty.  Called with
+ * interrupts disabled.
+ */
+static struct page *rmqueue_pcp_high(struct zone *zone, int order,
+				     gfp_t gfp_flags, int migratetype)
+{
+	struct per_cpu_high_pages *hpcp;
+	struct page *page;
+	int slot = pcp_high_slot(order);
+
+	if (slot < 0 || migratetype != MIGRATE_UNMOVABLE ||
+	    (gfp_flags & __GFP_CMA))
+		return NULL;
+
+	hpcp = &this_cpu_ptr(zone->pageset)->hpcp[slot];
+	if (list_empty(&hpcp->list)) {
+		__count_vm_event(PCP_HIGH_ORDER_MISS);
+		hpcp->count += rmqueue_bulk(zone, order, hpcp->batch,
+					&hpcp->list, migratetype, 0, 0);
+		if (unlikely(list_empty(&hpcp->list)))
+			return NULL;
+	} else {
+		__count_vm_event(PCP_HIGH_ORDER_HIT);
+	}
+
+	page = list_entry(hpcp->list.next, struct page, lru);
+	list_del(&page->lru);
+	hpcp->count--;
+	return page;
+}
+#else
+static inline void setup_pcp_high(struct per_cpu_pageset *p)
+{
+}
+
+static inline void drain_pcp_high(struct zone *zone,
+				  struct per_cpu_pageset *pset)
+{
+}
+
+static bool free_pcp_high_page(struct page *page, int order)
+{
+	return false;
+}
+
+static inline struct page *rmqueue_pcp_high(struct zone *zone, int order,
+					    gfp_t gfp_flags, int migratetype)
+{
+	return NULL;
+}
+#endif /* CONFIG_PCP_HIGH_ORDER */
+
 #ifdef CONFIG_NUMA
 /*
  * Called from the vmstat counter updater to drain pagesets of this
@@ -1278,6 +1454,7 @@ static void drain_pages(unsigned int cpu)
 			free_pcppages_bulk(zone, pcp->count, pcp);
 			pcp->count = 0;
 		}
+		drain_pcp_high(zone, pset);
 		local_irq_restore(flags);
 	}
 }
@@ -1583,16 +1760,20 @@ again:
 			 */
 			WARN_ON_ONCE(order > 1);
 		}
-		spin_lock_irqsave(&zone->lock, flags);
-		if (gfp_flags & __GFP_CMA)
-			page = __rmqueue_cma(zone, order, migratetype);
-		else
-			page = __rmqueue(zone, order, migratetype);
-		spin_unlock(&zone->lock);
-		if (!page)
-			goto failed;
-		__mod_zone_freepage_state(zone, -(1 << order),
-					  get_pageblock_migratetype(page));
+		local_irq_save(flags);
+		page = rmqueue_pcp_high(zone, order, gfp_flags, migratetype);
+		if (!page) {
+			spin_lock(&zone->lock);
+			if (gfp_flags & __GFP_CMA)
+				page = __rmqueue_cma(zone, order, migratetype);
+			else
+				page = __rmqueue(zone, order, migratetype);
+			spin_unlock(&zone->lock);
+			if (!page)
+				goto failed;
+			__mod_zone_freepage_state(zone, -(1 << order),
+					get_pageblock_migratetype(page));
+		}
 	}
 
 	__count_zone_vm_events(PGALLOC, zone, 1 << order);
@@ -2200,6 +2381,7 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 	unsigned long *did_some_progress)
 {
 	int retry_times = 0, order_adj = order;
+	struct vmpressure_stall stall = { };
 
 	if (!order)
 		return NULL;
@@ -2210,11 +2392,13 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 	}
 
 retry_compact:
+	vmpressure_stall_enter(&stall);
 	current->flags |= PF_MEMALLOC;
 	*did_some_progress = try_to_compact_pages(zonelist, order_adj, gfp_mask,
 						nodemask, sync_migration,
 						contended_compaction);
 	current->flags &= ~PF_MEMALLOC;
+	vmpressure_stall_leave(&stall);
 
 	if (*did_some_progress != COMPACT_SKIPPED) {
 		struct page *page;
@@ -2288,12 +2472,14 @@ __perform_reclaim(gfp_t gfp_mask, unsigned int order, struct zonelist *zonelist,
 		  nodemask_t *nodemask)
 {
 	struct reclaim_state reclaim_state;
+	struct vmpressure_stall stall = { };
 	int progress;
 
 	cond_resched();
 
 	/* We now go into synchronous reclaim */
 	cpuset_memory_pressure_bump();
+	vmpressure_stall_enter(&stall);
 	current->flags |= PF_MEMALLOC;
 	lockdep_set_current_reclaim_state(gfp_mask);
 	reclaim_state.reclaimed_slab = 0;
@@ -2304,6 +2490,7 @@ __perform_reclaim(gfp_t gfp_mask, unsigned int order, struct zonelist *zonelist,
 	current->reclaim_state = NULL;
 	lockdep_clear_current_reclaim_state();
 	current->flags &= ~PF_MEMALLOC;
+	vmpressure_stall_leave(&stall);
 
 	cond_resched();
 
@@ -4015,6 +4202,7 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+	setup_pcp_high(p);
 }
 
 /*
@@ -4122,6 +4310,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		drain_pcp_high(zone, pset);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
@@ -17,6 +17,7 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <trace/events/filemap.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -198,8 +199,13 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	 * uptodate then the caller will launch readpage again, and
 	 * will then handle the error.
 	 */
-	if (ret)
+	if (ret) {
+		if (filp) {
+			filp->f_ra.ra_submitted += ret;
+			trace_mm_filemap_page_cache_miss(filp, offset, page_idx);
+		}
 		read_pages(mapping, filp, &page_pool, ret);
+	}
 	BUG_ON(!list_empty(&page_pool));
 out:
 	return ret;
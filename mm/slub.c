@@ -30,6 +30,11 @@
 #include <linux/fault-inject.h>
 #include <linux/stacktrace.h>
 #include <linux/prefetch.h>
+#include <linux/jump_label.h>
+#include <linux/debugfs.h>
+#include <linux/sort.h>
+#include <linux/hash.h>
+#include <linux/vmalloc.h>
 
 #include <trace/events/kmem.h>
 
@@ -233,6 +238,127 @@ static inline void stat(const struct kmem_cache *s, enum stat_item si)
 #endif
 }
 
+enum slub_profile_op { PROFILE_ALLOC, PROFILE_FREE };
+
+#ifdef CONFIG_SLUB_PROFILE
+/*
+ * Sampled profiling of allocation and free latency.  While disabled the
+ * hooks below are a patched-out branch; once enabled through debugfs one
+ * in 1 << slub_profile_shift operations per cpu and cache is timed.
+ */
+static struct static_key slub_profile_key = STATIC_KEY_INIT_FALSE;
+static u32 slub_profile_shift = 6;
+
+#define SLUB_PROFILE_SITES	512
+#define SLUB_PROFILE_PROBE	8
+
+/* Sampled allocation latency per call site, hashed by cache and address */
+struct slub_profile_site {
+	struct kmem_cache *s;
+	unsigned long addr;
+	unsigned long count;
+	u64 total_ns;
+};
+
+static struct slub_profile_site slub_profile_sites[SLUB_PROFILE_SITES];
+static unsigned long slub_profile_sites_dropped;
+static DEFINE_SPINLOCK(slub_profile_lock);
+
+static noinline u64 __slub_profile_start(struct kmem_cache *s)
+{
+	unsigned int tick = this_cpu_inc_return(s->cpu_slab->profile_tick);
+	unsigned int shift = min_t(u32, slub_profile_shift, 16);
+
+	if (tick & ((1U << shift) - 1))
+		return 0;
+	return local_clock() | 1;
+}
+
+static void slub_profile_site(struct kmem_cache *s, unsigned long addr,
+			      u64 ns)
+{
+	struct slub_profile_site *site;
+	unsigned int i, hash;
+
+	/* Never spin in the allocator: drop the sample if contended */
+	if (!spin_trylock(&slub_profile_lock))
+		return;
+
+	hash = hash_long(addr ^ (unsigned long)s, BITS_PER_LONG);
+	for (i = 0; i < SLUB_PROFILE_PROBE; i++) {
+		site = &slub_profile_sites[(hash + i) % SLUB_PROFILE_SITES];
+		if (site->s == s && site->addr == addr)
+			break;
+		if (!site->s) {
+			site->s = s;
+			site->addr = addr;
+			break;
+		}
+	}
+	if (i < SLUB_PROFILE_PROBE) {
+		site->count++;
+		site->total_ns += ns;
+	} else {
+		slub_profile_sites_dropped++;
+	}
+	spin_unlock(&slub_profile_lock);
+}
+
+static noinline void __slub_profile_end(struct kmem_cache *s, u64 start,
+				enum slub_profile_op op, unsigned long addr)
+{
+	struct kmem_cache_latency *lat;
+	unsigned long flags;
+	u64 ns = local_clock() - start;
+
+	local_irq_save(flags);
+	lat = op == PROFILE_ALLOC ? &this_cpu_ptr(s->cpu_slab)->alloc_lat :
+				    &this_cpu_ptr(s->cpu_slab)->free_lat;
+	lat->samples++;
+	lat->total_ns += ns;
+	if (ns > lat->max_ns)
+		lat->max_ns = ns;
+	if (op == PROFILE_ALLOC)
+		slub_profile_site(s, addr, ns);
+	local_irq_restore(flags);
+}
+
+static __always_inline u64 slub_profile_start(struct kmem_cache *s)
+{
+	if (static_key_false(&slub_profile_key))
+		return __slub_profile_start(s);
+	return 0;
+}
+
+static __always_inline void slub_profile_end(struct kmem_cache *s, u64 start,
+				enum slub_profile_op op, unsigned long addr)
+{
+	if (static_key_false(&slub_profile_key) && start)
+		__slub_profile_end(s, start, op, addr);
+}
+
+/* Called with interrupts disabled when a cpu acquires a new cpu slab */
+static inline void slub_profile_refill(struct kmem_cache_cpu *c)
+{
+	if (static_key_false(&slub_profile_key))
+		c->refills++;
+}
+#else
+static inline u64 slub_profile_start(struct kmem_cache *s)
+{
+	return 0;
+}
+
+static inline void slub_profile_end(struct kmem_cache *s, u64 start,
+				enum slub_profile_op op, unsigned long addr)
+{
+}
+
+static inline void slub_profile_refill(struct kmem_cache_cpu *c)
+{
+}
+#endif /* CONFIG_SLUB_PROFILE */
+
 /********************************************************************
  * 			Core slab cache functions
  *******************************************************************/
@@ -2239,6 +2365,7 @@ load_freelist:
 	return object;
 
 new_slab:
+	slub_profile_refill(c);
 
 	if (c->partial) {
 		c->page = c->partial;
@@ -2295,10 +2422,12 @@ static __always_inline void *slab_alloc(struct kmem_cache *s,
 	void **object;
 	struct kmem_cache_cpu *c;
 	unsigned long tid;
+	u64 profile;
 
 	if (slab_pre_alloc_hook(s, gfpflags))
 		return NULL;
 
+	profile = slub_profile_start(s);
 redo:
 	/*
 	 * Must read kmem_cache cpu data via this cpu ptr. Preemption is
@@ -2360,6 +2489,7 @@ redo:
 
 	slab_post_alloc_hook(s, gfpflags, object);
 
+	slub_profile_end(s, profile, PROFILE_ALLOC, addr);
 	return object;
 }
 
@@ -2558,6 +2688,7 @@ static __always_inline void slab_free(struct kmem_cache *s,
 	void **object = (void *)x;
 	struct kmem_cache_cpu *c;
 	unsigned long tid;
+	u64 profile = slub_profile_start(s);
 
 	slab_free_hook(s, x);
 
@@ -2589,6 +2720,7 @@ redo:
 	} else
 		__slab_free(s, page, x, addr);
 
+	slub_profile_end(s, profile, PROFILE_FREE, addr);
 }
 
 void kmem_cache_free(struct kmem_cache *s, void *x)
@@ -5517,3 +5649,245 @@ static int __init slab_proc_init(void)
 }
 module_init(slab_proc_init);
 #endif /* CONFIG_SLABINFO */
+
+#ifdef CONFIG_SLUB_PROFILE
+/*
+ * /sys/kernel/debug/slub_profile: "enable" switches sampling on and off
+ * (clearing the previous results when switched on), "sample_shift" sets
+ * the sampling interval, "caches" reports latency, refills and partial
+ * list lengths per cache and "callsites" the busiest allocation sites.
+ */
+static bool slub_profile_enabled;
+static u64 slub_profile_since;
+static DEFINE_MUTEX(slub_profile_mutex);
+
+#define SLUB_PROFILE_TOP	20
+
+static void slub_profile_reset(void)
+{
+	struct kmem_cache *s;
+	unsigned long flags;
+	int cpu;
+
+	down_read(&slub_lock);
+	list_for_each_entry(s, &slab_caches, list) {
+		for_each_possible_cpu(cpu) {
+			struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
+
+			c->refills = 0;
+			memset(&c->alloc_lat, 0, sizeof(c->alloc_lat));
+			memset(&c->free_lat, 0, sizeof(c->free_lat));
+		}
+	}
+	up_read(&slub_lock);
+
+	spin_lock_irqsave(&slub_profile_lock, flags);
+	memset(slub_profile_sites, 0, sizeof(slub_profile_sites));
+	slub_profile_sites_dropped = 0;
+	spin_unlock_irqrestore(&slub_profile_lock, flags);
+}
+
+static ssize_t slub_profile_enable_read(struct file *file, char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	char tmp[4];
+	int len = sprintf(tmp, "%d\n", slub_profile_enabled);
+
+	return simple_read_from_buffer(buf, count, ppos, tmp, len);
+}
+
+static ssize_t slub_profile_enable_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned long enable;
+	int err;
+
+	err = kstrtoul_from_user(buf, count, 10, &enable);
+	if (err)
+		return err;
+	if (enable > 1)
+		return -EINVAL;
+
+	mutex_lock(&slub_profile_mutex);
+	if (enable && !slub_profile_enabled) {
+		slub_profile_reset();
+		slub_profile_since = local_clock();
+		static_key_slow_inc(&slub_profile_key);
+	} else if (!enable && slub_profile_enabled) {
+		static_key_slow_dec(&slub_profile_key);
+	}
+	slub_profile_enabled = enable;
+	mutex_unlock(&slub_profile_mutex);
+
+	return count;
+}
+
+static const struct file_operations slub_profile_enable_fops = {
+	.read		= slub_profile_enable_read,
+	.write		= slub_profile_enable_write,
+	.llseek		= default_llseek,
+};
+
+static void slub_profile_show_lat(struct seq_file *m,
+				  struct kmem_cache_latency *lat)
+{
+	seq_printf(m, " %8lu %7llu %8llu", lat->samples,
+		   lat->samples ? div64_u64(lat->total_ns, lat->samples) : 0,
+		   lat->max_ns);
+}
+
+static int slub_profile_caches_show(struct seq_file *m, void *v)
+{
+	struct kmem_cache *s;
+	int cpu, node;
+
+	seq_printf(m, "sampling 1/%u for %llu ms\n",
+		   1U << min_t(u32, slub_profile_shift, 16),
+		   slub_profile_enabled ?
+		   div_u64(local_clock() - slub_profile_since, NSEC_PER_MSEC) :
+		   0ULL);
+	seq_puts(m, "# name             allocs  avg_ns   max_ns    frees"
+		 "  avg_ns   max_ns  refills node_partial cpu_partial"
+		 " : refills per cpu\n");
+
+	down_read(&slub_lock);
+	list_for_each_entry(s, &slab_caches, list) {
+		struct kmem_cache_latency alloc = { 0 }, free = { 0 };
+		unsigned long refills = 0, node_partial = 0;
+		int cpu_partial = 0;
+
+		for_each_possible_cpu(cpu) {
+			struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
+
+			refills += c->refills;
+			alloc.samples += c->alloc_lat.samples;
+			alloc.total_ns += c->alloc_lat.total_ns;
+			alloc.max_ns = max(alloc.max_ns, c->alloc_lat.max_ns);
+			free.samples += c->free_lat.samples;
+			free.total_ns += c->free_lat.total_ns;
+			free.max_ns = max(free.max_ns, c->free_lat.max_ns);
+			if (cpu_online(cpu) && c->partial)
+				cpu_partial += c->partial->pages;
+		}
+		if (!alloc.samples && !free.samples && !refills)
+			continue;
+
+		for_each_online_node(node) {
+			struct kmem_cache_node *n = get_node(s, node);
+
+			if (n)
+				node_partial += n->nr_partial;
+		}
+
+		seq_printf(m, "%-17s", s->name);
+		slub_profile_show_lat(m, &alloc);
+		slub_profile_show_lat(m, &free);
+		seq_printf(m, " %8lu %12lu %11d :", refills, node_partial,
+			   cpu_partial);
+		for_each_online_cpu(cpu)
+			seq_printf(m, " C%d=%lu", cpu,
+				   per_cpu_ptr(s->cpu_slab, cpu)->refills);
+		seq_putc(m, '\n');
+	}
+	up_read(&slub_lock);
+	return 0;
+}
+
+static int slub_profile_caches_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, slub_profile_caches_show, NULL);
+}
+
+static const struct file_operations slub_profile_caches_fops = {
+	.open		= slub_profile_caches_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int slub_profile_site_cmp(const void *a, const void *b)
+{
+	const struct slub_profile_site *x = a, *y = b;
+
+	if (x->count == y->count)
+		return 0;
+	return x->count > y->count ? -1 : 1;
+}
+
+static int slub_profile_callsites_show(struct seq_file *m, void *v)
+{
+	struct slub_profile_site *sites;
+	unsigned long flags, dropped;
+	int i;
+
+	sites = vmalloc(sizeof(slub_profile_sites));
+	if (!sites)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&slub_profile_lock, flags);
+	memcpy(sites, slub_profile_sites, sizeof(slub_profile_sites));
+	dropped = slub_profile_sites_dropped;
+	spin_unlock_irqrestore(&slub_profile_lock, flags);
+
+	sort(sites, SLUB_PROFILE_SITES, sizeof(*sites),
+	     slub_profile_site_cmp, NULL);
+
+	seq_printf(m, "# samples  avg_ns cache             site"
+		   " (%lu samples dropped)\n", dropped);
+	/*
+	 * Caches may have been destroyed since they were sampled, so only
+	 * print names of those still on the list.
+	 */
+	down_read(&slub_lock);
+	for (i = 0; i < SLUB_PROFILE_TOP && sites[i].count; i++) {
+		struct kmem_cache *s;
+		const char *name = "(destroyed)";
+
+		list_for_each_entry(s, &slab_caches, list) {
+			if (s == sites[i].s) {
+				name = s->name;
+				break;
+			}
+		}
+		seq_printf(m, "%9lu %7llu %-17s %pS\n", sites[i].count,
+			   div64_u64(sites[i].total_ns, sites[i].count),
+			   name, (void *)sites[i].addr);
+	}
+	up_read(&slub_lock);
+
+	vfree(sites);
+	return 0;
+}
+
+static int slub_profile_callsites_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, slub_profile_callsites_show, NULL);
+}
+
+static const struct file_operations slub_profile_callsites_fops = {
+	.open		= slub_profile_callsites_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init slub_profile_debugfs_init(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("slub_profile", NULL);
+	if (!root)
+		return -ENOMEM;
+
+	debugfs_create_file("enable", S_IRUSR | S_IWUSR, root, NULL,
+			    &slub_profile_enable_fops);
+	debugfs_create_u32("sample_shift", S_IRUSR | S_IWUSR, root,
+			   &slub_profile_shift);
+	debugfs_create_file("caches", S_IRUSR, root, NULL,
+			    &slub_profile_caches_fops);
+	debugfs_create_file("callsites", S_IRUSR, root, NULL,
+			    &slub_profile_callsites_fops);
+	return 0;
+}
+late_initcall(slub_profile_debugfs_init);
+#endif /* CONFIG_SLUB_PROFILE */
@@ -50,14 +50,39 @@ static struct {
 	unsigned long del_total;
 	unsigned long find_success;
 	unsigned long find_total;
+	unsigned long ra_hits;
 } swap_cache_info;
 
+/*
+ * Swapin readahead state is kept per vma (or in swapin_readahead_info for
+ * callers without a real vma, such as shmem) packed into one atomic_long_t:
+ * bits 0-5 count readahead hits since the window was last sized, bits 6-11
+ * hold that window, and the remaining bits the swap offset of the last fault.
+ */
+#define SWAP_RA_HITS_BITS	6
+#define SWAP_RA_HITS_MAX	((1UL << SWAP_RA_HITS_BITS) - 1)
+#define SWAP_RA_WIN_SHIFT	SWAP_RA_HITS_BITS
+#define SWAP_RA_WIN_MAX		32
+#define SWAP_RA_OFFSET_SHIFT	(2 * SWAP_RA_HITS_BITS)
+#define SWAP_RA_OFFSET_MASK	(~0UL >> SWAP_RA_OFFSET_SHIFT)
+
+#define SWAP_RA_HITS(v)		((v) & SWAP_RA_HITS_MAX)
+#define SWAP_RA_WIN(v)		(((v) >> SWAP_RA_WIN_SHIFT) & SWAP_RA_HITS_MAX)
+#define SWAP_RA_OFFSET(v)	((v) >> SWAP_RA_OFFSET_SHIFT)
+#define SWAP_RA_VAL(offset, win, hits)				\
+	(((offset) << SWAP_RA_OFFSET_SHIFT) |			\
+	 ((unsigned long)(win) << SWAP_RA_WIN_SHIFT) | (hits))
+
+static atomic_long_t swapin_readahead_info = ATOMIC_LONG_INIT(0);
+
 void show_swap_cache_info(void)
 {
 	printk("%lu pages in swap cache\n", total_swapcache_pages);
-	printk("Swap cache stats: add %lu, delete %lu, find %lu/%lu\n",
+	printk("Swap cache stats: add %lu, delete %lu, find %lu/%lu, "
+		"readahead hits %lu\n",
 		swap_cache_info.add_total, swap_cache_info.del_total,
-		swap_cache_info.find_success, swap_cache_info.find_total);
+		swap_cache_info.find_success, swap_cache_info.find_total,
+		swap_cache_info.ra_hits);
 	printk("Free swap  = %ldkB\n",
 		get_nr_swap_pages() << (PAGE_SHIFT - 10));
 	printk("Total swap = %lukB\n", total_swap_pages << (PAGE_SHIFT - 10));
@@ -255,20 +280,47 @@ void free_pages_and_swap_cache(struct page **pages, int nr)
 	}
 }
 
+static atomic_long_t *swap_ra_info(struct vm_area_struct *vma)
+{
+	if (vma && vma->vm_mm)
+		return &vma->swap_readahead_info;
+	return &swapin_readahead_info;
+}
+
+static void swap_ra_hit(struct vm_area_struct *vma)
+{
+	atomic_long_t *info = swap_ra_info(vma);
+	unsigned long old;
+
+	do {
+		old = atomic_long_read(info);
+		if (SWAP_RA_HITS(old) == SWAP_RA_HITS_MAX)
+			return;
+	} while (atomic_long_cmpxchg(info, old, old + 1) != old);
+}
+
 /*
  * Lookup a swap entry in the swap cache. A found page will be returned
  * unlocked and with its refcount incremented - we rely on the kernel
  * lock getting page table operations atomic even if we drop the page
  * lock before returning.
+ *
+ * A page brought in by swapin_readahead() is credited to @vma's readahead
+ * window the first time it is found here.
  */
-struct page * lookup_swap_cache(swp_entry_t entry)
+struct page *lookup_swap_cache(swp_entry_t entry, struct vm_area_struct *vma)
 {
 	struct page *page;
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (TestClearPageReadahead(page)) {
+			INC_CACHE_INFO(ra_hits);
+			swap_ra_hit(vma);
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
@@ -280,12 +332,14 @@ struct page * lookup_swap_cache(swp_entry_t entry)
  * A failure return means that either the page allocation failed or that
  * the swap entry is no longer in use.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry,
+			gfp_t gfp_mask, struct vm_area_struct *vma,
+			unsigned long addr, bool *new_page_allocated)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*new_page_allocated = false;
 	do {
 		/*
 		 * First check the swap cache.  Since this is normally
@@ -352,6 +406,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			 */
 			lru_cache_add_anon(new_page);
 			swap_readpage(new_page);
+			*new_page_allocated = true;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -369,6 +424,66 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	bool new_page_allocated;
+
+	return __read_swap_cache_async(entry, gfp_mask, vma, addr,
+				       &new_page_allocated);
+}
+
+/*
+ * Size the readahead window for a fault on @entry from the hits the last
+ * window earned: a window that went unused collapses to the faulting page
+ * alone unless the fault is next to the previous one, while hits grow it
+ * up to 1 << page_cluster.  On slow devices the window only halves per
+ * fault, since a seek costs more than a few wasted pages; on devices with
+ * no seek cost (SWP_FAST) every speculative page is a wasted read and
+ * decompression, so the window follows the hits directly.
+ */
+static unsigned int swapin_nr_pages(swp_entry_t entry,
+			struct vm_area_struct *vma, bool fast)
+{
+	atomic_long_t *info = swap_ra_info(vma);
+	unsigned long offset = swp_offset(entry) & SWAP_RA_OFFSET_MASK;
+	unsigned long old, prev_offset;
+	unsigned int hits, prev_win, pages, max_pages;
+
+	max_pages = min_t(unsigned int, 1U << page_cluster, SWAP_RA_WIN_MAX);
+
+	do {
+		old = atomic_long_read(info);
+		hits = SWAP_RA_HITS(old);
+		prev_win = SWAP_RA_WIN(old);
+		prev_offset = SWAP_RA_OFFSET(old);
+
+		pages = hits + 2;
+		if (pages == 2) {
+			/* No hits: read ahead only for a sequential fault */
+			if (offset != ((prev_offset + 1) & SWAP_RA_OFFSET_MASK) &&
+			    offset != ((prev_offset - 1) & SWAP_RA_OFFSET_MASK))
+				pages = 1;
+		} else {
+			unsigned int roundup = 4;
+
+			while (roundup < pages)
+				roundup <<= 1;
+			pages = roundup;
+		}
+
+		if (!fast && pages < prev_win / 2)
+			pages = prev_win / 2;
+		if (pages > max_pages)
+			pages = max_pages;
+		if (!pages)
+			pages = 1;
+	} while (atomic_long_cmpxchg(info, old,
+				     SWAP_RA_VAL(offset, pages, 0)) != old);
+
+	return pages;
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -379,9 +494,11 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
  * Returns the struct page for entry and addr, after queueing swapin.
  *
  * Primitive swap readahead code. We simply read an aligned block of
- * (1 << page_cluster) entries in the swap area. This method is chosen
- * because it doesn't cost us any seek time.  We also make sure to queue
- * the 'original' request together with the readahead ones...
+ * entries in the swap area, sized by swapin_nr_pages() from how well the
+ * previous readahead in this vma was used, up to (1 << page_cluster).
+ * This method is chosen because it doesn't cost us any seek time.  We
+ * also make sure to queue the 'original' request together with the
+ * readahead ones...
  *
  * This has been extended to use the NUMA policies from the mm triggering
  * the readahead.
@@ -392,11 +509,17 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 			struct vm_area_struct *vma, unsigned long addr)
 {
 	struct page *page;
-	unsigned long offset = swp_offset(entry);
+	unsigned long entry_offset = swp_offset(entry);
+	unsigned long offset = entry_offset;
 	unsigned long start_offset, end_offset;
-	unsigned long mask = is_swap_fast(entry) ? 0 : (1UL << page_cluster) - 1;
+	unsigned long mask;
+	bool page_allocated;
+
+	mask = swapin_nr_pages(entry, vma, is_swap_fast(entry)) - 1;
+	if (!mask)
+		goto skip;
 
-	/* Read a page_cluster sized and aligned cluster around offset. */
+	/* Read a window sized and aligned cluster around offset. */
 	start_offset = offset & ~mask;
 	end_offset = offset | mask;
 	if (!start_offset)	/* First page is swap header. */
@@ -404,12 +527,15 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 
 	for (offset = start_offset; offset <= end_offset ; offset++) {
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
+		page = __read_swap_cache_async(swp_entry(swp_type(entry), offset),
+					gfp_mask, vma, addr, &page_allocated);
 		if (!page)
 			continue;
+		if (page_allocated && offset != entry_offset)
+			SetPageReadahead(page);
 		page_cache_release(page);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
+skip:
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
@@ -688,6 +688,24 @@ int page_swapcount(struct page *page)
 	return count;
 }
 
+/*
+ * How many page table entries refer to the swap slot of @entry?
+ * Like page_swapcount(), this stops counting at SWAP_MAP_MAX when the
+ * count is continued, which is plenty for sharing out proportional sizes.
+ */
+int swp_swapcount(swp_entry_t entry)
+{
+	int count = 0;
+	struct swap_info_struct *p;
+
+	p = swap_info_get(entry);
+	if (p) {
+		count = swap_count(p->swap_map[swp_offset(entry)]);
+		spin_unlock(&p->lock);
+	}
+	return count & ~COUNT_CONTINUED;
+}
+
 /*
  * We can write to an anon page without COW if there are no other references
  * to it.  And as a side-effect, free up its swap: because the old content
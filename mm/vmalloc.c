@@ -248,6 +248,9 @@ EXPORT_SYMBOL(vmalloc_to_pfn);
 #define VM_LAZY_FREE	0x01
 #define VM_LAZY_FREEING	0x02
 #define VM_VM_AREA	0x04
+#define VM_VMAP_BLOCK	0x08	/* backs a per-cpu vmap_block */
+
+struct vmap_block_queue;
 
 struct vmap_area {
 	unsigned long va_start;
@@ -256,7 +259,10 @@ struct vmap_area {
 	struct rb_node rb_node;		/* address sorted rbtree */
 	struct list_head list;		/* address sorted list */
 	struct list_head purge_list;	/* "lazy purge" list */
-	struct vm_struct *vm;
+	union {
+		struct vm_struct *vm;		/* VM_VM_AREA */
+		struct vmap_block_queue *vbq;	/* VM_VMAP_BLOCK */
+	};
 	struct rcu_head rcu_head;
 };
 
@@ -264,6 +270,18 @@ static DEFINE_SPINLOCK(vmap_area_lock);
 static LIST_HEAD(vmap_area_list);
 static struct rb_root vmap_area_root = RB_ROOT;
 
+/*
+ * Take vmap_area_lock, counting in /proc/vmstat how often somebody else
+ * was holding it.
+ */
+static inline void lock_vmap_area(void)
+{
+	if (!spin_trylock(&vmap_area_lock)) {
+		count_vm_event(VMAP_LOCK_CONTENDED);
+		spin_lock(&vmap_area_lock);
+	}
+}
+
 /* The vmap cache globals are protected by vmap_area_lock */
 static struct rb_node *free_vmap_cache;
 static unsigned long cached_hole_size;
@@ -397,7 +415,7 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 	kmemleak_scan_area(&va->rb_node, SIZE_MAX, gfp_mask & GFP_RECLAIM_MASK);
 
 retry:
-	spin_lock(&vmap_area_lock);
+	lock_vmap_area();
 	/*
 	 * Invalidate cache if we have more permissive parameters.
 	 * cached_hole_size notes the largest hole noticed _below_
@@ -539,7 +557,7 @@ static void __free_vmap_area(struct vmap_area *va)
  */
 static void free_vmap_area(struct vmap_area *va)
 {
-	spin_lock(&vmap_area_lock);
+	lock_vmap_area();
 	__free_vmap_area(va);
 	spin_unlock(&vmap_area_lock);
 }
@@ -589,7 +607,7 @@ static void vmap_debug_free_range(unsigned long start, unsigned long end)
  * code, and it will be simple to change the scale factor if we find that it
  * becomes a problem on bigger systems.
  */
-static unsigned long lazy_max_pages(void)
+static unsigned long lazy_base_pages(void)
 {
 	unsigned int log;
 
@@ -598,10 +616,49 @@ static unsigned long lazy_max_pages(void)
 	return log * (32UL * 1024 * 1024 / PAGE_SIZE);
 }
 
+/*
+ * When the threshold keeps being hit in quick succession - drivers mapping
+ * and unmapping buffers all the time - every purge is a broadcast TLB flush
+ * for little gain, so let more lazy areas pile up between flushes, up to
+ * VMAP_LAZY_SCALE_MAX times the base and never more than half of the
+ * vmalloc space. The scale comes back down once purges are infrequent.
+ */
+#define VMAP_LAZY_SCALE_MAX	4
+#define VMAP_PURGE_FAST		(HZ / 10)
+#define VMAP_PURGE_SLOW		HZ
+
+static unsigned int vmap_lazy_scale = 1;
+static unsigned long vmap_last_purge;
+
+static unsigned long lazy_max_pages(void)
+{
+	unsigned long pages = lazy_base_pages() * vmap_lazy_scale;
+
+	return min_t(unsigned long, pages,
+		     (VMALLOC_END - VMALLOC_START) >> (PAGE_SHIFT + 1));
+}
+
+/* Called with purge_lock held, for purges the threshold triggered. */
+static void vmap_lazy_adapt(void)
+{
+	unsigned long since = jiffies - vmap_last_purge;
+
+	if (since < VMAP_PURGE_FAST) {
+		if (vmap_lazy_scale < VMAP_LAZY_SCALE_MAX)
+			vmap_lazy_scale <<= 1;
+	} else if (since > VMAP_PURGE_SLOW) {
+		if (vmap_lazy_scale > 1)
+			vmap_lazy_scale >>= 1;
+	}
+	vmap_last_purge = jiffies;
+}
+
 static atomic_t vmap_lazy_nr = ATOMIC_INIT(0);
 
 /* for per-CPU blocks */
 static void purge_fragmented_blocks_allcpus(void);
+static void keep_spare_vmap_block(struct vmap_area *va);
+static void free_spare_vmap_blocks(void);
 
 /*
  * called before a call to iounmap() if the caller wants vm_area_struct's
@@ -637,8 +694,11 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	 * the case that isn't actually used at the moment anyway.
 	 */
 	if (!sync && !force_flush) {
-		if (!spin_trylock(&purge_lock))
+		if (!spin_trylock(&purge_lock)) {
+			count_vm_event(VMAP_PURGE_SKIPPED);
 			return;
+		}
+		vmap_lazy_adapt();
 	} else
 		spin_lock(&purge_lock);
 
@@ -660,14 +720,23 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	}
 	rcu_read_unlock();
 
-	if (nr)
+	if (nr) {
 		atomic_sub(nr, &vmap_lazy_nr);
+		count_vm_event(VMAP_PURGE);
+		count_vm_events(VMAP_PURGE_PAGES, nr);
+	}
 
+	/* one flush covers every area purged, however many there are */
 	if (nr || force_flush)
 		flush_tlb_kernel_range(*start, *end);
 
 	if (nr) {
-		spin_lock(&vmap_area_lock);
+		/* flushed block areas can go straight back to their cpu */
+		list_for_each_entry_safe(va, n_va, &valist, purge_list)
+			if (va->flags & VM_VMAP_BLOCK)
+				keep_spare_vmap_block(va);
+
+		lock_vmap_area();
 		list_for_each_entry_safe(va, n_va, &valist, purge_list)
 			__free_vmap_area(va);
 		spin_unlock(&vmap_area_lock);
@@ -694,6 +763,8 @@ static void purge_vmap_area_lazy(void)
 	unsigned long start = ULONG_MAX, end = 0;
 
 	__purge_vmap_area_lazy(&start, &end, 1, 0);
+	/* we are short of kva: give up the spare blocks too */
+	free_spare_vmap_blocks();
 }
 
 /*
@@ -732,7 +803,7 @@ static struct vmap_area *find_vmap_area(unsigned long addr)
 {
 	struct vmap_area *va;
 
-	spin_lock(&vmap_area_lock);
+	lock_vmap_area();
 	va = __find_vmap_area(addr);
 	spin_unlock(&vmap_area_lock);
 
@@ -767,7 +838,7 @@ static void free_unmap_vmap_area_addr(unsigned long addr)
 #endif
 
 #define VMALLOC_PAGES		(VMALLOC_SPACE / PAGE_SIZE)
-#define VMAP_MAX_ALLOC		BITS_PER_LONG	/* 256K with 4K pages */
+#define VMAP_MAX_ALLOC		64		/* 256K with 4K pages */
 #define VMAP_BBMAP_BITS_MAX	1024	/* 4MB with 4K pages */
 #define VMAP_BBMAP_BITS_MIN	(VMAP_MAX_ALLOC*2)
 #define VMAP_MIN(x, y)		((x) < (y) ? (x) : (y)) /* can't use min() */
@@ -781,9 +852,18 @@ static void free_unmap_vmap_area_addr(unsigned long addr)
 
 static bool vmap_initialized __read_mostly = false;
 
+/*
+ * Up to VMAP_BLOCK_SPARE areas of blocks that were used up and freed are
+ * kept for each cpu once the lazy purge has flushed them, so that the
+ * next block is set up without going through vmap_area_lock.
+ */
+#define VMAP_BLOCK_SPARE	4
+
 struct vmap_block_queue {
 	spinlock_t lock;
 	struct list_head free;
+	struct list_head spare;		/* flushed VM_VMAP_BLOCK areas */
+	unsigned int nr_spare;
 };
 
 struct vmap_block {
@@ -823,6 +903,66 @@ static unsigned long addr_to_vb_idx(unsigned long addr)
 	return addr;
 }
 
+/*
+ * Called from the lazy purge, after the TLB flush, for an area that backed
+ * a vmap_block: keep it for the block's cpu if that has room.
+ */
+static void keep_spare_vmap_block(struct vmap_area *va)
+{
+	struct vmap_block_queue *vbq = va->vbq;
+
+	spin_lock(&vbq->lock);
+	if (vbq->nr_spare < VMAP_BLOCK_SPARE) {
+		va->flags = VM_VMAP_BLOCK;
+		list_move(&va->purge_list, &vbq->spare);
+		vbq->nr_spare++;
+	}
+	spin_unlock(&vbq->lock);
+}
+
+static void free_spare_vmap_blocks(void)
+{
+	struct vmap_area *va, *n_va;
+	LIST_HEAD(valist);
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct vmap_block_queue *vbq = &per_cpu(vmap_block_queue, cpu);
+
+		spin_lock(&vbq->lock);
+		list_splice_init(&vbq->spare, &valist);
+		vbq->nr_spare = 0;
+		spin_unlock(&vbq->lock);
+	}
+
+	if (list_empty(&valist))
+		return;
+
+	lock_vmap_area();
+	list_for_each_entry_safe(va, n_va, &valist, purge_list)
+		__free_vmap_area(va);
+	spin_unlock(&vmap_area_lock);
+}
+
+static struct vmap_area *get_spare_vmap_block(void)
+{
+	struct vmap_block_queue *vbq;
+	struct vmap_area *va = NULL;
+
+	vbq = &get_cpu_var(vmap_block_queue);
+	spin_lock(&vbq->lock);
+	if (vbq->nr_spare) {
+		va = list_first_entry(&vbq->spare, struct vmap_area,
+				      purge_list);
+		list_del(&va->purge_list);
+		vbq->nr_spare--;
+	}
+	spin_unlock(&vbq->lock);
+	put_cpu_var(vmap_block_queue);
+
+	return va;
+}
+
 static struct vmap_block *new_vmap_block(gfp_t gfp_mask)
 {
 	struct vmap_block_queue *vbq;
@@ -838,12 +978,18 @@ static struct vmap_block *new_vmap_block(gfp_t gfp_mask)
 	if (unlikely(!vb))
 		return ERR_PTR(-ENOMEM);
 
-	va = alloc_vmap_area(VMAP_BLOCK_SIZE, VMAP_BLOCK_SIZE,
-					VMALLOC_START, VMALLOC_END,
-					node, gfp_mask);
-	if (IS_ERR(va)) {
-		kfree(vb);
-		return ERR_CAST(va);
+	va = get_spare_vmap_block();
+	if (va) {
+		count_vm_event(VMAP_BLOCK_REUSED);
+	} else {
+		va = alloc_vmap_area(VMAP_BLOCK_SIZE, VMAP_BLOCK_SIZE,
+						VMALLOC_START, VMALLOC_END,
+						node, gfp_mask);
+		if (IS_ERR(va)) {
+			kfree(vb);
+			return ERR_CAST(va);
+		}
+		va->flags = VM_VMAP_BLOCK;
 	}
 
 	err = radix_tree_preload(gfp_mask);
@@ -870,6 +1016,7 @@ static struct vmap_block *new_vmap_block(gfp_t gfp_mask)
 
 	vbq = &get_cpu_var(vmap_block_queue);
 	vb->vbq = vbq;
+	va->vbq = vbq;
 	spin_lock(&vbq->lock);
 	list_add_rcu(&vb->free_list, &vbq->free);
 	spin_unlock(&vbq->lock);
@@ -1251,6 +1398,8 @@ void __init vmalloc_init(void)
 		vbq = &per_cpu(vmap_block_queue, i);
 		spin_lock_init(&vbq->lock);
 		INIT_LIST_HEAD(&vbq->free);
+		INIT_LIST_HEAD(&vbq->spare);
+		vbq->nr_spare = 0;
 	}
 
 	/* Import existing vmlist entries. */
@@ -18,6 +18,7 @@
 #include <linux/sched.h>
 #include <linux/mm.h>
 #include <linux/vmstat.h>
+#include <linux/memcontrol.h>
 #include <linux/eventfd.h>
 #include <linux/swap.h>
 #include <linux/printk.h>
@@ -25,6 +26,10 @@
 #include <linux/notifier.h>
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/ktime.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/poll.h>
 #include <linux/vmpressure.h>
 
 /*
@@ -100,7 +105,7 @@ static struct vmpressure *work_to_vmpressure(struct work_struct *work)
 	return container_of(work, struct vmpressure, work);
 }
 
-#ifdef CONFIG_MEMCG
+#ifdef CONFIG_CGROUP_MEM_RES_CTLR
 static struct vmpressure *cg_to_vmpressure(struct cgroup *cg)
 {
 	return css_to_vmpressure(cgroup_subsys_state(cg, mem_cgroup_subsys_id));
@@ -351,7 +356,7 @@ void vmpressure(gfp_t gfp, struct mem_cgroup *memcg,
 	if (!memcg)
 		vmpressure_global(gfp, scanned, reclaimed);
 
-	if (IS_ENABLED(CONFIG_MEMCG))
+	if (IS_ENABLED(CONFIG_CGROUP_MEM_RES_CTLR))
 		vmpressure_memcg(gfp, memcg, scanned, reclaimed);
 }
 
@@ -385,6 +390,453 @@ void vmpressure_prio(gfp_t gfp, struct mem_cgroup *memcg, int prio)
 	vmpressure(gfp, memcg, vmpressure_win, 0);
 }
 
+/*
+ * Memory stall accounting
+ *
+ * Tasks in direct reclaim, direct compaction or swap-in mark themselves
+ * stalled in the global vmpressure and in that of their memcg and its
+ * parents. "some" time accrues while at least one task is stalled, and
+ * "full" time while stalled tasks occupy every online CPU, that is while
+ * no CPU can be doing productive work.
+ *
+ * The totals are sampled every two seconds into 10s, 60s and 300s
+ * running averages, calculated the same way as the load average.
+ */
+#define STALL_AVG_PERIOD	(2 * HZ)
+#define STALL_EXP_10s		1677		/* 1/exp(2s/10s) as fixed-point */
+#define STALL_EXP_60s		1981		/* 1/exp(2s/60s) */
+#define STALL_EXP_300s		2034		/* 1/exp(2s/300s) */
+/* Stop sampling once nothing stalled for the longest average window */
+#define STALL_IDLE_NS		(300ULL * NSEC_PER_SEC)
+
+#define STALL_WINDOW_MIN_US	500000
+#define STALL_WINDOW_MAX_US	10000000
+
+#define LOAD_INT(x) ((x) >> FSHIFT)
+#define LOAD_FRAC(x) LOAD_INT(((x) & (FIXED_1-1)) * 100)
+
+static const char * const vmpressure_stall_str[] = {
+	[VMPRESSURE_STALL_SOME] = "some",
+	[VMPRESSURE_STALL_FULL] = "full",
+};
+
+/*
+ * A trigger fires once @threshold ns of stall accumulated within a
+ * @window ns long window, at most once per window.
+ */
+struct vmpressure_trigger {
+	struct list_head node;
+	enum vmpressure_stall_states state;
+	u64 threshold;
+	u64 window;
+	u64 win_start;
+	u64 win_total;
+	bool fired;
+	/* memcg triggers signal an eventfd, /proc ones wake up pollers */
+	struct eventfd_ctx *efd;
+	wait_queue_head_t wait;
+	int event;
+};
+
+static bool vmpressure_stall_ready;
+
+static inline u64 vmpressure_clock(void)
+{
+	return ktime_to_ns(ktime_get());
+}
+
+/* needs vmpr->stall_lock */
+static void vmpressure_stall_update(struct vmpressure *vmpr, u64 now)
+{
+	u64 delta = now - vmpr->stall_state_time;
+
+	if (vmpr->nr_stalled)
+		vmpr->stall_total[VMPRESSURE_STALL_SOME] += delta;
+	if (vmpr->nr_stalled >= num_online_cpus())
+		vmpr->stall_total[VMPRESSURE_STALL_FULL] += delta;
+	vmpr->stall_state_time = now;
+}
+
+/* needs vmpr->stall_lock */
+static void vmpressure_stall_triggers(struct vmpressure *vmpr, u64 now)
+{
+	struct vmpressure_trigger *t;
+
+	list_for_each_entry(t, &vmpr->stall_triggers, node) {
+		u64 total = vmpr->stall_total[t->state];
+
+		if (now - t->win_start >= t->window) {
+			t->win_start = now;
+			t->win_total = total;
+			t->fired = false;
+			continue;
+		}
+		if (t->fired || total - t->win_total < t->threshold)
+			continue;
+
+		t->fired = true;
+		if (t->efd) {
+			eventfd_signal(t->efd, 1);
+		} else {
+			t->event = 1;
+			wake_up_interruptible(&t->wait);
+		}
+	}
+}
+
+static unsigned long vmpressure_calc_avg(unsigned long avg, unsigned long exp,
+					 unsigned long pct)
+{
+	avg *= exp;
+	avg += pct * (FIXED_1 - exp);
+	avg += 1UL << (FSHIFT - 1);
+	return avg >> FSHIFT;
+}
+
+static void vmpressure_stall_avg_fn(struct work_struct *work)
+{
+	struct vmpressure *vmpr = container_of(to_delayed_work(work),
+					struct vmpressure, stall_avg_work);
+	u64 now = vmpressure_clock();
+	u64 period;
+	bool idle;
+	int s;
+
+	spin_lock(&vmpr->stall_lock);
+	vmpressure_stall_update(vmpr, now);
+	period = now - vmpr->stall_avg_time;
+	vmpr->stall_avg_time = now;
+
+	for (s = 0; s < VMPRESSURE_STALL_NR; s++) {
+		u64 delta = vmpr->stall_total[s] - vmpr->stall_avg_total[s];
+		unsigned long *avg = vmpr->stall_avg[s];
+		unsigned long pct = 0;
+
+		vmpr->stall_avg_total[s] = vmpr->stall_total[s];
+		if (period) {
+			delta = min(delta, period);
+			pct = div64_u64(delta * 100 * FIXED_1, period);
+		}
+		avg[0] = vmpressure_calc_avg(avg[0], STALL_EXP_10s, pct);
+		avg[1] = vmpressure_calc_avg(avg[1], STALL_EXP_60s, pct);
+		avg[2] = vmpressure_calc_avg(avg[2], STALL_EXP_300s, pct);
+	}
+
+	/* Stalls that are still going on count towards the triggers too */
+	vmpressure_stall_triggers(vmpr, now);
+
+	idle = !vmpr->nr_stalled && now - vmpr->stall_last > STALL_IDLE_NS;
+	if (idle) {
+		memset(vmpr->stall_avg, 0, sizeof(vmpr->stall_avg));
+		vmpr->stall_avg_running = false;
+	} else {
+		schedule_delayed_work(&vmpr->stall_avg_work, STALL_AVG_PERIOD);
+	}
+	spin_unlock(&vmpr->stall_lock);
+}
+
+static void vmpressure_stall_start(struct vmpressure *vmpr, u64 now)
+{
+	spin_lock(&vmpr->stall_lock);
+	vmpressure_stall_update(vmpr, now);
+	vmpr->nr_stalled++;
+	if (!vmpr->stall_avg_running) {
+		vmpr->stall_avg_running = true;
+		vmpr->stall_avg_time = now;
+		schedule_delayed_work(&vmpr->stall_avg_work, STALL_AVG_PERIOD);
+	}
+	spin_unlock(&vmpr->stall_lock);
+}
+
+static void vmpressure_stall_stop(struct vmpressure *vmpr, u64 now)
+{
+	spin_lock(&vmpr->stall_lock);
+	vmpressure_stall_update(vmpr, now);
+	vmpr->nr_stalled--;
+	vmpr->stall_last = now;
+	vmpressure_stall_triggers(vmpr, now);
+	spin_unlock(&vmpr->stall_lock);
+}
+
+/**
+ * vmpressure_stall_enter() - Mark the current task as stalled on memory
+ * @stall:	zero initialised state, to be passed to vmpressure_stall_leave()
+ *
+ * This function should be called before the current task enters direct
+ * reclaim, direct compaction or waits for a page to be swapped in.
+ */
+void vmpressure_stall_enter(struct vmpressure_stall *stall)
+{
+	u64 now = vmpressure_clock();
+
+	if (vmpressure_stall_ready) {
+		vmpressure_stall_start(&global_vmpressure, now);
+		stall->global = true;
+	}
+
+#ifdef CONFIG_CGROUP_MEM_RES_CTLR
+	if (!mem_cgroup_disabled()) {
+		struct vmpressure *vmpr;
+
+		rcu_read_lock();
+		stall->css = task_subsys_state(current, mem_cgroup_subsys_id);
+		if (!css_tryget(stall->css))
+			stall->css = NULL;
+		rcu_read_unlock();
+
+		for (vmpr = stall->css ? css_to_vmpressure(stall->css) : NULL;
+		     vmpr; vmpr = vmpressure_parent(vmpr))
+			vmpressure_stall_start(vmpr, now);
+	}
+#endif
+}
+
+/**
+ * vmpressure_stall_leave() - End a stall started by vmpressure_stall_enter()
+ * @stall:	state filled in by vmpressure_stall_enter()
+ *
+ * Calling this on a stall that was never entered does nothing.
+ */
+void vmpressure_stall_leave(struct vmpressure_stall *stall)
+{
+	u64 now = vmpressure_clock();
+
+	if (stall->global) {
+		vmpressure_stall_stop(&global_vmpressure, now);
+		stall->global = false;
+	}
+
+#ifdef CONFIG_CGROUP_MEM_RES_CTLR
+	if (stall->css) {
+		struct vmpressure *vmpr;
+
+		for (vmpr = css_to_vmpressure(stall->css); vmpr;
+		     vmpr = vmpressure_parent(vmpr))
+			vmpressure_stall_stop(vmpr, now);
+		css_put(stall->css);
+		stall->css = NULL;
+	}
+#endif
+}
+
+static void vmpressure_stall_show(struct seq_file *m, struct vmpressure *vmpr)
+{
+	unsigned long avg[VMPRESSURE_STALL_NR][3];
+	u64 total[VMPRESSURE_STALL_NR];
+	int s;
+
+	spin_lock(&vmpr->stall_lock);
+	vmpressure_stall_update(vmpr, vmpressure_clock());
+	memcpy(avg, vmpr->stall_avg, sizeof(avg));
+	memcpy(total, vmpr->stall_total, sizeof(total));
+	spin_unlock(&vmpr->stall_lock);
+
+	for (s = 0; s < VMPRESSURE_STALL_NR; s++)
+		seq_printf(m, "%s avg10=%lu.%02lu avg60=%lu.%02lu "
+			   "avg300=%lu.%02lu total=%llu\n",
+			   vmpressure_stall_str[s],
+			   LOAD_INT(avg[s][0]), LOAD_FRAC(avg[s][0]),
+			   LOAD_INT(avg[s][1]), LOAD_FRAC(avg[s][1]),
+			   LOAD_INT(avg[s][2]), LOAD_FRAC(avg[s][2]),
+			   div_u64(total[s], NSEC_PER_USEC));
+}
+
+/*
+ * Parse "<some|full> <stall us> <window us>" and attach a trigger for it
+ * to @vmpr.
+ */
+static struct vmpressure_trigger *
+vmpressure_trigger_add(struct vmpressure *vmpr, const char *buf,
+		       struct eventfd_ctx *efd)
+{
+	struct vmpressure_trigger *t;
+	unsigned int threshold_us, window_us;
+	int state;
+
+	if (sscanf(buf, "some %u %u", &threshold_us, &window_us) == 2)
+		state = VMPRESSURE_STALL_SOME;
+	else if (sscanf(buf, "full %u %u", &threshold_us, &window_us) == 2)
+		state = VMPRESSURE_STALL_FULL;
+	else
+		return ERR_PTR(-EINVAL);
+
+	if (window_us < STALL_WINDOW_MIN_US || window_us > STALL_WINDOW_MAX_US)
+		return ERR_PTR(-EINVAL);
+	if (!threshold_us || threshold_us > window_us)
+		return ERR_PTR(-EINVAL);
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return ERR_PTR(-ENOMEM);
+
+	t->state = state;
+	t->threshold = (u64)threshold_us * NSEC_PER_USEC;
+	t->window = (u64)window_us * NSEC_PER_USEC;
+	t->efd = efd;
+	init_waitqueue_head(&t->wait);
+
+	spin_lock(&vmpr->stall_lock);
+	t->win_start = vmpressure_clock();
+	vmpressure_stall_update(vmpr, t->win_start);
+	t->win_total = vmpr->stall_total[state];
+	list_add(&t->node, &vmpr->stall_triggers);
+	spin_unlock(&vmpr->stall_lock);
+
+	return t;
+}
+
+static void vmpressure_trigger_del(struct vmpressure *vmpr,
+				   struct vmpressure_trigger *t)
+{
+	spin_lock(&vmpr->stall_lock);
+	list_del(&t->node);
+	spin_unlock(&vmpr->stall_lock);
+	kfree(t);
+}
+
+#ifdef CONFIG_CGROUP_MEM_RES_CTLR
+/* memory.stall: the stall averages of a memcg */
+int vmpressure_stall_read(struct cgroup *cg, struct cftype *cft,
+			  struct seq_file *m)
+{
+	vmpressure_stall_show(m, cg_to_vmpressure(cg));
+	return 0;
+}
+
+/**
+ * vmpressure_stall_register_event() - Signal an eventfd on memcg stalls
+ * @cg:		cgroup that is interested in stall notifications
+ * @cft:	cgroup control files handle
+ * @eventfd:	eventfd context to link notifications with
+ * @args:	"<some|full> <stall us> <window us>"
+ *
+ * The @eventfd is signalled once the tasks of @cg were stalled for the
+ * given time within a window, at most once per window.
+ */
+int vmpressure_stall_register_event(struct cgroup *cg, struct cftype *cft,
+				    struct eventfd_ctx *eventfd,
+				    const char *args)
+{
+	struct vmpressure_trigger *t;
+
+	t = vmpressure_trigger_add(cg_to_vmpressure(cg), args, eventfd);
+	return IS_ERR(t) ? PTR_ERR(t) : 0;
+}
+
+void vmpressure_stall_unregister_event(struct cgroup *cg, struct cftype *cft,
+				       struct eventfd_ctx *eventfd)
+{
+	struct vmpressure *vmpr = cg_to_vmpressure(cg);
+	struct vmpressure_trigger *t, *found = NULL;
+
+	spin_lock(&vmpr->stall_lock);
+	list_for_each_entry(t, &vmpr->stall_triggers, node) {
+		if (t->efd == eventfd) {
+			found = t;
+			break;
+		}
+	}
+	spin_unlock(&vmpr->stall_lock);
+
+	if (found)
+		vmpressure_trigger_del(vmpr, found);
+}
+
+/**
+ * vmpressure_cleanup() - Stop the deferred work of a vmpressure structure
+ * @vmpr:	Structure to be cleaned up
+ *
+ * This function should be called before a vmpressure structure is freed.
+ */
+void vmpressure_cleanup(struct vmpressure *vmpr)
+{
+	flush_work(&vmpr->work);
+	cancel_delayed_work_sync(&vmpr->stall_avg_work);
+}
+#endif
+
+/* /proc/pressure/memory reports and triggers on system wide stalls */
+static DEFINE_MUTEX(vmpressure_trigger_lock);
+
+static int vmpressure_proc_show(struct seq_file *m, void *v)
+{
+	vmpressure_stall_show(m, &global_vmpressure);
+	return 0;
+}
+
+static int vmpressure_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vmpressure_proc_show, NULL);
+}
+
+static ssize_t vmpressure_proc_write(struct file *file, const char __user *ubuf,
+				     size_t count, loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	struct vmpressure_trigger *t;
+	char buf[32];
+	size_t len;
+
+	len = min(count, sizeof(buf) - 1);
+	if (copy_from_user(buf, ubuf, len))
+		return -EFAULT;
+	buf[len] = '\0';
+
+	mutex_lock(&vmpressure_trigger_lock);
+	/* One trigger per open file */
+	if (m->private) {
+		mutex_unlock(&vmpressure_trigger_lock);
+		return -EBUSY;
+	}
+	t = vmpressure_trigger_add(&global_vmpressure, strstrip(buf), NULL);
+	if (IS_ERR(t)) {
+		mutex_unlock(&vmpressure_trigger_lock);
+		return PTR_ERR(t);
+	}
+	m->private = t;
+	mutex_unlock(&vmpressure_trigger_lock);
+
+	return count;
+}
+
+static unsigned int vmpressure_proc_poll(struct file *file, poll_table *wait)
+{
+	struct seq_file *m = file->private_data;
+	struct vmpressure_trigger *t;
+	unsigned int ret = DEFAULT_POLLMASK;
+
+	mutex_lock(&vmpressure_trigger_lock);
+	t = m->private;
+	if (!t) {
+		mutex_unlock(&vmpressure_trigger_lock);
+		return ret | POLLERR | POLLPRI;
+	}
+	poll_wait(file, &t->wait, wait);
+	if (xchg(&t->event, 0))
+		ret |= POLLPRI;
+	mutex_unlock(&vmpressure_trigger_lock);
+
+	return ret;
+}
+
+static int vmpressure_proc_release(struct inode *inode, struct file *file)
+{
+	struct seq_file *m = file->private_data;
+
+	if (m->private)
+		vmpressure_trigger_del(&global_vmpressure, m->private);
+	return single_release(inode, file);
+}
+
+static const struct file_operations vmpressure_proc_fops = {
+	.open		= vmpressure_proc_open,
+	.read		= seq_read,
+	.write		= vmpressure_proc_write,
+	.poll		= vmpressure_proc_poll,
+	.llseek		= seq_lseek,
+	.release	= vmpressure_proc_release,
+};
+
 /**
  * vmpressure_register_event() - Bind vmpressure notifications to an eventfd
  * @cg:		cgroup that is interested in vmpressure notifications
@@ -480,11 +932,23 @@ void vmpressure_init(struct vmpressure *vmpr)
 	mutex_init(&vmpr->events_lock);
 	INIT_LIST_HEAD(&vmpr->events);
 	INIT_WORK(&vmpr->work, vmpressure_work_fn);
+	spin_lock_init(&vmpr->stall_lock);
+	INIT_LIST_HEAD(&vmpr->stall_triggers);
+	INIT_DELAYED_WORK_DEFERRABLE(&vmpr->stall_avg_work,
+				     vmpressure_stall_avg_fn);
 }
 
 int vmpressure_global_init(void)
 {
+	struct proc_dir_entry *dir;
+
 	vmpressure_init(&global_vmpressure);
+	vmpressure_stall_ready = true;
+
+	dir = proc_mkdir("pressure", NULL);
+	if (dir)
+		proc_create("memory", S_IRUGO | S_IWUSR, dir,
+			    &vmpressure_proc_fops);
 	return 0;
 }
 late_initcall(vmpressure_global_init);
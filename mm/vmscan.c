@@ -735,7 +735,12 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		struct address_space *mapping;
 		struct page *page;
 		int may_enter_fs;
-		enum page_references references = PAGEREF_RECLAIM_CLEAN;
+		/*
+		 * Forced reclaim only writes dirty pages out if the caller
+		 * allows writepage, as process reclaim does.
+		 */
+		enum page_references references = sc->may_writepage ?
+				PAGEREF_RECLAIM : PAGEREF_RECLAIM_CLEAN;
 
 		cond_resched();
 
@@ -1000,6 +1005,52 @@ unsigned long reclaim_clean_pages_from_list(struct zone *zone,
 	return ret;
 }
 
+#ifdef CONFIG_PROCESS_RECLAIM
+/*
+ * Reclaim the isolated pages on @page_list regardless of their age, on
+ * behalf of /proc/PID/reclaim. Pages that could not be reclaimed are
+ * put back on the LRU.
+ */
+unsigned long reclaim_pages_from_list(struct list_head *page_list)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.priority = DEF_PRIORITY,
+		.may_writepage = 1,
+		.may_unmap = 1,
+		.may_swap = 1,
+	};
+	unsigned long nr_reclaimed = 0;
+	unsigned long dummy1, dummy2;
+	struct page *page, *next;
+
+	while (!list_empty(page_list)) {
+		struct zone *zone = page_zone(lru_to_page(page_list));
+		LIST_HEAD(zone_pages);
+
+		/* shrink_page_list() expects pages of a single zone */
+		list_for_each_entry_safe(page, next, page_list, lru) {
+			if (page_zone(page) != zone)
+				continue;
+			ClearPageActive(page);
+			list_move(&page->lru, &zone_pages);
+		}
+
+		nr_reclaimed += shrink_page_list(&zone_pages, zone, &sc,
+					TTU_UNMAP|TTU_IGNORE_ACCESS,
+					&dummy1, &dummy2, true);
+
+		while (!list_empty(&zone_pages)) {
+			page = lru_to_page(&zone_pages);
+			list_del(&page->lru);
+			putback_lru_page(page);
+		}
+	}
+
+	return nr_reclaimed;
+}
+#endif
+
 /*
  * Attempt to remove the specified page from its LRU.  Only take this page
  * if it is of the appropriate PageActive status.  Pages which are being
@@ -782,6 +782,10 @@ const char * const vmstat_text[] = {
 #ifdef CONFIG_HUGETLB_PAGE
 	"htlb_buddy_alloc_success",
 	"htlb_buddy_alloc_fail",
+#endif
+#ifdef CONFIG_PCP_HIGH_ORDER
+	"pcp_high_order_hit",
+	"pcp_high_order_miss",
 #endif
 	"unevictable_pgs_culled",
 	"unevictable_pgs_scanned",
@@ -791,6 +795,16 @@ const char * const vmstat_text[] = {
 	"unevictable_pgs_cleared",
 	"unevictable_pgs_stranded",
 	"unevictable_pgs_mlockfreed",
+	"fork_lazy_pt",
+	"fork_lazy_pte",
+	"vmap_purge",
+	"vmap_purge_pages",
+	"vmap_purge_skipped",
+	"vmap_lock_contended",
+	"vmap_block_reused",
+	"splice_page_moved",
+	"splice_page_copied",
+	"pipe_grow",
 
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	"thp_fault_alloc",
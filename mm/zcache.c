@@ -0,0 +1,602 @@
+/*
+ * zcache.c - LZ4 compressed cleancache backend
+ *
+ * Clean page cache pages evicted by reclaim are compressed with LZ4 and
+ * kept in a zsmalloc pool, so a later read of the same file page is a
+ * decompression from RAM instead of a trip to storage.
+ *
+ * The pool is capped at max_pool_percent of RAM; when a new page does not
+ * fit, the least recently stored pages are dropped to make room.  Pages are
+ * dropped from zcache once they have been read back, since they are then
+ * in the page cache again.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/rbtree.h>
+#include <linux/list.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/cleancache.h>
+#include <linux/zsmalloc.h>
+#include <linux/lz4.h>
+
+#define ZCACHE_MAX_POOLS	32
+
+/* Pages that compress worse than this are not worth keeping */
+#define ZCACHE_MAX_COMPRESSED	(PAGE_SIZE * 3 / 4)
+
+/* Maximum percentage of RAM the compressed pool may use */
+static unsigned int zcache_max_pool_percent = 10;
+module_param_named(max_pool_percent, zcache_max_pool_percent, uint, 0644);
+
+/* Statistics, exported through /sys/kernel/debug/zcache */
+static u64 zcache_puts;
+static u64 zcache_stored_pages;
+static u64 zcache_hits;
+static u64 zcache_misses;
+static u64 zcache_evicted;
+static u64 zcache_invalidates;
+static u64 zcache_reject_compress_poor;
+static u64 zcache_reject_alloc_fail;
+static u64 zcache_pool_pages;
+
+/**
+ * struct zcache_entry - one compressed page
+ * @rbnode: link into the owning inode's tree of entries, keyed by @index
+ * @lru: link into zcache_lru, most recently stored at the tail
+ * @zinode: the inode this page belongs to
+ * @index: page offset within the file
+ * @handle: zsmalloc handle of the compressed data
+ * @length: length of the compressed data
+ */
+struct zcache_entry {
+	struct rb_node rbnode;
+	struct list_head lru;
+	struct zcache_inode *zinode;
+	pgoff_t index;
+	unsigned long handle;
+	unsigned int length;
+};
+
+/**
+ * struct zcache_inode - pages of one file held in zcache
+ * @rbnode: link into the pool's tree of inodes, keyed by @key
+ * @entries: tree of zcache_entry
+ * @key: cleancache file key
+ * @pool: the pool (filesystem) this file belongs to
+ */
+struct zcache_inode {
+	struct rb_node rbnode;
+	struct rb_root entries;
+	struct cleancache_filekey key;
+	struct zcache_pool *pool;
+};
+
+/**
+ * struct zcache_pool - per filesystem state
+ * @inodes: tree of zcache_inode
+ */
+struct zcache_pool {
+	struct rb_root inodes;
+};
+
+/*
+ * zcache_lock protects the pools, their trees and the LRU.  put_page is
+ * called from page cache removal with mapping->tree_lock held and
+ * interrupts disabled, so it is always taken with interrupts off.
+ */
+static DEFINE_SPINLOCK(zcache_lock);
+static struct zcache_pool *zcache_pools[ZCACHE_MAX_POOLS];
+static LIST_HEAD(zcache_lru);
+
+static struct zs_pool *zcache_zs_pool;
+static struct kmem_cache *zcache_entry_cache;
+static struct kmem_cache *zcache_inode_cache;
+
+static DEFINE_PER_CPU(unsigned char *, zcache_dstmem);
+static DEFINE_PER_CPU(void *, zcache_wrkmem);
+
+static unsigned long zcache_max_pool_pages(void)
+{
+	return totalram_pages * zcache_max_pool_percent / 100;
+}
+
+static void zcache_update_pool_pages(void)
+{
+	zcache_pool_pages = zs_get_total_size_bytes(zcache_zs_pool)
+				>> PAGE_SHIFT;
+}
+
+static struct zcache_inode *zcache_inode_find(struct zcache_pool *pool,
+					      struct cleancache_filekey *key)
+{
+	struct rb_node *node = pool->inodes.rb_node;
+	struct zcache_inode *zinode;
+	int cmp;
+
+	while (node) {
+		zinode = rb_entry(node, struct zcache_inode, rbnode);
+		cmp = memcmp(key, &zinode->key, sizeof(*key));
+		if (cmp < 0)
+			node = node->rb_left;
+		else if (cmp > 0)
+			node = node->rb_right;
+		else
+			return zinode;
+	}
+	return NULL;
+}
+
+static struct zcache_inode *zcache_inode_get(struct zcache_pool *pool,
+					     struct cleancache_filekey *key)
+{
+	struct rb_node **link = &pool->inodes.rb_node, *parent = NULL;
+	struct zcache_inode *zinode;
+	int cmp;
+
+	while (*link) {
+		parent = *link;
+		zinode = rb_entry(parent, struct zcache_inode, rbnode);
+		cmp = memcmp(key, &zinode->key, sizeof(*key));
+		if (cmp < 0)
+			link = &parent->rb_left;
+		else if (cmp > 0)
+			link = &parent->rb_right;
+		else
+			return zinode;
+	}
+
+	zinode = kmem_cache_alloc(zcache_inode_cache,
+				  GFP_ATOMIC | __GFP_NOWARN);
+	if (!zinode)
+		return NULL;
+	zinode->entries = RB_ROOT;
+	zinode->key = *key;
+	zinode->pool = pool;
+	rb_link_node(&zinode->rbnode, parent, link);
+	rb_insert_color(&zinode->rbnode, &pool->inodes);
+	return zinode;
+}
+
+static void zcache_inode_put(struct zcache_inode *zinode)
+{
+	if (!RB_EMPTY_ROOT(&zinode->entries))
+		return;
+	rb_erase(&zinode->rbnode, &zinode->pool->inodes);
+	kmem_cache_free(zcache_inode_cache, zinode);
+}
+
+static struct zcache_entry *zcache_entry_find(struct zcache_inode *zinode,
+					      pgoff_t index)
+{
+	struct rb_node *node = zinode->entries.rb_node;
+	struct zcache_entry *entry;
+
+	while (node) {
+		entry = rb_entry(node, struct zcache_entry, rbnode);
+		if (index < entry->index)
+			node = node->rb_left;
+		else if (index > entry->index)
+			node = node->rb_right;
+		else
+			return entry;
+	}
+	return NULL;
+}
+
+/* Link @entry into @zinode; the caller has removed any previous entry */
+static void zcache_entry_insert(struct zcache_inode *zinode,
+				struct zcache_entry *entry)
+{
+	struct rb_node **link = &zinode->entries.rb_node, *parent = NULL;
+	struct zcache_entry *cur;
+
+	while (*link) {
+		parent = *link;
+		cur = rb_entry(parent, struct zcache_entry, rbnode);
+		if (entry->index < cur->index)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	entry->zinode = zinode;
+	rb_link_node(&entry->rbnode, parent, link);
+	rb_insert_color(&entry->rbnode, &zinode->entries);
+	list_add_tail(&entry->lru, &zcache_lru);
+	zcache_stored_pages++;
+}
+
+/*
+ * Unlink and free @entry.  The zcache_inode is left for the caller to
+ * release with zcache_inode_put(), as it may be walking its tree.
+ */
+static void zcache_entry_free(struct zcache_entry *entry)
+{
+	rb_erase(&entry->rbnode, &entry->zinode->entries);
+	list_del(&entry->lru);
+	zs_free(zcache_zs_pool, entry->handle);
+	kmem_cache_free(zcache_entry_cache, entry);
+	zcache_stored_pages--;
+}
+
+/* Drop least recently stored pages until the pool is below its cap */
+static bool zcache_evict(void)
+{
+	unsigned long max_pages = zcache_max_pool_pages();
+	struct zcache_entry *entry;
+	struct zcache_inode *zinode;
+
+	while (zcache_pool_pages >= max_pages) {
+		if (list_empty(&zcache_lru))
+			return false;
+		entry = list_first_entry(&zcache_lru, struct zcache_entry, lru);
+		zinode = entry->zinode;
+		zcache_entry_free(entry);
+		zcache_inode_put(zinode);
+		zcache_evicted++;
+		zcache_update_pool_pages();
+	}
+	return true;
+}
+
+static int zcache_init_fs(size_t pagesize)
+{
+	struct zcache_pool *pool;
+	unsigned long flags;
+	int i;
+
+	if (pagesize != PAGE_SIZE)
+		return -1;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return -1;
+	pool->inodes = RB_ROOT;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	for (i = 0; i < ZCACHE_MAX_POOLS; i++) {
+		if (!zcache_pools[i]) {
+			zcache_pools[i] = pool;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&zcache_lock, flags);
+
+	if (i == ZCACHE_MAX_POOLS) {
+		kfree(pool);
+		return -1;
+	}
+	return i;
+}
+
+static int zcache_init_shared_fs(char *uuid, size_t pagesize)
+{
+	/* Nothing is shared across a cluster here: treat it as private */
+	return zcache_init_fs(pagesize);
+}
+
+static struct zcache_pool *zcache_get_pool(int pool_id)
+{
+	if (pool_id < 0 || pool_id >= ZCACHE_MAX_POOLS)
+		return NULL;
+	return zcache_pools[pool_id];
+}
+
+static void zcache_put_page(int pool_id, struct cleancache_filekey key,
+			    pgoff_t index, struct page *page)
+{
+	struct zcache_pool *pool;
+	struct zcache_inode *zinode;
+	struct zcache_entry *entry, *old;
+	unsigned char *src, *dst;
+	unsigned long handle, flags;
+	size_t dlen;
+	void *buf;
+	int ret;
+
+	zcache_puts++;
+
+	/* Compress into this cpu's buffer before taking the lock */
+	local_irq_save(flags);
+	dst = __get_cpu_var(zcache_dstmem);
+	src = kmap_atomic(page);
+	ret = lz4_compress(src, PAGE_SIZE, dst, &dlen,
+			   __get_cpu_var(zcache_wrkmem));
+	kunmap_atomic(src);
+	if (ret || dlen > ZCACHE_MAX_COMPRESSED) {
+		zcache_reject_compress_poor++;
+		goto invalidate;
+	}
+
+	spin_lock(&zcache_lock);
+	pool = zcache_get_pool(pool_id);
+	if (!pool)
+		goto unlock;
+
+	/* A page put again replaces what was stored for it */
+	zinode = zcache_inode_find(pool, &key);
+	if (zinode) {
+		old = zcache_entry_find(zinode, index);
+		if (old) {
+			zcache_entry_free(old);
+			zcache_inode_put(zinode);
+		}
+	}
+
+	if (!zcache_evict())
+		goto reject;
+
+	entry = kmem_cache_alloc(zcache_entry_cache, GFP_ATOMIC | __GFP_NOWARN);
+	if (!entry)
+		goto reject;
+	handle = zs_malloc(zcache_zs_pool, dlen);
+	if (!handle) {
+		kmem_cache_free(zcache_entry_cache, entry);
+		goto reject;
+	}
+	zinode = zcache_inode_get(pool, &key);
+	if (!zinode) {
+		zs_free(zcache_zs_pool, handle);
+		kmem_cache_free(zcache_entry_cache, entry);
+		goto reject;
+	}
+
+	buf = zs_map_object(zcache_zs_pool, handle, ZS_MM_WO);
+	memcpy(buf, dst, dlen);
+	zs_unmap_object(zcache_zs_pool, handle);
+
+	entry->index = index;
+	entry->handle = handle;
+	entry->length = dlen;
+	zcache_entry_insert(zinode, entry);
+	zcache_update_pool_pages();
+	spin_unlock_irqrestore(&zcache_lock, flags);
+	return;
+
+reject:
+	zcache_reject_alloc_fail++;
+unlock:
+	spin_unlock_irqrestore(&zcache_lock, flags);
+	return;
+
+invalidate:
+	/* Don't leave a stale copy behind for a page that was not stored */
+	spin_lock(&zcache_lock);
+	pool = zcache_get_pool(pool_id);
+	zinode = pool ? zcache_inode_find(pool, &key) : NULL;
+	if (zinode) {
+		old = zcache_entry_find(zinode, index);
+		if (old) {
+			zcache_entry_free(old);
+			zcache_inode_put(zinode);
+		}
+	}
+	spin_unlock_irqrestore(&zcache_lock, flags);
+}
+
+static int zcache_get_page(int pool_id, struct cleancache_filekey key,
+			   pgoff_t index, struct page *page)
+{
+	struct zcache_pool *pool;
+	struct zcache_inode *zinode;
+	struct zcache_entry *entry = NULL;
+	unsigned char *src, *dst;
+	unsigned long flags;
+	size_t dlen = PAGE_SIZE;
+	int ret;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	pool = zcache_get_pool(pool_id);
+	zinode = pool ? zcache_inode_find(pool, &key) : NULL;
+	if (zinode)
+		entry = zcache_entry_find(zinode, index);
+	if (!entry) {
+		zcache_misses++;
+		spin_unlock_irqrestore(&zcache_lock, flags);
+		return -1;
+	}
+
+	src = zs_map_object(zcache_zs_pool, entry->handle, ZS_MM_RO);
+	dst = kmap_atomic(page);
+	ret = lz4_decompress_unknownoutputsize(src, entry->length, dst, &dlen);
+	kunmap_atomic(dst);
+	zs_unmap_object(zcache_zs_pool, entry->handle);
+
+	/* The page is back in the page cache: no need to keep a copy */
+	zcache_entry_free(entry);
+	zcache_inode_put(zinode);
+	zcache_update_pool_pages();
+
+	if (ret || dlen != PAGE_SIZE) {
+		zcache_misses++;
+		spin_unlock_irqrestore(&zcache_lock, flags);
+		pr_err("zcache: decompression failed for index %lu\n",
+		       (unsigned long)index);
+		return -1;
+	}
+	zcache_hits++;
+	spin_unlock_irqrestore(&zcache_lock, flags);
+	return 0;
+}
+
+static void zcache_invalidate_page(int pool_id, struct cleancache_filekey key,
+				   pgoff_t index)
+{
+	struct zcache_pool *pool;
+	struct zcache_inode *zinode;
+	struct zcache_entry *entry;
+	unsigned long flags;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	pool = zcache_get_pool(pool_id);
+	zinode = pool ? zcache_inode_find(pool, &key) : NULL;
+	if (zinode) {
+		entry = zcache_entry_find(zinode, index);
+		if (entry) {
+			zcache_entry_free(entry);
+			zcache_inode_put(zinode);
+			zcache_invalidates++;
+			zcache_update_pool_pages();
+		}
+	}
+	spin_unlock_irqrestore(&zcache_lock, flags);
+}
+
+/* Free every entry of @zinode and @zinode itself; zcache_lock held */
+static void zcache_inode_free(struct zcache_inode *zinode)
+{
+	struct rb_node *node;
+
+	while ((node = rb_first(&zinode->entries))) {
+		zcache_entry_free(rb_entry(node, struct zcache_entry, rbnode));
+		zcache_invalidates++;
+	}
+	zcache_inode_put(zinode);
+}
+
+static void zcache_invalidate_inode(int pool_id, struct cleancache_filekey key)
+{
+	struct zcache_pool *pool;
+	struct zcache_inode *zinode;
+	unsigned long flags;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	pool = zcache_get_pool(pool_id);
+	zinode = pool ? zcache_inode_find(pool, &key) : NULL;
+	if (zinode) {
+		zcache_inode_free(zinode);
+		zcache_update_pool_pages();
+	}
+	spin_unlock_irqrestore(&zcache_lock, flags);
+}
+
+static void zcache_invalidate_fs(int pool_id)
+{
+	struct zcache_pool *pool;
+	struct rb_node *node;
+	unsigned long flags;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	pool = zcache_get_pool(pool_id);
+	if (!pool) {
+		spin_unlock_irqrestore(&zcache_lock, flags);
+		return;
+	}
+	while ((node = rb_first(&pool->inodes)))
+		zcache_inode_free(rb_entry(node, struct zcache_inode, rbnode));
+	zcache_pools[pool_id] = NULL;
+	zcache_update_pool_pages();
+	spin_unlock_irqrestore(&zcache_lock, flags);
+
+	kfree(pool);
+}
+
+static struct cleancache_ops zcache_ops = {
+	.init_fs = zcache_init_fs,
+	.init_shared_fs = zcache_init_shared_fs,
+	.get_page = zcache_get_page,
+	.put_page = zcache_put_page,
+	.invalidate_page = zcache_invalidate_page,
+	.invalidate_inode = zcache_invalidate_inode,
+	.invalidate_fs = zcache_invalidate_fs,
+};
+
+#ifdef CONFIG_DEBUG_FS
+static int __init zcache_debugfs_init(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("zcache", NULL);
+	if (!root)
+		return -ENOMEM;
+
+	debugfs_create_u64("puts", S_IRUGO, root, &zcache_puts);
+	debugfs_create_u64("stored_pages", S_IRUGO, root,
+			   &zcache_stored_pages);
+	debugfs_create_u64("pool_pages", S_IRUGO, root, &zcache_pool_pages);
+	debugfs_create_u64("hits", S_IRUGO, root, &zcache_hits);
+	debugfs_create_u64("misses", S_IRUGO, root, &zcache_misses);
+	debugfs_create_u64("evicted", S_IRUGO, root, &zcache_evicted);
+	debugfs_create_u64("invalidates", S_IRUGO, root, &zcache_invalidates);
+	debugfs_create_u64("reject_compress_poor", S_IRUGO, root,
+			   &zcache_reject_compress_poor);
+	debugfs_create_u64("reject_alloc_fail", S_IRUGO, root,
+			   &zcache_reject_alloc_fail);
+	return 0;
+}
+#else
+static int __init zcache_debugfs_init(void)
+{
+	return 0;
+}
+#endif
+
+static void zcache_free_percpu(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		kfree(per_cpu(zcache_dstmem, cpu));
+		kfree(per_cpu(zcache_wrkmem, cpu));
+		per_cpu(zcache_dstmem, cpu) = NULL;
+		per_cpu(zcache_wrkmem, cpu) = NULL;
+	}
+}
+
+static int __init zcache_alloc_percpu(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		per_cpu(zcache_dstmem, cpu) = kmalloc(
+				lz4_compressbound(PAGE_SIZE), GFP_KERNEL);
+		per_cpu(zcache_wrkmem, cpu) = kmalloc(LZ4_MEM_COMPRESS,
+						      GFP_KERNEL);
+		if (!per_cpu(zcache_dstmem, cpu) ||
+		    !per_cpu(zcache_wrkmem, cpu)) {
+			zcache_free_percpu();
+			return -ENOMEM;
+		}
+	}
+	return 0;
+}
+
+static int __init zcache_init(void)
+{
+	zcache_entry_cache = KMEM_CACHE(zcache_entry, 0);
+	zcache_inode_cache = KMEM_CACHE(zcache_inode, 0);
+	if (!zcache_entry_cache || !zcache_inode_cache)
+		goto fail;
+
+	zcache_zs_pool = zs_create_pool("zcache", __GFP_NORETRY | __GFP_NOWARN |
+					__GFP_NOMEMALLOC | __GFP_HIGHMEM);
+	if (!zcache_zs_pool)
+		goto fail;
+
+	if (zcache_alloc_percpu())
+		goto fail_pool;
+
+	cleancache_register_ops(&zcache_ops);
+	zcache_debugfs_init();
+	pr_info("zcache: cleancache enabled, lz4 compressed, %u%% cap\n",
+		zcache_max_pool_percent);
+	return 0;
+
+fail_pool:
+	zs_destroy_pool(zcache_zs_pool);
+fail:
+	if (zcache_inode_cache)
+		kmem_cache_destroy(zcache_inode_cache);
+	if (zcache_entry_cache)
+		kmem_cache_destroy(zcache_entry_cache);
+	pr_err("zcache: initialization failed\n");
+	return -ENOMEM;
+}
+module_init(zcache_init);
@@ -56,6 +56,7 @@
 #include <net/sock.h>
 #include <net/tcp_states.h>
 #include <trace/events/skb.h>
+#include <trace/events/sock.h>
 
 /*
  *	Is a socket 'connection oriented' ?
@@ -263,6 +264,9 @@ EXPORT_SYMBOL(skb_recv_datagram);
 
 void skb_free_datagram(struct sock *sk, struct sk_buff *skb)
 {
+	/* Not a MSG_PEEK reference: the reader is done with it */
+	if (atomic_read(&skb->users) == 1)
+		trace_sock_rcvqueue_dequeue(sk, skb);
 	consume_skb(skb);
 	sk_mem_reclaim_partial(sk);
 }
@@ -277,6 +281,7 @@ void skb_free_datagram_locked(struct sock *sk, struct sk_buff *skb)
 	else if (likely(!atomic_dec_and_test(&skb->users)))
 		return;
 
+	trace_sock_rcvqueue_dequeue(sk, skb);
 	slow = lock_sock_fast(sk);
 	skb_orphan(skb);
 	sk_mem_reclaim_partial(sk);
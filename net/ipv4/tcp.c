@@ -280,6 +280,8 @@
 #include <net/netdma.h>
 #include <net/sock.h>
 
+#include <trace/events/sock.h>
+
 #include <asm/uaccess.h>
 #include <asm/ioctls.h>
 
@@ -1746,6 +1748,7 @@ skip_copy:
 		if (tcp_hdr(skb)->fin)
 			goto found_fin_ok;
 		if (!(flags & MSG_PEEK)) {
+			trace_sock_rcvqueue_dequeue(sk, skb);
 			sk_eat_skb(sk, skb, copied_early);
 			copied_early = 0;
 		}
@@ -1755,6 +1758,7 @@ skip_copy:
 		/* Process the FIN. */
 		++*seq;
 		if (!(flags & MSG_PEEK)) {
+			trace_sock_rcvqueue_dequeue(sk, skb);
 			sk_eat_skb(sk, skb, copied_early);
 			copied_early = 0;
 		}
@@ -2540,6 +2544,10 @@ void tcp_get_info(const struct sock *sk, struct tcp_info *info)
 
 	info->tcpi_total_retrans = tp->total_retrans;
 
+	info->tcpi_pacing_rate = tp->pacing_rate;
+	if (icsk->icsk_ca_ops && icsk->icsk_ca_ops->get_tcp_info)
+		icsk->icsk_ca_ops->get_tcp_info(sk, info);
+
 	if (sk->sk_socket) {
 		struct file *filep = sk->sk_socket->file;
 		if (filep)
@@ -0,0 +1,405 @@
+/*
+ * TCP BBR: model based congestion control
+ *
+ * Rather than reacting to loss, BBR keeps an explicit model of the path:
+ * the bottleneck bandwidth (the maximum delivery rate seen over the last
+ * few round trips) and the propagation RTT (the minimum RTT seen over the
+ * last ten seconds).  The sender paces at a gain times the bandwidth and
+ * keeps about two bandwidth-delay products in flight, so it neither fills
+ * deep buffers on cellular links nor collapses on random loss.
+ *
+ * The state machine follows the published algorithm:
+ *
+ *   STARTUP    grow quickly until the bandwidth stops growing by 25% for
+ *              three rounds, i.e. the pipe is full
+ *   DRAIN      pace below the bandwidth to empty the queue STARTUP built
+ *   PROBE_BW   cycle the pacing gain through 1.25, 0.75, 1, 1, ... one
+ *              round per phase, to probe for more bandwidth
+ *   PROBE_RTT  if the min RTT has not been refreshed for ten seconds, drop
+ *              to four packets in flight for 200ms to measure it again
+ *
+ * This kernel has no per-packet delivery rate sampling, so the bandwidth
+ * is sampled once per round trip as the data acked during the round over
+ * the duration of the round.
+ *
+ * Pacing is done by tcp_output.c on tp->pacing_rate.
+ */
+
+#include <linux/module.h>
+#include <linux/random.h>
+#include <net/tcp.h>
+
+/* Bandwidth is in packets per usec, scaled by BW_UNIT */
+#define BW_SCALE	24
+#define BW_UNIT		(1 << BW_SCALE)
+
+/* Gains are scaled by BBR_UNIT */
+#define BBR_SCALE	8
+#define BBR_UNIT	(1 << BBR_SCALE)
+
+/* Rounds per half of the max bandwidth filter window */
+#define BBR_BW_EPOCH	5
+
+#define BBR_CYCLE_LEN	8
+#define BBR_CWND_MIN	4
+
+enum bbr_mode {
+	BBR_STARTUP,
+	BBR_DRAIN,
+	BBR_PROBE_BW,
+	BBR_PROBE_RTT,
+};
+
+/* 2/ln(2), the smallest gain that doubles the sending rate every round */
+static const int bbr_high_gain = BBR_UNIT * 2885 / 1000 + 1;
+static const int bbr_drain_gain = BBR_UNIT * 1000 / 2885;
+static const int bbr_cwnd_gain = BBR_UNIT * 2;
+static const int bbr_pacing_gain[BBR_CYCLE_LEN] = {
+	BBR_UNIT * 5 / 4,
+	BBR_UNIT * 3 / 4,
+	BBR_UNIT, BBR_UNIT, BBR_UNIT, BBR_UNIT, BBR_UNIT, BBR_UNIT,
+};
+
+static int min_rtt_win_sec __read_mostly = 10;
+static int probe_rtt_mode_ms __read_mostly = 200;
+static int pacing __read_mostly = 1;
+
+module_param(min_rtt_win_sec, int, 0644);
+MODULE_PARM_DESC(min_rtt_win_sec, "min RTT filter window (seconds)");
+module_param(probe_rtt_mode_ms, int, 0644);
+MODULE_PARM_DESC(probe_rtt_mode_ms, "time spent in PROBE_RTT (msec)");
+module_param(pacing, int, 0644);
+MODULE_PARM_DESC(pacing, "pace transmissions at the modelled rate");
+
+/* BBR congestion control block, must fit in ICSK_CA_PRIV_SIZE */
+struct bbr {
+	u32	min_rtt_us;		/* min RTT over the filter window */
+	u32	min_rtt_stamp;		/* jiffies at which min_rtt_us was taken */
+	u32	probe_rtt_done_stamp;	/* end of PROBE_RTT, 0 if not started */
+	u32	bw[2];			/* max bw of this and the previous epoch */
+	u32	full_bw;		/* bw at the last full pipe check reset */
+	u32	round_seq;		/* snd_nxt when the current round began */
+	u32	round_start_us;		/* time the current round began */
+	u32	round_delivered;	/* packets acked in the current round */
+	u32	round_count;		/* rounds since init */
+	u16	acked;			/* packets acked by the latest ACK */
+	u8	mode;			/* enum bbr_mode */
+	u8	cycle_idx:3,		/* PROBE_BW pacing gain phase */
+		full_bw_cnt:2,		/* rounds without bandwidth growth */
+		full_bw_reached:1,	/* the pipe has been filled once */
+		probe_rtt_round_done:1,	/* a round passed in PROBE_RTT */
+		unused:1;
+};
+
+static inline u32 bbr_now_us(void)
+{
+	return (u32)ktime_to_us(ktime_get());
+}
+
+static u32 bbr_max_bw(const struct bbr *bbr)
+{
+	return max(bbr->bw[0], bbr->bw[1]);
+}
+
+/* Convert a bandwidth to bytes per second, with a gain applied */
+static u64 bbr_rate_bytes_per_sec(const struct sock *sk, u32 bw, int gain)
+{
+	u64 rate = bw;
+
+	rate *= tcp_sk(sk)->mss_cache;
+	rate *= gain;
+	rate >>= BBR_SCALE;
+	rate *= USEC_PER_SEC;
+	return rate >> BW_SCALE;
+}
+
+/* Packets in flight that keep the pipe full, with a gain applied */
+static u32 bbr_target_cwnd(const struct bbr *bbr, u32 bw, int gain)
+{
+	u64 w;
+
+	if (bbr->min_rtt_us == ~0U)
+		return TCP_INIT_CWND;
+
+	w = (u64)bw * bbr->min_rtt_us;
+	w = (w * gain) >> BBR_SCALE;
+	/* Round up, and leave room for delayed and stretched ACKs */
+	return (u32)((w + BW_UNIT - 1) >> BW_SCALE) + 3;
+}
+
+static int bbr_pacing_gain_now(const struct bbr *bbr)
+{
+	switch (bbr->mode) {
+	case BBR_STARTUP:
+		return bbr_high_gain;
+	case BBR_DRAIN:
+		return bbr_drain_gain;
+	case BBR_PROBE_BW:
+		return bbr_pacing_gain[bbr->cycle_idx];
+	default:
+		return BBR_UNIT;
+	}
+}
+
+static void bbr_set_pacing_rate(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	int gain = bbr_pacing_gain_now(bbr);
+	u32 bw = bbr_max_bw(bbr);
+	u64 rate;
+
+	if (!pacing) {
+		tp->pacing_rate = 0;
+		return;
+	}
+
+	if (bw) {
+		rate = bbr_rate_bytes_per_sec(sk, bw, gain);
+	} else if (tp->srtt) {
+		/* No model yet, pace the initial window over one RTT */
+		rate = (u64)tp->snd_cwnd * tp->mss_cache * USEC_PER_SEC;
+		do_div(rate, jiffies_to_usecs(tp->srtt >> 3) ? : 1);
+		rate = (rate * bbr_high_gain) >> BBR_SCALE;
+	} else {
+		return;
+	}
+
+	/* Until the pipe is full, never slow down on a low sample */
+	if (!bbr->full_bw_reached && rate < tp->pacing_rate)
+		return;
+	tp->pacing_rate = min_t(u64, rate, ~0U);
+}
+
+/* Returns true at the start of a new round trip */
+static bool bbr_update_bw(struct sock *sk, u32 num_acked)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 now = bbr_now_us();
+	u32 elapsed;
+	u64 bw;
+
+	bbr->round_delivered += num_acked;
+	if (before(tp->snd_una, bbr->round_seq))
+		return false;
+
+	elapsed = now - bbr->round_start_us;
+	if (elapsed && bbr->round_delivered) {
+		bw = (u64)bbr->round_delivered << BW_SCALE;
+		do_div(bw, elapsed);
+		if (!(bbr->round_count % BBR_BW_EPOCH)) {
+			bbr->bw[1] = bbr->bw[0];
+			bbr->bw[0] = 0;
+		}
+		bbr->bw[0] = max_t(u32, bbr->bw[0], min_t(u64, bw, ~0U));
+	}
+
+	bbr->round_count++;
+	bbr->round_seq = tp->snd_nxt;
+	bbr->round_start_us = now;
+	bbr->round_delivered = 0;
+	return true;
+}
+
+static void bbr_check_full_bw_reached(struct bbr *bbr)
+{
+	u32 bw = bbr_max_bw(bbr);
+
+	if (bbr->full_bw_reached)
+		return;
+
+	if ((u64)bw * 4 >= (u64)bbr->full_bw * 5) {
+		bbr->full_bw = bw;
+		bbr->full_bw_cnt = 0;
+		return;
+	}
+	if (++bbr->full_bw_cnt >= 3)
+		bbr->full_bw_reached = 1;
+}
+
+static void bbr_enter_probe_bw(struct bbr *bbr)
+{
+	bbr->mode = BBR_PROBE_BW;
+	/* Start anywhere but the draining phase */
+	bbr->cycle_idx = BBR_CYCLE_LEN - 1 - net_random() % (BBR_CYCLE_LEN - 1);
+}
+
+static void bbr_update_min_rtt(struct sock *sk, s32 rtt_us, bool round_start)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	bool expired;
+
+	expired = after(tcp_time_stamp,
+			bbr->min_rtt_stamp + min_rtt_win_sec * HZ);
+	if (rtt_us > 0 && ((u32)rtt_us <= bbr->min_rtt_us || expired)) {
+		bbr->min_rtt_us = rtt_us;
+		bbr->min_rtt_stamp = tcp_time_stamp;
+	}
+
+	if (expired && probe_rtt_mode_ms > 0 && bbr->mode != BBR_PROBE_RTT) {
+		bbr->mode = BBR_PROBE_RTT;
+		bbr->probe_rtt_done_stamp = 0;
+	}
+
+	if (bbr->mode != BBR_PROBE_RTT)
+		return;
+
+	if (!bbr->probe_rtt_done_stamp) {
+		if (tcp_packets_in_flight(tp) <= BBR_CWND_MIN) {
+			bbr->probe_rtt_done_stamp = (tcp_time_stamp +
+				msecs_to_jiffies(probe_rtt_mode_ms)) | 1;
+			bbr->probe_rtt_round_done = 0;
+		}
+		return;
+	}
+
+	if (round_start)
+		bbr->probe_rtt_round_done = 1;
+	if (bbr->probe_rtt_round_done &&
+	    after(tcp_time_stamp, bbr->probe_rtt_done_stamp)) {
+		bbr->min_rtt_stamp = tcp_time_stamp;
+		if (bbr->full_bw_reached)
+			bbr_enter_probe_bw(bbr);
+		else
+			bbr->mode = BBR_STARTUP;
+	}
+}
+
+static void bbr_update_mode(struct sock *sk, bool round_start)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	if (bbr->mode == BBR_STARTUP && bbr->full_bw_reached)
+		bbr->mode = BBR_DRAIN;
+
+	if (bbr->mode == BBR_DRAIN &&
+	    tcp_packets_in_flight(tp) <=
+	    bbr_target_cwnd(bbr, bbr_max_bw(bbr), BBR_UNIT))
+		bbr_enter_probe_bw(bbr);
+	else if (bbr->mode == BBR_PROBE_BW && round_start)
+		bbr->cycle_idx = (bbr->cycle_idx + 1) % BBR_CYCLE_LEN;
+}
+
+static void bbr_pkts_acked(struct sock *sk, u32 num_acked, s32 rtt_us)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+	bool round_start;
+
+	bbr->acked = min_t(u32, num_acked, 0xffff);
+
+	round_start = bbr_update_bw(sk, num_acked);
+	if (round_start)
+		bbr_check_full_bw_reached(bbr);
+	bbr_update_min_rtt(sk, rtt_us, round_start);
+	bbr_update_mode(sk, round_start);
+	bbr_set_pacing_rate(sk);
+}
+
+static void bbr_cong_avoid(struct sock *sk, u32 ack, u32 in_flight)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 bw = bbr_max_bw(bbr);
+	u32 cwnd, target;
+	int gain;
+
+	/* Behave like Reno until there is a model to work from */
+	if (!bw || bbr->min_rtt_us == ~0U) {
+		tcp_reno_cong_avoid(sk, ack, in_flight);
+		return;
+	}
+
+	gain = bbr->mode == BBR_STARTUP ? bbr_high_gain : bbr_cwnd_gain;
+	target = bbr_target_cwnd(bbr, bw, gain);
+	cwnd = tp->snd_cwnd;
+
+	if (bbr->full_bw_reached)
+		cwnd = min(cwnd + bbr->acked, target);
+	else if (cwnd < target)
+		cwnd += bbr->acked;
+	bbr->acked = 0;
+
+	cwnd = max_t(u32, cwnd, BBR_CWND_MIN);
+	if (bbr->mode == BBR_PROBE_RTT)
+		cwnd = min_t(u32, cwnd, BBR_CWND_MIN);
+	tp->snd_cwnd = min(cwnd, tp->snd_cwnd_clamp);
+}
+
+/*
+ * Loss is not a congestion signal for BBR; keep the window and let the
+ * model bound how much is in flight.
+ */
+static u32 bbr_ssthresh(struct sock *sk)
+{
+	return max_t(u32, tcp_sk(sk)->snd_cwnd, BBR_CWND_MIN);
+}
+
+static u32 bbr_undo_cwnd(struct sock *sk)
+{
+	return tcp_sk(sk)->snd_cwnd;
+}
+
+static void bbr_init(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	memset(bbr, 0, sizeof(*bbr));
+	bbr->min_rtt_us = ~0U;
+	bbr->min_rtt_stamp = tcp_time_stamp;
+	bbr->round_seq = tp->snd_nxt;
+	bbr->round_start_us = bbr_now_us();
+	bbr->mode = BBR_STARTUP;
+	tp->snd_ssthresh = TCP_INFINITE_SSTHRESH;
+	tp->pacing_rate = 0;
+	bbr_set_pacing_rate(sk);
+}
+
+static void bbr_release(struct sock *sk)
+{
+	tcp_sk(sk)->pacing_rate = 0;
+}
+
+static void bbr_get_tcp_info(const struct sock *sk, struct tcp_info *info)
+{
+	const struct bbr *bbr = inet_csk_ca(sk);
+
+	info->tcpi_delivery_rate = bbr_rate_bytes_per_sec(sk,
+					bbr_max_bw(bbr), BBR_UNIT);
+	if (bbr->min_rtt_us != ~0U)
+		info->tcpi_min_rtt = bbr->min_rtt_us;
+}
+
+static struct tcp_congestion_ops tcp_bbr __read_mostly = {
+	.flags		= TCP_CONG_RTT_STAMP,
+	.init		= bbr_init,
+	.release	= bbr_release,
+	.ssthresh	= bbr_ssthresh,
+	.cong_avoid	= bbr_cong_avoid,
+	.undo_cwnd	= bbr_undo_cwnd,
+	.pkts_acked	= bbr_pkts_acked,
+	.get_tcp_info	= bbr_get_tcp_info,
+
+	.owner		= THIS_MODULE,
+	.name		= "bbr",
+};
+
+static int __init bbr_register(void)
+{
+	BUILD_BUG_ON(sizeof(struct bbr) > ICSK_CA_PRIV_SIZE);
+	return tcp_register_congestion_control(&tcp_bbr);
+}
+
+static void __exit bbr_unregister(void)
+{
+	tcp_unregister_congestion_control(&tcp_bbr);
+}
+
+module_init(bbr_register);
+module_exit(bbr_unregister);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("TCP BBR (Bottleneck Bandwidth and RTT)");
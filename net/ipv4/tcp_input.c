@@ -75,6 +75,7 @@
 #include <linux/ipsec.h>
 #include <asm/unaligned.h>
 #include <net/netdma.h>
+#include <trace/events/sock.h>
 
 int sysctl_tcp_timestamps __read_mostly = 1;
 int sysctl_tcp_window_scaling __read_mostly = 1;
@@ -100,6 +101,7 @@ int sysctl_tcp_frto_response __read_mostly;
 int sysctl_tcp_nometrics_save __read_mostly;
 
 int sysctl_tcp_thin_dupack __read_mostly;
+int sysctl_tcp_recovery __read_mostly = TCP_RACK_LOSS_DETECTION;
 
 int sysctl_tcp_moderate_rcvbuf __read_mostly = 1;
 int sysctl_tcp_abc __read_mostly;
@@ -1030,6 +1032,64 @@ static void tcp_skb_mark_lost_uncond_verify(struct tcp_sock *tp,
 	}
 }
 
+/* RACK: remember the send time of the most recently sent skb that has
+ * been delivered, either cumulatively acked or SACKed.
+ */
+static void tcp_rack_advance(struct tcp_sock *tp, u8 sacked, u32 xmit_time)
+{
+	/* A delivery reported sooner than an RTT after a retransmission
+	 * is most likely for the original transmission.
+	 */
+	if ((sacked & TCPCB_RETRANS) &&
+	    (s32)(tcp_time_stamp - xmit_time) < (s32)(tp->srtt >> 3))
+		return;
+
+	if (!tp->rack.advanced || after(xmit_time, tp->rack.xmit_time)) {
+		tp->rack.xmit_time = xmit_time;
+		tp->rack.advanced = 1;
+	}
+}
+
+/* RACK: an skb that was sent more than a reordering window before one
+ * that has already been delivered is lost; there is no need to wait for
+ * enough duplicate ACKs to pile up.
+ */
+static void tcp_rack_mark_lost(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct sk_buff *skb;
+	u32 reo_wnd;
+	int lost = 0;
+
+	if (!(sysctl_tcp_recovery & TCP_RACK_LOSS_DETECTION) ||
+	    !tp->rack.advanced || !tcp_is_sack(tp))
+		return;
+	tp->rack.advanced = 0;
+
+	/* A quarter of the RTT, srtt being stored << 3 */
+	reo_wnd = max_t(u32, tp->srtt >> 5, 1);
+
+	tcp_for_write_queue(skb, sk) {
+		struct tcp_skb_cb *scb = TCP_SKB_CB(skb);
+
+		if (skb == tcp_send_head(sk))
+			break;
+		if (scb->sacked & (TCPCB_SACKED_ACKED | TCPCB_LOST))
+			continue;
+		/* Unmarked skbs are in send order: stop at the first
+		 * one still inside the reordering window.
+		 */
+		if (!after(tp->rack.xmit_time, scb->when + reo_wnd))
+			break;
+
+		tcp_skb_mark_lost(tp, skb);
+		lost += tcp_skb_pcount(skb);
+	}
+
+	if (lost)
+		NET_ADD_STATS_BH(sock_net(sk), LINUX_MIB_TCPRACKLOST, lost);
+}
+
 /* This procedure tags the retransmission queue when SACKs arrive.
  *
  * We have three tag bits: SACKED(S), RETRANS(R) and LOST(L).
@@ -1323,7 +1383,7 @@ static int tcp_match_skb_to_sack(struct sock *sk, struct sk_buff *skb,
 static u8 tcp_sacktag_one(struct sock *sk,
 			  struct tcp_sacktag_state *state, u8 sacked,
 			  u32 start_seq, u32 end_seq,
-			  int dup_sack, int pcount)
+			  int dup_sack, int pcount, u32 xmit_time)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
 	int fack_count = state->fack_count;
@@ -1342,6 +1402,8 @@ static u8 tcp_sacktag_one(struct sock *sk,
 		return sacked;
 
 	if (!(sacked & TCPCB_SACKED_ACKED)) {
+		tcp_rack_advance(tp, sacked, xmit_time);
+
 		if (sacked & TCPCB_SACKED_RETRANS) {
 			/* If the segment is not tagged as lost,
 			 * we do not clear RETRANS, believing
@@ -1422,7 +1484,8 @@ static int tcp_shifted_skb(struct sock *sk, struct sk_buff *skb,
 	 * tcp_highest_sack_seq() when skb is highest_sack.
 	 */
 	tcp_sacktag_one(sk, state, TCP_SKB_CB(skb)->sacked,
-			start_seq, end_seq, dup_sack, pcount);
+			start_seq, end_seq, dup_sack, pcount,
+			TCP_SKB_CB(skb)->when);
 
 	if (skb == tp->lost_skb_hint)
 		tp->lost_cnt_hint += pcount;
@@ -1701,7 +1764,8 @@ static struct sk_buff *tcp_sacktag_walk(struct sk_buff *skb, struct sock *sk,
 						TCP_SKB_CB(skb)->seq,
 						TCP_SKB_CB(skb)->end_seq,
 						dup_sack,
-						tcp_skb_pcount(skb));
+						tcp_skb_pcount(skb),
+						TCP_SKB_CB(skb)->when);
 
 			if (!before(TCP_SKB_CB(skb)->seq,
 				    tcp_highest_sack_seq(tp)))
@@ -3102,6 +3166,10 @@ static void tcp_fastretrans_alert(struct sock *sk, int pkts_acked,
 		}
 	}
 
+	/* Time based loss marking, not while the RTO recovery is running */
+	if (icsk->icsk_ca_state != TCP_CA_Loss)
+		tcp_rack_mark_lost(sk);
+
 	/* E. Process state. */
 	switch (icsk->icsk_ca_state) {
 	case TCP_CA_Recovery:
@@ -3263,7 +3331,7 @@ static void tcp_cong_avoid(struct sock *sk, u32 ack, u32 in_flight)
 /* Restart timer after forward progress on connection.
  * RFC2988 recommends to restart timer to now+rto.
  */
-static void tcp_rearm_rto(struct sock *sk)
+void tcp_rearm_rto(struct sock *sk)
 {
 	const struct tcp_sock *tp = tcp_sk(sk);
 
@@ -3356,6 +3424,8 @@ static int tcp_clean_rtx_queue(struct sock *sk, int prior_fackets,
 
 		if (sacked & TCPCB_SACKED_ACKED)
 			tp->sacked_out -= acked_pcount;
+		else
+			tcp_rack_advance(tp, sacked, scb->when);
 		if (sacked & TCPCB_LOST)
 			tp->lost_out -= acked_pcount;
 
@@ -3741,6 +3811,32 @@ static void tcp_replace_ts_recent(struct tcp_sock *tp, u32 seq)
 	}
 }
 
+/* An ACK beyond the tail loss probe ends the probe episode. Unless the
+ * probe was reported as a duplicate, it repaired a real loss and the
+ * window is reduced as for any other loss.
+ */
+static void tcp_process_tlp_ack(struct sock *sk, u32 ack, int flag)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	bool is_tlp_dupack = (ack == tp->tlp_high_seq) &&
+			     !(flag & (FLAG_SND_UNA_ADVANCED |
+				       FLAG_NOT_DUP | FLAG_DATA_SACKED));
+
+	if (is_tlp_dupack) {
+		tp->tlp_high_seq = 0;
+		return;
+	}
+
+	if (after(ack, tp->tlp_high_seq)) {
+		tp->tlp_high_seq = 0;
+		if (!(flag & FLAG_DSACKING_ACK)) {
+			tcp_enter_cwr(sk, 1);
+			NET_INC_STATS_BH(sock_net(sk),
+					 LINUX_MIB_TCPLOSSPROBERECOVERY);
+		}
+	}
+}
+
 /* This routine deals with incoming acks, but not outgoing ones. */
 static int tcp_ack(struct sock *sk, const struct sk_buff *skb, int flag)
 {
@@ -3776,6 +3872,9 @@ static int tcp_ack(struct sock *sk, const struct sk_buff *skb, int flag)
 	if (after(ack, tp->snd_nxt))
 		goto invalid_ack;
 
+	if (icsk->icsk_pending == ICSK_TIME_LOSS_PROBE)
+		tcp_rearm_rto(sk);
+
 	if (after(ack, prior_snd_una))
 		flag |= FLAG_SND_UNA_ADVANCED;
 
@@ -3860,9 +3959,14 @@ static int tcp_ack(struct sock *sk, const struct sk_buff *skb, int flag)
 			tcp_cong_avoid(sk, ack, prior_in_flight);
 	}
 
+	if (tp->tlp_high_seq)
+		tcp_process_tlp_ack(sk, ack, flag);
+
 	if ((flag & FLAG_FORWARD_PROGRESS) || !(flag & FLAG_NOT_DUP))
 		dst_confirm(__sk_dst_get(sk));
 
+	if (icsk->icsk_pending == ICSK_TIME_RETRANS)
+		tcp_schedule_loss_probe(sk);
 	return 1;
 
 no_queue:
@@ -4473,6 +4577,7 @@ static void tcp_ofo_queue(struct sock *sk)
 
 		__skb_unlink(skb, &tp->out_of_order_queue);
 		__skb_queue_tail(&sk->sk_receive_queue, skb);
+		trace_sock_rcvqueue_enqueue(sk, skb);
 		tp->rcv_nxt = TCP_SKB_CB(skb)->end_seq;
 		if (tcp_hdr(skb)->fin)
 			tcp_fin(sk);
@@ -4511,6 +4616,7 @@ static void tcp_data_queue_ofo(struct sock *sk, struct sk_buff *skb)
 
 	if (tcp_try_rmem_schedule(sk, skb->truesize)) {
 		/* TODO: should increment a counter */
+		trace_sock_rcvqueue_full(sk, skb);
 		__kfree_skb(skb);
 		return;
 	}
@@ -4678,11 +4784,14 @@ static void tcp_data_queue(struct sock *sk, struct sk_buff *skb)
 		if (eaten <= 0) {
 queue_and_out:
 			if (eaten < 0 &&
-			    tcp_try_rmem_schedule(sk, skb->truesize))
+			    tcp_try_rmem_schedule(sk, skb->truesize)) {
+				trace_sock_rcvqueue_full(sk, skb);
 				goto drop;
+			}
 
 			skb_set_owner_r(skb, sk);
 			__skb_queue_tail(&sk->sk_receive_queue, skb);
+			trace_sock_rcvqueue_enqueue(sk, skb);
 		}
 		tp->rcv_nxt = TCP_SKB_CB(skb)->end_seq;
 		if (skb->len)
@@ -5557,6 +5666,7 @@ int tcp_rcv_established(struct sock *sk, struct sk_buff *skb,
 				__skb_pull(skb, tcp_header_len);
 				__skb_queue_tail(&sk->sk_receive_queue, skb);
 				skb_set_owner_r(skb, sk);
+				trace_sock_rcvqueue_enqueue(sk, skb);
 				tp->rcv_nxt = TCP_SKB_CB(skb)->end_seq;
 			}
 
@@ -63,6 +63,9 @@ int sysctl_tcp_slow_start_after_idle __read_mostly = 1;
 int sysctl_tcp_cookie_size __read_mostly = 0; /* TCP_COOKIE_MAX */
 EXPORT_SYMBOL_GPL(sysctl_tcp_cookie_size);
 
+/* Send a tail loss probe before falling back to the RTO */
+int sysctl_tcp_early_retrans __read_mostly = 1;
+
 
 /* Account for new data that has been sent to the network. */
 static void tcp_event_new_data_sent(struct sock *sk, const struct sk_buff *skb)
@@ -1744,6 +1747,50 @@ static int tcp_mtu_probe(struct sock *sk)
  * Returns 1, if no segments are in flight and we have queued segments, but
  * cannot send anything now because of SWS or another problem.
  */
+/* Pacing.
+ *
+ * A congestion control that models the path rate may set tp->pacing_rate.
+ * New data is then spaced out so that it leaves at that rate instead of in
+ * cwnd sized bursts that only build a queue at the bottleneck.  An idle
+ * connection sends its first skb at once, so pacing never delays
+ * the only packet in flight.
+ */
+static bool tcp_pacing_defer(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (!tp->pacing_rate || !tp->packets_out)
+		return false;
+
+	if (ktime_to_ns(ktime_sub(tp->pacing_next, ktime_get())) <= 0)
+		return false;
+
+	if (!test_and_set_bit(TCP_PACING_TIMER_ARMED, &tp->pacing_flags)) {
+		sock_hold(sk);
+		tasklet_hrtimer_start(&tp->pacing_timer, tp->pacing_next,
+				      HRTIMER_MODE_ABS);
+	}
+	return true;
+}
+
+static void tcp_pacing_update(struct sock *sk, const struct sk_buff *skb)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	ktime_t now;
+	u64 gap_ns;
+
+	if (!tp->pacing_rate)
+		return;
+
+	gap_ns = (u64)skb->len * NSEC_PER_SEC;
+	do_div(gap_ns, tp->pacing_rate);
+
+	now = ktime_get();
+	if (ktime_to_ns(ktime_sub(tp->pacing_next, now)) < 0)
+		tp->pacing_next = now;
+	tp->pacing_next = ktime_add_ns(tp->pacing_next, gap_ns);
+}
+
 static int tcp_write_xmit(struct sock *sk, unsigned int mss_now, int nonagle,
 			  int push_one, gfp_t gfp)
 {
@@ -1788,6 +1835,9 @@ static int tcp_write_xmit(struct sock *sk, unsigned int mss_now, int nonagle,
 				break;
 		}
 
+		if (tcp_pacing_defer(sk))
+			break;
+
 		limit = mss_now;
 		if (tso_segs > 1 && !tcp_urg_mode(tp))
 			limit = tcp_mss_split_point(sk, skb, mss_now,
@@ -1808,6 +1858,7 @@ static int tcp_write_xmit(struct sock *sk, unsigned int mss_now, int nonagle,
 		 * This call will increment packets_out.
 		 */
 		tcp_event_new_data_sent(sk, skb);
+		tcp_pacing_update(sk, skb);
 
 		tcp_minshall_update(tp, mss_now, skb);
 		sent_pkts += tcp_skb_pcount(skb);
@@ -1819,12 +1870,115 @@ static int tcp_write_xmit(struct sock *sk, unsigned int mss_now, int nonagle,
 		tp->prr_out += sent_pkts;
 
 	if (likely(sent_pkts)) {
+		/* A probe sent from the probe timer rearms the RTO itself */
+		if (push_one != 2)
+			tcp_schedule_loss_probe(sk);
 		tcp_cwnd_validate(sk);
 		return 0;
 	}
 	return !tp->packets_out && tcp_send_head(sk);
 }
 
+/* Schedule a tail loss probe in place of the RTO when the sender cannot
+ * send more data, so that a loss at the end of a flight is repaired by
+ * SACK recovery in about two RTTs rather than by the RTO.
+ */
+bool tcp_schedule_loss_probe(struct sock *sk)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+	u32 rtt = tp->srtt >> 3;
+	u32 timeout, tlp_time_stamp, rto_time_stamp;
+
+	/* Only replace a pending RTO, and never probe twice in a row */
+	if (icsk->icsk_pending != ICSK_TIME_RETRANS)
+		return false;
+
+	if (!sysctl_tcp_early_retrans || !rtt || !tp->packets_out ||
+	    !tcp_is_sack(tp) || icsk->icsk_ca_state != TCP_CA_Open)
+		return false;
+
+	/* Still cwnd or application limited: new data will clock out acks */
+	if (tp->snd_cwnd > tcp_packets_in_flight(tp) && tcp_send_head(sk))
+		return false;
+
+	/* With a single packet out, allow for the peer's delayed ACK */
+	timeout = rtt << 1;
+	if (tp->packets_out == 1)
+		timeout = max_t(u32, timeout,
+				rtt + (rtt >> 1) + TCP_DELACK_MAX);
+	timeout = max_t(u32, timeout, msecs_to_jiffies(10));
+
+	/* Never fire later than the RTO would have */
+	tlp_time_stamp = tcp_time_stamp + timeout;
+	rto_time_stamp = (u32)icsk->icsk_timeout;
+	if ((s32)(tlp_time_stamp - rto_time_stamp) > 0) {
+		s32 delta = rto_time_stamp - tcp_time_stamp;
+
+		if (delta > 0)
+			timeout = delta;
+	}
+
+	inet_csk_reset_xmit_timer(sk, ICSK_TIME_LOSS_PROBE, timeout,
+				  TCP_RTO_MAX);
+	return true;
+}
+
+/* The probe timer fired: send new data if the window allows, otherwise
+ * retransmit the last segment. Either way the RTO is armed again.
+ */
+void tcp_send_loss_probe(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct sk_buff *skb;
+	int mss = tcp_current_mss(sk);
+	int pcount;
+	int err = -1;
+
+	if (tcp_send_head(sk) != NULL) {
+		u32 prior_snd_nxt = tp->snd_nxt;
+
+		tcp_write_xmit(sk, mss, TCP_NAGLE_OFF, 2, GFP_ATOMIC);
+		err = tp->snd_nxt == prior_snd_nxt;
+		goto rearm_timer;
+	}
+
+	/* At most one outstanding probe retransmission */
+	if (tp->tlp_high_seq)
+		goto rearm_timer;
+
+	skb = tcp_write_queue_tail(sk);
+	if (WARN_ON(!skb))
+		goto rearm_timer;
+
+	pcount = tcp_skb_pcount(skb);
+	if (WARN_ON(!pcount))
+		goto rearm_timer;
+
+	if (pcount > 1 && skb->len > (pcount - 1) * mss) {
+		if (unlikely(tcp_fragment(sk, skb, (pcount - 1) * mss, mss)))
+			goto rearm_timer;
+		skb = tcp_write_queue_tail(sk);
+	}
+
+	if (WARN_ON(!skb || !tcp_skb_pcount(skb)))
+		goto rearm_timer;
+
+	/* A probe without data cannot trigger fast recovery */
+	if (skb->len > 0)
+		err = __tcp_retransmit_skb(sk, skb);
+
+	if (likely(!err))
+		tp->tlp_high_seq = tp->snd_nxt;
+
+rearm_timer:
+	inet_csk_reset_xmit_timer(sk, ICSK_TIME_RETRANS,
+				  inet_csk(sk)->icsk_rto, TCP_RTO_MAX);
+
+	if (likely(!err))
+		NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPLOSSPROBES);
+}
+
 /* Push out any pending frames which were held back due to
  * TCP_CORK or attempt at coalescing tiny packets.
  * The socket must be locked by the caller.
@@ -2082,12 +2236,11 @@ static void tcp_retrans_try_collapse(struct sock *sk, struct sk_buff *to,
  * state updates are done by the caller.  Returns non-zero if an
  * error occurred which prevented the send.
  */
-int tcp_retransmit_skb(struct sock *sk, struct sk_buff *skb)
+int __tcp_retransmit_skb(struct sock *sk, struct sk_buff *skb)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
 	struct inet_connection_sock *icsk = inet_csk(sk);
 	unsigned int cur_mss;
-	int err;
 
 	/* Inconslusive MTU probe */
 	if (icsk->icsk_mtup.probe_size) {
@@ -2166,11 +2319,17 @@ int tcp_retransmit_skb(struct sock *sk, struct sk_buff *skb)
 		     skb_headroom(skb) >= 0xFFFF)) {
 		struct sk_buff *nskb = __pskb_copy(skb, MAX_TCP_HEADER,
 						   GFP_ATOMIC);
-		err = nskb ? tcp_transmit_skb(sk, nskb, 0, GFP_ATOMIC) :
-			     -ENOBUFS;
+		return nskb ? tcp_transmit_skb(sk, nskb, 0, GFP_ATOMIC) :
+			      -ENOBUFS;
 	} else {
-		err = tcp_transmit_skb(sk, skb, 1, GFP_ATOMIC);
+		return tcp_transmit_skb(sk, skb, 1, GFP_ATOMIC);
 	}
+}
+
+int tcp_retransmit_skb(struct sock *sk, struct sk_buff *skb)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	int err = __tcp_retransmit_skb(sk, skb);
 
 	if (err == 0) {
 		/* Update global TCP statistics. */
@@ -2197,11 +2356,11 @@ int tcp_retransmit_skb(struct sock *sk, struct sk_buff *skb)
 		 * see tcp_input.c tcp_sacktag_write_queue().
 		 */
 		TCP_SKB_CB(skb)->ack_seq = tp->snd_nxt;
-	}
 
-	if (tp->undo_retrans < 0)
-		tp->undo_retrans = 0;
-	tp->undo_retrans += tcp_skb_pcount(skb);
+		if (tp->undo_retrans < 0)
+			tp->undo_retrans = 0;
+		tp->undo_retrans += tcp_skb_pcount(skb);
+	}
 	return err;
 }
 
@@ -68,10 +68,59 @@ int tcp_use_userconfig_sysctl_handler(ctl_table *table, int write,
 	return ret;
 }
 
+/* Retry interval of the pacing timer while the user owns the socket */
+#define TCP_PACING_RETRY_NS	(100 * NSEC_PER_USEC)
+
+/*
+ * Runs in tasklet context once the pacing gap of the next skb has elapsed.
+ * The timer holds a reference on the socket while it is armed.
+ */
+static enum hrtimer_restart tcp_pacing_timer(struct hrtimer *timer)
+{
+	struct tcp_sock *tp = container_of(timer, struct tcp_sock,
+					   pacing_timer.timer);
+	struct sock *sk = (struct sock *)tp;
+
+	bh_lock_sock(sk);
+	if (sock_owned_by_user(sk)) {
+		/* Try again shortly, the owner may push by itself */
+		bh_unlock_sock(sk);
+		hrtimer_forward_now(timer, ns_to_ktime(TCP_PACING_RETRY_NS));
+		return HRTIMER_RESTART;
+	}
+
+	clear_bit(TCP_PACING_TIMER_ARMED, &tp->pacing_flags);
+	if (sk->sk_state != TCP_CLOSE)
+		tcp_push_pending_frames(sk);
+	bh_unlock_sock(sk);
+	sock_put(sk);
+	return HRTIMER_NORESTART;
+}
+
+void tcp_pacing_timer_cancel(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	/*
+	 * Callers may run in softirq context, so the tasklet cannot be
+	 * killed here.  If it is already scheduled it will find the socket
+	 * closed and drop its reference itself.
+	 */
+	if (hrtimer_try_to_cancel(&tp->pacing_timer.timer) == 1) {
+		clear_bit(TCP_PACING_TIMER_ARMED, &tp->pacing_flags);
+		__sock_put(sk);
+	}
+}
+
 void tcp_init_xmit_timers(struct sock *sk)
 {
+	struct tcp_sock *tp = tcp_sk(sk);
+
 	inet_csk_init_xmit_timers(sk, &tcp_write_timer, &tcp_delack_timer,
 				  &tcp_keepalive_timer);
+	tp->pacing_flags = 0;
+	tasklet_hrtimer_init(&tp->pacing_timer, tcp_pacing_timer,
+			     CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
 }
 EXPORT_SYMBOL(tcp_init_xmit_timers);
 
@@ -508,6 +557,9 @@ static void tcp_write_timer(unsigned long data)
 	case ICSK_TIME_PROBE0:
 		tcp_probe_timer(sk);
 		break;
+	case ICSK_TIME_LOSS_PROBE:
+		tcp_send_loss_probe(sk);
+		break;
 	}
 
 out:
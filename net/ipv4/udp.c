@@ -107,6 +107,7 @@
 #include <net/checksum.h>
 #include <net/xfrm.h>
 #include <trace/events/udp.h>
+#include <trace/events/sock.h>
 #include "udp_impl.h"
 
 struct udp_table udp_table __read_mostly;
@@ -1482,6 +1483,7 @@ int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 	if (!sock_owned_by_user(sk))
 		rc = __udp_queue_rcv_skb(sk, skb);
 	else if (sk_add_backlog(sk, skb)) {
+		trace_sock_rcvqueue_full(sk, skb);
 		bh_unlock_sock(sk);
 		goto drop;
 	}
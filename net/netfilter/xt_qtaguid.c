@@ -15,17 +15,21 @@
 #define DEBUG
 
 #include <linux/file.h>
+#include <linux/hash.h>
 #include <linux/inetdevice.h>
 #include <linux/module.h>
 #include <linux/netfilter/x_tables.h>
 #include <linux/netfilter/xt_qtaguid.h>
+#include <linux/percpu.h>
 #include <linux/ratelimit.h>
+#include <linux/rculist.h>
 #include <linux/skbuff.h>
 #include <linux/workqueue.h>
 #include <net/addrconf.h>
 #include <net/sock.h>
 #include <net/tcp.h>
 #include <net/udp.h>
+#include <trace/events/sock.h>
 
 #if defined(CONFIG_IP6_NF_IPTABLES) || defined(CONFIG_IP6_NF_IPTABLES_MODULE)
 #include <linux/netfilter_ipv6/ip6_tables.h>
@@ -55,6 +59,8 @@ module_param_named(stats_perms, proc_stats_perms, uint, S_IRUGO | S_IWUSR);
 
 static struct proc_dir_entry *xt_qtaguid_ctrl_file;
 
+static struct proc_dir_entry *xt_qtaguid_rcv_stats_file;
+
 /* Everybody can write. But proc_ctrl_write_limited is true by default which
  * limits what can be controlled. See the can_*() functions.
  */
@@ -109,6 +115,20 @@ module_param_named(tag_tracking_passive, qtu_proc_handling_passive, bool,
 uint qtaguid_debug_mask = DEFAULT_DEBUG_MASK;
 module_param_named(debug_mask, qtaguid_debug_mask, uint, S_IRUGO | S_IWUSR);
 
+/*
+ * Setting rcv_stats to Y hooks the socket receive queue tracepoints and
+ * collects per uid queue fill, rmem drops and read latency histograms
+ * in xt_qtaguid/rcv_stats. It also turns on skb receive timestamps.
+ */
+static bool rcv_stats_enabled;
+static int rcv_stats_param_set(const char *val, const struct kernel_param *kp);
+static struct kernel_param_ops rcv_stats_param_ops = {
+	.set = rcv_stats_param_set,
+	.get = param_get_bool,
+};
+module_param_cb(rcv_stats, &rcv_stats_param_ops, &rcv_stats_enabled,
+		S_IRUGO | S_IWUSR);
+
 /*---------------------------------------------------------------------------*/
 static const char *iface_stat_procdirname = "iface_stat";
 static struct proc_dir_entry *iface_stat_procdir;
@@ -187,15 +207,18 @@ static struct proc_dir_entry *iface_stat_fmt_procfile;
  * qtaguid_mt()
  *   account_for_uid()
  *     if_tag_stat_update()
- *       get_sock_stat()
- *         sock_tag_list_lock
- *       struct iface_stat->tag_stat_list_lock
- *         tag_stat_update()
- *           get_active_counter_set()
- *             tag_counter_set_list_lock
- *         tag_stat_update()
- *           get_active_counter_set()
- *             tag_counter_set_list_lock
+ *       rcu_read_lock
+ *         (iface_stat_list)
+ *         qtaguid_stat_cache hit: no locks
+ *         get_sock_stat()
+ *           (sock_tag_hash)
+ *         get_active_counter_set()
+ *           tag_counter_set_list_lock
+ *         struct iface_stat->tag_stat_list_lock
+ *           tag_stat_update()
+ *   iface_stat_update_from_skb()
+ *     rcu_read_lock
+ *       (iface_stat_list)
  *
  *
  * qtaguid_ctrl_parse()
@@ -226,6 +249,30 @@ static DEFINE_SPINLOCK(iface_stat_list_lock);
 static struct rb_root sock_tag_tree = RB_ROOT;
 static DEFINE_SPINLOCK(sock_tag_list_lock);
 
+/*
+ * Mirrors sock_tag_tree for the packet path: updated under
+ * sock_tag_list_lock, looked up under rcu_read_lock.
+ */
+#define SOCK_TAG_HASH_BITS 8
+static struct hlist_head sock_tag_hash[1 << SOCK_TAG_HASH_BITS];
+
+/*
+ * Per cpu cache of the stats entry of the last socket accounted on this
+ * cpu. Bulk flows hit it for every packet and skip all lookups.
+ * Anything that could change the result (tagging, counter sets, deleted
+ * stats) bumps qtaguid_cache_gen, which invalidates every cache.
+ */
+struct qtaguid_stat_cache {
+	const struct sock *sk;
+	uid_t uid;
+	struct iface_stat *iface_entry;
+	struct tag_stat *ts_entry;
+	int active_set;
+	unsigned int gen;
+};
+static DEFINE_PER_CPU(struct qtaguid_stat_cache, qtaguid_stat_cache);
+static atomic_t qtaguid_cache_gen = ATOMIC_INIT(1);
+
 static struct rb_root tag_counter_set_tree = RB_ROOT;
 static DEFINE_SPINLOCK(tag_counter_set_list_lock);
 
@@ -236,6 +283,13 @@ static struct rb_root proc_qtu_data_tree = RB_ROOT;
 /* No proc_qtu_data_tree_lock; use uid_tag_data_tree_lock */
 
 static struct qtaguid_event_counts qtu_events;
+
+static struct rb_root rcv_stat_tree = RB_ROOT;
+/* Taken from hard irq disabled sections of the packet path */
+static DEFINE_SPINLOCK(rcv_stat_tree_lock);
+static DEFINE_MUTEX(rcv_stats_mutex);
+/* Probes can only be registered once qtaguid_mt_init() ran */
+static bool rcv_stats_ready;
 /*----------------------------------------------*/
 static bool can_manipulate_uids(void)
 {
@@ -401,6 +455,31 @@ static void sock_tag_tree_insert(struct sock_tag *data, struct rb_root *root)
 	rb_insert_color(&data->sock_node, root);
 }
 
+static inline void qtaguid_cache_invalidate(void)
+{
+	atomic_inc(&qtaguid_cache_gen);
+}
+
+static struct hlist_head *sock_tag_hash_bucket(const struct sock *sk)
+{
+	return &sock_tag_hash[hash_ptr((void *)sk, SOCK_TAG_HASH_BITS)];
+}
+
+/* Caller must hold sock_tag_list_lock */
+static void sock_tag_hash_add(struct sock_tag *st_entry)
+{
+	hlist_add_head_rcu(&st_entry->sock_hash_node,
+			   sock_tag_hash_bucket(st_entry->sk));
+	qtaguid_cache_invalidate();
+}
+
+/* Caller must hold sock_tag_list_lock */
+static void sock_tag_hash_del(struct sock_tag *st_entry)
+{
+	hlist_del_rcu(&st_entry->sock_hash_node);
+	qtaguid_cache_invalidate();
+}
+
 static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 {
 	struct rb_node *node;
@@ -417,7 +496,7 @@ static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 			 get_uid_from_tag(st_entry->tag));
 		rb_erase(&st_entry->sock_node, st_to_free_tree);
 		sockfd_put(st_entry->socket);
-		kfree(st_entry);
+		kfree_rcu(st_entry, rcu);
 	}
 }
 
@@ -748,7 +827,8 @@ static int get_active_counter_set(tag_t tag)
 
 /*
  * Find the entry for tracking the specified interface.
- * Caller must hold iface_stat_list_lock
+ * Caller must hold iface_stat_list_lock or rcu_read_lock.
+ * iface_stat entries are never freed.
  */
 static struct iface_stat *get_iface_entry(const char *ifname)
 {
@@ -761,7 +841,7 @@ static struct iface_stat *get_iface_entry(const char *ifname)
 	}
 
 	/* Iterate over interfaces */
-	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
 		if (!strcmp(ifname, iface_entry->ifname))
 			goto done;
 	}
@@ -790,9 +870,10 @@ static int pp_iface_stat_line(bool header, char *outp,
 	} else {
 		struct rtnl_link_stats64 dev_stats, *stats;
 		__u64 rx_pkts, tx_pkts, rx_bytes, tx_bytes;
-		struct data_counters *cnts;
+		struct data_counters totals, *cnts = &totals;
 		int cnt_set = 0;   /* We only use one set for the device */
-		cnts = &iface_entry->totals_via_skb;
+
+		data_counters_fold(iface_entry->totals_via_skb, &totals);
 
 		if (iface_entry->active) {
 			stats = dev_get_stats(iface_entry->net_dev, &dev_stats);
@@ -996,7 +1077,8 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	struct iface_stat *new_iface;
 	struct iface_stat_work *isw;
 
-	new_iface = kzalloc(sizeof(*new_iface), GFP_ATOMIC);
+	new_iface = kzalloc(sizeof(*new_iface) + DATA_COUNTERS_PCPU_SIZE,
+			    GFP_ATOMIC);
 	if (new_iface == NULL) {
 		pr_err("qtaguid: iface_stat: create(%s): "
 		       "iface_stat alloc failed\n", net_dev->name);
@@ -1029,7 +1111,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	isw->iface_entry = new_iface;
 	INIT_WORK(&isw->iface_work, iface_create_proc_worker);
 	schedule_work(&isw->iface_work);
-	list_add(&new_iface->list, &iface_stat_list);
+	list_add_rcu(&new_iface->list, &iface_stat_list);
 	return new_iface;
 }
 
@@ -1210,16 +1292,20 @@ static struct sock_tag *get_sock_stat_nl(const struct sock *sk)
 	return sock_tag_tree_search(&sock_tag_tree, sk);
 }
 
+/* Caller must hold rcu_read_lock */
 static struct sock_tag *get_sock_stat(const struct sock *sk)
 {
 	struct sock_tag *sock_tag_entry;
+	struct hlist_node *node;
 	MT_DEBUG("qtaguid: get_sock_stat(sk=%p)\n", sk);
 	if (!sk)
 		return NULL;
-	spin_lock_bh(&sock_tag_list_lock);
-	sock_tag_entry = get_sock_stat_nl(sk);
-	spin_unlock_bh(&sock_tag_list_lock);
-	return sock_tag_entry;
+	hlist_for_each_entry_rcu(sock_tag_entry, node,
+				 sock_tag_hash_bucket(sk), sock_hash_node) {
+		if (sock_tag_entry->sk == sk)
+			return sock_tag_entry;
+	}
+	return NULL;
 }
 
 static int ipx_proto(const struct sk_buff *skb,
@@ -1247,6 +1333,7 @@ static void
 data_counters_update(struct data_counters *dc, int set,
 		     enum ifs_tx_rx direction, int proto, int bytes)
 {
+	u64_stats_update_begin(&dc->syncp);
 	switch (proto) {
 	case IPPROTO_TCP:
 		dc_add_byte_packets(dc, set, direction, IFS_TCP, bytes, 1);
@@ -1260,6 +1347,7 @@ data_counters_update(struct data_counters *dc, int set,
 				    1);
 		break;
 	}
+	u64_stats_update_end(&dc->syncp);
 }
 
 /*
@@ -1361,37 +1449,39 @@ static void iface_stat_update_from_skb(const struct sk_buff *skb,
 			 par->family, proto);
 	}
 
-	spin_lock_bh(&iface_stat_list_lock);
+	rcu_read_lock();
 	entry = get_iface_entry(el_dev->name);
 	if (entry == NULL) {
 		IF_DEBUG("qtaguid: iface_stat: %s(%s): not tracked\n",
 			 __func__, el_dev->name);
-		spin_unlock_bh(&iface_stat_list_lock);
+		rcu_read_unlock();
 		return;
 	}
 
 	IF_DEBUG("qtaguid: %s(%s): entry=%p\n", __func__,
 		 el_dev->name, entry);
 
-	data_counters_update(&entry->totals_via_skb, 0, direction, proto,
-			     bytes);
-	spin_unlock_bh(&iface_stat_list_lock);
+	/* The match runs with bh disabled, so the cpu is stable */
+	data_counters_update(&entry->totals_via_skb[smp_processor_id()], 0,
+			     direction, proto, bytes);
+	rcu_read_unlock();
 }
 
-static void tag_stat_update(struct tag_stat *tag_entry,
+/* Lockless: only this cpu's counters are touched, bh must be disabled */
+static void tag_stat_update(struct tag_stat *tag_entry, int active_set,
 			enum ifs_tx_rx direction, int proto, int bytes)
 {
-	int active_set;
-	active_set = get_active_counter_set(tag_entry->tn.tag);
+	int cpu = smp_processor_id();
+
 	MT_DEBUG("qtaguid: tag_stat_update(tag=0x%llx (uid=%u) set=%d "
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
-	data_counters_update(&tag_entry->counters, active_set, direction,
+	data_counters_update(&tag_entry->counters[cpu], active_set, direction,
 			     proto, bytes);
 	if (tag_entry->parent_counters)
-		data_counters_update(tag_entry->parent_counters, active_set,
-				     direction, proto, bytes);
+		data_counters_update(&tag_entry->parent_counters[cpu],
+				     active_set, direction, proto, bytes);
 }
 
 /*
@@ -1406,7 +1496,8 @@ static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
 	IF_DEBUG("qtaguid: iface_stat: %s(): ife=%p tag=0x%llx"
 		 " (uid=%u)\n", __func__,
 		 iface_entry, tag, get_uid_from_tag(tag));
-	new_tag_stat_entry = kzalloc(sizeof(*new_tag_stat_entry), GFP_ATOMIC);
+	new_tag_stat_entry = kzalloc(sizeof(*new_tag_stat_entry) +
+				     DATA_COUNTERS_PCPU_SIZE, GFP_ATOMIC);
 	if (!new_tag_stat_entry) {
 		pr_err("qtaguid: iface_stat: tag stat alloc failed\n");
 		goto done;
@@ -1428,32 +1519,45 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	struct sock_tag *sock_tag_entry;
 	struct iface_stat *iface_entry;
 	struct tag_stat *new_tag_stat = NULL;
+	struct qtaguid_stat_cache *cache;
+	unsigned int gen;
+	int active_set;
 	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
 		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
 		 ifname, uid, sk, direction, proto, bytes);
 
+	/* Sampled first: a change during the lookups voids what we cache */
+	gen = atomic_read(&qtaguid_cache_gen);
 
-	spin_lock_bh(&iface_stat_list_lock);
+	rcu_read_lock();
 	iface_entry = get_iface_entry(ifname);
 	if (!iface_entry) {
-		spin_unlock_bh(&iface_stat_list_lock);
+		rcu_read_unlock();
 		pr_err_ratelimited("qtaguid: iface_stat: stat_update() "
 				   "%s not found\n", ifname);
 		return;
 	}
-	spin_unlock_bh(&iface_stat_list_lock);
 	/* It is ok to process data when an iface_entry is inactive */
 
 	MT_DEBUG("qtaguid: iface_stat: stat_update() dev=%s entry=%p\n",
 		 ifname, iface_entry);
 
+	cache = &__get_cpu_var(qtaguid_stat_cache);
+	if (cache->gen == gen && cache->ts_entry && cache->sk == sk &&
+	    cache->uid == uid && cache->iface_entry == iface_entry) {
+		tag_stat_update(cache->ts_entry, cache->active_set,
+				direction, proto, bytes);
+		rcu_read_unlock();
+		return;
+	}
+
 	/*
 	 * Look for a tagged sock.
 	 * It will have an acct_uid.
 	 */
 	sock_tag_entry = get_sock_stat(sk);
 	if (sock_tag_entry) {
-		tag = sock_tag_entry->tag;
+		tag = ACCESS_ONCE(sock_tag_entry->tag);
 		acct_tag = get_atag_from_tag(tag);
 		uid_tag = get_utag_from_tag(tag);
 	} else {
@@ -1464,6 +1568,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	MT_DEBUG("qtaguid: iface_stat: stat_update(): "
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
+	active_set = get_active_counter_set(tag);
 	/* Loop over tag list under this interface for {acct_tag,uid_tag} */
 	spin_lock_bh(&iface_entry->tag_stat_list_lock);
 
@@ -1474,9 +1579,8 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 * Updating the {acct_tag, uid_tag} entry handles both stats:
 		 * {0, uid_tag} will also get updated.
 		 */
-		tag_stat_update(tag_stat_entry, direction, proto, bytes);
-		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
-		return;
+		new_tag_stat = tag_stat_entry;
+		goto update;
 	}
 
 	/* Loop over tag list under this interface for {0,uid_tag} */
@@ -1491,9 +1595,9 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
 		if (!new_tag_stat)
 			goto unlock;
-		uid_tag_counters = &new_tag_stat->counters;
+		uid_tag_counters = new_tag_stat->counters;
 	} else {
-		uid_tag_counters = &tag_stat_entry->counters;
+		uid_tag_counters = tag_stat_entry->counters;
 	}
 
 	if (acct_tag) {
@@ -1513,9 +1617,17 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 */
 		BUG_ON(!new_tag_stat);
 	}
-	tag_stat_update(new_tag_stat, direction, proto, bytes);
+update:
+	tag_stat_update(new_tag_stat, active_set, direction, proto, bytes);
+	cache->sk = sk;
+	cache->uid = uid;
+	cache->iface_entry = iface_entry;
+	cache->ts_entry = new_tag_stat;
+	cache->active_set = active_set;
+	cache->gen = gen;
 unlock:
 	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+	rcu_read_unlock();
 }
 
 static int iface_netdev_event_handler(struct notifier_block *nb,
@@ -2130,6 +2242,7 @@ static int ctrl_cmd_delete(const char *input)
 
 		if (!acct_tag || st_entry->tag == tag) {
 			rb_erase(&st_entry->sock_node, &sock_tag_tree);
+			sock_tag_hash_del(st_entry);
 			/* Can't sockfd_put() within spinlock, do it later. */
 			sock_tag_tree_insert(st_entry, &st_to_free_tree);
 			tr_entry = lookup_tag_ref(st_entry->tag, NULL);
@@ -2163,6 +2276,7 @@ static int ctrl_cmd_delete(const char *input)
 			 tcs_entry->active_set);
 		rb_erase(&tcs_entry->tn.node, &tag_counter_set_tree);
 		kfree(tcs_entry);
+		qtaguid_cache_invalidate();
 	}
 	spin_unlock_bh(&tag_counter_set_list_lock);
 
@@ -2193,7 +2307,8 @@ static int ctrl_cmd_delete(const char *input)
 					 entry_uid);
 				rb_erase(&ts_entry->tn.node,
 					 &iface_entry->tag_stat_tree);
-				kfree(ts_entry);
+				qtaguid_cache_invalidate();
+				kfree_rcu(ts_entry, rcu);
 			}
 		}
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
@@ -2281,6 +2396,7 @@ static int ctrl_cmd_counter_set(const char *input)
 			 input, tag, get_uid_from_tag(tag), counter_set);
 	}
 	tcs->active_set = counter_set;
+	qtaguid_cache_invalidate();
 	spin_unlock_bh(&tag_counter_set_list_lock);
 	atomic64_inc(&qtu_events.counter_set_changes);
 	res = 0;
@@ -2393,6 +2509,7 @@ static int ctrl_cmd_tag(const char *input)
 		BUG_ON(prev_tag_ref_entry->num_sock_tags <= 0);
 		prev_tag_ref_entry->num_sock_tags--;
 		sock_tag_entry->tag = full_tag;
+		qtaguid_cache_invalidate();
 	} else {
 		CT_DEBUG("qtaguid: ctrl_tag(%s): newtag for sk=%p\n",
 			 input, el_socket->sk);
@@ -2432,6 +2549,7 @@ static int ctrl_cmd_tag(const char *input)
 		spin_unlock_bh(&uid_tag_data_tree_lock);
 
 		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
+		sock_tag_hash_add(sock_tag_entry);
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
 	spin_unlock_bh(&sock_tag_list_lock);
@@ -2498,6 +2616,7 @@ static int ctrl_cmd_untag(const char *input)
 	 * so it can do whatever it wants to it.
 	 */
 	rb_erase(&sock_tag_entry->sock_node, &sock_tag_tree);
+	sock_tag_hash_del(sock_tag_entry);
 
 	tag_ref_entry = lookup_tag_ref(sock_tag_entry->tag, &utd_entry);
 	BUG_ON(!tag_ref_entry);
@@ -2534,7 +2653,7 @@ static int ctrl_cmd_untag(const char *input)
 		 atomic_long_read(&el_socket->file->f_count) - 1);
 	sockfd_put(el_socket);
 
-	kfree(sock_tag_entry);
+	kfree_rcu(sock_tag_entry, rcu);
 	atomic64_inc(&qtu_events.sockets_untagged);
 
 	return 0;
@@ -2621,7 +2740,7 @@ struct proc_print_info {
 static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 {
 	int len;
-	struct data_counters *cnts;
+	struct data_counters totals, *cnts;
 
 	if (!ppi->item_index) {
 		if (ppi->item_index++ < ppi->items_to_skip)
@@ -2653,7 +2772,8 @@ static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 		}
 		if (ppi->item_index++ < ppi->items_to_skip)
 			return 0;
-		cnts = &ppi->ts_entry->counters;
+		data_counters_fold(ppi->ts_entry->counters, &totals);
+		cnts = &totals;
 		len = snprintf(
 			ppi->outp, ppi->char_count,
 			"%d %s 0x%llx %u %u "
@@ -2783,6 +2903,279 @@ static int qtaguid_stats_proc_read(char *page, char **num_items_returned,
 	return ppi.outp - page;
 }
 
+/*------------------------------------------*/
+static void rcv_counters_fold(const struct rcv_counters *pcpu,
+			      struct rcv_counters *res)
+{
+	int cpu, i;
+
+	memset(res, 0, sizeof(*res));
+	for_each_possible_cpu(cpu) {
+		const struct rcv_counters *c = &pcpu[cpu];
+
+		res->queued += c->queued;
+		res->rmem_drops += c->rmem_drops;
+		res->reads += c->reads;
+		res->delay_us += c->delay_us;
+		res->rmem_max = max(res->rmem_max, c->rmem_max);
+		for (i = 0; i < RCV_FILL_BUCKETS; i++)
+			res->fill_hist[i] += c->fill_hist[i];
+		for (i = 0; i < RCV_DELAY_BUCKETS; i++)
+			res->delay_hist[i] += c->delay_hist[i];
+	}
+}
+
+/*
+ * Returns this cpu's counters for the uid the socket is accounted to,
+ * creating the entry if needed. Hard irqs must be disabled.
+ */
+static struct rcv_counters *get_rcv_counters(const struct sock *sk)
+{
+	struct sock_tag *sock_tag_entry;
+	struct tag_node *node;
+	struct rcv_stat *rs_entry;
+	const struct socket *sock;
+	const struct file *filp;
+	tag_t uid_tag;
+
+	rcu_read_lock();
+	sock_tag_entry = get_sock_stat(sk);
+	if (sock_tag_entry) {
+		uid_tag = get_utag_from_tag(sock_tag_entry->tag);
+	} else {
+		sock = sk->sk_socket;
+		filp = sock ? sock->file : NULL;
+		uid_tag = make_tag_from_uid(filp ? filp->f_cred->fsuid : 0);
+	}
+	rcu_read_unlock();
+
+	spin_lock(&rcv_stat_tree_lock);
+	node = tag_node_tree_search(&rcv_stat_tree, uid_tag);
+	rs_entry = node ? rb_entry(&node->node, struct rcv_stat, tn.node) : NULL;
+	if (!rs_entry) {
+		rs_entry = kzalloc(sizeof(*rs_entry) + RCV_COUNTERS_PCPU_SIZE,
+				   GFP_ATOMIC);
+		if (rs_entry) {
+			rs_entry->tn.tag = uid_tag;
+			tag_node_tree_insert(&rs_entry->tn, &rcv_stat_tree);
+		}
+	}
+	spin_unlock(&rcv_stat_tree_lock);
+
+	/* Entries are never freed */
+	return rs_entry ? &rs_entry->counters[smp_processor_id()] : NULL;
+}
+
+static void rcv_stat_enqueue_probe(void *ignore, struct sock *sk,
+				   struct sk_buff *skb)
+{
+	struct rcv_counters *cnts;
+	unsigned long flags;
+	int rmem = atomic_read(&sk->sk_rmem_alloc);
+	int bucket = RCV_FILL_BUCKETS - 1;
+
+	if (sk->sk_rcvbuf >= RCV_FILL_BUCKETS)
+		bucket = min(bucket,
+			     rmem / (sk->sk_rcvbuf / RCV_FILL_BUCKETS));
+
+	local_irq_save(flags);
+	cnts = get_rcv_counters(sk);
+	if (cnts) {
+		cnts->queued++;
+		cnts->fill_hist[bucket]++;
+		if (rmem > cnts->rmem_max)
+			cnts->rmem_max = rmem;
+	}
+	local_irq_restore(flags);
+}
+
+static void rcv_stat_dequeue_probe(void *ignore, struct sock *sk,
+				   struct sk_buff *skb)
+{
+	struct rcv_counters *cnts;
+	unsigned long flags;
+	s64 delay;
+
+	if (!skb->tstamp.tv64)
+		return;
+	delay = ktime_us_delta(ktime_get_real(), skb->tstamp);
+	if (delay < 0)
+		delay = 0;
+
+	local_irq_save(flags);
+	cnts = get_rcv_counters(sk);
+	if (cnts) {
+		cnts->reads++;
+		cnts->delay_us += delay;
+		cnts->delay_hist[min_t(int, fls64(delay),
+				       RCV_DELAY_BUCKETS - 1)]++;
+	}
+	local_irq_restore(flags);
+}
+
+static void rcv_stat_drop_probe(void *ignore, struct sock *sk,
+				struct sk_buff *skb)
+{
+	struct rcv_counters *cnts;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	cnts = get_rcv_counters(sk);
+	if (cnts)
+		cnts->rmem_drops++;
+	local_irq_restore(flags);
+}
+
+static int rcv_stats_probes_register(void)
+{
+	int ret;
+
+	ret = register_trace_sock_rcvqueue_enqueue(rcv_stat_enqueue_probe,
+						   NULL);
+	if (ret)
+		goto err;
+	ret = register_trace_sock_rcvqueue_dequeue(rcv_stat_dequeue_probe,
+						   NULL);
+	if (ret)
+		goto err_enqueue;
+	ret = register_trace_sock_rcvqueue_full(rcv_stat_drop_probe, NULL);
+	if (ret)
+		goto err_dequeue;
+	net_enable_timestamp();
+	return 0;
+
+err_dequeue:
+	unregister_trace_sock_rcvqueue_dequeue(rcv_stat_dequeue_probe, NULL);
+err_enqueue:
+	unregister_trace_sock_rcvqueue_enqueue(rcv_stat_enqueue_probe, NULL);
+	tracepoint_synchronize_unregister();
+err:
+	pr_err("qtaguid: rcv_stats: probe registration failed: %d\n", ret);
+	return ret;
+}
+
+static void rcv_stats_probes_unregister(void)
+{
+	net_disable_timestamp();
+	unregister_trace_sock_rcvqueue_full(rcv_stat_drop_probe, NULL);
+	unregister_trace_sock_rcvqueue_dequeue(rcv_stat_dequeue_probe, NULL);
+	unregister_trace_sock_rcvqueue_enqueue(rcv_stat_enqueue_probe, NULL);
+	tracepoint_synchronize_unregister();
+}
+
+static int rcv_stats_param_set(const char *val, const struct kernel_param *kp)
+{
+	bool was_enabled;
+	int ret;
+
+	mutex_lock(&rcv_stats_mutex);
+	was_enabled = rcv_stats_enabled;
+	ret = param_set_bool(val, kp);
+	if (!ret && rcv_stats_ready && rcv_stats_enabled != was_enabled) {
+		if (rcv_stats_enabled)
+			ret = rcv_stats_probes_register();
+		else
+			rcv_stats_probes_unregister();
+	}
+	if (ret)
+		rcv_stats_enabled = was_enabled;
+	mutex_unlock(&rcv_stats_mutex);
+	return ret;
+}
+
+static int __init rcv_stats_init(void)
+{
+	mutex_lock(&rcv_stats_mutex);
+	rcv_stats_ready = true;
+	if (rcv_stats_enabled && rcv_stats_probes_register())
+		rcv_stats_enabled = false;
+	mutex_unlock(&rcv_stats_mutex);
+	return 0;
+}
+
+static int pp_rcv_stat_line(bool header, char *outp, int char_count,
+			    int item_index, struct rcv_stat *rs_entry)
+{
+	struct rcv_counters totals;
+	int len, i;
+
+	if (header)
+		return snprintf(outp, char_count,
+				"idx uid_tag_int "
+				"queued rmem_drops rmem_max "
+				"reads delay_us fill_hist delay_hist\n");
+
+	rcv_counters_fold(rs_entry->counters, &totals);
+	len = snprintf(outp, char_count, "%d %u %llu %llu %u %llu %llu ",
+		       item_index, get_uid_from_tag(rs_entry->tn.tag),
+		       totals.queued, totals.rmem_drops, totals.rmem_max,
+		       totals.reads, totals.delay_us);
+	for (i = 0; i < RCV_FILL_BUCKETS && len < char_count; i++)
+		len += snprintf(outp + len, char_count - len, "%llu%c",
+				totals.fill_hist[i],
+				i < RCV_FILL_BUCKETS - 1 ? ',' : ' ');
+	for (i = 0; i < RCV_DELAY_BUCKETS && len < char_count; i++)
+		len += snprintf(outp + len, char_count - len, "%llu%c",
+				totals.delay_hist[i],
+				i < RCV_DELAY_BUCKETS - 1 ? ',' : '\n');
+	return len;
+}
+
+/*
+ * Procfs reader for the per uid receive queue stats, style "1)" as
+ * described in fs/proc/generic.c. The histograms are comma separated,
+ * see struct rcv_counters for the buckets.
+ */
+static int qtaguid_rcv_stats_proc_read(char *page, char **num_items_returned,
+				       off_t items_to_skip, int char_count,
+				       int *eof, void *data)
+{
+	char *outp = page;
+	int item_index = 0;
+	int len;
+	struct rb_node *node;
+	struct rcv_stat *rs_entry;
+	unsigned long flags;
+
+	if (*eof)
+		return 0;
+
+	if (item_index++ >= items_to_skip) {
+		len = pp_rcv_stat_line(true, outp, char_count, 0, NULL);
+		if (len >= char_count) {
+			*outp = '\0';
+			return outp - page;
+		}
+		outp += len;
+		char_count -= len;
+		(*num_items_returned)++;
+	}
+
+	spin_lock_irqsave(&rcv_stat_tree_lock, flags);
+	for (node = rb_first(&rcv_stat_tree); node; node = rb_next(node)) {
+		rs_entry = rb_entry(node, struct rcv_stat, tn.node);
+		if (!can_read_other_uid_stats(
+			    get_uid_from_tag(rs_entry->tn.tag)))
+			continue;
+		if (item_index++ < items_to_skip)
+			continue;
+		len = pp_rcv_stat_line(false, outp, char_count, item_index,
+				       rs_entry);
+		if (len >= char_count) {
+			spin_unlock_irqrestore(&rcv_stat_tree_lock, flags);
+			*outp = '\0';
+			return outp - page;
+		}
+		outp += len;
+		char_count -= len;
+		(*num_items_returned)++;
+	}
+	spin_unlock_irqrestore(&rcv_stat_tree_lock, flags);
+
+	*eof = 1;
+	return outp - page;
+}
+
 /*------------------------------------------*/
 static int qtudev_open(struct inode *inode, struct file *file)
 {
@@ -2901,6 +3294,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 		free_tag_ref_from_utd_entry(tr, utd_entry);
 
 		rb_erase(&st_entry->sock_node, &sock_tag_tree);
+		sock_tag_hash_del(st_entry);
 		list_del(&st_entry->list);
 		/* Can't sockfd_put() within spinlock, do it later. */
 		sock_tag_tree_insert(st_entry, &st_to_free_tree);
@@ -2980,8 +3374,21 @@ static int __init qtaguid_proc_register(struct proc_dir_entry **res_procdir)
 	 * TODO: add support counter hacking
 	 * xt_qtaguid_stats_file->write_proc = qtaguid_stats_proc_write;
 	 */
+
+	xt_qtaguid_rcv_stats_file = create_proc_entry("rcv_stats",
+						      proc_stats_perms,
+						      *res_procdir);
+	if (!xt_qtaguid_rcv_stats_file) {
+		pr_err("qtaguid: failed to create xt_qtaguid/rcv_stats "
+			"file\n");
+		ret = -ENOMEM;
+		goto no_rcv_stats_entry;
+	}
+	xt_qtaguid_rcv_stats_file->read_proc = qtaguid_rcv_stats_proc_read;
 	return 0;
 
+no_rcv_stats_entry:
+	remove_proc_entry("stats", *res_procdir);
 no_stats_entry:
 	remove_proc_entry("ctrl", *res_procdir);
 no_ctrl_entry:
@@ -3008,7 +3415,8 @@ static int __init qtaguid_mt_init(void)
 	if (qtaguid_proc_register(&xt_qtaguid_procdir)
 	    || iface_stat_init(xt_qtaguid_procdir)
 	    || xt_register_match(&qtaguid_mt_reg)
-	    || misc_register(&qtu_device))
+	    || misc_register(&qtu_device)
+	    || rcv_stats_init())
 		return -1;
 	return 0;
 }
@@ -11,8 +11,13 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/cache.h>
+#include <linux/cpumask.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
+#include <linux/string.h>
 #include <linux/spinlock_types.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -177,6 +182,8 @@ struct byte_packet_counters {
 
 struct data_counters {
 	struct byte_packet_counters bpc[IFS_MAX_COUNTER_SETS][IFS_MAX_DIRECTIONS][IFS_MAX_PROTOS];
+	/* keeps 32-bit readers of a per cpu copy from seeing torn values */
+	struct u64_stats_sync syncp;
 };
 
 static inline uint64_t dc_sum_bytes(struct data_counters *counters,
@@ -198,6 +205,38 @@ static inline uint64_t dc_sum_packets(struct data_counters *counters,
 }
 
 
+/*
+ * Counters updated on the packet path are kept one set per possible cpu,
+ * so updates need no lock. Readers fold them together.
+ */
+#define DATA_COUNTERS_PCPU_SIZE (nr_cpu_ids * sizeof(struct data_counters))
+
+static inline void data_counters_fold(const struct data_counters *pcpu,
+				      struct data_counters *res)
+{
+	struct data_counters snap;
+	unsigned int start;
+	int cpu, set, dir, proto;
+
+	memset(res, 0, sizeof(*res));
+	for_each_possible_cpu(cpu) {
+		do {
+			start = u64_stats_fetch_begin(&pcpu[cpu].syncp);
+			memcpy(snap.bpc, pcpu[cpu].bpc, sizeof(snap.bpc));
+		} while (u64_stats_fetch_retry(&pcpu[cpu].syncp, start));
+
+		for (set = 0; set < IFS_MAX_COUNTER_SETS; set++)
+			for (dir = 0; dir < IFS_MAX_DIRECTIONS; dir++)
+				for (proto = 0; proto < IFS_MAX_PROTOS;
+				     proto++) {
+					res->bpc[set][dir][proto].bytes +=
+					snap.bpc[set][dir][proto].bytes;
+					res->bpc[set][dir][proto].packets +=
+					snap.bpc[set][dir][proto].packets;
+				}
+	}
+}
+
 /* Generic X based nodes used as a base for rb_tree ops */
 struct tag_node {
 	struct rb_node node;
@@ -206,12 +245,15 @@ struct tag_node {
 
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
 	/*
 	 * If this tag is acct_tag based, we need to count against the
-	 * matching parent uid_tag.
+	 * matching parent uid_tag (the parent's per cpu counters).
 	 */
 	struct data_counters *parent_counters;
+	/* Freed after a grace period, the packet path may cache it */
+	struct rcu_head rcu;
+	/* One per possible cpu, see DATA_COUNTERS_PCPU_SIZE */
+	struct data_counters counters[0] ____cacheline_aligned;
 };
 
 struct iface_stat {
@@ -222,7 +264,6 @@ struct iface_stat {
 	struct net_device *net_dev;
 
 	struct byte_packet_counters totals_via_dev[IFS_MAX_DIRECTIONS];
-	struct data_counters totals_via_skb;
 	/*
 	 * We keep the last_known, because some devices reset their counters
 	 * just before NETDEV_UP, while some will reset just before
@@ -239,6 +280,9 @@ struct iface_stat {
 
 	struct rb_root tag_stat_tree;
 	spinlock_t tag_stat_list_lock;
+
+	/* One per possible cpu, see DATA_COUNTERS_PCPU_SIZE */
+	struct data_counters totals_via_skb[0] ____cacheline_aligned;
 };
 
 /* This is needed to create proc_dir_entries from atomic context. */
@@ -255,6 +299,9 @@ struct iface_stat_work {
  */
 struct sock_tag {
 	struct rb_node sock_node;
+	/* In sock_tag_hash, for lockless lookup from the packet path */
+	struct hlist_node sock_hash_node;
+	struct rcu_head rcu;
 	struct sock *sk;  /* Only used as a number, never dereferenced */
 	/* The socket is needed for sockfd_put() */
 	struct socket *socket;
@@ -297,6 +344,35 @@ struct qtaguid_event_counts {
 	atomic64_t match_no_sk_file;
 };
 
+/*
+ * Receive queue stats, one entry per uid_tag, fed by the sock_rcvqueue_*
+ * tracepoints while the rcv_stats param is set.
+ *  fill_hist[i]: sk_rmem_alloc was within [i/8, (i+1)/8) of sk_rcvbuf
+ *                right after an skb was queued (last bucket: 7/8 and up).
+ *  delay_hist[i]: skb read by the app [2^(i-1), 2^i) usec after the stack
+ *                 got it (bucket 0: under 1 usec, last bucket: no limit).
+ */
+#define RCV_FILL_BUCKETS 8
+#define RCV_DELAY_BUCKETS 20
+
+struct rcv_counters {
+	uint64_t queued;
+	uint64_t rmem_drops;
+	uint64_t reads;
+	uint64_t delay_us;  /* Summed over reads */
+	uint32_t rmem_max;
+	uint64_t fill_hist[RCV_FILL_BUCKETS];
+	uint64_t delay_hist[RCV_DELAY_BUCKETS];
+};
+
+#define RCV_COUNTERS_PCPU_SIZE (nr_cpu_ids * sizeof(struct rcv_counters))
+
+struct rcv_stat {
+	struct tag_node tn;
+	/* One per possible cpu, see RCV_COUNTERS_PCPU_SIZE */
+	struct rcv_counters counters[0] ____cacheline_aligned;
+};
+
 /* Track the set active_set for the given tag. */
 struct tag_counter_set {
 	struct tag_node tn;
@@ -151,6 +151,7 @@ char *pp_tag_ref(struct tag_ref *tr)
 
 char *pp_tag_stat(struct tag_stat *ts)
 {
+	struct data_counters totals, parent_totals;
 	char *tn_str;
 	char *counters_str;
 	char *parent_counters_str;
@@ -162,8 +163,14 @@ char *pp_tag_stat(struct tag_stat *ts)
 		return res;
 	}
 	tn_str = pp_tag_node(&ts->tn);
-	counters_str = pp_data_counters(&ts->counters, true);
-	parent_counters_str = pp_data_counters(ts->parent_counters, false);
+	data_counters_fold(ts->counters, &totals);
+	counters_str = pp_data_counters(&totals, true);
+	if (ts->parent_counters) {
+		data_counters_fold(ts->parent_counters, &parent_totals);
+		parent_counters_str = pp_data_counters(&parent_totals, true);
+	} else {
+		parent_counters_str = pp_data_counters(NULL, false);
+	}
 	res = kasprintf(GFP_ATOMIC,
 			"tag_stat@%p{%s, counters=%s, parent_counters=%s}",
 			ts, tn_str, counters_str, parent_counters_str);
@@ -180,7 +187,9 @@ char *pp_iface_stat(struct iface_stat *is)
 	if (!is) {
 		res = kasprintf(GFP_ATOMIC, "iface_stat@null{}");
 	} else {
-		struct data_counters *cnts = &is->totals_via_skb;
+		struct data_counters totals, *cnts = &totals;
+
+		data_counters_fold(is->totals_via_skb, &totals);
 		res = kasprintf(GFP_ATOMIC, "iface_stat@%p{"
 				"list=list_head{...}, "
 				"ifname=%s, "
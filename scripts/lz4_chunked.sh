@@ -0,0 +1,22 @@
+#!/bin/sh
+#
+# Compress stdin to stdout as a series of LZ4 legacy streams, each from
+# at most CHUNK bytes of input (default 1MB). The result is still a valid
+# legacy LZ4 stream, but with chunks small enough for the kernel to
+# decompress an initramfs or initrd on several cpus at once (see
+# lib/decompress_unlz4.c). lz4c -l on its own always cuts at 8MB.
+#
+# usage: lz4_chunked.sh [CHUNK] < ramdisk.cpio > ramdisk.cpio.lz4
+#
+
+CHUNK=${1:-1048576}
+
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+
+split -b "$CHUNK" - "$tmp/chunk." || exit 1
+
+for f in "$tmp"/chunk.*; do
+	[ -e "$f" ] || continue
+	lz4c -l -c1 "$f" stdout || exit 1
+done
@@ -16,6 +16,7 @@
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/time.h>
+#include <linux/ktime.h>
 #include <linux/wait.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
@@ -46,7 +47,7 @@ struct snd_msm_volume {
 
 #define PLAYBACK_NUM_PERIODS		4
 #define PLAYBACK_MAX_PERIOD_SIZE	1024
-#define PLAYBACK_MIN_PERIOD_SIZE	512
+#define PLAYBACK_MIN_PERIOD_SIZE	128
 #define CAPTURE_NUM_PERIODS		4
 #define CAPTURE_MIN_PERIOD_SIZE		128
 #define CAPTURE_MAX_PERIOD_SIZE		1024
@@ -104,6 +105,38 @@ static struct snd_pcm_hw_constraint_list constraints_sample_rates = {
 	.mask = 0,
 };
 
+/*
+ * Called for every buffer the DSP hands back while playing. An underrun
+ * means the DSP ran out of queued data: every buffer is back with the
+ * cpu, or, when mmap'ed, the period about to be queued was not written
+ * by the application yet. A glitch is a buffer returned more than half
+ * a period late, which the DSP covers with silence.
+ */
+static void msm_pcm_account_write_done(struct msm_audio *prtd)
+{
+	struct snd_pcm_runtime *runtime = prtd->substream->runtime;
+	ktime_t now = ktime_get();
+
+	/* running dry while draining is expected */
+	if (!atomic_read(&prtd->start) ||
+	    runtime->status->state != SNDRV_PCM_STATE_RUNNING)
+		return;
+
+	if (prtd->mmap_flag) {
+		if (snd_pcm_playback_hw_avail(runtime) <
+		    (snd_pcm_sframes_t)runtime->period_size)
+			prtd->underruns++;
+	} else if (atomic_read(&prtd->out_count) >= runtime->periods) {
+		prtd->underruns++;
+	}
+
+	if (prtd->last_write_done.tv64 &&
+	    ktime_us_delta(now, prtd->last_write_done) >
+	    prtd->period_us + prtd->period_us / 2)
+		prtd->glitches++;
+	prtd->last_write_done = now;
+}
+
 static void event_handler(uint32_t opcode,
 		uint32_t token, uint32_t *payload, void *priv)
 {
@@ -123,6 +156,7 @@ static void event_handler(uint32_t opcode,
 		if (atomic_read(&prtd->start))
 			snd_pcm_period_elapsed(substream);
 		atomic_inc(&prtd->out_count);
+		msm_pcm_account_write_done(prtd);
 		wake_up(&the_locks.write_wait);
 		if (!atomic_read(&prtd->start))
 			break;
@@ -215,6 +249,9 @@ static int msm_pcm_playback_prepare(struct snd_pcm_substream *substream)
 	/* rate and channels are sent to audio driver */
 	prtd->samp_rate = runtime->rate;
 	prtd->channel_mode = runtime->channels;
+	prtd->period_us = div_u64((u64)runtime->period_size * USEC_PER_SEC,
+				  runtime->rate);
+	prtd->last_write_done.tv64 = 0;
 	if (prtd->enabled)
 		return 0;
 
@@ -310,6 +347,8 @@ static int msm_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 		pr_debug("SNDRV_PCM_TRIGGER_PAUSE\n");
 		q6asm_cmd_nowait(prtd->audio_client, CMD_PAUSE);
 		atomic_set(&prtd->start, 0);
+		/* the gap across a pause is not a glitch */
+		prtd->last_write_done.tv64 = 0;
 		break;
 	default:
 		ret = -EINVAL;
@@ -718,6 +757,58 @@ static struct snd_pcm_ops msm_pcm_ops = {
 	.mmap		= msm_pcm_mmap,
 };
 
+static int msm_pcm_xrun_ctl_info(struct snd_kcontrol *kcontrol,
+				 struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 2;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = INT_MAX;
+	return 0;
+}
+
+/* underruns and glitches of the stream playing on the device, if any */
+static int msm_pcm_xrun_ctl_get(struct snd_kcontrol *kcontrol,
+				struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_pcm *pcm = snd_kcontrol_chip(kcontrol);
+	struct snd_pcm_substream *substream =
+		pcm->streams[SNDRV_PCM_STREAM_PLAYBACK].substream;
+	struct msm_audio *prtd;
+
+	ucontrol->value.integer.value[0] = 0;
+	ucontrol->value.integer.value[1] = 0;
+	if (!substream || !substream->runtime)
+		return 0;
+
+	prtd = substream->runtime->private_data;
+	if (prtd) {
+		ucontrol->value.integer.value[0] = prtd->underruns;
+		ucontrol->value.integer.value[1] = prtd->glitches;
+	}
+	return 0;
+}
+
+static int msm_pcm_add_xrun_ctl(struct snd_soc_pcm_runtime *rtd)
+{
+	struct snd_pcm *pcm = rtd->pcm;
+	struct snd_kcontrol_new knew = {
+		.iface	= SNDRV_CTL_ELEM_IFACE_MIXER,
+		.access	= SNDRV_CTL_ELEM_ACCESS_READ |
+			  SNDRV_CTL_ELEM_ACCESS_VOLATILE,
+		.info	= msm_pcm_xrun_ctl_info,
+		.get	= msm_pcm_xrun_ctl_get,
+	};
+	char name[44];
+
+	if (!pcm->streams[SNDRV_PCM_STREAM_PLAYBACK].substream)
+		return 0;
+
+	snprintf(name, sizeof(name), "Playback XRun %d", pcm->device);
+	knew.name = name;
+	return snd_ctl_add(rtd->card->snd_card, snd_ctl_new1(&knew, pcm));
+}
+
 static int msm_asoc_pcm_new(struct snd_soc_pcm_runtime *rtd)
 {
 	struct snd_card *card = rtd->card->snd_card;
@@ -725,6 +816,10 @@ static int msm_asoc_pcm_new(struct snd_soc_pcm_runtime *rtd)
 
 	if (!card->dev->coherent_dma_mask)
 		card->dev->coherent_dma_mask = DMA_BIT_MASK(32);
+
+	ret = msm_pcm_add_xrun_ctl(rtd);
+	if (ret < 0)
+		pr_err("%s: Could not add pcm XRun control\n", __func__);
 	return ret;
 }
 
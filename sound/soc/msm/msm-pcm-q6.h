@@ -18,6 +18,7 @@
 
 #ifndef _MSM_PCM_H
 #define _MSM_PCM_H
+#include <linux/ktime.h>
 #include <sound/apr_audio.h>
 #include <sound/q6asm.h>
 
@@ -84,6 +85,11 @@ struct msm_audio {
 	atomic_t pending_buffer;
 	bool set_channel_map;
 	char channel_map[8];
+	/* playback health, reported through the XRun mixer control */
+	ktime_t last_write_done;
+	unsigned int period_us;
+	unsigned int underruns;
+	unsigned int glitches;
 };
 
 struct output_meta_data_st {
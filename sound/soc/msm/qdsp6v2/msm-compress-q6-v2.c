@@ -62,6 +62,17 @@
 #define COMPR_PLAYBACK_MIN_NUM_FRAGMENTS (4)
 #define COMPR_PLAYBACK_MAX_NUM_FRAGMENTS (16 * 4)
 
+/*
+ * Buffers at least this big are handed to the DSP up to half a buffer
+ * per write, instead of a fragment at a time, so the AP is woken once
+ * per half buffer during screen-off playback.
+ */
+#define COMPR_DEEP_BUFFER_MIN_SIZE	(512 * 1024)
+
+static bool deep_buffer = 1;
+module_param(deep_buffer, bool, 0644);
+MODULE_PARM_DESC(deep_buffer, "Batch writes to the DSP for large buffers");
+
 #define COMPRESSED_LR_VOL_MAX_STEPS	0x2000
 const DECLARE_TLV_DB_LINEAR(msm_compr_vol_gain, 0,
 				COMPRESSED_LR_VOL_MAX_STEPS);
@@ -135,6 +146,11 @@ struct msm_compr_audio {
 
 	uint64_t marker_timestamp;
 
+	bool deep_buffer;
+	uint32_t wakeups; /* WRITE_DONE events while playing */
+	unsigned long play_start; /* jiffies, 0 when not playing */
+	unsigned long play_jiffies;
+
 	struct msm_compr_gapless_state gapless_state;
 
 	atomic_t start;
@@ -232,6 +248,48 @@ static int msm_compr_send_ddp_cfg(struct audio_client *ac,
 	return 0;
 }
 
+/* How much of bytes_available the next write to the DSP carries */
+static int msm_compr_write_len(struct msm_compr_audio *prtd,
+			       int bytes_available)
+{
+	uint32_t fragment_size = prtd->codec_param.buffer.fragment_size;
+	int len = fragment_size;
+
+	if (bytes_available < fragment_size) {
+		len = bytes_available;
+	} else if (prtd->deep_buffer) {
+		len = rounddown(bytes_available, fragment_size);
+		len = min_t(int, len, (prtd->codec_param.buffer.fragments / 2) *
+				      fragment_size);
+	}
+
+	if (prtd->byte_offset + len > prtd->buffer_size)
+		len = prtd->buffer_size - prtd->byte_offset;
+	return len;
+}
+
+/* Playing time in jiffies, including the current run */
+static unsigned long msm_compr_play_time(struct msm_compr_audio *prtd)
+{
+	unsigned long t = prtd->play_jiffies;
+
+	if (prtd->play_start)
+		t += jiffies - prtd->play_start;
+	return t;
+}
+
+static void msm_compr_play_start(struct msm_compr_audio *prtd)
+{
+	if (!prtd->play_start)
+		prtd->play_start = jiffies ?: 1;
+}
+
+static void msm_compr_play_stop(struct msm_compr_audio *prtd)
+{
+	prtd->play_jiffies = msm_compr_play_time(prtd);
+	prtd->play_start = 0;
+}
+
 static int msm_compr_send_buffer(struct msm_compr_audio *prtd)
 {
 	int buffer_length;
@@ -257,15 +315,8 @@ static int msm_compr_send_buffer(struct msm_compr_audio *prtd)
 				prtd->gapless_state.initial_samples_drop,
 				prtd->gapless_state.trailing_samples_drop);
 
-	buffer_length = prtd->codec_param.buffer.fragment_size;
 	bytes_available = prtd->bytes_received - prtd->copied_total;
-	if (bytes_available < prtd->codec_param.buffer.fragment_size)
-		buffer_length = bytes_available;
-
-	if (prtd->byte_offset + buffer_length > prtd->buffer_size) {
-		buffer_length = (prtd->buffer_size - prtd->byte_offset);
-		pr_debug("wrap around situation, send partial data %d now", buffer_length);
-	}
+	buffer_length = msm_compr_write_len(prtd, bytes_available);
 
 	if (buffer_length)
 		param.paddr	= prtd->buffer_paddr + prtd->byte_offset;
@@ -328,6 +379,7 @@ static void compr_event_handler(uint32_t opcode,
 			prtd->byte_offset -= prtd->buffer_size;
 
 		snd_compr_fragment_elapsed(cstream);
+		prtd->wakeups++;
 
 		if (!atomic_read(&prtd->start)) {
 			/* Writes must be restarted from _copy() */
@@ -350,8 +402,9 @@ static void compr_event_handler(uint32_t opcode,
 				wake_up(&prtd->drain_wait);
 				atomic_set(&prtd->drain, 0);
 			}
-		} else if ((bytes_available == cstream->runtime->fragment_size)
-			   && atomic_read(&prtd->drain)) {
+		} else if (atomic_read(&prtd->drain) &&
+			   msm_compr_write_len(prtd, bytes_available) ==
+			   bytes_available) {
 			prtd->last_buffer = 1;
 			msm_compr_send_buffer(prtd);
 			prtd->last_buffer = 0;
@@ -623,6 +676,9 @@ static int msm_compr_configure_dsp(struct snd_compr_stream *cstream)
 	prtd->buffer       = ac->port[dir].buf[0].data;
 	prtd->buffer_paddr = ac->port[dir].buf[0].phys;
 	prtd->buffer_size  = runtime->fragments * runtime->fragment_size;
+	prtd->deep_buffer = deep_buffer &&
+			    prtd->buffer_size >= COMPR_DEEP_BUFFER_MIN_SIZE;
+	pr_debug("%s: deep buffer %d\n", __func__, prtd->deep_buffer);
 
 	ret = msm_compr_send_media_format_block(cstream, ac->stream_id);
 	if (ret < 0)
@@ -971,6 +1027,7 @@ static int msm_compr_trigger(struct snd_compr_stream *cstream, int cmd)
 	case SNDRV_PCM_TRIGGER_START:
 		pr_debug("%s: SNDRV_PCM_TRIGGER_START\n", __func__);
 		atomic_set(&prtd->start, 1);
+		msm_compr_play_start(prtd);
 		q6asm_run_nowait(prtd->audio_client, 0, 0, 0);
 
 		msm_compr_set_volume(cstream, volume[0], volume[1]);
@@ -984,6 +1041,7 @@ static int msm_compr_trigger(struct snd_compr_stream *cstream, int cmd)
 					prtd->gapless_state.gapless_transition);
 		stream_id = ac->stream_id;
 		atomic_set(&prtd->start, 0);
+		msm_compr_play_stop(prtd);
 		if (prtd->next_stream) {
 			pr_debug("%s: interrupt next track wait queues\n",
 								__func__);
@@ -1047,6 +1105,7 @@ static int msm_compr_trigger(struct snd_compr_stream *cstream, int cmd)
 				  ac->stream_id);
 			q6asm_stream_cmd_nowait(ac, CMD_PAUSE, ac->stream_id);
 			atomic_set(&prtd->start, 0);
+			msm_compr_play_stop(prtd);
 		}
 		break;
 	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
@@ -1054,6 +1113,7 @@ static int msm_compr_trigger(struct snd_compr_stream *cstream, int cmd)
 				   prtd->gapless_state.gapless_transition);
 		if (!prtd->gapless_state.gapless_transition) {
 			atomic_set(&prtd->start, 1);
+			msm_compr_play_start(prtd);
 			q6asm_run_nowait(prtd->audio_client, 0, 0, 0);
 		}
 		break;
@@ -1641,6 +1701,40 @@ static int msm_compr_volume_get(struct snd_kcontrol *kcontrol,
 	return 0;
 }
 
+/* WRITE_DONE wakeups so far and per minute of playing time */
+static int msm_compr_wakeups_get(struct snd_kcontrol *kcontrol,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_platform *platform = snd_kcontrol_chip(kcontrol);
+	unsigned long fe_id = kcontrol->private_value;
+	struct msm_compr_pdata *pdata =
+		snd_soc_platform_get_drvdata(platform);
+	struct snd_compr_stream *cstream;
+	struct msm_compr_audio *prtd;
+	unsigned long play_time;
+
+	if (fe_id >= MSM_FRONTEND_DAI_MAX) {
+		pr_err("%s Received out of bound fe_id %lu\n", __func__, fe_id);
+		return -EINVAL;
+	}
+
+	ucontrol->value.integer.value[0] = 0;
+	ucontrol->value.integer.value[1] = 0;
+	cstream = pdata->cstream[fe_id];
+	if (!cstream || !cstream->runtime)
+		return 0;
+	prtd = cstream->runtime->private_data;
+	if (!prtd)
+		return 0;
+
+	play_time = msm_compr_play_time(prtd);
+	ucontrol->value.integer.value[0] = prtd->wakeups;
+	if (play_time >= HZ)
+		ucontrol->value.integer.value[1] =
+			div_u64((u64)prtd->wakeups * 60 * HZ, play_time);
+	return 0;
+}
+
 static int msm_compr_audio_effects_config_put(struct snd_kcontrol *kcontrol,
 					   struct snd_ctl_elem_value *ucontrol)
 {
@@ -1888,6 +1982,57 @@ static int msm_compr_add_volume_control(struct snd_soc_pcm_runtime *rtd)
 	return 0;
 }
 
+static int msm_compr_wakeups_info(struct snd_kcontrol *kcontrol,
+				  struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 2;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = 0x7FFFFFFF;
+	return 0;
+}
+
+static int msm_compr_add_wakeups_control(struct snd_soc_pcm_runtime *rtd)
+{
+	const char *mixer_ctl_name = "Compress Playback";
+	const char *deviceNo       = "NN";
+	const char *suffix         = "Wakeups";
+	char *mixer_str = NULL;
+	int ctl_len;
+	struct snd_kcontrol_new fe_wakeups_control[1] = {
+		{
+		.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+		.name = "?",
+		.access = SNDRV_CTL_ELEM_ACCESS_READ |
+			  SNDRV_CTL_ELEM_ACCESS_VOLATILE,
+		.info = msm_compr_wakeups_info,
+		.get = msm_compr_wakeups_get,
+		.private_value = 0,
+		}
+	};
+
+	if (!rtd) {
+		pr_err("%s NULL rtd\n", __func__);
+		return 0;
+	}
+	ctl_len = strlen(mixer_ctl_name) + 1 + strlen(deviceNo) + 1 +
+		  strlen(suffix) + 1;
+	mixer_str = kzalloc(ctl_len, GFP_KERNEL);
+	if (!mixer_str) {
+		pr_err("failed to allocate mixer ctrl str of len %d", ctl_len);
+		return 0;
+	}
+	snprintf(mixer_str, ctl_len, "%s %d %s", mixer_ctl_name,
+		 rtd->pcm->device, suffix);
+	fe_wakeups_control[0].name = mixer_str;
+	fe_wakeups_control[0].private_value = rtd->dai_link->be_id;
+	pr_debug("Registering new mixer ctl %s", mixer_str);
+	snd_soc_add_platform_controls(rtd->platform, fe_wakeups_control,
+				      ARRAY_SIZE(fe_wakeups_control));
+	kfree(mixer_str);
+	return 0;
+}
+
 static int msm_compr_add_audio_effects_control(struct snd_soc_pcm_runtime *rtd)
 {
 	const char *mixer_ctl_name = "Audio Effects Config";
@@ -2026,6 +2171,9 @@ static int msm_compr_new(struct snd_soc_pcm_runtime *rtd)
 	rc = msm_compr_add_volume_control(rtd);
 	if (rc)
 		pr_err("%s: Could not add Compr Volume Control\n", __func__);
+	rc = msm_compr_add_wakeups_control(rtd);
+	if (rc)
+		pr_err("%s: Could not add Compr Wakeups Control\n", __func__);
 	rc = msm_compr_add_audio_effects_control(rtd);
 	if (rc)
 		pr_err("%s: Could not add Compr Audio Effects Control\n",
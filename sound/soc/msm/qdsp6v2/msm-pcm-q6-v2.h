@@ -18,6 +18,7 @@
 
 #ifndef _MSM_PCM_H
 #define _MSM_PCM_H
+#include <linux/ktime.h>
 #include <sound/apr_audio-v2.h>
 #include <sound/q6asm-v2.h>
 
@@ -94,6 +95,11 @@ struct msm_audio {
 	int cmd_interrupt;
 	bool meta_data_mode;
 	uint32_t volume;
+	/* playback health, reported through the XRun mixer control */
+	ktime_t last_write_done;
+	unsigned int period_us;
+	unsigned int underruns;
+	unsigned int glitches;
 };
 
 struct output_meta_data_st {
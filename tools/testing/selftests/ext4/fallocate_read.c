@@ -0,0 +1,136 @@
+/*
+ * Preallocated (uninitialized) extents must read back as zeros, also
+ * after the blocks have been looked up, partly written with O_DIRECT
+ * and dropped from the page cache - which is when a stale extent
+ * status cache entry would map them as written.
+ *
+ * The blocks of a file full of a pattern are freed first so that the
+ * preallocation is likely to reuse them: a wrong mapping then shows the
+ * old pattern instead of zeros.
+ *
+ * usage: fallocate_read [directory on an ext4 file system]
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define FILE_SIZE	(4 << 20)
+#define CHUNK		(64 << 10)
+#define PATTERN		0x5a
+
+static char path[4096];
+static char buf[CHUNK] __attribute__((aligned(4096)));
+
+static void fail(const char *msg)
+{
+	perror(msg);
+	unlink(path);
+	exit(1);
+}
+
+static void drop_cache(int fd)
+{
+	if (fsync(fd))
+		fail("fsync");
+	if (posix_fadvise(fd, 0, FILE_SIZE, POSIX_FADV_DONTNEED))
+		fail("posix_fadvise");
+}
+
+/* Every byte of the file must be zero, except [skip, skip + len) */
+static int check_zero(int fd, off_t skip, size_t len, const char *when)
+{
+	off_t off;
+	size_t i;
+	int bad = 0;
+
+	for (off = 0; off < FILE_SIZE; off += CHUNK) {
+		if (pread(fd, buf, CHUNK, off) != CHUNK)
+			fail("pread");
+		if (off >= skip && off < skip + (off_t)len)
+			continue;
+		for (i = 0; i < CHUNK; i++) {
+			if (buf[i]) {
+				printf("%s: byte %lld is 0x%02x, not 0\n",
+				       when, (long long)(off + i),
+				       (unsigned char)buf[i]);
+				bad = 1;
+				break;
+			}
+		}
+	}
+
+	return bad;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = argc > 1 ? argv[1] : ".";
+	off_t off;
+	int fd, dfd, ret = 0;
+
+	snprintf(path, sizeof(path), "%s/fallocate_read.%d", dir, getpid());
+
+	/* leave a pattern in free blocks */
+	fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0600);
+	if (fd < 0)
+		fail("open");
+	memset(buf, PATTERN, CHUNK);
+	for (off = 0; off < FILE_SIZE; off += CHUNK)
+		if (pwrite(fd, buf, CHUNK, off) != CHUNK)
+			fail("pwrite");
+	if (fsync(fd))
+		fail("fsync");
+	close(fd);
+	unlink(path);
+	sync();
+
+	fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0600);
+	if (fd < 0)
+		fail("open");
+	if (fallocate(fd, 0, 0, FILE_SIZE)) {
+		if (errno == EOPNOTSUPP) {
+			printf("fallocate not supported, skipping\n");
+			close(fd);
+			unlink(path);
+			return 0;
+		}
+		fail("fallocate");
+	}
+
+	/* a second fallocate over the same range takes the repeat path */
+	if (fallocate(fd, 0, 0, FILE_SIZE))
+		fail("fallocate");
+	ret |= check_zero(fd, FILE_SIZE, 0, "after fallocate");
+	drop_cache(fd);
+	ret |= check_zero(fd, FILE_SIZE, 0, "after fallocate, uncached");
+
+	/* a direct write into the middle splits the preallocated extent */
+	dfd = open(path, O_RDWR | O_DIRECT);
+	if (dfd < 0) {
+		printf("O_DIRECT not supported, skipping the direct I/O part\n");
+	} else {
+		memset(buf, PATTERN, CHUNK);
+		if (pwrite(dfd, buf, CHUNK, FILE_SIZE / 2) != CHUNK)
+			fail("pwrite O_DIRECT");
+		close(dfd);
+		drop_cache(fd);
+		ret |= check_zero(fd, FILE_SIZE / 2, CHUNK,
+				  "around a direct write");
+	}
+
+	close(fd);
+	unlink(path);
+
+	printf("fallocate_read: %s\n", ret ? "FAIL" : "PASS");
+
+	return ret;
+}